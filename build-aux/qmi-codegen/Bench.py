@@ -0,0 +1,205 @@
+#!/usr/bin/env python
+# -*- Mode: python; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+#
+# This program is free software; you can redistribute it and/or modify it under
+# the terms of the GNU Lesser General Public License as published by the Free
+# Software Foundation; either version 2 of the License, or (at your option) any
+# later version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+# details.
+#
+# You should have received a copy of the GNU Lesser General Public License along
+# with this program; if not, write to the Free Software Foundation, Inc., 51
+# Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+# Copyright (C) 2026 agent <agent@local>
+#
+
+import struct
+
+import utils
+from Schema import MESSAGE_KIND_INDICATION
+
+"""
+The table of sample messages used by the bench-messages benchmark, with one
+request and one response (or one indication) per message, synthesized from the
+same field descriptions used for the binary schema database.
+
+Every TLV known for the message is included, with strings and arrays filled up
+to their maximum size when one is given, and up to a default size otherwise.
+"""
+
+# Sizes used when the field doesn't specify a maximum
+DEFAULT_STRING_LENGTH = 32
+DEFAULT_ARRAY_ITEMS   = 4
+
+# QMUX and QMI headers, for the size limit of the whole message
+MAX_TLVS_SIZE = 0xFFFF - 12
+
+BYTES_PER_LINE = 12
+
+
+class Bench:
+
+    def __init__(self, schema):
+        self.schema = schema
+
+
+    """
+    Raw value of a single field, as a bytearray
+    """
+    def __build_field(self, field, n_array_items):
+        field_type = field['type']
+        size = field['size']
+
+        if field_type == 'values':
+            value = 0
+            if self.schema.values.types:
+                (is_flags, values) = self.schema.values.lookup(field['values-type'])
+                if is_flags:
+                    # All flags set, so that all nicks are printed
+                    for (flag_value, nick) in values:
+                        value |= flag_value
+                elif values:
+                    value = values[-1][0]
+            return self.__build_integer(value, size, field['big-endian'])
+
+        if field_type == 'boolean':
+            return self.__build_integer(1, size, field['big-endian'])
+
+        if field_type in ('uint', 'int'):
+            return self.__build_integer(int.from_bytes(bytes((0x11 * (i + 1)) & 0x7F for i in range(size)), 'little'),
+                                        size, field['big-endian'])
+
+        if field_type == 'float':
+            return bytearray(struct.pack('<f', 1.5))
+
+        if field_type == 'fixed-size-string':
+            return self.__build_string(field['length'])
+
+        if field_type == 'string':
+            length = field['length'] if field['length'] else DEFAULT_STRING_LENGTH
+            if size == 1:
+                length = min(length, 0xFF)
+            raw = bytearray()
+            if size:
+                raw += self.__build_integer(length, size, False)
+            return raw + self.__build_string(length)
+
+        if field_type == 'struct':
+            raw = bytearray()
+            for member in field['members']:
+                raw += self.__build_field(member, n_array_items)
+            return raw
+
+        if field_type == 'array':
+            element = field['members'][-1]
+            raw = bytearray()
+            if field['length']:
+                n_items = field['length']
+            else:
+                n_items = n_array_items
+                raw += self.__build_integer(n_items, size, False)
+                if field['sequence']:
+                    raw += self.__build_integer(1, field['members'][0]['size'], False)
+            for i in range(n_items):
+                raw += self.__build_field(element, n_array_items)
+            return raw
+
+        raise ValueError('Unsupported field type \'%s\'' % field_type)
+
+
+    @staticmethod
+    def __build_integer(value, size, big_endian):
+        value &= (1 << (8 * size)) - 1
+        return bytearray(value.to_bytes(size, 'big' if big_endian else 'little'))
+
+
+    @staticmethod
+    def __build_string(length):
+        return bytearray((ord('a') + (i % 26)) for i in range(length))
+
+
+    """
+    Raw TLVs of the given message container, as a bytearray. The result TLV is
+    skipped, as responses are always created with it.
+    """
+    def __build_tlvs(self, tlvs):
+        for n_array_items in (DEFAULT_ARRAY_ITEMS, 1):
+            raw = bytearray()
+            for (tlv_type, name, field) in tlvs:
+                if field['type'] == 'result':
+                    continue
+                value = self.__build_field(field, n_array_items)
+                raw += struct.pack('<BH', tlv_type, len(value)) + value
+            if len(raw) <= MAX_TLVS_SIZE:
+                return raw
+        raise ValueError('Sample TLVs too long: %u bytes' % len(raw))
+
+
+    def __emit_raw(self, f, variable_name, raw):
+        if not raw:
+            return
+        f.write('\nstatic const guint8 %s[] = {\n' % variable_name)
+        for i in range(0, len(raw), BYTES_PER_LINE):
+            f.write('    %s,\n' % ', '.join('0x%02X' % b for b in raw[i:i + BYTES_PER_LINE]))
+        f.write('};\n')
+
+
+    """
+    Write the whole table in the given file
+    """
+    def emit(self, f):
+        f.write(
+            '#include <config.h>\n'
+            '#include <libqmi-glib.h>\n'
+            '\n'
+            '#include "bench-messages.h"\n')
+
+        entries = ''
+        for service_id in sorted(self.schema.services.keys()):
+            (service, messages) = self.schema.services[service_id]
+            guard = ('QMI_SERVICE_%s_SUPPORTED' % service.upper()) if service_id != 0 else None
+
+            f.write('\n/*****************************************************************************/\n'
+                    '/* %s */\n' % service)
+            if guard:
+                f.write('\n#if %s\n' % guard)
+                entries += '#if %s\n' % guard
+
+            for message in messages:
+                indication = (message['kind'] == MESSAGE_KIND_INDICATION)
+                variable_prefix = '%s_%s_%s' % (utils.build_underscore_name(service),
+                                                'indication' if indication else 'message',
+                                                utils.build_underscore_name(message['name']))
+                raw_input = self.__build_tlvs(message['input'])
+                raw_output = self.__build_tlvs(message['output'])
+                self.__emit_raw(f, variable_prefix + '_input', raw_input)
+                self.__emit_raw(f, variable_prefix + '_output', raw_output)
+
+                entries += ('    { "%s/%s/%s", QMI_SERVICE_%s, 0x%04X, 0x%04X, %s, %s, %u, %s, %u },\n' %
+                            (service.lower(),
+                             'indication' if indication else 'message',
+                             utils.build_dashed_name(message['name']),
+                             service.upper(),
+                             message['id'],
+                             message['vendor'],
+                             'TRUE' if indication else 'FALSE',
+                             (variable_prefix + '_input') if raw_input else 'NULL',
+                             len(raw_input),
+                             (variable_prefix + '_output') if raw_output else 'NULL',
+                             len(raw_output)))
+
+            if guard:
+                f.write('\n#endif /* %s */\n' % guard)
+                entries += '#endif /* %s */\n' % guard
+
+        f.write('\n/*****************************************************************************/\n'
+                '\n'
+                'const BenchMessage bench_messages[] = {\n'
+                '%s'
+                '    { NULL }\n'
+                '};\n' % entries)
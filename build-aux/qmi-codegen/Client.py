@@ -162,6 +162,10 @@ class Client:
                         '            ${output_camelcase} *output;\n'
                         '            GError *error = NULL;\n'
                         '\n'
+                        '            /* Don\'t parse the indication if nobody would get it */\n'
+                        '            if (!g_signal_has_handler_pending (self, signals[SIGNAL_${signal_id}], 0, FALSE))\n'
+                        '                break;\n'
+                        '\n'
                         '            /* Parse indication */\n'
                         '            output = __${message_fullname_underscore}_indication_parse (message, &error);\n'
                         '            if (!output) {\n'
@@ -288,6 +292,7 @@ class Client:
 
             translations['message_name'] = message.name
             translations['message_vendor_id'] = message.vendor
+            translations['message_priority'] = 'QMI_MESSAGE_PRIORITY_' + message.priority.upper() if message.priority is not None else None
             translations['message_underscore'] = utils.build_underscore_name(message.name)
             translations['message_fullname_underscore'] = utils.build_underscore_name(message.fullname)
             translations['input_camelcase'] = utils.build_camelcase_name(message.input.fullname)
@@ -295,6 +300,14 @@ class Client:
             translations['input_underscore'] = utils.build_underscore_name(message.input.fullname)
             translations['output_underscore'] = utils.build_underscore_name(message.output.fullname)
             translations['message_since'] = message.since
+            translations['input_static_camelcase'] = utils.build_camelcase_name(message.input.fullname + ' Static')
+            translations['no_reply_vendor_id'] = message.vendor if message.vendor is not None else 'QMI_MESSAGE_VENDOR_GENERIC'
+            if message.priority is not None:
+                translations['no_reply_priority'] = translations['message_priority']
+            elif self.service.upper() == 'CTL':
+                translations['no_reply_priority'] = 'QMI_MESSAGE_PRIORITY_HIGH'
+            else:
+                translations['no_reply_priority'] = 'QMI_MESSAGE_PRIORITY_NORMAL'
 
             if message.input.fields is None:
                 translations['input_arg'] = 'gpointer unused'
@@ -346,7 +359,76 @@ class Client:
                 '${output_camelcase} *${underscore}_${message_underscore}_finish (\n'
                 '    ${camelcase} *self,\n'
                 '    GAsyncResult *res,\n'
-                '    GError **error);\n')
+                '    GError **error);\n'
+                '\n'
+                '/**\n'
+                ' * ${underscore}_${message_underscore}_sync:\n'
+                ' * @self: a #${camelcase}.\n'
+                ' * @${input_doc}\n'
+                ' * @timeout: maximum time to wait for the method to complete, in seconds.\n'
+                ' * @cancellable: a #GCancellable or %NULL.\n'
+                ' * @error: Return location for error or %NULL.\n'
+                ' *\n'
+                ' * Synchronously sends a ${message_name} request to the device, blocking the calling thread until the response is received.\n'
+                ' *\n'
+                ' * This method must not be called from the thread running the main context of the #QmiDevice, and it is only supported when the device was opened with %QMI_DEVICE_OPEN_FLAGS_IO_THREAD. See qmi_device_command_full_sync() for details.\n'
+                ' *\n'
+                ' * Returns: a #${output_camelcase}, or %NULL if @error is set. The returned value should be freed with ${output_underscore}_unref().\n'
+                ' *\n'
+                ' * Since: 1.20\n'
+                ' */\n'
+                '${output_camelcase} *${underscore}_${message_underscore}_sync (\n'
+                '    ${camelcase} *self,\n'
+                '    ${input_arg},\n'
+                '    guint timeout,\n'
+                '    GCancellable *cancellable,\n'
+                '    GError **error);\n'
+                '\n'
+                '/**\n'
+                ' * ${underscore}_${message_underscore}_no_reply:\n'
+                ' * @self: a #${camelcase}.\n'
+                ' * @${input_doc}\n'
+                ' * @timeout: maximum time to wait for the response, in seconds.\n'
+                ' * @cancellable: a #GCancellable or %NULL.\n'
+                ' *\n'
+                ' * Sends a ${message_name} request to the device without reporting its result, for requests only sent for their side effects.\n'
+                ' *\n'
+                ' * The response is matched with the request and discarded without being parsed, and failures are only accounted in the statistics of the #QmiDevice, see qmi_message_context_set_no_reply().\n'
+                ' *\n'
+                ' * Since: 1.20\n'
+                ' */\n'
+                'void ${underscore}_${message_underscore}_no_reply (\n'
+                '    ${camelcase} *self,\n'
+                '    ${input_arg},\n'
+                '    guint timeout,\n'
+                '    GCancellable *cancellable);\n')
+            if message.static_input:
+                template += (
+                    '\n'
+                    '/**\n'
+                    ' * ${underscore}_${message_underscore}_static:\n'
+                    ' * @self: a #${camelcase}.\n'
+                    ' * @input: a #${input_static_camelcase}.\n'
+                    ' * @timeout: maximum time to wait for the method to complete, in seconds.\n'
+                    ' * @cancellable: a #GCancellable or %NULL.\n'
+                    ' * @callback: a #GAsyncReadyCallback to call when the request is satisfied.\n'
+                    ' * @user_data: user data to pass to @callback.\n'
+                    ' *\n'
+                    ' * Asynchronously sends a ${message_name} request to the device, as ${underscore}_${message_underscore}() does, but taking the input fields in a #${input_static_camelcase} instead of in a #${input_camelcase}.\n'
+                    ' *\n'
+                    ' * The request message is built before this method returns, so @input may be freed or go out of scope right after the call.\n'
+                    ' *\n'
+                    ' * You can then call ${underscore}_${message_underscore}_finish() to get the result of the operation.\n'
+                    ' *\n'
+                    ' * Since: 1.20\n'
+                    ' */\n'
+                    'void ${underscore}_${message_underscore}_static (\n'
+                    '    ${camelcase} *self,\n'
+                    '    const ${input_static_camelcase} *input,\n'
+                    '    guint timeout,\n'
+                    '    GCancellable *cancellable,\n'
+                    '    GAsyncReadyCallback callback,\n'
+                    '    gpointer user_data);\n')
             hfile.write(string.Template(template).substitute(translations))
 
             template = (
@@ -396,7 +478,6 @@ class Client:
                 '{\n'
                 '    GError *error = NULL;\n'
                 '    QmiMessage *reply;\n'
-                '    ${output_camelcase} *output;\n'
                 '\n'
                 '    reply = qmi_device_command_full_finish (device, res, &error);\n'
                 '    if (!reply) {\n')
@@ -444,22 +525,22 @@ class Client:
                 '        return;\n'
                 '    }\n'
                 '\n'
-                '    /* Parse reply */\n'
-                '    output = __${message_fullname_underscore}_response_parse (reply, &error);\n'
-                '    if (!output)\n'
-                '        g_task_return_error (task, error);\n'
-                '    else\n'
-                '        g_task_return_pointer (task,\n'
-                '                               output,\n'
-                '                               (GDestroyNotify)${output_underscore}_unref);\n'
-                '    g_object_unref (task);\n'
+                '    /* Parse reply, possibly in a worker thread; the task is completed there */\n'
+                '    __qmi_client_parse_response (QMI_CLIENT (g_task_get_source_object (task)),\n'
+                '                                 task,\n'
+                '                                 reply,\n'
+                '                                 (QmiClientResponseParseFn)__${message_fullname_underscore}_response_parse,\n'
+                '                                 (GDestroyNotify)${output_underscore}_unref);\n'
                 '    qmi_message_unref (reply);\n'
                 '}\n'
-                '\n'
+                '\n')
+
+            # The async method, also given with a static input if requested
+            async_template = (
                 'void\n'
-                '${underscore}_${message_underscore} (\n'
+                '${underscore}_${message_underscore}${async_suffix} (\n'
                 '    ${camelcase} *self,\n'
-                '    ${input_arg},\n'
+                '    ${async_input_arg},\n'
                 '    guint timeout,\n'
                 '    GCancellable *cancellable,\n'
                 '    GAsyncReadyCallback callback,\n'
@@ -470,11 +551,14 @@ class Client:
                 '    GError *error = NULL;\n'
                 '    guint16 transaction_id;\n')
 
-            if message.vendor is not None:
-                template += (
+            if message.vendor is not None or message.priority is not None:
+                async_template += (
                     '    QmiMessageContext *context;\n')
 
-            template += (
+            async_template += (
+                '\n'
+                '    /* Requests without reply must be explicitly asked for */\n'
+                '    g_return_if_fail (callback != NULL);\n'
                 '\n'
                 '    task = g_task_new (self, cancellable, callback, user_data);\n'
                 '    if (!qmi_client_is_valid (QMI_CLIENT (self))) {\n'
@@ -485,7 +569,7 @@ class Client:
                 '\n'
                 '    transaction_id = qmi_client_get_next_transaction_id (QMI_CLIENT (self));\n'
                 '\n'
-                '    request = __${message_fullname_underscore}_request_create (\n'
+                '    request = __${message_fullname_underscore}_request_create${async_suffix} (\n'
                 '                  transaction_id,\n'
                 '                  qmi_client_get_cid (QMI_CLIENT (self)),\n'
                 '                  ${input_var},\n'
@@ -498,44 +582,395 @@ class Client:
                 '    }\n')
 
             if message.abort:
-                template += (
+                async_template += (
                     '\n'
                     '    g_task_set_task_data (task, GUINT_TO_POINTER (transaction_id), NULL);\n')
 
-            if message.vendor is not None:
-                template += (
+            if message.vendor is not None or message.priority is not None:
+                async_template += (
                     '\n'
-                    '    context = qmi_message_context_new ();\n'
-                    '    qmi_message_context_set_vendor_id (context, ${message_vendor_id});\n')
-
-            template += (
+                    '    context = qmi_message_context_new ();\n')
+                if message.vendor is not None:
+                    async_template += (
+                        '    qmi_message_context_set_vendor_id (context, ${message_vendor_id});\n')
+                if message.priority is not None:
+                    async_template += (
+                        '    qmi_message_context_set_priority (context, ${message_priority});\n')
+
+            async_template += (
                 '\n'
                 '    qmi_device_command_full (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),\n'
                 '                             request,\n')
 
-            if message.vendor is not None:
-                template += (
+            if message.vendor is not None or message.priority is not None:
+                async_template += (
                     '                             context,\n')
             else:
-                template += (
+                async_template += (
                     '                             NULL,\n')
 
-            template += (
+            async_template += (
                 '                             timeout,\n'
                 '                             cancellable,\n'
                 '                             (GAsyncReadyCallback)${message_underscore}_ready,\n'
                 '                             task);\n'
                 '    qmi_message_unref (request);\n')
 
-            if message.vendor is not None:
+            if message.vendor is not None or message.priority is not None:
+                async_template += (
+                    '    qmi_message_context_unref (context);\n')
+
+            async_template += (
+                '}\n'
+                '\n')
+
+            template += string.Template(async_template).safe_substitute({ 'async_suffix'    : '',
+                                                                          'async_input_arg' : '${input_arg}' })
+            if message.static_input:
+                template += string.Template(async_template).safe_substitute({ 'async_suffix'    : '_static',
+                                                                              'async_input_arg' : 'const ${input_static_camelcase} *input' })
+
+            template += (
+                '${output_camelcase} *\n'
+                '${underscore}_${message_underscore}_sync (\n'
+                '    ${camelcase} *self,\n'
+                '    ${input_arg},\n'
+                '    guint timeout,\n'
+                '    GCancellable *cancellable,\n'
+                '    GError **error)\n'
+                '{\n'
+                '    QmiMessage *request;\n'
+                '    QmiMessage *reply;\n'
+                '    ${output_camelcase} *output;\n')
+
+            if message.vendor is not None or message.priority is not None:
+                template += (
+                    '    QmiMessageContext *context;\n')
+
+            template += (
+                '\n'
+                '    if (!qmi_client_is_valid (QMI_CLIENT (self))) {\n'
+                '        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE, "client invalid");\n'
+                '        return NULL;\n'
+                '    }\n'
+                '\n'
+                '    request = __${message_fullname_underscore}_request_create (\n'
+                '                  qmi_client_get_next_transaction_id (QMI_CLIENT (self)),\n'
+                '                  qmi_client_get_cid (QMI_CLIENT (self)),\n'
+                '                  ${input_var},\n'
+                '                  error);\n'
+                '    if (!request) {\n'
+                '        g_prefix_error (error, "Couldn\'t create request message: ");\n'
+                '        return NULL;\n'
+                '    }\n')
+
+            if message.vendor is not None or message.priority is not None:
+                template += (
+                    '\n'
+                    '    context = qmi_message_context_new ();\n')
+                if message.vendor is not None:
+                    template += (
+                        '    qmi_message_context_set_vendor_id (context, ${message_vendor_id});\n')
+                if message.priority is not None:
+                    template += (
+                        '    qmi_message_context_set_priority (context, ${message_priority});\n')
+
+            template += (
+                '\n'
+                '    reply = qmi_device_command_full_sync (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),\n'
+                '                                          request,\n')
+
+            if message.vendor is not None or message.priority is not None:
+                template += (
+                    '                                          context,\n')
+            else:
+                template += (
+                    '                                          NULL,\n')
+
+            template += (
+                '                                          timeout,\n'
+                '                                          cancellable,\n'
+                '                                          error);\n'
+                '    qmi_message_unref (request);\n')
+
+            if message.vendor is not None or message.priority is not None:
                 template += (
                     '    qmi_message_context_unref (context);\n')
 
             template += (
+                '    if (!reply)\n'
+                '        return NULL;\n'
+                '\n'
+                '    /* Parse reply */\n'
+                '    output = __${message_fullname_underscore}_response_parse (reply, error);\n'
+                '    qmi_message_unref (reply);\n'
+                '    return output;\n'
+                '}\n'
+                '\n'
+                'void\n'
+                '${underscore}_${message_underscore}_no_reply (\n'
+                '    ${camelcase} *self,\n'
+                '    ${input_arg},\n'
+                '    guint timeout,\n'
+                '    GCancellable *cancellable)\n'
+                '{\n'
+                '    QmiMessage *request;\n'
+                '    GError *error = NULL;\n'
+                '\n'
+                '    /* Nobody waits for the result, so don\'t even keep track of it */\n'
+                '    if (!qmi_client_is_valid (QMI_CLIENT (self)))\n'
+                '        return;\n'
+                '\n'
+                '    request = __${message_fullname_underscore}_request_create (\n'
+                '                  qmi_client_get_next_transaction_id (QMI_CLIENT (self)),\n'
+                '                  qmi_client_get_cid (QMI_CLIENT (self)),\n'
+                '                  ${input_var},\n'
+                '                  &error);\n'
+                '    if (!request) {\n'
+                '        g_warning ("Couldn\'t create request message: %s", error->message);\n'
+                '        g_error_free (error);\n'
+                '        return;\n'
+                '    }\n'
+                '\n'
+                '    __qmi_client_command_no_reply (QMI_CLIENT (self),\n'
+                '                                   request,\n'
+                '                                   ${no_reply_vendor_id},\n'
+                '                                   ${no_reply_priority},\n'
+                '                                   timeout,\n'
+                '                                   cancellable);\n'
+                '    qmi_message_unref (request);\n'
                 '}\n'
                 '\n')
             cfile.write(string.Template(template).substitute(translations))
 
+            if message.reply_indication_message is not None:
+                self.__emit_reply_indication_methods(hfile, cfile, message, translations)
+
+
+    """
+    Emit the methods of requests whose actual reply is given in an indication,
+    completed once the indication with the same token is received
+    """
+    def __emit_reply_indication_methods(self, hfile, cfile, message, translations):
+        indication = message.reply_indication_message
+        translations['indication_name'] = indication.name
+        translations['indication_id'] = indication.id_enum_name
+        translations['indication_fullname_underscore'] = utils.build_underscore_name(indication.fullname)
+        translations['indication_output_camelcase'] = utils.build_camelcase_name(indication.output.fullname)
+        translations['indication_output_underscore'] = utils.build_underscore_name(indication.output.fullname)
+        translations['indication_signal'] = utils.build_dashed_name(indication.name)
+        translations['token_name'] = message.reply_indication
+        translations['token_underscore'] = utils.build_underscore_name(message.reply_indication)
+        translations['token_tlv'] = message.reply_token_tlv
+
+        template = (
+            '\n'
+            '/**\n'
+            ' * ${underscore}_${message_underscore}_with_indication:\n'
+            ' * @self: a #${camelcase}.\n'
+            ' * @input: a #${input_camelcase}.\n'
+            ' * @timeout: maximum time to wait for the response and for the indication, in seconds.\n'
+            ' * @cancellable: a #GCancellable or %NULL.\n'
+            ' * @callback: a #GAsyncReadyCallback to call when the request is satisfied.\n'
+            ' * @user_data: user data to pass to @callback.\n'
+            ' *\n'
+            ' * Asynchronously sends a ${message_name} request to the device, and waits for the ${indication_name} indication that gives the reply to it.\n'
+            ' *\n'
+            ' * The indication is matched with the request by the \'${token_name}\' field. If none is set in @input, a new one unique for the client is set in @input before sending the request.\n'
+            ' *\n'
+            ' * The indication is also emitted in the #${camelcase}::${indication_signal} signal, as any other one.\n'
+            ' *\n'
+            ' * When the operation is finished, @callback will be invoked in the thread-default main loop of the thread you are calling this method from.\n'
+            ' *\n'
+            ' * You can then call ${underscore}_${message_underscore}_with_indication_finish() to get the result of the operation.\n'
+            ' *\n'
+            ' * Since: 1.20\n'
+            ' */\n'
+            'void ${underscore}_${message_underscore}_with_indication (\n'
+            '    ${camelcase} *self,\n'
+            '    ${input_camelcase} *input,\n'
+            '    guint timeout,\n'
+            '    GCancellable *cancellable,\n'
+            '    GAsyncReadyCallback callback,\n'
+            '    gpointer user_data);\n'
+            '\n'
+            '/**\n'
+            ' * ${underscore}_${message_underscore}_with_indication_finish:\n'
+            ' * @self: a #${camelcase}.\n'
+            ' * @res: the #GAsyncResult obtained from the #GAsyncReadyCallback passed to ${underscore}_${message_underscore}_with_indication().\n'
+            ' * @error: Return location for error or %NULL.\n'
+            ' *\n'
+            ' * Finishes an async operation started with ${underscore}_${message_underscore}_with_indication().\n'
+            ' *\n'
+            ' * If the request fails, @error is set with the error given in the response, and no indication is waited for.\n'
+            ' *\n'
+            ' * Returns: a #${indication_output_camelcase}, or %NULL if @error is set. The returned value should be freed with ${indication_output_underscore}_unref().\n'
+            ' *\n'
+            ' * Since: 1.20\n'
+            ' */\n'
+            '${indication_output_camelcase} *${underscore}_${message_underscore}_with_indication_finish (\n'
+            '    ${camelcase} *self,\n'
+            '    GAsyncResult *res,\n'
+            '    GError **error);\n')
+        hfile.write(string.Template(template).substitute(translations))
+
+        template = (
+            '\n'
+            '${indication_output_camelcase} *\n'
+            '${underscore}_${message_underscore}_with_indication_finish (\n'
+            '    ${camelcase} *self,\n'
+            '    GAsyncResult *res,\n'
+            '    GError **error)\n'
+            '{\n'
+            '   return g_task_propagate_pointer (G_TASK (res), error);\n'
+            '}\n'
+            '\n'
+            'static void\n'
+            '${message_underscore}_with_indication_reply (\n'
+            '    QmiClient *self,\n'
+            '    QmiMessage *indication,\n'
+            '    GTask *task)\n'
+            '{\n'
+            '    GError *error = NULL;\n'
+            '    ${indication_output_camelcase} *output;\n'
+            '\n'
+            '    output = __${indication_fullname_underscore}_indication_parse (indication, &error);\n'
+            '    if (!output)\n'
+            '        g_task_return_error (task, error);\n'
+            '    else\n'
+            '        g_task_return_pointer (task,\n'
+            '                               output,\n'
+            '                               (GDestroyNotify)${indication_output_underscore}_unref);\n'
+            '}\n'
+            '\n'
+            'static void\n'
+            '${message_underscore}_with_indication_ready (\n'
+            '    QmiDevice *device,\n'
+            '    GAsyncResult *res,\n'
+            '    GTask *task)\n'
+            '{\n'
+            '    GError *error = NULL;\n'
+            '    QmiMessage *reply;\n'
+            '    ${output_camelcase} *output;\n'
+            '\n'
+            '    reply = qmi_device_command_full_finish (device, res, &error);\n'
+            '    if (reply) {\n'
+            '        output = __${message_fullname_underscore}_response_parse (reply, &error);\n'
+            '        if (output) {\n'
+            '            ${output_underscore}_get_result (output, &error);\n'
+            '            ${output_underscore}_unref (output);\n'
+            '        }\n'
+            '        qmi_message_unref (reply);\n'
+            '    }\n'
+            '\n'
+            '    /* On success, the operation is completed when the indication is received */\n'
+            '    if (error)\n'
+            '        __qmi_client_indication_reply_abort (QMI_CLIENT (g_task_get_source_object (task)),\n'
+            '                                             ${indication_id},\n'
+            '                                             GPOINTER_TO_UINT (g_task_get_task_data (task)),\n'
+            '                                             error);\n'
+            '    g_object_unref (task);\n'
+            '}\n'
+            '\n'
+            'void\n'
+            '${underscore}_${message_underscore}_with_indication (\n'
+            '    ${camelcase} *self,\n'
+            '    ${input_camelcase} *input,\n'
+            '    guint timeout,\n'
+            '    GCancellable *cancellable,\n'
+            '    GAsyncReadyCallback callback,\n'
+            '    gpointer user_data)\n'
+            '{\n'
+            '    GTask *task;\n'
+            '    QmiMessage *request;\n'
+            '    GError *error = NULL;\n'
+            '    guint32 token;\n')
+
+        if message.vendor is not None or message.priority is not None:
+            template += (
+                '    QmiMessageContext *context;\n')
+
+        template += (
+            '\n'
+            '    task = g_task_new (self, cancellable, callback, user_data);\n'
+            '    if (!qmi_client_is_valid (QMI_CLIENT (self))) {\n'
+            '        g_task_return_new_error (task, QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE, "client invalid");\n'
+            '        g_object_unref (task);\n'
+            '        return;\n'
+            '    }\n'
+            '\n'
+            '    if (!${input_underscore}_get_${token_underscore} (input, &token, NULL)) {\n'
+            '        token = __qmi_client_get_next_token (QMI_CLIENT (self));\n'
+            '        ${input_underscore}_set_${token_underscore} (input, token, NULL);\n'
+            '    }\n'
+            '    g_task_set_task_data (task, GUINT_TO_POINTER (token), NULL);\n'
+            '\n'
+            '    request = __${message_fullname_underscore}_request_create (\n'
+            '                  qmi_client_get_next_transaction_id (QMI_CLIENT (self)),\n'
+            '                  qmi_client_get_cid (QMI_CLIENT (self)),\n'
+            '                  input,\n'
+            '                  &error);\n'
+            '    if (!request) {\n'
+            '        g_prefix_error (&error, "Couldn\'t create request message: ");\n'
+            '        g_task_return_error (task, error);\n'
+            '        g_object_unref (task);\n'
+            '        return;\n'
+            '    }\n'
+            '\n'
+            '    /* The indication may be received even before the response, so start\n'
+            '     * waiting for it before sending the request */\n'
+            '    if (!__qmi_client_indication_reply_wait (QMI_CLIENT (self),\n'
+            '                                             ${indication_id},\n'
+            '                                             ${token_tlv},\n'
+            '                                             token,\n'
+            '                                             timeout,\n'
+            '                                             cancellable,\n'
+            '                                             ${message_underscore}_with_indication_reply,\n'
+            '                                             task)) {\n'
+            '        qmi_message_unref (request);\n'
+            '        g_object_unref (task);\n'
+            '        return;\n'
+            '    }\n')
+
+        if message.vendor is not None or message.priority is not None:
+            template += (
+                '\n'
+                '    context = qmi_message_context_new ();\n')
+            if message.vendor is not None:
+                template += (
+                    '    qmi_message_context_set_vendor_id (context, ${message_vendor_id});\n')
+            if message.priority is not None:
+                template += (
+                    '    qmi_message_context_set_priority (context, ${message_priority});\n')
+
+        template += (
+            '\n'
+            '    qmi_device_command_full (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),\n'
+            '                             request,\n')
+
+        if message.vendor is not None or message.priority is not None:
+            template += (
+                '                             context,\n')
+        else:
+            template += (
+                '                             NULL,\n')
+
+        template += (
+            '                             timeout,\n'
+            '                             cancellable,\n'
+            '                             (GAsyncReadyCallback)${message_underscore}_with_indication_ready,\n'
+            '                             task);\n'
+            '    qmi_message_unref (request);\n')
+
+        if message.vendor is not None or message.priority is not None:
+            template += (
+                '    qmi_message_context_unref (context);\n')
+
+        template += (
+            '}\n'
+            '\n')
+        cfile.write(string.Template(template).substitute(translations))
+
 
     """
     Emit the service-specific client implementation
@@ -34,7 +34,7 @@ class Container:
     """
     Constructor
     """
-    def __init__(self, prefix, container_type, dictionary, common_objects_dictionary, static, since):
+    def __init__(self, prefix, container_type, dictionary, common_objects_dictionary, static, since, lazy_parse = False):
         # The field container prefix usually contains the name of the Message,
         # e.g. "Qmi Message Ctl Something"
         self.prefix = prefix
@@ -103,6 +103,48 @@ class Container:
                     else:
                         self.fields.append(Field(self.fullname, field_dictionary, common_objects_dictionary, container_type, static))
 
+            # Flag which output fields may be decoded on demand: mandatory
+            # fields must be validated when parsing, and fields involved in
+            # prerequisites need to be available right away
+            if lazy_parse and self.readonly:
+                prerequisite_fields = []
+                for field in self.fields:
+                    for prerequisite in field.prerequisites:
+                        prerequisite_fields.append(utils.build_underscore_name(prerequisite['field']).lower())
+                for field in self.fields:
+                    if isinstance(field, FieldResult) or \
+                       field.mandatory or \
+                       field.prerequisites != [] or \
+                       field.variable is None or \
+                       utils.build_underscore_name(field.name).lower() in prerequisite_fields:
+                        continue
+                    field.lazy = True
+
+
+    """
+    Whether any of the fields is decoded on demand
+    """
+    def has_lazy_fields(self):
+        if self.fields is None:
+            return False
+        for field in self.fields:
+            if field.lazy:
+                return True
+        return False
+
+
+    """
+    Whether the container needs to keep a reference to the parsed message,
+    either to decode fields on demand or to keep views into its contents
+    """
+    def needs_message(self):
+        if self.fields is None:
+            return False
+        for field in self.fields:
+            if field.lazy or field.view:
+                return True
+        return False
+
 
     """
     Emit enumeration of TLVs in the container
@@ -148,6 +190,12 @@ class Container:
             '    volatile gint ref_count;\n')
         cfile.write(string.Template(template).substitute(translations))
 
+        if self.needs_message():
+            cfile.write(
+                '\n'
+                '    /* Message to decode fields from on demand, or viewed by fields */\n'
+                '    QmiMessage *message;\n')
+
         if self.fields is not None:
             for field in self.fields:
                 if field.variable is not None:
@@ -158,6 +206,18 @@ class Container:
                         '\n'
                         '    /* ${field_name} */\n'
                         '    gboolean ${field_variable_name}_set;\n')
+                    # Outputs are shared, so fields decoded or copied on
+                    # demand are guarded with g_once_init_enter()
+                    if field.lazy:
+                        template += (
+                            '    volatile gsize ${field_variable_name}_decoded;\n'
+                            '    gsize ${field_variable_name}_offset;\n')
+                    if field.view:
+                        template += (
+                            '    const gchar *${field_variable_name}_data;\n'
+                            '    guint16 ${field_variable_name}_len;\n'
+                            '    gboolean ${field_variable_name}_interned;\n'
+                            '    volatile gsize ${field_variable_name}_copied;\n')
                     cfile.write(string.Template(template).substitute(translations))
                     cfile.write(variable_declaration)
 
@@ -252,14 +312,46 @@ class Container:
         if self.fields is not None:
             for field in self.fields:
                 if field.variable is not None and field.variable.needs_dispose is True:
-                    template += field.variable.build_dispose('        ', 'self->' + field.variable_name)
+                    if field.view:
+                        # Interned strings are shared
+                        template += ('        if (!self->%s_interned)\n' % field.variable_name)
+                        template += field.variable.build_dispose('            ', 'self->' + field.variable_name)
+                    else:
+                        template += field.variable.build_dispose('        ', 'self->' + field.variable_name)
+
+        if self.needs_message():
+            template += (
+                '        if (self->message)\n'
+                '            qmi_message_unref (self->message);\n')
 
         template += (
             '        g_slice_free (${camelcase}, self);\n'
+            '        __qmi_utils_live_object_add (QMI_UTILS_LIVE_OBJECT_CONTAINER, -1);\n'
             '    }\n'
             '}\n')
         cfile.write(string.Template(template).substitute(translations))
 
+        # Hand-written helpers may walk the message of containers keeping it
+        if self.needs_message() and not self.static:
+            template = (
+                '\n'
+                '#if defined (LIBQMI_GLIB_COMPILATION)\n'
+                'G_GNUC_INTERNAL\n'
+                'QmiMessage *__${underscore}_peek_message (${camelcase} *self);\n'
+                '#endif\n')
+            hfile.write(string.Template(template).substitute(translations))
+
+            template = (
+                '\n'
+                'QmiMessage *\n'
+                '__${underscore}_peek_message (${camelcase} *self)\n'
+                '{\n'
+                '    g_return_val_if_fail (self != NULL, NULL);\n'
+                '\n'
+                '    return self->message;\n'
+                '}\n')
+            cfile.write(string.Template(template).substitute(translations))
+
         # _new() is only generated if the container is not readonly
         if self.readonly == True:
             return
@@ -273,6 +365,7 @@ class Container:
             '\n'
             '    self = g_slice_new0 (${camelcase});\n'
             '    self->ref_count = 1;\n'
+            '    __qmi_utils_live_object_add (QMI_UTILS_LIVE_OBJECT_CONTAINER, 1);\n'
             '    return self;\n'
             '}\n')
         cfile.write(string.Template(template).substitute(translations))
@@ -0,0 +1,309 @@
+#!/usr/bin/env python
+# -*- Mode: python; tab-width: 4; indent-tabs-mode: nil -*-
+#
+# This program is free software; you can redistribute it and/or modify it under
+# the terms of the GNU Lesser General Public License as published by the Free
+# Software Foundation; either version 2 of the License, or (at your option) any
+# later version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+# details.
+#
+# You should have received a copy of the GNU Lesser General Public License along
+# with this program; if not, write to the Free Software Foundation, Inc., 51
+# Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+# Copyright (C) 2026 agent <agent@local>
+#
+
+import string
+
+import utils
+from FieldResult      import FieldResult
+from VariableArray    import VariableArray
+from VariableSequence import VariableSequence
+
+# Names which cannot be used as C++ identifiers
+CXX_KEYWORDS = [ 'delete', 'register' ]
+
+# Names already used by the base classes of containers and clients
+CONTAINER_NAMES = [ 'get', 'release', 'reset', 'result_code', 'success' ]
+CLIENT_NAMES = [ 'get' ]
+
+"""
+Build a C++ identifier from the given name, not clashing with the reserved
+ones
+"""
+def build_cxx_name(name, reserved):
+    underscore = utils.build_underscore_name(name).replace('-', '_')
+    if underscore in CXX_KEYWORDS or underscore in reserved:
+        underscore += '_'
+    return underscore
+
+
+"""
+The CxxBinding class takes care of emitting the header-only C++ binding of a
+service, wrapping the C API generated for it
+"""
+class CxxBinding:
+
+    """
+    Constructor
+    """
+    def __init__(self, client, message_list):
+        self.client = client
+        self.message_list = message_list
+        self.namespace = client.service.lower()
+
+
+    """
+    Split the getter or setter parameters declared in C by a variable into
+    (type, name) tuples; getter ones are pointers and the pointed type is
+    given
+    """
+    @staticmethod
+    def __split_declaration(declaration, is_getter):
+        params = []
+        for line in declaration.splitlines():
+            line = line.strip().rstrip(',')
+            if line == '':
+                continue
+            if is_getter:
+                i = line.rindex('*')
+                params.append((line[:i].strip(), line[i + 1:].strip()))
+            else:
+                i = max(line.rfind(' '), line.rfind('*'))
+                params.append((line[:i + 1].strip(), line[i + 1:].strip()))
+        return params
+
+
+    """
+    List the element formats of the arrays of the given variable, in the same
+    order as they appear in its getter
+    """
+    @staticmethod
+    def __list_array_elements(variable):
+        if isinstance(variable, VariableArray):
+            return [ variable.array_element.public_format ]
+        if isinstance(variable, VariableSequence):
+            elements = []
+            for member in variable.members:
+                elements += CxxBinding.__list_array_elements(member['object'])
+            return elements
+        return []
+
+
+    """
+    Build the C++ type and the conversion from the C value for a getter
+    parameter, borrowing strings and arrays from the output
+    """
+    @staticmethod
+    def __build_cxx_value(ctype, name, array_elements):
+        if ctype == 'const gchar *':
+            return ('std::string_view', 'std::string_view (%s ? %s : "")' % (name, name))
+        if ctype == 'GArray *':
+            element = array_elements.pop(0)
+            return ('qmi::ArrayView<%s>' % element, 'qmi::ArrayView<%s> (%s)' % (element, name))
+        return (ctype, name)
+
+
+    """
+    Emit the owning handle of the input container of a message, with chained
+    setters
+    """
+    def __emit_input(self, f, message):
+        translations = { 'name'       : utils.build_camelcase_name(message.name) + 'Input',
+                         'camelcase'  : utils.build_camelcase_name(message.input.fullname),
+                         'underscore' : utils.build_underscore_name(message.input.fullname) }
+
+        template = (
+            'class ${name} : public qmi::Handle<${camelcase}, ${underscore}_unref> {\n'
+            'public:\n'
+            '    ${name} () : Handle (${underscore}_new ()) {}\n')
+        f.write(string.Template(template).substitute(translations))
+
+        for field in message.input.fields:
+            if field.static or not field.variable.visible:
+                continue
+
+            params = self.__split_declaration(field.variable.build_setter_declaration('', 'value_' + utils.build_underscore_name(field.name)), False)
+            translations['method'] = build_cxx_name(field.name, CONTAINER_NAMES)
+            translations['field_underscore'] = utils.build_underscore_name(field.name)
+            translations['params_dec'] = ', '.join(['%s %s' % (ctype, name) for (ctype, name) in params])
+            translations['params_use'] = ''.join(['%s, ' % name for (ctype, name) in params])
+
+            template = (
+                '\n'
+                '    ${name} &set_${method} (${params_dec}) {\n'
+                '        ${underscore}_set_${field_underscore} (get (), ${params_use}nullptr);\n'
+                '        return *this;\n'
+                '    }\n')
+            f.write(string.Template(template).substitute(translations))
+
+        f.write('};\n')
+
+
+    """
+    Emit the owning handle of the output container of a message, with getters
+    of optional values: strings and arrays are borrowed from the output
+    """
+    def __emit_output(self, f, message):
+        translations = { 'name'       : utils.build_camelcase_name(message.name) + 'Output',
+                         'camelcase'  : utils.build_camelcase_name(message.output.fullname),
+                         'underscore' : utils.build_underscore_name(message.output.fullname) }
+
+        template = (
+            'class ${name} : public qmi::Handle<${camelcase}, ${underscore}_unref> {\n'
+            'public:\n'
+            '    using Handle::Handle;\n'
+            '\n'
+            '    bool success (qmi::Error *error = nullptr) const {\n'
+            '        return ${underscore}_get_result (get (), error ? error->out () : nullptr);\n'
+            '    }\n'
+            '\n'
+            '    QmiProtocolError result_code () const {\n'
+            '        return ${underscore}_get_result_code (get ());\n'
+            '    }\n')
+        f.write(string.Template(template).substitute(translations))
+
+        for field in message.output.fields:
+            if isinstance(field, FieldResult) or field.static or not field.variable.visible:
+                continue
+
+            translations['method'] = build_cxx_name(field.name, CONTAINER_NAMES)
+            translations['field_underscore'] = utils.build_underscore_name(field.name)
+
+            # Strings in the TLV level are peeked without copying them
+            if field.view:
+                template = (
+                    '\n'
+                    '    std::optional<std::string_view> ${method} () const {\n'
+                    '        const gchar *value;\n'
+                    '        gsize        value_len;\n'
+                    '\n'
+                    '        if (!${underscore}_peek_${field_underscore} (get (), &value, &value_len, nullptr))\n'
+                    '            return std::nullopt;\n'
+                    '        return std::string_view (value, value_len);\n'
+                    '    }\n')
+                f.write(string.Template(template).substitute(translations))
+                continue
+
+            params = self.__split_declaration(field.variable.build_getter_declaration('', 'value_' + utils.build_underscore_name(field.name)), True)
+            array_elements = self.__list_array_elements(field.variable)
+            values = [ self.__build_cxx_value(ctype, name, array_elements) for (ctype, name) in params ]
+
+            if len(values) == 1:
+                translations['return_type'] = values[0][0]
+                translations['return_value'] = values[0][1]
+            else:
+                translations['return_type'] = 'std::tuple<%s>' % ', '.join([cxxtype for (cxxtype, conversion) in values])
+                translations['return_value'] = 'std::make_tuple (%s)' % ', '.join([conversion for (cxxtype, conversion) in values])
+            translations['locals'] = ''.join(['        %s %s;\n' % (ctype, name) for (ctype, name) in params])
+            translations['params_use'] = ''.join(['&%s, ' % name for (ctype, name) in params])
+
+            template = (
+                '\n'
+                '    std::optional<${return_type}> ${method} () const {\n'
+                '${locals}'
+                '\n'
+                '        if (!${underscore}_get_${field_underscore} (get (), ${params_use}nullptr))\n'
+                '            return std::nullopt;\n'
+                '        return ${return_value};\n'
+                '    }\n')
+            f.write(string.Template(template).substitute(translations))
+
+        f.write('};\n')
+
+
+    """
+    Emit the client wrapper, with one callback-based and one synchronous
+    method per request
+    """
+    def __emit_client(self, f, messages):
+        translations = { 'camelcase'  : utils.build_camelcase_name(self.client.name),
+                         'underscore' : utils.build_underscore_name(self.client.name) }
+
+        template = (
+            'class Client : public qmi::Object<${camelcase}> {\n'
+            'public:\n'
+            '    using Object::Object;\n')
+        f.write(string.Template(template).substitute(translations))
+
+        for message in messages:
+            translations['method'] = build_cxx_name(message.name, CLIENT_NAMES)
+            translations['method_sync'] = utils.build_underscore_name(message.name) + '_sync'
+            translations['message_underscore'] = utils.build_underscore_name(message.name)
+            translations['output'] = utils.build_camelcase_name(message.name) + 'Output'
+            translations['output_camelcase'] = utils.build_camelcase_name(message.output.fullname)
+            if message.input.fields is None:
+                translations['input_dec'] = ''
+                translations['input_use'] = 'nullptr'
+            else:
+                translations['input_dec'] = 'const %sInput &input, ' % utils.build_camelcase_name(message.name)
+                translations['input_use'] = 'input.get ()'
+
+            template = (
+                '\n'
+                '    template <typename F>\n'
+                '    void ${method} (${input_dec}guint timeout, GCancellable *cancellable, F callback) const {\n'
+                '        ${underscore}_${message_underscore} (get (), ${input_use}, timeout, cancellable,\n'
+                '            qmi::detail::ready<${output}, ${camelcase}, ${output_camelcase}, ${underscore}_${message_underscore}_finish, F>,\n'
+                '            qmi::detail::pack_callback (callback));\n'
+                '    }\n'
+                '\n'
+                '    qmi::Result<${output}> ${method_sync} (${input_dec}guint timeout, GCancellable *cancellable = nullptr) const {\n'
+                '        qmi::Error error;\n'
+                '        ${output_camelcase} *output;\n'
+                '\n'
+                '        output = ${underscore}_${message_underscore}_sync (get (), ${input_use}, timeout, cancellable, error.out ());\n'
+                '        if (!output)\n'
+                '            return qmi::Result<${output}> (std::move (error));\n'
+                '        return qmi::Result<${output}> (${output} (output));\n'
+                '    }\n')
+            f.write(string.Template(template).substitute(translations))
+
+        f.write('};\n')
+
+
+    """
+    Emit the whole binding of the service
+    """
+    def emit(self, f, output_name):
+        translations = { 'guard'     : '__LIBQMI_GLIB_CXX_' + output_name.replace('-', '_').upper() + '_HPP__',
+                         'namespace' : self.namespace }
+
+        template = (
+            '\n'
+            '#ifndef ${guard}\n'
+            '#define ${guard}\n'
+            '\n'
+            '#include "qmi-cxx.hpp"\n'
+            '\n'
+            'namespace qmi {\n'
+            'namespace ${namespace} {\n')
+        f.write(string.Template(template).substitute(translations))
+
+        messages = []
+        for message in self.message_list.list:
+            if message.type == 'Indication' or message.static:
+                continue
+            messages.append(message)
+
+            utils.add_separator(f, 'REQUEST/RESPONSE', message.fullname)
+            if message.input.fields is not None:
+                self.__emit_input(f, message)
+                f.write('\n')
+            self.__emit_output(f, message)
+
+        utils.add_separator(f, 'CLIENT', self.client.name)
+        self.__emit_client(f, messages)
+
+        template = (
+            '\n'
+            '} /* namespace ${namespace} */\n'
+            '} /* namespace qmi */\n'
+            '\n'
+            '#endif /* ${guard} */\n')
+        f.write(string.Template(template).substitute(translations))
@@ -49,6 +49,8 @@ class Field:
         self.container_type = container_type
         # Whether the whole field is internally used only
         self.static = static
+        # Whether the field is decoded on demand (output only, set by the container)
+        self.lazy = False
 
         # Create the composed full name (prefix + name),
         #  e.g. "Qmi Message Ctl Something Output Result"
@@ -65,6 +67,10 @@ class Field:
         # Create the variable name within the Container
         self.variable_name = 'arg_' + utils.build_underscore_name(self.name).lower()
 
+        # Output variables which support it are kept as views into the message,
+        # and only copied when requested through the standard getter
+        self.view = (self.container_type == 'Output' and self.variable.supports_view())
+
         # Create the ID enumeration name
         self.id_enum_name = utils.build_underscore_name(self.prefix + ' TLV ' + self.name).upper()
 
@@ -138,6 +144,10 @@ class Field:
             '    GError **error);\n')
         hfile.write(string.Template(template).substitute(translations))
 
+        # Emit the on-demand decoder, if needed
+        if self.lazy:
+            self.emit_output_tlv_lazy_decoder(cfile)
+
         # Emit the getter source
         template = (
             '\n'
@@ -148,7 +158,105 @@ class Field:
             '    GError **error)\n'
             '{\n'
             '    g_return_val_if_fail (self != NULL, FALSE);\n'
+            '\n')
+        if self.lazy:
+            template += (
+                '    if (g_once_init_enter (&self->${variable_name}_decoded)) {\n'
+                '        __${prefix_underscore}_decode_${underscore} (self);\n'
+                '        g_once_init_leave (&self->${variable_name}_decoded, 1);\n'
+                '    }\n'
+                '\n')
+        template += (
+            '    if (!self->${variable_name}_set) {\n'
+            '        g_set_error (error,\n'
+            '                     QMI_CORE_ERROR,\n'
+            '                     QMI_CORE_ERROR_TLV_NOT_FOUND,\n'
+            '                     "Field \'${name}\' was not found in the message");\n'
+            '        return FALSE;\n'
+            '    }\n'
+            '\n')
+        if self.view:
+            template += (
+                '    if (g_once_init_enter (&self->${variable_name}_copied)) {\n'
+                '        /* Shared copy if interning, never freed */\n'
+                '        self->${variable_name} = (gchar *) __qmi_utils_intern_string (self->${variable_name}_data, self->${variable_name}_len);\n'
+                '        self->${variable_name}_interned = !!self->${variable_name};\n'
+                '        if (!self->${variable_name})\n'
+                '            self->${variable_name} = g_strndup (self->${variable_name}_data, self->${variable_name}_len);\n'
+                '        g_once_init_leave (&self->${variable_name}_copied, 1);\n'
+                '    }\n')
+        template += (
+            '${variable_getter_imp}'
             '\n'
+            '    return TRUE;\n'
+            '}\n')
+        cfile.write(string.Template(template).substitute(translations))
+
+        if self.view and self.variable.visible:
+            self.__emit_peek_getter(hfile, cfile)
+
+
+    """
+    Emit the method responsible for getting a string TLV from the output
+    container without copying it
+    """
+    def __emit_peek_getter(self, hfile, cfile):
+        input_variable_name = 'value_' + utils.build_underscore_name(self.name)
+        translations = { 'name'                : self.name,
+                         'variable_name'       : self.variable_name,
+                         'input_variable_name' : input_variable_name,
+                         'underscore'          : utils.build_underscore_name(self.name),
+                         'prefix_camelcase'    : utils.build_camelcase_name(self.prefix),
+                         'prefix_underscore'   : utils.build_underscore_name(self.prefix),
+                         'static'              : 'static ' if self.static else '' }
+
+        # Emit the peek getter header
+        template = (
+            '\n'
+            '/**\n'
+            ' * ${prefix_underscore}_peek_${underscore}:\n'
+            ' * @self: a #${prefix_camelcase}.\n'
+            ' * @${input_variable_name}: a placeholder for the output constant string, or %NULL if not required.\n'
+            ' * @${input_variable_name}_len: a placeholder for the length of the output string, or %NULL if not required.\n'
+            ' * @error: Return location for error or %NULL.\n'
+            ' *\n'
+            ' * Get the \'${name}\' field from @self, without copying it.\n'
+            ' *\n'
+            ' * The returned string points to the contents of the original message, it\n'
+            ' * is valid as long as @self is, and it is NOT NUL-terminated: always use\n'
+            ' * the returned length with it.\n'
+            ' *\n'
+            ' * Returns: %TRUE if the field is found, %FALSE otherwise.\n'
+            ' *\n'
+            ' * Since: 1.20\n'
+            ' */\n'
+            '${static}gboolean ${prefix_underscore}_peek_${underscore} (\n'
+            '    ${prefix_camelcase} *self,\n'
+            '    const gchar **${input_variable_name},\n'
+            '    gsize *${input_variable_name}_len,\n'
+            '    GError **error);\n')
+        hfile.write(string.Template(template).substitute(translations))
+
+        # Emit the peek getter source
+        template = (
+            '\n'
+            '${static}gboolean\n'
+            '${prefix_underscore}_peek_${underscore} (\n'
+            '    ${prefix_camelcase} *self,\n'
+            '    const gchar **${input_variable_name},\n'
+            '    gsize *${input_variable_name}_len,\n'
+            '    GError **error)\n'
+            '{\n'
+            '    g_return_val_if_fail (self != NULL, FALSE);\n'
+            '\n')
+        if self.lazy:
+            template += (
+                '    if (g_once_init_enter (&self->${variable_name}_decoded)) {\n'
+                '        __${prefix_underscore}_decode_${underscore} (self);\n'
+                '        g_once_init_leave (&self->${variable_name}_decoded, 1);\n'
+                '    }\n'
+                '\n')
+        template += (
             '    if (!self->${variable_name}_set) {\n'
             '        g_set_error (error,\n'
             '                     QMI_CORE_ERROR,\n'
@@ -157,7 +265,10 @@ class Field:
             '        return FALSE;\n'
             '    }\n'
             '\n'
-            '${variable_getter_imp}'
+            '    if (${input_variable_name})\n'
+            '        *${input_variable_name} = self->${variable_name}_data;\n'
+            '    if (${input_variable_name}_len)\n'
+            '        *${input_variable_name}_len = self->${variable_name}_len;\n'
             '\n'
             '    return TRUE;\n'
             '}\n')
@@ -278,7 +389,7 @@ class Field:
     """
     Emit the code responsible for retrieving the TLV from the QMI message
     """
-    def emit_output_tlv_get(self, f, line_prefix):
+    def emit_output_tlv_get(self, f, line_prefix, use_tlv_index = False):
         tlv_out = utils.build_underscore_name (self.fullname) + '_out'
         error = 'error' if self.mandatory else 'NULL'
         translations = { 'name'                 : self.name,
@@ -292,8 +403,13 @@ class Field:
         template = (
             '${lp}gsize offset = 0;\n'
             '${lp}gsize init_offset;\n'
-            '\n'
-            '${lp}if ((init_offset = qmi_message_tlv_read_init (message, ${tlv_id}, NULL, ${error})) == 0) {\n')
+            '\n')
+        if use_tlv_index:
+            template += (
+                '${lp}if ((init_offset = __qmi_message_tlv_index_read_init (message, &tlv_index, ${tlv_id}, NULL, ${error})) == 0) {\n')
+        else:
+            template += (
+                '${lp}if ((init_offset = qmi_message_tlv_read_init (message, ${tlv_id}, NULL, ${error})) == 0) {\n')
 
         if self.mandatory:
             template += (
@@ -310,7 +426,7 @@ class Field:
         f.write(string.Template(template).substitute(translations))
 
         # Now, read the contents of the buffer into the variable
-        self.variable.emit_buffer_read(f, line_prefix, tlv_out, error, 'self->' + self.variable_name)
+        self.emit_output_variable_read(f, line_prefix, tlv_out, error)
 
         template = (
             '\n'
@@ -335,9 +451,83 @@ class Field:
 
 
     """
-    Emit the method responsible for creating a printable representation of the TLV
+    Emit the code reading the contents of the TLV into the output container
+    """
+    def emit_output_variable_read(self, f, line_prefix, tlv_out, error):
+        if self.view:
+            self.variable.emit_buffer_read_view(f, line_prefix, tlv_out, error, 'self->' + self.variable_name)
+        else:
+            self.variable.emit_buffer_read(f, line_prefix, tlv_out, error, 'self->' + self.variable_name)
+
+
+    """
+    Emit the method responsible for decoding the TLV from the QMI message kept
+    in the output container, the first time the field is requested
     """
-    def emit_tlv_helpers(self, f):
+    def emit_output_tlv_lazy_decoder(self, f):
+        tlv_out = utils.build_underscore_name (self.fullname) + '_out'
+        translations = { 'name'              : self.name,
+                         'underscore'        : utils.build_underscore_name(self.name),
+                         'prefix_camelcase'  : utils.build_camelcase_name(self.prefix),
+                         'prefix_underscore' : utils.build_underscore_name(self.prefix),
+                         'tlv_out'           : tlv_out,
+                         'tlv_id'            : self.id_enum_name,
+                         'variable_name'     : self.variable_name }
+
+        template = (
+            '\n'
+            'static void\n'
+            '__${prefix_underscore}_decode_${underscore} (${prefix_camelcase} *self)\n'
+            '{\n'
+            '    QmiMessage *message = self->message;\n'
+            '    gsize offset = 0;\n'
+            '    gsize init_offset;\n'
+            '\n'
+            '    if (!self->${variable_name}_offset ||\n'
+            '        (init_offset = __qmi_message_tlv_read_init_at (message, ${tlv_id}, self->${variable_name}_offset, NULL, NULL)) == 0)\n'
+            '        goto ${tlv_out};\n')
+        f.write(string.Template(template).substitute(translations))
+
+        # Now, read the contents of the buffer into the variable
+        self.emit_output_variable_read(f, '    ', tlv_out, 'NULL')
+
+        template = (
+            '\n'
+            '    /* The remaining size of the buffer needs to be 0 if we successfully read the TLV */\n'
+            '    if ((offset = __qmi_message_tlv_read_remaining_size (message, init_offset, offset)) > 0) {\n'
+            '        g_warning ("Left \'%" G_GSIZE_FORMAT "\' bytes unread when getting the \'${name}\' TLV", offset);\n'
+            '    }\n'
+            '\n'
+            '    self->${variable_name}_set = TRUE;\n'
+            '    return;\n'
+            '\n'
+            '${tlv_out}:\n'
+            '    /* Don\'t keep whatever was partially decoded */\n')
+        f.write(string.Template(template).substitute(translations))
+
+        if self.variable.needs_dispose:
+            f.write(self.variable.build_dispose('    ', 'self->' + self.variable_name))
+        for storage in self.__build_storage_names():
+            f.write('    memset (&self->%s, 0, sizeof (self->%s));\n' % (storage, storage))
+        f.write('}\n')
+
+
+    """
+    Names of the container members holding the value of the field; sequences
+    are stored in one member per sequence member
+    """
+    def __build_storage_names(self):
+        if self.variable.format == 'sequence':
+            return [self.variable_name + '_' + member['name'] for member in self.variable.members]
+        return [self.variable_name]
+
+
+    """
+    Emit the compact descriptor of the TLV, and unless printable representations
+    are built from the descriptors, the method responsible for creating a
+    printable representation of the TLV
+    """
+    def emit_tlv_helpers(self, f, compact = False):
         if TypeFactory.helpers_emitted(self.fullname):
             return
 
@@ -347,22 +537,28 @@ class Field:
                          'tlv_id'     : self.id_enum_name,
                          'underscore' : utils.build_underscore_name (self.fullname) }
 
+        descriptor_name = utils.build_underscore_name (self.fullname) + '_tlv_field'
+        items = self.variable.build_tlv_field(f, descriptor_name, None)
+        f.write('\n'
+                'static const QmiTlvField %s[] = {\n'
+                '%s'
+                '};\n' % (descriptor_name, items))
+        if compact:
+            return
+
         template = (
             '\n'
-            'static gchar *\n'
-            '${underscore}_get_printable (\n'
+            'static void\n'
+            '${underscore}_append_printable (\n'
             '    QmiMessage *message,\n'
-            '    const gchar *line_prefix)\n'
+            '    GString *printable)\n'
             '{\n'
             '    gsize offset = 0;\n'
             '    gsize init_offset;\n'
-            '    GString *printable;\n'
             '    GError *error = NULL;\n'
             '\n'
             '    if ((init_offset = qmi_message_tlv_read_init (message, ${tlv_id}, NULL, NULL)) == 0)\n'
-            '        return NULL;\n'
-            '\n'
-            '    printable = g_string_new ("");\n')
+            '        return;\n')
         f.write(string.Template(template).substitute(translations))
 
         # Now, read the contents of the buffer into the printable representation
@@ -374,9 +570,10 @@ class Field:
             '        g_string_append_printf (printable, "Additional unexpected \'%" G_GSIZE_FORMAT "\' bytes", offset);\n'
             '\n'
             'out:\n'
-            '    if (error)\n'
+            '    if (error) {\n'
             '        g_string_append_printf (printable, " ERROR: %s", error->message);\n'
-            '    return g_string_free (printable, FALSE);\n'
+            '        g_error_free (error);\n'
+            '    }\n'
             '}\n')
         f.write(string.Template(template).substitute(translations))
 
@@ -399,4 +596,7 @@ class Field:
         if self.container_type == 'Input':
             template += (
                 '${prefix_underscore}_set_${underscore}\n')
+        if self.view and self.variable.visible:
+            template += (
+                '${prefix_underscore}_peek_${underscore}\n')
         sections['public-methods'] += string.Template(template).substitute(translations)
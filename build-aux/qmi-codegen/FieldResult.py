@@ -106,12 +106,53 @@ class FieldResult(Field):
             '}\n')
         cfile.write(string.Template(template).substitute(translations))
 
+        # Emit the result code getter header
+        template = (
+            '\n'
+            '/**\n'
+            ' * ${prefix_underscore}_get_result_code:\n'
+            ' * @self: a ${prefix_camelcase}.\n'
+            ' *\n'
+            ' * Get the result code of the QMI operation, without building any #GError.\n'
+            ' *\n'
+            ' * Returns: %QMI_PROTOCOL_ERROR_NONE if the QMI operation succeeded, or the #QmiProtocolError reported otherwise.\n'
+            ' *\n'
+            ' * Since: 1.20\n'
+            ' */\n'
+            'QmiProtocolError ${prefix_underscore}_get_result_code (\n'
+            '    ${prefix_camelcase} *self);\n')
+        hfile.write(string.Template(template).substitute(translations))
+
+        # Emit the result code getter source
+        template = (
+            '\n'
+            'QmiProtocolError\n'
+            '${prefix_underscore}_get_result_code (\n'
+            '    ${prefix_camelcase} *self)\n'
+            '{\n'
+            '    g_return_val_if_fail (self != NULL, QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE);\n'
+            '\n'
+            '    if (!self->${variable_name}_set)\n'
+            '        return QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE;\n'
+            '\n'
+            '    if (self->${variable_name}.error_status == QMI_STATUS_SUCCESS)\n'
+            '        return QMI_PROTOCOL_ERROR_NONE;\n'
+            '\n'
+            '    /* A failure must never be mistaken for a success */\n'
+            '    if (self->${variable_name}.error_code == QMI_PROTOCOL_ERROR_NONE)\n'
+            '        return QMI_PROTOCOL_ERROR_INTERNAL;\n'
+            '\n'
+            '    return (QmiProtocolError) self->${variable_name}.error_code;\n'
+            '}\n')
+        cfile.write(string.Template(template).substitute(translations))
+
 
     """
-    Emit the method responsible for getting a printable representation of this
-    TLV field.
+    Emit the compact descriptor of this TLV field, and unless printable
+    representations are built from the descriptors, the method responsible for
+    getting a printable representation of it
     """
-    def emit_tlv_helpers(self, f):
+    def emit_tlv_helpers(self, f, compact = False):
         if TypeFactory.helpers_emitted(self.fullname):
             return
 
@@ -121,6 +162,15 @@ class FieldResult(Field):
                          'tlv_id'     : self.id_enum_name,
                          'underscore' : utils.build_underscore_name (self.fullname) }
 
+        template = (
+            '\n'
+            'static const QmiTlvField ${underscore}_tlv_field[] = {\n'
+            '    { QMI_TLV_FIELD_TYPE_RESULT, QMI_TLV_FIELD_FLAG_NONE, 0, QMI_ENDIAN_LITTLE, 0, 0, NULL, NULL, NULL, NULL },\n'
+            '};\n')
+        f.write(string.Template(template).substitute(translations))
+        if compact:
+            return
+
         template = (
             '\n'
             'static gboolean\n'
@@ -142,47 +192,41 @@ class FieldResult(Field):
 
         template = (
             '\n'
-            'static gchar *\n'
-            '${underscore}_get_printable (\n'
+            'static void\n'
+            '${underscore}_append_printable (\n'
             '    QmiMessage *self,\n'
-            '    const gchar *line_prefix)\n'
+            '    GString *printable)\n'
             '{\n'
             '    const guint8 *buffer;\n'
             '    guint16 buffer_len;\n'
+            '    guint16 error_status;\n'
+            '    guint16 error_code;\n'
             '\n'
             '    buffer = qmi_message_get_raw_tlv (self,\n'
             '                                      ${tlv_id},\n'
             '                                      &buffer_len);\n'
-            '    if (buffer) {\n'
-            '        GString *printable;\n'
-            '        guint16 error_status;\n'
-            '        guint16 error_code;\n'
-            '\n'
-            '        printable = g_string_new ("");\n'
-            '        qmi_utils_read_guint16_from_buffer (\n'
-            '            &buffer,\n'
-            '            &buffer_len,\n'
-            '            QMI_ENDIAN_LITTLE,\n'
-            '            &error_status);\n'
-            '        qmi_utils_read_guint16_from_buffer (\n'
-            '            &buffer,\n'
-            '            &buffer_len,\n'
-            '            QMI_ENDIAN_LITTLE,\n'
-            '            &error_code);\n'
-            '\n'
-            '        g_warn_if_fail (buffer_len == 0);\n'
-            '\n'
-            '        if (error_status == QMI_STATUS_SUCCESS)\n'
-            '            g_string_append (printable, "SUCCESS");\n'
-            '        else\n'
-            '            g_string_append_printf (printable,\n'
-            '                                    "FAILURE: %s",\n'
-            '                                    qmi_protocol_error_get_string ((QmiProtocolError) error_code));\n'
-            '\n'
-            '        return g_string_free (printable, FALSE);\n'
-            '    }\n'
+            '    if (!buffer)\n'
+            '        return;\n'
+            '\n'
+            '    qmi_utils_read_guint16_from_buffer (\n'
+            '        &buffer,\n'
+            '        &buffer_len,\n'
+            '        QMI_ENDIAN_LITTLE,\n'
+            '        &error_status);\n'
+            '    qmi_utils_read_guint16_from_buffer (\n'
+            '        &buffer,\n'
+            '        &buffer_len,\n'
+            '        QMI_ENDIAN_LITTLE,\n'
+            '        &error_code);\n'
+            '\n'
+            '    g_warn_if_fail (buffer_len == 0);\n'
             '\n'
-            '    return NULL;\n'
+            '    if (error_status == QMI_STATUS_SUCCESS)\n'
+            '        g_string_append (printable, "SUCCESS");\n'
+            '    else\n'
+            '        g_string_append_printf (printable,\n'
+            '                                "FAILURE: %s",\n'
+            '                                qmi_protocol_error_get_string ((QmiProtocolError) error_code));\n'
             '}\n')
         f.write(string.Template(template).substitute(translations))
 
@@ -197,7 +241,8 @@ class FieldResult(Field):
 
         # Public methods
         template = (
-            '${prefix_underscore}_get_${underscore}\n')
+            '${prefix_underscore}_get_${underscore}\n'
+            '${prefix_underscore}_get_${underscore}_code\n')
         if self.container_type == 'Input':
             template += (
                 '${prefix_underscore}_set_${underscore}\n')
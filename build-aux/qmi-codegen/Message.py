@@ -32,7 +32,7 @@ class Message:
     """
     Constructor
     """
-    def __init__(self, dictionary, common_objects_dictionary):
+    def __init__(self, dictionary, common_objects_dictionary, compact_printable = False):
         # The message service, e.g. "Ctl"
         self.service = dictionary['service']
         # The name of the specific message, e.g. "Something"
@@ -46,6 +46,10 @@ class Message:
         self.version_info = dictionary['version'].split('.') if 'version' in dictionary else []
         self.static = True if 'scope' in dictionary and dictionary['scope'] == 'library-only' else False
         self.abort = True if 'abort' in dictionary and dictionary['abort'] == 'yes' else False
+        # Whether output fields should be decoded on demand, optional
+        self.lazy_parse = True if 'lazy-parse' in dictionary and dictionary['lazy-parse'] == 'yes' else False
+        # Whether printable representations are built from compact descriptors
+        self.compact_printable = compact_printable
 
         # libqmi version where the message was introduced
         self.since = dictionary['since'] if 'since' in dictionary else None
@@ -57,6 +61,53 @@ class Message:
         if self.type == 'Indication' and self.vendor is not None:
             raise ValueError('Vendor-specific indications unsupported')
 
+        # The priority of the request when queued in the device, optional
+        self.priority = dictionary['priority'] if 'priority' in dictionary else None
+        if self.priority is not None:
+            if self.type == 'Indication':
+                raise ValueError('Indications cannot have a priority')
+            if self.priority not in [ 'high', 'low' ]:
+                raise ValueError('Message ' + self.name + ' has an invalid priority: ' + self.priority)
+
+        # Whether the request only reads state, so that identical requests in
+        # flight at the same time may be coalesced, optional
+        self.idempotent = True if 'idempotent' in dictionary and dictionary['idempotent'] == 'yes' else False
+        if self.idempotent and self.type == 'Indication':
+            raise ValueError('Indications cannot be idempotent')
+
+        # Whether a stack-allocatable input struct, with borrowed values, is
+        # also given to build the request, optional
+        self.static_input = True if 'static-input' in dictionary and dictionary['static-input'] == 'yes' else False
+        if self.static_input:
+            if self.type == 'Indication':
+                raise ValueError('Indications cannot have a static input')
+            if self.static:
+                raise ValueError('Message ' + self.name + ' is static and cannot have a static input')
+            if 'input' not in dictionary:
+                raise ValueError('Message ' + self.name + ' has no input fields to give in a static input')
+
+        # How long, in seconds, the response may be cached and given to
+        # identical requests, optional
+        self.cache_ttl = int(dictionary['cache-ttl']) if 'cache-ttl' in dictionary else 0
+        if self.cache_ttl != 0:
+            if self.type == 'Indication':
+                raise ValueError('Indications cannot be cached')
+            if self.cache_ttl < 0:
+                raise ValueError('Message ' + self.name + ' has an invalid cache TTL: ' + dictionary['cache-ttl'])
+
+        # The name of the token field echoed in the indication with the same
+        # id that gives the actual reply to the request, optional; linked to
+        # the indication once all the messages are known
+        self.reply_indication = dictionary['reply-indication'] if 'reply-indication' in dictionary else None
+        self.reply_indication_message = None
+        self.reply_token_field = None
+        self.reply_token_tlv = None
+        if self.reply_indication is not None:
+            if self.type == 'Indication':
+                raise ValueError('Indications cannot be replied in another indication')
+            if self.static:
+                raise ValueError('Message ' + self.name + ' is static and cannot be replied in an indication')
+
         # The message prefix
         self.prefix = 'Qmi ' + self.type
 
@@ -77,7 +128,8 @@ class Message:
                                 dictionary['output'] if 'output' in dictionary else None,
                                 common_objects_dictionary,
                                 self.static,
-                                self.since)
+                                self.since,
+                                self.lazy_parse)
 
         self.input = None
         if self.type == 'Message':
@@ -92,35 +144,155 @@ class Message:
                                    self.static,
                                    self.since)
 
+        # Whether the TLVs with a fixed layout may also be decoded into a
+        # plain struct owned by the caller, optional
+        self.parse_into = True if 'parse-into' in dictionary and dictionary['parse-into'] == 'yes' else False
+        self.parse_into_fields = []
+        if self.parse_into:
+            if self.static:
+                raise ValueError('Message ' + self.name + ' is static and cannot be parsed into a struct')
+            if self.output.fields is not None:
+                for field in self.output.fields:
+                    if field.name == 'Result' or field.variable.fixed_layout_size() is None:
+                        continue
+                    # Only the prerequisite on the operation result is supported,
+                    # as it is already checked before decoding anything
+                    for prerequisite in field.prerequisites:
+                        if prerequisite['field'] != 'Result.Error Status' or prerequisite['operation'] != '==' or prerequisite['value'] != 'QMI_STATUS_SUCCESS':
+                            raise ValueError('Message ' + self.name + ' has unsupported prerequisites to be parsed into a struct')
+                    self.parse_into_fields.append(field)
+            if self.parse_into_fields == []:
+                raise ValueError('Message ' + self.name + ' has no fixed layout fields to be parsed into a struct')
+            if len(self.parse_into_fields) > 64:
+                raise ValueError('Message ' + self.name + ' has too many fields to be parsed into a struct')
+
+
+    """
+    Find the indication giving the reply to the request, and the token field
+    that correlates both
+    """
+    def link_reply_indication(self, message_list):
+        if self.reply_indication is None:
+            return
+
+        for message in message_list:
+            if message.type == 'Indication' and int(message.id, 0) == int(self.id, 0):
+                self.reply_indication_message = message
+                break
+        if self.reply_indication_message is None:
+            raise ValueError('Message ' + self.name + ' has no indication with the same id to be replied in')
+
+        input_token = None
+        if self.input.fields is not None:
+            for field in self.input.fields:
+                if field.name == self.reply_indication:
+                    input_token = field
+        indication_token = None
+        if self.reply_indication_message.output.fields is not None:
+            for field in self.reply_indication_message.output.fields:
+                if field.name == self.reply_indication:
+                    indication_token = field
+        if input_token is None or indication_token is None:
+            raise ValueError('Message ' + self.name + ' needs a \'' + self.reply_indication + '\' field in both the input and the indication')
+        if int(input_token.id, 0) != int(indication_token.id, 0):
+            raise ValueError('Message ' + self.name + ' has the \'' + self.reply_indication + '\' field in different TLVs in the input and the indication')
+        for field in [ input_token, indication_token ]:
+            if field.variable.private_format != 'guint32' or field.variable.public_format != 'guint32':
+                raise ValueError('Message ' + self.name + ' needs a guint32 \'' + self.reply_indication + '\' field')
+
+        if self.output.fields is None or not any(field.name == 'Result' for field in self.output.fields):
+            raise ValueError('Message ' + self.name + ' needs a result in the response to be replied in an indication')
+
+        self.reply_token_field = input_token
+        self.reply_token_tlv = input_token.id
+
 
     """
     Emit method responsible for creating a new request of the given type
     """
-    def __emit_request_creator(self, hfile, cfile):
+    def __emit_request_creator(self, hfile, cfile, static_input = False):
         translations = { 'name'       : self.name,
                          'service'    : self.service,
                          'container'  : utils.build_camelcase_name (self.input.fullname),
                          'underscore' : utils.build_underscore_name (self.fullname),
+                         'suffix'     : '_static' if static_input else '',
                          'message_id' : self.id_enum_name }
 
-        input_arg_template = 'gpointer unused' if self.input.fields is None else '${container} *input'
+        if self.input.fields is None:
+            input_arg_template = 'gpointer unused'
+        elif static_input:
+            # Same field names as in the input container, so the TLV builders
+            # below apply to both
+            input_arg_template = 'const ${container}Static *input'
+        else:
+            input_arg_template = '${container} *input'
+
+        if self.input.fields is None:
+            # Requests without TLVs are always the same except for the client
+            # and transaction IDs, so keep them already serialized
+            if self.service == 'CTL':
+                translations['qmux_length'] = '0x0B'
+                translations['transaction_bytes'] = '0x00'
+            else:
+                translations['qmux_length'] = '0x0C'
+                translations['transaction_bytes'] = '0x00, 0x00'
+            template = (
+                '\n'
+                '/* QMUX marker, QMUX header and QMI header, with no TLVs */\n'
+                'static const guint8 ${underscore}_request_template[] = {\n'
+                '    0x01, ${qmux_length}, 0x00, 0x00, QMI_SERVICE_${service}, 0x00,\n'
+                '    0x00, ${transaction_bytes},\n'
+                '    (guint8)(${message_id} & 0xFF), (guint8)(${message_id} >> 8),\n'
+                '    0x00, 0x00\n'
+                '};\n')
+            cfile.write(string.Template(template).substitute(translations))
+
         template = (
             '\n'
             'static QmiMessage *\n'
-            '__${underscore}_request_create (\n'
+            '__${underscore}_request_create${suffix} (\n'
             '    guint16 transaction_id,\n'
             '    guint8 cid,\n'
             '    %s,\n'
             '    GError **error)\n'
             '{\n'
-            '    QmiMessage *self;\n'
-            '\n'
-            '    self = qmi_message_new (QMI_SERVICE_${service},\n'
-            '                            cid,\n'
-            '                            transaction_id,\n'
-            '                            ${message_id});\n' % input_arg_template)
+            '    QmiMessage *self;\n' % input_arg_template)
         cfile.write(string.Template(template).substitute(translations))
 
+        if self.input.fields is None:
+            template = (
+                '\n'
+                '    self = __qmi_message_new_from_template (${underscore}_request_template,\n'
+                '                                            sizeof (${underscore}_request_template),\n'
+                '                                            cid,\n'
+                '                                            transaction_id);\n')
+            cfile.write(string.Template(template).substitute(translations))
+        else:
+            # Allocate the whole message at once; each TLV takes the type and
+            # length header (3 bytes) plus its value
+            cfile.write(
+                '    gsize tlvs_size = 0;\n'
+                '\n'
+                '    /* Compute the size of all the TLVs to add, so that the message is\n'
+                '     * allocated once */\n'
+                '    if (input) {\n')
+            for field in self.input.fields:
+                translations['variable_name'] = field.variable_name
+                translations['size_hint'] = field.variable.build_size_hint('input->' + field.variable_name)[0]
+                template = (
+                    '        if (input->${variable_name}_set)\n'
+                    '            tlvs_size += 3 + ${size_hint};\n')
+                cfile.write(string.Template(template).substitute(translations))
+            template = (
+                '    }\n'
+                '\n'
+                '    self = __qmi_message_new_sized (QMI_SERVICE_${service},\n'
+                '                                    cid,\n'
+                '                                    transaction_id,\n'
+                '                                    ${message_id},\n'
+                '                                    tlvs_size);\n')
+            cfile.write(string.Template(template).substitute(translations))
+
         if self.input.fields is not None:
             # Count how many mandatory fields we have
             n_mandatory = 0
@@ -189,6 +361,143 @@ class Message:
             '}\n')
 
 
+    """
+    Emit the public struct to give the input fields of the request without
+    allocating an input container
+    """
+    def __emit_static_input_type(self, hfile, cfile):
+        translations = { 'camelcase' : utils.build_camelcase_name (self.input.fullname + ' Static'),
+                         'container' : utils.build_camelcase_name (self.input.fullname),
+                         'request'   : self.service + ' ' + self.name }
+
+        template = (
+            '\n'
+            '/**\n'
+            ' * ${camelcase}:\n'
+            ' *\n'
+            ' * Input fields of the ${request} request, to be given in a struct that may be\n'
+            ' * allocated in the stack instead of in a #${container}.\n'
+            ' *\n'
+            ' * The struct should be zero-initialized, and then each field to include in the\n'
+            ' * request set along with its \'_set\' flag. Strings and arrays are borrowed: they\n'
+            ' * are copied into the request message while it is built, and never freed. The\n'
+            ' * fields of enum and flags types are given in the integer type of the TLV.\n'
+            ' *\n'
+            ' * Since: 1.20\n'
+            ' */\n'
+            'typedef struct {\n')
+        hfile.write(string.Template(template).substitute(translations))
+        for field in self.input.fields:
+            if field != self.input.fields[0]:
+                hfile.write('\n')
+            translations['variable_name'] = field.variable_name
+            translations['field_name'] = field.name
+            template = (
+                '    /* ${field_name} */\n'
+                '    gboolean ${variable_name}_set;\n')
+            hfile.write(string.Template(template).substitute(translations))
+            hfile.write(field.variable.build_variable_declaration(False, '    ', field.variable_name))
+        hfile.write(string.Template('} ${camelcase};\n').substitute(translations))
+
+
+    """
+    Emit the compact descriptors of the TLVs of the request/response, and the
+    method giving the ones of a given message. The descriptors are always
+    built, as they're also used for the JSON representation of messages.
+    """
+    def __emit_tlv_descriptors(self, hfile, cfile):
+        translations = { 'name'       : self.name,
+                         'service'    : self.service,
+                         'id'         : self.id,
+                         'type'       : utils.build_underscore_name(self.type),
+                         'underscore' : utils.build_underscore_name(self.name) }
+
+        need_tlv_printable = False
+        for container, container_name in ((self.input, 'input'), (self.output, 'output')):
+            translations[container_name + '_tlvs'] = 'NULL'
+            translations['n_' + container_name + '_tlvs'] = '0'
+            if container is None or container.fields is None:
+                continue
+
+            need_tlv_printable = True
+            for field in container.fields:
+                field.emit_tlv_helpers(cfile, self.compact_printable)
+
+            translations['container'] = container_name
+            template = (
+                '\n'
+                'static const QmiTlvDescriptor ${type}_${underscore}_${container}_tlvs[] = {\n')
+            for field in container.fields:
+                translations['underscore_field'] = utils.build_underscore_name(field.fullname)
+                translations['field_enum'] = field.id_enum_name
+                translations['field_name'] = field.name
+                field_template = (
+                    '    { ${field_enum}, "${field_name}", ${underscore_field}_tlv_field },\n')
+                template += string.Template(field_template).substitute(translations)
+            template += (
+                '};\n')
+            cfile.write(string.Template(template).substitute(translations))
+
+            translations[container_name + '_tlvs'] = string.Template('${type}_${underscore}_${container}_tlvs').substitute(translations)
+            translations['n_' + container_name + '_tlvs'] = 'G_N_ELEMENTS (%s)' % translations[container_name + '_tlvs']
+
+        template = (
+            '\n'
+            'static const QmiTlvDescriptor *\n'
+            '${type}_${underscore}_get_tlv_descriptors (\n'
+            '    QmiMessage *self,\n'
+            '    guint *n_tlvs)\n'
+            '{\n')
+        if self.type == 'Message':
+            template += (
+                '    if (!qmi_message_is_response (self)) {\n'
+                '        *n_tlvs = ${n_input_tlvs};\n'
+                '        return ${input_tlvs};\n'
+                '    }\n'
+                '\n')
+        template += (
+            '    *n_tlvs = ${n_output_tlvs};\n'
+            '    return ${output_tlvs};\n'
+            '}\n')
+        cfile.write(string.Template(template).substitute(translations))
+
+        return (translations, need_tlv_printable)
+
+
+    """
+    Emit method responsible for getting a printable representation of the whole
+    request/response, using the compact descriptors of each TLV
+    """
+    def __emit_compact_helpers(self, hfile, cfile, translations, need_tlv_printable):
+        template = (
+            '\n'
+            'static void\n'
+            '${type}_${underscore}_append_printable (\n'
+            '    QmiMessage *self,\n'
+            '    const gchar *line_prefix,\n'
+            '    GString *printable)\n'
+            '{\n'
+            '    g_string_append_printf (printable,\n'
+            '                            "%s  message     = \\\"${name}\\\" (${id})\\n",\n'
+            '                            line_prefix);\n')
+
+        if need_tlv_printable:
+            template += '\n'
+            if self.type == 'Message':
+                template += (
+                    '    if (!qmi_message_is_response (self))\n'
+                    '        __qmi_message_append_tlvs_printable (self, line_prefix, ${input_tlvs}, ${n_input_tlvs}, printable);\n'
+                    '    else\n'
+                    '        __qmi_message_append_tlvs_printable (self, line_prefix, ${output_tlvs}, ${n_output_tlvs}, printable);\n')
+            else:
+                template += (
+                    '    __qmi_message_append_tlvs_printable (self, line_prefix, ${output_tlvs}, ${n_output_tlvs}, printable);\n')
+
+        template += (
+            '}\n')
+        cfile.write(string.Template(template).substitute(translations))
+
+
     """
     Emit method responsible for parsing a response/indication of the given type
     """
@@ -204,6 +513,14 @@ class Message:
                          'underscore'           : utils.build_underscore_name (self.fullname),
                          'message_id'           : self.id_enum_name }
 
+        # When looking up several TLVs, index them all in one single pass
+        # instead of scanning the message once per field
+        n_eager = 0
+        for field in self.output.fields:
+            if not field.lazy:
+                n_eager += 1
+        use_tlv_index = (n_eager > 2 or self.output.has_lazy_fields())
+
         template = (
             '\n'
             'static ${container} *\n'
@@ -211,15 +528,27 @@ class Message:
             '    QmiMessage *message,\n'
             '    GError **error)\n'
             '{\n'
-            '    ${container} *self;\n'
+            '    ${container} *self;\n')
+        if use_tlv_index:
+            template += (
+                '    QmiMessageTlvIndex tlv_index;\n')
+        template += (
             '\n'
             '    g_return_val_if_fail (qmi_message_get_message_id (message) == ${message_id}, NULL);\n'
             '\n'
             '    self = g_slice_new0 (${container});\n'
-            '    self->ref_count = 1;\n')
+            '    self->ref_count = 1;\n'
+            '    __qmi_utils_live_object_add (QMI_UTILS_LIVE_OBJECT_CONTAINER, 1);\n')
+        if use_tlv_index:
+            template += (
+                '\n'
+                '    __qmi_message_tlv_index_build (message, &tlv_index);\n')
         cfile.write(string.Template(template).substitute(translations))
 
         for field in self.output.fields:
+            # Lazy fields are decoded on demand by the getters
+            if field.lazy:
+                continue
             cfile.write(
                 '\n'
                 '    do {\n')
@@ -227,12 +556,28 @@ class Message:
             cfile.write(
                 '\n'
                 '        {\n')
-            field.emit_output_tlv_get(cfile, '            ')
+            field.emit_output_tlv_get(cfile, '            ', use_tlv_index)
             cfile.write(
                 '\n'
                 '        }\n')
             cfile.write(
                 '    } while (0);\n')
+
+        if self.output.needs_message():
+            # Keep the message around, and record where each lazy TLV is
+            template = (
+                '\n'
+                '    /* Fields decoded on demand or viewed in the message */\n'
+                '    self->message = qmi_message_ref (message);\n')
+            for field in self.output.fields:
+                if not field.lazy:
+                    continue
+                translations['tlv_id'] = field.id_enum_name
+                translations['variable_name'] = field.variable_name
+                template += string.Template(
+                    '    self->${variable_name}_offset = tlv_index.offset[${tlv_id}];\n').substitute(translations)
+            cfile.write(template)
+
         cfile.write(
             '\n'
             '    return self;\n'
@@ -240,27 +585,257 @@ class Message:
 
 
     """
-    Emit method responsible for getting a printable representation of the whole
-    request/response
+    Emit the public struct with the output fields of fixed layout, and the
+    method decoding them into it without allocating an output container
     """
-    def __emit_helpers(self, hfile, cfile):
-        need_tlv_printable = False
-        if self.input is not None and self.input.fields is not None:
-            need_tlv_printable = True
-            for field in self.input.fields:
-                field.emit_tlv_helpers(cfile)
+    def __emit_parse_into(self, hfile, cfile):
+        translations = { 'name'       : self.name,
+                         'type'       : 'response' if self.type == 'Message' else 'indication',
+                         'message'    : self.service + ' ' + self.name,
+                         'struct'     : utils.build_camelcase_name (self.output.fullname + ' Struct'),
+                         'underscore' : utils.build_underscore_name (self.fullname),
+                         'field_macro_prefix' : utils.build_underscore_uppercase_name (self.output.fullname + ' Field'),
+                         'message_id' : self.id_enum_name,
+                         'n_fields'   : str(len(self.parse_into_fields)) }
 
-        if self.output is not None and self.output.fields is not None:
-            need_tlv_printable = True
-            for field in self.output.fields:
-                field.emit_tlv_helpers(cfile)
+        # Presence bits and struct
+        for i, field in enumerate(self.parse_into_fields):
+            translations['field_name'] = field.name
+            translations['field_macro'] = utils.build_underscore_uppercase_name (field.name)
+            translations['bit'] = str(i)
+            template = (
+                '\n'
+                '/**\n'
+                ' * ${field_macro_prefix}_${field_macro}:\n'
+                ' *\n'
+                ' * Bit set in the mask given by ${underscore}_${type}_parse_into() when the \'${field_name}\' field is given.\n'
+                ' *\n'
+                ' * Since: 1.20\n'
+                ' */\n'
+                '#define ${field_macro_prefix}_${field_macro} (G_GUINT64_CONSTANT (1) << ${bit})\n')
+            hfile.write(string.Template(template).substitute(translations))
 
-        translations = { 'name'       : self.name,
-                         'service'    : self.service,
-                         'id'         : self.id,
-                         'type'       : utils.build_underscore_name(self.type),
+        template = (
+            '\n'
+            '/**\n'
+            ' * ${struct}:\n'
+            ' *\n'
+            ' * Output fields of fixed layout of the ${message} ${type}, decoded with\n'
+            ' * ${underscore}_${type}_parse_into() into a plain struct owned by the\n'
+            ' * caller, which may be reused for every ${type}. Fields are given in the\n'
+            ' * same order and with the same names as in the output bundle; the ones of\n'
+            ' * enum and flags types are given in the integer type of the TLV.\n'
+            ' *\n'
+            ' * Since: 1.20\n'
+            ' */\n'
+            'typedef struct {\n')
+        hfile.write(string.Template(template).substitute(translations))
+        for field in self.parse_into_fields:
+            if field != self.parse_into_fields[0]:
+                hfile.write('\n')
+            hfile.write('    /* %s */\n' % field.name)
+            hfile.write(field.variable.build_variable_declaration(False, '    ', field.variable_name))
+        hfile.write(string.Template('} ${struct};\n').substitute(translations))
+
+        template = (
+            '\n'
+            '/**\n'
+            ' * ${underscore}_${type}_parse_into:\n'
+            ' * @message: a #QmiMessage with a ${message} ${type}.\n'
+            ' * @out: return location for the decoded fields.\n'
+            ' * @present_mask: (out) (optional): return location for the mask of ${field_macro_prefix}_* bits of the fields given in @message, or %NULL.\n'
+            ' * @error: Return location for error or %NULL.\n'
+            ' *\n'
+            ' * Decodes the fields of fixed layout of @message into @out, without allocating\n'
+            ' * any memory. Fields not given in @message are set to 0. Any other field is\n'
+            ' * only available in the output bundle.\n')
+        if self.type == 'Message':
+            template += (
+                ' *\n'
+                ' * If the operation reported a failure, @error is set with the #QmiProtocolError,\n'
+                ' * and only the fields given regardless of the result are decoded.\n')
+        template += (
+            ' *\n'
+            ' * Returns: %TRUE if @out is filled, %FALSE if @error is set.\n'
+            ' *\n'
+            ' * Since: 1.20\n'
+            ' */\n'
+            'gboolean ${underscore}_${type}_parse_into (\n'
+            '    QmiMessage *message,\n'
+            '    ${struct} *out,\n'
+            '    guint64 *present_mask,\n'
+            '    GError **error);\n')
+        hfile.write(string.Template(template).substitute(translations))
+
+        template = (
+            '\n'
+            'gboolean\n'
+            '${underscore}_${type}_parse_into (\n'
+            '    QmiMessage *message,\n'
+            '    ${struct} *out,\n'
+            '    guint64 *present_mask,\n'
+            '    GError **error)\n'
+            '{\n'
+            '    QmiMessageTlvIndex tlv_index;\n'
+            '    guint64 mask = 0;\n')
+        if self.type == 'Message':
+            template += (
+                '    QmiProtocolError result;\n')
+        template += (
+            '    gboolean success = FALSE;\n'
+            '\n'
+            '    g_return_val_if_fail (message != NULL, FALSE);\n'
+            '    g_return_val_if_fail (qmi_message_get_message_id (message) == ${message_id}, FALSE);\n'
+            '    g_return_val_if_fail (out != NULL, FALSE);\n'
+            '\n'
+            '    memset (out, 0, sizeof (${struct}));\n'
+            '    __qmi_message_tlv_index_build (message, &tlv_index);\n')
+        if self.type == 'Message':
+            template += (
+                '\n'
+                '    result = qmi_message_get_result_code (message);\n'
+                '    if (result == QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE) {\n'
+                '        g_set_error (error,\n'
+                '                     QMI_CORE_ERROR,\n'
+                '                     QMI_CORE_ERROR_INVALID_MESSAGE,\n'
+                '                     "No \'Result\' field given in the message");\n'
+                '        goto out;\n'
+                '    }\n')
+        cfile.write(string.Template(template).substitute(translations))
+
+        for i, field in enumerate(self.parse_into_fields):
+            translations['field_name'] = field.name
+            translations['field_macro'] = utils.build_underscore_uppercase_name (field.name)
+            translations['tlv_id'] = field.id_enum_name
+            translations['tlv_out'] = utils.build_underscore_name (field.fullname) + '_out'
+            translations['error'] = 'error' if field.mandatory else 'NULL'
+            translations['variable_name'] = field.variable_name
+
+            template = (
+                '\n'
+                '    /* ${field_name} */\n')
+            if field.prerequisites != []:
+                template += (
+                    '    if (result == QMI_PROTOCOL_ERROR_NONE) {\n')
+            else:
+                template += (
+                    '    {\n')
+            template += (
+                '        gsize offset = 0;\n'
+                '        gsize init_offset;\n'
+                '\n'
+                '        if ((init_offset = __qmi_message_tlv_index_read_init (message, &tlv_index, ${tlv_id}, NULL, ${error})) == 0)\n'
+                '            goto ${tlv_out};\n')
+            cfile.write(string.Template(template).substitute(translations))
+
+            field.variable.emit_buffer_read(cfile, '        ', translations['tlv_out'], translations['error'], 'out->' + field.variable_name)
+
+            template = (
+                '\n'
+                '        /* The remaining size of the buffer needs to be 0 if we successfully read the TLV */\n'
+                '        if ((offset = __qmi_message_tlv_read_remaining_size (message, init_offset, offset)) > 0) {\n'
+                '            g_warning ("Left \'%" G_GSIZE_FORMAT "\' bytes unread when getting the \'${field_name}\' TLV", offset);\n'
+                '        }\n'
+                '\n'
+                '        mask |= ${field_macro_prefix}_${field_macro};\n'
+                '\n'
+                '${tlv_out}:\n')
+            if field.mandatory:
+                template += (
+                    '        if (!(mask & ${field_macro_prefix}_${field_macro})) {\n'
+                    '            g_prefix_error (error, "Couldn\'t get the mandatory ${field_name} TLV: ");\n'
+                    '            goto out;\n'
+                    '        }\n')
+            else:
+                template += (
+                    '        ;\n')
+            template += (
+                '    }\n')
+            cfile.write(string.Template(template).substitute(translations))
+
+        if self.type == 'Message':
+            template = (
+                '\n'
+                '    if (result != QMI_PROTOCOL_ERROR_NONE) {\n'
+                '        g_set_error (error,\n'
+                '                     QMI_PROTOCOL_ERROR,\n'
+                '                     result,\n'
+                '                     "QMI protocol error (%u): \'%s\'",\n'
+                '                     result,\n'
+                '                     qmi_protocol_error_get_string (result));\n'
+                '        goto out;\n'
+                '    }\n')
+        else:
+            template = ''
+        template += (
+            '\n'
+            '    success = TRUE;\n'
+            '\n'
+            'out:\n'
+            '    if (present_mask)\n'
+            '        *present_mask = mask;\n'
+            '    return success;\n'
+            '}\n')
+        cfile.write(string.Template(template).substitute(translations))
+
+
+    """
+    Emit method responsible for checking whether a response/indication of the
+    given type can be parsed, used to validate messages of unknown origin
+    """
+    def __emit_parse_check(self, hfile, cfile):
+        translations = { 'type'       : utils.build_underscore_name(self.type),
                          'underscore' : utils.build_underscore_name(self.name) }
 
+        template = (
+            '\n'
+            'static gboolean\n'
+            '${type}_${underscore}_parse_check (\n'
+            '    QmiMessage *self,\n'
+            '    GError **error)\n'
+            '{\n')
+
+        # If no output fields to parse, there is nothing to validate
+        if self.output is None or self.output.fields is None:
+            template += (
+                '    return TRUE;\n'
+                '}\n')
+            cfile.write(string.Template(template).substitute(translations))
+            return
+
+        translations['container'] = utils.build_camelcase_name (self.output.fullname)
+        translations['container_underscore'] = utils.build_underscore_name (self.output.fullname)
+        translations['parser'] = '__' + utils.build_underscore_name (self.fullname) + ('_response_parse' if self.type == 'Message' else '_indication_parse')
+
+        template += (
+            '    ${container} *output;\n'
+            '\n')
+        if self.type == 'Message':
+            template += (
+                '    /* Requests are only parsed by the device */\n'
+                '    if (!qmi_message_is_response (self))\n'
+                '        return TRUE;\n'
+                '\n')
+        template += (
+            '    output = ${parser} (self, error);\n'
+            '    if (!output)\n'
+            '        return FALSE;\n'
+            '    ${container_underscore}_unref (output);\n'
+            '    return TRUE;\n'
+            '}\n')
+        cfile.write(string.Template(template).substitute(translations))
+
+
+    """
+    Emit method responsible for getting a printable representation of the whole
+    request/response
+    """
+    def __emit_helpers(self, hfile, cfile):
+        (translations, need_tlv_printable) = self.__emit_tlv_descriptors(hfile, cfile)
+        if self.compact_printable:
+            self.__emit_compact_helpers(hfile, cfile, translations, need_tlv_printable)
+            return
+
         template = ''
         if need_tlv_printable:
             template += (
@@ -279,7 +854,7 @@ class Message:
                 '    struct ${type}_${underscore}_context *ctx)\n'
                 '{\n'
                 '    const gchar *tlv_type_str = NULL;\n'
-                '    gchar *translated_value;\n'
+                '    QmiMessageTlvPrintableFn tlv_printable = NULL;\n'
                 '\n')
 
             if self.type == 'Message':
@@ -295,9 +870,7 @@ class Message:
                         field_template = (
                             '        case ${field_enum}:\n'
                             '            tlv_type_str = "${field_name}";\n'
-                            '            translated_value = ${underscore_field}_get_printable (\n'
-                            '                                   ctx->self,\n'
-                            '                                   ctx->line_prefix);\n'
+                            '            tlv_printable = ${underscore_field}_append_printable;\n'
                             '            break;\n')
                         template += string.Template(field_template).substitute(translations)
 
@@ -318,9 +891,7 @@ class Message:
                     field_template = (
                         '        case ${field_enum}:\n'
                         '            tlv_type_str = "${field_name}";\n'
-                        '            translated_value = ${underscore_field}_get_printable (\n'
-                        '                                   ctx->self,\n'
-                        '                                   ctx->line_prefix);\n'
+                        '            tlv_printable = ${underscore_field}_append_printable;\n'
                         '            break;\n')
                     template += string.Template(field_template).substitute(translations)
 
@@ -330,46 +901,24 @@ class Message:
                 '        }\n'
                 '    }\n'
                 '\n'
-                '    if (!tlv_type_str) {\n'
-                '        gchar *value_str = NULL;\n'
-                '\n'
-                '        value_str = qmi_message_get_tlv_printable (ctx->self,\n'
-                '                                                   ctx->line_prefix,\n'
-                '                                                   type,\n'
-                '                                                   value,\n'
-                '                                                   length);\n'
-                '        g_string_append (ctx->printable, value_str);\n'
-                '        g_free (value_str);\n'
-                '    } else {\n'
-                '        gchar *value_hex;\n'
-                '\n'
-                '        value_hex = __qmi_utils_str_hex (value, length, \':\');\n'
-                '        g_string_append_printf (ctx->printable,\n'
-                '                                "%sTLV:\\n"\n'
-                '                                "%s  type       = \\"%s\\" (0x%02x)\\n"\n'
-                '                                "%s  length     = %" G_GSIZE_FORMAT "\\n"\n'
-                '                                "%s  value      = %s\\n"\n'
-                '                                "%s  translated = %s\\n",\n'
-                '                                ctx->line_prefix,\n'
-                '                                ctx->line_prefix, tlv_type_str, type,\n'
-                '                                ctx->line_prefix, length,\n'
-                '                                ctx->line_prefix, value_hex,\n'
-                '                                ctx->line_prefix, translated_value ? translated_value : "");\n'
-                '        g_free (value_hex);\n'
-                '        g_free (translated_value);\n'
-                '    }\n'
+                '    __qmi_message_append_tlv_printable (ctx->self,\n'
+                '                                        ctx->line_prefix,\n'
+                '                                        type,\n'
+                '                                        tlv_type_str,\n'
+                '                                        value,\n'
+                '                                        length,\n'
+                '                                        tlv_printable,\n'
+                '                                        ctx->printable);\n'
                 '}\n')
 
         template += (
             '\n'
-            'static gchar *\n'
-            '${type}_${underscore}_get_printable (\n'
+            'static void\n'
+            '${type}_${underscore}_append_printable (\n'
             '    QmiMessage *self,\n'
-            '    const gchar *line_prefix)\n'
+            '    const gchar *line_prefix,\n'
+            '    GString *printable)\n'
             '{\n'
-            '    GString *printable;\n'
-            '\n'
-            '    printable = g_string_new ("");\n'
             '    g_string_append_printf (printable,\n'
             '                            "%s  message     = \\\"${name}\\\" (${id})\\n",\n'
             '                            line_prefix);\n')
@@ -387,8 +936,6 @@ class Message:
                 '                                     &ctx);\n'
                 '    }\n')
         template += (
-            '\n'
-            '    return g_string_free (printable, FALSE);\n'
             '}\n')
         cfile.write(string.Template(template).substitute(translations))
 
@@ -409,12 +956,18 @@ class Message:
             cfile.write('\n/* --- Input -- */\n');
             self.input.emit(hfile, cfile)
             self.__emit_request_creator(hfile, cfile)
+            if self.static_input:
+                self.__emit_static_input_type(hfile, cfile)
+                self.__emit_request_creator(hfile, cfile, True)
 
         hfile.write('\n/* --- Output -- */\n');
         cfile.write('\n/* --- Output -- */\n');
         self.output.emit(hfile, cfile)
         self.__emit_helpers(hfile, cfile)
         self.__emit_response_or_indication_parser(hfile, cfile)
+        if self.parse_into:
+            self.__emit_parse_into(hfile, cfile)
+        self.__emit_parse_check(hfile, cfile)
 
     """
     Emit the sections
@@ -438,13 +991,31 @@ class Message:
 
         if self.input:
             self.input.add_sections (sections)
+            if self.static_input:
+                sections['public-types'] += utils.build_camelcase_name (self.input.fullname + ' Static') + '\n'
         self.output.add_sections (sections)
+        if self.parse_into:
+            sections['public-types'] += utils.build_camelcase_name (self.output.fullname + ' Struct') + '\n'
+            for field in self.parse_into_fields:
+                sections['public-types'] += utils.build_underscore_uppercase_name (self.output.fullname + ' Field') + '_' + utils.build_underscore_uppercase_name (field.name) + '\n'
+            template = (
+                '<SUBSECTION ${camelcase}StructMethods>\n'
+                '${fullname_underscore}_${type}_parse_into\n')
+            sections['public-methods'] += string.Template(template).substitute(translations)
 
         if self.type == 'Message':
             template = (
                 '<SUBSECTION ${camelcase}ClientMethods>\n'
                 'qmi_client_${service}_${name_underscore}\n'
-                'qmi_client_${service}_${name_underscore}_finish\n')
+                'qmi_client_${service}_${name_underscore}_finish\n'
+                'qmi_client_${service}_${name_underscore}_sync\n'
+                'qmi_client_${service}_${name_underscore}_no_reply\n')
+            if self.static_input:
+                template += 'qmi_client_${service}_${name_underscore}_static\n'
+            if self.reply_indication_message is not None:
+                template += (
+                    'qmi_client_${service}_${name_underscore}_with_indication\n'
+                    'qmi_client_${service}_${name_underscore}_with_indication_finish\n')
             sections['public-methods'] += string.Template(template).substitute(translations)
             translations['message_type'] = 'request'
         elif self.type == 'Indication':
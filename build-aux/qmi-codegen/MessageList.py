@@ -33,7 +33,7 @@ class MessageList:
     """
     Constructor
     """
-    def __init__(self, objects_dictionary, common_objects_dictionary):
+    def __init__(self, objects_dictionary, common_objects_dictionary, compact_printable = False):
         self.list = []
         self.message_id_enum_name = None
         self.indication_id_enum_name = None
@@ -44,7 +44,7 @@ class MessageList:
         for object_dictionary in objects_dictionary:
             if object_dictionary['type'] == 'Message' or \
                object_dictionary['type'] == 'Indication':
-                message = Message(object_dictionary, common_objects_dictionary)
+                message = Message(object_dictionary, common_objects_dictionary, compact_printable)
                 self.list.append(message)
             elif object_dictionary['type'] == 'Message-ID-Enum':
                 self.message_id_enum_name = object_dictionary['name']
@@ -53,6 +53,10 @@ class MessageList:
             elif object_dictionary['type'] == 'Service':
                 self.service = object_dictionary['name']
 
+        # Requests replied in indications need all messages to be known
+        for message in self.list:
+            message.link_reply_indication(self.list)
+
         # We NEED the Message-ID-Enum field
         if self.message_id_enum_name is None:
             raise ValueError('Missing Message-ID-Enum field')
@@ -111,33 +115,14 @@ class MessageList:
 
 
     """
-    Emit the method responsible for getting a printable representation of all
-    messages of a given service.
+    Build the body of a method dispatching the given message to the code of its
+    specific type, which is built with the given template. Vendor-specific
+    messages are only looked up when the message context says so.
     """
-    def __emit_get_printable(self, hfile, cfile):
-        translations = { 'service'    : self.service.lower() }
-
-        template = (
-            '\n'
-            '#if defined (LIBQMI_GLIB_COMPILATION)\n'
-            '\n'
-            'G_GNUC_INTERNAL\n'
-            'gchar *__qmi_message_${service}_get_printable (\n'
-            '    QmiMessage *self,\n'
-            '    QmiMessageContext *context,\n'
-            '    const gchar *line_prefix);\n'
-            '\n'
-            '#endif\n'
-            '\n')
-        hfile.write(string.Template(template).substitute(translations))
+    def __build_message_dispatch(self, message_template, not_found):
+        translations = { 'not_found' : not_found }
 
         template = (
-            '\n'
-            'gchar *\n'
-            '__qmi_message_${service}_get_printable (\n'
-            '    QmiMessage *self,\n'
-            '    QmiMessageContext *context,\n'
-            '    const gchar *line_prefix)\n'
             '{\n'
             '    if (qmi_message_is_indication (self)) {\n'
             '        switch (qmi_message_get_message_id (self)) {\n')
@@ -145,15 +130,16 @@ class MessageList:
         for message in self.list:
             if message.type == 'Indication':
                 translations['enum_name'] = message.id_enum_name
-                translations['message_underscore'] = utils.build_underscore_name (message.name)
+                translations['message_name'] = message.name
+                translations['message_underscore'] = 'indication_' + utils.build_underscore_name (message.name)
                 inner_template = (
-                    '        case ${enum_name}:\n'
-                    '            return indication_${message_underscore}_get_printable (self, line_prefix);\n')
+                    '        case ${enum_name}:\n' +
+                    message_template.replace('${lp}', '            '))
                 template += string.Template(inner_template).substitute(translations)
 
         template += (
             '        default:\n'
-            '             return NULL;\n'
+            '             return ${not_found};\n'
             '        }\n'
             '    } else {\n'
             '        guint16 vendor_id;\n'
@@ -165,34 +151,131 @@ class MessageList:
         for message in self.list:
             if message.type == 'Message' and message.vendor is None:
                 translations['enum_name'] = message.id_enum_name
-                translations['message_underscore'] = utils.build_underscore_name (message.name)
+                translations['message_name'] = message.name
+                translations['message_underscore'] = 'message_' + utils.build_underscore_name (message.name)
                 inner_template = (
-                    '            case ${enum_name}:\n'
-                    '                return message_${message_underscore}_get_printable (self, line_prefix);\n')
+                    '            case ${enum_name}:\n' +
+                    message_template.replace('${lp}', '                '))
                 template += string.Template(inner_template).substitute(translations)
 
         template += (
             '             default:\n'
-            '                 return NULL;\n'
+            '                 return ${not_found};\n'
             '            }\n'
             '        } else {\n')
 
         for message in self.list:
             if message.type == 'Message' and message.vendor is not None:
                 translations['enum_name'] = message.id_enum_name
-                translations['message_underscore'] = utils.build_underscore_name (message.name)
+                translations['message_name'] = message.name
+                translations['message_underscore'] = 'message_' + utils.build_underscore_name (message.name)
                 translations['message_vendor'] = message.vendor
                 inner_template = (
-                    '            if (vendor_id == ${message_vendor} && (qmi_message_get_message_id (self) == ${enum_name}))\n'
-                    '                return message_${message_underscore}_get_printable (self, line_prefix);\n')
+                    '            if (vendor_id == ${message_vendor} && (qmi_message_get_message_id (self) == ${enum_name})) {\n' +
+                    message_template.replace('${lp}', '                ') +
+                    '            }\n')
                 template += string.Template(inner_template).substitute(translations)
 
         template += (
-            '            return NULL;\n'
+            '            return ${not_found};\n'
             '        }\n'
             '    }\n'
             '}\n')
+        return string.Template(template).substitute(translations)
+
+
+    """
+    Emit the method responsible for appending a printable representation of all
+    messages of a given service, the one giving the name of each message, the
+    one giving the compact descriptors of the TLVs of each message, and the one
+    running the parser of each message. Unknown messages are not validated.
+    """
+    def __emit_get_printable(self, hfile, cfile):
+        translations = { 'service'    : self.service.lower() }
+
+        template = (
+            '\n'
+            '#if defined (LIBQMI_GLIB_COMPILATION)\n'
+            '\n'
+            'G_GNUC_INTERNAL\n'
+            'gboolean __qmi_message_${service}_append_printable (\n'
+            '    QmiMessage *self,\n'
+            '    QmiMessageContext *context,\n'
+            '    const gchar *line_prefix,\n'
+            '    GString *printable);\n'
+            '\n'
+            'G_GNUC_INTERNAL\n'
+            'const gchar *__qmi_message_${service}_get_name (\n'
+            '    QmiMessage *self,\n'
+            '    QmiMessageContext *context);\n'
+            '\n'
+            'G_GNUC_INTERNAL\n'
+            'gboolean __qmi_message_${service}_get_tlv_descriptors (\n'
+            '    QmiMessage *self,\n'
+            '    QmiMessageContext *context,\n'
+            '    const QmiTlvDescriptor **tlvs,\n'
+            '    guint *n_tlvs);\n'
+            '\n'
+            'G_GNUC_INTERNAL\n'
+            'gboolean __qmi_message_${service}_parse_check (\n'
+            '    QmiMessage *self,\n'
+            '    QmiMessageContext *context,\n'
+            '    GError **error);\n'
+            '\n'
+            '#endif\n'
+            '\n')
+        hfile.write(string.Template(template).substitute(translations))
+
+        template = (
+            '\n'
+            'gboolean\n'
+            '__qmi_message_${service}_append_printable (\n'
+            '    QmiMessage *self,\n'
+            '    QmiMessageContext *context,\n'
+            '    const gchar *line_prefix,\n'
+            '    GString *printable)\n')
         cfile.write(string.Template(template).substitute(translations))
+        cfile.write(self.__build_message_dispatch(
+            '${lp}${message_underscore}_append_printable (self, line_prefix, printable);\n'
+            '${lp}return TRUE;\n',
+            'FALSE'))
+
+        template = (
+            '\n'
+            'const gchar *\n'
+            '__qmi_message_${service}_get_name (\n'
+            '    QmiMessage *self,\n'
+            '    QmiMessageContext *context)\n')
+        cfile.write(string.Template(template).substitute(translations))
+        cfile.write(self.__build_message_dispatch(
+            '${lp}return "${message_name}";\n',
+            'NULL'))
+
+        template = (
+            '\n'
+            'gboolean\n'
+            '__qmi_message_${service}_get_tlv_descriptors (\n'
+            '    QmiMessage *self,\n'
+            '    QmiMessageContext *context,\n'
+            '    const QmiTlvDescriptor **tlvs,\n'
+            '    guint *n_tlvs)\n')
+        cfile.write(string.Template(template).substitute(translations))
+        cfile.write(self.__build_message_dispatch(
+            '${lp}*tlvs = ${message_underscore}_get_tlv_descriptors (self, n_tlvs);\n'
+            '${lp}return TRUE;\n',
+            'FALSE'))
+
+        template = (
+            '\n'
+            'gboolean\n'
+            '__qmi_message_${service}_parse_check (\n'
+            '    QmiMessage *self,\n'
+            '    QmiMessageContext *context,\n'
+            '    GError **error)\n')
+        cfile.write(string.Template(template).substitute(translations))
+        cfile.write(self.__build_message_dispatch(
+            '${lp}return ${message_underscore}_parse_check (self, error);\n',
+            'TRUE'))
 
 
     """
@@ -275,6 +358,136 @@ class MessageList:
         cfile.write(string.Template(template).substitute(translations))
 
 
+    """
+    Emit the method telling whether a request is idempotent, i.e. whether it can
+    be answered with the response of an identical one already in flight. The
+    response must not depend on the client sending the request, as requests
+    from different clients (and processes, through the proxy) are matched.
+    """
+    def __emit_is_idempotent(self, hfile, cfile):
+        translations = { 'service'    : self.service.lower() }
+
+        template = (
+            '\n'
+            '#if defined (LIBQMI_GLIB_COMPILATION)\n'
+            '\n'
+            'G_GNUC_INTERNAL\n'
+            'gboolean __qmi_message_${service}_is_idempotent (\n'
+            '    QmiMessage *self,\n'
+            '    QmiMessageContext *context);\n'
+            '\n'
+            '#endif\n'
+            '\n')
+        hfile.write(string.Template(template).substitute(translations))
+
+        template = (
+            '\n'
+            'gboolean\n'
+            '__qmi_message_${service}_is_idempotent (\n'
+            '    QmiMessage *self,\n'
+            '    QmiMessageContext *context)\n'
+            '{\n'
+            '    guint16 vendor_id;\n'
+            '\n'
+            '    vendor_id = (context ? qmi_message_context_get_vendor_id (context) : QMI_MESSAGE_VENDOR_GENERIC);\n'
+            '    if (vendor_id == QMI_MESSAGE_VENDOR_GENERIC) {\n'
+            '        switch (qmi_message_get_message_id (self)) {\n')
+
+        for message in self.list:
+            if message.type == 'Message' and message.vendor is None and message.idempotent:
+                translations['enum_name'] = message.id_enum_name
+                inner_template = (
+                    '        case ${enum_name}:\n'
+                    '            return TRUE;\n')
+                template += string.Template(inner_template).substitute(translations)
+
+        template += (
+            '        default:\n'
+            '            return FALSE;\n'
+            '        }\n'
+            '    } else {\n')
+
+        for message in self.list:
+            if message.type == 'Message' and message.vendor is not None and message.idempotent:
+                translations['enum_name'] = message.id_enum_name
+                translations['message_vendor'] = message.vendor
+                inner_template = (
+                    '        if (vendor_id == ${message_vendor} && (qmi_message_get_message_id (self) == ${enum_name}))\n'
+                    '            return TRUE;\n')
+                template += string.Template(inner_template).substitute(translations)
+
+        template += (
+            '        return FALSE;\n'
+            '    }\n'
+            '}\n')
+        cfile.write(string.Template(template).substitute(translations))
+
+
+    """
+    Emit the method giving for how long the response to a request may be cached,
+    0 if it cannot be cached at all.
+    """
+    def __emit_get_cache_ttl(self, hfile, cfile):
+        translations = { 'service'    : self.service.lower() }
+
+        template = (
+            '\n'
+            '#if defined (LIBQMI_GLIB_COMPILATION)\n'
+            '\n'
+            'G_GNUC_INTERNAL\n'
+            'guint __qmi_message_${service}_get_cache_ttl (\n'
+            '    QmiMessage *self,\n'
+            '    QmiMessageContext *context);\n'
+            '\n'
+            '#endif\n'
+            '\n')
+        hfile.write(string.Template(template).substitute(translations))
+
+        template = (
+            '\n'
+            'guint\n'
+            '__qmi_message_${service}_get_cache_ttl (\n'
+            '    QmiMessage *self,\n'
+            '    QmiMessageContext *context)\n'
+            '{\n'
+            '    guint16 vendor_id;\n'
+            '\n'
+            '    vendor_id = (context ? qmi_message_context_get_vendor_id (context) : QMI_MESSAGE_VENDOR_GENERIC);\n'
+            '    if (vendor_id == QMI_MESSAGE_VENDOR_GENERIC) {\n'
+            '        switch (qmi_message_get_message_id (self)) {\n')
+
+        for message in self.list:
+            if message.type == 'Message' and message.vendor is None and message.cache_ttl > 0:
+                translations['enum_name'] = message.id_enum_name
+                translations['cache_ttl'] = message.cache_ttl
+                inner_template = (
+                    '        case ${enum_name}:\n'
+                    '            return ${cache_ttl};\n')
+                template += string.Template(inner_template).substitute(translations)
+
+        template += (
+            '        default:\n'
+            '            return 0;\n'
+            '        }\n'
+            '    } else {\n')
+
+        for message in self.list:
+            if message.type == 'Message' and message.vendor is not None and message.cache_ttl > 0:
+                translations['enum_name'] = message.id_enum_name
+                translations['message_vendor'] = message.vendor
+                translations['cache_ttl'] = message.cache_ttl
+                inner_template = (
+                    '        if (vendor_id == ${message_vendor} && (qmi_message_get_message_id (self) == ${enum_name}))\n'
+                    '            return ${cache_ttl};\n')
+                template += string.Template(inner_template).substitute(translations)
+
+        template += (
+            '        return 0;\n'
+            '    }\n'
+            '}\n')
+        cfile.write(string.Template(template).substitute(translations))
+
+
     """
     Emit the message list handling implementation
     """
@@ -293,6 +506,8 @@ class MessageList:
         utils.add_separator(cfile, 'Service-specific printable', self.service);
         self.__emit_get_printable(hfile, cfile)
         self.__emit_get_version_introduced(hfile, cfile)
+        self.__emit_is_idempotent(hfile, cfile)
+        self.__emit_get_cache_ttl(hfile, cfile)
 
     """
     Emit the sections
@@ -0,0 +1,281 @@
+#!/usr/bin/env python
+# -*- Mode: python; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+#
+# This program is free software; you can redistribute it and/or modify it under
+# the terms of the GNU Lesser General Public License as published by the Free
+# Software Foundation; either version 2 of the License, or (at your option) any
+# later version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+# details.
+#
+# You should have received a copy of the GNU Lesser General Public License along
+# with this program; if not, write to the Free Software Foundation, Inc., 51
+# Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+# Copyright (C) 2026 agent <agent@local>
+#
+
+import re
+import struct
+
+from FieldResult import FieldResult
+
+"""
+The binary schema database, with the descriptions of all the messages of all
+the services given, to be decoded at runtime by QmiSchema. See qmi-schema.c
+for the layout.
+"""
+
+SCHEMA_MAGIC   = b'QMISCHM\0'
+SCHEMA_VERSION = 1
+
+HEADER_SIZE  = 32
+SERVICE_SIZE = 16
+MESSAGE_SIZE = 24
+TLV_SIZE     = 12
+FIELD_SIZE   = 24
+VALUE_SIZE   = 16
+
+# Same values as QmiTlvFieldType
+FIELD_TYPES = { 'uint'              : 0,
+                'int'               : 1,
+                'float'             : 2,
+                'boolean'           : 3,
+                'enum'              : 4,
+                'flags'             : 5,
+                'flags64'           : 6,
+                'string'            : 7,
+                'fixed-size-string' : 8,
+                'array'             : 9,
+                'struct'            : 10,
+                'result'            : 11 }
+
+FIELD_FLAG_SIGNED   = 1 << 0
+FIELD_FLAG_SEQUENCE = 1 << 1
+
+MESSAGE_KIND_REQUEST_RESPONSE = 0
+MESSAGE_KIND_INDICATION       = 1
+
+
+"""
+Values of the enums and flags declared in C headers, with their nicks built
+the same way glib-mkenums does
+"""
+class SchemaValues:
+
+    def __init__(self):
+        self.types = {}
+
+
+    def load_header(self, path):
+        contents = open(path).read()
+        for match in re.finditer(r'typedef\s+enum\s*\{(.*?)\}\s*(\w+)\s*;', contents, re.DOTALL):
+            body = re.sub(r'/\*.*?\*/', '', match.group(1), flags = re.DOTALL)
+            entries = []
+            is_flags = False
+            next_value = 0
+            for item in body.split(','):
+                item = item.strip()
+                if item == '':
+                    continue
+                if '=' in item:
+                    (name, expression) = [part.strip() for part in item.split('=', 1)]
+                    if '<<' in expression:
+                        is_flags = True
+                    value = self.__evaluate(expression, entries)
+                else:
+                    name = item
+                    value = next_value
+                entries.append((name, value))
+                next_value = value + 1
+
+            if not entries:
+                continue
+
+            # Common prefix, up to the last underscore
+            prefix = entries[0][0]
+            for (name, value) in entries[1:]:
+                while not name.startswith(prefix):
+                    prefix = prefix[:-1]
+            prefix = re.sub(r'[A-Za-z0-9]*$', '', prefix)
+
+            self.types[match.group(2)] = (is_flags,
+                                          [(value, name[len(prefix):].lower().replace('_', '-')) for (name, value) in entries])
+
+
+    def __evaluate(self, expression, entries):
+        expression = re.sub(r'\(\s*g?u?int(8|16|32|64)?\s*\)', '', expression)
+        for (name, value) in entries:
+            expression = re.sub(r'\b%s\b' % name, str(value), expression)
+        if not re.match(r'^[0-9a-fA-FxX<|()~\-+ ]*$', expression):
+            raise ValueError('Unsupported enum value expression: \'%s\'' % expression)
+        return int(eval(expression))
+
+
+    def lookup(self, public_format):
+        if public_format not in self.types:
+            raise ValueError('Values of type \'%s\' not found in the given headers' % public_format)
+        return self.types[public_format]
+
+
+"""
+Builder of the binary schema database
+"""
+class Schema:
+
+    def __init__(self, values):
+        self.values = values
+        self.services = {}
+
+
+    """
+    Add all the messages of the service described by the given message list
+    """
+    def add_message_list(self, message_list):
+        service_enum = 'QMI_SERVICE_' + message_list.service.upper()
+        service_id = None
+        for (value, nick) in self.values.lookup('QmiService')[1]:
+            if nick == message_list.service.lower():
+                service_id = value
+                break
+        if service_id is None:
+            raise ValueError('Unknown service \'%s\' (%s)' % (message_list.service, service_enum))
+
+        messages = []
+        for message in message_list.list:
+            if message.type == 'Message':
+                kind = MESSAGE_KIND_REQUEST_RESPONSE
+            else:
+                kind = MESSAGE_KIND_INDICATION
+            messages.append({ 'id'     : int(message.id, 0),
+                              'vendor' : int(message.vendor, 0) if message.vendor else 0,
+                              'kind'   : kind,
+                              'name'   : message.name,
+                              'input'  : self.__build_tlvs(message.input),
+                              'output' : self.__build_tlvs(message.output) })
+
+        messages.sort(key = lambda m: (m['kind'], m['id'], m['vendor']))
+        self.services[service_id] = (message_list.service, messages)
+
+
+    def __build_tlvs(self, container):
+        if container is None or container.fields is None:
+            return []
+
+        tlvs = []
+        for field in container.fields:
+            if isinstance(field, FieldResult):
+                schema_field = { 'type' : 'result', 'signed' : False, 'sequence' : False, 'size' : 0, 'big-endian' : False,
+                                 'length' : 0, 'name' : None, 'values-type' : None, 'members' : [] }
+            else:
+                schema_field = field.variable.build_schema_field(None)
+            tlvs.append((int(field.id, 0), field.name, schema_field))
+        return tlvs
+
+
+    """
+    Write the whole database in the given file
+    """
+    def emit(self, f):
+        self.strings = bytearray()
+        self.string_offsets = {}
+        self.value_offsets = {}
+        self.blob = bytearray(HEADER_SIZE)
+
+        service_ids = sorted(self.services.keys())
+        services_offset = self.__reserve(SERVICE_SIZE * len(service_ids))
+        for (i, service_id) in enumerate(service_ids):
+            (name, messages) = self.services[service_id]
+            messages_offset = self.__reserve(MESSAGE_SIZE * len(messages))
+            for (j, message) in enumerate(messages):
+                input_offset = self.__emit_tlvs(message['input'])
+                output_offset = self.__emit_tlvs(message['output'])
+                struct.pack_into('<HHB3xIHHII', self.blob, messages_offset + j * MESSAGE_SIZE,
+                                 message['id'], message['vendor'], message['kind'],
+                                 self.__string(message['name']),
+                                 len(message['input']), len(message['output']),
+                                 input_offset, output_offset)
+            struct.pack_into('<HHIII', self.blob, services_offset + i * SERVICE_SIZE,
+                             service_id, 0, self.__string(name), len(messages), messages_offset)
+
+        # Strings go last, so that all their offsets are known
+        strings_offset = len(self.blob)
+        struct.pack_into('<8sIIIIII', self.blob, 0,
+                         SCHEMA_MAGIC, SCHEMA_VERSION, len(service_ids), services_offset,
+                         strings_offset, len(self.strings), 0)
+        f.write(bytes(self.blob))
+        f.write(bytes(self.strings))
+
+
+    def __reserve(self, size):
+        offset = len(self.blob)
+        self.blob.extend(bytearray(size))
+        return offset
+
+
+    def __string(self, string):
+        if string is None:
+            string = ''
+        if string not in self.string_offsets:
+            self.string_offsets[string] = len(self.strings)
+            self.strings.extend(string.encode('utf-8') + b'\0')
+        return self.string_offsets[string]
+
+
+    def __emit_tlvs(self, tlvs):
+        if not tlvs:
+            return 0
+        offset = self.__reserve(TLV_SIZE * len(tlvs))
+        for (i, (tlv_type, name, field)) in enumerate(tlvs):
+            field_offset = self.__emit_fields([field])
+            struct.pack_into('<B3xII', self.blob, offset + i * TLV_SIZE,
+                             tlv_type, self.__string(name), field_offset)
+        return offset
+
+
+    def __emit_fields(self, fields):
+        if not fields:
+            return 0
+        offset = self.__reserve(FIELD_SIZE * len(fields))
+        for (i, field) in enumerate(fields):
+            field_type = field['type']
+            values_offset = 0
+            if field_type == 'values':
+                (is_flags, values) = self.values.lookup(field['values-type'])
+                if not is_flags:
+                    field_type = 'enum'
+                elif field['size'] == 8:
+                    field_type = 'flags64'
+                else:
+                    field_type = 'flags'
+                values_offset = self.__emit_values(field['values-type'], values)
+
+            flags = 0
+            if field['signed']:
+                flags |= FIELD_FLAG_SIGNED
+            if field['sequence']:
+                flags |= FIELD_FLAG_SEQUENCE
+
+            members_offset = self.__emit_fields(field['members'])
+            struct.pack_into('<BBBBHHIII4x', self.blob, offset + i * FIELD_SIZE,
+                             FIELD_TYPES[field_type], flags, field['size'], 1 if field['big-endian'] else 0,
+                             field['length'], len(field['members']),
+                             self.__string(field['name']), values_offset, members_offset)
+        return offset
+
+
+    def __emit_values(self, values_type, values):
+        # Each table is written only once, shared by all the fields using it
+        if values_type in self.value_offsets:
+            return self.value_offsets[values_type]
+        offset = self.__reserve(8 + VALUE_SIZE * len(values))
+        struct.pack_into('<II', self.blob, offset, len(values), 0)
+        for (i, (value, nick)) in enumerate(values):
+            if value >= (1 << 63):
+                value -= (1 << 64)
+            struct.pack_into('<qI4x', self.blob, offset + 8 + i * VALUE_SIZE, value, self.__string(nick))
+        self.value_offsets[values_type] = offset
+        return offset
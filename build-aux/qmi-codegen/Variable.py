@@ -88,6 +88,116 @@ class Variable:
         pass
 
 
+    """
+    Whether the variable can be read as a view into the raw byte buffer,
+    instead of being copied into its private format.
+    """
+    def supports_view(self):
+        return False
+
+
+    """
+    Emits the code reading the variable as a view into the raw byte stream,
+    into the '_data' and '_len' variables named after the given one (only
+    for variables supporting views).
+    """
+    def emit_buffer_read_view(self, f, line_prefix, tlv_out, error, variable_name):
+        pass
+
+
+    """
+    Size in bytes of the variable in the raw byte stream, if it is always
+    the same and it can be decoded in place; None otherwise.
+    """
+    def fixed_layout_size(self):
+        return None
+
+
+    """
+    Builds the compact descriptor of the variable, as an item of a
+    QmiTlvField array. Descriptors of inner members are emitted first in
+    the given file, in arrays named after the given descriptor name.
+    """
+    def build_tlv_field(self, f, descriptor_name, member_name):
+        raise RuntimeError('Compact descriptors not supported for \'%s\' variables' % self.format)
+
+
+    """
+    Builds the description of the variable in the binary schema database, as
+    a dictionary with the same contents as the compact descriptor
+    """
+    def build_schema_field(self, member_name):
+        raise RuntimeError('Schema descriptions not supported for \'%s\' variables' % self.format)
+
+
+    """
+    Builds one single field of the binary schema database
+    """
+    @staticmethod
+    def build_schema_field_item(field_type, signed = False, sequence = False, size = 0, endian = 'QMI_ENDIAN_LITTLE',
+                                length = 0, member_name = None, values_type = None, members = None):
+        return { 'type'        : field_type,
+                 'signed'      : signed,
+                 'sequence'    : sequence,
+                 'size'        : int(size),
+                 'big-endian'  : endian == 'QMI_ENDIAN_BIG',
+                 'length'      : int(length),
+                 'name'        : member_name,
+                 'values-type' : values_type,
+                 'members'     : members if members else [] }
+
+
+    """
+    Builds one single item of a QmiTlvField array
+    """
+    @staticmethod
+    def build_tlv_field_item(field_type, flags = 'QMI_TLV_FIELD_FLAG_NONE', size = 0, endian = 'QMI_ENDIAN_LITTLE',
+                             length = 0, n_members = 0, member_name = None, to_string = None, members = None):
+        return ('    { %s, %s, %s, %s, %s, %s, %s, %s, %s, NULL },\n' %
+                (field_type,
+                 flags,
+                 size,
+                 endian,
+                 length,
+                 n_members,
+                 '"%s"' % member_name if member_name else 'NULL',
+                 '(GCallback) %s' % to_string if to_string else 'NULL',
+                 members if members else 'NULL'))
+
+
+    """
+    Emits the code to decode the variable in place, from the given offset
+    of a raw buffer already known to be big enough (only for variables with
+    a fixed layout).
+    """
+    def emit_fixed_layout_read(self, f, line_prefix, buffer_name, buffer_offset, variable_name):
+        pass
+
+
+    """
+    Emits the code reading a variable with a fixed layout in one go: bounds
+    are checked once for the whole variable, and then all its fields are
+    decoded in place.
+    """
+    def emit_fixed_layout_buffer_read(self, f, line_prefix, tlv_out, error, variable_name):
+        translations = { 'lp'      : line_prefix,
+                         'tlv_out' : tlv_out,
+                         'error'   : error,
+                         'size'    : self.fixed_layout_size() }
+
+        template = (
+            '${lp}{\n'
+            '${lp}    const guint8 *fixed_layout;\n'
+            '\n'
+            '${lp}    if (!(fixed_layout = __qmi_message_tlv_read_fixed_layout (message, init_offset, &offset, ${size}, ${error})))\n'
+            '${lp}        goto ${tlv_out};\n')
+        f.write(string.Template(template).substitute(translations))
+
+        self.emit_fixed_layout_read(f, line_prefix + '    ', 'fixed_layout', 0, variable_name)
+
+        f.write(line_prefix + '}\n')
+
+
     """
     Emits the code involved in writing the variable to the raw byte stream
     from the specific private format.
@@ -96,6 +206,15 @@ class Variable:
         pass
 
 
+    """
+    Builds a C expression with the number of bytes the variable takes once
+    written to the raw byte stream, or an upper bound of it. Returns a tuple
+    with the expression and whether it is a compile-time constant.
+    """
+    def build_size_hint(self, variable_name):
+        return ('0', True)
+
+
     """
     Emits the code to get the contents of the given variable as a printable string.
     """
@@ -22,6 +22,7 @@
 import string
 import utils
 from Variable import Variable
+from VariableInteger import VariableInteger
 import VariableFactory
 
 """
@@ -142,9 +143,10 @@ class VariableArray(Variable):
                          'underscore'                  : self.clear_func_name(),
                          'common_var_prefix'           : common_var_prefix }
 
-        template = (
-            '${lp}{\n'
-            '${lp}    guint ${common_var_prefix}_i;\n')
+        template = '${lp}{\n'
+        # Bulk copies don't loop over the items
+        if not self.__is_bulk_copy():
+            template += '${lp}    guint ${common_var_prefix}_i;\n'
         f.write(string.Template(template).substitute(translations))
 
         if self.fixed_size:
@@ -182,6 +184,10 @@ class VariableArray(Variable):
                     '${lp}    ${variable_name}_sequence = ${common_var_prefix}_sequence;\n')
                 f.write(string.Template(template).substitute(translations))
 
+        if self.array_element.fixed_layout_size() is not None:
+            self.__emit_fixed_layout_elements_read(f, line_prefix, tlv_out, error, variable_name)
+            return
+
         template = (
             '\n'
             '${lp}    ${variable_name} = g_array_sized_new (\n'
@@ -212,9 +218,91 @@ class VariableArray(Variable):
         f.write(string.Template(template).substitute(translations))
 
 
+    """
+    Arrays of elements with a fixed layout are read with one single bounds
+    check for all the elements. Integers which are stored in the array just
+    as they come in the raw byte buffer are read all at once with the
+    qmi_utils_read_*_array_from_buffer() helpers; other elements are decoded
+    in place one by one.
+    """
+    def __is_bulk_copy(self):
+        # Integers stored in the array with the same size they have in the
+        # raw byte buffer
+        return (self.array_element.fixed_layout_size() is not None and
+                self.array_element.public_format == self.array_element.private_format and
+                self.array_element.private_format in [ 'guint8', 'gint8', 'guint16', 'gint16', 'guint32', 'gint32', 'guint64', 'gint64' ])
+
+    def __emit_fixed_layout_elements_read(self, f, line_prefix, tlv_out, error, variable_name):
+        common_var_prefix = utils.build_underscore_name(self.name)
+        element_size = self.array_element.fixed_layout_size()
+        translations = { 'lp'                          : line_prefix,
+                         'tlv_out'                     : tlv_out,
+                         'error'                       : error,
+                         'variable_name'               : variable_name,
+                         'public_array_element_format' : self.array_element.public_format,
+                         'element_size'                : element_size,
+                         'common_var_prefix'           : common_var_prefix }
+
+        template = (
+            '\n'
+            '${lp}    {\n'
+            '${lp}        const guint8 *fixed_layout;\n'
+            '\n'
+            '${lp}        if (!(fixed_layout = __qmi_message_tlv_read_fixed_layout (message, init_offset, &offset, (gsize)${common_var_prefix}_n_items * ${element_size}, ${error})))\n'
+            '${lp}            goto ${tlv_out};\n'
+            '\n'
+            '${lp}        ${variable_name} = g_array_sized_new (\n'
+            '${lp}            FALSE,\n'
+            '${lp}            FALSE,\n'
+            '${lp}            sizeof (${public_array_element_format}),\n'
+            '${lp}            (guint)${common_var_prefix}_n_items);\n'
+            '${lp}        g_array_set_size (${variable_name}, (guint)${common_var_prefix}_n_items);\n'
+            '\n')
+        f.write(string.Template(template).substitute(translations))
+
+        if self.__is_bulk_copy():
+            if element_size == 1:
+                template = (
+                    '${lp}        memcpy (${variable_name}->data, fixed_layout, (gsize)${common_var_prefix}_n_items);\n')
+            else:
+                # Signed integers are read with the unsigned reader of the
+                # same size, the bit pattern is the same
+                translations['unsigned_format'] = 'guint%d' % (element_size * 8)
+                translations['endian'] = self.array_element.endian
+                template = (
+                    '${lp}        {\n'
+                    '${lp}            guint16 fixed_layout_size = (guint16)(${common_var_prefix}_n_items * ${element_size});\n'
+                    '\n'
+                    '${lp}            qmi_utils_read_${unsigned_format}_array_from_buffer (&fixed_layout, &fixed_layout_size, ${endian},\n'
+                    '${lp}                                                     (guint)${common_var_prefix}_n_items, (${unsigned_format} *)(gpointer)${variable_name}->data);\n'
+                    '${lp}        }\n')
+            template += (
+                '${lp}    }\n'
+                '${lp}}\n')
+            f.write(string.Template(template).substitute(translations))
+            return
+
+        template = (
+            '${lp}        for (${common_var_prefix}_i = 0; ${common_var_prefix}_i < ${common_var_prefix}_n_items; ${common_var_prefix}_i++) {\n'
+            '${lp}            const guint8 *fixed_layout_item = &fixed_layout[${common_var_prefix}_i * ${element_size}];\n'
+            '\n')
+        f.write(string.Template(template).substitute(translations))
+
+        self.array_element.emit_fixed_layout_read(f, line_prefix + '            ', 'fixed_layout_item', 0,
+                                                  'g_array_index (' + variable_name + ', ' + self.array_element.public_format + ', ' + common_var_prefix + '_i)')
+
+        template = (
+            '${lp}        }\n'
+            '${lp}    }\n'
+            '${lp}}\n')
+        f.write(string.Template(template).substitute(translations))
+
+
     """
     Writing an array to the raw byte buffer is just about providing a loop to
-    write every array element one by one.
+    write every array element one by one. Arrays of integers with the same
+    layout in memory as in the raw byte buffer are instead appended with a
+    single copy.
     """
     def emit_buffer_write(self, f, line_prefix, tlv_name, variable_name):
         common_var_prefix = utils.build_underscore_name(self.name)
@@ -222,9 +310,23 @@ class VariableArray(Variable):
                          'variable_name'     : variable_name,
                          'common_var_prefix' : common_var_prefix }
 
-        template = (
-            '${lp}{\n'
-            '${lp}    guint ${common_var_prefix}_i;\n')
+        bulk_copy = self.__is_bulk_copy()
+        element_size = self.array_element.fixed_layout_size()
+        if bulk_copy and element_size > 1:
+            translations['host_order'] = 'G_BIG_ENDIAN' if self.array_element.endian == 'QMI_ENDIAN_BIG' else 'G_LITTLE_ENDIAN'
+
+        f.write(string.Template('${lp}{\n').substitute(translations))
+        # The loop index is only needed if items are written one by one
+        if not bulk_copy:
+            template = (
+                '${lp}    guint ${common_var_prefix}_i;\n')
+        elif element_size > 1:
+            template = (
+                '#if G_BYTE_ORDER != ${host_order}\n'
+                '${lp}    guint ${common_var_prefix}_i;\n'
+                '#endif\n')
+        else:
+            template = ''
         f.write(string.Template(template).substitute(translations))
 
         if self.fixed_size == 0:
@@ -243,6 +345,24 @@ class VariableArray(Variable):
             self.array_sequence_element.emit_buffer_write(f, line_prefix + '    ', tlv_name, variable_name + '_sequence')
 
 
+        if bulk_copy:
+            translations['element_size'] = element_size
+            translations['tlv_name'] = tlv_name
+            if element_size > 1:
+                f.write(string.Template('#if G_BYTE_ORDER == ${host_order}\n').substitute(translations))
+            template = (
+                '\n'
+                '${lp}    /* Write all the array items at once */\n'
+                '${lp}    if (!__qmi_message_tlv_write_fixed_layout (self, (const guint8 *) ${variable_name}->data, (gsize) ${variable_name}->len * ${element_size}, error)) {\n'
+                '${lp}        g_prefix_error (error, "Cannot write array in TLV \'${tlv_name}\': ");\n'
+                '${lp}        goto error_out;\n'
+                '${lp}    }\n')
+            f.write(string.Template(template).substitute(translations))
+            if element_size == 1:
+                f.write(string.Template('${lp}}\n').substitute(translations))
+                return
+            f.write('#else\n')
+
         template = (
             '\n'
             '${lp}    for (${common_var_prefix}_i = 0; ${common_var_prefix}_i < ${variable_name}->len; ${common_var_prefix}_i++) {\n')
@@ -251,11 +371,31 @@ class VariableArray(Variable):
         self.array_element.emit_buffer_write(f, line_prefix + '        ', tlv_name, 'g_array_index (' + variable_name + ', ' + self.array_element.public_format + ',' + common_var_prefix + '_i)')
 
         template = (
-            '${lp}    }\n'
+            '${lp}    }\n')
+        if bulk_copy:
+            template += '#endif\n'
+        template += (
             '${lp}}\n')
         f.write(string.Template(template).substitute(translations))
 
 
+    """
+    The array takes its size and sequence prefixes plus all its elements.
+    Elements without a fixed size are just estimated.
+    """
+    def build_size_hint(self, variable_name):
+        prefixes = []
+        if self.fixed_size == 0:
+            prefixes.append(self.array_size_element.build_size_hint('')[0])
+        if self.array_sequence_element != '':
+            prefixes.append(self.array_sequence_element.build_size_hint('')[0])
+
+        element_hint = self.array_element.build_size_hint('')
+        element_size = element_hint[0] if element_hint[1] else '16'
+
+        return ('(' + ' + '.join(prefixes + ['(%s->len * %s)' % (variable_name, element_size)]) + ')', False)
+
+
     """
     The array will be printed as a list of fields enclosed between curly
     brackets
@@ -323,6 +463,64 @@ class VariableArray(Variable):
         f.write(string.Template(template).substitute(translations))
 
 
+    """
+    Arrays are described by their size prefix or fixed size, with the
+    descriptors of the sequence prefix (if any) and of the element as
+    members
+    """
+    def build_tlv_field(self, f, descriptor_name, member_name):
+        items = ''
+        n_members = 1
+        flags = 'QMI_TLV_FIELD_FLAG_NONE'
+        if self.array_sequence_element != '':
+            items += self.array_sequence_element.build_tlv_field(f, descriptor_name + '_sequence', None)
+            n_members += 1
+            flags = 'QMI_TLV_FIELD_FLAG_SEQUENCE'
+        items += self.array_element.build_tlv_field(f, descriptor_name + '_element', None)
+
+        f.write('\n'
+                'static const QmiTlvField %s_members[] = {\n'
+                '%s'
+                '};\n' % (descriptor_name, items))
+
+        if self.fixed_size:
+            size = 0
+            length = self.fixed_size
+        else:
+            size = VariableInteger.fixed_type_byte_size(self.array_size_element.private_format)
+            length = 0
+
+        return Variable.build_tlv_field_item('QMI_TLV_FIELD_TYPE_ARRAY', flags, size,
+                                             length = length,
+                                             n_members = n_members,
+                                             member_name = member_name,
+                                             members = descriptor_name + '_members')
+
+
+    """
+    Same as the compact descriptor
+    """
+    def build_schema_field(self, member_name):
+        members = []
+        if self.array_sequence_element != '':
+            members.append(self.array_sequence_element.build_schema_field(None))
+        members.append(self.array_element.build_schema_field(None))
+
+        if self.fixed_size:
+            size = 0
+            length = self.fixed_size
+        else:
+            size = VariableInteger.fixed_type_byte_size(self.array_size_element.private_format)
+            length = 0
+
+        return Variable.build_schema_field_item('array',
+                                                sequence = (self.array_sequence_element != ''),
+                                                size = size,
+                                                length = length,
+                                                member_name = member_name,
+                                                members = members)
+
+
     """
     Variable declaration
     """
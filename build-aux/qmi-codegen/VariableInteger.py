@@ -91,6 +91,44 @@ class VariableInteger(Variable):
         f.write(string.Template(template).substitute(translations))
 
 
+    """
+    Plain integers can be decoded in place
+    """
+    def fixed_layout_size(self):
+        if self.format == 'guint-sized' or self.private_format == 'gfloat':
+            return None
+        return VariableInteger.fixed_type_byte_size(self.private_format)
+
+
+    """
+    Decode a single integer in place; multi-byte values are byteswapped only
+    if the host endianness doesn't match
+    """
+    def emit_fixed_layout_read(self, f, line_prefix, buffer_name, buffer_offset, variable_name):
+        translations = { 'lp'             : line_prefix,
+                         'buffer_name'    : buffer_name,
+                         'buffer_offset'  : buffer_offset,
+                         'variable_name'  : variable_name,
+                         'public_format'  : self.public_format,
+                         'private_format' : self.private_format }
+
+        if self.private_format == 'guint8' or self.private_format == 'gint8':
+            template = (
+                '${lp}${variable_name} = (${public_format})(${private_format})${buffer_name}[${buffer_offset}];\n')
+        else:
+            translations['size'] = VariableInteger.fixed_type_byte_size(self.private_format)
+            translations['from_endian'] = '%s_FROM_%s' % (self.private_format.upper(),
+                                                          'BE' if self.endian == 'QMI_ENDIAN_BIG' else 'LE')
+            template = (
+                '${lp}{\n'
+                '${lp}    ${private_format} tmp;\n'
+                '\n'
+                '${lp}    memcpy (&tmp, &${buffer_name}[${buffer_offset}], ${size});\n'
+                '${lp}    ${variable_name} = (${public_format})${from_endian} (tmp);\n'
+                '${lp}}\n')
+        f.write(string.Template(template).substitute(translations))
+
+
     """
     Return the data type size of fixed c-types
     """
@@ -114,6 +152,73 @@ class VariableInteger(Variable):
             return 8
         raise Exception("Unsupported format %s" % (fmt))
 
+    """
+    Integers are described by their size and endianness, and the way they
+    are printed
+    """
+    def build_tlv_field(self, f, descriptor_name, member_name):
+        if self.format == 'guint-sized':
+            size = self.guint_sized_size
+        elif self.private_format == 'gfloat':
+            size = 4
+        else:
+            size = VariableInteger.fixed_type_byte_size(self.private_format)
+        flags = 'QMI_TLV_FIELD_FLAG_SIGNED' if utils.format_is_signed_integer(self.private_format) else 'QMI_TLV_FIELD_FLAG_NONE'
+        endian = self.endian
+
+        if self.private_format == 'gfloat':
+            return Variable.build_tlv_field_item('QMI_TLV_FIELD_TYPE_FLOAT', size = size, member_name = member_name)
+
+        if self.public_format == 'gboolean':
+            return Variable.build_tlv_field_item('QMI_TLV_FIELD_TYPE_BOOLEAN', flags, size, endian, member_name = member_name)
+
+        if self.public_format != self.private_format:
+            translations = { 'public_format'                : self.public_format,
+                             'public_type_underscore'       : utils.build_underscore_name_from_camelcase(self.public_format),
+                             'public_type_underscore_upper' : utils.build_underscore_name_from_camelcase(self.public_format).upper() }
+            flags_type = 'QMI_TLV_FIELD_TYPE_FLAGS64' if size == 8 else 'QMI_TLV_FIELD_TYPE_FLAGS'
+            template = (
+                '#if defined  __${public_type_underscore_upper}_IS_ENUM__\n' +
+                Variable.build_tlv_field_item('QMI_TLV_FIELD_TYPE_ENUM', flags, size, endian, member_name = member_name,
+                                              to_string = '${public_type_underscore}_get_string') +
+                '#elif defined  __${public_type_underscore_upper}_IS_FLAGS__\n' +
+                Variable.build_tlv_field_item(flags_type, flags, size, endian, member_name = member_name,
+                                              to_string = '${public_type_underscore}_build_string_from_mask') +
+                '#else\n'
+                '# error unexpected public format: ${public_format}\n'
+                '#endif\n')
+            return string.Template(template).substitute(translations)
+
+        field_type = 'QMI_TLV_FIELD_TYPE_INT' if utils.format_is_signed_integer(self.private_format) else 'QMI_TLV_FIELD_TYPE_UINT'
+        return Variable.build_tlv_field_item(field_type, flags, size, endian, member_name = member_name)
+
+
+    """
+    Same as the compact descriptor; enums and flags refer to their public type,
+    and whether they're one or the other is known when the values are loaded
+    """
+    def build_schema_field(self, member_name):
+        if self.format == 'guint-sized':
+            size = self.guint_sized_size
+        elif self.private_format == 'gfloat':
+            size = 4
+        else:
+            size = VariableInteger.fixed_type_byte_size(self.private_format)
+        signed = utils.format_is_signed_integer(self.private_format)
+
+        if self.private_format == 'gfloat':
+            return Variable.build_schema_field_item('float', size = size, member_name = member_name)
+
+        if self.public_format == 'gboolean':
+            return Variable.build_schema_field_item('boolean', signed, size = size, endian = self.endian, member_name = member_name)
+
+        if self.public_format != self.private_format:
+            return Variable.build_schema_field_item('values', signed, size = size, endian = self.endian, member_name = member_name,
+                                                    values_type = self.public_format)
+
+        return Variable.build_schema_field_item('int' if signed else 'uint', signed, size = size, endian = self.endian, member_name = member_name)
+
+
     """
     Write a single integer to the raw byte buffer
     """
@@ -158,6 +263,15 @@ class VariableInteger(Variable):
         f.write(string.Template(template).substitute(translations))
 
 
+    """
+    Integers take a fixed amount of bytes
+    """
+    def build_size_hint(self, variable_name):
+        if self.format == 'guint-sized':
+            return (self.guint_sized_size, True)
+        return ('sizeof (%s)' % self.private_format, True)
+
+
     """
     Get the integer as a printable string.
     """
@@ -77,10 +77,36 @@ class VariableSequence(Variable):
     fields one by one.
     """
     def emit_buffer_read(self, f, line_prefix, tlv_out, error, variable_name):
+        if self.fixed_layout_size() is not None:
+            self.emit_fixed_layout_buffer_read(f, line_prefix, tlv_out, error, variable_name)
+            return
+
         for member in self.members:
             member['object'].emit_buffer_read(f, line_prefix, tlv_out, error, variable_name + '_' +  member['name'])
 
 
+    """
+    The sequence has a fixed layout if all its members have one
+    """
+    def fixed_layout_size(self):
+        size = 0
+        for member in self.members:
+            member_size = member['object'].fixed_layout_size()
+            if member_size is None:
+                return None
+            size += member_size
+        return size
+
+
+    """
+    Decode all members in place, one after the other
+    """
+    def emit_fixed_layout_read(self, f, line_prefix, buffer_name, buffer_offset, variable_name):
+        for member in self.members:
+            member['object'].emit_fixed_layout_read(f, line_prefix, buffer_name, buffer_offset, variable_name + '_' + member['name'])
+            buffer_offset += member['object'].fixed_layout_size()
+
+
     """
     Writing the contents of a sequence is just about writing each of the sequence
     fields one by one.
@@ -90,6 +116,14 @@ class VariableSequence(Variable):
             member['object'].emit_buffer_write(f, line_prefix, tlv_name, variable_name + '_' +  member['name'])
 
 
+    """
+    The sequence takes the sum of all its members
+    """
+    def build_size_hint(self, variable_name):
+        hints = [member['object'].build_size_hint(variable_name + '_' + member['name']) for member in self.members]
+        return ('(' + ' + '.join([hint[0] for hint in hints]) + ')', all([hint[1] for hint in hints]))
+
+
     """
     The sequence will be printed as a list of fields enclosed between square
     brackets
@@ -118,6 +152,34 @@ class VariableSequence(Variable):
         f.write(string.Template(template).substitute(translations))
 
 
+    """
+    The sequence is described with the descriptors of all its members
+    """
+    def build_tlv_field(self, f, descriptor_name, member_name):
+        items = ''
+        for member in self.members:
+            items += member['object'].build_tlv_field(f, descriptor_name + '_' + member['name'], member['name'])
+
+        f.write('\n'
+                'static const QmiTlvField %s_members[] = {\n'
+                '%s'
+                '};\n' % (descriptor_name, items))
+
+        return Variable.build_tlv_field_item('QMI_TLV_FIELD_TYPE_STRUCT',
+                                             n_members = len(self.members),
+                                             member_name = member_name,
+                                             members = descriptor_name + '_members')
+
+
+    """
+    Same as the compact descriptor
+    """
+    def build_schema_field(self, member_name):
+        return Variable.build_schema_field_item('struct',
+                                                member_name = member_name,
+                                                members = [member['object'].build_schema_field(member['name']) for member in self.members])
+
+
     """
     Variable declaration
     """
@@ -111,6 +111,31 @@ class VariableString(Variable):
         f.write(string.Template(template).substitute(translations))
 
 
+    """
+    Variable-length strings may be read as a view into the raw byte buffer,
+    and only copied when requested.
+    """
+    def supports_view(self):
+        return not self.is_fixed_size
+
+
+    """
+    Read a variable-length string as a view into the raw byte buffer.
+    """
+    def emit_buffer_read_view(self, f, line_prefix, tlv_out, error, variable_name):
+        translations = { 'lp'                  : line_prefix,
+                         'tlv_out'             : tlv_out,
+                         'variable_name'       : variable_name,
+                         'error'               : error,
+                         'n_size_prefix_bytes' : self.n_size_prefix_bytes,
+                         'max_size'            : self.max_size if self.max_size != '' else '0' }
+
+        template = (
+            '${lp}if (!__qmi_message_tlv_read_string_view (message, init_offset, &offset, ${n_size_prefix_bytes}, ${max_size}, &(${variable_name}_data), &(${variable_name}_len), ${error}))\n'
+            '${lp}    goto ${tlv_out};\n')
+        f.write(string.Template(template).substitute(translations))
+
+
     """
     Write a string to the raw byte buffer.
     """
@@ -130,6 +155,43 @@ class VariableString(Variable):
         f.write(string.Template(template).substitute(translations))
 
 
+    """
+    Fixed-size strings take a fixed amount of bytes, variable-length ones
+    the string itself plus the length prefix
+    """
+    def build_size_hint(self, variable_name):
+        if self.is_fixed_size:
+            return (self.fixed_size, True)
+        return ('(%s + strlen (%s))' % (self.n_size_prefix_bytes, variable_name), False)
+
+
+    """
+    Strings are described by their size prefix and maximum size, or by their
+    fixed size
+    """
+    def build_tlv_field(self, f, descriptor_name, member_name):
+        if self.is_fixed_size:
+            return Variable.build_tlv_field_item('QMI_TLV_FIELD_TYPE_FIXED_SIZE_STRING',
+                                                 length = self.fixed_size,
+                                                 member_name = member_name)
+        return Variable.build_tlv_field_item('QMI_TLV_FIELD_TYPE_STRING',
+                                             size = self.n_size_prefix_bytes,
+                                             length = self.max_size if self.max_size != '' else '0',
+                                             member_name = member_name)
+
+
+    """
+    Same as the compact descriptor
+    """
+    def build_schema_field(self, member_name):
+        if self.is_fixed_size:
+            return Variable.build_schema_field_item('fixed-size-string', length = self.fixed_size, member_name = member_name)
+        return Variable.build_schema_field_item('string',
+                                                size = self.n_size_prefix_bytes,
+                                                length = self.max_size if self.max_size != '' else 0,
+                                                member_name = member_name)
+
+
     """
     Get the string as printable
     """
@@ -1,5 +1,190 @@
 /*** BEGIN file-header ***/
 
+/* Lookups of the nicks by value, built on first use instead of scanning the
+ * value tables in every call. Values dense enough are indexed directly, the
+ * others are kept sorted for a binary search; if several nicks are given to
+ * the same value, the first one wins, as when scanning the table. Single-bit
+ * flag values are also indexed by bit. */
+
+typedef struct {
+    gint64       value;
+    const gchar *nick;
+} ValueNick;
+
+typedef struct {
+    /* Direct index, if dense enough */
+    gint64        direct_min;
+    guint         n_direct;
+    const gchar **direct;
+    /* Sorted by value, otherwise */
+    guint         n_sorted;
+    ValueNick    *sorted;
+    /* Single-bit flag values, in table order; if each one is a higher bit
+     * than the previous one, also indexed by bit */
+    guint         n_bits;
+    ValueNick    *bits;
+    gboolean      bits_indexed;
+    const gchar  *bit_nicks[32];
+} ValueLookup;
+
+static gint
+value_nick_cmp (const ValueNick *a,
+                const ValueNick *b,
+                gpointer         unused)
+{
+    return (a->value > b->value) - (a->value < b->value);
+}
+
+static ValueLookup *
+value_lookup_new (gconstpointer values,
+                  gboolean      is_flags)
+{
+    ValueLookup *lookup;
+    ValueNick   *entries;
+    guint        n;
+    guint        i;
+    gint64       min;
+    gint64       max;
+
+    lookup = g_new0 (ValueLookup, 1);
+
+    for (n = 0; ((const GEnumValue *) values)[n].value_nick; n++);
+    if (!n)
+        return lookup;
+
+    entries = g_new (ValueNick, n);
+    for (i = 0; i < n; i++) {
+        if (is_flags) {
+            entries[i].value = (gint64) ((const GFlagsValue *) values)[i].value;
+            entries[i].nick  = ((const GFlagsValue *) values)[i].value_nick;
+        } else {
+            entries[i].value = (gint64) ((const GEnumValue *) values)[i].value;
+            entries[i].nick  = ((const GEnumValue *) values)[i].value_nick;
+        }
+    }
+
+    min = max = entries[0].value;
+    for (i = 1; i < n; i++) {
+        min = MIN (min, entries[i].value);
+        max = MAX (max, entries[i].value);
+    }
+
+    if (is_flags) {
+        lookup->bits = g_new (ValueNick, n);
+        lookup->bits_indexed = TRUE;
+        for (i = 0; i < n; i++) {
+            guint32 value;
+
+            value = (guint32) entries[i].value;
+            if (!value || (value & (value - 1)))
+                continue;
+            if (lookup->n_bits > 0 && value <= (guint32) lookup->bits[lookup->n_bits - 1].value)
+                lookup->bits_indexed = FALSE;
+            lookup->bits[lookup->n_bits++] = entries[i];
+            lookup->bit_nicks[g_bit_nth_lsf (value, -1)] = entries[i].nick;
+        }
+    }
+
+    if ((max - min) < (2 * (gint64) n + 16)) {
+        lookup->direct_min = min;
+        lookup->n_direct = (guint) (max - min + 1);
+        lookup->direct = g_new0 (const gchar *, lookup->n_direct);
+        for (i = 0; i < n; i++) {
+            if (!lookup->direct[entries[i].value - min])
+                lookup->direct[entries[i].value - min] = entries[i].nick;
+        }
+    } else {
+        /* Stable, so the first of several nicks for a value stays first */
+        g_qsort_with_data (entries, n, sizeof (ValueNick), (GCompareDataFunc) value_nick_cmp, NULL);
+        lookup->n_sorted = n;
+        lookup->sorted = entries;
+        return lookup;
+    }
+
+    g_free (entries);
+    return lookup;
+}
+
+static const ValueLookup *
+value_lookup_get (volatile gsize *lookup,
+                  gconstpointer   values,
+                  gboolean        is_flags)
+{
+    if (g_once_init_enter (lookup))
+        g_once_init_leave (lookup, (gsize) value_lookup_new (values, is_flags));
+    return (const ValueLookup *) *lookup;
+}
+
+static const gchar *
+value_lookup_find (const ValueLookup *lookup,
+                   gint64             value)
+{
+    guint lo;
+    guint hi;
+
+    if (lookup->direct) {
+        if (value < lookup->direct_min || (value - lookup->direct_min) >= lookup->n_direct)
+            return NULL;
+        return lookup->direct[value - lookup->direct_min];
+    }
+
+    /* First of the entries with the value, if any */
+    lo = 0;
+    hi = lookup->n_sorted;
+    while (lo < hi) {
+        guint mid;
+
+        mid = lo + (hi - lo) / 2;
+        if (lookup->sorted[mid].value < value)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < lookup->n_sorted && lookup->sorted[lo].value == value)
+        return lookup->sorted[lo].nick;
+    return NULL;
+}
+
+static G_GNUC_UNUSED gchar *
+value_lookup_build_string (const ValueLookup *lookup,
+                           gint64             mask)
+{
+    const gchar *nick;
+    GString     *str = NULL;
+    guint        i;
+
+    /* We also look for exact matches */
+    nick = value_lookup_find (lookup, mask);
+    if (nick)
+        return g_strdup (nick);
+
+    /* Build list with single-bit masks */
+    if (lookup->bits_indexed) {
+        guint32 pending;
+
+        for (pending = (guint32) mask; pending; pending &= pending - 1) {
+            nick = lookup->bit_nicks[g_bit_nth_lsf (pending, -1)];
+            if (!nick)
+                continue;
+            if (!str)
+                str = g_string_new (nick);
+            else
+                g_string_append_printf (str, ", %s", nick);
+        }
+    } else {
+        for (i = 0; i < lookup->n_bits; i++) {
+            if (!(mask & lookup->bits[i].value))
+                continue;
+            if (!str)
+                str = g_string_new (lookup->bits[i].nick);
+            else
+                g_string_append_printf (str, ", %s", lookup->bits[i].nick);
+        }
+    }
+
+    return (str ? g_string_free (str, FALSE) : NULL);
+}
+
 /*** END file-header ***/
 
 /*** BEGIN file-production ***/
@@ -40,14 +225,9 @@ GType
 const gchar *
 @enum_name@_get_string (@EnumName@ val)
 {
-    guint i;
+    static volatile gsize lookup = 0;
 
-    for (i = 0; @enum_name@_values[i].value_nick; i++) {
-        if (val == @enum_name@_values[i].value)
-            return @enum_name@_values[i].value_nick;
-    }
-
-    return NULL;
+    return value_lookup_find (value_lookup_get (&lookup, @enum_name@_values, FALSE), (gint64) val);
 }
 #endif /* __@ENUMNAME@_IS_ENUM__ */
 
@@ -59,39 +239,9 @@ const gchar *
 gchar *
 @enum_name@_build_string_from_mask (@EnumName@ mask)
 {
-    guint i;
-    gboolean first = TRUE;
-    GString *str = NULL;
-
-    for (i = 0; @enum_name@_values[i].value_nick; i++) {
-        /* We also look for exact matches */
-        if (mask == @enum_name@_values[i].value) {
-            if (str)
-                g_string_free (str, TRUE);
-            return g_strdup (@enum_name@_values[i].value_nick);
-        }
+    static volatile gsize lookup = 0;
 
-        /* Build list with single-bit masks */
-        if (mask & @enum_name@_values[i].value) {
-            guint c;
-            gulong number = @enum_name@_values[i].value;
-
-            for (c = 0; number; c++)
-                number &= number - 1;
-
-            if (c == 1) {
-                if (!str)
-                    str = g_string_new ("");
-                g_string_append_printf (str, "%s%s",
-                                        first ? "" : ", ",
-                                        @enum_name@_values[i].value_nick);
-                if (first)
-                    first = FALSE;
-            }
-        }
-    }
-
-    return (str ? g_string_free (str, FALSE) : NULL);
+    return value_lookup_build_string (value_lookup_get (&lookup, @enum_name@_values, TRUE), (gint64) mask);
 }
 #endif /* __@ENUMNAME@_IS_FLAGS__ */
 
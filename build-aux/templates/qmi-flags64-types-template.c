@@ -6,6 +6,138 @@ typedef struct {
   const gchar *value_nick;
 } GFlags64Value;
 
+/* Lookups of the nicks by value, built on first use instead of scanning the
+ * value tables in every call. Values are kept sorted for a binary search of
+ * exact matches; if several nicks are given to the same value, the first one
+ * wins, as when scanning the table. Single-bit values are also indexed by
+ * bit. */
+
+typedef struct {
+    guint64      value;
+    const gchar *nick;
+} ValueNick;
+
+typedef struct {
+    /* Sorted by value */
+    guint        n_sorted;
+    ValueNick   *sorted;
+    /* Single-bit values, in table order; if each one is a higher bit than the
+     * previous one, also indexed by bit */
+    guint        n_bits;
+    ValueNick   *bits;
+    gboolean     bits_indexed;
+    const gchar *bit_nicks[64];
+} ValueLookup;
+
+static guint
+bit_nth_lsf64 (guint64 value)
+{
+    if ((guint32) value)
+        return g_bit_nth_lsf ((guint32) value, -1);
+    return 32 + g_bit_nth_lsf ((guint32) (value >> 32), -1);
+}
+
+static gint
+value_nick_cmp (const ValueNick *a,
+                const ValueNick *b,
+                gpointer         unused)
+{
+    return (a->value > b->value) - (a->value < b->value);
+}
+
+static ValueLookup *
+value_lookup_new (const GFlags64Value *values)
+{
+    ValueLookup *lookup;
+    guint        n;
+    guint        i;
+
+    lookup = g_new0 (ValueLookup, 1);
+
+    for (n = 0; values[n].value_nick; n++);
+    if (!n)
+        return lookup;
+
+    lookup->bits = g_new (ValueNick, n);
+    lookup->bits_indexed = TRUE;
+    lookup->sorted = g_new (ValueNick, n);
+    lookup->n_sorted = n;
+    for (i = 0; i < n; i++) {
+        lookup->sorted[i].value = values[i].value;
+        lookup->sorted[i].nick  = values[i].value_nick;
+
+        if (!values[i].value || (values[i].value & (values[i].value - 1)))
+            continue;
+        if (lookup->n_bits > 0 && values[i].value <= lookup->bits[lookup->n_bits - 1].value)
+            lookup->bits_indexed = FALSE;
+        lookup->bits[lookup->n_bits++] = lookup->sorted[i];
+        lookup->bit_nicks[bit_nth_lsf64 (values[i].value)] = values[i].value_nick;
+    }
+
+    /* Stable, so the first of several nicks for a value stays first */
+    g_qsort_with_data (lookup->sorted, n, sizeof (ValueNick), (GCompareDataFunc) value_nick_cmp, NULL);
+    return lookup;
+}
+
+static gchar *
+value_lookup_build_string (volatile gsize      *lookup_volatile,
+                           const GFlags64Value *values,
+                           guint64              mask)
+{
+    const ValueLookup *lookup;
+    GString           *str = NULL;
+    guint              lo;
+    guint              hi;
+    guint              i;
+
+    if (g_once_init_enter (lookup_volatile))
+        g_once_init_leave (lookup_volatile, (gsize) value_lookup_new (values));
+    lookup = (const ValueLookup *) *lookup_volatile;
+
+    /* We also look for exact matches */
+    lo = 0;
+    hi = lookup->n_sorted;
+    while (lo < hi) {
+        guint mid;
+
+        mid = lo + (hi - lo) / 2;
+        if (lookup->sorted[mid].value < mask)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < lookup->n_sorted && lookup->sorted[lo].value == mask)
+        return g_strdup (lookup->sorted[lo].nick);
+
+    /* Build list with single-bit masks */
+    if (lookup->bits_indexed) {
+        guint64 pending;
+
+        for (pending = mask; pending; pending &= pending - 1) {
+            const gchar *nick;
+
+            nick = lookup->bit_nicks[bit_nth_lsf64 (pending)];
+            if (!nick)
+                continue;
+            if (!str)
+                str = g_string_new (nick);
+            else
+                g_string_append_printf (str, ", %s", nick);
+        }
+    } else {
+        for (i = 0; i < lookup->n_bits; i++) {
+            if (!(mask & lookup->bits[i].value))
+                continue;
+            if (!str)
+                str = g_string_new (lookup->bits[i].nick);
+            else
+                g_string_append_printf (str, ", %s", lookup->bits[i].nick);
+        }
+    }
+
+    return (str ? g_string_free (str, FALSE) : NULL);
+}
+
 /*** END file-header ***/
 
 /*** BEGIN file-production ***/
@@ -25,39 +157,9 @@ static const GFlags64Value @enum_name@_values[] = {
 gchar *
 @enum_name@_build_string_from_mask (@EnumName@ mask)
 {
-    guint i;
-    gboolean first = TRUE;
-    GString *str = NULL;
-
-    for (i = 0; @enum_name@_values[i].value_nick; i++) {
-        /* We also look for exact matches */
-        if (mask == @enum_name@_values[i].value) {
-            if (str)
-                g_string_free (str, TRUE);
-            return g_strdup (@enum_name@_values[i].value_nick);
-        }
+    static volatile gsize lookup = 0;
 
-        /* Build list with single-bit masks */
-        if (mask & @enum_name@_values[i].value) {
-            guint c;
-            guint64 number = @enum_name@_values[i].value;
-
-            for (c = 0; number; c++)
-                number &= number - 1;
-
-            if (c == 1) {
-                if (!str)
-                    str = g_string_new ("");
-                g_string_append_printf (str, "%s%s",
-                                        first ? "" : ", ",
-                                        @enum_name@_values[i].value_nick);
-                if (first)
-                    first = FALSE;
-            }
-        }
-    }
-
-    return (str ? g_string_free (str, FALSE) : NULL);
+    return value_lookup_build_string (&lookup, @enum_name@_values, (guint64) mask);
 }
 
 /*** END value-tail ***/
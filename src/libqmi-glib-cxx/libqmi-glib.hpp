@@ -0,0 +1,77 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib-cxx -- C++ binding of libqmi-glib
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef __LIBQMI_GLIB_CXX_HPP__
+#define __LIBQMI_GLIB_CXX_HPP__
+
+#include "qmi-cxx.hpp"
+
+#if QMI_SERVICE_DMS_SUPPORTED
+#include "qmi-dms.hpp"
+#endif
+
+#if QMI_SERVICE_NAS_SUPPORTED
+#include "qmi-nas.hpp"
+#endif
+
+#if QMI_SERVICE_WDS_SUPPORTED
+#include "qmi-wds.hpp"
+#endif
+
+#if QMI_SERVICE_WMS_SUPPORTED
+#include "qmi-wms.hpp"
+#endif
+
+#if QMI_SERVICE_PDS_SUPPORTED
+#include "qmi-pds.hpp"
+#endif
+
+#if QMI_SERVICE_PDC_SUPPORTED
+#include "qmi-pdc.hpp"
+#endif
+
+#if QMI_SERVICE_PBM_SUPPORTED
+#include "qmi-pbm.hpp"
+#endif
+
+#if QMI_SERVICE_UIM_SUPPORTED
+#include "qmi-uim.hpp"
+#endif
+
+#if QMI_SERVICE_OMA_SUPPORTED
+#include "qmi-oma.hpp"
+#endif
+
+#if QMI_SERVICE_WDA_SUPPORTED
+#include "qmi-wda.hpp"
+#endif
+
+#if QMI_SERVICE_VOICE_SUPPORTED
+#include "qmi-voice.hpp"
+#endif
+
+#if QMI_SERVICE_LOC_SUPPORTED
+#include "qmi-loc.hpp"
+#endif
+
+#endif /* __LIBQMI_GLIB_CXX_HPP__ */
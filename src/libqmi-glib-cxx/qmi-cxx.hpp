@@ -0,0 +1,260 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib-cxx -- C++ binding of libqmi-glib
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef __LIBQMI_GLIB_CXX_QMI_CXX_HPP__
+#define __LIBQMI_GLIB_CXX_QMI_CXX_HPP__
+
+#if __cplusplus < 201703L
+#error "libqmi-glib-cxx requires C++17."
+#endif
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include <libqmi-glib.h>
+
+/*
+ * Header-only C++ binding of libqmi-glib.
+ *
+ * Input and output containers are wrapped in move-only handles owning one
+ * reference, so that no extra ref/unref is ever needed. Output getters
+ * return std::optional values, and strings and arrays are borrowed from the
+ * output as std::string_view and qmi::ArrayView, valid as long as the output
+ * handle is.
+ *
+ * Requests are sent with the service Client wrappers, either with a
+ * callback or synchronously. The callback is stored in the user data pointer
+ * of the underlying GAsyncReadyCallback, so it must be trivially copyable
+ * and not bigger than a pointer (e.g. a lambda capturing only 'this'), and
+ * no allocation is done per request.
+ */
+
+namespace qmi {
+
+/*****************************************************************************/
+/* Errors */
+
+class Error {
+public:
+    Error () noexcept : error_ (nullptr) {}
+    explicit Error (GError *error) noexcept : error_ (error) {}
+    Error (const Error &) = delete;
+    Error &operator= (const Error &) = delete;
+    Error (Error &&other) noexcept : error_ (std::exchange (other.error_, nullptr)) {}
+    Error &operator= (Error &&other) noexcept {
+        if (this != &other) {
+            g_clear_error (&error_);
+            error_ = std::exchange (other.error_, nullptr);
+        }
+        return *this;
+    }
+    ~Error () { g_clear_error (&error_); }
+
+    /* Location to give to the C API, clearing any previous error */
+    GError **out () noexcept {
+        g_clear_error (&error_);
+        return &error_;
+    }
+
+    explicit operator bool () const noexcept { return error_ != nullptr; }
+    const GError *get () const noexcept { return error_; }
+    GError *release () noexcept { return std::exchange (error_, nullptr); }
+
+    GQuark domain () const noexcept { return error_ ? error_->domain : 0; }
+    gint code () const noexcept { return error_ ? error_->code : 0; }
+    std::string_view message () const noexcept { return error_ ? std::string_view (error_->message) : std::string_view (); }
+    bool matches (GQuark domain, gint code) const noexcept { return g_error_matches (error_, domain, code); }
+
+private:
+    GError *error_;
+};
+
+/*****************************************************************************/
+/* Owning handles */
+
+/* Move-only handle of a container, owning one reference */
+template <typename T, void (*Unref) (T *)>
+class Handle {
+public:
+    Handle () noexcept : ptr_ (nullptr) {}
+    explicit Handle (T *ptr) noexcept : ptr_ (ptr) {}
+    Handle (const Handle &) = delete;
+    Handle &operator= (const Handle &) = delete;
+    Handle (Handle &&other) noexcept : ptr_ (std::exchange (other.ptr_, nullptr)) {}
+    Handle &operator= (Handle &&other) noexcept {
+        if (this != &other)
+            reset (std::exchange (other.ptr_, nullptr));
+        return *this;
+    }
+    ~Handle () { reset (); }
+
+    explicit operator bool () const noexcept { return ptr_ != nullptr; }
+    T *get () const noexcept { return ptr_; }
+    T *release () noexcept { return std::exchange (ptr_, nullptr); }
+    void reset (T *ptr = nullptr) noexcept {
+        if (ptr_)
+            Unref (ptr_);
+        ptr_ = ptr;
+    }
+
+private:
+    T *ptr_;
+};
+
+/* Tag to adopt the reference given to an Object, instead of taking a new one */
+struct AdoptRef {};
+constexpr AdoptRef adopt_ref {};
+
+/* Handle of a GObject, copies take new references */
+template <typename T>
+class Object {
+public:
+    Object () noexcept : ptr_ (nullptr) {}
+    explicit Object (T *ptr) noexcept : ptr_ (ptr ? static_cast<T *> (g_object_ref (ptr)) : nullptr) {}
+    Object (T *ptr, AdoptRef) noexcept : ptr_ (ptr) {}
+    Object (const Object &other) noexcept : Object (other.ptr_) {}
+    Object &operator= (const Object &other) noexcept {
+        if (this != &other) {
+            g_clear_object (&ptr_);
+            ptr_ = other.ptr_ ? static_cast<T *> (g_object_ref (other.ptr_)) : nullptr;
+        }
+        return *this;
+    }
+    Object (Object &&other) noexcept : ptr_ (std::exchange (other.ptr_, nullptr)) {}
+    Object &operator= (Object &&other) noexcept {
+        if (this != &other) {
+            g_clear_object (&ptr_);
+            ptr_ = std::exchange (other.ptr_, nullptr);
+        }
+        return *this;
+    }
+    ~Object () { g_clear_object (&ptr_); }
+
+    explicit operator bool () const noexcept { return ptr_ != nullptr; }
+    T *get () const noexcept { return ptr_; }
+
+private:
+    T *ptr_;
+};
+
+/*****************************************************************************/
+/* Borrowed arrays */
+
+/* Read-only view of the elements of a GArray owned by someone else */
+template <typename T>
+class ArrayView {
+public:
+    ArrayView () noexcept : data_ (nullptr), size_ (0) {}
+    explicit ArrayView (const GArray *array) noexcept
+        : data_ (array ? reinterpret_cast<const T *> (array->data) : nullptr),
+          size_ (array ? array->len : 0) {}
+
+    const T *data () const noexcept { return data_; }
+    std::size_t size () const noexcept { return size_; }
+    bool empty () const noexcept { return size_ == 0; }
+    const T &operator[] (std::size_t i) const noexcept { return data_[i]; }
+    const T *begin () const noexcept { return data_; }
+    const T *end () const noexcept { return data_ + size_; }
+
+private:
+    const T     *data_;
+    std::size_t  size_;
+};
+
+/*****************************************************************************/
+/* Results of requests */
+
+/* Either the output of a request or the error of the transaction */
+template <typename T>
+class Result {
+public:
+    explicit Result (T &&value) noexcept : value_ (std::in_place_index<0>, std::move (value)) {}
+    explicit Result (Error &&error) noexcept : value_ (std::in_place_index<1>, std::move (error)) {}
+
+    explicit operator bool () const noexcept { return value_.index () == 0; }
+    T &value () noexcept { return std::get<0> (value_); }
+    const T &value () const noexcept { return std::get<0> (value_); }
+    T *operator-> () noexcept { return &std::get<0> (value_); }
+    const T *operator-> () const noexcept { return &std::get<0> (value_); }
+    const Error &error () const noexcept { return std::get<1> (value_); }
+
+private:
+    std::variant<T, Error> value_;
+};
+
+/*****************************************************************************/
+/* Callback trampolines, not to be used directly */
+
+namespace detail {
+
+template <typename F>
+inline gpointer
+pack_callback (const F &callback) noexcept
+{
+    static_assert (std::is_trivially_copyable<F>::value &&
+                   std::is_trivially_destructible<F>::value &&
+                   sizeof (F) <= sizeof (gpointer) &&
+                   alignof (F) <= alignof (gpointer),
+                   "Callbacks must be trivially copyable and not bigger than a pointer, "
+                   "e.g. a lambda capturing a single pointer");
+    gpointer user_data = nullptr;
+
+    std::memcpy (&user_data, &callback, sizeof (F));
+    return user_data;
+}
+
+template <typename Output, typename Self, typename COutput,
+          COutput *(*Finish) (Self *, GAsyncResult *, GError **),
+          typename F>
+void
+ready (GObject      *source,
+       GAsyncResult *res,
+       gpointer      user_data)
+{
+    alignas (F) unsigned char  storage[sizeof (F)];
+    F                         *callback;
+    Error                      error;
+    COutput                   *output;
+
+    std::memcpy (storage, &user_data, sizeof (F));
+    callback = std::launder (reinterpret_cast<F *> (storage));
+
+    output = Finish (reinterpret_cast<Self *> (source), res, error.out ());
+    if (!output)
+        (*callback) (Result<Output> (std::move (error)));
+    else
+        (*callback) (Result<Output> (Output (output)));
+}
+
+} /* namespace detail */
+
+} /* namespace qmi */
+
+#endif /* __LIBQMI_GLIB_CXX_QMI_CXX_HPP__ */
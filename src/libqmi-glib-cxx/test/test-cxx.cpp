@@ -0,0 +1,123 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <glib-object.h>
+
+#include "libqmi-glib.hpp"
+
+static void
+test_cxx_input (void)
+{
+    qmi::wds::GetProfileSettingsInput input;
+    QmiWdsProfileType                 profile_type = QMI_WDS_PROFILE_TYPE_3GPP2;
+    guint8                            profile_index = 0;
+
+    input.set_profile_id (QMI_WDS_PROFILE_TYPE_3GPP, 3);
+    g_assert (input);
+    g_assert (qmi_message_wds_get_profile_settings_input_get_profile_id (input.get (), &profile_type, &profile_index, NULL));
+    g_assert_cmpuint (profile_type, ==, QMI_WDS_PROFILE_TYPE_3GPP);
+    g_assert_cmpuint (profile_index, ==, 3);
+
+    /* Moves never take new references */
+    qmi::wds::GetProfileSettingsInput moved (std::move (input));
+    g_assert (!input);
+    g_assert (moved);
+    input = std::move (moved);
+    g_assert (input);
+    g_assert (!moved);
+}
+
+static void
+test_cxx_array_view (void)
+{
+    GArray  *array;
+    guint16  values[] = { 1, 2, 3, 4 };
+    guint    sum = 0;
+
+    array = g_array_new (FALSE, FALSE, sizeof (guint16));
+    g_array_append_vals (array, values, G_N_ELEMENTS (values));
+
+    qmi::ArrayView<guint16> view (array);
+    g_assert_cmpuint (view.size (), ==, G_N_ELEMENTS (values));
+    g_assert (view.data () == reinterpret_cast<guint16 *> (array->data));
+    for (guint16 value : view)
+        sum += value;
+    g_assert_cmpuint (sum, ==, 10);
+    g_assert_cmpuint (view[3], ==, 4);
+
+    g_assert (qmi::ArrayView<guint16> (nullptr).empty ());
+    g_array_unref (array);
+}
+
+static void
+test_cxx_error (void)
+{
+    qmi::Error error;
+
+    g_assert (!error);
+    g_set_error (error.out (), QMI_CORE_ERROR, QMI_CORE_ERROR_TIMEOUT, "timed out");
+    g_assert (error);
+    g_assert (error.matches (QMI_CORE_ERROR, QMI_CORE_ERROR_TIMEOUT));
+    g_assert (error.message () == "timed out");
+
+    /* Reusing the location clears the previous error */
+    g_set_error (error.out (), QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED, "failed");
+    g_assert_cmpint (error.code (), ==, QMI_CORE_ERROR_FAILED);
+
+    qmi::Error moved (std::move (error));
+    g_assert (!error);
+    g_assert (moved);
+}
+
+static QmiMessageWdsGetProfileSettingsOutput *
+failed_finish (QmiClientWds  *self,
+               GAsyncResult  *res,
+               GError       **error)
+{
+    g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TIMEOUT, "timed out");
+    return NULL;
+}
+
+static void
+test_cxx_callback (void)
+{
+    guint  n_calls = 0;
+    guint *n_calls_ptr = &n_calls;
+    auto   callback = [n_calls_ptr] (qmi::Result<qmi::wds::GetProfileSettingsOutput> result) {
+        g_assert (!result);
+        g_assert (result.error ().matches (QMI_CORE_ERROR, QMI_CORE_ERROR_TIMEOUT));
+        (*n_calls_ptr)++;
+    };
+
+    /* The callback travels in the user data, as given to the C API */
+    qmi::detail::ready<qmi::wds::GetProfileSettingsOutput,
+                       QmiClientWds,
+                       QmiMessageWdsGetProfileSettingsOutput,
+                       failed_finish,
+                       decltype (callback)> (NULL, NULL, qmi::detail::pack_callback (callback));
+    g_assert_cmpuint (n_calls, ==, 1);
+}
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/libqmi-glib-cxx/input",      test_cxx_input);
+    g_test_add_func ("/libqmi-glib-cxx/array-view", test_cxx_array_view);
+    g_test_add_func ("/libqmi-glib-cxx/error",      test_cxx_error);
+    g_test_add_func ("/libqmi-glib-cxx/callback",   test_cxx_callback);
+
+    return g_test_run ();
+}
@@ -32,50 +32,105 @@
 #include "qmi-device.h"
 #include "qmi-client.h"
 #include "qmi-proxy.h"
+#include "qmi-poller.h"
+#include "qmi-manager.h"
+#include "qmi-device-group.h"
 #include "qmi-message.h"
 #include "qmi-message-context.h"
+#include "qmi-schema.h"
+#include "qmi-trace.h"
 #include "qmi-enums.h"
 #include "qmi-utils.h"
+#include "qmi-charsets.h"
 
 #include "qmi-compat.h"
 
 #include "qmi-enums-dms.h"
 #include "qmi-flags64-dms.h"
+#if QMI_SERVICE_DMS_SUPPORTED
 #include "qmi-dms.h"
+#endif
 
 #include "qmi-flags64-nas.h"
 #include "qmi-enums-nas.h"
+#if QMI_SERVICE_NAS_SUPPORTED
 #include "qmi-nas.h"
+#include "qmi-nas-state-mirror.h"
+#include "qmi-nas-network-scan.h"
+#include "qmi-nas-cell-info.h"
+#endif
 
 #include "qmi-enums-wds.h"
+#if QMI_SERVICE_WDS_SUPPORTED
 #include "qmi-wds.h"
+#include "qmi-wds-stats-sampler.h"
+#include "qmi-wds-start-networks.h"
+#include "qmi-wds-profile-inventory.h"
+#include "qmi-wds-link.h"
+#endif
 
 #include "qmi-enums-wms.h"
+#if QMI_SERVICE_WMS_SUPPORTED
 #include "qmi-wms.h"
+#include "qmi-wms-sweep.h"
+#include "qmi-wms-pdu.h"
+#include "qmi-wms-delivery.h"
+#endif
 
 #include "qmi-enums-pds.h"
+#if QMI_SERVICE_PDS_SUPPORTED
 #include "qmi-pds.h"
+#include "qmi-pds-nmea-stream.h"
+#endif
 
 #include "qmi-enums-pdc.h"
+#if QMI_SERVICE_PDC_SUPPORTED
 #include "qmi-pdc.h"
+#include "qmi-pdc-load-config.h"
+#endif
 
 #include "qmi-enums-pbm.h"
+#if QMI_SERVICE_PBM_SUPPORTED
 #include "qmi-pbm.h"
+#include "qmi-pbm-read-phonebook.h"
+#endif
 
 #include "qmi-enums-uim.h"
+#if QMI_SERVICE_UIM_SUPPORTED
 #include "qmi-uim.h"
+#include "qmi-uim-read-file.h"
+#include "qmi-uim-card-status-cache.h"
+#endif
 
 #include "qmi-enums-oma.h"
+#if QMI_SERVICE_OMA_SUPPORTED
 #include "qmi-oma.h"
+#endif
 
 #include "qmi-enums-wda.h"
+#if QMI_SERVICE_WDA_SUPPORTED
 #include "qmi-wda.h"
+#endif
+
+#if QMI_SERVICE_WDS_SUPPORTED && QMI_SERVICE_WDA_SUPPORTED
+#include "qmi-wds-mux-sessions.h"
+#endif
+
+#if QMI_SERVICE_NAS_SUPPORTED && QMI_SERVICE_WDS_SUPPORTED
+#include "qmi-kpi-sampler.h"
+#endif
 
 #include "qmi-enums-voice.h"
+#if QMI_SERVICE_VOICE_SUPPORTED
 #include "qmi-voice.h"
+#include "qmi-voice-call-tracker.h"
+#endif
 
 #include "qmi-enums-loc.h"
+#if QMI_SERVICE_LOC_SUPPORTED
 #include "qmi-loc.h"
+#include "qmi-loc-session-mux.h"
+#endif
 
 /* generated */
 #include "qmi-error-types.h"
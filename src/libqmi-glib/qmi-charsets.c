@@ -0,0 +1,299 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <string.h>
+
+#include "qmi-charsets.h"
+
+/*****************************************************************************/
+/* UTF-8 output */
+
+/* Appends the given UTF-8 character to the output, unless it doesn't fit or
+ * the output was already truncated, always updating the total length */
+static inline void
+utf8_append (gchar       *out,
+             gsize        out_size,
+             gsize       *written,
+             gsize       *len,
+             const gchar *chars,
+             guint        n_chars)
+{
+    if (*written == *len && *written + n_chars < out_size) {
+        memcpy (&out[*written], chars, n_chars);
+        *written += n_chars;
+    }
+    *len += n_chars;
+}
+
+static inline void
+utf8_terminate (gchar *out,
+                gsize  out_size,
+                gsize  written)
+{
+    if (out_size > 0)
+        out[written] = '\0';
+}
+
+/*****************************************************************************/
+/* GSM 7-bit */
+
+typedef struct {
+    guint8 len;
+    gchar  chars[3];
+} GsmUtf8Mapping;
+
+#define ONE(a)       { 1, { (gchar)a, 0x00,     0x00 } }
+#define TWO(a, b)    { 2, { (gchar)a, (gchar)b, 0x00 } }
+#define THR(a, b, c) { 3, { (gchar)a, (gchar)b, (gchar)c } }
+
+/* ETSI GSM 03.38, version 6.0.1, section 6.2.1; Default alphabet. Mapping
+ * according to http://unicode.org/Public/MAPPINGS/ETSI/GSM0338.TXT, with the
+ * escape character decoded as a non-breaking space when not followed by a
+ * character of the extension table */
+static const GsmUtf8Mapping gsm_def_utf8_alphabet[128] = {
+    /* @             £                $                ¥   */
+    ONE(0x40),       TWO(0xc2, 0xa3), ONE(0x24),       TWO(0xc2, 0xa5),
+    /* è             é                ù                ì   */
+    TWO(0xc3, 0xa8), TWO(0xc3, 0xa9), TWO(0xc3, 0xb9), TWO(0xc3, 0xac),
+    /* ò             Ç                \n               Ø   */
+    TWO(0xc3, 0xb2), TWO(0xc3, 0x87), ONE(0x0a),       TWO(0xc3, 0x98),
+    /* ø             \r               Å                å   */
+    TWO(0xc3, 0xb8), ONE(0x0d),       TWO(0xc3, 0x85), TWO(0xc3, 0xa5),
+    /* Δ             _                Φ                Γ   */
+    TWO(0xce, 0x94), ONE(0x5f),       TWO(0xce, 0xa6), TWO(0xce, 0x93),
+    /* Λ             Ω                Π                Ψ   */
+    TWO(0xce, 0x9b), TWO(0xce, 0xa9), TWO(0xce, 0xa0), TWO(0xce, 0xa8),
+    /* Σ             Θ                Ξ                Escape Code */
+    TWO(0xce, 0xa3), TWO(0xce, 0x98), TWO(0xce, 0x9e), TWO(0xc2, 0xa0),
+    /* Æ             æ                ß                É   */
+    TWO(0xc3, 0x86), TWO(0xc3, 0xa6), TWO(0xc3, 0x9f), TWO(0xc3, 0x89),
+    /* ' '           !                "                #   */
+    ONE(0x20),       ONE(0x21),       ONE(0x22),       ONE(0x23),
+    /* ¤             %                &                '   */
+    TWO(0xc2, 0xa4), ONE(0x25),       ONE(0x26),       ONE(0x27),
+    /* (             )                *                +   */
+    ONE(0x28),       ONE(0x29),       ONE(0x2a),       ONE(0x2b),
+    /* ,             -                .                /   */
+    ONE(0x2c),       ONE(0x2d),       ONE(0x2e),       ONE(0x2f),
+    /* 0             1                2                3   */
+    ONE(0x30),       ONE(0x31),       ONE(0x32),       ONE(0x33),
+    /* 4             5                6                7   */
+    ONE(0x34),       ONE(0x35),       ONE(0x36),       ONE(0x37),
+    /* 8             9                :                ;   */
+    ONE(0x38),       ONE(0x39),       ONE(0x3a),       ONE(0x3b),
+    /* <             =                >                ?   */
+    ONE(0x3c),       ONE(0x3d),       ONE(0x3e),       ONE(0x3f),
+    /* ¡             A                B                C   */
+    TWO(0xc2, 0xa1), ONE(0x41),       ONE(0x42),       ONE(0x43),
+    /* D             E                F                G   */
+    ONE(0x44),       ONE(0x45),       ONE(0x46),       ONE(0x47),
+    /* H             I                J                K   */
+    ONE(0x48),       ONE(0x49),       ONE(0x4a),       ONE(0x4b),
+    /* L             M                N                O   */
+    ONE(0x4c),       ONE(0x4d),       ONE(0x4e),       ONE(0x4f),
+    /* P             Q                R                S   */
+    ONE(0x50),       ONE(0x51),       ONE(0x52),       ONE(0x53),
+    /* T             U                V                W   */
+    ONE(0x54),       ONE(0x55),       ONE(0x56),       ONE(0x57),
+    /* X             Y                Z                Ä   */
+    ONE(0x58),       ONE(0x59),       ONE(0x5a),       TWO(0xc3, 0x84),
+    /* Ö             Ñ                Ü                §   */
+    TWO(0xc3, 0x96), TWO(0xc3, 0x91), TWO(0xc3, 0x9c), TWO(0xc2, 0xa7),
+    /* ¿             a                b                c   */
+    TWO(0xc2, 0xbf), ONE(0x61),       ONE(0x62),       ONE(0x63),
+    /* d             e                f                g   */
+    ONE(0x64),       ONE(0x65),       ONE(0x66),       ONE(0x67),
+    /* h             i                j                k   */
+    ONE(0x68),       ONE(0x69),       ONE(0x6a),       ONE(0x6b),
+    /* l             m                n                o   */
+    ONE(0x6c),       ONE(0x6d),       ONE(0x6e),       ONE(0x6f),
+    /* p             q                r                s   */
+    ONE(0x70),       ONE(0x71),       ONE(0x72),       ONE(0x73),
+    /* t             u                v                w   */
+    ONE(0x74),       ONE(0x75),       ONE(0x76),       ONE(0x77),
+    /* x             y                z                ä   */
+    ONE(0x78),       ONE(0x79),       ONE(0x7a),       TWO(0xc3, 0xa4),
+    /* ö             ñ                ü                à   */
+    TWO(0xc3, 0xb6), TWO(0xc3, 0xb1), TWO(0xc3, 0xbc), TWO(0xc3, 0xa0)
+};
+
+/* Extension table, indexed by the character following the escape code; the
+ * entries not given have length 0 */
+static const GsmUtf8Mapping gsm_ext_utf8_alphabet[128] = {
+    [0x0a] = ONE(0x0c),             /* form feed */
+    [0x14] = ONE(0x5e),             /* ^ */
+    [0x28] = ONE(0x7b),             /* { */
+    [0x29] = ONE(0x7d),             /* } */
+    [0x2f] = ONE(0x5c),             /* \ */
+    [0x3c] = ONE(0x5b),             /* [ */
+    [0x3d] = ONE(0x7e),             /* ~ */
+    [0x3e] = ONE(0x5d),             /* ] */
+    [0x40] = ONE(0x7c),             /* | */
+    [0x65] = THR(0xe2, 0x82, 0xac), /* € */
+};
+
+#define GSM_ESCAPE_CHAR 0x1b
+
+/* Unpacks up to 8 septets from the given bytes, all loaded at once in a
+ * single word */
+static inline void
+gsm7_unpack_word (const guint8 *packed,
+                  guint         n_bytes,
+                  guint         n_septets,
+                  guint8       *out)
+{
+    guint64 word = 0;
+    guint   i;
+
+    memcpy (&word, packed, n_bytes);
+    word = GUINT64_FROM_LE (word);
+    for (i = 0; i < n_septets; i++)
+        out[i] = (guint8)((word >> (7 * i)) & 0x7F);
+}
+
+guint
+qmi_charset_gsm7_unpack (const guint8 *packed,
+                         gsize         packed_len,
+                         guint         n_septets,
+                         guint8       *out)
+{
+    guint i;
+
+    g_return_val_if_fail (packed != NULL || packed_len == 0, 0);
+    g_return_val_if_fail (out != NULL || n_septets == 0, 0);
+
+    /* Only unpack the septets fully available */
+    if (n_septets > (packed_len * 8) / 7)
+        n_septets = (guint)((packed_len * 8) / 7);
+
+    /* 8 septets in every 7 bytes */
+    for (i = 0; i + 8 <= n_septets; i += 8)
+        gsm7_unpack_word (&packed[(i / 8) * 7], 7, 8, &out[i]);
+
+    /* And the last ones, if any */
+    if (i < n_septets)
+        gsm7_unpack_word (&packed[(i / 8) * 7], ((n_septets - i) * 7 + 7) / 8, n_septets - i, &out[i]);
+
+    return n_septets;
+}
+
+gsize
+qmi_charset_gsm7_unpacked_to_utf8 (const guint8 *gsm,
+                                   gsize         gsm_len,
+                                   gchar        *out,
+                                   gsize         out_size)
+{
+    gsize written = 0;
+    gsize len = 0;
+    gsize i;
+
+    g_return_val_if_fail (gsm != NULL || gsm_len == 0, 0);
+    g_return_val_if_fail (out != NULL || out_size == 0, 0);
+
+    for (i = 0; i < gsm_len; i++) {
+        const GsmUtf8Mapping *mapping;
+
+        if (G_UNLIKELY (gsm[i] >= 128)) {
+            utf8_append (out, out_size, &written, &len, "?", 1);
+            continue;
+        }
+
+        mapping = &gsm_def_utf8_alphabet[gsm[i]];
+        if (G_UNLIKELY (gsm[i] == GSM_ESCAPE_CHAR) &&
+            (i + 1 < gsm_len) &&
+            (gsm[i + 1] < 128) &&
+            (gsm_ext_utf8_alphabet[gsm[i + 1]].len > 0)) {
+            mapping = &gsm_ext_utf8_alphabet[gsm[i + 1]];
+            i++;
+        }
+
+        utf8_append (out, out_size, &written, &len, mapping->chars, mapping->len);
+    }
+
+    utf8_terminate (out, out_size, written);
+    return len;
+}
+
+/*****************************************************************************/
+/* UCS-2 */
+
+static inline guint16
+ucs2_read (const guint8 *ucs2,
+           QmiEndian     endian)
+{
+    return (endian == QMI_ENDIAN_BIG ?
+            (guint16)((ucs2[0] << 8) | ucs2[1]) :
+            (guint16)((ucs2[1] << 8) | ucs2[0]));
+}
+
+gsize
+qmi_charset_ucs2_to_utf8 (const guint8 *ucs2,
+                          gsize         ucs2_len,
+                          QmiEndian     endian,
+                          gchar        *out,
+                          gsize         out_size)
+{
+    gsize written = 0;
+    gsize len = 0;
+    gsize i;
+
+    g_return_val_if_fail (ucs2 != NULL || ucs2_len == 0, 0);
+    g_return_val_if_fail (out != NULL || out_size == 0, 0);
+
+    for (i = 0; i + 2 <= ucs2_len; i += 2) {
+        gunichar c;
+        gchar    chars[4];
+        guint    n_chars;
+
+        c = ucs2_read (&ucs2[i], endian);
+
+        /* Plain ASCII, the most usual case */
+        if (G_LIKELY (c < 0x80)) {
+            if (c == 0)
+                break;
+            chars[0] = (gchar) c;
+            utf8_append (out, out_size, &written, &len, chars, 1);
+            continue;
+        }
+
+        if (c >= 0xD800 && c <= 0xDFFF) {
+            guint16 low;
+
+            /* Surrogate pair */
+            if (c <= 0xDBFF &&
+                i + 4 <= ucs2_len &&
+                (low = ucs2_read (&ucs2[i + 2], endian)) >= 0xDC00 &&
+                low <= 0xDFFF) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                i += 2;
+            } else
+                c = 0xFFFD;
+        }
+
+        n_chars = g_unichar_to_utf8 (c, chars);
+        utf8_append (out, out_size, &written, &len, chars, n_chars);
+    }
+
+    utf8_terminate (out, out_size, written);
+    return len;
+}
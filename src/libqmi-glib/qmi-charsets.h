@@ -0,0 +1,150 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_CHARSETS_H_
+#define _LIBQMI_GLIB_QMI_CHARSETS_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+#include "qmi-utils.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-charsets
+ * @title: Character sets
+ * @short_description: text decoding helpers
+ *
+ * Helpers to decode the text encodings found in QMI messages, e.g. in WMS
+ * raw messages, NAS operator names or USSD payloads, into UTF-8.
+ *
+ * The GSM 7-bit default alphabet and its extension table are decoded as
+ * given in 3GPP TS 23.038, and UCS-2 is decoded as UTF-16, so surrogate pairs
+ * are also accepted.
+ *
+ * None of these methods allocate memory: the output is written directly into
+ * a buffer given by the caller, which can be sized with
+ * QMI_CHARSET_GSM7_UTF8_SIZE() and QMI_CHARSET_UCS2_UTF8_SIZE() so that the
+ * output is never truncated.
+ */
+
+/**
+ * QMI_CHARSET_GSM7_UTF8_SIZE:
+ * @n_septets: number of unpacked GSM 7-bit characters.
+ *
+ * Size of the buffer needed to decode @n_septets GSM 7-bit characters into
+ * UTF-8, including the trailing NUL byte.
+ *
+ * Since: 1.20
+ */
+#define QMI_CHARSET_GSM7_UTF8_SIZE(n_septets) ((gsize)(n_septets) * 2 + 1)
+
+/**
+ * QMI_CHARSET_UCS2_UTF8_SIZE:
+ * @ucs2_len: size of the UCS-2 data, in bytes.
+ *
+ * Size of the buffer needed to decode @ucs2_len bytes of UCS-2 into UTF-8,
+ * including the trailing NUL byte.
+ *
+ * Since: 1.20
+ */
+#define QMI_CHARSET_UCS2_UTF8_SIZE(ucs2_len) (((gsize)(ucs2_len) / 2) * 3 + 1)
+
+/**
+ * qmi_charset_gsm7_unpack:
+ * @packed: GSM 7-bit packed data.
+ * @packed_len: size of @packed, in bytes.
+ * @n_septets: number of characters to unpack.
+ * @out: return location for the unpacked characters, with room for at least
+ *  @n_septets bytes.
+ *
+ * Unpacks GSM 7-bit characters, one character in each byte of @out.
+ *
+ * If @packed doesn't have enough data for @n_septets characters, only the
+ * ones fully available are unpacked.
+ *
+ * Returns: the number of characters unpacked.
+ *
+ * Since: 1.20
+ */
+guint qmi_charset_gsm7_unpack (const guint8 *packed,
+                               gsize         packed_len,
+                               guint         n_septets,
+                               guint8       *out);
+
+/**
+ * qmi_charset_gsm7_unpacked_to_utf8:
+ * @gsm: unpacked GSM 7-bit characters.
+ * @gsm_len: number of characters in @gsm.
+ * @out: return location for the UTF-8 string.
+ * @out_size: size of @out, in bytes.
+ *
+ * Decodes unpacked GSM 7-bit characters of the default alphabet and its
+ * extension table into a NUL-terminated UTF-8 string. Characters that cannot
+ * be decoded are replaced by '?'.
+ *
+ * If @out is not big enough, the string is truncated before the first
+ * character that doesn't fit, so that it is always valid UTF-8.
+ *
+ * Returns: the length of the whole UTF-8 string, not including the trailing
+ * NUL byte. If it is equal or greater than @out_size, the output was truncated.
+ *
+ * Since: 1.20
+ */
+gsize qmi_charset_gsm7_unpacked_to_utf8 (const guint8 *gsm,
+                                         gsize         gsm_len,
+                                         gchar        *out,
+                                         gsize         out_size);
+
+/**
+ * qmi_charset_ucs2_to_utf8:
+ * @ucs2: UCS-2 data.
+ * @ucs2_len: size of @ucs2, in bytes.
+ * @endian: byte order of @ucs2.
+ * @out: return location for the UTF-8 string.
+ * @out_size: size of @out, in bytes.
+ *
+ * Decodes UCS-2 data into a NUL-terminated UTF-8 string, stopping at the first
+ * NUL character if any. Unpaired surrogates are replaced by U+FFFD.
+ *
+ * If @out is not big enough, the string is truncated before the first
+ * character that doesn't fit, so that it is always valid UTF-8.
+ *
+ * Returns: the length of the whole UTF-8 string, not including the trailing
+ * NUL byte. If it is equal or greater than @out_size, the output was truncated.
+ *
+ * Since: 1.20
+ */
+gsize qmi_charset_ucs2_to_utf8 (const guint8 *ucs2,
+                                gsize         ucs2_len,
+                                QmiEndian     endian,
+                                gchar        *out,
+                                gsize         out_size);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_CHARSETS_H_ */
@@ -50,9 +50,45 @@ struct _QmiClientPrivate {
     guint version_major;
     guint version_minor;
 
-    guint16 transaction_id;
+    /* Accessed atomically, requests may be created from multiple threads */
+    gint transaction_id;
+
+    /* IDs of the indications to coalesce */
+    GArray *coalesced_indications;
+
+    /* Maximum number of indications pending to be reported, and what to do
+     * when exceeded; the limit is read and the drops counted from the
+     * context processing the input, so they're accessed atomically */
+    gint indication_queue_limit;
+    gint indication_overflow;
+    gint indication_drops;
+
+    /* Callbacks getting the raw indications; the ones removed while being
+     * run are only cleared, and dropped once done */
+    GArray *indication_callbacks;
+    guint next_indication_callback_id;
+    guint running_indication_callbacks;
+
+    /* Thread-default context when the client was created, where the
+     * indications are processed */
+    GMainContext *context;
+
+    /* Requests waiting for the indication with their reply, by indication
+     * id and token, and the token TLV of each indication id waited for */
+    GMutex      indication_replies_lock;
+    GHashTable *indication_replies;
+    GArray     *indication_reply_tokens;
+    gint        next_token;
 };
 
+typedef struct {
+    guint                       id;
+    guint16                     indication_id;
+    QmiClientIndicationCallback callback;
+    gpointer                    user_data;
+    GDestroyNotify              user_data_free;
+} IndicationCallback;
+
 /*****************************************************************************/
 
 GObject *
@@ -143,22 +179,474 @@ qmi_client_check_version (QmiClient *self,
 guint16
 qmi_client_get_next_transaction_id (QmiClient *self)
 {
-    guint16 next;
+    gint next;
+    gint updated;
 
     g_return_val_if_fail (QMI_IS_CLIENT (self), 0);
 
-    next = self->priv->transaction_id;
+    do {
+        next = g_atomic_int_get (&self->priv->transaction_id);
+
+        /* Don't go further than 8bits in the CTL service */
+        if ((self->priv->service == QMI_SERVICE_CTL &&
+             next == G_MAXUINT8) ||
+            next == G_MAXUINT16)
+            /* Reset! */
+            updated = 0x01;
+        else
+            updated = next + 1;
+    } while (!g_atomic_int_compare_and_exchange (&self->priv->transaction_id, next, updated));
+
+    return (guint16) next;
+}
+
+/*****************************************************************************/
+
+void
+qmi_client_set_indication_coalescing (QmiClient *self,
+                                      guint16    indication_id,
+                                      gboolean   enabled)
+{
+    guint i;
+
+    g_return_if_fail (QMI_IS_CLIENT (self));
+
+    if (!self->priv->coalesced_indications)
+        self->priv->coalesced_indications = g_array_new (FALSE, FALSE, sizeof (guint16));
+
+    for (i = 0; i < self->priv->coalesced_indications->len; i++) {
+        if (g_array_index (self->priv->coalesced_indications, guint16, i) == indication_id)
+            break;
+    }
+
+    if (enabled && i == self->priv->coalesced_indications->len)
+        g_array_append_val (self->priv->coalesced_indications, indication_id);
+    else if (!enabled && i < self->priv->coalesced_indications->len)
+        g_array_remove_index_fast (self->priv->coalesced_indications, i);
+}
+
+gboolean
+__qmi_client_get_indication_coalescing (QmiClient *self,
+                                        guint16    indication_id)
+{
+    guint i;
+
+    if (!self->priv->coalesced_indications)
+        return FALSE;
+
+    for (i = 0; i < self->priv->coalesced_indications->len; i++) {
+        if (g_array_index (self->priv->coalesced_indications, guint16, i) == indication_id)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/*****************************************************************************/
+
+void
+qmi_client_set_indication_queue_limit (QmiClient                   *self,
+                                       guint                        max_pending,
+                                       QmiClientIndicationOverflow  overflow)
+{
+    g_return_if_fail (QMI_IS_CLIENT (self));
+    g_return_if_fail (max_pending <= G_MAXINT);
+    g_return_if_fail (overflow <= QMI_CLIENT_INDICATION_OVERFLOW_COALESCE);
+
+    g_atomic_int_set (&self->priv->indication_overflow, (gint) overflow);
+    g_atomic_int_set (&self->priv->indication_queue_limit, (gint) max_pending);
+}
+
+guint
+qmi_client_get_indication_drops (QmiClient *self)
+{
+    g_return_val_if_fail (QMI_IS_CLIENT (self), 0);
+
+    return (guint) g_atomic_int_get (&self->priv->indication_drops);
+}
+
+guint
+__qmi_client_get_indication_queue_limit (QmiClient                   *self,
+                                         QmiClientIndicationOverflow *overflow)
+{
+    *overflow = (QmiClientIndicationOverflow) g_atomic_int_get (&self->priv->indication_overflow);
+    return (guint) g_atomic_int_get (&self->priv->indication_queue_limit);
+}
+
+void
+__qmi_client_add_indication_drop (QmiClient *self)
+{
+    g_atomic_int_inc (&self->priv->indication_drops);
+}
+
+/*****************************************************************************/
+
+static void
+indication_callback_clear (IndicationCallback *info)
+{
+    if (info->user_data_free)
+        info->user_data_free (info->user_data);
+}
+
+guint
+qmi_client_add_indication_callback (QmiClient                   *self,
+                                    guint16                      indication_id,
+                                    QmiClientIndicationCallback  callback,
+                                    gpointer                     user_data,
+                                    GDestroyNotify               user_data_free)
+{
+    IndicationCallback info;
+
+    g_return_val_if_fail (QMI_IS_CLIENT (self), 0);
+    g_return_val_if_fail (callback != NULL, 0);
+
+    if (!self->priv->indication_callbacks) {
+        self->priv->indication_callbacks = g_array_new (FALSE, FALSE, sizeof (IndicationCallback));
+        g_array_set_clear_func (self->priv->indication_callbacks, (GDestroyNotify) indication_callback_clear);
+    }
+
+    info.id = ++self->priv->next_indication_callback_id;
+    info.indication_id = indication_id;
+    info.callback = callback;
+    info.user_data = user_data;
+    info.user_data_free = user_data_free;
+    g_array_append_val (self->priv->indication_callbacks, info);
+
+    return info.id;
+}
+
+static void
+indication_callbacks_compact (QmiClient *self)
+{
+    guint i;
+
+    for (i = self->priv->indication_callbacks->len; i > 0; i--) {
+        if (!g_array_index (self->priv->indication_callbacks, IndicationCallback, i - 1).callback)
+            g_array_remove_index (self->priv->indication_callbacks, i - 1);
+    }
+}
+
+void
+qmi_client_remove_indication_callback (QmiClient *self,
+                                       guint      callback_id)
+{
+    guint i;
+
+    g_return_if_fail (QMI_IS_CLIENT (self));
+    g_return_if_fail (callback_id > 0);
+
+    if (!self->priv->indication_callbacks)
+        return;
+
+    for (i = 0; i < self->priv->indication_callbacks->len; i++) {
+        IndicationCallback *info;
+
+        info = &g_array_index (self->priv->indication_callbacks, IndicationCallback, i);
+        if (info->id != callback_id || !info->callback)
+            continue;
+
+        /* Never reshuffle the array while it's being iterated */
+        if (self->priv->running_indication_callbacks) {
+            info->callback = NULL;
+            return;
+        }
+        g_array_remove_index (self->priv->indication_callbacks, i);
+        return;
+    }
+
+    g_warning ("Unknown indication callback %u", callback_id);
+}
+
+void
+__qmi_client_run_indication_callbacks (QmiClient  *self,
+                                       QmiMessage *message)
+{
+    guint16 indication_id;
+    guint   n_callbacks;
+    guint   i;
+
+    if (!self->priv->indication_callbacks || !self->priv->indication_callbacks->len)
+        return;
+
+    indication_id = qmi_message_get_message_id (message);
+
+    g_object_ref (self);
+    self->priv->running_indication_callbacks++;
+    /* Callbacks added meanwhile are not run for this same indication */
+    n_callbacks = self->priv->indication_callbacks->len;
+    for (i = 0; i < n_callbacks; i++) {
+        IndicationCallback *info;
+
+        info = &g_array_index (self->priv->indication_callbacks, IndicationCallback, i);
+        if (info->indication_id == indication_id && info->callback)
+            info->callback (self, message, info->user_data);
+    }
+    if (--self->priv->running_indication_callbacks == 0)
+        indication_callbacks_compact (self);
+    g_object_unref (self);
+}
+
+/*****************************************************************************/
+/* Replies given in indications */
+
+typedef struct {
+    volatile gint               ref_count;
+    gint64                      key;
+    QmiClient                  *self;
+    GTask                      *task;
+    QmiClientIndicationReplyFn  callback;
+    GSource                    *timeout_source;
+    GSource                    *cancellable_source;
+} IndicationReply;
+
+typedef struct {
+    guint16 indication_id;
+    guint8  token_tlv;
+    guint   n_pending;
+} IndicationReplyToken;
+
+#define INDICATION_REPLY_KEY(indication_id, token) (((gint64) (indication_id) << 32) | (gint64) (token))
+
+static IndicationReply *
+indication_reply_ref (IndicationReply *reply)
+{
+    g_atomic_int_inc (&reply->ref_count);
+    return reply;
+}
+
+static void
+indication_reply_unref (IndicationReply *reply)
+{
+    if (g_atomic_int_dec_and_test (&reply->ref_count)) {
+        g_assert (!reply->task);
+        g_slice_free (IndicationReply, reply);
+    }
+}
+
+guint32
+__qmi_client_get_next_token (QmiClient *self)
+{
+    return (guint32) g_atomic_int_add (&self->priv->next_token, 1);
+}
+
+/* Must be called with the lock held */
+static IndicationReplyToken *
+indication_reply_token_lookup (QmiClient *self,
+                               guint16    indication_id)
+{
+    guint i;
+
+    if (!self->priv->indication_reply_tokens)
+        return NULL;
 
-    /* Don't go further than 8bits in the CTL service */
-    if ((self->priv->service == QMI_SERVICE_CTL &&
-         self->priv->transaction_id == G_MAXUINT8) ||
-        self->priv->transaction_id == G_MAXUINT16)
-        /* Reset! */
-        self->priv->transaction_id = 0x01;
+    for (i = 0; i < self->priv->indication_reply_tokens->len; i++) {
+        IndicationReplyToken *token;
+
+        token = &g_array_index (self->priv->indication_reply_tokens, IndicationReplyToken, i);
+        if (token->indication_id == indication_id)
+            return token;
+    }
+    return NULL;
+}
+
+/* Removes the reply from the table, returning it if it was still there; the
+ * reference of the table is transferred to the caller */
+static IndicationReply *
+indication_reply_steal (QmiClient *self,
+                        gint64     key)
+{
+    IndicationReply      *reply = NULL;
+    IndicationReplyToken *token;
+
+    g_mutex_lock (&self->priv->indication_replies_lock);
+    if (self->priv->indication_replies &&
+        (reply = g_hash_table_lookup (self->priv->indication_replies, &key)) != NULL) {
+        g_hash_table_steal (self->priv->indication_replies, &key);
+        token = indication_reply_token_lookup (self, (guint16) (key >> 32));
+        g_assert (token && token->n_pending > 0);
+        token->n_pending--;
+    }
+    g_mutex_unlock (&self->priv->indication_replies_lock);
+
+    return reply;
+}
+
+static void
+indication_reply_complete (IndicationReply *reply,
+                           QmiMessage      *indication,
+                           GError          *error)
+{
+    GTask *task;
+
+    if (reply->timeout_source) {
+        g_source_destroy (reply->timeout_source);
+        g_source_unref (reply->timeout_source);
+        reply->timeout_source = NULL;
+    }
+    if (reply->cancellable_source) {
+        g_source_destroy (reply->cancellable_source);
+        g_source_unref (reply->cancellable_source);
+        reply->cancellable_source = NULL;
+    }
+
+    task = reply->task;
+    reply->task = NULL;
+    if (indication)
+        reply->callback (reply->self, indication, task);
     else
-        self->priv->transaction_id++;
+        g_task_return_error (task, error);
+    g_object_unref (task);
+
+    indication_reply_unref (reply);
+}
 
-    return next;
+static gboolean
+indication_reply_timeout_cb (IndicationReply *reply)
+{
+    if (indication_reply_steal (reply->self, reply->key) == reply)
+        indication_reply_complete (reply,
+                                   NULL,
+                                   g_error_new (QMI_CORE_ERROR,
+                                                QMI_CORE_ERROR_TIMEOUT,
+                                                "Indication with the reply not received"));
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+indication_reply_cancelled_cb (GCancellable    *cancellable,
+                               IndicationReply *reply)
+{
+    if (indication_reply_steal (reply->self, reply->key) == reply)
+        indication_reply_complete (reply,
+                                   NULL,
+                                   g_error_new (G_IO_ERROR,
+                                                G_IO_ERROR_CANCELLED,
+                                                "Operation cancelled"));
+    return G_SOURCE_REMOVE;
+}
+
+gboolean
+__qmi_client_indication_reply_wait (QmiClient                  *self,
+                                    guint16                     indication_id,
+                                    guint8                      token_tlv,
+                                    guint32                     token,
+                                    guint                       timeout,
+                                    GCancellable               *cancellable,
+                                    QmiClientIndicationReplyFn  callback,
+                                    GTask                      *task)
+{
+    IndicationReply      *reply;
+    IndicationReplyToken *reply_token;
+
+    reply = g_slice_new0 (IndicationReply);
+    reply->ref_count = 1;
+    reply->key = INDICATION_REPLY_KEY (indication_id, token);
+    reply->self = self;
+    reply->callback = callback;
+
+    g_mutex_lock (&self->priv->indication_replies_lock);
+
+    if (!self->priv->indication_replies) {
+        self->priv->indication_replies = g_hash_table_new (g_int64_hash, g_int64_equal);
+        self->priv->indication_reply_tokens = g_array_new (FALSE, FALSE, sizeof (IndicationReplyToken));
+    }
+
+    /* The token is the only way to tell which request each indication is
+     * for, so it cannot be in use by two requests at the same time */
+    if (g_hash_table_contains (self->priv->indication_replies, &reply->key)) {
+        g_mutex_unlock (&self->priv->indication_replies_lock);
+        g_slice_free (IndicationReply, reply);
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_WRONG_STATE,
+                                 "Token %u already in use by another request",
+                                 token);
+        return FALSE;
+    }
+
+    reply_token = indication_reply_token_lookup (self, indication_id);
+    if (!reply_token) {
+        IndicationReplyToken new_token = { indication_id, token_tlv, 0 };
+
+        g_array_append_val (self->priv->indication_reply_tokens, new_token);
+        reply_token = &g_array_index (self->priv->indication_reply_tokens,
+                                      IndicationReplyToken,
+                                      self->priv->indication_reply_tokens->len - 1);
+    }
+    reply_token->n_pending++;
+
+    reply->task = g_object_ref (task);
+    g_hash_table_insert (self->priv->indication_replies, &reply->key, reply);
+
+    /* Both sources run in the context where the indications are processed,
+     * and each one keeps its own reference to the reply */
+    if (timeout > 0) {
+        reply->timeout_source = g_timeout_source_new_seconds (timeout);
+        g_source_set_callback (reply->timeout_source,
+                               (GSourceFunc) indication_reply_timeout_cb,
+                               indication_reply_ref (reply),
+                               (GDestroyNotify) indication_reply_unref);
+        g_source_attach (reply->timeout_source, self->priv->context);
+    }
+    if (cancellable) {
+        reply->cancellable_source = g_cancellable_source_new (cancellable);
+        g_source_set_callback (reply->cancellable_source,
+                               (GSourceFunc) indication_reply_cancelled_cb,
+                               indication_reply_ref (reply),
+                               (GDestroyNotify) indication_reply_unref);
+        g_source_attach (reply->cancellable_source, self->priv->context);
+    }
+
+    g_mutex_unlock (&self->priv->indication_replies_lock);
+    return TRUE;
+}
+
+void
+__qmi_client_indication_reply_abort (QmiClient *self,
+                                     guint16    indication_id,
+                                     guint32    token,
+                                     GError    *error)
+{
+    IndicationReply *reply;
+
+    /* The indication may have been received before the response */
+    reply = indication_reply_steal (self, INDICATION_REPLY_KEY (indication_id, token));
+    if (!reply) {
+        g_error_free (error);
+        return;
+    }
+    indication_reply_complete (reply, NULL, error);
+}
+
+static void
+indication_reply_process (QmiClient  *self,
+                          QmiMessage *message)
+{
+    IndicationReplyToken *reply_token;
+    IndicationReply      *reply;
+    guint16               indication_id;
+    guint8                token_tlv;
+    guint32               token;
+    gsize                 init_offset;
+    gsize                 offset = 0;
+
+    indication_id = qmi_message_get_message_id (message);
+
+    g_mutex_lock (&self->priv->indication_replies_lock);
+    reply_token = indication_reply_token_lookup (self, indication_id);
+    if (!reply_token || !reply_token->n_pending) {
+        g_mutex_unlock (&self->priv->indication_replies_lock);
+        return;
+    }
+    token_tlv = reply_token->token_tlv;
+    g_mutex_unlock (&self->priv->indication_replies_lock);
+
+    if ((init_offset = qmi_message_tlv_read_init (message, token_tlv, NULL, NULL)) == 0 ||
+        !qmi_message_tlv_read_guint32 (message, init_offset, &offset, QMI_ENDIAN_LITTLE, &token, NULL))
+        return;
+
+    reply = indication_reply_steal (self, INDICATION_REPLY_KEY (indication_id, token));
+    if (reply)
+        indication_reply_complete (reply, message, NULL);
 }
 
 /*****************************************************************************/
@@ -167,10 +655,122 @@ void
 __qmi_client_process_indication (QmiClient *self,
                                  QmiMessage *message)
 {
+    /* Requests waiting for this indication get it first, and then it's
+     * reported as any other one */
+    indication_reply_process (self, message);
+
     if (QMI_CLIENT_GET_CLASS (self)->process_indication)
         QMI_CLIENT_GET_CLASS (self)->process_indication (self, message);
 }
 
+GMainContext *
+__qmi_client_peek_context (QmiClient *self)
+{
+    return self->priv->context;
+}
+
+/*****************************************************************************/
+
+void
+__qmi_client_command_no_reply (QmiClient          *self,
+                               QmiMessage         *request,
+                               guint16             vendor_id,
+                               QmiMessagePriority  priority,
+                               guint               timeout,
+                               GCancellable       *cancellable)
+{
+    QmiMessageContext *context;
+
+    context = qmi_message_context_new ();
+    qmi_message_context_set_vendor_id (context, vendor_id);
+    qmi_message_context_set_priority (context, priority);
+    qmi_message_context_set_no_reply (context, TRUE);
+    qmi_device_command_full (QMI_DEVICE (qmi_client_peek_device (self)),
+                             request,
+                             context,
+                             timeout,
+                             cancellable,
+                             NULL,
+                             NULL);
+    qmi_message_context_unref (context);
+}
+
+/*****************************************************************************/
+/* Response parsing
+ *
+ * Responses parsed in a worker thread are handled by one pool shared by all
+ * clients. The task is completed from the worker, and GTask reports the
+ * result in the context of the caller. */
+
+#define PARSE_POOL_MAX_THREADS 4
+
+typedef struct {
+    GTask                    *task;
+    QmiMessage               *response;
+    QmiClientResponseParseFn  parse;
+    GDestroyNotify            output_free;
+} ParseJob;
+
+G_LOCK_DEFINE_STATIC (parse_pool);
+static GThreadPool *parse_pool;
+
+static void
+parse_response (GTask                    *task,
+                QmiMessage               *response,
+                QmiClientResponseParseFn  parse,
+                GDestroyNotify            output_free)
+{
+    gpointer  output;
+    GError   *error = NULL;
+
+    output = parse (response, &error);
+    if (!output)
+        g_task_return_error (task, error);
+    else
+        g_task_return_pointer (task, output, output_free);
+    g_object_unref (task);
+}
+
+static void
+parse_job_run (ParseJob *job,
+               gpointer  unused)
+{
+    parse_response (job->task, job->response, job->parse, job->output_free);
+    qmi_message_unref (job->response);
+    g_slice_free (ParseJob, job);
+}
+
+void
+__qmi_client_parse_response (QmiClient                *self,
+                             GTask                    *task,
+                             QmiMessage               *response,
+                             QmiClientResponseParseFn  parse,
+                             GDestroyNotify            output_free)
+{
+    ParseJob *job;
+
+    if (!self->priv->device || !__qmi_device_get_response_offload (self->priv->device, response)) {
+        parse_response (task, response, parse, output_free);
+        return;
+    }
+
+    G_LOCK (parse_pool);
+    if (!parse_pool)
+        parse_pool = g_thread_pool_new ((GFunc)parse_job_run,
+                                        NULL,
+                                        CLAMP (g_get_num_processors (), 1, PARSE_POOL_MAX_THREADS),
+                                        FALSE,
+                                        NULL);
+    G_UNLOCK (parse_pool);
+
+    job = g_slice_new (ParseJob);
+    job->task = task;
+    job->response = qmi_message_ref (response);
+    job->parse = parse;
+    job->output_free = output_free;
+    g_thread_pool_push (parse_pool, job, NULL);
+}
+
 /*****************************************************************************/
 
 static void
@@ -251,6 +851,32 @@ qmi_client_init (QmiClient *self)
     self->priv->cid = QMI_CID_NONE;
     self->priv->version_major = 0;
     self->priv->version_minor = 0;
+
+    self->priv->context = g_main_context_ref_thread_default ();
+
+    g_mutex_init (&self->priv->indication_replies_lock);
+    self->priv->next_token = 1;
+}
+
+static void
+finalize (GObject *object)
+{
+    QmiClient *self = QMI_CLIENT (object);
+
+    if (self->priv->coalesced_indications)
+        g_array_unref (self->priv->coalesced_indications);
+    if (self->priv->indication_callbacks)
+        g_array_unref (self->priv->indication_callbacks);
+    /* Each pending reply keeps a reference to the client through its task */
+    if (self->priv->indication_replies) {
+        g_assert (g_hash_table_size (self->priv->indication_replies) == 0);
+        g_hash_table_unref (self->priv->indication_replies);
+        g_array_unref (self->priv->indication_reply_tokens);
+    }
+    g_mutex_clear (&self->priv->indication_replies_lock);
+    g_main_context_unref (self->priv->context);
+
+    G_OBJECT_CLASS (qmi_client_parent_class)->finalize (object);
 }
 
 static void
@@ -262,6 +888,7 @@ qmi_client_class_init (QmiClientClass *klass)
 
     object_class->get_property = get_property;
     object_class->set_property = set_property;
+    object_class->finalize = finalize;
 
     /**
      * QmiClient:client-device:
@@ -28,6 +28,7 @@
 #endif
 
 #include <glib-object.h>
+#include <gio/gio.h>
 
 #include "qmi-enums.h"
 #include "qmi-message.h"
@@ -45,6 +46,11 @@ G_BEGIN_DECLS
  * These objects are created by a #QmiDevice with qmi_device_allocate_client(),
  * and before completely disposing them qmi_device_release_client() needs to be
  * called in order to release the unique client ID reserved.
+ *
+ * The indications received by a #QmiClient are processed, and their signals
+ * emitted, in the thread-default main context of the thread where the client
+ * was created, so clients created in different threads don't wait for each
+ * other to get their indications.
  */
 
 /**
@@ -269,12 +275,203 @@ gboolean qmi_client_check_version (QmiClient *self,
  */
 guint16 qmi_client_get_next_transaction_id (QmiClient *self);
 
+/**
+ * qmi_client_set_indication_coalescing:
+ * @self: A #QmiClient
+ * @indication_id: the ID of an indication message.
+ * @enabled: %TRUE to coalesce the indication, %FALSE otherwise.
+ *
+ * Configures whether multiple instances of the indication with ID
+ * @indication_id received before @self had the chance to process them should
+ * be coalesced, so that only the most recent one is reported.
+ *
+ * This is useful for indications that report a full snapshot of some state,
+ * e.g. signal quality updates, when only the latest one is relevant. Ordering
+ * with respect to other indications is kept, the coalesced indication is
+ * reported in the position of the first one received.
+ *
+ * Since: 1.20
+ */
+void qmi_client_set_indication_coalescing (QmiClient *self,
+                                           guint16    indication_id,
+                                           gboolean   enabled);
+
+/**
+ * QmiClientIndicationOverflow:
+ * @QMI_CLIENT_INDICATION_OVERFLOW_DROP_OLDEST: drop the oldest indication pending for the client.
+ * @QMI_CLIENT_INDICATION_OVERFLOW_DROP_NEWEST: drop the indication just received.
+ * @QMI_CLIENT_INDICATION_OVERFLOW_COALESCE: replace the oldest indication pending for the client with the same ID, or drop the oldest one if there is none.
+ *
+ * What to do with the indications received for a #QmiClient whose queue of
+ * indications pending to be reported is full.
+ *
+ * Since: 1.20
+ */
+typedef enum {
+    QMI_CLIENT_INDICATION_OVERFLOW_DROP_OLDEST = 0,
+    QMI_CLIENT_INDICATION_OVERFLOW_DROP_NEWEST = 1,
+    QMI_CLIENT_INDICATION_OVERFLOW_COALESCE    = 2,
+} QmiClientIndicationOverflow;
+
+/**
+ * qmi_client_indication_overflow_get_string:
+ *
+ * Since: 1.20
+ */
+
+/**
+ * qmi_client_set_indication_queue_limit:
+ * @self: A #QmiClient
+ * @max_pending: maximum number of indications pending to be reported to @self, or 0 for no limit.
+ * @overflow: a #QmiClientIndicationOverflow.
+ *
+ * Bounds the number of indications received for @self and not yet reported
+ * to it, e.g. because its main context is busy. Once @max_pending
+ * indications are pending, each new one is handled as given by @overflow,
+ * and the indications dropped are counted, see
+ * qmi_client_get_indication_drops().
+ *
+ * The limit applies to the indications received from now on. Indications
+ * given to the callbacks added with qmi_client_add_indication_callback() are
+ * never dropped, as these callbacks are run as soon as they are received.
+ *
+ * Since: 1.20
+ */
+void qmi_client_set_indication_queue_limit (QmiClient                   *self,
+                                            guint                        max_pending,
+                                            QmiClientIndicationOverflow  overflow);
+
+/**
+ * qmi_client_get_indication_drops:
+ * @self: A #QmiClient
+ *
+ * Gets the number of indications dropped, or replaced by a newer one,
+ * because the queue of indications pending to be reported to @self was
+ * full.
+ *
+ * Returns: the number of indications dropped.
+ *
+ * Since: 1.20
+ */
+guint qmi_client_get_indication_drops (QmiClient *self);
+
+/**
+ * QmiClientIndicationCallback:
+ * @self: a #QmiClient.
+ * @message: the indication #QmiMessage.
+ * @user_data: the user data given to qmi_client_add_indication_callback().
+ *
+ * Callback to get indications directly from the device, as raw messages.
+ *
+ * Since: 1.20
+ */
+typedef void (* QmiClientIndicationCallback) (QmiClient  *self,
+                                              QmiMessage *message,
+                                              gpointer    user_data);
+
+/**
+ * qmi_client_add_indication_callback:
+ * @self: A #QmiClient
+ * @indication_id: the ID of an indication message.
+ * @callback: a #QmiClientIndicationCallback.
+ * @user_data: user data to pass to @callback.
+ * @user_data_free: (allow-none): a #GDestroyNotify for @user_data, or %NULL.
+ *
+ * Registers @callback to get the indications with ID @indication_id
+ * reported to @self, as raw messages.
+ *
+ * The callback is called synchronously as soon as the device processes the
+ * indication, in the context where the device was opened, and before the
+ * indication is reported with the corresponding signal. The message is not
+ * parsed, so this is cheaper than connecting to the signal for indications
+ * received at a high rate (e.g. position reports); it can be read with
+ * qmi_message_get_raw_tlv() or the qmi_message_tlv_read_*() methods.
+ *
+ * Returns: an ID, greater than 0, to be used in
+ * qmi_client_remove_indication_callback().
+ *
+ * Since: 1.20
+ */
+guint qmi_client_add_indication_callback (QmiClient                   *self,
+                                          guint16                      indication_id,
+                                          QmiClientIndicationCallback  callback,
+                                          gpointer                     user_data,
+                                          GDestroyNotify               user_data_free);
+
+/**
+ * qmi_client_remove_indication_callback:
+ * @self: A #QmiClient
+ * @callback_id: the ID returned by qmi_client_add_indication_callback().
+ *
+ * Unregisters a callback added with qmi_client_add_indication_callback().
+ *
+ * This method may be called from within the callback itself.
+ *
+ * Since: 1.20
+ */
+void qmi_client_remove_indication_callback (QmiClient *self,
+                                            guint      callback_id);
+
 /* not part of the public API */
 
 #if defined (LIBQMI_GLIB_COMPILATION)
 G_GNUC_INTERNAL
+gboolean __qmi_client_get_indication_coalescing (QmiClient *self,
+                                                 guint16    indication_id);
+G_GNUC_INTERNAL
+guint __qmi_client_get_indication_queue_limit (QmiClient                   *self,
+                                               QmiClientIndicationOverflow *overflow);
+G_GNUC_INTERNAL
+void __qmi_client_add_indication_drop (QmiClient *self);
+G_GNUC_INTERNAL
 void __qmi_client_process_indication (QmiClient  *self,
                                       QmiMessage *message);
+G_GNUC_INTERNAL
+void __qmi_client_run_indication_callbacks (QmiClient  *self,
+                                            QmiMessage *message);
+G_GNUC_INTERNAL
+GMainContext *__qmi_client_peek_context (QmiClient *self);
+
+/* Requests whose actual reply is given in an indication, matched by a token
+ * echoed in it; the callback gets the indication to complete the task */
+typedef void (* QmiClientIndicationReplyFn) (QmiClient  *self,
+                                             QmiMessage *indication,
+                                             GTask      *task);
+G_GNUC_INTERNAL
+guint32 __qmi_client_get_next_token (QmiClient *self);
+G_GNUC_INTERNAL
+gboolean __qmi_client_indication_reply_wait (QmiClient                  *self,
+                                             guint16                     indication_id,
+                                             guint8                      token_tlv,
+                                             guint32                     token,
+                                             guint                       timeout,
+                                             GCancellable               *cancellable,
+                                             QmiClientIndicationReplyFn  callback,
+                                             GTask                      *task);
+G_GNUC_INTERNAL
+void __qmi_client_indication_reply_abort (QmiClient *self,
+                                          guint16    indication_id,
+                                          guint32    token,
+                                          GError    *error);
+G_GNUC_INTERNAL
+void __qmi_client_command_no_reply (QmiClient          *self,
+                                    QmiMessage         *request,
+                                    guint16             vendor_id,
+                                    QmiMessagePriority  priority,
+                                    guint               timeout,
+                                    GCancellable       *cancellable);
+
+/* Parses the response and completes the task (whose reference is taken)
+ * with the output, either right away or from a worker thread if the device
+ * offloads the parsing of the response */
+typedef gpointer (* QmiClientResponseParseFn) (QmiMessage  *response,
+                                               GError     **error);
+G_GNUC_INTERNAL
+void __qmi_client_parse_response (QmiClient                *self,
+                                  GTask                    *task,
+                                  QmiMessage               *response,
+                                  QmiClientResponseParseFn  parse,
+                                  GDestroyNotify            output_free);
 #endif
 
 G_END_DECLS
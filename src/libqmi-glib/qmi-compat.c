@@ -21,7 +21,7 @@
 
 #include "qmi-compat.h"
 
-#ifndef QMI_DISABLE_DEPRECATED
+#if !defined (QMI_DISABLE_DEPRECATED) && QMI_SERVICE_DMS_SUPPORTED
 
 gboolean
 qmi_message_dms_set_service_programming_code_input_get_new (
@@ -59,4 +59,4 @@ qmi_message_dms_set_service_programming_code_input_set_current (
   return qmi_message_dms_set_service_programming_code_input_set_current_code (self, arg_current, error);
 }
 
-#endif /* QMI_DISABLE_DEPRECATED */
+#endif /* !QMI_DISABLE_DEPRECATED && QMI_SERVICE_DMS_SUPPORTED */
@@ -26,7 +26,10 @@
 #error "Only <libqmi-glib.h> can be included directly."
 #endif
 
+#include "qmi-version.h"
+#if QMI_SERVICE_DMS_SUPPORTED
 #include "qmi-dms.h"
+#endif
 #include "qmi-enums-nas.h"
 #include "qmi-enums-wms.h"
 
@@ -41,6 +44,8 @@
 
 #ifndef QMI_DISABLE_DEPRECATED
 
+#if QMI_SERVICE_DMS_SUPPORTED
+
 /**
  * qmi_message_dms_set_service_programming_code_input_get_new:
  * @self: a #QmiMessageDmsSetServiceProgrammingCodeInput.
@@ -117,6 +122,8 @@ gboolean qmi_message_dms_set_service_programming_code_input_set_current (
     const gchar *arg_current,
     GError **error);
 
+#endif /* QMI_SERVICE_DMS_SUPPORTED */
+
 /* The following type exists just so that we can get deprecation warnings */
 G_DEPRECATED
 typedef int QmiDeprecatedNasSimRejectState;
@@ -0,0 +1,366 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <glib.h>
+
+#include "qmi-device-group.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+#include "qmi-enum-types.h"
+
+G_DEFINE_TYPE (QmiDeviceGroup, qmi_device_group, G_TYPE_OBJECT)
+
+/* Device not bound to any service yet */
+#define DEVICE_NONE G_MAXUINT
+
+struct _QmiDeviceGroupPrivate {
+    /* Open devices, full references */
+    GPtrArray *devices;
+
+    /* Index of the device each service is bound to, and the number of
+     * services bound to each device */
+    guint service_devices[G_MAXUINT8 + 1];
+    GArray *n_services;
+};
+
+/*****************************************************************************/
+
+static gboolean
+service_is_slow (QmiService service)
+{
+    switch (service) {
+    case QMI_SERVICE_UIM:
+    case QMI_SERVICE_PDC:
+    case QMI_SERVICE_PBM:
+    case QMI_SERVICE_WMS:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+static void
+bind_service (QmiDeviceGroup *self,
+              QmiService      service,
+              guint           index)
+{
+    guint previous;
+
+    previous = self->priv->service_devices[(guint8) service];
+    if (previous != DEVICE_NONE)
+        g_array_index (self->priv->n_services, guint, previous)--;
+
+    self->priv->service_devices[(guint8) service] = index;
+    g_array_index (self->priv->n_services, guint, index)++;
+
+    g_debug ("[%s] Service '%s' bound to device %u of the group",
+             qmi_device_get_path_display (g_ptr_array_index (self->priv->devices, index)),
+             qmi_service_get_string (service),
+             index);
+}
+
+static guint
+select_device (QmiDeviceGroup *self,
+               QmiService      service)
+{
+    guint n_devices;
+    guint selected = 0;
+    guint i;
+
+    n_devices = self->priv->devices->len;
+    if (n_devices == 1)
+        return 0;
+
+    /* Slow services all go to the last device... */
+    if (service_is_slow (service))
+        return n_devices - 1;
+
+    /* ...and the other ones to the remaining device with less services */
+    for (i = 1; i < n_devices - 1; i++) {
+        if (g_array_index (self->priv->n_services, guint, i) <
+            g_array_index (self->priv->n_services, guint, selected))
+            selected = i;
+    }
+    return selected;
+}
+
+guint
+qmi_device_group_get_n_devices (QmiDeviceGroup *self)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE_GROUP (self), 0);
+
+    return self->priv->devices->len;
+}
+
+QmiDevice *
+qmi_device_group_peek_device (QmiDeviceGroup *self,
+                              guint           index)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE_GROUP (self), NULL);
+    g_return_val_if_fail (index < self->priv->devices->len, NULL);
+
+    return g_ptr_array_index (self->priv->devices, index);
+}
+
+void
+qmi_device_group_set_service_device (QmiDeviceGroup *self,
+                                     QmiService      service,
+                                     guint           index)
+{
+    g_return_if_fail (QMI_IS_DEVICE_GROUP (self));
+    g_return_if_fail (index < self->priv->devices->len);
+
+    bind_service (self, service, index);
+}
+
+QmiDevice *
+qmi_device_group_peek_service_device (QmiDeviceGroup *self,
+                                      QmiService      service)
+{
+    guint index;
+
+    g_return_val_if_fail (QMI_IS_DEVICE_GROUP (self), NULL);
+
+    index = self->priv->service_devices[(guint8) service];
+    if (index == DEVICE_NONE) {
+        index = select_device (self, service);
+        bind_service (self, service, index);
+    }
+    return g_ptr_array_index (self->priv->devices, index);
+}
+
+/*****************************************************************************/
+/* Allocate client */
+
+QmiClient *
+qmi_device_group_allocate_client_finish (QmiDeviceGroup  *self,
+                                         GAsyncResult    *res,
+                                         GError         **error)
+{
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+static void
+allocate_client_ready (QmiDevice    *device,
+                       GAsyncResult *res,
+                       GTask        *task)
+{
+    QmiClient *client;
+    GError    *error = NULL;
+
+    client = qmi_device_allocate_client_finish (device, res, &error);
+    if (!client)
+        g_task_return_error (task, error);
+    else
+        g_task_return_pointer (task, client, g_object_unref);
+    g_object_unref (task);
+}
+
+void
+qmi_device_group_allocate_client (QmiDeviceGroup      *self,
+                                  QmiService           service,
+                                  guint8               cid,
+                                  guint                timeout,
+                                  GCancellable        *cancellable,
+                                  GAsyncReadyCallback  callback,
+                                  gpointer             user_data)
+{
+    g_return_if_fail (QMI_IS_DEVICE_GROUP (self));
+
+    qmi_device_allocate_client (qmi_device_group_peek_service_device (self, service),
+                                service,
+                                cid,
+                                timeout,
+                                cancellable,
+                                (GAsyncReadyCallback) allocate_client_ready,
+                                g_task_new (self, cancellable, callback, user_data));
+}
+
+/*****************************************************************************/
+/* New device group */
+
+typedef struct {
+    GPtrArray *devices; /* One per file, NULL if failed */
+    guint      n_pending;
+    GError    *error;   /* The first one */
+} NewContext;
+
+typedef struct {
+    GTask *task;
+    guint  index;
+} NewDeviceContext;
+
+static void
+new_context_free (NewContext *ctx)
+{
+    g_ptr_array_unref (ctx->devices);
+    g_clear_error (&ctx->error);
+    g_slice_free (NewContext, ctx);
+}
+
+QmiDeviceGroup *
+qmi_device_group_new_finish (GAsyncResult  *res,
+                             GError       **error)
+{
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+static void
+device_new_shared_ready (GObject          *source,
+                         GAsyncResult     *res,
+                         NewDeviceContext *device_ctx)
+{
+    GTask          *task;
+    QmiDeviceGroup *self;
+    NewContext     *ctx;
+    QmiDevice      *device;
+    GError         *error = NULL;
+    guint           i;
+
+    task = device_ctx->task;
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    device = qmi_device_new_shared_finish (res, &error);
+    if (!device) {
+        g_debug ("couldn't open device in group: %s", error->message);
+        if (!ctx->error)
+            ctx->error = error;
+        else
+            g_error_free (error);
+    } else
+        g_ptr_array_index (ctx->devices, device_ctx->index) = device;
+    g_slice_free (NewDeviceContext, device_ctx);
+
+    if (--ctx->n_pending > 0) {
+        g_object_unref (task);
+        return;
+    }
+
+    /* Keep the order of the files, skipping the failed ones */
+    for (i = 0; i < ctx->devices->len; i++) {
+        if (g_ptr_array_index (ctx->devices, i)) {
+            g_ptr_array_add (self->priv->devices, g_ptr_array_index (ctx->devices, i));
+            g_ptr_array_index (ctx->devices, i) = NULL;
+        }
+    }
+
+    if (!self->priv->devices->len) {
+        g_task_return_error (task, ctx->error);
+        ctx->error = NULL;
+    } else {
+        g_array_set_size (self->priv->n_services, self->priv->devices->len);
+        g_task_return_pointer (task, g_object_ref (self), g_object_unref);
+    }
+    g_object_unref (task);
+}
+
+void
+qmi_device_group_new (GFile               **files,
+                      guint                 n_files,
+                      QmiDeviceOpenFlags    flags,
+                      guint                 timeout,
+                      GCancellable         *cancellable,
+                      GAsyncReadyCallback   callback,
+                      gpointer              user_data)
+{
+    QmiDeviceGroup *self;
+    GTask          *task;
+    NewContext     *ctx;
+    guint           i;
+
+    g_return_if_fail (files != NULL || n_files == 0);
+
+    self = QMI_DEVICE_GROUP (g_object_new (QMI_TYPE_DEVICE_GROUP, NULL));
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_object_unref (self);
+
+    if (!n_files) {
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_INVALID_ARGS,
+                                 "No devices given");
+        g_object_unref (task);
+        return;
+    }
+
+    ctx = g_slice_new0 (NewContext);
+    ctx->devices = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+    g_ptr_array_set_size (ctx->devices, n_files);
+    ctx->n_pending = n_files;
+    g_task_set_task_data (task, ctx, (GDestroyNotify) new_context_free);
+
+    /* All at the same time, each with its own reference to the task */
+    for (i = 0; i < n_files; i++) {
+        NewDeviceContext *device_ctx;
+
+        device_ctx = g_slice_new (NewDeviceContext);
+        device_ctx->task = g_object_ref (task);
+        device_ctx->index = i;
+        qmi_device_new_shared (files[i],
+                               flags,
+                               timeout,
+                               cancellable,
+                               (GAsyncReadyCallback) device_new_shared_ready,
+                               device_ctx);
+    }
+    g_object_unref (task);
+}
+
+/*****************************************************************************/
+
+static void
+qmi_device_group_init (QmiDeviceGroup *self)
+{
+    guint i;
+
+    self->priv = G_TYPE_INSTANCE_GET_PRIVATE ((self),
+                                              QMI_TYPE_DEVICE_GROUP,
+                                              QmiDeviceGroupPrivate);
+
+    self->priv->devices = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+    self->priv->n_services = g_array_new (FALSE, TRUE, sizeof (guint));
+    for (i = 0; i < G_N_ELEMENTS (self->priv->service_devices); i++)
+        self->priv->service_devices[i] = DEVICE_NONE;
+}
+
+static void
+finalize (GObject *object)
+{
+    QmiDeviceGroup *self = QMI_DEVICE_GROUP (object);
+
+    g_ptr_array_unref (self->priv->devices);
+    g_array_unref (self->priv->n_services);
+
+    G_OBJECT_CLASS (qmi_device_group_parent_class)->finalize (object);
+}
+
+static void
+qmi_device_group_class_init (QmiDeviceGroupClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    g_type_class_add_private (object_class, sizeof (QmiDeviceGroupPrivate));
+
+    object_class->finalize = finalize;
+}
@@ -0,0 +1,242 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_DEVICE_GROUP_H_
+#define _LIBQMI_GLIB_QMI_DEVICE_GROUP_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "qmi-device.h"
+#include "qmi-client.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-device-group
+ * @title: QmiDeviceGroup
+ * @short_description: clients of one modem spread across several control ports
+ *
+ * Some modems expose several QMI control ports, processed independently by
+ * the firmware. A #QmiDeviceGroup opens a #QmiDevice for each of them, with
+ * qmi_device_new_shared(), and allocates the clients of each service in one
+ * of them, so that slow operations in some services don't delay the requests
+ * of the other ones.
+ *
+ * Each service is bound to one single device the first time it is needed,
+ * unless set explicitly with qmi_device_group_set_service_device(). Services
+ * with usually slow operations (UIM, PDC, PBM and WMS) go to the last device,
+ * and all the other ones are spread across the remaining devices. With one
+ * single device, all the services use it.
+ *
+ * Devices removed are not replaced; the clients of their services fail as
+ * usual.
+ */
+
+#define QMI_TYPE_DEVICE_GROUP            (qmi_device_group_get_type ())
+#define QMI_DEVICE_GROUP(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), QMI_TYPE_DEVICE_GROUP, QmiDeviceGroup))
+#define QMI_DEVICE_GROUP_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  QMI_TYPE_DEVICE_GROUP, QmiDeviceGroupClass))
+#define QMI_IS_DEVICE_GROUP(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), QMI_TYPE_DEVICE_GROUP))
+#define QMI_IS_DEVICE_GROUP_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  QMI_TYPE_DEVICE_GROUP))
+#define QMI_DEVICE_GROUP_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  QMI_TYPE_DEVICE_GROUP, QmiDeviceGroupClass))
+
+typedef struct _QmiDeviceGroup QmiDeviceGroup;
+typedef struct _QmiDeviceGroupClass QmiDeviceGroupClass;
+typedef struct _QmiDeviceGroupPrivate QmiDeviceGroupPrivate;
+
+/**
+ * QmiDeviceGroup:
+ *
+ * The #QmiDeviceGroup structure contains private data and should only be
+ * accessed using the provided API.
+ *
+ * Since: 1.20
+ */
+struct _QmiDeviceGroup {
+    /*< private >*/
+    GObject parent;
+    QmiDeviceGroupPrivate *priv;
+};
+
+struct _QmiDeviceGroupClass {
+    /*< private >*/
+    GObjectClass parent;
+};
+
+GType qmi_device_group_get_type (void);
+
+/**
+ * qmi_device_group_new:
+ * @files: (array length=n_files): the #GFile of each control port of the modem.
+ * @n_files: number of elements in @files.
+ * @flags: mask of #QmiDeviceOpenFlags specifying how the devices should be opened.
+ * @timeout: maximum time, in seconds, to wait for each device to be opened.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously creates a #QmiDeviceGroup, opening all the devices at the
+ * same time.
+ *
+ * The group is created as long as any of the devices is opened; the ones that
+ * fail are left out, and the index of each of the other ones is the order
+ * they have in @files, skipping the failed ones.
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * qmi_device_group_new_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_group_new (GFile               **files,
+                           guint                 n_files,
+                           QmiDeviceOpenFlags    flags,
+                           guint                 timeout,
+                           GCancellable         *cancellable,
+                           GAsyncReadyCallback   callback,
+                           gpointer              user_data);
+
+/**
+ * qmi_device_group_new_finish:
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_group_new().
+ *
+ * Returns: (transfer full): a newly created #QmiDeviceGroup, or %NULL if @error is set. The returned value should be freed with g_object_unref().
+ *
+ * Since: 1.20
+ */
+QmiDeviceGroup *qmi_device_group_new_finish (GAsyncResult  *res,
+                                             GError       **error);
+
+/**
+ * qmi_device_group_get_n_devices:
+ * @self: a #QmiDeviceGroup.
+ *
+ * Gets the number of devices open in the group.
+ *
+ * Returns: the number of devices.
+ *
+ * Since: 1.20
+ */
+guint qmi_device_group_get_n_devices (QmiDeviceGroup *self);
+
+/**
+ * qmi_device_group_peek_device:
+ * @self: a #QmiDeviceGroup.
+ * @index: the index of the device, lower than qmi_device_group_get_n_devices().
+ *
+ * Gets one of the devices of the group, without increasing the reference
+ * count on the returned object.
+ *
+ * Returns: (transfer none): a #QmiDevice. Do not free the returned object, it is owned by @self.
+ *
+ * Since: 1.20
+ */
+QmiDevice *qmi_device_group_peek_device (QmiDeviceGroup *self,
+                                         guint           index);
+
+/**
+ * qmi_device_group_set_service_device:
+ * @self: a #QmiDeviceGroup.
+ * @service: a #QmiService.
+ * @index: the index of the device, lower than qmi_device_group_get_n_devices().
+ *
+ * Binds @service to the device at @index, for the clients allocated from now
+ * on. Clients already allocated are not moved.
+ *
+ * Since: 1.20
+ */
+void qmi_device_group_set_service_device (QmiDeviceGroup *self,
+                                          QmiService      service,
+                                          guint           index);
+
+/**
+ * qmi_device_group_peek_service_device:
+ * @self: a #QmiDeviceGroup.
+ * @service: a #QmiService.
+ *
+ * Gets the device where the clients of @service are allocated, binding
+ * @service to one if not done yet, without increasing the reference count on
+ * the returned object.
+ *
+ * Returns: (transfer none): a #QmiDevice. Do not free the returned object, it is owned by @self.
+ *
+ * Since: 1.20
+ */
+QmiDevice *qmi_device_group_peek_service_device (QmiDeviceGroup *self,
+                                                 QmiService      service);
+
+/**
+ * qmi_device_group_allocate_client:
+ * @self: a #QmiDeviceGroup.
+ * @service: a valid #QmiService.
+ * @cid: a valid client ID, or #QMI_CID_NONE.
+ * @timeout: maximum time to wait.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously allocates a new #QmiClient in the device given by
+ * qmi_device_group_peek_service_device(), as with
+ * qmi_device_allocate_client().
+ *
+ * The client is released as usual with qmi_device_release_client(), using
+ * the device given by qmi_client_peek_device().
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * qmi_device_group_allocate_client_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_group_allocate_client (QmiDeviceGroup      *self,
+                                       QmiService           service,
+                                       guint8               cid,
+                                       guint                timeout,
+                                       GCancellable        *cancellable,
+                                       GAsyncReadyCallback  callback,
+                                       gpointer             user_data);
+
+/**
+ * qmi_device_group_allocate_client_finish:
+ * @self: a #QmiDeviceGroup.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_group_allocate_client().
+ *
+ * Returns: (transfer full): a newly allocated #QmiClient, or %NULL if @error is set.
+ *
+ * Since: 1.20
+ */
+QmiClient *qmi_device_group_allocate_client_finish (QmiDeviceGroup  *self,
+                                                    GAsyncResult    *res,
+                                                    GError         **error);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_DEVICE_GROUP_H_ */
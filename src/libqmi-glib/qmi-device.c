@@ -23,16 +23,23 @@
 
 #include <config.h>
 
+#define _GNU_SOURCE
 #include <stdio.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <string.h>
 #include <fcntl.h>
 #include <termios.h>
 #include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <gio/gio.h>
 #include <gio/gunixinputstream.h>
 #include <gio/gunixoutputstream.h>
 #include <gio/gunixsocketaddress.h>
+#if defined HAVE_DLADDR
+# include <dlfcn.h>
+#endif
 
 #if defined MBIM_QMUX_ENABLED
 #include <libmbim-glib.h>
@@ -40,23 +47,54 @@
 
 #include "qmi-device.h"
 #include "qmi-message.h"
+#include "qmi-version.h"
 #include "qmi-ctl.h"
+#if QMI_SERVICE_DMS_SUPPORTED
 #include "qmi-dms.h"
+#endif
+#if QMI_SERVICE_WDS_SUPPORTED
 #include "qmi-wds.h"
+#endif
+#if QMI_SERVICE_NAS_SUPPORTED
 #include "qmi-nas.h"
+#endif
+#if QMI_SERVICE_WMS_SUPPORTED
 #include "qmi-wms.h"
+#endif
+#if QMI_SERVICE_PDC_SUPPORTED
 #include "qmi-pdc.h"
+#endif
+#if QMI_SERVICE_PDS_SUPPORTED
 #include "qmi-pds.h"
+#endif
+#if QMI_SERVICE_PBM_SUPPORTED
 #include "qmi-pbm.h"
+#endif
+#if QMI_SERVICE_UIM_SUPPORTED
 #include "qmi-uim.h"
+#endif
+#if QMI_SERVICE_OMA_SUPPORTED
 #include "qmi-oma.h"
+#endif
+#if QMI_SERVICE_WDA_SUPPORTED
 #include "qmi-wda.h"
+#endif
+#if QMI_SERVICE_VOICE_SUPPORTED
 #include "qmi-voice.h"
+#endif
+#if QMI_SERVICE_LOC_SUPPORTED
 #include "qmi-loc.h"
+#endif
 #include "qmi-utils.h"
 #include "qmi-error-types.h"
 #include "qmi-enum-types.h"
 #include "qmi-proxy.h"
+#include "qmi-probes.h"
+#include "qmi-io-uring.h"
+#include "qmi-transaction-table.h"
+#include "qmi-mux-links.h"
+#include "qmi-qrtr.h"
+#include "qmi-low-power.h"
 
 static void async_initable_iface_init (GAsyncInitableIface *iface);
 
@@ -71,18 +109,41 @@ enum {
     PROP_NO_FILE_CHECK,
     PROP_PROXY_PATH,
     PROP_WWAN_IFACE,
+    PROP_MAX_IN_FLIGHT,
+    PROP_VERSION_INFO_CACHE_DIR,
+    PROP_CID_POOL,
+    PROP_CID_POOL_FILE,
+    PROP_COALESCE_REQUESTS,
+    PROP_RESPONSE_CACHE,
+    PROP_INDICATION_CACHE,
+    PROP_ADAPTIVE_TIMEOUTS,
+    PROP_HEALTH_CHECK,
+    PROP_REMOVAL_MONITOR,
+    PROP_IO_URING,
+    PROP_STALL_THRESHOLD,
+    PROP_SUSPEND_MONITOR,
+    PROP_OFFLOAD_THRESHOLD,
     PROP_LAST
 };
 
 enum {
     SIGNAL_INDICATION,
     SIGNAL_REMOVED,
+    SIGNAL_UNRESPONSIVE,
+    SIGNAL_CALLBACK_STALL,
     SIGNAL_LAST
 };
 
 static GParamSpec *properties[PROP_LAST];
 static guint       signals   [SIGNAL_LAST] = { 0 };
 
+/* Version of a service reported by the device */
+typedef struct {
+    gboolean supported;
+    guint16  major;
+    guint16  minor;
+} ServiceVersion;
+
 struct _QmiDevicePrivate {
     /* File */
     GFile *file;
@@ -93,38 +154,515 @@ struct _QmiDevicePrivate {
 
 #if defined MBIM_QMUX_ENABLED
     MbimDevice *mbimdev;
+    guint mbim_indication_id;
+    GQueue mbim_batch;
+    GSource *mbim_batch_source;
+#endif
+
+#if defined HAVE_LINUX_QRTR_H
+    /* QRTR node, if the device was given as a qrtr:// URI, and its
+     * transport when open */
+    gboolean qrtr;
+    guint32 qrtr_node_id;
+    QmiQrtrNode *qrtr_node;
 #endif
 
     /* WWAN interface */
     gboolean no_wwan_check;
     gchar *wwan_iface;
+    /* Multiplexed links of the WWAN interface, names indexed by mux ID */
+    GHashTable *mux_links;
 
     /* Implicit CTL client */
     QmiClientCtl *client_ctl;
     guint sync_indication_id;
 
-    /* Supported services */
+    /* Supported services, and their versions indexed by service (with the
+     * device-specific workarounds already applied) for the per-request
+     * checks */
     GArray *supported_services;
+    ServiceVersion service_versions[G_MAXUINT8 + 1];
+    gchar *version_info_cache_dir;
+
+    /* Released CIDs, to reuse */
+    gboolean cid_pool_enabled;
+    gchar *cid_pool_file;
+    GArray *cid_pool;
 
     /* I/O stream, set when the file is open */
     GInputStream *istream;
     GOutputStream *ostream;
     GSource *input_source;
     GByteArray *buffer;
+    guint buffer_offset;
+
+    /* io_uring engine, replacing both input and output sources */
+    gboolean io_uring_enabled;
+    QmiIoUringWatch *io_uring_watch;
+    gboolean dispatching_response;
+
+    /* Messages waiting to be written */
+    GQueue *output_queue;
+    gsize output_offset;
+    guint output_in_flight;
+    /* While not 0, messages are queued without writing them */
+    guint output_batching;
+    GSource *output_source;
 
     /* Support for qmi-proxy */
     GSocketClient *socket_client;
     GSocketConnection *socket_connection;
-
-    /* HT to keep track of ongoing transactions */
-    GHashTable *transactions;
+    /* Whether connected to a remote proxy, and if through TLS */
+    gboolean proxy_remote;
+    gboolean proxy_tls;
+    gboolean proxy_abort_supported;
+    gboolean proxy_indication_filter_supported;
+    gboolean proxy_transactions_supported;
+    gboolean proxy_stats_supported;
+    gboolean proxy_monitor_supported;
+
+    /* Table to keep track of ongoing transactions */
+    QmiTransactionTable transactions;
+
+    /* Whether identical idempotent requests are coalesced, and the sent
+     * transactions that others may be coalesced with, indexed by service,
+     * vendor, message id and TLV contents */
+    gboolean coalesce_requests;
+    GHashTable *coalesced_transactions;
+
+    /* Cached responses, indexed in the same way, if enabled */
+    gboolean response_cache_enabled;
+    GHashTable *response_cache;
+
+    /* Limits of requests sent without a response yet (0 if unlimited),
+     * and the transactions waiting to be sent because of them */
+    guint max_in_flight;
+    guint max_in_flight_by_service[G_MAXUINT8 + 1];
+    guint n_in_flight;
+    guint n_in_flight_by_service[G_MAXUINT8 + 1];
+    GQueue *throttled_transactions;
+    GSource *throttled_source;
+
+    /* Pool of unused transactions, recycled to avoid allocator churn; as
+     * the same memory (and key) may be reused by a newer transaction, each
+     * one gets a new generation number. Transactions are created in the I/O
+     * context, but may be released from the caller's context as well (e.g.
+     * when closing the device), so the pool has its own lock. */
+    GMutex transaction_pool_lock;
+    GPtrArray *transaction_pool;
+    guint transaction_generation;
+
+    /* Groups of transactions by cancellable, indexed by GCancellable */
+    GHashTable *cancellable_groups;
+
+    /* Transactions waiting for a timeout, sorted by deadline, and the single
+     * source used to fire all of them */
+    GSequence *transaction_timeouts;
+    GSource *transaction_timeout_source;
+
+    /* Last indication received of each kind kept for the new clients, if
+     * enabled, indexed by service and message ID. Protected by its own
+     * lock, as it's cleared when closing and may be queried from any
+     * thread. */
+    gboolean indication_cache_enabled;
+    GMutex indication_cache_lock;
+    GHashTable *indication_cache;
 
     /* HT of clients that want to get indications */
     GHashTable *registered_clients;
+
+    /* Registered clients indexed by service, to quickly find all the ones
+     * that need to get broadcast indications. References are owned by the
+     * registered clients HT. */
+    GPtrArray *registered_clients_by_service[G_MAXUINT8 + 1];
+
+    /* Indications pending to be reported to clients, in one queue per
+     * context where clients process them, indexed by GMainContext. The
+     * queues may be accessed from different threads, so they're protected
+     * by their own lock. */
+    GMutex pending_indications_lock;
+    GHashTable *pending_indications;
+
+    /* Dedicated I/O thread and context, if requested when opening; the
+     * owner context is the one where the device was opened */
+    GThread *io_thread;
+    GMainContext *io_context;
+    GMainLoop *io_loop;
+    GMainContext *owner_context;
+    /* Context where the device was last opened, where timeouts are handled
+     * if there's no I/O thread */
+    GMainContext *open_context;
+
+    /* Indications and completed transactions reported from the I/O thread
+     * to the owner context, all dispatched from one single idle, scheduled
+     * only when the queue is found empty */
+    GMutex owner_dispatch_lock;
+    GQueue owner_dispatch_queue;
+    gboolean owner_dispatch_scheduled;
+
+    /* Statistics, updated from the I/O context and protected by their own
+     * lock so that they can be queried from any thread. Per-message stats
+     * indexed by service and message ID. */
+    GMutex stats_lock;
+    QmiDeviceStats stats;
+    GHashTable *message_stats;
+    /* Snapshots of the in-flight requests and the queue lengths, updated
+     * atomically from the I/O context whenever they change */
+    gint stats_n_in_flight;
+    gint stats_output_queue_length;
+    gint stats_throttled_queue_length;
+
+    /* Callbacks running for longer than this, in milliseconds, are reported
+     * as stalls; 0 if not measured */
+    guint stall_threshold;
+
+    /* Responses parsed in a worker thread: the ones at least this large,
+     * in bytes, if not 0, and the ones of the messages in the set, indexed
+     * like the per-message stats. The set is protected by the stats lock,
+     * and only looked up if not empty. */
+    gint offload_threshold;
+    gint n_offloaded_messages;
+    GHashTable *offloaded_messages;
+
+    /* Timeouts derived from the observed latencies, indexed like the
+     * per-message stats, and also protected by the stats lock */
+    gboolean adaptive_timeouts_enabled;
+    gdouble adaptive_timeout_multiplier;
+    guint adaptive_timeout_min;
+    guint adaptive_timeout_max;
+    GHashTable *adaptive_timeouts;
+
+    /* Health check: CTL pings sent from the I/O context when nothing is
+     * received for a while, and the last time something was received or
+     * a request was sent with none other waiting for a response. Parameters
+     * protected by the stats lock. */
+    gboolean health_check_enabled;
+    guint health_check_idle_timeout;
+    guint health_check_stall_timeout;
+    guint health_check_ping_timeout;
+    GSource *health_check_source;
+    gboolean health_check_pinging;
+    gint64 last_activity_time;
+
+    /* Monitor of the device file, created in the context where the device
+     * is opened, if enabled; and whether the removal was already reported */
+    gboolean removal_monitor_enabled;
+    GFileMonitor *removal_monitor;
+    gboolean removal_reported;
+
+    /* Indication registrations sent by the clients, disabled while in
+     * low-power mode, see qmi-low-power.h */
+    QmiIndicationRegistrations *indication_registrations;
+
+    /* Monitor of the host suspend, created in the context where the device
+     * is opened, if enabled */
+    gboolean suspend_monitor_enabled;
+    QmiSuspendMonitor *suspend_monitor;
+
+    /* Binary trace function, if any */
+    QmiDeviceTraceFn trace_func;
+    gpointer trace_func_user_data;
+    GDestroyNotify trace_func_user_data_free;
+
+    /* Context where the device was created, driven from an external event
+     * loop with qmi_device_query() and qmi_device_dispatch(); acquired in
+     * between both */
+    GMainContext *context;
+    gboolean context_acquired;
+    gint context_max_priority;
 };
 
 #define BUFFER_SIZE 2048
 
+/* Max number of messages waiting to be written before new requests are
+ * rejected */
+#define OUTPUT_QUEUE_MAX_LENGTH 256
+
+/* Max number of messages written in one single syscall, when the
+ * underlying transport allows it */
+#define OUTPUT_MAX_VECTORS 16
+
+/* Max number of unused transactions kept around for reuse.
+ *
+ * Only the per-request bookkeeping owned by the device is pooled. Message
+ * buffers are not: QmiMessage is a public GByteArray whose last reference may
+ * be dropped by the user with g_byte_array_unref(), so the device never knows
+ * when a buffer could go back to a pool. Parsed outputs aren't allocated from
+ * an arena either, as they are public refcounted types released one by one;
+ * they already come from g_slice, which keeps per-thread magazines of
+ * same-sized blocks. */
+#define TRANSACTION_POOL_MAX_SIZE 32
+
+/* All I/O sources are attached to the dedicated I/O context, if any, or
+ * otherwise to the caller's thread-default context */
+static GMainContext *
+device_peek_io_context (QmiDevice *self)
+{
+    return (self->priv->io_context ? self->priv->io_context : g_main_context_get_thread_default ());
+}
+
+/* Must be called from the I/O context after changing the number of requests
+ * in flight or any of the queues */
+static void
+device_stats_update_lengths (QmiDevice *self)
+{
+    g_atomic_int_set (&self->priv->stats_n_in_flight, (gint) self->priv->n_in_flight);
+    g_atomic_int_set (&self->priv->stats_output_queue_length, (gint) g_queue_get_length (self->priv->output_queue));
+    g_atomic_int_set (&self->priv->stats_throttled_queue_length, (gint) g_queue_get_length (self->priv->throttled_transactions));
+}
+
+/* Timeouts are never handled in the context of whoever happens to need them
+ * first, as they apply to requests coming from any context */
+static GMainContext *
+device_peek_timeouts_context (QmiDevice *self)
+{
+    if (self->priv->io_context)
+        return self->priv->io_context;
+    if (self->priv->open_context)
+        return self->priv->open_context;
+    return g_main_context_get_thread_default ();
+}
+
+/* Whether messages can be sent, either through the I/O streams or through
+ * one of the other transports */
+static gboolean
+device_transport_ready (QmiDevice *self)
+{
+    if (self->priv->istream && self->priv->ostream)
+        return TRUE;
+#if defined MBIM_QMUX_ENABLED
+    if (self->priv->mbimdev)
+        return TRUE;
+#endif
+#if defined HAVE_LINUX_QRTR_H
+    if (self->priv->qrtr_node && __qmi_qrtr_node_is_open (self->priv->qrtr_node))
+        return TRUE;
+#endif
+    return FALSE;
+}
+
+/*****************************************************************************/
+/* Statistics */
+
+#define MESSAGE_STATS_KEY(service, message_id) \
+    GUINT_TO_POINTER (((guint)(service) << 16) | (guint)(message_id))
+
+/* Must be called with the stats lock held */
+static QmiDeviceMessageStats *
+device_peek_message_stats (QmiDevice *self,
+                           QmiMessage *message)
+{
+    QmiDeviceMessageStats *message_stats;
+    QmiService             service;
+    guint16                message_id;
+
+    service = __qmi_message_get_service (message);
+    message_id = __qmi_message_get_message_id (message);
+
+    message_stats = g_hash_table_lookup (self->priv->message_stats, MESSAGE_STATS_KEY (service, message_id));
+    if (!message_stats) {
+        message_stats = g_slice_new0 (QmiDeviceMessageStats);
+        message_stats->service = service;
+        message_stats->message_id = message_id;
+        g_hash_table_insert (self->priv->message_stats, MESSAGE_STATS_KEY (service, message_id), message_stats);
+    }
+    return message_stats;
+}
+
+static void
+message_stats_free (QmiDeviceMessageStats *message_stats)
+{
+    g_slice_free (QmiDeviceMessageStats, message_stats);
+}
+
+static void
+device_stats_frame (QmiDevice  *self,
+                    QmiMessage *message,
+                    gboolean    sent)
+{
+    guint len;
+
+    len = ((GByteArray *)message)->len;
+
+    g_mutex_lock (&self->priv->stats_lock);
+    if (sent) {
+        self->priv->stats.frames_sent++;
+        self->priv->stats.bytes_sent += len;
+        if (!__qmi_message_is_response (message) && !__qmi_message_is_indication (message)) {
+            self->priv->stats.n_requests++;
+            device_peek_message_stats (self, message)->n_requests++;
+        }
+    } else {
+        self->priv->stats.frames_received++;
+        self->priv->stats.bytes_received += len;
+        if (__qmi_message_is_indication (message)) {
+            self->priv->stats.n_indications++;
+            device_peek_message_stats (self, message)->n_indications++;
+        }
+    }
+    g_mutex_unlock (&self->priv->stats_lock);
+}
+
+/* Must be called with the stats lock held */
+static void
+device_adaptive_timeout_update (QmiDevice *self,
+                                QmiMessage *request,
+                                gint64      latency,
+                                gboolean    timed_out);
+
+static void
+device_stats_transaction (QmiDevice    *self,
+                          QmiMessage   *request,
+                          gint64        sent_time,
+                          gboolean      replied,
+                          const GError *error)
+{
+    QmiDeviceMessageStats *message_stats;
+
+    g_mutex_lock (&self->priv->stats_lock);
+    message_stats = device_peek_message_stats (self, request);
+    if (replied) {
+        self->priv->stats.n_responses++;
+        message_stats->n_responses++;
+        if (sent_time > 0) {
+            guint64 latency;
+            guint64 latency_ms;
+            guint   i;
+
+            latency = (guint64) (g_get_monotonic_time () - sent_time);
+            message_stats->latency_total += latency;
+            if (message_stats->n_responses == 1 || latency < message_stats->latency_min)
+                message_stats->latency_min = latency;
+            if (latency > message_stats->latency_max)
+                message_stats->latency_max = latency;
+
+            /* Bucket i counts latencies below 4^i ms, the last one all the rest */
+            latency_ms = latency / 1000;
+            for (i = 0; i < QMI_DEVICE_LATENCY_HISTOGRAM_SIZE - 1 && latency_ms >= (G_GUINT64_CONSTANT (1) << (2 * i)); i++);
+            message_stats->latency_histogram[i]++;
+
+            if (self->priv->adaptive_timeouts_enabled)
+                device_adaptive_timeout_update (self, request, (gint64) latency, FALSE);
+        }
+    } else if (g_error_matches (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TIMEOUT)) {
+        self->priv->stats.n_timeouts++;
+        message_stats->n_timeouts++;
+        if (self->priv->adaptive_timeouts_enabled)
+            device_adaptive_timeout_update (self, request, 0, TRUE);
+    } else if (g_error_matches (error, QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_ABORTED)) {
+        self->priv->stats.n_aborts++;
+        message_stats->n_aborts++;
+    }
+    g_mutex_unlock (&self->priv->stats_lock);
+}
+
+/*****************************************************************************/
+/* Adaptive timeouts */
+
+/* Latencies kept for each message, the most recent ones */
+#define ADAPTIVE_TIMEOUT_SAMPLES 64
+/* Latencies needed before the timeout given by the caller is overridden */
+#define ADAPTIVE_TIMEOUT_MIN_SAMPLES 8
+/* Percentile of the latencies the timeout is derived from */
+#define ADAPTIVE_TIMEOUT_PERCENTILE 99
+
+#define ADAPTIVE_TIMEOUT_MULTIPLIER_DEFAULT 4.0
+#define ADAPTIVE_TIMEOUT_MIN_DEFAULT        1000
+
+typedef struct {
+    guint32 samples[ADAPTIVE_TIMEOUT_SAMPLES]; /* milliseconds */
+    guint   n_samples;
+    guint   next_sample;
+    guint   timeout; /* milliseconds, 0 if not known yet */
+} AdaptiveTimeout;
+
+static void
+adaptive_timeout_free (AdaptiveTimeout *adaptive)
+{
+    g_slice_free (AdaptiveTimeout, adaptive);
+}
+
+static gint
+guint32_cmp (gconstpointer a,
+             gconstpointer b)
+{
+    guint32 va = *((const guint32 *) a);
+    guint32 vb = *((const guint32 *) b);
+
+    return (va < vb ? -1 : (va > vb ? 1 : 0));
+}
+
+static void
+device_adaptive_timeout_update (QmiDevice  *self,
+                                QmiMessage *request,
+                                gint64      latency,
+                                gboolean    timed_out)
+{
+    AdaptiveTimeout *adaptive;
+    gpointer         key;
+
+    key = MESSAGE_STATS_KEY (__qmi_message_get_service (request), __qmi_message_get_message_id (request));
+    adaptive = g_hash_table_lookup (self->priv->adaptive_timeouts, key);
+    if (!adaptive) {
+        adaptive = g_slice_new0 (AdaptiveTimeout);
+        g_hash_table_insert (self->priv->adaptive_timeouts, key, adaptive);
+    }
+
+    /* The device may just be slower than expected, so give it twice as much
+     * time on the next request, until real latencies tell otherwise */
+    if (timed_out) {
+        if (adaptive->timeout) {
+            adaptive->timeout = MAX (adaptive->timeout, self->priv->adaptive_timeout_min) * 2;
+            if (self->priv->adaptive_timeout_max)
+                adaptive->timeout = MIN (adaptive->timeout, self->priv->adaptive_timeout_max);
+        }
+        return;
+    }
+
+    adaptive->samples[adaptive->next_sample] = (guint32) MIN (latency / 1000, G_MAXUINT32);
+    adaptive->next_sample = (adaptive->next_sample + 1) % ADAPTIVE_TIMEOUT_SAMPLES;
+    if (adaptive->n_samples < ADAPTIVE_TIMEOUT_SAMPLES)
+        adaptive->n_samples++;
+
+    if (adaptive->n_samples >= ADAPTIVE_TIMEOUT_MIN_SAMPLES) {
+        guint32 sorted[ADAPTIVE_TIMEOUT_SAMPLES];
+        guint   i;
+
+        memcpy (sorted, adaptive->samples, adaptive->n_samples * sizeof (guint32));
+        qsort (sorted, adaptive->n_samples, sizeof (guint32), guint32_cmp);
+        i = (adaptive->n_samples * ADAPTIVE_TIMEOUT_PERCENTILE + 99) / 100 - 1;
+        /* Never 0, which means not known yet */
+        adaptive->timeout = (guint) CLAMP (sorted[i] * self->priv->adaptive_timeout_multiplier, 1.0, (gdouble) G_MAXUINT);
+    }
+}
+
+/* Timeout to use for the given request, in milliseconds */
+static guint
+device_get_effective_timeout (QmiDevice  *self,
+                              QmiMessage *request,
+                              guint       timeout)
+{
+    AdaptiveTimeout *adaptive;
+    guint            effective;
+    guint            max;
+
+    effective = timeout * 1000;
+    if (!self->priv->adaptive_timeouts_enabled || !timeout)
+        return effective;
+
+    g_mutex_lock (&self->priv->stats_lock);
+    adaptive = g_hash_table_lookup (self->priv->adaptive_timeouts,
+                                    MESSAGE_STATS_KEY (__qmi_message_get_service (request),
+                                                       __qmi_message_get_message_id (request)));
+    if (adaptive && adaptive->timeout) {
+        max = (self->priv->adaptive_timeout_max ? self->priv->adaptive_timeout_max : effective);
+        effective = MIN (MAX (adaptive->timeout, self->priv->adaptive_timeout_min), max);
+    }
+    g_mutex_unlock (&self->priv->stats_lock);
+
+    return effective;
+}
+
 /*****************************************************************************/
 /* Message transactions (private) */
 
@@ -133,2692 +671,9480 @@ typedef struct {
     gpointer key;
 } TransactionWaitContext;
 
+/* Completion of transactions from qmi_device_command_full_sync() */
 typedef struct {
+    GMutex      mutex;
+    GCond       cond;
+    gboolean    done;
+    QmiMessage *reply;
+    GError     *error;
+} CommandSyncContext;
+
+typedef struct _Transaction      Transaction;
+typedef struct _CancellableGroup CancellableGroup;
+
+struct _Transaction {
     QmiMessage             *message;
     QmiMessageContext      *message_context;
-    GSimpleAsyncResult     *result;
-    GSource                *timeout_source;
+    QmiMessagePriority      priority;
+    GTask                  *task;
+    CommandSyncContext     *sync_ctx;
+    GSequenceIter          *timeout_iter;
+    gint64                  timeout_deadline;
+    gint64                  issue_time;
+    gint64                  sent_time;
+    guint                   timeout;
+    gboolean                in_flight;
+    GList                  *throttled_link;
     GCancellable           *cancellable;
-    gulong                  cancellable_id;
-    TransactionWaitContext *wait_ctx;
-} Transaction;
+    /* Stored transactions with the same cancellable, linked in a group */
+    CancellableGroup       *cancellable_group;
+    Transaction            *cancellable_group_prev;
+    Transaction            *cancellable_group_next;
+    TransactionWaitContext  wait_ctx;
+    /* Unique among the transactions of the device, so that deferred lookups
+     * by key don't match a newer transaction with the same key */
+    guint                   generation;
+    /* Coalescing: key of a sent transaction, the identical transactions
+     * waiting for it, and, in those, the one they're waiting for */
+    GBytes                 *coalesce_key;
+    GSList                 *followers;
+    gpointer                coalesce_leader;
+    /* For how long the response may be cached, 0 if not at all */
+    guint                   cache_ttl;
+    /* Answered without sending the request (coalesced or cached) */
+    gboolean                not_sent;
+    /* The result is not reported to the caller */
+    gboolean                no_reply;
+};
+
+/* All the stored transactions with the same cancellable, so that a single
+ * handler is connected to it, and kept connected while the cancellable may
+ * be given in new requests */
+struct _CancellableGroup {
+    QmiDevice    *self;
+    GCancellable *cancellable;
+    gulong        cancellable_id;
+    Transaction  *transactions;
+    /* Transactions being aborted, the group cannot be removed */
+    guint         n_dispatching;
+};
+
+static void cancellable_group_remove (Transaction *tr);
+
+static void
+transaction_pool_free_item (Transaction *tr)
+{
+    g_slice_free (Transaction, tr);
+}
+
+static Transaction *
+transaction_pool_get (QmiDevice *self)
+{
+    Transaction *tr = NULL;
+    guint generation;
+
+    g_mutex_lock (&self->priv->transaction_pool_lock);
+    if (self->priv->transaction_pool && self->priv->transaction_pool->len > 0)
+        tr = g_ptr_array_remove_index_fast (self->priv->transaction_pool,
+                                            self->priv->transaction_pool->len - 1);
+    generation = ++self->priv->transaction_generation;
+    g_mutex_unlock (&self->priv->transaction_pool_lock);
+
+    if (tr)
+        memset (tr, 0, sizeof (Transaction));
+    else
+        tr = g_slice_new0 (Transaction);
+
+    tr->wait_ctx.self = self;
+    tr->generation = generation;
+    return tr;
+}
+
+static void
+transaction_pool_put (QmiDevice   *self,
+                      Transaction *tr)
+{
+    g_mutex_lock (&self->priv->transaction_pool_lock);
+    if (!self->priv->transaction_pool)
+        self->priv->transaction_pool = g_ptr_array_new_with_free_func ((GDestroyNotify)transaction_pool_free_item);
+
+    if (self->priv->transaction_pool->len < TRANSACTION_POOL_MAX_SIZE) {
+        g_ptr_array_add (self->priv->transaction_pool, tr);
+        tr = NULL;
+    }
+    g_mutex_unlock (&self->priv->transaction_pool_lock);
+
+    if (tr)
+        transaction_pool_free_item (tr);
+}
 
+static void device_schedule_throttled (QmiDevice *self);
+
+/* Takes ownership of the task; either a task or a sync context is given */
 static Transaction *
 transaction_new (QmiDevice           *self,
                  QmiMessage          *message,
                  QmiMessageContext   *message_context,
                  GCancellable        *cancellable,
-                 GAsyncReadyCallback  callback,
-                 gpointer             user_data)
+                 GTask               *task,
+                 CommandSyncContext  *sync_ctx)
 {
     Transaction *tr;
 
-    tr = g_slice_new0 (Transaction);
+    tr = transaction_pool_get (self);
+    __qmi_utils_live_object_add (QMI_UTILS_LIVE_OBJECT_TRANSACTION, 1);
     tr->message = qmi_message_ref (message);
     tr->message_context = (message_context ? qmi_message_context_ref (message_context) : NULL);
-    tr->result = g_simple_async_result_new (G_OBJECT (self),
-                                            callback,
-                                            user_data,
-                                            transaction_new);
+    if (message_context)
+        tr->priority = qmi_message_context_get_priority (message_context);
+    else if (qmi_message_get_service (message) == QMI_SERVICE_CTL)
+        tr->priority = QMI_MESSAGE_PRIORITY_HIGH;
+    else
+        tr->priority = QMI_MESSAGE_PRIORITY_NORMAL;
+    tr->task = task;
+    tr->sync_ctx = sync_ctx;
     if (cancellable)
         tr->cancellable = g_object_ref (cancellable);
+    tr->issue_time = g_get_monotonic_time ();
 
     return tr;
 }
 
-static void
-transaction_complete_and_free (Transaction *tr,
-                               QmiMessage *reply,
-                               const GError *error)
-{
-    g_assert (reply != NULL || error != NULL);
-
-    if (tr->timeout_source)
-        g_source_destroy (tr->timeout_source);
+typedef struct {
+    GTask      *task;
+    QmiMessage *reply;
+    GError     *error;
+} TransactionCompletion;
 
-    if (tr->cancellable) {
-        if (tr->cancellable_id)
-            g_cancellable_disconnect (tr->cancellable, tr->cancellable_id);
-        g_object_unref (tr->cancellable);
-    }
+/*****************************************************************************/
+/* Stall watchdog */
 
-    if (tr->wait_ctx)
-        g_slice_free (TransactionWaitContext, tr->wait_ctx);
+/* Details of the request kept in its task when the time spent in the
+ * callback is measured */
+typedef struct {
+    QmiService          service;
+    guint16             message_id;
+    GAsyncReadyCallback callback;
+} CallbackWatch;
 
-    if (reply)
-        g_simple_async_result_set_op_res_gpointer (tr->result,
-                                                   qmi_message_ref (reply),
-                                                   (GDestroyNotify)qmi_message_unref);
-    else
-        g_simple_async_result_set_from_error (tr->result, error);
+static GQuark callback_watch_quark;
 
-    g_simple_async_result_complete_in_idle (tr->result);
-    g_object_unref (tr->result);
-    if (tr->message_context)
-        qmi_message_context_unref (tr->message_context);
-    qmi_message_unref (tr->message);
-    g_slice_free (Transaction, tr);
+/* Exported symbol name of the callback, or its offset in the object file
+ * otherwise (e.g. static functions), to be resolved with addr2line */
+static gchar *
+build_callback_name (gpointer callback)
+{
+#if defined HAVE_DLADDR
+    Dl_info info;
+
+    if (dladdr (callback, &info)) {
+        if (info.dli_sname && info.dli_saddr == callback)
+            return g_strdup (info.dli_sname);
+        if (info.dli_fname) {
+            gchar *basename;
+            gchar *name;
+
+            basename = g_path_get_basename (info.dli_fname);
+            name = g_strdup_printf ("%s+0x%" G_GINTPTR_MODIFIER "x", basename,
+                                    (guintptr) callback - (guintptr) info.dli_fbase);
+            g_free (basename);
+            return name;
+        }
+    }
+#endif
+    return g_strdup_printf ("%p", callback);
 }
 
-static inline gpointer
-build_transaction_key (QmiMessage *message)
+/* Either @callback or @callback_name are given */
+static void
+callback_stall_check (QmiDevice   *self,
+                      gint64       start,
+                      QmiService   service,
+                      guint16      message_id,
+                      gpointer     callback,
+                      const gchar *callback_name)
 {
-    gpointer key;
-    guint8 service;
-    guint8 client_id;
-    guint16 transaction_id;
+    guint64  duration;
+    gchar   *name = NULL;
 
-    service = (guint8)qmi_message_get_service (message);
-    client_id = qmi_message_get_client_id (message);
-    transaction_id = qmi_message_get_transaction_id (message);
+    duration = (guint64) (g_get_monotonic_time () - start);
+    if (!self->priv->stall_threshold || duration < (guint64) self->priv->stall_threshold * 1000)
+        return;
 
-    /* We're putting a 32 bit value into a gpointer */
-    key = GUINT_TO_POINTER ((((service << 8) | client_id) << 16) | transaction_id);
+    g_mutex_lock (&self->priv->stats_lock);
+    self->priv->stats.n_callback_stalls++;
+    self->priv->stats.callback_stall_max = MAX (self->priv->stats.callback_stall_max, duration);
+    g_mutex_unlock (&self->priv->stats_lock);
 
-    return key;
+    if (callback)
+        callback_name = name = build_callback_name (callback);
+
+    g_debug ("[%s] Callback '%s' of message 0x%04x in service '%s' blocked its main context for %" G_GUINT64_FORMAT "ms",
+             self->priv->path_display, callback_name, message_id,
+             qmi_service_get_string (service), duration / 1000);
+    g_signal_emit (self, signals[SIGNAL_CALLBACK_STALL], 0,
+                   (guint) service, (guint) message_id, callback_name, duration);
+    g_free (name);
 }
 
-static Transaction *
-device_release_transaction (QmiDevice *self,
-                            gconstpointer key)
+static void
+transaction_task_return (GTask        *task,
+                         QmiMessage   *reply,
+                         const GError *error)
 {
-    Transaction *tr = NULL;
+    CallbackWatch *watch;
+    gint64         start = 0;
 
-    if (self->priv->transactions) {
-        tr = g_hash_table_lookup (self->priv->transactions, key);
-        if (tr)
-            /* If found, remove it from the HT */
-            g_hash_table_remove (self->priv->transactions, key);
-    }
+    watch = g_object_get_qdata (G_OBJECT (task), callback_watch_quark);
+    if (watch)
+        start = g_get_monotonic_time ();
 
-    return tr;
+    if (reply)
+        g_task_return_pointer (task, qmi_message_ref (reply), (GDestroyNotify)qmi_message_unref);
+    else
+        g_task_return_error (task, g_error_copy (error));
+
+    /* The task keeps a reference to the device */
+    if (watch)
+        callback_stall_check (QMI_DEVICE (g_task_get_source_object (task)), start,
+                              watch->service, watch->message_id, watch->callback, NULL);
 }
 
 static gboolean
-transaction_timed_out (TransactionWaitContext *ctx)
+transaction_complete_idle (TransactionCompletion *completion)
 {
-    Transaction *tr;
-    GError *error = NULL;
+    transaction_task_return (completion->task, completion->reply, completion->error);
+    g_object_unref (completion->task);
+    if (completion->reply)
+        qmi_message_unref (completion->reply);
+    if (completion->error)
+        g_error_free (completion->error);
+    g_slice_free (TransactionCompletion, completion);
+    return G_SOURCE_REMOVE;
+}
 
-    tr = device_release_transaction (ctx->self, ctx->key);
-    tr->timeout_source = NULL;
+/* Key to find identical requests, built from the service, vendor, message id
+ * and TLV contents */
+static GBytes *
+build_contents_key (QmiMessage        *message,
+                    QmiMessageContext *message_context)
+{
+    GByteArray   *key;
+    const guint8 *tlvs;
+    gsize         tlvs_length;
+    guint8        service;
+    guint16       vendor_id;
+    guint16       message_id;
+
+    service = (guint8) qmi_message_get_service (message);
+    vendor_id = (message_context ? qmi_message_context_get_vendor_id (message_context) : QMI_MESSAGE_VENDOR_GENERIC);
+    message_id = qmi_message_get_message_id (message);
+    tlvs = __qmi_message_peek_all_tlvs (message, &tlvs_length);
+
+    key = g_byte_array_sized_new (sizeof (service) + sizeof (vendor_id) + sizeof (message_id) + tlvs_length);
+    g_byte_array_append (key, &service, sizeof (service));
+    g_byte_array_append (key, (const guint8 *) &vendor_id, sizeof (vendor_id));
+    g_byte_array_append (key, (const guint8 *) &message_id, sizeof (message_id));
+    g_byte_array_append (key, tlvs, tlvs_length);
+    return g_byte_array_free_to_bytes (key);
+}
 
-    /* Complete transaction with a timeout error */
-    error = g_error_new (QMI_CORE_ERROR,
-                         QMI_CORE_ERROR_TIMEOUT,
-                         "Transaction timed out");
-    transaction_complete_and_free (tr, NULL, error);
-    g_error_free (error);
+/*****************************************************************************/
+/* Response cache */
 
-    return FALSE;
-}
+/* Max number of responses kept in the cache */
+#define RESPONSE_CACHE_MAX_SIZE 64
+
+typedef struct {
+    QmiMessage *response;
+    gint64      expiry;
+} ResponseCacheEntry;
 
 static void
-transaction_cancelled (GCancellable *cancellable,
-                       TransactionWaitContext *ctx)
+response_cache_entry_free (ResponseCacheEntry *entry)
 {
-    Transaction *tr;
-    GError *error = NULL;
-
-    tr = device_release_transaction (ctx->self, ctx->key);
+    qmi_message_unref (entry->response);
+    g_slice_free (ResponseCacheEntry, entry);
+}
 
-    /* The transaction may have already been cancelled before we stored it in
-     * the tracking table */
-    if (!tr)
+static void
+response_cache_clear (QmiDevice   *self,
+                      const gchar *reason)
+{
+    if (!g_hash_table_size (self->priv->response_cache))
         return;
 
-    tr->cancellable_id = 0;
-
-    /* Complete transaction with an abort error */
-    error = g_error_new (QMI_PROTOCOL_ERROR,
-                         QMI_PROTOCOL_ERROR_ABORTED,
-                         "Transaction aborted");
-    transaction_complete_and_free (tr, NULL, error);
-    g_error_free (error);
+    g_debug ("[%s] Response cache cleared: %s", self->priv->path_display, reason);
+    g_hash_table_remove_all (self->priv->response_cache);
 }
 
 static gboolean
-device_store_transaction (QmiDevice *self,
-                          Transaction *tr,
-                          guint timeout,
-                          GError **error)
+response_cache_entry_expired (gpointer            key,
+                              ResponseCacheEntry *entry,
+                              gint64             *now)
 {
-    gpointer     key;
-    Transaction *existing;
-
-    key = build_transaction_key (tr->message);
+    return (entry->expiry <= *now);
+}
 
-    /* Setup the timeout and cancellation */
+static gboolean
+response_is_success (QmiMessage *response)
+{
+    return (qmi_message_get_result_code (response) == QMI_PROTOCOL_ERROR_NONE);
+}
 
-    tr->wait_ctx = g_slice_new (TransactionWaitContext);
-    tr->wait_ctx->self = self;
-    tr->wait_ctx->key = key; /* valid as long as the transaction is in the HT */
+static void
+response_cache_store (QmiDevice   *self,
+                      Transaction *tr,
+                      QmiMessage  *response)
+{
+    ResponseCacheEntry *entry;
+    gint64              now;
 
-    /* Timeout is optional (e.g. disabled when MBIM is used) */
-    if (timeout > 0) {
-        tr->timeout_source = g_timeout_source_new_seconds (timeout);
-        g_source_set_callback (tr->timeout_source, (GSourceFunc)transaction_timed_out, tr->wait_ctx, NULL);
-        g_source_attach (tr->timeout_source, g_main_context_get_thread_default ());
-        g_source_unref (tr->timeout_source);
-    }
+    /* Errors may be transient, never cache them */
+    if (!response_is_success (response))
+        return;
 
-    if (tr->cancellable) {
-        /* Note: transaction_cancelled() will also be called directly if the
-         * cancellable is already cancelled */
-        tr->cancellable_id = g_cancellable_connect (tr->cancellable,
-                                                    (GCallback)transaction_cancelled,
-                                                    tr->wait_ctx,
-                                                    NULL);
-        if (!tr->cancellable_id) {
-            g_set_error (error,
-                         QMI_PROTOCOL_ERROR,
-                         QMI_PROTOCOL_ERROR_ABORTED,
-                         "Request is already cancelled");
-            return FALSE;
-        }
+    now = g_get_monotonic_time ();
+    if (g_hash_table_size (self->priv->response_cache) >= RESPONSE_CACHE_MAX_SIZE) {
+        g_hash_table_foreach_remove (self->priv->response_cache,
+                                     (GHRFunc)response_cache_entry_expired,
+                                     &now);
+        if (g_hash_table_size (self->priv->response_cache) >= RESPONSE_CACHE_MAX_SIZE)
+            return;
     }
 
-    /* If we have already a transaction with the same ID complete the existing
-     * one with an error before the new one is added, or we'll end up with
-     * dangling timeouts and cancellation handlers that may be fired off later
-     * on. */
-    existing = device_release_transaction (self, key);
-    if (existing) {
-        GError *inner_error;
+    entry = g_slice_new (ResponseCacheEntry);
+    entry->response = qmi_message_ref (response);
+    entry->expiry = now + ((gint64) tr->cache_ttl * G_USEC_PER_SEC);
+    g_hash_table_replace (self->priv->response_cache,
+                          build_contents_key (tr->message, tr->message_context),
+                          entry);
+}
 
-        /* Complete transaction with an abort error */
-        inner_error = g_error_new (QMI_PROTOCOL_ERROR,
-                                   QMI_PROTOCOL_ERROR_ABORTED,
-                                   "Transaction overwritten");
-        transaction_complete_and_free (existing, NULL, inner_error);
-        g_error_free (inner_error);
+static QmiMessage *
+response_cache_lookup (QmiDevice   *self,
+                       Transaction *tr)
+{
+    ResponseCacheEntry *entry;
+    GBytes             *key;
+    QmiMessage         *response = NULL;
+
+    key = build_contents_key (tr->message, tr->message_context);
+    entry = g_hash_table_lookup (self->priv->response_cache, key);
+    if (entry) {
+        if (entry->expiry <= g_get_monotonic_time ())
+            g_hash_table_remove (self->priv->response_cache, key);
+        else
+            /* Given as if it were the response to this same request */
+            response = __qmi_message_copy_for_transaction (entry->response,
+                                                           qmi_message_get_client_id (tr->message),
+                                                           qmi_message_get_transaction_id (tr->message));
     }
+    g_bytes_unref (key);
+    return response;
+}
+
+static gboolean
+response_cache_entry_is_wds_profile (gpointer            key,
+                                     ResponseCacheEntry *entry,
+                                     gpointer            unused)
+{
+    guint16 message_id;
 
-    /* Keep in the HT */
-    g_hash_table_insert (self->priv->transactions, key, tr);
+    if (qmi_message_get_service (entry->response) != QMI_SERVICE_WDS)
+        return FALSE;
 
-    return TRUE;
+    message_id = qmi_message_get_message_id (entry->response);
+    /* Get Profile List, Get Profile Settings */
+    return (message_id == 0x002A || message_id == 0x002B);
 }
 
-static Transaction *
-device_match_transaction (QmiDevice *self,
-                          QmiMessage *message)
+/* Requests changing the state of the whole device make all the cached
+ * responses useless, both when sent and once completed. Requests changing
+ * the profiles only make the cached profile responses useless. */
+static void
+response_cache_check_request (QmiDevice  *self,
+                              QmiMessage *request)
 {
-    /* msg can be either the original message or the response */
-    return device_release_transaction (self, build_transaction_key (message));
-}
+    if (qmi_message_get_service (request) == QMI_SERVICE_WDS) {
+        switch (qmi_message_get_message_id (request)) {
+        case 0x0027: /* Create Profile */
+        case 0x0028: /* Modify Profile */
+        case 0x0029: /* Delete Profile */
+            if (g_hash_table_foreach_remove (self->priv->response_cache,
+                                             (GHRFunc)response_cache_entry_is_wds_profile,
+                                             NULL))
+                g_debug ("[%s] Response cache of profiles cleared", self->priv->path_display);
+            break;
+        default:
+            break;
+        }
+        return;
+    }
 
-/*****************************************************************************/
-/* Version info request */
+    if (qmi_message_get_service (request) != QMI_SERVICE_DMS)
+        return;
 
-GArray *
-qmi_device_get_service_version_info_finish (QmiDevice *self,
-                                            GAsyncResult *res,
-                                            GError **error)
-{
-    return g_task_propagate_pointer (G_TASK (res), error);
+    switch (qmi_message_get_message_id (request)) {
+    case 0x0000: /* Reset */
+        response_cache_clear (self, "device reset");
+        break;
+    case 0x002E: /* Set Operating Mode */
+        response_cache_clear (self, "operating mode changed");
+        break;
+    case 0x003A: /* Restore Factory Defaults */
+        response_cache_clear (self, "factory defaults restored");
+        break;
+    default:
+        break;
+    }
 }
 
 static void
-version_info_ready (QmiClientCtl *client_ctl,
-                    GAsyncResult *res,
-                    GTask *task)
+response_cache_check_indication (QmiDevice  *self,
+                                 QmiMessage *indication)
 {
-    GArray *service_list = NULL;
-    GArray *out;
-    QmiMessageCtlGetVersionInfoOutput *output;
-    GError *error = NULL;
-    guint i;
+    /* DMS Event Report with the Operating Mode TLV */
+    if (qmi_message_get_service (indication) == QMI_SERVICE_DMS &&
+        qmi_message_get_message_id (indication) == 0x0001 &&
+        qmi_message_get_raw_tlv (indication, 0x14, NULL))
+        response_cache_clear (self, "operating mode changed");
+}
 
-    /* Check result of the async operation */
-    output = qmi_client_ctl_get_version_info_finish (client_ctl, res, &error);
-    if (!output) {
-        g_task_return_error (task, error);
-        g_object_unref (task);
+/*****************************************************************************/
+
+static void owner_dispatch_push (QmiDevice    *self,
+                                 GTask        *task,
+                                 QmiMessage   *message,
+                                 const GError *error);
+
+/* Returns the result to the caller of the transaction */
+static void
+transaction_return (QmiDevice          *self,
+                    GTask              *task,
+                    CommandSyncContext *sync_ctx,
+                    QmiMessage         *reply,
+                    const GError       *error)
+{
+    GMainContext          *caller_context;
+    TransactionCompletion *completion;
+    GSource               *source;
+
+    /* Synchronous requests just wake up the waiting thread, wherever the
+     * transaction is completed */
+    if (sync_ctx) {
+        g_mutex_lock (&sync_ctx->mutex);
+        sync_ctx->reply = (reply ? qmi_message_ref (reply) : NULL);
+        sync_ctx->error = (reply ? NULL : g_error_copy (error));
+        sync_ctx->done = TRUE;
+        g_cond_signal (&sync_ctx->cond);
+        g_mutex_unlock (&sync_ctx->mutex);
         return;
     }
 
-    /* Check result of the QMI operation */
-    if (!qmi_message_ctl_get_version_info_output_get_result (output, &error)) {
-        qmi_message_ctl_get_version_info_output_unref (output);
-        g_task_return_error (task, error);
+    /* Responses dispatched from the input source running in the context of
+     * the caller are completed right away. The input processing is ready to
+     * be re-entered by the callback (e.g. new requests, or even closing the
+     * device) and it keeps a reference to the device meanwhile. */
+    caller_context = g_task_get_context (task);
+    if (reply && self->priv->dispatching_response && g_main_context_is_owner (caller_context)) {
+        transaction_task_return (task, reply, NULL);
         g_object_unref (task);
         return;
     }
 
-    /* QMI operation succeeded, we can now get the outputs */
-    qmi_message_ctl_get_version_info_output_get_service_list (output, &service_list, NULL);
-    out = g_array_sized_new (FALSE, FALSE, sizeof (QmiDeviceServiceVersionInfo), service_list->len);
-    for (i = 0; i < service_list->len; i++) {
-        QmiMessageCtlGetVersionInfoOutputServiceListService *info;
-        QmiDeviceServiceVersionInfo outinfo;
-
-        info = &g_array_index (service_list,
-                               QmiMessageCtlGetVersionInfoOutputServiceListService,
-                               i);
-        outinfo.service = info->service;
-        outinfo.major_version = info->major_version;
-        outinfo.minor_version = info->minor_version;
-        g_array_append_val (out, outinfo);
+    /* Otherwise, complete in the context of the caller, which also gets our
+     * reference to the task, so that the device is never disposed from within
+     * the I/O thread, and so that the callback doesn't run while iterating
+     * the timeouts or from within g_cancellable_cancel(). Completions from
+     * the I/O thread to the owner context share the indications queue. */
+    if (self->priv->io_context && caller_context == self->priv->owner_context) {
+        owner_dispatch_push (self, task, reply, error);
+        return;
     }
 
-    qmi_message_ctl_get_version_info_output_unref (output);
-    g_task_return_pointer (task, out, (GDestroyNotify)g_array_unref);
-    g_object_unref (task);
-}
+    completion = g_slice_new (TransactionCompletion);
+    completion->task = task;
+    completion->reply = (reply ? qmi_message_ref (reply) : NULL);
+    completion->error = (error ? g_error_copy (error) : NULL);
 
-void
-qmi_device_get_service_version_info (QmiDevice *self,
-                                     guint timeout,
-                                     GCancellable *cancellable,
-                                     GAsyncReadyCallback callback,
-                                     gpointer user_data)
-{
-    qmi_client_ctl_get_version_info (
-        self->priv->client_ctl,
-        NULL,
-        timeout,
-        cancellable,
-        (GAsyncReadyCallback)version_info_ready,
-        g_task_new (self, cancellable, callback, user_data));
+    source = g_idle_source_new ();
+    g_source_set_callback (source, (GSourceFunc)transaction_complete_idle, completion, NULL);
+    g_source_attach (source, caller_context);
+    g_source_unref (source);
 }
 
-/*****************************************************************************/
-/* Version info checks (private) */
+static Transaction *device_release_transaction (QmiDevice     *self,
+                                                gconstpointer  key);
+static void         transaction_complete_and_free (Transaction  *tr,
+                                                   QmiMessage   *reply,
+                                                   const GError *error);
+static void         transaction_abort (QmiDevice   *self,
+                                       Transaction *tr);
 
-static const QmiMessageCtlGetVersionInfoOutputServiceListService *
-find_service_version_info (QmiDevice *self,
-                           QmiService service)
+static void
+transaction_complete_followers (QmiDevice    *self,
+                                GSList       *followers,
+                                QmiMessage   *reply,
+                                const GError *error)
 {
-    guint i;
-
-    if (!self->priv->supported_services)
-        return NULL;
+    GSList *l;
 
-    for (i = 0; i < self->priv->supported_services->len; i++) {
-        const QmiMessageCtlGetVersionInfoOutputServiceListService *info;
+    /* Detach all of them first, so that none can be completed on its own
+     * (e.g. cancelled) from within the callback of a previous one */
+    followers = g_slist_reverse (followers);
+    for (l = followers; l; l = g_slist_next (l)) {
+        Transaction *follower = l->data;
 
-        info = &g_array_index (self->priv->supported_services,
-                               QmiMessageCtlGetVersionInfoOutputServiceListService,
-                               i);
+        device_release_transaction (self, follower->wait_ctx.key);
+        follower->coalesce_leader = NULL;
+    }
 
-        if (service == info->service)
-            return info;
+    for (l = followers; l; l = g_slist_next (l)) {
+        Transaction *follower = l->data;
+        QmiMessage  *follower_reply = NULL;
+
+        /* Each one gets the response as if it was its own */
+        if (reply)
+            follower_reply = __qmi_message_copy_for_transaction (reply,
+                                                                 qmi_message_get_client_id (follower->message),
+                                                                 qmi_message_get_transaction_id (follower->message));
+        transaction_complete_and_free (follower, follower_reply, error);
+        if (follower_reply)
+            qmi_message_unref (follower_reply);
     }
 
-    return NULL;
+    g_slist_free (followers);
 }
 
-static gboolean
-check_service_supported (QmiDevice *self,
-                         QmiService service)
+static void
+transaction_complete_and_free (Transaction *tr,
+                               QmiMessage *reply,
+                               const GError *error)
 {
-    /* If we didn't check supported services, just assume it is supported */
-    if (!self->priv->supported_services) {
-        g_debug ("[%s] Assuming service '%s' is supported...",
-                 self->priv->path_display,
-                 qmi_service_get_string (service));
-        return TRUE;
-    }
+    QmiDevice          *self;
+    GTask              *task;
+    CommandSyncContext *sync_ctx;
 
-    return !!find_service_version_info (self, service);
-}
+    g_assert (reply != NULL || error != NULL);
 
-static gboolean
-check_message_supported (QmiDevice *self,
-                         QmiMessage *message,
-                         GError **error)
-{
-    const QmiMessageCtlGetVersionInfoOutputServiceListService *info;
-    guint message_major = 0;
-    guint message_minor = 0;
-    guint device_major = 0;
-    guint device_minor = 0;
+    self = tr->wait_ctx.self;
 
-    /* If we didn't check supported services, just assume it is supported */
-    if (!self->priv->supported_services)
-        return TRUE;
+    /* A coalesced transaction no longer waits for the one actually sent; if
+     * that one was already left without caller, it's not needed any more */
+    if (tr->coalesce_leader) {
+        Transaction *leader = tr->coalesce_leader;
 
-    /* For CTL, we assume all are supported */
-    if (qmi_message_get_service (message) == QMI_SERVICE_CTL)
-        return TRUE;
+        leader->followers = g_slist_remove (leader->followers, tr);
+        if (!leader->followers && !leader->task && !leader->sync_ctx)
+            transaction_abort (self, leader);
+    }
 
-    /* If we cannot get in which version this message was introduced, we'll just
-     * assume it's supported */
-    if (!qmi_message_get_version_introduced (message, &message_major, &message_minor))
-        return TRUE;
+    if (reply) {
+        if (tr->cache_ttl && !tr->not_sent)
+            response_cache_store (self, tr, reply);
+        response_cache_check_request (self, tr->message);
+    }
 
-    /* Get version info. It MUST exist because we allowed creating a client
-     * of this service type */
-    info = find_service_version_info (self, qmi_message_get_service (message));
-    g_assert (info != NULL);
-    g_assert (info->service == qmi_message_get_service (message));
-    device_major = info->major_version;
-    device_minor = info->minor_version;
+    /* Transactions coalesced with this one get the same result */
+    if (tr->coalesce_key) {
+        g_hash_table_remove (self->priv->coalesced_transactions, tr->coalesce_key);
+        g_bytes_unref (tr->coalesce_key);
+    }
+    if (tr->followers)
+        transaction_complete_followers (self, tr->followers, reply, error);
+
+    /* Release the in-flight slot, or remove from the queue of transactions
+     * waiting for one */
+    if (tr->in_flight) {
+        guint8 service;
+
+        service = (guint8) qmi_message_get_service (tr->message);
+        g_assert (self->priv->n_in_flight > 0);
+        g_assert (self->priv->n_in_flight_by_service[service] > 0);
+        self->priv->n_in_flight--;
+        self->priv->n_in_flight_by_service[service]--;
+        if (!g_queue_is_empty (self->priv->throttled_transactions))
+            device_schedule_throttled (self);
+        device_stats_update_lengths (self);
+    } else if (tr->throttled_link) {
+        g_queue_delete_link (self->priv->throttled_transactions, tr->throttled_link);
+        device_stats_update_lengths (self);
+    }
 
-    /* Some device firmware versions (Quectel EC21) lie about their supported
-     * DMS version, so assume a reasonable DMS version if the WDS version is
-     * high enough */
-    if (info->service == QMI_SERVICE_DMS && device_major == 1 && device_minor == 0) {
-        const QmiMessageCtlGetVersionInfoOutputServiceListService *wds;
+    /* Transactions not sent are not accounted */
+    if (!tr->not_sent)
+        device_stats_transaction (self, tr->message, tr->sent_time, !!reply, error);
 
-        wds = find_service_version_info (self, QMI_SERVICE_WDS);
-        g_assert (wds != NULL);
-        if (wds->major_version >= 1 && wds->minor_version >= 9) {
-            device_major = 1;
-            device_minor = 3;
-        }
+    /* Nobody will look at the result of these, so only keep track of the
+     * errors; the response is not even parsed, just its result code */
+    if (tr->no_reply && (!reply || !response_is_success (reply))) {
+        g_debug ("[%s] Request without reply (service %s, message 0x%04x) failed: %s",
+                 self->priv->path_display,
+                 qmi_service_get_string (qmi_message_get_service (tr->message)),
+                 qmi_message_get_message_id (tr->message),
+                 reply ? qmi_protocol_error_get_string ((QmiProtocolError) qmi_message_get_result_code (reply)) : error->message);
+        g_mutex_lock (&self->priv->stats_lock);
+        self->priv->stats.n_no_reply_errors++;
+        g_mutex_unlock (&self->priv->stats_lock);
     }
 
-    /* If the version of the message is greater than the version of the service,
-     * report unsupported */
-    if (message_major > device_major ||
-        (message_major == device_major &&
-         message_minor > device_minor)) {
-        g_set_error (error,
-                     QMI_CORE_ERROR,
-                     QMI_CORE_ERROR_UNSUPPORTED,
-                     "QMI service '%s' version '%u.%u' required, got version '%u.%u'",
-                     qmi_service_get_string (qmi_message_get_service (message)),
-                     message_major, message_minor,
-                     info->major_version,
-                     info->minor_version);
-        return FALSE;
+    /* The timeout source is not rescheduled here; if this was the next
+     * transaction to time out, the source will just find nothing to do
+     * when dispatched and reschedule itself */
+    if (tr->timeout_iter)
+        g_sequence_remove (tr->timeout_iter);
+
+    if (tr->cancellable) {
+        cancellable_group_remove (tr);
+        g_object_unref (tr->cancellable);
     }
 
-    /* Supported! */
-    return TRUE;
+    if (tr->message_context)
+        qmi_message_context_unref (tr->message_context);
+    qmi_message_unref (tr->message);
+
+    /* The task keeps a reference to the device, so recycle the transaction
+     * before releasing it */
+    task = tr->task;
+    sync_ctx = tr->sync_ctx;
+    transaction_pool_put (self, tr);
+    __qmi_utils_live_object_add (QMI_UTILS_LIVE_OBJECT_TRANSACTION, -1);
+
+    /* Transactions kept only for the coalesced ones have no caller */
+    if (task || sync_ctx)
+        transaction_return (self, task, sync_ctx, reply, error);
 }
 
-/*****************************************************************************/
+static inline gpointer
+build_transaction_key (QmiMessage *message)
+{
+    gpointer key;
+    guint8 service;
+    guint8 client_id;
+    guint16 transaction_id;
 
-GFile *
-qmi_device_get_file (QmiDevice *self)
+    service = (guint8)__qmi_message_get_service (message);
+    client_id = __qmi_message_get_client_id (message);
+    transaction_id = __qmi_message_get_transaction_id (message);
+
+    /* We're putting a 32 bit value into a gpointer */
+    key = GUINT_TO_POINTER ((((service << 8) | client_id) << 16) | transaction_id);
+
+    return key;
+}
+
+static Transaction *
+device_release_transaction (QmiDevice *self,
+                            gconstpointer key)
 {
-    GFile *file = NULL;
+    /* If found, remove it from the table */
+    return (Transaction *) __qmi_transaction_table_remove (&self->priv->transactions, GPOINTER_TO_UINT (key));
+}
 
-    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
+/* Lookup of a transaction referred to from a deferred operation, which
+ * may already be gone and its key used by a newer one */
+static Transaction *
+device_lookup_transaction_generation (QmiDevice     *self,
+                                      gconstpointer  key,
+                                      guint          generation)
+{
+    Transaction *tr;
 
-    g_object_get (G_OBJECT (self),
-                  QMI_DEVICE_FILE, &file,
-                  NULL);
-    return file;
+    tr = (Transaction *) __qmi_transaction_table_lookup (&self->priv->transactions, GPOINTER_TO_UINT (key));
+    return ((tr && tr->generation == generation) ? tr : NULL);
 }
 
-GFile *
-qmi_device_peek_file (QmiDevice *self)
+static gint
+transaction_timeout_cmp (Transaction *a,
+                         Transaction *b,
+                         gpointer     unused)
 {
-    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
+    return (a->timeout_deadline < b->timeout_deadline ? -1 :
+            (a->timeout_deadline > b->timeout_deadline ? 1 : 0));
+}
 
-    return self->priv->file;
+static void
+transaction_timeouts_reschedule (QmiDevice *self)
+{
+    GSequenceIter *first;
+
+    if (!self->priv->transaction_timeout_source)
+        return;
+
+    first = g_sequence_get_begin_iter (self->priv->transaction_timeouts);
+    if (g_sequence_iter_is_end (first))
+        g_source_set_ready_time (self->priv->transaction_timeout_source, -1);
+    else
+        g_source_set_ready_time (self->priv->transaction_timeout_source,
+                                 ((Transaction *) g_sequence_get (first))->timeout_deadline);
 }
 
-const gchar *
-qmi_device_get_path (QmiDevice *self)
+static void
+transaction_proxy_abort (QmiDevice   *self,
+                         Transaction *tr)
 {
-    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
+    QmiMessageCtlInternalProxyAbortInput *input;
+
+    /* When going through qmi-proxy, let it know we're no longer waiting for
+     * the response, so that it doesn't keep the request around in its own
+     * device. CTL requests are never aborted, the proxy needs to see all
+     * their responses. */
+    if (!self->priv->proxy_abort_supported ||
+        qmi_message_get_service (tr->message) == QMI_SERVICE_CTL ||
+        tr->not_sent)
+        return;
 
-    return self->priv->path;
+    input = qmi_message_ctl_internal_proxy_abort_input_new ();
+    qmi_message_ctl_internal_proxy_abort_input_set_transaction (input,
+                                                                qmi_message_get_service (tr->message),
+                                                                qmi_message_get_client_id (tr->message),
+                                                                qmi_message_get_transaction_id (tr->message),
+                                                                NULL);
+    qmi_client_ctl_internal_proxy_abort_no_reply (self->priv->client_ctl,
+                                                  input,
+                                                  5,
+                                                  NULL);
+    qmi_message_ctl_internal_proxy_abort_input_unref (input);
 }
 
-const gchar *
-qmi_device_get_path_display (QmiDevice *self)
+static gboolean
+transaction_timeouts_cb (QmiDevice *self)
 {
-    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
+    gint64 now;
 
-    return self->priv->path_display;
+    now = g_get_monotonic_time ();
+
+    /* Complete all the transactions that reached their deadline */
+    while (TRUE) {
+        GSequenceIter *first;
+        Transaction   *tr;
+        GError        *error;
+
+        first = g_sequence_get_begin_iter (self->priv->transaction_timeouts);
+        if (g_sequence_iter_is_end (first))
+            break;
+
+        tr = (Transaction *) g_sequence_get (first);
+        if (tr->timeout_deadline > now)
+            break;
+
+        device_release_transaction (self, tr->wait_ctx.key);
+        transaction_proxy_abort (self, tr);
+        QMI_PROBE_MESSAGE (transaction_timeout, tr->message);
+
+        /* Complete transaction with a timeout error */
+        error = g_error_new (QMI_CORE_ERROR,
+                             QMI_CORE_ERROR_TIMEOUT,
+                             "Transaction timed out");
+        transaction_complete_and_free (tr, NULL, error);
+        g_error_free (error);
+    }
+
+    transaction_timeouts_reschedule (self);
+    return G_SOURCE_CONTINUE;
 }
 
-gboolean
-qmi_device_is_open (QmiDevice *self)
+static gboolean
+transaction_timeout_source_dispatch (GSource     *source,
+                                     GSourceFunc  callback,
+                                     gpointer     user_data)
 {
-    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+    g_assert (callback != NULL);
+    return callback (user_data);
+}
 
-    return !!(self->priv->istream && self->priv->ostream);
+static GSourceFuncs transaction_timeout_source_funcs = {
+    NULL, /* prepare */
+    NULL, /* check */
+    transaction_timeout_source_dispatch,
+    NULL, /* finalize */
+};
+
+static void
+transaction_timeout_source_setup (QmiDevice *self)
+{
+    g_assert (!self->priv->transaction_timeout_source);
+    self->priv->transaction_timeout_source = g_source_new (&transaction_timeout_source_funcs, sizeof (GSource));
+    g_source_set_callback (self->priv->transaction_timeout_source, (GSourceFunc)transaction_timeouts_cb, self, NULL);
+    g_source_set_ready_time (self->priv->transaction_timeout_source, -1);
+    g_source_attach (self->priv->transaction_timeout_source, device_peek_timeouts_context (self));
 }
 
-/*****************************************************************************/
-/* WWAN iface name
- * Always reload from scratch, to handle possible net interface renames  */
+static void
+transaction_timeouts_add (QmiDevice   *self,
+                          Transaction *tr,
+                          guint        timeout_ms)
+{
+    GSequenceIter *first;
+
+    /* A single source per device takes care of all timeouts, armed to be
+     * ready when the earliest deadline is reached */
+    if (!self->priv->transaction_timeout_source)
+        transaction_timeout_source_setup (self);
+
+    tr->timeout_deadline = g_get_monotonic_time () + ((gint64) timeout_ms * 1000);
+    tr->timeout_iter = g_sequence_insert_sorted (self->priv->transaction_timeouts,
+                                                 tr,
+                                                 (GCompareDataFunc)transaction_timeout_cmp,
+                                                 NULL);
+
+    /* Only need to reschedule if this is the earliest one */
+    first = g_sequence_get_begin_iter (self->priv->transaction_timeouts);
+    if (first == tr->timeout_iter)
+        transaction_timeouts_reschedule (self);
+}
 
 static void
-reload_wwan_iface_name (QmiDevice *self)
+transaction_abort (QmiDevice   *self,
+                   Transaction *tr)
 {
-    const gchar *cdc_wdm_device_name;
-    static const gchar *driver_names[] = { "usbmisc", "usb" };
-    guint i;
+    GError *error;
 
-    /* Early cleanup */
-    g_free (self->priv->wwan_iface);
-    self->priv->wwan_iface = NULL;
+    error = g_error_new (QMI_PROTOCOL_ERROR,
+                         QMI_PROTOCOL_ERROR_ABORTED,
+                         "Transaction aborted");
 
-    cdc_wdm_device_name = strrchr (self->priv->path, '/');
-    if (!cdc_wdm_device_name) {
-        g_warning ("[%s] invalid path for cdc-wdm control port", self->priv->path_display);
+    /* If there are other transactions coalesced with this one, the request
+     * goes on for them; only its caller gets the abort error */
+    if (tr->followers) {
+        if (tr->cancellable) {
+            cancellable_group_remove (tr);
+            g_clear_object (&tr->cancellable);
+        }
+        if (tr->task || tr->sync_ctx) {
+            transaction_return (self, tr->task, tr->sync_ctx, NULL, error);
+            tr->task = NULL;
+            tr->sync_ctx = NULL;
+        }
+        g_error_free (error);
         return;
     }
-    cdc_wdm_device_name++;
 
-    for (i = 0; i < G_N_ELEMENTS (driver_names) && !self->priv->wwan_iface; i++) {
-        gchar *sysfs_path;
-        GFile *sysfs_file;
-        GFileEnumerator *enumerator;
-        GError *error = NULL;
+    device_release_transaction (self, tr->wait_ctx.key);
+    transaction_proxy_abort (self, tr);
 
-        sysfs_path = g_strdup_printf ("/sys/class/%s/%s/device/net/", driver_names[i], cdc_wdm_device_name);
-        sysfs_file = g_file_new_for_path (sysfs_path);
-        enumerator = g_file_enumerate_children (sysfs_file,
-                                                G_FILE_ATTRIBUTE_STANDARD_NAME,
-                                                G_FILE_QUERY_INFO_NONE,
-                                                NULL,
-                                                &error);
-        if (!enumerator) {
-            g_debug ("[%s] cannot enumerate files at path '%s': %s",
-                     self->priv->path_display,
-                     sysfs_path,
-                     error->message);
-            g_error_free (error);
-        } else {
-            GFileInfo *file_info;
+    /* Complete transaction with an abort error */
+    transaction_complete_and_free (tr, NULL, error);
+    g_error_free (error);
+}
 
-            /* Ignore errors when enumerating */
-            while ((file_info = g_file_enumerator_next_file (enumerator, NULL, NULL)) != NULL) {
-                const gchar *name;
+/* No transaction is referred to from the I/O context hop, as it may be
+ * completed and its memory reused by the time the abort is processed; the
+ * group is looked up again by the cancellable, which is kept alive */
+typedef struct {
+    QmiDevice    *self;
+    GCancellable *cancellable;
+} CancellableGroupCancelContext;
 
-                name = g_file_info_get_name (file_info);
-                if (name) {
-                    /* We only expect ONE file in the sysfs directory corresponding
-                     * to this control port, if more found for any reason, warn about it */
-                    if (self->priv->wwan_iface)
-                        g_warning ("[%s] invalid additional wwan iface found: %s",
-                               self->priv->path_display, name);
-                    else
-                        self->priv->wwan_iface = g_strdup (name);
-                }
-                g_object_unref (file_info);
-            }
+static void
+cancellable_group_cancel_context_free (CancellableGroupCancelContext *ctx)
+{
+    g_object_unref (ctx->cancellable);
+    g_object_unref (ctx->self);
+    g_slice_free (CancellableGroupCancelContext, ctx);
+}
 
-            g_object_unref (enumerator);
-        }
+static void
+cancellable_group_abort (QmiDevice        *self,
+                         CancellableGroup *group)
+{
+    /* Aborting a transaction always removes it from the group */
+    group->n_dispatching++;
+    while (group->transactions)
+        transaction_abort (self, group->transactions);
+    group->n_dispatching--;
+}
 
-        g_free (sysfs_path);
-        g_object_unref (sysfs_file);
+static gboolean
+cancellable_group_cancelled_in_io_context (CancellableGroupCancelContext *ctx)
+{
+    CancellableGroup *group;
+
+    /* The group may have been removed in the meantime */
+    group = g_hash_table_lookup (ctx->self->priv->cancellable_groups, ctx->cancellable);
+    if (group)
+        cancellable_group_abort (ctx->self, group);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+cancellable_group_cancelled (GCancellable     *cancellable,
+                             CancellableGroup *group)
+{
+    QmiDevice *self;
+
+    self = group->self;
+
+    /* When using a dedicated I/O thread, the transactions may be cancelled
+     * from any other thread, so the abort is processed in the I/O context */
+    if (self->priv->io_context && !g_main_context_is_owner (self->priv->io_context)) {
+        CancellableGroupCancelContext *cancel_ctx;
+        GSource                       *source;
+
+        cancel_ctx = g_slice_new (CancellableGroupCancelContext);
+        cancel_ctx->self = g_object_ref (self);
+        cancel_ctx->cancellable = g_object_ref (cancellable);
+
+        source = g_idle_source_new ();
+        g_source_set_callback (source,
+                               (GSourceFunc)cancellable_group_cancelled_in_io_context,
+                               cancel_ctx,
+                               (GDestroyNotify)cancellable_group_cancel_context_free);
+        g_source_attach (source, self->priv->io_context);
+        g_source_unref (source);
+        return;
     }
 
-    if (!self->priv->wwan_iface)
-        g_warning ("[%s] wwan iface not found", self->priv->path_display);
+    /* The last transactions aborted may drop the last reference to the
+     * device */
+    g_object_ref (self);
+    cancellable_group_abort (self, group);
+    g_object_unref (self);
 }
 
-const gchar *
-qmi_device_get_wwan_iface (QmiDevice *self)
+static void
+cancellable_group_free (CancellableGroup *group)
 {
-    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
+    g_assert (!group->transactions);
+    g_assert (!group->n_dispatching);
 
-    reload_wwan_iface_name (self);
-    return self->priv->wwan_iface;
+    g_cancellable_disconnect (group->cancellable, group->cancellable_id);
+    g_object_unref (group->cancellable);
+    g_slice_free (CancellableGroup, group);
 }
 
-/*****************************************************************************/
-/* Expected data format */
+static gboolean
+cancellable_group_is_unused (gpointer          key,
+                             CancellableGroup *group,
+                             gpointer          user_data)
+{
+    /* Empty groups are kept for as long as someone else holds a reference to
+     * the cancellable, as it may be given in new requests, unless it's
+     * already cancelled */
+    return (!group->transactions &&
+            !group->n_dispatching &&
+            (G_OBJECT (group->cancellable)->ref_count == 1 ||
+             g_cancellable_is_cancelled (group->cancellable)));
+}
+
+static CancellableGroup *
+cancellable_group_get (QmiDevice    *self,
+                       GCancellable *cancellable)
+{
+    CancellableGroup *group;
+
+    group = g_hash_table_lookup (self->priv->cancellable_groups, cancellable);
+    if (group)
+        return group;
+
+    /* A new cancellable is seen, a good time to forget the ones not
+     * used any more */
+    g_hash_table_foreach_remove (self->priv->cancellable_groups,
+                                 (GHRFunc)cancellable_group_is_unused,
+                                 NULL);
+
+    group = g_slice_new0 (CancellableGroup);
+    group->self = self;
+    group->cancellable = g_object_ref (cancellable);
+    g_hash_table_insert (self->priv->cancellable_groups, cancellable, group);
+
+    /* Note: cancellable_group_cancelled() will also be called directly if the
+     * cancellable is already cancelled, with no transaction yet in the group */
+    group->cancellable_id = g_cancellable_connect (cancellable,
+                                                   (GCallback)cancellable_group_cancelled,
+                                                   group,
+                                                   NULL);
+    return group;
+}
 
 static gboolean
-get_expected_data_format (QmiDevice *self,
-                          const gchar *sysfs_path,
-                          GError **error)
+cancellable_group_add (QmiDevice   *self,
+                       Transaction *tr)
 {
-    QmiDeviceExpectedDataFormat expected = QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN;
-    gchar value = '\0';
-    FILE *f;
+    CancellableGroup *group;
 
-    g_debug ("[%s] Reading expected data format from: %s",
-             self->priv->path_display,
-             sysfs_path);
+    group = cancellable_group_get (self, tr->cancellable);
 
-    if (!(f = fopen (sysfs_path, "r"))) {
-        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
-                     "Failed to open file '%s': %s",
-                     sysfs_path, g_strerror (errno));
-        goto out;
-    }
+    tr->cancellable_group = group;
+    tr->cancellable_group_prev = NULL;
+    tr->cancellable_group_next = group->transactions;
+    if (group->transactions)
+        group->transactions->cancellable_group_prev = tr;
+    group->transactions = tr;
 
-    if (fread (&value, 1, 1, f) != 1) {
-        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
-                     "Failed to read from file '%s': %s",
-                     sysfs_path, g_strerror (errno));
-        goto out;
+    /* Checked once in the group, so that it is aborted with the rest of
+     * the group if cancelled from now on */
+    if (g_cancellable_is_cancelled (tr->cancellable)) {
+        cancellable_group_remove (tr);
+        return FALSE;
     }
+    return TRUE;
+}
 
-    if (value == 'Y')
-        expected = QMI_DEVICE_EXPECTED_DATA_FORMAT_RAW_IP;
-    else if (value == 'N')
-        expected = QMI_DEVICE_EXPECTED_DATA_FORMAT_802_3;
+static void
+cancellable_group_remove (Transaction *tr)
+{
+    CancellableGroup *group;
+
+    group = tr->cancellable_group;
+    if (!group)
+        return;
+
+    if (tr->cancellable_group_prev)
+        tr->cancellable_group_prev->cancellable_group_next = tr->cancellable_group_next;
     else
-        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
-                     "Unexpected sysfs file contents");
+        group->transactions = tr->cancellable_group_next;
+    if (tr->cancellable_group_next)
+        tr->cancellable_group_next->cancellable_group_prev = tr->cancellable_group_prev;
 
- out:
-    g_prefix_error (error, "Expected data format not retrieved properly: ");
-    if (f)
-        fclose (f);
-    return expected;
+    tr->cancellable_group = NULL;
+    tr->cancellable_group_prev = NULL;
+    tr->cancellable_group_next = NULL;
 }
 
 static gboolean
-set_expected_data_format (QmiDevice *self,
-                          const gchar *sysfs_path,
-                          QmiDeviceExpectedDataFormat requested,
+device_store_transaction (QmiDevice *self,
+                          Transaction *tr,
+                          guint timeout,
                           GError **error)
 {
-    gboolean status = FALSE;
-    gchar value;
-    FILE *f;
+    gpointer     key;
+    Transaction *existing;
 
-    g_debug ("[%s] Writing expected data format to: %s",
-             self->priv->path_display,
-             sysfs_path);
+    key = build_transaction_key (tr->message);
 
-    if (requested == QMI_DEVICE_EXPECTED_DATA_FORMAT_RAW_IP)
-        value = 'Y';
-    else if (requested == QMI_DEVICE_EXPECTED_DATA_FORMAT_802_3)
-        value = 'N';
-    else
-        g_assert_not_reached ();
+    /* Setup the timeout and cancellation */
 
-    if (!(f = fopen (sysfs_path, "w"))) {
-        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
-                     "Failed to open file '%s' for R/W: %s",
-                     sysfs_path, g_strerror (errno));
-        goto out;
+    tr->wait_ctx.key = key; /* valid as long as the transaction is in the table */
+
+    /* Timeout is optional */
+    if (timeout > 0)
+        transaction_timeouts_add (self, tr, device_get_effective_timeout (self, tr->message, timeout));
+
+    /* All the transactions with the same cancellable share one single
+     * cancellation handler */
+    if (tr->cancellable) {
+        if (!cancellable_group_add (self, tr)) {
+            g_set_error (error,
+                         QMI_PROTOCOL_ERROR,
+                         QMI_PROTOCOL_ERROR_ABORTED,
+                         "Request is already cancelled");
+            return FALSE;
+        }
     }
 
-    if (fwrite (&value, 1, 1, f) != 1) {
-        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
-                     "Failed to write to file '%s': %s",
-                     sysfs_path, g_strerror (errno));
-        goto out;
+    /* If we have already a transaction with the same ID complete the existing
+     * one with an error before the new one is added, or we'll end up with
+     * dangling timeouts and cancellation handlers that may be fired off later
+     * on. */
+    existing = device_release_transaction (self, key);
+    if (existing) {
+        GError *inner_error;
+
+        /* Complete transaction with an abort error */
+        inner_error = g_error_new (QMI_PROTOCOL_ERROR,
+                                   QMI_PROTOCOL_ERROR_ABORTED,
+                                   "Transaction overwritten");
+        transaction_complete_and_free (existing, NULL, inner_error);
+        g_error_free (inner_error);
     }
 
-    status = TRUE;
+    /* Keep in the table */
+    __qmi_transaction_table_insert (&self->priv->transactions, GPOINTER_TO_UINT (key), tr);
 
- out:
-    g_prefix_error (error, "Expected data format not updated properly: ");
-    if (f)
-        fclose (f);
-    return status;
+    return TRUE;
 }
 
-static QmiDeviceExpectedDataFormat
-common_get_set_expected_data_format (QmiDevice *self,
-                                     QmiDeviceExpectedDataFormat requested,
-                                     GError **error)
+static Transaction *
+device_match_transaction (QmiDevice *self,
+                          QmiMessage *message)
 {
-    gchar *sysfs_path = NULL;
-    QmiDeviceExpectedDataFormat expected = QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN;
-    gboolean readonly;
+    /* msg can be either the original message or the response */
+    return device_release_transaction (self, build_transaction_key (message));
+}
 
-    readonly = (requested == QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN);
+/*****************************************************************************/
+/* Health check */
 
-    /* Make sure we load the WWAN iface name */
-    reload_wwan_iface_name (self);
-    if (!self->priv->wwan_iface) {
-        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
-                     "Unknown wwan iface");
-        goto out;
+#define HEALTH_CHECK_IDLE_TIMEOUT_DEFAULT  60
+#define HEALTH_CHECK_STALL_TIMEOUT_DEFAULT 5
+#define HEALTH_CHECK_PING_TIMEOUT_DEFAULT  3
+
+/* Completes all the transactions in the table with the same error */
+static void
+device_abort_all_transactions (QmiDevice    *self,
+                               const GError *error)
+{
+    /* Completing a transaction may complete or abort others as well, and
+     * removing one may shift the following ones back within the table, so
+     * the same slot is checked again after each completion, and the table is
+     * walked again if any is left (e.g. added from a callback). The proxy is
+     * not told about these, as that would just add more requests to the
+     * table. */
+    while (self->priv->transactions.n_items > 0) {
+        guint i = 0;
+
+        while (i < self->priv->transactions.size) {
+            Transaction *tr;
+
+            tr = (Transaction *) self->priv->transactions.entries[i].value;
+            if (!tr) {
+                i++;
+                continue;
+            }
+
+            device_release_transaction (self, tr->wait_ctx.key);
+            transaction_complete_and_free (tr, NULL, error);
+        }
     }
+}
 
-    /* Build sysfs file path and open it */
-    sysfs_path = g_strdup_printf ("/sys/class/net/%s/qmi/raw_ip", self->priv->wwan_iface);
+static gboolean
+unresponsive_idle (QmiDevice *self)
+{
+    g_signal_emit (self, signals[SIGNAL_UNRESPONSIVE], 0);
+    return G_SOURCE_REMOVE;
+}
 
-    /* Set operation? */
-    if (!readonly && !set_expected_data_format (self, sysfs_path, requested, error))
-        goto out;
+static void
+device_report_unresponsive (QmiDevice *self)
+{
+    GError *error;
 
-    /* Get/Set operations */
-    if ((expected = get_expected_data_format (self, sysfs_path, error)) == QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN)
-        goto out;
+    g_warning ("[%s] Device not responding, aborting all pending requests",
+               self->priv->path_display);
 
-    /* If we requested an update but we didn't read that value, report an error */
-    if (!readonly && (requested != expected)) {
-        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
-                     "Expected data format not updated properly to '%s': got '%s' instead",
-                     qmi_device_expected_data_format_get_string (requested),
-                     qmi_device_expected_data_format_get_string (expected));
-        expected = QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN;
+    error = g_error_new (QMI_CORE_ERROR,
+                         QMI_CORE_ERROR_UNRESPONSIVE,
+                         "Device not responding");
+
+    device_abort_all_transactions (self, error);
+    g_error_free (error);
+
+    /* When using a dedicated I/O thread, signals are emitted in the context
+     * where the device was opened, as clients are not thread-safe */
+    if (self->priv->io_context) {
+        GSource *source;
+
+        source = g_idle_source_new ();
+        g_source_set_callback (source,
+                               (GSourceFunc)unresponsive_idle,
+                               g_object_ref (self),
+                               (GDestroyNotify)g_object_unref);
+        g_source_attach (source, self->priv->owner_context);
+        g_source_unref (source);
+        return;
     }
 
- out:
-    g_free (sysfs_path);
-    return expected;
+    g_signal_emit (self, signals[SIGNAL_UNRESPONSIVE], 0);
 }
 
-QmiDeviceExpectedDataFormat
-qmi_device_get_expected_data_format (QmiDevice  *self,
-                                     GError    **error)
+/* When the next ping is due, or -1 if none */
+static gint64
+health_check_deadline (QmiDevice *self)
 {
-    g_return_val_if_fail (QMI_IS_DEVICE (self), QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN);
+    guint idle_timeout;
+    guint stall_timeout;
+    guint timeout;
 
-    return common_get_set_expected_data_format (self, QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN, error);
-}
+    g_mutex_lock (&self->priv->stats_lock);
+    idle_timeout = self->priv->health_check_idle_timeout;
+    stall_timeout = self->priv->health_check_stall_timeout;
+    g_mutex_unlock (&self->priv->stats_lock);
 
-gboolean
-qmi_device_set_expected_data_format (QmiDevice *self,
-                                     QmiDeviceExpectedDataFormat format,
-                                     GError **error)
-{
-    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+    /* Requests waiting for a response are expected to get it soon, or some
+     * other message in the meantime */
+    timeout = idle_timeout;
+    if (self->priv->n_in_flight > 0 && stall_timeout && (!timeout || stall_timeout < timeout))
+        timeout = stall_timeout;
+    if (!timeout)
+        return -1;
 
-    return (common_get_set_expected_data_format (self, format, error) != QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN);
+    return self->priv->last_activity_time + ((gint64) timeout * G_USEC_PER_SEC);
 }
 
-/*****************************************************************************/
-/* Register/Unregister clients that want to receive indications */
-
-static gpointer
-build_registered_client_key (guint8 cid,
-                             QmiService service)
+static void
+health_check_reschedule (QmiDevice *self)
 {
-    return GUINT_TO_POINTER (((guint8)service << 8) | cid);
+    /* While pinging, re-armed once the ping is completed */
+    if (!self->priv->health_check_source || self->priv->health_check_pinging)
+        return;
+
+    g_source_set_ready_time (self->priv->health_check_source, health_check_deadline (self));
 }
 
-static gboolean
-register_client (QmiDevice *self,
-                 QmiClient *client,
-                 GError **error)
+static void
+health_check_ping_ready (QmiClientCtl *client_ctl,
+                         GAsyncResult *res,
+                         QmiDevice    *self)
 {
-    gpointer key;
+    QmiMessageCtlGetVersionInfoOutput *output;
+    GError                            *error = NULL;
 
-    key = build_registered_client_key (qmi_client_get_cid (client),
-                                       qmi_client_get_service (client));
-    /* Only add the new client if not already registered one with the same CID
-     * for the same service */
-    if (g_hash_table_lookup (self->priv->registered_clients, key)) {
-        g_set_error (error,
-                     QMI_CORE_ERROR,
-                     QMI_CORE_ERROR_FAILED,
-                     "A client with CID '%u' and service '%s' is already registered",
-                     qmi_client_get_cid (client),
-                     qmi_service_get_string (qmi_client_get_service (client)));
-        return FALSE;
+    self->priv->health_check_pinging = FALSE;
+
+    /* Any response, even an error one, means the device is alive. If it
+     * isn't, the health check is not re-armed until something is received
+     * again. */
+    output = qmi_client_ctl_get_version_info_finish (client_ctl, res, &error);
+    if (output) {
+        qmi_message_ctl_get_version_info_output_unref (output);
+        health_check_reschedule (self);
+    } else if (g_error_matches (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TIMEOUT)) {
+        device_report_unresponsive (self);
+        g_error_free (error);
+    } else {
+        g_debug ("[%s] Couldn't check whether device is alive: %s",
+                 self->priv->path_display, error->message);
+        g_error_free (error);
+        health_check_reschedule (self);
     }
 
-    g_hash_table_insert (self->priv->registered_clients,
-                         key,
-                         g_object_ref (client));
-    return TRUE;
+    g_object_unref (self);
 }
 
-static void
-unregister_client (QmiDevice *self,
-                   QmiClient *client)
+static gboolean
+health_check_cb (QmiDevice *self)
 {
-    g_hash_table_remove (self->priv->registered_clients,
-                         build_registered_client_key (qmi_client_get_cid (client),
-                                                      qmi_client_get_service (client)));
-}
+    gint64 deadline;
+    guint  ping_timeout;
 
-/*****************************************************************************/
-/* Allocate new client */
+    if (!self->priv->health_check_enabled) {
+        g_clear_pointer (&self->priv->health_check_source, g_source_unref);
+        return G_SOURCE_REMOVE;
+    }
 
-typedef struct {
-    QmiService service;
-    GType client_type;
-    guint8 cid;
-} AllocateClientContext;
+    g_source_set_ready_time (self->priv->health_check_source, -1);
+
+    /* If not open, re-armed once something is received */
+    if (self->priv->health_check_pinging || !self->priv->client_ctl)
+        return G_SOURCE_CONTINUE;
+    if (!device_transport_ready (self))
+        return G_SOURCE_CONTINUE;
+
+    /* Deadlines are not moved forward with every message received, only
+     * when found to be too early here */
+    deadline = health_check_deadline (self);
+    if (deadline < 0)
+        return G_SOURCE_CONTINUE;
+    if (deadline > g_get_monotonic_time ()) {
+        g_source_set_ready_time (self->priv->health_check_source, deadline);
+        return G_SOURCE_CONTINUE;
+    }
 
-static void
-allocate_client_context_free (AllocateClientContext *ctx)
-{
-    g_slice_free (AllocateClientContext, ctx);
+    g_debug ("[%s] Nothing received for a while, checking whether device is alive",
+             self->priv->path_display);
+
+    g_mutex_lock (&self->priv->stats_lock);
+    ping_timeout = self->priv->health_check_ping_timeout;
+    g_mutex_unlock (&self->priv->stats_lock);
+
+    self->priv->health_check_pinging = TRUE;
+    qmi_client_ctl_get_version_info (self->priv->client_ctl,
+                                     NULL,
+                                     ping_timeout,
+                                     NULL,
+                                     (GAsyncReadyCallback)health_check_ping_ready,
+                                     g_object_ref (self));
+    return G_SOURCE_CONTINUE;
 }
 
-QmiClient *
-qmi_device_allocate_client_finish (QmiDevice *self,
-                                   GAsyncResult *res,
-                                   GError **error)
+static void
+health_check_source_setup (QmiDevice *self)
 {
-    return g_task_propagate_pointer (G_TASK (res), error);
+    g_assert (!self->priv->health_check_source);
+    self->priv->health_check_source = g_source_new (&transaction_timeout_source_funcs, sizeof (GSource));
+    g_source_set_callback (self->priv->health_check_source, (GSourceFunc)health_check_cb, self, NULL);
+    g_source_set_ready_time (self->priv->health_check_source, -1);
+    g_source_attach (self->priv->health_check_source, device_peek_timeouts_context (self));
 }
 
+/* Something received, or a request sent with @waiting set if no other one
+ * was waiting for a response; the source is created here from the I/O
+ * context if needed */
 static void
-build_client_object (GTask *task)
+health_check_activity (QmiDevice *self,
+                       gboolean   waiting)
 {
-    QmiDevice *self;
-    AllocateClientContext *ctx;
-    gchar *version_string = NULL;
-    QmiClient *client;
-    GError *error = NULL;
-    const QmiMessageCtlGetVersionInfoOutputServiceListService *version_info;
-
-    self = g_task_get_source_object (task);
-    ctx = g_task_get_task_data (task);
-
-    /* We now have a proper CID for the client, we should be able to create it
-     * right away */
-    client = g_object_new (ctx->client_type,
-                           QMI_CLIENT_DEVICE,  self,
-                           QMI_CLIENT_SERVICE, ctx->service,
-                           QMI_CLIENT_CID,     ctx->cid,
-                           NULL);
-
-    /* Add version info to the client if it was retrieved */
-    version_info = find_service_version_info (self, ctx->service);
-    if (version_info)
-        g_object_set (client,
-                      QMI_CLIENT_VERSION_MAJOR, version_info->major_version,
-                      QMI_CLIENT_VERSION_MINOR, version_info->minor_version,
-                      NULL);
-
-    /* Register the client to get indications */
-    if (!register_client (self, client, &error)) {
-        g_prefix_error (&error,
-                        "Cannot register new client with CID '%u' and service '%s'",
-                        ctx->cid,
-                        qmi_service_get_string (ctx->service));
-        g_task_return_error (task, error);
-        g_object_unref (task);
-        g_object_unref (client);
+    if (!self->priv->health_check_enabled)
         return;
-    }
 
-    /* Build version string for the logging */
-    if (self->priv->supported_services) {
-        const QmiMessageCtlGetVersionInfoOutputServiceListService *info;
+    if (!self->priv->health_check_source)
+        health_check_source_setup (self);
 
-        info = find_service_version_info (self, ctx->service);
-        if (info)
-            version_string = g_strdup_printf ("%u.%u", info->major_version, info->minor_version);
-    }
+    self->priv->last_activity_time = g_get_monotonic_time ();
 
-    g_debug ("[%s] Registered '%s' (version %s) client with ID '%u'",
-             self->priv->path_display,
-             qmi_service_get_string (ctx->service),
-             version_string ? version_string : "unknown",
-             ctx->cid);
+    /* The deadline may be earlier now */
+    if (waiting || g_source_get_ready_time (self->priv->health_check_source) < 0)
+        health_check_reschedule (self);
+}
 
-    g_free (version_string);
+/*****************************************************************************/
+/* Version info request */
 
-    /* Client created and registered, complete successfully */
-    g_task_return_pointer (task, client, g_object_unref);
-    g_object_unref (task);
+GArray *
+qmi_device_get_service_version_info_finish (QmiDevice *self,
+                                            GAsyncResult *res,
+                                            GError **error)
+{
+    return g_task_propagate_pointer (G_TASK (res), error);
 }
 
 static void
-allocate_cid_ready (QmiClientCtl *client_ctl,
+version_info_ready (QmiClientCtl *client_ctl,
                     GAsyncResult *res,
                     GTask *task)
 {
-    QmiMessageCtlAllocateCidOutput *output;
-    QmiService service;
-    guint8 cid;
+    GArray *service_list = NULL;
+    GArray *out;
+    QmiMessageCtlGetVersionInfoOutput *output;
     GError *error = NULL;
-    AllocateClientContext *ctx;
+    guint i;
 
     /* Check result of the async operation */
-    output = qmi_client_ctl_allocate_cid_finish (client_ctl, res, &error);
+    output = qmi_client_ctl_get_version_info_finish (client_ctl, res, &error);
     if (!output) {
-        g_prefix_error (&error, "CID allocation failed in the CTL client: ");
         g_task_return_error (task, error);
         g_object_unref (task);
         return;
     }
 
     /* Check result of the QMI operation */
-    if (!qmi_message_ctl_allocate_cid_output_get_result (output, &error)) {
+    if (!qmi_message_ctl_get_version_info_output_get_result (output, &error)) {
+        qmi_message_ctl_get_version_info_output_unref (output);
         g_task_return_error (task, error);
         g_object_unref (task);
-        qmi_message_ctl_allocate_cid_output_unref (output);
         return;
     }
 
-    /* Allocation info is mandatory when result is success */
-    g_assert (qmi_message_ctl_allocate_cid_output_get_allocation_info (output, &service, &cid, NULL));
-
-    ctx = g_task_get_task_data (task);
+    /* QMI operation succeeded, we can now get the outputs */
+    qmi_message_ctl_get_version_info_output_get_service_list (output, &service_list, NULL);
+    out = g_array_sized_new (FALSE, FALSE, sizeof (QmiDeviceServiceVersionInfo), service_list->len);
+    for (i = 0; i < service_list->len; i++) {
+        QmiMessageCtlGetVersionInfoOutputServiceListService *info;
+        QmiDeviceServiceVersionInfo outinfo;
 
-    if (service != ctx->service) {
-        g_task_return_new_error (
-            task,
-            QMI_CORE_ERROR,
-            QMI_CORE_ERROR_FAILED,
-            "CID allocation failed in the CTL client: "
-            "Service mismatch (requested '%s', got '%s')",
-            qmi_service_get_string (ctx->service),
-            qmi_service_get_string (service));
-        g_object_unref (task);
-        qmi_message_ctl_allocate_cid_output_unref (output);
-        return;
+        info = &g_array_index (service_list,
+                               QmiMessageCtlGetVersionInfoOutputServiceListService,
+                               i);
+        outinfo.service = info->service;
+        outinfo.major_version = info->major_version;
+        outinfo.minor_version = info->minor_version;
+        g_array_append_val (out, outinfo);
     }
 
-    ctx->cid = cid;
-    build_client_object (task);
-    qmi_message_ctl_allocate_cid_output_unref (output);
+    qmi_message_ctl_get_version_info_output_unref (output);
+    g_task_return_pointer (task, out, (GDestroyNotify)g_array_unref);
+    g_object_unref (task);
 }
 
 void
-qmi_device_allocate_client (QmiDevice *self,
-                            QmiService service,
-                            guint8 cid,
-                            guint timeout,
-                            GCancellable *cancellable,
-                            GAsyncReadyCallback callback,
-                            gpointer user_data)
+qmi_device_get_service_version_info (QmiDevice *self,
+                                     guint timeout,
+                                     GCancellable *cancellable,
+                                     GAsyncReadyCallback callback,
+                                     gpointer user_data)
 {
-    AllocateClientContext *ctx;
+    qmi_client_ctl_get_version_info (
+        self->priv->client_ctl,
+        NULL,
+        timeout,
+        cancellable,
+        (GAsyncReadyCallback)version_info_ready,
+        g_task_new (self, cancellable, callback, user_data));
+}
+
+/*****************************************************************************/
+/* Indication filter */
+
+gboolean
+qmi_device_set_indication_filter_finish (QmiDevice     *self,
+                                         GAsyncResult  *res,
+                                         GError       **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void
+set_indication_filter_ready (QmiClientCtl *client_ctl,
+                             GAsyncResult *res,
+                             GTask *task)
+{
+    QmiMessageCtlInternalProxySetIndicationFilterOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_ctl_internal_proxy_set_indication_filter_finish (client_ctl, res, &error);
+    if (!output || !qmi_message_ctl_internal_proxy_set_indication_filter_output_get_result (output, &error))
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
+
+    if (output)
+        qmi_message_ctl_internal_proxy_set_indication_filter_output_unref (output);
+    g_object_unref (task);
+}
+
+void
+qmi_device_set_indication_filter (QmiDevice           *self,
+                                  QmiService           service,
+                                  GArray              *message_ids,
+                                  guint                timeout,
+                                  GCancellable        *cancellable,
+                                  GAsyncReadyCallback  callback,
+                                  gpointer             user_data)
+{
+    QmiMessageCtlInternalProxySetIndicationFilterInput *input;
     GTask *task;
 
     g_return_if_fail (QMI_IS_DEVICE (self));
-    g_return_if_fail (service != QMI_SERVICE_UNKNOWN);
-
-    ctx = g_slice_new0 (AllocateClientContext);
-    ctx->service = service;
+    g_return_if_fail ((guint) service <= G_MAXUINT8);
+    g_return_if_fail (!message_ids || message_ids->len <= G_MAXUINT8);
 
     task = g_task_new (self, cancellable, callback, user_data);
-    g_task_set_task_data (task,
-                          ctx,
-                          (GDestroyNotify)allocate_client_context_free);
 
-    /* Check if the requested service is supported by the device */
-    if (!check_service_supported (self, service)) {
+    /* The filter is applied by the proxy, never by the device itself */
+    if (!self->priv->proxy_indication_filter_supported) {
         g_task_return_new_error (task,
                                  QMI_CORE_ERROR,
                                  QMI_CORE_ERROR_UNSUPPORTED,
-                                 "Service '%s' not supported by the device",
-                                 qmi_service_get_string (service));
+                                 "Indication filters are only supported through qmi-proxy");
         g_object_unref (task);
         return;
     }
 
-    switch (service) {
-    case QMI_SERVICE_CTL:
-        g_task_return_new_error (task,
-                                 QMI_CORE_ERROR,
-                                 QMI_CORE_ERROR_INVALID_ARGS,
-                                 "Cannot create additional clients for the CTL service");
-        g_object_unref (task);
-        return;
+    input = qmi_message_ctl_internal_proxy_set_indication_filter_input_new ();
+    qmi_message_ctl_internal_proxy_set_indication_filter_input_set_service (input, service, NULL);
+    if (message_ids)
+        qmi_message_ctl_internal_proxy_set_indication_filter_input_set_indications (input, message_ids, NULL);
+    qmi_client_ctl_internal_proxy_set_indication_filter (self->priv->client_ctl,
+                                                         input,
+                                                         timeout,
+                                                         cancellable,
+                                                         (GAsyncReadyCallback)set_indication_filter_ready,
+                                                         task);
+    qmi_message_ctl_internal_proxy_set_indication_filter_input_unref (input);
+}
 
-    case QMI_SERVICE_DMS:
-        ctx->client_type = QMI_TYPE_CLIENT_DMS;
-        break;
+/*****************************************************************************/
+/* Indication monitoring */
 
-    case QMI_SERVICE_WDS:
-        ctx->client_type = QMI_TYPE_CLIENT_WDS;
-        break;
+gboolean
+qmi_device_monitor_indications_finish (QmiDevice     *self,
+                                       GAsyncResult  *res,
+                                       GError       **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
 
-    case QMI_SERVICE_NAS:
-        ctx->client_type = QMI_TYPE_CLIENT_NAS;
-        break;
+static void
+monitor_indications_ready (QmiClientCtl *client_ctl,
+                           GAsyncResult *res,
+                           GTask *task)
+{
+    QmiMessageCtlInternalProxyMonitorOutput *output;
+    GError *error = NULL;
 
-    case QMI_SERVICE_WMS:
-        ctx->client_type = QMI_TYPE_CLIENT_WMS;
-        break;
+    output = qmi_client_ctl_internal_proxy_monitor_finish (client_ctl, res, &error);
+    if (!output || !qmi_message_ctl_internal_proxy_monitor_output_get_result (output, &error))
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
 
-    case QMI_SERVICE_PDS:
-        ctx->client_type = QMI_TYPE_CLIENT_PDS;
-        break;
+    if (output)
+        qmi_message_ctl_internal_proxy_monitor_output_unref (output);
+    g_object_unref (task);
+}
 
-    case QMI_SERVICE_PDC:
-        ctx->client_type = QMI_TYPE_CLIENT_PDC;
-        break;
-
-    case QMI_SERVICE_PBM:
-        ctx->client_type = QMI_TYPE_CLIENT_PBM;
-        break;
-
-    case QMI_SERVICE_UIM:
-        ctx->client_type = QMI_TYPE_CLIENT_UIM;
-        break;
-
-    case QMI_SERVICE_OMA:
-        ctx->client_type = QMI_TYPE_CLIENT_OMA;
-        break;
-
-    case QMI_SERVICE_WDA:
-        ctx->client_type = QMI_TYPE_CLIENT_WDA;
-        break;
+void
+qmi_device_monitor_indications (QmiDevice           *self,
+                                GArray              *services,
+                                guint                timeout,
+                                GCancellable        *cancellable,
+                                GAsyncReadyCallback  callback,
+                                gpointer             user_data)
+{
+    QmiMessageCtlInternalProxyMonitorInput *input;
+    GArray *empty = NULL;
+    GTask *task;
 
-    case QMI_SERVICE_VOICE:
-        ctx->client_type = QMI_TYPE_CLIENT_VOICE;
-        break;
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (!services || services->len <= G_MAXUINT8);
 
-    case QMI_SERVICE_LOC:
-        ctx->client_type = QMI_TYPE_CLIENT_LOC;
-        break;
+    task = g_task_new (self, cancellable, callback, user_data);
 
-    default:
+    /* Only the proxy sees the indications of other processes */
+    if (!self->priv->proxy_monitor_supported) {
         g_task_return_new_error (task,
                                  QMI_CORE_ERROR,
-                                 QMI_CORE_ERROR_INVALID_ARGS,
-                                 "Clients for service '%s' not yet supported",
-                                 qmi_service_get_string (service));
+                                 QMI_CORE_ERROR_UNSUPPORTED,
+                                 "Indication monitoring is only supported through qmi-proxy");
         g_object_unref (task);
         return;
     }
 
-    /* Allocate a new CID for the client to be created */
-    if (cid == QMI_CID_NONE) {
-        QmiMessageCtlAllocateCidInput *input;
+    if (!services)
+        services = empty = g_array_new (FALSE, FALSE, sizeof (QmiService));
+
+    input = qmi_message_ctl_internal_proxy_monitor_input_new ();
+    qmi_message_ctl_internal_proxy_monitor_input_set_services (input, services, NULL);
+    qmi_client_ctl_internal_proxy_monitor (self->priv->client_ctl,
+                                           input,
+                                           timeout,
+                                           cancellable,
+                                           (GAsyncReadyCallback)monitor_indications_ready,
+                                           task);
+    qmi_message_ctl_internal_proxy_monitor_input_unref (input);
+    if (empty)
+        g_array_unref (empty);
+}
 
-        input = qmi_message_ctl_allocate_cid_input_new ();
-        qmi_message_ctl_allocate_cid_input_set_service (input, ctx->service, NULL);
+/*****************************************************************************/
+/* Transactions snapshot */
 
-        g_debug ("[%s] Allocating new client ID...",
-                 self->priv->path_display);
-        qmi_client_ctl_allocate_cid (self->priv->client_ctl,
-                                     input,
-                                     timeout,
-                                     cancellable,
-                                     (GAsyncReadyCallback)allocate_cid_ready,
-                                     task);
+GArray *
+qmi_device_get_transactions_finish (QmiDevice     *self,
+                                    GAsyncResult  *res,
+                                    GError       **error)
+{
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
 
-        qmi_message_ctl_allocate_cid_input_unref (input);
-        return;
+static GArray *
+device_build_transactions_snapshot (QmiDevice *self)
+{
+    GArray *array;
+    gint64  now;
+    guint   i;
+
+    now = g_get_monotonic_time ();
+    array = g_array_sized_new (FALSE, FALSE, sizeof (QmiDeviceTransactionInfo),
+                               self->priv->transactions.n_items);
+
+    for (i = 0; i < self->priv->transactions.size; i++) {
+        QmiDeviceTransactionInfo  info;
+        Transaction              *tr;
+
+        tr = self->priv->transactions.entries[i].value;
+        if (!tr)
+            continue;
+
+        info.service = qmi_message_get_service (tr->message);
+        info.message_id = qmi_message_get_message_id (tr->message);
+        info.client_id = qmi_message_get_client_id (tr->message);
+        info.transaction_id = qmi_message_get_transaction_id (tr->message);
+        info.in_flight = tr->in_flight;
+        info.age = (guint64) (now - tr->issue_time);
+        info.timeout_remaining = (tr->timeout_iter ? MAX (tr->timeout_deadline - now, 0) : -1);
+        info.proxy_client_pid = 0;
+        g_array_append_val (array, info);
     }
 
-    /* Reuse the given CID */
-    g_debug ("[%s] Reusing client CID '%u'...",
-             self->priv->path_display,
-             cid);
-    ctx->cid = cid;
-    build_client_object (task);
+    return array;
 }
 
-/*****************************************************************************/
-/* Release client */
-
-gboolean
-qmi_device_release_client_finish (QmiDevice *self,
-                                  GAsyncResult *res,
-                                  GError **error)
+static gboolean
+get_transactions_in_io_context (GTask *task)
 {
-    return g_task_propagate_boolean (G_TASK (res), error);
+    g_task_return_pointer (task,
+                           device_build_transactions_snapshot (g_task_get_source_object (task)),
+                           (GDestroyNotify)g_array_unref);
+    g_object_unref (task);
+    return G_SOURCE_REMOVE;
 }
 
 static void
-client_ctl_release_cid_ready (QmiClientCtl *client_ctl,
-                              GAsyncResult *res,
-                              GTask *task)
+internal_proxy_get_transactions_ready (QmiClientCtl *client_ctl,
+                                       GAsyncResult *res,
+                                       GTask *task)
 {
+    QmiMessageCtlInternalProxyGetTransactionsOutput *output;
+    GArray *transactions = NULL;
+    GArray *array;
     GError *error = NULL;
-    QmiMessageCtlReleaseCidOutput *output;
-
-    /* Note: even if we return an error, the client is to be considered
-     * released! (so shouldn't be used) */
+    guint i;
 
-    /* Check result of the async operation */
-    output = qmi_client_ctl_release_cid_finish (client_ctl, res, &error);
-    if (!output) {
+    output = qmi_client_ctl_internal_proxy_get_transactions_finish (client_ctl, res, &error);
+    if (!output || !qmi_message_ctl_internal_proxy_get_transactions_output_get_result (output, &error)) {
         g_task_return_error (task, error);
         g_object_unref (task);
+        if (output)
+            qmi_message_ctl_internal_proxy_get_transactions_output_unref (output);
         return;
     }
 
-    /* Check result of the QMI operation */
-    if (!qmi_message_ctl_release_cid_output_get_result (output, &error)) {
-        g_task_return_error (task, error);
-        g_object_unref (task);
-        qmi_message_ctl_release_cid_output_unref (output);
-        return;
+    /* The TLV isn't given when there are no transactions */
+    qmi_message_ctl_internal_proxy_get_transactions_output_get_transactions (output, &transactions, NULL);
+    array = g_array_sized_new (FALSE, FALSE, sizeof (QmiDeviceTransactionInfo),
+                               transactions ? transactions->len : 0);
+    for (i = 0; transactions && i < transactions->len; i++) {
+        QmiMessageCtlInternalProxyGetTransactionsOutputTransactionsTransaction *element;
+        QmiDeviceTransactionInfo info;
+
+        element = &g_array_index (transactions,
+                                  QmiMessageCtlInternalProxyGetTransactionsOutputTransactionsTransaction,
+                                  i);
+        info.service = element->service;
+        info.message_id = element->message_id;
+        info.client_id = element->cid;
+        info.transaction_id = element->transaction_id;
+        info.in_flight = element->in_flight;
+        info.age = element->age;
+        info.timeout_remaining = element->timeout_remaining;
+        info.proxy_client_pid = element->client_pid;
+        g_array_append_val (array, info);
     }
 
-    g_task_return_boolean (task, TRUE);
+    g_task_return_pointer (task, array, (GDestroyNotify)g_array_unref);
     g_object_unref (task);
-    qmi_message_ctl_release_cid_output_unref (output);
+    qmi_message_ctl_internal_proxy_get_transactions_output_unref (output);
 }
 
 void
-qmi_device_release_client (QmiDevice *self,
-                           QmiClient *client,
-                           QmiDeviceReleaseClientFlags flags,
-                           guint timeout,
-                           GCancellable *cancellable,
-                           GAsyncReadyCallback callback,
-                           gpointer user_data)
+qmi_device_get_transactions (QmiDevice           *self,
+                             guint                timeout,
+                             GCancellable        *cancellable,
+                             GAsyncReadyCallback  callback,
+                             gpointer             user_data)
 {
     GTask *task;
-    QmiService service;
-    guint8 cid;
-    gchar *flags_str;
 
     g_return_if_fail (QMI_IS_DEVICE (self));
-    g_return_if_fail (QMI_IS_CLIENT (client));
-
-    cid = qmi_client_get_cid (client);
-    service = (guint8)qmi_client_get_service (client);
-
-    /* The CTL client should not have been created out of the QmiDevice */
-    g_return_if_fail (service != QMI_SERVICE_CTL);
-
-    flags_str = qmi_device_release_client_flags_build_string_from_mask (flags);
-    g_debug ("[%s] Releasing '%s' client with flags '%s'...",
-             self->priv->path_display,
-             qmi_service_get_string (service),
-             flags_str);
-    g_free (flags_str);
 
     task = g_task_new (self, cancellable, callback, user_data);
 
-    /* Do not try to release an already released client */
-    if (cid == QMI_CID_NONE) {
-        g_task_return_new_error (task,
-                                 QMI_CORE_ERROR,
-                                 QMI_CORE_ERROR_INVALID_ARGS,
-                                 "Client is already released");
-        g_object_unref (task);
+    /* Through the proxy, the requests of all its clients are reported */
+    if (self->priv->proxy_transactions_supported) {
+        qmi_client_ctl_internal_proxy_get_transactions (self->priv->client_ctl,
+                                                        NULL,
+                                                        timeout,
+                                                        cancellable,
+                                                        (GAsyncReadyCallback)internal_proxy_get_transactions_ready,
+                                                        task);
         return;
     }
 
-    /* Keep the client object valid until after we reset its contents below */
-    g_object_ref (client);
-
-    /* Unregister from device */
-    unregister_client (self, client);
-
-    g_debug ("[%s] Unregistered '%s' client with ID '%u'",
-             self->priv->path_display,
-             qmi_service_get_string (service),
-             cid);
-
-    /* Reset the contents of the client object, making it invalid */
-    g_object_set (client,
-                  QMI_CLIENT_CID,     QMI_CID_NONE,
-                  QMI_CLIENT_SERVICE, QMI_SERVICE_UNKNOWN,
-                  QMI_CLIENT_DEVICE,  NULL,
-                  NULL);
-
-    g_object_unref (client);
-
-    if (flags & QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID) {
-        QmiMessageCtlReleaseCidInput *input;
-
-        /* And now, really try to release the CID */
-        input = qmi_message_ctl_release_cid_input_new ();
-        qmi_message_ctl_release_cid_input_set_release_info (input, service,cid, NULL);
-
-        /* And now, really try to release the CID */
-        qmi_client_ctl_release_cid (self->priv->client_ctl,
-                                    input,
-                                    timeout,
-                                    cancellable,
-                                    (GAsyncReadyCallback)client_ctl_release_cid_ready,
-                                    task);
+    /* The transactions table is only used from within the I/O context */
+    if (self->priv->io_context && !g_main_context_is_owner (self->priv->io_context)) {
+        GSource *source;
 
-        qmi_message_ctl_release_cid_input_unref (input);
+        source = g_idle_source_new ();
+        g_source_set_callback (source, (GSourceFunc)get_transactions_in_io_context, task, NULL);
+        g_source_attach (source, self->priv->io_context);
+        g_source_unref (source);
         return;
     }
 
-    /* No need to release the CID, so just done */
-    g_task_return_boolean (task, TRUE);
-    g_object_unref (task);
-    return;
+    get_transactions_in_io_context (task);
 }
 
 /*****************************************************************************/
-/* Set instance ID */
+/* Proxy statistics */
+
+typedef struct {
+    GArray *device_stats;
+    GArray *client_stats;
+} GetProxyStatsResult;
+
+static void
+get_proxy_stats_result_free (GetProxyStatsResult *result)
+{
+    g_array_unref (result->device_stats);
+    g_array_unref (result->client_stats);
+    g_slice_free (GetProxyStatsResult, result);
+}
 
 gboolean
-qmi_device_set_instance_id_finish (QmiDevice *self,
-                                   GAsyncResult *res,
-                                   guint16 *link_id,
-                                   GError **error)
+qmi_device_get_proxy_stats_finish (QmiDevice     *self,
+                                   GAsyncResult  *res,
+                                   GArray       **out_device_stats,
+                                   GArray       **out_client_stats,
+                                   GError       **error)
 {
-    gssize value;
+    GetProxyStatsResult *result;
 
-    value = g_task_propagate_int (G_TASK (res), error);
-    if (value == -1)
+    result = g_task_propagate_pointer (G_TASK (res), error);
+    if (!result)
         return FALSE;
 
-    if (link_id)
-        *link_id = (guint16)value;
-
+    if (out_device_stats)
+        *out_device_stats = g_array_ref (result->device_stats);
+    if (out_client_stats)
+        *out_client_stats = g_array_ref (result->client_stats);
+    get_proxy_stats_result_free (result);
     return TRUE;
 }
 
 static void
-set_instance_id_ready (QmiClientCtl *client_ctl,
-                       GAsyncResult *res,
-                       GTask *task)
+proxy_device_stats_clear (QmiProxyDeviceStats *stats)
 {
-    QmiMessageCtlSetInstanceIdOutput *output;
+    g_free (stats->device_path);
+}
+
+static void
+proxy_client_stats_clear (QmiProxyClientStats *stats)
+{
+    g_free (stats->device_path);
+}
+
+static void
+internal_proxy_get_stats_ready (QmiClientCtl *client_ctl,
+                                GAsyncResult *res,
+                                GTask *task)
+{
+    QmiMessageCtlInternalProxyGetStatsOutput *output;
+    GetProxyStatsResult *result;
+    GArray *devices = NULL;
+    GArray *clients = NULL;
     GError *error = NULL;
+    guint i;
 
-    /* Check result of the async operation */
-    output = qmi_client_ctl_set_instance_id_finish (client_ctl, res, &error);
-    if (!output)
+    output = qmi_client_ctl_internal_proxy_get_stats_finish (client_ctl, res, &error);
+    if (!output || !qmi_message_ctl_internal_proxy_get_stats_output_get_result (output, &error)) {
         g_task_return_error (task, error);
-    else {
-        /* Check result of the QMI operation */
-        if (!qmi_message_ctl_set_instance_id_output_get_result (output, &error))
-            g_task_return_error (task, error);
-        else {
-            guint16 link_id;
+        g_object_unref (task);
+        if (output)
+            qmi_message_ctl_internal_proxy_get_stats_output_unref (output);
+        return;
+    }
 
-            qmi_message_ctl_set_instance_id_output_get_link_id (output, &link_id, NULL);
-            g_task_return_int (task, link_id);
-        }
-        qmi_message_ctl_set_instance_id_output_unref (output);
+    /* The TLVs aren't given when there are no devices or clients */
+    qmi_message_ctl_internal_proxy_get_stats_output_get_devices (output, &devices, NULL);
+    qmi_message_ctl_internal_proxy_get_stats_output_get_clients (output, &clients, NULL);
+
+    result = g_slice_new (GetProxyStatsResult);
+
+    result->device_stats = g_array_sized_new (FALSE, TRUE, sizeof (QmiProxyDeviceStats),
+                                              devices ? devices->len : 0);
+    g_array_set_clear_func (result->device_stats, (GDestroyNotify)proxy_device_stats_clear);
+    for (i = 0; devices && i < devices->len; i++) {
+        QmiMessageCtlInternalProxyGetStatsOutputDevicesDevice *element;
+        QmiProxyDeviceStats stats;
+
+        element = &g_array_index (devices, QmiMessageCtlInternalProxyGetStatsOutputDevicesDevice, i);
+        stats.device_path = g_strdup (element->device_path);
+        stats.n_clients = element->clients;
+        stats.n_requests = element->requests;
+        stats.n_responses = element->responses;
+        stats.n_timeouts = element->timeouts;
+        stats.n_aborts = element->aborts;
+        stats.n_indications = element->indications;
+        stats.n_coalesced = element->coalesced;
+        stats.n_cached = element->cached;
+        stats.bytes_sent = element->bytes_sent;
+        stats.bytes_received = element->bytes_received;
+        stats.n_in_flight = element->in_flight;
+        stats.output_queue_length = element->output_queue_length;
+        stats.throttled_queue_length = element->throttled_queue_length;
+        stats.latency_mean = element->latency_mean;
+        stats.latency_p99 = element->latency_p99;
+        g_array_append_val (result->device_stats, stats);
+    }
+
+    result->client_stats = g_array_sized_new (FALSE, TRUE, sizeof (QmiProxyClientStats),
+                                              clients ? clients->len : 0);
+    g_array_set_clear_func (result->client_stats, (GDestroyNotify)proxy_client_stats_clear);
+    for (i = 0; clients && i < clients->len; i++) {
+        QmiMessageCtlInternalProxyGetStatsOutputClientsClient *element;
+        QmiProxyClientStats stats;
+
+        element = &g_array_index (clients, QmiMessageCtlInternalProxyGetStatsOutputClientsClient, i);
+        stats.device_path = g_strdup (element->device_path);
+        stats.pid = element->pid;
+        stats.n_requests = element->requests;
+        stats.n_responses = element->responses;
+        stats.n_timeouts = element->timeouts;
+        stats.n_aborts = element->aborts;
+        stats.n_indications = element->indications;
+        stats.n_pending_requests = element->pending_requests;
+        stats.n_queued_requests = element->queued_requests;
+        stats.bytes_received = element->bytes_received;
+        stats.bytes_sent = element->bytes_sent;
+        stats.latency_max = element->latency_max;
+        stats.latency_total = element->latency_total;
+        stats.latency_p99 = element->latency_p99;
+        g_array_append_val (result->client_stats, stats);
     }
 
+    g_task_return_pointer (task, result, (GDestroyNotify)get_proxy_stats_result_free);
     g_object_unref (task);
+    qmi_message_ctl_internal_proxy_get_stats_output_unref (output);
 }
 
 void
-qmi_device_set_instance_id (QmiDevice *self,
-                            guint8 instance_id,
-                            guint timeout,
-                            GCancellable *cancellable,
-                            GAsyncReadyCallback callback,
-                            gpointer user_data)
+qmi_device_get_proxy_stats (QmiDevice           *self,
+                            guint                timeout,
+                            GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data)
 {
     GTask *task;
-    QmiMessageCtlSetInstanceIdInput *input;
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
 
     task = g_task_new (self, cancellable, callback, user_data);
 
-    input = qmi_message_ctl_set_instance_id_input_new ();
-    qmi_message_ctl_set_instance_id_input_set_id (
-        input,
-        instance_id,
-        NULL);
-    qmi_client_ctl_set_instance_id (self->priv->client_ctl,
-                                    input,
-                                    timeout,
-                                    cancellable,
-                                    (GAsyncReadyCallback)set_instance_id_ready,
-                                    task);
-    qmi_message_ctl_set_instance_id_input_unref (input);
+    if (!self->priv->proxy_stats_supported) {
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_UNSUPPORTED,
+                                 "Statistics are only available through a qmi-proxy supporting them");
+        g_object_unref (task);
+        return;
+    }
+
+    qmi_client_ctl_internal_proxy_get_stats (self->priv->client_ctl,
+                                             NULL,
+                                             timeout,
+                                             cancellable,
+                                             (GAsyncReadyCallback)internal_proxy_get_stats_ready,
+                                             task);
 }
 
 /*****************************************************************************/
-/* Input channel processing */
-
-typedef struct {
-    QmiClient *client;
-    QmiMessage *message;
-} IdleIndicationContext;
+/* Version info checks (private) */
 
-static gboolean
-process_indication_idle (IdleIndicationContext *ctx)
+static const QmiMessageCtlGetVersionInfoOutputServiceListService *
+find_service_version_info (QmiDevice *self,
+                           QmiService service)
 {
-    g_assert (ctx->client != NULL);
-    g_assert (ctx->message != NULL);
-
-    __qmi_client_process_indication (ctx->client, ctx->message);
-
-    g_object_unref (ctx->client);
-    qmi_message_unref (ctx->message);
-    g_slice_free (IdleIndicationContext, ctx);
-    return FALSE;
-}
+    guint i;
 
-static void
-report_indication (QmiClient *client,
-                   QmiMessage *message)
-{
-    IdleIndicationContext *ctx;
-    GSource *source;
+    if (!self->priv->supported_services)
+        return NULL;
 
-    /* Setup an idle to Pass the indication down to the client */
-    ctx = g_slice_new (IdleIndicationContext);
-    ctx->client = g_object_ref (client);
-    ctx->message = qmi_message_ref (message);
+    for (i = 0; i < self->priv->supported_services->len; i++) {
+        const QmiMessageCtlGetVersionInfoOutputServiceListService *info;
 
-    source = g_idle_source_new ();
-    g_source_set_callback (source, (GSourceFunc)process_indication_idle, ctx, NULL);
-    g_source_attach (source, g_main_context_get_thread_default ());
-    g_source_unref (source);
+        info = &g_array_index (self->priv->supported_services,
+                               QmiMessageCtlGetVersionInfoOutputServiceListService,
+                               i);
+
+        if (service == info->service)
+            return info;
+    }
+
+    return NULL;
 }
 
 static void
-trace_message (QmiDevice         *self,
-               QmiMessage        *message,
-               gboolean           sent_or_received,
-               const gchar       *message_str,
-               QmiMessageContext *message_context)
+build_service_versions (QmiDevice *self)
 {
-    gchar       *printable;
-    const gchar *prefix_str;
-    const gchar *action_str;
-    gchar       *vendor_str = NULL;
+    ServiceVersion *dms;
+    ServiceVersion *wds;
+    guint           i;
 
-    if (!qmi_utils_get_traces_enabled ())
-        return;
+    memset (self->priv->service_versions, 0, sizeof (self->priv->service_versions));
 
-    if (sent_or_received) {
-        prefix_str = "<<<<<< ";
-        action_str = "sent";
-    } else {
-        prefix_str = "<<<<<< ";
-        action_str = "received";
-    }
+    for (i = 0; i < self->priv->supported_services->len; i++) {
+        const QmiMessageCtlGetVersionInfoOutputServiceListService *info;
 
-    printable = __qmi_utils_str_hex (((GByteArray *)message)->data,
-                                     ((GByteArray *)message)->len,
-                                     ':');
-    g_debug ("[%s] %s message...\n"
-             "%sRAW:\n"
-             "%s  length = %u\n"
-             "%s  data   = %s\n",
-             self->priv->path_display, action_str,
-             prefix_str,
-             prefix_str, ((GByteArray *)message)->len,
-             prefix_str, printable);
-    g_free (printable);
+        info = &g_array_index (self->priv->supported_services,
+                               QmiMessageCtlGetVersionInfoOutputServiceListService,
+                               i);
+        if ((guint) info->service > G_MAXUINT8)
+            continue;
 
-    if (message_context) {
-        guint16 vendor_id;
+        self->priv->service_versions[info->service].supported = TRUE;
+        self->priv->service_versions[info->service].major = info->major_version;
+        self->priv->service_versions[info->service].minor = info->minor_version;
+    }
 
-        vendor_id = qmi_message_context_get_vendor_id (message_context);
-        if (vendor_id != QMI_MESSAGE_VENDOR_GENERIC)
-            vendor_str = g_strdup_printf ("vendor-specific (0x%04x)", vendor_id);
+    /* Some device firmware versions (Quectel EC21) lie about their supported
+     * DMS version, so assume a reasonable DMS version if the WDS version is
+     * high enough */
+    dms = &self->priv->service_versions[QMI_SERVICE_DMS];
+    wds = &self->priv->service_versions[QMI_SERVICE_WDS];
+    if (dms->supported && dms->major == 1 && dms->minor == 0 &&
+        wds->supported && wds->major >= 1 && wds->minor >= 9) {
+        dms->major = 1;
+        dms->minor = 3;
     }
+}
 
-    printable = qmi_message_get_printable_full (message, message_context, prefix_str);
-    g_debug ("[%s] %s %s %s (translated)...\n%s",
-             self->priv->path_display,
-             action_str,
-             vendor_str ? vendor_str : "generic",
-             message_str,
-             printable);
-    g_free (printable);
+static gboolean
+check_service_supported (QmiDevice *self,
+                         QmiService service)
+{
+    /* If we didn't check supported services, just assume it is supported */
+    if (!self->priv->supported_services) {
+        g_debug ("[%s] Assuming service '%s' is supported...",
+                 self->priv->path_display,
+                 qmi_service_get_string (service));
+        return TRUE;
+    }
 
-    g_free (vendor_str);
+    return ((guint) service <= G_MAXUINT8 && self->priv->service_versions[service].supported);
 }
 
-static void
-process_message (QmiDevice *self,
-                 QmiMessage *message)
+static gboolean
+check_message_supported (QmiDevice *self,
+                         QmiMessage *message,
+                         QmiMessageContext *message_context,
+                         GError **error)
 {
-    if (qmi_message_is_indication (message)) {
-        /* Indication traces translated without an explicit vendor */
-        trace_message (self, message, FALSE, "indication", NULL);
-
-        /* Generic emission of the indication */
-        g_signal_emit (self, signals[SIGNAL_INDICATION], 0, message);
+    const ServiceVersion *version;
+    QmiService service;
+    guint message_major = 0;
+    guint message_minor = 0;
 
-        if (qmi_message_get_client_id (message) == QMI_CID_BROADCAST) {
-            GHashTableIter iter;
-            gpointer key;
-            QmiClient *client;
+    /* If we didn't check supported services, just assume it is supported */
+    if (!self->priv->supported_services)
+        return TRUE;
 
-            g_hash_table_iter_init (&iter, self->priv->registered_clients);
-            while (g_hash_table_iter_next (&iter, &key, (gpointer *)&client)) {
-                /* For broadcast messages, report them just if the service matches */
-                if (qmi_message_get_service (message) == qmi_client_get_service (client))
-                    report_indication (client, message);
-            }
-        } else {
-            QmiClient *client;
+    /* For CTL, we assume all are supported */
+    service = qmi_message_get_service (message);
+    if (service == QMI_SERVICE_CTL)
+        return TRUE;
 
-            client = g_hash_table_lookup (self->priv->registered_clients,
-                                          build_registered_client_key (qmi_message_get_client_id (message),
-                                                                       qmi_message_get_service (message)));
-            if (client)
-                report_indication (client, message);
-        }
+    /* If we cannot get in which version this message was introduced, we'll just
+     * assume it's supported */
+    if (!qmi_message_get_version_introduced_full (message, message_context, &message_major, &message_minor))
+        return TRUE;
 
-        return;
+    version = &self->priv->service_versions[service];
+    if (!version->supported) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_UNSUPPORTED,
+                     "QMI service '%s' not supported",
+                     qmi_service_get_string (service));
+        return FALSE;
     }
 
-    if (qmi_message_is_response (message)) {
-        Transaction *tr;
-
-        tr = device_match_transaction (self, message);
-        if (!tr) {
-            /* Unmatched transactions translated without an explicit context */
-            trace_message (self, message, FALSE, "response", NULL);
-            g_debug ("[%s] No transaction matched in received message",
-                     self->priv->path_display);
-        } else {
-            /* Matched transactions translated with the same context as the request */
-            trace_message (self, message, FALSE, "response", tr->message_context);
-            /* Report the reply message */
-            transaction_complete_and_free (tr, message, NULL);
-        }
-
-        return;
+    /* If the version of the message is greater than the version of the service,
+     * report unsupported */
+    if (message_major > version->major ||
+        (message_major == version->major &&
+         message_minor > version->minor)) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_UNSUPPORTED,
+                     "QMI service '%s' version '%u.%u' required, got version '%u.%u'",
+                     qmi_service_get_string (service),
+                     message_major, message_minor,
+                     version->major, version->minor);
+        return FALSE;
     }
 
-    /* Unexpected message types translated without an explicit context */
-    trace_message (self, message, FALSE, "unexpected message", NULL);
-    g_debug ("[%s] Message received but it is neither an indication nor a response. Skipping it.",
-             self->priv->path_display);
+    /* Supported! */
+    return TRUE;
 }
 
-static void
-parse_response (QmiDevice *self)
+gboolean
+qmi_device_check_message_supported (QmiDevice          *self,
+                                    QmiMessage         *message,
+                                    QmiMessageContext  *message_context,
+                                    GError            **error)
 {
-    do {
-        GError *error = NULL;
-        QmiMessage *message;
-
-        /* Every message received must start with the QMUX marker.
-         * If it doesn't, we broke framing :-/
-         * If we broke framing, an error should be reported and the device
-         * should get closed */
-        if (self->priv->buffer->len > 0 &&
-            self->priv->buffer->data[0] != QMI_MESSAGE_QMUX_MARKER) {
-            /* TODO: Report fatal error */
-            g_warning ("[%s] QMI framing error detected",
-                       self->priv->path_display);
-            return;
-        }
+    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+    g_return_val_if_fail (message != NULL, FALSE);
 
-        message = qmi_message_new_from_raw (self->priv->buffer, &error);
-        if (!message) {
-            if (!error)
-                /* More data we need */
-                return;
+    return check_message_supported (self, message, message_context, error);
+}
 
-            /* Warn about the issue */
-            g_warning ("[%s] Invalid QMI message received: '%s'",
-                       self->priv->path_display,
-                       error->message);
-            g_error_free (error);
+/*****************************************************************************/
 
-            if (qmi_utils_get_traces_enabled ()) {
-                gchar *printable;
-                guint len = MIN (self->priv->buffer->len, 2048);
+GFile *
+qmi_device_get_file (QmiDevice *self)
+{
+    GFile *file = NULL;
 
-                printable = __qmi_utils_str_hex (self->priv->buffer->data, len, ':');
-                g_debug ("<<<<<< RAW INVALID MESSAGE:\n"
-                         "<<<<<<   length = %u\n"
-                         "<<<<<<   data   = %s\n",
-                         self->priv->buffer->len, /* show full buffer len */
-                         printable);
-                g_free (printable);
-            }
+    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
 
-        } else {
-            /* Play with the received message */
-            process_message (self, message);
-            qmi_message_unref (message);
-        }
-    } while (self->priv->buffer->len > 0);
+    g_object_get (G_OBJECT (self),
+                  QMI_DEVICE_FILE, &file,
+                  NULL);
+    return file;
 }
 
-static gboolean
-input_ready_cb (GInputStream *istream,
-                QmiDevice *self)
+GFile *
+qmi_device_peek_file (QmiDevice *self)
 {
-    guint8 buffer[BUFFER_SIZE];
-    GError *error = NULL;
-    gssize r;
+    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
 
-    r = g_pollable_input_stream_read_nonblocking (G_POLLABLE_INPUT_STREAM (istream),
-                                                  buffer,
-                                                  BUFFER_SIZE,
-                                                  NULL,
-                                                  &error);
-    if (r < 0) {
-        g_warning ("Error reading from istream: %s", error ? error->message : "unknown");
-        if (error)
-            g_error_free (error);
-        /* Close the device */
-        qmi_device_close (self, NULL);
-        return G_SOURCE_REMOVE;
-    }
+    return self->priv->file;
+}
 
-    if (r == 0) {
-        /* HUP! */
-        g_warning ("Cannot read from istream: connection broken");
-        g_signal_emit (self, signals[SIGNAL_REMOVED], 0);
-        return G_SOURCE_REMOVE;
-    }
+const gchar *
+qmi_device_get_path (QmiDevice *self)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
 
-    /* else, r > 0 */
-    if (!G_UNLIKELY (self->priv->buffer))
-        self->priv->buffer = g_byte_array_sized_new (r);
-    g_byte_array_append (self->priv->buffer, buffer, r);
+    return self->priv->path;
+}
 
-    parse_response (self);
+const gchar *
+qmi_device_get_path_display (QmiDevice *self)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
 
-    return G_SOURCE_CONTINUE;
+    return self->priv->path_display;
 }
 
-typedef struct {
-    guint spawn_retries;
-} CreateIostreamContext;
-
-static void
-create_iostream_context_free (CreateIostreamContext *ctx)
+gboolean
+qmi_device_is_open (QmiDevice *self)
 {
-    g_slice_free (CreateIostreamContext, ctx);
+    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+
+#if defined HAVE_LINUX_QRTR_H
+    if (self->priv->qrtr_node && __qmi_qrtr_node_is_open (self->priv->qrtr_node))
+        return TRUE;
+#endif
+
+    return !!(self->priv->istream && self->priv->ostream);
 }
 
+/*****************************************************************************/
+/* WWAN iface name
+ *
+ * The name is cached, but validated on every lookup with a single stat() of
+ * its sysfs entry under the control port device; if the interface was renamed
+ * or removed the entry is gone, and only then the (more expensive) sysfs
+ * directory enumeration is run again.
+ *
+ * All the sysfs helpers below work on plain strings and not on the QmiDevice,
+ * so that they can also be run in a worker thread by the async methods. */
+
+static const gchar *wwan_iface_driver_names[] = { "usbmisc", "usb" };
+
 static gboolean
-create_iostream_finish (QmiDevice *self,
-                        GAsyncResult *res,
-                        GError **error)
+wwan_iface_name_validate (const gchar *cdc_wdm_device_name,
+                          const gchar *wwan_iface)
 {
-    return g_task_propagate_boolean (G_TASK (res), error);
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (wwan_iface_driver_names); i++) {
+        gchar    *sysfs_path;
+        gboolean  exists;
+
+        sysfs_path = g_strdup_printf ("/sys/class/%s/%s/device/net/%s",
+                                      wwan_iface_driver_names[i], cdc_wdm_device_name, wwan_iface);
+        exists = g_file_test (sysfs_path, G_FILE_TEST_EXISTS);
+        g_free (sysfs_path);
+        if (exists)
+            return TRUE;
+    }
+    return FALSE;
 }
 
-static void
-setup_iostream (GTask *task)
+static gchar *
+wwan_iface_name_lookup (const gchar *path,
+                        const gchar *path_display,
+                        const gchar *cached)
 {
-    QmiDevice *self;
-
-    self = g_task_get_source_object (task);
+    const gchar *cdc_wdm_device_name;
+    gchar *wwan_iface = NULL;
+    guint i;
 
-    /* Check in/out streams */
-    if (!self->priv->istream || !self->priv->ostream) {
-        g_clear_object (&self->priv->istream);
-        g_clear_object (&self->priv->ostream);
-        g_clear_object (&self->priv->socket_connection);
-        g_clear_object (&self->priv->socket_client);
-        g_task_return_new_error (task,
-                                 QMI_CORE_ERROR,
-                                 QMI_CORE_ERROR_FAILED,
-                                 "Cannot get input/output streams");
-        g_object_unref (task);
-        return;
+    cdc_wdm_device_name = strrchr (path, '/');
+    if (!cdc_wdm_device_name) {
+        g_warning ("[%s] invalid path for cdc-wdm control port", path_display);
+        return NULL;
     }
+    cdc_wdm_device_name++;
 
-    /* Setup input events */
-    self->priv->input_source = (g_pollable_input_stream_create_source (
-                                    G_POLLABLE_INPUT_STREAM (
-                                        self->priv->istream),
-                                    NULL));
+    if (cached && wwan_iface_name_validate (cdc_wdm_device_name, cached))
+        return g_strdup (cached);
+
+    for (i = 0; i < G_N_ELEMENTS (wwan_iface_driver_names) && !wwan_iface; i++) {
+        gchar *sysfs_path;
+        GFile *sysfs_file;
+        GFileEnumerator *enumerator;
+        GError *error = NULL;
+
+        sysfs_path = g_strdup_printf ("/sys/class/%s/%s/device/net/", wwan_iface_driver_names[i], cdc_wdm_device_name);
+        sysfs_file = g_file_new_for_path (sysfs_path);
+        enumerator = g_file_enumerate_children (sysfs_file,
+                                                G_FILE_ATTRIBUTE_STANDARD_NAME,
+                                                G_FILE_QUERY_INFO_NONE,
+                                                NULL,
+                                                &error);
+        if (!enumerator) {
+            g_debug ("[%s] cannot enumerate files at path '%s': %s",
+                     path_display,
+                     sysfs_path,
+                     error->message);
+            g_error_free (error);
+        } else {
+            GFileInfo *file_info;
+
+            /* Ignore errors when enumerating */
+            while ((file_info = g_file_enumerator_next_file (enumerator, NULL, NULL)) != NULL) {
+                const gchar *name;
+
+                name = g_file_info_get_name (file_info);
+                if (name) {
+                    /* We only expect ONE file in the sysfs directory corresponding
+                     * to this control port, if more found for any reason, warn about it */
+                    if (wwan_iface)
+                        g_warning ("[%s] invalid additional wwan iface found: %s",
+                               path_display, name);
+                    else
+                        wwan_iface = g_strdup (name);
+                }
+                g_object_unref (file_info);
+            }
+
+            g_object_unref (enumerator);
+        }
+
+        g_free (sysfs_path);
+        g_object_unref (sysfs_file);
+    }
+
+    if (!wwan_iface)
+        g_warning ("[%s] wwan iface not found", path_display);
+    return wwan_iface;
+}
+
+/* Takes ownership of the given name */
+static void
+set_wwan_iface_name (QmiDevice *self,
+                     gchar     *wwan_iface)
+{
+    /* Keep the previous string if unchanged, so that pointers returned by
+     * qmi_device_get_wwan_iface() stay valid as long as possible */
+    if (g_strcmp0 (wwan_iface, self->priv->wwan_iface) == 0) {
+        g_free (wwan_iface);
+        return;
+    }
+
+    if (self->priv->wwan_iface && wwan_iface)
+        g_debug ("[%s] wwan iface renamed: %s -> %s",
+                 self->priv->path_display, self->priv->wwan_iface, wwan_iface);
+    g_free (self->priv->wwan_iface);
+    self->priv->wwan_iface = wwan_iface;
+}
+
+static void
+reload_wwan_iface_name (QmiDevice *self)
+{
+    set_wwan_iface_name (self, wwan_iface_name_lookup (self->priv->path,
+                                                       self->priv->path_display,
+                                                       self->priv->wwan_iface));
+}
+
+const gchar *
+qmi_device_get_wwan_iface (QmiDevice *self)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
+
+    reload_wwan_iface_name (self);
+    return self->priv->wwan_iface;
+}
+
+/*****************************************************************************/
+/* Expected data format */
+
+static gboolean
+get_expected_data_format (const gchar *path_display,
+                          const gchar *sysfs_path,
+                          GError **error)
+{
+    QmiDeviceExpectedDataFormat expected = QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN;
+    gchar value = '\0';
+    FILE *f;
+
+    g_debug ("[%s] Reading expected data format from: %s",
+             path_display,
+             sysfs_path);
+
+    if (!(f = fopen (sysfs_path, "r"))) {
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                     "Failed to open file '%s': %s",
+                     sysfs_path, g_strerror (errno));
+        goto out;
+    }
+
+    if (fread (&value, 1, 1, f) != 1) {
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                     "Failed to read from file '%s': %s",
+                     sysfs_path, g_strerror (errno));
+        goto out;
+    }
+
+    if (value == 'Y')
+        expected = QMI_DEVICE_EXPECTED_DATA_FORMAT_RAW_IP;
+    else if (value == 'N')
+        expected = QMI_DEVICE_EXPECTED_DATA_FORMAT_802_3;
+    else
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
+                     "Unexpected sysfs file contents");
+
+ out:
+    g_prefix_error (error, "Expected data format not retrieved properly: ");
+    if (f)
+        fclose (f);
+    return expected;
+}
+
+static gboolean
+set_expected_data_format (const gchar *path_display,
+                          const gchar *sysfs_path,
+                          QmiDeviceExpectedDataFormat requested,
+                          GError **error)
+{
+    gboolean status = FALSE;
+    gchar value;
+    FILE *f;
+
+    g_debug ("[%s] Writing expected data format to: %s",
+             path_display,
+             sysfs_path);
+
+    if (requested == QMI_DEVICE_EXPECTED_DATA_FORMAT_RAW_IP)
+        value = 'Y';
+    else if (requested == QMI_DEVICE_EXPECTED_DATA_FORMAT_802_3)
+        value = 'N';
+    else
+        g_assert_not_reached ();
+
+    if (!(f = fopen (sysfs_path, "w"))) {
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                     "Failed to open file '%s' for R/W: %s",
+                     sysfs_path, g_strerror (errno));
+        goto out;
+    }
+
+    if (fwrite (&value, 1, 1, f) != 1) {
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                     "Failed to write to file '%s': %s",
+                     sysfs_path, g_strerror (errno));
+        goto out;
+    }
+
+    status = TRUE;
+
+ out:
+    g_prefix_error (error, "Expected data format not updated properly: ");
+    if (f)
+        fclose (f);
+    return status;
+}
+
+static QmiDeviceExpectedDataFormat
+common_get_set_expected_data_format (const gchar *path_display,
+                                     const gchar *wwan_iface,
+                                     QmiDeviceExpectedDataFormat requested,
+                                     GError **error)
+{
+    gchar *sysfs_path = NULL;
+    QmiDeviceExpectedDataFormat expected = QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN;
+    gboolean readonly;
+
+    readonly = (requested == QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN);
+
+    if (!wwan_iface) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
+                     "Unknown wwan iface");
+        goto out;
+    }
+
+    /* Build sysfs file path and open it */
+    sysfs_path = g_strdup_printf ("/sys/class/net/%s/qmi/raw_ip", wwan_iface);
+
+    /* Set operation? */
+    if (!readonly && !set_expected_data_format (path_display, sysfs_path, requested, error))
+        goto out;
+
+    /* Get/Set operations */
+    if ((expected = get_expected_data_format (path_display, sysfs_path, error)) == QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN)
+        goto out;
+
+    /* If we requested an update but we didn't read that value, report an error */
+    if (!readonly && (requested != expected)) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
+                     "Expected data format not updated properly to '%s': got '%s' instead",
+                     qmi_device_expected_data_format_get_string (requested),
+                     qmi_device_expected_data_format_get_string (expected));
+        expected = QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN;
+    }
+
+ out:
+    g_free (sysfs_path);
+    return expected;
+}
+
+QmiDeviceExpectedDataFormat
+qmi_device_get_expected_data_format (QmiDevice  *self,
+                                     GError    **error)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN);
+
+    /* Make sure we load the WWAN iface name */
+    reload_wwan_iface_name (self);
+    return common_get_set_expected_data_format (self->priv->path_display,
+                                                self->priv->wwan_iface,
+                                                QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN,
+                                                error);
+}
+
+gboolean
+qmi_device_set_expected_data_format (QmiDevice *self,
+                                     QmiDeviceExpectedDataFormat format,
+                                     GError **error)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+
+    /* Make sure we load the WWAN iface name */
+    reload_wwan_iface_name (self);
+    return (common_get_set_expected_data_format (self->priv->path_display,
+                                                 self->priv->wwan_iface,
+                                                 format,
+                                                 error) != QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN);
+}
+
+/*****************************************************************************/
+/* Async WWAN iface and expected data format
+ *
+ * Same sysfs operations as above, run in a worker thread so that the caller's
+ * main loop isn't blocked. The cached WWAN iface name is only updated in the
+ * caller's context, when the operation is finished. */
+
+typedef struct {
+    gchar                       *path;
+    gchar                       *path_display;
+    gchar                       *cached_wwan_iface;
+    gboolean                     data_format;
+    QmiDeviceExpectedDataFormat  requested;
+    /* outputs */
+    gchar                       *wwan_iface;
+    QmiDeviceExpectedDataFormat  expected;
+} SysfsProbeContext;
+
+static void
+sysfs_probe_context_free (SysfsProbeContext *ctx)
+{
+    g_free (ctx->path);
+    g_free (ctx->path_display);
+    g_free (ctx->cached_wwan_iface);
+    g_free (ctx->wwan_iface);
+    g_slice_free (SysfsProbeContext, ctx);
+}
+
+static void
+sysfs_probe_thread (GTask             *task,
+                    gpointer           source_object,
+                    SysfsProbeContext *ctx,
+                    GCancellable      *cancellable)
+{
+    GError *error = NULL;
+
+    ctx->wwan_iface = wwan_iface_name_lookup (ctx->path, ctx->path_display, ctx->cached_wwan_iface);
+
+    if (!ctx->data_format) {
+        if (!ctx->wwan_iface)
+            g_task_return_new_error (task, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
+                                     "Unknown wwan iface");
+        else
+            g_task_return_boolean (task, TRUE);
+        return;
+    }
+
+    ctx->expected = common_get_set_expected_data_format (ctx->path_display,
+                                                         ctx->wwan_iface,
+                                                         ctx->requested,
+                                                         &error);
+    if (ctx->expected == QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN)
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
+}
+
+static void
+sysfs_probe_run (QmiDevice                   *self,
+                 gboolean                     data_format,
+                 QmiDeviceExpectedDataFormat  requested,
+                 GCancellable                *cancellable,
+                 GAsyncReadyCallback          callback,
+                 gpointer                     user_data)
+{
+    SysfsProbeContext *ctx;
+    GTask             *task;
+
+    ctx = g_slice_new0 (SysfsProbeContext);
+    ctx->path = g_strdup (self->priv->path);
+    ctx->path_display = g_strdup (self->priv->path_display);
+    ctx->cached_wwan_iface = g_strdup (self->priv->wwan_iface);
+    ctx->data_format = data_format;
+    ctx->requested = requested;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_task_data (task, ctx, (GDestroyNotify)sysfs_probe_context_free);
+    g_task_run_in_thread (task, (GTaskThreadFunc)sysfs_probe_thread);
+    g_object_unref (task);
+}
+
+static SysfsProbeContext *
+sysfs_probe_finish (QmiDevice     *self,
+                    GAsyncResult  *res,
+                    GError       **error)
+{
+    SysfsProbeContext *ctx;
+
+    ctx = g_task_get_task_data (G_TASK (res));
+
+    /* Update the cache, even if the data format operation failed */
+    set_wwan_iface_name (self, ctx->wwan_iface);
+    ctx->wwan_iface = NULL;
+
+    if (!g_task_propagate_boolean (G_TASK (res), error))
+        return NULL;
+    return ctx;
+}
+
+void
+qmi_device_load_wwan_iface (QmiDevice           *self,
+                            GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+
+    sysfs_probe_run (self, FALSE, QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN, cancellable, callback, user_data);
+}
+
+const gchar *
+qmi_device_load_wwan_iface_finish (QmiDevice     *self,
+                                   GAsyncResult  *res,
+                                   GError       **error)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
+
+    if (!sysfs_probe_finish (self, res, error))
+        return NULL;
+    return self->priv->wwan_iface;
+}
+
+void
+qmi_device_load_expected_data_format (QmiDevice           *self,
+                                      GCancellable        *cancellable,
+                                      GAsyncReadyCallback  callback,
+                                      gpointer             user_data)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+
+    sysfs_probe_run (self, TRUE, QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN, cancellable, callback, user_data);
+}
+
+QmiDeviceExpectedDataFormat
+qmi_device_load_expected_data_format_finish (QmiDevice     *self,
+                                             GAsyncResult  *res,
+                                             GError       **error)
+{
+    SysfsProbeContext *ctx;
+
+    g_return_val_if_fail (QMI_IS_DEVICE (self), QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN);
+
+    ctx = sysfs_probe_finish (self, res, error);
+    return (ctx ? ctx->expected : QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN);
+}
+
+void
+qmi_device_update_expected_data_format (QmiDevice                   *self,
+                                        QmiDeviceExpectedDataFormat  format,
+                                        GCancellable                *cancellable,
+                                        GAsyncReadyCallback          callback,
+                                        gpointer                     user_data)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (format == QMI_DEVICE_EXPECTED_DATA_FORMAT_802_3 ||
+                      format == QMI_DEVICE_EXPECTED_DATA_FORMAT_RAW_IP);
+
+    sysfs_probe_run (self, TRUE, format, cancellable, callback, user_data);
+}
+
+gboolean
+qmi_device_update_expected_data_format_finish (QmiDevice     *self,
+                                               GAsyncResult  *res,
+                                               GError       **error)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+
+    return !!sysfs_probe_finish (self, res, error);
+}
+
+/*****************************************************************************/
+/* Multiplexed links
+ *
+ * Managed through sysfs in a worker thread as the other sysfs operations, see
+ * qmi-mux-links.h. The cache of known links is only updated in the caller's
+ * context, when the operation is finished. */
+
+typedef enum {
+    MUX_LINK_OPERATION_ADD,
+    MUX_LINK_OPERATION_DELETE,
+    MUX_LINK_OPERATION_LIST,
+} MuxLinkOperation;
+
+typedef struct {
+    MuxLinkOperation  operation;
+    gchar            *path;
+    gchar            *path_display;
+    gchar            *cached_wwan_iface;
+    guint8            mux_id;
+    gchar            *cached_ifname;
+    /* outputs */
+    gchar            *wwan_iface;
+    gchar            *ifname;
+    GArray           *links;
+} MuxLinkContext;
+
+static void
+mux_link_context_free (MuxLinkContext *ctx)
+{
+    g_free (ctx->path);
+    g_free (ctx->path_display);
+    g_free (ctx->cached_wwan_iface);
+    g_free (ctx->cached_ifname);
+    g_free (ctx->wwan_iface);
+    g_free (ctx->ifname);
+    if (ctx->links)
+        g_array_unref (ctx->links);
+    g_slice_free (MuxLinkContext, ctx);
+}
+
+static void
+mux_link_thread (GTask          *task,
+                 gpointer        source_object,
+                 MuxLinkContext *ctx,
+                 GCancellable   *cancellable)
+{
+    GError *error = NULL;
+
+    ctx->wwan_iface = wwan_iface_name_lookup (ctx->path, ctx->path_display, ctx->cached_wwan_iface);
+    if (!ctx->wwan_iface) {
+        g_task_return_new_error (task, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
+                                 "Unknown wwan iface");
+        return;
+    }
+
+    switch (ctx->operation) {
+    case MUX_LINK_OPERATION_ADD:
+        ctx->ifname = __qmi_mux_link_add (QMI_MUX_LINKS_SYSFS_NET_PATH,
+                                          ctx->path_display,
+                                          ctx->wwan_iface,
+                                          ctx->mux_id,
+                                          ctx->cached_ifname,
+                                          &ctx->links,
+                                          &error);
+        if (!ctx->ifname) {
+            g_task_return_error (task, error);
+            return;
+        }
+        break;
+    case MUX_LINK_OPERATION_DELETE:
+        if (!__qmi_mux_link_delete (QMI_MUX_LINKS_SYSFS_NET_PATH,
+                                    ctx->path_display,
+                                    ctx->wwan_iface,
+                                    ctx->mux_id,
+                                    &ctx->links,
+                                    &error)) {
+            g_task_return_error (task, error);
+            return;
+        }
+        break;
+    case MUX_LINK_OPERATION_LIST:
+        ctx->links = __qmi_mux_links_list (QMI_MUX_LINKS_SYSFS_NET_PATH,
+                                           ctx->path_display,
+                                           ctx->wwan_iface,
+                                           &error);
+        if (!ctx->links) {
+            g_task_return_error (task, error);
+            return;
+        }
+        break;
+    default:
+        g_assert_not_reached ();
+    }
+
+    g_task_return_boolean (task, TRUE);
+}
+
+static void
+mux_link_run (QmiDevice           *self,
+              MuxLinkOperation     operation,
+              guint8               mux_id,
+              GCancellable        *cancellable,
+              GAsyncReadyCallback  callback,
+              gpointer             user_data)
+{
+    MuxLinkContext *ctx;
+    GTask          *task;
+
+    ctx = g_slice_new0 (MuxLinkContext);
+    ctx->operation = operation;
+    ctx->path = g_strdup (self->priv->path);
+    ctx->path_display = g_strdup (self->priv->path_display);
+    ctx->cached_wwan_iface = g_strdup (self->priv->wwan_iface);
+    ctx->mux_id = mux_id;
+    ctx->cached_ifname = g_strdup (g_hash_table_lookup (self->priv->mux_links, GUINT_TO_POINTER (mux_id)));
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_task_data (task, ctx, (GDestroyNotify)mux_link_context_free);
+    g_task_run_in_thread (task, (GTaskThreadFunc)mux_link_thread);
+    g_object_unref (task);
+}
+
+static MuxLinkContext *
+mux_link_finish (QmiDevice     *self,
+                 GAsyncResult  *res,
+                 GError       **error)
+{
+    MuxLinkContext *ctx;
+    guint           i;
+
+    ctx = g_task_get_task_data (G_TASK (res));
+
+    /* Links of a different WWAN iface are of no use */
+    if (g_strcmp0 (ctx->wwan_iface, self->priv->wwan_iface) != 0)
+        g_hash_table_remove_all (self->priv->mux_links);
+    set_wwan_iface_name (self, ctx->wwan_iface);
+    ctx->wwan_iface = NULL;
+
+    if (!g_task_propagate_boolean (G_TASK (res), error))
+        return NULL;
+
+    /* Whenever all links are looked up, the cache is fully refreshed */
+    if (ctx->links) {
+        g_hash_table_remove_all (self->priv->mux_links);
+        for (i = 0; i < ctx->links->len; i++) {
+            QmiDeviceMuxLink *link;
+
+            link = &g_array_index (ctx->links, QmiDeviceMuxLink, i);
+            g_hash_table_insert (self->priv->mux_links, GUINT_TO_POINTER (link->mux_id), g_strdup (link->ifname));
+        }
+    }
+
+    switch (ctx->operation) {
+    case MUX_LINK_OPERATION_ADD:
+        g_hash_table_insert (self->priv->mux_links, GUINT_TO_POINTER (ctx->mux_id), g_strdup (ctx->ifname));
+        break;
+    case MUX_LINK_OPERATION_DELETE:
+        g_hash_table_remove (self->priv->mux_links, GUINT_TO_POINTER (ctx->mux_id));
+        break;
+    case MUX_LINK_OPERATION_LIST:
+        break;
+    default:
+        g_assert_not_reached ();
+    }
+
+    return ctx;
+}
+
+void
+qmi_device_add_mux_link (QmiDevice           *self,
+                         guint8               mux_id,
+                         GCancellable        *cancellable,
+                         GAsyncReadyCallback  callback,
+                         gpointer             user_data)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (mux_id > 0 && mux_id < G_MAXUINT8);
+
+    mux_link_run (self, MUX_LINK_OPERATION_ADD, mux_id, cancellable, callback, user_data);
+}
+
+gchar *
+qmi_device_add_mux_link_finish (QmiDevice     *self,
+                                GAsyncResult  *res,
+                                GError       **error)
+{
+    MuxLinkContext *ctx;
+
+    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
+
+    ctx = mux_link_finish (self, res, error);
+    return (ctx ? g_strdup (ctx->ifname) : NULL);
+}
+
+void
+qmi_device_delete_mux_link (QmiDevice           *self,
+                            guint8               mux_id,
+                            GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+
+    mux_link_run (self, MUX_LINK_OPERATION_DELETE, mux_id, cancellable, callback, user_data);
+}
+
+gboolean
+qmi_device_delete_mux_link_finish (QmiDevice     *self,
+                                   GAsyncResult  *res,
+                                   GError       **error)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+
+    return !!mux_link_finish (self, res, error);
+}
+
+void
+qmi_device_list_mux_links (QmiDevice           *self,
+                           GCancellable        *cancellable,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+
+    mux_link_run (self, MUX_LINK_OPERATION_LIST, 0, cancellable, callback, user_data);
+}
+
+GArray *
+qmi_device_list_mux_links_finish (QmiDevice     *self,
+                                  GAsyncResult  *res,
+                                  GError       **error)
+{
+    MuxLinkContext *ctx;
+
+    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
+
+    ctx = mux_link_finish (self, res, error);
+    return (ctx ? g_array_ref (ctx->links) : NULL);
+}
+
+/*****************************************************************************/
+/* Port enumeration
+ *
+ * Same sysfs layout as used by the lookups above, but walked once for all the
+ * cdc-wdm ports in the system, in a worker thread. */
+
+QmiDevicePortInfo *
+qmi_device_port_info_copy (const QmiDevicePortInfo *info)
+{
+    QmiDevicePortInfo *copy;
+
+    g_return_val_if_fail (info != NULL, NULL);
+
+    copy = g_slice_new0 (QmiDevicePortInfo);
+    copy->path = g_strdup (info->path);
+    copy->driver = g_strdup (info->driver);
+    copy->wwan_iface = g_strdup (info->wwan_iface);
+    copy->physdev_path = g_strdup (info->physdev_path);
+    copy->expected_data_format = info->expected_data_format;
+    return copy;
+}
+
+void
+qmi_device_port_info_free (QmiDevicePortInfo *info)
+{
+    if (!info)
+        return;
+
+    g_free (info->path);
+    g_free (info->driver);
+    g_free (info->wwan_iface);
+    g_free (info->physdev_path);
+    g_slice_free (QmiDevicePortInfo, info);
+}
+
+GType
+qmi_device_port_info_get_type (void)
+{
+    static volatile gsize g_define_type_id__volatile = 0;
+
+    if (g_once_init_enter (&g_define_type_id__volatile)) {
+        GType g_define_type_id =
+            g_boxed_type_register_static (g_intern_static_string ("QmiDevicePortInfo"),
+                                          (GBoxedCopyFunc) qmi_device_port_info_copy,
+                                          (GBoxedFreeFunc) qmi_device_port_info_free);
+
+        g_once_init_leave (&g_define_type_id__volatile, g_define_type_id);
+    }
+
+    return g_define_type_id__volatile;
+}
+
+static gboolean
+port_driver_is_qmi_capable (const gchar *driver)
+{
+    if (!g_strcmp0 (driver, "qmi_wwan"))
+        return TRUE;
+#if defined MBIM_QMUX_ENABLED
+    if (!g_strcmp0 (driver, "cdc_mbim"))
+        return TRUE;
+#endif
+    return FALSE;
+}
+
+/* e.g. /sys/class/usbmisc/cdc-wdm0 */
+static QmiDevicePortInfo *
+port_info_load (const gchar *class_path,
+                const gchar *name)
+{
+    QmiDevicePortInfo *info = NULL;
+    gchar             *tmp;
+    gchar             *interface_path;
+    gchar             *driver_path;
+    gchar             *usb_device_path;
+    GDir              *dir;
+
+    /* The USB interface, e.g.
+     *    $ realpath /sys/class/usbmisc/cdc-wdm0/device
+     *    /sys/devices/pci0000:00/0000:00:14.0/usb2/2-3/2-3:1.8
+     */
+    tmp = g_build_filename (class_path, name, "device", NULL);
+    interface_path = realpath (tmp, NULL);
+    g_free (tmp);
+    if (!interface_path)
+        return NULL;
+
+    tmp = g_build_filename (interface_path, "driver", NULL);
+    driver_path = realpath (tmp, NULL);
+    g_free (tmp);
+    if (!driver_path)
+        goto out;
+
+    info = g_slice_new0 (QmiDevicePortInfo);
+    info->driver = g_path_get_basename (driver_path);
+    g_free (driver_path);
+    if (!port_driver_is_qmi_capable (info->driver)) {
+        g_clear_pointer (&info, qmi_device_port_info_free);
+        goto out;
+    }
+    info->path = g_build_filename ("/dev", name, NULL);
+
+    /* Only one network interface expected */
+    tmp = g_build_filename (interface_path, "net", NULL);
+    dir = g_dir_open (tmp, 0, NULL);
+    g_free (tmp);
+    if (dir) {
+        info->wwan_iface = g_strdup (g_dir_read_name (dir));
+        g_dir_close (dir);
+    }
+
+    /* The parent of the interface is the USB device */
+    usb_device_path = g_path_get_dirname (interface_path);
+    tmp = g_build_filename (usb_device_path, "idVendor", NULL);
+    if (g_file_test (tmp, G_FILE_TEST_EXISTS))
+        info->physdev_path = usb_device_path;
+    else
+        g_free (usb_device_path);
+    g_free (tmp);
+
+    /* Not available e.g. with the cdc_mbim driver */
+    if (info->wwan_iface) {
+        tmp = g_strdup_printf ("/sys/class/net/%s/qmi/raw_ip", info->wwan_iface);
+        if (g_file_test (tmp, G_FILE_TEST_EXISTS))
+            info->expected_data_format = get_expected_data_format (info->path, tmp, NULL);
+        g_free (tmp);
+    }
+
+out:
+    g_free (interface_path);
+    return info;
+}
+
+/* Shorter paths first, so that cdc-wdm2 goes before cdc-wdm10 */
+static gint
+port_info_cmp (const QmiDevicePortInfo **a,
+               const QmiDevicePortInfo **b)
+{
+    gsize len_a;
+    gsize len_b;
+
+    len_a = strlen ((*a)->path);
+    len_b = strlen ((*b)->path);
+    if (len_a != len_b)
+        return (len_a < len_b) ? -1 : 1;
+    return strcmp ((*a)->path, (*b)->path);
+}
+
+static void
+enumerate_ports_thread (GTask        *task,
+                        gpointer      source_object,
+                        gpointer      task_data,
+                        GCancellable *cancellable)
+{
+    GPtrArray  *ports;
+    GHashTable *seen;
+    guint       i;
+
+    ports = g_ptr_array_new_with_free_func ((GDestroyNotify) qmi_device_port_info_free);
+    seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    /* Same subsystems as for the wwan iface lookup */
+    for (i = 0; i < G_N_ELEMENTS (wwan_iface_driver_names); i++) {
+        gchar       *class_path;
+        GDir        *dir;
+        const gchar *name;
+
+        class_path = g_build_filename ("/sys/class", wwan_iface_driver_names[i], NULL);
+        dir = g_dir_open (class_path, 0, NULL);
+        while (dir && (name = g_dir_read_name (dir)) != NULL) {
+            QmiDevicePortInfo *info;
+
+            if (!g_str_has_prefix (name, "cdc-wdm") || g_hash_table_contains (seen, name))
+                continue;
+            g_hash_table_add (seen, g_strdup (name));
+
+            if (g_cancellable_is_cancelled (cancellable))
+                break;
+
+            info = port_info_load (class_path, name);
+            if (info)
+                g_ptr_array_add (ports, info);
+        }
+        if (dir)
+            g_dir_close (dir);
+        g_free (class_path);
+    }
+
+    g_hash_table_unref (seen);
+
+    if (g_task_return_error_if_cancelled (task)) {
+        g_ptr_array_unref (ports);
+        return;
+    }
+
+    g_ptr_array_sort (ports, (GCompareFunc) port_info_cmp);
+    g_task_return_pointer (task, ports, (GDestroyNotify) g_ptr_array_unref);
+}
+
+void
+qmi_device_enumerate_ports (GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data)
+{
+    GTask *task;
+
+    task = g_task_new (NULL, cancellable, callback, user_data);
+    g_task_run_in_thread (task, enumerate_ports_thread);
+    g_object_unref (task);
+}
+
+GPtrArray *
+qmi_device_enumerate_ports_finish (GAsyncResult  *res,
+                                   GError       **error)
+{
+    g_return_val_if_fail (g_task_is_valid (res, NULL), NULL);
+
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+/*****************************************************************************/
+/* Register/Unregister clients that want to receive indications */
+
+static void indication_cache_replay (QmiDevice *self,
+                                     QmiClient *client);
+
+static gpointer
+build_registered_client_key (guint8 cid,
+                             QmiService service)
+{
+    return GUINT_TO_POINTER (((guint8)service << 8) | cid);
+}
+
+static gboolean
+register_client (QmiDevice *self,
+                 QmiClient *client,
+                 GError **error)
+{
+    gpointer key;
+    guint8   service;
+
+    key = build_registered_client_key (qmi_client_get_cid (client),
+                                       qmi_client_get_service (client));
+    /* Only add the new client if not already registered one with the same CID
+     * for the same service */
+    if (g_hash_table_lookup (self->priv->registered_clients, key)) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_FAILED,
+                     "A client with CID '%u' and service '%s' is already registered",
+                     qmi_client_get_cid (client),
+                     qmi_service_get_string (qmi_client_get_service (client)));
+        return FALSE;
+    }
+
+    g_hash_table_insert (self->priv->registered_clients,
+                         key,
+                         g_object_ref (client));
+
+    service = (guint8) qmi_client_get_service (client);
+    if (!self->priv->registered_clients_by_service[service])
+        self->priv->registered_clients_by_service[service] = g_ptr_array_new ();
+    g_ptr_array_add (self->priv->registered_clients_by_service[service], client);
+    return TRUE;
+}
+
+static void
+unregister_client (QmiDevice *self,
+                   QmiClient *client)
+{
+    gpointer   key;
+    guint8     service;
+    QmiClient *registered;
+
+    key = build_registered_client_key (qmi_client_get_cid (client),
+                                       qmi_client_get_service (client));
+    registered = g_hash_table_lookup (self->priv->registered_clients, key);
+    if (!registered)
+        return;
+
+    service = (guint8) qmi_client_get_service (client);
+    if (self->priv->registered_clients_by_service[service])
+        g_ptr_array_remove (self->priv->registered_clients_by_service[service], registered);
+
+    __qmi_indication_registrations_forget (self->priv->indication_registrations,
+                                           qmi_client_get_service (registered),
+                                           qmi_client_get_cid (registered));
+    g_hash_table_remove (self->priv->registered_clients, key);
+}
+
+/*****************************************************************************/
+/* CID pool
+ *
+ * When enabled, CIDs of released clients are not released in the device but
+ * kept per service, and handed back to the next clients allocated for the same
+ * service. The pool may be stored in a key file, so that it is also reused by
+ * the next QmiDevice created for the same port (e.g. after a restart of the
+ * program); each port gets its own group in the file. A modem-wide CTL sync
+ * releases all CIDs, so the pool is cleared whenever that happens. As the
+ * device may also have been reset behind our back, a CID is always reset
+ * with the service before being reused, falling back to a new allocation if
+ * that fails. */
+
+#define CID_POOL_GROUP_PREFIX "cid-pool "
+#define CID_POOL_KEY_CIDS     "cids"
+/* The Reset request has the same ID in every service */
+#define CID_POOL_RESET_MESSAGE_ID 0x0000
+
+static gchar *
+cid_pool_build_group (QmiDevice *self)
+{
+    return g_strconcat (CID_POOL_GROUP_PREFIX, self->priv->path, NULL);
+}
+
+typedef struct {
+    QmiService service;
+    guint8     cid;
+} CidPoolEntry;
+
+static void
+cid_pool_load (QmiDevice *self)
+{
+    GKeyFile  *key_file;
+    gchar     *group;
+    gchar    **cids = NULL;
+    GError    *error = NULL;
+    guint      i;
+
+    if (self->priv->cid_pool)
+        return;
+
+    self->priv->cid_pool = g_array_new (FALSE, FALSE, sizeof (CidPoolEntry));
+    if (!self->priv->cid_pool_file)
+        return;
+
+    key_file = g_key_file_new ();
+    group = cid_pool_build_group (self);
+    if (!g_key_file_load_from_file (key_file, self->priv->cid_pool_file, G_KEY_FILE_NONE, &error) ||
+        !(cids = g_key_file_get_string_list (key_file,
+                                             group,
+                                             CID_POOL_KEY_CIDS,
+                                             NULL,
+                                             &error))) {
+        g_debug ("[%s] No stored CID pool available: %s",
+                 self->priv->path_display,
+                 error->message);
+        g_error_free (error);
+        goto out;
+    }
+
+    /* Each CID given as "<service>:<cid>" */
+    for (i = 0; cids[i]; i++) {
+        CidPoolEntry entry;
+        guint service;
+        guint cid;
+
+        if (sscanf (cids[i], "%u:%u", &service, &cid) != 2 ||
+            service == QMI_SERVICE_CTL || service > G_MAXUINT8 ||
+            cid == QMI_CID_NONE || cid >= QMI_CID_BROADCAST) {
+            g_debug ("[%s] Invalid stored CID pool entry: '%s'",
+                     self->priv->path_display,
+                     cids[i]);
+            continue;
+        }
+
+        entry.service = (QmiService) service;
+        entry.cid = (guint8) cid;
+        g_array_append_val (self->priv->cid_pool, entry);
+    }
+
+    g_debug ("[%s] Loaded %u CIDs from pool file '%s'",
+             self->priv->path_display,
+             self->priv->cid_pool->len,
+             self->priv->cid_pool_file);
+
+out:
+    g_strfreev (cids);
+    g_free (group);
+    g_key_file_free (key_file);
+}
+
+static void
+cid_pool_save (QmiDevice *self)
+{
+    GKeyFile  *key_file;
+    gchar     *group;
+    gchar    **cids;
+    gchar     *contents;
+    gsize      contents_length;
+    GError    *error = NULL;
+    guint      i;
+
+    if (!self->priv->cid_pool_file)
+        return;
+
+    cids = g_new0 (gchar *, self->priv->cid_pool->len + 1);
+    for (i = 0; i < self->priv->cid_pool->len; i++) {
+        CidPoolEntry *entry;
+
+        entry = &g_array_index (self->priv->cid_pool, CidPoolEntry, i);
+        cids[i] = g_strdup_printf ("%u:%u", (guint) entry->service, (guint) entry->cid);
+    }
+
+    /* The pools of other ports stored in the same file are kept */
+    key_file = g_key_file_new ();
+    g_key_file_load_from_file (key_file, self->priv->cid_pool_file, G_KEY_FILE_NONE, NULL);
+    group = cid_pool_build_group (self);
+    g_key_file_set_string_list (key_file,
+                                group,
+                                CID_POOL_KEY_CIDS,
+                                (const gchar * const *) cids,
+                                self->priv->cid_pool->len);
+    contents = g_key_file_to_data (key_file, &contents_length, NULL);
+
+    if (!g_file_set_contents (self->priv->cid_pool_file, contents, contents_length, &error)) {
+        g_debug ("[%s] Cannot store CID pool: %s",
+                 self->priv->path_display,
+                 error->message);
+        g_error_free (error);
+    }
+
+    g_free (contents);
+    g_free (group);
+    g_key_file_free (key_file);
+    g_strfreev (cids);
+}
+
+static guint8
+cid_pool_take (QmiDevice  *self,
+               QmiService  service)
+{
+    guint i;
+
+    if (!self->priv->cid_pool_enabled)
+        return QMI_CID_NONE;
+
+    cid_pool_load (self);
+    for (i = 0; i < self->priv->cid_pool->len; i++) {
+        CidPoolEntry *entry;
+        guint8 cid;
+
+        entry = &g_array_index (self->priv->cid_pool, CidPoolEntry, i);
+        if (entry->service != service)
+            continue;
+
+        cid = entry->cid;
+        g_array_remove_index (self->priv->cid_pool, i);
+        cid_pool_save (self);
+        return cid;
+    }
+
+    return QMI_CID_NONE;
+}
+
+static gboolean
+cid_pool_put (QmiDevice  *self,
+              QmiService  service,
+              guint8      cid)
+{
+    CidPoolEntry entry;
+
+    if (!self->priv->cid_pool_enabled)
+        return FALSE;
+
+    cid_pool_load (self);
+    entry.service = service;
+    entry.cid = cid;
+    g_array_append_val (self->priv->cid_pool, entry);
+    cid_pool_save (self);
+    return TRUE;
+}
+
+static void
+cid_pool_clear (QmiDevice *self)
+{
+    if (!self->priv->cid_pool_enabled)
+        return;
+
+    cid_pool_load (self);
+    if (self->priv->cid_pool->len == 0)
+        return;
+
+    g_debug ("[%s] Clearing CID pool (%u CIDs)",
+             self->priv->path_display,
+             self->priv->cid_pool->len);
+    g_array_set_size (self->priv->cid_pool, 0);
+    cid_pool_save (self);
+}
+
+/*****************************************************************************/
+/* Allocate new client */
+
+typedef struct {
+    QmiService service;
+    GType client_type;
+    guint8 cid;
+    guint timeout;
+} AllocateClientContext;
+
+static void
+allocate_client_context_free (AllocateClientContext *ctx)
+{
+    g_slice_free (AllocateClientContext, ctx);
+}
+
+QmiClient *
+qmi_device_allocate_client_finish (QmiDevice *self,
+                                   GAsyncResult *res,
+                                   GError **error)
+{
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+static void
+build_client_object (GTask *task)
+{
+    QmiDevice *self;
+    AllocateClientContext *ctx;
+    gchar *version_string = NULL;
+    QmiClient *client;
+    GError *error = NULL;
+    const QmiMessageCtlGetVersionInfoOutputServiceListService *version_info;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    /* We now have a proper CID for the client, we should be able to create it
+     * right away */
+    client = g_object_new (ctx->client_type,
+                           QMI_CLIENT_DEVICE,  self,
+                           QMI_CLIENT_SERVICE, ctx->service,
+                           QMI_CLIENT_CID,     ctx->cid,
+                           NULL);
+
+    /* Add version info to the client if it was retrieved */
+    version_info = find_service_version_info (self, ctx->service);
+    if (version_info)
+        g_object_set (client,
+                      QMI_CLIENT_VERSION_MAJOR, version_info->major_version,
+                      QMI_CLIENT_VERSION_MINOR, version_info->minor_version,
+                      NULL);
+
+    /* Register the client to get indications */
+    if (!register_client (self, client, &error)) {
+        g_prefix_error (&error,
+                        "Cannot register new client with CID '%u' and service '%s'",
+                        ctx->cid,
+                        qmi_service_get_string (ctx->service));
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        g_object_unref (client);
+        return;
+    }
+
+    /* Build version string for the logging */
+    if (self->priv->supported_services) {
+        const QmiMessageCtlGetVersionInfoOutputServiceListService *info;
+
+        info = find_service_version_info (self, ctx->service);
+        if (info)
+            version_string = g_strdup_printf ("%u.%u", info->major_version, info->minor_version);
+    }
+
+    g_debug ("[%s] Registered '%s' (version %s) client with ID '%u'",
+             self->priv->path_display,
+             qmi_service_get_string (ctx->service),
+             version_string ? version_string : "unknown",
+             ctx->cid);
+
+    g_free (version_string);
+
+    /* Client created and registered, complete successfully. The current
+     * state is reported once the client is given to the caller, so that it
+     * gets the chance to connect to the indications first. */
+    g_object_ref (client);
+    g_task_return_pointer (task, client, g_object_unref);
+    g_object_unref (task);
+    indication_cache_replay (self, client);
+    g_object_unref (client);
+}
+
+static void
+allocate_cid_ready (QmiClientCtl *client_ctl,
+                    GAsyncResult *res,
+                    GTask *task)
+{
+    QmiMessageCtlAllocateCidOutput *output;
+    QmiService service;
+    guint8 cid;
+    GError *error = NULL;
+    AllocateClientContext *ctx;
+
+    /* Check result of the async operation */
+    output = qmi_client_ctl_allocate_cid_finish (client_ctl, res, &error);
+    if (!output) {
+        g_prefix_error (&error, "CID allocation failed in the CTL client: ");
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    /* Check result of the QMI operation */
+    if (!qmi_message_ctl_allocate_cid_output_get_result (output, &error)) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        qmi_message_ctl_allocate_cid_output_unref (output);
+        return;
+    }
+
+    /* Allocation info is mandatory when result is success */
+    g_assert (qmi_message_ctl_allocate_cid_output_get_allocation_info (output, &service, &cid, NULL));
+
+    ctx = g_task_get_task_data (task);
+
+    if (service != ctx->service) {
+        g_task_return_new_error (
+            task,
+            QMI_CORE_ERROR,
+            QMI_CORE_ERROR_FAILED,
+            "CID allocation failed in the CTL client: "
+            "Service mismatch (requested '%s', got '%s')",
+            qmi_service_get_string (ctx->service),
+            qmi_service_get_string (service));
+        g_object_unref (task);
+        qmi_message_ctl_allocate_cid_output_unref (output);
+        return;
+    }
+
+    ctx->cid = cid;
+    build_client_object (task);
+    qmi_message_ctl_allocate_cid_output_unref (output);
+}
+
+static void
+allocate_cid (GTask *task)
+{
+    QmiDevice *self;
+    AllocateClientContext *ctx;
+    QmiMessageCtlAllocateCidInput *input;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    input = qmi_message_ctl_allocate_cid_input_new ();
+    qmi_message_ctl_allocate_cid_input_set_service (input, ctx->service, NULL);
+
+    g_debug ("[%s] Allocating new client ID...",
+             self->priv->path_display);
+    qmi_client_ctl_allocate_cid (self->priv->client_ctl,
+                                 input,
+                                 ctx->timeout,
+                                 g_task_get_cancellable (task),
+                                 (GAsyncReadyCallback)allocate_cid_ready,
+                                 task);
+
+    qmi_message_ctl_allocate_cid_input_unref (input);
+}
+
+static void
+pooled_cid_reset_ready (QmiDevice    *self,
+                        GAsyncResult *res,
+                        GTask        *task)
+{
+    AllocateClientContext *ctx;
+    QmiMessage *response;
+    QmiProtocolError result = QMI_PROTOCOL_ERROR_NONE;
+    GError *error = NULL;
+
+    ctx = g_task_get_task_data (task);
+
+    response = qmi_device_command_full_finish (self, res, &error);
+    if (response) {
+        result = qmi_message_get_result_code (response);
+        qmi_message_unref (response);
+    }
+
+    /* The reset also clears whatever state the previous client left, e.g.
+     * indication registrations */
+    if (response && result == QMI_PROTOCOL_ERROR_NONE) {
+        g_debug ("[%s] Reusing pooled client ID '%u'",
+                 self->priv->path_display,
+                 ctx->cid);
+        build_client_object (task);
+        return;
+    }
+
+    if (g_task_return_error_if_cancelled (task)) {
+        g_clear_error (&error);
+        g_object_unref (task);
+        return;
+    }
+
+    g_debug ("[%s] Cannot reuse pooled client ID '%u': %s",
+             self->priv->path_display,
+             ctx->cid,
+             error ? error->message : qmi_protocol_error_get_string (result));
+    g_clear_error (&error);
+
+    /* Unless the device no longer knows about it, don't leave the CID
+     * allocated */
+    if (response && result != QMI_PROTOCOL_ERROR_INVALID_CLIENT_ID) {
+        QmiMessageCtlReleaseCidInput *input;
+
+        input = qmi_message_ctl_release_cid_input_new ();
+        qmi_message_ctl_release_cid_input_set_release_info (input, ctx->service, ctx->cid, NULL);
+        qmi_client_ctl_release_cid_no_reply (self->priv->client_ctl, input, ctx->timeout, NULL);
+        qmi_message_ctl_release_cid_input_unref (input);
+    }
+
+    ctx->cid = QMI_CID_NONE;
+    allocate_cid (task);
+}
+
+void
+qmi_device_allocate_client (QmiDevice *self,
+                            QmiService service,
+                            guint8 cid,
+                            guint timeout,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data)
+{
+    AllocateClientContext *ctx;
+    GTask *task;
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (service != QMI_SERVICE_UNKNOWN);
+
+    ctx = g_slice_new0 (AllocateClientContext);
+    ctx->service = service;
+    ctx->timeout = timeout;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_task_data (task,
+                          ctx,
+                          (GDestroyNotify)allocate_client_context_free);
+
+    /* Check if the requested service is supported by the device */
+    if (!check_service_supported (self, service)) {
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_UNSUPPORTED,
+                                 "Service '%s' not supported by the device",
+                                 qmi_service_get_string (service));
+        g_object_unref (task);
+        return;
+    }
+
+    switch (service) {
+    case QMI_SERVICE_CTL:
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_INVALID_ARGS,
+                                 "Cannot create additional clients for the CTL service");
+        g_object_unref (task);
+        return;
+
+#if QMI_SERVICE_DMS_SUPPORTED
+    case QMI_SERVICE_DMS:
+        ctx->client_type = QMI_TYPE_CLIENT_DMS;
+        break;
+#endif
+
+#if QMI_SERVICE_WDS_SUPPORTED
+    case QMI_SERVICE_WDS:
+        ctx->client_type = QMI_TYPE_CLIENT_WDS;
+        break;
+#endif
+
+#if QMI_SERVICE_NAS_SUPPORTED
+    case QMI_SERVICE_NAS:
+        ctx->client_type = QMI_TYPE_CLIENT_NAS;
+        break;
+#endif
+
+#if QMI_SERVICE_WMS_SUPPORTED
+    case QMI_SERVICE_WMS:
+        ctx->client_type = QMI_TYPE_CLIENT_WMS;
+        break;
+#endif
+
+#if QMI_SERVICE_PDS_SUPPORTED
+    case QMI_SERVICE_PDS:
+        ctx->client_type = QMI_TYPE_CLIENT_PDS;
+        break;
+#endif
+
+#if QMI_SERVICE_PDC_SUPPORTED
+    case QMI_SERVICE_PDC:
+        ctx->client_type = QMI_TYPE_CLIENT_PDC;
+        break;
+#endif
+
+#if QMI_SERVICE_PBM_SUPPORTED
+    case QMI_SERVICE_PBM:
+        ctx->client_type = QMI_TYPE_CLIENT_PBM;
+        break;
+#endif
+
+#if QMI_SERVICE_UIM_SUPPORTED
+    case QMI_SERVICE_UIM:
+        ctx->client_type = QMI_TYPE_CLIENT_UIM;
+        break;
+#endif
+
+#if QMI_SERVICE_OMA_SUPPORTED
+    case QMI_SERVICE_OMA:
+        ctx->client_type = QMI_TYPE_CLIENT_OMA;
+        break;
+#endif
+
+#if QMI_SERVICE_WDA_SUPPORTED
+    case QMI_SERVICE_WDA:
+        ctx->client_type = QMI_TYPE_CLIENT_WDA;
+        break;
+#endif
+
+#if QMI_SERVICE_VOICE_SUPPORTED
+    case QMI_SERVICE_VOICE:
+        ctx->client_type = QMI_TYPE_CLIENT_VOICE;
+        break;
+#endif
+
+#if QMI_SERVICE_LOC_SUPPORTED
+    case QMI_SERVICE_LOC:
+        ctx->client_type = QMI_TYPE_CLIENT_LOC;
+        break;
+#endif
+
+    default:
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_INVALID_ARGS,
+                                 "Clients for service '%s' not yet supported",
+                                 qmi_service_get_string (service));
+        g_object_unref (task);
+        return;
+    }
+
+    /* Reuse a CID from the pool, if any, once reset */
+    if (cid == QMI_CID_NONE) {
+        cid = cid_pool_take (self, service);
+        if (cid != QMI_CID_NONE) {
+            QmiMessage *message;
+
+            g_debug ("[%s] Taking client ID '%u' from the pool...",
+                     self->priv->path_display,
+                     cid);
+            ctx->cid = cid;
+            message = qmi_message_new (service, cid, 1, CID_POOL_RESET_MESSAGE_ID);
+            qmi_device_command_full (self,
+                                     message,
+                                     NULL,
+                                     timeout,
+                                     cancellable,
+                                     (GAsyncReadyCallback)pooled_cid_reset_ready,
+                                     task);
+            qmi_message_unref (message);
+            return;
+        }
+    }
+
+    /* Allocate a new CID for the client to be created */
+    if (cid == QMI_CID_NONE) {
+        allocate_cid (task);
+        return;
+    }
+
+    /* Reuse the given CID */
+    g_debug ("[%s] Reusing client CID '%u'...",
+             self->priv->path_display,
+             cid);
+    ctx->cid = cid;
+    build_client_object (task);
+}
+
+/*****************************************************************************/
+/* Allocate multiple clients */
+
+typedef struct {
+    guint      n_pending;
+    GPtrArray *clients;
+    GPtrArray *errors;
+} AllocateClientsContext;
+
+typedef struct {
+    GTask      *task;
+    guint       index;
+    QmiService  service;
+} AllocateClientsItem;
+
+static void
+allocate_clients_context_free (AllocateClientsContext *ctx)
+{
+    g_ptr_array_unref (ctx->clients);
+    g_ptr_array_unref (ctx->errors);
+    g_slice_free (AllocateClientsContext, ctx);
+}
+
+GPtrArray *
+qmi_device_allocate_clients_finish (QmiDevice     *self,
+                                    GAsyncResult  *res,
+                                    GPtrArray    **errors,
+                                    GError       **error)
+{
+    AllocateClientsContext *ctx;
+
+    if (!g_task_propagate_boolean (G_TASK (res), error))
+        return NULL;
+
+    ctx = g_task_get_task_data (G_TASK (res));
+    if (errors)
+        *errors = g_ptr_array_ref (ctx->errors);
+    return g_ptr_array_ref (ctx->clients);
+}
+
+static void
+allocate_clients_complete (GTask *task)
+{
+    AllocateClientsContext *ctx;
+    guint n_failed = 0;
+    guint i;
+
+    ctx = g_task_get_task_data (task);
+
+    for (i = 0; i < ctx->errors->len; i++) {
+        if (g_ptr_array_index (ctx->errors, i))
+            n_failed++;
+    }
+
+    /* Only a full failure is reported as an error */
+    if (n_failed > 0 && n_failed == ctx->errors->len) {
+        g_task_return_error (task, g_error_copy (g_ptr_array_index (ctx->errors, 0)));
+        g_object_unref (task);
+        return;
+    }
+
+    g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+}
+
+static void
+allocate_clients_item_ready (QmiDevice           *self,
+                             GAsyncResult        *res,
+                             AllocateClientsItem *item)
+{
+    AllocateClientsContext *ctx;
+    QmiClient *client;
+    GError *error = NULL;
+
+    ctx = g_task_get_task_data (item->task);
+
+    client = qmi_device_allocate_client_finish (self, res, &error);
+    if (!client) {
+        g_prefix_error (&error, "Couldn't allocate '%s' client: ",
+                        qmi_service_get_string (item->service));
+        g_debug ("[%s] %s", self->priv->path_display, error->message);
+        g_ptr_array_index (ctx->errors, item->index) = error;
+    } else
+        g_ptr_array_index (ctx->clients, item->index) = client;
+
+    g_assert (ctx->n_pending > 0);
+    if (--ctx->n_pending == 0)
+        allocate_clients_complete (item->task);
+    g_slice_free (AllocateClientsItem, item);
+}
+
+void
+qmi_device_allocate_clients (QmiDevice           *self,
+                             const QmiService    *services,
+                             guint                n_services,
+                             guint                timeout,
+                             GCancellable        *cancellable,
+                             GAsyncReadyCallback  callback,
+                             gpointer             user_data)
+{
+    AllocateClientsContext *ctx;
+    GTask *task;
+    guint i;
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (services != NULL);
+    g_return_if_fail (n_services > 0);
+
+    ctx = g_slice_new0 (AllocateClientsContext);
+    ctx->n_pending = n_services;
+    ctx->clients = g_ptr_array_new_full (n_services, (GDestroyNotify)g_object_unref);
+    g_ptr_array_set_size (ctx->clients, n_services);
+    ctx->errors = g_ptr_array_new_full (n_services, (GDestroyNotify)g_error_free);
+    g_ptr_array_set_size (ctx->errors, n_services);
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_task_data (task,
+                          ctx,
+                          (GDestroyNotify)allocate_clients_context_free);
+
+    g_debug ("[%s] Allocating %u clients...",
+             self->priv->path_display, n_services);
+
+    /* All the CTL Allocate CID requests are sent right away, without waiting
+     * for the previous ones to be replied; each one completes independently */
+    for (i = 0; i < n_services; i++) {
+        AllocateClientsItem *item;
+
+        item = g_slice_new (AllocateClientsItem);
+        item->task = task;
+        item->index = i;
+        item->service = services[i];
+        qmi_device_allocate_client (self,
+                                    services[i],
+                                    QMI_CID_NONE,
+                                    timeout,
+                                    cancellable,
+                                    (GAsyncReadyCallback)allocate_clients_item_ready,
+                                    item);
+    }
+}
+
+/*****************************************************************************/
+/* Release client */
+
+gboolean
+qmi_device_release_client_finish (QmiDevice *self,
+                                  GAsyncResult *res,
+                                  GError **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void
+client_ctl_release_cid_ready (QmiClientCtl *client_ctl,
+                              GAsyncResult *res,
+                              GTask *task)
+{
+    GError *error = NULL;
+    QmiMessageCtlReleaseCidOutput *output;
+
+    /* Note: even if we return an error, the client is to be considered
+     * released! (so shouldn't be used) */
+
+    /* Check result of the async operation */
+    output = qmi_client_ctl_release_cid_finish (client_ctl, res, &error);
+    if (!output) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    /* Check result of the QMI operation */
+    if (!qmi_message_ctl_release_cid_output_get_result (output, &error)) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        qmi_message_ctl_release_cid_output_unref (output);
+        return;
+    }
+
+    g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+    qmi_message_ctl_release_cid_output_unref (output);
+}
+
+void
+qmi_device_release_client (QmiDevice *self,
+                           QmiClient *client,
+                           QmiDeviceReleaseClientFlags flags,
+                           guint timeout,
+                           GCancellable *cancellable,
+                           GAsyncReadyCallback callback,
+                           gpointer user_data)
+{
+    GTask *task;
+    QmiService service;
+    guint8 cid;
+    gchar *flags_str;
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (QMI_IS_CLIENT (client));
+
+    cid = qmi_client_get_cid (client);
+    service = (guint8)qmi_client_get_service (client);
+
+    /* The CTL client should not have been created out of the QmiDevice */
+    g_return_if_fail (service != QMI_SERVICE_CTL);
+
+    flags_str = qmi_device_release_client_flags_build_string_from_mask (flags);
+    g_debug ("[%s] Releasing '%s' client with flags '%s'...",
+             self->priv->path_display,
+             qmi_service_get_string (service),
+             flags_str);
+    g_free (flags_str);
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    /* Do not try to release an already released client */
+    if (cid == QMI_CID_NONE) {
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_INVALID_ARGS,
+                                 "Client is already released");
+        g_object_unref (task);
+        return;
+    }
+
+    /* Keep the client object valid until after we reset its contents below */
+    g_object_ref (client);
+
+    /* Unregister from device */
+    unregister_client (self, client);
+
+    g_debug ("[%s] Unregistered '%s' client with ID '%u'",
+             self->priv->path_display,
+             qmi_service_get_string (service),
+             cid);
+
+    /* Reset the contents of the client object, making it invalid */
+    g_object_set (client,
+                  QMI_CLIENT_CID,     QMI_CID_NONE,
+                  QMI_CLIENT_SERVICE, QMI_SERVICE_UNKNOWN,
+                  QMI_CLIENT_DEVICE,  NULL,
+                  NULL);
+
+    g_object_unref (client);
+
+    /* Keep the CID for a later client, if using the pool */
+    if ((flags & QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID) && cid_pool_put (self, service, cid)) {
+        g_debug ("[%s] Client ID '%u' kept in the pool",
+                 self->priv->path_display,
+                 cid);
+        g_task_return_boolean (task, TRUE);
+        g_object_unref (task);
+        return;
+    }
+
+    if (flags & QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID) {
+        QmiMessageCtlReleaseCidInput *input;
+
+        /* And now, really try to release the CID */
+        input = qmi_message_ctl_release_cid_input_new ();
+        qmi_message_ctl_release_cid_input_set_release_info (input, service,cid, NULL);
+
+        /* And now, really try to release the CID */
+        qmi_client_ctl_release_cid (self->priv->client_ctl,
+                                    input,
+                                    timeout,
+                                    cancellable,
+                                    (GAsyncReadyCallback)client_ctl_release_cid_ready,
+                                    task);
+
+        qmi_message_ctl_release_cid_input_unref (input);
+        return;
+    }
+
+    /* No need to release the CID, so just done */
+    g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+    return;
+}
+
+/*****************************************************************************/
+/* Release multiple clients */
+
+typedef struct {
+    guint      n_pending;
+    GPtrArray *errors;
+} ReleaseClientsContext;
+
+typedef struct {
+    GTask *task;
+    guint  index;
+} ReleaseClientsItem;
+
+static void
+release_clients_context_free (ReleaseClientsContext *ctx)
+{
+    g_ptr_array_unref (ctx->errors);
+    g_slice_free (ReleaseClientsContext, ctx);
+}
+
+gboolean
+qmi_device_release_clients_finish (QmiDevice     *self,
+                                   GAsyncResult  *res,
+                                   GPtrArray    **errors,
+                                   GError       **error)
+{
+    ReleaseClientsContext *ctx;
+
+    ctx = g_task_get_task_data (G_TASK (res));
+    if (errors)
+        *errors = g_ptr_array_ref (ctx->errors);
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void
+release_clients_complete (GTask *task)
+{
+    ReleaseClientsContext *ctx;
+    const GError *first_error = NULL;
+    guint n_failed = 0;
+    guint i;
+
+    ctx = g_task_get_task_data (task);
+
+    for (i = 0; i < ctx->errors->len; i++) {
+        if (g_ptr_array_index (ctx->errors, i)) {
+            if (!first_error)
+                first_error = g_ptr_array_index (ctx->errors, i);
+            n_failed++;
+        }
+    }
+
+    if (n_failed > 0) {
+        g_task_return_new_error (task,
+                                 first_error->domain,
+                                 first_error->code,
+                                 "Couldn't release %u of %u clients: %s",
+                                 n_failed, ctx->errors->len, first_error->message);
+        g_object_unref (task);
+        return;
+    }
+
+    g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+}
+
+static void
+release_clients_item_ready (QmiDevice          *self,
+                            GAsyncResult       *res,
+                            ReleaseClientsItem *item)
+{
+    ReleaseClientsContext *ctx;
+    GError *error = NULL;
+
+    ctx = g_task_get_task_data (item->task);
+
+    if (!qmi_device_release_client_finish (self, res, &error)) {
+        g_debug ("[%s] Couldn't release client: %s", self->priv->path_display, error->message);
+        g_ptr_array_index (ctx->errors, item->index) = error;
+    }
+
+    g_assert (ctx->n_pending > 0);
+    if (--ctx->n_pending == 0)
+        release_clients_complete (item->task);
+    g_slice_free (ReleaseClientsItem, item);
+}
+
+void
+qmi_device_release_clients (QmiDevice                   *self,
+                            QmiClient                  **clients,
+                            guint                        n_clients,
+                            QmiDeviceReleaseClientFlags  flags,
+                            guint                        timeout,
+                            GCancellable                *cancellable,
+                            GAsyncReadyCallback          callback,
+                            gpointer                     user_data)
+{
+    ReleaseClientsContext *ctx;
+    GTask *task;
+    guint i;
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (clients != NULL);
+    g_return_if_fail (n_clients > 0);
+
+    ctx = g_slice_new0 (ReleaseClientsContext);
+    ctx->n_pending = n_clients;
+    ctx->errors = g_ptr_array_new_full (n_clients, (GDestroyNotify)g_error_free);
+    g_ptr_array_set_size (ctx->errors, n_clients);
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_task_data (task,
+                          ctx,
+                          (GDestroyNotify)release_clients_context_free);
+
+    g_debug ("[%s] Releasing %u clients...",
+             self->priv->path_display, n_clients);
+
+    /* All the CTL Release CID requests are sent right away, without waiting
+     * for the previous ones to be replied; each one completes independently */
+    for (i = 0; i < n_clients; i++) {
+        ReleaseClientsItem *item;
+
+        item = g_slice_new (ReleaseClientsItem);
+        item->task = task;
+        item->index = i;
+        qmi_device_release_client (self,
+                                   clients[i],
+                                   flags,
+                                   timeout,
+                                   cancellable,
+                                   (GAsyncReadyCallback)release_clients_item_ready,
+                                   item);
+    }
+}
+
+/*****************************************************************************/
+/* Set instance ID */
+
+gboolean
+qmi_device_set_instance_id_finish (QmiDevice *self,
+                                   GAsyncResult *res,
+                                   guint16 *link_id,
+                                   GError **error)
+{
+    gssize value;
+
+    value = g_task_propagate_int (G_TASK (res), error);
+    if (value == -1)
+        return FALSE;
+
+    if (link_id)
+        *link_id = (guint16)value;
+
+    return TRUE;
+}
+
+static void
+set_instance_id_ready (QmiClientCtl *client_ctl,
+                       GAsyncResult *res,
+                       GTask *task)
+{
+    QmiMessageCtlSetInstanceIdOutput *output;
+    GError *error = NULL;
+
+    /* Check result of the async operation */
+    output = qmi_client_ctl_set_instance_id_finish (client_ctl, res, &error);
+    if (!output)
+        g_task_return_error (task, error);
+    else {
+        /* Check result of the QMI operation */
+        if (!qmi_message_ctl_set_instance_id_output_get_result (output, &error))
+            g_task_return_error (task, error);
+        else {
+            guint16 link_id;
+
+            qmi_message_ctl_set_instance_id_output_get_link_id (output, &link_id, NULL);
+            g_task_return_int (task, link_id);
+        }
+        qmi_message_ctl_set_instance_id_output_unref (output);
+    }
+
+    g_object_unref (task);
+}
+
+void
+qmi_device_set_instance_id (QmiDevice *self,
+                            guint8 instance_id,
+                            guint timeout,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data)
+{
+    GTask *task;
+    QmiMessageCtlSetInstanceIdInput *input;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    input = qmi_message_ctl_set_instance_id_input_new ();
+    qmi_message_ctl_set_instance_id_input_set_id (
+        input,
+        instance_id,
+        NULL);
+    qmi_client_ctl_set_instance_id (self->priv->client_ctl,
+                                    input,
+                                    timeout,
+                                    cancellable,
+                                    (GAsyncReadyCallback)set_instance_id_ready,
+                                    task);
+    qmi_message_ctl_set_instance_id_input_unref (input);
+}
+
+/*****************************************************************************/
+/* Input channel processing */
+
+typedef struct {
+    QmiClient *client;
+    QmiMessage *message;
+} PendingIndication;
+
+/* Indications to report in a given context, and the idle source reporting
+ * them, if scheduled. The number of indications pending is tracked for the
+ * clients with a queue limit. */
+typedef struct {
+    QmiDevice *self;
+    GMainContext *context;
+    GQueue queue;
+    GSource *source;
+    GHashTable *n_pending_by_client;
+} PendingIndications;
+
+static void
+pending_indication_free (PendingIndication *pending)
+{
+    g_object_unref (pending->client);
+    qmi_message_unref (pending->message);
+    g_slice_free (PendingIndication, pending);
+}
+
+static void
+pending_indications_free (PendingIndications *pending_indications)
+{
+    g_assert (!pending_indications->source);
+    g_assert (g_queue_is_empty (&pending_indications->queue));
+    g_hash_table_unref (pending_indications->n_pending_by_client);
+    g_main_context_unref (pending_indications->context);
+    g_slice_free (PendingIndications, pending_indications);
+}
+
+static void
+pending_indications_flush (QmiDevice *self)
+{
+    GHashTableIter      iter;
+    PendingIndications *pending_indications;
+    GQueue              queue = G_QUEUE_INIT;
+    PendingIndication  *pending;
+
+    g_mutex_lock (&self->priv->pending_indications_lock);
+    g_hash_table_iter_init (&iter, self->priv->pending_indications);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&pending_indications)) {
+        if (pending_indications->source) {
+            g_source_destroy (pending_indications->source);
+            g_clear_pointer (&pending_indications->source, g_source_unref);
+        }
+        while ((pending = g_queue_pop_head (&pending_indications->queue)) != NULL)
+            g_queue_push_tail (&queue, pending);
+        g_hash_table_remove_all (pending_indications->n_pending_by_client);
+    }
+    g_mutex_unlock (&self->priv->pending_indications_lock);
+
+    /* Client references dropped without the lock held */
+    while ((pending = g_queue_pop_head (&queue)) != NULL)
+        pending_indication_free (pending);
+}
+
+static guint
+pending_indications_get_length (QmiDevice *self)
+{
+    GHashTableIter      iter;
+    PendingIndications *pending_indications;
+    guint               length = 0;
+
+    g_mutex_lock (&self->priv->pending_indications_lock);
+    g_hash_table_iter_init (&iter, self->priv->pending_indications);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&pending_indications))
+        length += g_queue_get_length (&pending_indications->queue);
+    g_mutex_unlock (&self->priv->pending_indications_lock);
+
+    return length;
+}
+
+/* Must be called with the pending indications lock held. Only the clients
+ * already tracked are decremented, so that the limits can be set at any time. */
+static guint
+pending_indications_count (PendingIndications *pending_indications,
+                           QmiClient          *client,
+                           gint                delta)
+{
+    guint n_pending;
+
+    n_pending = GPOINTER_TO_UINT (g_hash_table_lookup (pending_indications->n_pending_by_client, client));
+    if (!delta || (delta < 0 && !n_pending))
+        return n_pending;
+
+    n_pending += delta;
+    if (n_pending)
+        g_hash_table_insert (pending_indications->n_pending_by_client, client, GUINT_TO_POINTER (n_pending));
+    else
+        g_hash_table_remove (pending_indications->n_pending_by_client, client);
+    return n_pending;
+}
+
+/* Must be called with the pending indications lock held, when the client
+ * already has its maximum number of indications pending. Returns whether the
+ * new indication must still be queued; the indication dropped, if any, is
+ * returned in @dropped to be freed without the lock held. */
+static gboolean
+pending_indications_overflow (PendingIndications           *pending_indications,
+                              QmiClient                    *client,
+                              QmiMessage                   *message,
+                              QmiClientIndicationOverflow   overflow,
+                              PendingIndication           **dropped)
+{
+    PendingIndication *pending;
+    GList             *oldest = NULL;
+    GList             *l;
+
+    *dropped = NULL;
+
+    if (overflow == QMI_CLIENT_INDICATION_OVERFLOW_DROP_NEWEST)
+        return FALSE;
+
+    for (l = g_queue_peek_head_link (&pending_indications->queue); l; l = g_list_next (l)) {
+        pending = (PendingIndication *)l->data;
+        if (pending->client != client)
+            continue;
+        if (!oldest)
+            oldest = l;
+        if (overflow != QMI_CLIENT_INDICATION_OVERFLOW_COALESCE)
+            break;
+
+        /* Keep the position of the pending one, with the newest contents */
+        if (qmi_message_get_message_id (pending->message) == qmi_message_get_message_id (message)) {
+            qmi_message_unref (pending->message);
+            pending->message = qmi_message_ref (message);
+            return FALSE;
+        }
+    }
+
+    /* Otherwise, make room for the new one */
+    if (oldest) {
+        *dropped = (PendingIndication *)oldest->data;
+        g_queue_delete_link (&pending_indications->queue, oldest);
+        pending_indications_count (pending_indications, client, -1);
+    }
+    return TRUE;
+}
+
+static gboolean
+process_pending_indications_idle (PendingIndications *pending_indications)
+{
+    QmiDevice *self;
+    guint      n_pending;
+
+    self = pending_indications->self;
+
+    /* Keep the device alive while reporting, the clients may drop the last
+     * reference to it */
+    g_object_ref (self);
+
+    /* Indications queued while processing these ones will be reported in
+     * the next main loop iteration, using a new idle source */
+    g_mutex_lock (&self->priv->pending_indications_lock);
+    g_clear_pointer (&pending_indications->source, g_source_unref);
+    n_pending = g_queue_get_length (&pending_indications->queue);
+    g_mutex_unlock (&self->priv->pending_indications_lock);
+
+    while (n_pending-- > 0) {
+        PendingIndication *pending;
+
+        /* The lock is not held while reporting, so that new indications can
+         * be queued meanwhile from other threads */
+        g_mutex_lock (&self->priv->pending_indications_lock);
+        pending = g_queue_pop_head (&pending_indications->queue);
+        if (pending)
+            pending_indications_count (pending_indications, pending->client, -1);
+        g_mutex_unlock (&self->priv->pending_indications_lock);
+        if (!pending)
+            break;
+
+        if (self->priv->stall_threshold) {
+            gint64 start;
+
+            start = g_get_monotonic_time ();
+            __qmi_client_process_indication (pending->client, pending->message);
+            callback_stall_check (self, start,
+                                  qmi_message_get_service (pending->message),
+                                  qmi_message_get_message_id (pending->message),
+                                  NULL, G_OBJECT_TYPE_NAME (pending->client));
+        } else
+            __qmi_client_process_indication (pending->client, pending->message);
+        pending_indication_free (pending);
+    }
+
+    g_object_unref (self);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+report_indication (QmiDevice *self,
+                   QmiClient *client,
+                   QmiMessage *message)
+{
+    PendingIndications          *pending_indications;
+    PendingIndication           *pending;
+    PendingIndication           *dropped = NULL;
+    GMainContext                *context;
+    guint                        max_pending;
+    QmiClientIndicationOverflow  overflow;
+
+    QMI_PROBE_MESSAGE (indication_dispatch, message);
+
+    /* Callbacks registered for the raw indication get it right away */
+    __qmi_client_run_indication_callbacks (client, message);
+
+    /* Indications are processed in the context of each client */
+    context = __qmi_client_peek_context (client);
+
+    g_mutex_lock (&self->priv->pending_indications_lock);
+
+    pending_indications = g_hash_table_lookup (self->priv->pending_indications, context);
+    if (!pending_indications) {
+        pending_indications = g_slice_new0 (PendingIndications);
+        pending_indications->self = self;
+        pending_indications->context = g_main_context_ref (context);
+        g_queue_init (&pending_indications->queue);
+        pending_indications->n_pending_by_client = g_hash_table_new (g_direct_hash, g_direct_equal);
+        g_hash_table_insert (self->priv->pending_indications, context, pending_indications);
+    }
+
+    /* If the client asked to coalesce this indication, just replace the
+     * message in the one already pending, if any */
+    if (__qmi_client_get_indication_coalescing (client, qmi_message_get_message_id (message))) {
+        GList *l;
+
+        for (l = g_queue_peek_tail_link (&pending_indications->queue); l; l = g_list_previous (l)) {
+            pending = (PendingIndication *)l->data;
+            if (pending->client == client &&
+                qmi_message_get_message_id (pending->message) == qmi_message_get_message_id (message)) {
+                qmi_message_unref (pending->message);
+                pending->message = qmi_message_ref (message);
+                g_mutex_unlock (&self->priv->pending_indications_lock);
+                return;
+            }
+        }
+    }
+
+    /* If the client has too many indications pending already, apply its
+     * overflow policy */
+    max_pending = __qmi_client_get_indication_queue_limit (client, &overflow);
+    if (max_pending &&
+        pending_indications_count (pending_indications, client, 0) >= max_pending) {
+        gboolean queue;
+
+        queue = pending_indications_overflow (pending_indications, client, message, overflow, &dropped);
+        g_mutex_unlock (&self->priv->pending_indications_lock);
+
+        __qmi_client_add_indication_drop (client);
+        g_mutex_lock (&self->priv->stats_lock);
+        self->priv->stats.n_indications_dropped++;
+        g_mutex_unlock (&self->priv->stats_lock);
+        g_debug ("[%s] Too many indications pending for client %s (%u): %s",
+                 self->priv->path_display,
+                 qmi_service_get_string (qmi_client_get_service (client)),
+                 qmi_client_get_cid (client),
+                 qmi_client_indication_overflow_get_string (overflow));
+
+        /* Client references dropped without the lock held */
+        if (dropped)
+            pending_indication_free (dropped);
+        if (!queue)
+            return;
+
+        g_mutex_lock (&self->priv->pending_indications_lock);
+    }
+
+    /* Queue the indication, to be passed down to the client in the next
+     * iteration of its main context. All indications pending in the same
+     * context are reported from a single idle source, in the same order as
+     * they were received. */
+    pending = g_slice_new (PendingIndication);
+    pending->client = g_object_ref (client);
+    pending->message = qmi_message_ref (message);
+    g_queue_push_tail (&pending_indications->queue, pending);
+    if (max_pending)
+        pending_indications_count (pending_indications, client, 1);
+
+    if (!pending_indications->source) {
+        pending_indications->source = g_idle_source_new ();
+        g_source_set_callback (pending_indications->source,
+                               (GSourceFunc)process_pending_indications_idle,
+                               pending_indications,
+                               NULL);
+        g_source_attach (pending_indications->source, context);
+    }
+
+    g_mutex_unlock (&self->priv->pending_indications_lock);
+}
+
+static void
+trace_message (QmiDevice         *self,
+               QmiMessage        *message,
+               gboolean           sent_or_received,
+               const gchar       *message_str,
+               QmiMessageContext *message_context,
+               gint64             latency)
+{
+    GString     *printable;
+    const gchar *prefix_str;
+    const gchar *action_str;
+    const gchar *vendor_str = "generic";
+    gchar       *vendor_str_aux = NULL;
+
+    device_stats_frame (self, message, sent_or_received);
+
+    if (self->priv->trace_func) {
+        QmiTraceRecord record;
+
+        record.timestamp  = g_get_monotonic_time ();
+        record.latency    = latency;
+        record.sent       = sent_or_received;
+        record.path       = self->priv->path_display;
+        record.raw        = ((GByteArray *)message)->data;
+        record.raw_length = ((GByteArray *)message)->len;
+        self->priv->trace_func (self, &record, self->priv->trace_func_user_data);
+    }
+
+    if (!qmi_utils_get_traces_enabled ())
+        return;
+
+    /* Filtered out before any formatting */
+    if (!qmi_utils_traces_filter_check (self->priv->path_display,
+                                        __qmi_message_get_service (message),
+                                        __qmi_message_get_message_id (message),
+                                        sent_or_received))
+        return;
+
+    if (sent_or_received) {
+        prefix_str = "<<<<<< ";
+        action_str = "sent";
+    } else {
+        prefix_str = "<<<<<< ";
+        action_str = "received";
+    }
+
+    /* In summary mode, a single line per message, without the hex dump of the
+     * raw contents nor the per-TLV translation */
+    if (qmi_utils_get_traces_summary_only ()) {
+        printable = g_string_sized_new (128);
+        qmi_message_append_summary (message, message_context, printable);
+        g_debug ("[%s] %s %s: %s",
+                 self->priv->path_display,
+                 action_str,
+                 message_str,
+                 printable->str);
+        g_string_free (printable, TRUE);
+        return;
+    }
+
+    /* The same buffer is reused for the raw and the translated traces */
+    printable = g_string_sized_new (64 + 3 * ((GByteArray *)message)->len);
+    __qmi_utils_str_hex_append (printable,
+                                ((GByteArray *)message)->data,
+                                ((GByteArray *)message)->len,
+                                ':');
+    g_debug ("[%s] %s message...\n"
+             "%sRAW:\n"
+             "%s  length = %u\n"
+             "%s  data   = %s\n",
+             self->priv->path_display, action_str,
+             prefix_str,
+             prefix_str, ((GByteArray *)message)->len,
+             prefix_str, printable->str);
+
+    if (message_context) {
+        guint16 vendor_id;
+
+        vendor_id = qmi_message_context_get_vendor_id (message_context);
+        if (vendor_id != QMI_MESSAGE_VENDOR_GENERIC) {
+            vendor_str_aux = g_strdup_printf ("vendor-specific (0x%04x)", vendor_id);
+            vendor_str = vendor_str_aux;
+        }
+    }
+
+    g_string_truncate (printable, 0);
+    qmi_message_append_printable (message, message_context, prefix_str, printable);
+    g_debug ("[%s] %s %s %s (translated)...\n%s",
+             self->priv->path_display,
+             action_str,
+             vendor_str,
+             message_str,
+             printable->str);
+
+    g_string_free (printable, TRUE);
+    g_free (vendor_str_aux);
+}
+
+/*****************************************************************************/
+/* Indication cache */
+
+/* Indications reporting the current state of the device, and not just
+ * events, replayed to the clients registered after they were received */
+static const struct {
+    QmiService service;
+    guint16    message_id;
+} cached_indications[] = {
+    { QMI_SERVICE_NAS, 0x0024 }, /* Serving System */
+    { QMI_SERVICE_NAS, 0x004E }, /* System Info */
+    { QMI_SERVICE_NAS, 0x0051 }, /* Signal Info */
+    { QMI_SERVICE_WDS, 0x0022 }, /* Packet Service Status */
+    { QMI_SERVICE_DMS, 0x0001 }, /* Event Report */
+};
+
+static void
+indication_cache_clear (QmiDevice *self)
+{
+    g_mutex_lock (&self->priv->indication_cache_lock);
+    g_hash_table_remove_all (self->priv->indication_cache);
+    g_mutex_unlock (&self->priv->indication_cache_lock);
+}
+
+static void
+indication_cache_store (QmiDevice  *self,
+                        QmiMessage *indication)
+{
+    QmiService service;
+    guint16    message_id;
+    guint      i;
+
+    if (!self->priv->indication_cache_enabled)
+        return;
+
+    service = __qmi_message_get_service (indication);
+    message_id = __qmi_message_get_message_id (indication);
+    for (i = 0; i < G_N_ELEMENTS (cached_indications); i++) {
+        if (cached_indications[i].service == service && cached_indications[i].message_id == message_id)
+            break;
+    }
+    if (i == G_N_ELEMENTS (cached_indications))
+        return;
+
+    g_mutex_lock (&self->priv->indication_cache_lock);
+    g_hash_table_replace (self->priv->indication_cache,
+                          MESSAGE_STATS_KEY (service, message_id),
+                          qmi_message_ref (indication));
+    g_mutex_unlock (&self->priv->indication_cache_lock);
+}
+
+static void
+indication_cache_replay (QmiDevice *self,
+                         QmiClient *client)
+{
+    GPtrArray *cached;
+    guint      i;
+
+    /* Not if already released while completing the allocation */
+    if (g_hash_table_lookup (self->priv->registered_clients,
+                             build_registered_client_key (qmi_client_get_cid (client),
+                                                          qmi_client_get_service (client))) != client)
+        return;
+
+    cached = qmi_device_get_cached_indications (self, qmi_client_get_service (client));
+    for (i = 0; i < cached->len; i++) {
+        QmiMessage *message;
+        QmiMessage *replayed;
+
+        /* Addressed to the new client, as if it were the only one */
+        message = g_ptr_array_index (cached, i);
+        replayed = __qmi_message_copy_for_transaction (message,
+                                                       qmi_client_get_cid (client),
+                                                       __qmi_message_get_transaction_id (message));
+        g_debug ("[%s] Replaying cached indication 0x%04x to '%s' client with ID '%u'",
+                 self->priv->path_display,
+                 __qmi_message_get_message_id (message),
+                 qmi_service_get_string (qmi_client_get_service (client)),
+                 qmi_client_get_cid (client));
+        report_indication (self, client, replayed);
+        qmi_message_unref (replayed);
+    }
+    g_ptr_array_unref (cached);
+}
+
+GPtrArray *
+qmi_device_get_cached_indications (QmiDevice  *self,
+                                   QmiService  service)
+{
+    GPtrArray      *cached;
+    GHashTableIter  iter;
+    QmiMessage     *message;
+
+    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
+
+    cached = g_ptr_array_new_with_free_func ((GDestroyNotify)qmi_message_unref);
+    g_mutex_lock (&self->priv->indication_cache_lock);
+    g_hash_table_iter_init (&iter, self->priv->indication_cache);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&message)) {
+        if (__qmi_message_get_service (message) == service)
+            g_ptr_array_add (cached, qmi_message_ref (message));
+    }
+    g_mutex_unlock (&self->priv->indication_cache_lock);
+
+    return cached;
+}
+
+/*****************************************************************************/
+
+static void
+process_indication (QmiDevice *self,
+                    QmiMessage *message)
+{
+    indication_cache_store (self, message);
+
+    /* Generic emission of the indication */
+    if (self->priv->stall_threshold) {
+        gint64 start;
+
+        start = g_get_monotonic_time ();
+        g_signal_emit (self, signals[SIGNAL_INDICATION], 0, message);
+        callback_stall_check (self, start,
+                              qmi_message_get_service (message),
+                              qmi_message_get_message_id (message),
+                              NULL, "QmiDevice::" QMI_DEVICE_SIGNAL_INDICATION);
+    } else
+        g_signal_emit (self, signals[SIGNAL_INDICATION], 0, message);
+
+    if (__qmi_message_get_client_id (message) == QMI_CID_BROADCAST) {
+        GPtrArray *clients;
+        guint i;
+
+        /* For broadcast messages, report them just to the clients of the
+         * same service */
+        clients = self->priv->registered_clients_by_service[(guint8) __qmi_message_get_service (message)];
+        for (i = 0; clients && i < clients->len; i++)
+            report_indication (self, QMI_CLIENT (g_ptr_array_index (clients, i)), message);
+    } else {
+        QmiClient *client;
+
+        client = g_hash_table_lookup (self->priv->registered_clients,
+                                      build_registered_client_key (__qmi_message_get_client_id (message),
+                                                                   __qmi_message_get_service (message)));
+        if (client)
+            report_indication (self, client, message);
+    }
+}
+
+/*****************************************************************************/
+/* Dispatching in the owner context */
+
+typedef struct {
+    GTask      *task;    /* NULL for indications */
+    QmiMessage *message; /* reply or indication */
+    GError     *error;
+} OwnerDispatchItem;
+
+static gboolean
+owner_dispatch_idle (QmiDevice *self)
+{
+    GQueue             queue;
+    OwnerDispatchItem *item;
+
+    /* Take all the pending items at once; any new one from now on will
+     * schedule a new idle */
+    g_mutex_lock (&self->priv->owner_dispatch_lock);
+    queue = self->priv->owner_dispatch_queue;
+    g_queue_init (&self->priv->owner_dispatch_queue);
+    self->priv->owner_dispatch_scheduled = FALSE;
+    g_mutex_unlock (&self->priv->owner_dispatch_lock);
+
+    while ((item = g_queue_pop_head (&queue)) != NULL) {
+        if (item->task) {
+            transaction_task_return (item->task, item->message, item->error);
+            g_object_unref (item->task);
+        } else
+            process_indication (self, item->message);
+
+        if (item->message)
+            qmi_message_unref (item->message);
+        if (item->error)
+            g_error_free (item->error);
+        g_slice_free (OwnerDispatchItem, item);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Takes ownership of @task, if any */
+static void
+owner_dispatch_push (QmiDevice    *self,
+                     GTask        *task,
+                     QmiMessage   *message,
+                     const GError *error)
+{
+    OwnerDispatchItem *item;
+    gboolean           schedule;
+
+    item = g_slice_new (OwnerDispatchItem);
+    item->task = task;
+    item->message = (message ? qmi_message_ref (message) : NULL);
+    item->error = (error ? g_error_copy (error) : NULL);
+
+    g_mutex_lock (&self->priv->owner_dispatch_lock);
+    g_queue_push_tail (&self->priv->owner_dispatch_queue, item);
+    schedule = !self->priv->owner_dispatch_scheduled;
+    self->priv->owner_dispatch_scheduled = TRUE;
+    g_mutex_unlock (&self->priv->owner_dispatch_lock);
+
+    if (schedule) {
+        GSource *source;
+
+        source = g_idle_source_new ();
+        g_source_set_callback (source,
+                               (GSourceFunc)owner_dispatch_idle,
+                               g_object_ref (self),
+                               (GDestroyNotify)g_object_unref);
+        g_source_attach (source, self->priv->owner_context);
+        g_source_unref (source);
+    }
+}
+
+static void
+process_message (QmiDevice *self,
+                 QmiMessage *message)
+{
+    health_check_activity (self, FALSE);
+
+    if (__qmi_message_is_indication (message)) {
+        /* Indication traces translated without an explicit vendor */
+        trace_message (self, message, FALSE, "indication", NULL, -1);
+
+        response_cache_check_indication (self, message);
+
+        /* When using a dedicated I/O thread, indications are reported in the
+         * context where the device was opened, as clients are not
+         * thread-safe */
+        if (self->priv->io_context) {
+            owner_dispatch_push (self, NULL, message, NULL);
+            return;
+        }
+
+        process_indication (self, message);
+        return;
+    }
+
+    if (__qmi_message_is_response (message)) {
+        Transaction *tr;
+
+        tr = device_match_transaction (self, message);
+        if (!tr) {
+            QMI_PROBE_MESSAGE (transaction_miss, message);
+            /* Unmatched transactions translated without an explicit context */
+            trace_message (self, message, FALSE, "response", NULL, -1);
+            g_debug ("[%s] No transaction matched in received message",
+                     self->priv->path_display);
+        } else {
+            QMI_PROBE_MESSAGE_VALUE (transaction_match, message, g_get_monotonic_time () - tr->sent_time);
+            /* Matched transactions translated with the same context as the request */
+            trace_message (self, message, FALSE, "response", tr->message_context,
+                           g_get_monotonic_time () - tr->sent_time);
+            /* Report the reply message */
+            self->priv->dispatching_response = TRUE;
+            transaction_complete_and_free (tr, message, NULL);
+            self->priv->dispatching_response = FALSE;
+        }
+
+        return;
+    }
+
+    /* Unexpected message types translated without an explicit context */
+    trace_message (self, message, FALSE, "unexpected message", NULL, -1);
+    g_debug ("[%s] Message received but it is neither an indication nor a response. Skipping it.",
+             self->priv->path_display);
+}
+
+static void
+buffer_compact (QmiDevice *self)
+{
+    /* The buffer may have been destroyed while processing messages, e.g. if
+     * the device got closed from within a signal handler */
+    if (!self->priv->buffer) {
+        self->priv->buffer_offset = 0;
+        return;
+    }
+
+    /* Drop all the already processed data in one single step, instead of
+     * once per parsed message */
+    if (self->priv->buffer_offset == self->priv->buffer->len)
+        g_byte_array_set_size (self->priv->buffer, 0);
+    else if (self->priv->buffer_offset > 0)
+        g_byte_array_remove_range (self->priv->buffer, 0, self->priv->buffer_offset);
+    self->priv->buffer_offset = 0;
+}
+
+static void
+parse_response (QmiDevice *self)
+{
+    while (self->priv->buffer && self->priv->buffer_offset < self->priv->buffer->len) {
+        GError *error = NULL;
+        QmiMessage *message;
+        const guint8 *data;
+        gsize data_len;
+        gsize consumed = 0;
+
+        data = &self->priv->buffer->data[self->priv->buffer_offset];
+        data_len = self->priv->buffer->len - self->priv->buffer_offset;
+
+        /* Every message received must start with the QMUX marker.
+         * If it doesn't, we broke framing :-/
+         * If we broke framing, an error should be reported and the device
+         * should get closed */
+        if (data[0] != QMI_MESSAGE_QMUX_MARKER) {
+            /* TODO: Report fatal error */
+            g_warning ("[%s] QMI framing error detected",
+                       self->priv->path_display);
+            break;
+        }
+
+        /* Frames are validated in place, and only copied out once a
+         * complete one is available */
+        message = __qmi_message_new_from_raw_data (data, data_len, &consumed, &error);
+        if (!message) {
+            if (!error)
+                /* More data we need */
+                break;
+
+            /* Warn about the issue */
+            g_warning ("[%s] Invalid QMI message received: '%s'",
+                       self->priv->path_display,
+                       error->message);
+            g_error_free (error);
+
+            if (qmi_utils_get_traces_enabled ()) {
+                gchar *printable;
+                guint len = MIN (data_len, 2048);
+
+                printable = __qmi_utils_str_hex (data, len, ':');
+                g_debug ("<<<<<< RAW INVALID MESSAGE:\n"
+                         "<<<<<<   length = %" G_GSIZE_FORMAT "\n"
+                         "<<<<<<   data   = %s\n",
+                         data_len, /* show full buffer len */
+                         printable);
+                g_free (printable);
+            }
+
+            /* Skip the invalid frame */
+            self->priv->buffer_offset += consumed;
+        } else {
+            /* Frame consumed before processing, as processing the message
+             * may end up modifying the buffer */
+            self->priv->buffer_offset += consumed;
+            QMI_PROBE_MESSAGE (frame_received, message);
+
+            /* Play with the received message */
+            process_message (self, message);
+            qmi_message_unref (message);
+        }
+    }
+
+    buffer_compact (self);
+}
+
+/* Reported once per open, either when the connection is broken or when the
+ * device file goes away */
+static void
+device_report_removed (QmiDevice *self)
+{
+    if (self->priv->removal_reported)
+        return;
+    self->priv->removal_reported = TRUE;
+
+    response_cache_clear (self, "device removed");
+    indication_cache_clear (self);
+    g_signal_emit (self, signals[SIGNAL_REMOVED], 0);
+}
+
+static gboolean
+input_ready_cb (GInputStream *istream,
+                QmiDevice *self)
+{
+    GError *error = NULL;
+    gssize r;
+    gboolean failed = FALSE;
+    gboolean hangup = FALSE;
+
+    if (!G_UNLIKELY (self->priv->buffer))
+        self->priv->buffer = g_byte_array_sized_new (BUFFER_SIZE);
+
+    /* Keep on reading until the stream tells us there is nothing else
+     * available, reading directly into the tail of the input buffer */
+    while (TRUE) {
+        guint len;
+
+        len = self->priv->buffer->len;
+        g_byte_array_set_size (self->priv->buffer, len + BUFFER_SIZE);
+        r = g_pollable_input_stream_read_nonblocking (G_POLLABLE_INPUT_STREAM (istream),
+                                                      &self->priv->buffer->data[len],
+                                                      BUFFER_SIZE,
+                                                      NULL,
+                                                      &error);
+        g_byte_array_set_size (self->priv->buffer, len + MAX (r, 0));
+
+        if (r < 0) {
+            if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+                /* Fully drained */
+                g_error_free (error);
+                break;
+            }
+
+            g_warning ("Error reading from istream: %s", error ? error->message : "unknown");
+            if (error)
+                g_error_free (error);
+            failed = TRUE;
+            break;
+        }
+
+        if (r == 0) {
+            /* HUP! */
+            g_warning ("Cannot read from istream: connection broken");
+            hangup = TRUE;
+            break;
+        }
+    }
+
+    /* Callbacks run while processing the messages may drop the last reference
+     * to the device */
+    g_object_ref (self);
+
+    /* Whatever was read before the error or hangup is still processed before
+     * tearing down */
+    parse_response (self);
+
+    if (failed) {
+        /* Close the device */
+        qmi_device_close (self, NULL);
+    } else if (hangup)
+        device_report_removed (self);
+
+    g_object_unref (self);
+
+    return ((failed || hangup) ? G_SOURCE_REMOVE : G_SOURCE_CONTINUE);
+}
+
+typedef struct {
+    guint spawn_retries;
+    gboolean proxy_spawned;
+    gchar *auth_token;
+} CreateIostreamContext;
+
+static void
+create_iostream_context_free (CreateIostreamContext *ctx)
+{
+    g_free (ctx->auth_token);
+    g_slice_free (CreateIostreamContext, ctx);
+}
+
+static gboolean
+create_iostream_finish (QmiDevice *self,
+                        GAsyncResult *res,
+                        GError **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void
+input_io_uring_read_cb (const guint8 *data,
+                        gsize         len,
+                        const GError *error,
+                        QmiDevice    *self)
+{
+    if (error) {
+        g_warning ("Error reading from istream: %s", error->message);
+        /* Close the device */
+        qmi_device_close (self, NULL);
+        return;
+    }
+
+    if (!len) {
+        /* HUP! */
+        g_warning ("Cannot read from istream: connection broken");
+        device_report_removed (self);
+        return;
+    }
+
+    if (!G_UNLIKELY (self->priv->buffer))
+        self->priv->buffer = g_byte_array_sized_new (BUFFER_SIZE);
+    g_byte_array_append (self->priv->buffer, data, len);
+
+    /* Callbacks run while processing the messages may drop the last reference
+     * to the device */
+    g_object_ref (self);
+    parse_response (self);
+    g_object_unref (self);
+}
+
+static void output_io_uring_write_cb (gssize        written,
+                                      const GError *error,
+                                      QmiDevice    *self);
+
+static gboolean
+input_io_uring_setup (QmiDevice *self)
+{
+    GError   *error = NULL;
+    gint      fd;
+    gboolean  is_socket;
+
+    /* TLS connections must go through the streams */
+    if (self->priv->socket_connection && !self->priv->proxy_tls) {
+        fd = g_socket_get_fd (g_socket_connection_get_socket (self->priv->socket_connection));
+        is_socket = TRUE;
+    } else if (G_IS_UNIX_INPUT_STREAM (self->priv->istream)) {
+        fd = g_unix_input_stream_get_fd (G_UNIX_INPUT_STREAM (self->priv->istream));
+        is_socket = FALSE;
+    } else
+        return FALSE;
+
+    self->priv->io_uring_watch = __qmi_io_uring_watch_new (device_peek_io_context (self),
+                                                           fd,
+                                                           is_socket,
+                                                           (QmiIoUringReadFn) input_io_uring_read_cb,
+                                                           (QmiIoUringWriteFn) output_io_uring_write_cb,
+                                                           self,
+                                                           &error);
+    if (!self->priv->io_uring_watch) {
+        g_debug ("[%s] io_uring engine unavailable, using the default one: %s",
+                 self->priv->path_display, error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void
+input_source_setup (QmiDevice *self)
+{
+    g_assert (!self->priv->input_source);
+    g_assert (!self->priv->io_uring_watch);
+
+    if (self->priv->io_uring_enabled && input_io_uring_setup (self))
+        return;
+
+    self->priv->input_source = (g_pollable_input_stream_create_source (
+                                    G_POLLABLE_INPUT_STREAM (
+                                        self->priv->istream),
+                                    NULL));
     g_source_set_callback (self->priv->input_source,
                            (GSourceFunc)input_ready_cb,
                            self,
                            NULL);
-    g_source_attach (self->priv->input_source, g_main_context_get_thread_default ());
+    g_source_attach (self->priv->input_source, device_peek_io_context (self));
+}
+
+static void
+setup_iostream (GTask *task)
+{
+    QmiDevice *self;
+
+    self = g_task_get_source_object (task);
+
+    /* Check in/out streams */
+    if (!self->priv->istream || !self->priv->ostream) {
+        g_clear_object (&self->priv->istream);
+        g_clear_object (&self->priv->ostream);
+        g_clear_object (&self->priv->socket_connection);
+        g_clear_object (&self->priv->socket_client);
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_FAILED,
+                                 "Cannot get input/output streams");
+        g_object_unref (task);
+        return;
+    }
+
+    /* Setup input events */
+    input_source_setup (self);
+
+    g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+}
+
+static void
+create_iostream_with_fd (GTask *task)
+{
+    QmiDevice *self;
+    gint fd;
+
+    self = g_task_get_source_object (task);
+    fd = open (self->priv->path, O_RDWR | O_EXCL | O_NONBLOCK | O_NOCTTY);
+    if (fd < 0) {
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_FAILED,
+                                 "Cannot open device file '%s': %s",
+                                 self->priv->path_display,
+                                 strerror (errno));
+        g_object_unref (task);
+        return;
+    }
+
+    self->priv->istream = g_unix_input_stream_new  (fd, TRUE);
+    self->priv->ostream = g_unix_output_stream_new (fd, TRUE);
+
+    setup_iostream (task);
+}
+
+static void create_iostream_with_socket (GTask *task);
+
+static gboolean
+wait_for_proxy_cb (GTask *task)
+{
+    create_iostream_with_socket (task);
+    return FALSE;
+}
+
+/* File descriptor where the spawned proxy gets its listening socket */
+#define PROXY_LISTEN_FD 3
+
+static void
+spawn_child_setup (gpointer user_data)
+{
+    gint fd = GPOINTER_TO_INT (user_data);
+
+    if (setpgid (0, 0) < 0)
+        g_warning ("couldn't setup proxy specific process group");
+
+    /* All other descriptors are closed on exec; dup2() clears the flag in
+     * the new one */
+    if (fd >= 0) {
+        if (fd == PROXY_LISTEN_FD)
+            fcntl (fd, F_SETFD, 0);
+        else
+            dup2 (fd, PROXY_LISTEN_FD);
+    }
+}
+
+/* Binding the abstract address is atomic, so out of all the clients trying
+ * to start the proxy at the same time, only one spawns it. The socket is
+ * already listening when the proxy gets it, so clients connect right away and
+ * wait in the backlog until the proxy is ready. Returns TRUE as well if the
+ * address is already taken, i.e. someone else is starting the proxy. */
+static gboolean
+spawn_proxy_with_socket (GError **error)
+{
+    GSocket        *socket;
+    GSocketAddress *socket_address;
+    gchar          *argv[3];
+    gboolean        spawned;
+    GError         *inner_error = NULL;
+
+    socket = g_socket_new (G_SOCKET_FAMILY_UNIX,
+                           G_SOCKET_TYPE_STREAM,
+                           G_SOCKET_PROTOCOL_DEFAULT,
+                           error);
+    if (!socket)
+        return FALSE;
+
+    socket_address = (g_unix_socket_address_new_with_type (
+                          QMI_PROXY_SOCKET_PATH,
+                          -1,
+                          G_UNIX_SOCKET_ADDRESS_ABSTRACT));
+    if (!g_socket_bind (socket, socket_address, FALSE, &inner_error)) {
+        g_object_unref (socket_address);
+        g_object_unref (socket);
+        if (g_error_matches (inner_error, G_IO_ERROR, G_IO_ERROR_ADDRESS_IN_USE)) {
+            g_debug ("qmi-proxy already being started");
+            g_error_free (inner_error);
+            return TRUE;
+        }
+        g_propagate_error (error, inner_error);
+        return FALSE;
+    }
+    g_object_unref (socket_address);
+
+    if (!g_socket_listen (socket, error)) {
+        g_object_unref (socket);
+        return FALSE;
+    }
+
+    g_debug ("spawning new qmi-proxy with listening socket...");
+
+    argv[0] = (gchar *) LIBEXEC_PATH "/qmi-proxy";
+    argv[1] = (gchar *) "--listen-fd=" G_STRINGIFY (PROXY_LISTEN_FD);
+    argv[2] = NULL;
+    spawned = g_spawn_async (NULL, /* working directory */
+                             argv,
+                             NULL, /* envp */
+                             G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL,
+                             (GSpawnChildSetupFunc) spawn_child_setup,
+                             GINT_TO_POINTER (g_socket_get_fd (socket)),
+                             NULL,
+                             error);
+
+    /* Our own copy of the listening socket is no longer needed */
+    g_object_unref (socket);
+    return spawned;
+}
+
+static void
+create_iostream_with_socket (GTask *task)
+{
+    QmiDevice *self;
+    CreateIostreamContext *ctx;
+    GSocketAddress *socket_address;
+    GError *error = NULL;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    /* Create socket client */
+    self->priv->socket_client = g_socket_client_new ();
+    g_socket_client_set_family (self->priv->socket_client, G_SOCKET_FAMILY_UNIX);
+    g_socket_client_set_socket_type (self->priv->socket_client, G_SOCKET_TYPE_STREAM);
+    g_socket_client_set_protocol (self->priv->socket_client, G_SOCKET_PROTOCOL_DEFAULT);
+
+    /* Setup socket address */
+    socket_address = (g_unix_socket_address_new_with_type (
+                          self->priv->proxy_path,
+                          -1,
+                          G_UNIX_SOCKET_ADDRESS_ABSTRACT));
+
+    /* Connect to address */
+    self->priv->socket_connection = (g_socket_client_connect (
+                                         self->priv->socket_client,
+                                         G_SOCKET_CONNECTABLE (socket_address),
+                                         NULL,
+                                         &error));
+    g_object_unref (socket_address);
+
+    if (!self->priv->socket_connection) {
+        gchar **argc;
+        GSource *source;
+
+        g_debug ("cannot connect to proxy: %s", error->message);
+        g_clear_error (&error);
+        g_clear_object (&self->priv->socket_client);
+
+        /* The default proxy is started only once, and connecting to it
+         * right away should just work */
+        if (!ctx->proxy_spawned && !g_strcmp0 (self->priv->proxy_path, QMI_PROXY_SOCKET_PATH)) {
+            ctx->proxy_spawned = TRUE;
+            if (spawn_proxy_with_socket (&error)) {
+                create_iostream_with_socket (task);
+                return;
+            }
+            g_debug ("error spawning qmi-proxy: %s", error->message);
+            g_clear_error (&error);
+            ctx->proxy_spawned = FALSE;
+        }
+
+        /* Don't retry forever */
+        ctx->spawn_retries++;
+        if (ctx->spawn_retries > MAX_SPAWN_RETRIES) {
+            g_task_return_new_error (task,
+                                     QMI_CORE_ERROR,
+                                     QMI_CORE_ERROR_FAILED,
+                                     "Couldn't spawn the qmi-proxy");
+            g_object_unref (task);
+            return;
+        }
+
+        /* If the proxy was already spawned with the listening socket, the
+         * connection may have been attempted while another client was
+         * setting up the socket, so just retry */
+        if (!ctx->proxy_spawned) {
+            g_debug ("spawning new qmi-proxy (try %u)...", ctx->spawn_retries);
+
+            argc = g_new0 (gchar *, 2);
+            argc[0] = g_strdup (LIBEXEC_PATH "/qmi-proxy");
+            if (!g_spawn_async (NULL, /* working directory */
+                                argc,
+                                NULL, /* envp */
+                                G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL,
+                                (GSpawnChildSetupFunc) spawn_child_setup,
+                                GINT_TO_POINTER (-1),
+                                NULL,
+                                &error)) {
+                g_debug ("error spawning qmi-proxy: %s", error->message);
+                g_clear_error (&error);
+            }
+            g_strfreev (argc);
+        }
+
+        /* Wait some ms and retry */
+        source = g_timeout_source_new (ctx->proxy_spawned ? 10 : 100);
+        g_source_set_callback (source, (GSourceFunc)wait_for_proxy_cb, task, NULL);
+        g_source_attach (source, g_main_context_get_thread_default ());
+        g_source_unref (source);
+        return;
+    }
+
+    self->priv->istream = g_io_stream_get_input_stream (G_IO_STREAM (self->priv->socket_connection));
+    if (self->priv->istream)
+        g_object_ref (self->priv->istream);
+
+    self->priv->ostream = g_io_stream_get_output_stream (G_IO_STREAM (self->priv->socket_connection));
+    if (self->priv->ostream)
+        g_object_ref (self->priv->ostream);
+
+    /* Writes are done without blocking, queued messages get written when the
+     * socket is ready */
+    g_socket_set_blocking (g_socket_connection_get_socket (self->priv->socket_connection), FALSE);
+
+    setup_iostream (task);
+}
+
+/* Remote proxies are given as "tcp://[TOKEN@]HOST:PORT", or with "tls://"
+ * to connect through TLS. If not in the path, the token is taken from the
+ * environment. */
+#define REMOTE_PROXY_AUTH_TOKEN_ENV "QMI_PROXY_AUTH_TOKEN"
+#define REMOTE_PROXY_AUTH_PREAMBLE  "QMI-PROXY-AUTH "
+
+static gboolean
+proxy_path_is_remote (const gchar *proxy_path)
+{
+    return (g_str_has_prefix (proxy_path, "tcp://") || g_str_has_prefix (proxy_path, "tls://"));
+}
+
+static gboolean
+parse_remote_proxy_path (const gchar  *proxy_path,
+                         gboolean     *tls,
+                         gchar       **host_and_port,
+                         gchar       **auth_token,
+                         GError      **error)
+{
+    const gchar *authority;
+    const gchar *at;
+
+    *tls = g_str_has_prefix (proxy_path, "tls://");
+    authority = proxy_path + strlen ("tcp://");
+
+    at = strrchr (authority, '@');
+    if (at) {
+        *auth_token = g_uri_unescape_segment (authority, at, NULL);
+        authority = at + 1;
+    } else
+        *auth_token = g_strdup (g_getenv (REMOTE_PROXY_AUTH_TOKEN_ENV));
+
+    if (!*auth_token || !(*auth_token)[0] || strchr (*auth_token, '\n')) {
+        g_clear_pointer (auth_token, g_free);
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS,
+                     "No valid authentication token given for remote proxy '%s'", authority);
+        return FALSE;
+    }
+
+    if (!authority[0]) {
+        g_clear_pointer (auth_token, g_free);
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS,
+                     "No remote proxy address given");
+        return FALSE;
+    }
+
+    *host_and_port = g_strdup (authority);
+    return TRUE;
+}
+
+static void
+remote_socket_connect_ready (GSocketClient *socket_client,
+                             GAsyncResult  *res,
+                             GTask         *task)
+{
+    QmiDevice             *self;
+    CreateIostreamContext *ctx;
+    GSocket               *socket;
+    gchar                 *preamble;
+    GError                *error = NULL;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    self->priv->socket_connection = g_socket_client_connect_to_host_finish (socket_client, res, &error);
+    if (!self->priv->socket_connection) {
+        g_clear_object (&self->priv->socket_client);
+        g_prefix_error (&error, "Cannot connect to remote proxy: ");
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    socket = g_socket_connection_get_socket (self->priv->socket_connection);
+    self->priv->istream = g_object_ref (g_io_stream_get_input_stream (G_IO_STREAM (self->priv->socket_connection)));
+    self->priv->ostream = g_object_ref (g_io_stream_get_output_stream (G_IO_STREAM (self->priv->socket_connection)));
+
+    /* The proxy expects the token before anything else; it's small enough
+     * to go out right away even if still blocking */
+    preamble = g_strdup_printf (REMOTE_PROXY_AUTH_PREAMBLE "%s\n", ctx->auth_token);
+    if (!g_output_stream_write_all (self->priv->ostream, preamble, strlen (preamble), NULL, NULL, &error)) {
+        g_free (preamble);
+        g_clear_object (&self->priv->istream);
+        g_clear_object (&self->priv->ostream);
+        g_clear_object (&self->priv->socket_connection);
+        g_clear_object (&self->priv->socket_client);
+        g_prefix_error (&error, "Cannot authenticate with remote proxy: ");
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+    g_free (preamble);
+
+    /* Messages are already batched before being written */
+    if (!g_socket_set_option (socket, IPPROTO_TCP, TCP_NODELAY, 1, &error)) {
+        g_debug ("[%s] couldn't disable Nagle's algorithm: %s", self->priv->path_display, error->message);
+        g_clear_error (&error);
+    }
+    g_socket_set_blocking (socket, FALSE);
+
+    self->priv->proxy_remote = TRUE;
+    setup_iostream (task);
+}
+
+static void
+create_iostream_with_remote_socket (GTask *task)
+{
+    QmiDevice             *self;
+    CreateIostreamContext *ctx;
+    gchar                 *host_and_port = NULL;
+    GError                *error = NULL;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    if (!parse_remote_proxy_path (self->priv->proxy_path,
+                                  &self->priv->proxy_tls,
+                                  &host_and_port,
+                                  &ctx->auth_token,
+                                  &error)) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    g_debug ("[%s] connecting to remote proxy at %s%s...",
+             self->priv->path_display, host_and_port, self->priv->proxy_tls ? " (TLS)" : "");
+
+    self->priv->socket_client = g_socket_client_new ();
+    g_socket_client_set_socket_type (self->priv->socket_client, G_SOCKET_TYPE_STREAM);
+    g_socket_client_set_protocol (self->priv->socket_client, G_SOCKET_PROTOCOL_TCP);
+    g_socket_client_set_tls (self->priv->socket_client, self->priv->proxy_tls);
+    g_socket_client_connect_to_host_async (self->priv->socket_client,
+                                           host_and_port,
+                                           0, /* the port must be given */
+                                           NULL,
+                                           (GAsyncReadyCallback)remote_socket_connect_ready,
+                                           task);
+    g_free (host_and_port);
+}
+
+static void
+create_iostream (QmiDevice *self,
+                 gboolean proxy,
+                 GAsyncReadyCallback callback,
+                 gpointer user_data)
+{
+    CreateIostreamContext *ctx;
+    GTask *task;
+
+    ctx = g_slice_new (CreateIostreamContext);
+    ctx->spawn_retries = 0;
+    ctx->proxy_spawned = FALSE;
+    ctx->auth_token = NULL;
+
+    task = g_task_new (self, NULL, callback, user_data);
+    g_task_set_task_data (task,
+                          ctx,
+                          (GDestroyNotify)create_iostream_context_free);
+
+    if (self->priv->istream || self->priv->ostream) {
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_WRONG_STATE,
+                                 "Already open");
+        g_object_unref (task);
+        return;
+    }
+
+    g_assert (self->priv->file);
+    g_assert (self->priv->path);
+
+    if (proxy && proxy_path_is_remote (self->priv->proxy_path))
+        create_iostream_with_remote_socket (task);
+    else if (proxy)
+        create_iostream_with_socket (task);
+    else
+        create_iostream_with_fd (task);
+}
+
+/*****************************************************************************/
+/* Open device */
+
+static gboolean io_thread_start (QmiDevice  *self,
+                                 GError    **error);
+static void     io_thread_stop  (QmiDevice  *self);
+static void     removal_monitor_start (QmiDevice *self);
+static void     suspend_monitor_start (QmiDevice *self);
+
+typedef enum {
+    DEVICE_OPEN_CONTEXT_STEP_FIRST = 0,
+#if defined HAVE_LINUX_QRTR_H
+    DEVICE_OPEN_CONTEXT_STEP_QRTR,
+#endif
+    DEVICE_OPEN_CONTEXT_STEP_DRIVER,
+#if defined MBIM_QMUX_ENABLED
+    DEVICE_OPEN_CONTEXT_STEP_DEVICE_MBIM,
+    DEVICE_OPEN_CONTEXT_STEP_OPEN_DEVICE_MBIM,
+#endif
+    DEVICE_OPEN_CONTEXT_STEP_CREATE_IOSTREAM,
+    DEVICE_OPEN_CONTEXT_STEP_FLAGS_PROXY,
+    DEVICE_OPEN_CONTEXT_STEP_FLAGS_CTL_SETUP,
+    DEVICE_OPEN_CONTEXT_STEP_LAST
+} DeviceOpenContextStep;
+
+/* CTL operations pipelined along with the version info check */
+typedef enum {
+    CTL_SETUP_OPERATION_NONE    = 0,
+    CTL_SETUP_OPERATION_SYNC    = 1 << 0,
+    CTL_SETUP_OPERATION_NETPORT = 1 << 1,
+} CtlSetupOperation;
+
+typedef struct {
+    DeviceOpenContextStep step;
+    QmiDeviceOpenFlags flags;
+    guint timeout;
+    guint version_check_retries;
+    gboolean version_info_cached;
+    gchar *driver;
+    gboolean io_thread_started;
+
+    /* CTL setup */
+    guint ctl_setup_pending;
+    gboolean ctl_setup_version_info_pending;
+    gboolean ctl_setup_restarting;
+    CtlSetupOperation ctl_setup_running;
+    CtlSetupOperation ctl_setup_cancelled;
+    CtlSetupOperation ctl_setup_stopped;
+    GCancellable *ctl_setup_cancellable;
+    GCancellable *ctl_setup_task_cancellable;
+    gulong ctl_setup_task_cancellable_id;
+    GError *ctl_setup_error;
+} DeviceOpenContext;
+
+static void
+device_open_context_free (DeviceOpenContext *ctx)
+{
+    if (ctx->ctl_setup_task_cancellable_id)
+        g_cancellable_disconnect (ctx->ctl_setup_task_cancellable, ctx->ctl_setup_task_cancellable_id);
+    g_clear_object (&ctx->ctl_setup_task_cancellable);
+    g_clear_object (&ctx->ctl_setup_cancellable);
+    g_clear_error (&ctx->ctl_setup_error);
+    g_free (ctx->driver);
+    g_slice_free (DeviceOpenContext, ctx);
+}
+
+gboolean
+qmi_device_open_finish (QmiDevice *self,
+                        GAsyncResult *res,
+                        GError **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void device_open_step (GTask *task);
+
+/*****************************************************************************/
+/* CTL setup
+ *
+ * The version info check, the sync and the network port setup don't depend on
+ * each other, so all of them are issued back-to-back instead of waiting for
+ * each response before sending the next request. The modem processes CTL
+ * requests in order, so this keeps the same sequence as running them one by
+ * one.
+ *
+ * The version info check is retried once per second while the modem isn't
+ * ready yet; if that happens the other requests were most likely lost as
+ * well, so they are cancelled and issued again once the version info check
+ * succeeds, instead of waiting for their own (longer) timeouts. */
+
+static void ctl_setup_operation_start (GTask             *task,
+                                       CtlSetupOperation  operation);
+
+static void
+ctl_setup_cancelled (GCancellable *task_cancellable,
+                     GCancellable *ctl_setup_cancellable)
+{
+    g_cancellable_cancel (ctl_setup_cancellable);
+}
+
+static void
+ctl_setup_reset_cancellable (GTask *task)
+{
+    DeviceOpenContext *ctx;
+
+    ctx = g_task_get_task_data (task);
+
+    if (ctx->ctl_setup_task_cancellable_id) {
+        g_cancellable_disconnect (ctx->ctl_setup_task_cancellable, ctx->ctl_setup_task_cancellable_id);
+        ctx->ctl_setup_task_cancellable_id = 0;
+    }
+    g_clear_object (&ctx->ctl_setup_cancellable);
+
+    /* Cancelling the open operation cancels also the pipelined requests */
+    ctx->ctl_setup_cancellable = g_cancellable_new ();
+    if (!ctx->ctl_setup_task_cancellable && g_task_get_cancellable (task))
+        ctx->ctl_setup_task_cancellable = g_object_ref (g_task_get_cancellable (task));
+    if (ctx->ctl_setup_task_cancellable)
+        ctx->ctl_setup_task_cancellable_id = g_cancellable_connect (ctx->ctl_setup_task_cancellable,
+                                                                    G_CALLBACK (ctl_setup_cancelled),
+                                                                    ctx->ctl_setup_cancellable,
+                                                                    NULL);
+}
+
+static void
+ctl_setup_operation_complete (GTask             *task,
+                              CtlSetupOperation  operation,
+                              GError            *error)
+{
+    DeviceOpenContext *ctx;
+
+    ctx = g_task_get_task_data (task);
+
+    ctx->ctl_setup_running &= ~operation;
+    ctx->ctl_setup_cancelled &= ~operation;
+
+    /* Keep the first error only, and don't wait for the other requests to
+     * time out. Note that cancelling may complete the other requests right
+     * away, so this one must still be accounted as pending meanwhile. */
+    if (error) {
+        if (!ctx->ctl_setup_error) {
+            ctx->ctl_setup_error = error;
+            g_cancellable_cancel (ctx->ctl_setup_cancellable);
+        } else
+            g_error_free (error);
+    }
+
+    g_assert (ctx->ctl_setup_pending > 0);
+    if (--ctx->ctl_setup_pending > 0)
+        return;
+
+    if (ctx->ctl_setup_error) {
+        g_task_return_error (task, ctx->ctl_setup_error);
+        ctx->ctl_setup_error = NULL;
+        g_object_unref (task);
+        return;
+    }
+
+    /* Go on */
+    ctx->step++;
+    device_open_step (task);
+}
+
+/* Returns TRUE if the operation was cancelled to be issued again */
+static gboolean
+ctl_setup_operation_stopped (GTask             *task,
+                             CtlSetupOperation  operation,
+                             GError            *error)
+{
+    DeviceOpenContext *ctx;
+    GCancellable *task_cancellable;
+
+    ctx = g_task_get_task_data (task);
+    task_cancellable = g_task_get_cancellable (task);
+
+    if (!(ctx->ctl_setup_cancelled & operation) ||
+        ctx->ctl_setup_error ||
+        (task_cancellable && g_cancellable_is_cancelled (task_cancellable)))
+        return FALSE;
+
+    g_error_free (error);
+    ctx->ctl_setup_running &= ~operation;
+    ctx->ctl_setup_cancelled &= ~operation;
+    g_assert (ctx->ctl_setup_pending > 0);
+    ctx->ctl_setup_pending--;
+
+    if (ctx->ctl_setup_version_info_pending) {
+        ctx->ctl_setup_stopped |= operation;
+        return TRUE;
+    }
+
+    /* The version info check already succeeded; the cancellable used to stop
+     * the operation is replaced before issuing it again, unless another
+     * operation restarted before already did so */
+    if (g_cancellable_is_cancelled (ctx->ctl_setup_cancellable))
+        ctl_setup_reset_cancellable (task);
+    ctl_setup_operation_start (task, operation);
+    return TRUE;
+}
+
+static void
+ctl_set_data_format_ready (QmiClientCtl *client,
+                           GAsyncResult *res,
+                           GTask *task)
+{
+    QmiDevice *self;
+    QmiMessageCtlSetDataFormatOutput *output = NULL;
+    GError *error = NULL;
+
+    output = qmi_client_ctl_set_data_format_finish (client, res, &error);
+    /* Check result of the async operation */
+    if (!output) {
+        if (!ctl_setup_operation_stopped (task, CTL_SETUP_OPERATION_NETPORT, error))
+            ctl_setup_operation_complete (task, CTL_SETUP_OPERATION_NETPORT, error);
+        return;
+    }
+
+    /* Check result of the QMI operation */
+    if (!qmi_message_ctl_set_data_format_output_get_result (output, &error)) {
+        ctl_setup_operation_complete (task, CTL_SETUP_OPERATION_NETPORT, error);
+        qmi_message_ctl_set_data_format_output_unref (output);
+        return;
+    }
+
+    self = g_task_get_source_object (task);
+
+    g_debug ("[%s] Network port data format operation finished",
+             self->priv->path_display);
+
+    qmi_message_ctl_set_data_format_output_unref (output);
+
+    ctl_setup_operation_complete (task, CTL_SETUP_OPERATION_NETPORT, NULL);
+}
+
+static void
+sync_ready (QmiClientCtl *client_ctl,
+            GAsyncResult *res,
+            GTask *task)
+{
+    QmiDevice *self;
+    GError *error = NULL;
+    QmiMessageCtlSyncOutput *output;
+
+    /* Check result of the async operation */
+    output = qmi_client_ctl_sync_finish (client_ctl, res, &error);
+    if(!output) {
+        if (!ctl_setup_operation_stopped (task, CTL_SETUP_OPERATION_SYNC, error))
+            ctl_setup_operation_complete (task, CTL_SETUP_OPERATION_SYNC, error);
+        return;
+    }
+
+    /* Check result of the QMI operation */
+    if (!qmi_message_ctl_sync_output_get_result (output, &error)) {
+        ctl_setup_operation_complete (task, CTL_SETUP_OPERATION_SYNC, error);
+        qmi_message_ctl_sync_output_unref (output);
+        return;
+    }
+
+    self = g_task_get_source_object (task);
+    g_debug ("[%s] Sync operation finished",
+             self->priv->path_display);
+
+    /* All CIDs released by the device */
+    cid_pool_clear (self);
+
+    qmi_message_ctl_sync_output_unref (output);
+
+    ctl_setup_operation_complete (task, CTL_SETUP_OPERATION_SYNC, NULL);
+}
+
+static void
+ctl_setup_operation_start (GTask             *task,
+                           CtlSetupOperation  operation)
+{
+    QmiDevice *self;
+    DeviceOpenContext *ctx;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    ctx->ctl_setup_pending++;
+    ctx->ctl_setup_running |= operation;
+
+    switch (operation) {
+    case CTL_SETUP_OPERATION_SYNC:
+        g_debug ("[%s] Running sync...",
+                 self->priv->path_display);
+        qmi_client_ctl_sync (self->priv->client_ctl,
+                             NULL,
+                             ctx->timeout,
+                             ctx->ctl_setup_cancellable,
+                             (GAsyncReadyCallback)sync_ready,
+                             task);
+        return;
+
+    case CTL_SETUP_OPERATION_NETPORT: {
+        QmiMessageCtlSetDataFormatInput *input;
+        QmiCtlDataFormat qos = QMI_CTL_DATA_FORMAT_QOS_FLOW_HEADER_ABSENT;
+        QmiCtlDataLinkProtocol link_protocol = QMI_CTL_DATA_LINK_PROTOCOL_802_3;
+
+        g_debug ("[%s] Setting network port data format...",
+                 self->priv->path_display);
+
+        input = qmi_message_ctl_set_data_format_input_new ();
+
+        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_NET_QOS_HEADER)
+            qos = QMI_CTL_DATA_FORMAT_QOS_FLOW_HEADER_PRESENT;
+        qmi_message_ctl_set_data_format_input_set_format (input, qos, NULL);
+
+        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_NET_RAW_IP)
+            link_protocol = QMI_CTL_DATA_LINK_PROTOCOL_RAW_IP;
+        qmi_message_ctl_set_data_format_input_set_protocol (input, link_protocol, NULL);
+
+        qmi_client_ctl_set_data_format (self->priv->client_ctl,
+                                        input,
+                                        5,
+                                        ctx->ctl_setup_cancellable,
+                                        (GAsyncReadyCallback)ctl_set_data_format_ready,
+                                        task);
+        qmi_message_ctl_set_data_format_input_unref (input);
+        return;
+    }
+
+    case CTL_SETUP_OPERATION_NONE:
+    default:
+        g_assert_not_reached ();
+    }
+}
+
+static void
+ctl_setup_restart_stopped (GTask *task)
+{
+    DeviceOpenContext *ctx;
+    CtlSetupOperation stopped;
+
+    ctx = g_task_get_task_data (task);
+    if (ctx->ctl_setup_stopped == CTL_SETUP_OPERATION_NONE)
+        return;
+
+    stopped = ctx->ctl_setup_stopped;
+    ctx->ctl_setup_stopped = CTL_SETUP_OPERATION_NONE;
+
+    /* Issue them again in the original order */
+    ctl_setup_reset_cancellable (task);
+    if (stopped & CTL_SETUP_OPERATION_SYNC)
+        ctl_setup_operation_start (task, CTL_SETUP_OPERATION_SYNC);
+    if (stopped & CTL_SETUP_OPERATION_NETPORT)
+        ctl_setup_operation_start (task, CTL_SETUP_OPERATION_NETPORT);
+}
+
+/*****************************************************************************/
+/* Version info cache
+ *
+ * The list of supported services is stored in a key file named after the USB
+ * identity of the device (vendor and product ids, serial number and device
+ * revision), so that the CTL Get Version Info request doesn't need to be
+ * completed before the device is reported as open. When the cached list is
+ * used, the request is still run in background once the device is open, and
+ * the cache updated if needed (e.g. after a firmware upgrade that didn't change
+ * the USB device revision). */
+
+#define VERSION_INFO_CACHE_GROUP        "version-info"
+#define VERSION_INFO_CACHE_KEY_SERVICES "services"
+
+static void
+device_set_supported_services (QmiDevice *self,
+                               GArray    *service_list)
+{
+    guint i;
+
+    if (self->priv->supported_services)
+        g_array_unref (self->priv->supported_services);
+    self->priv->supported_services = g_array_ref (service_list);
+    build_service_versions (self);
+
+    g_debug ("[%s] QMI Device supports %u services:",
+             self->priv->path_display,
+             self->priv->supported_services->len);
+    for (i = 0; i < self->priv->supported_services->len; i++) {
+        QmiMessageCtlGetVersionInfoOutputServiceListService *info;
+        const gchar *service_str;
+
+        info = &g_array_index (self->priv->supported_services,
+                               QmiMessageCtlGetVersionInfoOutputServiceListService,
+                               i);
+        service_str = qmi_service_get_string (info->service);
+        if (service_str)
+            g_debug ("[%s]    %s (%u.%u)",
+                     self->priv->path_display,
+                     service_str,
+                     info->major_version,
+                     info->minor_version);
+        else
+            g_debug ("[%s]    unknown [0x%02x] (%u.%u)",
+                     self->priv->path_display,
+                     info->service,
+                     info->major_version,
+                     info->minor_version);
+    }
+}
+
+static gchar *
+version_info_cache_build_path (QmiDevice *self)
+{
+    gchar *identity;
+    gchar *filename;
+    gchar *path;
+
+    if (!self->priv->version_info_cache_dir || !self->priv->path)
+        return NULL;
+
+    identity = __qmi_utils_get_device_identity (self->priv->path);
+    if (!identity) {
+        g_debug ("[%s] Cannot cache version info: unknown device identity",
+                 self->priv->path_display);
+        return NULL;
+    }
+
+    filename = g_strdup_printf ("%s.version-info", identity);
+    path = g_build_filename (self->priv->version_info_cache_dir, filename, NULL);
+    g_free (filename);
+    g_free (identity);
+    return path;
+}
+
+static GArray *
+version_info_cache_load (QmiDevice *self)
+{
+    gchar    *path;
+    GKeyFile *key_file;
+    gchar   **services = NULL;
+    GArray   *service_list = NULL;
+    GError   *error = NULL;
+    guint     i;
+
+    path = version_info_cache_build_path (self);
+    if (!path)
+        return NULL;
+
+    key_file = g_key_file_new ();
+    if (!g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, &error) ||
+        !(services = g_key_file_get_string_list (key_file,
+                                                 VERSION_INFO_CACHE_GROUP,
+                                                 VERSION_INFO_CACHE_KEY_SERVICES,
+                                                 NULL,
+                                                 &error))) {
+        g_debug ("[%s] No cached version info available: %s",
+                 self->priv->path_display,
+                 error->message);
+        g_error_free (error);
+        goto out;
+    }
+
+    /* Each service given as "<service>:<major>.<minor>" */
+    service_list = g_array_sized_new (FALSE, FALSE, sizeof (QmiMessageCtlGetVersionInfoOutputServiceListService), g_strv_length (services));
+    for (i = 0; services[i]; i++) {
+        QmiMessageCtlGetVersionInfoOutputServiceListService info;
+        guint service;
+        guint major;
+        guint minor;
+
+        if (sscanf (services[i], "%u:%u.%u", &service, &major, &minor) != 3 ||
+            service > G_MAXUINT8 || major > G_MAXUINT16 || minor > G_MAXUINT16) {
+            g_debug ("[%s] Invalid cached version info: '%s'",
+                     self->priv->path_display,
+                     services[i]);
+            g_array_unref (service_list);
+            service_list = NULL;
+            goto out;
+        }
+
+        info.service = (QmiService) service;
+        info.major_version = (guint16) major;
+        info.minor_version = (guint16) minor;
+        g_array_append_val (service_list, info);
+    }
+
+    g_debug ("[%s] Loaded cached version info from '%s'",
+             self->priv->path_display,
+             path);
+
+out:
+    g_strfreev (services);
+    g_key_file_free (key_file);
+    g_free (path);
+    return service_list;
+}
+
+static void
+version_info_cache_save (QmiDevice *self,
+                         GArray    *service_list)
+{
+    gchar     *path;
+    GKeyFile  *key_file;
+    gchar    **services;
+    gchar     *contents;
+    gsize      contents_length;
+    GError    *error = NULL;
+    guint      i;
+
+    path = version_info_cache_build_path (self);
+    if (!path)
+        return;
+
+    services = g_new0 (gchar *, service_list->len + 1);
+    for (i = 0; i < service_list->len; i++) {
+        QmiMessageCtlGetVersionInfoOutputServiceListService *info;
+
+        info = &g_array_index (service_list, QmiMessageCtlGetVersionInfoOutputServiceListService, i);
+        services[i] = g_strdup_printf ("%u:%u.%u", (guint) info->service, info->major_version, info->minor_version);
+    }
+
+    key_file = g_key_file_new ();
+    g_key_file_set_string_list (key_file,
+                                VERSION_INFO_CACHE_GROUP,
+                                VERSION_INFO_CACHE_KEY_SERVICES,
+                                (const gchar * const *) services,
+                                service_list->len);
+    contents = g_key_file_to_data (key_file, &contents_length, NULL);
+
+    if (g_mkdir_with_parents (self->priv->version_info_cache_dir, 0755) < 0)
+        g_debug ("[%s] Cannot create version info cache directory: %s",
+                 self->priv->path_display,
+                 g_strerror (errno));
+    else if (!g_file_set_contents (path, contents, contents_length, &error)) {
+        g_debug ("[%s] Cannot store version info in cache: %s",
+                 self->priv->path_display,
+                 error->message);
+        g_error_free (error);
+    } else
+        g_debug ("[%s] Stored version info in '%s'",
+                 self->priv->path_display,
+                 path);
+
+    g_free (contents);
+    g_key_file_free (key_file);
+    g_strfreev (services);
+    g_free (path);
+}
+
+static gboolean
+service_list_equal (GArray *a,
+                    GArray *b)
+{
+    guint i;
+
+    if (a->len != b->len)
+        return FALSE;
+
+    for (i = 0; i < a->len; i++) {
+        QmiMessageCtlGetVersionInfoOutputServiceListService *info_a;
+        QmiMessageCtlGetVersionInfoOutputServiceListService *info_b;
+
+        info_a = &g_array_index (a, QmiMessageCtlGetVersionInfoOutputServiceListService, i);
+        info_b = &g_array_index (b, QmiMessageCtlGetVersionInfoOutputServiceListService, i);
+        if (info_a->service != info_b->service ||
+            info_a->major_version != info_b->major_version ||
+            info_a->minor_version != info_b->minor_version)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+version_info_revalidate_ready (QmiClientCtl *client_ctl,
+                               GAsyncResult *res,
+                               QmiDevice    *self)
+{
+    QmiMessageCtlGetVersionInfoOutput *output;
+    GArray *service_list = NULL;
+    GError *error = NULL;
+
+    output = qmi_client_ctl_get_version_info_finish (client_ctl, res, &error);
+    if (!output ||
+        !qmi_message_ctl_get_version_info_output_get_result (output, &error) ||
+        !qmi_message_ctl_get_version_info_output_get_service_list (output, &service_list, &error)) {
+        g_debug ("[%s] Couldn't revalidate cached version info: %s",
+                 self->priv->path_display,
+                 error->message);
+        g_error_free (error);
+        goto out;
+    }
+
+    if (self->priv->supported_services && service_list_equal (self->priv->supported_services, service_list)) {
+        g_debug ("[%s] Cached version info is up to date",
+                 self->priv->path_display);
+        goto out;
+    }
+
+    g_debug ("[%s] Cached version info is outdated, updating it...",
+             self->priv->path_display);
+    device_set_supported_services (self, service_list);
+    version_info_cache_save (self, service_list);
+
+out:
+    if (output)
+        qmi_message_ctl_get_version_info_output_unref (output);
+    g_object_unref (self);
+}
+
+/*****************************************************************************/
+
+static void
+open_version_info_ready (QmiClientCtl *client_ctl,
+                         GAsyncResult *res,
+                         GTask *task)
+{
+    QmiDevice *self;
+    DeviceOpenContext *ctx;
+    GArray *service_list;
+    QmiMessageCtlGetVersionInfoOutput *output;
+    GError *error = NULL;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    /* Check result of the async operation */
+    output = qmi_client_ctl_get_version_info_finish (client_ctl, res, &error);
+    if (!output) {
+        if (g_error_matches (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TIMEOUT)) {
+            /* Update retries... */
+            ctx->version_check_retries--;
+            /* If retries left and no other pipelined request failed, retry */
+            if (ctx->version_check_retries > 0 && !ctx->ctl_setup_error) {
+                g_error_free (error);
+
+                /* The modem isn't ready yet, so the pipelined requests were
+                 * likely lost; cancel them, they're issued again once the
+                 * version info check succeeds */
+                if (!ctx->ctl_setup_restarting && ctx->ctl_setup_running != CTL_SETUP_OPERATION_NONE) {
+                    g_debug ("[%s] Device not ready yet, delaying pipelined requests...",
+                             self->priv->path_display);
+                    ctx->ctl_setup_restarting = TRUE;
+                    ctx->ctl_setup_cancelled = ctx->ctl_setup_running;
+                    g_cancellable_cancel (ctx->ctl_setup_cancellable);
+                }
+
+                qmi_client_ctl_get_version_info (self->priv->client_ctl,
+                                                 NULL,
+                                                 1,
+                                                 g_task_get_cancellable (task),
+                                                 (GAsyncReadyCallback)open_version_info_ready,
+                                                 task);
+                return;
+            }
+
+            /* Otherwise, propagate the error */
+        }
+
+        ctx->ctl_setup_version_info_pending = FALSE;
+        ctl_setup_operation_complete (task, CTL_SETUP_OPERATION_NONE, error);
+        return;
+    }
+
+    ctx->ctl_setup_version_info_pending = FALSE;
+
+    /* Check result of the QMI operation */
+    if (!qmi_message_ctl_get_version_info_output_get_result (output, &error)) {
+        ctl_setup_operation_complete (task, CTL_SETUP_OPERATION_NONE, error);
+        qmi_message_ctl_get_version_info_output_unref (output);
+        return;
+    }
+
+    /* QMI operation succeeded, we can now get the outputs */
+    service_list = NULL;
+    qmi_message_ctl_get_version_info_output_get_service_list (output,
+                                                              &service_list,
+                                                              NULL);
+    device_set_supported_services (self, service_list);
+    version_info_cache_save (self, service_list);
+
+    qmi_message_ctl_get_version_info_output_unref (output);
+
+    /* Modem is ready, issue again the requests stopped while waiting */
+    ctl_setup_restart_stopped (task);
+
+    ctl_setup_operation_complete (task, CTL_SETUP_OPERATION_NONE, NULL);
+}
+
+static void
+internal_proxy_open_ready (QmiClientCtl *client_ctl,
+                           GAsyncResult *res,
+                           GTask *task)
+{
+    QmiDevice *self;
+    DeviceOpenContext *ctx;
+    QmiMessageCtlInternalProxyOpenOutput *output;
+    GError *error = NULL;
+
+    /* Check result of the async operation */
+    output = qmi_client_ctl_internal_proxy_open_finish (client_ctl, res, &error);
+    if (!output) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    /* Check result of the QMI operation */
+    if (!qmi_message_ctl_internal_proxy_open_output_get_result (output, &error)) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        qmi_message_ctl_internal_proxy_open_output_unref (output);
+        return;
+    }
+
+    /* Older proxies don't know about aborting requests, filtering or
+     * monitoring indications, or reporting their transactions and
+     * statistics */
+    self = g_task_get_source_object (task);
+    if (!qmi_message_ctl_internal_proxy_open_output_get_abort_supported (output,
+                                                                         &self->priv->proxy_abort_supported,
+                                                                         NULL))
+        self->priv->proxy_abort_supported = FALSE;
+    if (!qmi_message_ctl_internal_proxy_open_output_get_indication_filter_supported (output,
+                                                                                    &self->priv->proxy_indication_filter_supported,
+                                                                                    NULL))
+        self->priv->proxy_indication_filter_supported = FALSE;
+    if (!qmi_message_ctl_internal_proxy_open_output_get_transactions_supported (output,
+                                                                                &self->priv->proxy_transactions_supported,
+                                                                                NULL))
+        self->priv->proxy_transactions_supported = FALSE;
+    if (!qmi_message_ctl_internal_proxy_open_output_get_stats_supported (output,
+                                                                         &self->priv->proxy_stats_supported,
+                                                                         NULL))
+        self->priv->proxy_stats_supported = FALSE;
+    if (!qmi_message_ctl_internal_proxy_open_output_get_monitor_supported (output,
+                                                                           &self->priv->proxy_monitor_supported,
+                                                                           NULL))
+        self->priv->proxy_monitor_supported = FALSE;
+
+    qmi_message_ctl_internal_proxy_open_output_unref (output);
+
+    /* Go on */
+    ctx = g_task_get_task_data (task);
+    ctx->step++;
+    device_open_step (task);
+}
+
+static void
+create_iostream_ready (QmiDevice *self,
+                       GAsyncResult *res,
+                       GTask *task)
+{
+    DeviceOpenContext *ctx;
+    GError *error = NULL;
+
+    ctx = g_task_get_task_data (task);
+
+    if (!create_iostream_finish (self, res, &error)) {
+        if (ctx->io_thread_started)
+            io_thread_stop (self);
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    /* Go on */
+    ctx->step++;
+    device_open_step (task);
+}
+
+#if defined MBIM_QMUX_ENABLED
+
+static void
+mbim_device_open_ready (MbimDevice *dev,
+                        GAsyncResult *res,
+                        GTask *task)
+{
+    QmiDevice *self;
+    DeviceOpenContext *ctx;
+    GError *error = NULL;
+
+    if (!mbim_device_open_finish (dev, res, &error)) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    self = g_task_get_source_object (task);
+    g_debug ("[%s] MBIM device open", self->priv->path_display);
+
+    /* Go on */
+    ctx = g_task_get_task_data (task);
+    ctx->step++;
+    device_open_step (task);
+}
+
+static void
+open_mbim_device (GTask *task)
+{
+    QmiDevice *self;
+    DeviceOpenContext *ctx;
+    MbimDeviceOpenFlags open_flags = MBIM_DEVICE_OPEN_FLAGS_NONE;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    /* If QMI proxy was requested, use MBIM proxy instead */
+    if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_PROXY)
+        open_flags |= MBIM_DEVICE_OPEN_FLAGS_PROXY;
+
+    /* We pass the original timeout of the request to the open operation */
+    g_debug ("[%s] opening MBIM device...", self->priv->path_display);
+    mbim_device_open_full (self->priv->mbimdev,
+                           open_flags,
+                           ctx->timeout,
+                           g_task_get_cancellable (task),
+                           (GAsyncReadyCallback) mbim_device_open_ready,
+                           task);
+}
+
+static void
+mbim_device_indicate_status_cb (MbimDevice  *dev,
+                                MbimMessage *indication,
+                                QmiDevice   *self)
+{
+    const guint8 *buf;
+    guint32 len;
+
+    if (mbim_message_indicate_status_get_service (indication) != MBIM_SERVICE_QMI ||
+        mbim_message_indicate_status_get_cid (indication) != MBIM_CID_QMI_MSG)
+        return;
+
+    g_debug ("[%s] Received MBIM indication", self->priv->path_display);
+
+    /* QMI indications are given in the information buffer; store it in the
+     * internal reception buffer, as if we had read from a iochannel, so that
+     * they're processed as any other indication */
+    buf = mbim_message_indicate_status_get_raw_information_buffer (indication, &len);
+    if (!len)
+        return;
+    if (!G_UNLIKELY (self->priv->buffer))
+        self->priv->buffer = g_byte_array_sized_new (len);
+    g_byte_array_append (self->priv->buffer, buf, len);
+    parse_response (self);
+}
+
+static void
+mbim_device_release (QmiDevice *self)
+{
+    if (self->priv->mbim_indication_id) {
+        g_signal_handler_disconnect (self->priv->mbimdev, self->priv->mbim_indication_id);
+        self->priv->mbim_indication_id = 0;
+    }
+    g_clear_object (&self->priv->mbimdev);
+}
+
+static void
+mbim_device_new_ready (GObject *source,
+                       GAsyncResult *res,
+                       GTask *task)
+{
+    QmiDevice *self;
+    DeviceOpenContext *ctx;
+    GError *error = NULL;
+
+    self = g_task_get_source_object (task);
+    self->priv->mbimdev = mbim_device_new_finish (res, &error);
+    if (!self->priv->mbimdev) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    g_debug ("[%s] MBIM device created", self->priv->path_display);
+
+    /* QMI indications come as MBIM indications of the QMI service */
+    self->priv->mbim_indication_id = g_signal_connect (self->priv->mbimdev,
+                                                       MBIM_DEVICE_SIGNAL_INDICATE_STATUS,
+                                                       G_CALLBACK (mbim_device_indicate_status_cb),
+                                                       self);
+
+    /* Go on */
+    ctx = g_task_get_task_data (task);
+    ctx->step++;
+    device_open_step (task);
+}
+
+static void
+create_mbim_device (GTask *task)
+{
+    QmiDevice *self;
+    GFile *file;
+
+    self = g_task_get_source_object (task);
+    if (self->priv->mbimdev) {
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_WRONG_STATE,
+                                 "Already open");
+        g_object_unref (task);
+        return;
+    }
+
+    g_debug ("[%s] creating MBIM device...", self->priv->path_display);
+    file = g_file_new_for_path (self->priv->path);
+    mbim_device_new (file,
+                     g_task_get_cancellable (task),
+                     (GAsyncReadyCallback) mbim_device_new_ready,
+                     task);
+    g_object_unref (file);
+}
+
+#endif
+
+#if defined HAVE_LINUX_QRTR_H
+
+/*****************************************************************************/
+/* QRTR transport, see qmi-qrtr.h */
+
+static GByteArray *
+qrtr_get_buffer (QmiDevice *self)
+{
+    if (!G_UNLIKELY (self->priv->buffer))
+        self->priv->buffer = g_byte_array_sized_new (BUFFER_SIZE);
+    return self->priv->buffer;
+}
+
+static void
+qrtr_input (QmiDevice *self)
+{
+    /* The node may be closed while processing the messages */
+    g_object_ref (self);
+    parse_response (self);
+    g_object_unref (self);
+}
+
+/* Completes right away the transaction of a request that couldn't be sent,
+ * if still around */
+static void
+qrtr_send_error (QmiMessage   *message,
+                 const GError *error,
+                 QmiDevice    *self)
+{
+    gpointer     key;
+    Transaction *tr;
+
+    key = build_transaction_key (message);
+    tr = (Transaction *) __qmi_transaction_table_lookup (&self->priv->transactions, GPOINTER_TO_UINT (key));
+    if (!tr || tr->message != message)
+        return;
+
+    tr = device_release_transaction (self, key);
+    transaction_complete_and_free (tr, NULL, error);
+}
+
+static const QmiQrtrNodeCallbacks qrtr_callbacks = {
+    .get_buffer = (GByteArray * (*) (gpointer)) qrtr_get_buffer,
+    .input      = (void (*) (gpointer)) qrtr_input,
+    .send_error = (void (*) (QmiMessage *, const GError *, gpointer)) qrtr_send_error,
+    .removed    = (void (*) (gpointer)) device_report_removed,
+};
+
+static void
+qrtr_close (QmiDevice *self)
+{
+    g_clear_pointer (&self->priv->qrtr_node, __qmi_qrtr_node_free);
+}
+
+typedef struct {
+    GTask  *task;
+    GError *error;
+    guint   n_servers;
+} QrtrOpenResult;
+
+/* Run in the context of the open operation */
+static gboolean
+qrtr_open_result_cb (QrtrOpenResult *result)
+{
+    GTask             *task;
+    QmiDevice         *self;
+    DeviceOpenContext *ctx;
+
+    task = result->task;
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    if (result->error) {
+        if (ctx->io_thread_started)
+            io_thread_stop (self);
+        qrtr_close (self);
+        g_task_return_error (task, result->error);
+        g_object_unref (task);
+    } else {
+        g_debug ("[%s] QRTR node open: %u services found",
+                 self->priv->path_display, result->n_servers);
+
+        /* No driver, I/O streams nor proxy involved */
+        ctx->step = DEVICE_OPEN_CONTEXT_STEP_FLAGS_CTL_SETUP;
+        device_open_step (task);
+    }
+
+    g_slice_free (QrtrOpenResult, result);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+qrtr_open_ready (QmiQrtrNode *node,
+                 GError      *error,
+                 GTask       *task)
+{
+    QrtrOpenResult *result;
+    GSource        *source;
+
+    result = g_slice_new0 (QrtrOpenResult);
+    result->task = task;
+    result->error = error;
+    result->n_servers = __qmi_qrtr_node_get_n_servers (node);
+
+    /* Always in an idle, even if in the same context, as the node cannot be
+     * freed from within this callback */
+    source = g_idle_source_new ();
+    g_source_set_callback (source, (GSourceFunc) qrtr_open_result_cb, result, NULL);
+    g_source_attach (source, g_task_get_context (task));
+    g_source_unref (source);
+}
+
+static void
+qrtr_open (GTask *task)
+{
+    QmiDevice         *self;
+    DeviceOpenContext *ctx;
+    GError            *error = NULL;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    if (self->priv->qrtr_node) {
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_WRONG_STATE,
+                                 "Already open");
+        g_object_unref (task);
+        return;
+    }
+
+    /* The I/O thread must be running before any source is created */
+    if ((ctx->flags & QMI_DEVICE_OPEN_FLAGS_IO_THREAD) && !self->priv->io_thread) {
+        if (!io_thread_start (self, &error)) {
+            g_prefix_error (&error, "Cannot start I/O thread: ");
+            g_task_return_error (task, error);
+            g_object_unref (task);
+            return;
+        }
+        ctx->io_thread_started = TRUE;
+    }
+
+    self->priv->qrtr_node = __qmi_qrtr_node_new (self->priv->qrtr_node_id,
+                                                 self->priv->path_display,
+                                                 device_peek_io_context (self),
+                                                 &qrtr_callbacks,
+                                                 self);
+    if (!__qmi_qrtr_node_open (self->priv->qrtr_node,
+                               ctx->timeout,
+                               (QmiQrtrNodeOpenFn) qrtr_open_ready,
+                               task,
+                               &error)) {
+        if (ctx->io_thread_started)
+            io_thread_stop (self);
+        qrtr_close (self);
+        g_task_return_error (task, error);
+        g_object_unref (task);
+    }
+}
+
+#endif /* HAVE_LINUX_QRTR_H */
+
+#define NETPORT_FLAGS (QMI_DEVICE_OPEN_FLAGS_NET_802_3 | \
+                       QMI_DEVICE_OPEN_FLAGS_NET_RAW_IP | \
+                       QMI_DEVICE_OPEN_FLAGS_NET_QOS_HEADER | \
+                       QMI_DEVICE_OPEN_FLAGS_NET_NO_QOS_HEADER)
+
+static void
+device_open_step (GTask *task)
+{
+    QmiDevice *self;
+    DeviceOpenContext *ctx;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    switch (ctx->step) {
+    case DEVICE_OPEN_CONTEXT_STEP_FIRST:
+        ctx->step++;
+        /* Fall down */
+
+#if defined HAVE_LINUX_QRTR_H
+    case DEVICE_OPEN_CONTEXT_STEP_QRTR:
+        if (self->priv->qrtr) {
+            ctx->flags &= ~(QMI_DEVICE_OPEN_FLAGS_MBIM | QMI_DEVICE_OPEN_FLAGS_AUTO);
+            /* Through the proxy, which opens the QRTR node itself */
+            if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_PROXY) {
+                ctx->step = DEVICE_OPEN_CONTEXT_STEP_CREATE_IOSTREAM;
+                device_open_step (task);
+                return;
+            }
+            qrtr_open (task);
+            return;
+        }
+        ctx->step++;
+        /* Fall down */
+#endif
+
+    case DEVICE_OPEN_CONTEXT_STEP_DRIVER:
+        ctx->driver = __qmi_utils_get_driver (self->priv->path);
+        if (ctx->driver)
+            g_debug ("[%s] loaded driver of cdc-wdm port: %s", self->priv->path_display, ctx->driver);
+        else if (!self->priv->no_file_check)
+            g_warning ("[%s] couldn't load driver of cdc-wdm port", self->priv->path_display);
+
+#if defined MBIM_QMUX_ENABLED
+
+        /* Auto mode requested? */
+        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_AUTO) {
+            if (!g_strcmp0 (ctx->driver, "cdc_mbim")) {
+                g_debug ("[%s] automatically selecting MBIM mode", self->priv->path_display);
+                ctx->flags |= QMI_DEVICE_OPEN_FLAGS_MBIM;
+                goto next_step;
+            }
+            if (!g_strcmp0 (ctx->driver, "qmi_wwan")) {
+                g_debug ("[%s] automatically selecting QMI mode", self->priv->path_display);
+                ctx->flags &= ~QMI_DEVICE_OPEN_FLAGS_MBIM;
+                goto next_step;
+            }
+            g_task_return_new_error (task,
+                                     QMI_CORE_ERROR,
+                                     QMI_CORE_ERROR_FAILED,
+                                     "Cannot automatically select QMI/MBIM mode: driver %s",
+                                     ctx->driver ? ctx->driver : "unknown");
+            g_object_unref (task);
+            return;
+        }
+
+        /* MBIM mode requested? */
+        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_MBIM) {
+            if (g_strcmp0 (ctx->driver, "cdc_mbim") && !self->priv->no_file_check)
+                g_warning ("[%s] requested MBIM mode but unexpected driver found: %s", self->priv->path_display, ctx->driver);
+            goto next_step;
+        }
+
+#else
+        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_AUTO)
+            g_warning ("[%s] requested auto mode but no MBIM QMUX support available", self->priv->path_display);
+        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_MBIM)
+            g_warning ("[%s] requested MBIM mode but no MBIM QMUX support available", self->priv->path_display);
+
+#endif /* MBIM_QMUX_ENABLED */
+
+        /* QMI mode requested? */
+        if (g_strcmp0 (ctx->driver, "qmi_wwan") && !self->priv->no_file_check)
+            g_warning ("[%s] requested QMI mode but unexpected driver found: %s",
+                       self->priv->path_display, ctx->driver ? ctx->driver : "unknown");
+
+#if defined MBIM_QMUX_ENABLED
+    next_step:
+#endif
+        ctx->step++;
+        /* Fall down */
+
+#if defined MBIM_QMUX_ENABLED
+    case DEVICE_OPEN_CONTEXT_STEP_DEVICE_MBIM:
+        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_MBIM) {
+            create_mbim_device (task);
+            return;
+        }
+        ctx->step++;
+        /* Fall down */
+
+    case DEVICE_OPEN_CONTEXT_STEP_OPEN_DEVICE_MBIM:
+        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_MBIM) {
+            open_mbim_device (task);
+            return;
+        }
+        ctx->step++;
+        /* Fall down */
+#endif
+
+    case DEVICE_OPEN_CONTEXT_STEP_CREATE_IOSTREAM:
+        if (!(ctx->flags & QMI_DEVICE_OPEN_FLAGS_MBIM)) {
+            /* The I/O thread must be running before any source is created */
+            if ((ctx->flags & QMI_DEVICE_OPEN_FLAGS_IO_THREAD) && !self->priv->io_thread) {
+                GError *error = NULL;
+
+                if (!io_thread_start (self, &error)) {
+                    g_prefix_error (&error, "Cannot start I/O thread: ");
+                    g_task_return_error (task, error);
+                    g_object_unref (task);
+                    return;
+                }
+                ctx->io_thread_started = TRUE;
+            }
+            create_iostream (self,
+                             !!(ctx->flags & QMI_DEVICE_OPEN_FLAGS_PROXY),
+                             (GAsyncReadyCallback)create_iostream_ready,
+                             task);
+            return;
+        }
+        ctx->step++;
+        /* Fall down */
+
+    case DEVICE_OPEN_CONTEXT_STEP_FLAGS_PROXY:
+        /* Initialize communication with proxy? */
+        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_PROXY && !(ctx->flags & QMI_DEVICE_OPEN_FLAGS_MBIM)) {
+            QmiMessageCtlInternalProxyOpenInput *input;
+
+            input = qmi_message_ctl_internal_proxy_open_input_new ();
+            qmi_message_ctl_internal_proxy_open_input_set_device_path (input, self->priv->path, NULL);
+            qmi_client_ctl_internal_proxy_open (self->priv->client_ctl,
+                                                input,
+                                                5,
+                                                g_task_get_cancellable (task),
+                                                (GAsyncReadyCallback)internal_proxy_open_ready,
+                                                task);
+            qmi_message_ctl_internal_proxy_open_input_unref (input);
+            return;
+        }
+        ctx->step++;
+        /* Fall down */
+
+    case DEVICE_OPEN_CONTEXT_STEP_FLAGS_CTL_SETUP:
+        /* Version info, sync and network port setup, all pipelined */
+        ctl_setup_reset_cancellable (task);
+        ctx->ctl_setup_pending = 0;
+
+        /* Query version info? */
+        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_VERSION_INFO) {
+            GArray *cached;
+
+            /* Use the cached list if any, it will be revalidated once open */
+            cached = version_info_cache_load (self);
+            if (cached) {
+                device_set_supported_services (self, cached);
+                g_array_unref (cached);
+                ctx->version_info_cached = TRUE;
+            } else {
+                /* Setup how many times to retry... We'll retry once per second */
+                ctx->version_check_retries = ctx->timeout > 0 ? ctx->timeout : 1;
+                g_debug ("[%s] Checking version info (%u retries)...",
+                         self->priv->path_display,
+                         ctx->version_check_retries);
+                ctx->ctl_setup_pending++;
+                ctx->ctl_setup_version_info_pending = TRUE;
+                qmi_client_ctl_get_version_info (self->priv->client_ctl,
+                                                 NULL,
+                                                 1,
+                                                 g_task_get_cancellable (task),
+                                                 (GAsyncReadyCallback)open_version_info_ready,
+                                                 task);
+            }
+        }
+
+        /* Sync? */
+        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_SYNC)
+            ctl_setup_operation_start (task, CTL_SETUP_OPERATION_SYNC);
+
+        /* Network port setup */
+        if (ctx->flags & NETPORT_FLAGS)
+            ctl_setup_operation_start (task, CTL_SETUP_OPERATION_NETPORT);
+
+        if (ctx->ctl_setup_pending > 0)
+            return;
+
+        ctx->step++;
+        /* Fall down */
+
+    case DEVICE_OPEN_CONTEXT_STEP_LAST:
+        /* Revalidate the cached version info in background */
+        if (ctx->version_info_cached) {
+            g_debug ("[%s] Revalidating cached version info...",
+                     self->priv->path_display);
+            qmi_client_ctl_get_version_info (self->priv->client_ctl,
+                                             NULL,
+                                             ctx->timeout > 0 ? ctx->timeout : 1,
+                                             NULL,
+                                             (GAsyncReadyCallback)version_info_revalidate_ready,
+                                             g_object_ref (self));
+        }
+
+        self->priv->removal_reported = FALSE;
+        if (self->priv->removal_monitor_enabled)
+            removal_monitor_start (self);
+        if (self->priv->suspend_monitor_enabled)
+            suspend_monitor_start (self);
+
+        /* Nothing else to process, done we are */
+        g_task_return_boolean (task, TRUE);
+        g_object_unref (task);
+        return;
+
+    default:
+        break;
+    }
+
+    g_assert_not_reached ();
+}
+
+/* Timeout sources left from a previous open in a different context are moved
+ * to the new one */
+static void
+device_set_open_context (QmiDevice *self)
+{
+    GMainContext *context;
+
+    context = g_main_context_get_thread_default ();
+    if (!context)
+        context = g_main_context_default ();
+    if (self->priv->open_context == context)
+        return;
+
+    g_clear_pointer (&self->priv->open_context, g_main_context_unref);
+    self->priv->open_context = g_main_context_ref (context);
+
+    if (self->priv->transaction_timeout_source) {
+        g_source_destroy (self->priv->transaction_timeout_source);
+        g_clear_pointer (&self->priv->transaction_timeout_source, g_source_unref);
+        transaction_timeout_source_setup (self);
+        transaction_timeouts_reschedule (self);
+    }
+
+    if (self->priv->health_check_source) {
+        g_source_destroy (self->priv->health_check_source);
+        g_clear_pointer (&self->priv->health_check_source, g_source_unref);
+        health_check_source_setup (self);
+        health_check_reschedule (self);
+    }
+}
+
+void
+qmi_device_open (QmiDevice *self,
+                 QmiDeviceOpenFlags flags,
+                 guint timeout,
+                 GCancellable *cancellable,
+                 GAsyncReadyCallback callback,
+                 gpointer user_data)
+{
+    DeviceOpenContext *ctx;
+    gchar *flags_str;
+    GTask *task;
+
+    /* Raw IP and 802.3 are mutually exclusive */
+    g_return_if_fail (!((flags & QMI_DEVICE_OPEN_FLAGS_NET_802_3) &&
+                        (flags & QMI_DEVICE_OPEN_FLAGS_NET_RAW_IP)));
+    /* QoS and no QoS are mutually exclusive */
+    g_return_if_fail (!((flags & QMI_DEVICE_OPEN_FLAGS_NET_QOS_HEADER) &&
+                        (flags & QMI_DEVICE_OPEN_FLAGS_NET_NO_QOS_HEADER)));
+    /* At least one of both link protocol and QoS must be specified */
+    if (flags & (QMI_DEVICE_OPEN_FLAGS_NET_802_3 | QMI_DEVICE_OPEN_FLAGS_NET_RAW_IP))
+        g_return_if_fail (flags & (QMI_DEVICE_OPEN_FLAGS_NET_QOS_HEADER | QMI_DEVICE_OPEN_FLAGS_NET_NO_QOS_HEADER));
+    if (flags & (QMI_DEVICE_OPEN_FLAGS_NET_QOS_HEADER | QMI_DEVICE_OPEN_FLAGS_NET_NO_QOS_HEADER))
+        g_return_if_fail (flags & (QMI_DEVICE_OPEN_FLAGS_NET_802_3 | QMI_DEVICE_OPEN_FLAGS_NET_RAW_IP));
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
+
+    flags_str = qmi_device_open_flags_build_string_from_mask (flags);
+    g_debug ("[%s] Opening device with flags '%s'...",
+             self->priv->path_display,
+             flags_str);
+    g_free (flags_str);
 
-    g_task_return_boolean (task, TRUE);
-    g_object_unref (task);
+    ctx = g_slice_new0 (DeviceOpenContext);
+    ctx->step = DEVICE_OPEN_CONTEXT_STEP_FIRST;
+    ctx->flags = flags;
+    ctx->timeout = timeout;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_task_data (task, ctx, (GDestroyNotify)device_open_context_free);
+
+    if (!device_transport_ready (self))
+        device_set_open_context (self);
+
+    /* Start processing */
+    device_open_step (task);
 }
 
+/*****************************************************************************/
+/* Output queue */
+
+typedef struct {
+    QmiMessage         *message;
+    QmiMessagePriority  priority;
+} OutputItem;
+
 static void
-create_iostream_with_fd (GTask *task)
+output_item_free (OutputItem *item)
 {
-    QmiDevice *self;
-    gint fd;
+    qmi_message_unref (item->message);
+    g_slice_free (OutputItem, item);
+}
 
-    self = g_task_get_source_object (task);
-    fd = open (self->priv->path, O_RDWR | O_EXCL | O_NONBLOCK | O_NOCTTY);
-    if (fd < 0) {
-        g_task_return_new_error (task,
-                                 QMI_CORE_ERROR,
-                                 QMI_CORE_ERROR_FAILED,
-                                 "Cannot open device file '%s': %s",
-                                 self->priv->path_display,
-                                 strerror (errno));
-        g_object_unref (task);
+static gboolean output_ready_cb (GOutputStream *ostream,
+                                 QmiDevice     *self);
+
+/* Stops reading, either from the input source or from the io_uring; any
+ * write in flight through the io_uring is not reported */
+static void
+input_source_teardown (QmiDevice *self)
+{
+    if (self->priv->input_source) {
+        g_source_destroy (self->priv->input_source);
+        g_clear_pointer (&self->priv->input_source, g_source_unref);
+    }
+    g_clear_pointer (&self->priv->io_uring_watch, __qmi_io_uring_watch_free);
+}
+
+static void
+output_queue_clear (QmiDevice *self)
+{
+    if (self->priv->output_source) {
+        g_source_destroy (self->priv->output_source);
+        g_clear_pointer (&self->priv->output_source, g_source_unref);
+    }
+
+    self->priv->output_offset = 0;
+    self->priv->output_in_flight = 0;
+
+    /* Messages not written will never get a response, so their transactions
+     * are completed right away instead of waiting for their timeouts */
+    if (g_queue_is_empty (self->priv->output_queue))
+        return;
+
+    g_debug ("[%s] Aborting %u requests not yet written",
+             self->priv->path_display,
+             g_queue_get_length (self->priv->output_queue));
+
+    while (!g_queue_is_empty (self->priv->output_queue)) {
+        OutputItem  *item;
+        Transaction *tr;
+
+        item = g_queue_pop_head (self->priv->output_queue);
+        tr = device_match_transaction (self, item->message);
+        if (tr) {
+            GError *error;
+
+            tr->not_sent = TRUE;
+            error = g_error_new (QMI_PROTOCOL_ERROR,
+                                 QMI_PROTOCOL_ERROR_ABORTED,
+                                 "Request not sent: device closed");
+            transaction_complete_and_free (tr, NULL, error);
+            g_error_free (error);
+        }
+        output_item_free (item);
+    }
+    device_stats_update_lengths (self);
+}
+
+static void
+output_queue_fail_head (QmiDevice *self,
+                        GError    *error)
+{
+    OutputItem  *item;
+    Transaction *tr;
+
+    item = g_queue_pop_head (self->priv->output_queue);
+    self->priv->output_offset = 0;
+
+    tr = device_match_transaction (self, item->message);
+    if (tr) {
+        GError *inner_error;
+
+        inner_error = g_error_new (error->domain, error->code, "Cannot write message: %s", error->message);
+        transaction_complete_and_free (tr, NULL, inner_error);
+        g_error_free (inner_error);
+    }
+    output_item_free (item);
+    device_stats_update_lengths (self);
+}
+
+/* Returns the number of bytes written, or -1 if error */
+static gssize
+output_write (QmiDevice  *self,
+              GError    **error)
+{
+    QmiMessage *message;
+
+    /* Stream sockets (i.e. qmi-proxy connections) allow writing multiple
+     * messages at once; but not through TLS, which must go through the
+     * stream */
+    if (self->priv->socket_connection && !self->priv->proxy_tls) {
+        GOutputVector vectors[OUTPUT_MAX_VECTORS];
+        GList        *l;
+        guint         n_vectors = 0;
+
+        for (l = g_queue_peek_head_link (self->priv->output_queue);
+             l && n_vectors < OUTPUT_MAX_VECTORS;
+             l = g_list_next (l), n_vectors++) {
+            message = ((OutputItem *) l->data)->message;
+            vectors[n_vectors].buffer = ((GByteArray *)message)->data;
+            vectors[n_vectors].size = ((GByteArray *)message)->len;
+        }
+        vectors[0].buffer = ((const guint8 *) vectors[0].buffer) + self->priv->output_offset;
+        vectors[0].size -= self->priv->output_offset;
+
+        return g_socket_send_message (g_socket_connection_get_socket (self->priv->socket_connection),
+                                      NULL, /* address */
+                                      vectors,
+                                      n_vectors,
+                                      NULL, /* messages */
+                                      0,
+                                      0, /* flags */
+                                      NULL, /* cancellable */
+                                      error);
+    }
+
+    /* Character devices (e.g. cdc-wdm) expect one single message per
+     * write */
+    message = ((OutputItem *) g_queue_peek_head (self->priv->output_queue))->message;
+    return g_pollable_output_stream_write_nonblocking (G_POLLABLE_OUTPUT_STREAM (self->priv->ostream),
+                                                       ((GByteArray *)message)->data + self->priv->output_offset,
+                                                       ((GByteArray *)message)->len - self->priv->output_offset,
+                                                       NULL,
+                                                       error);
+}
+
+/* Removes all the messages fully written */
+static void
+output_queue_advance (QmiDevice *self,
+                      gsize      written)
+{
+    while (written > 0) {
+        QmiMessage *message;
+        gsize       pending;
+
+        message = ((OutputItem *) g_queue_peek_head (self->priv->output_queue))->message;
+        pending = ((GByteArray *)message)->len - self->priv->output_offset;
+        if (written < pending) {
+            self->priv->output_offset += written;
+            break;
+        }
+
+        written -= pending;
+        self->priv->output_offset = 0;
+        output_item_free (g_queue_pop_head (self->priv->output_queue));
+    }
+    device_stats_update_lengths (self);
+}
+
+/* The io_uring keeps one write in flight, with the same number of messages
+ * per write as output_write(); the messages are kept alive until the write
+ * completes, even if the queue is cleared meanwhile */
+static void
+output_io_uring_flush (QmiDevice *self)
+{
+    struct iovec  vectors[OUTPUT_MAX_VECTORS];
+    GPtrArray    *messages;
+    GList        *l;
+    guint         max_vectors;
+    guint         n_vectors = 0;
+
+    if (g_queue_is_empty (self->priv->output_queue) ||
+        __qmi_io_uring_watch_is_writing (self->priv->io_uring_watch))
+        return;
+
+    max_vectors = (self->priv->socket_connection ? OUTPUT_MAX_VECTORS : 1);
+    messages = g_ptr_array_new_with_free_func ((GDestroyNotify) qmi_message_unref);
+    for (l = g_queue_peek_head_link (self->priv->output_queue);
+         l && n_vectors < max_vectors;
+         l = g_list_next (l), n_vectors++) {
+        QmiMessage *message;
+
+        message = ((OutputItem *) l->data)->message;
+        vectors[n_vectors].iov_base = ((GByteArray *)message)->data;
+        vectors[n_vectors].iov_len = ((GByteArray *)message)->len;
+        g_ptr_array_add (messages, qmi_message_ref (message));
+    }
+    vectors[0].iov_base = ((guint8 *) vectors[0].iov_base) + self->priv->output_offset;
+    vectors[0].iov_len -= self->priv->output_offset;
+    self->priv->output_in_flight = n_vectors;
+
+    __qmi_io_uring_watch_write (self->priv->io_uring_watch,
+                                vectors,
+                                n_vectors,
+                                messages,
+                                (GDestroyNotify) g_ptr_array_unref);
+}
+
+static void
+output_io_uring_write_cb (gssize        written,
+                          const GError *error,
+                          QmiDevice    *self)
+{
+    self->priv->output_in_flight = 0;
+    if (written < 0) {
+        /* The message being written is lost, fail its transaction */
+        output_queue_fail_head (self, (GError *) error);
+    } else
+        output_queue_advance (self, (gsize) written);
+
+    output_io_uring_flush (self);
+}
+
+static void
+output_flush (QmiDevice *self)
+{
+    if (self->priv->io_uring_watch) {
+        output_io_uring_flush (self);
+        return;
+    }
+
+    while (!g_queue_is_empty (self->priv->output_queue)) {
+        GError *error = NULL;
+        gssize  written;
+
+        written = output_write (self, &error);
+        if (written < 0) {
+            if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+                g_error_free (error);
+                break;
+            }
+
+            /* The message being written is lost, fail its transaction */
+            output_queue_fail_head (self, error);
+            g_error_free (error);
+            continue;
+        }
+
+        output_queue_advance (self, written);
+    }
+
+    /* Wait until the stream is writable again if there's still pending
+     * data */
+    if (!g_queue_is_empty (self->priv->output_queue) && !self->priv->output_source) {
+        self->priv->output_source = g_pollable_output_stream_create_source (G_POLLABLE_OUTPUT_STREAM (self->priv->ostream), NULL);
+        g_source_set_callback (self->priv->output_source, (GSourceFunc)output_ready_cb, self, NULL);
+        g_source_attach (self->priv->output_source, device_peek_io_context (self));
+    }
+}
+
+static gboolean
+output_ready_cb (GOutputStream *ostream,
+                 QmiDevice     *self)
+{
+    g_clear_pointer (&self->priv->output_source, g_source_unref);
+    output_flush (self);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+output_batch_cb (QmiDevice *self)
+{
+    g_clear_pointer (&self->priv->output_source, g_source_unref);
+    output_flush (self);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+output_queue_push (QmiDevice          *self,
+                   QmiMessage         *message,
+                   QmiMessagePriority  priority)
+{
+    OutputItem *item;
+    GList      *l;
+    guint       position;
+    guint       n_locked;
+
+    item = g_slice_new (OutputItem);
+    item->message = qmi_message_ref (message);
+    item->priority = priority;
+
+    /* Queue after the last message with the same or higher priority, but
+     * never before a message already partially written or being written
+     * through the io_uring */
+    n_locked = MAX (self->priv->output_in_flight, self->priv->output_offset > 0 ? 1 : 0);
+    for (l = g_queue_peek_tail_link (self->priv->output_queue), position = g_queue_get_length (self->priv->output_queue);
+         l;
+         l = g_list_previous (l), position--) {
+        if (((OutputItem *) l->data)->priority >= priority || position <= n_locked)
+            break;
+    }
+    if (l)
+        g_queue_insert_after (self->priv->output_queue, l, item);
+    else
+        g_queue_push_head (self->priv->output_queue, item);
+    device_stats_update_lengths (self);
+
+    /* If already waiting for the stream to be writable, or queueing a batch
+     * of requests, nothing else to do */
+    if (self->priv->output_source || self->priv->output_batching)
+        return;
+
+    /* Every write to a remote proxy ends up as at least one segment in the
+     * network, so all the messages queued until the context is idle are
+     * written together */
+    if (self->priv->proxy_remote) {
+        self->priv->output_source = g_idle_source_new ();
+        g_source_set_callback (self->priv->output_source, (GSourceFunc)output_batch_cb, self, NULL);
+        g_source_attach (self->priv->output_source, device_peek_io_context (self));
+        return;
+    }
+
+    output_flush (self);
+}
+
+/*****************************************************************************/
+/* I/O thread */
+
+static gpointer
+io_thread_func (GMainLoop *loop)
+{
+    GMainContext *io_context;
+
+    io_context = g_main_loop_get_context (loop);
+    g_main_context_push_thread_default (io_context);
+    g_main_loop_run (loop);
+    g_main_context_pop_thread_default (io_context);
+    g_main_loop_unref (loop);
+    return NULL;
+}
+
+static gboolean
+io_thread_quit (GMainLoop *loop)
+{
+    g_main_loop_quit (loop);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+io_thread_start (QmiDevice  *self,
+                 GError    **error)
+{
+    GThread *thread;
+
+    g_assert (!self->priv->io_thread);
+
+    self->priv->io_context = g_main_context_new ();
+    self->priv->io_loop = g_main_loop_new (self->priv->io_context, FALSE);
+    thread = g_thread_try_new ("qmi-device-io",
+                               (GThreadFunc)io_thread_func,
+                               g_main_loop_ref (self->priv->io_loop),
+                               error);
+    if (!thread) {
+        g_main_loop_unref (self->priv->io_loop);
+        g_clear_pointer (&self->priv->io_loop, g_main_loop_unref);
+        g_clear_pointer (&self->priv->io_context, g_main_context_unref);
+        return FALSE;
+    }
+
+    self->priv->io_thread = thread;
+    self->priv->owner_context = g_main_context_ref_thread_default ();
+    return TRUE;
+}
+
+/* Recreate in the current thread-default context all the sources that were
+ * attached to the I/O context */
+static void
+io_thread_move_sources (QmiDevice *self)
+{
+    if (self->priv->input_source || self->priv->io_uring_watch) {
+        input_source_teardown (self);
+        input_source_setup (self);
+    }
+
+    if (self->priv->output_source) {
+        g_source_destroy (self->priv->output_source);
+        g_clear_pointer (&self->priv->output_source, g_source_unref);
+        output_flush (self);
+    }
+
+    if (self->priv->throttled_source) {
+        g_source_destroy (self->priv->throttled_source);
+        g_clear_pointer (&self->priv->throttled_source, g_source_unref);
+        device_schedule_throttled (self);
+    }
+
+    if (self->priv->transaction_timeout_source) {
+        g_source_destroy (self->priv->transaction_timeout_source);
+        g_clear_pointer (&self->priv->transaction_timeout_source, g_source_unref);
+        transaction_timeout_source_setup (self);
+        transaction_timeouts_reschedule (self);
+    }
+
+    if (self->priv->health_check_source) {
+        g_source_destroy (self->priv->health_check_source);
+        g_clear_pointer (&self->priv->health_check_source, g_source_unref);
+        health_check_source_setup (self);
+        health_check_reschedule (self);
+    }
+}
+
+static void
+io_thread_stop (QmiDevice *self)
+{
+    GMainContext *io_context;
+    GSource      *source;
+    gboolean      in_io_thread;
+
+    if (!self->priv->io_thread)
+        return;
+
+    /* Quit from within the loop, so that it doesn't matter whether it is
+     * already running or not */
+    source = g_idle_source_new ();
+    g_source_set_callback (source,
+                           (GSourceFunc)io_thread_quit,
+                           g_main_loop_ref (self->priv->io_loop),
+                           (GDestroyNotify)g_main_loop_unref);
+    g_source_attach (source, self->priv->io_context);
+    g_source_unref (source);
+
+    /* The last reference to the device may be dropped in the I/O thread
+     * itself, in which case it will just exit once back in the loop */
+    in_io_thread = (g_thread_self () == self->priv->io_thread);
+    if (in_io_thread)
+        g_thread_unref (self->priv->io_thread);
+    else
+        g_thread_join (self->priv->io_thread);
+    self->priv->io_thread = NULL;
+    g_clear_pointer (&self->priv->io_loop, g_main_loop_unref);
+
+    io_context = self->priv->io_context;
+    self->priv->io_context = NULL;
+
+    if (!in_io_thread) {
+        /* From now on everything runs in the current context; requests
+         * already submitted to the I/O context are processed as well */
+        io_thread_move_sources (self);
+        while (g_main_context_iteration (io_context, FALSE));
+    }
+
+    g_main_context_unref (io_context);
+    g_clear_pointer (&self->priv->owner_context, g_main_context_unref);
+}
+
+/*****************************************************************************/
+/* Removal monitor
+ *
+ * In some failure modes of USB devices the file descriptor stays open and
+ * nothing is ever read from it any more, so the removal is never detected
+ * and the requests just time out. The kernel removes the device file as
+ * soon as the device (or its driver) goes away, so the file is monitored and
+ * the removal reported right away, completing all the ongoing requests. */
+
+static gboolean
+removal_monitor_idle (QmiDevice *self)
+{
+    GError *error;
+
+    /* Closed (or reported as removed) meanwhile */
+    if (!qmi_device_is_open (self) || self->priv->removal_reported)
+        return G_SOURCE_REMOVE;
+
+    g_warning ("[%s] Device file removed", self->priv->path_display);
+
+    if (self->priv->transactions.n_items) {
+        error = g_error_new (QMI_CORE_ERROR,
+                             QMI_CORE_ERROR_WRONG_STATE,
+                             "Device removed");
+        device_abort_all_transactions (self, error);
+        g_error_free (error);
+    }
+
+    device_report_removed (self);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+removal_monitor_changed_cb (GFileMonitor      *monitor,
+                            GFile             *file,
+                            GFile             *other_file,
+                            GFileMonitorEvent  event_type,
+                            QmiDevice         *self)
+{
+    GSource *source;
+
+    if (event_type != G_FILE_MONITOR_EVENT_DELETED)
+        return;
+
+    /* Transactions are handled in the I/O context */
+    source = g_idle_source_new ();
+    g_source_set_callback (source,
+                           (GSourceFunc)removal_monitor_idle,
+                           g_object_ref (self),
+                           (GDestroyNotify)g_object_unref);
+    g_source_attach (source, device_peek_io_context (self));
+    g_source_unref (source);
+}
+
+static void
+removal_monitor_stop (QmiDevice *self)
+{
+    if (!self->priv->removal_monitor)
+        return;
+
+    g_signal_handlers_disconnect_by_func (self->priv->removal_monitor, removal_monitor_changed_cb, self);
+    g_file_monitor_cancel (self->priv->removal_monitor);
+    g_clear_object (&self->priv->removal_monitor);
+}
+
+static void
+removal_monitor_start (QmiDevice *self)
+{
+    GError *error = NULL;
+
+    if (self->priv->removal_monitor || !self->priv->file || !g_file_is_native (self->priv->file))
+        return;
+
+    self->priv->removal_monitor = g_file_monitor_file (self->priv->file, G_FILE_MONITOR_NONE, NULL, &error);
+    if (!self->priv->removal_monitor) {
+        g_debug ("[%s] Couldn't monitor device file removal: %s",
+                 self->priv->path_display, error->message);
+        g_error_free (error);
+        return;
+    }
+
+    g_signal_connect (self->priv->removal_monitor,
+                      "changed",
+                      G_CALLBACK (removal_monitor_changed_cb),
+                      self);
+}
+
+/*****************************************************************************/
+/* Handoff of the open device file to another process
+ *
+ * The file descriptor of the device is passed as is, so the open device
+ * file is shared by both processes until the one handing it over closes its
+ * own. Only input is paused: nothing is written to the device meanwhile as
+ * long as no request is sent. */
+
+gboolean
+__qmi_device_handoff_pause (QmiDevice   *self,
+                            gint        *fd,
+                            GByteArray **pending_input,
+                            GError     **error)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+
+    if (!qmi_device_is_open (self) ||
+        !G_IS_UNIX_INPUT_STREAM (self->priv->istream) ||
+        self->priv->socket_connection ||
+        self->priv->io_thread) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_UNSUPPORTED,
+                     "Cannot hand over device '%s': not an open device file handled in the main context",
+                     self->priv->path_display);
+        return FALSE;
+    }
+
+    /* Data already read by the io_uring when the read is cancelled would be
+     * lost */
+    if (self->priv->io_uring_watch) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_UNSUPPORTED,
+                     "Cannot hand over device '%s': io_uring engine in use",
+                     self->priv->path_display);
+        return FALSE;
+    }
+
+    if (!g_queue_is_empty (self->priv->output_queue)) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE,
+                     "Cannot hand over device '%s': output pending",
+                     self->priv->path_display);
+        return FALSE;
+    }
+
+    if (self->priv->input_source) {
+        g_source_destroy (self->priv->input_source);
+        g_clear_pointer (&self->priv->input_source, g_source_unref);
+    }
+
+    *fd = g_unix_input_stream_get_fd (G_UNIX_INPUT_STREAM (self->priv->istream));
+    *pending_input = g_byte_array_new ();
+    if (self->priv->buffer && self->priv->buffer_offset < self->priv->buffer->len)
+        g_byte_array_append (*pending_input,
+                             &self->priv->buffer->data[self->priv->buffer_offset],
+                             self->priv->buffer->len - self->priv->buffer_offset);
+
+    g_debug ("[%s] input paused for handoff (%u bytes pending)",
+             self->priv->path_display, (*pending_input)->len);
+    return TRUE;
+}
+
+void
+__qmi_device_handoff_resume (QmiDevice *self)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+
+    if (!qmi_device_is_open (self) || self->priv->input_source || self->priv->io_uring_watch)
         return;
+
+    g_debug ("[%s] input resumed", self->priv->path_display);
+    input_source_setup (self);
+
+    /* Frames received before the handoff may already be complete */
+    if (self->priv->buffer && self->priv->buffer->len > 0) {
+        g_object_ref (self);
+        parse_response (self);
+        g_object_unref (self);
+    }
+}
+
+gboolean
+__qmi_device_handoff_adopt (QmiDevice     *self,
+                            gint           fd,
+                            const guint8  *pending_input,
+                            gsize          pending_input_len,
+                            GError       **error)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+
+    if (qmi_device_is_open (self)) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE,
+                     "Cannot adopt device file: device '%s' already open",
+                     self->priv->path_display);
+        return FALSE;
     }
 
+    /* Input stays paused until __qmi_device_handoff_resume() */
     self->priv->istream = g_unix_input_stream_new  (fd, TRUE);
     self->priv->ostream = g_unix_output_stream_new (fd, TRUE);
-
-    setup_iostream (task);
+    self->priv->buffer = g_byte_array_sized_new (MAX (BUFFER_SIZE, pending_input_len));
+    g_byte_array_append (self->priv->buffer, pending_input, pending_input_len);
+    self->priv->buffer_offset = 0;
+    self->priv->removal_reported = FALSE;
+    if (self->priv->removal_monitor_enabled)
+        removal_monitor_start (self);
+    if (self->priv->suspend_monitor_enabled)
+        suspend_monitor_start (self);
+
+    g_debug ("[%s] device file adopted (%" G_GSIZE_FORMAT " bytes pending)",
+             self->priv->path_display, pending_input_len);
+    return TRUE;
 }
 
-static void create_iostream_with_socket (GTask *task);
+/*****************************************************************************/
+/* Close stream */
 
-static gboolean
-wait_for_proxy_cb (GTask *task)
-{
-    create_iostream_with_socket (task);
-    return FALSE;
-}
+static void suspend_monitor_stop (QmiDevice *self);
 
 static void
-spawn_child_setup (void)
+destroy_iostream (QmiDevice *self)
 {
-    if (setpgid (0, 0) < 0)
-        g_warning ("couldn't setup proxy specific process group");
+    input_source_teardown (self);
+    g_clear_pointer (&self->priv->buffer, g_byte_array_unref);
+    self->priv->buffer_offset = 0;
+    output_queue_clear (self);
+    g_clear_object (&self->priv->istream);
+    g_clear_object (&self->priv->ostream);
+    g_clear_object (&self->priv->socket_connection);
+    g_clear_object (&self->priv->socket_client);
+    self->priv->proxy_remote = FALSE;
+    self->priv->proxy_tls = FALSE;
+    self->priv->proxy_abort_supported = FALSE;
+    self->priv->proxy_indication_filter_supported = FALSE;
+    self->priv->proxy_transactions_supported = FALSE;
+    self->priv->proxy_stats_supported = FALSE;
+    self->priv->proxy_monitor_supported = FALSE;
+    response_cache_clear (self, "device closed");
+    indication_cache_clear (self);
+    __qmi_indication_registrations_clear (self->priv->indication_registrations);
+    removal_monitor_stop (self);
+    suspend_monitor_stop (self);
 }
 
+#if defined MBIM_QMUX_ENABLED
+
 static void
-create_iostream_with_socket (GTask *task)
+mbim_device_close_ready (MbimDevice   *dev,
+                         GAsyncResult *res,
+                         GTask        *task)
 {
-    QmiDevice *self;
-    CreateIostreamContext *ctx;
-    GSocketAddress *socket_address;
     GError *error = NULL;
 
-    self = g_task_get_source_object (task);
-    ctx = g_task_get_task_data (task);
+    if (!mbim_device_close_finish (dev, res, &error))
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+}
 
-    /* Create socket client */
-    self->priv->socket_client = g_socket_client_new ();
-    g_socket_client_set_family (self->priv->socket_client, G_SOCKET_FAMILY_UNIX);
-    g_socket_client_set_socket_type (self->priv->socket_client, G_SOCKET_TYPE_STREAM);
-    g_socket_client_set_protocol (self->priv->socket_client, G_SOCKET_PROTOCOL_DEFAULT);
+#endif
 
-    /* Setup socket address */
-    socket_address = (g_unix_socket_address_new_with_type (
-                          self->priv->proxy_path,
-                          -1,
-                          G_UNIX_SOCKET_ADDRESS_ABSTRACT));
+/* No response will ever be received for the transactions still ongoing, so
+ * they are all completed right away instead of waiting for their timeouts */
+static void
+device_abort_on_close (QmiDevice *self)
+{
+    GError *error;
 
-    /* Connect to address */
-    self->priv->socket_connection = (g_socket_client_connect (
-                                         self->priv->socket_client,
-                                         G_SOCKET_CONNECTABLE (socket_address),
-                                         NULL,
-                                         &error));
-    g_object_unref (socket_address);
+    if (!self->priv->transactions.n_items)
+        return;
 
-    if (!self->priv->socket_connection) {
-        gchar **argc;
-        GSource *source;
+    g_debug ("[%s] Aborting %u pending requests on close",
+             self->priv->path_display, self->priv->transactions.n_items);
 
-        g_debug ("cannot connect to proxy: %s", error->message);
-        g_clear_error (&error);
-        g_clear_object (&self->priv->socket_client);
+    error = g_error_new (QMI_CORE_ERROR,
+                         QMI_CORE_ERROR_WRONG_STATE,
+                         "Device closed");
+    device_abort_all_transactions (self, error);
+    g_error_free (error);
+}
 
-        /* Don't retry forever */
-        ctx->spawn_retries++;
-        if (ctx->spawn_retries > MAX_SPAWN_RETRIES) {
-            g_task_return_new_error (task,
-                                     QMI_CORE_ERROR,
-                                     QMI_CORE_ERROR_FAILED,
-                                     "Couldn't spawn the qmi-proxy");
-            g_object_unref (task);
-            return;
-        }
+gboolean
+qmi_device_close_finish (QmiDevice     *self,
+                         GAsyncResult  *res,
+                         GError       **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
 
-        g_debug ("spawning new qmi-proxy (try %u)...", ctx->spawn_retries);
+void
+qmi_device_close_async (QmiDevice           *self,
+                        guint                timeout,
+                        GCancellable        *cancellable,
+                        GAsyncReadyCallback  callback,
+                        gpointer             user_data)
+{
+    GTask *task;
 
-        argc = g_new0 (gchar *, 2);
-        argc[0] = g_strdup (LIBEXEC_PATH "/qmi-proxy");
-        if (!g_spawn_async (NULL, /* working directory */
-                            argc,
-                            NULL, /* envp */
-                            G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL,
-                            (GSpawnChildSetupFunc) spawn_child_setup,
-                            NULL, /* child_setup_user_data */
-                            NULL,
-                            &error)) {
-            g_debug ("error spawning qmi-proxy: %s", error->message);
-            g_clear_error (&error);
-        }
-        g_strfreev (argc);
+    task = g_task_new (self, cancellable, callback, user_data);
 
-        /* Wait some ms and retry */
-        source = g_timeout_source_new (100);
-        g_source_set_callback (source, (GSourceFunc)wait_for_proxy_cb, task, NULL);
-        g_source_attach (source, g_main_context_get_thread_default ());
-        g_source_unref (source);
+#if defined MBIM_QMUX_ENABLED
+    if (self->priv->mbimdev) {
+        /* Schedule in new main context */
+        mbim_device_close (self->priv->mbimdev,
+                           timeout,
+                           NULL,
+                           (GAsyncReadyCallback) mbim_device_close_ready,
+                           task);
+        /* Cleanup right away, we don't want multiple close attempts on the
+         * device */
+        mbim_device_release (self);
+        device_abort_on_close (self);
         return;
     }
+#endif
 
-    self->priv->istream = g_io_stream_get_input_stream (G_IO_STREAM (self->priv->socket_connection));
-    if (self->priv->istream)
-        g_object_ref (self->priv->istream);
+    io_thread_stop (self);
+#if defined HAVE_LINUX_QRTR_H
+    qrtr_close (self);
+#endif
+    destroy_iostream (self);
+    device_abort_on_close (self);
 
-    self->priv->ostream = g_io_stream_get_output_stream (G_IO_STREAM (self->priv->socket_connection));
-    if (self->priv->ostream)
-        g_object_ref (self->priv->ostream);
+    g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+}
 
-    setup_iostream (task);
+gboolean
+qmi_device_close (QmiDevice *self,
+                  GError **error)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+    qmi_device_close_async (self, 0, NULL, NULL, NULL);
+    return TRUE;
 }
 
+static void transaction_early_error (QmiDevice   *self,
+                                     Transaction *tr,
+                                     gboolean     stored,
+                                     GError      *error);
+
+#if defined MBIM_QMUX_ENABLED
+
+/* Time given to libmbim on top of the transaction timeout, so that our own
+ * timeout management always completes the transaction first */
+#define MBIM_COMMAND_TIMEOUT_GRACE 5
+
+/* Requests are given to libmbim in batches, all the ones sent in the same
+ * main loop iteration back to back, sharing a single completion context */
+typedef struct _MbimBatch MbimBatch;
+
+typedef struct {
+    MbimBatch     *batch;
+    gconstpointer  transaction_key;
+    guint          transaction_generation;
+} MbimBatchEntry;
+
+struct _MbimBatch {
+    QmiDevice      *self;
+    MbimBatchEntry *entries;
+    guint           n_pending;
+};
+
+typedef struct {
+    gconstpointer  transaction_key;
+    guint          transaction_generation;
+} MbimBatchRequest;
+
 static void
-create_iostream (QmiDevice *self,
-                 gboolean proxy,
-                 GAsyncReadyCallback callback,
-                 gpointer user_data)
+mbim_batch_request_free (MbimBatchRequest *request)
 {
-    CreateIostreamContext *ctx;
-    GTask *task;
+    g_slice_free (MbimBatchRequest, request);
+}
 
-    ctx = g_slice_new (CreateIostreamContext);
-    ctx->spawn_retries = 0;
+static void
+mbim_batch_entry_done (MbimBatchEntry *entry)
+{
+    MbimBatch *batch;
 
-    task = g_task_new (self, NULL, callback, user_data);
-    g_task_set_task_data (task,
-                          ctx,
-                          (GDestroyNotify)create_iostream_context_free);
+    batch = entry->batch;
+    g_assert (batch->n_pending > 0);
+    if (--batch->n_pending > 0)
+        return;
 
-    if (self->priv->istream || self->priv->ostream) {
-        g_task_return_new_error (task,
-                                 QMI_CORE_ERROR,
-                                 QMI_CORE_ERROR_WRONG_STATE,
-                                 "Already open");
-        g_object_unref (task);
+    g_object_unref (batch->self);
+    g_free (batch->entries);
+    g_slice_free (MbimBatch, batch);
+}
+
+static void
+mbim_device_command_ready (MbimDevice     *dev,
+                           GAsyncResult   *res,
+                           MbimBatchEntry *ctx)
+{
+    QmiDevice *self;
+    MbimMessage *response;
+    QmiMessage *message;
+    GError *error = NULL;
+    const guint8 *buf;
+    guint32 len;
+    gsize consumed = 0;
+    Transaction *tr;
+
+    self = ctx->batch->self;
+    response = mbim_device_command_finish (dev, res, &error);
+
+    /* The transaction is released right away. It is possible that the
+     * transaction doesn't exist, when it gets cancelled by the user or times
+     * out before the response arrives, or that a newer one got the same key
+     * meanwhile. In such a case, we just return without processing the
+     * response */
+    tr = device_lookup_transaction_generation (self, ctx->transaction_key, ctx->transaction_generation);
+    if (!tr) {
+        g_clear_error (&error);
+        if (response)
+            mbim_message_unref (response);
+        mbim_batch_entry_done (ctx);
         return;
     }
+    device_release_transaction (self, ctx->transaction_key);
 
-    g_assert (self->priv->file);
-    g_assert (self->priv->path);
+    if (!response || !mbim_message_response_get_result (response, MBIM_MESSAGE_TYPE_COMMAND_DONE, &error)) {
+        g_prefix_error (&error, "MBIM error: ");
+        transaction_complete_and_free (tr, NULL, error);
+        g_error_free (error);
+        if (response)
+            mbim_message_unref (response);
+        mbim_batch_entry_done (ctx);
+        return;
+    }
 
-    if (proxy)
-        create_iostream_with_socket (task);
-    else
-        create_iostream_with_fd (task);
+    g_debug ("[%s] Received MBIM message", self->priv->path_display);
+
+    /* The information buffer is expected to be the QMI response of the
+     * transaction, so try to build it directly from there */
+    buf = mbim_message_command_done_get_raw_information_buffer (response, &len);
+    message = __qmi_message_new_from_raw_data (buf, len, &consumed, &error);
+    g_clear_error (&error);
+    if (message &&
+        qmi_message_is_response (message) &&
+        build_transaction_key (message) == ctx->transaction_key) {
+        trace_message (self, message, FALSE, "response", tr->message_context,
+                       g_get_monotonic_time () - tr->sent_time);
+        self->priv->dispatching_response = TRUE;
+        transaction_complete_and_free (tr, message, NULL);
+        self->priv->dispatching_response = FALSE;
+        tr = NULL;
+
+        /* Anything else, processed as if read from a iochannel */
+        buf += consumed;
+        len -= consumed;
+    }
+    if (message)
+        qmi_message_unref (message);
+
+    /* Otherwise, store the raw information buffer in the internal reception
+     * buffer, as if we had read from a iochannel, and parse it as QMI */
+    if (len > 0) {
+        if (!G_UNLIKELY (self->priv->buffer))
+            self->priv->buffer = g_byte_array_sized_new (len);
+        g_byte_array_append (self->priv->buffer, buf, len);
+        parse_response (self);
+    }
+    mbim_message_unref (response);
+
+    /* If the QMI message embedded in MBIM wasn't the proper one, complete the
+     * transaction ourselves, so that it isn't left waiting forever */
+    if (tr) {
+        error = g_error_new (QMI_CORE_ERROR,
+                             QMI_CORE_ERROR_UNEXPECTED_MESSAGE,
+                             "Transaction received unexpected message");
+        transaction_complete_and_free (tr, NULL, error);
+        g_error_free (error);
+    }
+
+    mbim_batch_entry_done (ctx);
 }
 
-/*****************************************************************************/
-/* Open device */
+static gboolean
+mbim_batch_flush (QmiDevice *self)
+{
+    MbimBatch      *batch;
+    MbimBatchEntry  keep_alive;
+    guint           n;
+    guint           i;
 
-typedef enum {
-    DEVICE_OPEN_CONTEXT_STEP_FIRST = 0,
-    DEVICE_OPEN_CONTEXT_STEP_DRIVER,
-#if defined MBIM_QMUX_ENABLED
-    DEVICE_OPEN_CONTEXT_STEP_DEVICE_MBIM,
-    DEVICE_OPEN_CONTEXT_STEP_OPEN_DEVICE_MBIM,
-#endif
-    DEVICE_OPEN_CONTEXT_STEP_CREATE_IOSTREAM,
-    DEVICE_OPEN_CONTEXT_STEP_FLAGS_PROXY,
-    DEVICE_OPEN_CONTEXT_STEP_FLAGS_VERSION_INFO,
-    DEVICE_OPEN_CONTEXT_STEP_FLAGS_SYNC,
-    DEVICE_OPEN_CONTEXT_STEP_FLAGS_NETPORT,
-    DEVICE_OPEN_CONTEXT_STEP_LAST
-} DeviceOpenContextStep;
+    g_clear_pointer (&self->priv->mbim_batch_source, g_source_unref);
 
-typedef struct {
-    DeviceOpenContextStep step;
-    QmiDeviceOpenFlags flags;
-    guint timeout;
-    guint version_check_retries;
-    gchar *driver;
-} DeviceOpenContext;
+    n = g_queue_get_length (&self->priv->mbim_batch);
+    g_debug ("[%s] sending %u message(s) as MBIM...", self->priv->path_display, n);
+
+    batch = g_slice_new0 (MbimBatch);
+    batch->self = g_object_ref (self);
+    batch->entries = g_new (MbimBatchEntry, n);
+
+    /* The batch is kept alive until all commands are sent, even if some of
+     * them complete right away */
+    keep_alive.batch = batch;
+    batch->n_pending = 1;
+
+    for (i = 0; i < n; i++) {
+        MbimBatchRequest *request;
+        MbimMessage      *mbim_message;
+        Transaction      *tr;
+        gconstpointer     raw_message;
+        gsize             raw_message_len;
+        GError           *error = NULL;
+
+        request = g_queue_pop_head (&self->priv->mbim_batch);
+
+        /* The transaction may already be gone, e.g. if cancelled */
+        tr = device_lookup_transaction_generation (self, request->transaction_key, request->transaction_generation);
+        if (!tr) {
+            mbim_batch_request_free (request);
+            continue;
+        }
+
+        if (!self->priv->mbimdev) {
+            transaction_early_error (self, tr, TRUE,
+                                     g_error_new (QMI_CORE_ERROR,
+                                                  QMI_CORE_ERROR_WRONG_STATE,
+                                                  "Device must be open to send commands"));
+            mbim_batch_request_free (request);
+            continue;
+        }
+
+        /* Already validated when the request was issued */
+        raw_message = qmi_message_get_raw (tr->message, &raw_message_len, NULL);
+        g_assert (raw_message);
+
+        mbim_message = mbim_message_qmi_msg_set_new (raw_message_len, raw_message, &error);
+        if (!mbim_message) {
+            g_prefix_error (&error, "Cannot create MBIM command: ");
+            transaction_early_error (self, tr, TRUE, error);
+            mbim_batch_request_free (request);
+            continue;
+        }
+
+        batch->entries[i].batch = batch;
+        batch->entries[i].transaction_key = request->transaction_key;
+        batch->entries[i].transaction_generation = request->transaction_generation;
+        batch->n_pending++;
+
+        /* Cancellation and timeouts are managed with the transaction, if the
+         * transaction is gone by the time the response arrives, it's just
+         * ignored */
+        mbim_device_command (self->priv->mbimdev,
+                             mbim_message,
+                             tr->timeout + MBIM_COMMAND_TIMEOUT_GRACE,
+                             NULL,
+                             (GAsyncReadyCallback) mbim_device_command_ready,
+                             &batch->entries[i]);
+        mbim_message_unref (mbim_message);
+        mbim_batch_request_free (request);
+    }
+
+    mbim_batch_entry_done (&keep_alive);
+    return G_SOURCE_REMOVE;
+}
 
 static void
-device_open_context_free (DeviceOpenContext *ctx)
+mbim_command (QmiDevice   *self,
+              Transaction *tr)
 {
-    g_free (ctx->driver);
-    g_slice_free (DeviceOpenContext, ctx);
+    MbimBatchRequest *request;
+
+    request = g_slice_new (MbimBatchRequest);
+    request->transaction_key = tr->wait_ctx.key;
+    request->transaction_generation = tr->generation;
+    g_queue_push_tail (&self->priv->mbim_batch, request);
+
+    if (self->priv->mbim_batch_source)
+        return;
+
+    self->priv->mbim_batch_source = g_idle_source_new ();
+    g_source_set_callback (self->priv->mbim_batch_source, (GSourceFunc) mbim_batch_flush, self, NULL);
+    g_source_attach (self->priv->mbim_batch_source, device_peek_io_context (self));
 }
 
-gboolean
-qmi_device_open_finish (QmiDevice *self,
-                        GAsyncResult *res,
-                        GError **error)
+static void
+mbim_batch_clear (QmiDevice *self)
 {
-    return g_task_propagate_boolean (G_TASK (res), error);
+    if (self->priv->mbim_batch_source) {
+        g_source_destroy (self->priv->mbim_batch_source);
+        g_clear_pointer (&self->priv->mbim_batch_source, g_source_unref);
+    }
+    while (!g_queue_is_empty (&self->priv->mbim_batch))
+        mbim_batch_request_free (g_queue_pop_head (&self->priv->mbim_batch));
 }
 
-static void device_open_step (GTask *task);
+#endif
+
+#if defined HAVE_LINUX_QRTR_H
 
 static void
-ctl_set_data_format_ready (QmiClientCtl *client,
-                           GAsyncResult *res,
-                           GTask *task)
+qrtr_command (QmiDevice   *self,
+              Transaction *tr)
 {
-    QmiDevice *self;
-    DeviceOpenContext *ctx;
-    QmiMessageCtlSetDataFormatOutput *output = NULL;
     GError *error = NULL;
 
-    output = qmi_client_ctl_set_data_format_finish (client, res, &error);
-    /* Check result of the async operation */
-    if (!output) {
-        g_task_return_error (task, error);
-        g_object_unref (task);
-        return;
-    }
+    if (!__qmi_qrtr_node_send (self->priv->qrtr_node, tr->message, &error))
+        transaction_early_error (self, tr, TRUE, error);
+}
 
-    /* Check result of the QMI operation */
-    if (!qmi_message_ctl_set_data_format_output_get_result (output, &error)) {
-        g_task_return_error (task, error);
-        g_object_unref (task);
-        qmi_message_ctl_set_data_format_output_unref (output);
-        return;
-    }
+#endif
 
-    self = g_task_get_source_object (task);
+/*****************************************************************************/
+/* Command */
 
-    g_debug ("[%s] Network port data format operation finished",
-             self->priv->path_display);
+static gboolean
+device_can_send (QmiDevice  *self,
+                 QmiService  service)
+{
+    if (self->priv->max_in_flight &&
+        self->priv->n_in_flight >= self->priv->max_in_flight)
+        return FALSE;
 
-    qmi_message_ctl_set_data_format_output_unref (output);
+    if (self->priv->max_in_flight_by_service[(guint8) service] &&
+        self->priv->n_in_flight_by_service[(guint8) service] >= self->priv->max_in_flight_by_service[(guint8) service])
+        return FALSE;
 
-    /* Go on */
-    ctx = g_task_get_task_data (task);
-    ctx->step++;
-    device_open_step (task);
+    return TRUE;
 }
 
+/* The transaction must have been stored already */
 static void
-sync_ready (QmiClientCtl *client_ctl,
-            GAsyncResult *res,
-            GTask *task)
+device_send_transaction (QmiDevice   *self,
+                         Transaction *tr)
 {
-    QmiDevice *self;
-    DeviceOpenContext *ctx;
-    GError *error = NULL;
-    QmiMessageCtlSyncOutput *output;
+    guint8 service;
 
-    /* Check result of the async operation */
-    output = qmi_client_ctl_sync_finish (client_ctl, res, &error);
-    if(!output) {
-        g_task_return_error (task, error);
-        g_object_unref (task);
+    /* Device may have been closed while the transaction was waiting */
+    if (!device_transport_ready (self)) {
+        transaction_early_error (self, tr, TRUE,
+                                 g_error_new (QMI_CORE_ERROR,
+                                              QMI_CORE_ERROR_WRONG_STATE,
+                                              "Device must be open to send commands"));
         return;
     }
 
-    /* Check result of the QMI operation */
-    if (!qmi_message_ctl_sync_output_get_result (output, &error)) {
-        g_task_return_error (task, error);
-        g_object_unref (task);
-        qmi_message_ctl_sync_output_unref (output);
+    service = (guint8) qmi_message_get_service (tr->message);
+    tr->in_flight = TRUE;
+    self->priv->n_in_flight++;
+    self->priv->n_in_flight_by_service[service]++;
+    device_stats_update_lengths (self);
+
+    tr->sent_time = g_get_monotonic_time ();
+    trace_message (self, tr->message, TRUE, "request", tr->message_context, -1);
+    QMI_PROBE_MESSAGE (command_send, tr->message);
+
+    if (self->priv->n_in_flight == 1)
+        health_check_activity (self, TRUE);
+
+#if defined MBIM_QMUX_ENABLED
+    if (self->priv->mbimdev) {
+        mbim_command (self, tr);
         return;
     }
+#endif
 
-    self = g_task_get_source_object (task);
-    g_debug ("[%s] Sync operation finished",
-             self->priv->path_display);
-
-    qmi_message_ctl_sync_output_unref (output);
+#if defined HAVE_LINUX_QRTR_H
+    if (self->priv->qrtr_node && __qmi_qrtr_node_is_open (self->priv->qrtr_node)) {
+        qrtr_command (self, tr);
+        return;
+    }
+#endif
 
-    /* Go on */
-    ctx = g_task_get_task_data (task);
-    ctx->step++;
-    device_open_step (task);
+    /* Queue the message, it will be written without blocking as soon as the
+     * stream allows it */
+    output_queue_push (self, tr->message, tr->priority);
 }
 
 static void
-open_version_info_ready (QmiClientCtl *client_ctl,
-                         GAsyncResult *res,
-                         GTask *task)
+throttled_transactions_insert (QmiDevice   *self,
+                               Transaction *tr)
 {
-    QmiDevice *self;
-    DeviceOpenContext *ctx;
-    GArray *service_list;
-    QmiMessageCtlGetVersionInfoOutput *output;
-    GError *error = NULL;
-    guint i;
+    GList *l;
 
-    self = g_task_get_source_object (task);
-    ctx = g_task_get_task_data (task);
+    /* Queue after the last transaction with the same or higher priority */
+    for (l = g_queue_peek_tail_link (self->priv->throttled_transactions); l; l = g_list_previous (l)) {
+        if (((Transaction *) l->data)->priority >= tr->priority)
+            break;
+    }
+    if (l) {
+        g_queue_insert_after (self->priv->throttled_transactions, l, tr);
+        tr->throttled_link = g_list_next (l);
+    } else {
+        g_queue_push_head (self->priv->throttled_transactions, tr);
+        tr->throttled_link = g_queue_peek_head_link (self->priv->throttled_transactions);
+    }
+    device_stats_update_lengths (self);
+}
 
-    /* Check result of the async operation */
-    output = qmi_client_ctl_get_version_info_finish (client_ctl, res, &error);
-    if (!output) {
-        if (g_error_matches (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TIMEOUT)) {
-            /* Update retries... */
-            ctx->version_check_retries--;
-            /* If retries left, retry */
-            if (ctx->version_check_retries > 0) {
-                g_error_free (error);
-                qmi_client_ctl_get_version_info (self->priv->client_ctl,
-                                                 NULL,
-                                                 1,
-                                                 g_task_get_cancellable (task),
-                                                 (GAsyncReadyCallback)open_version_info_ready,
-                                                 task);
-                return;
-            }
+/* Requests only wait if the limits are reached for their service, or to keep
+ * the order with the ones already waiting: those for the same service, and
+ * those with the same or higher priority that could be sent as well */
+static gboolean
+device_must_wait (QmiDevice   *self,
+                  Transaction *tr)
+{
+    QmiService  service;
+    GList      *l;
 
-            /* Otherwise, propagate the error */
-        }
+    service = qmi_message_get_service (tr->message);
+    if (!device_can_send (self, service))
+        return TRUE;
 
-        g_task_return_error (task, error);
-        g_object_unref (task);
-        return;
-    }
+    for (l = g_queue_peek_head_link (self->priv->throttled_transactions); l; l = g_list_next (l)) {
+        Transaction *waiting;
+        QmiService   waiting_service;
 
-    /* Check result of the QMI operation */
-    if (!qmi_message_ctl_get_version_info_output_get_result (output, &error)) {
-        g_task_return_error (task, error);
-        g_object_unref (task);
-        qmi_message_ctl_get_version_info_output_unref (output);
-        return;
+        waiting = (Transaction *) l->data;
+        if (waiting->priority < tr->priority)
+            break;
+        waiting_service = qmi_message_get_service (waiting->message);
+        if (waiting_service == service || device_can_send (self, waiting_service))
+            return TRUE;
     }
 
-    /* QMI operation succeeded, we can now get the outputs */
-    service_list = NULL;
-    qmi_message_ctl_get_version_info_output_get_service_list (output,
-                                                              &service_list,
-                                                              NULL);
-    self->priv->supported_services = g_array_ref (service_list);
+    return FALSE;
+}
 
-    g_debug ("[%s] QMI Device supports %u services:",
-             self->priv->path_display,
-             self->priv->supported_services->len);
-    for (i = 0; i < self->priv->supported_services->len; i++) {
-        QmiMessageCtlGetVersionInfoOutputServiceListService *info;
-        const gchar *service_str;
+static gboolean
+throttled_cb (QmiDevice *self)
+{
+    GList *l;
 
-        info = &g_array_index (self->priv->supported_services,
-                               QmiMessageCtlGetVersionInfoOutputServiceListService,
-                               i);
-        service_str = qmi_service_get_string (info->service);
-        if (service_str)
-            g_debug ("[%s]    %s (%u.%u)",
-                     self->priv->path_display,
-                     service_str,
-                     info->major_version,
-                     info->minor_version);
-        else
-            g_debug ("[%s]    unknown [0x%02x] (%u.%u)",
-                     self->priv->path_display,
-                     info->service,
-                     info->major_version,
-                     info->minor_version);
+    g_clear_pointer (&self->priv->throttled_source, g_source_unref);
+
+    /* Send as many waiting transactions as the limits allow, in priority
+     * order */
+    l = g_queue_peek_head_link (self->priv->throttled_transactions);
+    while (l && (!self->priv->max_in_flight || self->priv->n_in_flight < self->priv->max_in_flight)) {
+        Transaction *tr;
+        GList       *next;
+
+        next = g_list_next (l);
+        tr = (Transaction *) l->data;
+        if (device_can_send (self, qmi_message_get_service (tr->message))) {
+            g_queue_delete_link (self->priv->throttled_transactions, l);
+            tr->throttled_link = NULL;
+            device_stats_update_lengths (self);
+            device_send_transaction (self, tr);
+            /* Sending may have completed other transactions, restart */
+            next = g_queue_peek_head_link (self->priv->throttled_transactions);
+        }
+        l = next;
     }
 
-    qmi_message_ctl_get_version_info_output_unref (output);
+    return G_SOURCE_REMOVE;
+}
 
-    /* Go on */
-    ctx->step++;
-    device_open_step (task);
+static void
+device_schedule_throttled (QmiDevice *self)
+{
+    /* Not done right away, as we may be in the middle of completing a
+     * transaction */
+    if (self->priv->throttled_source)
+        return;
+
+    self->priv->throttled_source = g_idle_source_new ();
+    g_source_set_callback (self->priv->throttled_source, (GSourceFunc)throttled_cb, self, NULL);
+    g_source_attach (self->priv->throttled_source, device_peek_io_context (self));
+}
+
+static gboolean
+schedule_throttled_in_io_context (QmiDevice *self)
+{
+    if (!g_queue_is_empty (self->priv->throttled_transactions))
+        device_schedule_throttled (self);
+    return G_SOURCE_REMOVE;
 }
 
+/* The throttled transactions are owned by the I/O context, so they're
+ * rescheduled from there when a limit changes */
 static void
-internal_proxy_open_ready (QmiClientCtl *client_ctl,
-                           GAsyncResult *res,
-                           GTask *task)
+device_max_in_flight_changed (QmiDevice *self)
 {
-    DeviceOpenContext *ctx;
-    QmiMessageCtlInternalProxyOpenOutput *output;
-    GError *error = NULL;
+    /* Limit may have been increased */
+    if (self->priv->io_context && !g_main_context_is_owner (self->priv->io_context)) {
+        GSource *source;
 
-    /* Check result of the async operation */
-    output = qmi_client_ctl_internal_proxy_open_finish (client_ctl, res, &error);
-    if (!output) {
-        g_task_return_error (task, error);
-        g_object_unref (task);
+        source = g_idle_source_new ();
+        g_source_set_callback (source,
+                               (GSourceFunc)schedule_throttled_in_io_context,
+                               g_object_ref (self),
+                               (GDestroyNotify)g_object_unref);
+        g_source_attach (source, self->priv->io_context);
+        g_source_unref (source);
         return;
     }
 
-    /* Check result of the QMI operation */
-    if (!qmi_message_ctl_internal_proxy_open_output_get_result (output, &error)) {
-        g_task_return_error (task, error);
-        g_object_unref (task);
-        qmi_message_ctl_internal_proxy_open_output_unref (output);
-        return;
-    }
+    if (!g_queue_is_empty (self->priv->throttled_transactions))
+        device_schedule_throttled (self);
+}
 
-    qmi_message_ctl_internal_proxy_open_output_unref (output);
+void
+qmi_device_set_service_max_in_flight (QmiDevice  *self,
+                                      QmiService  service,
+                                      guint       max_in_flight)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail ((guint) service <= G_MAXUINT8);
+
+    self->priv->max_in_flight_by_service[(guint8) service] = max_in_flight;
+    device_max_in_flight_changed (self);
+}
+
+void
+qmi_device_get_stats (QmiDevice      *self,
+                      QmiDeviceStats *stats)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (stats != NULL);
+
+    g_mutex_lock (&self->priv->stats_lock);
+    *stats = self->priv->stats;
+    g_mutex_unlock (&self->priv->stats_lock);
+
+    /* The queues are owned by the I/O context, so only their snapshots are
+     * read here; the pending indications have their own lock */
+    stats->n_in_flight = (guint) g_atomic_int_get (&self->priv->stats_n_in_flight);
+    stats->output_queue_length = (guint) g_atomic_int_get (&self->priv->stats_output_queue_length);
+    stats->throttled_queue_length = (guint) g_atomic_int_get (&self->priv->stats_throttled_queue_length);
+    stats->pending_indications_length = pending_indications_get_length (self);
+}
+
+GArray *
+qmi_device_get_message_stats (QmiDevice *self)
+{
+    GArray                *array;
+    GHashTableIter         iter;
+    QmiDeviceMessageStats *message_stats;
+
+    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
+
+    g_mutex_lock (&self->priv->stats_lock);
+    array = g_array_sized_new (FALSE, FALSE, sizeof (QmiDeviceMessageStats),
+                               g_hash_table_size (self->priv->message_stats));
+    g_hash_table_iter_init (&iter, self->priv->message_stats);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&message_stats))
+        g_array_append_vals (array, message_stats, 1);
+    g_mutex_unlock (&self->priv->stats_lock);
+
+    return array;
+}
+
+void
+qmi_device_reset_stats (QmiDevice *self)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+
+    g_mutex_lock (&self->priv->stats_lock);
+    memset (&self->priv->stats, 0, sizeof (QmiDeviceStats));
+    self->priv->stats.since = g_get_monotonic_time ();
+    g_hash_table_remove_all (self->priv->message_stats);
+    g_mutex_unlock (&self->priv->stats_lock);
+}
+
+/*****************************************************************************/
+
+void
+qmi_device_set_adaptive_timeout_params (QmiDevice *self,
+                                        gdouble    multiplier,
+                                        guint      min_timeout,
+                                        guint      max_timeout)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (multiplier >= 1.0);
+    g_return_if_fail (!max_timeout || min_timeout <= max_timeout);
+
+    g_mutex_lock (&self->priv->stats_lock);
+    self->priv->adaptive_timeout_multiplier = multiplier;
+    self->priv->adaptive_timeout_min = min_timeout;
+    self->priv->adaptive_timeout_max = max_timeout;
+    g_mutex_unlock (&self->priv->stats_lock);
+}
+
+void
+qmi_device_set_offloaded_message (QmiDevice  *self,
+                                  QmiService  service,
+                                  guint16     message_id,
+                                  gboolean    offloaded)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+
+    g_mutex_lock (&self->priv->stats_lock);
+    if (offloaded)
+        g_hash_table_add (self->priv->offloaded_messages, MESSAGE_STATS_KEY (service, message_id));
+    else
+        g_hash_table_remove (self->priv->offloaded_messages, MESSAGE_STATS_KEY (service, message_id));
+    g_atomic_int_set (&self->priv->n_offloaded_messages, g_hash_table_size (self->priv->offloaded_messages));
+    g_mutex_unlock (&self->priv->stats_lock);
+}
+
+gboolean
+__qmi_device_get_response_offload (QmiDevice  *self,
+                                   QmiMessage *response)
+{
+    guint    threshold;
+    gboolean offload = FALSE;
+
+    threshold = (guint) g_atomic_int_get (&self->priv->offload_threshold);
+    if (threshold && qmi_message_get_length (response) >= threshold)
+        offload = TRUE;
+
+    g_mutex_lock (&self->priv->stats_lock);
+    if (!offload && g_atomic_int_get (&self->priv->n_offloaded_messages))
+        offload = g_hash_table_contains (self->priv->offloaded_messages,
+                                         MESSAGE_STATS_KEY (qmi_message_get_service (response),
+                                                            qmi_message_get_message_id (response)));
+    if (offload)
+        self->priv->stats.n_offloaded++;
+    g_mutex_unlock (&self->priv->stats_lock);
+
+    return offload;
+}
+
+void
+qmi_device_set_health_check_params (QmiDevice *self,
+                                    guint      idle_timeout,
+                                    guint      stall_timeout,
+                                    guint      ping_timeout)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (ping_timeout > 0);
 
-    /* Go on */
-    ctx = g_task_get_task_data (task);
-    ctx->step++;
-    device_open_step (task);
+    g_mutex_lock (&self->priv->stats_lock);
+    self->priv->health_check_idle_timeout = idle_timeout;
+    self->priv->health_check_stall_timeout = stall_timeout;
+    self->priv->health_check_ping_timeout = ping_timeout;
+    g_mutex_unlock (&self->priv->stats_lock);
 }
 
-static void
-create_iostream_ready (QmiDevice *self,
-                       GAsyncResult *res,
-                       GTask *task)
+guint
+qmi_device_get_adaptive_timeout (QmiDevice  *self,
+                                 QmiService  service,
+                                 guint16     message_id)
 {
-    DeviceOpenContext *ctx;
-    GError *error = NULL;
+    AdaptiveTimeout *adaptive;
+    guint            timeout = 0;
 
-    if (!create_iostream_finish (self, res, &error)) {
-        g_task_return_error (task, error);
-        g_object_unref (task);
-        return;
+    g_return_val_if_fail (QMI_IS_DEVICE (self), 0);
+
+    g_mutex_lock (&self->priv->stats_lock);
+    adaptive = g_hash_table_lookup (self->priv->adaptive_timeouts, MESSAGE_STATS_KEY (service, message_id));
+    if (adaptive && adaptive->timeout) {
+        timeout = MAX (adaptive->timeout, self->priv->adaptive_timeout_min);
+        if (self->priv->adaptive_timeout_max)
+            timeout = MIN (timeout, self->priv->adaptive_timeout_max);
     }
+    g_mutex_unlock (&self->priv->stats_lock);
 
-    /* Go on */
-    ctx = g_task_get_task_data (task);
-    ctx->step++;
-    device_open_step (task);
+    return timeout;
 }
 
-#if defined MBIM_QMUX_ENABLED
+typedef struct {
+    QmiDevice        *self;
+    QmiDeviceTraceFn  trace_func;
+    gpointer          user_data;
+    GDestroyNotify    user_data_free;
+} TraceFuncUpdate;
 
 static void
-mbim_device_open_ready (MbimDevice *dev,
-                        GAsyncResult *res,
-                        GTask *task)
+trace_func_update_free (TraceFuncUpdate *update)
 {
-    QmiDevice *self;
-    DeviceOpenContext *ctx;
-    GError *error = NULL;
-
-    if (!mbim_device_open_finish (dev, res, &error)) {
-        g_task_return_error (task, error);
-        g_object_unref (task);
-        return;
-    }
-
-    self = g_task_get_source_object (task);
-    g_debug ("[%s] MBIM device open", self->priv->path_display);
-
-    /* Go on */
-    ctx = g_task_get_task_data (task);
-    ctx->step++;
-    device_open_step (task);
+    g_object_unref (update->self);
+    g_slice_free (TraceFuncUpdate, update);
 }
 
 static void
-open_mbim_device (GTask *task)
+device_trace_func_swap (QmiDevice        *self,
+                        QmiDeviceTraceFn  trace_func,
+                        gpointer          user_data,
+                        GDestroyNotify    user_data_free)
 {
-    QmiDevice *self;
-    DeviceOpenContext *ctx;
-    MbimDeviceOpenFlags open_flags = MBIM_DEVICE_OPEN_FLAGS_NONE;
+    if (self->priv->trace_func_user_data_free)
+        self->priv->trace_func_user_data_free (self->priv->trace_func_user_data);
 
-    self = g_task_get_source_object (task);
-    ctx = g_task_get_task_data (task);
-
-    /* If QMI proxy was requested, use MBIM proxy instead */
-    if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_PROXY)
-        open_flags |= MBIM_DEVICE_OPEN_FLAGS_PROXY;
+    self->priv->trace_func = trace_func;
+    self->priv->trace_func_user_data = user_data;
+    self->priv->trace_func_user_data_free = user_data_free;
+}
 
-    /* We pass the original timeout of the request to the open operation */
-    g_debug ("[%s] opening MBIM device...", self->priv->path_display);
-    mbim_device_open_full (self->priv->mbimdev,
-                           open_flags,
-                           ctx->timeout,
-                           g_task_get_cancellable (task),
-                           (GAsyncReadyCallback) mbim_device_open_ready,
-                           task);
+static gboolean
+trace_func_update_in_io_context (TraceFuncUpdate *update)
+{
+    device_trace_func_swap (update->self, update->trace_func, update->user_data, update->user_data_free);
+    return G_SOURCE_REMOVE;
 }
 
-static void
-mbim_device_new_ready (GObject *source,
-                       GAsyncResult *res,
-                       GTask *task)
+void
+qmi_device_set_trace_func (QmiDevice        *self,
+                           QmiDeviceTraceFn  trace_func,
+                           gpointer          user_data,
+                           GDestroyNotify    user_data_free)
 {
-    QmiDevice *self;
-    DeviceOpenContext *ctx;
-    GError *error = NULL;
+    TraceFuncUpdate *update;
+    GSource         *source;
 
-    self = g_task_get_source_object (task);
-    self->priv->mbimdev = mbim_device_new_finish (res, &error);
-    if (!self->priv->mbimdev) {
-        g_task_return_error (task, error);
-        g_object_unref (task);
+    g_return_if_fail (QMI_IS_DEVICE (self));
+
+    if (!self->priv->io_context || g_main_context_is_owner (self->priv->io_context)) {
+        device_trace_func_swap (self, trace_func, user_data, user_data_free);
         return;
     }
 
-    g_debug ("[%s] MBIM device created", self->priv->path_display);
+    /* The trace function is called from the I/O thread, so it's only
+     * replaced, and the old user data freed, from there */
+    update = g_slice_new (TraceFuncUpdate);
+    update->self = g_object_ref (self);
+    update->trace_func = trace_func;
+    update->user_data = user_data;
+    update->user_data_free = user_data_free;
 
-    /* Go on */
-    ctx = g_task_get_task_data (task);
-    ctx->step++;
-    device_open_step (task);
+    source = g_idle_source_new ();
+    g_source_set_callback (source,
+                           (GSourceFunc)trace_func_update_in_io_context,
+                           update,
+                           (GDestroyNotify)trace_func_update_free);
+    g_source_attach (source, self->priv->io_context);
+    g_source_unref (source);
 }
 
-static void
-create_mbim_device (GTask *task)
-{
-    QmiDevice *self;
-    GFile *file;
+/*****************************************************************************/
+/* External event loop integration */
 
-    self = g_task_get_source_object (task);
-    if (self->priv->mbimdev) {
-        g_task_return_new_error (task,
-                                 QMI_CORE_ERROR,
-                                 QMI_CORE_ERROR_WRONG_STATE,
-                                 "Already open");
-        g_object_unref (task);
-        return;
+gint
+qmi_device_query (QmiDevice *self,
+                  GPollFD   *fds,
+                  gint       n_fds,
+                  gint64    *out_deadline)
+{
+    gint     timeout = -1;
+    gint     n_required;
+    gboolean ready;
+
+    g_return_val_if_fail (QMI_IS_DEVICE (self), 0);
+    g_return_val_if_fail (fds != NULL || n_fds == 0, 0);
+    g_return_val_if_fail (out_deadline != NULL, 0);
+
+    /* Kept until dispatched, also if queried again with a bigger array */
+    if (!self->priv->context_acquired) {
+        if (!g_main_context_acquire (self->priv->context)) {
+            g_warning ("[%s] couldn't acquire the device context: already owned by another thread",
+                       self->priv->path_display);
+            *out_deadline = -1;
+            return 0;
+        }
+        self->priv->context_acquired = TRUE;
     }
 
-    g_debug ("[%s] creating MBIM device...", self->priv->path_display);
-    file = g_file_new_for_path (self->priv->path);
-    mbim_device_new (file,
-                     g_task_get_cancellable (task),
-                     (GAsyncReadyCallback) mbim_device_new_ready,
-                     task);
-    g_object_unref (file);
-}
+    ready = g_main_context_prepare (self->priv->context, &self->priv->context_max_priority);
+    n_required = g_main_context_query (self->priv->context,
+                                       self->priv->context_max_priority,
+                                       &timeout,
+                                       fds,
+                                       n_fds);
 
-#endif
+    /* Sources already ready need to be dispatched right away */
+    if (ready)
+        timeout = 0;
 
-#define NETPORT_FLAGS (QMI_DEVICE_OPEN_FLAGS_NET_802_3 | \
-                       QMI_DEVICE_OPEN_FLAGS_NET_RAW_IP | \
-                       QMI_DEVICE_OPEN_FLAGS_NET_QOS_HEADER | \
-                       QMI_DEVICE_OPEN_FLAGS_NET_NO_QOS_HEADER)
+    *out_deadline = (timeout < 0 ? -1 : g_get_monotonic_time () + (gint64) timeout * 1000);
+    return n_required;
+}
 
-static void
-device_open_step (GTask *task)
+void
+qmi_device_dispatch (QmiDevice     *self,
+                     const GPollFD *fds,
+                     gint           n_fds)
 {
-    QmiDevice *self;
-    DeviceOpenContext *ctx;
+    GMainContext *context;
 
-    self = g_task_get_source_object (task);
-    ctx = g_task_get_task_data (task);
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (self->priv->context_acquired);
 
-    switch (ctx->step) {
-    case DEVICE_OPEN_CONTEXT_STEP_FIRST:
-        ctx->step++;
-        /* Fall down */
+    /* The device may be disposed by any of the callbacks */
+    context = g_main_context_ref (self->priv->context);
+    self->priv->context_acquired = FALSE;
 
-    case DEVICE_OPEN_CONTEXT_STEP_DRIVER:
-        ctx->driver = __qmi_utils_get_driver (self->priv->path);
-        if (ctx->driver)
-            g_debug ("[%s] loaded driver of cdc-wdm port: %s", self->priv->path_display, ctx->driver);
-        else if (!self->priv->no_file_check)
-            g_warning ("[%s] couldn't load driver of cdc-wdm port", self->priv->path_display);
+    if (g_main_context_check (context, self->priv->context_max_priority, (GPollFD *) fds, n_fds))
+        g_main_context_dispatch (context);
 
-#if defined MBIM_QMUX_ENABLED
+    g_main_context_release (context);
+    g_main_context_unref (context);
+}
 
-        /* Auto mode requested? */
-        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_AUTO) {
-            if (!g_strcmp0 (ctx->driver, "cdc_mbim")) {
-                g_debug ("[%s] automatically selecting MBIM mode", self->priv->path_display);
-                ctx->flags |= QMI_DEVICE_OPEN_FLAGS_MBIM;
-                goto next_step;
-            }
-            if (!g_strcmp0 (ctx->driver, "qmi_wwan")) {
-                g_debug ("[%s] automatically selecting QMI mode", self->priv->path_display);
-                ctx->flags &= ~QMI_DEVICE_OPEN_FLAGS_MBIM;
-                goto next_step;
-            }
-            g_task_return_new_error (task,
-                                     QMI_CORE_ERROR,
-                                     QMI_CORE_ERROR_FAILED,
-                                     "Cannot automatically select QMI/MBIM mode: driver %s",
-                                     ctx->driver ? ctx->driver : "unknown");
-            g_object_unref (task);
-            return;
-        }
+QmiMessage *
+qmi_device_command_full_finish (QmiDevice     *self,
+                                GAsyncResult  *res,
+                                GError       **error)
+{
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
 
-        /* MBIM mode requested? */
-        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_MBIM) {
-            if (g_strcmp0 (ctx->driver, "cdc_mbim") && !self->priv->no_file_check)
-                g_warning ("[%s] requested MBIM mode but unexpected driver found: %s", self->priv->path_display, ctx->driver);
-            goto next_step;
-        }
+static void
+transaction_early_error (QmiDevice   *self,
+                         Transaction *tr,
+                         gboolean     stored,
+                         GError      *error)
+{
+    g_assert (error);
 
-#else
-        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_AUTO)
-            g_warning ("[%s] requested auto mode but no MBIM QMUX support available", self->priv->path_display);
-        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_MBIM)
-            g_warning ("[%s] requested MBIM mode but no MBIM QMUX support available", self->priv->path_display);
+    if (stored) {
+        /* Match transaction so that we remove it from our tracking table */
+        tr = device_match_transaction (self, tr->message);
+        g_assert (tr);
+    }
+    transaction_complete_and_free (tr, NULL, error);
+    g_error_free (error);
+}
 
-#endif /* MBIM_QMUX_ENABLED */
+/* Takes ownership of the task; either a task or a sync context is given, or
+ * none if the result is not reported */
+static void
+device_command (QmiDevice          *self,
+                QmiMessage         *message,
+                QmiMessageContext  *message_context,
+                guint               timeout,
+                GCancellable       *cancellable,
+                GTask              *task,
+                CommandSyncContext *sync_ctx)
+{
+    GError *error = NULL;
+    Transaction *tr;
+    gconstpointer raw_message;
+    gsize raw_message_len;
+    GBytes *coalesce_key = NULL;
 
-        /* QMI mode requested? */
-        if (g_strcmp0 (ctx->driver, "qmi_wwan") && !self->priv->no_file_check)
-            g_warning ("[%s] requested QMI mode but unexpected driver found: %s",
-                       self->priv->path_display, ctx->driver ? ctx->driver : "unknown");
+    tr = transaction_new (self, message, message_context, cancellable, task, sync_ctx);
+    tr->no_reply = (!task && !sync_ctx);
 
-#if defined MBIM_QMUX_ENABLED
-    next_step:
-#endif
-        ctx->step++;
-        /* Fall down */
+    /* Device must be open */
+    if (!device_transport_ready (self)) {
+        error = g_error_new (QMI_CORE_ERROR,
+                             QMI_CORE_ERROR_WRONG_STATE,
+                             "Device must be open to send commands");
+        transaction_early_error (self, tr, FALSE, error);
+        return;
+    }
 
-#if defined MBIM_QMUX_ENABLED
-    case DEVICE_OPEN_CONTEXT_STEP_DEVICE_MBIM:
-        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_MBIM) {
-            create_mbim_device (task);
-            return;
-        }
-        ctx->step++;
-        /* Fall down */
+    /* Non-CTL services should use a proper CID */
+    if (qmi_message_get_service (message) != QMI_SERVICE_CTL &&
+        qmi_message_get_client_id (message) == 0) {
+        error = g_error_new (QMI_CORE_ERROR,
+                             QMI_CORE_ERROR_FAILED,
+                             "Cannot send message in service '%s' without a CID",
+                             qmi_service_get_string (qmi_message_get_service (message)));
+        transaction_early_error (self, tr, FALSE, error);
+        return;
+    }
 
-    case DEVICE_OPEN_CONTEXT_STEP_OPEN_DEVICE_MBIM:
-        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_MBIM) {
-            open_mbim_device (task);
-            return;
-        }
-        ctx->step++;
-        /* Fall down */
-#endif
+    /* Check if the message to be sent is supported by the device
+     * (only applicable if we did version info check when opening) */
+    if (!check_message_supported (self, message, message_context, &error)) {
+        g_prefix_error (&error, "Cannot send message: ");
+        transaction_early_error (self, tr, FALSE, error);
+        return;
+    }
 
-    case DEVICE_OPEN_CONTEXT_STEP_CREATE_IOSTREAM:
-        if (!(ctx->flags & QMI_DEVICE_OPEN_FLAGS_MBIM)) {
-            create_iostream (self,
-                             !!(ctx->flags & QMI_DEVICE_OPEN_FLAGS_PROXY),
-                             (GAsyncReadyCallback)create_iostream_ready,
-                             task);
-            return;
+    /* Get raw message */
+    raw_message = qmi_message_get_raw (message, &raw_message_len, &error);
+    if (!raw_message) {
+        g_prefix_error (&error, "Cannot get raw message: ");
+        transaction_early_error (self, tr, FALSE, error);
+        return;
+    }
+
+    /* Requests changing the device state invalidate the cached responses;
+     * otherwise the response may already be cached */
+    response_cache_check_request (self, message);
+    if (self->priv->response_cache_enabled && !tr->no_reply) {
+        tr->cache_ttl = __qmi_message_get_cache_ttl (message, message_context);
+        if (tr->cache_ttl) {
+            QmiMessage *cached;
+
+            cached = response_cache_lookup (self, tr);
+            if (cached) {
+                g_debug ("[%s] Request answered from the response cache", self->priv->path_display);
+                g_mutex_lock (&self->priv->stats_lock);
+                self->priv->stats.n_cached++;
+                g_mutex_unlock (&self->priv->stats_lock);
+
+                tr->not_sent = TRUE;
+                transaction_complete_and_free (tr, cached, NULL);
+                qmi_message_unref (cached);
+                return;
+            }
         }
-        ctx->step++;
-        /* Fall down */
+    }
 
-    case DEVICE_OPEN_CONTEXT_STEP_FLAGS_PROXY:
-        /* Initialize communication with proxy? */
-        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_PROXY && !(ctx->flags & QMI_DEVICE_OPEN_FLAGS_MBIM)) {
-            QmiMessageCtlInternalProxyOpenInput *input;
+    /* If an identical idempotent request is already ongoing, don't send a
+     * new one, just wait for its response. The coalesced transaction is still
+     * stored with its own key, so that its own timeout and cancellation
+     * apply. */
+    if (self->priv->coalesce_requests && !tr->no_reply && __qmi_message_is_idempotent (message, message_context)) {
+        Transaction *leader;
+
+        coalesce_key = build_contents_key (message, message_context);
+        leader = g_hash_table_lookup (self->priv->coalesced_transactions, coalesce_key);
+        if (leader) {
+            g_bytes_unref (coalesce_key);
+
+            tr->not_sent = TRUE;
+            if (!device_store_transaction (self, tr, timeout, &error)) {
+                g_prefix_error (&error, "Cannot store transaction: ");
+                transaction_early_error (self, tr, FALSE, error);
+                return;
+            }
+            tr->timeout = timeout;
+            tr->coalesce_leader = leader;
+            leader->followers = g_slist_prepend (leader->followers, tr);
 
-            input = qmi_message_ctl_internal_proxy_open_input_new ();
-            qmi_message_ctl_internal_proxy_open_input_set_device_path (input, self->priv->path, NULL);
-            qmi_client_ctl_internal_proxy_open (self->priv->client_ctl,
-                                                input,
-                                                5,
-                                                g_task_get_cancellable (task),
-                                                (GAsyncReadyCallback)internal_proxy_open_ready,
-                                                task);
-            qmi_message_ctl_internal_proxy_open_input_unref (input);
+            g_mutex_lock (&self->priv->stats_lock);
+            self->priv->stats.n_coalesced++;
+            g_mutex_unlock (&self->priv->stats_lock);
             return;
         }
-        ctx->step++;
-        /* Fall down */
+    }
 
-    case DEVICE_OPEN_CONTEXT_STEP_FLAGS_VERSION_INFO:
-        /* Query version info? */
-        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_VERSION_INFO) {
-            /* Setup how many times to retry... We'll retry once per second */
-            ctx->version_check_retries = ctx->timeout > 0 ? ctx->timeout : 1;
-            g_debug ("[%s] Checking version info (%u retries)...",
-                     self->priv->path_display,
-                     ctx->version_check_retries);
-            qmi_client_ctl_get_version_info (self->priv->client_ctl,
-                                             NULL,
-                                             1,
-                                             g_task_get_cancellable (task),
-                                             (GAsyncReadyCallback)open_version_info_ready,
-                                             task);
-            return;
-        }
-        ctx->step++;
-        /* Fall down */
+    /* Backpressure: if the device isn't able to cope with the rate of
+     * requests, don't keep on queueing more */
+    if (g_queue_get_length (self->priv->output_queue) >= OUTPUT_QUEUE_MAX_LENGTH) {
+        error = g_error_new (QMI_CORE_ERROR,
+                             QMI_CORE_ERROR_WRONG_STATE,
+                             "Cannot send message: too many requests waiting to be written");
+        if (coalesce_key)
+            g_bytes_unref (coalesce_key);
+        transaction_early_error (self, tr, FALSE, error);
+        return;
+    }
 
-    case DEVICE_OPEN_CONTEXT_STEP_FLAGS_SYNC:
-        /* Sync? */
-        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_SYNC) {
-            g_debug ("[%s] Running sync...",
-                     self->priv->path_display);
-            qmi_client_ctl_sync (self->priv->client_ctl,
-                                 NULL,
-                                 ctx->timeout,
-                                 g_task_get_cancellable (task),
-                                 (GAsyncReadyCallback)sync_ready,
-                                 task);
-            return;
-        }
-        ctx->step++;
-        /* Fall down */
+    /* Setup context to match response */
+    if (!device_store_transaction (self, tr, timeout, &error)) {
+        g_prefix_error (&error, "Cannot store transaction: ");
+        if (coalesce_key)
+            g_bytes_unref (coalesce_key);
+        transaction_early_error (self, tr, FALSE, error);
+        return;
+    }
 
-    case DEVICE_OPEN_CONTEXT_STEP_FLAGS_NETPORT:
-        /* Network port setup */
-        if (ctx->flags & NETPORT_FLAGS) {
-            QmiMessageCtlSetDataFormatInput *input;
-            QmiCtlDataFormat qos = QMI_CTL_DATA_FORMAT_QOS_FLOW_HEADER_ABSENT;
-            QmiCtlDataLinkProtocol link_protocol = QMI_CTL_DATA_LINK_PROTOCOL_802_3;
+    /* Let other identical requests be coalesced with this one */
+    if (coalesce_key) {
+        tr->coalesce_key = coalesce_key;
+        g_hash_table_insert (self->priv->coalesced_transactions, coalesce_key, tr);
+    }
 
-            g_debug ("[%s] Setting network port data format...",
-                     self->priv->path_display);
+    /* From now on, if we want to complete the transaction with an early error,
+     *  it needs to be removed from the tracking table as well. */
 
-            input = qmi_message_ctl_set_data_format_input_new ();
+    tr->timeout = timeout;
 
-            if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_NET_QOS_HEADER)
-                qos = QMI_CTL_DATA_FORMAT_QOS_FLOW_HEADER_PRESENT;
-            qmi_message_ctl_set_data_format_input_set_format (input, qos, NULL);
+    /* If we reached the limit of in-flight requests for the service, or if
+     * other requests must go first, wait; requests are sent in priority order,
+     * and in the order they were issued within the same priority */
+    if (device_must_wait (self, tr)) {
+        throttled_transactions_insert (self, tr);
+        /* The request, or the ones waiting ahead of it, may be sent right away */
+        if (device_can_send (self, qmi_message_get_service (message)))
+            device_schedule_throttled (self);
+        return;
+    }
 
-            if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_NET_RAW_IP)
-                link_protocol = QMI_CTL_DATA_LINK_PROTOCOL_RAW_IP;
-            qmi_message_ctl_set_data_format_input_set_protocol (input, link_protocol, NULL);
+    device_send_transaction (self, tr);
+}
 
-            qmi_client_ctl_set_data_format (self->priv->client_ctl,
-                                            input,
-                                            5,
-                                            NULL,
-                                            (GAsyncReadyCallback)ctl_set_data_format_ready,
-                                            task);
-            qmi_message_ctl_set_data_format_input_unref (input);
-            return;
+typedef struct {
+    QmiDevice          *self;
+    QmiMessage         *message;
+    QmiMessageContext  *message_context;
+    guint               timeout;
+    GCancellable       *cancellable;
+    GTask              *task;
+    CommandSyncContext *sync_ctx;
+    /* Only when there is no result keeping a reference to the device */
+    QmiDevice          *self_ref;
+} CommandRequest;
+
+static void
+command_request_free (CommandRequest *req)
+{
+    /* The task, if still set, was never passed to a transaction */
+    if (req->task)
+        g_object_unref (req->task);
+    /* Same for the sync context, don't leave the caller waiting forever */
+    if (req->sync_ctx) {
+        g_mutex_lock (&req->sync_ctx->mutex);
+        req->sync_ctx->error = g_error_new (QMI_CORE_ERROR,
+                                            QMI_CORE_ERROR_WRONG_STATE,
+                                            "Request not processed");
+        req->sync_ctx->done = TRUE;
+        g_cond_signal (&req->sync_ctx->cond);
+        g_mutex_unlock (&req->sync_ctx->mutex);
+    }
+    if (req->cancellable)
+        g_object_unref (req->cancellable);
+    if (req->message_context)
+        qmi_message_context_unref (req->message_context);
+    qmi_message_unref (req->message);
+    if (req->self_ref)
+        g_object_unref (req->self_ref);
+    g_slice_free (CommandRequest, req);
+}
+
+static gboolean
+command_request_in_io_context (CommandRequest *req)
+{
+    device_command (req->self,
+                    req->message,
+                    req->message_context,
+                    req->timeout,
+                    req->cancellable,
+                    req->task,
+                    req->sync_ctx);
+    req->task = NULL;
+    req->sync_ctx = NULL;
+    return G_SOURCE_REMOVE;
+}
+
+static void
+ensure_ctl_transaction_id (QmiDevice  *self,
+                           QmiMessage *message)
+{
+    /* Use a proper transaction id for CTL messages if they don't have one */
+    if (qmi_message_get_service (message) == QMI_SERVICE_CTL &&
+        qmi_message_get_transaction_id (message) == 0) {
+        qmi_message_set_transaction_id (
+            message,
+            qmi_client_get_next_transaction_id (
+                QMI_CLIENT (
+                    self->priv->client_ctl)));
+    }
+}
+
+void
+qmi_device_command_full (QmiDevice           *self,
+                         QmiMessage          *message,
+                         QmiMessageContext   *message_context,
+                         guint                timeout,
+                         GCancellable        *cancellable,
+                         GAsyncReadyCallback  callback,
+                         gpointer             user_data)
+{
+    GTask              *task = NULL;
+    CommandRequest     *req;
+    GSource            *source;
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (message != NULL);
+    g_return_if_fail (timeout > 0);
+
+    ensure_ctl_transaction_id (self, message);
+    __qmi_indication_registrations_record (self->priv->indication_registrations, message);
+
+    /* The task is always completed in the caller's context. Cancellation is
+     * handled by the transaction itself, so the cancellable is not given to
+     * the task. Requests without reply don't need any. */
+    if (!message_context || !qmi_message_context_get_no_reply (message_context)) {
+        task = g_task_new (self, NULL, callback, user_data);
+        g_task_set_source_tag (task, qmi_device_command_full);
+
+        if (self->priv->stall_threshold && callback) {
+            CallbackWatch *watch;
+
+            watch = g_new (CallbackWatch, 1);
+            watch->service = qmi_message_get_service (message);
+            watch->message_id = qmi_message_get_message_id (message);
+            watch->callback = callback;
+            g_object_set_qdata_full (G_OBJECT (task), callback_watch_quark, watch, g_free);
         }
-        ctx->step++;
-        /* Fall down */
+    }
 
-    case DEVICE_OPEN_CONTEXT_STEP_LAST:
-        /* Nothing else to process, done we are */
-        g_task_return_boolean (task, TRUE);
-        g_object_unref (task);
+    if (!self->priv->io_context || g_main_context_is_owner (self->priv->io_context)) {
+        device_command (self,
+                        message,
+                        message_context,
+                        timeout,
+                        cancellable,
+                        task,
+                        NULL);
         return;
-
-    default:
-        break;
     }
 
-    g_assert_not_reached ();
+    /* When using a dedicated I/O thread, the request is processed there */
+    req = g_slice_new0 (CommandRequest);
+    req->self = self; /* the result keeps a reference */
+    if (!task)
+        req->self_ref = g_object_ref (self);
+    req->message = qmi_message_ref (message);
+    req->message_context = (message_context ? qmi_message_context_ref (message_context) : NULL);
+    req->timeout = timeout;
+    req->cancellable = (cancellable ? g_object_ref (cancellable) : NULL);
+    req->task = task;
+
+    source = g_idle_source_new ();
+    g_source_set_callback (source,
+                           (GSourceFunc)command_request_in_io_context,
+                           req,
+                           (GDestroyNotify)command_request_free);
+    g_source_attach (source, self->priv->io_context);
+    g_source_unref (source);
 }
 
-void
-qmi_device_open (QmiDevice *self,
-                 QmiDeviceOpenFlags flags,
-                 guint timeout,
-                 GCancellable *cancellable,
-                 GAsyncReadyCallback callback,
-                 gpointer user_data)
+QmiMessage *
+qmi_device_command_full_sync (QmiDevice          *self,
+                              QmiMessage         *message,
+                              QmiMessageContext  *message_context,
+                              guint               timeout,
+                              GCancellable       *cancellable,
+                              GError            **error)
 {
-    DeviceOpenContext *ctx;
-    gchar *flags_str;
-    GTask *task;
+    CommandSyncContext  ctx;
+    CommandRequest     *req;
+    GSource            *source;
+    GMainContext       *io_context;
 
-    /* Raw IP and 802.3 are mutually exclusive */
-    g_return_if_fail (!((flags & QMI_DEVICE_OPEN_FLAGS_NET_802_3) &&
-                        (flags & QMI_DEVICE_OPEN_FLAGS_NET_RAW_IP)));
-    /* QoS and no QoS are mutually exclusive */
-    g_return_if_fail (!((flags & QMI_DEVICE_OPEN_FLAGS_NET_QOS_HEADER) &&
-                        (flags & QMI_DEVICE_OPEN_FLAGS_NET_NO_QOS_HEADER)));
-    /* At least one of both link protocol and QoS must be specified */
-    if (flags & (QMI_DEVICE_OPEN_FLAGS_NET_802_3 | QMI_DEVICE_OPEN_FLAGS_NET_RAW_IP))
-        g_return_if_fail (flags & (QMI_DEVICE_OPEN_FLAGS_NET_QOS_HEADER | QMI_DEVICE_OPEN_FLAGS_NET_NO_QOS_HEADER));
-    if (flags & (QMI_DEVICE_OPEN_FLAGS_NET_QOS_HEADER | QMI_DEVICE_OPEN_FLAGS_NET_NO_QOS_HEADER))
-        g_return_if_fail (flags & (QMI_DEVICE_OPEN_FLAGS_NET_802_3 | QMI_DEVICE_OPEN_FLAGS_NET_RAW_IP));
+    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
+    g_return_val_if_fail (message != NULL, NULL);
+    g_return_val_if_fail (timeout > 0, NULL);
+
+    /* The request is processed and completed in the I/O thread, so that the
+     * caller doesn't need to run any main loop */
+    io_context = self->priv->io_context;
+    if (!io_context) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE,
+                     "Synchronous requests need the device open with a dedicated I/O thread");
+        return NULL;
+    }
+    if (g_main_context_is_owner (io_context)) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE,
+                     "Synchronous requests cannot be run from the I/O thread");
+        return NULL;
+    }
 
-    g_return_if_fail (QMI_IS_DEVICE (self));
+    ensure_ctl_transaction_id (self, message);
+    __qmi_indication_registrations_record (self->priv->indication_registrations, message);
 
-    flags_str = qmi_device_open_flags_build_string_from_mask (flags);
-    g_debug ("[%s] Opening device with flags '%s'...",
-             self->priv->path_display,
-             flags_str);
-    g_free (flags_str);
+    memset (&ctx, 0, sizeof (ctx));
+    g_mutex_init (&ctx.mutex);
+    g_cond_init (&ctx.cond);
 
-    ctx = g_slice_new (DeviceOpenContext);
-    ctx->step = DEVICE_OPEN_CONTEXT_STEP_FIRST;
-    ctx->flags = flags;
-    ctx->timeout = timeout;
+    /* Keep the device valid until the request is completed */
+    req = g_slice_new0 (CommandRequest);
+    req->self = g_object_ref (self);
+    req->message = qmi_message_ref (message);
+    req->message_context = (message_context ? qmi_message_context_ref (message_context) : NULL);
+    req->timeout = timeout;
+    req->cancellable = (cancellable ? g_object_ref (cancellable) : NULL);
+    req->sync_ctx = &ctx;
 
-    task = g_task_new (self, cancellable, callback, user_data);
-    g_task_set_task_data (task, ctx, (GDestroyNotify)device_open_context_free);
+    source = g_idle_source_new ();
+    g_source_set_callback (source,
+                           (GSourceFunc)command_request_in_io_context,
+                           req,
+                           (GDestroyNotify)command_request_free);
+    g_source_attach (source, io_context);
+    g_source_unref (source);
 
-    /* Start processing */
-    device_open_step (task);
+    g_mutex_lock (&ctx.mutex);
+    while (!ctx.done)
+        g_cond_wait (&ctx.cond, &ctx.mutex);
+    g_mutex_unlock (&ctx.mutex);
+
+    g_mutex_clear (&ctx.mutex);
+    g_cond_clear (&ctx.cond);
+    g_object_unref (self);
+
+    if (ctx.error) {
+        g_propagate_error (error, ctx.error);
+        return NULL;
+    }
+    return ctx.reply;
 }
 
 /*****************************************************************************/
-/* Close stream */
+/* Batch of commands */
+
+typedef struct {
+    QmiDevice          *self;
+    QmiMessage        **messages;
+    QmiMessageContext **message_contexts;
+    GTask             **tasks;
+    guint               n_messages;
+    guint               timeout;
+    GCancellable       *cancellable;
+    /* Results, updated in the caller context */
+    guint               n_pending;
+    GPtrArray          *responses;
+    GPtrArray          *errors;
+} CommandBatchContext;
+
+typedef struct {
+    GTask *task;
+    guint  index;
+} CommandBatchItem;
 
 static void
-destroy_iostream (QmiDevice *self)
+command_batch_context_free (CommandBatchContext *ctx)
 {
-    if (self->priv->input_source) {
-        g_source_destroy (self->priv->input_source);
-        g_clear_pointer (&self->priv->input_source, g_source_unref);
+    guint i;
+
+    for (i = 0; i < ctx->n_messages; i++) {
+        if (ctx->message_contexts[i])
+            qmi_message_context_unref (ctx->message_contexts[i]);
+        qmi_message_unref (ctx->messages[i]);
     }
-    g_clear_pointer (&self->priv->buffer, g_byte_array_unref);
-    g_clear_object (&self->priv->istream);
-    g_clear_object (&self->priv->ostream);
-    g_clear_object (&self->priv->socket_connection);
-    g_clear_object (&self->priv->socket_client);
+    g_free (ctx->tasks);
+    g_free (ctx->message_contexts);
+    g_free (ctx->messages);
+    if (ctx->cancellable)
+        g_object_unref (ctx->cancellable);
+    g_ptr_array_unref (ctx->responses);
+    g_ptr_array_unref (ctx->errors);
+    g_slice_free (CommandBatchContext, ctx);
 }
 
-#if defined MBIM_QMUX_ENABLED
+GPtrArray *
+qmi_device_command_batch_finish (QmiDevice     *self,
+                                 GAsyncResult  *res,
+                                 GPtrArray    **errors,
+                                 GError       **error)
+{
+    CommandBatchContext *ctx;
+
+    if (!g_task_propagate_boolean (G_TASK (res), error))
+        return NULL;
+
+    ctx = g_task_get_task_data (G_TASK (res));
+    if (errors)
+        *errors = g_ptr_array_ref (ctx->errors);
+    return g_ptr_array_ref (ctx->responses);
+}
 
 static void
-mbim_device_close_ready (MbimDevice   *dev,
-                         GAsyncResult *res,
-                         GTask        *task)
+command_batch_complete (GTask *task)
 {
-    GError *error = NULL;
+    CommandBatchContext *ctx;
+    guint n_failed = 0;
+    guint i;
 
-    if (!mbim_device_close_finish (dev, res, &error))
-        g_task_return_error (task, error);
-    else
-        g_task_return_boolean (task, TRUE);
+    ctx = g_task_get_task_data (task);
+
+    for (i = 0; i < ctx->errors->len; i++) {
+        if (g_ptr_array_index (ctx->errors, i))
+            n_failed++;
+    }
+
+    /* Only a full failure is reported as an error */
+    if (n_failed > 0 && n_failed == ctx->errors->len) {
+        g_task_return_error (task, g_error_copy (g_ptr_array_index (ctx->errors, 0)));
+        g_object_unref (task);
+        return;
+    }
+
+    g_task_return_boolean (task, TRUE);
     g_object_unref (task);
 }
 
-#endif
+static void
+command_batch_item_ready (QmiDevice        *self,
+                          GAsyncResult     *res,
+                          CommandBatchItem *item)
+{
+    CommandBatchContext *ctx;
+    QmiMessage *response;
+    GError *error = NULL;
 
-gboolean
-qmi_device_close_finish (QmiDevice     *self,
-                         GAsyncResult  *res,
-                         GError       **error)
+    ctx = g_task_get_task_data (item->task);
+
+    response = qmi_device_command_full_finish (self, res, &error);
+    if (!response)
+        g_ptr_array_index (ctx->errors, item->index) = error;
+    else
+        g_ptr_array_index (ctx->responses, item->index) = response;
+
+    g_assert (ctx->n_pending > 0);
+    if (--ctx->n_pending == 0)
+        command_batch_complete (item->task);
+    g_slice_free (CommandBatchItem, item);
+}
+
+/* Processed in the I/O context */
+static gboolean
+command_batch_send (GTask *task)
 {
-    return g_task_propagate_boolean (G_TASK (res), error);
+    CommandBatchContext *ctx;
+    QmiDevice *self;
+    guint i;
+
+    ctx = g_task_get_task_data (task);
+    self = ctx->self;
+
+    /* All the requests are queued first, and then written together */
+    self->priv->output_batching++;
+    for (i = 0; i < ctx->n_messages; i++)
+        device_command (self,
+                        ctx->messages[i],
+                        ctx->message_contexts[i],
+                        ctx->timeout,
+                        ctx->cancellable,
+                        ctx->tasks[i],
+                        NULL);
+    self->priv->output_batching--;
+
+    if (!self->priv->output_batching &&
+        !self->priv->output_source &&
+        !g_queue_is_empty (self->priv->output_queue))
+        output_flush (self);
+
+    return G_SOURCE_REMOVE;
 }
 
 void
-qmi_device_close_async (QmiDevice           *self,
-                        guint                timeout,
-                        GCancellable        *cancellable,
-                        GAsyncReadyCallback  callback,
-                        gpointer             user_data)
+qmi_device_command_batch (QmiDevice           *self,
+                          QmiMessage         **messages,
+                          QmiMessageContext  **message_contexts,
+                          guint                n_messages,
+                          guint                timeout,
+                          GCancellable        *cancellable,
+                          GAsyncReadyCallback  callback,
+                          gpointer             user_data)
 {
+    CommandBatchContext *ctx;
     GTask *task;
+    GSource *source;
+    guint i;
 
-    task = g_task_new (self, cancellable, callback, user_data);
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (messages != NULL);
+    g_return_if_fail (n_messages > 0);
+    g_return_if_fail (timeout > 0);
 
-#if defined MBIM_QMUX_ENABLED
-    if (self->priv->mbimdev) {
-        /* Schedule in new main context */
-        mbim_device_close (self->priv->mbimdev,
-                           timeout,
-                           NULL,
-                           (GAsyncReadyCallback) mbim_device_close_ready,
-                           task);
-        /* Cleanup right away, we don't want multiple close attempts on the
-         * device */
-        g_clear_object (&self->priv->mbimdev);
-        return;
+    ctx = g_slice_new0 (CommandBatchContext);
+    ctx->self = self; /* the task keeps a reference */
+    ctx->n_messages = n_messages;
+    /* One more until all requests are submitted */
+    ctx->n_pending = n_messages + 1;
+    ctx->timeout = timeout;
+    ctx->cancellable = (cancellable ? g_object_ref (cancellable) : NULL);
+    ctx->messages = g_new0 (QmiMessage *, n_messages);
+    ctx->message_contexts = g_new0 (QmiMessageContext *, n_messages);
+    ctx->tasks = g_new0 (GTask *, n_messages);
+    ctx->responses = g_ptr_array_new_full (n_messages, (GDestroyNotify)qmi_message_unref);
+    g_ptr_array_set_size (ctx->responses, n_messages);
+    ctx->errors = g_ptr_array_new_full (n_messages, (GDestroyNotify)g_error_free);
+    g_ptr_array_set_size (ctx->errors, n_messages);
+
+    /* As in qmi_device_command_full(), cancellation is handled by each
+     * transaction */
+    task = g_task_new (self, NULL, callback, user_data);
+    g_task_set_task_data (task,
+                          ctx,
+                          (GDestroyNotify)command_batch_context_free);
+
+    g_debug ("[%s] Sending batch of %u requests...",
+             self->priv->path_display, n_messages);
+
+    /* Each request completes independently in the caller's context; the
+     * tasks are given to the transactions when sent */
+    for (i = 0; i < n_messages; i++) {
+        CommandBatchItem *item;
+
+        ensure_ctl_transaction_id (self, messages[i]);
+        ctx->messages[i] = qmi_message_ref (messages[i]);
+        if (message_contexts && message_contexts[i])
+            ctx->message_contexts[i] = qmi_message_context_ref (message_contexts[i]);
+
+        /* Requests without reply are not waited for */
+        if (ctx->message_contexts[i] && qmi_message_context_get_no_reply (ctx->message_contexts[i])) {
+            ctx->n_pending--;
+            continue;
+        }
+
+        item = g_slice_new (CommandBatchItem);
+        item->task = task;
+        item->index = i;
+        ctx->tasks[i] = g_task_new (self, NULL, (GAsyncReadyCallback)command_batch_item_ready, item);
+        g_task_set_source_tag (ctx->tasks[i], qmi_device_command_full);
     }
-#endif
 
-    destroy_iostream (self);
+    if (!self->priv->io_context || g_main_context_is_owner (self->priv->io_context))
+        command_batch_send (task);
+    else {
+        /* When using a dedicated I/O thread, the requests are sent from there */
+        source = g_idle_source_new ();
+        g_source_set_callback (source,
+                               (GSourceFunc)command_batch_send,
+                               g_object_ref (task),
+                               (GDestroyNotify)g_object_unref);
+        g_source_attach (source, self->priv->io_context);
+        g_source_unref (source);
+    }
 
-    g_task_return_boolean (task, TRUE);
-    g_object_unref (task);
+    if (--ctx->n_pending == 0)
+        command_batch_complete (task);
 }
 
+/*****************************************************************************/
+/* Indication registrations and low-power mode */
+
+#define LOW_POWER_TIMEOUT 10
+
 gboolean
-qmi_device_close (QmiDevice *self,
-                  GError **error)
+qmi_device_set_low_power_finish (QmiDevice     *self,
+                                 GAsyncResult  *res,
+                                 GError       **error)
 {
-    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
-    qmi_device_close_async (self, 0, NULL, NULL, NULL);
-    return TRUE;
+    return g_task_propagate_boolean (G_TASK (res), error);
 }
 
-#if defined MBIM_QMUX_ENABLED
+static void
+low_power_batch_ready (QmiDevice    *self,
+                       GAsyncResult *res,
+                       GTask        *task)
+{
+    GPtrArray *responses;
+    GPtrArray *errors = NULL;
+    GError    *error = NULL;
+    guint      i;
 
-typedef struct {
-    QmiDevice     *self;
-    gconstpointer  transaction_key;
-} MbimTransactionContext;
+    responses = qmi_device_command_batch_finish (self, res, &errors, &error);
+    if (!responses) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
 
-static MbimTransactionContext *
-mbim_transaction_context_new (QmiDevice     *self,
-                              gconstpointer  transaction_key)
-{
-    MbimTransactionContext *ctx;
+    /* Protocol errors are reported within the responses */
+    for (i = 0; i < responses->len && !error; i++) {
+        QmiMessage       *response;
+        QmiProtocolError  result;
 
-    ctx = g_slice_new (MbimTransactionContext);
-    ctx->self = g_object_ref (self);
-    ctx->transaction_key = transaction_key;
-    return ctx;
+        response = g_ptr_array_index (responses, i);
+        if (!response) {
+            error = g_error_copy (g_ptr_array_index (errors, i));
+            continue;
+        }
+
+        result = qmi_message_get_result_code (response);
+        if (result != QMI_PROTOCOL_ERROR_NONE)
+            error = g_error_new (QMI_PROTOCOL_ERROR,
+                                 result,
+                                 "Request 0x%04x failed: %s",
+                                 qmi_message_get_message_id (response),
+                                 qmi_protocol_error_get_string (result));
+    }
+    g_ptr_array_unref (responses);
+    g_ptr_array_unref (errors);
+
+    if (error) {
+        g_prefix_error (&error, "Couldn't update all indication registrations: ");
+        g_task_return_error (task, error);
+    } else
+        g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
 }
 
-static void
-mbim_transaction_context_free (MbimTransactionContext *ctx)
+static gboolean
+low_power_transaction_id (QmiService  service,
+                          guint8      cid,
+                          guint16    *transaction_id,
+                          QmiDevice  *self)
 {
-    g_object_unref (ctx->self);
-    g_slice_free (MbimTransactionContext, ctx);
+    QmiClient *client;
+
+    client = g_hash_table_lookup (self->priv->registered_clients,
+                                  build_registered_client_key (cid, service));
+    if (!client)
+        return FALSE;
+
+    *transaction_id = qmi_client_get_next_transaction_id (client);
+    return TRUE;
 }
 
-static void
-mbim_device_command_ready (MbimDevice             *dev,
-                           GAsyncResult           *res,
-                           MbimTransactionContext *ctx)
+void
+qmi_device_set_low_power (QmiDevice           *self,
+                          gboolean             low_power,
+                          GCancellable        *cancellable,
+                          GAsyncReadyCallback  callback,
+                          gpointer             user_data)
 {
-    MbimMessage *response;
-    GError *error = NULL;
-    const guint8 *buf;
-    guint32 len;
-    Transaction *tr;
+    GTask     *task;
+    GPtrArray *messages;
 
-    /* It is possible that the transaction doesn't exist, when it gets cancelled
-     * by the user before the response arrives. In such a case, we just return
-     * without processing the response */
-    tr = g_hash_table_lookup (ctx->self->priv->transactions, ctx->transaction_key);
-    if (!tr) {
-        mbim_device_command_finish (dev, res, NULL);
-        mbim_transaction_context_free (ctx);
+    g_return_if_fail (QMI_IS_DEVICE (self));
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    if (!qmi_device_is_open (self)) {
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_WRONG_STATE,
+                                 "Device must be open to change the power mode");
+        g_object_unref (task);
         return;
     }
 
-    response = mbim_device_command_finish (dev, res, &error);
-    if (!response || !mbim_message_response_get_result (response, MBIM_MESSAGE_TYPE_COMMAND_DONE, &error)) {
-        g_prefix_error (&error, "MBIM error: ");
-        tr = device_release_transaction (ctx->self, ctx->transaction_key);
-        transaction_complete_and_free (tr, NULL, error);
-        if (response)
-            mbim_message_unref (response);
-        mbim_transaction_context_free (ctx);
+    messages = __qmi_indication_registrations_set_low_power (self->priv->indication_registrations,
+                                                             low_power,
+                                                             (QmiIndicationRegistrationsTransactionIdFn)low_power_transaction_id,
+                                                             self);
+    if (!messages || !messages->len) {
+        if (messages)
+            g_ptr_array_unref (messages);
+        g_task_return_boolean (task, TRUE);
+        g_object_unref (task);
         return;
     }
 
-    g_debug ("[%s] Received MBIM message", ctx->self->priv->path_display);
+    g_debug ("[%s] %s %u indication registrations...",
+             self->priv->path_display,
+             low_power ? "Disabling" : "Restoring",
+             messages->len);
+
+    /* All of them written in one single burst */
+    qmi_device_command_batch (self,
+                              (QmiMessage **)messages->pdata,
+                              NULL,
+                              messages->len,
+                              LOW_POWER_TIMEOUT,
+                              cancellable,
+                              (GAsyncReadyCallback)low_power_batch_ready,
+                              task);
+    g_ptr_array_unref (messages);
+}
 
-    /* Store the raw information buffer in the internal reception buffer,
-     * as if we had read from a iochannel. */
-    buf = mbim_message_command_done_get_raw_information_buffer (response, &len);
-    if (!G_UNLIKELY (ctx->self->priv->buffer))
-        ctx->self->priv->buffer = g_byte_array_sized_new (len);
-    g_byte_array_append (ctx->self->priv->buffer, buf, len);
+/*****************************************************************************/
+/* Suspend monitor */
 
-    /* And parse it as QMI; it should remove and cleanup the transaction */
-    parse_response (ctx->self);
-    mbim_message_unref (response);
+static void
+suspend_monitor_low_power_ready (QmiDevice    *self,
+                                 GAsyncResult *res,
+                                 gpointer      suspending)
+{
+    GError *error = NULL;
 
-    /* After processing the QMI message, we check whether the transaction id was
-     * removed from our tables, and if it wasn't (e.g. the QMI message embedded
-     * in MBIM wasn't the proper one), we remove it ourselves. This is so that
-     * we don't leave unused transactions in the HT, given that we've disabled
-     * the transaction timeout for MBIM based ones */
-    tr = device_release_transaction (ctx->self, ctx->transaction_key);
-    if (tr) {
-        /* Complete transaction with a timeout error */
-        error = g_error_new (QMI_CORE_ERROR,
-                             QMI_CORE_ERROR_UNEXPECTED_MESSAGE,
-                             "Transaction received unexpected message");
-        transaction_complete_and_free (tr, NULL, error);
+    if (!qmi_device_set_low_power_finish (self, res, &error)) {
+        g_debug ("[%s] %s", self->priv->path_display, error->message);
         g_error_free (error);
     }
 
-    mbim_transaction_context_free (ctx);
+    /* The host may go on with the suspend now */
+    if (GPOINTER_TO_UINT (suspending) && self->priv->suspend_monitor)
+        __qmi_suspend_monitor_release (self->priv->suspend_monitor);
 }
 
-static gboolean
-mbim_command (QmiDevice      *self,
-              gconstpointer   raw_message,
-              gsize           raw_message_len,
-              gconstpointer   transaction_key,
-              guint           timeout,
-              GCancellable   *cancellable,
-              GError        **error)
+static void
+suspend_monitor_prepare_for_sleep (QmiSuspendMonitor *monitor,
+                                   gboolean           suspending,
+                                   QmiDevice         *self)
 {
-    MbimMessage *mbim_message;
-
-    g_debug ("[%s] sending message as MBIM...", self->priv->path_display);
+    if (!qmi_device_is_open (self)) {
+        if (suspending)
+            __qmi_suspend_monitor_release (monitor);
+        return;
+    }
 
-    mbim_message = (mbim_message_qmi_msg_set_new (raw_message_len, raw_message, error));
-    if (!mbim_message)
-        return FALSE;
+    qmi_device_set_low_power (self,
+                              suspending,
+                              NULL,
+                              (GAsyncReadyCallback)suspend_monitor_low_power_ready,
+                              GUINT_TO_POINTER (suspending));
+}
 
-    /* Note:
-     *
-     * Pass a full reference to the original QMI device to the MBIM command
-     * operation, so that we make sure the parent object is valid regardless
-     * of when the underlying device is fully disposed. This is required
-     * because device close is async().
-     */
-    mbim_device_command (self->priv->mbimdev,
-                         mbim_message,
-                         timeout,
-                         cancellable,
-                         (GAsyncReadyCallback) mbim_device_command_ready,
-                         mbim_transaction_context_new (self, transaction_key));
-
-    mbim_message_unref (mbim_message);
-    return TRUE;
+static void
+suspend_monitor_stop (QmiDevice *self)
+{
+    g_clear_pointer (&self->priv->suspend_monitor, __qmi_suspend_monitor_free);
 }
 
-#endif
+static void
+suspend_monitor_start (QmiDevice *self)
+{
+    GDBusConnection *connection;
+    GError          *error = NULL;
+
+    if (self->priv->suspend_monitor)
+        return;
+
+    connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+    if (!connection) {
+        g_debug ("[%s] Couldn't monitor host suspend: %s",
+                 self->priv->path_display, error->message);
+        g_error_free (error);
+        return;
+    }
+
+    self->priv->suspend_monitor = __qmi_suspend_monitor_new (connection,
+                                                             self->priv->path_display,
+                                                             (QmiSuspendMonitorFn)suspend_monitor_prepare_for_sleep,
+                                                             self);
+    g_object_unref (connection);
+}
 
 /*****************************************************************************/
-/* Command */
+/* Generic command */
 
 QmiMessage *
-qmi_device_command_full_finish (QmiDevice     *self,
-                                GAsyncResult  *res,
-                                GError       **error)
+qmi_device_command_finish (QmiDevice     *self,
+                           GAsyncResult  *res,
+                           GError       **error)
 {
-    if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (res), error))
-        return NULL;
+    return qmi_device_command_full_finish (self, res, error);
+}
 
-    return qmi_message_ref (g_simple_async_result_get_op_res_gpointer (
-                                G_SIMPLE_ASYNC_RESULT (res)));
+void
+qmi_device_command (QmiDevice           *self,
+                    QmiMessage          *message,
+                    guint                timeout,
+                    GCancellable        *cancellable,
+                    GAsyncReadyCallback  callback,
+                    gpointer             user_data)
+{
+    qmi_device_command_full (self, message, NULL, timeout, cancellable, callback, user_data);
 }
 
-static void
-transaction_early_error (QmiDevice   *self,
-                         Transaction *tr,
-                         gboolean     stored,
-                         GError      *error)
+/*****************************************************************************/
+/* New QMI device */
+
+QmiDevice *
+qmi_device_new_finish (GAsyncResult *res,
+                       GError **error)
 {
-    g_assert (error);
+    GObject *ret;
+    GObject *source_object;
 
-    if (stored) {
-        /* Match transaction so that we remove it from our tracking table */
-        tr = device_match_transaction (self, tr->message);
-        g_assert (tr);
-    }
-    transaction_complete_and_free (tr, NULL, error);
-    g_error_free (error);
+    source_object = g_async_result_get_source_object (res);
+    ret = g_async_initable_new_finish (G_ASYNC_INITABLE (source_object), res, error);
+    g_object_unref (source_object);
+
+    return (ret ? QMI_DEVICE (ret) : NULL);
 }
 
 void
-qmi_device_command_full (QmiDevice           *self,
-                         QmiMessage          *message,
-                         QmiMessageContext   *message_context,
-                         guint                timeout,
-                         GCancellable        *cancellable,
-                         GAsyncReadyCallback  callback,
-                         gpointer             user_data)
+qmi_device_new (GFile *file,
+                GCancellable *cancellable,
+                GAsyncReadyCallback callback,
+                gpointer user_data)
 {
-    GError *error = NULL;
-    Transaction *tr;
-    gconstpointer raw_message;
-    gsize raw_message_len;
-    guint transaction_timeout;
-
-    g_return_if_fail (QMI_IS_DEVICE (self));
-    g_return_if_fail (message != NULL);
-    g_return_if_fail (timeout > 0);
-
-    /* Use a proper transaction id for CTL messages if they don't have one */
-    if (qmi_message_get_service (message) == QMI_SERVICE_CTL &&
-        qmi_message_get_transaction_id (message) == 0) {
-        qmi_message_set_transaction_id (
-            message,
-            qmi_client_get_next_transaction_id (
-                QMI_CLIENT (
-                    self->priv->client_ctl)));
-    }
+    g_async_initable_new_async (QMI_TYPE_DEVICE,
+                                G_PRIORITY_DEFAULT,
+                                cancellable,
+                                callback,
+                                user_data,
+                                QMI_DEVICE_FILE, file,
+                                NULL);
+}
 
-    tr = transaction_new (self, message, message_context, cancellable, callback, user_data);
+/*****************************************************************************/
+/* Shared QMI devices
+ *
+ * Devices opened with qmi_device_new_shared() are kept in a process-wide
+ * registry indexed by path, without a reference, so that the device is
+ * disposed (and closed) once the last consumer drops its own reference. The
+ * consumers asking for a device while it is being created and opened wait
+ * for that same operation to finish. */
 
-    /* Device must be open */
-    if (!self->priv->istream || !self->priv->ostream) {
-#if defined MBIM_QMUX_ENABLED
-        if (!self->priv->mbimdev)
-#endif
-        {
-            error = g_error_new (QMI_CORE_ERROR,
-                                 QMI_CORE_ERROR_WRONG_STATE,
-                                 "Device must be open to send commands");
-            transaction_early_error (self, tr, FALSE, error);
-            return;
-        }
-    }
+typedef struct {
+    GWeakRef  device;
+    gboolean  opening;
+    GList    *waiting; /* GTasks */
+} SharedDevice;
 
-    /* Non-CTL services should use a proper CID */
-    if (qmi_message_get_service (message) != QMI_SERVICE_CTL &&
-        qmi_message_get_client_id (message) == 0) {
-        error = g_error_new (QMI_CORE_ERROR,
-                             QMI_CORE_ERROR_FAILED,
-                             "Cannot send message in service '%s' without a CID",
-                             qmi_service_get_string (qmi_message_get_service (message)));
-        transaction_early_error (self, tr, FALSE, error);
-        return;
-    }
+typedef struct {
+    gchar              *path;
+    QmiDeviceOpenFlags  flags;
+    guint               timeout;
+} SharedDeviceOpenContext;
 
-    /* Check if the message to be sent is supported by the device
-     * (only applicable if we did version info check when opening) */
-    if (!check_message_supported (self, message, &error)) {
-        g_prefix_error (&error, "Cannot send message: ");
-        transaction_early_error (self, tr, FALSE, error);
-        return;
-    }
+G_LOCK_DEFINE_STATIC (shared_devices);
+static GHashTable *shared_devices;
 
-    /* Get raw message */
-    raw_message = qmi_message_get_raw (message, &raw_message_len, &error);
-    if (!raw_message) {
-        g_prefix_error (&error, "Cannot get raw message: ");
-        transaction_early_error (self, tr, FALSE, error);
-        return;
-    }
+static void
+shared_device_open_context_free (SharedDeviceOpenContext *ctx)
+{
+    g_free (ctx->path);
+    g_slice_free (SharedDeviceOpenContext, ctx);
+}
 
-    /* For transactions using the MBIM backend, no explicit timeout is set.
-     * Instead, we rely on the timeout management in libmbim. */
-    transaction_timeout = timeout;
-#if defined MBIM_QMUX_ENABLED
-    if (self->priv->mbimdev)
-        transaction_timeout = 0;
-#endif
+static void
+shared_device_free (SharedDevice *shared)
+{
+    g_assert (!shared->waiting);
+    g_weak_ref_clear (&shared->device);
+    g_slice_free (SharedDevice, shared);
+}
 
-    /* Setup context to match response */
-    if (!device_store_transaction (self, tr, transaction_timeout, &error)) {
-        g_prefix_error (&error, "Cannot store transaction: ");
-        transaction_early_error (self, tr, FALSE, error);
-        return;
+static void
+shared_device_forget (QmiDevice *self)
+{
+    SharedDevice *shared;
+    QmiDevice    *device = NULL;
+
+    G_LOCK (shared_devices);
+    shared = ((shared_devices && self->priv->path) ? g_hash_table_lookup (shared_devices, self->priv->path) : NULL);
+    if (shared && !shared->opening) {
+        /* Only if not already replaced by a new device for the same path */
+        device = g_weak_ref_get (&shared->device);
+        if (!device || device == self)
+            g_hash_table_remove (shared_devices, self->priv->path);
     }
+    G_UNLOCK (shared_devices);
 
-    /* From now on, if we want to complete the transaction with an early error,
-     *  it needs to be removed from the tracking table as well. */
+    /* Never dropped with the lock held, it may be the last reference */
+    if (device)
+        g_object_unref (device);
+}
 
-    trace_message (self, message, TRUE, "request", message_context);
+static void
+shared_device_removed_cb (QmiDevice *self)
+{
+    /* The next consumers get a new device */
+    shared_device_forget (self);
+}
 
-#if defined MBIM_QMUX_ENABLED
-    if (self->priv->mbimdev) {
-        if (!mbim_command (self,
-                           raw_message,
-                           raw_message_len,
-                           build_transaction_key (message),
-                           timeout,
-                           cancellable,
-                           &error)) {
-            g_prefix_error (&error, "Cannot create MBIM command: ");
-            transaction_early_error (self, tr, TRUE, error);
+static void
+shared_device_complete (const gchar  *path,
+                        QmiDevice    *device,
+                        const GError *error)
+{
+    SharedDevice *shared;
+    GList        *waiting;
+    GList        *l;
+
+    G_LOCK (shared_devices);
+    shared = g_hash_table_lookup (shared_devices, path);
+    g_assert (shared && shared->opening);
+    waiting = shared->waiting;
+    shared->waiting = NULL;
+    shared->opening = FALSE;
+    if (device)
+        g_weak_ref_set (&shared->device, device);
+    else
+        g_hash_table_remove (shared_devices, path);
+    G_UNLOCK (shared_devices);
+
+    for (l = waiting; l; l = g_list_next (l)) {
+        GTask *task = l->data;
+
+        /* Consumers cancelled while waiting just don't get the device */
+        if (!g_task_return_error_if_cancelled (task)) {
+            if (device)
+                g_task_return_pointer (task, g_object_ref (device), g_object_unref);
+            else
+                g_task_return_error (task, g_error_copy (error));
         }
-        return;
+        g_object_unref (task);
+    }
+    g_list_free (waiting);
+}
+
+static void
+shared_device_open_ready (QmiDevice               *device,
+                          GAsyncResult            *res,
+                          SharedDeviceOpenContext *ctx)
+{
+    GError *error = NULL;
+
+    if (!qmi_device_open_finish (device, res, &error)) {
+        shared_device_complete (ctx->path, NULL, error);
+        g_error_free (error);
+    } else {
+        g_signal_connect (device,
+                          QMI_DEVICE_SIGNAL_REMOVED,
+                          G_CALLBACK (shared_device_removed_cb),
+                          NULL);
+        shared_device_complete (ctx->path, device, NULL);
     }
-#endif
 
-    if (!g_output_stream_write_all (self->priv->ostream,
-                                    raw_message,
-                                    raw_message_len,
-                                    NULL, /* bytes_written */
-                                    NULL, /* cancellable */
-                                    &error)) {
-        g_prefix_error (&error, "Cannot write message: ");
-        transaction_early_error (self, tr, TRUE, error);
+    g_object_unref (device);
+    shared_device_open_context_free (ctx);
+}
+
+static void
+shared_device_new_ready (GObject                 *source,
+                         GAsyncResult            *res,
+                         SharedDeviceOpenContext *ctx)
+{
+    QmiDevice *device;
+    GError    *error = NULL;
+
+    device = qmi_device_new_finish (res, &error);
+    if (!device) {
+        shared_device_complete (ctx->path, NULL, error);
+        g_error_free (error);
+        shared_device_open_context_free (ctx);
         return;
     }
 
-    /* Flush explicitly if correctly written */
-    g_output_stream_flush (self->priv->ostream, NULL, NULL);
+    /* Opened without the cancellable of any of the consumers, as they're
+     * all waiting for it */
+    qmi_device_open (device,
+                     ctx->flags,
+                     ctx->timeout,
+                     NULL,
+                     (GAsyncReadyCallback)shared_device_open_ready,
+                     ctx);
 }
 
-/*****************************************************************************/
-/* Generic command */
-
-QmiMessage *
-qmi_device_command_finish (QmiDevice     *self,
-                           GAsyncResult  *res,
-                           GError       **error)
+QmiDevice *
+qmi_device_new_shared_finish (GAsyncResult  *res,
+                              GError       **error)
 {
-    return qmi_device_command_full_finish (self, res, error);
+    return g_task_propagate_pointer (G_TASK (res), error);
 }
 
 void
-qmi_device_command (QmiDevice           *self,
-                    QmiMessage          *message,
-                    guint                timeout,
-                    GCancellable        *cancellable,
-                    GAsyncReadyCallback  callback,
-                    gpointer             user_data)
+qmi_device_new_shared (GFile               *file,
+                       QmiDeviceOpenFlags   flags,
+                       guint                timeout,
+                       GCancellable        *cancellable,
+                       GAsyncReadyCallback  callback,
+                       gpointer             user_data)
 {
-    qmi_device_command_full (self, message, NULL, timeout, cancellable, callback, user_data);
-}
+    GTask        *task;
+    SharedDevice *shared;
+    QmiDevice    *device = NULL;
+    gchar        *path;
 
-/*****************************************************************************/
-/* New QMI device */
+    g_return_if_fail (G_IS_FILE (file));
 
-QmiDevice *
-qmi_device_new_finish (GAsyncResult *res,
-                       GError **error)
-{
-    GObject *ret;
-    GObject *source_object;
+    task = g_task_new (NULL, cancellable, callback, user_data);
 
-    source_object = g_async_result_get_source_object (res);
-    ret = g_async_initable_new_finish (G_ASYNC_INITABLE (source_object), res, error);
-    g_object_unref (source_object);
+    path = g_file_get_path (file);
+    if (!path) {
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_INVALID_ARGS,
+                                 "Cannot share a device without a local path");
+        g_object_unref (task);
+        return;
+    }
 
-    return (ret ? QMI_DEVICE (ret) : NULL);
-}
+    G_LOCK (shared_devices);
 
-void
-qmi_device_new (GFile *file,
-                GCancellable *cancellable,
-                GAsyncReadyCallback callback,
-                gpointer user_data)
-{
-    g_async_initable_new_async (QMI_TYPE_DEVICE,
-                                G_PRIORITY_DEFAULT,
-                                cancellable,
-                                callback,
-                                user_data,
-                                QMI_DEVICE_FILE, file,
-                                NULL);
+    if (!shared_devices)
+        shared_devices = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)shared_device_free);
+
+    shared = g_hash_table_lookup (shared_devices, path);
+    if (shared && shared->opening) {
+        /* Being opened for another consumer, just wait for it */
+        shared->waiting = g_list_append (shared->waiting, task);
+        G_UNLOCK (shared_devices);
+        g_free (path);
+        return;
+    }
+
+    if (shared)
+        device = g_weak_ref_get (&shared->device);
+
+    if (!device) {
+        SharedDeviceOpenContext *ctx;
+
+        if (!shared) {
+            shared = g_slice_new0 (SharedDevice);
+            g_weak_ref_init (&shared->device, NULL);
+            g_hash_table_insert (shared_devices, g_strdup (path), shared);
+        }
+        shared->opening = TRUE;
+        shared->waiting = g_list_append (shared->waiting, task);
+        G_UNLOCK (shared_devices);
+
+        ctx = g_slice_new (SharedDeviceOpenContext);
+        ctx->path = path;
+        ctx->flags = flags;
+        ctx->timeout = timeout;
+        qmi_device_new (file,
+                        NULL,
+                        (GAsyncReadyCallback)shared_device_new_ready,
+                        ctx);
+        return;
+    }
+
+    G_UNLOCK (shared_devices);
+
+    /* Already open; the flags given by the consumer that opened it apply */
+    g_debug ("[%s] Reusing shared device", device->priv->path_display);
+    g_task_return_pointer (task, device, g_object_unref);
+    g_object_unref (task);
+    g_free (path);
 }
 
 /*****************************************************************************/
@@ -2836,9 +10162,11 @@ static void
 sync_indication_cb (QmiClientCtl *client_ctl,
                     QmiDevice *self)
 {
-    /* Just log about it */
     g_debug ("[%s] Sync indication received",
              self->priv->path_display);
+
+    /* All CIDs released by the device */
+    cid_pool_clear (self);
 }
 
 static void
@@ -2929,6 +10257,23 @@ initable_init_async (GAsyncInitable *initable,
         return;
     }
 
+#if defined HAVE_LINUX_QRTR_H
+    /* QRTR nodes are not files */
+    if (self->priv->qrtr) {
+        if (!__qmi_qrtr_parse_uri (self->priv->path, &self->priv->qrtr_node_id)) {
+            g_task_return_new_error (task,
+                                     QMI_CORE_ERROR,
+                                     QMI_CORE_ERROR_INVALID_ARGS,
+                                     "Cannot initialize QMI device: Invalid QRTR node: %s",
+                                     self->priv->path_display);
+            g_object_unref (task);
+            return;
+        }
+        client_ctl_setup (task);
+        return;
+    }
+#endif
+
     /* If no file check requested, don't do it */
     if (self->priv->no_file_check) {
         client_ctl_setup (task);
@@ -2962,6 +10307,15 @@ set_property (GObject *object,
         g_assert (self->priv->file == NULL);
         self->priv->file = g_value_dup_object (value);
         if (self->priv->file) {
+#if defined HAVE_LINUX_QRTR_H
+            /* QRTR nodes given as URIs, validated when initializing */
+            if (g_file_has_uri_scheme (self->priv->file, QMI_QRTR_URI_SCHEME)) {
+                self->priv->qrtr = TRUE;
+                self->priv->path = g_file_get_uri (self->priv->file);
+                self->priv->path_display = g_strdup (self->priv->path);
+                break;
+            }
+#endif
             self->priv->path = g_file_get_path (self->priv->file);
             self->priv->path_display = g_filename_display_name (self->priv->path);
         }
@@ -2973,6 +10327,67 @@ set_property (GObject *object,
         g_free (self->priv->proxy_path);
         self->priv->proxy_path = g_value_dup_string (value);
         break;
+    case PROP_MAX_IN_FLIGHT:
+        self->priv->max_in_flight = g_value_get_uint (value);
+        device_max_in_flight_changed (self);
+        break;
+    case PROP_VERSION_INFO_CACHE_DIR:
+        g_free (self->priv->version_info_cache_dir);
+        self->priv->version_info_cache_dir = g_value_dup_string (value);
+        break;
+    case PROP_CID_POOL:
+        self->priv->cid_pool_enabled = g_value_get_boolean (value);
+        break;
+    case PROP_CID_POOL_FILE:
+        g_free (self->priv->cid_pool_file);
+        self->priv->cid_pool_file = g_value_dup_string (value);
+        /* Reload from the new file when needed */
+        g_clear_pointer (&self->priv->cid_pool, g_array_unref);
+        break;
+    case PROP_COALESCE_REQUESTS:
+        self->priv->coalesce_requests = g_value_get_boolean (value);
+        break;
+    case PROP_RESPONSE_CACHE:
+        self->priv->response_cache_enabled = g_value_get_boolean (value);
+        break;
+    case PROP_INDICATION_CACHE:
+        self->priv->indication_cache_enabled = g_value_get_boolean (value);
+        if (!self->priv->indication_cache_enabled)
+            indication_cache_clear (self);
+        break;
+    case PROP_ADAPTIVE_TIMEOUTS:
+        g_mutex_lock (&self->priv->stats_lock);
+        self->priv->adaptive_timeouts_enabled = g_value_get_boolean (value);
+        g_mutex_unlock (&self->priv->stats_lock);
+        break;
+    case PROP_HEALTH_CHECK:
+        g_mutex_lock (&self->priv->stats_lock);
+        self->priv->health_check_enabled = g_value_get_boolean (value);
+        g_mutex_unlock (&self->priv->stats_lock);
+        break;
+    case PROP_REMOVAL_MONITOR:
+        self->priv->removal_monitor_enabled = g_value_get_boolean (value);
+        if (!self->priv->removal_monitor_enabled)
+            removal_monitor_stop (self);
+        else if (qmi_device_is_open (self))
+            removal_monitor_start (self);
+        break;
+    case PROP_IO_URING:
+        self->priv->io_uring_enabled = g_value_get_boolean (value);
+        break;
+    case PROP_STALL_THRESHOLD:
+        self->priv->stall_threshold = g_value_get_uint (value);
+        break;
+    case PROP_OFFLOAD_THRESHOLD:
+        g_atomic_int_set (&self->priv->offload_threshold, (gint) g_value_get_uint (value));
+        break;
+    case PROP_SUSPEND_MONITOR:
+        self->priv->suspend_monitor_enabled = g_value_get_boolean (value);
+        if (!self->priv->suspend_monitor_enabled)
+            suspend_monitor_stop (self);
+        else if (qmi_device_is_open (self))
+            suspend_monitor_start (self);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -2995,6 +10410,48 @@ get_property (GObject *object,
         reload_wwan_iface_name (self);
         g_value_set_string (value, self->priv->wwan_iface);
         break;
+    case PROP_MAX_IN_FLIGHT:
+        g_value_set_uint (value, self->priv->max_in_flight);
+        break;
+    case PROP_VERSION_INFO_CACHE_DIR:
+        g_value_set_string (value, self->priv->version_info_cache_dir);
+        break;
+    case PROP_CID_POOL:
+        g_value_set_boolean (value, self->priv->cid_pool_enabled);
+        break;
+    case PROP_CID_POOL_FILE:
+        g_value_set_string (value, self->priv->cid_pool_file);
+        break;
+    case PROP_COALESCE_REQUESTS:
+        g_value_set_boolean (value, self->priv->coalesce_requests);
+        break;
+    case PROP_RESPONSE_CACHE:
+        g_value_set_boolean (value, self->priv->response_cache_enabled);
+        break;
+    case PROP_INDICATION_CACHE:
+        g_value_set_boolean (value, self->priv->indication_cache_enabled);
+        break;
+    case PROP_ADAPTIVE_TIMEOUTS:
+        g_value_set_boolean (value, self->priv->adaptive_timeouts_enabled);
+        break;
+    case PROP_HEALTH_CHECK:
+        g_value_set_boolean (value, self->priv->health_check_enabled);
+        break;
+    case PROP_REMOVAL_MONITOR:
+        g_value_set_boolean (value, self->priv->removal_monitor_enabled);
+        break;
+    case PROP_IO_URING:
+        g_value_set_boolean (value, self->priv->io_uring_enabled);
+        break;
+    case PROP_STALL_THRESHOLD:
+        g_value_set_uint (value, self->priv->stall_threshold);
+        break;
+    case PROP_SUSPEND_MONITOR:
+        g_value_set_boolean (value, self->priv->suspend_monitor_enabled);
+        break;
+    case PROP_OFFLOAD_THRESHOLD:
+        g_value_set_uint (value, (guint) g_atomic_int_get (&self->priv->offload_threshold));
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -3008,14 +10465,57 @@ qmi_device_init (QmiDevice *self)
                                               QMI_TYPE_DEVICE,
                                               QmiDevicePrivate);
 
-    self->priv->transactions = g_hash_table_new (g_direct_hash,
-                                                 g_direct_equal);
+    self->priv->transaction_timeouts = g_sequence_new (NULL);
+    self->priv->mux_links = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+    self->priv->cancellable_groups = g_hash_table_new_full (g_direct_hash,
+                                                            g_direct_equal,
+                                                            NULL,
+                                                            (GDestroyNotify)cancellable_group_free);
 
     self->priv->registered_clients = g_hash_table_new_full (g_direct_hash,
                                                             g_direct_equal,
                                                             NULL,
                                                             g_object_unref);
+    self->priv->pending_indications = g_hash_table_new_full (g_direct_hash,
+                                                             g_direct_equal,
+                                                             NULL,
+                                                             (GDestroyNotify)pending_indications_free);
+    self->priv->output_queue = g_queue_new ();
+    self->priv->throttled_transactions = g_queue_new ();
+    self->priv->coalesced_transactions = g_hash_table_new (g_bytes_hash, g_bytes_equal);
+    self->priv->response_cache = g_hash_table_new_full (g_bytes_hash,
+                                                        g_bytes_equal,
+                                                        (GDestroyNotify)g_bytes_unref,
+                                                        (GDestroyNotify)response_cache_entry_free);
+    self->priv->indication_cache = g_hash_table_new_full (g_direct_hash,
+                                                          g_direct_equal,
+                                                          NULL,
+                                                          (GDestroyNotify)qmi_message_unref);
+    self->priv->indication_registrations = __qmi_indication_registrations_new ();
     self->priv->proxy_path = g_strdup (QMI_PROXY_SOCKET_PATH);
+
+    g_mutex_init (&self->priv->stats_lock);
+    g_mutex_init (&self->priv->transaction_pool_lock);
+    g_mutex_init (&self->priv->owner_dispatch_lock);
+    g_mutex_init (&self->priv->pending_indications_lock);
+    g_mutex_init (&self->priv->indication_cache_lock);
+    g_queue_init (&self->priv->owner_dispatch_queue);
+    self->priv->stats.since = g_get_monotonic_time ();
+    self->priv->message_stats = g_hash_table_new_full (g_direct_hash,
+                                                       g_direct_equal,
+                                                       NULL,
+                                                       (GDestroyNotify)message_stats_free);
+    self->priv->offloaded_messages = g_hash_table_new (g_direct_hash, g_direct_equal);
+    self->priv->adaptive_timeout_multiplier = ADAPTIVE_TIMEOUT_MULTIPLIER_DEFAULT;
+    self->priv->adaptive_timeout_min = ADAPTIVE_TIMEOUT_MIN_DEFAULT;
+    self->priv->adaptive_timeouts = g_hash_table_new_full (g_direct_hash,
+                                                           g_direct_equal,
+                                                           NULL,
+                                                           (GDestroyNotify)adaptive_timeout_free);
+    self->priv->health_check_idle_timeout = HEALTH_CHECK_IDLE_TIMEOUT_DEFAULT;
+    self->priv->health_check_stall_timeout = HEALTH_CHECK_STALL_TIMEOUT_DEFAULT;
+    self->priv->health_check_ping_timeout = HEALTH_CHECK_PING_TIMEOUT_DEFAULT;
+    self->priv->context = g_main_context_ref_thread_default ();
 }
 
 static gboolean
@@ -3035,9 +10535,48 @@ static void
 dispose (GObject *object)
 {
     QmiDevice *self = QMI_DEVICE (object);
+    guint      i;
 
     g_clear_object (&self->priv->file);
 
+    shared_device_forget (self);
+    removal_monitor_stop (self);
+    suspend_monitor_stop (self);
+
+    io_thread_stop (self);
+
+#if defined MBIM_QMUX_ENABLED
+    /* The MBIM device must not report indications to us any more */
+    if (self->priv->mbimdev)
+        mbim_device_release (self);
+    mbim_batch_clear (self);
+#endif
+
+#if defined HAVE_LINUX_QRTR_H
+    qrtr_close (self);
+#endif
+
+    /* Indications not yet reported are lost */
+    pending_indications_flush (self);
+
+    if (self->priv->throttled_source) {
+        g_source_destroy (self->priv->throttled_source);
+        g_clear_pointer (&self->priv->throttled_source, g_source_unref);
+    }
+
+    /* Transactions keep a reference to the device, so there cannot be any
+     * pending timeout at this point */
+    if (self->priv->transaction_timeout_source) {
+        g_source_destroy (self->priv->transaction_timeout_source);
+        g_clear_pointer (&self->priv->transaction_timeout_source, g_source_unref);
+    }
+
+    /* Pings also keep a reference to the device */
+    if (self->priv->health_check_source) {
+        g_source_destroy (self->priv->health_check_source);
+        g_clear_pointer (&self->priv->health_check_source, g_source_unref);
+    }
+
     /* unregister our CTL client */
     if (self->priv->client_ctl)
         unregister_client (self, QMI_CLIENT (self->priv->client_ctl));
@@ -3048,6 +10587,8 @@ dispose (GObject *object)
     g_hash_table_foreach_remove (self->priv->registered_clients,
                                  (GHRFunc)foreach_warning,
                                  self);
+    for (i = 0; i < G_N_ELEMENTS (self->priv->registered_clients_by_service); i++)
+        g_clear_pointer (&self->priv->registered_clients_by_service[i], g_ptr_array_unref);
 
     if (self->priv->sync_indication_id &&
         self->priv->client_ctl) {
@@ -3066,14 +10607,28 @@ finalize (GObject *object)
     QmiDevice *self = QMI_DEVICE (object);
 
     /* Transactions keep refs to the device, so it's actually
-     * impossible to have any content in the HT */
-    if (self->priv->transactions) {
-        g_assert (g_hash_table_size (self->priv->transactions) == 0);
-        g_hash_table_unref (self->priv->transactions);
-    }
+     * impossible to have any content in the table */
+    g_assert (self->priv->transactions.n_items == 0);
+    __qmi_transaction_table_clear (&self->priv->transactions);
+
+    if (self->priv->transaction_pool)
+        g_ptr_array_unref (self->priv->transaction_pool);
+
+    g_assert (g_sequence_get_length (self->priv->transaction_timeouts) == 0);
+    g_sequence_free (self->priv->transaction_timeouts);
+
+    g_hash_table_unref (self->priv->cancellable_groups);
 
     g_hash_table_unref (self->priv->registered_clients);
 
+    g_hash_table_unref (self->priv->pending_indications);
+    g_queue_free (self->priv->output_queue);
+    g_assert (g_queue_is_empty (self->priv->throttled_transactions));
+    g_queue_free (self->priv->throttled_transactions);
+
+    g_assert (g_hash_table_size (self->priv->coalesced_transactions) == 0);
+    g_hash_table_unref (self->priv->coalesced_transactions);
+
     if (self->priv->supported_services)
         g_array_unref (self->priv->supported_services);
 
@@ -3081,8 +10636,34 @@ finalize (GObject *object)
     g_free (self->priv->path_display);
     g_free (self->priv->proxy_path);
     g_free (self->priv->wwan_iface);
+    g_hash_table_unref (self->priv->mux_links);
+    g_free (self->priv->version_info_cache_dir);
+    g_free (self->priv->cid_pool_file);
+    if (self->priv->cid_pool)
+        g_array_unref (self->priv->cid_pool);
+    if (self->priv->open_context)
+        g_main_context_unref (self->priv->open_context);
+
+    if (self->priv->trace_func_user_data_free)
+        self->priv->trace_func_user_data_free (self->priv->trace_func_user_data);
+
+    g_hash_table_unref (self->priv->message_stats);
+    g_hash_table_unref (self->priv->offloaded_messages);
+    g_hash_table_unref (self->priv->adaptive_timeouts);
+    g_mutex_clear (&self->priv->stats_lock);
+    g_mutex_clear (&self->priv->transaction_pool_lock);
+    g_mutex_clear (&self->priv->owner_dispatch_lock);
+    g_mutex_clear (&self->priv->pending_indications_lock);
+    g_mutex_clear (&self->priv->indication_cache_lock);
 
     destroy_iostream (self);
+    g_hash_table_unref (self->priv->response_cache);
+    g_hash_table_unref (self->priv->indication_cache);
+    __qmi_indication_registrations_free (self->priv->indication_registrations);
+
+    if (self->priv->context_acquired)
+        g_main_context_release (self->priv->context);
+    g_main_context_unref (self->priv->context);
 
     G_OBJECT_CLASS (qmi_device_parent_class)->finalize (object);
 }
@@ -3106,6 +10687,8 @@ qmi_device_class_init (QmiDeviceClass *klass)
     object_class->finalize = finalize;
     object_class->dispose = dispose;
 
+    callback_watch_quark = g_quark_from_static_string ("qmi-device-callback-watch");
+
     /**
      * QmiDevice:device-file:
      *
@@ -3135,12 +10718,18 @@ qmi_device_class_init (QmiDeviceClass *klass)
     /**
      * QmiDevice:device-proxy-path:
      *
+     * Abstract socket name of the proxy, or the address of a remote proxy as
+     * "tcp://[TOKEN@]HOST:PORT" (or "tls://" to connect through TLS). If not
+     * given in the address, the token is read from the QMI_PROXY_AUTH_TOKEN
+     * environment variable. The path of the device is then one in the remote
+     * host, so the #QmiDevice:device-no-file-check property should be set.
+     *
      * Since: 1.12
      */
     properties[PROP_PROXY_PATH] =
         g_param_spec_string (QMI_DEVICE_PROXY_PATH,
                              "Proxy path",
-                             "Path of the abstract socket where the proxy is available.",
+                             "Path of the abstract socket where the proxy is available, or address of a remote proxy.",
                              QMI_PROXY_SOCKET_PATH,
                              G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY);
     g_object_class_install_property (object_class, PROP_PROXY_PATH, properties[PROP_PROXY_PATH]);
@@ -3158,6 +10747,194 @@ qmi_device_class_init (QmiDeviceClass *klass)
                              G_PARAM_READABLE);
     g_object_class_install_property (object_class, PROP_WWAN_IFACE, properties[PROP_WWAN_IFACE]);
 
+    /**
+     * QmiDevice:device-max-in-flight:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_MAX_IN_FLIGHT] =
+        g_param_spec_uint (QMI_DEVICE_MAX_IN_FLIGHT,
+                           "Max in flight",
+                           "Maximum number of requests sent without a response yet, 0 for no limit.",
+                           0,
+                           G_MAXUINT,
+                           0,
+                           G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_MAX_IN_FLIGHT, properties[PROP_MAX_IN_FLIGHT]);
+
+    /**
+     * QmiDevice:device-version-info-cache-dir:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_VERSION_INFO_CACHE_DIR] =
+        g_param_spec_string (QMI_DEVICE_VERSION_INFO_CACHE_DIR,
+                             "Version info cache directory",
+                             "Directory where the version info of the device is cached, or NULL to disable the cache.",
+                             NULL,
+                             G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_VERSION_INFO_CACHE_DIR, properties[PROP_VERSION_INFO_CACHE_DIR]);
+
+    /**
+     * QmiDevice:device-cid-pool:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_CID_POOL] =
+        g_param_spec_boolean (QMI_DEVICE_CID_POOL,
+                              "CID pool",
+                              "Keep the CIDs of released clients to reuse them in new clients",
+                              FALSE,
+                              G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_CID_POOL, properties[PROP_CID_POOL]);
+
+    /**
+     * QmiDevice:device-cid-pool-file:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_CID_POOL_FILE] =
+        g_param_spec_string (QMI_DEVICE_CID_POOL_FILE,
+                             "CID pool file",
+                             "File where the CID pool is stored, or NULL to keep it only in memory.",
+                             NULL,
+                             G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_CID_POOL_FILE, properties[PROP_CID_POOL_FILE]);
+
+    /**
+     * QmiDevice:device-coalesce-requests:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_COALESCE_REQUESTS] =
+        g_param_spec_boolean (QMI_DEVICE_COALESCE_REQUESTS,
+                              "Coalesce requests",
+                              "Don't send idempotent requests identical to one already ongoing",
+                              FALSE,
+                              G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_COALESCE_REQUESTS, properties[PROP_COALESCE_REQUESTS]);
+
+    /**
+     * QmiDevice:device-response-cache:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_RESPONSE_CACHE] =
+        g_param_spec_boolean (QMI_DEVICE_RESPONSE_CACHE,
+                              "Response cache",
+                              "Keep the responses to requests querying rarely changing information",
+                              FALSE,
+                              G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_RESPONSE_CACHE, properties[PROP_RESPONSE_CACHE]);
+
+    /**
+     * QmiDevice:device-indication-cache:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_INDICATION_CACHE] =
+        g_param_spec_boolean (QMI_DEVICE_INDICATION_CACHE,
+                              "Indication cache",
+                              "Keep the last indications reporting the device state, and replay them to new clients",
+                              FALSE,
+                              G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_INDICATION_CACHE, properties[PROP_INDICATION_CACHE]);
+
+    /**
+     * QmiDevice:device-adaptive-timeouts:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_ADAPTIVE_TIMEOUTS] =
+        g_param_spec_boolean (QMI_DEVICE_ADAPTIVE_TIMEOUTS,
+                              "Adaptive timeouts",
+                              "Derive the timeouts of the requests from the latencies observed for each message",
+                              FALSE,
+                              G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_ADAPTIVE_TIMEOUTS, properties[PROP_ADAPTIVE_TIMEOUTS]);
+
+    /**
+     * QmiDevice:device-health-check:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_HEALTH_CHECK] =
+        g_param_spec_boolean (QMI_DEVICE_HEALTH_CHECK,
+                              "Health check",
+                              "Ping the device when nothing is received for a while, and fail fast if it doesn't reply",
+                              FALSE,
+                              G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_HEALTH_CHECK, properties[PROP_HEALTH_CHECK]);
+
+    /**
+     * QmiDevice:device-removal-monitor:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_REMOVAL_MONITOR] =
+        g_param_spec_boolean (QMI_DEVICE_REMOVAL_MONITOR,
+                              "Removal monitor",
+                              "Report the device as removed as soon as its file goes away",
+                              FALSE,
+                              G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_REMOVAL_MONITOR, properties[PROP_REMOVAL_MONITOR]);
+
+    /**
+     * QmiDevice:device-io-uring:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_IO_URING] =
+        g_param_spec_boolean (QMI_DEVICE_IO_URING,
+                              "io_uring",
+                              "Use the io_uring I/O engine, if available",
+                              FALSE,
+                              G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_IO_URING, properties[PROP_IO_URING]);
+
+    /**
+     * QmiDevice:device-stall-threshold:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_STALL_THRESHOLD] =
+        g_param_spec_uint (QMI_DEVICE_STALL_THRESHOLD,
+                           "Stall threshold",
+                           "Report callbacks blocking the main context for longer than this, in milliseconds, 0 to disable.",
+                           0,
+                           G_MAXUINT,
+                           0,
+                           G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_STALL_THRESHOLD, properties[PROP_STALL_THRESHOLD]);
+
+    /**
+     * QmiDevice:device-suspend-monitor:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_SUSPEND_MONITOR] =
+        g_param_spec_boolean (QMI_DEVICE_SUSPEND_MONITOR,
+                              "Suspend monitor",
+                              "Disable the indication registrations while the host is suspended",
+                              FALSE,
+                              G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_SUSPEND_MONITOR, properties[PROP_SUSPEND_MONITOR]);
+
+    /**
+     * QmiDevice:device-offload-threshold:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_OFFLOAD_THRESHOLD] =
+        g_param_spec_uint (QMI_DEVICE_OFFLOAD_THRESHOLD,
+                           "Offload threshold",
+                           "Parse responses at least this large, in bytes, in a worker thread, 0 to disable.",
+                           0,
+                           G_MAXINT,
+                           0,
+                           G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_OFFLOAD_THRESHOLD, properties[PROP_OFFLOAD_THRESHOLD]);
+
     /**
      * QmiDevice::indication:
      * @object: A #QmiDevice.
@@ -3198,4 +10975,59 @@ qmi_device_class_init (QmiDeviceClass *klass)
                       NULL,
                       G_TYPE_NONE,
                       0);
+
+    /**
+     * QmiDevice::device-unresponsive:
+     * @object: A #QmiDevice.
+     * @output: none
+     *
+     * The ::device-unresponsive signal is emitted when the device doesn't
+     * reply to the pings sent when #QmiDevice:device-health-check is enabled.
+     * All the requests waiting for a response at that point have already
+     * been completed with %QMI_CORE_ERROR_UNRESPONSIVE.
+     *
+     * Since: 1.20
+     */
+    signals[SIGNAL_UNRESPONSIVE] =
+        g_signal_new (QMI_DEVICE_SIGNAL_UNRESPONSIVE,
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      0);
+
+    /**
+     * QmiDevice::device-callback-stall:
+     * @object: A #QmiDevice.
+     * @service: the #QmiService of the message.
+     * @message_id: the ID of the message.
+     * @callback: the symbol name of the callback, or the type of the client or
+     *  the signal whose handlers processed the indication.
+     * @duration: time spent in the callback, in microseconds.
+     * @output: none
+     *
+     * The ::device-callback-stall signal is emitted when a request callback or
+     * an indication handler blocks its main context for longer than
+     * #QmiDevice:device-stall-threshold. It is emitted right after the
+     * callback returns, in the same main context.
+     *
+     * Since: 1.20
+     */
+    signals[SIGNAL_CALLBACK_STALL] =
+        g_signal_new (QMI_DEVICE_SIGNAL_CALLBACK_STALL,
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      4,
+                      G_TYPE_UINT,
+                      G_TYPE_UINT,
+                      G_TYPE_STRING,
+                      G_TYPE_UINT64);
 }
@@ -33,7 +33,9 @@
 #include "qmi-enums.h"
 #include "qmi-message.h"
 #include "qmi-message-context.h"
+#include "qmi-trace.h"
 #include "qmi-client.h"
+#include "qmi-proxy.h"
 
 G_BEGIN_DECLS
 
@@ -95,6 +97,248 @@ typedef struct _QmiDevicePrivate QmiDevicePrivate;
  */
 #define QMI_DEVICE_WWAN_IFACE "device-wwan-iface"
 
+/**
+ * QMI_DEVICE_MAX_IN_FLIGHT:
+ *
+ * Symbol defining the #QmiDevice:device-max-in-flight property.
+ *
+ * Since: 1.20
+ */
+#define QMI_DEVICE_MAX_IN_FLIGHT "device-max-in-flight"
+
+/**
+ * QMI_DEVICE_VERSION_INFO_CACHE_DIR:
+ *
+ * Symbol defining the #QmiDevice:device-version-info-cache-dir property.
+ *
+ * When set, opening the device with %QMI_DEVICE_OPEN_FLAGS_VERSION_INFO will
+ * use the list of supported services cached in the given directory for the
+ * same USB device, if any, instead of waiting for the device to report it. The
+ * list is then still queried in background, and the cache updated if needed.
+ *
+ * Since: 1.20
+ */
+#define QMI_DEVICE_VERSION_INFO_CACHE_DIR "device-version-info-cache-dir"
+
+/**
+ * QMI_DEVICE_CID_POOL:
+ *
+ * Symbol defining the #QmiDevice:device-cid-pool property.
+ *
+ * When enabled, releasing a client with
+ * %QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID doesn't release its CID in the
+ * device; the CID is kept instead, and given to the next client allocated for
+ * the same service with %QMI_CID_NONE. Before being reused, the CID is reset
+ * with the service, so that no state of the previous client (e.g. indication
+ * registrations) is kept; if that fails, a new CID is allocated instead. The
+ * pool is cleared when the device reports that all CIDs were released (i.e.
+ * after a CTL sync).
+ *
+ * Since: 1.20
+ */
+#define QMI_DEVICE_CID_POOL "device-cid-pool"
+
+/**
+ * QMI_DEVICE_CID_POOL_FILE:
+ *
+ * Symbol defining the #QmiDevice:device-cid-pool-file property.
+ *
+ * When set, the CID pool is also stored in the given file, so that the next
+ * #QmiDevice for the same port using the same file (e.g. after restarting the
+ * program) reuses the CIDs still allocated in the device. The same file may be
+ * shared by several ports, each one keeping its own pool.
+ *
+ * Since: 1.20
+ */
+#define QMI_DEVICE_CID_POOL_FILE "device-cid-pool-file"
+
+/**
+ * QMI_DEVICE_COALESCE_REQUESTS:
+ *
+ * Symbol defining the #QmiDevice:device-coalesce-requests property.
+ *
+ * When enabled, an idempotent request (e.g. DMS Get IDs or NAS Get Serving
+ * System) that is identical to another one already ongoing, i.e. with the same
+ * service, message ID and TLVs, is not sent to the device; it just gets the
+ * same response as the ongoing one. Only requests querying state of the whole
+ * device are idempotent, never the ones about the session of the client
+ * sending them (e.g. WDS Get Packet Service Status). The timeout and
+ * cancellation of each request still apply as usual.
+ *
+ * Since: 1.20
+ */
+#define QMI_DEVICE_COALESCE_REQUESTS "device-coalesce-requests"
+
+/**
+ * QMI_DEVICE_RESPONSE_CACHE:
+ *
+ * Symbol defining the #QmiDevice:device-response-cache property.
+ *
+ * When enabled, successful responses to requests that query information which
+ * rarely changes (e.g. DMS Get IDs or DMS Get Revision) are kept for a while,
+ * and identical requests sent meanwhile are answered without reaching the
+ * device. The cache is cleared whenever the device is reset, its operating
+ * mode changes, or it is closed or removed.
+ *
+ * Since: 1.20
+ */
+#define QMI_DEVICE_RESPONSE_CACHE "device-response-cache"
+
+/**
+ * QMI_DEVICE_INDICATION_CACHE:
+ *
+ * Symbol defining the #QmiDevice:device-indication-cache property.
+ *
+ * When enabled, the last indication received of each of the ones reporting
+ * the current state of the device (NAS Serving System, NAS System Info, NAS
+ * Signal Info, WDS Packet Service Status and DMS Event Report) is kept, and
+ * reported again to each new client of the same service right after it is
+ * allocated, so that it doesn't need to query that state itself. The cache is
+ * cleared when the device is closed or removed.
+ *
+ * Since: 1.20
+ */
+#define QMI_DEVICE_INDICATION_CACHE "device-indication-cache"
+
+/**
+ * QMI_DEVICE_ADAPTIVE_TIMEOUTS:
+ *
+ * Symbol defining the #QmiDevice:device-adaptive-timeouts property.
+ *
+ * When enabled, the device keeps the latencies of the most recent responses
+ * to each message, and once enough of them are known, requests no longer
+ * time out after the time given by the caller, but after the 99th percentile
+ * of those latencies times a multiplier, within some bounds; see
+ * qmi_device_set_adaptive_timeout_params(). A wedged device is therefore
+ * detected as soon as it is clearly slower than usual. Each time a request
+ * times out, the next one of the same message gets twice as much time, so
+ * that slow operations still complete. Requests without a timeout are never
+ * given one.
+ *
+ * Since: 1.20
+ */
+#define QMI_DEVICE_ADAPTIVE_TIMEOUTS "device-adaptive-timeouts"
+
+/**
+ * QMI_DEVICE_HEALTH_CHECK:
+ *
+ * Symbol defining the #QmiDevice:device-health-check property.
+ *
+ * When enabled, a CTL Get Version Info request is sent to the device whenever
+ * nothing is received from it for a while: either when idle, or, sooner, when
+ * requests are waiting for a response; see
+ * qmi_device_set_health_check_params(). If the device doesn't reply to it in
+ * time, all the requests waiting for a response are completed right away with
+ * %QMI_CORE_ERROR_UNRESPONSIVE and the #QmiDevice::device-unresponsive signal
+ * is emitted, instead of letting each request wait for its own timeout.
+ *
+ * The health check starts with the next message sent or received.
+ *
+ * Since: 1.20
+ */
+#define QMI_DEVICE_HEALTH_CHECK "device-health-check"
+
+/**
+ * QMI_DEVICE_REMOVAL_MONITOR:
+ *
+ * Symbol defining the #QmiDevice:device-removal-monitor property.
+ *
+ * When enabled, the device file is monitored while the device is open, and
+ * as soon as it is removed, e.g. when the USB device is unplugged or its
+ * driver unbound, all the requests waiting for a response are completed with
+ * %QMI_CORE_ERROR_WRONG_STATE and the #QmiDevice::device-removed signal is
+ * emitted, instead of waiting for the connection to be reported as broken.
+ *
+ * The file is monitored from the
+ * <link linkend="g-main-context-push-thread-default">thread-default main context</link>
+ * where the device is opened.
+ *
+ * Since: 1.20
+ */
+#define QMI_DEVICE_REMOVAL_MONITOR "device-removal-monitor"
+
+/**
+ * QMI_DEVICE_IO_URING:
+ *
+ * Symbol defining the #QmiDevice:device-io-uring property.
+ *
+ * When enabled, reads and writes of the device file, or of the connection to
+ * the proxy, are submitted through one io_uring per main context instead of
+ * being driven by poll() wakeups: a read is kept armed at all times and the
+ * data received is processed as soon as its completion is dispatched, and
+ * all the writes queued while the context is busy are submitted together.
+ *
+ * Only available if the library was built with io_uring support; otherwise,
+ * or if the io_uring cannot be created, the default engine is used. The
+ * io_uring is also skipped if the LIBQMI_DISABLE_IO_URING environment
+ * variable is set when it would be created. Must be set before the device is
+ * opened. Devices using io_uring cannot be handed
+ * over to another process.
+ *
+ * Since: 1.20
+ */
+#define QMI_DEVICE_IO_URING "device-io-uring"
+
+/**
+ * QMI_DEVICE_STALL_THRESHOLD:
+ *
+ * Symbol defining the #QmiDevice:device-stall-threshold property.
+ *
+ * When set to a non-zero value, in milliseconds, the time spent running the
+ * callbacks of the requests and the handlers of the indications is measured,
+ * and every one that blocks its main context for longer than that is
+ * reported with the #QmiDevice::device-callback-stall signal and counted in
+ * the #QmiDeviceStats of the device.
+ *
+ * Only requests issued after setting the property are measured. The time
+ * measured is the one spent in the callback given to qmi_device_command_full(),
+ * or to the client method, if completed in the same main loop iteration.
+ *
+ * Since: 1.20
+ */
+#define QMI_DEVICE_STALL_THRESHOLD "device-stall-threshold"
+
+/**
+ * QMI_DEVICE_SUSPEND_MONITOR:
+ *
+ * Symbol defining the #QmiDevice:device-suspend-monitor property.
+ *
+ * When enabled, the host suspend and resume are monitored through the
+ * systemd-logind <literal>PrepareForSleep</literal> signal while the device
+ * is open, and the device is switched to low-power mode with
+ * qmi_device_set_low_power() before the host suspends, and back after it
+ * resumes. A suspend delay inhibitor is held so that the host waits for the
+ * indication registrations to be disabled before suspending.
+ *
+ * The signals are monitored from the
+ * <link linkend="g-main-context-push-thread-default">thread-default main context</link>
+ * where the device is opened.
+ *
+ * Since: 1.20
+ */
+#define QMI_DEVICE_SUSPEND_MONITOR "device-suspend-monitor"
+
+/**
+ * QMI_DEVICE_OFFLOAD_THRESHOLD:
+ *
+ * Symbol defining the #QmiDevice:device-offload-threshold property.
+ *
+ * When set to a non-zero value, in bytes, responses at least that large
+ * received for the requests of the generated clients are parsed in a worker
+ * thread, shared by all devices, instead of in the context of the caller;
+ * the output is still reported in the context of the caller. This keeps
+ * large responses, e.g. network scans or cell information, from blocking
+ * the processing of every other message in that context. Responses of the
+ * messages given with qmi_device_set_offloaded_message() are always parsed
+ * in a worker thread. All other responses are parsed right away.
+ *
+ * Responses parsed in a worker thread may be reported after other responses
+ * received later.
+ *
+ * Since: 1.20
+ */
+#define QMI_DEVICE_OFFLOAD_THRESHOLD "device-offload-threshold"
+
 /**
  * QMI_DEVICE_SIGNAL_INDICATION:
  *
@@ -113,6 +357,24 @@ typedef struct _QmiDevicePrivate QmiDevicePrivate;
  */
 #define QMI_DEVICE_SIGNAL_REMOVED "device-removed"
 
+/**
+ * QMI_DEVICE_SIGNAL_UNRESPONSIVE:
+ *
+ * Symbol defining the #QmiDevice::device-unresponsive signal.
+ *
+ * Since: 1.20
+ */
+#define QMI_DEVICE_SIGNAL_UNRESPONSIVE "device-unresponsive"
+
+/**
+ * QMI_DEVICE_SIGNAL_CALLBACK_STALL:
+ *
+ * Symbol defining the #QmiDevice::device-callback-stall signal.
+ *
+ * Since: 1.20
+ */
+#define QMI_DEVICE_SIGNAL_CALLBACK_STALL "device-callback-stall"
+
 /**
  * QmiDevice:
  *
@@ -145,6 +407,11 @@ GType qmi_device_get_type (void);
  * When the operation is finished, @callback will be invoked. You can then call
  * qmi_device_new_finish() to get the result of the operation.
  *
+ * Modems integrated in the SoC, exposing their QMI services through QRTR
+ * instead of a control port, are given as a <literal>qrtr://</literal> URI
+ * with the number of the QRTR node (e.g. <literal>qrtr://0</literal>), if
+ * supported by the system. Since: 1.20.
+ *
  * Since: 1.0
  */
 void qmi_device_new (GFile               *file,
@@ -220,7 +487,10 @@ const gchar *qmi_device_get_path_display (QmiDevice *self);
  * @self: a #QmiDevice.
  *
  * Get the WWAN interface name associated with this /dev/cdc-wdm control port.
- * This value will be loaded every time it's asked for it.
+ * The value is cached, and it is validated every time it's asked for it, so
+ * that network interface renames are detected. The validation and, if needed,
+ * the lookup are done in sysfs, blocking the caller; see
+ * qmi_device_load_wwan_iface() for the asynchronous version.
  *
  * Returns: UTF-8 encoded network interface name, or %NULL if not available.
  *
@@ -252,6 +522,7 @@ gboolean qmi_device_is_open (QmiDevice *self);
  * @QMI_DEVICE_OPEN_FLAGS_PROXY: Try to open the port through the 'qmi-proxy'. Since: 1.8.
  * @QMI_DEVICE_OPEN_FLAGS_MBIM: open an MBIM port with QMUX tunneling service. Since: 1.16.
  * @QMI_DEVICE_OPEN_FLAGS_AUTO: open a port either in QMI or MBIM mode, depending on device driver. Since: 1.18.
+ * @QMI_DEVICE_OPEN_FLAGS_IO_THREAD: run all the I/O of the port in a dedicated thread, so that qmi_device_command_full() can be called from any thread. Not applicable in MBIM mode. Since: 1.20.
  *
  * Flags to specify which actions to be performed when the device is open.
  *
@@ -268,6 +539,7 @@ typedef enum {
     QMI_DEVICE_OPEN_FLAGS_PROXY             = 1 << 6,
     QMI_DEVICE_OPEN_FLAGS_MBIM              = 1 << 7,
     QMI_DEVICE_OPEN_FLAGS_AUTO              = 1 << 8,
+    QMI_DEVICE_OPEN_FLAGS_IO_THREAD         = 1 << 9,
 } QmiDeviceOpenFlags;
 
 /**
@@ -315,6 +587,55 @@ gboolean qmi_device_open_finish (QmiDevice     *self,
                                  GAsyncResult  *res,
                                  GError       **error);
 
+/**
+ * qmi_device_new_shared:
+ * @file: a #GFile.
+ * @flags: mask of #QmiDeviceOpenFlags specifying how the device should be opened.
+ * @timeout: maximum time, in seconds, to wait for the device to be opened.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously gets an open #QmiDevice to manage @file, shared with all the
+ * other consumers in the same process asking for the same path.
+ *
+ * The first consumer creates and opens the device with the given @flags and
+ * @timeout; the ones asking for it meanwhile wait for that same operation,
+ * and the ones asking for it afterwards get it right away, regardless of the
+ * @flags they give. This avoids e.g. several connections to the proxy, CTL
+ * clients or version info queries for the same device within one process.
+ *
+ * Each consumer gets its own reference, and allocates and releases its own
+ * clients as usual. The device must not be closed explicitly: it is closed
+ * once the last reference is dropped. If the device is removed, the next
+ * consumers get a new one.
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * qmi_device_new_shared_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_new_shared (GFile               *file,
+                            QmiDeviceOpenFlags   flags,
+                            guint                timeout,
+                            GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data);
+
+/**
+ * qmi_device_new_shared_finish:
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_new_shared().
+ *
+ * Returns: (transfer full): an open #QmiDevice, or #NULL if @error is set. The returned value should be freed with g_object_unref().
+ *
+ * Since: 1.20
+ */
+QmiDevice *qmi_device_new_shared_finish (GAsyncResult  *res,
+                                         GError       **error);
+
 /**
  * qmi_device_close:
  * @self: a #QmiDevice
@@ -353,6 +674,10 @@ gboolean qmi_device_close (QmiDevice  *self,
  *
  * Closing a #QmiDevice multiple times will not return an error.
  *
+ * Since 1.20, all the requests still waiting for a response are completed
+ * right away with a %QMI_CORE_ERROR_WRONG_STATE error, instead of waiting for
+ * their own timeouts.
+ *
  * When the operation is finished @callback will be called. You can then call
  * qmi_device_close_finish() to get the result of the operation.
  *
@@ -427,6 +752,60 @@ QmiClient *qmi_device_allocate_client_finish (QmiDevice     *self,
                                               GAsyncResult  *res,
                                               GError       **error);
 
+/**
+ * qmi_device_allocate_clients:
+ * @self: a #QmiDevice.
+ * @services: (array length=n_services): array of valid #QmiService values.
+ * @n_services: number of elements in @services.
+ * @timeout: maximum time to wait for each client ID allocation.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously allocates one new #QmiClient in @self for each of the
+ * services given in @services. The same service may be given multiple times,
+ * e.g. to get several #QmiClientWds objects.
+ *
+ * All the client ID allocation requests are sent right away, without waiting
+ * for the previous ones to be replied, so allocating multiple clients this way
+ * is much faster than doing it one by one with qmi_device_allocate_client().
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * qmi_device_allocate_clients_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_allocate_clients (QmiDevice           *self,
+                                  const QmiService    *services,
+                                  guint                n_services,
+                                  guint                timeout,
+                                  GCancellable        *cancellable,
+                                  GAsyncReadyCallback  callback,
+                                  gpointer             user_data);
+
+/**
+ * qmi_device_allocate_clients_finish:
+ * @self: a #QmiDevice.
+ * @res: a #GAsyncResult.
+ * @errors: (out) (optional) (element-type GError) (transfer full): return location for an array with the individual allocation errors, or %NULL.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_allocate_clients().
+ *
+ * The returned array has one element for each of the services requested, in
+ * the same order. Elements for clients that couldn't be allocated are %NULL,
+ * and the corresponding elements in @errors give the reason why; the elements
+ * in @errors for clients properly allocated are %NULL.
+ *
+ * Returns: (element-type QmiClient) (transfer full): a #GPtrArray of #QmiClient elements, or %NULL if none of the clients could be allocated and @error is set. The returned value should be freed with g_ptr_array_unref().
+ *
+ * Since: 1.20
+ */
+GPtrArray *qmi_device_allocate_clients_finish (QmiDevice     *self,
+                                               GAsyncResult  *res,
+                                               GPtrArray    **errors,
+                                               GError       **error);
+
 /**
  * QmiDeviceReleaseClientFlags:
  * @QMI_DEVICE_RELEASE_CLIENT_FLAGS_NONE: No flags.
@@ -495,6 +874,63 @@ gboolean qmi_device_release_client_finish (QmiDevice     *self,
                                            GAsyncResult  *res,
                                            GError       **error);
 
+/**
+ * qmi_device_release_clients:
+ * @self: a #QmiDevice.
+ * @clients: (array length=n_clients): array of #QmiClient objects.
+ * @n_clients: number of elements in @clients.
+ * @flags: mask of #QmiDeviceReleaseClientFlags specifying how the clients should be released.
+ * @timeout: maximum time to wait for each client ID release.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously releases all the #QmiClient objects given in @clients, as
+ * with qmi_device_release_client().
+ *
+ * All the client ID release requests are sent right away, without waiting
+ * for the previous ones to be replied, so releasing multiple clients this way
+ * is much faster than doing it one by one with qmi_device_release_client().
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * qmi_device_release_clients_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_release_clients (QmiDevice                   *self,
+                                 QmiClient                  **clients,
+                                 guint                        n_clients,
+                                 QmiDeviceReleaseClientFlags  flags,
+                                 guint                        timeout,
+                                 GCancellable                *cancellable,
+                                 GAsyncReadyCallback          callback,
+                                 gpointer                     user_data);
+
+/**
+ * qmi_device_release_clients_finish:
+ * @self: a #QmiDevice.
+ * @res: a #GAsyncResult.
+ * @errors: (out) (optional) (element-type GError) (transfer full): return location for an array with the individual release errors, or %NULL.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_release_clients().
+ *
+ * The array returned in @errors has one element for each of the clients
+ * given, in the same order; the elements for clients properly released are
+ * %NULL.
+ *
+ * Note that even if the release operation returns an error, all the clients
+ * should anyway be considered released, and shouldn't be used afterwards.
+ *
+ * Returns: %TRUE if all the clients were released, or %FALSE if any release failed and @error is set.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_device_release_clients_finish (QmiDevice     *self,
+                                            GAsyncResult  *res,
+                                            GPtrArray    **errors,
+                                            GError       **error);
+
 /**
  * qmi_device_set_instance_id:
  * @self: a #QmiDevice.
@@ -586,19 +1022,32 @@ QmiMessage  *qmi_device_command_finish (QmiDevice     *self,
  * @message_context: the context of the message.
  * @timeout: maximum time, in seconds, to wait for the response.
  * @cancellable: a #GCancellable, or %NULL.
- * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @callback: (nullable): a #GAsyncReadyCallback to call when the operation is finished, or %NULL if @message_context has the no-reply flag set.
  * @user_data: the data to pass to callback function.
  *
  * Asynchronously sends a #QmiMessage to the device.
  *
  * The message will be processed according to the specific @message_context
- * given.
+ * given. If the request needs to wait before being sent, the priority in
+ * @message_context decides which pending requests are sent first, see
+ * #QmiMessagePriority.
+ *
+ * If @message_context has the no-reply flag set, see
+ * qmi_message_context_set_no_reply(), the result is never reported and
+ * @callback is ignored. These requests are never coalesced nor answered from
+ * the response cache.
  *
  * When the operation is finished @callback will be called. You can then call
  * qmi_device_command_full_finish() to get the result of the operation.
  *
  * If no @context given, the behavior is the same as qmi_device_command().
  *
+ * If the device was opened with %QMI_DEVICE_OPEN_FLAGS_IO_THREAD, this method
+ * may be called from any thread, and @callback will be called in the
+ * thread-default main context of the caller thread. Indications and all
+ * other operations are still processed in the context where the device was
+ * opened.
+ *
  * Since: 1.18
  */
 void qmi_device_command_full (QmiDevice           *self,
@@ -626,63 +1075,789 @@ QmiMessage *qmi_device_command_full_finish (QmiDevice     *self,
                                             GError       **error);
 
 /**
- * QmiDeviceServiceVersionInfo:
- * @service: a #QmiService.
- * @major_version: major version of the service.
- * @minor_version: minor version of the service.
+ * qmi_device_command_full_sync:
+ * @self: a #QmiDevice.
+ * @message: the message to send.
+ * @message_context: the context of the message.
+ * @timeout: maximum time, in seconds, to wait for the response.
+ * @cancellable: a #GCancellable, or %NULL.
+ * @error: Return location for error or %NULL.
  *
- * Version information for a service.
+ * Synchronously sends a #QmiMessage to the device, blocking the calling
+ * thread until the response is received, without requiring any main loop
+ * running in that thread.
  *
- * Since: 1.6
+ * The device must have been opened with %QMI_DEVICE_OPEN_FLAGS_IO_THREAD; the
+ * request is processed and completed in the I/O thread, and this method may
+ * be called from any other thread, e.g. from several worker threads at the
+ * same time.
+ *
+ * Returns: a #QmiMessage response, or #NULL if @error is set. The returned value should be freed with qmi_message_unref().
+ *
+ * Since: 1.20
  */
-typedef struct {
-    QmiService service;
-    guint16    major_version;
-    guint16    minor_version;
-} QmiDeviceServiceVersionInfo;
+QmiMessage *qmi_device_command_full_sync (QmiDevice          *self,
+                                          QmiMessage         *message,
+                                          QmiMessageContext  *message_context,
+                                          guint               timeout,
+                                          GCancellable       *cancellable,
+                                          GError            **error);
 
 /**
- * qmi_device_get_service_version_info:
+ * qmi_device_command_batch:
  * @self: a #QmiDevice.
- * @timeout: maximum time to wait for the method to complete, in seconds.
- * @cancellable: a #GCancellable or %NULL.
- * @callback: a #GAsyncReadyCallback to call when the request is satisfied.
- * @user_data: user data to pass to @callback.
+ * @messages: (array length=n_messages): the messages to send.
+ * @message_contexts: (array length=n_messages) (allow-none): the context of each message, which may be %NULL, or %NULL if none of the messages has a context.
+ * @n_messages: number of elements in @messages.
+ * @timeout: maximum time, in seconds, to wait for each response.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
  *
- * Asynchronously requests the service version information of the device.
+ * Asynchronously sends several independent requests to the device, and
+ * waits for all their responses.
  *
- * When the operation is finished, @callback will be invoked in the thread-default main loop of the thread you are calling this method from.
+ * Each request is processed as if sent with qmi_device_command_full(), but
+ * all of them are queued before writing any, so that they are written back
+ * to back, and the operation completes once, when all the requests are
+ * completed. Requests flagged as not expecting a reply are not waited for,
+ * and they get neither response nor error.
  *
- * You can then call qmi_device_get_service_version_info_finish() to get the result of the operation.
+ * When the operation is finished @callback will be called. You can then call
+ * qmi_device_command_batch_finish() to get the result of the operation.
  *
- * Since: 1.6
+ * Since: 1.20
  */
-void qmi_device_get_service_version_info (QmiDevice           *self,
-                                          guint                timeout,
-                                          GCancellable        *cancellable,
-                                          GAsyncReadyCallback  callback,
-                                          gpointer             user_data);
+void qmi_device_command_batch (QmiDevice           *self,
+                               QmiMessage         **messages,
+                               QmiMessageContext  **message_contexts,
+                               guint                n_messages,
+                               guint                timeout,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data);
 
 /**
- * qmi_device_get_service_version_info_finish:
+ * qmi_device_command_batch_finish:
  * @self: a #QmiDevice.
  * @res: a #GAsyncResult.
+ * @errors: (out) (optional) (element-type GError) (transfer full): return location for an array with the individual request errors, or %NULL.
  * @error: Return location for error or %NULL.
  *
- * Finishes an operation started with qmi_device_get_service_version_info().
+ * Finishes an operation started with qmi_device_command_batch().
  *
- * Returns: a #GArray of #QmiDeviceServiceVersionInfo elements, or #NULL if @error is set. The returned value should be freed with g_array_unref().
+ * The returned array has one element for each of the messages given, in the
+ * same order. Elements for requests that failed are %NULL, and the
+ * corresponding elements in @errors give the reason why; the elements in
+ * @errors for requests properly replied are %NULL.
  *
- * Since: 1.6
+ * Returns: (element-type QmiMessage) (transfer full): a #GPtrArray of #QmiMessage responses, or %NULL if all the requests failed and @error is set. The returned value should be freed with g_ptr_array_unref().
+ *
+ * Since: 1.20
  */
-GArray *qmi_device_get_service_version_info_finish (QmiDevice     *self,
-                                                    GAsyncResult  *res,
-                                                    GError       **error);
+GPtrArray *qmi_device_command_batch_finish (QmiDevice     *self,
+                                            GAsyncResult  *res,
+                                            GPtrArray    **errors,
+                                            GError       **error);
+
 /**
- * QmiDeviceExpectedDataFormat:
- * @QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN: Unknown.
- * @QMI_DEVICE_EXPECTED_DATA_FORMAT_802_3: 802.3.
- * @QMI_DEVICE_EXPECTED_DATA_FORMAT_RAW_IP: Raw IP.
+ * qmi_device_set_low_power:
+ * @self: a #QmiDevice.
+ * @low_power: %TRUE to enter low-power mode, %FALSE to leave it.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously enters or leaves low-power mode, e.g. while the host is
+ * idle or suspended.
+ *
+ * The indication registrations sent by the clients of the device are
+ * recorded, i.e. the NAS Register Indications request and the NAS, WDS and
+ * DMS Set Event Report requests. When entering low-power mode, all the
+ * reports enabled with them are disabled in one single burst of requests,
+ * so that the device doesn't wake up the host for them; and when leaving
+ * it, the last registrations of each client are sent again.
+ *
+ * Registrations sent by the clients while in low-power mode are applied
+ * right away.
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * qmi_device_set_low_power_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_set_low_power (QmiDevice           *self,
+                               gboolean             low_power,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data);
+
+/**
+ * qmi_device_set_low_power_finish:
+ * @self: a #QmiDevice.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_set_low_power(). The mode is
+ * switched even if some of the registrations couldn't be updated.
+ *
+ * Returns: %TRUE if all the registrations were updated, %FALSE if @error is set.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_device_set_low_power_finish (QmiDevice     *self,
+                                          GAsyncResult  *res,
+                                          GError       **error);
+
+/**
+ * qmi_device_check_message_supported:
+ * @self: a #QmiDevice.
+ * @message: a #QmiMessage.
+ * @message_context: (allow-none): the context of the message, or %NULL.
+ * @error: Return location for error or %NULL.
+ *
+ * Checks whether the version of the service reported by the device when it
+ * was opened is enough for @message, the same way it's checked before
+ * sending it with qmi_device_command_full(). This allows skipping requests
+ * that would fail right away, e.g. when setting up periodic polling.
+ *
+ * If the service versions weren't retrieved when opening the device, all
+ * messages are assumed to be supported.
+ *
+ * Returns: %TRUE if @message is supported, %FALSE if @error is set.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_device_check_message_supported (QmiDevice          *self,
+                                             QmiMessage         *message,
+                                             QmiMessageContext  *message_context,
+                                             GError            **error);
+
+/**
+ * qmi_device_set_service_max_in_flight:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService.
+ * @max_in_flight: maximum number of requests, or 0 to disable the limit.
+ *
+ * Sets the maximum number of requests of the given @service that may be sent
+ * to the device without having received their responses yet.
+ *
+ * Requests exceeding this limit, or the global one set in the
+ * #QmiDevice:device-max-in-flight property, are queued and sent in order as
+ * soon as the ongoing ones are completed. The timeout given when the request
+ * was issued also applies while the request is queued.
+ *
+ * Since: 1.20
+ */
+void qmi_device_set_service_max_in_flight (QmiDevice  *self,
+                                           QmiService  service,
+                                           guint       max_in_flight);
+
+/**
+ * QmiDeviceStats:
+ * @since: monotonic time when the statistics were last reset, in microseconds.
+ * @frames_sent: number of QMI frames sent.
+ * @frames_received: number of QMI frames received.
+ * @bytes_sent: number of bytes sent.
+ * @bytes_received: number of bytes received.
+ * @n_requests: number of requests sent.
+ * @n_responses: number of responses matched to a request.
+ * @n_timeouts: number of requests that timed out.
+ * @n_aborts: number of requests that were aborted or cancelled.
+ * @n_indications: number of indications received.
+ * @n_indications_dropped: number of indications dropped, or replaced by a newer one, because the queue of the client was full; see qmi_client_set_indication_queue_limit().
+ * @n_coalesced: number of requests not sent because an identical one was already ongoing.
+ * @n_cached: number of requests answered from the response cache.
+ * @n_no_reply_errors: number of requests sent without reporting the result to the caller that failed, with an error in the response, a timeout or an abort.
+ * @n_callback_stalls: number of callbacks that ran for longer than #QmiDevice:device-stall-threshold.
+ * @callback_stall_max: longest time spent in a single callback reported as stalled, in microseconds.
+ * @n_offloaded: number of responses parsed in a worker thread; see #QmiDevice:device-offload-threshold.
+ * @n_in_flight: number of requests currently waiting for a response.
+ * @output_queue_length: number of messages currently waiting to be written.
+ * @throttled_queue_length: number of requests currently waiting for an in-flight slot.
+ * @pending_indications_length: number of indications currently waiting to be reported to clients.
+ *
+ * Traffic statistics of a #QmiDevice.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    gint64  since;
+    guint64 frames_sent;
+    guint64 frames_received;
+    guint64 bytes_sent;
+    guint64 bytes_received;
+    guint64 n_requests;
+    guint64 n_responses;
+    guint64 n_timeouts;
+    guint64 n_aborts;
+    guint64 n_indications;
+    guint64 n_indications_dropped;
+    guint64 n_coalesced;
+    guint64 n_cached;
+    guint64 n_no_reply_errors;
+    guint64 n_callback_stalls;
+    guint64 callback_stall_max;
+    guint64 n_offloaded;
+    guint   n_in_flight;
+    guint   output_queue_length;
+    guint   throttled_queue_length;
+    guint   pending_indications_length;
+} QmiDeviceStats;
+
+/**
+ * QMI_DEVICE_LATENCY_HISTOGRAM_SIZE:
+ *
+ * Number of buckets in the latency histogram of #QmiDeviceMessageStats.
+ *
+ * Since: 1.20
+ */
+#define QMI_DEVICE_LATENCY_HISTOGRAM_SIZE 8
+
+/**
+ * QmiDeviceMessageStats:
+ * @service: a #QmiService.
+ * @message_id: the message ID.
+ * @n_requests: number of requests sent.
+ * @n_responses: number of responses matched to a request.
+ * @n_timeouts: number of requests that timed out.
+ * @n_aborts: number of requests that were aborted or cancelled.
+ * @n_indications: number of indications received with this message ID.
+ * @latency_min: minimum response latency, in microseconds.
+ * @latency_max: maximum response latency, in microseconds.
+ * @latency_total: sum of all response latencies, in microseconds.
+ * @latency_histogram: number of responses by latency; bucket i counts latencies below 4^i milliseconds, and the last bucket all the longer ones.
+ *
+ * Traffic statistics of a given message in a #QmiDevice. Latencies are
+ * measured from the moment the request is sent to the device, not including
+ * the time spent waiting for an in-flight slot, until the response is matched.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    QmiService service;
+    guint16    message_id;
+    guint64    n_requests;
+    guint64    n_responses;
+    guint64    n_timeouts;
+    guint64    n_aborts;
+    guint64    n_indications;
+    guint64    latency_min;
+    guint64    latency_max;
+    guint64    latency_total;
+    guint64    latency_histogram[QMI_DEVICE_LATENCY_HISTOGRAM_SIZE];
+} QmiDeviceMessageStats;
+
+/**
+ * qmi_device_get_stats:
+ * @self: a #QmiDevice.
+ * @stats: (out caller-allocates): return location for the #QmiDeviceStats.
+ *
+ * Gets the traffic statistics of the device since it was created, or since
+ * qmi_device_reset_stats() was last called.
+ *
+ * This method may be called from any thread.
+ *
+ * Since: 1.20
+ */
+void qmi_device_get_stats (QmiDevice      *self,
+                           QmiDeviceStats *stats);
+
+/**
+ * qmi_device_get_message_stats:
+ * @self: a #QmiDevice.
+ *
+ * Gets the traffic statistics of each message sent or received by the
+ * device since it was created, or since qmi_device_reset_stats() was last
+ * called.
+ *
+ * This method may be called from any thread.
+ *
+ * Returns: (transfer full) (element-type QmiDeviceMessageStats): a #GArray of #QmiDeviceMessageStats elements. The returned value should be freed with g_array_unref().
+ *
+ * Since: 1.20
+ */
+GArray *qmi_device_get_message_stats (QmiDevice *self);
+
+/**
+ * qmi_device_get_cached_indications:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService.
+ *
+ * Gets the indications of @service kept in the cache, when the
+ * #QmiDevice:device-indication-cache property is enabled, as they were
+ * received from the device.
+ *
+ * This method may be called from any thread.
+ *
+ * Returns: (transfer full) (element-type QmiMessage): a #GPtrArray of #QmiMessage elements, possibly empty. The returned value should be freed with g_ptr_array_unref().
+ *
+ * Since: 1.20
+ */
+GPtrArray *qmi_device_get_cached_indications (QmiDevice  *self,
+                                              QmiService  service);
+
+/**
+ * qmi_device_reset_stats:
+ * @self: a #QmiDevice.
+ *
+ * Resets all the traffic statistics of the device, except for the current
+ * queue lengths.
+ *
+ * Since: 1.20
+ */
+void qmi_device_reset_stats (QmiDevice *self);
+
+/**
+ * QmiDeviceTransactionInfo:
+ * @service: a #QmiService.
+ * @message_id: the message ID.
+ * @client_id: the client ID.
+ * @transaction_id: the transaction ID.
+ * @in_flight: %TRUE if the request was already sent to the device, %FALSE if it is still waiting to be sent.
+ * @age: time since the request was issued, in microseconds.
+ * @timeout_remaining: time left until the request times out, in microseconds, or -1 if it has no timeout.
+ * @proxy_client_pid: process ID of the qmi-proxy client that issued the request, or 0 if unknown or not given through qmi-proxy.
+ *
+ * A request waiting for its response in a #QmiDevice.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    QmiService service;
+    guint16    message_id;
+    guint8     client_id;
+    guint16    transaction_id;
+    gboolean   in_flight;
+    guint64    age;
+    gint64     timeout_remaining;
+    guint32    proxy_client_pid;
+} QmiDeviceTransactionInfo;
+
+/**
+ * qmi_device_get_transactions:
+ * @self: a #QmiDevice.
+ * @timeout: maximum time to wait for the method to complete, in seconds.
+ * @cancellable: a #GCancellable or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the request is satisfied.
+ * @user_data: user data to pass to @callback.
+ *
+ * Asynchronously gets a snapshot of the requests waiting for a response,
+ * either queued or already written to the device.
+ *
+ * When the device was opened with %QMI_DEVICE_OPEN_FLAGS_PROXY, and the proxy
+ * in use supports it, the snapshot is taken by qmi-proxy, and it includes the
+ * requests of all its clients. Note that qmi-proxy uses its own timeout for
+ * the requests it forwards, not the one given by its clients.
+ *
+ * When the operation is finished, @callback will be invoked in the thread-default main loop of the thread you are calling this method from.
+ *
+ * You can then call qmi_device_get_transactions_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_get_transactions (QmiDevice           *self,
+                                  guint                timeout,
+                                  GCancellable        *cancellable,
+                                  GAsyncReadyCallback  callback,
+                                  gpointer             user_data);
+
+/**
+ * qmi_device_get_transactions_finish:
+ * @self: a #QmiDevice.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_get_transactions().
+ *
+ * Returns: (transfer full) (element-type QmiDeviceTransactionInfo): a #GArray of #QmiDeviceTransactionInfo elements, or %NULL if @error is set. The returned value should be freed with g_array_unref().
+ *
+ * Since: 1.20
+ */
+GArray *qmi_device_get_transactions_finish (QmiDevice     *self,
+                                            GAsyncResult  *res,
+                                            GError       **error);
+
+/**
+ * qmi_device_get_proxy_stats:
+ * @self: a #QmiDevice.
+ * @timeout: maximum time to wait for the method to complete, in seconds.
+ * @cancellable: a #GCancellable or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the request is satisfied.
+ * @user_data: user data to pass to @callback.
+ *
+ * Asynchronously gets the traffic statistics of qmi-proxy, as given by
+ * qmi_proxy_get_device_stats() and qmi_proxy_get_client_stats() in the
+ * proxy process.
+ *
+ * This is only supported when the device was opened with
+ * %QMI_DEVICE_OPEN_FLAGS_PROXY, and the proxy in use supports it; otherwise
+ * the operation fails with %QMI_CORE_ERROR_UNSUPPORTED.
+ *
+ * When the operation is finished, @callback will be invoked in the thread-default main loop of the thread you are calling this method from.
+ *
+ * You can then call qmi_device_get_proxy_stats_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_get_proxy_stats (QmiDevice           *self,
+                                 guint                timeout,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data);
+
+/**
+ * qmi_device_get_proxy_stats_finish:
+ * @self: a #QmiDevice.
+ * @res: a #GAsyncResult.
+ * @out_device_stats: (out) (optional) (transfer full) (element-type QmiProxyDeviceStats): return location for a #GArray of #QmiProxyDeviceStats elements, or %NULL. The returned value should be freed with g_array_unref().
+ * @out_client_stats: (out) (optional) (transfer full) (element-type QmiProxyClientStats): return location for a #GArray of #QmiProxyClientStats elements, or %NULL. The returned value should be freed with g_array_unref().
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_get_proxy_stats().
+ *
+ * Returns: %TRUE if the statistics were retrieved, %FALSE if @error is set.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_device_get_proxy_stats_finish (QmiDevice     *self,
+                                            GAsyncResult  *res,
+                                            GArray       **out_device_stats,
+                                            GArray       **out_client_stats,
+                                            GError       **error);
+
+/**
+ * qmi_device_set_adaptive_timeout_params:
+ * @self: a #QmiDevice.
+ * @multiplier: factor applied to the 99th percentile of the latencies, at least 1.
+ * @min_timeout: minimum timeout, in milliseconds.
+ * @max_timeout: maximum timeout, in milliseconds, or 0 to never go beyond the timeout given by the caller.
+ *
+ * Sets how timeouts are derived when #QmiDevice:device-adaptive-timeouts is
+ * enabled. By default, @multiplier is 4, @min_timeout 1000 and @max_timeout 0.
+ *
+ * This method may be called from any thread.
+ *
+ * Since: 1.20
+ */
+void qmi_device_set_adaptive_timeout_params (QmiDevice *self,
+                                             gdouble    multiplier,
+                                             guint      min_timeout,
+                                             guint      max_timeout);
+
+/**
+ * qmi_device_get_adaptive_timeout:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService.
+ * @message_id: the message ID.
+ *
+ * Gets the timeout currently derived for the given message when
+ * #QmiDevice:device-adaptive-timeouts is enabled. The timeout given by the
+ * caller is still used when shorter, unless a maximum bound was set with
+ * qmi_device_set_adaptive_timeout_params().
+ *
+ * This method may be called from any thread.
+ *
+ * Returns: the timeout, in milliseconds, or 0 if not enough latencies are known yet.
+ *
+ * Since: 1.20
+ */
+guint qmi_device_get_adaptive_timeout (QmiDevice  *self,
+                                       QmiService  service,
+                                       guint16     message_id);
+
+/**
+ * qmi_device_set_health_check_params:
+ * @self: a #QmiDevice.
+ * @idle_timeout: seconds without anything received after which the device is pinged, or 0 to never ping an idle device. Defaults to 60.
+ * @stall_timeout: seconds without anything received while requests wait for a response after which the device is pinged, or 0 to only use @idle_timeout. Defaults to 5.
+ * @ping_timeout: seconds to wait for the reply to a ping. Defaults to 3.
+ *
+ * Sets the parameters used when #QmiDevice:device-health-check is enabled.
+ *
+ * This method may be called from any thread.
+ *
+ * Since: 1.20
+ */
+void qmi_device_set_health_check_params (QmiDevice *self,
+                                         guint      idle_timeout,
+                                         guint      stall_timeout,
+                                         guint      ping_timeout);
+
+/**
+ * qmi_device_set_offloaded_message:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService.
+ * @message_id: the message ID.
+ * @offloaded: whether the responses to the message are always parsed in a worker thread.
+ *
+ * Sets whether the responses to the given message are always parsed in a
+ * worker thread, regardless of their size and of
+ * #QmiDevice:device-offload-threshold.
+ *
+ * This method may be called from any thread.
+ *
+ * Since: 1.20
+ */
+void qmi_device_set_offloaded_message (QmiDevice  *self,
+                                       QmiService  service,
+                                       guint16     message_id,
+                                       gboolean    offloaded);
+
+/**
+ * QmiDeviceTraceFn:
+ * @self: a #QmiDevice.
+ * @record: a #QmiTraceRecord, only valid during the call.
+ * @user_data: user data.
+ *
+ * Function called for each QMI frame sent or received by the device.
+ *
+ * If the device was opened with %QMI_DEVICE_OPEN_FLAGS_IO_THREAD, this
+ * function is called from the dedicated I/O thread.
+ *
+ * Since: 1.20
+ */
+typedef void (* QmiDeviceTraceFn) (QmiDevice            *self,
+                                   const QmiTraceRecord *record,
+                                   gpointer              user_data);
+
+/**
+ * qmi_device_set_trace_func:
+ * @self: a #QmiDevice.
+ * @trace_func: (allow-none): the function to call for each frame, or %NULL to disable it.
+ * @user_data: (allow-none): user data to pass to @trace_func.
+ * @user_data_free: (allow-none): function to free @user_data when no longer needed.
+ *
+ * Sets the function receiving every raw QMI frame sent or received by the
+ * device, e.g. in order to keep them in a #QmiTraceRing with
+ * qmi_trace_ring_add(). This is independent of the text traces enabled with
+ * qmi_utils_set_traces_enabled().
+ *
+ * The trace function should be set before opening the device. If it is
+ * replaced while the device is open with %QMI_DEVICE_OPEN_FLAGS_IO_THREAD, the
+ * change is applied, and the previous @user_data freed, from the I/O thread,
+ * so the previous function may still be called until then.
+ *
+ * Since: 1.20
+ */
+void qmi_device_set_trace_func (QmiDevice        *self,
+                                QmiDeviceTraceFn  trace_func,
+                                gpointer          user_data,
+                                GDestroyNotify    user_data_free);
+
+/**
+ * qmi_device_query:
+ * @self: a #QmiDevice.
+ * @fds: (out caller-allocates) (array length=n_fds): location to store the file descriptors to poll.
+ * @n_fds: length of @fds.
+ * @out_deadline: (out): return location for the monotonic time, in microseconds, at which qmi_device_dispatch() must be called even if no file descriptor is ready; or -1 if there is no deadline.
+ *
+ * Gets the file descriptors, and the events of each of them, that need to be
+ * polled to drive @self from an event loop other than a #GMainLoop.
+ *
+ * Everything done by a #QmiDevice, including the completion of the
+ * operations requested and the report of indications, runs in the
+ * thread-default #GMainContext where the device was created. Applications
+ * integrating libqmi-glib in their own event loop should create the device
+ * with a dedicated #GMainContext pushed as thread-default, issue all requests
+ * from that same thread, and, in each iteration of their loop, call
+ * qmi_device_query(), poll the file descriptors given until the deadline,
+ * and then call qmi_device_dispatch() with the @fds array updated with the
+ * events received.
+ *
+ * This is equivalent to g_main_context_prepare() and g_main_context_query()
+ * on that context, which is acquired until qmi_device_dispatch() is called.
+ * If the return value is bigger than @n_fds, the method should be called
+ * again with a bigger array.
+ *
+ * Returns: the number of file descriptors to poll.
+ *
+ * Since: 1.20
+ */
+gint qmi_device_query (QmiDevice *self,
+                       GPollFD   *fds,
+                       gint       n_fds,
+                       gint64    *out_deadline);
+
+/**
+ * qmi_device_dispatch:
+ * @self: a #QmiDevice.
+ * @fds: (array length=n_fds): the file descriptors given by qmi_device_query(), with the events received in their @revents.
+ * @n_fds: length of @fds, as returned by qmi_device_query().
+ *
+ * Runs all the work of @self that is ready after polling the file descriptors
+ * given by qmi_device_query(), or once its deadline is reached.
+ *
+ * This is equivalent to g_main_context_check() and g_main_context_dispatch()
+ * on the #GMainContext where @self was created, which is then released.
+ * Callbacks of operations and indication handlers are run from within this
+ * method, and they may drop the last reference to @self.
+ *
+ * Since: 1.20
+ */
+void qmi_device_dispatch (QmiDevice     *self,
+                          const GPollFD *fds,
+                          gint           n_fds);
+
+/**
+ * QmiDeviceServiceVersionInfo:
+ * @service: a #QmiService.
+ * @major_version: major version of the service.
+ * @minor_version: minor version of the service.
+ *
+ * Version information for a service.
+ *
+ * Since: 1.6
+ */
+typedef struct {
+    QmiService service;
+    guint16    major_version;
+    guint16    minor_version;
+} QmiDeviceServiceVersionInfo;
+
+/**
+ * qmi_device_get_service_version_info:
+ * @self: a #QmiDevice.
+ * @timeout: maximum time to wait for the method to complete, in seconds.
+ * @cancellable: a #GCancellable or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the request is satisfied.
+ * @user_data: user data to pass to @callback.
+ *
+ * Asynchronously requests the service version information of the device.
+ *
+ * When the operation is finished, @callback will be invoked in the thread-default main loop of the thread you are calling this method from.
+ *
+ * You can then call qmi_device_get_service_version_info_finish() to get the result of the operation.
+ *
+ * Since: 1.6
+ */
+void qmi_device_get_service_version_info (QmiDevice           *self,
+                                          guint                timeout,
+                                          GCancellable        *cancellable,
+                                          GAsyncReadyCallback  callback,
+                                          gpointer             user_data);
+
+/**
+ * qmi_device_get_service_version_info_finish:
+ * @self: a #QmiDevice.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_get_service_version_info().
+ *
+ * Returns: a #GArray of #QmiDeviceServiceVersionInfo elements, or #NULL if @error is set. The returned value should be freed with g_array_unref().
+ *
+ * Since: 1.6
+ */
+GArray *qmi_device_get_service_version_info_finish (QmiDevice     *self,
+                                                    GAsyncResult  *res,
+                                                    GError       **error);
+
+/**
+ * qmi_device_set_indication_filter:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService.
+ * @message_ids: (element-type guint16): a #GArray with the ids of the indications to receive, or %NULL to receive all of them.
+ * @timeout: maximum time to wait for the method to complete, in seconds.
+ * @cancellable: a #GCancellable or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the request is satisfied.
+ * @user_data: user data to pass to @callback.
+ *
+ * Asynchronously asks qmi-proxy to only forward the indications of @service
+ * listed in @message_ids, replacing any filter previously set for the same
+ * service. Indications in other services are not affected.
+ *
+ * This is only supported when the device was opened with
+ * %QMI_DEVICE_OPEN_FLAGS_PROXY, and the proxy in use supports it; otherwise
+ * the operation fails with %QMI_CORE_ERROR_UNSUPPORTED.
+ *
+ * When the operation is finished, @callback will be invoked in the thread-default main loop of the thread you are calling this method from.
+ *
+ * You can then call qmi_device_set_indication_filter_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_set_indication_filter (QmiDevice           *self,
+                                       QmiService           service,
+                                       GArray              *message_ids,
+                                       guint                timeout,
+                                       GCancellable        *cancellable,
+                                       GAsyncReadyCallback  callback,
+                                       gpointer             user_data);
+
+/**
+ * qmi_device_set_indication_filter_finish:
+ * @self: a #QmiDevice.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_set_indication_filter().
+ *
+ * Returns: %TRUE if the filter was set, %FALSE if @error is set.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_device_set_indication_filter_finish (QmiDevice     *self,
+                                                  GAsyncResult  *res,
+                                                  GError       **error);
+
+/**
+ * qmi_device_monitor_indications:
+ * @self: a #QmiDevice.
+ * @services: (element-type QmiService): a #GArray with the services to monitor, or %NULL to stop monitoring.
+ * @timeout: maximum time to wait for the method to complete, in seconds.
+ * @cancellable: a #GCancellable or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the request is satisfied.
+ * @user_data: user data to pass to @callback.
+ *
+ * Asynchronously asks qmi-proxy to forward all the indications of @services
+ * received from the device, including the ones addressed to the clients of
+ * other processes, replacing any list of services previously given. The
+ * indications are then reported in the #QmiDevice::indication signal, even
+ * if no #QmiClient was allocated in this process for their service.
+ *
+ * This allows watching the indications requested by other users of the
+ * device without allocating any additional client in it. Indication filters
+ * set with qmi_device_set_indication_filter() also apply to the monitored
+ * indications.
+ *
+ * This is only supported when the device was opened with
+ * %QMI_DEVICE_OPEN_FLAGS_PROXY, and the proxy in use supports it; otherwise
+ * the operation fails with %QMI_CORE_ERROR_UNSUPPORTED.
+ *
+ * When the operation is finished, @callback will be invoked in the thread-default main loop of the thread you are calling this method from.
+ *
+ * You can then call qmi_device_monitor_indications_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_monitor_indications (QmiDevice           *self,
+                                     GArray              *services,
+                                     guint                timeout,
+                                     GCancellable        *cancellable,
+                                     GAsyncReadyCallback  callback,
+                                     gpointer             user_data);
+
+/**
+ * qmi_device_monitor_indications_finish:
+ * @self: a #QmiDevice.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_monitor_indications().
+ *
+ * Returns: %TRUE if the monitored services were set, %FALSE if @error is set.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_device_monitor_indications_finish (QmiDevice     *self,
+                                                GAsyncResult  *res,
+                                                GError       **error);
+/**
+ * QmiDeviceExpectedDataFormat:
+ * @QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN: Unknown.
+ * @QMI_DEVICE_EXPECTED_DATA_FORMAT_802_3: 802.3.
+ * @QMI_DEVICE_EXPECTED_DATA_FORMAT_RAW_IP: Raw IP.
  *
  * Data format expected by the kernel.
  *
@@ -735,6 +1910,356 @@ gboolean qmi_device_set_expected_data_format (QmiDevice                    *self
                                               QmiDeviceExpectedDataFormat   format,
                                               GError                      **error);
 
+/**
+ * qmi_device_load_wwan_iface:
+ * @self: a #QmiDevice.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously looks up the WWAN interface name associated with this
+ * /dev/cdc-wdm control port, without blocking the caller on sysfs access.
+ *
+ * When the operation is finished, @callback will be invoked. You can then call
+ * qmi_device_load_wwan_iface_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_load_wwan_iface (QmiDevice           *self,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data);
+
+/**
+ * qmi_device_load_wwan_iface_finish:
+ * @self: a #QmiDevice.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_load_wwan_iface().
+ *
+ * Returns: UTF-8 encoded network interface name, or %NULL if @error is set. The returned value is owned by @self and should not be freed.
+ *
+ * Since: 1.20
+ */
+const gchar *qmi_device_load_wwan_iface_finish (QmiDevice     *self,
+                                                GAsyncResult  *res,
+                                                GError       **error);
+
+/**
+ * qmi_device_load_expected_data_format:
+ * @self: a #QmiDevice.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously retrieves the data format currently expected by the kernel in
+ * the network interface, without blocking the caller on sysfs access.
+ *
+ * When the operation is finished, @callback will be invoked. You can then call
+ * qmi_device_load_expected_data_format_finish() to get the result of the
+ * operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_load_expected_data_format (QmiDevice           *self,
+                                           GCancellable        *cancellable,
+                                           GAsyncReadyCallback  callback,
+                                           gpointer             user_data);
+
+/**
+ * qmi_device_load_expected_data_format_finish:
+ * @self: a #QmiDevice.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_load_expected_data_format().
+ *
+ * Returns: a valid #QmiDeviceExpectedDataFormat, or @QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN if @error is set.
+ *
+ * Since: 1.20
+ */
+QmiDeviceExpectedDataFormat qmi_device_load_expected_data_format_finish (QmiDevice     *self,
+                                                                         GAsyncResult  *res,
+                                                                         GError       **error);
+
+/**
+ * qmi_device_update_expected_data_format:
+ * @self: a #QmiDevice.
+ * @format: a known #QmiDeviceExpectedDataFormat.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously configures the data format currently expected by the kernel
+ * in the network interface, without blocking the caller on sysfs access.
+ *
+ * When the operation is finished, @callback will be invoked. You can then call
+ * qmi_device_update_expected_data_format_finish() to get the result of the
+ * operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_update_expected_data_format (QmiDevice                   *self,
+                                             QmiDeviceExpectedDataFormat  format,
+                                             GCancellable                *cancellable,
+                                             GAsyncReadyCallback          callback,
+                                             gpointer                     user_data);
+
+/**
+ * qmi_device_update_expected_data_format_finish:
+ * @self: a #QmiDevice.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_update_expected_data_format().
+ *
+ * Returns: %TRUE if successful, or %FALSE if @error is set.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_device_update_expected_data_format_finish (QmiDevice     *self,
+                                                        GAsyncResult  *res,
+                                                        GError       **error);
+
+/**
+ * QmiDeviceMuxLink:
+ * @mux_id: the QMAP mux ID of the link.
+ * @ifname: the name of the network interface of the link, e.g. "qmimux0".
+ *
+ * A multiplexed network link created on top of the WWAN interface of a
+ * #QmiDevice, as given by qmi_device_list_mux_links().
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    guint8  mux_id;
+    gchar  *ifname;
+} QmiDeviceMuxLink;
+
+/**
+ * qmi_device_add_mux_link:
+ * @self: a #QmiDevice.
+ * @mux_id: the QMAP mux ID of the link, from 1 to 254.
+ * @cancellable: a #GCancellable or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously creates a network link for @mux_id on top of the WWAN
+ * interface of @self, through the add_mux sysfs attribute of the qmi_wwan
+ * driver. The WWAN interface must be in raw-IP mode, see
+ * qmi_device_update_expected_data_format().
+ *
+ * If a link for @mux_id already exists, it is reused, so that links don't
+ * need to be torn down when the session bound to @mux_id is restarted. The
+ * links known are cached in @self, so reusing one doesn't require walking
+ * all the network interfaces again.
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * qmi_device_add_mux_link_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_add_mux_link (QmiDevice           *self,
+                              guint8               mux_id,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data);
+
+/**
+ * qmi_device_add_mux_link_finish:
+ * @self: a #QmiDevice.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_add_mux_link().
+ *
+ * Returns: (transfer full): the name of the network interface of the link, or %NULL if @error is set. The returned value should be freed with g_free().
+ *
+ * Since: 1.20
+ */
+gchar *qmi_device_add_mux_link_finish (QmiDevice     *self,
+                                       GAsyncResult  *res,
+                                       GError       **error);
+
+/**
+ * qmi_device_delete_mux_link:
+ * @self: a #QmiDevice.
+ * @mux_id: the QMAP mux ID of the link.
+ * @cancellable: a #GCancellable or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously deletes the network link for @mux_id created on top of the
+ * WWAN interface of @self, through the del_mux sysfs attribute of the
+ * qmi_wwan driver. Deleting a link that doesn't exist is not an error.
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * qmi_device_delete_mux_link_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_delete_mux_link (QmiDevice           *self,
+                                 guint8               mux_id,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data);
+
+/**
+ * qmi_device_delete_mux_link_finish:
+ * @self: a #QmiDevice.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_delete_mux_link().
+ *
+ * Returns: %TRUE if the link doesn't exist any more, %FALSE if @error is set.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_device_delete_mux_link_finish (QmiDevice     *self,
+                                            GAsyncResult  *res,
+                                            GError       **error);
+
+/**
+ * qmi_device_list_mux_links:
+ * @self: a #QmiDevice.
+ * @cancellable: a #GCancellable or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously lists the network links created on top of the WWAN
+ * interface of @self, including the ones not created with
+ * qmi_device_add_mux_link(), and updates the links cached in @self.
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * qmi_device_list_mux_links_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_list_mux_links (QmiDevice           *self,
+                                GCancellable        *cancellable,
+                                GAsyncReadyCallback  callback,
+                                gpointer             user_data);
+
+/**
+ * qmi_device_list_mux_links_finish:
+ * @self: a #QmiDevice.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_list_mux_links().
+ *
+ * Returns: (transfer full) (element-type QmiDeviceMuxLink): a #GArray of #QmiDeviceMuxLink elements, sorted by mux ID, or %NULL if @error is set. The returned value should be freed with g_array_unref().
+ *
+ * Since: 1.20
+ */
+GArray *qmi_device_list_mux_links_finish (QmiDevice     *self,
+                                          GAsyncResult  *res,
+                                          GError       **error);
+
+/**
+ * QmiDevicePortInfo:
+ * @path: path of the control port, e.g. "/dev/cdc-wdm0".
+ * @driver: kernel driver of the control port, e.g. "qmi_wwan".
+ * @wwan_iface: name of the network interface of the control port, or %NULL if not found.
+ * @physdev_path: sysfs path of the USB device of the control port, e.g. "/sys/devices/pci0000:00/0000:00:14.0/usb2/2-3", or %NULL if not found.
+ * @expected_data_format: data format currently expected by the kernel in @wwan_iface, or %QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN if not available, e.g. with the cdc_mbim driver.
+ *
+ * Information about a QMI capable control port, as given by
+ * qmi_device_enumerate_ports().
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    gchar                       *path;
+    gchar                       *driver;
+    gchar                       *wwan_iface;
+    gchar                       *physdev_path;
+    QmiDeviceExpectedDataFormat  expected_data_format;
+} QmiDevicePortInfo;
+
+GType qmi_device_port_info_get_type (void);
+
+/**
+ * qmi_device_port_info_copy:
+ * @info: a #QmiDevicePortInfo.
+ *
+ * Copies a #QmiDevicePortInfo.
+ *
+ * Returns: (transfer full): a newly allocated #QmiDevicePortInfo, which should be freed with qmi_device_port_info_free().
+ *
+ * Since: 1.20
+ */
+QmiDevicePortInfo *qmi_device_port_info_copy (const QmiDevicePortInfo *info);
+
+/**
+ * qmi_device_port_info_free:
+ * @info: a #QmiDevicePortInfo.
+ *
+ * Frees a #QmiDevicePortInfo.
+ *
+ * Since: 1.20
+ */
+void qmi_device_port_info_free (QmiDevicePortInfo *info);
+
+/**
+ * qmi_device_enumerate_ports:
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously looks for all the QMI capable cdc-wdm control ports in the
+ * system, i.e. those handled by the qmi_wwan driver, or by the cdc_mbim driver
+ * when the library is built with QMI over MBIM support.
+ *
+ * The driver, network interface, USB device and expected data format of all
+ * the ports are loaded in a single sweep of sysfs run in a worker thread,
+ * without creating any #QmiDevice, so this is much cheaper than creating and
+ * opening a #QmiDevice for each port just to get that information.
+ *
+ * When the operation is finished, @callback will be invoked. You can then call
+ * qmi_device_enumerate_ports_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_enumerate_ports (GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data);
+
+/**
+ * qmi_device_enumerate_ports_finish:
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_enumerate_ports().
+ *
+ * Returns: (transfer full) (element-type QmiDevicePortInfo): a #GPtrArray of #QmiDevicePortInfo values sorted by path, possibly empty, or %NULL if @error is set. The returned value should be freed with g_ptr_array_unref().
+ *
+ * Since: 1.20
+ */
+GPtrArray *qmi_device_enumerate_ports_finish (GAsyncResult  *res,
+                                              GError       **error);
+
+#if defined (LIBQMI_GLIB_COMPILATION)
+G_GNUC_INTERNAL
+gboolean __qmi_device_get_response_offload (QmiDevice  *self,
+                                            QmiMessage *response);
+G_GNUC_INTERNAL
+gboolean __qmi_device_handoff_pause  (QmiDevice     *self,
+                                      gint          *fd,
+                                      GByteArray   **pending_input,
+                                      GError       **error);
+G_GNUC_INTERNAL
+void     __qmi_device_handoff_resume (QmiDevice     *self);
+G_GNUC_INTERNAL
+gboolean __qmi_device_handoff_adopt  (QmiDevice     *self,
+                                      gint           fd,
+                                      const guint8  *pending_input,
+                                      gsize          pending_input_len,
+                                      GError       **error);
+#endif
+
 G_END_DECLS
 
 #endif /* _LIBQMI_GLIB_QMI_DEVICE_H_ */
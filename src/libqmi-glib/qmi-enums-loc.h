@@ -61,4 +61,64 @@ typedef enum {
  * Since: 1.20
  */
 
+/*****************************************************************************/
+/* Helper enums for the 'QMI LOC Start' request */
+
+/**
+ * QmiLocFixRecurrenceType:
+ * @QMI_LOC_FIX_RECURRENCE_TYPE_UNKNOWN: Unknown.
+ * @QMI_LOC_FIX_RECURRENCE_TYPE_REQUEST_PERIODIC_FIXES: Request periodic position fixes.
+ * @QMI_LOC_FIX_RECURRENCE_TYPE_REQUEST_SINGLE_FIX: Request a single position fix.
+ *
+ * Type of recurrence of the position fixes requested.
+ *
+ * Since: 1.20
+ */
+typedef enum {
+    QMI_LOC_FIX_RECURRENCE_TYPE_UNKNOWN                = 0,
+    QMI_LOC_FIX_RECURRENCE_TYPE_REQUEST_PERIODIC_FIXES = 1,
+    QMI_LOC_FIX_RECURRENCE_TYPE_REQUEST_SINGLE_FIX     = 2,
+} QmiLocFixRecurrenceType;
+
+/**
+ * qmi_loc_fix_recurrence_type_get_string:
+ *
+ * Since: 1.20
+ */
+
+/*****************************************************************************/
+/* Helper enums for the 'QMI LOC Position Report' indication */
+
+/**
+ * QmiLocSessionStatus:
+ * @QMI_LOC_SESSION_STATUS_SUCCESS: Session finished successfully.
+ * @QMI_LOC_SESSION_STATUS_IN_PROGRESS: Session still in progress, further reports will follow.
+ * @QMI_LOC_SESSION_STATUS_GENERAL_FAILURE: Session failed.
+ * @QMI_LOC_SESSION_STATUS_TIMEOUT: Session timed out before a fix could be computed.
+ * @QMI_LOC_SESSION_STATUS_USER_END: Session ended by the user.
+ * @QMI_LOC_SESSION_STATUS_BAD_PARAMETER: Session failed due to a bad parameter.
+ * @QMI_LOC_SESSION_STATUS_PHONE_OFFLINE: Session failed because the device is offline.
+ * @QMI_LOC_SESSION_STATUS_ENGINE_LOCKED: Session failed because the location engine is locked.
+ *
+ * Status of the location session reported in a position report.
+ *
+ * Since: 1.20
+ */
+typedef enum {
+    QMI_LOC_SESSION_STATUS_SUCCESS         = 0,
+    QMI_LOC_SESSION_STATUS_IN_PROGRESS     = 1,
+    QMI_LOC_SESSION_STATUS_GENERAL_FAILURE = 2,
+    QMI_LOC_SESSION_STATUS_TIMEOUT         = 3,
+    QMI_LOC_SESSION_STATUS_USER_END        = 4,
+    QMI_LOC_SESSION_STATUS_BAD_PARAMETER   = 5,
+    QMI_LOC_SESSION_STATUS_PHONE_OFFLINE   = 6,
+    QMI_LOC_SESSION_STATUS_ENGINE_LOCKED   = 7,
+} QmiLocSessionStatus;
+
+/**
+ * qmi_loc_session_status_get_string:
+ *
+ * Since: 1.20
+ */
+
 #endif /* _LIBQMI_GLIB_QMI_ENUMS_LOC_H_ */
@@ -396,4 +396,86 @@ typedef enum {
  * Since: 1.10
  */
 
+/*****************************************************************************/
+/* Helper enums for the 'QMI UIM Register Events' request/response */
+
+/**
+ * QmiUimEventRegistrationFlag:
+ * @QMI_UIM_EVENT_REGISTRATION_FLAG_CARD_STATUS: Card status.
+ * @QMI_UIM_EVENT_REGISTRATION_FLAG_SAP_CONNECTION: SAP connection.
+ * @QMI_UIM_EVENT_REGISTRATION_FLAG_EXTENDED_CARD_STATUS: Extended card status.
+ *
+ * Flags to use to register to UIM indications.
+ *
+ * Since: 1.20
+ */
+typedef enum {
+    QMI_UIM_EVENT_REGISTRATION_FLAG_CARD_STATUS          = 1 << 0,
+    QMI_UIM_EVENT_REGISTRATION_FLAG_SAP_CONNECTION       = 1 << 1,
+    QMI_UIM_EVENT_REGISTRATION_FLAG_EXTENDED_CARD_STATUS = 1 << 2,
+} QmiUimEventRegistrationFlag;
+
+/**
+ * qmi_uim_event_registration_flag_build_string_from_mask:
+ *
+ * Since: 1.20
+ */
+
+/*****************************************************************************/
+/* Helper enums for the 'QMI UIM Refresh' indication */
+
+/**
+ * QmiUimRefreshStage:
+ * @QMI_UIM_REFRESH_STAGE_WAIT_FOR_OK: Waiting for clients to vote on the refresh.
+ * @QMI_UIM_REFRESH_STAGE_START: Refresh started.
+ * @QMI_UIM_REFRESH_STAGE_END_WITH_SUCCESS: Refresh finished successfully.
+ * @QMI_UIM_REFRESH_STAGE_END_WITH_FAILURE: Refresh failed.
+ *
+ * Stage of a UIM refresh procedure.
+ *
+ * Since: 1.20
+ */
+typedef enum {
+    QMI_UIM_REFRESH_STAGE_WAIT_FOR_OK      = 0,
+    QMI_UIM_REFRESH_STAGE_START            = 1,
+    QMI_UIM_REFRESH_STAGE_END_WITH_SUCCESS = 2,
+    QMI_UIM_REFRESH_STAGE_END_WITH_FAILURE = 3,
+} QmiUimRefreshStage;
+
+/**
+ * qmi_uim_refresh_stage_get_string:
+ *
+ * Since: 1.20
+ */
+
+/**
+ * QmiUimRefreshMode:
+ * @QMI_UIM_REFRESH_MODE_RESET: Reset of the card.
+ * @QMI_UIM_REFRESH_MODE_INIT: Initialization of the applications.
+ * @QMI_UIM_REFRESH_MODE_INIT_FCN: Initialization of the applications with file change notification.
+ * @QMI_UIM_REFRESH_MODE_FCN: File change notification.
+ * @QMI_UIM_REFRESH_MODE_INIT_FULL_FCN: Initialization of the applications with full file change notification.
+ * @QMI_UIM_REFRESH_MODE_APP_RESET: Reset of an application.
+ * @QMI_UIM_REFRESH_MODE_3G_RESET: 3G session reset.
+ *
+ * Mode of a UIM refresh procedure.
+ *
+ * Since: 1.20
+ */
+typedef enum {
+    QMI_UIM_REFRESH_MODE_RESET         = 0,
+    QMI_UIM_REFRESH_MODE_INIT          = 1,
+    QMI_UIM_REFRESH_MODE_INIT_FCN      = 2,
+    QMI_UIM_REFRESH_MODE_FCN           = 3,
+    QMI_UIM_REFRESH_MODE_INIT_FULL_FCN = 4,
+    QMI_UIM_REFRESH_MODE_APP_RESET     = 5,
+    QMI_UIM_REFRESH_MODE_3G_RESET      = 6,
+} QmiUimRefreshMode;
+
+/**
+ * qmi_uim_refresh_mode_get_string:
+ *
+ * Since: 1.20
+ */
+
 #endif /* _LIBQMI_GLIB_QMI_ENUMS_UIM_H_ */
@@ -563,4 +563,102 @@ typedef enum {
  * Since: 1.0
  */
 
+/*****************************************************************************/
+/* Helper enums for the WMS message store sweep */
+
+/**
+ * QmiWmsSweepFlags:
+ * @QMI_WMS_SWEEP_FLAGS_NONE: Just read the messages.
+ * @QMI_WMS_SWEEP_FLAGS_MARK_READ: Tag the received messages not yet read as read, once read.
+ * @QMI_WMS_SWEEP_FLAGS_DELETE: Delete the messages, once read.
+ *
+ * Actions to perform on each message in qmi_client_wms_sweep().
+ *
+ * Since: 1.20
+ */
+typedef enum {
+    QMI_WMS_SWEEP_FLAGS_NONE      = 0,
+    QMI_WMS_SWEEP_FLAGS_MARK_READ = 1 << 0,
+    QMI_WMS_SWEEP_FLAGS_DELETE    = 1 << 1
+} QmiWmsSweepFlags;
+
+/**
+ * qmi_wms_sweep_flags_build_string_from_mask:
+ *
+ * Since: 1.20
+ */
+
+/*****************************************************************************/
+/* Helper enums for the WMS direct delivery setup */
+
+/**
+ * QmiWmsDeliveryMode:
+ * @QMI_WMS_DELIVERY_MODE_STORE_AND_NOTIFY: Messages are stored, and notified with their storage and index.
+ * @QMI_WMS_DELIVERY_MODE_TRANSFER: Messages are given in the indication itself, without being stored.
+ *
+ * How incoming messages are delivered, as configured by
+ * qmi_client_wms_setup_direct_delivery().
+ *
+ * Since: 1.20
+ */
+typedef enum {
+    QMI_WMS_DELIVERY_MODE_STORE_AND_NOTIFY = 0,
+    QMI_WMS_DELIVERY_MODE_TRANSFER         = 1
+} QmiWmsDeliveryMode;
+
+/**
+ * qmi_wms_delivery_mode_get_string:
+ *
+ * Since: 1.20
+ */
+
+/*****************************************************************************/
+/* Helper enums for the WMS PDU parser */
+
+/**
+ * QmiWmsPduType:
+ * @QMI_WMS_PDU_TYPE_DELIVER: SMS-DELIVER.
+ * @QMI_WMS_PDU_TYPE_SUBMIT: SMS-SUBMIT.
+ * @QMI_WMS_PDU_TYPE_STATUS_REPORT: SMS-STATUS-REPORT.
+ *
+ * Type of a 3GPP SMS TPDU, as given in its TP-MTI.
+ *
+ * Since: 1.20
+ */
+typedef enum {
+    QMI_WMS_PDU_TYPE_DELIVER       = 0,
+    QMI_WMS_PDU_TYPE_SUBMIT        = 1,
+    QMI_WMS_PDU_TYPE_STATUS_REPORT = 2
+} QmiWmsPduType;
+
+/**
+ * qmi_wms_pdu_type_get_string:
+ *
+ * Since: 1.20
+ */
+
+/**
+ * QmiWmsPduEncoding:
+ * @QMI_WMS_PDU_ENCODING_UNKNOWN: Unknown or compressed.
+ * @QMI_WMS_PDU_ENCODING_GSM7: GSM 7-bit default alphabet.
+ * @QMI_WMS_PDU_ENCODING_8BIT: 8-bit data.
+ * @QMI_WMS_PDU_ENCODING_UCS2: UCS-2.
+ *
+ * Encoding of the user data of a 3GPP SMS TPDU, as given in its TP-DCS.
+ *
+ * Since: 1.20
+ */
+typedef enum {
+    QMI_WMS_PDU_ENCODING_UNKNOWN = 0,
+    QMI_WMS_PDU_ENCODING_GSM7    = 1,
+    QMI_WMS_PDU_ENCODING_8BIT    = 2,
+    QMI_WMS_PDU_ENCODING_UCS2    = 3
+} QmiWmsPduEncoding;
+
+/**
+ * qmi_wms_pdu_encoding_get_string:
+ *
+ * Since: 1.20
+ */
+
 #endif /* _LIBQMI_GLIB_QMI_ENUMS_WMS_H_ */
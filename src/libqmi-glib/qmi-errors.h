@@ -73,6 +73,7 @@
  * @QMI_CORE_ERROR_UNSUPPORTED: Not supported.
  * @QMI_CORE_ERROR_TLV_EMPTY: TLV has no value. Since: 1.12.
  * @QMI_CORE_ERROR_UNEXPECTED_MESSAGE: QMI message is unexpected. Since: 1.16.
+ * @QMI_CORE_ERROR_UNRESPONSIVE: Device is not responding. Since: 1.20.
  *
  * Common errors that may be reported by libqmi-glib.
  *
@@ -89,6 +90,7 @@ typedef enum { /*< underscore_name=qmi_core_error >*/
     QMI_CORE_ERROR_UNSUPPORTED        = 7, /*< nick=Unsupported >*/
     QMI_CORE_ERROR_TLV_EMPTY          = 8, /*< nick=TlvEmpty >*/
     QMI_CORE_ERROR_UNEXPECTED_MESSAGE = 9, /*< nick=UnexpectedMessage >*/
+    QMI_CORE_ERROR_UNRESPONSIVE       = 10, /*< nick=Unresponsive >*/
 } QmiCoreError;
 
 /**
@@ -0,0 +1,663 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <gio/gio.h>
+
+#include "qmi-io-uring.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+#if defined QMI_IO_URING_ENABLED
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <liburing.h>
+
+/* Max number of operations submitted at once */
+#define RING_ENTRIES 256
+
+/* Buffers provided to the kernel for all the reads of the ring; each one
+ * is given back as soon as the read callback returns, so they only need to
+ * cover the reads completed in one single dispatch */
+#define BUFFER_GROUP 0
+#define N_BUFFERS    64
+#define BUFFER_SIZE  4096
+
+/* Max number of completions handled in one single dispatch, so that other
+ * sources in the context are not starved */
+#define MAX_COMPLETIONS_PER_DISPATCH (2 * RING_ENTRIES)
+
+typedef struct _Ring Ring;
+
+typedef enum {
+    OP_TYPE_READ,
+    OP_TYPE_WRITE,
+} OpType;
+
+typedef struct {
+    OpType           type;
+    QmiIoUringWatch *watch;
+    /* Waiting for the file to be ready, when the operation would block */
+    gboolean         polling;
+    /* Write only */
+    struct iovec    *vectors;
+    guint            n_vectors;
+    struct msghdr    msg;
+    gpointer         owner;
+    GDestroyNotify   owner_free;
+} Op;
+
+struct _QmiIoUringWatch {
+    Ring              *ring; /* full ref */
+    gint               fd;
+    gboolean           is_socket;
+    QmiIoUringReadFn   read_callback;
+    QmiIoUringWriteFn  write_callback;
+    gpointer           user_data;
+    Op                 read_op;
+    gboolean           read_armed;
+    gboolean           read_done;
+    Op                *write_op;
+    /* Operations not completed yet, including the read */
+    guint              n_in_flight;
+    gboolean           removed;
+};
+
+struct _Ring {
+    GSource                   source;
+    GMainContext             *context;
+    gint                      ref_count; /* protected by the rings lock */
+    gboolean                  initialized;
+    struct io_uring           ring;
+    gint                      event_fd;
+    gpointer                  tag;
+    struct io_uring_buf_ring *buf_ring;
+    guint8                   *buffers;
+};
+
+/* One ring per main context */
+G_LOCK_DEFINE_STATIC (rings);
+static GHashTable *rings;
+
+/*****************************************************************************/
+
+static void
+ring_submit (Ring *ring)
+{
+    gint r;
+
+    if (!io_uring_sq_ready (&ring->ring))
+        return;
+
+    r = io_uring_submit (&ring->ring);
+    if (r < 0 && r != -EINTR && r != -EAGAIN && r != -EBUSY)
+        g_warning ("couldn't submit io_uring operations: %s", g_strerror (-r));
+}
+
+static struct io_uring_sqe *
+ring_get_sqe (Ring *ring)
+{
+    struct io_uring_sqe *sqe;
+
+    sqe = io_uring_get_sqe (&ring->ring);
+    if (G_UNLIKELY (!sqe)) {
+        /* Submission queue full, make room */
+        io_uring_submit (&ring->ring);
+        sqe = io_uring_get_sqe (&ring->ring);
+        g_assert (sqe);
+    }
+    return sqe;
+}
+
+static void
+ring_recycle_buffer (Ring    *ring,
+                     guint16  buffer_id)
+{
+    io_uring_buf_ring_add (ring->buf_ring,
+                           ring->buffers + (gsize) buffer_id * BUFFER_SIZE,
+                           BUFFER_SIZE,
+                           buffer_id,
+                           io_uring_buf_ring_mask (N_BUFFERS),
+                           0);
+    io_uring_buf_ring_advance (ring->buf_ring, 1);
+}
+
+static void
+op_submit (Op *op)
+{
+    QmiIoUringWatch     *watch = op->watch;
+    struct io_uring_sqe *sqe;
+
+    sqe = ring_get_sqe (watch->ring);
+
+    if (op->polling)
+        io_uring_prep_poll_add (sqe, watch->fd, op->type == OP_TYPE_READ ? POLLIN : POLLOUT);
+    else if (op->type == OP_TYPE_READ) {
+        /* Sockets get all their data through one single receive */
+        if (watch->is_socket)
+            io_uring_prep_recv_multishot (sqe, watch->fd, NULL, 0, 0);
+        else
+            io_uring_prep_read (sqe, watch->fd, NULL, BUFFER_SIZE, (__u64) -1);
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+    } else if (watch->is_socket)
+        io_uring_prep_sendmsg (sqe, watch->fd, &op->msg, MSG_NOSIGNAL);
+    else
+        io_uring_prep_writev (sqe, watch->fd, op->vectors, op->n_vectors, (__u64) -1);
+
+    io_uring_sqe_set_data (sqe, op);
+}
+
+static void
+op_free (Op *op)
+{
+    if (op->owner_free)
+        op->owner_free (op->owner);
+    g_free (op->vectors);
+    g_slice_free (Op, op);
+}
+
+static void ring_unref (Ring *ring);
+
+static void
+watch_check_free (QmiIoUringWatch *watch)
+{
+    if (!watch->removed || watch->n_in_flight > 0)
+        return;
+
+    ring_unref (watch->ring);
+    g_slice_free (QmiIoUringWatch, watch);
+}
+
+static void
+watch_arm_read (QmiIoUringWatch *watch)
+{
+    watch->read_op.polling = FALSE;
+    watch->read_armed = TRUE;
+    watch->n_in_flight++;
+    op_submit (&watch->read_op);
+}
+
+static void
+watch_report_read_error (QmiIoUringWatch *watch,
+                         gint             errno_value)
+{
+    GError *error;
+
+    watch->read_done = TRUE;
+    error = g_error_new (G_IO_ERROR,
+                         g_io_error_from_errno (errno_value),
+                         "%s",
+                         g_strerror (errno_value));
+    watch->read_callback (NULL, 0, error, watch->user_data);
+    g_error_free (error);
+}
+
+static void
+read_op_complete (Ring    *ring,
+                  Op      *op,
+                  gint32   res,
+                  guint32  flags)
+{
+    QmiIoUringWatch *watch = op->watch;
+    gboolean         reporting;
+    gboolean         finished = TRUE;
+
+    reporting = (!watch->removed && !watch->read_done);
+
+    if (op->polling) {
+        /* Ready to be read again */
+        op->polling = FALSE;
+        if (res < 0 && res != -ECANCELED && reporting)
+            watch_report_read_error (watch, -res);
+        else if (res >= 0 && reporting) {
+            op_submit (op);
+            finished = FALSE;
+        }
+    } else if (res > 0) {
+        if (flags & IORING_CQE_F_BUFFER) {
+            guint16 buffer_id;
+
+            buffer_id = (guint16) (flags >> IORING_CQE_BUFFER_SHIFT);
+            if (reporting)
+                watch->read_callback (ring->buffers + (gsize) buffer_id * BUFFER_SIZE,
+                                      (gsize) res,
+                                      NULL,
+                                      watch->user_data);
+            ring_recycle_buffer (ring, buffer_id);
+        }
+        finished = !(flags & IORING_CQE_F_MORE);
+    } else if (res == 0) {
+        if (reporting) {
+            watch->read_done = TRUE;
+            watch->read_callback (NULL, 0, NULL, watch->user_data);
+        }
+    } else if (res == -EAGAIN && reporting) {
+        /* Files opened in non-blocking mode are not waited for */
+        op->polling = TRUE;
+        op_submit (op);
+        finished = FALSE;
+    } else if (res != -ENOBUFS && res != -ECANCELED && reporting)
+        watch_report_read_error (watch, -res);
+
+    /* Re-armed until end of file or error; including when all buffers were
+     * in use, as they are all given back by now */
+    if (finished) {
+        watch->n_in_flight--;
+        watch->read_armed = FALSE;
+        if (!watch->removed && !watch->read_done)
+            watch_arm_read (watch);
+    }
+
+    watch_check_free (watch);
+}
+
+static void
+write_op_complete (Ring   *ring,
+                   Op     *op,
+                   gint32  res)
+{
+    QmiIoUringWatch *watch = op->watch;
+
+    if (!watch->removed) {
+        if (op->polling && res >= 0) {
+            /* Ready to be written again */
+            op->polling = FALSE;
+            op_submit (op);
+            return;
+        }
+
+        if (res == -EAGAIN) {
+            op->polling = TRUE;
+            op_submit (op);
+            return;
+        }
+    }
+
+    /* Completed before reporting, so that a new write can be started from
+     * the callback */
+    watch->write_op = NULL;
+    if (!watch->removed) {
+        if (res < 0) {
+            GError *error;
+
+            error = g_error_new (G_IO_ERROR,
+                                 g_io_error_from_errno (-res),
+                                 "%s",
+                                 g_strerror (-res));
+            watch->write_callback (-1, error, watch->user_data);
+            g_error_free (error);
+        } else
+            watch->write_callback ((gssize) res, NULL, watch->user_data);
+    }
+
+    op_free (op);
+    watch->n_in_flight--;
+    watch_check_free (watch);
+}
+
+/*****************************************************************************/
+
+static gboolean
+ring_prepare (GSource *source,
+              gint    *timeout)
+{
+    Ring *ring = (Ring *) source;
+
+    /* Everything queued while dispatching goes in one single call */
+    ring_submit (ring);
+
+    *timeout = -1;
+    return (io_uring_cq_ready (&ring->ring) > 0);
+}
+
+static gboolean
+ring_check (GSource *source)
+{
+    Ring *ring = (Ring *) source;
+
+    return (io_uring_cq_ready (&ring->ring) > 0 ||
+            !!(g_source_query_unix_fd (source, ring->tag) & G_IO_IN));
+}
+
+static gboolean
+ring_dispatch (GSource     *source,
+               GSourceFunc  callback,
+               gpointer     user_data)
+{
+    Ring                *ring = (Ring *) source;
+    struct io_uring_cqe *cqe;
+    guint64              value;
+    guint                n = 0;
+
+    /* Cleared before reaping, so that no completion is missed */
+    if (read (ring->event_fd, &value, sizeof (value)) < 0 && errno != EAGAIN)
+        g_warning ("couldn't read io_uring eventfd: %s", g_strerror (errno));
+
+    while (n++ < MAX_COMPLETIONS_PER_DISPATCH && io_uring_peek_cqe (&ring->ring, &cqe) == 0) {
+        Op      *op;
+        gint32   res;
+        guint32  flags;
+
+        op = io_uring_cqe_get_data (cqe);
+        res = cqe->res;
+        flags = cqe->flags;
+        io_uring_cqe_seen (&ring->ring, cqe);
+
+        /* Cancellations */
+        if (!op)
+            continue;
+
+        if (op->type == OP_TYPE_READ)
+            read_op_complete (ring, op, res, flags);
+        else
+            write_op_complete (ring, op, res);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+ring_finalize (GSource *source)
+{
+    Ring *ring = (Ring *) source;
+
+    if (ring->buf_ring)
+        io_uring_free_buf_ring (&ring->ring, ring->buf_ring, N_BUFFERS, BUFFER_GROUP);
+    if (ring->initialized)
+        io_uring_queue_exit (&ring->ring);
+    if (ring->event_fd >= 0)
+        close (ring->event_fd);
+    g_free (ring->buffers);
+}
+
+static GSourceFuncs ring_funcs = {
+    ring_prepare,
+    ring_check,
+    ring_dispatch,
+    ring_finalize,
+};
+
+static Ring *
+ring_new (GMainContext  *context,
+          GError       **error)
+{
+    Ring *ring;
+    gint  r;
+    guint i;
+
+    /* As if the kernel refused it, e.g. with io_uring disabled by sysctl or
+     * seccomp; checked for each new ring, the existing ones are kept */
+    if (g_getenv ("LIBQMI_DISABLE_IO_URING")) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_UNSUPPORTED,
+                     "io_uring disabled through LIBQMI_DISABLE_IO_URING");
+        return NULL;
+    }
+
+    ring = (Ring *) g_source_new (&ring_funcs, sizeof (Ring));
+    ring->context = context;
+    ring->ref_count = 1;
+    ring->event_fd = -1;
+
+    r = io_uring_queue_init (RING_ENTRIES, &ring->ring, 0);
+    if (r < 0) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
+                     "Cannot create io_uring: %s", g_strerror (-r));
+        goto failed;
+    }
+    ring->initialized = TRUE;
+
+    ring->event_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ring->event_fd < 0) {
+        r = errno;
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
+                     "Cannot create io_uring eventfd: %s", g_strerror (r));
+        goto failed;
+    }
+    r = io_uring_register_eventfd (&ring->ring, ring->event_fd);
+    if (r < 0) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
+                     "Cannot register io_uring eventfd: %s", g_strerror (-r));
+        goto failed;
+    }
+
+    ring->buf_ring = io_uring_setup_buf_ring (&ring->ring, N_BUFFERS, BUFFER_GROUP, 0, &r);
+    if (!ring->buf_ring) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_UNSUPPORTED,
+                     "Cannot setup io_uring buffers: %s", g_strerror (-r));
+        goto failed;
+    }
+    ring->buffers = g_malloc ((gsize) N_BUFFERS * BUFFER_SIZE);
+    for (i = 0; i < N_BUFFERS; i++)
+        io_uring_buf_ring_add (ring->buf_ring,
+                               ring->buffers + (gsize) i * BUFFER_SIZE,
+                               BUFFER_SIZE,
+                               (unsigned short) i,
+                               io_uring_buf_ring_mask (N_BUFFERS),
+                               (gint) i);
+    io_uring_buf_ring_advance (ring->buf_ring, N_BUFFERS);
+
+    ring->tag = g_source_add_unix_fd ((GSource *) ring, ring->event_fd, G_IO_IN);
+    g_source_attach ((GSource *) ring, context);
+    return ring;
+
+failed:
+    g_source_unref ((GSource *) ring);
+    return NULL;
+}
+
+static Ring *
+ring_get (GMainContext  *context,
+          GError       **error)
+{
+    Ring *ring;
+
+    if (!context)
+        context = g_main_context_default ();
+
+    G_LOCK (rings);
+    if (!rings)
+        rings = g_hash_table_new (g_direct_hash, g_direct_equal);
+    ring = g_hash_table_lookup (rings, context);
+    if (ring)
+        ring->ref_count++;
+    else {
+        ring = ring_new (context, error);
+        if (ring)
+            g_hash_table_insert (rings, context, ring);
+    }
+    G_UNLOCK (rings);
+
+    return ring;
+}
+
+static void
+ring_unref (Ring *ring)
+{
+    G_LOCK (rings);
+    if (--ring->ref_count > 0) {
+        G_UNLOCK (rings);
+        return;
+    }
+    g_hash_table_remove (rings, ring->context);
+    G_UNLOCK (rings);
+
+    /* If dispatching, finalized once done */
+    g_source_destroy ((GSource *) ring);
+    g_source_unref ((GSource *) ring);
+}
+
+/*****************************************************************************/
+
+gboolean
+__qmi_io_uring_supported (void)
+{
+    return TRUE;
+}
+
+QmiIoUringWatch *
+__qmi_io_uring_watch_new (GMainContext       *context,
+                          gint                fd,
+                          gboolean            is_socket,
+                          QmiIoUringReadFn    read_callback,
+                          QmiIoUringWriteFn   write_callback,
+                          gpointer            user_data,
+                          GError            **error)
+{
+    QmiIoUringWatch *watch;
+    Ring            *ring;
+
+    ring = ring_get (context, error);
+    if (!ring)
+        return NULL;
+
+    watch = g_slice_new0 (QmiIoUringWatch);
+    watch->ring = ring;
+    watch->fd = fd;
+    watch->is_socket = is_socket;
+    watch->read_callback = read_callback;
+    watch->write_callback = write_callback;
+    watch->user_data = user_data;
+    watch->read_op.type = OP_TYPE_READ;
+    watch->read_op.watch = watch;
+
+    watch_arm_read (watch);
+    return watch;
+}
+
+gboolean
+__qmi_io_uring_watch_is_writing (QmiIoUringWatch *watch)
+{
+    return !!watch->write_op;
+}
+
+void
+__qmi_io_uring_watch_write (QmiIoUringWatch    *watch,
+                            const struct iovec *vectors,
+                            guint               n_vectors,
+                            gpointer            owner,
+                            GDestroyNotify      owner_free)
+{
+    Op *op;
+
+    g_assert (!watch->removed);
+    g_assert (!watch->write_op);
+    g_assert (n_vectors > 0);
+
+    op = g_slice_new0 (Op);
+    op->type = OP_TYPE_WRITE;
+    op->watch = watch;
+    op->vectors = g_memdup (vectors, n_vectors * sizeof (struct iovec));
+    op->n_vectors = n_vectors;
+    op->msg.msg_iov = op->vectors;
+    op->msg.msg_iovlen = n_vectors;
+    op->owner = owner;
+    op->owner_free = owner_free;
+
+    /* Submitted with everything else before the context polls again */
+    watch->write_op = op;
+    watch->n_in_flight++;
+    op_submit (op);
+}
+
+void
+__qmi_io_uring_watch_free (QmiIoUringWatch *watch)
+{
+    struct io_uring_sqe *sqe;
+
+    if (!watch)
+        return;
+
+    g_assert (!watch->removed);
+    watch->removed = TRUE;
+
+    if (watch->read_armed) {
+        sqe = ring_get_sqe (watch->ring);
+        io_uring_prep_cancel (sqe, &watch->read_op, 0);
+        io_uring_sqe_set_data (sqe, NULL);
+    }
+    if (watch->write_op) {
+        sqe = ring_get_sqe (watch->ring);
+        io_uring_prep_cancel (sqe, watch->write_op, 0);
+        io_uring_sqe_set_data (sqe, NULL);
+    }
+
+    /* Right away, as the file may be closed as soon as we return; the
+     * watch itself is freed once all its operations complete */
+    if (watch->n_in_flight > 0) {
+        ring_submit (watch->ring);
+        return;
+    }
+    watch_check_free (watch);
+}
+
+#else
+
+gboolean
+__qmi_io_uring_supported (void)
+{
+    return FALSE;
+}
+
+QmiIoUringWatch *
+__qmi_io_uring_watch_new (GMainContext       *context,
+                          gint                fd,
+                          gboolean            is_socket,
+                          QmiIoUringReadFn    read_callback,
+                          QmiIoUringWriteFn   write_callback,
+                          gpointer            user_data,
+                          GError            **error)
+{
+    g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_UNSUPPORTED,
+                 "io_uring support not available");
+    return NULL;
+}
+
+gboolean
+__qmi_io_uring_watch_is_writing (QmiIoUringWatch *watch)
+{
+    g_assert_not_reached ();
+    return FALSE;
+}
+
+void
+__qmi_io_uring_watch_write (QmiIoUringWatch    *watch,
+                            const struct iovec *vectors,
+                            guint               n_vectors,
+                            gpointer            owner,
+                            GDestroyNotify      owner_free)
+{
+    g_assert_not_reached ();
+}
+
+void
+__qmi_io_uring_watch_free (QmiIoUringWatch *watch)
+{
+    g_assert (!watch);
+}
+
+#endif /* QMI_IO_URING_ENABLED */
@@ -0,0 +1,99 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_IO_URING_H_
+#define _LIBQMI_GLIB_QMI_IO_URING_H_
+
+#if !defined (LIBQMI_GLIB_COMPILATION)
+#error "This is a private header."
+#endif
+
+#include <sys/uio.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * io_uring I/O engine, shared by the QmiDevice and qmi-proxy I/O.
+ *
+ * There is one single ring per main context, created with the first watch
+ * in the context and destroyed with the last one. Its completions are all
+ * reported through one eventfd, watched by one GSource; and everything
+ * submitted while dispatching is given to the kernel in one single call
+ * right before the context polls again.
+ *
+ * Each watch keeps a read always armed on its file descriptor, into buffers
+ * provided by the ring: a multishot receive for sockets, re-armed after each
+ * completion for other files. Writes are given as I/O vectors, one at a time
+ * per watch; the buffers must stay valid until the write completes, so an
+ * owner of the buffers is given with each write and released then, even if
+ * the watch is gone.
+ *
+ * The watch callbacks are never called once the watch has been freed, and
+ * the watch must be freed in the same context where it was created.
+ */
+
+typedef struct _QmiIoUringWatch QmiIoUringWatch;
+
+/* @data is only valid during the callback. End of file is reported with
+ * @len 0 and no error; after an error or end of file, no more reads are
+ * reported. */
+typedef void (* QmiIoUringReadFn)  (const guint8 *data,
+                                    gsize         len,
+                                    const GError *error,
+                                    gpointer      user_data);
+
+/* @written is the number of bytes written, which may be less than requested,
+ * or -1 if @error is set */
+typedef void (* QmiIoUringWriteFn) (gssize        written,
+                                    const GError *error,
+                                    gpointer      user_data);
+
+G_GNUC_INTERNAL
+gboolean         __qmi_io_uring_supported  (void);
+
+G_GNUC_INTERNAL
+QmiIoUringWatch *__qmi_io_uring_watch_new  (GMainContext       *context,
+                                            gint                fd,
+                                            gboolean            is_socket,
+                                            QmiIoUringReadFn    read_callback,
+                                            QmiIoUringWriteFn   write_callback,
+                                            gpointer            user_data,
+                                            GError            **error);
+
+G_GNUC_INTERNAL
+gboolean         __qmi_io_uring_watch_is_writing (QmiIoUringWatch *watch);
+
+G_GNUC_INTERNAL
+void             __qmi_io_uring_watch_write (QmiIoUringWatch    *watch,
+                                             const struct iovec *vectors,
+                                             guint               n_vectors,
+                                             gpointer            owner,
+                                             GDestroyNotify      owner_free);
+
+G_GNUC_INTERNAL
+void             __qmi_io_uring_watch_free (QmiIoUringWatch *watch);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_IO_URING_H_ */
@@ -0,0 +1,857 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "qmi-kpi-sampler.h"
+#include "qmi-enums-nas.h"
+#include "qmi-message.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+G_DEFINE_TYPE (QmiKpiSampler, qmi_kpi_sampler, G_TYPE_OBJECT)
+
+/* Timeout of each request sent */
+#define REQUEST_TIMEOUT 10
+
+#define MAX_HISTORY_SIZE 86400
+
+/* Slack of the poller created when none given, in milliseconds */
+#define DEFAULT_POLLER_SLACK 1000
+
+/* Requests sent for each sample; the message ids are given by hand as the
+ * poller is given raw messages */
+#define NAS_GET_SIGNAL_INFO       0x004F
+#define NAS_GET_TX_RX_INFO        0x005A
+#define NAS_GET_LTE_CPHY_CA_INFO  0x00AC
+#define WDS_GET_CHANNEL_RATES     0x0023
+
+#define NAS_GET_TX_RX_INFO_INPUT_TLV_RADIO_INTERFACE 0x01
+
+typedef enum {
+    REQUEST_SIGNAL_INFO   = 1 << 0,
+    REQUEST_TX_RX_INFO    = 1 << 1,
+    REQUEST_CA_INFO       = 1 << 2,
+    REQUEST_CHANNEL_RATES = 1 << 3,
+} Request;
+
+#define BINARY_MAGIC   "QKPI"
+#define BINARY_VERSION 1
+
+G_STATIC_ASSERT (QMI_KPI_METRIC_LAST <= 32);
+
+enum {
+    PROP_0,
+    PROP_POLLER,
+    PROP_NAS_CLIENT,
+    PROP_WDS_CLIENT,
+    PROP_INTERVAL,
+    PROP_HISTORY_SIZE,
+    PROP_LAST
+};
+
+enum {
+    SIGNAL_UPDATED,
+    SIGNAL_LAST
+};
+
+static GParamSpec *properties[PROP_LAST];
+static guint       signals[SIGNAL_LAST] = { 0 };
+
+struct _QmiKpiSamplerPrivate {
+    QmiPoller    *poller;
+    QmiClientNas *nas_client;
+    QmiClientWds *wds_client;
+    guint         interval;
+    guint         history_size;
+
+    /* Periodic requests in the poller, and the ones expected each sample */
+    guint   poll_ids[4];
+    guint   n_poll_ids;
+    Request requests;
+
+    /* Ring of samples, allocated once, with one array per metric so that the
+     * values of a metric are contiguous. The values of the metric M for the
+     * sample in position P are in values[M * history_size + P], valid if bit
+     * M of masks[P] is set. The lock allows reading them from other threads */
+    GMutex   samples_lock;
+    gint64  *timestamps;
+    guint32 *masks;
+    gint32  *values;
+    guint    samples_head;
+    guint    n_samples;
+    Request  head_requests;
+};
+
+/*****************************************************************************/
+
+static const gchar *metric_strings[QMI_KPI_METRIC_LAST] = {
+    [QMI_KPI_METRIC_LTE_RSSI]          = "lte-rssi",
+    [QMI_KPI_METRIC_LTE_RSRQ]          = "lte-rsrq",
+    [QMI_KPI_METRIC_LTE_RSRP]          = "lte-rsrp",
+    [QMI_KPI_METRIC_LTE_SNR]           = "lte-snr",
+    [QMI_KPI_METRIC_WCDMA_RSSI]        = "wcdma-rssi",
+    [QMI_KPI_METRIC_WCDMA_ECIO]        = "wcdma-ecio",
+    [QMI_KPI_METRIC_GSM_RSSI]          = "gsm-rssi",
+    [QMI_KPI_METRIC_LTE_RX0_POWER]     = "lte-rx0-power",
+    [QMI_KPI_METRIC_LTE_RX1_POWER]     = "lte-rx1-power",
+    [QMI_KPI_METRIC_LTE_TX_POWER]      = "lte-tx-power",
+    [QMI_KPI_METRIC_LTE_PCELL_PCI]     = "lte-pcell-pci",
+    [QMI_KPI_METRIC_LTE_PCELL_CHANNEL] = "lte-pcell-channel",
+    [QMI_KPI_METRIC_LTE_PCELL_BAND]    = "lte-pcell-band",
+    [QMI_KPI_METRIC_LTE_DL_BANDWIDTH]  = "lte-dl-bandwidth",
+    [QMI_KPI_METRIC_LTE_SCELL_STATE]   = "lte-scell-state",
+    [QMI_KPI_METRIC_TX_RATE]           = "tx-rate",
+    [QMI_KPI_METRIC_RX_RATE]           = "rx-rate",
+};
+
+const gchar *
+qmi_kpi_metric_get_string (QmiKpiMetric metric)
+{
+    if ((guint) metric >= QMI_KPI_METRIC_LAST)
+        return NULL;
+    return metric_strings[metric];
+}
+
+/*****************************************************************************/
+
+#define SAMPLE_POSITION(self, index) \
+    (((self)->priv->samples_head + (self)->priv->history_size - (index)) % (self)->priv->history_size)
+
+#define SAMPLE_VALUE(self, metric, position) \
+    ((self)->priv->values[(metric) * (self)->priv->history_size + (position)])
+
+guint
+qmi_kpi_sampler_get_n_samples (QmiKpiSampler *self)
+{
+    guint n_samples;
+
+    g_return_val_if_fail (QMI_IS_KPI_SAMPLER (self), 0);
+
+    g_mutex_lock (&self->priv->samples_lock);
+    n_samples = self->priv->n_samples;
+    g_mutex_unlock (&self->priv->samples_lock);
+    return n_samples;
+}
+
+gboolean
+qmi_kpi_sampler_get_value (QmiKpiSampler *self,
+                           guint          index,
+                           QmiKpiMetric   metric,
+                           gint64        *timestamp,
+                           gint32        *value)
+{
+    gboolean found = FALSE;
+
+    g_return_val_if_fail (QMI_IS_KPI_SAMPLER (self), FALSE);
+    g_return_val_if_fail ((guint) metric < QMI_KPI_METRIC_LAST, FALSE);
+
+    g_mutex_lock (&self->priv->samples_lock);
+    if (index < self->priv->n_samples) {
+        guint position;
+
+        position = SAMPLE_POSITION (self, index);
+        if (self->priv->masks[position] & (1U << metric)) {
+            if (timestamp)
+                *timestamp = self->priv->timestamps[position];
+            if (value)
+                *value = SAMPLE_VALUE (self, metric, position);
+            found = TRUE;
+        }
+    }
+    g_mutex_unlock (&self->priv->samples_lock);
+    return found;
+}
+
+gboolean
+qmi_kpi_sampler_aggregate (QmiKpiSampler   *self,
+                           QmiKpiMetric     metric,
+                           gint64           window,
+                           QmiKpiAggregate *aggregate)
+{
+    gint64 since = 0;
+    gint64 sum = 0;
+    guint  n_values = 0;
+    gint32 min = G_MAXINT32;
+    gint32 max = G_MININT32;
+    guint  i;
+
+    g_return_val_if_fail (QMI_IS_KPI_SAMPLER (self), FALSE);
+    g_return_val_if_fail ((guint) metric < QMI_KPI_METRIC_LAST, FALSE);
+    g_return_val_if_fail (window >= 0, FALSE);
+    g_return_val_if_fail (aggregate != NULL, FALSE);
+
+    g_mutex_lock (&self->priv->samples_lock);
+
+    if (window > 0 && self->priv->n_samples > 0)
+        since = self->priv->timestamps[self->priv->samples_head] - window;
+
+    /* From the latest sample, until out of the window */
+    for (i = 0; i < self->priv->n_samples; i++) {
+        guint  position;
+        gint32 value;
+
+        position = SAMPLE_POSITION (self, i);
+        if (self->priv->timestamps[position] < since)
+            break;
+        if (!(self->priv->masks[position] & (1U << metric)))
+            continue;
+
+        value = SAMPLE_VALUE (self, metric, position);
+        if (value < min)
+            min = value;
+        if (value > max)
+            max = value;
+        sum += value;
+        n_values++;
+    }
+
+    g_mutex_unlock (&self->priv->samples_lock);
+
+    if (!n_values)
+        return FALSE;
+
+    aggregate->n_values = n_values;
+    aggregate->min = min;
+    aggregate->max = max;
+    aggregate->mean = (gdouble) sum / n_values;
+    return TRUE;
+}
+
+/*****************************************************************************/
+/* Export */
+
+static void
+export_csv (QmiKpiSampler *self,
+            GString       *str)
+{
+    guint i;
+    guint metric;
+
+    g_string_append (str, "timestamp");
+    for (metric = 0; metric < QMI_KPI_METRIC_LAST; metric++)
+        g_string_append_printf (str, ",%s", metric_strings[metric]);
+    g_string_append_c (str, '\n');
+
+    /* From the oldest sample */
+    for (i = self->priv->n_samples; i > 0; i--) {
+        guint position;
+
+        position = SAMPLE_POSITION (self, i - 1);
+        g_string_append_printf (str, "%" G_GINT64_FORMAT, self->priv->timestamps[position]);
+        for (metric = 0; metric < QMI_KPI_METRIC_LAST; metric++) {
+            g_string_append_c (str, ',');
+            if (self->priv->masks[position] & (1U << metric))
+                g_string_append_printf (str, "%d", SAMPLE_VALUE (self, metric, position));
+        }
+        g_string_append_c (str, '\n');
+    }
+}
+
+static void
+export_binary (QmiKpiSampler *self,
+               GByteArray    *array)
+{
+    guint16 value16;
+    guint32 value32;
+    guint64 value64;
+    guint   i;
+    guint   metric;
+
+    g_byte_array_append (array, (const guint8 *) BINARY_MAGIC, 4);
+    value16 = GUINT16_TO_LE (BINARY_VERSION);
+    g_byte_array_append (array, (const guint8 *) &value16, sizeof (value16));
+    value16 = GUINT16_TO_LE (QMI_KPI_METRIC_LAST);
+    g_byte_array_append (array, (const guint8 *) &value16, sizeof (value16));
+    value32 = GUINT32_TO_LE (self->priv->n_samples);
+    g_byte_array_append (array, (const guint8 *) &value32, sizeof (value32));
+    value32 = GUINT32_TO_LE (self->priv->interval);
+    g_byte_array_append (array, (const guint8 *) &value32, sizeof (value32));
+
+    /* From the oldest sample */
+    for (i = self->priv->n_samples; i > 0; i--) {
+        guint position;
+
+        position = SAMPLE_POSITION (self, i - 1);
+        value64 = GUINT64_TO_LE ((guint64) self->priv->timestamps[position]);
+        g_byte_array_append (array, (const guint8 *) &value64, sizeof (value64));
+        value32 = GUINT32_TO_LE (self->priv->masks[position]);
+        g_byte_array_append (array, (const guint8 *) &value32, sizeof (value32));
+        for (metric = 0; metric < QMI_KPI_METRIC_LAST; metric++) {
+            value32 = GUINT32_TO_LE ((guint32) SAMPLE_VALUE (self, metric, position));
+            g_byte_array_append (array, (const guint8 *) &value32, sizeof (value32));
+        }
+    }
+}
+
+GBytes *
+qmi_kpi_sampler_export (QmiKpiSampler      *self,
+                        QmiKpiExportFormat  format)
+{
+    GBytes *bytes = NULL;
+
+    g_return_val_if_fail (QMI_IS_KPI_SAMPLER (self), NULL);
+
+    g_mutex_lock (&self->priv->samples_lock);
+
+    switch (format) {
+    case QMI_KPI_EXPORT_FORMAT_CSV: {
+        GString *str;
+        gsize    len;
+
+        str = g_string_new (NULL);
+        export_csv (self, str);
+        len = str->len;
+        bytes = g_bytes_new_take (g_string_free (str, FALSE), len);
+        break;
+    }
+    case QMI_KPI_EXPORT_FORMAT_BINARY: {
+        GByteArray *array;
+
+        /* Header, plus the records */
+        array = g_byte_array_sized_new (16 + self->priv->n_samples * (12 + 4 * QMI_KPI_METRIC_LAST));
+        export_binary (self, array);
+        bytes = g_byte_array_free_to_bytes (array);
+        break;
+    }
+    default:
+        g_warn_if_reached ();
+        bytes = g_bytes_new (NULL, 0);
+        break;
+    }
+
+    g_mutex_unlock (&self->priv->samples_lock);
+
+    return bytes;
+}
+
+/*****************************************************************************/
+/* New samples */
+
+/* All the responses to the requests of the same burst go to the same sample.
+ * A new sample is started when a response comes for a request already
+ * reported in the latest one, or when the latest one is too old (e.g. if
+ * one of the responses was lost). Must be called with the lock held. */
+static guint
+sample_begin (QmiKpiSampler *self,
+              Request        request)
+{
+    gint64 now;
+
+    now = g_get_monotonic_time ();
+
+    if (!self->priv->n_samples ||
+        (self->priv->head_requests & request) ||
+        (now - self->priv->timestamps[self->priv->samples_head]) > ((gint64) self->priv->interval * G_USEC_PER_SEC / 2)) {
+        if (self->priv->n_samples)
+            self->priv->samples_head = (self->priv->samples_head + 1) % self->priv->history_size;
+        if (self->priv->n_samples < self->priv->history_size)
+            self->priv->n_samples++;
+        self->priv->timestamps[self->priv->samples_head] = now;
+        self->priv->masks[self->priv->samples_head] = 0;
+        self->priv->head_requests = 0;
+    }
+
+    self->priv->head_requests |= request;
+    return self->priv->samples_head;
+}
+
+static void
+sample_set (QmiKpiSampler *self,
+            guint          position,
+            QmiKpiMetric   metric,
+            gint32         value)
+{
+    SAMPLE_VALUE (self, metric, position) = value;
+    self->priv->masks[position] |= (1U << metric);
+}
+
+/* Whether all the requests of the latest sample have been reported, whether
+ * successful or not. Must be called with the lock held. */
+static gboolean
+sample_complete (QmiKpiSampler *self)
+{
+    return (self->priv->head_requests == self->priv->requests);
+}
+
+static void
+signal_info_response (QmiPoller     *poller,
+                      QmiClient     *client,
+                      QmiMessage    *response,
+                      const GError  *error,
+                      QmiKpiSampler *self)
+{
+    QmiMessageNasGetSignalInfoOutputStruct out;
+    guint64                                mask = 0;
+    GError                                *inner_error = NULL;
+    guint                                  position;
+    gboolean                               complete;
+
+    if (response && !qmi_message_nas_get_signal_info_response_parse_into (response, &out, &mask, &inner_error)) {
+        g_debug ("couldn't get signal info: %s", inner_error->message);
+        g_error_free (inner_error);
+        mask = 0;
+    }
+
+    g_mutex_lock (&self->priv->samples_lock);
+    position = sample_begin (self, REQUEST_SIGNAL_INFO);
+    if (mask & QMI_MESSAGE_NAS_GET_SIGNAL_INFO_OUTPUT_FIELD_LTE_SIGNAL_STRENGTH) {
+        sample_set (self, position, QMI_KPI_METRIC_LTE_RSSI, out.arg_lte_signal_strength_rssi);
+        sample_set (self, position, QMI_KPI_METRIC_LTE_RSRQ, out.arg_lte_signal_strength_rsrq);
+        sample_set (self, position, QMI_KPI_METRIC_LTE_RSRP, out.arg_lte_signal_strength_rsrp);
+        sample_set (self, position, QMI_KPI_METRIC_LTE_SNR, out.arg_lte_signal_strength_snr);
+    }
+    if (mask & QMI_MESSAGE_NAS_GET_SIGNAL_INFO_OUTPUT_FIELD_WCDMA_SIGNAL_STRENGTH) {
+        sample_set (self, position, QMI_KPI_METRIC_WCDMA_RSSI, out.arg_wcdma_signal_strength_rssi);
+        sample_set (self, position, QMI_KPI_METRIC_WCDMA_ECIO, out.arg_wcdma_signal_strength_ecio);
+    }
+    if (mask & QMI_MESSAGE_NAS_GET_SIGNAL_INFO_OUTPUT_FIELD_GSM_SIGNAL_STRENGTH)
+        sample_set (self, position, QMI_KPI_METRIC_GSM_RSSI, out.arg_gsm_signal_strength);
+    complete = sample_complete (self);
+    g_mutex_unlock (&self->priv->samples_lock);
+
+    if (complete)
+        g_signal_emit (self, signals[SIGNAL_UPDATED], 0);
+}
+
+static void
+tx_rx_info_response (QmiPoller     *poller,
+                     QmiClient     *client,
+                     QmiMessage    *response,
+                     const GError  *error,
+                     QmiKpiSampler *self)
+{
+    QmiMessageNasGetTxRxInfoOutputStruct out;
+    guint64                              mask = 0;
+    GError                              *inner_error = NULL;
+    guint                                position;
+    gboolean                             complete;
+
+    if (response && !qmi_message_nas_get_tx_rx_info_response_parse_into (response, &out, &mask, &inner_error)) {
+        /* e.g. not in LTE */
+        g_debug ("couldn't get TX/RX info: %s", inner_error->message);
+        g_error_free (inner_error);
+        mask = 0;
+    }
+
+    g_mutex_lock (&self->priv->samples_lock);
+    position = sample_begin (self, REQUEST_TX_RX_INFO);
+    if ((mask & QMI_MESSAGE_NAS_GET_TX_RX_INFO_OUTPUT_FIELD_RX_CHAIN_0_INFO) && out.arg_rx_chain_0_info_is_radio_tuned)
+        sample_set (self, position, QMI_KPI_METRIC_LTE_RX0_POWER, out.arg_rx_chain_0_info_rx_power);
+    if ((mask & QMI_MESSAGE_NAS_GET_TX_RX_INFO_OUTPUT_FIELD_RX_CHAIN_1_INFO) && out.arg_rx_chain_1_info_is_radio_tuned)
+        sample_set (self, position, QMI_KPI_METRIC_LTE_RX1_POWER, out.arg_rx_chain_1_info_rx_power);
+    if ((mask & QMI_MESSAGE_NAS_GET_TX_RX_INFO_OUTPUT_FIELD_TX_INFO) && out.arg_tx_info_is_in_traffic)
+        sample_set (self, position, QMI_KPI_METRIC_LTE_TX_POWER, out.arg_tx_info_tx_power);
+    complete = sample_complete (self);
+    g_mutex_unlock (&self->priv->samples_lock);
+
+    if (complete)
+        g_signal_emit (self, signals[SIGNAL_UPDATED], 0);
+}
+
+static void
+ca_info_response (QmiPoller     *poller,
+                  QmiClient     *client,
+                  QmiMessage    *response,
+                  const GError  *error,
+                  QmiKpiSampler *self)
+{
+    QmiMessageNasGetLteCphyCaInfoOutputStruct out;
+    guint64                                   mask = 0;
+    GError                                   *inner_error = NULL;
+    guint                                     position;
+    gboolean                                  complete;
+
+    if (response && !qmi_message_nas_get_lte_cphy_ca_info_response_parse_into (response, &out, &mask, &inner_error)) {
+        g_debug ("couldn't get carrier aggregation info: %s", inner_error->message);
+        g_error_free (inner_error);
+        mask = 0;
+    }
+
+    g_mutex_lock (&self->priv->samples_lock);
+    position = sample_begin (self, REQUEST_CA_INFO);
+    if (mask & QMI_MESSAGE_NAS_GET_LTE_CPHY_CA_INFO_OUTPUT_FIELD_PHY_CA_AGG_PCELL_INFO) {
+        sample_set (self, position, QMI_KPI_METRIC_LTE_PCELL_PCI, out.arg_phy_ca_agg_pcell_info_physical_cell_id);
+        sample_set (self, position, QMI_KPI_METRIC_LTE_PCELL_CHANNEL, out.arg_phy_ca_agg_pcell_info_rx_channel);
+        sample_set (self, position, QMI_KPI_METRIC_LTE_PCELL_BAND, out.arg_phy_ca_agg_pcell_info_lte_band);
+    }
+    if (mask & QMI_MESSAGE_NAS_GET_LTE_CPHY_CA_INFO_OUTPUT_FIELD_DL_BANDWIDTH)
+        sample_set (self, position, QMI_KPI_METRIC_LTE_DL_BANDWIDTH, (gint32) out.arg_dl_bandwidth);
+    if (mask & QMI_MESSAGE_NAS_GET_LTE_CPHY_CA_INFO_OUTPUT_FIELD_PHY_CA_AGG_SCELL_INFO)
+        sample_set (self, position, QMI_KPI_METRIC_LTE_SCELL_STATE, (gint32) out.arg_phy_ca_agg_scell_info_state);
+    complete = sample_complete (self);
+    g_mutex_unlock (&self->priv->samples_lock);
+
+    if (complete)
+        g_signal_emit (self, signals[SIGNAL_UPDATED], 0);
+}
+
+static void
+channel_rates_response (QmiPoller     *poller,
+                        QmiClient     *client,
+                        QmiMessage    *response,
+                        const GError  *error,
+                        QmiKpiSampler *self)
+{
+    QmiMessageWdsGetChannelRatesOutputStruct out;
+    guint64                                  mask = 0;
+    GError                                  *inner_error = NULL;
+    guint                                    position;
+    gboolean                                 complete;
+
+    if (response && !qmi_message_wds_get_channel_rates_response_parse_into (response, &out, &mask, &inner_error)) {
+        /* e.g. out of call */
+        g_debug ("couldn't get channel rates: %s", inner_error->message);
+        g_error_free (inner_error);
+        mask = 0;
+    }
+
+    g_mutex_lock (&self->priv->samples_lock);
+    position = sample_begin (self, REQUEST_CHANNEL_RATES);
+    /* In kbps, so that any rate fits */
+    if (mask & QMI_MESSAGE_WDS_GET_CHANNEL_RATES_OUTPUT_FIELD_CHANNEL_RATES) {
+        sample_set (self, position, QMI_KPI_METRIC_TX_RATE, (gint32) (out.arg_channel_rates_channel_tx_rate_bps / 1000));
+        sample_set (self, position, QMI_KPI_METRIC_RX_RATE, (gint32) (out.arg_channel_rates_channel_rx_rate_bps / 1000));
+    }
+    complete = sample_complete (self);
+    g_mutex_unlock (&self->priv->samples_lock);
+
+    if (complete)
+        g_signal_emit (self, signals[SIGNAL_UPDATED], 0);
+}
+
+/*****************************************************************************/
+/* Polling */
+
+static void
+polling_add (QmiKpiSampler             *self,
+             QmiClient                 *client,
+             QmiMessage                *request,
+             Request                    request_bit,
+             QmiPollerResponseCallback  callback)
+{
+    g_assert (self->priv->n_poll_ids < G_N_ELEMENTS (self->priv->poll_ids));
+
+    /* The sampler removes its requests when disposed, so no need to keep a
+     * reference in the poller */
+    self->priv->poll_ids[self->priv->n_poll_ids++] = qmi_poller_add (self->priv->poller,
+                                                                      client,
+                                                                      request,
+                                                                      self->priv->interval,
+                                                                      REQUEST_TIMEOUT,
+                                                                      callback,
+                                                                      self,
+                                                                      NULL);
+    self->priv->requests |= request_bit;
+    qmi_message_unref (request);
+}
+
+static void
+polling_start (QmiKpiSampler *self)
+{
+    QmiMessage *request;
+    gsize       init_offset;
+
+    /* All added in the same main loop iteration, so sent in the same burst */
+    polling_add (self, QMI_CLIENT (self->priv->nas_client),
+                 qmi_message_new (QMI_SERVICE_NAS, 0, 0, NAS_GET_SIGNAL_INFO),
+                 REQUEST_SIGNAL_INFO,
+                 (QmiPollerResponseCallback) signal_info_response);
+
+    request = qmi_message_new (QMI_SERVICE_NAS, 0, 0, NAS_GET_TX_RX_INFO);
+    init_offset = qmi_message_tlv_write_init (request, NAS_GET_TX_RX_INFO_INPUT_TLV_RADIO_INTERFACE, NULL);
+    g_assert (init_offset);
+    qmi_message_tlv_write_gint8 (request, QMI_NAS_RADIO_INTERFACE_LTE, NULL);
+    qmi_message_tlv_write_complete (request, init_offset, NULL);
+    polling_add (self, QMI_CLIENT (self->priv->nas_client),
+                 request,
+                 REQUEST_TX_RX_INFO,
+                 (QmiPollerResponseCallback) tx_rx_info_response);
+
+    polling_add (self, QMI_CLIENT (self->priv->nas_client),
+                 qmi_message_new (QMI_SERVICE_NAS, 0, 0, NAS_GET_LTE_CPHY_CA_INFO),
+                 REQUEST_CA_INFO,
+                 (QmiPollerResponseCallback) ca_info_response);
+
+    if (self->priv->wds_client)
+        polling_add (self, QMI_CLIENT (self->priv->wds_client),
+                     qmi_message_new (QMI_SERVICE_WDS, 0, 0, WDS_GET_CHANNEL_RATES),
+                     REQUEST_CHANNEL_RATES,
+                     (QmiPollerResponseCallback) channel_rates_response);
+}
+
+/*****************************************************************************/
+/* New sampler */
+
+QmiKpiSampler *
+qmi_kpi_sampler_new (QmiPoller    *poller,
+                     QmiClientNas *nas_client,
+                     QmiClientWds *wds_client,
+                     guint         interval,
+                     guint         history_size)
+{
+    g_return_val_if_fail (!poller || QMI_IS_POLLER (poller), NULL);
+    g_return_val_if_fail (QMI_IS_CLIENT_NAS (nas_client), NULL);
+    g_return_val_if_fail (!wds_client || QMI_IS_CLIENT_WDS (wds_client), NULL);
+    g_return_val_if_fail (interval >= 1, NULL);
+    g_return_val_if_fail (history_size >= 1 && history_size <= MAX_HISTORY_SIZE, NULL);
+
+    return QMI_KPI_SAMPLER (g_object_new (QMI_TYPE_KPI_SAMPLER,
+                                          QMI_KPI_SAMPLER_POLLER,       poller,
+                                          QMI_KPI_SAMPLER_NAS_CLIENT,   nas_client,
+                                          QMI_KPI_SAMPLER_WDS_CLIENT,   wds_client,
+                                          QMI_KPI_SAMPLER_INTERVAL,     interval,
+                                          QMI_KPI_SAMPLER_HISTORY_SIZE, history_size,
+                                          NULL));
+}
+
+/*****************************************************************************/
+
+static void
+set_property (GObject      *object,
+              guint         prop_id,
+              const GValue *value,
+              GParamSpec   *pspec)
+{
+    QmiKpiSampler *self = QMI_KPI_SAMPLER (object);
+
+    switch (prop_id) {
+    case PROP_POLLER:
+        g_assert (self->priv->poller == NULL);
+        self->priv->poller = g_value_dup_object (value);
+        break;
+    case PROP_NAS_CLIENT:
+        g_assert (self->priv->nas_client == NULL);
+        self->priv->nas_client = g_value_dup_object (value);
+        break;
+    case PROP_WDS_CLIENT:
+        g_assert (self->priv->wds_client == NULL);
+        self->priv->wds_client = g_value_dup_object (value);
+        break;
+    case PROP_INTERVAL:
+        self->priv->interval = g_value_get_uint (value);
+        break;
+    case PROP_HISTORY_SIZE:
+        self->priv->history_size = g_value_get_uint (value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+get_property (GObject    *object,
+              guint       prop_id,
+              GValue     *value,
+              GParamSpec *pspec)
+{
+    QmiKpiSampler *self = QMI_KPI_SAMPLER (object);
+
+    switch (prop_id) {
+    case PROP_POLLER:
+        g_value_set_object (value, self->priv->poller);
+        break;
+    case PROP_NAS_CLIENT:
+        g_value_set_object (value, self->priv->nas_client);
+        break;
+    case PROP_WDS_CLIENT:
+        g_value_set_object (value, self->priv->wds_client);
+        break;
+    case PROP_INTERVAL:
+        g_value_set_uint (value, self->priv->interval);
+        break;
+    case PROP_HISTORY_SIZE:
+        g_value_set_uint (value, self->priv->history_size);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+qmi_kpi_sampler_init (QmiKpiSampler *self)
+{
+    self->priv = G_TYPE_INSTANCE_GET_PRIVATE ((self),
+                                              QMI_TYPE_KPI_SAMPLER,
+                                              QmiKpiSamplerPrivate);
+
+    g_mutex_init (&self->priv->samples_lock);
+}
+
+static void
+constructed (GObject *object)
+{
+    QmiKpiSampler *self = QMI_KPI_SAMPLER (object);
+
+    G_OBJECT_CLASS (qmi_kpi_sampler_parent_class)->constructed (object);
+
+    if (!self->priv->poller)
+        self->priv->poller = qmi_poller_new (DEFAULT_POLLER_SLACK, 0);
+
+    self->priv->timestamps = g_new0 (gint64, self->priv->history_size);
+    self->priv->masks = g_new0 (guint32, self->priv->history_size);
+    self->priv->values = g_new0 (gint32, (gsize) self->priv->history_size * QMI_KPI_METRIC_LAST);
+
+    if (self->priv->nas_client)
+        polling_start (self);
+}
+
+static void
+dispose (GObject *object)
+{
+    QmiKpiSampler *self = QMI_KPI_SAMPLER (object);
+    guint          i;
+
+    if (self->priv->poller) {
+        for (i = 0; i < self->priv->n_poll_ids; i++)
+            qmi_poller_remove (self->priv->poller, self->priv->poll_ids[i]);
+        self->priv->n_poll_ids = 0;
+        g_clear_object (&self->priv->poller);
+    }
+
+    g_clear_object (&self->priv->nas_client);
+    g_clear_object (&self->priv->wds_client);
+
+    G_OBJECT_CLASS (qmi_kpi_sampler_parent_class)->dispose (object);
+}
+
+static void
+finalize (GObject *object)
+{
+    QmiKpiSampler *self = QMI_KPI_SAMPLER (object);
+
+    g_free (self->priv->timestamps);
+    g_free (self->priv->masks);
+    g_free (self->priv->values);
+    g_mutex_clear (&self->priv->samples_lock);
+
+    G_OBJECT_CLASS (qmi_kpi_sampler_parent_class)->finalize (object);
+}
+
+static void
+qmi_kpi_sampler_class_init (QmiKpiSamplerClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    g_type_class_add_private (object_class, sizeof (QmiKpiSamplerPrivate));
+
+    object_class->get_property = get_property;
+    object_class->set_property = set_property;
+    object_class->constructed = constructed;
+    object_class->dispose = dispose;
+    object_class->finalize = finalize;
+
+    /**
+     * QmiKpiSampler:kpi-sampler-poller:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_POLLER] =
+        g_param_spec_object (QMI_KPI_SAMPLER_POLLER,
+                             "Poller",
+                             "The poller where the requests are scheduled",
+                             QMI_TYPE_POLLER,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_POLLER, properties[PROP_POLLER]);
+
+    /**
+     * QmiKpiSampler:kpi-sampler-nas-client:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_NAS_CLIENT] =
+        g_param_spec_object (QMI_KPI_SAMPLER_NAS_CLIENT,
+                             "NAS client",
+                             "The NAS client of the sampled device",
+                             QMI_TYPE_CLIENT_NAS,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_NAS_CLIENT, properties[PROP_NAS_CLIENT]);
+
+    /**
+     * QmiKpiSampler:kpi-sampler-wds-client:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_WDS_CLIENT] =
+        g_param_spec_object (QMI_KPI_SAMPLER_WDS_CLIENT,
+                             "WDS client",
+                             "The WDS client of the sampled device, if any",
+                             QMI_TYPE_CLIENT_WDS,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_WDS_CLIENT, properties[PROP_WDS_CLIENT]);
+
+    /**
+     * QmiKpiSampler:kpi-sampler-interval:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_INTERVAL] =
+        g_param_spec_uint (QMI_KPI_SAMPLER_INTERVAL,
+                           "Interval",
+                           "Sampling interval, in seconds",
+                           1,
+                           G_MAXUINT,
+                           1,
+                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_INTERVAL, properties[PROP_INTERVAL]);
+
+    /**
+     * QmiKpiSampler:kpi-sampler-history-size:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_HISTORY_SIZE] =
+        g_param_spec_uint (QMI_KPI_SAMPLER_HISTORY_SIZE,
+                           "History size",
+                           "Number of samples kept",
+                           1,
+                           MAX_HISTORY_SIZE,
+                           60,
+                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_HISTORY_SIZE, properties[PROP_HISTORY_SIZE]);
+
+    /**
+     * QmiKpiSampler::updated:
+     * @object: A #QmiKpiSampler.
+     *
+     * The ::updated signal is emitted whenever a new sample is complete in
+     * the history, i.e. once all the requests sent for it have been answered
+     * or have failed.
+     *
+     * Since: 1.20
+     */
+    signals[SIGNAL_UPDATED] =
+        g_signal_new (QMI_KPI_SAMPLER_SIGNAL_UPDATED,
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      0);
+}
@@ -0,0 +1,340 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_KPI_SAMPLER_H_
+#define _LIBQMI_GLIB_QMI_KPI_SAMPLER_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "qmi-poller.h"
+#include "qmi-nas.h"
+#include "qmi-wds.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-kpi-sampler
+ * @title: QmiKpiSampler
+ * @short_description: time series of radio KPIs
+ *
+ * The #QmiKpiSampler periodically samples the radio KPIs of a device (signal
+ * strength, LTE TX and RX power, LTE carrier aggregation and channel rates)
+ * and keeps them in a fixed-size history.
+ *
+ * All the requests needed for one sample are scheduled in a #QmiPoller, so
+ * that they are sent to the device in a single burst each interval, along
+ * with the ones of any other sampler sharing the same poller. The responses
+ * are decoded without allocating any memory, and stored in a ring allocated
+ * once, with one array per metric, so that no memory is allocated per sample
+ * either.
+ *
+ * The history can be queried sample by sample, aggregated over a time window,
+ * or exported in bulk.
+ */
+
+/**
+ * QmiKpiMetric:
+ * @QMI_KPI_METRIC_LTE_RSSI: LTE RSSI, in dBm.
+ * @QMI_KPI_METRIC_LTE_RSRQ: LTE RSRQ, in dB.
+ * @QMI_KPI_METRIC_LTE_RSRP: LTE RSRP, in dBm.
+ * @QMI_KPI_METRIC_LTE_SNR: LTE SNR, in units of 0.1 dB.
+ * @QMI_KPI_METRIC_WCDMA_RSSI: WCDMA RSSI, in dBm.
+ * @QMI_KPI_METRIC_WCDMA_ECIO: WCDMA Ec/Io, in units of -0.5 dB.
+ * @QMI_KPI_METRIC_GSM_RSSI: GSM RSSI, in dBm.
+ * @QMI_KPI_METRIC_LTE_RX0_POWER: LTE RX power in the primary chain, in units of 0.1 dBm.
+ * @QMI_KPI_METRIC_LTE_RX1_POWER: LTE RX power in the diversity chain, in units of 0.1 dBm.
+ * @QMI_KPI_METRIC_LTE_TX_POWER: LTE TX power, in units of 0.1 dBm, only while in traffic.
+ * @QMI_KPI_METRIC_LTE_PCELL_PCI: physical cell id of the LTE primary cell.
+ * @QMI_KPI_METRIC_LTE_PCELL_CHANNEL: EARFCN of the LTE primary cell.
+ * @QMI_KPI_METRIC_LTE_PCELL_BAND: LTE band of the primary cell, given as a #QmiNasActiveBand.
+ * @QMI_KPI_METRIC_LTE_DL_BANDWIDTH: LTE downlink bandwidth, given as a #QmiNasDLBandwidth.
+ * @QMI_KPI_METRIC_LTE_SCELL_STATE: state of the LTE secondary cell, given as a #QmiNasScellState.
+ * @QMI_KPI_METRIC_TX_RATE: current channel TX rate, in kbps.
+ * @QMI_KPI_METRIC_RX_RATE: current channel RX rate, in kbps.
+ * @QMI_KPI_METRIC_LAST: the number of metrics, not a metric itself.
+ *
+ * The metrics kept by a #QmiKpiSampler. All values are stored as 32-bit
+ * signed integers, in the units reported by the device.
+ *
+ * Since: 1.20
+ */
+typedef enum {
+    QMI_KPI_METRIC_LTE_RSSI,
+    QMI_KPI_METRIC_LTE_RSRQ,
+    QMI_KPI_METRIC_LTE_RSRP,
+    QMI_KPI_METRIC_LTE_SNR,
+    QMI_KPI_METRIC_WCDMA_RSSI,
+    QMI_KPI_METRIC_WCDMA_ECIO,
+    QMI_KPI_METRIC_GSM_RSSI,
+    QMI_KPI_METRIC_LTE_RX0_POWER,
+    QMI_KPI_METRIC_LTE_RX1_POWER,
+    QMI_KPI_METRIC_LTE_TX_POWER,
+    QMI_KPI_METRIC_LTE_PCELL_PCI,
+    QMI_KPI_METRIC_LTE_PCELL_CHANNEL,
+    QMI_KPI_METRIC_LTE_PCELL_BAND,
+    QMI_KPI_METRIC_LTE_DL_BANDWIDTH,
+    QMI_KPI_METRIC_LTE_SCELL_STATE,
+    QMI_KPI_METRIC_TX_RATE,
+    QMI_KPI_METRIC_RX_RATE,
+    QMI_KPI_METRIC_LAST
+} QmiKpiMetric;
+
+/**
+ * qmi_kpi_metric_get_string:
+ * @metric: a #QmiKpiMetric.
+ *
+ * Gets the nickname of @metric, as used in the exported CSV header.
+ *
+ * Returns: (transfer none): a string, or %NULL if @metric is not a valid metric.
+ *
+ * Since: 1.20
+ */
+const gchar *qmi_kpi_metric_get_string (QmiKpiMetric metric);
+
+/**
+ * QmiKpiExportFormat:
+ * @QMI_KPI_EXPORT_FORMAT_CSV: Comma separated values, with a header line with the metric names, and one line per sample with the timestamp followed by the values; values not available are left empty.
+ * @QMI_KPI_EXPORT_FORMAT_BINARY: Little endian records, after a 16 byte header with the "QKPI" magic, a 16-bit version (1), the 16-bit number of metrics, the 32-bit number of samples and the 32-bit interval in seconds. Each record has the 64-bit timestamp, a 32-bit mask with one bit per available metric, and one 32-bit value per metric.
+ *
+ * Formats in which the history of a #QmiKpiSampler may be exported. In both
+ * of them the samples are given from the oldest to the latest, with
+ * monotonic timestamps in microseconds.
+ *
+ * Since: 1.20
+ */
+typedef enum {
+    QMI_KPI_EXPORT_FORMAT_CSV,
+    QMI_KPI_EXPORT_FORMAT_BINARY,
+} QmiKpiExportFormat;
+
+/**
+ * QmiKpiAggregate:
+ * @n_values: number of samples with the metric available in the window.
+ * @min: minimum value.
+ * @max: maximum value.
+ * @mean: mean value.
+ *
+ * Aggregate of the values of one metric over a time window.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    guint   n_values;
+    gint32  min;
+    gint32  max;
+    gdouble mean;
+} QmiKpiAggregate;
+
+#define QMI_TYPE_KPI_SAMPLER            (qmi_kpi_sampler_get_type ())
+#define QMI_KPI_SAMPLER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), QMI_TYPE_KPI_SAMPLER, QmiKpiSampler))
+#define QMI_KPI_SAMPLER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  QMI_TYPE_KPI_SAMPLER, QmiKpiSamplerClass))
+#define QMI_IS_KPI_SAMPLER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), QMI_TYPE_KPI_SAMPLER))
+#define QMI_IS_KPI_SAMPLER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  QMI_TYPE_KPI_SAMPLER))
+#define QMI_KPI_SAMPLER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  QMI_TYPE_KPI_SAMPLER, QmiKpiSamplerClass))
+
+typedef struct _QmiKpiSampler QmiKpiSampler;
+typedef struct _QmiKpiSamplerClass QmiKpiSamplerClass;
+typedef struct _QmiKpiSamplerPrivate QmiKpiSamplerPrivate;
+
+/**
+ * QMI_KPI_SAMPLER_POLLER:
+ *
+ * Symbol defining the #QmiKpiSampler:kpi-sampler-poller property.
+ *
+ * Since: 1.20
+ */
+#define QMI_KPI_SAMPLER_POLLER "kpi-sampler-poller"
+
+/**
+ * QMI_KPI_SAMPLER_NAS_CLIENT:
+ *
+ * Symbol defining the #QmiKpiSampler:kpi-sampler-nas-client property.
+ *
+ * Since: 1.20
+ */
+#define QMI_KPI_SAMPLER_NAS_CLIENT "kpi-sampler-nas-client"
+
+/**
+ * QMI_KPI_SAMPLER_WDS_CLIENT:
+ *
+ * Symbol defining the #QmiKpiSampler:kpi-sampler-wds-client property.
+ *
+ * Since: 1.20
+ */
+#define QMI_KPI_SAMPLER_WDS_CLIENT "kpi-sampler-wds-client"
+
+/**
+ * QMI_KPI_SAMPLER_INTERVAL:
+ *
+ * Symbol defining the #QmiKpiSampler:kpi-sampler-interval property.
+ *
+ * Since: 1.20
+ */
+#define QMI_KPI_SAMPLER_INTERVAL "kpi-sampler-interval"
+
+/**
+ * QMI_KPI_SAMPLER_HISTORY_SIZE:
+ *
+ * Symbol defining the #QmiKpiSampler:kpi-sampler-history-size property.
+ *
+ * Since: 1.20
+ */
+#define QMI_KPI_SAMPLER_HISTORY_SIZE "kpi-sampler-history-size"
+
+/**
+ * QMI_KPI_SAMPLER_SIGNAL_UPDATED:
+ *
+ * Symbol defining the #QmiKpiSampler::updated signal.
+ *
+ * Since: 1.20
+ */
+#define QMI_KPI_SAMPLER_SIGNAL_UPDATED "updated"
+
+/**
+ * QmiKpiSampler:
+ *
+ * The #QmiKpiSampler structure contains private data and should only be
+ * accessed using the provided API.
+ *
+ * Since: 1.20
+ */
+struct _QmiKpiSampler {
+    /*< private >*/
+    GObject parent;
+    QmiKpiSamplerPrivate *priv;
+};
+
+struct _QmiKpiSamplerClass {
+    /*< private >*/
+    GObjectClass parent;
+};
+
+GType qmi_kpi_sampler_get_type (void);
+
+/**
+ * qmi_kpi_sampler_new:
+ * @poller: (nullable): a #QmiPoller to schedule the requests in, or %NULL to use one of the sampler's own.
+ * @nas_client: a #QmiClientNas.
+ * @wds_client: (nullable): a #QmiClientWds, or %NULL to skip the channel rates.
+ * @interval: the sampling interval, in seconds, at least 1.
+ * @history_size: the number of samples to keep, at least 1.
+ *
+ * Creates a #QmiKpiSampler, and starts sampling right away.
+ *
+ * The sampling is done in the context of @poller; if the sampler uses its own
+ * poller, it is the
+ * <link linkend="g-main-context-push-thread-default">thread-default main context</link>
+ * of the thread you are calling this method from.
+ *
+ * Returns: (transfer full): a newly created #QmiKpiSampler. The returned value should be freed with g_object_unref().
+ *
+ * Since: 1.20
+ */
+QmiKpiSampler *qmi_kpi_sampler_new (QmiPoller    *poller,
+                                    QmiClientNas *nas_client,
+                                    QmiClientWds *wds_client,
+                                    guint         interval,
+                                    guint         history_size);
+
+/**
+ * qmi_kpi_sampler_get_n_samples:
+ * @self: a #QmiKpiSampler.
+ *
+ * Gets the number of samples currently in the history, which is never more
+ * than the history size given when creating the sampler.
+ *
+ * This method may be called from any thread.
+ *
+ * Returns: the number of samples.
+ *
+ * Since: 1.20
+ */
+guint qmi_kpi_sampler_get_n_samples (QmiKpiSampler *self);
+
+/**
+ * qmi_kpi_sampler_get_value:
+ * @self: a #QmiKpiSampler.
+ * @index: the index of the sample in the history, 0 being the latest one.
+ * @metric: a #QmiKpiMetric.
+ * @timestamp: (out) (optional): return location for the monotonic time when the sample was taken, in microseconds, or %NULL.
+ * @value: (out) (optional): return location for the value, or %NULL.
+ *
+ * Gets the value of @metric in one of the samples in the history.
+ *
+ * This method may be called from any thread.
+ *
+ * Returns: %TRUE if the sample exists and has @metric available, %FALSE otherwise.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_kpi_sampler_get_value (QmiKpiSampler *self,
+                                    guint          index,
+                                    QmiKpiMetric   metric,
+                                    gint64        *timestamp,
+                                    gint32        *value);
+
+/**
+ * qmi_kpi_sampler_aggregate:
+ * @self: a #QmiKpiSampler.
+ * @metric: a #QmiKpiMetric.
+ * @window: the time window, in microseconds up to the latest sample, or 0 for the whole history.
+ * @aggregate: (out): a placeholder for the output #QmiKpiAggregate.
+ *
+ * Computes the minimum, maximum and mean of the values of @metric in the
+ * samples within @window.
+ *
+ * This method may be called from any thread.
+ *
+ * Returns: %TRUE if @aggregate is set, %FALSE if @metric isn't available in any sample in the window.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_kpi_sampler_aggregate (QmiKpiSampler   *self,
+                                    QmiKpiMetric     metric,
+                                    gint64           window,
+                                    QmiKpiAggregate *aggregate);
+
+/**
+ * qmi_kpi_sampler_export:
+ * @self: a #QmiKpiSampler.
+ * @format: a #QmiKpiExportFormat.
+ *
+ * Exports the whole history in @format.
+ *
+ * This method may be called from any thread.
+ *
+ * Returns: (transfer full): a #GBytes with the exported history. The returned value should be freed with g_bytes_unref().
+ *
+ * Since: 1.20
+ */
+GBytes *qmi_kpi_sampler_export (QmiKpiSampler      *self,
+                                QmiKpiExportFormat  format);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_KPI_SAMPLER_H_ */
@@ -0,0 +1,674 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "qmi-loc-session-mux.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+G_DEFINE_TYPE (QmiLocSessionMux, qmi_loc_session_mux, G_TYPE_OBJECT)
+
+/* Timeout of each request sent */
+#define REQUEST_TIMEOUT 10
+
+#define MIN_INTERVAL 100
+
+/* Key of the shared object in the client */
+#define CLIENT_DATA_KEY "qmi-loc-session-mux"
+
+/* Session ID used for the shared session */
+#define SESSION_ID 0x4d
+
+/* Position Report event in the Event Registration Mask */
+#define EVENT_REGISTRATION_MASK_POSITION_REPORT 0x01
+
+/* LOC Position Report indication, read as a raw message */
+#define POSITION_REPORT_INDICATION_ID           0x0024
+#define POSITION_REPORT_TLV_SESSION_STATUS      0x01
+#define POSITION_REPORT_TLV_SESSION_ID          0x02
+#define POSITION_REPORT_TLV_LATITUDE            0x10
+#define POSITION_REPORT_TLV_LONGITUDE           0x11
+#define POSITION_REPORT_TLV_HORIZONTAL_UNC      0x12
+#define POSITION_REPORT_TLV_HORIZONTAL_SPEED    0x18
+#define POSITION_REPORT_TLV_ALTITUDE            0x1A
+#define POSITION_REPORT_TLV_HEADING             0x20
+#define POSITION_REPORT_TLV_UTC_TIMESTAMP       0x25
+
+typedef struct {
+    guint                            id;
+    guint                            interval;
+    gint64                           last_timestamp;
+    QmiLocSessionMuxPositionCallback callback;
+    gpointer                         user_data;
+    GDestroyNotify                   user_data_free_func;
+} Subscriber;
+
+enum {
+    PROP_0,
+    PROP_CLIENT,
+    PROP_LAST
+};
+
+enum {
+    SIGNAL_SESSION_ERROR,
+    SIGNAL_LAST
+};
+
+static GParamSpec *properties[PROP_LAST];
+static guint       signals[SIGNAL_LAST] = { 0 };
+
+struct _QmiLocSessionMuxPrivate {
+    QmiClientLoc *client;
+    guint         position_report_id;
+
+    GPtrArray *subscribers;
+    guint      next_subscriber_id;
+    guint      dispatching;
+    gboolean   subscribers_removed;
+
+    /* Interval of the running session, 0 if not running */
+    guint    interval;
+    gboolean events_registered;
+
+    /* Only one request in flight; updates requested meanwhile are run once
+     * it finishes */
+    gboolean operation_running;
+    guint    operation_interval;
+    gboolean update_pending;
+};
+
+static void session_update (QmiLocSessionMux *self);
+
+/*****************************************************************************/
+
+static void
+subscriber_free (Subscriber *subscriber)
+{
+    if (subscriber->user_data_free_func)
+        subscriber->user_data_free_func (subscriber->user_data);
+    g_slice_free (Subscriber, subscriber);
+}
+
+QmiClientLoc *
+qmi_loc_session_mux_peek_client (QmiLocSessionMux *self)
+{
+    g_return_val_if_fail (QMI_IS_LOC_SESSION_MUX (self), NULL);
+
+    return self->priv->client;
+}
+
+guint
+qmi_loc_session_mux_get_interval (QmiLocSessionMux *self)
+{
+    g_return_val_if_fail (QMI_IS_LOC_SESSION_MUX (self), 0);
+
+    return self->priv->interval;
+}
+
+guint
+qmi_loc_session_mux_subscribe (QmiLocSessionMux                 *self,
+                               guint                             interval,
+                               QmiLocSessionMuxPositionCallback  callback,
+                               gpointer                          user_data,
+                               GDestroyNotify                    user_data_free_func)
+{
+    Subscriber *subscriber;
+
+    g_return_val_if_fail (QMI_IS_LOC_SESSION_MUX (self), 0);
+    g_return_val_if_fail (interval >= MIN_INTERVAL, 0);
+    g_return_val_if_fail (callback != NULL, 0);
+
+    subscriber = g_slice_new0 (Subscriber);
+    subscriber->id = ++self->priv->next_subscriber_id;
+    if (!subscriber->id)
+        subscriber->id = ++self->priv->next_subscriber_id;
+    subscriber->interval = interval;
+    subscriber->callback = callback;
+    subscriber->user_data = user_data;
+    subscriber->user_data_free_func = user_data_free_func;
+    g_ptr_array_add (self->priv->subscribers, subscriber);
+
+    session_update (self);
+    return subscriber->id;
+}
+
+static void
+subscribers_compact (QmiLocSessionMux *self)
+{
+    guint i;
+
+    for (i = 0; i < self->priv->subscribers->len;) {
+        Subscriber *subscriber;
+
+        subscriber = g_ptr_array_index (self->priv->subscribers, i);
+        if (!subscriber->callback)
+            g_ptr_array_remove_index (self->priv->subscribers, i);
+        else
+            i++;
+    }
+    self->priv->subscribers_removed = FALSE;
+}
+
+void
+qmi_loc_session_mux_unsubscribe (QmiLocSessionMux *self,
+                                 guint             id)
+{
+    guint i;
+
+    g_return_if_fail (QMI_IS_LOC_SESSION_MUX (self));
+
+    for (i = 0; i < self->priv->subscribers->len; i++) {
+        Subscriber *subscriber;
+
+        subscriber = g_ptr_array_index (self->priv->subscribers, i);
+        if (subscriber->id != id || !subscriber->callback)
+            continue;
+
+        /* While dispatching, only flag it; the array is compacted afterwards */
+        if (self->priv->dispatching) {
+            subscriber->callback = NULL;
+            if (subscriber->user_data_free_func) {
+                subscriber->user_data_free_func (subscriber->user_data);
+                subscriber->user_data_free_func = NULL;
+            }
+            self->priv->subscribers_removed = TRUE;
+        } else
+            g_ptr_array_remove_index (self->priv->subscribers, i);
+
+        session_update (self);
+        return;
+    }
+
+    g_warning ("LOC session mux subscriber %u not found", id);
+}
+
+/*****************************************************************************/
+/* Position reports */
+
+static gboolean
+read_guint32 (QmiMessage *message,
+              guint8      type,
+              guint32    *value)
+{
+    const guint8 *raw;
+    guint16       raw_length;
+
+    raw = qmi_message_get_raw_tlv (message, type, &raw_length);
+    if (!raw || raw_length < 4)
+        return FALSE;
+    memcpy (value, raw, 4);
+    *value = GUINT32_FROM_LE (*value);
+    return TRUE;
+}
+
+static gboolean
+read_guint64 (QmiMessage *message,
+              guint8      type,
+              guint64    *value)
+{
+    const guint8 *raw;
+    guint16       raw_length;
+
+    raw = qmi_message_get_raw_tlv (message, type, &raw_length);
+    if (!raw || raw_length < 8)
+        return FALSE;
+    memcpy (value, raw, 8);
+    *value = GUINT64_FROM_LE (*value);
+    return TRUE;
+}
+
+static gboolean
+read_gfloat (QmiMessage *message,
+             guint8      type,
+             gfloat     *value)
+{
+    guint32 tmp;
+
+    if (!read_guint32 (message, type, &tmp))
+        return FALSE;
+    memcpy (value, &tmp, 4);
+    return TRUE;
+}
+
+static gboolean
+read_gdouble (QmiMessage *message,
+              guint8      type,
+              gdouble    *value)
+{
+    guint64 tmp;
+
+    if (!read_guint64 (message, type, &tmp))
+        return FALSE;
+    memcpy (value, &tmp, 8);
+    return TRUE;
+}
+
+static void
+position_dispatch (QmiLocSessionMux     *self,
+                   const QmiLocPosition *position)
+{
+    guint n_subscribers;
+    guint i;
+
+    /* Subscribers added from within a callback are only given the next
+     * records */
+    n_subscribers = self->priv->subscribers->len;
+
+    g_object_ref (self);
+    self->priv->dispatching++;
+    for (i = 0; i < n_subscribers; i++) {
+        Subscriber *subscriber;
+
+        subscriber = g_ptr_array_index (self->priv->subscribers, i);
+        if (!subscriber->callback)
+            continue;
+
+        /* Half an interval of tolerance, so that the jitter of the reports
+         * doesn't make a subscriber skip every other one */
+        if (subscriber->last_timestamp &&
+            2 * (position->timestamp - subscriber->last_timestamp) < (gint64) subscriber->interval * 1000)
+            continue;
+
+        subscriber->last_timestamp = position->timestamp;
+        subscriber->callback (self, position, subscriber->user_data);
+    }
+    self->priv->dispatching--;
+
+    if (!self->priv->dispatching && self->priv->subscribers_removed)
+        subscribers_compact (self);
+    g_object_unref (self);
+}
+
+static void
+position_report_indication_cb (QmiClient        *client,
+                               QmiMessage       *message,
+                               QmiLocSessionMux *self)
+{
+    QmiLocPosition  position;
+    const guint8   *raw;
+    guint16         raw_length;
+    guint32         session_status;
+
+    /* Reports of sessions started by other users of the client are ignored */
+    raw = qmi_message_get_raw_tlv (message, POSITION_REPORT_TLV_SESSION_ID, &raw_length);
+    if (!raw || raw_length < 1 || raw[0] != SESSION_ID)
+        return;
+
+    if (!self->priv->interval && !self->priv->operation_running)
+        return;
+
+    if (!read_guint32 (message, POSITION_REPORT_TLV_SESSION_STATUS, &session_status)) {
+        g_debug ("invalid LOC position report: no session status");
+        return;
+    }
+
+    /* The record is parsed once and shared by all the subscribers */
+    memset (&position, 0, sizeof (position));
+    position.timestamp = g_get_monotonic_time ();
+    position.session_status = (QmiLocSessionStatus) session_status;
+    if (read_gdouble (message, POSITION_REPORT_TLV_LATITUDE, &position.latitude))
+        position.fields |= QMI_LOC_POSITION_FIELD_LATITUDE;
+    if (read_gdouble (message, POSITION_REPORT_TLV_LONGITUDE, &position.longitude))
+        position.fields |= QMI_LOC_POSITION_FIELD_LONGITUDE;
+    if (read_gfloat (message, POSITION_REPORT_TLV_HORIZONTAL_UNC, &position.horizontal_uncertainty))
+        position.fields |= QMI_LOC_POSITION_FIELD_HORIZONTAL_UNCERTAINTY;
+    if (read_gfloat (message, POSITION_REPORT_TLV_HORIZONTAL_SPEED, &position.horizontal_speed))
+        position.fields |= QMI_LOC_POSITION_FIELD_HORIZONTAL_SPEED;
+    if (read_gfloat (message, POSITION_REPORT_TLV_ALTITUDE, &position.altitude))
+        position.fields |= QMI_LOC_POSITION_FIELD_ALTITUDE;
+    if (read_gfloat (message, POSITION_REPORT_TLV_HEADING, &position.heading))
+        position.fields |= QMI_LOC_POSITION_FIELD_HEADING;
+    if (read_guint64 (message, POSITION_REPORT_TLV_UTC_TIMESTAMP, &position.utc_timestamp))
+        position.fields |= QMI_LOC_POSITION_FIELD_UTC_TIMESTAMP;
+
+    position_dispatch (self, &position);
+}
+
+/*****************************************************************************/
+/* Session management */
+
+static void
+operation_finish (QmiLocSessionMux *self,
+                  GError           *error)
+{
+    if (error) {
+        g_debug ("couldn't update LOC session: %s", error->message);
+        g_signal_emit (self, signals[SIGNAL_SESSION_ERROR], 0, error);
+        g_error_free (error);
+    }
+
+    self->priv->operation_running = FALSE;
+    if (self->priv->update_pending) {
+        self->priv->update_pending = FALSE;
+        session_update (self);
+    }
+}
+
+static void
+start_ready (QmiClientLoc     *client,
+             GAsyncResult     *res,
+             QmiLocSessionMux *self)
+{
+    QmiMessageLocStartOutput *output;
+    GError                   *error = NULL;
+
+    output = qmi_client_loc_start_finish (client, res, &error);
+    if (!output || !qmi_message_loc_start_output_get_result (output, &error))
+        g_prefix_error (&error, "Couldn't start LOC session: ");
+    else {
+        g_debug ("LOC session running with a %u ms interval", self->priv->operation_interval);
+        self->priv->interval = self->priv->operation_interval;
+    }
+
+    if (output)
+        qmi_message_loc_start_output_unref (output);
+
+    if (self->priv->client)
+        operation_finish (self, error);
+    else
+        g_clear_error (&error);
+    g_object_unref (self);
+}
+
+static void
+session_start (QmiLocSessionMux *self)
+{
+    QmiMessageLocStartInput *input;
+
+    /* Starting again the same session just updates its parameters */
+    input = qmi_message_loc_start_input_new ();
+    qmi_message_loc_start_input_set_session_id (input, SESSION_ID, NULL);
+    qmi_message_loc_start_input_set_fix_recurrence (input, QMI_LOC_FIX_RECURRENCE_TYPE_REQUEST_PERIODIC_FIXES, NULL);
+    qmi_message_loc_start_input_set_intermediate_report_state (input, QMI_LOC_INTERMEDIATE_REPORT_STATE_DISABLE, NULL);
+    qmi_message_loc_start_input_set_minimum_interval_between_position_reports (input, self->priv->operation_interval, NULL);
+    qmi_client_loc_start (self->priv->client,
+                          input,
+                          REQUEST_TIMEOUT,
+                          NULL,
+                          (GAsyncReadyCallback)start_ready,
+                          g_object_ref (self));
+    qmi_message_loc_start_input_unref (input);
+}
+
+static void
+register_events_ready (QmiClientLoc     *client,
+                       GAsyncResult     *res,
+                       QmiLocSessionMux *self)
+{
+    QmiMessageLocRegisterEventsOutput *output;
+    GError                            *error = NULL;
+
+    output = qmi_client_loc_register_events_finish (client, res, &error);
+    if (!output || !qmi_message_loc_register_events_output_get_result (output, &error))
+        g_prefix_error (&error, "Couldn't register LOC events: ");
+    else
+        self->priv->events_registered = TRUE;
+
+    if (output)
+        qmi_message_loc_register_events_output_unref (output);
+
+    if (!self->priv->client)
+        g_clear_error (&error);
+    else if (error)
+        operation_finish (self, error);
+    else
+        session_start (self);
+    g_object_unref (self);
+}
+
+static void
+session_stop (QmiLocSessionMux *self)
+{
+    QmiMessageLocStopInput *input;
+
+    /* No need to wait for the result */
+    input = qmi_message_loc_stop_input_new ();
+    qmi_message_loc_stop_input_set_session_id (input, SESSION_ID, NULL);
+    qmi_client_loc_stop (self->priv->client, input, REQUEST_TIMEOUT, NULL, NULL, NULL);
+    qmi_message_loc_stop_input_unref (input);
+
+    g_debug ("LOC session stopped");
+    self->priv->interval = 0;
+}
+
+static void
+session_update (QmiLocSessionMux *self)
+{
+    guint interval = 0;
+    guint i;
+
+    if (self->priv->operation_running) {
+        self->priv->update_pending = TRUE;
+        return;
+    }
+
+    /* The session runs at the shortest interval requested */
+    for (i = 0; i < self->priv->subscribers->len; i++) {
+        Subscriber *subscriber;
+
+        subscriber = g_ptr_array_index (self->priv->subscribers, i);
+        if (subscriber->callback && (!interval || subscriber->interval < interval))
+            interval = subscriber->interval;
+    }
+
+    if (interval == self->priv->interval)
+        return;
+
+    if (!interval) {
+        session_stop (self);
+        return;
+    }
+
+    self->priv->operation_running = TRUE;
+    self->priv->operation_interval = interval;
+
+    if (!self->priv->events_registered) {
+        QmiMessageLocRegisterEventsInput *input;
+
+        input = qmi_message_loc_register_events_input_new ();
+        qmi_message_loc_register_events_input_set_event_registration_mask (input, EVENT_REGISTRATION_MASK_POSITION_REPORT, NULL);
+        qmi_client_loc_register_events (self->priv->client,
+                                        input,
+                                        REQUEST_TIMEOUT,
+                                        NULL,
+                                        (GAsyncReadyCallback)register_events_ready,
+                                        g_object_ref (self));
+        qmi_message_loc_register_events_input_unref (input);
+        return;
+    }
+
+    session_start (self);
+}
+
+/*****************************************************************************/
+
+QmiLocSessionMux *
+qmi_loc_session_mux_get (QmiClientLoc *client)
+{
+    QmiLocSessionMux *self;
+
+    g_return_val_if_fail (QMI_IS_CLIENT_LOC (client), NULL);
+
+    self = g_object_get_data (G_OBJECT (client), CLIENT_DATA_KEY);
+    if (self)
+        return g_object_ref (self);
+
+    /* The object clears the data itself when disposed */
+    self = g_object_new (QMI_TYPE_LOC_SESSION_MUX,
+                         QMI_LOC_SESSION_MUX_CLIENT, client,
+                         NULL);
+    g_object_set_data (G_OBJECT (client), CLIENT_DATA_KEY, self);
+    return self;
+}
+
+/*****************************************************************************/
+
+static void
+set_property (GObject      *object,
+              guint         prop_id,
+              const GValue *value,
+              GParamSpec   *pspec)
+{
+    QmiLocSessionMux *self = QMI_LOC_SESSION_MUX (object);
+
+    switch (prop_id) {
+    case PROP_CLIENT:
+        g_assert (self->priv->client == NULL);
+        self->priv->client = g_value_dup_object (value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+get_property (GObject    *object,
+              guint       prop_id,
+              GValue     *value,
+              GParamSpec *pspec)
+{
+    QmiLocSessionMux *self = QMI_LOC_SESSION_MUX (object);
+
+    switch (prop_id) {
+    case PROP_CLIENT:
+        g_value_set_object (value, self->priv->client);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+qmi_loc_session_mux_init (QmiLocSessionMux *self)
+{
+    self->priv = G_TYPE_INSTANCE_GET_PRIVATE ((self),
+                                              QMI_TYPE_LOC_SESSION_MUX,
+                                              QmiLocSessionMuxPrivate);
+
+    self->priv->subscribers = g_ptr_array_new_with_free_func ((GDestroyNotify) subscriber_free);
+}
+
+static void
+constructed (GObject *object)
+{
+    QmiLocSessionMux *self = QMI_LOC_SESSION_MUX (object);
+
+    G_OBJECT_CLASS (qmi_loc_session_mux_parent_class)->constructed (object);
+
+    g_assert (self->priv->client);
+    self->priv->position_report_id = qmi_client_add_indication_callback (QMI_CLIENT (self->priv->client),
+                                                                         POSITION_REPORT_INDICATION_ID,
+                                                                         (QmiClientIndicationCallback) position_report_indication_cb,
+                                                                         self,
+                                                                         NULL);
+}
+
+static void
+dispose (GObject *object)
+{
+    QmiLocSessionMux *self = QMI_LOC_SESSION_MUX (object);
+
+    if (self->priv->client) {
+        if (g_object_get_data (G_OBJECT (self->priv->client), CLIENT_DATA_KEY) == self)
+            g_object_set_data (G_OBJECT (self->priv->client), CLIENT_DATA_KEY, NULL);
+
+        if (self->priv->position_report_id) {
+            qmi_client_remove_indication_callback (QMI_CLIENT (self->priv->client), self->priv->position_report_id);
+            self->priv->position_report_id = 0;
+        }
+
+        if (self->priv->interval || self->priv->operation_running)
+            session_stop (self);
+
+        g_clear_object (&self->priv->client);
+    }
+
+    g_ptr_array_set_size (self->priv->subscribers, 0);
+
+    G_OBJECT_CLASS (qmi_loc_session_mux_parent_class)->dispose (object);
+}
+
+static void
+finalize (GObject *object)
+{
+    QmiLocSessionMux *self = QMI_LOC_SESSION_MUX (object);
+
+    g_ptr_array_unref (self->priv->subscribers);
+
+    G_OBJECT_CLASS (qmi_loc_session_mux_parent_class)->finalize (object);
+}
+
+static void
+qmi_loc_session_mux_class_init (QmiLocSessionMuxClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    g_type_class_add_private (object_class, sizeof (QmiLocSessionMuxPrivate));
+
+    object_class->get_property = get_property;
+    object_class->set_property = set_property;
+    object_class->constructed = constructed;
+    object_class->dispose = dispose;
+    object_class->finalize = finalize;
+
+    /**
+     * QmiLocSessionMux:loc-session-mux-client:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_CLIENT] =
+        g_param_spec_object (QMI_LOC_SESSION_MUX_CLIENT,
+                             "LOC client",
+                             "The LOC client running the session",
+                             QMI_TYPE_CLIENT_LOC,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_CLIENT, properties[PROP_CLIENT]);
+
+    /**
+     * QmiLocSessionMux::session-error:
+     * @object: A #QmiLocSessionMux.
+     * @error: the #GError.
+     *
+     * The ::session-error signal is emitted when the LOC session couldn't be
+     * started or reconfigured. It is retried the next time the subscribers
+     * change.
+     *
+     * Since: 1.20
+     */
+    signals[SIGNAL_SESSION_ERROR] =
+        g_signal_new (QMI_LOC_SESSION_MUX_SIGNAL_SESSION_ERROR,
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      1,
+                      G_TYPE_POINTER);
+}
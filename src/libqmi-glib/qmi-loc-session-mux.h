@@ -0,0 +1,267 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_LOC_SESSION_MUX_H_
+#define _LIBQMI_GLIB_QMI_LOC_SESSION_MUX_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "qmi-enums-loc.h"
+#include "qmi-loc.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-loc-session-mux
+ * @title: QmiLocSessionMux
+ * @short_description: single LOC session shared by several consumers
+ *
+ * The #QmiLocSessionMux runs a single LOC session in the modem on behalf of
+ * all the consumers of a #QmiClientLoc, instead of each of them starting its
+ * own session and receiving its own copy of every Position Report indication.
+ *
+ * Each subscriber requests the interval at which it wants to receive position
+ * records; the session is run at the shortest of the intervals requested, and
+ * reconfigured whenever subscribers come and go. Each Position Report
+ * indication is parsed once into a fixed-layout #QmiLocPosition, which is
+ * then given to every subscriber whose own interval has elapsed, so that
+ * subscribers with longer intervals receive a decimated stream.
+ *
+ * The same #QmiLocSessionMux is shared by all the users of a given client
+ * within the process, see qmi_loc_session_mux_get(). When the device is
+ * opened through the qmi-proxy, each process runs its own single session.
+ */
+
+/**
+ * QmiLocPositionField:
+ * @QMI_LOC_POSITION_FIELD_NONE: No field given.
+ * @QMI_LOC_POSITION_FIELD_LATITUDE: The latitude is given.
+ * @QMI_LOC_POSITION_FIELD_LONGITUDE: The longitude is given.
+ * @QMI_LOC_POSITION_FIELD_HORIZONTAL_UNCERTAINTY: The circular horizontal uncertainty is given.
+ * @QMI_LOC_POSITION_FIELD_HORIZONTAL_SPEED: The horizontal speed is given.
+ * @QMI_LOC_POSITION_FIELD_ALTITUDE: The altitude is given.
+ * @QMI_LOC_POSITION_FIELD_HEADING: The heading is given.
+ * @QMI_LOC_POSITION_FIELD_UTC_TIMESTAMP: The UTC timestamp is given.
+ *
+ * Fields given in a #QmiLocPosition.
+ *
+ * Since: 1.20
+ */
+typedef enum {
+    QMI_LOC_POSITION_FIELD_NONE                   = 0,
+    QMI_LOC_POSITION_FIELD_LATITUDE               = 1 << 0,
+    QMI_LOC_POSITION_FIELD_LONGITUDE              = 1 << 1,
+    QMI_LOC_POSITION_FIELD_HORIZONTAL_UNCERTAINTY = 1 << 2,
+    QMI_LOC_POSITION_FIELD_HORIZONTAL_SPEED       = 1 << 3,
+    QMI_LOC_POSITION_FIELD_ALTITUDE               = 1 << 4,
+    QMI_LOC_POSITION_FIELD_HEADING                = 1 << 5,
+    QMI_LOC_POSITION_FIELD_UTC_TIMESTAMP          = 1 << 6,
+} QmiLocPositionField;
+
+/**
+ * QmiLocPosition:
+ * @timestamp: monotonic time when the report was received, in microseconds.
+ * @session_status: a #QmiLocSessionStatus.
+ * @fields: mask of #QmiLocPositionField values specifying which of the fields below are given.
+ * @latitude: latitude, in degrees.
+ * @longitude: longitude, in degrees.
+ * @horizontal_uncertainty: circular horizontal uncertainty, in meters.
+ * @horizontal_speed: horizontal speed, in meters per second.
+ * @altitude: altitude with respect to the WGS-84 ellipsoid, in meters.
+ * @heading: heading, in degrees.
+ * @utc_timestamp: UTC time of the fix, in milliseconds since the epoch.
+ *
+ * A position record given to the subscribers of a #QmiLocSessionMux.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    gint64              timestamp;
+    QmiLocSessionStatus session_status;
+    guint32             fields;
+    gdouble             latitude;
+    gdouble             longitude;
+    gfloat              horizontal_uncertainty;
+    gfloat              horizontal_speed;
+    gfloat              altitude;
+    gfloat              heading;
+    guint64             utc_timestamp;
+} QmiLocPosition;
+
+#define QMI_TYPE_LOC_SESSION_MUX            (qmi_loc_session_mux_get_type ())
+#define QMI_LOC_SESSION_MUX(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), QMI_TYPE_LOC_SESSION_MUX, QmiLocSessionMux))
+#define QMI_LOC_SESSION_MUX_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  QMI_TYPE_LOC_SESSION_MUX, QmiLocSessionMuxClass))
+#define QMI_IS_LOC_SESSION_MUX(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), QMI_TYPE_LOC_SESSION_MUX))
+#define QMI_IS_LOC_SESSION_MUX_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  QMI_TYPE_LOC_SESSION_MUX))
+#define QMI_LOC_SESSION_MUX_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  QMI_TYPE_LOC_SESSION_MUX, QmiLocSessionMuxClass))
+
+typedef struct _QmiLocSessionMux QmiLocSessionMux;
+typedef struct _QmiLocSessionMuxClass QmiLocSessionMuxClass;
+typedef struct _QmiLocSessionMuxPrivate QmiLocSessionMuxPrivate;
+
+/**
+ * QMI_LOC_SESSION_MUX_CLIENT:
+ *
+ * Symbol defining the #QmiLocSessionMux:loc-session-mux-client property.
+ *
+ * Since: 1.20
+ */
+#define QMI_LOC_SESSION_MUX_CLIENT "loc-session-mux-client"
+
+/**
+ * QMI_LOC_SESSION_MUX_SIGNAL_SESSION_ERROR:
+ *
+ * Symbol defining the #QmiLocSessionMux::session-error signal.
+ *
+ * Since: 1.20
+ */
+#define QMI_LOC_SESSION_MUX_SIGNAL_SESSION_ERROR "session-error"
+
+/**
+ * QmiLocSessionMux:
+ *
+ * The #QmiLocSessionMux structure contains private data and should only be
+ * accessed using the provided API.
+ *
+ * Since: 1.20
+ */
+struct _QmiLocSessionMux {
+    /*< private >*/
+    GObject parent;
+    QmiLocSessionMuxPrivate *priv;
+};
+
+struct _QmiLocSessionMuxClass {
+    /*< private >*/
+    GObjectClass parent;
+};
+
+GType qmi_loc_session_mux_get_type (void);
+
+/**
+ * QmiLocSessionMuxPositionCallback:
+ * @self: a #QmiLocSessionMux.
+ * @position: the #QmiLocPosition, only valid during the call.
+ * @user_data: the data given when subscribing.
+ *
+ * Callback given to qmi_loc_session_mux_subscribe().
+ *
+ * Since: 1.20
+ */
+typedef void (* QmiLocSessionMuxPositionCallback) (QmiLocSessionMux     *self,
+                                                   const QmiLocPosition *position,
+                                                   gpointer              user_data);
+
+/**
+ * qmi_loc_session_mux_get:
+ * @client: a #QmiClientLoc.
+ *
+ * Gets the #QmiLocSessionMux of @client, creating it if there was none.
+ *
+ * All the callers within the process get the same object for the same
+ * @client, so that they all share the same LOC session. No LOC session is
+ * started until the first subscriber is added.
+ *
+ * The #QmiLocSessionMux must be used from the thread-default main context
+ * where @client processes its indications.
+ *
+ * Returns: (transfer full): a #QmiLocSessionMux. The returned value should be freed with g_object_unref().
+ *
+ * Since: 1.20
+ */
+QmiLocSessionMux *qmi_loc_session_mux_get (QmiClientLoc *client);
+
+/**
+ * qmi_loc_session_mux_peek_client:
+ * @self: a #QmiLocSessionMux.
+ *
+ * Gets the #QmiClientLoc used by @self.
+ *
+ * Returns: (transfer none): a #QmiClientLoc. Do not free the returned object, it is owned by @self.
+ *
+ * Since: 1.20
+ */
+QmiClientLoc *qmi_loc_session_mux_peek_client (QmiLocSessionMux *self);
+
+/**
+ * qmi_loc_session_mux_subscribe:
+ * @self: a #QmiLocSessionMux.
+ * @interval: the interval between position records, in milliseconds, at least 100.
+ * @callback: a #QmiLocSessionMuxPositionCallback called for each position record.
+ * @user_data: the data to pass to @callback.
+ * @user_data_free_func: (nullable): a #GDestroyNotify to free @user_data, or %NULL.
+ *
+ * Adds a subscriber to the position records of @self.
+ *
+ * If @interval is shorter than the one of the running session, the session
+ * is reconfigured; the session is started if it was not running. Errors
+ * starting or reconfiguring the session are notified in the
+ * #QmiLocSessionMux::session-error signal.
+ *
+ * Returns: the subscription id, to be given to qmi_loc_session_mux_unsubscribe().
+ *
+ * Since: 1.20
+ */
+guint qmi_loc_session_mux_subscribe (QmiLocSessionMux                 *self,
+                                     guint                             interval,
+                                     QmiLocSessionMuxPositionCallback  callback,
+                                     gpointer                          user_data,
+                                     GDestroyNotify                    user_data_free_func);
+
+/**
+ * qmi_loc_session_mux_unsubscribe:
+ * @self: a #QmiLocSessionMux.
+ * @id: a subscription id returned by qmi_loc_session_mux_subscribe().
+ *
+ * Removes a subscriber from the position records of @self. It may be called
+ * from within the subscriber callback.
+ *
+ * The session is reconfigured if the remaining subscribers allow a longer
+ * interval, and stopped if there are none left.
+ *
+ * Since: 1.20
+ */
+void qmi_loc_session_mux_unsubscribe (QmiLocSessionMux *self,
+                                      guint             id);
+
+/**
+ * qmi_loc_session_mux_get_interval:
+ * @self: a #QmiLocSessionMux.
+ *
+ * Gets the interval between position reports requested to the modem in the
+ * running session.
+ *
+ * Returns: the interval, in milliseconds, or 0 if no session is running.
+ *
+ * Since: 1.20
+ */
+guint qmi_loc_session_mux_get_interval (QmiLocSessionMux *self);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_LOC_SESSION_MUX_H_ */
@@ -0,0 +1,450 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+#include <unistd.h>
+#include <gio/gio.h>
+#include <gio/gunixfdlist.h>
+
+#include "qmi-low-power.h"
+
+/*****************************************************************************/
+/* Indication registrations
+ *
+ * Every TLV of these requests starts with the flag (or period) enabling the
+ * reports. */
+
+static const struct {
+    QmiService service;
+    guint16    message_id;
+} gated_registrations[] = {
+    { QMI_SERVICE_NAS, 0x0002 }, /* Set Event Report */
+    { QMI_SERVICE_NAS, 0x0003 }, /* Register Indications */
+    { QMI_SERVICE_WDS, 0x0001 }, /* Set Event Report */
+    { QMI_SERVICE_DMS, 0x0001 }, /* Set Event Report */
+};
+
+#define INDICATION_REGISTRATION_KEY(service, cid, message_id) \
+    GUINT_TO_POINTER (((guint8)(service) << 24) | ((guint8)(cid) << 16) | (guint16)(message_id))
+
+typedef struct {
+    guint8  type;
+    GBytes *value;
+} IndicationRegistrationTlv;
+
+typedef struct {
+    QmiService  service;
+    guint8      cid;
+    guint16     message_id;
+    GArray     *tlvs;
+} IndicationRegistration;
+
+struct _QmiIndicationRegistrations {
+    /* Indexed by service, CID and message ID */
+    GMutex      lock;
+    GHashTable *table;
+    gboolean    low_power;
+};
+
+static void
+indication_registration_tlv_clear (IndicationRegistrationTlv *tlv)
+{
+    g_bytes_unref (tlv->value);
+}
+
+static void
+indication_registration_free (IndicationRegistration *registration)
+{
+    g_array_unref (registration->tlvs);
+    g_slice_free (IndicationRegistration, registration);
+}
+
+static void
+indication_registration_merge_tlv (guint8        type,
+                                   const guint8 *value,
+                                   gsize         length,
+                                   GArray       *tlvs)
+{
+    IndicationRegistrationTlv new_tlv;
+    guint                     i;
+
+    /* The last value given for each TLV is the one in effect */
+    for (i = 0; i < tlvs->len; i++) {
+        IndicationRegistrationTlv *tlv;
+
+        tlv = &g_array_index (tlvs, IndicationRegistrationTlv, i);
+        if (tlv->type == type) {
+            g_bytes_unref (tlv->value);
+            tlv->value = g_bytes_new (value, length);
+            return;
+        }
+    }
+
+    new_tlv.type = type;
+    new_tlv.value = g_bytes_new (value, length);
+    g_array_append_val (tlvs, new_tlv);
+}
+
+static QmiMessage *
+indication_registration_build (IndicationRegistration *registration,
+                               guint16                 transaction_id,
+                               gboolean                disabled)
+{
+    QmiMessage *message;
+    guint       i;
+
+    message = qmi_message_new (registration->service,
+                               registration->cid,
+                               transaction_id,
+                               registration->message_id);
+
+    for (i = 0; i < registration->tlvs->len; i++) {
+        IndicationRegistrationTlv *tlv;
+        const guint8              *value;
+        gsize                      length;
+        guint8                    *disabled_value;
+
+        tlv = &g_array_index (registration->tlvs, IndicationRegistrationTlv, i);
+        value = g_bytes_get_data (tlv->value, &length);
+        if (!disabled || !length) {
+            qmi_message_add_raw_tlv (message, tlv->type, value, length, NULL);
+            continue;
+        }
+
+        /* Reporting flag or period cleared, with the rest of the TLV as is;
+         * battery level limits are the only TLV without such a flag, so the
+         * whole range is given instead */
+        disabled_value = g_memdup (value, length);
+        disabled_value[0] = 0;
+        if (registration->service == QMI_SERVICE_DMS && tlv->type == 0x11 && length == 2)
+            disabled_value[1] = 100;
+        qmi_message_add_raw_tlv (message, tlv->type, disabled_value, length, NULL);
+        g_free (disabled_value);
+    }
+
+    return message;
+}
+
+gboolean
+__qmi_indication_registrations_record (QmiIndicationRegistrations *registrations,
+                                       QmiMessage                 *message)
+{
+    IndicationRegistration *registration;
+    QmiService              service;
+    guint16                 message_id;
+    guint8                  cid;
+    gpointer                key;
+    guint                   i;
+
+    service = qmi_message_get_service (message);
+    if (service == QMI_SERVICE_CTL)
+        return FALSE;
+
+    message_id = qmi_message_get_message_id (message);
+    for (i = 0; i < G_N_ELEMENTS (gated_registrations); i++) {
+        if (gated_registrations[i].service == service && gated_registrations[i].message_id == message_id)
+            break;
+    }
+    if (i == G_N_ELEMENTS (gated_registrations))
+        return FALSE;
+
+    cid = qmi_message_get_client_id (message);
+    key = INDICATION_REGISTRATION_KEY (service, cid, message_id);
+
+    g_mutex_lock (&registrations->lock);
+    registration = g_hash_table_lookup (registrations->table, key);
+    if (!registration) {
+        registration = g_slice_new (IndicationRegistration);
+        registration->service = service;
+        registration->cid = cid;
+        registration->message_id = message_id;
+        registration->tlvs = g_array_new (FALSE, FALSE, sizeof (IndicationRegistrationTlv));
+        g_array_set_clear_func (registration->tlvs, (GDestroyNotify)indication_registration_tlv_clear);
+        g_hash_table_insert (registrations->table, key, registration);
+    }
+    qmi_message_foreach_raw_tlv (message,
+                                 (QmiMessageForeachRawTlvFn)indication_registration_merge_tlv,
+                                 registration->tlvs);
+    g_mutex_unlock (&registrations->lock);
+    return TRUE;
+}
+
+typedef struct {
+    QmiService service;
+    guint8     cid;
+} ForgetContext;
+
+static gboolean
+indication_registration_match_client (gpointer                key,
+                                      IndicationRegistration *registration,
+                                      ForgetContext          *ctx)
+{
+    return (registration->service == ctx->service && registration->cid == ctx->cid);
+}
+
+void
+__qmi_indication_registrations_forget (QmiIndicationRegistrations *registrations,
+                                       QmiService                  service,
+                                       guint8                      cid)
+{
+    ForgetContext ctx = { service, cid };
+
+    g_mutex_lock (&registrations->lock);
+    g_hash_table_foreach_remove (registrations->table,
+                                 (GHRFunc)indication_registration_match_client,
+                                 &ctx);
+    g_mutex_unlock (&registrations->lock);
+}
+
+void
+__qmi_indication_registrations_clear (QmiIndicationRegistrations *registrations)
+{
+    g_mutex_lock (&registrations->lock);
+    g_hash_table_remove_all (registrations->table);
+    registrations->low_power = FALSE;
+    g_mutex_unlock (&registrations->lock);
+}
+
+GPtrArray *
+__qmi_indication_registrations_set_low_power (QmiIndicationRegistrations                *registrations,
+                                              gboolean                                   low_power,
+                                              QmiIndicationRegistrationsTransactionIdFn  transaction_id_fn,
+                                              gpointer                                   user_data)
+{
+    GPtrArray              *messages = NULL;
+    GHashTableIter          iter;
+    IndicationRegistration *registration;
+
+    g_mutex_lock (&registrations->lock);
+    if (registrations->low_power != !!low_power) {
+        registrations->low_power = !!low_power;
+        messages = g_ptr_array_new_with_free_func ((GDestroyNotify)qmi_message_unref);
+        g_hash_table_iter_init (&iter, registrations->table);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&registration)) {
+            guint16 transaction_id;
+
+            if (transaction_id_fn (registration->service, registration->cid, &transaction_id, user_data))
+                g_ptr_array_add (messages, indication_registration_build (registration, transaction_id, low_power));
+        }
+    }
+    g_mutex_unlock (&registrations->lock);
+
+    return messages;
+}
+
+QmiIndicationRegistrations *
+__qmi_indication_registrations_new (void)
+{
+    QmiIndicationRegistrations *registrations;
+
+    registrations = g_slice_new0 (QmiIndicationRegistrations);
+    g_mutex_init (&registrations->lock);
+    registrations->table = g_hash_table_new_full (g_direct_hash,
+                                                  g_direct_equal,
+                                                  NULL,
+                                                  (GDestroyNotify)indication_registration_free);
+    return registrations;
+}
+
+void
+__qmi_indication_registrations_free (QmiIndicationRegistrations *registrations)
+{
+    g_hash_table_unref (registrations->table);
+    g_mutex_clear (&registrations->lock);
+    g_slice_free (QmiIndicationRegistrations, registrations);
+}
+
+/*****************************************************************************/
+/* Suspend monitor */
+
+struct _QmiSuspendMonitor {
+    GDBusConnection     *connection;
+    gchar               *path_display;
+    QmiSuspendMonitorFn  callback;
+    gpointer             user_data;
+    guint                subscription_id;
+    gint                 inhibitor_fd;
+    /* Set while an Inhibit call is ongoing, cancelled when freed */
+    GCancellable        *inhibitor_cancellable;
+};
+
+typedef struct {
+    QmiSuspendMonitor *monitor;
+    GCancellable      *cancellable;
+} InhibitorContext;
+
+void
+__qmi_suspend_monitor_release (QmiSuspendMonitor *monitor)
+{
+    if (monitor->inhibitor_fd < 0)
+        return;
+
+    close (monitor->inhibitor_fd);
+    monitor->inhibitor_fd = -1;
+}
+
+static void
+inhibitor_ready (GDBusConnection  *connection,
+                 GAsyncResult     *res,
+                 InhibitorContext *ctx)
+{
+    QmiSuspendMonitor *monitor;
+    GVariant          *reply;
+    GUnixFDList       *fd_list = NULL;
+    GError            *error = NULL;
+    gint32             index;
+
+    reply = g_dbus_connection_call_with_unix_fd_list_finish (connection, &fd_list, res, &error);
+
+    /* The monitor is gone if cancelled, whatever the result */
+    if (g_cancellable_is_cancelled (ctx->cancellable)) {
+        g_clear_error (&error);
+        goto out;
+    }
+
+    monitor = ctx->monitor;
+    g_clear_object (&monitor->inhibitor_cancellable);
+
+    if (!reply) {
+        g_debug ("[%s] Couldn't take suspend delay inhibitor: %s",
+                 monitor->path_display, error->message);
+        g_error_free (error);
+        goto out;
+    }
+
+    g_variant_get (reply, "(h)", &index);
+    monitor->inhibitor_fd = g_unix_fd_list_get (fd_list, index, &error);
+    if (monitor->inhibitor_fd < 0) {
+        g_debug ("[%s] Couldn't get suspend delay inhibitor: %s",
+                 monitor->path_display, error->message);
+        g_error_free (error);
+    }
+
+out:
+    if (reply)
+        g_variant_unref (reply);
+    g_clear_object (&fd_list);
+    g_object_unref (ctx->cancellable);
+    g_slice_free (InhibitorContext, ctx);
+}
+
+static void
+inhibitor_take (QmiSuspendMonitor *monitor)
+{
+    InhibitorContext *ctx;
+
+    if (monitor->inhibitor_fd >= 0 || monitor->inhibitor_cancellable)
+        return;
+
+    monitor->inhibitor_cancellable = g_cancellable_new ();
+
+    ctx = g_slice_new (InhibitorContext);
+    ctx->monitor = monitor;
+    ctx->cancellable = g_object_ref (monitor->inhibitor_cancellable);
+
+    g_dbus_connection_call_with_unix_fd_list (monitor->connection,
+                                              QMI_SUSPEND_MONITOR_LOGIND_BUS_NAME,
+                                              QMI_SUSPEND_MONITOR_LOGIND_OBJECT_PATH,
+                                              QMI_SUSPEND_MONITOR_LOGIND_INTERFACE,
+                                              "Inhibit",
+                                              g_variant_new ("(ssss)",
+                                                             "sleep",
+                                                             "libqmi",
+                                                             "Disabling modem indications",
+                                                             "delay"),
+                                              G_VARIANT_TYPE ("(h)"),
+                                              G_DBUS_CALL_FLAGS_NONE,
+                                              -1,
+                                              NULL,
+                                              ctx->cancellable,
+                                              (GAsyncReadyCallback)inhibitor_ready,
+                                              ctx);
+}
+
+static void
+prepare_for_sleep (GDBusConnection   *connection,
+                   const gchar       *sender_name,
+                   const gchar       *object_path,
+                   const gchar       *interface_name,
+                   const gchar       *signal_name,
+                   GVariant          *parameters,
+                   QmiSuspendMonitor *monitor)
+{
+    gboolean suspending;
+
+    if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(b)")))
+        return;
+
+    g_variant_get (parameters, "(b)", &suspending);
+    g_debug ("[%s] Host %s", monitor->path_display, suspending ? "suspending" : "resumed");
+
+    if (!suspending)
+        inhibitor_take (monitor);
+
+    monitor->callback (monitor, suspending, monitor->user_data);
+}
+
+QmiSuspendMonitor *
+__qmi_suspend_monitor_new (GDBusConnection     *connection,
+                           const gchar         *path_display,
+                           QmiSuspendMonitorFn  callback,
+                           gpointer             user_data)
+{
+    QmiSuspendMonitor *monitor;
+
+    monitor = g_slice_new0 (QmiSuspendMonitor);
+    monitor->connection = g_object_ref (connection);
+    monitor->path_display = g_strdup (path_display);
+    monitor->callback = callback;
+    monitor->user_data = user_data;
+    monitor->inhibitor_fd = -1;
+
+    monitor->subscription_id =
+        g_dbus_connection_signal_subscribe (connection,
+                                            QMI_SUSPEND_MONITOR_LOGIND_BUS_NAME,
+                                            QMI_SUSPEND_MONITOR_LOGIND_INTERFACE,
+                                            "PrepareForSleep",
+                                            QMI_SUSPEND_MONITOR_LOGIND_OBJECT_PATH,
+                                            NULL,
+                                            G_DBUS_SIGNAL_FLAGS_NONE,
+                                            (GDBusSignalCallback)prepare_for_sleep,
+                                            monitor,
+                                            NULL);
+    inhibitor_take (monitor);
+
+    return monitor;
+}
+
+void
+__qmi_suspend_monitor_free (QmiSuspendMonitor *monitor)
+{
+    g_dbus_connection_signal_unsubscribe (monitor->connection, monitor->subscription_id);
+    if (monitor->inhibitor_cancellable) {
+        g_cancellable_cancel (monitor->inhibitor_cancellable);
+        g_object_unref (monitor->inhibitor_cancellable);
+    }
+    __qmi_suspend_monitor_release (monitor);
+    g_object_unref (monitor->connection);
+    g_free (monitor->path_display);
+    g_slice_free (QmiSuspendMonitor, monitor);
+}
@@ -0,0 +1,120 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_LOW_POWER_H_
+#define _LIBQMI_GLIB_QMI_LOW_POWER_H_
+
+#if !defined (LIBQMI_GLIB_COMPILATION)
+#error "This is a private header."
+#endif
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "qmi-message.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Indication registrations of QmiDevice.
+ *
+ * The requests enabling periodic or frequent indications are recorded for
+ * each client as they're sent, merging the TLVs of all the ones sent, so
+ * that while the host is idle or suspended all of them can be disabled at
+ * once, and restored later on, without the clients being involved. All the
+ * operations may be run from any thread.
+ */
+
+typedef struct _QmiIndicationRegistrations QmiIndicationRegistrations;
+
+/* Next transaction ID of the client with @cid, FALSE if it's gone */
+typedef gboolean (* QmiIndicationRegistrationsTransactionIdFn) (QmiService  service,
+                                                                guint8      cid,
+                                                                guint16    *transaction_id,
+                                                                gpointer    user_data);
+
+G_GNUC_INTERNAL
+QmiIndicationRegistrations *__qmi_indication_registrations_new    (void);
+
+G_GNUC_INTERNAL
+void                        __qmi_indication_registrations_free   (QmiIndicationRegistrations *registrations);
+
+/* Returns whether @message is one of the recorded registrations */
+G_GNUC_INTERNAL
+gboolean                    __qmi_indication_registrations_record (QmiIndicationRegistrations *registrations,
+                                                                   QmiMessage                 *message);
+
+G_GNUC_INTERNAL
+void                        __qmi_indication_registrations_forget (QmiIndicationRegistrations *registrations,
+                                                                   QmiService                  service,
+                                                                   guint8                      cid);
+
+/* Forgets all of them, and leaves low-power mode */
+G_GNUC_INTERNAL
+void                        __qmi_indication_registrations_clear  (QmiIndicationRegistrations *registrations);
+
+/* Switches the mode, and builds the requests disabling or restoring the
+ * registrations of the clients still there; returns NULL if already in
+ * that mode */
+G_GNUC_INTERNAL
+GPtrArray                  *__qmi_indication_registrations_set_low_power (QmiIndicationRegistrations                *registrations,
+                                                                          gboolean                                   low_power,
+                                                                          QmiIndicationRegistrationsTransactionIdFn  transaction_id_fn,
+                                                                          gpointer                                   user_data);
+
+/*
+ * Suspend monitor of QmiDevice.
+ *
+ * logind announces the host suspend and resume with the PrepareForSleep
+ * signal, reported through the callback in the thread-default context where
+ * the monitor is created. A delay inhibitor is held while monitoring, so
+ * that the host waits before suspending until it is released with
+ * __qmi_suspend_monitor_release(); it's taken again after resuming.
+ */
+
+#define QMI_SUSPEND_MONITOR_LOGIND_BUS_NAME    "org.freedesktop.login1"
+#define QMI_SUSPEND_MONITOR_LOGIND_OBJECT_PATH "/org/freedesktop/login1"
+#define QMI_SUSPEND_MONITOR_LOGIND_INTERFACE   "org.freedesktop.login1.Manager"
+
+typedef struct _QmiSuspendMonitor QmiSuspendMonitor;
+
+typedef void (* QmiSuspendMonitorFn) (QmiSuspendMonitor *monitor,
+                                      gboolean           suspending,
+                                      gpointer           user_data);
+
+G_GNUC_INTERNAL
+QmiSuspendMonitor *__qmi_suspend_monitor_new     (GDBusConnection     *connection,
+                                                  const gchar         *path_display,
+                                                  QmiSuspendMonitorFn  callback,
+                                                  gpointer             user_data);
+
+G_GNUC_INTERNAL
+void               __qmi_suspend_monitor_free    (QmiSuspendMonitor *monitor);
+
+/* The host may go on with the suspend */
+G_GNUC_INTERNAL
+void               __qmi_suspend_monitor_release (QmiSuspendMonitor *monitor);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_LOW_POWER_H_ */
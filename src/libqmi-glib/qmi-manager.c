@@ -0,0 +1,809 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "qmi-manager.h"
+#include "qmi-client.h"
+
+G_DEFINE_TYPE (QmiManager, qmi_manager, G_TYPE_OBJECT)
+
+#define MAX_OPENING_DEFAULT 4
+
+/* Timeouts, in seconds */
+#define OPEN_TIMEOUT     15
+#define ALLOCATE_TIMEOUT 10
+#define RELEASE_TIMEOUT  5
+#define CLOSE_TIMEOUT    5
+
+/* Several ports of the same device usually appear or go away together, so
+ * wait a bit before rescanning, in milliseconds */
+#define RESCAN_DELAY 100
+
+enum {
+    PROP_0,
+    PROP_MAX_OPENING,
+    PROP_LAST
+};
+
+enum {
+    SIGNAL_DEVICE_ADDED,
+    SIGNAL_DEVICE_REMOVED,
+    SIGNAL_LAST
+};
+
+static GParamSpec *properties[PROP_LAST];
+static guint       signals[SIGNAL_LAST] = { 0 };
+
+typedef enum {
+    ENTRY_STATE_QUEUED,
+    ENTRY_STATE_OPENING,
+    ENTRY_STATE_READY,
+    ENTRY_STATE_FAILED,
+} EntryState;
+
+typedef struct {
+    volatile gint  ref_count;
+    /* NULL once the entry is no longer in the table */
+    QmiManager    *self;
+    gchar         *key;
+    gchar         *path;
+    EntryState     state;
+    GCancellable  *cancellable;
+    QmiDevice     *device;
+    gulong         device_removed_id;
+    GPtrArray     *clients;
+} Entry;
+
+struct _QmiManagerPrivate {
+    GMainContext       *context;
+    GCancellable       *cancellable;
+    QmiDeviceOpenFlags  open_flags;
+    GArray             *services;
+    guint               max_opening;
+
+    /* Entries by physical device path, and the ones waiting to be opened */
+    GHashTable         *entries;
+    GQueue             *queue;
+    guint               n_opening;
+
+    GFileMonitor       *monitor;
+    GSource            *rescan_source;
+    gboolean            enumerating;
+    gboolean            rescan_pending;
+};
+
+static void manager_schedule_rescan (QmiManager *self);
+static void manager_open_next       (QmiManager *self);
+
+/*****************************************************************************/
+/* Device shutdown, once the device is no longer managed */
+
+typedef struct {
+    QmiDevice *device;
+    guint      n_pending;
+} ShutdownContext;
+
+static void
+shutdown_close_ready (QmiDevice    *device,
+                      GAsyncResult *res,
+                      gpointer      user_data)
+{
+    GError *error = NULL;
+
+    if (!qmi_device_close_finish (device, res, &error)) {
+        g_debug ("[%s] couldn't close device: %s", qmi_device_get_path_display (device), error->message);
+        g_error_free (error);
+    }
+}
+
+static void
+shutdown_close (ShutdownContext *ctx)
+{
+    qmi_device_close_async (ctx->device, CLOSE_TIMEOUT, NULL,
+                            (GAsyncReadyCallback) shutdown_close_ready,
+                            NULL);
+    g_object_unref (ctx->device);
+    g_slice_free (ShutdownContext, ctx);
+}
+
+static void
+shutdown_release_client_ready (QmiDevice       *device,
+                               GAsyncResult    *res,
+                               ShutdownContext *ctx)
+{
+    GError *error = NULL;
+
+    if (!qmi_device_release_client_finish (device, res, &error)) {
+        g_debug ("[%s] couldn't release client: %s", qmi_device_get_path_display (device), error->message);
+        g_error_free (error);
+    }
+
+    if (--ctx->n_pending == 0)
+        shutdown_close (ctx);
+}
+
+/* Client IDs are only released in the device if it's still there */
+static void
+device_shutdown (QmiDevice *device,
+                 GPtrArray *clients,
+                 gboolean   release_cids)
+{
+    ShutdownContext *ctx;
+    guint            i;
+
+    ctx = g_slice_new0 (ShutdownContext);
+    ctx->device = g_object_ref (device);
+
+    for (i = 0; clients && i < clients->len; i++) {
+        QmiClient *client;
+
+        client = g_ptr_array_index (clients, i);
+        if (!client)
+            continue;
+        ctx->n_pending++;
+        qmi_device_release_client (device, client,
+                                   (release_cids ?
+                                    QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID :
+                                    QMI_DEVICE_RELEASE_CLIENT_FLAGS_NONE),
+                                   RELEASE_TIMEOUT, NULL,
+                                   (GAsyncReadyCallback) shutdown_release_client_ready,
+                                   ctx);
+    }
+
+    if (!ctx->n_pending)
+        shutdown_close (ctx);
+}
+
+/*****************************************************************************/
+/* Entries */
+
+static Entry *
+entry_new (QmiManager  *self,
+           const gchar *key,
+           const gchar *path)
+{
+    Entry *entry;
+
+    entry = g_slice_new0 (Entry);
+    entry->ref_count = 1;
+    entry->self = self;
+    entry->key = g_strdup (key);
+    entry->path = g_strdup (path);
+    entry->state = ENTRY_STATE_QUEUED;
+    return entry;
+}
+
+static Entry *
+entry_ref (Entry *entry)
+{
+    g_atomic_int_inc (&entry->ref_count);
+    return entry;
+}
+
+static void
+entry_unref (Entry *entry)
+{
+    if (g_atomic_int_dec_and_test (&entry->ref_count)) {
+        g_assert (!entry->device_removed_id);
+        g_clear_object (&entry->cancellable);
+        g_clear_object (&entry->device);
+        if (entry->clients)
+            g_ptr_array_unref (entry->clients);
+        g_free (entry->key);
+        g_free (entry->path);
+        g_slice_free (Entry, entry);
+    }
+}
+
+static void
+entry_device_removed_cb (QmiDevice *device,
+                         Entry     *entry)
+{
+    /* The table is only updated once the port is gone from sysfs as well */
+    if (entry->self)
+        manager_schedule_rescan (entry->self);
+}
+
+/* Called right before removing the entry from the table */
+static void
+entry_detach (Entry    *entry,
+              gboolean  port_available)
+{
+    QmiManager *self = entry->self;
+
+    g_assert (self);
+
+    switch (entry->state) {
+    case ENTRY_STATE_QUEUED:
+        if (g_queue_remove (self->priv->queue, entry))
+            entry_unref (entry);
+        break;
+    case ENTRY_STATE_OPENING:
+        /* The open operation cleans up when finished */
+        g_cancellable_cancel (entry->cancellable);
+        self->priv->n_opening--;
+        break;
+    case ENTRY_STATE_READY:
+        g_signal_handler_disconnect (entry->device, entry->device_removed_id);
+        entry->device_removed_id = 0;
+        if (!port_available)
+            g_signal_emit (self, signals[SIGNAL_DEVICE_REMOVED], 0, entry->device);
+        device_shutdown (entry->device, entry->clients, port_available);
+        break;
+    case ENTRY_STATE_FAILED:
+        break;
+    default:
+        g_assert_not_reached ();
+    }
+
+    entry->self = NULL;
+}
+
+static void
+entry_open_finish (Entry  *entry,
+                   GError *error)
+{
+    QmiManager *self = entry->self;
+
+    /* Removed while being opened */
+    if (!self) {
+        if (error)
+            g_error_free (error);
+        if (entry->device)
+            device_shutdown (entry->device, entry->clients, TRUE);
+        entry_unref (entry);
+        return;
+    }
+
+    self->priv->n_opening--;
+
+    if (error) {
+        g_warning ("[%s] couldn't bring up device: %s", entry->path, error->message);
+        g_error_free (error);
+        if (entry->device) {
+            device_shutdown (entry->device, entry->clients, TRUE);
+            g_clear_object (&entry->device);
+        }
+        if (entry->clients) {
+            g_ptr_array_unref (entry->clients);
+            entry->clients = NULL;
+        }
+        /* Retried on the next rescan */
+        entry->state = ENTRY_STATE_FAILED;
+    } else {
+        entry->state = ENTRY_STATE_READY;
+        entry->device_removed_id = g_signal_connect (entry->device,
+                                                     QMI_DEVICE_SIGNAL_REMOVED,
+                                                     G_CALLBACK (entry_device_removed_cb),
+                                                     entry);
+        g_object_ref (self);
+        g_signal_emit (self, signals[SIGNAL_DEVICE_ADDED], 0, entry->device, entry->clients);
+        g_object_unref (self);
+    }
+
+    manager_open_next (self);
+    entry_unref (entry);
+}
+
+static void
+allocate_clients_ready (QmiDevice    *device,
+                        GAsyncResult *res,
+                        Entry        *entry)
+{
+    GError *error = NULL;
+
+    entry->clients = qmi_device_allocate_clients_finish (device, res, NULL, &error);
+    entry_open_finish (entry, error);
+}
+
+static void
+device_open_ready (QmiDevice    *device,
+                   GAsyncResult *res,
+                   Entry        *entry)
+{
+    GError *error = NULL;
+
+    if (!qmi_device_open_finish (device, res, &error) || !entry->self ||
+        !entry->self->priv->services->len) {
+        entry_open_finish (entry, error);
+        return;
+    }
+
+    qmi_device_allocate_clients (device,
+                                 (const QmiService *) entry->self->priv->services->data,
+                                 entry->self->priv->services->len,
+                                 ALLOCATE_TIMEOUT,
+                                 entry->cancellable,
+                                 (GAsyncReadyCallback) allocate_clients_ready,
+                                 entry);
+}
+
+static void
+device_new_ready (GObject      *source,
+                  GAsyncResult *res,
+                  Entry        *entry)
+{
+    GError *error = NULL;
+
+    entry->device = qmi_device_new_finish (res, &error);
+    if (!entry->device || !entry->self) {
+        entry_open_finish (entry, error);
+        return;
+    }
+
+    qmi_device_open (entry->device,
+                     entry->self->priv->open_flags,
+                     OPEN_TIMEOUT,
+                     entry->cancellable,
+                     (GAsyncReadyCallback) device_open_ready,
+                     entry);
+}
+
+/* Takes ownership of the given reference */
+static void
+entry_open (Entry *entry)
+{
+    GFile *file;
+
+    entry->state = ENTRY_STATE_OPENING;
+    entry->self->priv->n_opening++;
+    g_clear_object (&entry->cancellable);
+    entry->cancellable = g_cancellable_new ();
+
+    g_debug ("[%s] bringing up device...", entry->path);
+    file = g_file_new_for_path (entry->path);
+    qmi_device_new (file,
+                    entry->cancellable,
+                    (GAsyncReadyCallback) device_new_ready,
+                    entry);
+    g_object_unref (file);
+}
+
+/*****************************************************************************/
+
+static void
+manager_open_next (QmiManager *self)
+{
+    while (self->priv->n_opening < self->priv->max_opening) {
+        Entry *entry;
+
+        entry = g_queue_pop_head (self->priv->queue);
+        if (!entry)
+            break;
+        entry_open (entry);
+    }
+}
+
+static void
+manager_queue_entry (QmiManager *self,
+                     Entry      *entry)
+{
+    entry->state = ENTRY_STATE_QUEUED;
+    g_queue_push_tail (self->priv->queue, entry_ref (entry));
+}
+
+static void
+manager_update (QmiManager *self,
+                GPtrArray  *ports)
+{
+    GHashTable     *found;
+    GHashTableIter  iter;
+    Entry          *entry;
+    guint           i;
+
+    found = g_hash_table_new (g_str_hash, g_str_equal);
+
+    for (i = 0; i < ports->len; i++) {
+        QmiDevicePortInfo *info;
+        const gchar       *key;
+
+        info = g_ptr_array_index (ports, i);
+        key = (info->physdev_path ? info->physdev_path : info->path);
+
+        /* Only the first control port of each device */
+        if (g_hash_table_contains (found, key))
+            continue;
+        g_hash_table_add (found, (gpointer) key);
+
+        entry = g_hash_table_lookup (self->priv->entries, key);
+
+        /* Same device, different port, so it was replugged */
+        if (entry && g_strcmp0 (entry->path, info->path) != 0) {
+            entry_detach (entry, FALSE);
+            g_hash_table_remove (self->priv->entries, key);
+            entry = NULL;
+        }
+
+        if (!entry) {
+            entry = entry_new (self, key, info->path);
+            g_hash_table_insert (self->priv->entries, entry->key, entry);
+            manager_queue_entry (self, entry);
+        } else if (entry->state == ENTRY_STATE_FAILED)
+            manager_queue_entry (self, entry);
+    }
+
+    g_hash_table_iter_init (&iter, self->priv->entries);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry)) {
+        if (g_hash_table_contains (found, entry->key))
+            continue;
+        entry_detach (entry, FALSE);
+        g_hash_table_iter_remove (&iter);
+    }
+
+    g_hash_table_unref (found);
+
+    manager_open_next (self);
+}
+
+static void manager_rescan (QmiManager *self);
+
+static void
+enumerate_ports_ready (GObject      *source,
+                       GAsyncResult *res,
+                       QmiManager   *self)
+{
+    GError    *error = NULL;
+    GPtrArray *ports;
+
+    self->priv->enumerating = FALSE;
+
+    ports = qmi_device_enumerate_ports_finish (res, &error);
+    if (!ports) {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            g_warning ("couldn't enumerate control ports: %s", error->message);
+        g_error_free (error);
+        g_object_unref (self);
+        return;
+    }
+
+    manager_update (self, ports);
+    g_ptr_array_unref (ports);
+
+    if (self->priv->rescan_pending) {
+        self->priv->rescan_pending = FALSE;
+        manager_rescan (self);
+    }
+
+    g_object_unref (self);
+}
+
+static void
+manager_rescan (QmiManager *self)
+{
+    /* Never more than one sweep at a time */
+    if (self->priv->enumerating) {
+        self->priv->rescan_pending = TRUE;
+        return;
+    }
+
+    self->priv->enumerating = TRUE;
+    qmi_device_enumerate_ports (self->priv->cancellable,
+                                (GAsyncReadyCallback) enumerate_ports_ready,
+                                g_object_ref (self));
+}
+
+static gboolean
+rescan_cb (QmiManager *self)
+{
+    g_source_unref (self->priv->rescan_source);
+    self->priv->rescan_source = NULL;
+    manager_rescan (self);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+manager_schedule_rescan (QmiManager *self)
+{
+    if (self->priv->rescan_source)
+        return;
+
+    self->priv->rescan_source = g_timeout_source_new (RESCAN_DELAY);
+    g_source_set_callback (self->priv->rescan_source, (GSourceFunc) rescan_cb, self, NULL);
+    g_source_attach (self->priv->rescan_source, self->priv->context);
+}
+
+static void
+dev_changed_cb (GFileMonitor      *monitor,
+                GFile             *file,
+                GFile             *other_file,
+                GFileMonitorEvent  event_type,
+                QmiManager        *self)
+{
+    gchar *name;
+
+    if (event_type != G_FILE_MONITOR_EVENT_CREATED && event_type != G_FILE_MONITOR_EVENT_DELETED)
+        return;
+
+    name = g_file_get_basename (file);
+    if (name && g_str_has_prefix (name, "cdc-wdm"))
+        manager_schedule_rescan (self);
+    g_free (name);
+}
+
+/*****************************************************************************/
+
+gboolean
+qmi_manager_start (QmiManager  *self,
+                   GError     **error)
+{
+    GFile *dev;
+
+    g_return_val_if_fail (QMI_IS_MANAGER (self), FALSE);
+    g_return_val_if_fail (!self->priv->monitor, FALSE);
+
+    /* udev creates the device nodes once the ports are ready in sysfs */
+    dev = g_file_new_for_path ("/dev");
+    self->priv->monitor = g_file_monitor_directory (dev, G_FILE_MONITOR_NONE, self->priv->cancellable, error);
+    g_object_unref (dev);
+    if (!self->priv->monitor) {
+        g_prefix_error (error, "Couldn't monitor control ports: ");
+        return FALSE;
+    }
+    g_signal_connect (self->priv->monitor, "changed", G_CALLBACK (dev_changed_cb), self);
+
+    manager_rescan (self);
+    return TRUE;
+}
+
+GPtrArray *
+qmi_manager_get_devices (QmiManager *self)
+{
+    GPtrArray      *devices;
+    GHashTableIter  iter;
+    Entry          *entry;
+
+    g_return_val_if_fail (QMI_IS_MANAGER (self), NULL);
+
+    devices = g_ptr_array_new_with_free_func (g_object_unref);
+    g_hash_table_iter_init (&iter, self->priv->entries);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry)) {
+        if (entry->state == ENTRY_STATE_READY)
+            g_ptr_array_add (devices, g_object_ref (entry->device));
+    }
+    return devices;
+}
+
+QmiDevice *
+qmi_manager_peek_device (QmiManager  *self,
+                         const gchar *physdev_path)
+{
+    Entry *entry;
+
+    g_return_val_if_fail (QMI_IS_MANAGER (self), NULL);
+    g_return_val_if_fail (physdev_path != NULL, NULL);
+
+    entry = g_hash_table_lookup (self->priv->entries, physdev_path);
+    return ((entry && entry->state == ENTRY_STATE_READY) ? entry->device : NULL);
+}
+
+GPtrArray *
+qmi_manager_peek_clients (QmiManager *self,
+                          QmiDevice  *device)
+{
+    GHashTableIter  iter;
+    Entry          *entry;
+
+    g_return_val_if_fail (QMI_IS_MANAGER (self), NULL);
+    g_return_val_if_fail (QMI_IS_DEVICE (device), NULL);
+
+    g_hash_table_iter_init (&iter, self->priv->entries);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry)) {
+        if (entry->state == ENTRY_STATE_READY && entry->device == device)
+            return entry->clients;
+    }
+    return NULL;
+}
+
+/*****************************************************************************/
+
+QmiManager *
+qmi_manager_new (QmiDeviceOpenFlags  open_flags,
+                 const QmiService   *services,
+                 guint               n_services)
+{
+    QmiManager *self;
+
+    g_return_val_if_fail (services != NULL || n_services == 0, NULL);
+
+    self = QMI_MANAGER (g_object_new (QMI_TYPE_MANAGER, NULL));
+    self->priv->open_flags = open_flags;
+    g_array_append_vals (self->priv->services, services, n_services);
+    return self;
+}
+
+static void
+set_property (GObject      *object,
+              guint         prop_id,
+              const GValue *value,
+              GParamSpec   *pspec)
+{
+    QmiManager *self = QMI_MANAGER (object);
+
+    switch (prop_id) {
+    case PROP_MAX_OPENING:
+        self->priv->max_opening = g_value_get_uint (value);
+        manager_open_next (self);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+get_property (GObject    *object,
+              guint       prop_id,
+              GValue     *value,
+              GParamSpec *pspec)
+{
+    QmiManager *self = QMI_MANAGER (object);
+
+    switch (prop_id) {
+    case PROP_MAX_OPENING:
+        g_value_set_uint (value, self->priv->max_opening);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+qmi_manager_init (QmiManager *self)
+{
+    self->priv = G_TYPE_INSTANCE_GET_PRIVATE ((self),
+                                              QMI_TYPE_MANAGER,
+                                              QmiManagerPrivate);
+
+    self->priv->context = g_main_context_ref_thread_default ();
+    self->priv->cancellable = g_cancellable_new ();
+    self->priv->services = g_array_new (FALSE, FALSE, sizeof (QmiService));
+    self->priv->max_opening = MAX_OPENING_DEFAULT;
+    self->priv->entries = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) entry_unref);
+    self->priv->queue = g_queue_new ();
+}
+
+static void
+dispose (GObject *object)
+{
+    QmiManager     *self = QMI_MANAGER (object);
+    GHashTableIter  iter;
+    Entry          *entry;
+
+    g_cancellable_cancel (self->priv->cancellable);
+
+    if (self->priv->rescan_source) {
+        g_source_destroy (self->priv->rescan_source);
+        g_source_unref (self->priv->rescan_source);
+        self->priv->rescan_source = NULL;
+    }
+
+    if (self->priv->monitor) {
+        g_signal_handlers_disconnect_by_data (self->priv->monitor, self);
+        g_file_monitor_cancel (self->priv->monitor);
+        g_clear_object (&self->priv->monitor);
+    }
+
+    /* The ports are still there, so clients are properly released */
+    g_hash_table_iter_init (&iter, self->priv->entries);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry)) {
+        entry_detach (entry, TRUE);
+        g_hash_table_iter_remove (&iter);
+    }
+
+    G_OBJECT_CLASS (qmi_manager_parent_class)->dispose (object);
+}
+
+static void
+finalize (GObject *object)
+{
+    QmiManager *self = QMI_MANAGER (object);
+
+    g_assert (g_queue_is_empty (self->priv->queue));
+    g_queue_free (self->priv->queue);
+    g_hash_table_unref (self->priv->entries);
+    g_array_unref (self->priv->services);
+    g_object_unref (self->priv->cancellable);
+    g_main_context_unref (self->priv->context);
+
+    G_OBJECT_CLASS (qmi_manager_parent_class)->finalize (object);
+}
+
+static void
+qmi_manager_class_init (QmiManagerClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    g_type_class_add_private (object_class, sizeof (QmiManagerPrivate));
+
+    object_class->get_property = get_property;
+    object_class->set_property = set_property;
+    object_class->dispose = dispose;
+    object_class->finalize = finalize;
+
+    /**
+     * QmiManager:manager-max-opening:
+     *
+     * Maximum number of devices being opened at the same time.
+     *
+     * Since: 1.20
+     */
+    properties[PROP_MAX_OPENING] =
+        g_param_spec_uint (QMI_MANAGER_MAX_OPENING,
+                           "Max opening",
+                           "Maximum number of devices being opened at the same time",
+                           1,
+                           G_MAXUINT,
+                           MAX_OPENING_DEFAULT,
+                           G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_MAX_OPENING, properties[PROP_MAX_OPENING]);
+
+    /**
+     * QmiManager::device-added:
+     * @object: A #QmiManager.
+     * @device: the #QmiDevice, open.
+     * @clients: (element-type QmiClient): the #QmiClient objects allocated in @device, as given by qmi_manager_peek_clients().
+     *
+     * The ::device-added signal is emitted when a new device is open and has
+     * its clients allocated.
+     *
+     * Since: 1.20
+     */
+    signals[SIGNAL_DEVICE_ADDED] =
+        g_signal_new (QMI_MANAGER_SIGNAL_DEVICE_ADDED,
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      2,
+                      QMI_TYPE_DEVICE,
+                      G_TYPE_PTR_ARRAY);
+
+    /**
+     * QmiManager::device-removed:
+     * @object: A #QmiManager.
+     * @device: the #QmiDevice.
+     *
+     * The ::device-removed signal is emitted when the control port of a
+     * device given in #QmiManager::device-added is gone. The device is closed
+     * right after the signal.
+     *
+     * Since: 1.20
+     */
+    signals[SIGNAL_DEVICE_REMOVED] =
+        g_signal_new (QMI_MANAGER_SIGNAL_DEVICE_REMOVED,
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      1,
+                      QMI_TYPE_DEVICE);
+}
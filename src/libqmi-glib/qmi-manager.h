@@ -0,0 +1,201 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_MANAGER_H_
+#define _LIBQMI_GLIB_QMI_MANAGER_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "qmi-device.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-manager
+ * @title: QmiManager
+ * @short_description: hot-plug aware management of all the QMI devices
+ *
+ * The #QmiManager keeps a table of open #QmiDevice objects, one for each
+ * physical device with a QMI capable control port, and the #QmiClient objects
+ * requested for each of them.
+ *
+ * The control ports are listed with qmi_device_enumerate_ports() when the
+ * manager is started, and again whenever a cdc-wdm port appears or goes away
+ * in /dev. Each new device is opened and gets its clients allocated as soon
+ * as it is found, in parallel with the other ones, up to the configured number
+ * of devices being opened at the same time. The
+ * #QmiManager::device-added signal is emitted once the device is ready, and
+ * the #QmiManager::device-removed signal once its control port is gone.
+ *
+ * Physical devices are identified by the sysfs path of their USB device, so
+ * if a device exposes several control ports only the first one is used.
+ */
+
+#define QMI_TYPE_MANAGER            (qmi_manager_get_type ())
+#define QMI_MANAGER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), QMI_TYPE_MANAGER, QmiManager))
+#define QMI_MANAGER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  QMI_TYPE_MANAGER, QmiManagerClass))
+#define QMI_IS_MANAGER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), QMI_TYPE_MANAGER))
+#define QMI_IS_MANAGER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  QMI_TYPE_MANAGER))
+#define QMI_MANAGER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  QMI_TYPE_MANAGER, QmiManagerClass))
+
+typedef struct _QmiManager QmiManager;
+typedef struct _QmiManagerClass QmiManagerClass;
+typedef struct _QmiManagerPrivate QmiManagerPrivate;
+
+/**
+ * QMI_MANAGER_MAX_OPENING:
+ *
+ * Symbol defining the #QmiManager:manager-max-opening property.
+ *
+ * Since: 1.20
+ */
+#define QMI_MANAGER_MAX_OPENING "manager-max-opening"
+
+/**
+ * QMI_MANAGER_SIGNAL_DEVICE_ADDED:
+ *
+ * Symbol defining the #QmiManager::device-added signal.
+ *
+ * Since: 1.20
+ */
+#define QMI_MANAGER_SIGNAL_DEVICE_ADDED "device-added"
+
+/**
+ * QMI_MANAGER_SIGNAL_DEVICE_REMOVED:
+ *
+ * Symbol defining the #QmiManager::device-removed signal.
+ *
+ * Since: 1.20
+ */
+#define QMI_MANAGER_SIGNAL_DEVICE_REMOVED "device-removed"
+
+/**
+ * QmiManager:
+ *
+ * The #QmiManager structure contains private data and should only be
+ * accessed using the provided API.
+ *
+ * Since: 1.20
+ */
+struct _QmiManager {
+    /*< private >*/
+    GObject parent;
+    QmiManagerPrivate *priv;
+};
+
+struct _QmiManagerClass {
+    /*< private >*/
+    GObjectClass parent;
+};
+
+GType qmi_manager_get_type (void);
+
+/**
+ * qmi_manager_new:
+ * @open_flags: mask of #QmiDeviceOpenFlags to open each device with.
+ * @services: (array length=n_services): array of #QmiService values to allocate a #QmiClient for in each device.
+ * @n_services: number of elements in @services.
+ *
+ * Creates a #QmiManager, which works in the
+ * <link linkend="g-main-context-push-thread-default">thread-default main context</link>
+ * where it is created. No device is looked for until qmi_manager_start() is
+ * called.
+ *
+ * Returns: (transfer full): a newly created #QmiManager. The returned value should be freed with g_object_unref().
+ *
+ * Since: 1.20
+ */
+QmiManager *qmi_manager_new (QmiDeviceOpenFlags  open_flags,
+                             const QmiService   *services,
+                             guint               n_services);
+
+/**
+ * qmi_manager_start:
+ * @self: a #QmiManager.
+ * @error: Return location for error or %NULL.
+ *
+ * Starts watching the control ports in the system, and looks for the ones
+ * already available.
+ *
+ * Returns: %TRUE if the manager is started, %FALSE if @error is set.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_manager_start (QmiManager  *self,
+                            GError     **error);
+
+/**
+ * qmi_manager_get_devices:
+ * @self: a #QmiManager.
+ *
+ * Gets all the devices currently ready, i.e. open and with the clients
+ * allocated.
+ *
+ * Returns: (transfer full) (element-type QmiDevice): a #GPtrArray of #QmiDevice elements, possibly empty. The returned value should be freed with g_ptr_array_unref().
+ *
+ * Since: 1.20
+ */
+GPtrArray *qmi_manager_get_devices (QmiManager *self);
+
+/**
+ * qmi_manager_peek_device:
+ * @self: a #QmiManager.
+ * @physdev_path: the sysfs path of a USB device, as given in #QmiDevicePortInfo, or the path of the control port if not available.
+ *
+ * Gets the device ready for the given physical device, without increasing
+ * the reference count on the returned object.
+ *
+ * Returns: (transfer none): a #QmiDevice, or %NULL if not available. Do not free the returned object, it is owned by @self.
+ *
+ * Since: 1.20
+ */
+QmiDevice *qmi_manager_peek_device (QmiManager  *self,
+                                    const gchar *physdev_path);
+
+/**
+ * qmi_manager_peek_clients:
+ * @self: a #QmiManager.
+ * @device: a #QmiDevice given by @self.
+ *
+ * Gets the clients allocated in @device, without increasing the reference
+ * count on the returned array.
+ *
+ * The array has one element for each of the services given to
+ * qmi_manager_new(), in the same order. Elements for clients that couldn't be
+ * allocated are %NULL.
+ *
+ * Returns: (transfer none) (element-type QmiClient): a #GPtrArray of #QmiClient elements, or %NULL if @device is not known. Do not free the returned array, it is owned by @self.
+ *
+ * Since: 1.20
+ */
+GPtrArray *qmi_manager_peek_clients (QmiManager *self,
+                                     QmiDevice  *device);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_MANAGER_H_ */
@@ -33,6 +33,12 @@ struct _QmiMessageContext {
 
     /* Vendor ID */
     guint16 vendor_id;
+
+    /* Priority */
+    QmiMessagePriority priority;
+
+    /* No reply */
+    gboolean no_reply;
 };
 
 QmiMessageContext *
@@ -42,6 +48,7 @@ qmi_message_context_new (void)
 
     self = g_slice_new0 (QmiMessageContext);
     self->ref_count = 1;
+    self->priority = QMI_MESSAGE_PRIORITY_NORMAL;
     return self;
 }
 
@@ -99,3 +106,41 @@ qmi_message_context_get_vendor_id (QmiMessageContext *self)
     g_return_val_if_fail (self != NULL, QMI_MESSAGE_VENDOR_GENERIC);
     return self->vendor_id;
 }
+
+/*****************************************************************************/
+/* Priority */
+
+void
+qmi_message_context_set_priority (QmiMessageContext  *self,
+                                  QmiMessagePriority  priority)
+{
+    g_return_if_fail (self != NULL);
+
+    self->priority = priority;
+}
+
+QmiMessagePriority
+qmi_message_context_get_priority (QmiMessageContext *self)
+{
+    g_return_val_if_fail (self != NULL, QMI_MESSAGE_PRIORITY_NORMAL);
+    return self->priority;
+}
+
+/*****************************************************************************/
+/* No reply */
+
+void
+qmi_message_context_set_no_reply (QmiMessageContext *self,
+                                  gboolean           no_reply)
+{
+    g_return_if_fail (self != NULL);
+
+    self->no_reply = no_reply;
+}
+
+gboolean
+qmi_message_context_get_no_reply (QmiMessageContext *self)
+{
+    g_return_val_if_fail (self != NULL, FALSE);
+    return self->no_reply;
+}
@@ -129,6 +129,99 @@ void qmi_message_context_set_vendor_id (QmiMessageContext *self,
  */
 guint16 qmi_message_context_get_vendor_id (QmiMessageContext *self);
 
+/*****************************************************************************/
+/* Priority */
+
+/**
+ * QmiMessagePriority:
+ * @QMI_MESSAGE_PRIORITY_LOW: Bulk or periodic requests, sent after any other pending one.
+ * @QMI_MESSAGE_PRIORITY_NORMAL: Default priority.
+ * @QMI_MESSAGE_PRIORITY_HIGH: Control requests, sent before any other pending one.
+ *
+ * Priority of a request waiting to be sent to the device.
+ *
+ * Requests are always sent in the same order as they were issued, unless
+ * they need to wait (e.g. because the device is not writable, or because the
+ * limit of in-flight requests was reached); in that case, requests with a
+ * higher priority are sent first.
+ *
+ * CTL requests issued without an explicit priority are considered
+ * %QMI_MESSAGE_PRIORITY_HIGH.
+ *
+ * Since: 1.20
+ */
+typedef enum {
+    QMI_MESSAGE_PRIORITY_LOW    = 0,
+    QMI_MESSAGE_PRIORITY_NORMAL = 1,
+    QMI_MESSAGE_PRIORITY_HIGH   = 2,
+} QmiMessagePriority;
+
+/**
+ * qmi_message_priority_get_string:
+ *
+ * Since: 1.20
+ */
+
+/**
+ * qmi_message_context_set_priority:
+ * @self: a #QmiMessageContext.
+ * @priority: a #QmiMessagePriority.
+ *
+ * Sets the priority of the message when waiting to be sent.
+ *
+ * Since: 1.20
+ */
+void qmi_message_context_set_priority (QmiMessageContext  *self,
+                                       QmiMessagePriority  priority);
+
+/**
+ * qmi_message_context_get_priority:
+ * @self: a #QmiMessageContext.
+ *
+ * Gets the priority of the message when waiting to be sent.
+ *
+ * Returns: a #QmiMessagePriority.
+ *
+ * Since: 1.20
+ */
+QmiMessagePriority qmi_message_context_get_priority (QmiMessageContext *self);
+
+/*****************************************************************************/
+/* No reply */
+
+/**
+ * qmi_message_context_set_no_reply:
+ * @self: a #QmiMessageContext.
+ * @no_reply: %TRUE if the result of the request is not needed.
+ *
+ * Sets whether the request is sent without reporting its result to the
+ * caller.
+ *
+ * The response is still matched with the request, and discarded without
+ * being parsed; errors, including timeouts, are only accounted in the
+ * statistics of the #QmiDevice. No callback is ever called, so
+ * qmi_device_command_full() may be given a %NULL callback.
+ *
+ * This is not supported in synchronous requests, where it is ignored.
+ *
+ * Since: 1.20
+ */
+void qmi_message_context_set_no_reply (QmiMessageContext *self,
+                                       gboolean           no_reply);
+
+/**
+ * qmi_message_context_get_no_reply:
+ * @self: a #QmiMessageContext.
+ *
+ * Gets whether the request is sent without reporting its result to the
+ * caller.
+ *
+ * Returns: %TRUE if the result of the request is not needed, %FALSE otherwise.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_message_context_get_no_reply (QmiMessageContext *self);
+
 G_END_DECLS
 
 #endif /* _LIBQMI_GLIB_QMI_MESSAGE_CONTEXT_H_ */
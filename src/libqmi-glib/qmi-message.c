@@ -31,6 +31,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 #include <endian.h>
 
 #include "qmi-message.h"
@@ -40,19 +41,44 @@
 #include "qmi-enum-types.h"
 #include "qmi-error-types.h"
 
+#include "qmi-version.h"
 #include "qmi-ctl.h"
+#if QMI_SERVICE_DMS_SUPPORTED
 #include "qmi-dms.h"
+#endif
+#if QMI_SERVICE_WDS_SUPPORTED
 #include "qmi-wds.h"
+#endif
+#if QMI_SERVICE_NAS_SUPPORTED
 #include "qmi-nas.h"
+#endif
+#if QMI_SERVICE_WMS_SUPPORTED
 #include "qmi-wms.h"
+#endif
+#if QMI_SERVICE_PDC_SUPPORTED
 #include "qmi-pdc.h"
+#endif
+#if QMI_SERVICE_PDS_SUPPORTED
 #include "qmi-pds.h"
+#endif
+#if QMI_SERVICE_PBM_SUPPORTED
 #include "qmi-pbm.h"
+#endif
+#if QMI_SERVICE_UIM_SUPPORTED
 #include "qmi-uim.h"
+#endif
+#if QMI_SERVICE_OMA_SUPPORTED
 #include "qmi-oma.h"
+#endif
+#if QMI_SERVICE_WDA_SUPPORTED
 #include "qmi-wda.h"
+#endif
+#if QMI_SERVICE_VOICE_SUPPORTED
 #include "qmi-voice.h"
+#endif
+#if QMI_SERVICE_LOC_SUPPORTED
 #include "qmi-loc.h"
+#endif
 
 #define PACKED __attribute__((packed))
 
@@ -102,6 +128,15 @@ struct full_message {
     } qmi;
 } PACKED;
 
+/* The inline getters in the header rely on these offsets */
+G_STATIC_ASSERT (G_STRUCT_OFFSET (struct full_message, qmux.service) == 4);
+G_STATIC_ASSERT (G_STRUCT_OFFSET (struct full_message, qmux.client) == 5);
+G_STATIC_ASSERT (G_STRUCT_OFFSET (struct full_message, qmi.control.header.flags) == 6);
+G_STATIC_ASSERT (G_STRUCT_OFFSET (struct full_message, qmi.control.header.transaction) == 7);
+G_STATIC_ASSERT (G_STRUCT_OFFSET (struct full_message, qmi.control.header.message) == 8);
+G_STATIC_ASSERT (G_STRUCT_OFFSET (struct full_message, qmi.service.header.transaction) == 7);
+G_STATIC_ASSERT (G_STRUCT_OFFSET (struct full_message, qmi.service.header.message) == 9);
+
 static inline gboolean
 message_is_control (QmiMessage *self)
 {
@@ -145,29 +180,13 @@ qmi_message_is_request (QmiMessage *self)
 gboolean
 qmi_message_is_response (QmiMessage *self)
 {
-    if (message_is_control (self)) {
-        if (((struct full_message *)(self->data))->qmi.control.header.flags & QMI_CTL_FLAG_RESPONSE)
-            return TRUE;
-    } else {
-        if (((struct full_message *)(self->data))->qmi.service.header.flags & QMI_SERVICE_FLAG_RESPONSE)
-            return TRUE;
-    }
-
-    return FALSE;
+    return __qmi_message_is_response (self);
 }
 
 gboolean
 qmi_message_is_indication (QmiMessage *self)
 {
-    if (message_is_control (self)) {
-        if (((struct full_message *)(self->data))->qmi.control.header.flags & QMI_CTL_FLAG_INDICATION)
-            return TRUE;
-    } else {
-        if (((struct full_message *)(self->data))->qmi.service.header.flags & QMI_SERVICE_FLAG_INDICATION)
-            return TRUE;
-    }
-
-    return FALSE;
+    return __qmi_message_is_indication (self);
 }
 
 QmiService
@@ -175,7 +194,7 @@ qmi_message_get_service (QmiMessage *self)
 {
     g_return_val_if_fail (self != NULL, QMI_SERVICE_UNKNOWN);
 
-    return (QmiService)((struct full_message *)(self->data))->qmux.service;
+    return __qmi_message_get_service (self);
 }
 
 guint8
@@ -183,7 +202,7 @@ qmi_message_get_client_id (QmiMessage *self)
 {
     g_return_val_if_fail (self != NULL, 0);
 
-    return ((struct full_message *)(self->data))->qmux.client;
+    return __qmi_message_get_client_id (self);
 }
 
 guint16
@@ -191,11 +210,7 @@ qmi_message_get_transaction_id (QmiMessage *self)
 {
     g_return_val_if_fail (self != NULL, 0);
 
-    if (message_is_control (self))
-        /* note: only 1 byte for transaction in CTL message */
-        return (guint16)((struct full_message *)(self->data))->qmi.control.header.transaction;
-
-    return GUINT16_FROM_LE (((struct full_message *)(self->data))->qmi.service.header.transaction);
+    return __qmi_message_get_transaction_id (self);
 }
 
 void
@@ -215,10 +230,7 @@ qmi_message_get_message_id (QmiMessage *self)
 {
     g_return_val_if_fail (self != NULL, 0);
 
-    if (message_is_control (self))
-        return GUINT16_FROM_LE (((struct full_message *)(self->data))->qmi.control.header.message);
-
-    return GUINT16_FROM_LE (((struct full_message *)(self->data))->qmi.service.header.message);
+    return __qmi_message_get_message_id (self);
 }
 
 gsize
@@ -269,10 +281,19 @@ tlv_next (struct tlv *tlv)
     return (struct tlv *)((guint8 *)tlv + sizeof(struct tlv) + GUINT16_FROM_LE (tlv->length));
 }
 
+/* Messages forwarded without their TLVs validated may still be walked (e.g.
+ * when printed), so the iteration stops at the first TLV not fitting */
+static inline gboolean
+tlv_fits (struct tlv *tlv,
+          guint8     *end)
+{
+    return (tlv->value <= end && tlv->value + GUINT16_FROM_LE (tlv->length) <= end);
+}
+
 static inline struct tlv *
 qmi_tlv_first (QmiMessage *self)
 {
-    if (get_all_tlvs_length (self))
+    if (get_all_tlvs_length (self) && tlv_fits (qmi_tlv (self), qmi_end (self)))
         return qmi_tlv (self);
 
     return NULL;
@@ -282,33 +303,30 @@ static inline struct tlv *
 qmi_tlv_next (QmiMessage *self,
               struct tlv *tlv)
 {
-    struct tlv *end;
+    guint8 *end;
     struct tlv *next;
 
-    end = (struct tlv *) qmi_end (self);
+    end = qmi_end (self);
     next = tlv_next (tlv);
 
-    return (next < end ? next : NULL);
+    return (((guint8 *) next < end && tlv_fits (next, end)) ? next : NULL);
 }
 
 /*
- * Checks the validity of a QMI message.
+ * Checks the validity of the headers of a QMI message.
  *
  * In particular, checks:
  * 1. The message has space for all required headers.
  * 2. The length of the buffer, the qmux length field, and the QMI tlv_length
  *    field are all consistent.
- * 3. The TLVs in the message fit exactly in the payload size.
  *
- * Returns: %TRUE if the message is valid, %FALSE otherwise.
+ * Returns: %TRUE if the headers are valid, %FALSE otherwise.
  */
 static gboolean
-message_check (QmiMessage *self,
-               GError **error)
+message_check_headers (QmiMessage *self,
+                       GError **error)
 {
     gsize header_length;
-    guint8 *end;
-    struct tlv *tlv;
 
     if (((struct full_message *)(self->data))->marker != QMI_MESSAGE_QMUX_MARKER) {
         g_set_error (error,
@@ -362,6 +380,22 @@ message_check (QmiMessage *self,
         return FALSE;
     }
 
+    return TRUE;
+}
+
+/*
+ * Checks that the TLVs in a QMI message with valid headers fit exactly in
+ * the payload size.
+ *
+ * Returns: %TRUE if the TLVs are valid, %FALSE otherwise.
+ */
+static gboolean
+message_check_tlvs (QmiMessage *self,
+                    GError **error)
+{
+    guint8 *end;
+    struct tlv *tlv;
+
     end = qmi_end (self);
     for (tlv = qmi_tlv (self); tlv < (struct tlv *)end; tlv = tlv_next (tlv)) {
         if (tlv->value > end) {
@@ -391,11 +425,51 @@ message_check (QmiMessage *self,
     return TRUE;
 }
 
+/*
+ * Checks the validity of a QMI message, both headers and TLVs.
+ *
+ * Returns: %TRUE if the message is valid, %FALSE otherwise.
+ */
+static gboolean
+message_check (QmiMessage *self,
+               GError **error)
+{
+    return (message_check_headers (self, error) && message_check_tlvs (self, error));
+}
+
+/*
+ * Cheaper than message_check(), only valid when the message was already
+ * consistent before the last TLV was appended: the TLVs themselves are
+ * built by us, so only the length fields need to be checked.
+ */
+static inline gboolean
+message_check_lengths (QmiMessage *self)
+{
+    gsize header_length;
+
+    header_length = sizeof (struct qmux) + (message_is_control (self) ?
+                                            sizeof (struct control_header) :
+                                            sizeof (struct service_header));
+
+    return (get_qmux_length (self) == self->len - 1 &&
+            get_qmux_length (self) == header_length + get_all_tlvs_length (self));
+}
+
 QmiMessage *
 qmi_message_new (QmiService service,
                  guint8 client_id,
                  guint16 transaction_id,
                  guint16 message_id)
+{
+    return __qmi_message_new_sized (service, client_id, transaction_id, message_id, 0);
+}
+
+QmiMessage *
+__qmi_message_new_sized (QmiService service,
+                         guint8     client_id,
+                         guint16    transaction_id,
+                         guint16    message_id,
+                         gsize      tlvs_size)
 {
     GByteArray *self;
     struct full_message *buffer;
@@ -417,8 +491,10 @@ qmi_message_new (QmiService service,
      * https://bugzilla.gnome.org/show_bug.cgi?id=738170
      */
 
-    /* Create the GByteArray with buffer_len bytes preallocated */
-    self = g_byte_array_sized_new (buffer_len);
+    /* Create the GByteArray with buffer_len bytes preallocated, plus room
+     * for all the TLVs that will be added, if known */
+    self = g_byte_array_sized_new (buffer_len + MIN (tlvs_size, G_MAXUINT16 - buffer_len));
+    __qmi_utils_live_object_add (QMI_UTILS_LIVE_OBJECT_MESSAGE, 1);
     /* Actually flag as all the buffer_len bytes being used. */
     g_byte_array_set_size (self, buffer_len);
 
@@ -448,6 +524,37 @@ qmi_message_new (QmiService service,
     return (QmiMessage *)self;
 }
 
+QmiMessage *
+__qmi_message_new_from_template (const guint8 *template,
+                                 gsize         template_len,
+                                 guint8        client_id,
+                                 guint16       transaction_id)
+{
+    GByteArray *self;
+    struct full_message *buffer;
+
+    g_return_val_if_fail (template_len > G_STRUCT_OFFSET (struct full_message, qmi.service.header.message), NULL);
+    /* Transaction ID in the control service is 8bit only */
+    g_return_val_if_fail ((template[G_STRUCT_OFFSET (struct full_message, qmux.service)] != QMI_SERVICE_CTL ||
+                           transaction_id <= G_MAXUINT8),
+                          NULL);
+
+    /* The template is an already valid message, so there's no need to build
+     * the headers or check it, just to copy it and set the IDs */
+    self = g_byte_array_sized_new (template_len);
+    __qmi_utils_live_object_add (QMI_UTILS_LIVE_OBJECT_MESSAGE, 1);
+    g_byte_array_append (self, template, template_len);
+
+    buffer = (struct full_message *)(self->data);
+    buffer->qmux.client = client_id;
+    if (buffer->qmux.service == QMI_SERVICE_CTL)
+        buffer->qmi.control.header.transaction = (guint8)transaction_id;
+    else
+        buffer->qmi.service.header.transaction = GUINT16_TO_LE (transaction_id);
+
+    return (QmiMessage *)self;
+}
+
 QmiMessage *
 qmi_message_response_new (QmiMessage       *request,
                           QmiProtocolError  error)
@@ -483,6 +590,7 @@ qmi_message_ref (QmiMessage *self)
 {
     g_return_val_if_fail (self != NULL, NULL);
 
+    __qmi_utils_live_object_add (QMI_UTILS_LIVE_OBJECT_MESSAGE, 1);
     return (QmiMessage *)g_byte_array_ref (self);
 }
 
@@ -491,6 +599,7 @@ qmi_message_unref (QmiMessage *self)
 {
     g_return_if_fail (self != NULL);
 
+    __qmi_utils_live_object_add (QMI_UTILS_LIVE_OBJECT_MESSAGE, -1);
     g_byte_array_unref (self);
 }
 
@@ -599,7 +708,7 @@ qmi_message_tlv_write_complete (QmiMessage  *self,
     set_all_tlvs_length (self, (guint16)(get_all_tlvs_length (self) + tlv_length));
 
     /* Make sure we didn't break anything. */
-    g_assert (message_check (self, NULL));
+    g_assert (message_check_lengths (self));
 
     return TRUE;
 }
@@ -843,9 +952,54 @@ qmi_message_tlv_write_string (QmiMessage   *self,
     return TRUE;
 }
 
+gboolean
+__qmi_message_tlv_write_fixed_layout (QmiMessage    *self,
+                                      const guint8  *in,
+                                      gsize          len,
+                                      GError       **error)
+{
+    g_return_val_if_fail (self != NULL, FALSE);
+    g_return_val_if_fail (in != NULL || len == 0, FALSE);
+
+    /* Check for overflow of message size */
+    if (!tlv_error_if_write_overflow (self, len, error))
+        return FALSE;
+
+    if (len > 0)
+        g_byte_array_append (self, in, len);
+    return TRUE;
+}
+
 /*****************************************************************************/
 /* TLV reader */
 
+static gsize
+tlv_read_init_at (QmiMessage  *self,
+                  struct tlv  *tlv,
+                  guint16     *out_tlv_length,
+                  GError     **error)
+{
+    guint16 tlv_length;
+
+    tlv_length = GUINT16_FROM_LE (tlv->length);
+    if (!tlv_length) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TLV_EMPTY,
+                     "TLV 0x%02X is empty", tlv->type);
+        return 0;
+    }
+
+    if (((guint8 *) tlv_next (tlv)) > ((guint8 *) qmi_end (self))) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TLV_TOO_LONG,
+                     "Invalid length for TLV 0x%02X: %" G_GUINT16_FORMAT, tlv->type, tlv_length);
+        return 0;
+    }
+
+    if (out_tlv_length)
+        *out_tlv_length = tlv_length;
+
+    return (((guint8 *)tlv) - self->data);
+}
+
 gsize
 qmi_message_tlv_read_init (QmiMessage  *self,
                            guint8       type,
@@ -853,7 +1007,6 @@ qmi_message_tlv_read_init (QmiMessage  *self,
                            GError     **error)
 {
     struct tlv *tlv;
-    guint16     tlv_length;
 
     g_return_val_if_fail (self != NULL, 0);
     g_return_val_if_fail (self->len > 0, 0);
@@ -869,23 +1022,60 @@ qmi_message_tlv_read_init (QmiMessage  *self,
         return 0;
     }
 
-    tlv_length = GUINT16_FROM_LE (tlv->length);
-    if (!tlv_length) {
-        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TLV_EMPTY,
-                     "TLV 0x%02X is empty", type);
+    return tlv_read_init_at (self, tlv, out_tlv_length, error);
+}
+
+gsize
+__qmi_message_tlv_read_init_at (QmiMessage  *self,
+                                guint8       type,
+                                gsize        tlv_offset,
+                                guint16     *out_tlv_length,
+                                GError     **error)
+{
+    struct tlv *tlv;
+
+    /* The offset must have been found in this very message */
+    if (!tlv_offset ||
+        tlv_offset + sizeof (struct tlv) > self->len ||
+        (tlv = (struct tlv *) &(self->data[tlv_offset]))->type != type) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_MESSAGE,
+                     "TLV 0x%02X not found at offset %" G_GSIZE_FORMAT, type, tlv_offset);
         return 0;
     }
 
-    if (((guint8 *) tlv_next (tlv)) > ((guint8 *) qmi_end (self))) {
-        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TLV_TOO_LONG,
-                     "Invalid length for TLV 0x%02X: %" G_GUINT16_FORMAT, type, tlv_length);
-        return 0;
+    return tlv_read_init_at (self, tlv, out_tlv_length, error);
+}
+
+void
+__qmi_message_tlv_index_build (QmiMessage         *self,
+                               QmiMessageTlvIndex *index)
+{
+    struct tlv *tlv;
+
+    memset (index, 0, sizeof (QmiMessageTlvIndex));
+
+    /* Only the first TLV of each type is indexed, same as in
+     * qmi_message_tlv_read_init() */
+    for (tlv = qmi_tlv_first (self); tlv; tlv = qmi_tlv_next (self, tlv)) {
+        if (!index->offset[tlv->type])
+            index->offset[tlv->type] = (guint16)(((guint8 *)tlv) - self->data);
     }
+}
 
-    if (out_tlv_length)
-        *out_tlv_length = tlv_length;
+gsize
+__qmi_message_tlv_index_read_init (QmiMessage               *self,
+                                   const QmiMessageTlvIndex *index,
+                                   guint8                    type,
+                                   guint16                  *out_tlv_length,
+                                   GError                  **error)
+{
+    if (!index->offset[type]) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TLV_NOT_FOUND,
+                     "TLV 0x%02X not found", type);
+        return 0;
+    }
 
-    return (((guint8 *)tlv) - self->data);
+    return __qmi_message_tlv_read_init_at (self, type, index->offset[type], out_tlv_length, error);
 }
 
 static const guint8 *
@@ -1174,13 +1364,14 @@ qmi_message_tlv_read_gfloat (QmiMessage  *self,
 }
 
 gboolean
-qmi_message_tlv_read_string (QmiMessage  *self,
-                             gsize        tlv_offset,
-                             gsize       *offset,
-                             guint8       n_size_prefix_bytes,
-                             guint16      max_size,
-                             gchar      **out,
-                             GError     **error)
+__qmi_message_tlv_read_string_view (QmiMessage    *self,
+                                    gsize          tlv_offset,
+                                    gsize         *offset,
+                                    guint8         n_size_prefix_bytes,
+                                    guint16        max_size,
+                                    const gchar  **out,
+                                    guint16       *out_length,
+                                    GError       **error)
 {
     const guint8 *ptr;
     guint16 string_length;
@@ -1189,6 +1380,7 @@ qmi_message_tlv_read_string (QmiMessage  *self,
     g_return_val_if_fail (self != NULL, FALSE);
     g_return_val_if_fail (offset != NULL, FALSE);
     g_return_val_if_fail (out != NULL, FALSE);
+    g_return_val_if_fail (out_length != NULL, FALSE);
     g_return_val_if_fail (n_size_prefix_bytes <= 2, FALSE);
 
     switch (n_size_prefix_bytes) {
@@ -1220,7 +1412,8 @@ qmi_message_tlv_read_string (QmiMessage  *self,
     }
 
     if (string_length == 0) {
-        *out = g_strdup ("");
+        *out = "";
+        *out_length = 0;
         return TRUE;
     }
 
@@ -1232,14 +1425,39 @@ qmi_message_tlv_read_string (QmiMessage  *self,
     if (!(ptr = tlv_error_if_read_overflow (self, tlv_offset, *offset, valid_string_length, error)))
         return FALSE;
 
-    *out = g_malloc (valid_string_length + 1);
-    memcpy (*out, ptr, valid_string_length);
-    (*out)[valid_string_length] = '\0';
+    *out = (const gchar *) ptr;
+    *out_length = valid_string_length;
 
     *offset = (*offset + string_length);
     return TRUE;
 }
 
+gboolean
+qmi_message_tlv_read_string (QmiMessage  *self,
+                             gsize        tlv_offset,
+                             gsize       *offset,
+                             guint8       n_size_prefix_bytes,
+                             guint16      max_size,
+                             gchar      **out,
+                             GError     **error)
+{
+    const gchar *str;
+    guint16 str_length;
+
+    g_return_val_if_fail (self != NULL, FALSE);
+    g_return_val_if_fail (offset != NULL, FALSE);
+    g_return_val_if_fail (out != NULL, FALSE);
+    g_return_val_if_fail (n_size_prefix_bytes <= 2, FALSE);
+
+    if (!__qmi_message_tlv_read_string_view (self, tlv_offset, offset, n_size_prefix_bytes, max_size, &str, &str_length, error))
+        return FALSE;
+
+    *out = g_malloc (str_length + 1);
+    memcpy (*out, str, str_length);
+    (*out)[str_length] = '\0';
+    return TRUE;
+}
+
 gboolean
 qmi_message_tlv_read_fixed_size_string (QmiMessage  *self,
                                         gsize        tlv_offset,
@@ -1265,6 +1483,25 @@ qmi_message_tlv_read_fixed_size_string (QmiMessage  *self,
     return TRUE;
 }
 
+const guint8 *
+__qmi_message_tlv_read_fixed_layout (QmiMessage  *self,
+                                     gsize        tlv_offset,
+                                     gsize       *offset,
+                                     gsize        len,
+                                     GError     **error)
+{
+    const guint8 *ptr;
+
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (offset != NULL, NULL);
+
+    if (!(ptr = tlv_error_if_read_overflow (self, tlv_offset, *offset, len, error)))
+        return NULL;
+
+    *offset = *offset + len;
+    return ptr;
+}
+
 guint16
 __qmi_message_tlv_read_remaining_size (QmiMessage *self,
                                        gsize       tlv_offset,
@@ -1302,6 +1539,38 @@ qmi_message_get_raw_tlv (QmiMessage *self,
     return NULL;
 }
 
+QmiProtocolError
+qmi_message_get_result_code (QmiMessage *self)
+{
+    const guint8 *raw;
+    guint16       raw_length;
+    guint16       error_status;
+    guint16       error_code;
+
+    g_return_val_if_fail (self != NULL, QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE);
+
+    if (!qmi_message_is_response (self))
+        return QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE;
+
+    /* The result TLV always comes with the same layout, in every service */
+    raw = qmi_message_get_raw_tlv (self, 0x02, &raw_length);
+    if (!raw || raw_length < 4)
+        return QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE;
+
+    memcpy (&error_status, &raw[0], 2);
+    memcpy (&error_code, &raw[2], 2);
+
+    /* QMI_STATUS_SUCCESS */
+    if (GUINT16_FROM_LE (error_status) == 0x0000)
+        return QMI_PROTOCOL_ERROR_NONE;
+
+    /* A failure must never be mistaken for a success */
+    if (GUINT16_FROM_LE (error_code) == QMI_PROTOCOL_ERROR_NONE)
+        return QMI_PROTOCOL_ERROR_INTERNAL;
+
+    return (QmiProtocolError) GUINT16_FROM_LE (error_code);
+}
+
 void
 qmi_message_foreach_raw_tlv (QmiMessage *self,
                              QmiMessageForeachRawTlvFn func,
@@ -1360,40 +1629,46 @@ qmi_message_add_raw_tlv (QmiMessage *self,
     set_all_tlvs_length (self, (guint16)(get_all_tlvs_length (self) + tlv_len));
 
     /* Make sure we didn't break anything. */
-    g_assert (message_check (self, NULL));
+    g_assert (message_check_lengths (self));
 
     return TRUE;
 }
 
-QmiMessage *
-qmi_message_new_from_raw (GByteArray *raw,
-                          GError **error)
+static QmiMessage *
+message_new_from_raw_data (const guint8  *data,
+                           gsize          data_len,
+                           gsize         *consumed,
+                           gboolean       check_tlvs,
+                           GError       **error)
 {
     GByteArray *self;
     gsize message_len;
 
-    g_return_val_if_fail (raw != NULL, NULL);
+    g_assert (consumed != NULL);
+
+    *consumed = 0;
 
     /* If we didn't even read the QMUX header (comes after the 1-byte marker),
      * leave */
-    if (raw->len < (sizeof (struct qmux) + 1))
+    if (data_len < (sizeof (struct qmux) + 1))
         return NULL;
 
     /* We need to have read the length reported by the QMUX header (plus the
      * initial 1-byte marker) */
-    message_len = GUINT16_FROM_LE (((struct full_message *)raw->data)->qmux.length);
-    if (raw->len < (message_len + 1))
+    message_len = GUINT16_FROM_LE (((struct full_message *)data)->qmux.length);
+    if (data_len < (message_len + 1))
         return NULL;
 
-    /* Ok, so we should have all the data available already */
+    /* Ok, so we should have all the data available already; this is the
+     * only copy done of the frame */
     self = g_byte_array_sized_new (message_len + 1);
-    g_byte_array_prepend (self, raw->data, message_len + 1);
-
-    /* We got a complete QMI message, remove from input buffer */
-    g_byte_array_remove_range (raw, 0, self->len);
+    g_byte_array_append (self, data, message_len + 1);
+    __qmi_utils_live_object_add (QMI_UTILS_LIVE_OBJECT_MESSAGE, 1);
+    *consumed = self->len;
 
     /* Check input message validity as soon as we create the QmiMessage */
-    if (!message_check (self, error)) {
+    if (!message_check_headers (self, error) ||
+        (check_tlvs && !message_check_tlvs (self, error))) {
         /* Yes, we lose the whole message here */
         qmi_message_unref (self);
         return NULL;
@@ -1402,81 +1677,600 @@ qmi_message_new_from_raw (GByteArray *raw,
     return (QmiMessage *)self;
 }
 
-gchar *
-qmi_message_get_tlv_printable (QmiMessage *self,
-                               const gchar *line_prefix,
-                               guint8 type,
-                               const guint8 *raw,
-                               gsize raw_length)
+QmiMessage *
+__qmi_message_new_from_raw_data (const guint8  *data,
+                                 gsize          data_len,
+                                 gsize         *consumed,
+                                 GError       **error)
 {
-    gchar *printable;
-    gchar *value_hex;
+    return message_new_from_raw_data (data, data_len, consumed, TRUE, error);
+}
 
-    g_return_val_if_fail (self != NULL, NULL);
-    g_return_val_if_fail (line_prefix != NULL, NULL);
-    g_return_val_if_fail (raw != NULL, NULL);
-    g_return_val_if_fail (raw_length > 0, NULL);
+QmiMessage *
+__qmi_message_new_from_raw_data_opaque (const guint8  *data,
+                                        gsize          data_len,
+                                        gsize         *consumed,
+                                        GError       **error)
+{
+    return message_new_from_raw_data (data, data_len, consumed, FALSE, error);
+}
 
-    value_hex = __qmi_utils_str_hex (raw, raw_length, ':');
-    printable = g_strdup_printf ("%sTLV:\n"
-                                 "%s  type   = 0x%02x\n"
-                                 "%s  length = %" G_GSIZE_FORMAT "\n"
-                                 "%s  value  = %s\n",
-                                 line_prefix,
-                                 line_prefix, type,
-                                 line_prefix, raw_length,
-                                 line_prefix, value_hex);
-    g_free (value_hex);
-    return printable;
+gboolean
+__qmi_message_check_tlvs (QmiMessage  *self,
+                          GError     **error)
+{
+    return message_check_tlvs (self, error);
 }
 
-static gchar *
-get_generic_printable (QmiMessage *self,
-                       const gchar *line_prefix)
+QmiMessage *
+__qmi_message_copy_for_transaction (QmiMessage *self,
+                                    guint8      client_id,
+                                    guint16     transaction_id)
 {
-    GString *printable;
-    struct tlv *tlv;
+    GByteArray *copy;
 
-    printable = g_string_new ("");
+    /* Shared messages are never modified, so no need to copy if the header
+     * already has the requested values */
+    if (__qmi_message_get_client_id (self) == client_id &&
+        __qmi_message_get_transaction_id (self) == transaction_id)
+        return qmi_message_ref (self);
 
-    g_string_append_printf (printable,
-                            "%s  message     = (0x%04x)\n",
-                            line_prefix, qmi_message_get_message_id (self));
+    copy = g_byte_array_sized_new (self->len);
+    g_byte_array_append (copy, self->data, self->len);
+    __qmi_utils_live_object_add (QMI_UTILS_LIVE_OBJECT_MESSAGE, 1);
+    ((struct full_message *)(copy->data))->qmux.client = client_id;
+    qmi_message_set_transaction_id ((QmiMessage *)copy, transaction_id);
+    return (QmiMessage *)copy;
+}
 
-    for (tlv = qmi_tlv_first (self); tlv; tlv = qmi_tlv_next (self, tlv)) {
-        gchar *printable_tlv;
+const guint8 *
+__qmi_message_peek_all_tlvs (QmiMessage *self,
+                             gsize      *length)
+{
+    *length = get_all_tlvs_length (self);
+    return (const guint8 *) qmi_tlv (self);
+}
 
-        printable_tlv = qmi_message_get_tlv_printable (self,
-                                                       line_prefix,
-                                                       tlv->type,
-                                                       tlv->value,
-                                                       GUINT16_FROM_LE (tlv->length));
-        g_string_append (printable, printable_tlv);
-        g_free (printable_tlv);
-    }
+QmiMessage *
+qmi_message_new_from_raw (GByteArray *raw,
+                          GError **error)
+{
+    QmiMessage *self;
+    GError *inner_error = NULL;
+    gsize consumed = 0;
 
-    return g_string_free (printable, FALSE);
+    g_return_val_if_fail (raw != NULL, NULL);
+
+    self = __qmi_message_new_from_raw_data (raw->data, raw->len, &consumed, &inner_error);
+
+    /* We got a complete QMI message (valid or not), remove from input buffer */
+    if (consumed > 0)
+        g_byte_array_remove_range (raw, 0, consumed);
+
+    if (inner_error)
+        g_propagate_error (error, inner_error);
+
+    return self;
 }
 
-gchar *
-qmi_message_get_printable_full (QmiMessage        *self,
-                                QmiMessageContext *context,
-                                const gchar       *line_prefix)
+/*****************************************************************************/
+/* Frame iterator */
+
+void
+qmi_message_frame_iter_init (QmiMessageFrameIter *iter,
+                             const guint8        *data,
+                             gsize                length)
 {
-    GString *printable;
-    gchar *qmi_flags_str;
-    gchar *contents;
+    g_return_if_fail (iter != NULL);
+    g_return_if_fail (data != NULL || length == 0);
 
-    g_return_val_if_fail (self != NULL, NULL);
-    g_return_val_if_fail (line_prefix != NULL, NULL);
+    iter->data = data;
+    iter->length = length;
+    iter->offset = 0;
+}
 
-    if (!line_prefix)
-        line_prefix = "";
+gboolean
+qmi_message_frame_iter_next (QmiMessageFrameIter  *iter,
+                             QmiMessageFrame      *frame,
+                             GError              **error)
+{
+    g_return_val_if_fail (iter != NULL, FALSE);
+    g_return_val_if_fail (frame != NULL, FALSE);
+
+    while (iter->length - iter->offset >= sizeof (struct qmux) + 1) {
+        const guint8 *data;
+        gsize         message_len;
+        GByteArray    view;
+        GError       *inner_error = NULL;
+
+        data = iter->data + iter->offset;
+        message_len = GUINT16_FROM_LE (((struct full_message *)data)->qmux.length) + 1;
+        if (iter->length - iter->offset < message_len)
+            break;
 
-    printable = g_string_new ("");
-    g_string_append_printf (printable,
-                            "%sQMUX:\n"
-                            "%s  length  = %u\n"
+        /* Complete message, valid or not, not processed again */
+        iter->offset += message_len;
+
+        /* The checks only read the data, so they can be run on a view of
+         * the buffer instead of on a copy */
+        view.data = (guint8 *) data;
+        view.len = message_len;
+        if (!message_check (&view, error ? &inner_error : NULL)) {
+            if (inner_error) {
+                g_propagate_error (error, inner_error);
+                return FALSE;
+            }
+            continue;
+        }
+
+        frame->data = data;
+        frame->offset = iter->offset - message_len;
+        frame->length = message_len;
+        frame->service = __qmi_message_get_service (&view);
+        frame->client_id = __qmi_message_get_client_id (&view);
+        frame->transaction_id = __qmi_message_get_transaction_id (&view);
+        frame->message_id = __qmi_message_get_message_id (&view);
+        frame->response = __qmi_message_is_response (&view);
+        frame->indication = __qmi_message_is_indication (&view);
+        frame->tlvs = (const guint8 *) qmi_tlv (&view);
+        frame->tlvs_length = get_all_tlvs_length (&view);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+gsize
+qmi_message_frame_iter_get_offset (QmiMessageFrameIter *iter)
+{
+    g_return_val_if_fail (iter != NULL, 0);
+
+    return iter->offset;
+}
+
+QmiMessage *
+qmi_message_new_from_frame (const QmiMessageFrame *frame)
+{
+    GByteArray *self;
+
+    g_return_val_if_fail (frame != NULL, NULL);
+
+    self = g_byte_array_sized_new (frame->length);
+    g_byte_array_append (self, frame->data, frame->length);
+    __qmi_utils_live_object_add (QMI_UTILS_LIVE_OBJECT_MESSAGE, 1);
+    return (QmiMessage *)self;
+}
+
+static void
+append_tlv_printable_generic (const gchar  *line_prefix,
+                              guint8        type,
+                              const guint8 *raw,
+                              gsize         raw_length,
+                              GString      *printable)
+{
+    g_string_append_printf (printable,
+                            "%sTLV:\n"
+                            "%s  type   = 0x%02x\n"
+                            "%s  length = %" G_GSIZE_FORMAT "\n"
+                            "%s  value  = ",
+                            line_prefix,
+                            line_prefix, type,
+                            line_prefix, raw_length,
+                            line_prefix);
+    __qmi_utils_str_hex_append (printable, raw, raw_length, ':');
+    g_string_append_c (printable, '\n');
+}
+
+/* Appends everything but the translated value itself */
+void
+__qmi_message_append_tlv_printable_header (const gchar  *line_prefix,
+                                           guint8        type,
+                                           const gchar  *tlv_type_str,
+                                           const guint8 *raw,
+                                           gsize         raw_length,
+                                           GString      *printable)
+{
+    g_string_append_printf (printable,
+                            "%sTLV:\n"
+                            "%s  type       = \"%s\" (0x%02x)\n"
+                            "%s  length     = %" G_GSIZE_FORMAT "\n"
+                            "%s  value      = ",
+                            line_prefix,
+                            line_prefix, tlv_type_str, type,
+                            line_prefix, raw_length,
+                            line_prefix);
+    __qmi_utils_str_hex_append (printable, raw, raw_length, ':');
+    g_string_append_printf (printable,
+                            "\n"
+                            "%s  translated = ",
+                            line_prefix);
+}
+
+void
+__qmi_message_append_tlv_printable (QmiMessage               *self,
+                                    const gchar              *line_prefix,
+                                    guint8                    type,
+                                    const gchar              *tlv_type_str,
+                                    const guint8             *raw,
+                                    gsize                     raw_length,
+                                    QmiMessageTlvPrintableFn  tlv_printable,
+                                    GString                  *printable)
+{
+    if (!tlv_type_str) {
+        append_tlv_printable_generic (line_prefix, type, raw, raw_length, printable);
+        return;
+    }
+
+    __qmi_message_append_tlv_printable_header (line_prefix, type, tlv_type_str, raw, raw_length, printable);
+    tlv_printable (self, printable);
+    g_string_append_c (printable, '\n');
+}
+
+gchar *
+qmi_message_get_tlv_printable (QmiMessage *self,
+                               const gchar *line_prefix,
+                               guint8 type,
+                               const guint8 *raw,
+                               gsize raw_length)
+{
+    GString *printable;
+
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (line_prefix != NULL, NULL);
+    g_return_val_if_fail (raw != NULL, NULL);
+    g_return_val_if_fail (raw_length > 0, NULL);
+
+    printable = g_string_sized_new (64 + 3 * raw_length);
+    append_tlv_printable_generic (line_prefix, type, raw, raw_length, printable);
+    return g_string_free (printable, FALSE);
+}
+
+/*****************************************************************************/
+/* Printable representations built from TLV descriptors */
+
+typedef const gchar *(* EnumGetStringFn)       (gint    val);
+typedef gchar       *(* FlagsBuildStringFn)    (guint   mask);
+typedef gchar       *(* Flags64BuildStringFn)  (guint64 mask);
+
+/* Same results as the generated enum and flags string builders */
+static const gchar *
+tlv_field_values_find (const QmiTlvFieldValues *values,
+                       gint64                   value)
+{
+    guint i;
+
+    for (i = 0; i < values->n_values; i++) {
+        if (values->values[i].value == value)
+            return values->values[i].nick;
+    }
+    return NULL;
+}
+
+static const gchar *
+tlv_field_enum_get_string (const QmiTlvField *field,
+                           gint64             value)
+{
+    if (field->to_string)
+        return ((EnumGetStringFn) field->to_string) ((gint) value);
+    return tlv_field_values_find (field->values, value);
+}
+
+static gchar *
+tlv_field_flags_build_string (const QmiTlvField *field,
+                              guint64            mask)
+{
+    const gchar *nick;
+    GString     *str = NULL;
+    guint        i;
+
+    if (field->to_string) {
+        if (field->type == QMI_TLV_FIELD_TYPE_FLAGS)
+            return ((FlagsBuildStringFn) field->to_string) ((guint) mask);
+        return ((Flags64BuildStringFn) field->to_string) (mask);
+    }
+
+    if (field->type == QMI_TLV_FIELD_TYPE_FLAGS)
+        mask = (guint32) mask;
+
+    /* Exact matches first, then the single-bit values */
+    if ((nick = tlv_field_values_find (field->values, (gint64) mask)) != NULL)
+        return g_strdup (nick);
+
+    for (i = 0; i < field->values->n_values; i++) {
+        guint64 value;
+
+        value = (guint64) field->values->values[i].value;
+        if (!value || (value & (value - 1)) || !(mask & value))
+            continue;
+        if (!str)
+            str = g_string_new (field->values->values[i].nick);
+        else
+            g_string_append_printf (str, ", %s", field->values->values[i].nick);
+    }
+
+    return (str ? g_string_free (str, FALSE) : NULL);
+}
+
+static gboolean
+tlv_field_read_integer (QmiMessage         *self,
+                        gsize               tlv_offset,
+                        gsize              *offset,
+                        const QmiTlvField  *field,
+                        guint64            *out_unsigned,
+                        gint64             *out_signed,
+                        GError            **error)
+{
+    if (!(field->flags & QMI_TLV_FIELD_FLAG_SIGNED)) {
+        if (!qmi_message_tlv_read_sized_guint (self, tlv_offset, offset, field->size, (QmiEndian) field->endian, out_unsigned, error))
+            return FALSE;
+        *out_signed = (gint64) *out_unsigned;
+        return TRUE;
+    }
+
+    switch (field->size) {
+    case 1: {
+        gint8 tmp;
+
+        if (!qmi_message_tlv_read_gint8 (self, tlv_offset, offset, &tmp, error))
+            return FALSE;
+        *out_signed = tmp;
+        break;
+    }
+    case 2: {
+        gint16 tmp;
+
+        if (!qmi_message_tlv_read_gint16 (self, tlv_offset, offset, (QmiEndian) field->endian, &tmp, error))
+            return FALSE;
+        *out_signed = tmp;
+        break;
+    }
+    case 4: {
+        gint32 tmp;
+
+        if (!qmi_message_tlv_read_gint32 (self, tlv_offset, offset, (QmiEndian) field->endian, &tmp, error))
+            return FALSE;
+        *out_signed = tmp;
+        break;
+    }
+    case 8:
+        if (!qmi_message_tlv_read_gint64 (self, tlv_offset, offset, (QmiEndian) field->endian, out_signed, error))
+            return FALSE;
+        break;
+    default:
+        g_assert_not_reached ();
+    }
+
+    *out_unsigned = (guint64) *out_signed;
+    return TRUE;
+}
+
+static gboolean
+tlv_field_append_printable (QmiMessage         *self,
+                            gsize               tlv_offset,
+                            gsize              *offset,
+                            const QmiTlvField  *field,
+                            GString            *printable,
+                            GError            **error)
+{
+    guint64 value_unsigned;
+    gint64  value_signed;
+
+    switch ((QmiTlvFieldType) field->type) {
+    case QMI_TLV_FIELD_TYPE_UINT:
+        if (!tlv_field_read_integer (self, tlv_offset, offset, field, &value_unsigned, &value_signed, error))
+            return FALSE;
+        g_string_append_printf (printable, "%" G_GUINT64_FORMAT, value_unsigned);
+        return TRUE;
+
+    case QMI_TLV_FIELD_TYPE_INT:
+        if (!tlv_field_read_integer (self, tlv_offset, offset, field, &value_unsigned, &value_signed, error))
+            return FALSE;
+        g_string_append_printf (printable, "%" G_GINT64_FORMAT, value_signed);
+        return TRUE;
+
+    case QMI_TLV_FIELD_TYPE_FLOAT: {
+        gfloat tmp;
+
+        if (!qmi_message_tlv_read_gfloat (self, tlv_offset, offset, &tmp, error))
+            return FALSE;
+        g_string_append_printf (printable, "%f", tmp);
+        return TRUE;
+    }
+
+    case QMI_TLV_FIELD_TYPE_BOOLEAN:
+        if (!tlv_field_read_integer (self, tlv_offset, offset, field, &value_unsigned, &value_signed, error))
+            return FALSE;
+        g_string_append_printf (printable, "%s", value_unsigned ? "yes" : "no");
+        return TRUE;
+
+    case QMI_TLV_FIELD_TYPE_ENUM:
+        if (!tlv_field_read_integer (self, tlv_offset, offset, field, &value_unsigned, &value_signed, error))
+            return FALSE;
+        g_string_append_printf (printable, "%s", tlv_field_enum_get_string (field, value_signed));
+        return TRUE;
+
+    case QMI_TLV_FIELD_TYPE_FLAGS:
+    case QMI_TLV_FIELD_TYPE_FLAGS64: {
+        gchar *flags_str;
+
+        if (!tlv_field_read_integer (self, tlv_offset, offset, field, &value_unsigned, &value_signed, error))
+            return FALSE;
+        flags_str = tlv_field_flags_build_string (field, value_unsigned);
+        g_string_append_printf (printable, "%s", flags_str);
+        g_free (flags_str);
+        return TRUE;
+    }
+
+    case QMI_TLV_FIELD_TYPE_STRING: {
+        const gchar *str;
+        guint16      str_length;
+
+        if (!__qmi_message_tlv_read_string_view (self, tlv_offset, offset, field->size, field->length, &str, &str_length, error))
+            return FALSE;
+        g_string_append_len (printable, str, strnlen (str, str_length));
+        return TRUE;
+    }
+
+    case QMI_TLV_FIELD_TYPE_FIXED_SIZE_STRING: {
+        const guint8 *str;
+
+        if (!(str = __qmi_message_tlv_read_fixed_layout (self, tlv_offset, offset, field->length, error)))
+            return FALSE;
+        g_string_append_len (printable, (const gchar *) str, strnlen ((const gchar *) str, field->length));
+        return TRUE;
+    }
+
+    case QMI_TLV_FIELD_TYPE_ARRAY: {
+        const QmiTlvField *element;
+        guint64            n_items;
+        guint              i;
+
+        if (field->size > 0) {
+            if (!qmi_message_tlv_read_sized_guint (self, tlv_offset, offset, field->size, QMI_ENDIAN_LITTLE, &n_items, error))
+                return FALSE;
+        } else
+            n_items = field->length;
+
+        element = &field->members[0];
+        if (field->flags & QMI_TLV_FIELD_FLAG_SEQUENCE) {
+            if (!tlv_field_read_integer (self, tlv_offset, offset, element, &value_unsigned, &value_signed, error))
+                return FALSE;
+            g_string_append_printf (printable, "[[Seq:%u]] ", (guint) value_unsigned);
+            element++;
+        }
+
+        g_string_append (printable, "{");
+        for (i = 0; i < n_items; i++) {
+            g_string_append_printf (printable, " [%u] = '", i);
+            if (!tlv_field_append_printable (self, tlv_offset, offset, element, printable, error))
+                return FALSE;
+            g_string_append (printable, " '");
+        }
+        g_string_append (printable, "}");
+        return TRUE;
+    }
+
+    case QMI_TLV_FIELD_TYPE_STRUCT: {
+        guint i;
+
+        g_string_append (printable, "[");
+        for (i = 0; i < field->n_members; i++) {
+            g_string_append_printf (printable, " %s = '", field->members[i].name);
+            if (!tlv_field_append_printable (self, tlv_offset, offset, &field->members[i], printable, error))
+                return FALSE;
+            g_string_append (printable, "'");
+        }
+        g_string_append (printable, " ]");
+        return TRUE;
+    }
+
+    case QMI_TLV_FIELD_TYPE_RESULT: {
+        guint16 error_status;
+        guint16 error_code;
+
+        if (!qmi_message_tlv_read_guint16 (self, tlv_offset, offset, QMI_ENDIAN_LITTLE, &error_status, error) ||
+            !qmi_message_tlv_read_guint16 (self, tlv_offset, offset, QMI_ENDIAN_LITTLE, &error_code, error))
+            return FALSE;
+        /* QMI_STATUS_SUCCESS */
+        if (error_status == 0x0000)
+            g_string_append (printable, "SUCCESS");
+        else
+            g_string_append_printf (printable,
+                                    "FAILURE: %s",
+                                    qmi_protocol_error_get_string ((QmiProtocolError) error_code));
+        return TRUE;
+    }
+
+    default:
+        g_assert_not_reached ();
+    }
+}
+
+static void
+tlv_append_printable (QmiMessage        *self,
+                      guint8             type,
+                      const QmiTlvField *field,
+                      GString           *printable)
+{
+    gsize   offset = 0;
+    gsize   init_offset;
+    GError *error = NULL;
+
+    if ((init_offset = qmi_message_tlv_read_init (self, type, NULL, NULL)) == 0)
+        return;
+
+    if (tlv_field_append_printable (self, init_offset, &offset, field, printable, &error)) {
+        if ((offset = __qmi_message_tlv_read_remaining_size (self, init_offset, offset)) > 0)
+            g_string_append_printf (printable, "Additional unexpected '%" G_GSIZE_FORMAT "' bytes", offset);
+    } else {
+        g_string_append_printf (printable, " ERROR: %s", error->message);
+        g_error_free (error);
+    }
+}
+
+void
+__qmi_message_append_tlvs_printable (QmiMessage             *self,
+                                     const gchar            *line_prefix,
+                                     const QmiTlvDescriptor *tlvs,
+                                     guint                   n_tlvs,
+                                     GString                *printable)
+{
+    struct tlv *tlv;
+
+    for (tlv = qmi_tlv_first (self); tlv; tlv = qmi_tlv_next (self, tlv)) {
+        const QmiTlvDescriptor *descriptor = NULL;
+        guint16                 length;
+        guint                   i;
+
+        length = GUINT16_FROM_LE (tlv->length);
+
+        for (i = 0; i < n_tlvs; i++) {
+            if (tlvs[i].type == tlv->type) {
+                descriptor = &tlvs[i];
+                break;
+            }
+        }
+
+        if (!descriptor) {
+            append_tlv_printable_generic (line_prefix, tlv->type, tlv->value, length, printable);
+            continue;
+        }
+
+        __qmi_message_append_tlv_printable_header (line_prefix, tlv->type, descriptor->name, tlv->value, length, printable);
+        tlv_append_printable (self, tlv->type, descriptor->field, printable);
+        g_string_append_c (printable, '\n');
+    }
+}
+
+static void
+append_generic_printable (QmiMessage  *self,
+                          const gchar *line_prefix,
+                          GString     *printable)
+{
+    struct tlv *tlv;
+
+    g_string_append_printf (printable,
+                            "%s  message     = (0x%04x)\n",
+                            line_prefix, qmi_message_get_message_id (self));
+
+    for (tlv = qmi_tlv_first (self); tlv; tlv = qmi_tlv_next (self, tlv))
+        append_tlv_printable_generic (line_prefix,
+                                      tlv->type,
+                                      tlv->value,
+                                      GUINT16_FROM_LE (tlv->length),
+                                      printable);
+}
+
+void
+__qmi_message_append_printable_header (QmiMessage  *self,
+                                       const gchar *line_prefix,
+                                       GString     *printable)
+{
+    gchar *qmi_flags_str;
+
+    g_string_append_printf (printable,
+                            "%sQMUX:\n"
+                            "%s  length  = %u\n"
                             "%s  flags   = 0x%02x\n"
                             "%s  service = \"%s\"\n"
                             "%s  client  = %u\n",
@@ -1501,60 +2295,711 @@ qmi_message_get_printable_full (QmiMessage        *self,
                             line_prefix, qmi_message_get_transaction_id (self),
                             line_prefix, get_all_tlvs_length (self));
     g_free (qmi_flags_str);
+}
+
+void
+qmi_message_append_printable (QmiMessage        *self,
+                              QmiMessageContext *context,
+                              const gchar       *line_prefix,
+                              GString           *printable)
+{
+    gboolean known;
 
-    contents = NULL;
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (printable != NULL);
+
+    if (!line_prefix)
+        line_prefix = "";
+
+    __qmi_message_append_printable_header (self, line_prefix, printable);
+
+    known = FALSE;
     switch (qmi_message_get_service (self)) {
     case QMI_SERVICE_CTL:
-        contents = __qmi_message_ctl_get_printable (self, context, line_prefix);
+        known = __qmi_message_ctl_append_printable (self, context, line_prefix, printable);
         break;
+#if QMI_SERVICE_DMS_SUPPORTED
     case QMI_SERVICE_DMS:
-        contents = __qmi_message_dms_get_printable (self, context, line_prefix);
+        known = __qmi_message_dms_append_printable (self, context, line_prefix, printable);
         break;
+#endif
+#if QMI_SERVICE_WDS_SUPPORTED
     case QMI_SERVICE_WDS:
-        contents = __qmi_message_wds_get_printable (self, context, line_prefix);
+        known = __qmi_message_wds_append_printable (self, context, line_prefix, printable);
         break;
+#endif
+#if QMI_SERVICE_NAS_SUPPORTED
     case QMI_SERVICE_NAS:
-        contents = __qmi_message_nas_get_printable (self, context, line_prefix);
+        known = __qmi_message_nas_append_printable (self, context, line_prefix, printable);
         break;
+#endif
+#if QMI_SERVICE_WMS_SUPPORTED
     case QMI_SERVICE_WMS:
-        contents = __qmi_message_wms_get_printable (self, context, line_prefix);
+        known = __qmi_message_wms_append_printable (self, context, line_prefix, printable);
         break;
+#endif
+#if QMI_SERVICE_PDC_SUPPORTED
     case QMI_SERVICE_PDC:
-        contents = __qmi_message_pdc_get_printable (self, context, line_prefix);
+        known = __qmi_message_pdc_append_printable (self, context, line_prefix, printable);
         break;
+#endif
+#if QMI_SERVICE_PDS_SUPPORTED
     case QMI_SERVICE_PDS:
-        contents = __qmi_message_pds_get_printable (self, context, line_prefix);
+        known = __qmi_message_pds_append_printable (self, context, line_prefix, printable);
         break;
+#endif
+#if QMI_SERVICE_PBM_SUPPORTED
     case QMI_SERVICE_PBM:
-        contents = __qmi_message_pbm_get_printable (self, context, line_prefix);
+        known = __qmi_message_pbm_append_printable (self, context, line_prefix, printable);
         break;
+#endif
+#if QMI_SERVICE_UIM_SUPPORTED
     case QMI_SERVICE_UIM:
-        contents = __qmi_message_uim_get_printable (self, context, line_prefix);
+        known = __qmi_message_uim_append_printable (self, context, line_prefix, printable);
         break;
+#endif
+#if QMI_SERVICE_OMA_SUPPORTED
     case QMI_SERVICE_OMA:
-        contents = __qmi_message_oma_get_printable (self, context, line_prefix);
+        known = __qmi_message_oma_append_printable (self, context, line_prefix, printable);
         break;
+#endif
+#if QMI_SERVICE_WDA_SUPPORTED
     case QMI_SERVICE_WDA:
-        contents = __qmi_message_wda_get_printable (self, context, line_prefix);
+        known = __qmi_message_wda_append_printable (self, context, line_prefix, printable);
         break;
+#endif
+#if QMI_SERVICE_VOICE_SUPPORTED
     case QMI_SERVICE_VOICE:
-        contents = __qmi_message_voice_get_printable (self, context, line_prefix);
+        known = __qmi_message_voice_append_printable (self, context, line_prefix, printable);
         break;
+#endif
+#if QMI_SERVICE_LOC_SUPPORTED
     case QMI_SERVICE_LOC:
-        contents = __qmi_message_loc_get_printable (self, context, line_prefix);
+        known = __qmi_message_loc_append_printable (self, context, line_prefix, printable);
         break;
+#endif
     default:
         break;
     }
 
-    if (!contents)
-        contents = get_generic_printable (self, line_prefix);
-    g_string_append (printable, contents);
-    g_free (contents);
+    if (!known)
+        append_generic_printable (self, line_prefix, printable);
+}
 
+gchar *
+qmi_message_get_printable_full (QmiMessage        *self,
+                                QmiMessageContext *context,
+                                const gchar       *line_prefix)
+{
+    GString *printable;
+
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (line_prefix != NULL, NULL);
+
+    printable = g_string_sized_new (1024);
+    qmi_message_append_printable (self, context, line_prefix, printable);
     return g_string_free (printable, FALSE);
 }
 
+static const gchar *
+get_name (QmiMessage        *self,
+          QmiMessageContext *context)
+{
+    switch (qmi_message_get_service (self)) {
+    case QMI_SERVICE_CTL:
+        return __qmi_message_ctl_get_name (self, context);
+#if QMI_SERVICE_DMS_SUPPORTED
+    case QMI_SERVICE_DMS:
+        return __qmi_message_dms_get_name (self, context);
+#endif
+#if QMI_SERVICE_WDS_SUPPORTED
+    case QMI_SERVICE_WDS:
+        return __qmi_message_wds_get_name (self, context);
+#endif
+#if QMI_SERVICE_NAS_SUPPORTED
+    case QMI_SERVICE_NAS:
+        return __qmi_message_nas_get_name (self, context);
+#endif
+#if QMI_SERVICE_WMS_SUPPORTED
+    case QMI_SERVICE_WMS:
+        return __qmi_message_wms_get_name (self, context);
+#endif
+#if QMI_SERVICE_PDC_SUPPORTED
+    case QMI_SERVICE_PDC:
+        return __qmi_message_pdc_get_name (self, context);
+#endif
+#if QMI_SERVICE_PDS_SUPPORTED
+    case QMI_SERVICE_PDS:
+        return __qmi_message_pds_get_name (self, context);
+#endif
+#if QMI_SERVICE_PBM_SUPPORTED
+    case QMI_SERVICE_PBM:
+        return __qmi_message_pbm_get_name (self, context);
+#endif
+#if QMI_SERVICE_UIM_SUPPORTED
+    case QMI_SERVICE_UIM:
+        return __qmi_message_uim_get_name (self, context);
+#endif
+#if QMI_SERVICE_OMA_SUPPORTED
+    case QMI_SERVICE_OMA:
+        return __qmi_message_oma_get_name (self, context);
+#endif
+#if QMI_SERVICE_WDA_SUPPORTED
+    case QMI_SERVICE_WDA:
+        return __qmi_message_wda_get_name (self, context);
+#endif
+#if QMI_SERVICE_VOICE_SUPPORTED
+    case QMI_SERVICE_VOICE:
+        return __qmi_message_voice_get_name (self, context);
+#endif
+#if QMI_SERVICE_LOC_SUPPORTED
+    case QMI_SERVICE_LOC:
+        return __qmi_message_loc_get_name (self, context);
+#endif
+    default:
+        return NULL;
+    }
+}
+
+void
+qmi_message_append_summary (QmiMessage        *self,
+                            QmiMessageContext *context,
+                            GString           *summary)
+{
+    const gchar *type_str;
+    const gchar *message_str;
+
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (summary != NULL);
+
+    if (qmi_message_is_indication (self))
+        type_str = "indication";
+    else if (qmi_message_is_response (self))
+        type_str = "response";
+    else
+        type_str = "request";
+
+    message_str = get_name (self, context);
+
+    g_string_append_printf (summary,
+                            "type = \"%s\", service = \"%s\", client = %u, message = ",
+                            type_str,
+                            qmi_service_get_string (qmi_message_get_service (self)),
+                            qmi_message_get_client_id (self));
+    if (message_str)
+        g_string_append_printf (summary, "\"%s\" ", message_str);
+    g_string_append_printf (summary,
+                            "(0x%04x), transaction = %u",
+                            qmi_message_get_message_id (self),
+                            qmi_message_get_transaction_id (self));
+
+    if (qmi_message_is_response (self)) {
+        const guint8 *raw;
+        guint16       raw_length;
+
+        /* The result TLV always comes with the same layout, in every service */
+        raw = qmi_message_get_raw_tlv (self, 0x02, &raw_length);
+        if (raw && raw_length >= 4) {
+            guint16 error_status;
+            guint16 error_code;
+
+            memcpy (&error_status, &raw[0], 2);
+            memcpy (&error_code,   &raw[2], 2);
+            /* QMI_STATUS_SUCCESS */
+            if (GUINT16_FROM_LE (error_status) == 0x0000)
+                g_string_append (summary, ", result = \"SUCCESS\"");
+            else
+                g_string_append_printf (summary,
+                                        ", result = \"FAILURE: %s\"",
+                                        qmi_protocol_error_get_string ((QmiProtocolError) GUINT16_FROM_LE (error_code)));
+        }
+    }
+}
+
+/*****************************************************************************/
+/* JSON representations built from TLV descriptors */
+
+static void
+json_append_string (GString      *json,
+                    const gchar  *str,
+                    gsize         str_length)
+{
+    const gchar *end;
+
+    end = str + str_length;
+    g_string_append_c (json, '"');
+    while (str < end) {
+        gunichar c;
+
+        c = g_utf8_get_char_validated (str, end - str);
+        if (c == (gunichar) -1 || c == (gunichar) -2) {
+            /* Invalid UTF-8 bytes are escaped one by one */
+            g_string_append_printf (json, "\\u%04x", (guint8) *str);
+            str++;
+            continue;
+        }
+
+        switch (c) {
+        case '"':
+            g_string_append (json, "\\\"");
+            break;
+        case '\\':
+            g_string_append (json, "\\\\");
+            break;
+        case '\n':
+            g_string_append (json, "\\n");
+            break;
+        case '\r':
+            g_string_append (json, "\\r");
+            break;
+        case '\t':
+            g_string_append (json, "\\t");
+            break;
+        default:
+            if (c < 0x20)
+                g_string_append_printf (json, "\\u%04x", c);
+            else
+                g_string_append_unichar (json, c);
+            break;
+        }
+        str = g_utf8_next_char (str);
+    }
+    g_string_append_c (json, '"');
+}
+
+static gboolean
+tlv_field_append_json (QmiMessage         *self,
+                       gsize               tlv_offset,
+                       gsize              *offset,
+                       const QmiTlvField  *field,
+                       GString            *json,
+                       GError            **error)
+{
+    guint64 value_unsigned;
+    gint64  value_signed;
+
+    switch ((QmiTlvFieldType) field->type) {
+    case QMI_TLV_FIELD_TYPE_UINT:
+        if (!tlv_field_read_integer (self, tlv_offset, offset, field, &value_unsigned, &value_signed, error))
+            return FALSE;
+        g_string_append_printf (json, "%" G_GUINT64_FORMAT, value_unsigned);
+        return TRUE;
+
+    case QMI_TLV_FIELD_TYPE_INT:
+        if (!tlv_field_read_integer (self, tlv_offset, offset, field, &value_unsigned, &value_signed, error))
+            return FALSE;
+        g_string_append_printf (json, "%" G_GINT64_FORMAT, value_signed);
+        return TRUE;
+
+    case QMI_TLV_FIELD_TYPE_FLOAT: {
+        gfloat tmp;
+        gchar  buffer[G_ASCII_DTOSTR_BUF_SIZE];
+
+        if (!qmi_message_tlv_read_gfloat (self, tlv_offset, offset, &tmp, error))
+            return FALSE;
+        /* NaN and infinite values can't be given as JSON numbers */
+        if (isfinite (tmp))
+            g_string_append (json, g_ascii_dtostr (buffer, sizeof (buffer), (gdouble) tmp));
+        else
+            g_string_append (json, "null");
+        return TRUE;
+    }
+
+    case QMI_TLV_FIELD_TYPE_BOOLEAN:
+        if (!tlv_field_read_integer (self, tlv_offset, offset, field, &value_unsigned, &value_signed, error))
+            return FALSE;
+        g_string_append (json, value_unsigned ? "true" : "false");
+        return TRUE;
+
+    case QMI_TLV_FIELD_TYPE_ENUM: {
+        const gchar *enum_str;
+
+        if (!tlv_field_read_integer (self, tlv_offset, offset, field, &value_unsigned, &value_signed, error))
+            return FALSE;
+        /* Unknown values are given as numbers */
+        enum_str = tlv_field_enum_get_string (field, value_signed);
+        if (enum_str)
+            json_append_string (json, enum_str, strlen (enum_str));
+        else
+            g_string_append_printf (json, "%" G_GINT64_FORMAT, value_signed);
+        return TRUE;
+    }
+
+    case QMI_TLV_FIELD_TYPE_FLAGS:
+    case QMI_TLV_FIELD_TYPE_FLAGS64: {
+        gchar *flags_str;
+
+        if (!tlv_field_read_integer (self, tlv_offset, offset, field, &value_unsigned, &value_signed, error))
+            return FALSE;
+        flags_str = tlv_field_flags_build_string (field, value_unsigned);
+        if (flags_str)
+            json_append_string (json, flags_str, strlen (flags_str));
+        else
+            g_string_append (json, "\"\"");
+        g_free (flags_str);
+        return TRUE;
+    }
+
+    case QMI_TLV_FIELD_TYPE_STRING: {
+        const gchar *str;
+        guint16      str_length;
+
+        if (!__qmi_message_tlv_read_string_view (self, tlv_offset, offset, field->size, field->length, &str, &str_length, error))
+            return FALSE;
+        json_append_string (json, str, strnlen (str, str_length));
+        return TRUE;
+    }
+
+    case QMI_TLV_FIELD_TYPE_FIXED_SIZE_STRING: {
+        const guint8 *str;
+
+        if (!(str = __qmi_message_tlv_read_fixed_layout (self, tlv_offset, offset, field->length, error)))
+            return FALSE;
+        json_append_string (json, (const gchar *) str, strnlen ((const gchar *) str, field->length));
+        return TRUE;
+    }
+
+    case QMI_TLV_FIELD_TYPE_ARRAY: {
+        const QmiTlvField *element;
+        guint64            n_items;
+        guint              i;
+        gboolean           sequence;
+
+        if (field->size > 0) {
+            if (!qmi_message_tlv_read_sized_guint (self, tlv_offset, offset, field->size, QMI_ENDIAN_LITTLE, &n_items, error))
+                return FALSE;
+        } else
+            n_items = field->length;
+
+        element = &field->members[0];
+        sequence = !!(field->flags & QMI_TLV_FIELD_FLAG_SEQUENCE);
+        if (sequence) {
+            if (!tlv_field_read_integer (self, tlv_offset, offset, element, &value_unsigned, &value_signed, error))
+                return FALSE;
+            g_string_append_printf (json, "{\"sequence\":%u,\"items\":", (guint) value_unsigned);
+            element++;
+        }
+
+        g_string_append_c (json, '[');
+        for (i = 0; i < n_items; i++) {
+            if (i > 0)
+                g_string_append_c (json, ',');
+            if (!tlv_field_append_json (self, tlv_offset, offset, element, json, error))
+                return FALSE;
+        }
+        g_string_append_c (json, ']');
+
+        if (sequence)
+            g_string_append_c (json, '}');
+        return TRUE;
+    }
+
+    case QMI_TLV_FIELD_TYPE_STRUCT: {
+        guint i;
+
+        g_string_append_c (json, '{');
+        for (i = 0; i < field->n_members; i++) {
+            if (i > 0)
+                g_string_append_c (json, ',');
+            json_append_string (json, field->members[i].name, strlen (field->members[i].name));
+            g_string_append_c (json, ':');
+            if (!tlv_field_append_json (self, tlv_offset, offset, &field->members[i], json, error))
+                return FALSE;
+        }
+        g_string_append_c (json, '}');
+        return TRUE;
+    }
+
+    case QMI_TLV_FIELD_TYPE_RESULT: {
+        guint16 error_status;
+        guint16 error_code;
+
+        if (!qmi_message_tlv_read_guint16 (self, tlv_offset, offset, QMI_ENDIAN_LITTLE, &error_status, error) ||
+            !qmi_message_tlv_read_guint16 (self, tlv_offset, offset, QMI_ENDIAN_LITTLE, &error_code, error))
+            return FALSE;
+        /* QMI_STATUS_SUCCESS */
+        if (error_status == 0x0000)
+            g_string_append (json, "{\"status\":\"success\"}");
+        else {
+            const gchar *error_str;
+
+            error_str = qmi_protocol_error_get_string ((QmiProtocolError) error_code);
+            g_string_append (json, "{\"status\":\"failure\",\"error\":");
+            if (error_str)
+                json_append_string (json, error_str, strlen (error_str));
+            else
+                g_string_append_printf (json, "%u", error_code);
+            g_string_append_c (json, '}');
+        }
+        return TRUE;
+    }
+
+    default:
+        g_assert_not_reached ();
+    }
+}
+
+static void
+tlv_append_json (QmiMessage             *self,
+                 const QmiTlvDescriptor *descriptor,
+                 GString                *json)
+{
+    gsize    offset = 0;
+    gsize    init_offset;
+    gsize    json_length;
+    GError  *error = NULL;
+
+    json_append_string (json, descriptor->name, strlen (descriptor->name));
+    g_string_append (json, ",\"value\":");
+
+    if ((init_offset = qmi_message_tlv_read_init (self, descriptor->type, NULL, &error)) > 0) {
+        /* Drop the partial value if it can't be fully read */
+        json_length = json->len;
+        if (tlv_field_append_json (self, init_offset, &offset, descriptor->field, json, &error)) {
+            if ((offset = __qmi_message_tlv_read_remaining_size (self, init_offset, offset)) > 0)
+                g_string_append_printf (json, ",\"unexpected-bytes\":%" G_GSIZE_FORMAT, offset);
+            return;
+        }
+        g_string_truncate (json, json_length);
+    }
+
+    g_string_append (json, "null,\"error\":");
+    json_append_string (json, error->message, strlen (error->message));
+    g_error_free (error);
+}
+
+static gboolean
+get_tlv_descriptors (QmiMessage              *self,
+                     QmiMessageContext       *context,
+                     const QmiTlvDescriptor **tlvs,
+                     guint                   *n_tlvs)
+{
+    switch (qmi_message_get_service (self)) {
+    case QMI_SERVICE_CTL:
+        return __qmi_message_ctl_get_tlv_descriptors (self, context, tlvs, n_tlvs);
+#if QMI_SERVICE_DMS_SUPPORTED
+    case QMI_SERVICE_DMS:
+        return __qmi_message_dms_get_tlv_descriptors (self, context, tlvs, n_tlvs);
+#endif
+#if QMI_SERVICE_WDS_SUPPORTED
+    case QMI_SERVICE_WDS:
+        return __qmi_message_wds_get_tlv_descriptors (self, context, tlvs, n_tlvs);
+#endif
+#if QMI_SERVICE_NAS_SUPPORTED
+    case QMI_SERVICE_NAS:
+        return __qmi_message_nas_get_tlv_descriptors (self, context, tlvs, n_tlvs);
+#endif
+#if QMI_SERVICE_WMS_SUPPORTED
+    case QMI_SERVICE_WMS:
+        return __qmi_message_wms_get_tlv_descriptors (self, context, tlvs, n_tlvs);
+#endif
+#if QMI_SERVICE_PDC_SUPPORTED
+    case QMI_SERVICE_PDC:
+        return __qmi_message_pdc_get_tlv_descriptors (self, context, tlvs, n_tlvs);
+#endif
+#if QMI_SERVICE_PDS_SUPPORTED
+    case QMI_SERVICE_PDS:
+        return __qmi_message_pds_get_tlv_descriptors (self, context, tlvs, n_tlvs);
+#endif
+#if QMI_SERVICE_PBM_SUPPORTED
+    case QMI_SERVICE_PBM:
+        return __qmi_message_pbm_get_tlv_descriptors (self, context, tlvs, n_tlvs);
+#endif
+#if QMI_SERVICE_UIM_SUPPORTED
+    case QMI_SERVICE_UIM:
+        return __qmi_message_uim_get_tlv_descriptors (self, context, tlvs, n_tlvs);
+#endif
+#if QMI_SERVICE_OMA_SUPPORTED
+    case QMI_SERVICE_OMA:
+        return __qmi_message_oma_get_tlv_descriptors (self, context, tlvs, n_tlvs);
+#endif
+#if QMI_SERVICE_WDA_SUPPORTED
+    case QMI_SERVICE_WDA:
+        return __qmi_message_wda_get_tlv_descriptors (self, context, tlvs, n_tlvs);
+#endif
+#if QMI_SERVICE_VOICE_SUPPORTED
+    case QMI_SERVICE_VOICE:
+        return __qmi_message_voice_get_tlv_descriptors (self, context, tlvs, n_tlvs);
+#endif
+#if QMI_SERVICE_LOC_SUPPORTED
+    case QMI_SERVICE_LOC:
+        return __qmi_message_loc_get_tlv_descriptors (self, context, tlvs, n_tlvs);
+#endif
+    default:
+        return FALSE;
+    }
+}
+
+void
+qmi_message_append_json (QmiMessage        *self,
+                         QmiMessageContext *context,
+                         GString           *json)
+{
+    const QmiTlvDescriptor *tlvs = NULL;
+    guint                   n_tlvs = 0;
+    const gchar            *type_str;
+    const gchar            *service_str;
+    const gchar            *message_str;
+    struct tlv             *tlv;
+    gboolean                first;
+
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (json != NULL);
+
+    if (qmi_message_is_indication (self))
+        type_str = "indication";
+    else if (qmi_message_is_response (self))
+        type_str = "response";
+    else
+        type_str = "request";
+
+    g_string_append (json, "{\"service\":");
+    service_str = qmi_service_get_string (qmi_message_get_service (self));
+    if (service_str)
+        json_append_string (json, service_str, strlen (service_str));
+    else
+        g_string_append_printf (json, "%u", (guint) qmi_message_get_service (self));
+
+    g_string_append_printf (json,
+                            ",\"client\":%u,\"transaction\":%u,\"type\":\"%s\",\"message\":",
+                            qmi_message_get_client_id (self),
+                            qmi_message_get_transaction_id (self),
+                            type_str);
+
+    message_str = get_name (self, context);
+    if (message_str)
+        json_append_string (json, message_str, strlen (message_str));
+    else
+        g_string_append (json, "null");
+    g_string_append_printf (json, ",\"message-id\":%u,\"tlvs\":[", qmi_message_get_message_id (self));
+
+    get_tlv_descriptors (self, context, &tlvs, &n_tlvs);
+
+    first = TRUE;
+    for (tlv = qmi_tlv_first (self); tlv; tlv = qmi_tlv_next (self, tlv)) {
+        const QmiTlvDescriptor *descriptor = NULL;
+        guint                   i;
+
+        for (i = 0; i < n_tlvs; i++) {
+            if (tlvs[i].type == tlv->type) {
+                descriptor = &tlvs[i];
+                break;
+            }
+        }
+
+        if (!first)
+            g_string_append_c (json, ',');
+        first = FALSE;
+
+        g_string_append_printf (json, "{\"type\":%u,", tlv->type);
+        if (descriptor) {
+            g_string_append (json, "\"name\":");
+            tlv_append_json (self, descriptor, json);
+        } else {
+            g_string_append (json, "\"raw\":\"");
+            __qmi_utils_str_hex_append (json, tlv->value, GUINT16_FROM_LE (tlv->length), ':');
+            g_string_append_c (json, '"');
+        }
+        g_string_append_c (json, '}');
+    }
+
+    g_string_append (json, "]}");
+}
+
+gchar *
+qmi_message_get_json (QmiMessage        *self,
+                      QmiMessageContext *context)
+{
+    GString *json;
+
+    g_return_val_if_fail (self != NULL, NULL);
+
+    json = g_string_sized_new (256);
+    qmi_message_append_json (self, context, json);
+    return g_string_free (json, FALSE);
+}
+
+static gboolean
+parse_check (QmiMessage         *self,
+             QmiMessageContext  *context,
+             GError            **error)
+{
+    switch (qmi_message_get_service (self)) {
+    case QMI_SERVICE_CTL:
+        return __qmi_message_ctl_parse_check (self, context, error);
+#if QMI_SERVICE_DMS_SUPPORTED
+    case QMI_SERVICE_DMS:
+        return __qmi_message_dms_parse_check (self, context, error);
+#endif
+#if QMI_SERVICE_WDS_SUPPORTED
+    case QMI_SERVICE_WDS:
+        return __qmi_message_wds_parse_check (self, context, error);
+#endif
+#if QMI_SERVICE_NAS_SUPPORTED
+    case QMI_SERVICE_NAS:
+        return __qmi_message_nas_parse_check (self, context, error);
+#endif
+#if QMI_SERVICE_WMS_SUPPORTED
+    case QMI_SERVICE_WMS:
+        return __qmi_message_wms_parse_check (self, context, error);
+#endif
+#if QMI_SERVICE_PDC_SUPPORTED
+    case QMI_SERVICE_PDC:
+        return __qmi_message_pdc_parse_check (self, context, error);
+#endif
+#if QMI_SERVICE_PDS_SUPPORTED
+    case QMI_SERVICE_PDS:
+        return __qmi_message_pds_parse_check (self, context, error);
+#endif
+#if QMI_SERVICE_PBM_SUPPORTED
+    case QMI_SERVICE_PBM:
+        return __qmi_message_pbm_parse_check (self, context, error);
+#endif
+#if QMI_SERVICE_UIM_SUPPORTED
+    case QMI_SERVICE_UIM:
+        return __qmi_message_uim_parse_check (self, context, error);
+#endif
+#if QMI_SERVICE_OMA_SUPPORTED
+    case QMI_SERVICE_OMA:
+        return __qmi_message_oma_parse_check (self, context, error);
+#endif
+#if QMI_SERVICE_WDA_SUPPORTED
+    case QMI_SERVICE_WDA:
+        return __qmi_message_wda_parse_check (self, context, error);
+#endif
+#if QMI_SERVICE_VOICE_SUPPORTED
+    case QMI_SERVICE_VOICE:
+        return __qmi_message_voice_parse_check (self, context, error);
+#endif
+#if QMI_SERVICE_LOC_SUPPORTED
+    case QMI_SERVICE_LOC:
+        return __qmi_message_loc_parse_check (self, context, error);
+#endif
+    default:
+        g_assert_not_reached ();
+    }
+}
+
+gboolean
+qmi_message_validate (QmiMessage         *self,
+                      QmiMessageContext  *context,
+                      GError            **error)
+{
+    g_return_val_if_fail (self != NULL, FALSE);
+
+    if (!get_name (self, context)) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_UNSUPPORTED,
+                     "Unknown message 0x%04x in service 0x%02x",
+                     qmi_message_get_message_id (self),
+                     qmi_message_get_service (self));
+        return FALSE;
+    }
+
+    return parse_check (self, context, error);
+}
+
 gchar *
 qmi_message_get_printable (QmiMessage  *self,
                            const gchar *line_prefix)
@@ -1575,35 +3020,55 @@ qmi_message_get_version_introduced_full (QmiMessage        *self,
         *minor = 0;
         return TRUE;
 
+#if QMI_SERVICE_DMS_SUPPORTED
     case QMI_SERVICE_DMS:
         return __qmi_message_dms_get_version_introduced (self, context, major, minor);
+#endif
 
+#if QMI_SERVICE_WDS_SUPPORTED
     case QMI_SERVICE_WDS:
         return __qmi_message_wds_get_version_introduced (self, context, major, minor);
+#endif
 
+#if QMI_SERVICE_NAS_SUPPORTED
     case QMI_SERVICE_NAS:
         return __qmi_message_nas_get_version_introduced (self, context, major, minor);
+#endif
 
+#if QMI_SERVICE_WMS_SUPPORTED
     case QMI_SERVICE_WMS:
         return __qmi_message_wms_get_version_introduced (self, context, major, minor);
+#endif
 
+#if QMI_SERVICE_PDS_SUPPORTED
     case QMI_SERVICE_PDS:
         return __qmi_message_pds_get_version_introduced (self, context, major, minor);
+#endif
 
+#if QMI_SERVICE_PBM_SUPPORTED
     case QMI_SERVICE_PBM:
         return __qmi_message_pbm_get_version_introduced (self, context, major, minor);
+#endif
 
+#if QMI_SERVICE_UIM_SUPPORTED
     case QMI_SERVICE_UIM:
         return __qmi_message_uim_get_version_introduced (self, context, major, minor);
+#endif
 
+#if QMI_SERVICE_OMA_SUPPORTED
     case QMI_SERVICE_OMA:
         return __qmi_message_oma_get_version_introduced (self, context, major, minor);
+#endif
 
+#if QMI_SERVICE_WDA_SUPPORTED
     case QMI_SERVICE_WDA:
         return __qmi_message_wda_get_version_introduced (self, context, major, minor);
+#endif
 
+#if QMI_SERVICE_LOC_SUPPORTED
     case QMI_SERVICE_LOC:
         return __qmi_message_loc_get_version_introduced (self, context, major, minor);
+#endif
 
     default:
         /* For the still unsupported services, cannot do anything */
@@ -1618,3 +3083,151 @@ qmi_message_get_version_introduced (QmiMessage *self,
 {
     return qmi_message_get_version_introduced_full (self, NULL, major, minor);
 }
+
+gboolean
+__qmi_message_is_idempotent (QmiMessage        *self,
+                             QmiMessageContext *context)
+{
+    if (!qmi_message_is_request (self))
+        return FALSE;
+
+    switch (qmi_message_get_service (self)) {
+#if QMI_SERVICE_DMS_SUPPORTED
+    case QMI_SERVICE_DMS:
+        return __qmi_message_dms_is_idempotent (self, context);
+#endif
+
+#if QMI_SERVICE_WDS_SUPPORTED
+    case QMI_SERVICE_WDS:
+        return __qmi_message_wds_is_idempotent (self, context);
+#endif
+
+#if QMI_SERVICE_NAS_SUPPORTED
+    case QMI_SERVICE_NAS:
+        return __qmi_message_nas_is_idempotent (self, context);
+#endif
+
+#if QMI_SERVICE_WMS_SUPPORTED
+    case QMI_SERVICE_WMS:
+        return __qmi_message_wms_is_idempotent (self, context);
+#endif
+
+#if QMI_SERVICE_PDC_SUPPORTED
+    case QMI_SERVICE_PDC:
+        return __qmi_message_pdc_is_idempotent (self, context);
+#endif
+
+#if QMI_SERVICE_PDS_SUPPORTED
+    case QMI_SERVICE_PDS:
+        return __qmi_message_pds_is_idempotent (self, context);
+#endif
+
+#if QMI_SERVICE_PBM_SUPPORTED
+    case QMI_SERVICE_PBM:
+        return __qmi_message_pbm_is_idempotent (self, context);
+#endif
+
+#if QMI_SERVICE_UIM_SUPPORTED
+    case QMI_SERVICE_UIM:
+        return __qmi_message_uim_is_idempotent (self, context);
+#endif
+
+#if QMI_SERVICE_OMA_SUPPORTED
+    case QMI_SERVICE_OMA:
+        return __qmi_message_oma_is_idempotent (self, context);
+#endif
+
+#if QMI_SERVICE_WDA_SUPPORTED
+    case QMI_SERVICE_WDA:
+        return __qmi_message_wda_is_idempotent (self, context);
+#endif
+
+#if QMI_SERVICE_VOICE_SUPPORTED
+    case QMI_SERVICE_VOICE:
+        return __qmi_message_voice_is_idempotent (self, context);
+#endif
+
+#if QMI_SERVICE_LOC_SUPPORTED
+    case QMI_SERVICE_LOC:
+        return __qmi_message_loc_is_idempotent (self, context);
+#endif
+
+    default:
+        /* Not for CTL requests, or those of unsupported services */
+        return FALSE;
+    }
+}
+
+guint
+__qmi_message_get_cache_ttl (QmiMessage        *self,
+                             QmiMessageContext *context)
+{
+    if (!qmi_message_is_request (self))
+        return 0;
+
+    switch (qmi_message_get_service (self)) {
+#if QMI_SERVICE_DMS_SUPPORTED
+    case QMI_SERVICE_DMS:
+        return __qmi_message_dms_get_cache_ttl (self, context);
+#endif
+
+#if QMI_SERVICE_WDS_SUPPORTED
+    case QMI_SERVICE_WDS:
+        return __qmi_message_wds_get_cache_ttl (self, context);
+#endif
+
+#if QMI_SERVICE_NAS_SUPPORTED
+    case QMI_SERVICE_NAS:
+        return __qmi_message_nas_get_cache_ttl (self, context);
+#endif
+
+#if QMI_SERVICE_WMS_SUPPORTED
+    case QMI_SERVICE_WMS:
+        return __qmi_message_wms_get_cache_ttl (self, context);
+#endif
+
+#if QMI_SERVICE_PDC_SUPPORTED
+    case QMI_SERVICE_PDC:
+        return __qmi_message_pdc_get_cache_ttl (self, context);
+#endif
+
+#if QMI_SERVICE_PDS_SUPPORTED
+    case QMI_SERVICE_PDS:
+        return __qmi_message_pds_get_cache_ttl (self, context);
+#endif
+
+#if QMI_SERVICE_PBM_SUPPORTED
+    case QMI_SERVICE_PBM:
+        return __qmi_message_pbm_get_cache_ttl (self, context);
+#endif
+
+#if QMI_SERVICE_UIM_SUPPORTED
+    case QMI_SERVICE_UIM:
+        return __qmi_message_uim_get_cache_ttl (self, context);
+#endif
+
+#if QMI_SERVICE_OMA_SUPPORTED
+    case QMI_SERVICE_OMA:
+        return __qmi_message_oma_get_cache_ttl (self, context);
+#endif
+
+#if QMI_SERVICE_WDA_SUPPORTED
+    case QMI_SERVICE_WDA:
+        return __qmi_message_wda_get_cache_ttl (self, context);
+#endif
+
+#if QMI_SERVICE_VOICE_SUPPORTED
+    case QMI_SERVICE_VOICE:
+        return __qmi_message_voice_get_cache_ttl (self, context);
+#endif
+
+#if QMI_SERVICE_LOC_SUPPORTED
+    case QMI_SERVICE_LOC:
+        return __qmi_message_loc_get_cache_ttl (self, context);
+#endif
+
+    default:
+        /* Not for CTL requests, or those of unsupported services */
+        return 0;
+    }
+}
@@ -41,6 +41,10 @@
 #include "qmi-errors.h"
 #include "qmi-message-context.h"
 
+#if defined (LIBQMI_GLIB_COMPILATION)
+#include "qmi-enums-private.h"
+#endif
+
 G_BEGIN_DECLS
 
 /**
@@ -122,6 +126,177 @@ QmiMessage *qmi_message_new (QmiService service,
 QmiMessage *qmi_message_new_from_raw (GByteArray  *raw,
                                       GError     **error);
 
+/**
+ * QmiMessageFrame:
+ * @data: the first byte of the frame (the QMUX marker) in the buffer being iterated.
+ * @offset: offset of the frame in the buffer being iterated.
+ * @length: length of the whole frame.
+ * @service: a #QmiService.
+ * @client_id: the client ID.
+ * @transaction_id: the transaction ID.
+ * @message_id: the message ID.
+ * @response: whether the frame is a response.
+ * @indication: whether the frame is an indication.
+ * @tlvs: the raw TLVs of the frame, pointing into the buffer being iterated.
+ * @tlvs_length: the length of all the raw TLVs.
+ *
+ * A view of a complete and valid QMI message found in a raw data buffer by a
+ * #QmiMessageFrameIter. No data is copied, so it is only valid as long as the
+ * buffer is.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    const guint8 *data;
+    gsize         offset;
+    gsize         length;
+    QmiService    service;
+    guint8        client_id;
+    guint16       transaction_id;
+    guint16       message_id;
+    gboolean      response;
+    gboolean      indication;
+    const guint8 *tlvs;
+    gsize         tlvs_length;
+} QmiMessageFrame;
+
+/**
+ * QmiMessageFrameIter:
+ *
+ * An opaque type representing an iterator over the QMI messages in a raw data
+ * buffer, usually allocated in the stack.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    /*< private >*/
+    const guint8 *data;
+    gsize         length;
+    gsize         offset;
+} QmiMessageFrameIter;
+
+/**
+ * qmi_message_frame_iter_init:
+ * @iter: a #QmiMessageFrameIter.
+ * @data: raw data buffer, starting with the QMUX marker of a message.
+ * @length: length of @data.
+ *
+ * Initializes @iter to iterate the QMI messages in @data, which is never
+ * modified. Unlike qmi_message_new_from_raw(), nothing is allocated or
+ * copied while iterating, so this is suitable for data coming from custom
+ * transports, logs or captures.
+ *
+ * Since: 1.20
+ */
+void qmi_message_frame_iter_init (QmiMessageFrameIter *iter,
+                                  const guint8        *data,
+                                  gsize                length);
+
+/**
+ * qmi_message_frame_iter_next:
+ * @iter: a #QmiMessageFrameIter.
+ * @frame: (out caller-allocates): return location for the next #QmiMessageFrame.
+ * @error: return location for error or %NULL.
+ *
+ * Gets the next complete QMI message in the buffer, with both its headers and
+ * its TLVs validated the same way as in qmi_message_new_from_raw().
+ *
+ * If the next complete message is not valid, it is skipped and %FALSE is
+ * returned with @error set, and the iteration may go on. If @error is %NULL,
+ * invalid messages are skipped silently.
+ *
+ * Returns: %TRUE if @frame is set, %FALSE if there are no more complete
+ * messages in the buffer or if @error is set.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_message_frame_iter_next (QmiMessageFrameIter  *iter,
+                                      QmiMessageFrame      *frame,
+                                      GError              **error);
+
+/**
+ * qmi_message_frame_iter_get_offset:
+ * @iter: a #QmiMessageFrameIter.
+ *
+ * Gets the number of bytes of the buffer already iterated, i.e. the offset of
+ * the data not yet processed. Once qmi_message_frame_iter_next() returns
+ * %FALSE without error, this is where the partial message left in the
+ * buffer, if any, starts.
+ *
+ * Returns: the offset in the buffer.
+ *
+ * Since: 1.20
+ */
+gsize qmi_message_frame_iter_get_offset (QmiMessageFrameIter *iter);
+
+/**
+ * qmi_message_new_from_frame:
+ * @frame: a #QmiMessageFrame.
+ *
+ * Creates a new #QmiMessage with a copy of the data of @frame, e.g. to keep
+ * it once the buffer is gone or to parse it with the message-specific API.
+ * The frame was already validated, so no other check is done.
+ *
+ * Returns: (transfer full): a newly created #QmiMessage, which should be freed with qmi_message_unref().
+ *
+ * Since: 1.20
+ */
+QmiMessage *qmi_message_new_from_frame (const QmiMessageFrame *frame);
+
+#if defined (LIBQMI_GLIB_COMPILATION)
+G_GNUC_INTERNAL
+QmiMessage *__qmi_message_new_sized (QmiService service,
+                                     guint8     client_id,
+                                     guint16    transaction_id,
+                                     guint16    message_id,
+                                     gsize      tlvs_size);
+G_GNUC_INTERNAL
+QmiMessage *__qmi_message_new_from_template (const guint8 *template,
+                                             gsize         template_len,
+                                             guint8        client_id,
+                                             guint16       transaction_id);
+#endif
+
+#if defined (LIBQMI_GLIB_COMPILATION)
+G_GNUC_INTERNAL
+QmiMessage *__qmi_message_new_from_raw_data (const guint8  *data,
+                                             gsize          data_len,
+                                             gsize         *consumed,
+                                             GError       **error);
+
+/* Same as __qmi_message_new_from_raw_data(), but only the QMUX and QMI
+ * headers are validated, so that messages with malformed TLVs can still be
+ * answered */
+G_GNUC_INTERNAL
+QmiMessage *__qmi_message_new_from_raw_data_opaque (const guint8  *data,
+                                                    gsize          data_len,
+                                                    gsize         *consumed,
+                                                    GError       **error);
+
+/* Validates the TLVs of a message created with
+ * __qmi_message_new_from_raw_data_opaque() */
+G_GNUC_INTERNAL
+gboolean __qmi_message_check_tlvs (QmiMessage  *self,
+                                   GError     **error);
+#endif
+
+#if defined (LIBQMI_GLIB_COMPILATION)
+/* Copy of the message, with the given client id and transaction id. Messages
+ * may be shared once built (e.g. responses stored in the cache, indications
+ * given to several clients), so this is the way to rewrite their header;
+ * if the header already has the requested values, a new reference to the
+ * message itself is returned instead. */
+G_GNUC_INTERNAL
+QmiMessage *__qmi_message_copy_for_transaction (QmiMessage *self,
+                                                guint8      client_id,
+                                                guint16     transaction_id);
+
+/* Raw contents of all the TLVs in the message */
+G_GNUC_INTERNAL
+const guint8 *__qmi_message_peek_all_tlvs (QmiMessage *self,
+                                           gsize      *length);
+#endif
+
 /**
  * qmi_message_response_new:
  * @request: a request #QmiMessage.
@@ -246,6 +421,66 @@ guint16 qmi_message_get_transaction_id (QmiMessage *self);
  */
 guint16 qmi_message_get_message_id (QmiMessage *self);
 
+#if defined (LIBQMI_GLIB_COMPILATION)
+/* Inline versions of the header getters, for the hot paths within the
+ * library. They expect a valid message, which always has at least the QMUX
+ * header and the QMI header, and read the fields at their fixed offsets:
+ *
+ *   [0] marker, [1-2] QMUX length, [3] QMUX flags, [4] service, [5] client
+ *   [6] QMI flags, then
+ *     CTL:     [7] transaction, [8-9] message
+ *     service: [7-8] transaction, [9-10] message
+ */
+
+static inline gboolean
+__qmi_message_is_control (QmiMessage *self)
+{
+    return self->data[4] == QMI_SERVICE_CTL;
+}
+
+static inline gboolean
+__qmi_message_is_response (QmiMessage *self)
+{
+    return !!(self->data[6] & (__qmi_message_is_control (self) ? QMI_CTL_FLAG_RESPONSE : QMI_SERVICE_FLAG_RESPONSE));
+}
+
+static inline gboolean
+__qmi_message_is_indication (QmiMessage *self)
+{
+    return !!(self->data[6] & (__qmi_message_is_control (self) ? QMI_CTL_FLAG_INDICATION : QMI_SERVICE_FLAG_INDICATION));
+}
+
+static inline QmiService
+__qmi_message_get_service (QmiMessage *self)
+{
+    return (QmiService) self->data[4];
+}
+
+static inline guint8
+__qmi_message_get_client_id (QmiMessage *self)
+{
+    return self->data[5];
+}
+
+static inline guint16
+__qmi_message_get_transaction_id (QmiMessage *self)
+{
+    /* note: only 1 byte for transaction in CTL message */
+    if (__qmi_message_is_control (self))
+        return (guint16) self->data[7];
+    return (guint16) (self->data[7] | (self->data[8] << 8));
+}
+
+static inline guint16
+__qmi_message_get_message_id (QmiMessage *self)
+{
+    if (__qmi_message_is_control (self))
+        return (guint16) (self->data[8] | (self->data[9] << 8));
+    return (guint16) (self->data[9] | (self->data[10] << 8));
+}
+
+#endif
+
 /**
  * qmi_message_get_length:
  * @self: a #QmiMessage.
@@ -320,6 +555,20 @@ gboolean qmi_message_get_version_introduced_full (QmiMessage        *self,
                                                   guint             *major,
                                                   guint             *minor);
 
+#if defined (LIBQMI_GLIB_COMPILATION)
+/* Whether the request only reads state from the device, so that it can be
+ * answered with the response of an identical one already in flight */
+G_GNUC_INTERNAL
+gboolean __qmi_message_is_idempotent (QmiMessage        *self,
+                                      QmiMessageContext *context);
+
+/* For how long, in seconds, the response to the request may be given to
+ * identical ones, 0 if it cannot be cached */
+G_GNUC_INTERNAL
+guint __qmi_message_get_cache_ttl (QmiMessage        *self,
+                                   QmiMessageContext *context);
+#endif
+
 /*****************************************************************************/
 /* TLV builder & writer */
 
@@ -576,6 +825,16 @@ gboolean qmi_message_tlv_write_string (QmiMessage   *self,
                                        gssize        in_length,
                                        GError      **error);
 
+#if defined (LIBQMI_GLIB_COMPILATION)
+/* Appends @len bytes already laid out as they go in the TLV, with a single
+ * copy, e.g. the contents of arrays of integers in the wire byte order */
+G_GNUC_INTERNAL
+gboolean __qmi_message_tlv_write_fixed_layout (QmiMessage    *self,
+                                               const guint8  *in,
+                                               gsize          len,
+                                               GError       **error);
+#endif
+
 /*****************************************************************************/
 /* TLV reader */
 
@@ -914,6 +1173,54 @@ G_GNUC_INTERNAL
 guint16 __qmi_message_tlv_read_remaining_size (QmiMessage  *self,
                                                gsize        tlv_offset,
                                                gsize        offset);
+
+/* Checks that @len bytes can be read from @offset in the TLV, and returns
+ * them so that they can be decoded in place, advancing @offset */
+G_GNUC_INTERNAL
+const guint8 *__qmi_message_tlv_read_fixed_layout (QmiMessage  *self,
+                                                   gsize        tlv_offset,
+                                                   gsize       *offset,
+                                                   gsize        len,
+                                                   GError     **error);
+
+/* Same as qmi_message_tlv_read_string(), but instead of a newly allocated
+ * copy, returns the (not NUL-terminated) string contents in the message buffer */
+G_GNUC_INTERNAL
+gboolean __qmi_message_tlv_read_string_view (QmiMessage    *self,
+                                             gsize          tlv_offset,
+                                             gsize         *offset,
+                                             guint8         n_size_prefix_bytes,
+                                             guint16        max_size,
+                                             const gchar  **out,
+                                             guint16       *out_length,
+                                             GError       **error);
+
+/* Same as qmi_message_tlv_read_init(), but for a TLV at a known offset,
+ * which is checked to really hold a TLV of the given type */
+G_GNUC_INTERNAL
+gsize __qmi_message_tlv_read_init_at (QmiMessage  *self,
+                                      guint8       type,
+                                      gsize        tlv_offset,
+                                      guint16     *out_tlv_length,
+                                      GError     **error);
+
+/* Offsets of the first TLV of each type in a message, 0 if not found. Built
+ * in one single pass by each parser, kept on its stack (or its offsets in
+ * the output struct, for fields decoded on demand), so that TLVs can be
+ * looked up by type without scanning the whole message each time. */
+typedef struct {
+    guint16 offset[256];
+} QmiMessageTlvIndex;
+
+G_GNUC_INTERNAL
+void          __qmi_message_tlv_index_build     (QmiMessage               *self,
+                                                 QmiMessageTlvIndex       *index);
+G_GNUC_INTERNAL
+gsize         __qmi_message_tlv_index_read_init (QmiMessage               *self,
+                                                 const QmiMessageTlvIndex *index,
+                                                 guint8                    type,
+                                                 guint16                  *out_tlv_length,
+                                                 GError                  **error);
 #endif
 
 /*****************************************************************************/
@@ -966,6 +1273,21 @@ const guint8 *qmi_message_get_raw_tlv (QmiMessage *self,
                                        guint8      type,
                                        guint16    *length);
 
+/**
+ * qmi_message_get_result_code:
+ * @self: a #QmiMessage.
+ *
+ * Get the result code reported in the 'Result' TLV of a response message,
+ * without parsing the whole message and without building any #GError.
+ *
+ * Returns: %QMI_PROTOCOL_ERROR_NONE if the operation succeeded, the reported
+ * #QmiProtocolError if it failed, or %QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE if
+ * @self is not a response or has no valid 'Result' TLV.
+ *
+ * Since: 1.20
+ */
+QmiProtocolError qmi_message_get_result_code (QmiMessage *self);
+
 /**
  * qmi_message_add_raw_tlv:
  * @self: a #QmiMessage.
@@ -1047,6 +1369,99 @@ gchar *qmi_message_get_printable_full (QmiMessage        *self,
                                        QmiMessageContext *context,
                                        const gchar       *line_prefix);
 
+/**
+ * qmi_message_append_printable:
+ * @self: a #QmiMessage.
+ * @context: (allow-none): a #QmiMessageContext, or %NULL.
+ * @line_prefix: prefix string to use in each new generated line.
+ * @printable: a #GString where the printable contents are appended.
+ *
+ * Appends the same printable contents as qmi_message_get_printable_full()
+ * to @printable, without building any intermediate string.
+ *
+ * Since: 1.20
+ */
+void qmi_message_append_printable (QmiMessage        *self,
+                                   QmiMessageContext *context,
+                                   const gchar       *line_prefix,
+                                   GString           *printable);
+
+/**
+ * qmi_message_append_summary:
+ * @self: a #QmiMessage.
+ * @context: (allow-none): a #QmiMessageContext, or %NULL.
+ * @summary: a #GString where the summary is appended.
+ *
+ * Appends a one-line summary of the message to @summary, including only
+ * the service, client, message, transaction and, in responses, the result.
+ *
+ * This is much cheaper than building the full printable contents of the
+ * message, as none of the TLVs (other than the result) is translated.
+ *
+ * Since: 1.20
+ */
+void qmi_message_append_summary (QmiMessage        *self,
+                                 QmiMessageContext *context,
+                                 GString           *summary);
+
+/**
+ * qmi_message_get_json:
+ * @self: a #QmiMessage.
+ * @context: (allow-none): a #QmiMessageContext, or %NULL.
+ *
+ * Gets a JSON representation of the message, as a single object with the
+ * "service", "client", "transaction", "type", "message" and "message-id"
+ * members, and a "tlvs" array.
+ *
+ * Each known TLV is given as an object with its "type", "name" and "value",
+ * where the value is built from the same TLV descriptions as the printable
+ * contents of the message. If the TLV cannot be read, the value is null and
+ * an "error" member is included. Unknown TLVs are given with their "type"
+ * and their "raw" contents as a hexadecimal string.
+ *
+ * Returns: (transfer full): a newly allocated string, which should be freed with g_free().
+ *
+ * Since: 1.20
+ */
+gchar *qmi_message_get_json (QmiMessage        *self,
+                             QmiMessageContext *context);
+
+/**
+ * qmi_message_append_json:
+ * @self: a #QmiMessage.
+ * @context: (allow-none): a #QmiMessageContext, or %NULL.
+ * @json: a #GString where the JSON representation is appended.
+ *
+ * Appends the same JSON representation as qmi_message_get_json() to @json,
+ * without building any intermediate string.
+ *
+ * Since: 1.20
+ */
+void qmi_message_append_json (QmiMessage        *self,
+                              QmiMessageContext *context,
+                              GString           *json);
+
+/**
+ * qmi_message_validate:
+ * @self: a #QmiMessage.
+ * @context: (allow-none): a #QmiMessageContext, or %NULL.
+ * @error: Return location for error or %NULL.
+ *
+ * Checks whether the message is one of the known messages of its service and,
+ * for responses and indications, whether its TLVs can be parsed into the
+ * corresponding output, the same way as when received by a #QmiClient.
+ *
+ * This is useful to check messages of unknown origin before processing them,
+ * e.g. in a proxy.
+ *
+ * Returns: %TRUE if the message is valid, %FALSE if @error is set.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_message_validate (QmiMessage         *self,
+                               QmiMessageContext  *context,
+                               GError            **error);
+
 /**
  * qmi_message_get_tlv_printable:
  * @self: a #QmiMessage.
@@ -1069,6 +1484,107 @@ gchar *qmi_message_get_tlv_printable (QmiMessage   *self,
                                       const guint8 *raw,
                                       gsize         raw_length);
 
+#if defined (LIBQMI_GLIB_COMPILATION)
+
+/* Compact descriptions of the contents of TLVs, used to build their printable
+ * representations with one single interpreter instead of with per-TLV code.
+ * Only printables are table-driven: TLV parsers and builders are always
+ * generated as per-TLV code, as they fill or read the public output structs. */
+
+typedef enum {
+    QMI_TLV_FIELD_TYPE_UINT,
+    QMI_TLV_FIELD_TYPE_INT,
+    QMI_TLV_FIELD_TYPE_FLOAT,
+    QMI_TLV_FIELD_TYPE_BOOLEAN,
+    QMI_TLV_FIELD_TYPE_ENUM,
+    QMI_TLV_FIELD_TYPE_FLAGS,
+    QMI_TLV_FIELD_TYPE_FLAGS64,
+    QMI_TLV_FIELD_TYPE_STRING,
+    QMI_TLV_FIELD_TYPE_FIXED_SIZE_STRING,
+    QMI_TLV_FIELD_TYPE_ARRAY,
+    QMI_TLV_FIELD_TYPE_STRUCT,
+    QMI_TLV_FIELD_TYPE_RESULT,
+} QmiTlvFieldType;
+
+typedef enum {
+    QMI_TLV_FIELD_FLAG_NONE     = 0,
+    QMI_TLV_FIELD_FLAG_SIGNED   = 1 << 0, /* Integer read as signed */
+    QMI_TLV_FIELD_FLAG_SEQUENCE = 1 << 1, /* Array with a sequence prefix */
+} QmiTlvFieldFlag;
+
+/* Nicks of enum or flags values, for fields described at runtime without a
+ * string builder to call */
+typedef struct {
+    gint64       value;
+    const gchar *nick;
+} QmiTlvFieldValue;
+
+typedef struct {
+    guint                   n_values;
+    const QmiTlvFieldValue *values;   /* In declaration order */
+} QmiTlvFieldValues;
+
+typedef struct _QmiTlvField QmiTlvField;
+struct _QmiTlvField {
+    guint8                   type;      /* QmiTlvFieldType */
+    guint8                   flags;     /* QmiTlvFieldFlag */
+    guint8                   size;      /* Integer size, or string/array size prefix size (0 if fixed), in bytes */
+    guint8                   endian;    /* QmiEndian of the integer */
+    guint16                  length;    /* Maximum or fixed string size, or fixed number of array items */
+    guint16                  n_members; /* Number of struct members, or of array sequence and element */
+    const gchar             *name;      /* Name of the struct member */
+    GCallback                to_string; /* Enum or flags string builder */
+    const QmiTlvField       *members;   /* Struct members, or array sequence (if any) and element */
+    const QmiTlvFieldValues *values;    /* Enum or flags nicks, if no string builder given */
+};
+
+typedef struct {
+    guint8             type;
+    const gchar       *name;
+    const QmiTlvField *field;
+} QmiTlvDescriptor;
+
+G_GNUC_INTERNAL
+void __qmi_message_append_tlvs_printable (QmiMessage             *self,
+                                          const gchar            *line_prefix,
+                                          const QmiTlvDescriptor *tlvs,
+                                          guint                   n_tlvs,
+                                          GString                *printable);
+
+/* Appends the QMUX and QMI headers of the message */
+G_GNUC_INTERNAL
+void __qmi_message_append_printable_header (QmiMessage  *self,
+                                            const gchar *line_prefix,
+                                            GString     *printable);
+
+/* Appends the printable representation of a known TLV up to its translated
+ * value, which is left to the caller */
+G_GNUC_INTERNAL
+void __qmi_message_append_tlv_printable_header (const gchar  *line_prefix,
+                                                guint8        type,
+                                                const gchar  *tlv_type_str,
+                                                const guint8 *raw,
+                                                gsize         raw_length,
+                                                GString      *printable);
+
+/* Appends the translated contents of a known TLV */
+typedef void (* QmiMessageTlvPrintableFn) (QmiMessage *self,
+                                           GString    *printable);
+
+/* Appends the printable representation of a TLV; if @tlv_type_str is given
+ * the TLV is known and its contents are translated with @tlv_printable */
+G_GNUC_INTERNAL
+void __qmi_message_append_tlv_printable (QmiMessage               *self,
+                                         const gchar              *line_prefix,
+                                         guint8                    type,
+                                         const gchar              *tlv_type_str,
+                                         const guint8             *raw,
+                                         gsize                     raw_length,
+                                         QmiMessageTlvPrintableFn  tlv_printable,
+                                         GString                  *printable);
+
+#endif
+
 G_END_DECLS
 
 #endif /* _LIBQMI_GLIB_QMI_MESSAGE_H_ */
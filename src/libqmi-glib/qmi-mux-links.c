@@ -0,0 +1,275 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <gio/gio.h>
+
+#include "qmi-mux-links.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+static void
+mux_link_clear (QmiDeviceMuxLink *link)
+{
+    g_free (link->ifname);
+}
+
+static gint
+mux_link_cmp (const QmiDeviceMuxLink *a,
+              const QmiDeviceMuxLink *b)
+{
+    return (gint) a->mux_id - (gint) b->mux_id;
+}
+
+static gboolean
+mux_link_validate (const gchar *sysfs_net_path,
+                   const gchar *wwan_iface,
+                   const gchar *ifname,
+                   guint8       mux_id)
+{
+    gchar    *sysfs_path;
+    gchar    *contents = NULL;
+    gboolean  valid = FALSE;
+
+    /* Must still be a link of the WWAN iface... */
+    sysfs_path = g_strdup_printf ("%s/%s/upper_%s", sysfs_net_path, wwan_iface, ifname);
+    if (!g_file_test (sysfs_path, G_FILE_TEST_EXISTS))
+        goto out;
+    g_free (sysfs_path);
+
+    /* ...and with the same mux ID, given in hex */
+    sysfs_path = g_strdup_printf ("%s/%s/qmap/mux_id", sysfs_net_path, ifname);
+    if (g_file_get_contents (sysfs_path, &contents, NULL, NULL))
+        valid = (g_ascii_strtoull (contents, NULL, 0) == mux_id);
+
+out:
+    g_free (contents);
+    g_free (sysfs_path);
+    return valid;
+}
+
+static gchar *
+mux_links_find (GArray *links,
+                guint8  mux_id)
+{
+    guint i;
+
+    for (i = 0; i < links->len; i++) {
+        QmiDeviceMuxLink *link;
+
+        link = &g_array_index (links, QmiDeviceMuxLink, i);
+        if (link->mux_id == mux_id)
+            return g_strdup (link->ifname);
+    }
+    return NULL;
+}
+
+static gboolean
+mux_link_write (const gchar  *sysfs_net_path,
+                const gchar  *path_display,
+                const gchar  *wwan_iface,
+                const gchar  *attribute,
+                guint8        mux_id,
+                GError      **error)
+{
+    gchar    *sysfs_path;
+    gchar     value[5];
+    gint      fd;
+    gboolean  status = FALSE;
+
+    sysfs_path = g_strdup_printf ("%s/%s/qmi/%s", sysfs_net_path, wwan_iface, attribute);
+    g_debug ("[%s] Writing mux ID %u to: %s", path_display, mux_id, sysfs_path);
+
+    /* Unbuffered, so that the errors reported by the driver are not lost */
+    g_snprintf (value, sizeof (value), "%u", mux_id);
+    fd = open (sysfs_path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        gint errsv = errno;
+
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     "Failed to open file '%s': %s",
+                     sysfs_path, g_strerror (errsv));
+        goto out;
+    }
+
+    if (write (fd, value, strlen (value)) < 0) {
+        gint errsv = errno;
+
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     "Failed to write to file '%s': %s",
+                     sysfs_path, g_strerror (errsv));
+        goto out;
+    }
+
+    status = TRUE;
+
+out:
+    if (fd >= 0)
+        close (fd);
+    g_free (sysfs_path);
+    return status;
+}
+
+GArray *
+__qmi_mux_links_list (const gchar  *sysfs_net_path,
+                      const gchar  *path_display,
+                      const gchar  *wwan_iface,
+                      GError      **error)
+{
+    GArray      *links;
+    GDir        *dir;
+    gchar       *sysfs_path;
+    const gchar *name;
+
+    sysfs_path = g_strdup_printf ("%s/%s", sysfs_net_path, wwan_iface);
+    dir = g_dir_open (sysfs_path, 0, error);
+    g_free (sysfs_path);
+    if (!dir) {
+        g_prefix_error (error, "Couldn't list links: ");
+        return NULL;
+    }
+
+    links = g_array_new (FALSE, FALSE, sizeof (QmiDeviceMuxLink));
+    g_array_set_clear_func (links, (GDestroyNotify)mux_link_clear);
+
+    while ((name = g_dir_read_name (dir))) {
+        QmiDeviceMuxLink  link;
+        gchar            *contents = NULL;
+        guint64           mux_id;
+
+        if (!g_str_has_prefix (name, "upper_"))
+            continue;
+        name += strlen ("upper_");
+
+        /* Other kind of upper devices (e.g. bridges) don't have a mux ID */
+        sysfs_path = g_strdup_printf ("%s/%s/qmap/mux_id", sysfs_net_path, name);
+        if (!g_file_get_contents (sysfs_path, &contents, NULL, NULL)) {
+            g_free (sysfs_path);
+            continue;
+        }
+        mux_id = g_ascii_strtoull (contents, NULL, 0);
+        g_free (contents);
+        g_free (sysfs_path);
+
+        if (!mux_id || mux_id > G_MAXUINT8)
+            continue;
+
+        link.mux_id = (guint8) mux_id;
+        link.ifname = g_strdup (name);
+        g_array_append_val (links, link);
+        g_debug ("[%s] found link %s with mux ID %u", path_display, link.ifname, link.mux_id);
+    }
+    g_dir_close (dir);
+
+    g_array_sort (links, (GCompareFunc)mux_link_cmp);
+    return links;
+}
+
+gchar *
+__qmi_mux_link_add (const gchar  *sysfs_net_path,
+                    const gchar  *path_display,
+                    const gchar  *wwan_iface,
+                    guint8        mux_id,
+                    const gchar  *cached_ifname,
+                    GArray      **links,
+                    GError      **error)
+{
+    GArray *found;
+    gchar  *ifname;
+
+    if (links)
+        *links = NULL;
+
+    /* A link known from before needs no lookup */
+    if (cached_ifname && mux_link_validate (sysfs_net_path, wwan_iface, cached_ifname, mux_id))
+        return g_strdup (cached_ifname);
+
+    found = __qmi_mux_links_list (sysfs_net_path, path_display, wwan_iface, error);
+    if (!found)
+        return NULL;
+
+    ifname = mux_links_find (found, mux_id);
+    if (!ifname) {
+        /* The driver names the new link itself, so look for it afterwards */
+        if (!mux_link_write (sysfs_net_path, path_display, wwan_iface, "add_mux", mux_id, error)) {
+            g_prefix_error (error, "Link not created: ");
+            g_array_unref (found);
+            return NULL;
+        }
+        g_array_unref (found);
+        found = __qmi_mux_links_list (sysfs_net_path, path_display, wwan_iface, error);
+        if (!found)
+            return NULL;
+        ifname = mux_links_find (found, mux_id);
+        if (!ifname) {
+            g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
+                         "Link with mux ID %u not found after creating it", mux_id);
+            g_array_unref (found);
+            return NULL;
+        }
+    }
+
+    if (links)
+        *links = found;
+    else
+        g_array_unref (found);
+    return ifname;
+}
+
+gboolean
+__qmi_mux_link_delete (const gchar  *sysfs_net_path,
+                       const gchar  *path_display,
+                       const gchar  *wwan_iface,
+                       guint8        mux_id,
+                       GArray      **links,
+                       GError      **error)
+{
+    GArray *found;
+    gchar  *ifname;
+
+    if (links)
+        *links = NULL;
+
+    found = __qmi_mux_links_list (sysfs_net_path, path_display, wwan_iface, error);
+    if (!found)
+        return FALSE;
+
+    ifname = mux_links_find (found, mux_id);
+    if (ifname && !mux_link_write (sysfs_net_path, path_display, wwan_iface, "del_mux", mux_id, error)) {
+        g_prefix_error (error, "Link not deleted: ");
+        g_free (ifname);
+        g_array_unref (found);
+        return FALSE;
+    }
+    g_free (ifname);
+
+    if (links)
+        *links = found;
+    else
+        g_array_unref (found);
+    return TRUE;
+}
@@ -0,0 +1,81 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_MUX_LINKS_H_
+#define _LIBQMI_GLIB_QMI_MUX_LINKS_H_
+
+#if !defined (LIBQMI_GLIB_COMPILATION)
+#error "This is a private header."
+#endif
+
+#include <glib.h>
+
+#include "qmi-device.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Multiplexed links of qmi_wwan, managed through the add_mux and del_mux
+ * sysfs attributes of the WWAN iface. Each link is an upper device of the
+ * WWAN iface, with its QMAP mux ID given in sysfs.
+ *
+ * All these operations block, and are meant to be run in a worker thread.
+ * @sysfs_net_path is the directory with the network interfaces, usually
+ * QMI_MUX_LINKS_SYSFS_NET_PATH. @links, when given, is set to the list of
+ * links found while running the operation, or to %NULL if none was needed.
+ * Links are always sorted by mux ID, in arrays of #QmiDeviceMuxLink.
+ */
+
+#define QMI_MUX_LINKS_SYSFS_NET_PATH "/sys/class/net"
+
+G_GNUC_INTERNAL
+GArray   *__qmi_mux_links_list  (const gchar  *sysfs_net_path,
+                                 const gchar  *path_display,
+                                 const gchar  *wwan_iface,
+                                 GError      **error);
+
+/* Reuses @cached_ifname if still a link with @mux_id, otherwise looks up
+ * the links and only creates a new one if there is none with @mux_id.
+ * Returns the name of the link. */
+G_GNUC_INTERNAL
+gchar    *__qmi_mux_link_add    (const gchar  *sysfs_net_path,
+                                 const gchar  *path_display,
+                                 const gchar  *wwan_iface,
+                                 guint8        mux_id,
+                                 const gchar  *cached_ifname,
+                                 GArray      **links,
+                                 GError      **error);
+
+/* Not having a link with @mux_id is not an error; @links are the ones found
+ * before deleting it */
+G_GNUC_INTERNAL
+gboolean  __qmi_mux_link_delete (const gchar  *sysfs_net_path,
+                                 const gchar  *path_display,
+                                 const gchar  *wwan_iface,
+                                 guint8        mux_id,
+                                 GArray      **links,
+                                 GError      **error);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_MUX_LINKS_H_ */
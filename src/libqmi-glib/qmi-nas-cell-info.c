@@ -0,0 +1,578 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "qmi-nas-cell-info.h"
+
+/* NAS Get Cell Location Info response TLVs with neighbor cells */
+#define CELL_LOCATION_INFO_TLV_GERAN_INFO               0x10
+#define CELL_LOCATION_INFO_TLV_UMTS_INFO                0x11
+#define CELL_LOCATION_INFO_TLV_INTRAFREQUENCY_LTE_INFO  0x13
+#define CELL_LOCATION_INFO_TLV_INTERFREQUENCY_LTE_INFO  0x14
+#define CELL_LOCATION_INFO_TLV_LTE_INFO_NEIGHBORING_GSM 0x15
+#define CELL_LOCATION_INFO_TLV_LTE_INFO_NEIGHBORING_WCDMA 0x16
+#define CELL_LOCATION_INFO_TLV_UMTS_INFO_NEIGHBORING_LTE 0x18
+
+typedef enum {
+    CELLS_GERAN,
+    CELLS_UMTS,
+    CELLS_UMTS_GERAN,
+    CELLS_LTE_INTRAFREQUENCY,
+    CELLS_LTE_INTERFREQUENCY,
+    CELLS_LTE_GSM,
+    CELLS_LTE_WCDMA,
+    CELLS_UMTS_LTE,
+    CELLS_LAST
+} CellsType;
+
+static const gsize cell_sizes[CELLS_LAST] = {
+    [CELLS_GERAN]              = sizeof (QmiNasCellInfoGeranCell),
+    [CELLS_UMTS]               = sizeof (QmiNasCellInfoUmtsCell),
+    [CELLS_UMTS_GERAN]         = sizeof (QmiNasCellInfoUmtsGeranCell),
+    [CELLS_LTE_INTRAFREQUENCY] = sizeof (QmiNasCellInfoLteCell),
+    [CELLS_LTE_INTERFREQUENCY] = sizeof (QmiNasCellInfoLteCell),
+    [CELLS_LTE_GSM]            = sizeof (QmiNasCellInfoLteGsmCell),
+    [CELLS_LTE_WCDMA]          = sizeof (QmiNasCellInfoLteWcdmaCell),
+    [CELLS_UMTS_LTE]           = sizeof (QmiNasCellInfoUmtsLteCell),
+};
+
+/* The cell arrays are allocated along with the struct itself */
+struct _QmiNasCellInfo {
+    volatile gint ref_count;
+    gpointer      cells[CELLS_LAST];
+    guint         n_cells[CELLS_LAST];
+};
+
+#define CELL_INFO_ALIGN(size) (((size) + 7) & ~((gsize) 7))
+
+/*****************************************************************************/
+/* Reading TLVs in place */
+
+typedef struct {
+    const guint8 *data;
+    gsize         left;
+    gboolean      failed;
+} Reader;
+
+static const guint8 *
+reader_take (Reader *reader,
+             gsize   len)
+{
+    const guint8 *data;
+
+    if (reader->failed || reader->left < len) {
+        reader->failed = TRUE;
+        return NULL;
+    }
+    data = reader->data;
+    reader->data += len;
+    reader->left -= len;
+    return data;
+}
+
+static guint8
+reader_guint8 (Reader *reader)
+{
+    const guint8 *data;
+
+    data = reader_take (reader, 1);
+    return (data ? data[0] : 0);
+}
+
+static guint16
+reader_guint16 (Reader *reader)
+{
+    const guint8 *data;
+
+    data = reader_take (reader, 2);
+    return (data ? (guint16) (data[0] | (data[1] << 8)) : 0);
+}
+
+static guint32
+reader_guint32 (Reader *reader)
+{
+    const guint8 *data;
+
+    data = reader_take (reader, 4);
+    return (data ? ((guint32) data[0] | ((guint32) data[1] << 8) | ((guint32) data[2] << 16) | ((guint32) data[3] << 24)) : 0);
+}
+
+/* Same as qmi_message_tlv_read_gfloat() */
+static gfloat
+reader_gfloat (Reader *reader)
+{
+    const guint8 *data;
+    gfloat        value = 0;
+
+    data = reader_take (reader, 4);
+    if (data)
+        memcpy (&value, data, 4);
+    return value;
+}
+
+/*****************************************************************************/
+/* Parsers, run once to count the cells and once to fill them in */
+
+/* Returns the next slot of the given type, or NULL when counting */
+static gpointer
+next_cell (QmiNasCellInfo *self,
+           CellsType       type)
+{
+    guint i;
+
+    i = self->n_cells[type]++;
+    return (self->cells[type] ? ((guint8 *) self->cells[type]) + (i * cell_sizes[type]) : NULL);
+}
+
+static void
+parse_geran_info (QmiNasCellInfo *self,
+                  Reader         *reader)
+{
+    guint n;
+    guint i;
+
+    /* Serving cell */
+    reader_take (reader, 18);
+
+    n = reader_guint8 (reader);
+    for (i = 0; i < n && !reader->failed; i++) {
+        QmiNasCellInfoGeranCell *cell;
+        const guint8            *plmn;
+
+        cell = next_cell (self, CELLS_GERAN);
+        if (!cell) {
+            reader_take (reader, 14);
+            continue;
+        }
+        cell->cell_id = reader_guint32 (reader);
+        plmn = reader_take (reader, 3);
+        memcpy (cell->plmn, plmn, 3);
+        cell->plmn[3] = '\0';
+        cell->lac = reader_guint16 (reader);
+        cell->arfcn = reader_guint16 (reader);
+        cell->bsic = reader_guint8 (reader);
+        cell->rx_level = reader_guint16 (reader);
+    }
+}
+
+static void
+parse_umts_info (QmiNasCellInfo *self,
+                 Reader         *reader)
+{
+    guint n;
+    guint i;
+
+    /* Serving cell */
+    reader_take (reader, 15);
+
+    n = reader_guint8 (reader);
+    for (i = 0; i < n && !reader->failed; i++) {
+        QmiNasCellInfoUmtsCell *cell;
+
+        cell = next_cell (self, CELLS_UMTS);
+        if (!cell) {
+            reader_take (reader, 8);
+            continue;
+        }
+        cell->uarfcn = reader_guint16 (reader);
+        cell->psc = reader_guint16 (reader);
+        cell->rscp = (gint16) reader_guint16 (reader);
+        cell->ecio = (gint16) reader_guint16 (reader);
+    }
+
+    n = reader_guint8 (reader);
+    for (i = 0; i < n && !reader->failed; i++) {
+        QmiNasCellInfoUmtsGeranCell *cell;
+
+        cell = next_cell (self, CELLS_UMTS_GERAN);
+        if (!cell) {
+            reader_take (reader, 6);
+            continue;
+        }
+        cell->arfcn = reader_guint16 (reader);
+        cell->ncc = reader_guint8 (reader);
+        cell->bcc = reader_guint8 (reader);
+        cell->rssi = (gint16) reader_guint16 (reader);
+    }
+}
+
+static void
+parse_lte_cells (QmiNasCellInfo *self,
+                 Reader         *reader,
+                 CellsType       type,
+                 guint16         earfcn)
+{
+    guint n;
+    guint i;
+
+    n = reader_guint8 (reader);
+    for (i = 0; i < n && !reader->failed; i++) {
+        QmiNasCellInfoLteCell *cell;
+
+        cell = next_cell (self, type);
+        if (!cell) {
+            reader_take (reader, 10);
+            continue;
+        }
+        cell->earfcn = earfcn;
+        cell->pci = reader_guint16 (reader);
+        cell->rsrq = (gint16) reader_guint16 (reader);
+        cell->rsrp = (gint16) reader_guint16 (reader);
+        cell->rssi = (gint16) reader_guint16 (reader);
+        cell->rx_level = (gint16) reader_guint16 (reader);
+    }
+}
+
+static void
+parse_intrafrequency_lte_info (QmiNasCellInfo *self,
+                               Reader         *reader)
+{
+    guint16 earfcn;
+
+    /* UE in idle, PLMN, TAC and global cell ID */
+    reader_take (reader, 10);
+    earfcn = reader_guint16 (reader);
+    /* Serving cell ID, cell reselection priority and thresholds */
+    reader_take (reader, 6);
+
+    parse_lte_cells (self, reader, CELLS_LTE_INTRAFREQUENCY, earfcn);
+}
+
+static void
+parse_interfrequency_lte_info (QmiNasCellInfo *self,
+                               Reader         *reader)
+{
+    guint n;
+    guint i;
+
+    /* UE in idle */
+    reader_take (reader, 1);
+
+    n = reader_guint8 (reader);
+    for (i = 0; i < n && !reader->failed; i++) {
+        guint16 earfcn;
+
+        earfcn = reader_guint16 (reader);
+        /* Thresholds and cell reselection priority */
+        reader_take (reader, 3);
+        parse_lte_cells (self, reader, CELLS_LTE_INTERFREQUENCY, earfcn);
+    }
+}
+
+static void
+parse_lte_info_neighboring_gsm (QmiNasCellInfo *self,
+                                Reader         *reader)
+{
+    guint n_frequencies;
+    guint i;
+
+    /* UE in idle */
+    reader_take (reader, 1);
+
+    n_frequencies = reader_guint8 (reader);
+    for (i = 0; i < n_frequencies && !reader->failed; i++) {
+        guint n;
+        guint j;
+
+        /* Cell reselection priority, thresholds and NCC permitted */
+        reader_take (reader, 4);
+
+        n = reader_guint8 (reader);
+        for (j = 0; j < n && !reader->failed; j++) {
+            QmiNasCellInfoLteGsmCell *cell;
+
+            cell = next_cell (self, CELLS_LTE_GSM);
+            if (!cell) {
+                reader_take (reader, 9);
+                continue;
+            }
+            cell->arfcn = reader_guint16 (reader);
+            cell->band_is_1900 = !!reader_guint8 (reader);
+            cell->cell_id_valid = !!reader_guint8 (reader);
+            cell->bsic = reader_guint8 (reader);
+            cell->rssi = (gint16) reader_guint16 (reader);
+            cell->rx_level = (gint16) reader_guint16 (reader);
+        }
+    }
+}
+
+static void
+parse_lte_info_neighboring_wcdma (QmiNasCellInfo *self,
+                                  Reader         *reader)
+{
+    guint n_frequencies;
+    guint i;
+
+    /* UE in idle */
+    reader_take (reader, 1);
+
+    n_frequencies = reader_guint8 (reader);
+    for (i = 0; i < n_frequencies && !reader->failed; i++) {
+        guint16 uarfcn;
+        guint   n;
+        guint   j;
+
+        uarfcn = reader_guint16 (reader);
+        /* Cell reselection priority and thresholds */
+        reader_take (reader, 5);
+
+        n = reader_guint8 (reader);
+        for (j = 0; j < n && !reader->failed; j++) {
+            QmiNasCellInfoLteWcdmaCell *cell;
+
+            cell = next_cell (self, CELLS_LTE_WCDMA);
+            if (!cell) {
+                reader_take (reader, 8);
+                continue;
+            }
+            cell->uarfcn = uarfcn;
+            cell->psc = reader_guint16 (reader);
+            cell->rscp = (gint16) reader_guint16 (reader);
+            cell->ecno = (gint16) reader_guint16 (reader);
+            cell->rx_level = (gint16) reader_guint16 (reader);
+        }
+    }
+}
+
+static void
+parse_umts_info_neighboring_lte (QmiNasCellInfo *self,
+                                 Reader         *reader)
+{
+    guint n;
+    guint i;
+
+    /* RRC state */
+    reader_take (reader, 4);
+
+    n = reader_guint8 (reader);
+    for (i = 0; i < n && !reader->failed; i++) {
+        QmiNasCellInfoUmtsLteCell *cell;
+
+        cell = next_cell (self, CELLS_UMTS_LTE);
+        if (!cell) {
+            reader_take (reader, 15);
+            continue;
+        }
+        cell->earfcn = reader_guint16 (reader);
+        cell->pci = reader_guint16 (reader);
+        cell->rsrp = reader_gfloat (reader);
+        cell->rsrq = reader_gfloat (reader);
+        cell->rx_level = (gint16) reader_guint16 (reader);
+        cell->is_tdd = !!reader_guint8 (reader);
+    }
+}
+
+typedef void (* ParseFunc) (QmiNasCellInfo *self,
+                            Reader         *reader);
+
+static const struct {
+    guint8    type;
+    ParseFunc parse;
+} parsers[] = {
+    { CELL_LOCATION_INFO_TLV_GERAN_INFO,                parse_geran_info                 },
+    { CELL_LOCATION_INFO_TLV_UMTS_INFO,                 parse_umts_info                  },
+    { CELL_LOCATION_INFO_TLV_INTRAFREQUENCY_LTE_INFO,   parse_intrafrequency_lte_info    },
+    { CELL_LOCATION_INFO_TLV_INTERFREQUENCY_LTE_INFO,   parse_interfrequency_lte_info    },
+    { CELL_LOCATION_INFO_TLV_LTE_INFO_NEIGHBORING_GSM,  parse_lte_info_neighboring_gsm   },
+    { CELL_LOCATION_INFO_TLV_LTE_INFO_NEIGHBORING_WCDMA, parse_lte_info_neighboring_wcdma },
+    { CELL_LOCATION_INFO_TLV_UMTS_INFO_NEIGHBORING_LTE, parse_umts_info_neighboring_lte  },
+};
+
+/*****************************************************************************/
+
+GType
+qmi_nas_cell_info_get_type (void)
+{
+    static volatile gsize g_define_type_id__volatile = 0;
+
+    if (g_once_init_enter (&g_define_type_id__volatile)) {
+        GType g_define_type_id =
+            g_boxed_type_register_static (g_intern_static_string ("QmiNasCellInfo"),
+                                          (GBoxedCopyFunc) qmi_nas_cell_info_ref,
+                                          (GBoxedFreeFunc) qmi_nas_cell_info_unref);
+
+        g_once_init_leave (&g_define_type_id__volatile, g_define_type_id);
+    }
+
+    return g_define_type_id__volatile;
+}
+
+QmiNasCellInfo *
+qmi_nas_cell_info_new (QmiMessageNasGetCellLocationInfoOutput  *output,
+                       GError                                 **error)
+{
+    QmiNasCellInfo  counts = { 0 };
+    QmiNasCellInfo *self;
+    QmiMessage     *message;
+    const guint8   *raw[G_N_ELEMENTS (parsers)];
+    guint16         raw_length[G_N_ELEMENTS (parsers)];
+    gsize           size;
+    guint8         *data;
+    guint           i;
+
+    g_return_val_if_fail (output != NULL, NULL);
+
+    if (!qmi_message_nas_get_cell_location_info_output_get_result (output, error))
+        return NULL;
+
+    message = __qmi_message_nas_get_cell_location_info_output_peek_message (output);
+
+    /* First pass, counting and validating */
+    for (i = 0; i < G_N_ELEMENTS (parsers); i++) {
+        QmiNasCellInfo previous;
+        Reader         reader = { NULL, 0, FALSE };
+
+        raw[i] = qmi_message_get_raw_tlv (message, parsers[i].type, &raw_length[i]);
+        if (!raw[i])
+            continue;
+
+        previous = counts;
+        reader.data = raw[i];
+        reader.left = raw_length[i];
+        parsers[i].parse (&counts, &reader);
+        if (reader.failed) {
+            g_debug ("ignoring invalid cell location info TLV 0x%02x", parsers[i].type);
+            counts = previous;
+            raw[i] = NULL;
+        }
+    }
+
+    /* One single allocation for all the cells */
+    size = CELL_INFO_ALIGN (sizeof (QmiNasCellInfo));
+    for (i = 0; i < CELLS_LAST; i++)
+        size += CELL_INFO_ALIGN (counts.n_cells[i] * cell_sizes[i]);
+
+    data = g_malloc0 (size);
+    self = (QmiNasCellInfo *) data;
+    self->ref_count = 1;
+    data += CELL_INFO_ALIGN (sizeof (QmiNasCellInfo));
+    for (i = 0; i < CELLS_LAST; i++) {
+        if (counts.n_cells[i] == 0)
+            continue;
+        self->cells[i] = data;
+        data += CELL_INFO_ALIGN (counts.n_cells[i] * cell_sizes[i]);
+    }
+
+    /* Second pass, filling in; TLVs already validated */
+    for (i = 0; i < G_N_ELEMENTS (parsers); i++) {
+        Reader reader = { NULL, 0, FALSE };
+
+        if (!raw[i])
+            continue;
+
+        reader.data = raw[i];
+        reader.left = raw_length[i];
+        parsers[i].parse (self, &reader);
+        g_assert (!reader.failed);
+    }
+
+    return self;
+}
+
+QmiNasCellInfo *
+qmi_nas_cell_info_ref (QmiNasCellInfo *self)
+{
+    g_return_val_if_fail (self != NULL, NULL);
+
+    g_atomic_int_inc (&self->ref_count);
+    return self;
+}
+
+void
+qmi_nas_cell_info_unref (QmiNasCellInfo *self)
+{
+    g_return_if_fail (self != NULL);
+
+    if (g_atomic_int_dec_and_test (&self->ref_count))
+        g_free (self);
+}
+
+static gconstpointer
+get_cells (QmiNasCellInfo *self,
+           CellsType       type,
+           guint          *n_cells)
+{
+    g_return_val_if_fail (self != NULL, NULL);
+
+    if (n_cells)
+        *n_cells = self->n_cells[type];
+    return self->cells[type];
+}
+
+const QmiNasCellInfoGeranCell *
+qmi_nas_cell_info_get_geran_cells (QmiNasCellInfo *self,
+                                   guint          *n_cells)
+{
+    return get_cells (self, CELLS_GERAN, n_cells);
+}
+
+const QmiNasCellInfoUmtsCell *
+qmi_nas_cell_info_get_umts_cells (QmiNasCellInfo *self,
+                                  guint          *n_cells)
+{
+    return get_cells (self, CELLS_UMTS, n_cells);
+}
+
+const QmiNasCellInfoUmtsGeranCell *
+qmi_nas_cell_info_get_umts_geran_cells (QmiNasCellInfo *self,
+                                        guint          *n_cells)
+{
+    return get_cells (self, CELLS_UMTS_GERAN, n_cells);
+}
+
+const QmiNasCellInfoLteCell *
+qmi_nas_cell_info_get_lte_intrafrequency_cells (QmiNasCellInfo *self,
+                                                guint          *n_cells)
+{
+    return get_cells (self, CELLS_LTE_INTRAFREQUENCY, n_cells);
+}
+
+const QmiNasCellInfoLteCell *
+qmi_nas_cell_info_get_lte_interfrequency_cells (QmiNasCellInfo *self,
+                                                guint          *n_cells)
+{
+    return get_cells (self, CELLS_LTE_INTERFREQUENCY, n_cells);
+}
+
+const QmiNasCellInfoLteGsmCell *
+qmi_nas_cell_info_get_lte_gsm_cells (QmiNasCellInfo *self,
+                                     guint          *n_cells)
+{
+    return get_cells (self, CELLS_LTE_GSM, n_cells);
+}
+
+const QmiNasCellInfoLteWcdmaCell *
+qmi_nas_cell_info_get_lte_wcdma_cells (QmiNasCellInfo *self,
+                                       guint          *n_cells)
+{
+    return get_cells (self, CELLS_LTE_WCDMA, n_cells);
+}
+
+const QmiNasCellInfoUmtsLteCell *
+qmi_nas_cell_info_get_umts_lte_cells (QmiNasCellInfo *self,
+                                      guint          *n_cells)
+{
+    return get_cells (self, CELLS_UMTS_LTE, n_cells);
+}
@@ -0,0 +1,370 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_NAS_CELL_INFO_H_
+#define _LIBQMI_GLIB_QMI_NAS_CELL_INFO_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+
+#include "qmi-nas.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-nas-cell-info
+ * @title: QmiNasCellInfo
+ * @short_description: compact copy of the neighbor cells in a NAS Get Cell Location Info response
+ *
+ * A #QmiNasCellInfo holds all the neighbor cells reported in a NAS Get Cell
+ * Location Info response, decoded directly from the message into one single
+ * allocation, with one contiguous array per kind of neighbor cell.
+ *
+ * Cells reported per frequency are flattened, each cell including the
+ * channel number of its frequency. The information about the serving cell
+ * and the frequencies is still available with the
+ * #QmiMessageNasGetCellLocationInfoOutput getters.
+ */
+
+/**
+ * QmiNasCellInfoGeranCell:
+ * @cell_id: the cell ID.
+ * @plmn: the NUL-terminated PLMN, as given in the response.
+ * @lac: the location area code.
+ * @arfcn: the GERAN absolute RF channel number.
+ * @bsic: the base station identity code.
+ * @rx_level: the RX level.
+ *
+ * A GERAN neighbor cell, from the 'GERAN Info' TLV.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    guint32 cell_id;
+    gchar   plmn[4];
+    guint16 lac;
+    guint16 arfcn;
+    guint8  bsic;
+    guint16 rx_level;
+} QmiNasCellInfoGeranCell;
+
+/**
+ * QmiNasCellInfoUmtsCell:
+ * @uarfcn: the UTRA absolute RF channel number.
+ * @psc: the primary scrambling code.
+ * @rscp: the RSCP.
+ * @ecio: the ECIO.
+ *
+ * A UMTS neighbor cell, from the 'UMTS Info' TLV.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    guint16 uarfcn;
+    guint16 psc;
+    gint16  rscp;
+    gint16  ecio;
+} QmiNasCellInfoUmtsCell;
+
+/**
+ * QmiNasCellInfoUmtsGeranCell:
+ * @arfcn: the GERAN absolute RF channel number.
+ * @ncc: the network color code.
+ * @bcc: the base station color code.
+ * @rssi: the RSSI.
+ *
+ * A GERAN cell neighboring the UMTS serving cell, from the 'UMTS Info' TLV.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    guint16 arfcn;
+    guint8  ncc;
+    guint8  bcc;
+    gint16  rssi;
+} QmiNasCellInfoUmtsGeranCell;
+
+/**
+ * QmiNasCellInfoLteCell:
+ * @earfcn: the EUTRA absolute RF channel number.
+ * @pci: the physical cell ID.
+ * @rsrq: the RSRQ.
+ * @rsrp: the RSRP.
+ * @rssi: the RSSI.
+ * @rx_level: the cell selection RX level.
+ *
+ * A LTE neighbor cell, from the 'Intrafrequency LTE Info' or the
+ * 'Interfrequency LTE Info' TLVs. For intrafrequency cells, @earfcn is the one
+ * of the serving cell.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    guint16 earfcn;
+    guint16 pci;
+    gint16  rsrq;
+    gint16  rsrp;
+    gint16  rssi;
+    gint16  rx_level;
+} QmiNasCellInfoLteCell;
+
+/**
+ * QmiNasCellInfoLteGsmCell:
+ * @arfcn: the GERAN absolute RF channel number.
+ * @band_is_1900: whether the cell is in the 1900 band.
+ * @cell_id_valid: whether the cell ID is valid.
+ * @bsic: the base station identity code.
+ * @rssi: the RSSI.
+ * @rx_level: the cell selection RX level.
+ *
+ * A GSM cell neighboring the LTE serving cell, from the
+ * 'LTE Info Neighboring GSM' TLV.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    guint16  arfcn;
+    gboolean band_is_1900;
+    gboolean cell_id_valid;
+    guint8   bsic;
+    gint16   rssi;
+    gint16   rx_level;
+} QmiNasCellInfoLteGsmCell;
+
+/**
+ * QmiNasCellInfoLteWcdmaCell:
+ * @uarfcn: the UTRA absolute RF channel number.
+ * @psc: the primary scrambling code.
+ * @rscp: the CPICH RSCP.
+ * @ecno: the CPICH EcNo.
+ * @rx_level: the cell selection RX level.
+ *
+ * A WCDMA cell neighboring the LTE serving cell, from the
+ * 'LTE Info Neighboring WCDMA' TLV.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    guint16 uarfcn;
+    guint16 psc;
+    gint16  rscp;
+    gint16  ecno;
+    gint16  rx_level;
+} QmiNasCellInfoLteWcdmaCell;
+
+/**
+ * QmiNasCellInfoUmtsLteCell:
+ * @earfcn: the EUTRA absolute RF channel number.
+ * @pci: the physical cell ID.
+ * @rsrp: the RSRP.
+ * @rsrq: the RSRQ.
+ * @rx_level: the cell selection RX level.
+ * @is_tdd: whether the cell is TDD.
+ *
+ * A LTE cell neighboring the UMTS serving cell, from the
+ * 'UMTS Info Neighboring LTE' TLV.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    guint16  earfcn;
+    guint16  pci;
+    gfloat   rsrp;
+    gfloat   rsrq;
+    gint16   rx_level;
+    gboolean is_tdd;
+} QmiNasCellInfoUmtsLteCell;
+
+/**
+ * QmiNasCellInfo:
+ *
+ * An opaque type holding the neighbor cells of a NAS Get Cell Location Info
+ * response.
+ *
+ * Since: 1.20
+ */
+typedef struct _QmiNasCellInfo QmiNasCellInfo;
+
+GType qmi_nas_cell_info_get_type (void);
+
+/**
+ * qmi_nas_cell_info_new:
+ * @output: a #QmiMessageNasGetCellLocationInfoOutput.
+ * @error: Return location for error or %NULL.
+ *
+ * Decodes all the neighbor cells reported in @output. Nothing refers to
+ * @output once this method returns.
+ *
+ * TLVs which are not valid are ignored, as if not given.
+ *
+ * Returns: (transfer full): a new #QmiNasCellInfo, or %NULL if @error is set. The returned value should be freed with qmi_nas_cell_info_unref().
+ *
+ * Since: 1.20
+ */
+QmiNasCellInfo *qmi_nas_cell_info_new (QmiMessageNasGetCellLocationInfoOutput  *output,
+                                       GError                                 **error);
+
+/**
+ * qmi_nas_cell_info_ref:
+ * @self: a #QmiNasCellInfo.
+ *
+ * Atomically increments the reference count of @self by one.
+ *
+ * Returns: (transfer full) the new reference to @self.
+ *
+ * Since: 1.20
+ */
+QmiNasCellInfo *qmi_nas_cell_info_ref (QmiNasCellInfo *self);
+
+/**
+ * qmi_nas_cell_info_unref:
+ * @self: a #QmiNasCellInfo.
+ *
+ * Atomically decrements the reference count of @self by one.
+ * If the reference count drops to 0, @self is completely disposed.
+ *
+ * Since: 1.20
+ */
+void qmi_nas_cell_info_unref (QmiNasCellInfo *self);
+
+/**
+ * qmi_nas_cell_info_get_geran_cells:
+ * @self: a #QmiNasCellInfo.
+ * @n_cells: (out): return location for the number of cells.
+ *
+ * Gets the GERAN neighbor cells.
+ *
+ * Returns: (transfer none) (array length=n_cells): the cells, owned by @self, or %NULL if none.
+ *
+ * Since: 1.20
+ */
+const QmiNasCellInfoGeranCell *qmi_nas_cell_info_get_geran_cells (QmiNasCellInfo *self,
+                                                                  guint          *n_cells);
+
+/**
+ * qmi_nas_cell_info_get_umts_cells:
+ * @self: a #QmiNasCellInfo.
+ * @n_cells: (out): return location for the number of cells.
+ *
+ * Gets the UMTS neighbor cells.
+ *
+ * Returns: (transfer none) (array length=n_cells): the cells, owned by @self, or %NULL if none.
+ *
+ * Since: 1.20
+ */
+const QmiNasCellInfoUmtsCell *qmi_nas_cell_info_get_umts_cells (QmiNasCellInfo *self,
+                                                                guint          *n_cells);
+
+/**
+ * qmi_nas_cell_info_get_umts_geran_cells:
+ * @self: a #QmiNasCellInfo.
+ * @n_cells: (out): return location for the number of cells.
+ *
+ * Gets the GERAN cells neighboring the UMTS serving cell.
+ *
+ * Returns: (transfer none) (array length=n_cells): the cells, owned by @self, or %NULL if none.
+ *
+ * Since: 1.20
+ */
+const QmiNasCellInfoUmtsGeranCell *qmi_nas_cell_info_get_umts_geran_cells (QmiNasCellInfo *self,
+                                                                           guint          *n_cells);
+
+/**
+ * qmi_nas_cell_info_get_lte_intrafrequency_cells:
+ * @self: a #QmiNasCellInfo.
+ * @n_cells: (out): return location for the number of cells.
+ *
+ * Gets the LTE neighbor cells in the frequency of the serving cell.
+ *
+ * Returns: (transfer none) (array length=n_cells): the cells, owned by @self, or %NULL if none.
+ *
+ * Since: 1.20
+ */
+const QmiNasCellInfoLteCell *qmi_nas_cell_info_get_lte_intrafrequency_cells (QmiNasCellInfo *self,
+                                                                             guint          *n_cells);
+
+/**
+ * qmi_nas_cell_info_get_lte_interfrequency_cells:
+ * @self: a #QmiNasCellInfo.
+ * @n_cells: (out): return location for the number of cells.
+ *
+ * Gets the LTE neighbor cells in frequencies other than the one of the
+ * serving cell, of all the frequencies reported.
+ *
+ * Returns: (transfer none) (array length=n_cells): the cells, owned by @self, or %NULL if none.
+ *
+ * Since: 1.20
+ */
+const QmiNasCellInfoLteCell *qmi_nas_cell_info_get_lte_interfrequency_cells (QmiNasCellInfo *self,
+                                                                             guint          *n_cells);
+
+/**
+ * qmi_nas_cell_info_get_lte_gsm_cells:
+ * @self: a #QmiNasCellInfo.
+ * @n_cells: (out): return location for the number of cells.
+ *
+ * Gets the GSM cells neighboring the LTE serving cell, of all the frequencies
+ * reported.
+ *
+ * Returns: (transfer none) (array length=n_cells): the cells, owned by @self, or %NULL if none.
+ *
+ * Since: 1.20
+ */
+const QmiNasCellInfoLteGsmCell *qmi_nas_cell_info_get_lte_gsm_cells (QmiNasCellInfo *self,
+                                                                     guint          *n_cells);
+
+/**
+ * qmi_nas_cell_info_get_lte_wcdma_cells:
+ * @self: a #QmiNasCellInfo.
+ * @n_cells: (out): return location for the number of cells.
+ *
+ * Gets the WCDMA cells neighboring the LTE serving cell, of all the
+ * frequencies reported.
+ *
+ * Returns: (transfer none) (array length=n_cells): the cells, owned by @self, or %NULL if none.
+ *
+ * Since: 1.20
+ */
+const QmiNasCellInfoLteWcdmaCell *qmi_nas_cell_info_get_lte_wcdma_cells (QmiNasCellInfo *self,
+                                                                         guint          *n_cells);
+
+/**
+ * qmi_nas_cell_info_get_umts_lte_cells:
+ * @self: a #QmiNasCellInfo.
+ * @n_cells: (out): return location for the number of cells.
+ *
+ * Gets the LTE cells neighboring the UMTS serving cell.
+ *
+ * Returns: (transfer none) (array length=n_cells): the cells, owned by @self, or %NULL if none.
+ *
+ * Since: 1.20
+ */
+const QmiNasCellInfoUmtsLteCell *qmi_nas_cell_info_get_umts_lte_cells (QmiNasCellInfo *self,
+                                                                       guint          *n_cells);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_NAS_CELL_INFO_H_ */
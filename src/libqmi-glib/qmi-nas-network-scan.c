@@ -0,0 +1,198 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "qmi-nas-network-scan.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+/* NAS Network Scan response TLVs */
+#define NETWORK_SCAN_TLV_NETWORK_INFORMATION     0x10
+#define NETWORK_SCAN_TLV_RADIO_ACCESS_TECHNOLOGY 0x11
+#define NETWORK_SCAN_TLV_MNC_PCS_DIGIT           0x12
+
+/* MCC (2), MNC (2) and status (1), followed by the description with a
+ * 1-byte length prefix */
+#define NETWORK_INFORMATION_HEADER_SIZE 6
+
+/* MCC (2), MNC (2) and a 1-byte value, in both the 'Radio Access Technology'
+ * and 'MNC PCS Digit Include Status' TLVs */
+#define NETWORK_VALUE_ELEMENT_SIZE 5
+
+typedef struct {
+    const guint8 *info;
+    const guint8 *rat;
+    const guint8 *pcs;
+    guint         n_info_left;
+    guint         n_rat;
+    guint         n_pcs;
+    guint         index;
+} RealIter;
+
+G_STATIC_ASSERT (sizeof (RealIter) <= sizeof (QmiNasNetworkScanIter));
+
+static inline guint16
+read_guint16 (const guint8 *data)
+{
+    return (guint16) (data[0] | (data[1] << 8));
+}
+
+/* Fixed-size arrays are only checked for their length; invalid ones are
+ * just ignored, as the networks are still usable without them */
+static const guint8 *
+get_network_value_array (QmiMessage *message,
+                         guint8      type,
+                         guint      *n_elements)
+{
+    const guint8 *raw;
+    guint16       raw_length = 0;
+    guint16       n;
+
+    *n_elements = 0;
+
+    raw = qmi_message_get_raw_tlv (message, type, &raw_length);
+    if (!raw || raw_length < 2)
+        return NULL;
+
+    n = read_guint16 (raw);
+    if ((gsize) n * NETWORK_VALUE_ELEMENT_SIZE > (gsize) (raw_length - 2)) {
+        g_debug ("ignoring invalid network scan TLV 0x%02x: %u elements in %u bytes",
+                 type, n, raw_length - 2);
+        return NULL;
+    }
+
+    *n_elements = n;
+    return &raw[2];
+}
+
+gboolean
+qmi_nas_network_scan_iter_init (QmiNasNetworkScanIter           *iter,
+                                QmiMessageNasNetworkScanOutput  *output,
+                                GError                         **error)
+{
+    RealIter     *real = (RealIter *) iter;
+    QmiMessage   *message;
+    const guint8 *raw;
+    const guint8 *walker;
+    const guint8 *end;
+    guint16       raw_length = 0;
+    guint16       n;
+    guint         i;
+
+    g_return_val_if_fail (iter != NULL, FALSE);
+    g_return_val_if_fail (output != NULL, FALSE);
+
+    if (!qmi_message_nas_network_scan_output_get_result (output, error))
+        return FALSE;
+
+    message = __qmi_message_nas_network_scan_output_peek_message (output);
+    raw = qmi_message_get_raw_tlv (message, NETWORK_SCAN_TLV_NETWORK_INFORMATION, &raw_length);
+    if (!raw) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_TLV_NOT_FOUND,
+                     "Field 'Network Information' was not found in the message");
+        return FALSE;
+    }
+
+    /* Validate the variable-size elements, so that they can be walked
+     * afterwards without checks */
+    end = raw + raw_length;
+    walker = raw + 2;
+    n = (raw_length >= 2 ? read_guint16 (raw) : 0);
+    for (i = 0; walker <= end && i < n; i++) {
+        if (end - walker < NETWORK_INFORMATION_HEADER_SIZE)
+            break;
+        walker += NETWORK_INFORMATION_HEADER_SIZE + walker[NETWORK_INFORMATION_HEADER_SIZE - 1];
+    }
+    if (raw_length < 2 || i < n || walker > end) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_TLV_TOO_LONG,
+                     "Reading TLV would overflow");
+        return FALSE;
+    }
+
+    real->info = raw + 2;
+    real->n_info_left = n;
+    real->index = 0;
+    real->rat = get_network_value_array (message, NETWORK_SCAN_TLV_RADIO_ACCESS_TECHNOLOGY, &real->n_rat);
+    real->pcs = get_network_value_array (message, NETWORK_SCAN_TLV_MNC_PCS_DIGIT, &real->n_pcs);
+    return TRUE;
+}
+
+/* Elements of the fixed-size arrays are usually given in the same order as
+ * the networks, so look at the same index first */
+static const guint8 *
+find_network_value (const guint8 *array,
+                    guint         n_elements,
+                    guint         index,
+                    const guint8 *mcc_mnc)
+{
+    guint i;
+
+    if (!array)
+        return NULL;
+
+    if (index < n_elements && memcmp (&array[index * NETWORK_VALUE_ELEMENT_SIZE], mcc_mnc, 4) == 0)
+        return &array[index * NETWORK_VALUE_ELEMENT_SIZE];
+
+    for (i = 0; i < n_elements; i++) {
+        if (memcmp (&array[i * NETWORK_VALUE_ELEMENT_SIZE], mcc_mnc, 4) == 0)
+            return &array[i * NETWORK_VALUE_ELEMENT_SIZE];
+    }
+    return NULL;
+}
+
+gboolean
+qmi_nas_network_scan_iter_next (QmiNasNetworkScanIter   *iter,
+                                QmiNasNetworkScanResult *result)
+{
+    RealIter     *real = (RealIter *) iter;
+    const guint8 *value;
+
+    g_return_val_if_fail (iter != NULL, FALSE);
+    g_return_val_if_fail (result != NULL, FALSE);
+
+    if (real->n_info_left == 0)
+        return FALSE;
+
+    result->mcc = read_guint16 (&real->info[0]);
+    result->mnc = read_guint16 (&real->info[2]);
+    result->network_status = (QmiNasNetworkStatus) real->info[4];
+    result->description_length = real->info[5];
+    result->description = (const gchar *) &real->info[NETWORK_INFORMATION_HEADER_SIZE];
+
+    value = find_network_value (real->rat, real->n_rat, real->index, real->info);
+    result->radio_interface = (value ? (QmiNasRadioInterface) (gint8) value[4] : QMI_NAS_RADIO_INTERFACE_UNKNOWN);
+
+    value = find_network_value (real->pcs, real->n_pcs, real->index, real->info);
+    result->mnc_includes_pcs_digit = (value ? !!value[4] : FALSE);
+
+    real->info += NETWORK_INFORMATION_HEADER_SIZE + result->description_length;
+    real->n_info_left--;
+    real->index++;
+    return TRUE;
+}
@@ -0,0 +1,130 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_NAS_NETWORK_SCAN_H_
+#define _LIBQMI_GLIB_QMI_NAS_NETWORK_SCAN_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+#include "qmi-enums-nas.h"
+#include "qmi-nas.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-nas-network-scan
+ * @title: NAS network scan results
+ * @short_description: iteration over the results of a NAS Network Scan
+ *
+ * Helpers to walk the networks reported in a NAS Network Scan response one
+ * by one, directly from the message, instead of getting the whole
+ * 'Network Information', 'Radio Access Technology' and 'MNC PCS Digit
+ * Include Status' arrays with the #QmiMessageNasNetworkScanOutput getters.
+ *
+ * Each network is reported along with its radio access technology and PCS
+ * digit information, and nothing is allocated while iterating, so the
+ * caller may stop as soon as a suitable network is found.
+ */
+
+/**
+ * QmiNasNetworkScanResult:
+ * @mcc: the Mobile Country Code.
+ * @mnc: the Mobile Network Code.
+ * @network_status: a #QmiNasNetworkStatus mask.
+ * @description: (array length=description_length): the network description, not NUL-terminated.
+ * @description_length: the length of @description.
+ * @radio_interface: a #QmiNasRadioInterface, or %QMI_NAS_RADIO_INTERFACE_UNKNOWN if not reported.
+ * @mnc_includes_pcs_digit: whether @mnc includes the PCS digit, %FALSE if not reported.
+ *
+ * A network reported in a NAS Network Scan response. @description points to
+ * the response message, and is valid as long as the
+ * #QmiMessageNasNetworkScanOutput it was read from.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    guint16               mcc;
+    guint16               mnc;
+    QmiNasNetworkStatus   network_status;
+    const gchar          *description;
+    guint8                description_length;
+    QmiNasRadioInterface  radio_interface;
+    gboolean              mnc_includes_pcs_digit;
+} QmiNasNetworkScanResult;
+
+/**
+ * QmiNasNetworkScanIter:
+ *
+ * An opaque structure used to iterate over the results in a NAS Network
+ * Scan response, allocated by the caller, usually in the stack.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    /*< private >*/
+    gconstpointer dummy1[3];
+    guint         dummy2[4];
+} QmiNasNetworkScanIter;
+
+/**
+ * qmi_nas_network_scan_iter_init:
+ * @iter: an uninitialized #QmiNasNetworkScanIter.
+ * @output: a #QmiMessageNasNetworkScanOutput.
+ * @error: Return location for error or %NULL.
+ *
+ * Initializes @iter to walk the networks reported in @output, which must be
+ * kept valid while iterating.
+ *
+ * The 'Network Information' TLV of the response is validated in a single
+ * pass, without decoding it, so that qmi_nas_network_scan_iter_next() never
+ * fails.
+ *
+ * Returns: %TRUE if @iter is initialized, %FALSE if @error is set.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_nas_network_scan_iter_init (QmiNasNetworkScanIter           *iter,
+                                         QmiMessageNasNetworkScanOutput  *output,
+                                         GError                         **error);
+
+/**
+ * qmi_nas_network_scan_iter_next:
+ * @iter: a #QmiNasNetworkScanIter.
+ * @result: (out caller-allocates): a placeholder for the output #QmiNasNetworkScanResult.
+ *
+ * Advances @iter to the next network, in the order given in the response.
+ *
+ * Returns: %TRUE if @result is set, %FALSE if there are no more networks.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_nas_network_scan_iter_next (QmiNasNetworkScanIter   *iter,
+                                         QmiNasNetworkScanResult *result);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_NAS_NETWORK_SCAN_H_ */
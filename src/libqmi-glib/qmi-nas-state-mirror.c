@@ -0,0 +1,1209 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "qmi-nas-state-mirror.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+static void async_initable_iface_init (GAsyncInitableIface *iface);
+
+G_DEFINE_TYPE_EXTENDED (QmiNasStateMirror, qmi_nas_state_mirror, G_TYPE_OBJECT, 0,
+                        G_IMPLEMENT_INTERFACE (G_TYPE_ASYNC_INITABLE, async_initable_iface_init))
+
+/* Timeout of each of the setup requests */
+#define SETUP_TIMEOUT 10
+
+/* Max number of thresholds given for each measurement */
+#define SIGNAL_THRESHOLDS_MAX 32
+
+/* Max signal resolution, in dB */
+#define SIGNAL_RESOLUTION_MAX 30
+
+enum {
+    PROP_0,
+    PROP_CLIENT,
+    PROP_SIGNAL_RESOLUTION,
+    PROP_LAST
+};
+
+enum {
+    SIGNAL_UPDATED,
+    SIGNAL_LAST
+};
+
+static GParamSpec *properties[PROP_LAST];
+static guint       signals[SIGNAL_LAST] = { 0 };
+
+/*****************************************************************************/
+/* Snapshot */
+
+typedef struct {
+    gboolean                      serving_system_valid;
+    QmiNasRegistrationState       registration_state;
+    QmiNasAttachState             cs_attach_state;
+    QmiNasAttachState             ps_attach_state;
+    QmiNasNetworkType             selected_network;
+    GArray                       *radio_interfaces;
+    gboolean                      roaming_indicator_valid;
+    QmiNasRoamingIndicatorStatus  roaming_indicator;
+    gboolean                      current_plmn_valid;
+    guint16                       mcc;
+    guint16                       mnc;
+    gchar                        *description;
+    gboolean                      lac_3gpp_valid;
+    guint16                       lac_3gpp;
+    gboolean                      cid_3gpp_valid;
+    guint32                       cid_3gpp;
+    gboolean                      lte_tac_valid;
+    guint16                       lte_tac;
+} ServingSystemState;
+
+typedef struct {
+    gboolean            cdma_valid;
+    gint8               cdma_rssi;
+    gint16              cdma_ecio;
+    gboolean            hdr_valid;
+    gint8               hdr_rssi;
+    gint16              hdr_ecio;
+    QmiNasEvdoSinrLevel hdr_sinr;
+    gint32              hdr_io;
+    gboolean            gsm_valid;
+    gint8               gsm_rssi;
+    gboolean            wcdma_valid;
+    gint8               wcdma_rssi;
+    gint16              wcdma_ecio;
+    gboolean            lte_valid;
+    gint8               lte_rssi;
+    gint8               lte_rsrq;
+    gint16              lte_rsrp;
+    gint16              lte_snr;
+} SignalState;
+
+struct _QmiNasStateSnapshot {
+    volatile gint      ref_count;
+    gint64             timestamp;
+    ServingSystemState serving_system;
+    SignalState        signal;
+};
+
+static void
+serving_system_state_copy (ServingSystemState       *dest,
+                           const ServingSystemState *src)
+{
+    *dest = *src;
+    if (src->radio_interfaces)
+        dest->radio_interfaces = g_array_ref (src->radio_interfaces);
+    dest->description = g_strdup (src->description);
+}
+
+static void
+serving_system_state_clear (ServingSystemState *state)
+{
+    if (state->radio_interfaces)
+        g_array_unref (state->radio_interfaces);
+    g_free (state->description);
+}
+
+GType
+qmi_nas_state_snapshot_get_type (void)
+{
+    static volatile gsize g_define_type_id__volatile = 0;
+
+    if (g_once_init_enter (&g_define_type_id__volatile)) {
+        GType g_define_type_id =
+            g_boxed_type_register_static (g_intern_static_string ("QmiNasStateSnapshot"),
+                                          (GBoxedCopyFunc) qmi_nas_state_snapshot_ref,
+                                          (GBoxedFreeFunc) qmi_nas_state_snapshot_unref);
+
+        g_once_init_leave (&g_define_type_id__volatile, g_define_type_id);
+    }
+
+    return g_define_type_id__volatile;
+}
+
+static QmiNasStateSnapshot *
+snapshot_new (void)
+{
+    QmiNasStateSnapshot *self;
+
+    self = g_slice_new0 (QmiNasStateSnapshot);
+    self->ref_count = 1;
+    self->timestamp = g_get_monotonic_time ();
+    return self;
+}
+
+QmiNasStateSnapshot *
+qmi_nas_state_snapshot_ref (QmiNasStateSnapshot *self)
+{
+    g_return_val_if_fail (self != NULL, NULL);
+
+    g_atomic_int_inc (&self->ref_count);
+    return self;
+}
+
+void
+qmi_nas_state_snapshot_unref (QmiNasStateSnapshot *self)
+{
+    g_return_if_fail (self != NULL);
+
+    if (g_atomic_int_dec_and_test (&self->ref_count)) {
+        serving_system_state_clear (&self->serving_system);
+        g_slice_free (QmiNasStateSnapshot, self);
+    }
+}
+
+gint64
+qmi_nas_state_snapshot_get_timestamp (QmiNasStateSnapshot *self)
+{
+    g_return_val_if_fail (self != NULL, 0);
+
+    return self->timestamp;
+}
+
+gboolean
+qmi_nas_state_snapshot_get_serving_system (QmiNasStateSnapshot      *self,
+                                           QmiNasRegistrationState  *registration_state,
+                                           QmiNasAttachState        *cs_attach_state,
+                                           QmiNasAttachState        *ps_attach_state,
+                                           QmiNasNetworkType        *selected_network,
+                                           GArray                  **radio_interfaces)
+{
+    g_return_val_if_fail (self != NULL, FALSE);
+
+    if (!self->serving_system.serving_system_valid)
+        return FALSE;
+
+    if (registration_state)
+        *registration_state = self->serving_system.registration_state;
+    if (cs_attach_state)
+        *cs_attach_state = self->serving_system.cs_attach_state;
+    if (ps_attach_state)
+        *ps_attach_state = self->serving_system.ps_attach_state;
+    if (selected_network)
+        *selected_network = self->serving_system.selected_network;
+    if (radio_interfaces)
+        *radio_interfaces = self->serving_system.radio_interfaces;
+    return TRUE;
+}
+
+gboolean
+qmi_nas_state_snapshot_get_roaming_indicator (QmiNasStateSnapshot          *self,
+                                              QmiNasRoamingIndicatorStatus *roaming_indicator)
+{
+    g_return_val_if_fail (self != NULL, FALSE);
+
+    if (!self->serving_system.roaming_indicator_valid)
+        return FALSE;
+
+    if (roaming_indicator)
+        *roaming_indicator = self->serving_system.roaming_indicator;
+    return TRUE;
+}
+
+gboolean
+qmi_nas_state_snapshot_get_current_plmn (QmiNasStateSnapshot  *self,
+                                         guint16              *mcc,
+                                         guint16              *mnc,
+                                         const gchar         **description)
+{
+    g_return_val_if_fail (self != NULL, FALSE);
+
+    if (!self->serving_system.current_plmn_valid)
+        return FALSE;
+
+    if (mcc)
+        *mcc = self->serving_system.mcc;
+    if (mnc)
+        *mnc = self->serving_system.mnc;
+    if (description)
+        *description = self->serving_system.description;
+    return TRUE;
+}
+
+gboolean
+qmi_nas_state_snapshot_get_lac_3gpp (QmiNasStateSnapshot *self,
+                                     guint16             *lac)
+{
+    g_return_val_if_fail (self != NULL, FALSE);
+
+    if (!self->serving_system.lac_3gpp_valid)
+        return FALSE;
+
+    if (lac)
+        *lac = self->serving_system.lac_3gpp;
+    return TRUE;
+}
+
+gboolean
+qmi_nas_state_snapshot_get_cid_3gpp (QmiNasStateSnapshot *self,
+                                     guint32             *cid)
+{
+    g_return_val_if_fail (self != NULL, FALSE);
+
+    if (!self->serving_system.cid_3gpp_valid)
+        return FALSE;
+
+    if (cid)
+        *cid = self->serving_system.cid_3gpp;
+    return TRUE;
+}
+
+gboolean
+qmi_nas_state_snapshot_get_lte_tac (QmiNasStateSnapshot *self,
+                                    guint16             *tac)
+{
+    g_return_val_if_fail (self != NULL, FALSE);
+
+    if (!self->serving_system.lte_tac_valid)
+        return FALSE;
+
+    if (tac)
+        *tac = self->serving_system.lte_tac;
+    return TRUE;
+}
+
+gboolean
+qmi_nas_state_snapshot_get_cdma_signal_strength (QmiNasStateSnapshot *self,
+                                                 gint8               *rssi,
+                                                 gint16              *ecio)
+{
+    g_return_val_if_fail (self != NULL, FALSE);
+
+    if (!self->signal.cdma_valid)
+        return FALSE;
+
+    if (rssi)
+        *rssi = self->signal.cdma_rssi;
+    if (ecio)
+        *ecio = self->signal.cdma_ecio;
+    return TRUE;
+}
+
+gboolean
+qmi_nas_state_snapshot_get_hdr_signal_strength (QmiNasStateSnapshot *self,
+                                                gint8               *rssi,
+                                                gint16              *ecio,
+                                                QmiNasEvdoSinrLevel *sinr,
+                                                gint32              *io)
+{
+    g_return_val_if_fail (self != NULL, FALSE);
+
+    if (!self->signal.hdr_valid)
+        return FALSE;
+
+    if (rssi)
+        *rssi = self->signal.hdr_rssi;
+    if (ecio)
+        *ecio = self->signal.hdr_ecio;
+    if (sinr)
+        *sinr = self->signal.hdr_sinr;
+    if (io)
+        *io = self->signal.hdr_io;
+    return TRUE;
+}
+
+gboolean
+qmi_nas_state_snapshot_get_gsm_signal_strength (QmiNasStateSnapshot *self,
+                                                gint8               *rssi)
+{
+    g_return_val_if_fail (self != NULL, FALSE);
+
+    if (!self->signal.gsm_valid)
+        return FALSE;
+
+    if (rssi)
+        *rssi = self->signal.gsm_rssi;
+    return TRUE;
+}
+
+gboolean
+qmi_nas_state_snapshot_get_wcdma_signal_strength (QmiNasStateSnapshot *self,
+                                                  gint8               *rssi,
+                                                  gint16              *ecio)
+{
+    g_return_val_if_fail (self != NULL, FALSE);
+
+    if (!self->signal.wcdma_valid)
+        return FALSE;
+
+    if (rssi)
+        *rssi = self->signal.wcdma_rssi;
+    if (ecio)
+        *ecio = self->signal.wcdma_ecio;
+    return TRUE;
+}
+
+gboolean
+qmi_nas_state_snapshot_get_lte_signal_strength (QmiNasStateSnapshot *self,
+                                                gint8               *rssi,
+                                                gint8               *rsrq,
+                                                gint16              *rsrp,
+                                                gint16              *snr)
+{
+    g_return_val_if_fail (self != NULL, FALSE);
+
+    if (!self->signal.lte_valid)
+        return FALSE;
+
+    if (rssi)
+        *rssi = self->signal.lte_rssi;
+    if (rsrq)
+        *rsrq = self->signal.lte_rsrq;
+    if (rsrp)
+        *rsrp = self->signal.lte_rsrp;
+    if (snr)
+        *snr = self->signal.lte_snr;
+    return TRUE;
+}
+
+/*****************************************************************************/
+/* Loading the state from the responses and indications, which report the
+ * whole serving system or signal state each time */
+
+static void
+serving_system_state_load_from_response (ServingSystemState                  *state,
+                                         QmiMessageNasGetServingSystemOutput *output)
+{
+    GArray      *radio_interfaces = NULL;
+    const gchar *description = NULL;
+
+    state->serving_system_valid =
+        qmi_message_nas_get_serving_system_output_get_serving_system (output,
+                                                                      &state->registration_state,
+                                                                      &state->cs_attach_state,
+                                                                      &state->ps_attach_state,
+                                                                      &state->selected_network,
+                                                                      &radio_interfaces,
+                                                                      NULL);
+    if (state->serving_system_valid)
+        state->radio_interfaces = g_array_ref (radio_interfaces);
+
+    state->roaming_indicator_valid =
+        qmi_message_nas_get_serving_system_output_get_roaming_indicator (output, &state->roaming_indicator, NULL);
+
+    state->current_plmn_valid =
+        qmi_message_nas_get_serving_system_output_get_current_plmn (output, &state->mcc, &state->mnc, &description, NULL);
+    if (state->current_plmn_valid)
+        state->description = g_strdup (description);
+
+    state->lac_3gpp_valid = qmi_message_nas_get_serving_system_output_get_lac_3gpp (output, &state->lac_3gpp, NULL);
+    state->cid_3gpp_valid = qmi_message_nas_get_serving_system_output_get_cid_3gpp (output, &state->cid_3gpp, NULL);
+    state->lte_tac_valid  = qmi_message_nas_get_serving_system_output_get_lte_tac  (output, &state->lte_tac,  NULL);
+}
+
+static void
+serving_system_state_load_from_indication (ServingSystemState                  *state,
+                                           QmiIndicationNasServingSystemOutput *output)
+{
+    GArray      *radio_interfaces = NULL;
+    const gchar *description = NULL;
+
+    state->serving_system_valid =
+        qmi_indication_nas_serving_system_output_get_serving_system (output,
+                                                                     &state->registration_state,
+                                                                     &state->cs_attach_state,
+                                                                     &state->ps_attach_state,
+                                                                     &state->selected_network,
+                                                                     &radio_interfaces,
+                                                                     NULL);
+    if (state->serving_system_valid)
+        state->radio_interfaces = g_array_ref (radio_interfaces);
+
+    state->roaming_indicator_valid =
+        qmi_indication_nas_serving_system_output_get_roaming_indicator (output, &state->roaming_indicator, NULL);
+
+    state->current_plmn_valid =
+        qmi_indication_nas_serving_system_output_get_current_plmn (output, &state->mcc, &state->mnc, &description, NULL);
+    if (state->current_plmn_valid)
+        state->description = g_strdup (description);
+
+    state->lac_3gpp_valid = qmi_indication_nas_serving_system_output_get_lac_3gpp (output, &state->lac_3gpp, NULL);
+    state->cid_3gpp_valid = qmi_indication_nas_serving_system_output_get_cid_3gpp (output, &state->cid_3gpp, NULL);
+    state->lte_tac_valid  = qmi_indication_nas_serving_system_output_get_lte_tac  (output, &state->lte_tac,  NULL);
+}
+
+static void
+signal_state_load_from_response (SignalState                     *state,
+                                 QmiMessageNasGetSignalInfoOutput *output)
+{
+    state->cdma_valid =
+        qmi_message_nas_get_signal_info_output_get_cdma_signal_strength (output,
+                                                                         &state->cdma_rssi,
+                                                                         &state->cdma_ecio,
+                                                                         NULL);
+    state->hdr_valid =
+        qmi_message_nas_get_signal_info_output_get_hdr_signal_strength (output,
+                                                                        &state->hdr_rssi,
+                                                                        &state->hdr_ecio,
+                                                                        &state->hdr_sinr,
+                                                                        &state->hdr_io,
+                                                                        NULL);
+    state->gsm_valid =
+        qmi_message_nas_get_signal_info_output_get_gsm_signal_strength (output,
+                                                                        &state->gsm_rssi,
+                                                                        NULL);
+    state->wcdma_valid =
+        qmi_message_nas_get_signal_info_output_get_wcdma_signal_strength (output,
+                                                                          &state->wcdma_rssi,
+                                                                          &state->wcdma_ecio,
+                                                                          NULL);
+    state->lte_valid =
+        qmi_message_nas_get_signal_info_output_get_lte_signal_strength (output,
+                                                                        &state->lte_rssi,
+                                                                        &state->lte_rsrq,
+                                                                        &state->lte_rsrp,
+                                                                        &state->lte_snr,
+                                                                        NULL);
+}
+
+static void
+signal_state_load_from_indication (SignalState                      *state,
+                                   QmiIndicationNasSignalInfoOutput *output)
+{
+    state->cdma_valid =
+        qmi_indication_nas_signal_info_output_get_cdma_signal_strength (output,
+                                                                        &state->cdma_rssi,
+                                                                        &state->cdma_ecio,
+                                                                        NULL);
+    state->hdr_valid =
+        qmi_indication_nas_signal_info_output_get_hdr_signal_strength (output,
+                                                                       &state->hdr_rssi,
+                                                                       &state->hdr_ecio,
+                                                                       &state->hdr_sinr,
+                                                                       &state->hdr_io,
+                                                                       NULL);
+    state->gsm_valid =
+        qmi_indication_nas_signal_info_output_get_gsm_signal_strength (output,
+                                                                       &state->gsm_rssi,
+                                                                       NULL);
+    state->wcdma_valid =
+        qmi_indication_nas_signal_info_output_get_wcdma_signal_strength (output,
+                                                                         &state->wcdma_rssi,
+                                                                         &state->wcdma_ecio,
+                                                                         NULL);
+    state->lte_valid =
+        qmi_indication_nas_signal_info_output_get_lte_signal_strength (output,
+                                                                       &state->lte_rssi,
+                                                                       &state->lte_rsrq,
+                                                                       &state->lte_rsrp,
+                                                                       &state->lte_snr,
+                                                                       NULL);
+}
+
+static inline gboolean
+value_changed (gint old_value,
+               gint new_value,
+               gint step)
+{
+    return (ABS (new_value - old_value) >= step);
+}
+
+/* Whether the change is worth reporting with the given resolution, in dB;
+ * ECIO values are given in units of 0.5 dB and SNR values in units of
+ * 0.1 dB */
+static gboolean
+signal_state_changed (const SignalState *old,
+                      const SignalState *new,
+                      guint              resolution)
+{
+    gint step = (gint) resolution;
+
+    if (old->cdma_valid  != new->cdma_valid  ||
+        old->hdr_valid   != new->hdr_valid   ||
+        old->gsm_valid   != new->gsm_valid   ||
+        old->wcdma_valid != new->wcdma_valid ||
+        old->lte_valid   != new->lte_valid)
+        return TRUE;
+
+    if (new->cdma_valid &&
+        (value_changed (old->cdma_rssi, new->cdma_rssi, step) ||
+         value_changed (old->cdma_ecio, new->cdma_ecio, 2 * step)))
+        return TRUE;
+
+    if (new->hdr_valid &&
+        (value_changed (old->hdr_rssi, new->hdr_rssi, step) ||
+         value_changed (old->hdr_ecio, new->hdr_ecio, 2 * step) ||
+         value_changed (old->hdr_io,   new->hdr_io,   step) ||
+         old->hdr_sinr != new->hdr_sinr))
+        return TRUE;
+
+    if (new->gsm_valid &&
+        value_changed (old->gsm_rssi, new->gsm_rssi, step))
+        return TRUE;
+
+    if (new->wcdma_valid &&
+        (value_changed (old->wcdma_rssi, new->wcdma_rssi, step) ||
+         value_changed (old->wcdma_ecio, new->wcdma_ecio, 2 * step)))
+        return TRUE;
+
+    if (new->lte_valid &&
+        (value_changed (old->lte_rssi, new->lte_rssi, step) ||
+         value_changed (old->lte_rsrq, new->lte_rsrq, step) ||
+         value_changed (old->lte_rsrp, new->lte_rsrp, step) ||
+         value_changed (old->lte_snr,  new->lte_snr,  10 * step)))
+        return TRUE;
+
+    return FALSE;
+}
+
+/*****************************************************************************/
+
+struct _QmiNasStateMirrorPrivate {
+    QmiClientNas *client;
+    gulong        serving_system_indication_id;
+    gulong        signal_info_indication_id;
+
+    /* Signal resolution in dB, 0 if not given */
+    guint         signal_resolution;
+
+    /* The current snapshot is replaced, never modified; the lock just
+     * protects the pointer while taking a new reference */
+    GMutex               snapshot_lock;
+    QmiNasStateSnapshot *snapshot;
+};
+
+QmiClientNas *
+qmi_nas_state_mirror_peek_client (QmiNasStateMirror *self)
+{
+    g_return_val_if_fail (QMI_IS_NAS_STATE_MIRROR (self), NULL);
+
+    return self->priv->client;
+}
+
+QmiNasStateSnapshot *
+qmi_nas_state_mirror_get_snapshot (QmiNasStateMirror *self)
+{
+    QmiNasStateSnapshot *snapshot;
+
+    g_return_val_if_fail (QMI_IS_NAS_STATE_MIRROR (self), NULL);
+
+    g_mutex_lock (&self->priv->snapshot_lock);
+    snapshot = qmi_nas_state_snapshot_ref (self->priv->snapshot);
+    g_mutex_unlock (&self->priv->snapshot_lock);
+    return snapshot;
+}
+
+/* Takes ownership of the new snapshot */
+static void
+snapshot_replace (QmiNasStateMirror   *self,
+                  QmiNasStateSnapshot *snapshot)
+{
+    QmiNasStateSnapshot *old;
+
+    g_mutex_lock (&self->priv->snapshot_lock);
+    old = self->priv->snapshot;
+    self->priv->snapshot = snapshot;
+    g_mutex_unlock (&self->priv->snapshot_lock);
+
+    qmi_nas_state_snapshot_unref (old);
+}
+
+/* Only the owner context updates the snapshot, so the current one can be
+ * read without the lock */
+
+static void
+update_serving_system (QmiNasStateMirror                   *self,
+                       QmiMessageNasGetServingSystemOutput *response,
+                       QmiIndicationNasServingSystemOutput *indication)
+{
+    QmiNasStateSnapshot *snapshot;
+
+    snapshot = snapshot_new ();
+    snapshot->signal = self->priv->snapshot->signal;
+    if (response)
+        serving_system_state_load_from_response (&snapshot->serving_system, response);
+    else
+        serving_system_state_load_from_indication (&snapshot->serving_system, indication);
+    snapshot_replace (self, snapshot);
+
+    g_signal_emit (self, signals[SIGNAL_UPDATED], 0);
+}
+
+static void
+update_signal (QmiNasStateMirror                *self,
+               QmiMessageNasGetSignalInfoOutput *response,
+               QmiIndicationNasSignalInfoOutput *indication)
+{
+    QmiNasStateSnapshot *snapshot;
+
+    snapshot = snapshot_new ();
+    if (response)
+        signal_state_load_from_response (&snapshot->signal, response);
+    else
+        signal_state_load_from_indication (&snapshot->signal, indication);
+
+    /* The device reports every threshold crossed, so a value oscillating
+     * around one of them would be reported over and over; only report
+     * values that moved at least the resolution away from the last ones
+     * reported */
+    if (indication &&
+        self->priv->signal_resolution &&
+        !signal_state_changed (&self->priv->snapshot->signal, &snapshot->signal, self->priv->signal_resolution)) {
+        qmi_nas_state_snapshot_unref (snapshot);
+        return;
+    }
+
+    serving_system_state_copy (&snapshot->serving_system, &self->priv->snapshot->serving_system);
+    snapshot_replace (self, snapshot);
+
+    g_signal_emit (self, signals[SIGNAL_UPDATED], 0);
+}
+
+static void
+serving_system_indication_cb (QmiClientNas                        *client,
+                              QmiIndicationNasServingSystemOutput *output,
+                              QmiNasStateMirror                   *self)
+{
+    update_serving_system (self, NULL, output);
+}
+
+static void
+signal_info_indication_cb (QmiClientNas                     *client,
+                           QmiIndicationNasSignalInfoOutput *output,
+                           QmiNasStateMirror                *self)
+{
+    update_signal (self, NULL, output);
+}
+
+/*****************************************************************************/
+/* New mirror */
+
+QmiNasStateMirror *
+qmi_nas_state_mirror_new_finish (GAsyncResult  *res,
+                                 GError       **error)
+{
+    GObject *ret;
+    GObject *source_object;
+
+    source_object = g_async_result_get_source_object (res);
+    ret = g_async_initable_new_finish (G_ASYNC_INITABLE (source_object), res, error);
+    g_object_unref (source_object);
+
+    return (ret ? QMI_NAS_STATE_MIRROR (ret) : NULL);
+}
+
+void
+qmi_nas_state_mirror_new (QmiClientNas        *client,
+                          GCancellable        *cancellable,
+                          GAsyncReadyCallback  callback,
+                          gpointer             user_data)
+{
+    qmi_nas_state_mirror_new_full (client, 0, cancellable, callback, user_data);
+}
+
+void
+qmi_nas_state_mirror_new_full (QmiClientNas        *client,
+                               guint                signal_resolution,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data)
+{
+    g_return_if_fail (QMI_IS_CLIENT_NAS (client));
+    g_return_if_fail (signal_resolution <= SIGNAL_RESOLUTION_MAX);
+
+    g_async_initable_new_async (QMI_TYPE_NAS_STATE_MIRROR,
+                                G_PRIORITY_DEFAULT,
+                                cancellable,
+                                callback,
+                                user_data,
+                                QMI_NAS_STATE_MIRROR_CLIENT,            client,
+                                QMI_NAS_STATE_MIRROR_SIGNAL_RESOLUTION, signal_resolution,
+                                NULL);
+}
+
+/*****************************************************************************/
+/* Async init */
+
+typedef enum {
+    INIT_CONTEXT_STEP_FIRST = 0,
+    INIT_CONTEXT_STEP_REGISTER_INDICATIONS,
+    INIT_CONTEXT_STEP_CONFIG_SIGNAL_INFO,
+    INIT_CONTEXT_STEP_GET_SERVING_SYSTEM,
+    INIT_CONTEXT_STEP_GET_SIGNAL_INFO,
+    INIT_CONTEXT_STEP_LAST
+} InitContextStep;
+
+static void init_step (GTask *task);
+
+/* Thresholds from @min to @max every @step, or every larger step if there
+ * would be too many of them */
+static GArray *
+build_thresholds (gint  min,
+                  gint  max,
+                  gint  step,
+                  guint element_size)
+{
+    GArray *thresholds;
+    gint    value;
+
+    step = MAX (step, (max - min + SIGNAL_THRESHOLDS_MAX - 2) / (SIGNAL_THRESHOLDS_MAX - 1));
+
+    thresholds = g_array_new (FALSE, FALSE, element_size);
+    for (value = min; value <= max; value += step) {
+        if (element_size == sizeof (gint8)) {
+            gint8 threshold = (gint8) value;
+
+            g_array_append_val (thresholds, threshold);
+        } else {
+            gint16 threshold = (gint16) value;
+
+            g_assert (element_size == sizeof (gint16));
+            g_array_append_val (thresholds, threshold);
+        }
+    }
+    return thresholds;
+}
+
+static QmiMessageNasConfigSignalInfoInput *
+build_config_signal_info_input (guint resolution)
+{
+    QmiMessageNasConfigSignalInfoInput *input;
+    GArray                             *thresholds;
+    gint                                step;
+    guint8                              report_rate;
+
+    step = (gint) resolution;
+    input = qmi_message_nas_config_signal_info_input_new ();
+
+    /* RSSI and RSCP in dBm */
+    thresholds = build_thresholds (-110, -50, step, sizeof (gint8));
+    qmi_message_nas_config_signal_info_input_set_rssi_threshold (input, thresholds, NULL);
+    g_array_unref (thresholds);
+
+    thresholds = build_thresholds (-120, -25, step, sizeof (gint8));
+    qmi_message_nas_config_signal_info_input_set_rscp_threshold (input, thresholds, NULL);
+    g_array_unref (thresholds);
+
+    /* ECIO in units of 0.5 dB, from 0 to 20 dB below */
+    thresholds = build_thresholds (0, 40, 2 * step, sizeof (gint16));
+    qmi_message_nas_config_signal_info_input_set_ecio_threshold (input, thresholds, NULL);
+    g_array_unref (thresholds);
+
+    /* LTE RSRQ in dB, RSRP in dBm and SNR in units of 0.1 dB */
+    thresholds = build_thresholds (-20, -3, step, sizeof (gint8));
+    qmi_message_nas_config_signal_info_input_set_rsrq_threshold (input, thresholds, NULL);
+    g_array_unref (thresholds);
+
+    thresholds = build_thresholds (-140, -44, step, sizeof (gint16));
+    qmi_message_nas_config_signal_info_input_set_rsrp_threshold (input, thresholds, NULL);
+    g_array_unref (thresholds);
+
+    thresholds = build_thresholds (-200, 300, 10 * step, sizeof (gint16));
+    qmi_message_nas_config_signal_info_input_set_lte_snr_threshold (input, thresholds, NULL);
+    g_array_unref (thresholds);
+
+    /* LTE reports every 1 to 5 seconds, averaged over twice that time; the
+     * coarser the resolution, the less often */
+    report_rate = (guint8) CLAMP (resolution, 1, 5);
+    qmi_message_nas_config_signal_info_input_set_lte_report (input, report_rate, 2 * report_rate, NULL);
+
+    return input;
+}
+
+static gboolean
+initable_init_finish (GAsyncInitable  *initable,
+                      GAsyncResult    *result,
+                      GError         **error)
+{
+    return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static void
+init_step_next (GTask *task)
+{
+    InitContextStep *step;
+
+    step = g_task_get_task_data (task);
+    (*step)++;
+    init_step (task);
+}
+
+static void
+get_signal_info_ready (QmiClientNas *client,
+                       GAsyncResult *res,
+                       GTask        *task)
+{
+    QmiMessageNasGetSignalInfoOutput *output;
+    GError                           *error = NULL;
+
+    output = qmi_client_nas_get_signal_info_finish (client, res, &error);
+    if (!output || !qmi_message_nas_get_signal_info_output_get_result (output, &error)) {
+        g_debug ("couldn't load initial signal info: %s", error->message);
+        g_error_free (error);
+    } else
+        update_signal (g_task_get_source_object (task), output, NULL);
+
+    if (output)
+        qmi_message_nas_get_signal_info_output_unref (output);
+    init_step_next (task);
+}
+
+static void
+get_serving_system_ready (QmiClientNas *client,
+                          GAsyncResult *res,
+                          GTask        *task)
+{
+    QmiMessageNasGetServingSystemOutput *output;
+    GError                              *error = NULL;
+
+    output = qmi_client_nas_get_serving_system_finish (client, res, &error);
+    if (!output || !qmi_message_nas_get_serving_system_output_get_result (output, &error)) {
+        g_debug ("couldn't load initial serving system: %s", error->message);
+        g_error_free (error);
+    } else
+        update_serving_system (g_task_get_source_object (task), output, NULL);
+
+    if (output)
+        qmi_message_nas_get_serving_system_output_unref (output);
+    init_step_next (task);
+}
+
+static void
+config_signal_info_ready (QmiClientNas *client,
+                          GAsyncResult *res,
+                          GTask        *task)
+{
+    QmiMessageNasConfigSignalInfoOutput *output;
+    GError                              *error = NULL;
+
+    output = qmi_client_nas_config_signal_info_finish (client, res, &error);
+    if (!output || !qmi_message_nas_config_signal_info_output_get_result (output, &error)) {
+        g_debug ("couldn't configure signal info thresholds: %s", error->message);
+        g_error_free (error);
+    }
+
+    if (output)
+        qmi_message_nas_config_signal_info_output_unref (output);
+    init_step_next (task);
+}
+
+static void
+register_indications_ready (QmiClientNas *client,
+                            GAsyncResult *res,
+                            GTask        *task)
+{
+    QmiMessageNasRegisterIndicationsOutput *output;
+    GError                                 *error = NULL;
+
+    output = qmi_client_nas_register_indications_finish (client, res, &error);
+    if (!output || !qmi_message_nas_register_indications_output_get_result (output, &error)) {
+        g_debug ("couldn't register indications: %s", error->message);
+        g_error_free (error);
+    }
+
+    if (output)
+        qmi_message_nas_register_indications_output_unref (output);
+    init_step_next (task);
+}
+
+static void
+init_step (GTask *task)
+{
+    QmiNasStateMirror *self;
+    InitContextStep   *step;
+
+    self = g_task_get_source_object (task);
+    step = g_task_get_task_data (task);
+
+    /* Setup requests are allowed to fail, but not to be cancelled */
+    if (g_task_return_error_if_cancelled (task)) {
+        g_object_unref (task);
+        return;
+    }
+
+    switch (*step) {
+    case INIT_CONTEXT_STEP_FIRST:
+        /* Indications are processed right away, even if received before the
+         * initial state is loaded */
+        self->priv->serving_system_indication_id =
+            g_signal_connect (self->priv->client,
+                              "serving-system",
+                              G_CALLBACK (serving_system_indication_cb),
+                              self);
+        self->priv->signal_info_indication_id =
+            g_signal_connect (self->priv->client,
+                              "signal-info",
+                              G_CALLBACK (signal_info_indication_cb),
+                              self);
+        (*step)++;
+        /* Fall down */
+
+    case INIT_CONTEXT_STEP_REGISTER_INDICATIONS: {
+        QmiMessageNasRegisterIndicationsInput *input;
+
+        input = qmi_message_nas_register_indications_input_new ();
+        qmi_message_nas_register_indications_input_set_serving_system_events (input, TRUE, NULL);
+        qmi_message_nas_register_indications_input_set_signal_info (input, TRUE, NULL);
+        qmi_client_nas_register_indications (self->priv->client,
+                                             input,
+                                             SETUP_TIMEOUT,
+                                             g_task_get_cancellable (task),
+                                             (GAsyncReadyCallback)register_indications_ready,
+                                             task);
+        qmi_message_nas_register_indications_input_unref (input);
+        return;
+    }
+
+    case INIT_CONTEXT_STEP_CONFIG_SIGNAL_INFO: {
+        QmiMessageNasConfigSignalInfoInput *input;
+
+        /* Without thresholds, no Signal Info indication is ever sent */
+        if (self->priv->signal_resolution)
+            input = build_config_signal_info_input (self->priv->signal_resolution);
+        else {
+            GArray             *thresholds;
+            static const gint8  rssi_thresholds[] = { -100, -95, -90, -85, -80, -75, -70, -65 };
+
+            thresholds = g_array_sized_new (FALSE, FALSE, sizeof (gint8), G_N_ELEMENTS (rssi_thresholds));
+            g_array_append_vals (thresholds, rssi_thresholds, G_N_ELEMENTS (rssi_thresholds));
+            input = qmi_message_nas_config_signal_info_input_new ();
+            qmi_message_nas_config_signal_info_input_set_rssi_threshold (input, thresholds, NULL);
+            g_array_unref (thresholds);
+        }
+        qmi_client_nas_config_signal_info (self->priv->client,
+                                           input,
+                                           SETUP_TIMEOUT,
+                                           g_task_get_cancellable (task),
+                                           (GAsyncReadyCallback)config_signal_info_ready,
+                                           task);
+        qmi_message_nas_config_signal_info_input_unref (input);
+        return;
+    }
+
+    case INIT_CONTEXT_STEP_GET_SERVING_SYSTEM:
+        qmi_client_nas_get_serving_system (self->priv->client,
+                                           NULL,
+                                           SETUP_TIMEOUT,
+                                           g_task_get_cancellable (task),
+                                           (GAsyncReadyCallback)get_serving_system_ready,
+                                           task);
+        return;
+
+    case INIT_CONTEXT_STEP_GET_SIGNAL_INFO:
+        qmi_client_nas_get_signal_info (self->priv->client,
+                                        NULL,
+                                        SETUP_TIMEOUT,
+                                        g_task_get_cancellable (task),
+                                        (GAsyncReadyCallback)get_signal_info_ready,
+                                        task);
+        return;
+
+    case INIT_CONTEXT_STEP_LAST:
+        g_task_return_boolean (task, TRUE);
+        g_object_unref (task);
+        return;
+
+    default:
+        break;
+    }
+
+    g_assert_not_reached ();
+}
+
+static void
+initable_init_async (GAsyncInitable      *initable,
+                     int                  io_priority,
+                     GCancellable        *cancellable,
+                     GAsyncReadyCallback  callback,
+                     gpointer             user_data)
+{
+    QmiNasStateMirror *self;
+    InitContextStep   *step;
+    GTask             *task;
+
+    self = QMI_NAS_STATE_MIRROR (initable);
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    if (!self->priv->client) {
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_INVALID_ARGS,
+                                 "Cannot initialize NAS state mirror: No client given");
+        g_object_unref (task);
+        return;
+    }
+
+    step = g_new0 (InitContextStep, 1);
+    g_task_set_task_data (task, step, g_free);
+    init_step (task);
+}
+
+/*****************************************************************************/
+
+static void
+set_property (GObject      *object,
+              guint         prop_id,
+              const GValue *value,
+              GParamSpec   *pspec)
+{
+    QmiNasStateMirror *self = QMI_NAS_STATE_MIRROR (object);
+
+    switch (prop_id) {
+    case PROP_CLIENT:
+        g_assert (self->priv->client == NULL);
+        self->priv->client = g_value_dup_object (value);
+        break;
+    case PROP_SIGNAL_RESOLUTION:
+        self->priv->signal_resolution = g_value_get_uint (value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+get_property (GObject    *object,
+              guint       prop_id,
+              GValue     *value,
+              GParamSpec *pspec)
+{
+    QmiNasStateMirror *self = QMI_NAS_STATE_MIRROR (object);
+
+    switch (prop_id) {
+    case PROP_CLIENT:
+        g_value_set_object (value, self->priv->client);
+        break;
+    case PROP_SIGNAL_RESOLUTION:
+        g_value_set_uint (value, self->priv->signal_resolution);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+qmi_nas_state_mirror_init (QmiNasStateMirror *self)
+{
+    self->priv = G_TYPE_INSTANCE_GET_PRIVATE ((self),
+                                              QMI_TYPE_NAS_STATE_MIRROR,
+                                              QmiNasStateMirrorPrivate);
+
+    g_mutex_init (&self->priv->snapshot_lock);
+    /* Everything unknown until loaded */
+    self->priv->snapshot = snapshot_new ();
+}
+
+static void
+dispose (GObject *object)
+{
+    QmiNasStateMirror *self = QMI_NAS_STATE_MIRROR (object);
+
+    if (self->priv->client) {
+        if (self->priv->serving_system_indication_id) {
+            g_signal_handler_disconnect (self->priv->client, self->priv->serving_system_indication_id);
+            self->priv->serving_system_indication_id = 0;
+        }
+        if (self->priv->signal_info_indication_id) {
+            g_signal_handler_disconnect (self->priv->client, self->priv->signal_info_indication_id);
+            self->priv->signal_info_indication_id = 0;
+        }
+        g_clear_object (&self->priv->client);
+    }
+
+    G_OBJECT_CLASS (qmi_nas_state_mirror_parent_class)->dispose (object);
+}
+
+static void
+finalize (GObject *object)
+{
+    QmiNasStateMirror *self = QMI_NAS_STATE_MIRROR (object);
+
+    qmi_nas_state_snapshot_unref (self->priv->snapshot);
+    g_mutex_clear (&self->priv->snapshot_lock);
+
+    G_OBJECT_CLASS (qmi_nas_state_mirror_parent_class)->finalize (object);
+}
+
+static void
+async_initable_iface_init (GAsyncInitableIface *iface)
+{
+    iface->init_async = initable_init_async;
+    iface->init_finish = initable_init_finish;
+}
+
+static void
+qmi_nas_state_mirror_class_init (QmiNasStateMirrorClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    g_type_class_add_private (object_class, sizeof (QmiNasStateMirrorPrivate));
+
+    object_class->get_property = get_property;
+    object_class->set_property = set_property;
+    object_class->dispose = dispose;
+    object_class->finalize = finalize;
+
+    /**
+     * QmiNasStateMirror:nas-state-mirror-client:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_CLIENT] =
+        g_param_spec_object (QMI_NAS_STATE_MIRROR_CLIENT,
+                             "NAS client",
+                             "The NAS client feeding the mirror",
+                             QMI_TYPE_CLIENT_NAS,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_CLIENT, properties[PROP_CLIENT]);
+
+    /**
+     * QmiNasStateMirror:nas-state-mirror-signal-resolution:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_SIGNAL_RESOLUTION] =
+        g_param_spec_uint (QMI_NAS_STATE_MIRROR_SIGNAL_RESOLUTION,
+                           "Signal resolution",
+                           "Smallest signal change reported, in dB, or 0 to report every change",
+                           0,
+                           SIGNAL_RESOLUTION_MAX,
+                           0,
+                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_SIGNAL_RESOLUTION, properties[PROP_SIGNAL_RESOLUTION]);
+
+    /**
+     * QmiNasStateMirror::updated:
+     * @object: A #QmiNasStateMirror.
+     *
+     * The ::updated signal is emitted in the main context of the #QmiClientNas
+     * whenever the state changes, i.e. after a new snapshot is available with
+     * qmi_nas_state_mirror_get_snapshot().
+     *
+     * Since: 1.20
+     */
+    signals[SIGNAL_UPDATED] =
+        g_signal_new (QMI_NAS_STATE_MIRROR_SIGNAL_UPDATED,
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      0);
+}
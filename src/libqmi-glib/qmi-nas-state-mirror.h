@@ -0,0 +1,448 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_NAS_STATE_MIRROR_H_
+#define _LIBQMI_GLIB_QMI_NAS_STATE_MIRROR_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "qmi-enums-nas.h"
+#include "qmi-nas.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-nas-state-mirror
+ * @title: QmiNasStateMirror
+ * @short_description: in-memory copy of the NAS serving system and signal state
+ *
+ * The #QmiNasStateMirror keeps the latest serving system and signal
+ * information reported by the device through a #QmiClientNas, so that it can
+ * be read at any time without any QMI request.
+ *
+ * When created, the mirror enables the NAS Serving System and Signal Info
+ * indications, configures the RSSI thresholds for the latter, and queries the
+ * initial state with NAS Get Serving System and NAS Get Signal Info. From then
+ * on, the state is only updated from the indications.
+ *
+ * The state is given as a #QmiNasStateSnapshot, which is never modified once
+ * created: each update replaces the current snapshot of the mirror with a new
+ * one, so a snapshot taken from any thread can be read without any locking.
+ */
+
+/**
+ * QmiNasStateSnapshot:
+ *
+ * An opaque type representing the state of a #QmiNasStateMirror at a given
+ * time.
+ *
+ * Since: 1.20
+ */
+typedef struct _QmiNasStateSnapshot QmiNasStateSnapshot;
+
+GType qmi_nas_state_snapshot_get_type (void);
+
+/**
+ * qmi_nas_state_snapshot_ref:
+ * @self: a #QmiNasStateSnapshot.
+ *
+ * Atomically increments the reference count of @self by one.
+ *
+ * Returns: (transfer full) the new reference to @self.
+ *
+ * Since: 1.20
+ */
+QmiNasStateSnapshot *qmi_nas_state_snapshot_ref (QmiNasStateSnapshot *self);
+
+/**
+ * qmi_nas_state_snapshot_unref:
+ * @self: a #QmiNasStateSnapshot.
+ *
+ * Atomically decrements the reference count of @self by one.
+ * If the reference count drops to 0, @self is completely disposed.
+ *
+ * Since: 1.20
+ */
+void qmi_nas_state_snapshot_unref (QmiNasStateSnapshot *self);
+
+/**
+ * qmi_nas_state_snapshot_get_timestamp:
+ * @self: a #QmiNasStateSnapshot.
+ *
+ * Gets when the state was last updated.
+ *
+ * Returns: the monotonic time of the last update, in microseconds.
+ *
+ * Since: 1.20
+ */
+gint64 qmi_nas_state_snapshot_get_timestamp (QmiNasStateSnapshot *self);
+
+/**
+ * qmi_nas_state_snapshot_get_serving_system:
+ * @self: a #QmiNasStateSnapshot.
+ * @registration_state: (out) (allow-none): a placeholder for the output #QmiNasRegistrationState, or %NULL if not required.
+ * @cs_attach_state: (out) (allow-none): a placeholder for the output CS #QmiNasAttachState, or %NULL if not required.
+ * @ps_attach_state: (out) (allow-none): a placeholder for the output PS #QmiNasAttachState, or %NULL if not required.
+ * @selected_network: (out) (allow-none): a placeholder for the output #QmiNasNetworkType, or %NULL if not required.
+ * @radio_interfaces: (out) (allow-none) (transfer none): a placeholder for the output #GArray of #QmiNasRadioInterface elements, or %NULL if not required. Do not free it, it is owned by @self.
+ *
+ * Gets the registration state of the device.
+ *
+ * Returns: %TRUE if the values are known, %FALSE otherwise.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_nas_state_snapshot_get_serving_system (QmiNasStateSnapshot      *self,
+                                                    QmiNasRegistrationState  *registration_state,
+                                                    QmiNasAttachState        *cs_attach_state,
+                                                    QmiNasAttachState        *ps_attach_state,
+                                                    QmiNasNetworkType        *selected_network,
+                                                    GArray                  **radio_interfaces);
+
+/**
+ * qmi_nas_state_snapshot_get_roaming_indicator:
+ * @self: a #QmiNasStateSnapshot.
+ * @roaming_indicator: (out) (allow-none): a placeholder for the output #QmiNasRoamingIndicatorStatus, or %NULL if not required.
+ *
+ * Gets whether the device is roaming.
+ *
+ * Returns: %TRUE if the value is known, %FALSE otherwise.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_nas_state_snapshot_get_roaming_indicator (QmiNasStateSnapshot          *self,
+                                                       QmiNasRoamingIndicatorStatus *roaming_indicator);
+
+/**
+ * qmi_nas_state_snapshot_get_current_plmn:
+ * @self: a #QmiNasStateSnapshot.
+ * @mcc: (out) (allow-none): a placeholder for the output MCC, or %NULL if not required.
+ * @mnc: (out) (allow-none): a placeholder for the output MNC, or %NULL if not required.
+ * @description: (out) (allow-none) (transfer none): a placeholder for the output network description, or %NULL if not required. Do not free it, it is owned by @self.
+ *
+ * Gets the network the device is registered in.
+ *
+ * Returns: %TRUE if the values are known, %FALSE otherwise.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_nas_state_snapshot_get_current_plmn (QmiNasStateSnapshot  *self,
+                                                  guint16              *mcc,
+                                                  guint16              *mnc,
+                                                  const gchar         **description);
+
+/**
+ * qmi_nas_state_snapshot_get_lac_3gpp:
+ * @self: a #QmiNasStateSnapshot.
+ * @lac: (out) (allow-none): a placeholder for the output location area code, or %NULL if not required.
+ *
+ * Gets the 3GPP location area code of the serving cell.
+ *
+ * Returns: %TRUE if the value is known, %FALSE otherwise.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_nas_state_snapshot_get_lac_3gpp (QmiNasStateSnapshot *self,
+                                              guint16             *lac);
+
+/**
+ * qmi_nas_state_snapshot_get_cid_3gpp:
+ * @self: a #QmiNasStateSnapshot.
+ * @cid: (out) (allow-none): a placeholder for the output cell ID, or %NULL if not required.
+ *
+ * Gets the 3GPP cell ID of the serving cell.
+ *
+ * Returns: %TRUE if the value is known, %FALSE otherwise.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_nas_state_snapshot_get_cid_3gpp (QmiNasStateSnapshot *self,
+                                              guint32             *cid);
+
+/**
+ * qmi_nas_state_snapshot_get_lte_tac:
+ * @self: a #QmiNasStateSnapshot.
+ * @tac: (out) (allow-none): a placeholder for the output tracking area code, or %NULL if not required.
+ *
+ * Gets the LTE tracking area code of the serving cell.
+ *
+ * Returns: %TRUE if the value is known, %FALSE otherwise.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_nas_state_snapshot_get_lte_tac (QmiNasStateSnapshot *self,
+                                             guint16             *tac);
+
+/**
+ * qmi_nas_state_snapshot_get_cdma_signal_strength:
+ * @self: a #QmiNasStateSnapshot.
+ * @rssi: (out) (allow-none): a placeholder for the output RSSI, in dBm, or %NULL if not required.
+ * @ecio: (out) (allow-none): a placeholder for the output ECIO, in units of -0.5 dBm, or %NULL if not required.
+ *
+ * Gets the CDMA signal strength.
+ *
+ * Returns: %TRUE if the values are known, %FALSE otherwise.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_nas_state_snapshot_get_cdma_signal_strength (QmiNasStateSnapshot *self,
+                                                          gint8               *rssi,
+                                                          gint16              *ecio);
+
+/**
+ * qmi_nas_state_snapshot_get_hdr_signal_strength:
+ * @self: a #QmiNasStateSnapshot.
+ * @rssi: (out) (allow-none): a placeholder for the output RSSI, in dBm, or %NULL if not required.
+ * @ecio: (out) (allow-none): a placeholder for the output ECIO, in units of -0.5 dBm, or %NULL if not required.
+ * @sinr: (out) (allow-none): a placeholder for the output #QmiNasEvdoSinrLevel, or %NULL if not required.
+ * @io: (out) (allow-none): a placeholder for the output IO, in dBm, or %NULL if not required.
+ *
+ * Gets the HDR signal strength.
+ *
+ * Returns: %TRUE if the values are known, %FALSE otherwise.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_nas_state_snapshot_get_hdr_signal_strength (QmiNasStateSnapshot *self,
+                                                         gint8               *rssi,
+                                                         gint16              *ecio,
+                                                         QmiNasEvdoSinrLevel *sinr,
+                                                         gint32              *io);
+
+/**
+ * qmi_nas_state_snapshot_get_gsm_signal_strength:
+ * @self: a #QmiNasStateSnapshot.
+ * @rssi: (out) (allow-none): a placeholder for the output RSSI, in dBm, or %NULL if not required.
+ *
+ * Gets the GSM signal strength.
+ *
+ * Returns: %TRUE if the value is known, %FALSE otherwise.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_nas_state_snapshot_get_gsm_signal_strength (QmiNasStateSnapshot *self,
+                                                         gint8               *rssi);
+
+/**
+ * qmi_nas_state_snapshot_get_wcdma_signal_strength:
+ * @self: a #QmiNasStateSnapshot.
+ * @rssi: (out) (allow-none): a placeholder for the output RSSI, in dBm, or %NULL if not required.
+ * @ecio: (out) (allow-none): a placeholder for the output ECIO, in units of -0.5 dBm, or %NULL if not required.
+ *
+ * Gets the WCDMA signal strength.
+ *
+ * Returns: %TRUE if the values are known, %FALSE otherwise.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_nas_state_snapshot_get_wcdma_signal_strength (QmiNasStateSnapshot *self,
+                                                           gint8               *rssi,
+                                                           gint16              *ecio);
+
+/**
+ * qmi_nas_state_snapshot_get_lte_signal_strength:
+ * @self: a #QmiNasStateSnapshot.
+ * @rssi: (out) (allow-none): a placeholder for the output RSSI, in dBm, or %NULL if not required.
+ * @rsrq: (out) (allow-none): a placeholder for the output RSRQ, in dB, or %NULL if not required.
+ * @rsrp: (out) (allow-none): a placeholder for the output RSRP, in dBm, or %NULL if not required.
+ * @snr: (out) (allow-none): a placeholder for the output SNR, in units of 0.1 dB, or %NULL if not required.
+ *
+ * Gets the LTE signal strength.
+ *
+ * Returns: %TRUE if the values are known, %FALSE otherwise.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_nas_state_snapshot_get_lte_signal_strength (QmiNasStateSnapshot *self,
+                                                         gint8               *rssi,
+                                                         gint8               *rsrq,
+                                                         gint16              *rsrp,
+                                                         gint16              *snr);
+
+/*****************************************************************************/
+
+#define QMI_TYPE_NAS_STATE_MIRROR            (qmi_nas_state_mirror_get_type ())
+#define QMI_NAS_STATE_MIRROR(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), QMI_TYPE_NAS_STATE_MIRROR, QmiNasStateMirror))
+#define QMI_NAS_STATE_MIRROR_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  QMI_TYPE_NAS_STATE_MIRROR, QmiNasStateMirrorClass))
+#define QMI_IS_NAS_STATE_MIRROR(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), QMI_TYPE_NAS_STATE_MIRROR))
+#define QMI_IS_NAS_STATE_MIRROR_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  QMI_TYPE_NAS_STATE_MIRROR))
+#define QMI_NAS_STATE_MIRROR_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  QMI_TYPE_NAS_STATE_MIRROR, QmiNasStateMirrorClass))
+
+typedef struct _QmiNasStateMirror QmiNasStateMirror;
+typedef struct _QmiNasStateMirrorClass QmiNasStateMirrorClass;
+typedef struct _QmiNasStateMirrorPrivate QmiNasStateMirrorPrivate;
+
+/**
+ * QMI_NAS_STATE_MIRROR_CLIENT:
+ *
+ * Symbol defining the #QmiNasStateMirror:nas-state-mirror-client property.
+ *
+ * Since: 1.20
+ */
+#define QMI_NAS_STATE_MIRROR_CLIENT "nas-state-mirror-client"
+
+/**
+ * QMI_NAS_STATE_MIRROR_SIGNAL_RESOLUTION:
+ *
+ * Symbol defining the #QmiNasStateMirror:nas-state-mirror-signal-resolution property.
+ *
+ * Since: 1.20
+ */
+#define QMI_NAS_STATE_MIRROR_SIGNAL_RESOLUTION "nas-state-mirror-signal-resolution"
+
+/**
+ * QMI_NAS_STATE_MIRROR_SIGNAL_UPDATED:
+ *
+ * Symbol defining the #QmiNasStateMirror::updated signal.
+ *
+ * Since: 1.20
+ */
+#define QMI_NAS_STATE_MIRROR_SIGNAL_UPDATED "updated"
+
+/**
+ * QmiNasStateMirror:
+ *
+ * The #QmiNasStateMirror structure contains private data and should only be
+ * accessed using the provided API.
+ *
+ * Since: 1.20
+ */
+struct _QmiNasStateMirror {
+    /*< private >*/
+    GObject parent;
+    QmiNasStateMirrorPrivate *priv;
+};
+
+struct _QmiNasStateMirrorClass {
+    /*< private >*/
+    GObjectClass parent;
+};
+
+GType qmi_nas_state_mirror_get_type (void);
+
+/**
+ * qmi_nas_state_mirror_new:
+ * @client: a #QmiClientNas.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the initialization is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously creates a #QmiNasStateMirror fed from the indications
+ * received by @client, and loads its initial state.
+ *
+ * Requests not supported by the device are just skipped, the corresponding
+ * state being left unknown until reported in an indication.
+ *
+ * When the operation is finished, @callback will be invoked in the
+ * <link linkend="g-main-context-push-thread-default">thread-default main context</link>
+ * of the thread you are calling this method from. You can then call
+ * qmi_nas_state_mirror_new_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_nas_state_mirror_new (QmiClientNas        *client,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data);
+
+/**
+ * qmi_nas_state_mirror_new_full:
+ * @client: a #QmiClientNas.
+ * @signal_resolution: smallest signal change to report, in dB, up to 30; or 0 to report every change.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the initialization is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously creates a #QmiNasStateMirror, like qmi_nas_state_mirror_new().
+ *
+ * If @signal_resolution is given, the device is configured to send Signal
+ * Info indications only when the RSSI, RSCP, ECIO, RSRQ, RSRP or LTE SNR
+ * cross one of a set of thresholds spaced @signal_resolution dB apart, and
+ * to report and average the LTE measurements less often as the resolution
+ * gets coarser. On top of that, indications with values that moved less than
+ * @signal_resolution dB from the ones last reported are ignored, so that a
+ * value oscillating around one of the thresholds doesn't update the state
+ * over and over.
+ *
+ * When the operation is finished, @callback will be invoked in the
+ * <link linkend="g-main-context-push-thread-default">thread-default main context</link>
+ * of the thread you are calling this method from. You can then call
+ * qmi_nas_state_mirror_new_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_nas_state_mirror_new_full (QmiClientNas        *client,
+                                    guint                signal_resolution,
+                                    GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data);
+
+/**
+ * qmi_nas_state_mirror_new_finish:
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_nas_state_mirror_new().
+ *
+ * Returns: (transfer full): a newly created #QmiNasStateMirror, or %NULL if @error is set.
+ *
+ * Since: 1.20
+ */
+QmiNasStateMirror *qmi_nas_state_mirror_new_finish (GAsyncResult  *res,
+                                                    GError       **error);
+
+/**
+ * qmi_nas_state_mirror_peek_client:
+ * @self: a #QmiNasStateMirror.
+ *
+ * Get the #QmiClientNas feeding the mirror, without increasing the reference
+ * count on the returned object.
+ *
+ * Returns: (transfer none): a #QmiClientNas. Do not free the returned object, it is owned by @self.
+ *
+ * Since: 1.20
+ */
+QmiClientNas *qmi_nas_state_mirror_peek_client (QmiNasStateMirror *self);
+
+/**
+ * qmi_nas_state_mirror_get_snapshot:
+ * @self: a #QmiNasStateMirror.
+ *
+ * Gets the current state of the mirror, without any QMI request.
+ *
+ * This method may be called from any thread.
+ *
+ * Returns: (transfer full): a #QmiNasStateSnapshot. The returned value should be freed with qmi_nas_state_snapshot_unref().
+ *
+ * Since: 1.20
+ */
+QmiNasStateSnapshot *qmi_nas_state_mirror_get_snapshot (QmiNasStateMirror *self);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_NAS_STATE_MIRROR_H_ */
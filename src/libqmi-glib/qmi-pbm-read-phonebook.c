@@ -0,0 +1,430 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "qmi-pbm-read-phonebook.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+/* Timeout of each request sent */
+#define REQUEST_TIMEOUT 10
+
+/* Maximum time to wait for the next indication of a page */
+#define INDICATION_TIMEOUT 10
+
+/* PBM Record Read indication, read directly from the raw message */
+#define RECORD_READ_INDICATION_ID      0x0004
+#define RECORD_READ_TLV_BASIC_DATA     0x01
+
+/* Sequence number (2), session type (1), phonebook type (2) and the number
+ * of records (1) */
+#define BASIC_DATA_HEADER_SIZE 6
+
+/* Record ID (2), number type (1), number plan (1) and number length (1) */
+#define RECORD_HEADER_SIZE 5
+
+typedef struct {
+    QmiPbmSessionType            session_type;
+    QmiPbmPhonebookType          phonebook_type;
+    guint16                      last_record_id;
+    guint                        batch_size;
+    QmiPbmReadPhonebookCallback  records_callback;
+    gpointer                     records_callback_data;
+
+    /* Record IDs in the page being read, [page_start, page_end] */
+    guint                        page_start;
+    guint                        page_end;
+    gboolean                     page_expected_known;
+    guint                        page_expected;
+    guint                        page_received;
+
+    /* Records read and not yet given to the user, allocated once */
+    QmiPbmRecord                *batch;
+    guint                        n_batch;
+    guint                        n_records;
+
+    guint                        indication_id;
+    GSource                     *timeout_source;
+    GSource                     *cancellable_source;
+    gboolean                     completed;
+} ReadPhonebookContext;
+
+static void
+read_phonebook_context_free (ReadPhonebookContext *ctx)
+{
+    g_assert (!ctx->indication_id);
+    g_assert (!ctx->timeout_source);
+    g_assert (!ctx->cancellable_source);
+
+    g_free (ctx->batch);
+    g_slice_free (ReadPhonebookContext, ctx);
+}
+
+gboolean
+qmi_client_pbm_read_phonebook_finish (QmiClientPbm  *self,
+                                      GAsyncResult  *res,
+                                      guint         *n_records,
+                                      GError       **error)
+{
+    if (!g_task_propagate_boolean (G_TASK (res), error))
+        return FALSE;
+
+    if (n_records)
+        *n_records = ((ReadPhonebookContext *) g_task_get_task_data (G_TASK (res)))->n_records;
+    return TRUE;
+}
+
+static void
+read_phonebook_complete (GTask  *task,
+                         GError *error)
+{
+    ReadPhonebookContext *ctx;
+
+    ctx = g_task_get_task_data (task);
+
+    /* Requests still in flight may fail after the operation is over */
+    if (ctx->completed) {
+        if (error)
+            g_error_free (error);
+        return;
+    }
+    ctx->completed = TRUE;
+
+    if (ctx->indication_id) {
+        qmi_client_remove_indication_callback (QMI_CLIENT (g_task_get_source_object (task)), ctx->indication_id);
+        ctx->indication_id = 0;
+    }
+    if (ctx->timeout_source) {
+        g_source_destroy (ctx->timeout_source);
+        g_source_unref (ctx->timeout_source);
+        ctx->timeout_source = NULL;
+    }
+    if (ctx->cancellable_source) {
+        g_source_destroy (ctx->cancellable_source);
+        g_source_unref (ctx->cancellable_source);
+        ctx->cancellable_source = NULL;
+    }
+
+    if (error)
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
+
+    /* Drop the reference held while running */
+    g_object_unref (task);
+}
+
+static gboolean
+read_phonebook_timeout_cb (GTask *task)
+{
+    read_phonebook_complete (task,
+                             g_error_new (QMI_CORE_ERROR,
+                                          QMI_CORE_ERROR_TIMEOUT,
+                                          "No record read indication received"));
+    return G_SOURCE_REMOVE;
+}
+
+static void
+read_phonebook_timeout_reset (GTask    *task,
+                              gboolean  waiting)
+{
+    ReadPhonebookContext *ctx;
+
+    ctx = g_task_get_task_data (task);
+
+    if (ctx->timeout_source) {
+        g_source_destroy (ctx->timeout_source);
+        g_source_unref (ctx->timeout_source);
+        ctx->timeout_source = NULL;
+    }
+
+    if (!waiting)
+        return;
+
+    ctx->timeout_source = g_timeout_source_new_seconds (INDICATION_TIMEOUT);
+    g_source_set_callback (ctx->timeout_source, (GSourceFunc) read_phonebook_timeout_cb, task, NULL);
+    g_source_attach (ctx->timeout_source, g_task_get_context (task));
+}
+
+static gboolean
+read_phonebook_cancelled_cb (GCancellable *cancellable,
+                             GTask        *task)
+{
+    read_phonebook_complete (task,
+                             g_error_new (G_IO_ERROR,
+                                          G_IO_ERROR_CANCELLED,
+                                          "Operation was cancelled"));
+    return G_SOURCE_REMOVE;
+}
+
+static void
+batch_flush (GTask *task)
+{
+    ReadPhonebookContext *ctx;
+
+    ctx = g_task_get_task_data (task);
+    if (!ctx->n_batch)
+        return;
+
+    ctx->records_callback (QMI_CLIENT_PBM (g_task_get_source_object (task)),
+                           ctx->batch,
+                           ctx->n_batch,
+                           ctx->records_callback_data);
+    ctx->n_records += ctx->n_batch;
+    ctx->n_batch = 0;
+}
+
+static void read_phonebook_page_next (GTask *task);
+
+static void
+read_phonebook_page_check (GTask *task)
+{
+    ReadPhonebookContext *ctx;
+
+    ctx = g_task_get_task_data (task);
+
+    /* Indications are given after the response, but may be processed before */
+    if (!ctx->page_expected_known) {
+        read_phonebook_timeout_reset (task, FALSE);
+        return;
+    }
+
+    if (ctx->page_received < ctx->page_expected) {
+        read_phonebook_timeout_reset (task, TRUE);
+        return;
+    }
+
+    read_phonebook_timeout_reset (task, FALSE);
+    batch_flush (task);
+
+    /* The user may have cancelled the operation from the records callback */
+    if (!ctx->completed)
+        read_phonebook_page_next (task);
+}
+
+static void
+record_read_indication_cb (QmiClient  *client,
+                           QmiMessage *message,
+                           GTask      *task)
+{
+    ReadPhonebookContext *ctx;
+    const guint8         *raw;
+    const guint8         *walker;
+    const guint8         *end;
+    guint16               raw_length = 0;
+    guint16               value16;
+    guint                 n;
+    guint                 i;
+
+    ctx = g_task_get_task_data (task);
+
+    raw = qmi_message_get_raw_tlv (message, RECORD_READ_TLV_BASIC_DATA, &raw_length);
+    if (!raw || raw_length < BASIC_DATA_HEADER_SIZE) {
+        g_debug ("ignoring invalid record read indication");
+        return;
+    }
+
+    /* Ignore indications for other phonebooks, e.g. from other reads */
+    memcpy (&value16, &raw[3], 2);
+    if (raw[2] != ctx->session_type || GUINT16_FROM_LE (value16) != ctx->phonebook_type)
+        return;
+
+    end = raw + raw_length;
+    walker = raw + BASIC_DATA_HEADER_SIZE;
+    n = raw[BASIC_DATA_HEADER_SIZE - 1];
+    for (i = 0; i < n; i++) {
+        QmiPbmRecord *record;
+        guint16       record_id;
+        guint8        number_length;
+        guint8        name_length;
+
+        if (end - walker < RECORD_HEADER_SIZE ||
+            end - walker - RECORD_HEADER_SIZE < walker[4] + 1 ||
+            end - walker - RECORD_HEADER_SIZE - walker[4] - 1 < walker[RECORD_HEADER_SIZE + walker[4]]) {
+            g_debug ("ignoring invalid records in record read indication");
+            break;
+        }
+
+        memcpy (&record_id, &walker[0], 2);
+        record_id = GUINT16_FROM_LE (record_id);
+        number_length = walker[4];
+        name_length = walker[RECORD_HEADER_SIZE + number_length];
+
+        if (record_id >= ctx->page_start && record_id <= ctx->page_end) {
+            /* Never more than one page of records, unless the device
+             * duplicates them */
+            if (ctx->n_batch == ctx->batch_size)
+                batch_flush (task);
+
+            record = &ctx->batch[ctx->n_batch++];
+            record->record_id = record_id;
+            record->number_type = walker[2];
+            record->number_plan = walker[3];
+            memcpy (record->number, &walker[RECORD_HEADER_SIZE], number_length);
+            record->number[number_length] = '\0';
+            record->name_length = name_length;
+            memcpy (record->name, &walker[RECORD_HEADER_SIZE + number_length + 1], name_length);
+            ctx->page_received++;
+        }
+
+        walker += RECORD_HEADER_SIZE + number_length + 1 + name_length;
+    }
+
+    if (!ctx->completed)
+        read_phonebook_page_check (task);
+}
+
+static void
+read_records_ready (QmiClientPbm *self,
+                    GAsyncResult *res,
+                    GTask        *task)
+{
+    ReadPhonebookContext           *ctx;
+    QmiMessagePbmReadRecordsOutput *output;
+    GError                         *error = NULL;
+    guint16                         n_records = 0;
+
+    ctx = g_task_get_task_data (task);
+
+    output = qmi_client_pbm_read_records_finish (self, res, &error);
+    if (ctx->completed) {
+        g_clear_error (&error);
+        goto out;
+    }
+
+    if (!output) {
+        read_phonebook_complete (task, error);
+        goto out;
+    }
+
+    if (!qmi_message_pbm_read_records_output_get_result (output, &error)) {
+        /* No records in the page */
+        if (!g_error_matches (error, QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_NO_ENTRY)) {
+            read_phonebook_complete (task, error);
+            goto out;
+        }
+        g_clear_error (&error);
+    } else if (!qmi_message_pbm_read_records_output_get_number_of_records (output, &n_records, &error)) {
+        read_phonebook_complete (task, error);
+        goto out;
+    }
+
+    ctx->page_expected_known = TRUE;
+    ctx->page_expected = n_records;
+    read_phonebook_page_check (task);
+
+out:
+    if (output)
+        qmi_message_pbm_read_records_output_unref (output);
+    g_object_unref (task);
+}
+
+static void
+read_phonebook_page_next (GTask *task)
+{
+    ReadPhonebookContext          *ctx;
+    QmiMessagePbmReadRecordsInput *input;
+
+    ctx = g_task_get_task_data (task);
+
+    if (ctx->page_end >= ctx->last_record_id) {
+        read_phonebook_complete (task, NULL);
+        return;
+    }
+
+    ctx->page_start = ctx->page_end + 1;
+    ctx->page_end = MIN (ctx->page_start + ctx->batch_size - 1, (guint) ctx->last_record_id);
+    ctx->page_expected_known = FALSE;
+    ctx->page_expected = 0;
+    ctx->page_received = 0;
+
+    input = qmi_message_pbm_read_records_input_new ();
+    qmi_message_pbm_read_records_input_set_record_information (input,
+                                                               ctx->session_type,
+                                                               ctx->phonebook_type,
+                                                               ctx->page_start,
+                                                               ctx->page_end,
+                                                               NULL);
+    qmi_client_pbm_read_records (QMI_CLIENT_PBM (g_task_get_source_object (task)),
+                                 input,
+                                 REQUEST_TIMEOUT,
+                                 NULL,
+                                 (GAsyncReadyCallback) read_records_ready,
+                                 g_object_ref (task));
+    qmi_message_pbm_read_records_input_unref (input);
+}
+
+void
+qmi_client_pbm_read_phonebook (QmiClientPbm                *self,
+                               QmiPbmSessionType            session_type,
+                               QmiPbmPhonebookType          phonebook_type,
+                               guint16                      first_record_id,
+                               guint16                      last_record_id,
+                               guint                        batch_size,
+                               QmiPbmReadPhonebookCallback  records_callback,
+                               gpointer                     records_callback_data,
+                               GCancellable                *cancellable,
+                               GAsyncReadyCallback          callback,
+                               gpointer                     user_data)
+{
+    GTask                *task;
+    ReadPhonebookContext *ctx;
+
+    g_return_if_fail (QMI_IS_CLIENT_PBM (self));
+    g_return_if_fail (first_record_id > 0);
+    g_return_if_fail (batch_size > 0);
+    g_return_if_fail (records_callback != NULL);
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    ctx = g_slice_new0 (ReadPhonebookContext);
+    ctx->session_type = session_type;
+    ctx->phonebook_type = phonebook_type;
+    ctx->last_record_id = last_record_id;
+    ctx->batch_size = MIN (batch_size, (guint) G_MAXUINT16);
+    ctx->records_callback = records_callback;
+    ctx->records_callback_data = records_callback_data;
+    ctx->page_end = first_record_id - 1;
+    ctx->batch = g_new (QmiPbmRecord, ctx->batch_size);
+    g_task_set_task_data (task, ctx, (GDestroyNotify) read_phonebook_context_free);
+
+    /* The reference of the task is kept until the operation is completed,
+     * as it is used in the indication callback. Indications are read in
+     * place, without building the full list of records of each one. */
+    ctx->indication_id = qmi_client_add_indication_callback (QMI_CLIENT (self),
+                                                             RECORD_READ_INDICATION_ID,
+                                                             (QmiClientIndicationCallback) record_read_indication_cb,
+                                                             task,
+                                                             NULL);
+
+    if (cancellable) {
+        ctx->cancellable_source = g_cancellable_source_new (cancellable);
+        g_source_set_callback (ctx->cancellable_source, (GSourceFunc) read_phonebook_cancelled_cb, task, NULL);
+        g_source_attach (ctx->cancellable_source, g_task_get_context (task));
+    }
+
+    read_phonebook_page_next (task);
+}
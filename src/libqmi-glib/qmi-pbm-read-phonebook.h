@@ -0,0 +1,171 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_PBM_READ_PHONEBOOK_H_
+#define _LIBQMI_GLIB_QMI_PBM_READ_PHONEBOOK_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "qmi-enums-pbm.h"
+#include "qmi-pbm.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-pbm-read-phonebook
+ * @title: PBM phonebook reading
+ * @short_description: reading of all the records of a phonebook in batches
+ *
+ * Helpers to read a range of records of a phonebook, issuing PBM Read Records
+ * requests for consecutive pages of record IDs and collecting the records
+ * given in the PBM Record Read indications of each page.
+ *
+ * Records are delivered in batches through a callback, as soon as each page
+ * is complete, so the memory used doesn't depend on the size of the
+ * phonebook.
+ */
+
+/**
+ * QMI_PBM_RECORD_NUMBER_MAX_LENGTH:
+ *
+ * Maximum length of the number of a #QmiPbmRecord.
+ *
+ * Since: 1.20
+ */
+#define QMI_PBM_RECORD_NUMBER_MAX_LENGTH 255
+
+/**
+ * QMI_PBM_RECORD_NAME_MAX_LENGTH:
+ *
+ * Maximum length of the name of a #QmiPbmRecord, in bytes.
+ *
+ * Since: 1.20
+ */
+#define QMI_PBM_RECORD_NAME_MAX_LENGTH 255
+
+/**
+ * QmiPbmRecord:
+ * @record_id: the record ID.
+ * @number_type: the type of number.
+ * @number_plan: the numbering plan.
+ * @number: the number, NUL-terminated.
+ * @name_length: the length of @name, in bytes.
+ * @name: (array length=name_length): the name, as given by the device, usually UCS-2 encoded.
+ *
+ * A record read with qmi_client_pbm_read_phonebook().
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    guint16 record_id;
+    guint8  number_type;
+    guint8  number_plan;
+    gchar   number[QMI_PBM_RECORD_NUMBER_MAX_LENGTH + 1];
+    guint8  name_length;
+    guint8  name[QMI_PBM_RECORD_NAME_MAX_LENGTH];
+} QmiPbmRecord;
+
+/**
+ * QmiPbmReadPhonebookCallback:
+ * @self: a #QmiClientPbm.
+ * @records: (array length=n_records): the #QmiPbmRecord values read.
+ * @n_records: the number of records in @records, at least 1.
+ * @user_data: the user data given to qmi_client_pbm_read_phonebook().
+ *
+ * Callback to get the records read by qmi_client_pbm_read_phonebook(). The
+ * records are owned by the operation, and are only valid during the call.
+ *
+ * Since: 1.20
+ */
+typedef void (* QmiPbmReadPhonebookCallback) (QmiClientPbm       *self,
+                                              const QmiPbmRecord *records,
+                                              guint               n_records,
+                                              gpointer            user_data);
+
+/**
+ * qmi_client_pbm_read_phonebook:
+ * @self: a #QmiClientPbm.
+ * @session_type: a #QmiPbmSessionType.
+ * @phonebook_type: a #QmiPbmPhonebookType.
+ * @first_record_id: the first record ID to read, at least 1.
+ * @last_record_id: the last record ID to read, usually the maximum number of records reported by PBM Get Capabilities.
+ * @batch_size: the number of record IDs in each PBM Read Records request, at least 1.
+ * @records_callback: a #QmiPbmReadPhonebookCallback to call with each batch of records read.
+ * @records_callback_data: user data to pass to @records_callback.
+ * @cancellable: a #GCancellable or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: user data to pass to @callback.
+ *
+ * Asynchronously reads all the records with IDs between @first_record_id and
+ * @last_record_id in the given phonebook.
+ *
+ * The range is read in pages of @batch_size record IDs, one PBM Read Records
+ * request at a time. Once all the records of a page are given in PBM Record
+ * Read indications, @records_callback is called with them, and the next
+ * page is requested. Empty records are not reported by the device, so
+ * batches may have less than @batch_size records, and pages without records
+ * don't result in any call to @records_callback.
+ *
+ * When the operation is finished, @callback will be called. You can then call
+ * qmi_client_pbm_read_phonebook_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_client_pbm_read_phonebook (QmiClientPbm                *self,
+                                    QmiPbmSessionType            session_type,
+                                    QmiPbmPhonebookType          phonebook_type,
+                                    guint16                      first_record_id,
+                                    guint16                      last_record_id,
+                                    guint                        batch_size,
+                                    QmiPbmReadPhonebookCallback  records_callback,
+                                    gpointer                     records_callback_data,
+                                    GCancellable                *cancellable,
+                                    GAsyncReadyCallback          callback,
+                                    gpointer                     user_data);
+
+/**
+ * qmi_client_pbm_read_phonebook_finish:
+ * @self: a #QmiClientPbm.
+ * @res: the #GAsyncResult obtained from the #GAsyncReadyCallback passed to qmi_client_pbm_read_phonebook().
+ * @n_records: (out) (optional): return location for the total number of records read, or %NULL.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an async operation started with qmi_client_pbm_read_phonebook().
+ *
+ * Returns: %TRUE if all the records were read, %FALSE if @error is set.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_client_pbm_read_phonebook_finish (QmiClientPbm  *self,
+                                               GAsyncResult  *res,
+                                               guint         *n_records,
+                                               GError       **error);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_PBM_READ_PHONEBOOK_H_ */
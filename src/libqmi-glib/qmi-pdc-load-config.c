@@ -0,0 +1,464 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "qmi-pdc-load-config.h"
+#include "qmi-message.h"
+#include "qmi-message-context.h"
+#include "qmi-device.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+/* Timeout of each request sent */
+#define REQUEST_TIMEOUT 10
+
+/* Maximum time to wait for the indication of the oldest chunk in flight */
+#define INDICATION_TIMEOUT 10
+
+/* PDC Load Config request, built here instead of with the generated
+ * QmiMessagePdcLoadConfigInput, so that the chunk is written straight from
+ * the mapped file into the message and not copied into a GArray first. */
+#define MESSAGE_PDC_LOAD_CONFIG 0x0026
+#define TLV_CONFIG_CHUNK        0x01
+#define TLV_RESULT              0x02
+#define TLV_TOKEN               0x10
+
+typedef struct {
+    GMappedFile             *mapped_file;
+    const guint8            *contents;
+    gsize                    size;
+    GArray                  *id;
+    QmiPdcConfigurationType  config_type;
+    guint                    window;
+    GFileProgressCallback    progress_callback;
+    gpointer                 progress_callback_data;
+    QmiMessageContext       *message_context;
+
+    /* Chunks with tokens in [acked_token, next_token) are in flight */
+    guint32                  acked_token;
+    guint32                  next_token;
+    gsize                    offset;
+
+    gulong                   indication_id;
+    GSource                 *timeout_source;
+    GSource                 *cancellable_source;
+    gboolean                 completed;
+} LoadConfigContext;
+
+static void
+load_config_context_free (LoadConfigContext *ctx)
+{
+    g_assert (!ctx->indication_id);
+    g_assert (!ctx->timeout_source);
+    g_assert (!ctx->cancellable_source);
+
+    qmi_message_context_unref (ctx->message_context);
+    g_array_unref (ctx->id);
+    g_mapped_file_unref (ctx->mapped_file);
+    g_slice_free (LoadConfigContext, ctx);
+}
+
+GArray *
+qmi_client_pdc_load_config_from_file_finish (QmiClientPdc  *self,
+                                             GAsyncResult  *res,
+                                             GError       **error)
+{
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+static void
+load_config_complete (GTask  *task,
+                      GError *error)
+{
+    LoadConfigContext *ctx;
+
+    ctx = g_task_get_task_data (task);
+
+    /* Requests still in flight may fail after the operation is over */
+    if (ctx->completed) {
+        if (error)
+            g_error_free (error);
+        return;
+    }
+    ctx->completed = TRUE;
+
+    if (ctx->indication_id) {
+        g_signal_handler_disconnect (g_task_get_source_object (task), ctx->indication_id);
+        ctx->indication_id = 0;
+    }
+    if (ctx->timeout_source) {
+        g_source_destroy (ctx->timeout_source);
+        g_source_unref (ctx->timeout_source);
+        ctx->timeout_source = NULL;
+    }
+    if (ctx->cancellable_source) {
+        g_source_destroy (ctx->cancellable_source);
+        g_source_unref (ctx->cancellable_source);
+        ctx->cancellable_source = NULL;
+    }
+
+    if (error)
+        g_task_return_error (task, error);
+    else
+        g_task_return_pointer (task, g_array_ref (ctx->id), (GDestroyNotify) g_array_unref);
+
+    /* Drop the reference held while running */
+    g_object_unref (task);
+}
+
+static gboolean
+load_config_timeout_cb (GTask *task)
+{
+    load_config_complete (task,
+                          g_error_new (QMI_CORE_ERROR,
+                                       QMI_CORE_ERROR_TIMEOUT,
+                                       "No load config indication received"));
+    return G_SOURCE_REMOVE;
+}
+
+static void
+load_config_timeout_reset (GTask *task)
+{
+    LoadConfigContext *ctx;
+
+    ctx = g_task_get_task_data (task);
+
+    if (ctx->timeout_source) {
+        g_source_destroy (ctx->timeout_source);
+        g_source_unref (ctx->timeout_source);
+        ctx->timeout_source = NULL;
+    }
+
+    if (ctx->completed || ctx->next_token == ctx->acked_token)
+        return;
+
+    ctx->timeout_source = g_timeout_source_new_seconds (INDICATION_TIMEOUT);
+    g_source_set_callback (ctx->timeout_source, (GSourceFunc) load_config_timeout_cb, task, NULL);
+    g_source_attach (ctx->timeout_source, g_task_get_context (task));
+}
+
+static gboolean
+load_config_cancelled_cb (GCancellable *cancellable,
+                          GTask        *task)
+{
+    load_config_complete (task,
+                          g_error_new (G_IO_ERROR,
+                                       G_IO_ERROR_CANCELLED,
+                                       "Operation was cancelled"));
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+load_config_response_get_result (QmiMessage  *reply,
+                                 GError     **error)
+{
+    const guint8 *raw;
+    guint16       raw_length;
+    guint16       error_status;
+    guint16       error_code;
+
+    raw = qmi_message_get_raw_tlv (reply, TLV_RESULT, &raw_length);
+    if (!raw || raw_length < 4) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_TLV_NOT_FOUND,
+                     "No 'Result' field given in the message");
+        return FALSE;
+    }
+
+    memcpy (&error_status, &raw[0], 2);
+    memcpy (&error_code, &raw[2], 2);
+    error_status = GUINT16_FROM_LE (error_status);
+    error_code = GUINT16_FROM_LE (error_code);
+
+    /* QMI_STATUS_SUCCESS */
+    if (error_status == 0x0000)
+        return TRUE;
+
+    g_set_error (error,
+                 QMI_PROTOCOL_ERROR,
+                 (QmiProtocolError) error_code,
+                 "QMI protocol error (%u): '%s'",
+                 error_code,
+                 qmi_protocol_error_get_string ((QmiProtocolError) error_code));
+    return FALSE;
+}
+
+static void
+load_config_chunk_ready (QmiDevice    *device,
+                         GAsyncResult *res,
+                         GTask        *task)
+{
+    QmiMessage *reply;
+    GError     *error = NULL;
+
+    reply = qmi_device_command_full_finish (device, res, &error);
+    if (!reply || !load_config_response_get_result (reply, &error)) {
+        g_prefix_error (&error, "Couldn't load config chunk: ");
+        load_config_complete (task, error);
+    }
+
+    /* On success, wait for the indication */
+    if (reply)
+        qmi_message_unref (reply);
+    g_object_unref (task);
+}
+
+static QmiMessage *
+load_config_request_create (QmiClientPdc       *self,
+                            LoadConfigContext  *ctx,
+                            gsize               chunk_size,
+                            GError            **error)
+{
+    QmiMessage *request;
+    gsize       tlv_offset;
+
+    /* Compute the size of all the TLVs to add, so that the message is
+     * allocated once */
+    request = __qmi_message_new_sized (QMI_SERVICE_PDC,
+                                       qmi_client_get_cid (QMI_CLIENT (self)),
+                                       qmi_client_get_next_transaction_id (QMI_CLIENT (self)),
+                                       MESSAGE_PDC_LOAD_CONFIG,
+                                       ((3 + sizeof (guint32)) +
+                                        (3 + sizeof (guint32) + sizeof (guint8) + ctx->id->len + sizeof (guint32) + sizeof (guint16) + chunk_size)));
+
+    if (!(tlv_offset = qmi_message_tlv_write_init (request, TLV_TOKEN, error)) ||
+        !qmi_message_tlv_write_guint32 (request, QMI_ENDIAN_LITTLE, ctx->next_token, error) ||
+        !qmi_message_tlv_write_complete (request, tlv_offset, error)) {
+        g_prefix_error (error, "Cannot write TLV 'Token': ");
+        goto error_out;
+    }
+
+    /* The config id and the chunk are both arrays of bytes, written in the
+     * same way as length-prefixed strings */
+    if (!(tlv_offset = qmi_message_tlv_write_init (request, TLV_CONFIG_CHUNK, error)) ||
+        !qmi_message_tlv_write_guint32 (request, QMI_ENDIAN_LITTLE, (guint32) ctx->config_type, error) ||
+        !qmi_message_tlv_write_string (request, 1, (const gchar *) ctx->id->data, ctx->id->len, error) ||
+        !qmi_message_tlv_write_guint32 (request, QMI_ENDIAN_LITTLE, (guint32) ctx->size, error) ||
+        !qmi_message_tlv_write_string (request, 2, (const gchar *) &ctx->contents[ctx->offset], chunk_size, error) ||
+        !qmi_message_tlv_write_complete (request, tlv_offset, error)) {
+        g_prefix_error (error, "Cannot write TLV 'Config Chunk': ");
+        goto error_out;
+    }
+
+    return request;
+
+error_out:
+    qmi_message_unref (request);
+    return NULL;
+}
+
+static void
+load_config_send_chunks (GTask *task)
+{
+    QmiClientPdc      *self;
+    LoadConfigContext *ctx;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    while (!ctx->completed &&
+           ctx->offset < ctx->size &&
+           (ctx->next_token - ctx->acked_token) < ctx->window) {
+        QmiMessage *request;
+        GError     *error = NULL;
+        gsize       chunk_size;
+
+        if (!qmi_client_is_valid (QMI_CLIENT (self))) {
+            load_config_complete (task, g_error_new (QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE, "client invalid"));
+            return;
+        }
+
+        chunk_size = MIN (QMI_PDC_LOAD_CONFIG_CHUNK_SIZE, ctx->size - ctx->offset);
+        request = load_config_request_create (self, ctx, chunk_size, &error);
+        if (!request) {
+            g_prefix_error (&error, "Couldn't create request message: ");
+            load_config_complete (task, error);
+            return;
+        }
+
+        qmi_device_command_full (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
+                                 request,
+                                 ctx->message_context,
+                                 REQUEST_TIMEOUT,
+                                 g_task_get_cancellable (task),
+                                 (GAsyncReadyCallback) load_config_chunk_ready,
+                                 g_object_ref (task));
+        qmi_message_unref (request);
+
+        ctx->offset += chunk_size;
+        ctx->next_token++;
+    }
+
+    load_config_timeout_reset (task);
+}
+
+static void
+load_config_indication_cb (QmiClientPdc                     *self,
+                           QmiIndicationPdcLoadConfigOutput *output,
+                           GTask                            *task)
+{
+    LoadConfigContext *ctx;
+    GError            *error = NULL;
+    guint32            token;
+    guint16            error_code = 0;
+    gboolean           frame_reset = FALSE;
+    guint32            remaining_size;
+
+    ctx = g_task_get_task_data (task);
+
+    /* Ignore indications of chunks not in flight, e.g. from other loads */
+    if (qmi_indication_pdc_load_config_output_get_token (output, &token, NULL)) {
+        if ((token - ctx->acked_token) >= (ctx->next_token - ctx->acked_token))
+            return;
+        ctx->acked_token = token + 1;
+    } else if (ctx->next_token != ctx->acked_token)
+        ctx->acked_token++;
+    else
+        return;
+
+    if (!qmi_indication_pdc_load_config_output_get_indication_result (output, &error_code, &error)) {
+        load_config_complete (task, error);
+        return;
+    }
+
+    if (error_code != QMI_PROTOCOL_ERROR_NONE) {
+        load_config_complete (task,
+                              g_error_new (QMI_PROTOCOL_ERROR,
+                                           (QmiProtocolError) error_code,
+                                           "Couldn't load config: QMI protocol error (%u): '%s'",
+                                           error_code,
+                                           qmi_protocol_error_get_string ((QmiProtocolError) error_code)));
+        return;
+    }
+
+    /* The device may ask to restart the whole load */
+    if (qmi_indication_pdc_load_config_output_get_frame_reset (output, &frame_reset, NULL) && frame_reset) {
+        load_config_complete (task,
+                              g_error_new (QMI_CORE_ERROR,
+                                           QMI_CORE_ERROR_FAILED,
+                                           "Couldn't load config: frame reset requested"));
+        return;
+    }
+
+    if (!qmi_indication_pdc_load_config_output_get_remaining_size (output, &remaining_size, &error)) {
+        load_config_complete (task, error);
+        return;
+    }
+
+    if (ctx->progress_callback)
+        ctx->progress_callback ((goffset) (ctx->size - MIN (remaining_size, ctx->size)),
+                                (goffset) ctx->size,
+                                ctx->progress_callback_data);
+
+    if (remaining_size == 0) {
+        load_config_complete (task, NULL);
+        return;
+    }
+
+    load_config_send_chunks (task);
+}
+
+void
+qmi_client_pdc_load_config_from_file (QmiClientPdc            *self,
+                                      const gchar             *path,
+                                      QmiPdcConfigurationType  config_type,
+                                      guint                    window,
+                                      GFileProgressCallback    progress_callback,
+                                      gpointer                 progress_callback_data,
+                                      GCancellable            *cancellable,
+                                      GAsyncReadyCallback      callback,
+                                      gpointer                 user_data)
+{
+    GTask             *task;
+    LoadConfigContext *ctx;
+    GMappedFile       *mapped_file;
+    GChecksum         *checksum;
+    gsize              digest_size;
+    GError            *error = NULL;
+
+    g_return_if_fail (QMI_IS_CLIENT_PDC (self));
+    g_return_if_fail (path != NULL);
+    g_return_if_fail (window > 0);
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    if (!(mapped_file = g_mapped_file_new (path, FALSE, &error))) {
+        g_prefix_error (&error, "Couldn't map config file: ");
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    if (g_mapped_file_get_length (mapped_file) == 0 || g_mapped_file_get_length (mapped_file) > G_MAXUINT32) {
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_INVALID_ARGS,
+                                 "Invalid config file size: %" G_GSIZE_FORMAT,
+                                 g_mapped_file_get_length (mapped_file));
+        g_mapped_file_unref (mapped_file);
+        g_object_unref (task);
+        return;
+    }
+
+    ctx = g_slice_new0 (LoadConfigContext);
+    ctx->mapped_file = mapped_file;
+    ctx->contents = (const guint8 *) g_mapped_file_get_contents (mapped_file);
+    ctx->size = g_mapped_file_get_length (mapped_file);
+    ctx->config_type = config_type;
+    ctx->window = window;
+    ctx->progress_callback = progress_callback;
+    ctx->progress_callback_data = progress_callback_data;
+    ctx->message_context = qmi_message_context_new ();
+    qmi_message_context_set_priority (ctx->message_context, QMI_MESSAGE_PRIORITY_LOW);
+    ctx->acked_token = ctx->next_token = g_random_int ();
+
+    /* The id of the config is the SHA-1 of its contents */
+    digest_size = g_checksum_type_get_length (G_CHECKSUM_SHA1);
+    ctx->id = g_array_sized_new (FALSE, FALSE, sizeof (guint8), digest_size);
+    g_array_set_size (ctx->id, digest_size);
+    checksum = g_checksum_new (G_CHECKSUM_SHA1);
+    g_checksum_update (checksum, ctx->contents, ctx->size);
+    g_checksum_get_digest (checksum, (guint8 *) ctx->id->data, &digest_size);
+    g_checksum_free (checksum);
+
+    g_task_set_task_data (task, ctx, (GDestroyNotify) load_config_context_free);
+
+    /* The reference of the task is kept until the operation is completed,
+     * as it is used in the indication handler */
+    ctx->indication_id = g_signal_connect (self,
+                                           "load-config",
+                                           G_CALLBACK (load_config_indication_cb),
+                                           task);
+
+    if (cancellable) {
+        ctx->cancellable_source = g_cancellable_source_new (cancellable);
+        g_source_set_callback (ctx->cancellable_source, (GSourceFunc) load_config_cancelled_cb, task, NULL);
+        g_source_attach (ctx->cancellable_source, g_task_get_context (task));
+    }
+
+    load_config_send_chunks (task);
+}
@@ -0,0 +1,119 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_PDC_LOAD_CONFIG_H_
+#define _LIBQMI_GLIB_QMI_PDC_LOAD_CONFIG_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "qmi-enums-pdc.h"
+#include "qmi-pdc.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-pdc-load-config
+ * @title: PDC config loading
+ * @short_description: loading of config files using the PDC service
+ *
+ * Helpers to load a whole config file (e.g. a carrier MBN) in the device,
+ * handling the chunking of the file in PDC Load Config requests and the
+ * indications the device reports for each of them.
+ */
+
+/**
+ * QMI_PDC_LOAD_CONFIG_CHUNK_SIZE:
+ *
+ * Size of each chunk of the config file sent in a PDC Load Config request.
+ *
+ * Since: 1.20
+ */
+#define QMI_PDC_LOAD_CONFIG_CHUNK_SIZE 0x400
+
+/**
+ * qmi_client_pdc_load_config_from_file:
+ * @self: a #QmiClientPdc.
+ * @path: path to the config file.
+ * @config_type: a #QmiPdcConfigurationType.
+ * @window: maximum number of chunks sent and not yet acknowledged by the device, at least 1.
+ * @progress_callback: (nullable): function to report the progress of the operation, or %NULL.
+ * @progress_callback_data: (closure progress_callback): data to pass to @progress_callback.
+ * @cancellable: a #GCancellable or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: user data to pass to @callback.
+ *
+ * Asynchronously loads the config file at @path in the device.
+ *
+ * The file is memory-mapped and each chunk is written straight from the
+ * mapping into its request. The id of the config is the SHA-1 digest of the
+ * file contents.
+ *
+ * A @window of 1 waits for the Load Config indication of each chunk before
+ * sending the next one. Larger values keep up to @window chunks in flight,
+ * which speeds up the load considerably in devices that queue the chunks
+ * received; the operation fails if the device doesn't.
+ *
+ * Every time the device reports the amount of data still to be received,
+ * @progress_callback is called with the number of bytes already loaded and
+ * the total size of the file.
+ *
+ * When the operation is finished, @callback will be called. You can then call
+ * qmi_client_pdc_load_config_from_file_finish() to get the result of the
+ * operation.
+ *
+ * Since: 1.20
+ */
+void qmi_client_pdc_load_config_from_file (QmiClientPdc            *self,
+                                           const gchar             *path,
+                                           QmiPdcConfigurationType  config_type,
+                                           guint                    window,
+                                           GFileProgressCallback    progress_callback,
+                                           gpointer                 progress_callback_data,
+                                           GCancellable            *cancellable,
+                                           GAsyncReadyCallback      callback,
+                                           gpointer                 user_data);
+
+/**
+ * qmi_client_pdc_load_config_from_file_finish:
+ * @self: a #QmiClientPdc.
+ * @res: the #GAsyncResult obtained from the #GAsyncReadyCallback passed to qmi_client_pdc_load_config_from_file().
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an async operation started with qmi_client_pdc_load_config_from_file().
+ *
+ * Returns: (transfer full) (element-type guint8): the id of the loaded config, or %NULL if @error is set. The returned value should be freed with g_array_unref().
+ *
+ * Since: 1.20
+ */
+GArray *qmi_client_pdc_load_config_from_file_finish (QmiClientPdc  *self,
+                                                     GAsyncResult  *res,
+                                                     GError       **error);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_PDC_LOAD_CONFIG_H_ */
@@ -0,0 +1,628 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "qmi-pds-nmea-stream.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+static void async_initable_iface_init (GAsyncInitableIface *iface);
+
+G_DEFINE_TYPE_EXTENDED (QmiPdsNmeaStream, qmi_pds_nmea_stream, G_TYPE_OBJECT, 0,
+                        G_IMPLEMENT_INTERFACE (G_TYPE_ASYNC_INITABLE, async_initable_iface_init))
+
+/* Timeout of each request sent */
+#define REQUEST_TIMEOUT 10
+
+#define MAX_BUFFER_SIZE 65536
+
+/* PDS Event Report indication, read as a raw message */
+#define EVENT_REPORT_INDICATION_ID         0x0001
+#define EVENT_REPORT_TLV_NMEA_POSITION     0x10
+#define EVENT_REPORT_TLV_EXTENDED_NMEA     0x11
+
+/* Sentence types with their own decimation counter; sentences of any other
+ * type are never skipped */
+#define MAX_SENTENCE_TYPES 16
+#define SENTENCE_TYPE_SIZE 8
+
+typedef struct {
+    gchar type[SENTENCE_TYPE_SIZE];
+    guint count;
+} SentenceCounter;
+
+enum {
+    PROP_0,
+    PROP_CLIENT,
+    PROP_EXTENDED,
+    PROP_BUFFER_SIZE,
+    PROP_DECIMATION,
+    PROP_LAST
+};
+
+enum {
+    SIGNAL_AVAILABLE,
+    SIGNAL_LAST
+};
+
+static GParamSpec *properties[PROP_LAST];
+static guint       signals[SIGNAL_LAST] = { 0 };
+
+struct _QmiPdsNmeaStreamPrivate {
+    QmiClientPds *client;
+    gboolean      extended;
+    guint         buffer_size;
+    guint         decimation;
+
+    guint           event_report_id;
+    SentenceCounter counters[MAX_SENTENCE_TYPES];
+    guint           n_counters;
+
+    /* Ring of sentences, allocated once; the lock allows reading them from
+     * other threads */
+    GMutex              sentences_lock;
+    QmiPdsNmeaSentence *sentences;
+    guint               sentences_head;
+    guint               n_sentences;
+    guint64             n_dropped;
+};
+
+/*****************************************************************************/
+
+QmiClientPds *
+qmi_pds_nmea_stream_peek_client (QmiPdsNmeaStream *self)
+{
+    g_return_val_if_fail (QMI_IS_PDS_NMEA_STREAM (self), NULL);
+
+    return self->priv->client;
+}
+
+guint
+qmi_pds_nmea_stream_get_n_sentences (QmiPdsNmeaStream *self)
+{
+    guint n_sentences;
+
+    g_return_val_if_fail (QMI_IS_PDS_NMEA_STREAM (self), 0);
+
+    g_mutex_lock (&self->priv->sentences_lock);
+    n_sentences = self->priv->n_sentences;
+    g_mutex_unlock (&self->priv->sentences_lock);
+    return n_sentences;
+}
+
+guint64
+qmi_pds_nmea_stream_get_n_dropped (QmiPdsNmeaStream *self)
+{
+    guint64 n_dropped;
+
+    g_return_val_if_fail (QMI_IS_PDS_NMEA_STREAM (self), 0);
+
+    g_mutex_lock (&self->priv->sentences_lock);
+    n_dropped = self->priv->n_dropped;
+    g_mutex_unlock (&self->priv->sentences_lock);
+    return n_dropped;
+}
+
+guint
+qmi_pds_nmea_stream_read (QmiPdsNmeaStream   *self,
+                          QmiPdsNmeaSentence *sentences,
+                          guint               n_sentences)
+{
+    guint n_read;
+    guint n_first;
+
+    g_return_val_if_fail (QMI_IS_PDS_NMEA_STREAM (self), 0);
+    g_return_val_if_fail (sentences != NULL || n_sentences == 0, 0);
+
+    g_mutex_lock (&self->priv->sentences_lock);
+
+    n_read = MIN (n_sentences, self->priv->n_sentences);
+
+    /* At most two copies, before and after wrapping around */
+    n_first = MIN (n_read, self->priv->buffer_size - self->priv->sentences_head);
+    memcpy (sentences,
+            &self->priv->sentences[self->priv->sentences_head],
+            n_first * sizeof (QmiPdsNmeaSentence));
+    if (n_read > n_first)
+        memcpy (&sentences[n_first],
+                self->priv->sentences,
+                (n_read - n_first) * sizeof (QmiPdsNmeaSentence));
+
+    self->priv->sentences_head = (self->priv->sentences_head + n_read) % self->priv->buffer_size;
+    self->priv->n_sentences -= n_read;
+
+    g_mutex_unlock (&self->priv->sentences_lock);
+    return n_read;
+}
+
+/*****************************************************************************/
+/* New sentences */
+
+/* Decimation is applied per sentence type, so that the sets of sentences
+ * reported for the same fix are either all kept or all skipped */
+static gboolean
+sentence_decimate (QmiPdsNmeaStream *self,
+                   const gchar      *sentence,
+                   gsize             length)
+{
+    SentenceCounter *counter = NULL;
+    gsize            type_length;
+    guint            i;
+
+    if (self->priv->decimation == 1)
+        return FALSE;
+
+    /* The address field, e.g. "$GPGGA" */
+    for (type_length = 0; type_length < length && type_length < SENTENCE_TYPE_SIZE - 1; type_length++) {
+        if (sentence[type_length] == ',' || sentence[type_length] == '*')
+            break;
+    }
+
+    for (i = 0; i < self->priv->n_counters; i++) {
+        if (strncmp (self->priv->counters[i].type, sentence, type_length) == 0 &&
+            self->priv->counters[i].type[type_length] == '\0') {
+            counter = &self->priv->counters[i];
+            break;
+        }
+    }
+
+    if (!counter) {
+        if (self->priv->n_counters == MAX_SENTENCE_TYPES)
+            return FALSE;
+        counter = &self->priv->counters[self->priv->n_counters++];
+        memcpy (counter->type, sentence, type_length);
+        counter->type[type_length] = '\0';
+        counter->count = 0;
+    }
+
+    return (counter->count++ % self->priv->decimation) != 0;
+}
+
+/* Called with the lock held; returns TRUE if the buffer stopped being empty */
+static gboolean
+sentences_add_unlocked (QmiPdsNmeaStream    *self,
+                        QmiPdsOperationMode  operation_mode,
+                        gint64               timestamp,
+                        const gchar         *sentence,
+                        gsize                length)
+{
+    QmiPdsNmeaSentence *item;
+    gboolean            was_empty;
+
+    was_empty = (self->priv->n_sentences == 0);
+
+    /* Overwrite the oldest one if full */
+    if (self->priv->n_sentences == self->priv->buffer_size) {
+        self->priv->sentences_head = (self->priv->sentences_head + 1) % self->priv->buffer_size;
+        self->priv->n_sentences--;
+        self->priv->n_dropped++;
+    }
+
+    item = &self->priv->sentences[(self->priv->sentences_head + self->priv->n_sentences) % self->priv->buffer_size];
+    item->timestamp = timestamp;
+    item->operation_mode = operation_mode;
+    item->length = (guint16) length;
+    memcpy (item->sentence, sentence, length);
+    item->sentence[length] = '\0';
+    self->priv->n_sentences++;
+
+    return was_empty;
+}
+
+/* A single report may have several sentences, one per line */
+static void
+sentences_add (QmiPdsNmeaStream    *self,
+               QmiPdsOperationMode  operation_mode,
+               const gchar         *data,
+               gsize                length)
+{
+    gint64   timestamp;
+    gboolean available = FALSE;
+    gsize    start = 0;
+
+    timestamp = g_get_monotonic_time ();
+
+    g_mutex_lock (&self->priv->sentences_lock);
+    while (start < length) {
+        gsize end;
+
+        for (end = start; end < length && data[end] != '\r' && data[end] != '\n' && data[end] != '\0'; end++);
+
+        if (end > start &&
+            (end - start) <= QMI_PDS_NMEA_SENTENCE_MAX_LENGTH &&
+            !sentence_decimate (self, &data[start], end - start))
+            available |= sentences_add_unlocked (self, operation_mode, timestamp, &data[start], end - start);
+
+        start = end + 1;
+    }
+    g_mutex_unlock (&self->priv->sentences_lock);
+
+    if (available)
+        g_signal_emit (self, signals[SIGNAL_AVAILABLE], 0);
+}
+
+static void
+event_report_indication_cb (QmiClient        *client,
+                            QmiMessage       *message,
+                            QmiPdsNmeaStream *self)
+{
+    const guint8 *raw;
+    guint16       raw_length;
+    guint16       nmea_length;
+
+    /* Only the NMEA TLVs are looked at, the message is never fully parsed */
+    raw = qmi_message_get_raw_tlv (message, EVENT_REPORT_TLV_NMEA_POSITION, &raw_length);
+    if (raw) {
+        sentences_add (self, QMI_PDS_OPERATION_MODE_UNKNOWN, (const gchar *) raw, raw_length);
+        return;
+    }
+
+    /* Operation mode (1 byte), NMEA size (2 bytes) and NMEA */
+    raw = qmi_message_get_raw_tlv (message, EVENT_REPORT_TLV_EXTENDED_NMEA, &raw_length);
+    if (!raw || raw_length < 3)
+        return;
+
+    nmea_length = (guint16) (raw[1] | (raw[2] << 8));
+    if (nmea_length > raw_length - 3) {
+        g_debug ("invalid extended NMEA position report: %u bytes given, %u available",
+                 nmea_length, raw_length - 3);
+        return;
+    }
+
+    sentences_add (self, (QmiPdsOperationMode) (gint8) raw[0], (const gchar *) &raw[3], nmea_length);
+}
+
+/*****************************************************************************/
+/* New stream */
+
+QmiPdsNmeaStream *
+qmi_pds_nmea_stream_new_finish (GAsyncResult  *res,
+                                GError       **error)
+{
+    GObject *ret;
+    GObject *source_object;
+
+    source_object = g_async_result_get_source_object (res);
+    ret = g_async_initable_new_finish (G_ASYNC_INITABLE (source_object), res, error);
+    g_object_unref (source_object);
+
+    return (ret ? QMI_PDS_NMEA_STREAM (ret) : NULL);
+}
+
+void
+qmi_pds_nmea_stream_new (QmiClientPds        *client,
+                         gboolean             extended,
+                         guint                buffer_size,
+                         guint                decimation,
+                         GCancellable        *cancellable,
+                         GAsyncReadyCallback  callback,
+                         gpointer             user_data)
+{
+    g_return_if_fail (QMI_IS_CLIENT_PDS (client));
+    g_return_if_fail (buffer_size >= 1 && buffer_size <= MAX_BUFFER_SIZE);
+    g_return_if_fail (decimation >= 1);
+
+    g_async_initable_new_async (QMI_TYPE_PDS_NMEA_STREAM,
+                                G_PRIORITY_DEFAULT,
+                                cancellable,
+                                callback,
+                                user_data,
+                                QMI_PDS_NMEA_STREAM_CLIENT,      client,
+                                QMI_PDS_NMEA_STREAM_EXTENDED,    extended,
+                                QMI_PDS_NMEA_STREAM_BUFFER_SIZE, buffer_size,
+                                QMI_PDS_NMEA_STREAM_DECIMATION,  decimation,
+                                NULL);
+}
+
+/*****************************************************************************/
+/* Async init */
+
+static QmiMessagePdsSetEventReportInput *
+set_event_report_input_new (QmiPdsNmeaStream *self,
+                            gboolean          enabled)
+{
+    QmiMessagePdsSetEventReportInput *input;
+
+    input = qmi_message_pds_set_event_report_input_new ();
+    if (self->priv->extended)
+        qmi_message_pds_set_event_report_input_set_extended_nmea_position_reporting (input, enabled, NULL);
+    else
+        qmi_message_pds_set_event_report_input_set_nmea_position_reporting (input, enabled, NULL);
+    return input;
+}
+
+static gboolean
+initable_init_finish (GAsyncInitable  *initable,
+                      GAsyncResult    *result,
+                      GError         **error)
+{
+    return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static void
+set_event_report_ready (QmiClientPds *client,
+                        GAsyncResult *res,
+                        GTask        *task)
+{
+    QmiPdsNmeaStream                  *self;
+    QmiMessagePdsSetEventReportOutput *output;
+    GError                            *error = NULL;
+
+    self = g_task_get_source_object (task);
+
+    output = qmi_client_pds_set_event_report_finish (client, res, &error);
+    if (!output || !qmi_message_pds_set_event_report_output_get_result (output, &error)) {
+        g_prefix_error (&error, "Couldn't enable NMEA position reports: ");
+        qmi_client_remove_indication_callback (QMI_CLIENT (client), self->priv->event_report_id);
+        self->priv->event_report_id = 0;
+        g_task_return_error (task, error);
+    } else
+        g_task_return_boolean (task, TRUE);
+
+    if (output)
+        qmi_message_pds_set_event_report_output_unref (output);
+    g_object_unref (task);
+}
+
+static void
+initable_init_async (GAsyncInitable      *initable,
+                     int                  io_priority,
+                     GCancellable        *cancellable,
+                     GAsyncReadyCallback  callback,
+                     gpointer             user_data)
+{
+    QmiPdsNmeaStream                 *self;
+    QmiMessagePdsSetEventReportInput *input;
+    GTask                            *task;
+
+    self = QMI_PDS_NMEA_STREAM (initable);
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    if (!self->priv->client) {
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_INVALID_ARGS,
+                                 "Cannot initialize PDS NMEA stream: No client given");
+        g_object_unref (task);
+        return;
+    }
+
+    self->priv->sentences = g_new0 (QmiPdsNmeaSentence, self->priv->buffer_size);
+
+    /* Listen before enabling the reports, so that no sentence is lost */
+    self->priv->event_report_id = qmi_client_add_indication_callback (QMI_CLIENT (self->priv->client),
+                                                                      EVENT_REPORT_INDICATION_ID,
+                                                                      (QmiClientIndicationCallback) event_report_indication_cb,
+                                                                      self,
+                                                                      NULL);
+
+    input = set_event_report_input_new (self, TRUE);
+    qmi_client_pds_set_event_report (self->priv->client,
+                                     input,
+                                     REQUEST_TIMEOUT,
+                                     cancellable,
+                                     (GAsyncReadyCallback)set_event_report_ready,
+                                     task);
+    qmi_message_pds_set_event_report_input_unref (input);
+}
+
+/*****************************************************************************/
+
+static void
+set_property (GObject      *object,
+              guint         prop_id,
+              const GValue *value,
+              GParamSpec   *pspec)
+{
+    QmiPdsNmeaStream *self = QMI_PDS_NMEA_STREAM (object);
+
+    switch (prop_id) {
+    case PROP_CLIENT:
+        g_assert (self->priv->client == NULL);
+        self->priv->client = g_value_dup_object (value);
+        break;
+    case PROP_EXTENDED:
+        self->priv->extended = g_value_get_boolean (value);
+        break;
+    case PROP_BUFFER_SIZE:
+        self->priv->buffer_size = g_value_get_uint (value);
+        break;
+    case PROP_DECIMATION:
+        self->priv->decimation = g_value_get_uint (value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+get_property (GObject    *object,
+              guint       prop_id,
+              GValue     *value,
+              GParamSpec *pspec)
+{
+    QmiPdsNmeaStream *self = QMI_PDS_NMEA_STREAM (object);
+
+    switch (prop_id) {
+    case PROP_CLIENT:
+        g_value_set_object (value, self->priv->client);
+        break;
+    case PROP_EXTENDED:
+        g_value_set_boolean (value, self->priv->extended);
+        break;
+    case PROP_BUFFER_SIZE:
+        g_value_set_uint (value, self->priv->buffer_size);
+        break;
+    case PROP_DECIMATION:
+        g_value_set_uint (value, self->priv->decimation);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+qmi_pds_nmea_stream_init (QmiPdsNmeaStream *self)
+{
+    self->priv = G_TYPE_INSTANCE_GET_PRIVATE ((self),
+                                              QMI_TYPE_PDS_NMEA_STREAM,
+                                              QmiPdsNmeaStreamPrivate);
+
+    g_mutex_init (&self->priv->sentences_lock);
+}
+
+static void
+dispose (GObject *object)
+{
+    QmiPdsNmeaStream *self = QMI_PDS_NMEA_STREAM (object);
+
+    if (self->priv->client) {
+        if (self->priv->event_report_id) {
+            QmiMessagePdsSetEventReportInput *input;
+
+            qmi_client_remove_indication_callback (QMI_CLIENT (self->priv->client), self->priv->event_report_id);
+            self->priv->event_report_id = 0;
+
+            /* Stop the reports, no need to wait for the result */
+            input = set_event_report_input_new (self, FALSE);
+            qmi_client_pds_set_event_report (self->priv->client, input, REQUEST_TIMEOUT, NULL, NULL, NULL);
+            qmi_message_pds_set_event_report_input_unref (input);
+        }
+        g_clear_object (&self->priv->client);
+    }
+
+    G_OBJECT_CLASS (qmi_pds_nmea_stream_parent_class)->dispose (object);
+}
+
+static void
+finalize (GObject *object)
+{
+    QmiPdsNmeaStream *self = QMI_PDS_NMEA_STREAM (object);
+
+    g_free (self->priv->sentences);
+    g_mutex_clear (&self->priv->sentences_lock);
+
+    G_OBJECT_CLASS (qmi_pds_nmea_stream_parent_class)->finalize (object);
+}
+
+static void
+async_initable_iface_init (GAsyncInitableIface *iface)
+{
+    iface->init_async = initable_init_async;
+    iface->init_finish = initable_init_finish;
+}
+
+static void
+qmi_pds_nmea_stream_class_init (QmiPdsNmeaStreamClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    g_type_class_add_private (object_class, sizeof (QmiPdsNmeaStreamPrivate));
+
+    object_class->get_property = get_property;
+    object_class->set_property = set_property;
+    object_class->dispose = dispose;
+    object_class->finalize = finalize;
+
+    /**
+     * QmiPdsNmeaStream:pds-nmea-stream-client:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_CLIENT] =
+        g_param_spec_object (QMI_PDS_NMEA_STREAM_CLIENT,
+                             "PDS client",
+                             "The PDS client reporting the sentences",
+                             QMI_TYPE_CLIENT_PDS,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_CLIENT, properties[PROP_CLIENT]);
+
+    /**
+     * QmiPdsNmeaStream:pds-nmea-stream-extended:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_EXTENDED] =
+        g_param_spec_boolean (QMI_PDS_NMEA_STREAM_EXTENDED,
+                              "Extended",
+                              "Whether the extended NMEA position reports are requested",
+                              FALSE,
+                              G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_EXTENDED, properties[PROP_EXTENDED]);
+
+    /**
+     * QmiPdsNmeaStream:pds-nmea-stream-buffer-size:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_BUFFER_SIZE] =
+        g_param_spec_uint (QMI_PDS_NMEA_STREAM_BUFFER_SIZE,
+                           "Buffer size",
+                           "Number of sentences kept until read",
+                           1,
+                           MAX_BUFFER_SIZE,
+                           64,
+                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_BUFFER_SIZE, properties[PROP_BUFFER_SIZE]);
+
+    /**
+     * QmiPdsNmeaStream:pds-nmea-stream-decimation:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_DECIMATION] =
+        g_param_spec_uint (QMI_PDS_NMEA_STREAM_DECIMATION,
+                           "Decimation",
+                           "One in every how many sentences of the same type are kept",
+                           1,
+                           G_MAXUINT,
+                           1,
+                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_DECIMATION, properties[PROP_DECIMATION]);
+
+    /**
+     * QmiPdsNmeaStream::available:
+     * @object: A #QmiPdsNmeaStream.
+     *
+     * The ::available signal is emitted when new sentences are added to an
+     * empty buffer. It is not emitted again until all the sentences have been
+     * read with qmi_pds_nmea_stream_read().
+     *
+     * Since: 1.20
+     */
+    signals[SIGNAL_AVAILABLE] =
+        g_signal_new (QMI_PDS_NMEA_STREAM_SIGNAL_AVAILABLE,
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      0);
+}
@@ -0,0 +1,275 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_PDS_NMEA_STREAM_H_
+#define _LIBQMI_GLIB_QMI_PDS_NMEA_STREAM_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "qmi-enums-pds.h"
+#include "qmi-pds.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-pds-nmea-stream
+ * @title: QmiPdsNmeaStream
+ * @short_description: buffered stream of the NMEA sentences reported by PDS
+ *
+ * The #QmiPdsNmeaStream enables the NMEA position reports of a #QmiClientPds,
+ * and keeps the sentences received in a fixed-size buffer, from which they
+ * can be read in batches.
+ *
+ * The PDS Event Report indications are read directly from the raw messages,
+ * without building the parsed indication output, and each sentence is copied
+ * into a preallocated fixed-layout #QmiPdsNmeaSentence, so no memory is
+ * allocated per sentence. The consumer is notified only when the buffer stops
+ * being empty, so that a consumer reading at a lower rate than the device
+ * reports wakes up once per batch.
+ *
+ * Optionally, only one in every few sentences of each type can be kept, for
+ * consumers needing a lower rate than the one reported by the device.
+ */
+
+/**
+ * QMI_PDS_NMEA_SENTENCE_MAX_LENGTH:
+ *
+ * Maximum length of a NMEA sentence reported by PDS.
+ *
+ * Since: 1.20
+ */
+#define QMI_PDS_NMEA_SENTENCE_MAX_LENGTH 200
+
+/**
+ * QmiPdsNmeaSentence:
+ * @timestamp: monotonic time when the sentence was received, in microseconds.
+ * @operation_mode: a #QmiPdsOperationMode, or %QMI_PDS_OPERATION_MODE_UNKNOWN if not reported.
+ * @length: length of @sentence, without the trailing NUL byte.
+ * @sentence: the NUL-terminated sentence, without line breaks.
+ *
+ * A NMEA sentence read from a #QmiPdsNmeaStream.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    gint64              timestamp;
+    QmiPdsOperationMode operation_mode;
+    guint16             length;
+    gchar               sentence[QMI_PDS_NMEA_SENTENCE_MAX_LENGTH + 1];
+} QmiPdsNmeaSentence;
+
+#define QMI_TYPE_PDS_NMEA_STREAM            (qmi_pds_nmea_stream_get_type ())
+#define QMI_PDS_NMEA_STREAM(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), QMI_TYPE_PDS_NMEA_STREAM, QmiPdsNmeaStream))
+#define QMI_PDS_NMEA_STREAM_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  QMI_TYPE_PDS_NMEA_STREAM, QmiPdsNmeaStreamClass))
+#define QMI_IS_PDS_NMEA_STREAM(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), QMI_TYPE_PDS_NMEA_STREAM))
+#define QMI_IS_PDS_NMEA_STREAM_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  QMI_TYPE_PDS_NMEA_STREAM))
+#define QMI_PDS_NMEA_STREAM_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  QMI_TYPE_PDS_NMEA_STREAM, QmiPdsNmeaStreamClass))
+
+typedef struct _QmiPdsNmeaStream QmiPdsNmeaStream;
+typedef struct _QmiPdsNmeaStreamClass QmiPdsNmeaStreamClass;
+typedef struct _QmiPdsNmeaStreamPrivate QmiPdsNmeaStreamPrivate;
+
+/**
+ * QMI_PDS_NMEA_STREAM_CLIENT:
+ *
+ * Symbol defining the #QmiPdsNmeaStream:pds-nmea-stream-client property.
+ *
+ * Since: 1.20
+ */
+#define QMI_PDS_NMEA_STREAM_CLIENT "pds-nmea-stream-client"
+
+/**
+ * QMI_PDS_NMEA_STREAM_EXTENDED:
+ *
+ * Symbol defining the #QmiPdsNmeaStream:pds-nmea-stream-extended property.
+ *
+ * Since: 1.20
+ */
+#define QMI_PDS_NMEA_STREAM_EXTENDED "pds-nmea-stream-extended"
+
+/**
+ * QMI_PDS_NMEA_STREAM_BUFFER_SIZE:
+ *
+ * Symbol defining the #QmiPdsNmeaStream:pds-nmea-stream-buffer-size property.
+ *
+ * Since: 1.20
+ */
+#define QMI_PDS_NMEA_STREAM_BUFFER_SIZE "pds-nmea-stream-buffer-size"
+
+/**
+ * QMI_PDS_NMEA_STREAM_DECIMATION:
+ *
+ * Symbol defining the #QmiPdsNmeaStream:pds-nmea-stream-decimation property.
+ *
+ * Since: 1.20
+ */
+#define QMI_PDS_NMEA_STREAM_DECIMATION "pds-nmea-stream-decimation"
+
+/**
+ * QMI_PDS_NMEA_STREAM_SIGNAL_AVAILABLE:
+ *
+ * Symbol defining the #QmiPdsNmeaStream::available signal.
+ *
+ * Since: 1.20
+ */
+#define QMI_PDS_NMEA_STREAM_SIGNAL_AVAILABLE "available"
+
+/**
+ * QmiPdsNmeaStream:
+ *
+ * The #QmiPdsNmeaStream structure contains private data and should only be
+ * accessed using the provided API.
+ *
+ * Since: 1.20
+ */
+struct _QmiPdsNmeaStream {
+    /*< private >*/
+    GObject parent;
+    QmiPdsNmeaStreamPrivate *priv;
+};
+
+struct _QmiPdsNmeaStreamClass {
+    /*< private >*/
+    GObjectClass parent;
+};
+
+GType qmi_pds_nmea_stream_get_type (void);
+
+/**
+ * qmi_pds_nmea_stream_new:
+ * @client: a #QmiClientPds.
+ * @extended: %TRUE to request the extended NMEA position reports, which include the #QmiPdsOperationMode.
+ * @buffer_size: the maximum number of sentences kept until read, at least 1.
+ * @decimation: keep only one in every @decimation sentences of the same type, at least 1.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the initialization is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously creates a #QmiPdsNmeaStream, enabling the NMEA position
+ * reports in the PDS Event Report indications of @client.
+ *
+ * Sentence types are given by the address field of the sentences (e.g.
+ * "GPGGA"), so that e.g. with a @decimation of 5 and a device reporting one
+ * fix per second, a full set of sentences is kept every 5 seconds.
+ *
+ * When the operation is finished, @callback will be invoked in the
+ * <link linkend="g-main-context-push-thread-default">thread-default main context</link>
+ * of the thread you are calling this method from. You can then call
+ * qmi_pds_nmea_stream_new_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_pds_nmea_stream_new (QmiClientPds        *client,
+                              gboolean             extended,
+                              guint                buffer_size,
+                              guint                decimation,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data);
+
+/**
+ * qmi_pds_nmea_stream_new_finish:
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_pds_nmea_stream_new().
+ *
+ * Returns: (transfer full): a newly created #QmiPdsNmeaStream, or %NULL if @error is set.
+ *
+ * Since: 1.20
+ */
+QmiPdsNmeaStream *qmi_pds_nmea_stream_new_finish (GAsyncResult  *res,
+                                                  GError       **error);
+
+/**
+ * qmi_pds_nmea_stream_peek_client:
+ * @self: a #QmiPdsNmeaStream.
+ *
+ * Get the #QmiClientPds used by the stream, without increasing the reference
+ * count on the returned object.
+ *
+ * Returns: (transfer none): a #QmiClientPds. Do not free the returned object, it is owned by @self.
+ *
+ * Since: 1.20
+ */
+QmiClientPds *qmi_pds_nmea_stream_peek_client (QmiPdsNmeaStream *self);
+
+/**
+ * qmi_pds_nmea_stream_get_n_sentences:
+ * @self: a #QmiPdsNmeaStream.
+ *
+ * Gets the number of sentences received and not read yet, which is never
+ * more than the buffer size given when creating the stream.
+ *
+ * This method may be called from any thread.
+ *
+ * Returns: the number of sentences.
+ *
+ * Since: 1.20
+ */
+guint qmi_pds_nmea_stream_get_n_sentences (QmiPdsNmeaStream *self);
+
+/**
+ * qmi_pds_nmea_stream_get_n_dropped:
+ * @self: a #QmiPdsNmeaStream.
+ *
+ * Gets the number of sentences dropped because the buffer was full, since the
+ * stream was created. When the buffer is full, the oldest sentence is dropped.
+ *
+ * Sentences skipped because of the decimation are not counted.
+ *
+ * This method may be called from any thread.
+ *
+ * Returns: the number of sentences dropped.
+ *
+ * Since: 1.20
+ */
+guint64 qmi_pds_nmea_stream_get_n_dropped (QmiPdsNmeaStream *self);
+
+/**
+ * qmi_pds_nmea_stream_read:
+ * @self: a #QmiPdsNmeaStream.
+ * @sentences: (out caller-allocates) (array length=n_sentences): an array of #QmiPdsNmeaSentence.
+ * @n_sentences: the number of elements in @sentences.
+ *
+ * Reads up to @n_sentences sentences from the buffer, oldest first, removing
+ * them from it.
+ *
+ * This method may be called from any thread.
+ *
+ * Returns: the number of sentences read into @sentences.
+ *
+ * Since: 1.20
+ */
+guint qmi_pds_nmea_stream_read (QmiPdsNmeaStream   *self,
+                                QmiPdsNmeaSentence *sentences,
+                                guint               n_sentences);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_PDS_NMEA_STREAM_H_ */
@@ -0,0 +1,536 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <glib.h>
+
+#include "qmi-poller.h"
+#include "qmi-device.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+G_DEFINE_TYPE (QmiPoller, qmi_poller, G_TYPE_OBJECT)
+
+/* Responses slower than this make the device intervals grow */
+#define SLOW_RESPONSE_THRESHOLD_US (G_USEC_PER_SEC / 2)
+
+#define MAX_BACKOFF 16
+
+#define MAX_SLACK_MS  60000
+#define MAX_JITTER_MS 60000
+
+enum {
+    PROP_0,
+    PROP_SLACK,
+    PROP_JITTER,
+    PROP_LAST
+};
+
+static GParamSpec *properties[PROP_LAST];
+
+typedef struct {
+    guint n_entries;
+    guint backoff;
+} DeviceInfo;
+
+typedef struct {
+    volatile gint ref_count;
+    guint         id;
+
+    /* Both unset when the entry is removed */
+    QmiPoller    *self;
+    DeviceInfo   *device_info;
+
+    QmiClient                 *client;
+    QmiMessage                *request;
+    guint                      interval;
+    guint                      timeout;
+    QmiPollerResponseCallback  callback;
+    gpointer                   user_data;
+    GDestroyNotify             user_data_free_func;
+
+    gint64   due;
+    gint64   sent;
+    gboolean pending;
+} Entry;
+
+struct _QmiPollerPrivate {
+    guint slack;
+    guint jitter;
+
+    /* Scheduling, in the context where the poller was created */
+    GMainContext *context;
+    GSource      *source;
+
+    /* id -> Entry */
+    GHashTable *entries;
+    guint       next_id;
+
+    /* QmiDevice -> DeviceInfo */
+    GHashTable *devices;
+};
+
+static void schedule (QmiPoller *self);
+
+/*****************************************************************************/
+
+static Entry *
+entry_ref (Entry *entry)
+{
+    g_atomic_int_inc (&entry->ref_count);
+    return entry;
+}
+
+static void
+entry_unref (Entry *entry)
+{
+    if (g_atomic_int_dec_and_test (&entry->ref_count)) {
+        g_assert (!entry->self);
+        g_object_unref (entry->client);
+        qmi_message_unref (entry->request);
+        g_slice_free (Entry, entry);
+    }
+}
+
+static void
+entry_detach (QmiPoller *self,
+              Entry     *entry)
+{
+    g_assert (entry->self == self);
+
+    if (--entry->device_info->n_entries == 0)
+        g_hash_table_remove (self->priv->devices, qmi_client_peek_device (entry->client));
+    entry->device_info = NULL;
+    entry->self = NULL;
+
+    if (entry->user_data_free_func)
+        entry->user_data_free_func (entry->user_data);
+    entry->user_data = NULL;
+}
+
+static gint64
+entry_period (Entry *entry)
+{
+    return (gint64) entry->interval * entry->device_info->backoff * G_USEC_PER_SEC;
+}
+
+/*****************************************************************************/
+
+static void
+device_info_update_backoff (DeviceInfo *device_info,
+                            gboolean    slow)
+{
+    if (slow) {
+        if (device_info->backoff < MAX_BACKOFF) {
+            device_info->backoff *= 2;
+            g_debug ("device is slow, polling backoff increased to %u", device_info->backoff);
+        }
+    } else if (device_info->backoff > 1) {
+        device_info->backoff /= 2;
+        g_debug ("device is fast again, polling backoff decreased to %u", device_info->backoff);
+    }
+}
+
+static void
+command_ready (QmiDevice    *device,
+               GAsyncResult *res,
+               Entry        *entry)
+{
+    QmiMessage *response;
+    GError     *error = NULL;
+
+    response = qmi_device_command_full_finish (device, res, &error);
+    entry->pending = FALSE;
+
+    /* Removed while waiting for the response */
+    if (entry->self) {
+        gboolean slow;
+
+        slow = (g_error_matches (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TIMEOUT) ||
+                (g_get_monotonic_time () - entry->sent) > SLOW_RESPONSE_THRESHOLD_US);
+        device_info_update_backoff (entry->device_info, slow);
+
+        entry->callback (entry->self, entry->client, response, error, entry->user_data);
+    }
+
+    if (response)
+        qmi_message_unref (response);
+    if (error)
+        g_error_free (error);
+    entry_unref (entry);
+}
+
+static void
+entry_send (Entry  *entry,
+            gint64  now)
+{
+    QmiMessage *message;
+
+    message = __qmi_message_copy_for_transaction (entry->request,
+                                                  qmi_client_get_cid (entry->client),
+                                                  qmi_client_get_next_transaction_id (entry->client));
+    entry->pending = TRUE;
+    entry->sent = now;
+    qmi_device_command_full (QMI_DEVICE (qmi_client_peek_device (entry->client)),
+                             message,
+                             NULL,
+                             entry->timeout,
+                             NULL,
+                             (GAsyncReadyCallback)command_ready,
+                             entry_ref (entry));
+    qmi_message_unref (message);
+}
+
+/* Group by device, keeping the order in which requests were added */
+static gint
+entry_cmp (Entry **a,
+           Entry **b)
+{
+    gpointer device_a;
+    gpointer device_b;
+
+    device_a = qmi_client_peek_device ((*a)->client);
+    device_b = qmi_client_peek_device ((*b)->client);
+    if (device_a != device_b)
+        return (device_a < device_b ? -1 : 1);
+    return ((*a)->id < (*b)->id ? -1 : ((*a)->id > (*b)->id));
+}
+
+static gboolean
+burst_cb (QmiPoller *self)
+{
+    GHashTableIter  iter;
+    Entry          *entry;
+    GPtrArray      *due;
+    gint64          now;
+    gint64          limit;
+    guint           i;
+
+    g_source_unref (self->priv->source);
+    self->priv->source = NULL;
+
+    /* Response callbacks may drop the last reference to the poller */
+    g_object_ref (self);
+
+    now = g_get_monotonic_time ();
+    limit = now + ((gint64) self->priv->slack * 1000);
+
+    due = g_ptr_array_new_with_free_func ((GDestroyNotify)entry_unref);
+    g_hash_table_iter_init (&iter, self->priv->entries);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&entry)) {
+        if (entry->due <= limit)
+            g_ptr_array_add (due, entry_ref (entry));
+    }
+    g_ptr_array_sort (due, (GCompareFunc)entry_cmp);
+
+    /* All requests sent at once get the same base time, so that the ones with
+     * the same interval keep on being sent together */
+    for (i = 0; i < due->len; i++) {
+        entry = g_ptr_array_index (due, i);
+
+        /* Removed by a response callback run right away */
+        if (!entry->self)
+            continue;
+
+        /* Never more than one request at a time, even if the device is slow */
+        if (entry->pending)
+            device_info_update_backoff (entry->device_info, TRUE);
+        else
+            entry_send (entry, now);
+        entry->due = now + entry_period (entry);
+    }
+    g_ptr_array_unref (due);
+
+    schedule (self);
+    g_object_unref (self);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+schedule (QmiPoller *self)
+{
+    GHashTableIter  iter;
+    Entry          *entry;
+    gint64          next = G_MAXINT64;
+    gint64          now;
+    guint           delay = 0;
+
+    if (self->priv->source) {
+        g_source_destroy (self->priv->source);
+        g_source_unref (self->priv->source);
+        self->priv->source = NULL;
+    }
+
+    g_hash_table_iter_init (&iter, self->priv->entries);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&entry))
+        next = MIN (next, entry->due);
+    if (next == G_MAXINT64)
+        return;
+
+    /* Requests already due are sent right away; jitter only applies to the
+     * periodic wakeups */
+    now = g_get_monotonic_time ();
+    if (next > now) {
+        delay = (guint) ((next - now + 999) / 1000);
+        if (self->priv->jitter)
+            delay += g_random_int_range (0, self->priv->jitter + 1);
+    }
+
+    self->priv->source = g_timeout_source_new (delay);
+    g_source_set_callback (self->priv->source, (GSourceFunc)burst_cb, self, NULL);
+    g_source_attach (self->priv->source, self->priv->context);
+}
+
+/*****************************************************************************/
+
+guint
+qmi_poller_add (QmiPoller                 *self,
+                QmiClient                 *client,
+                QmiMessage                *request,
+                guint                      interval,
+                guint                      timeout,
+                QmiPollerResponseCallback  callback,
+                gpointer                   user_data,
+                GDestroyNotify             user_data_free_func)
+{
+    Entry      *entry;
+    DeviceInfo *device_info;
+    GObject    *device;
+
+    g_return_val_if_fail (QMI_IS_POLLER (self), 0);
+    g_return_val_if_fail (QMI_IS_CLIENT (client), 0);
+    g_return_val_if_fail (request != NULL, 0);
+    g_return_val_if_fail (qmi_message_get_service (request) == qmi_client_get_service (client), 0);
+    g_return_val_if_fail (interval > 0, 0);
+    g_return_val_if_fail (callback != NULL, 0);
+
+    device = qmi_client_peek_device (client);
+    g_return_val_if_fail (QMI_IS_DEVICE (device), 0);
+
+    device_info = g_hash_table_lookup (self->priv->devices, device);
+    if (!device_info) {
+        device_info = g_new0 (DeviceInfo, 1);
+        device_info->backoff = 1;
+        g_hash_table_insert (self->priv->devices, device, device_info);
+    }
+    device_info->n_entries++;
+
+    entry = g_slice_new0 (Entry);
+    entry->ref_count = 1;
+    entry->self = self;
+    entry->device_info = device_info;
+    entry->client = g_object_ref (client);
+    entry->request = qmi_message_ref (request);
+    entry->interval = interval;
+    entry->timeout = timeout;
+    entry->callback = callback;
+    entry->user_data = user_data;
+    entry->user_data_free_func = user_data_free_func;
+    entry->due = g_get_monotonic_time ();
+
+    do {
+        entry->id = ++self->priv->next_id;
+    } while (entry->id == 0 || g_hash_table_contains (self->priv->entries, GUINT_TO_POINTER (entry->id)));
+    g_hash_table_insert (self->priv->entries, GUINT_TO_POINTER (entry->id), entry);
+
+    schedule (self);
+    return entry->id;
+}
+
+void
+qmi_poller_remove (QmiPoller *self,
+                   guint      id)
+{
+    Entry *entry;
+
+    g_return_if_fail (QMI_IS_POLLER (self));
+
+    entry = g_hash_table_lookup (self->priv->entries, GUINT_TO_POINTER (id));
+    if (!entry)
+        return;
+
+    g_hash_table_steal (self->priv->entries, GUINT_TO_POINTER (id));
+    entry_detach (self, entry);
+    entry_unref (entry);
+
+    if (g_hash_table_size (self->priv->entries) == 0)
+        schedule (self);
+}
+
+guint
+qmi_poller_get_backoff (QmiPoller *self,
+                        QmiClient *client)
+{
+    DeviceInfo *device_info;
+
+    g_return_val_if_fail (QMI_IS_POLLER (self), 0);
+    g_return_val_if_fail (QMI_IS_CLIENT (client), 0);
+
+    device_info = g_hash_table_lookup (self->priv->devices, qmi_client_peek_device (client));
+    return (device_info ? device_info->backoff : 0);
+}
+
+/*****************************************************************************/
+
+QmiPoller *
+qmi_poller_new (guint slack,
+                guint jitter)
+{
+    return QMI_POLLER (g_object_new (QMI_TYPE_POLLER,
+                                     QMI_POLLER_SLACK,  MIN (slack, MAX_SLACK_MS),
+                                     QMI_POLLER_JITTER, MIN (jitter, MAX_JITTER_MS),
+                                     NULL));
+}
+
+static void
+set_property (GObject      *object,
+              guint         prop_id,
+              const GValue *value,
+              GParamSpec   *pspec)
+{
+    QmiPoller *self = QMI_POLLER (object);
+
+    switch (prop_id) {
+    case PROP_SLACK:
+        self->priv->slack = g_value_get_uint (value);
+        break;
+    case PROP_JITTER:
+        self->priv->jitter = g_value_get_uint (value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+get_property (GObject    *object,
+              guint       prop_id,
+              GValue     *value,
+              GParamSpec *pspec)
+{
+    QmiPoller *self = QMI_POLLER (object);
+
+    switch (prop_id) {
+    case PROP_SLACK:
+        g_value_set_uint (value, self->priv->slack);
+        break;
+    case PROP_JITTER:
+        g_value_set_uint (value, self->priv->jitter);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+qmi_poller_init (QmiPoller *self)
+{
+    self->priv = G_TYPE_INSTANCE_GET_PRIVATE ((self),
+                                              QMI_TYPE_POLLER,
+                                              QmiPollerPrivate);
+
+    self->priv->context = g_main_context_ref_thread_default ();
+    self->priv->entries = g_hash_table_new (g_direct_hash, g_direct_equal);
+    self->priv->devices = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+}
+
+static void
+dispose (GObject *object)
+{
+    QmiPoller *self = QMI_POLLER (object);
+
+    if (self->priv->source) {
+        g_source_destroy (self->priv->source);
+        g_source_unref (self->priv->source);
+        self->priv->source = NULL;
+    }
+
+    if (self->priv->entries) {
+        GHashTableIter  iter;
+        Entry          *entry;
+
+        g_hash_table_iter_init (&iter, self->priv->entries);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&entry)) {
+            g_hash_table_iter_steal (&iter);
+            entry_detach (self, entry);
+            entry_unref (entry);
+        }
+        g_hash_table_unref (self->priv->entries);
+        self->priv->entries = NULL;
+    }
+
+    if (self->priv->devices) {
+        g_hash_table_unref (self->priv->devices);
+        self->priv->devices = NULL;
+    }
+
+    if (self->priv->context) {
+        g_main_context_unref (self->priv->context);
+        self->priv->context = NULL;
+    }
+
+    G_OBJECT_CLASS (qmi_poller_parent_class)->dispose (object);
+}
+
+static void
+qmi_poller_class_init (QmiPollerClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    g_type_class_add_private (object_class, sizeof (QmiPollerPrivate));
+
+    object_class->get_property = get_property;
+    object_class->set_property = set_property;
+    object_class->dispose = dispose;
+
+    /**
+     * QmiPoller:poller-slack:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_SLACK] =
+        g_param_spec_uint (QMI_POLLER_SLACK,
+                           "Slack",
+                           "How early a request may be sent along with others, in milliseconds",
+                           0,
+                           MAX_SLACK_MS,
+                           1000,
+                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_SLACK, properties[PROP_SLACK]);
+
+    /**
+     * QmiPoller:poller-jitter:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_JITTER] =
+        g_param_spec_uint (QMI_POLLER_JITTER,
+                           "Jitter",
+                           "Maximum random delay added to each wakeup, in milliseconds",
+                           0,
+                           MAX_JITTER_MS,
+                           0,
+                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_JITTER, properties[PROP_JITTER]);
+}
@@ -0,0 +1,208 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_POLLER_H_
+#define _LIBQMI_GLIB_QMI_POLLER_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+
+#include "qmi-message.h"
+#include "qmi-client.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-poller
+ * @title: QmiPoller
+ * @short_description: scheduling of periodic requests
+ *
+ * The #QmiPoller sends requests periodically, on behalf of any number of
+ * #QmiClient objects, possibly in different #QmiDevice objects, so that
+ * each user doesn't need its own timeout source for each request.
+ *
+ * All the requests of a poller are scheduled together: whenever one of them
+ * is due, all the ones due within the configured slack are sent at the same
+ * time, grouped by device, so that the process and the devices are woken up
+ * once for all of them. Requests that keep on being sent together have their
+ * next times aligned as well.
+ *
+ * A random delay, up to the configured jitter, is added to each wakeup, so
+ * that pollers in different processes don't end up sending their requests to
+ * the same device at the very same time.
+ *
+ * If a device is slow to reply, the intervals of all the requests sent to it
+ * are progressively increased, and they are progressively restored once it
+ * replies fast enough again. There is never more than one pending request for
+ * each of the periodic requests added.
+ */
+
+#define QMI_TYPE_POLLER            (qmi_poller_get_type ())
+#define QMI_POLLER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), QMI_TYPE_POLLER, QmiPoller))
+#define QMI_POLLER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  QMI_TYPE_POLLER, QmiPollerClass))
+#define QMI_IS_POLLER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), QMI_TYPE_POLLER))
+#define QMI_IS_POLLER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  QMI_TYPE_POLLER))
+#define QMI_POLLER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  QMI_TYPE_POLLER, QmiPollerClass))
+
+typedef struct _QmiPoller QmiPoller;
+typedef struct _QmiPollerClass QmiPollerClass;
+typedef struct _QmiPollerPrivate QmiPollerPrivate;
+
+/**
+ * QMI_POLLER_SLACK:
+ *
+ * Symbol defining the #QmiPoller:poller-slack property.
+ *
+ * Since: 1.20
+ */
+#define QMI_POLLER_SLACK "poller-slack"
+
+/**
+ * QMI_POLLER_JITTER:
+ *
+ * Symbol defining the #QmiPoller:poller-jitter property.
+ *
+ * Since: 1.20
+ */
+#define QMI_POLLER_JITTER "poller-jitter"
+
+/**
+ * QmiPoller:
+ *
+ * The #QmiPoller structure contains private data and should only be
+ * accessed using the provided API.
+ *
+ * Since: 1.20
+ */
+struct _QmiPoller {
+    /*< private >*/
+    GObject parent;
+    QmiPollerPrivate *priv;
+};
+
+struct _QmiPollerClass {
+    /*< private >*/
+    GObjectClass parent;
+};
+
+GType qmi_poller_get_type (void);
+
+/**
+ * QmiPollerResponseCallback:
+ * @self: a #QmiPoller.
+ * @client: the #QmiClient the request was sent for.
+ * @response: (nullable): the #QmiMessage response, or %NULL if @error is set.
+ * @error: (nullable): a #GError if the request failed, or %NULL.
+ * @user_data: the data given when the request was added.
+ *
+ * Callback to run on each response to a periodic request. Both @response and
+ * @error are owned by the poller.
+ *
+ * Since: 1.20
+ */
+typedef void (* QmiPollerResponseCallback) (QmiPoller    *self,
+                                            QmiClient    *client,
+                                            QmiMessage   *response,
+                                            const GError *error,
+                                            gpointer      user_data);
+
+/**
+ * qmi_poller_new:
+ * @slack: how early a request may be sent to go along with others, in milliseconds.
+ * @jitter: the maximum random delay added to each wakeup, in milliseconds.
+ *
+ * Creates a #QmiPoller, which sends the requests in the
+ * <link linkend="g-main-context-push-thread-default">thread-default main context</link>
+ * of the thread you are calling this method from.
+ *
+ * Returns: (transfer full): a newly created #QmiPoller. The returned value should be freed with g_object_unref().
+ *
+ * Since: 1.20
+ */
+QmiPoller *qmi_poller_new (guint slack,
+                           guint jitter);
+
+/**
+ * qmi_poller_add:
+ * @self: a #QmiPoller.
+ * @client: a #QmiClient.
+ * @request: the #QmiMessage request, for the service of @client.
+ * @interval: the interval between requests, in seconds, at least 1.
+ * @timeout: maximum time, in seconds, to wait for each response.
+ * @callback: a #QmiPollerResponseCallback to call on each response.
+ * @user_data: the data to pass to @callback.
+ * @user_data_free_func: (nullable): a #GDestroyNotify for @user_data, or %NULL.
+ *
+ * Adds a periodic request. The first request is sent as soon as possible,
+ * along with any other requests added in the same main loop iteration.
+ *
+ * The client id and transaction id of @request are ignored; each time it is
+ * sent, a copy is made with the client id of @client and a new transaction id.
+ *
+ * Returns: the id of the periodic request, to be given to qmi_poller_remove().
+ *
+ * Since: 1.20
+ */
+guint qmi_poller_add (QmiPoller                 *self,
+                      QmiClient                 *client,
+                      QmiMessage                *request,
+                      guint                      interval,
+                      guint                      timeout,
+                      QmiPollerResponseCallback  callback,
+                      gpointer                   user_data,
+                      GDestroyNotify             user_data_free_func);
+
+/**
+ * qmi_poller_remove:
+ * @self: a #QmiPoller.
+ * @id: the id returned by qmi_poller_add().
+ *
+ * Removes a periodic request. If there is a request pending, its response is
+ * ignored.
+ *
+ * Since: 1.20
+ */
+void qmi_poller_remove (QmiPoller *self,
+                        guint      id);
+
+/**
+ * qmi_poller_get_backoff:
+ * @self: a #QmiPoller.
+ * @client: a #QmiClient.
+ *
+ * Gets the factor currently applied to the intervals of the requests sent to
+ * the device of @client, which is 1 unless the device is being slow.
+ *
+ * Returns: the backoff factor, or 0 if there are no requests for the device.
+ *
+ * Since: 1.20
+ */
+guint qmi_poller_get_backoff (QmiPoller *self,
+                              QmiClient *client);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_POLLER_H_ */
@@ -0,0 +1,84 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_PROBES_H_
+#define _LIBQMI_GLIB_QMI_PROBES_H_
+
+#if !defined (LIBQMI_GLIB_COMPILATION)
+#error "This is a private header."
+#endif
+
+#include "qmi-message.h"
+
+/*
+ * Static USDT probes in the 'libqmi' provider, at the points where messages
+ * go through the library. They can be listed with e.g.:
+ *
+ *   bpftrace -l 'usdt:/usr/lib/libqmi-glib.so.5:libqmi:*'
+ *
+ * Every message probe gets the service, client id, message id, transaction
+ * id and raw length of the message, in that order:
+ *
+ *   command_send         request written to the device
+ *   frame_received       message read from the device
+ *   transaction_match    response matching a pending request; the request
+ *                        latency, in microseconds, is given as 6th argument
+ *   transaction_miss     response not matching any pending request
+ *   transaction_timeout  request given up waiting for its response
+ *   indication_dispatch  indication reported to a client
+ *   proxy_forward        message forwarded by the proxy; a 6th argument is
+ *                        1 if forwarded to the device, 0 if to a client
+ *
+ * When not being traced, a probe is a single nop instruction, plus reading
+ * the arguments from the message header.
+ */
+
+#if defined QMI_USDT_ENABLED
+
+#include <sys/sdt.h>
+
+#define QMI_PROBE_MESSAGE(name, message)                                \
+    DTRACE_PROBE5 (libqmi, name,                                        \
+                   (guint) __qmi_message_get_service (message),         \
+                   (guint) __qmi_message_get_client_id (message),       \
+                   (guint) __qmi_message_get_message_id (message),      \
+                   (guint) __qmi_message_get_transaction_id (message),  \
+                   (guint) ((GByteArray *) (message))->len)
+
+#define QMI_PROBE_MESSAGE_VALUE(name, message, value)                   \
+    DTRACE_PROBE6 (libqmi, name,                                        \
+                   (guint) __qmi_message_get_service (message),         \
+                   (guint) __qmi_message_get_client_id (message),       \
+                   (guint) __qmi_message_get_message_id (message),      \
+                   (guint) __qmi_message_get_transaction_id (message),  \
+                   (guint) ((GByteArray *) (message))->len,             \
+                   (gint64) (value))
+
+#else
+
+#define QMI_PROBE_MESSAGE(name, message)
+#define QMI_PROBE_MESSAGE_VALUE(name, message, value)
+
+#endif
+
+#endif /* _LIBQMI_GLIB_QMI_PROBES_H_ */
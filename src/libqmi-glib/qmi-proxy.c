@@ -21,26 +21,52 @@
  * Copyright (C) 2013-2017 <Aleksander Morgado <aleksander@aleksander.es>
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <sys/file.h>
 #include <sys/types.h>
 #include <errno.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <gio/gunixsocketaddress.h>
+#include <gio/gunixfdlist.h>
+#include <gio/gunixfdmessage.h>
 
 #include "config.h"
+#if defined HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
 #include "qmi-enum-types.h"
 #include "qmi-error-types.h"
 #include "qmi-device.h"
 #include "qmi-ctl.h"
 #include "qmi-utils.h"
+#include "qmi-trace.h"
 #include "qmi-proxy.h"
+#include "qmi-probes.h"
+#include "qmi-io-uring.h"
 
 #define BUFFER_SIZE 512
 
+/* Max number of messages written to a client at once */
+#define CLIENT_OUTPUT_MAX_VECTORS 16
+
+/* Clients with more than this many bytes pending to be written are
+ * considered stalled and disconnected */
+#define CLIENT_OUTPUT_HIGH_WATERMARK (256 * 1024)
+
+/* Max number of socket events handled in one single dispatch */
+#define EPOLL_MAX_EVENTS 64
+
+/* Remote clients must start with "QMI-PROXY-AUTH <token>\n" */
+#define REMOTE_AUTH_PREAMBLE "QMI-PROXY-AUTH "
+#define REMOTE_AUTH_MAX_LENGTH 512
+
 #define QMI_MESSAGE_OUTPUT_TLV_RESULT 0x02
 #define QMI_MESSAGE_OUTPUT_TLV_ALLOCATION_INFO 0x01
 #define QMI_MESSAGE_CTL_ALLOCATE_CID 0x0022
@@ -48,26 +74,130 @@
 
 #define QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN 0xFF00
 #define QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN_INPUT_TLV_DEVICE_PATH 0x01
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN_OUTPUT_TLV_ABORT_SUPPORTED 0x10
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN_OUTPUT_TLV_INDICATION_FILTER_SUPPORTED 0x11
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN_OUTPUT_TLV_TRANSACTIONS_SUPPORTED 0x12
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN_OUTPUT_TLV_STATS_SUPPORTED 0x13
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN_OUTPUT_TLV_MONITOR_SUPPORTED 0x14
+
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_ABORT 0xFF01
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_ABORT_INPUT_TLV_TRANSACTION 0x01
+
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_SET_INDICATION_FILTER 0xFF02
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_SET_INDICATION_FILTER_INPUT_TLV_SERVICE 0x01
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_SET_INDICATION_FILTER_INPUT_TLV_INDICATIONS 0x10
+
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_GET_TRANSACTIONS 0xFF03
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_GET_TRANSACTIONS_OUTPUT_TLV_TRANSACTIONS 0x10
+
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_GET_STATS 0xFF04
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_GET_STATS_OUTPUT_TLV_DEVICES 0x10
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_GET_STATS_OUTPUT_TLV_CLIENTS 0x11
+
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_MONITOR 0xFF05
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_MONITOR_INPUT_TLV_SERVICES 0x01
+
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_HANDOFF 0xFF06
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_HANDOFF_INPUT_TLV_DRAIN_TIMEOUT 0x01
+
+/* After the handoff response, the proxy handing over sends the file
+ * descriptors, in chunks of one 'F' byte each, and then 'S' followed by the
+ * 32bit length and the serialized state. The new proxy confirms it adopted
+ * everything with 'A', and it only starts once the old one replies with 'D',
+ * so that if either goes away before, the old one just goes on. */
+#define HANDOFF_STATE_VERSION 1
+#define HANDOFF_CLIENT_FORMAT "(hbbusa(yy)ayayauauaub)"
+#define HANDOFF_STATE_FORMAT "(uahsa(shay)a" HANDOFF_CLIENT_FORMAT ")"
+#define HANDOFF_STATE_MAX_LENGTH (64 * 1024 * 1024)
+#define HANDOFF_MARKER_FDS 'F'
+#define HANDOFF_MARKER_STATE 'S'
+#define HANDOFF_MARKER_ADOPTED 'A'
+#define HANDOFF_MARKER_DONE 'D'
+#define HANDOFF_MAX_FDS_PER_MESSAGE 200
+#define HANDOFF_DRAIN_POLL_MS 100
+#define HANDOFF_DEFAULT_DRAIN_TIMEOUT 10
+#define HANDOFF_SOCKET_TIMEOUT 10
 
 G_DEFINE_TYPE (QmiProxy, qmi_proxy, G_TYPE_OBJECT)
 
 enum {
     PROP_0,
     PROP_N_CLIENTS,
+    PROP_COALESCE_REQUESTS,
+    PROP_RESPONSE_CACHE,
+    PROP_INDICATION_CACHE,
+    PROP_TRACE_RING,
+    PROP_DEVICE_LINGER,
+    PROP_KEEP_OPEN,
+    PROP_EPOLL,
+    PROP_IO_URING,
+    PROP_FAIR_QUEUE_WINDOW,
+    PROP_HANDED_OFF,
     PROP_LAST
 };
 
 static GParamSpec *properties[PROP_LAST];
 
+typedef struct _EpollCore EpollCore;
+typedef struct _EpollWatch EpollWatch;
+typedef struct _Handoff Handoff;
+
 struct _QmiProxyPrivate {
-    /* Unix socket service */
+    /* Unix socket service, also accepting TCP clients if requested */
     GSocketService *socket_service;
-
-    /* Clients */
-    GList *clients;
-
-    /* Devices */
-    GList *devices;
+    /* The sockets the service listens in, handed over to a new proxy */
+    GPtrArray *listening_sockets;
+    /* Token remote clients must authenticate with */
+    gchar *auth_token;
+    /* Certificate presented to remote clients, if TLS is used */
+    GTlsCertificate *tls_certificate;
+
+    /* Clients, as a set of full references */
+    GHashTable *clients;
+
+    /* Devices open, indexed by path (only if not sharded) */
+    GHashTable *devices;
+    /* Devices being open, indexed by path (only if not sharded) */
+    GHashTable *pending_opens;
+
+    /* Sharded mode: each device, together with its clients, is handled in
+     * its own thread and context. Shards are indexed by device path. */
+    gboolean sharded;
+    GHashTable *shards;
+    GMainContext *main_context;
+
+    /* Whether the devices coalesce identical requests */
+    gboolean coalesce_requests;
+    /* Whether the devices cache responses */
+    gboolean response_cache;
+    /* Whether the devices cache indications, replayed to new clients */
+    gboolean indication_cache;
+    /* Where the traffic of all devices is recorded, if any */
+    QmiTraceRing *trace_ring;
+    /* Service requests forwarded to each device at a time, 0 if not limited */
+    guint fair_queue_window;
+
+    /* How long devices are kept open once left without clients, in
+     * seconds, and the paths of the ones never closed; both protected by
+     * the lock, as they're read from the shard threads */
+    guint device_linger;
+    gchar **keep_open;
+
+    /* Whether new clients are handled by the epoll core of their context,
+     * and the one of the main context, if any */
+    gboolean epoll;
+    EpollCore *epoll_core;
+
+    /* Whether new clients and the devices opened afterwards use the
+     * io_uring engine */
+    gboolean io_uring;
+
+    /* Handoff to a new proxy in progress, if any, and whether already done */
+    Handoff *handoff;
+    gboolean handed_off;
+
+    /* Protects the list of clients and the shards */
+    GMutex lock;
 };
 
 /*****************************************************************************/
@@ -75,744 +205,4966 @@ struct _QmiProxyPrivate {
 guint
 qmi_proxy_get_n_clients (QmiProxy *self)
 {
+    guint n_clients;
+
     g_return_val_if_fail (QMI_IS_PROXY (self), 0);
 
-    return g_list_length (self->priv->clients);
+    g_mutex_lock (&self->priv->lock);
+    n_clients = g_hash_table_size (self->priv->clients);
+    g_mutex_unlock (&self->priv->lock);
+    return n_clients;
 }
 
-/*****************************************************************************/
+static gboolean
+notify_n_clients_idle (QmiProxy *self)
+{
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_CLIENTS]);
+    return G_SOURCE_REMOVE;
+}
 
-typedef struct {
-    QmiService service;
-    guint8 cid;
-} QmiClientInfo;
+static void
+notify_n_clients (QmiProxy *self)
+{
+    GSource *source;
 
-typedef struct {
-    volatile gint ref_count;
+    /* Changes in the number of clients coming from the shards are notified
+     * in the main context */
+    if (!self->priv->sharded || g_main_context_is_owner (self->priv->main_context)) {
+        g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_CLIENTS]);
+        return;
+    }
 
-    QmiProxy *proxy; /* not full ref */
-    GSocketConnection *connection;
-    GSource *connection_readable_source;
-    GByteArray *buffer;
-    QmiDevice *device;
-    QmiMessage *internal_proxy_open_request;
-    GArray *qmi_client_info_array;
-    guint indication_id;
-    guint device_removed_id;
-} Client;
+    source = g_idle_source_new ();
+    g_source_set_callback (source,
+                           (GSourceFunc)notify_n_clients_idle,
+                           g_object_ref (self),
+                           (GDestroyNotify)g_object_unref);
+    g_source_attach (source, self->priv->main_context);
+    g_source_unref (source);
+}
 
-static gboolean connection_readable_cb (GSocket *socket, GIOCondition condition, Client *client);
-static void     track_client           (QmiProxy *self, Client *client);
-static void     untrack_client         (QmiProxy *self, Client *client);
+/*****************************************************************************/
+/* epoll core: one single source per main context multiplexing the sockets
+ * of all the clients handled in it, with edge-triggered notifications, so
+ * that each main context iteration costs the same no matter how many clients
+ * are connected */
+
+typedef void (* EpollWatchFn) (guint32  events,
+                               gpointer user_data);
+
+#if defined HAVE_SYS_EPOLL_H
+
+struct _EpollCore {
+    GSource   source;
+    gint      epoll_fd;
+    gpointer  tag;
+    gboolean  dispatching;
+    /* Watches removed while dispatching, freed afterwards */
+    GSList   *removed;
+};
+
+struct _EpollWatch {
+    EpollCore    *core; /* full ref */
+    gint          fd;
+    EpollWatchFn  callback;
+    gpointer      user_data;
+    gboolean      removed;
+};
 
 static void
-client_disconnect (Client *client)
+epoll_watch_free (EpollWatch *watch)
 {
-    if (client->connection_readable_source) {
-        g_source_destroy (client->connection_readable_source);
-        g_source_unref (client->connection_readable_source);
-        client->connection_readable_source = 0;
+    g_source_unref ((GSource *) watch->core);
+    g_slice_free (EpollWatch, watch);
+}
+
+static gboolean
+epoll_core_prepare (GSource *source,
+                    gint    *timeout)
+{
+    *timeout = -1;
+    return FALSE;
+}
+
+static gboolean
+epoll_core_check (GSource *source)
+{
+    return !!(g_source_query_unix_fd (source, ((EpollCore *) source)->tag) & G_IO_IN);
+}
+
+static gboolean
+epoll_core_dispatch (GSource     *source,
+                     GSourceFunc  callback,
+                     gpointer     user_data)
+{
+    EpollCore          *core = (EpollCore *) source;
+    struct epoll_event  events[EPOLL_MAX_EVENTS];
+    gint                n;
+    gint                i;
+
+    /* If there are more events, the epoll fd is still readable and they
+     * are handled in the next iteration */
+    n = epoll_wait (core->epoll_fd, events, EPOLL_MAX_EVENTS, 0);
+    if (n < 0) {
+        if (errno != EINTR)
+            g_warning ("couldn't get socket events: %s", g_strerror (errno));
+        return G_SOURCE_CONTINUE;
     }
 
-    if (client->connection) {
-        g_debug ("Client (%d) connection closed...", g_socket_get_fd (g_socket_connection_get_socket (client->connection)));
-        g_output_stream_close (g_io_stream_get_output_stream (G_IO_STREAM (client->connection)), NULL, NULL);
-        g_object_unref (client->connection);
-        client->connection = NULL;
+    core->dispatching = TRUE;
+    for (i = 0; i < n; i++) {
+        EpollWatch *watch = events[i].data.ptr;
+
+        if (!watch->removed)
+            watch->callback (events[i].events, watch->user_data);
     }
+    core->dispatching = FALSE;
+
+    g_slist_free_full (core->removed, (GDestroyNotify) epoll_watch_free);
+    core->removed = NULL;
+    return G_SOURCE_CONTINUE;
 }
 
 static void
-client_unref (Client *client)
+epoll_core_finalize (GSource *source)
 {
-    if (g_atomic_int_dec_and_test (&client->ref_count)) {
-        /* Ensure disconnected */
-        client_disconnect (client);
-
-        if (client->device) {
-            if (g_signal_handler_is_connected (client->device, client->indication_id))
-                g_signal_handler_disconnect (client->device, client->indication_id);
-            if (g_signal_handler_is_connected (client->device, client->device_removed_id))
-                g_signal_handler_disconnect (client->device, client->device_removed_id);
-            g_object_unref (client->device);
-        }
+    EpollCore *core = (EpollCore *) source;
 
-        if (client->buffer)
-            g_byte_array_unref (client->buffer);
+    g_assert (!core->removed);
+    close (core->epoll_fd);
+}
 
-        if (client->internal_proxy_open_request)
-            g_byte_array_unref (client->internal_proxy_open_request);
+static GSourceFuncs epoll_core_funcs = {
+    epoll_core_prepare,
+    epoll_core_check,
+    epoll_core_dispatch,
+    epoll_core_finalize,
+};
 
-        g_array_unref (client->qmi_client_info_array);
+static EpollCore *
+epoll_core_new (GMainContext *context)
+{
+    EpollCore *core;
+    gint       fd;
 
-        g_slice_free (Client, client);
+    fd = epoll_create1 (EPOLL_CLOEXEC);
+    if (fd < 0) {
+        g_warning ("couldn't create epoll core: %s", g_strerror (errno));
+        return NULL;
     }
+
+    core = (EpollCore *) g_source_new (&epoll_core_funcs, sizeof (EpollCore));
+    core->epoll_fd = fd;
+    core->tag = g_source_add_unix_fd ((GSource *) core, fd, G_IO_IN);
+    g_source_attach ((GSource *) core, context);
+    return core;
 }
 
-static Client *
-client_ref (Client *client)
+static void
+epoll_core_free (EpollCore *core)
 {
-    g_atomic_int_inc (&client->ref_count);
-    return client;
+    /* Watches still registered keep their own references */
+    g_source_destroy ((GSource *) core);
+    g_source_unref ((GSource *) core);
 }
 
-static gboolean
-client_send_message (Client      *client,
-                     QmiMessage  *message,
-                     GError     **error)
+/* Both reads and writes are notified, only when the socket becomes
+ * readable or writable, so the callback must read until the socket would
+ * block, and writes are retried once told so */
+static EpollWatch *
+epoll_core_add (EpollCore    *core,
+                gint          fd,
+                EpollWatchFn  callback,
+                gpointer      user_data)
 {
-    if (!client->connection) {
-        g_set_error (error,
-                     QMI_CORE_ERROR,
-                     QMI_CORE_ERROR_WRONG_STATE,
-                     "Cannot send message: not connected");
-        return FALSE;
-    }
-
-    g_debug ("Client (%d) TX: %u bytes", g_socket_get_fd (g_socket_connection_get_socket (client->connection)), message->len);
-    if (!g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (client->connection)),
-                                    message->data,
-                                    message->len,
-                                    NULL, /* bytes_written */
-                                    NULL, /* cancellable */
-                                    error)) {
-        g_prefix_error (error, "Cannot send message to client: ");
-        return FALSE;
+    EpollWatch         *watch;
+    struct epoll_event  event;
+
+    watch = g_slice_new0 (EpollWatch);
+    watch->core = (EpollCore *) g_source_ref ((GSource *) core);
+    watch->fd = fd;
+    watch->callback = callback;
+    watch->user_data = user_data;
+
+    memset (&event, 0, sizeof (event));
+    event.events = EPOLLIN | EPOLLPRI | EPOLLOUT | EPOLLET;
+    event.data.ptr = watch;
+    if (epoll_ctl (core->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        g_warning ("couldn't add socket to epoll core: %s", g_strerror (errno));
+        epoll_watch_free (watch);
+        return NULL;
     }
 
-    return TRUE;
+    return watch;
 }
 
-/*****************************************************************************/
-/* Track/untrack clients */
-
+/* Must be called before closing the socket */
 static void
-track_client (QmiProxy *self,
-              Client   *client)
+epoll_watch_remove (EpollWatch *watch)
 {
-    self->priv->clients = g_list_append (self->priv->clients, client_ref (client));
-    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_CLIENTS]);
+    EpollCore *core = watch->core;
+
+    epoll_ctl (core->epoll_fd, EPOLL_CTL_DEL, watch->fd, NULL);
+    if (core->dispatching) {
+        watch->removed = TRUE;
+        core->removed = g_slist_prepend (core->removed, watch);
+        return;
+    }
+    epoll_watch_free (watch);
 }
 
-static guint
-get_n_clients_with_device (QmiProxy *self,
-                           QmiDevice *device)
-{
-    GList *l;
-    guint n = 0;
+#else
 
-    for (l = self->priv->clients; l; l = g_list_next (l)) {
-        Client *client = l->data;
+static EpollCore *
+epoll_core_new (GMainContext *context)
+{
+    g_warning ("couldn't create epoll core: not supported");
+    return NULL;
+}
 
-        if (client->device && (device == client->device ||
-            g_str_equal (qmi_device_get_path (device), qmi_device_get_path (client->device))))
-            n++;
-    }
+static void
+epoll_core_free (EpollCore *core)
+{
+    g_assert_not_reached ();
+}
 
-    return n;
+static EpollWatch *
+epoll_core_add (EpollCore    *core,
+                gint          fd,
+                EpollWatchFn  callback,
+                gpointer      user_data)
+{
+    g_assert_not_reached ();
+    return NULL;
 }
 
 static void
-untrack_client (QmiProxy *self,
-                Client   *client)
+epoll_watch_remove (EpollWatch *watch)
 {
-    QmiDevice *device;
+    g_assert_not_reached ();
+}
 
-    device = client->device ? g_object_ref (client->device) : NULL;
+#endif /* HAVE_SYS_EPOLL_H */
 
-    /* Disconnect the client explicitly when untracking */
-    client_disconnect (client);
+/*****************************************************************************/
 
-    if (g_list_find (self->priv->clients, client)) {
-        self->priv->clients = g_list_remove (self->priv->clients, client);
-        client_unref (client);
-        g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_CLIENTS]);
-    }
+typedef struct {
+    QmiService service;
+    guint8 cid;
+} QmiClientInfo;
 
-    if (!device)
-        return;
+typedef struct _Client Client;
+typedef struct _Request Request;
 
-    /* If no more clients using the device, close and cleanup */
-    if (get_n_clients_with_device (self, device) == 0) {
-        GList *l;
+/* Latencies kept for each client, to find their 99th percentile */
+#define CLIENT_LATENCY_SAMPLES 128
 
-        for (l = self->priv->devices; l; l = g_list_next (l)) {
-            QmiDevice *device_in_list = QMI_DEVICE (l->data);
+/* State of an open device, shared by all the clients using it */
+typedef struct {
+    QmiProxy *proxy; /* not full ref */
+    QmiDevice *device;
+    /* Clients using the device; not full refs */
+    GHashTable *clients;
+    /* Clients by (service, cid), for unicast indications; not full refs */
+    GHashTable *clients_by_cid;
+    /* Per service, clients with at least one CID in it and how many, for
+     * broadcast indications; not full refs */
+    GHashTable *clients_by_service[G_MAXUINT8 + 1];
+    /* Clients monitoring the indications of any service; not full refs */
+    GHashTable *monitors;
+    /* CTL requests of all the clients, which share the 8bit transaction id
+     * space of the device: the ones forwarded, by the transaction id given
+     * to them, and the ones waiting for a free one; not full refs */
+    Request *ctl_requests[G_MAXUINT8 + 1];
+    guint8 ctl_next_trid;
+    GQueue ctl_queue;
+    /* Service requests of all the clients, when fair queuing: the ones
+     * forwarded and not yet completed, up to the window, and the clients
+     * with requests waiting, in round-robin order; not full refs */
+    guint fair_window;
+    GHashTable *fair_in_flight;
+    GQueue fair_clients;
+    guint indication_id;
+    guint device_removed_id;
+    /* Set while the device is kept open without clients */
+    GSource *linger_source;
+    gboolean keep_open;
+} DeviceInfo;
 
-            if (device_in_list && (device == device_in_list ||
-                g_str_equal (qmi_device_get_path (device), qmi_device_get_path (device_in_list)))) {
-                g_debug ("closing device '%s': no longer used", qmi_device_get_path_display (device));
-                qmi_device_close (device_in_list, NULL);
-                g_object_unref (device_in_list);
-                self->priv->devices = g_list_remove (self->priv->devices, device_in_list);
-                break;
-            }
-        }
-    }
+typedef struct _PendingOpen PendingOpen;
 
-    g_object_unref (device);
-}
+typedef struct {
+    QmiProxy     *proxy;       /* not full ref; unset once finalized */
+    gchar        *path;
+    GThread      *thread;
+    GThread      *previous;    /* finishing shard for the same path */
+    GMainContext *context;
+    GMainLoop    *loop;
+    DeviceInfo   *device_info; /* only used from the shard thread */
+    PendingOpen  *pending_open; /* only used from the shard thread */
+    EpollCore    *epoll_core;  /* only used from the shard thread */
+    guint         n_clients;   /* protected by the proxy lock */
+    gboolean      finishing;   /* protected by the proxy lock */
+} Shard;
+
+struct _Client {
+    volatile gint ref_count;
 
-static QmiDevice *
-find_device_for_path (QmiProxy *self,
-                      const gchar *path)
-{
-    GList *l;
+    QmiProxy *proxy; /* not full ref */
+    Shard *shard;
+    gboolean shard_handoff;
+    GSocketConnection *connection;
+    GSource *connection_readable_source;
+    GSource *connection_writable_source;
+    /* Used instead of the sources when handled by an epoll core */
+    gboolean epoll;
+    EpollWatch *epoll_watch;
+    gboolean output_waiting;
+    /* Used instead of the sources when handled by the io_uring engine */
+    gboolean io_uring;
+    QmiIoUringWatch *io_uring_watch;
+    /* Remote clients connect over TCP, must authenticate first, and get
+     * all the messages queued in the same main context iteration written
+     * at once */
+    gboolean remote;
+    gboolean auth_pending;
+    GSource *output_batch_source;
+    /* Remote clients through TLS are read and written through the streams
+     * of the TLS connection, never through the raw socket */
+    GIOStream *tls_connection;
+    GQueue *output_queue; /* QmiMessage full refs, shared with other clients */
+    gsize output_offset;
+    gsize output_pending;
+    gboolean stalled;
+    GByteArray *buffer;
+    guint buffer_offset;
+    QmiDevice *device;
+    DeviceInfo *device_info; /* set while using the device */
+    QmiMessage *internal_proxy_open_request;
+    GArray *qmi_client_info_array;
+    /* Requests forwarded to the device and not yet completed, indexed by
+     * (service, cid, transaction id); not full refs */
+    GHashTable *requests;
+    /* Process id of the peer, 0 if unknown, and whether the peer runs as
+     * the same user as the proxy */
+    guint32 pid;
+    gboolean same_user;
+    /* Service requests waiting for room in the window of the device, and
+     * the link of the client in the round-robin list of the device */
+    GQueue fair_queue;
+    GList fair_link;
+    /* Cancelled when the client goes away, aborting all its requests */
+    GCancellable *cancellable;
+    /* Indications the client asked for, as (service, message id) keys, in
+     * the services flagged as filtered; all others are forwarded */
+    GHashTable *indication_filter;
+    guint32 indication_filtered_services[(G_MAXUINT8 + 1) / 32];
+    /* Services whose indications are all forwarded to the client, whatever
+     * the CID they're addressed to */
+    guint32 monitored_services[(G_MAXUINT8 + 1) / 32];
+    gboolean monitoring;
+    /* Statistics, with their own lock so that they can be queried from the
+     * main context while the client is handled in a shard: the device in
+     * use, and the most recent latencies, in microseconds */
+    GMutex stats_lock;
+    QmiProxyClientStats stats;
+    QmiDevice *stats_device;
+    guint32 latency_samples[CLIENT_LATENCY_SAMPLES];
+    guint n_latency_samples;
+    guint next_latency_sample;
+};
 
-    for (l = self->priv->devices; l; l = g_list_next (l)) {
-        QmiDevice *device;
+/* Handoff requested by a new proxy, while draining the requests in flight */
+struct _Handoff {
+    Client     *client; /* full ref */
+    QmiMessage *request;
+    gint64      deadline;
+    GSource    *drain_source;
+};
 
-        device = (QmiDevice *)l->data;
+static void device_info_free (DeviceInfo *info);
+static void device_info_clear_ctl_requests (DeviceInfo *info);
+static void device_info_clear_fair_requests (DeviceInfo *info, Client *client);
 
-        /* Return if found */
-        if (g_str_equal (qmi_device_get_path (device), path))
-            return device;
-    }
+static gboolean connection_readable_cb (GSocket *socket, GIOCondition condition, Client *client);
+static gboolean client_tls_readable_cb (GObject *stream, Client *client);
+static void     track_client           (QmiProxy *self, Client *client);
+static void     untrack_client         (QmiProxy *self, Client *client);
+static void     client_output_flush    (Client *client);
+static Client  *client_ref             (Client *client);
+static gboolean client_process_input   (QmiProxy *self, Client *client);
+static void     client_io_uring_read_cb  (const guint8 *data, gsize len, const GError *error, Client *client);
+static void     client_io_uring_write_cb (gssize written, const GError *error, Client *client);
+static void     client_unref           (Client *client);
 
-    return NULL;
-}
+/*****************************************************************************/
+/* Statistics */
 
-static void
-complete_internal_proxy_open (QmiProxy *self,
-                              Client   *client)
+static gint
+guint32_cmp (gconstpointer a,
+             gconstpointer b)
 {
-    QmiMessage *response;
-    GError *error = NULL;
+    guint32 va = *((const guint32 *) a);
+    guint32 vb = *((const guint32 *) b);
 
-    g_debug ("connection to QMI device '%s' established", qmi_device_get_path (client->device));
+    return (va < vb ? -1 : (va > vb ? 1 : 0));
+}
 
-    g_assert (client->internal_proxy_open_request != NULL);
-    response = qmi_message_response_new (client->internal_proxy_open_request, QMI_PROTOCOL_ERROR_NONE);
-    qmi_message_unref (client->internal_proxy_open_request);
-    client->internal_proxy_open_request = NULL;
+/* Sorts the samples */
+static guint64
+latency_samples_p99 (guint32 *samples,
+                     guint    n_samples)
+{
+    if (!n_samples)
+        return 0;
 
-    if (!client_send_message (client, response, &error)) {
-        g_warning ("couldn't send proxy open response to client: %s", error->message);
-        g_error_free (error);
-        untrack_client (self, client);
-    }
+    qsort (samples, n_samples, sizeof (guint32), guint32_cmp);
+    return samples[(n_samples * 99 + 99) / 100 - 1];
+}
 
-    qmi_message_unref (response);
+static void
+client_stats_add_latency (Client  *client,
+                          guint64  latency)
+{
+    client->stats.n_responses++;
+    client->stats.latency_total += latency;
+    if (latency > client->stats.latency_max)
+        client->stats.latency_max = latency;
+
+    client->latency_samples[client->next_latency_sample] = (guint32) MIN (latency, G_MAXUINT32);
+    client->next_latency_sample = (client->next_latency_sample + 1) % CLIENT_LATENCY_SAMPLES;
+    if (client->n_latency_samples < CLIENT_LATENCY_SAMPLES)
+        client->n_latency_samples++;
 }
 
 static void
-indication_cb (QmiDevice *device,
-               QmiMessage *message,
-               Client *client)
+client_stats_clear (QmiProxyClientStats *stats)
 {
-    guint i;
+    g_free (stats->device_path);
+}
 
-    for (i = 0; i < client->qmi_client_info_array->len; i++) {
-        QmiClientInfo *info;
+GArray *
+qmi_proxy_get_client_stats (QmiProxy *self)
+{
+    GArray         *array;
+    GHashTableIter  iter;
+    Client         *client;
+
+    g_return_val_if_fail (QMI_IS_PROXY (self), NULL);
+
+    g_mutex_lock (&self->priv->lock);
+    array = g_array_sized_new (FALSE, FALSE, sizeof (QmiProxyClientStats),
+                               g_hash_table_size (self->priv->clients));
+    g_array_set_clear_func (array, (GDestroyNotify)client_stats_clear);
+    g_hash_table_iter_init (&iter, self->priv->clients);
+    while (g_hash_table_iter_next (&iter, (gpointer *)&client, NULL)) {
+        QmiProxyClientStats stats;
+        guint32             samples[CLIENT_LATENCY_SAMPLES];
+        guint               n_samples;
+
+        g_mutex_lock (&client->stats_lock);
+        stats = client->stats;
+        stats.device_path = g_strdup (client->stats.device_path);
+        n_samples = client->n_latency_samples;
+        memcpy (samples, client->latency_samples, n_samples * sizeof (guint32));
+        g_mutex_unlock (&client->stats_lock);
+
+        stats.latency_p99 = latency_samples_p99 (samples, n_samples);
+        g_array_append_val (array, stats);
+    }
+    g_mutex_unlock (&self->priv->lock);
 
-        info = &g_array_index (client->qmi_client_info_array, QmiClientInfo, i);
-        /* If service and CID match; or if service and broadcast, forward to
-         * the remote client */
-        if ((qmi_message_get_service (message) == info->service) &&
-            (qmi_message_get_client_id (message) == info->cid ||
-             qmi_message_get_client_id (message) == QMI_CID_BROADCAST)) {
-            GError *error = NULL;
+    return array;
+}
 
-            if (!client_send_message (client, message, &error)) {
-                g_warning ("couldn't forward indication to client: %s", error->message);
-                g_error_free (error);
-            }
+typedef struct {
+    QmiDevice           *device;
+    QmiProxyDeviceStats  stats;
+    guint64              n_responses;
+    guint64              latency_total;
+    GArray              *samples;
+} DeviceStatsContext;
 
-            /* Avoid forwarding broadcast messages multiple times */
-            break;
-        }
-    }
+static void
+device_stats_clear (QmiProxyDeviceStats *stats)
+{
+    g_free (stats->device_path);
 }
 
-static void
-device_removed_cb (QmiDevice *device,
-                   Client *client)
+GArray *
+qmi_proxy_get_device_stats (QmiProxy *self)
 {
-    untrack_client (client->proxy, client);
+    GArray         *array;
+    GPtrArray      *contexts;
+    GHashTableIter  iter;
+    Client         *client;
+    guint           i;
+
+    g_return_val_if_fail (QMI_IS_PROXY (self), NULL);
+
+    /* Devices are found through their clients, as in sharded mode each
+     * device is only known in its own shard */
+    contexts = g_ptr_array_new ();
+    g_mutex_lock (&self->priv->lock);
+    g_hash_table_iter_init (&iter, self->priv->clients);
+    while (g_hash_table_iter_next (&iter, (gpointer *)&client, NULL)) {
+        DeviceStatsContext *ctx = NULL;
+
+        g_mutex_lock (&client->stats_lock);
+        if (client->stats_device) {
+            for (i = 0; i < contexts->len; i++) {
+                ctx = g_ptr_array_index (contexts, i);
+                if (ctx->device == client->stats_device)
+                    break;
+                ctx = NULL;
+            }
+            if (!ctx) {
+                ctx = g_slice_new0 (DeviceStatsContext);
+                ctx->device = g_object_ref (client->stats_device);
+                ctx->samples = g_array_new (FALSE, FALSE, sizeof (guint32));
+                g_ptr_array_add (contexts, ctx);
+            }
+            ctx->stats.n_clients++;
+            ctx->n_responses += client->stats.n_responses;
+            ctx->latency_total += client->stats.latency_total;
+            g_array_append_vals (ctx->samples, client->latency_samples, client->n_latency_samples);
+        }
+        g_mutex_unlock (&client->stats_lock);
+    }
+    g_mutex_unlock (&self->priv->lock);
+
+    array = g_array_sized_new (FALSE, FALSE, sizeof (QmiProxyDeviceStats), contexts->len);
+    g_array_set_clear_func (array, (GDestroyNotify)device_stats_clear);
+    for (i = 0; i < contexts->len; i++) {
+        DeviceStatsContext *ctx;
+        QmiDeviceStats      device_stats;
+
+        ctx = g_ptr_array_index (contexts, i);
+        qmi_device_get_stats (ctx->device, &device_stats);
+        ctx->stats.device_path = g_strdup (qmi_device_get_path (ctx->device));
+        ctx->stats.n_requests = device_stats.n_requests;
+        ctx->stats.n_responses = device_stats.n_responses;
+        ctx->stats.n_timeouts = device_stats.n_timeouts;
+        ctx->stats.n_aborts = device_stats.n_aborts;
+        ctx->stats.n_indications = device_stats.n_indications;
+        ctx->stats.n_coalesced = device_stats.n_coalesced;
+        ctx->stats.n_cached = device_stats.n_cached;
+        ctx->stats.bytes_sent = device_stats.bytes_sent;
+        ctx->stats.bytes_received = device_stats.bytes_received;
+        ctx->stats.n_in_flight = device_stats.n_in_flight;
+        ctx->stats.output_queue_length = device_stats.output_queue_length;
+        ctx->stats.throttled_queue_length = device_stats.throttled_queue_length;
+        ctx->stats.latency_mean = (ctx->n_responses ? ctx->latency_total / ctx->n_responses : 0);
+        ctx->stats.latency_p99 = latency_samples_p99 ((guint32 *) ctx->samples->data, ctx->samples->len);
+        g_array_append_val (array, ctx->stats);
+
+        g_array_unref (ctx->samples);
+        g_object_unref (ctx->device);
+        g_slice_free (DeviceStatsContext, ctx);
+    }
+    g_ptr_array_unref (contexts);
+
+    return array;
 }
 
 static void
-device_open_ready (QmiDevice *device,
-                   GAsyncResult *res,
-                   Client *client)
+client_epoll_cb (guint32  events,
+                 Client  *client)
 {
-    QmiProxy *self = client->proxy;
-    QmiDevice *existing;
-    GError *error = NULL;
-
-    /* Note: we get a full client ref */
+#if defined HAVE_SYS_EPOLL_H
+    GIOCondition condition = 0;
 
-    if (!qmi_device_open_finish (device, res, &error)) {
-        g_debug ("couldn't open QMI device: %s", error->message);
-        g_error_free (error);
-        untrack_client (self, client);
-        goto out;
-    }
+    /* The client may be untracked while handling the events */
+    client_ref (client);
 
-    /* Store device in the proxy independently */
-    existing = find_device_for_path (self, qmi_device_get_path (client->device));
-    if (existing) {
-        /* Race condition, we created two QmiDevices for the same port, just skip ours, no big deal */
-        g_object_unref (client->device);
-        client->device = g_object_ref (existing);
-    } else {
-        /* Keep the newly added device in the proxy */
-        self->priv->devices = g_list_append (self->priv->devices, g_object_ref (client->device));
+    if ((events & EPOLLOUT) && client->output_waiting) {
+        client->output_waiting = FALSE;
+        client_output_flush (client);
     }
 
-    /* Register for device indications */
-    client->indication_id = g_signal_connect (client->device,
-                                              "indication",
-                                              G_CALLBACK (indication_cb),
-                                              client);
-    client->device_removed_id = g_signal_connect (client->device,
-                                                  "device-removed",
-                                                  G_CALLBACK (device_removed_cb),
-                                                  client);
-
-    complete_internal_proxy_open (self, client);
+    if (events & (EPOLLIN | EPOLLPRI))
+        condition |= G_IO_IN;
+    if (events & EPOLLHUP)
+        condition |= G_IO_HUP;
+    if (events & EPOLLERR)
+        condition |= G_IO_ERR;
+    if (condition && client->epoll_watch)
+        connection_readable_cb (g_socket_connection_get_socket (client->connection), condition, client);
 
-out:
-    /* Balance out the reference we got */
     client_unref (client);
+#endif
 }
 
 static void
-device_new_ready (GObject *source,
-                  GAsyncResult *res,
-                  Client *client)
+client_setup_readable_source (Client       *client,
+                              GMainContext *context)
 {
-    QmiProxy *self = client->proxy;
-    GError *error = NULL;
+    g_assert (!client->connection_readable_source);
+    g_assert (!client->epoll_watch);
+    g_assert (!client->io_uring_watch);
+
+    /* The source of the TLS input stream also tells when there is already
+     * decrypted data waiting to be read */
+    if (client->tls_connection) {
+        client->connection_readable_source =
+            g_pollable_input_stream_create_source (G_POLLABLE_INPUT_STREAM (g_io_stream_get_input_stream (client->tls_connection)),
+                                                   NULL);
+        g_source_set_callback (client->connection_readable_source,
+                               (GSourceFunc)client_tls_readable_cb,
+                               client,
+                               NULL);
+        g_source_attach (client->connection_readable_source, context);
+        return;
+    }
 
-    /* Note: we get a full client ref */
+    if (client->io_uring) {
+        GError *error = NULL;
 
-    client->device = qmi_device_new_finish (res, &error);
-    if (!client->device) {
-        g_debug ("couldn't open QMI device: %s", error->message);
+        client->io_uring_watch = __qmi_io_uring_watch_new (context,
+                                                           g_socket_get_fd (g_socket_connection_get_socket (client->connection)),
+                                                           TRUE,
+                                                           (QmiIoUringReadFn) client_io_uring_read_cb,
+                                                           (QmiIoUringWriteFn) client_io_uring_write_cb,
+                                                           client,
+                                                           &error);
+        if (client->io_uring_watch)
+            return;
+
+        /* Otherwise, fall back to the other engines */
+        g_debug ("io_uring engine unavailable: %s", error->message);
         g_error_free (error);
-        untrack_client (self, client);
-        goto out;
+        client->io_uring = FALSE;
     }
 
-    qmi_device_open (client->device,
-                     QMI_DEVICE_OPEN_FLAGS_NONE,
-                     10,
-                     NULL,
-                     (GAsyncReadyCallback)device_open_ready,
-                     client_ref (client)); /* Full ref */
+    if (client->epoll) {
+        EpollCore **core;
+
+        /* One single core in each main context */
+        core = (client->shard ? &client->shard->epoll_core : &client->proxy->priv->epoll_core);
+        if (!*core)
+            *core = epoll_core_new (context);
+        if (*core) {
+            client->epoll_watch = epoll_core_add (*core,
+                                                  g_socket_get_fd (g_socket_connection_get_socket (client->connection)),
+                                                  (EpollWatchFn) client_epoll_cb,
+                                                  client);
+            if (client->epoll_watch)
+                return;
+        }
 
-out:
-    /* Balance out the reference we got */
-    client_unref (client);
-}
+        /* Otherwise, fall back to sources of its own */
+        client->epoll = FALSE;
+    }
 
-static gboolean
-process_internal_proxy_open (QmiProxy   *self,
+    client->connection_readable_source = g_socket_create_source (g_socket_connection_get_socket (client->connection),
+                                                                 G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP,
+                                                                 NULL);
+    g_source_set_callback (client->connection_readable_source,
+                           (GSourceFunc)connection_readable_cb,
+                           client,
+                           NULL);
+    g_source_attach (client->connection_readable_source, context);
+}
+
+/* Both reading and writing, until the readable source is setup again */
+static void
+client_stop_reading (Client *client)
+{
+    if (client->connection_readable_source) {
+        g_source_destroy (client->connection_readable_source);
+        g_clear_pointer (&client->connection_readable_source, g_source_unref);
+    }
+    if (client->epoll_watch) {
+        epoll_watch_remove (client->epoll_watch);
+        client->epoll_watch = NULL;
+    }
+    g_clear_pointer (&client->io_uring_watch, __qmi_io_uring_watch_free);
+    if (client->connection_writable_source) {
+        g_source_destroy (client->connection_writable_source);
+        g_clear_pointer (&client->connection_writable_source, g_source_unref);
+    }
+    if (client->output_batch_source) {
+        g_source_destroy (client->output_batch_source);
+        g_clear_pointer (&client->output_batch_source, g_source_unref);
+    }
+    client->output_waiting = FALSE;
+}
+
+static void
+client_output_clear (Client *client)
+{
+    if (client->connection_writable_source) {
+        g_source_destroy (client->connection_writable_source);
+        g_clear_pointer (&client->connection_writable_source, g_source_unref);
+    }
+    if (client->output_batch_source) {
+        g_source_destroy (client->output_batch_source);
+        g_clear_pointer (&client->output_batch_source, g_source_unref);
+    }
+    client->output_waiting = FALSE;
+
+    g_queue_foreach (client->output_queue, (GFunc)qmi_message_unref, NULL);
+    g_queue_clear (client->output_queue);
+    client->output_offset = 0;
+    client->output_pending = 0;
+}
+
+static void
+client_disconnect (Client *client)
+{
+    client_stop_reading (client);
+    client_output_clear (client);
+
+    if (client->tls_connection) {
+        g_io_stream_close (client->tls_connection, NULL, NULL);
+        g_clear_object (&client->tls_connection);
+    }
+
+    if (client->connection) {
+        g_debug ("Client (%d) connection closed...", g_socket_get_fd (g_socket_connection_get_socket (client->connection)));
+        g_output_stream_close (g_io_stream_get_output_stream (G_IO_STREAM (client->connection)), NULL, NULL);
+        g_object_unref (client->connection);
+        client->connection = NULL;
+    }
+}
+
+static void
+client_unref (Client *client)
+{
+    if (g_atomic_int_dec_and_test (&client->ref_count)) {
+        /* Ensure disconnected */
+        client_disconnect (client);
+
+        if (client->device)
+            g_object_unref (client->device);
+
+        if (client->buffer)
+            g_byte_array_unref (client->buffer);
+
+        if (client->internal_proxy_open_request)
+            g_byte_array_unref (client->internal_proxy_open_request);
+
+        g_array_unref (client->qmi_client_info_array);
+        g_queue_free (client->output_queue);
+        g_hash_table_unref (client->requests);
+        g_object_unref (client->cancellable);
+        if (client->indication_filter)
+            g_hash_table_unref (client->indication_filter);
+
+        g_free (client->stats.device_path);
+        if (client->stats_device)
+            g_object_unref (client->stats_device);
+        g_mutex_clear (&client->stats_lock);
+
+        g_slice_free (Client, client);
+        __qmi_utils_live_object_add (QMI_UTILS_LIVE_OBJECT_PROXY_CLIENT, -1);
+    }
+}
+
+static Client *
+client_ref (Client *client)
+{
+    g_atomic_int_inc (&client->ref_count);
+    return client;
+}
+
+#define BUILD_INDICATION_FILTER_KEY(service, message_id) GUINT_TO_POINTER (((guint)(service) << 16) | (guint)(message_id))
+
+static gboolean
+client_wants_indication (Client     *client,
+                         QmiMessage *message)
+{
+    guint8 service;
+
+    service = (guint8) qmi_message_get_service (message);
+    if (!(client->indication_filtered_services[service / 32] & (1u << (service % 32))))
+        return TRUE;
+
+    return g_hash_table_contains (client->indication_filter,
+                                  BUILD_INDICATION_FILTER_KEY (service, qmi_message_get_message_id (message)));
+}
+
+static gboolean
+client_stalled_idle (Client *client)
+{
+    untrack_client (client->proxy, client);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+client_set_stalled (Client *client)
+{
+    GSource *source;
+
+    if (client->stalled)
+        return;
+
+    /* The client is untracked from an idle, as we may be in the middle of
+     * forwarding an indication to several clients */
+    g_warning ("Client (%d) not reading: %" G_GSIZE_FORMAT " bytes pending, disconnecting",
+               g_socket_get_fd (g_socket_connection_get_socket (client->connection)),
+               client->output_pending);
+    client->stalled = TRUE;
+    client_stop_reading (client);
+    client_output_clear (client);
+
+    source = g_idle_source_new ();
+    g_source_set_callback (source,
+                           (GSourceFunc)client_stalled_idle,
+                           client_ref (client),
+                           (GDestroyNotify)client_unref);
+    g_source_attach (source, g_main_context_get_thread_default ());
+    g_source_unref (source);
+}
+
+static gboolean client_output_ready_cb (GSocket      *socket,
+                                        GIOCondition  condition,
+                                        Client       *client);
+
+/* Removes all the messages fully written */
+static void
+client_output_advance (Client *client,
+                       gsize   written)
+{
+    client->output_pending -= written;
+    while (written > 0) {
+        QmiMessage *message;
+        gsize       pending;
+
+        message = g_queue_peek_head (client->output_queue);
+        pending = message->len - client->output_offset;
+        if (written < pending) {
+            client->output_offset += written;
+            break;
+        }
+
+        written -= pending;
+        client->output_offset = 0;
+        qmi_message_unref (g_queue_pop_head (client->output_queue));
+    }
+}
+
+/* One write in flight at a time, with the messages kept alive until it
+ * completes */
+static void
+client_output_io_uring_flush (Client *client)
+{
+    struct iovec  vectors[CLIENT_OUTPUT_MAX_VECTORS];
+    GPtrArray    *messages;
+    GList        *l;
+    guint         n_vectors = 0;
+
+    if (g_queue_is_empty (client->output_queue) ||
+        __qmi_io_uring_watch_is_writing (client->io_uring_watch))
+        return;
+
+    messages = g_ptr_array_new_with_free_func ((GDestroyNotify) qmi_message_unref);
+    for (l = g_queue_peek_head_link (client->output_queue);
+         l && n_vectors < CLIENT_OUTPUT_MAX_VECTORS;
+         l = g_list_next (l), n_vectors++) {
+        vectors[n_vectors].iov_base = ((QmiMessage *) l->data)->data;
+        vectors[n_vectors].iov_len = ((QmiMessage *) l->data)->len;
+        g_ptr_array_add (messages, qmi_message_ref (l->data));
+    }
+    vectors[0].iov_base = ((guint8 *) vectors[0].iov_base) + client->output_offset;
+    vectors[0].iov_len -= client->output_offset;
+
+    __qmi_io_uring_watch_write (client->io_uring_watch,
+                                vectors,
+                                n_vectors,
+                                messages,
+                                (GDestroyNotify) g_ptr_array_unref);
+}
+
+static void
+client_io_uring_write_cb (gssize        written,
+                          const GError *error,
+                          Client       *client)
+{
+    if (written < 0) {
+        /* The read completion reports the connection as closed */
+        g_warning ("Cannot send message to client: %s", error->message);
+        client_output_clear (client);
+        return;
+    }
+
+    client_output_advance (client, (gsize) written);
+    client_output_io_uring_flush (client);
+}
+
+static gboolean
+client_output_tls_ready_cb (GObject *stream,
+                            Client  *client)
+{
+    g_clear_pointer (&client->connection_writable_source, g_source_unref);
+    client_output_flush (client);
+    return G_SOURCE_REMOVE;
+}
+
+/* One message per write: a write that would block must be retried with the
+ * same data, which is only guaranteed if the head of the queue is written */
+static void
+client_output_tls_flush (Client *client)
+{
+    GPollableOutputStream *stream;
+
+    stream = G_POLLABLE_OUTPUT_STREAM (g_io_stream_get_output_stream (client->tls_connection));
+
+    while (!g_queue_is_empty (client->output_queue)) {
+        QmiMessage *message;
+        gssize      written;
+        GError     *error = NULL;
+
+        message = g_queue_peek_head (client->output_queue);
+        written = g_pollable_output_stream_write_nonblocking (stream,
+                                                              &message->data[client->output_offset],
+                                                              message->len - client->output_offset,
+                                                              NULL,
+                                                              &error);
+        if (written < 0) {
+            if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+                g_error_free (error);
+                break;
+            }
+
+            /* The readable source reports the connection as closed */
+            g_warning ("Cannot send message to client: %s", error->message);
+            g_error_free (error);
+            client_output_clear (client);
+            return;
+        }
+
+        client_output_advance (client, (gsize) written);
+    }
+
+    if (!g_queue_is_empty (client->output_queue) && !client->connection_writable_source) {
+        client->connection_writable_source = g_pollable_output_stream_create_source (stream, NULL);
+        g_source_set_callback (client->connection_writable_source,
+                               (GSourceFunc)client_output_tls_ready_cb,
+                               client,
+                               NULL);
+        g_source_attach (client->connection_writable_source, g_main_context_get_thread_default ());
+    }
+}
+
+static void
+client_output_flush (Client *client)
+{
+    GSocket *socket;
+
+    if (client->io_uring_watch) {
+        client_output_io_uring_flush (client);
+        return;
+    }
+
+    if (client->tls_connection) {
+        client_output_tls_flush (client);
+        return;
+    }
+
+    socket = g_socket_connection_get_socket (client->connection);
+
+    while (!g_queue_is_empty (client->output_queue)) {
+        GOutputVector  vectors[CLIENT_OUTPUT_MAX_VECTORS];
+        GList         *l;
+        guint          n_vectors = 0;
+        gssize         written;
+        GError        *error = NULL;
+
+        /* Messages are written straight from the buffers shared among all
+         * the clients they're forwarded to */
+        for (l = g_queue_peek_head_link (client->output_queue);
+             l && n_vectors < CLIENT_OUTPUT_MAX_VECTORS;
+             l = g_list_next (l), n_vectors++) {
+            vectors[n_vectors].buffer = ((QmiMessage *) l->data)->data;
+            vectors[n_vectors].size = ((QmiMessage *) l->data)->len;
+        }
+        vectors[0].buffer = ((const guint8 *) vectors[0].buffer) + client->output_offset;
+        vectors[0].size -= client->output_offset;
+
+        written = g_socket_send_message (socket,
+                                         NULL, /* address */
+                                         vectors,
+                                         n_vectors,
+                                         NULL, /* messages */
+                                         0,
+                                         0, /* flags */
+                                         NULL, /* cancellable */
+                                         &error);
+        if (written < 0) {
+            if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+                g_error_free (error);
+                break;
+            }
+
+            /* The readable source reports the connection as closed */
+            g_warning ("Cannot send message to client: %s", error->message);
+            g_error_free (error);
+            client_output_clear (client);
+            return;
+        }
+
+        client_output_advance (client, (gsize) written);
+    }
+
+    /* Wait until the socket is writable again if there's still pending
+     * data; the epoll core tells once it is */
+    if (!g_queue_is_empty (client->output_queue) && client->epoll_watch)
+        client->output_waiting = TRUE;
+    else if (!g_queue_is_empty (client->output_queue) && !client->connection_writable_source) {
+        client->connection_writable_source = g_socket_create_source (socket, G_IO_OUT, NULL);
+        g_source_set_callback (client->connection_writable_source,
+                               (GSourceFunc)client_output_ready_cb,
+                               client,
+                               NULL);
+        g_source_attach (client->connection_writable_source, g_main_context_get_thread_default ());
+    }
+}
+
+static gboolean
+client_output_ready_cb (GSocket      *socket,
+                        GIOCondition  condition,
+                        Client       *client)
+{
+    g_clear_pointer (&client->connection_writable_source, g_source_unref);
+    client_output_flush (client);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+client_output_batch_cb (Client *client)
+{
+    g_clear_pointer (&client->output_batch_source, g_source_unref);
+    client_output_flush (client);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+client_send_message (Client      *client,
+                     QmiMessage  *message,
+                     GError     **error)
+{
+    if (!client->connection || client->stalled) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_WRONG_STATE,
+                     "Cannot send message: not connected");
+        return FALSE;
+    }
+
+    g_debug ("Client (%d) TX: %u bytes", g_socket_get_fd (g_socket_connection_get_socket (client->connection)), message->len);
+    QMI_PROBE_MESSAGE_VALUE (proxy_forward, message, 0);
+
+    /* Clients not reading what they're sent would otherwise make the
+     * queue grow without limit */
+    if (client->output_pending + message->len > CLIENT_OUTPUT_HIGH_WATERMARK) {
+        client_set_stalled (client);
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_WRONG_STATE,
+                     "Cannot send message: client not reading");
+        return FALSE;
+    }
+
+    g_queue_push_tail (client->output_queue, qmi_message_ref (message));
+    client->output_pending += message->len;
+
+    g_mutex_lock (&client->stats_lock);
+    client->stats.bytes_sent += message->len;
+    if (qmi_message_is_indication (message))
+        client->stats.n_indications++;
+    g_mutex_unlock (&client->stats_lock);
+
+    /* If already waiting for the socket to be writable, nothing else to do */
+    if (client->connection_writable_source || client->output_waiting || client->output_batch_source)
+        return TRUE;
+
+    /* Every write to a remote client ends up as at least one segment in the
+     * network, so all the messages queued until the main context is idle
+     * are written together */
+    if (client->remote) {
+        client->output_batch_source = g_idle_source_new ();
+        g_source_set_callback (client->output_batch_source,
+                               (GSourceFunc)client_output_batch_cb,
+                               client,
+                               NULL);
+        g_source_attach (client->output_batch_source, g_main_context_get_thread_default ());
+        return TRUE;
+    }
+
+    client_output_flush (client);
+    return TRUE;
+}
+
+/*****************************************************************************/
+/* Shards */
+
+static gboolean
+shard_quit_idle (GMainLoop *loop)
+{
+    g_main_loop_quit (loop);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+shard_quit (GMainLoop *loop)
+{
+    GSource *source;
+
+    /* Quit from within the loop, so that it doesn't matter whether it is
+     * already running or not */
+    source = g_idle_source_new ();
+    g_source_set_callback (source,
+                           (GSourceFunc)shard_quit_idle,
+                           g_main_loop_ref (loop),
+                           (GDestroyNotify)g_main_loop_unref);
+    g_source_attach (source, g_main_loop_get_context (loop));
+    g_source_unref (source);
+}
+
+static gpointer
+shard_thread_func (Shard *shard)
+{
+    QmiProxy *proxy;
+    gboolean  drain = FALSE;
+
+    /* The device may only be opened once the previous shard for the same
+     * path has closed it */
+    if (shard->previous) {
+        g_thread_join (shard->previous);
+        g_atomic_pointer_set (&shard->previous, NULL);
+    }
+
+    g_main_context_push_thread_default (shard->context);
+    g_main_loop_run (shard->loop);
+
+    if (shard->device_info)
+        device_info_free (shard->device_info);
+
+    /* The device is closed; only now may a new shard take over the path.
+     * If the proxy is being finalized, it will join this thread before
+     * going away. */
+    proxy = g_atomic_pointer_get (&shard->proxy);
+    if (proxy) {
+        g_mutex_lock (&proxy->priv->lock);
+        if (g_hash_table_lookup (proxy->priv->shards, shard->path) == shard)
+            g_hash_table_remove (proxy->priv->shards, shard->path);
+        drain = !shard->n_clients;
+        g_mutex_unlock (&proxy->priv->lock);
+    }
+
+    /* Complete whatever was left pending in the shard, unless the whole
+     * proxy is going away */
+    if (drain)
+        while (g_main_context_iteration (shard->context, FALSE));
+
+    if (shard->epoll_core)
+        epoll_core_free (shard->epoll_core);
+
+    g_main_context_pop_thread_default (shard->context);
+
+    g_debug ("shard for '%s' finished", shard->path);
+
+    g_main_loop_unref (shard->loop);
+    g_main_context_unref (shard->context);
+    g_thread_unref (shard->thread);
+    g_free (shard->path);
+    g_slice_free (Shard, shard);
+    return NULL;
+}
+
+/* Must be called with the proxy lock held */
+static Shard *
+shard_get_for_path (QmiProxy     *self,
+                    const gchar  *path,
+                    GError      **error)
+{
+    Shard *shard;
+    Shard *previous;
+
+    previous = g_hash_table_lookup (self->priv->shards, path);
+    if (previous && !previous->finishing)
+        return previous;
+
+    shard = g_slice_new0 (Shard);
+    shard->proxy = self;
+    shard->path = g_strdup (path);
+    /* A shard still closing the device stays in the table until done; the
+     * new one waits for it before opening the device again */
+    if (previous)
+        shard->previous = g_thread_ref (previous->thread);
+    shard->context = g_main_context_new ();
+    shard->loop = g_main_loop_new (shard->context, FALSE);
+    shard->thread = g_thread_try_new ("qmi-proxy-shard", (GThreadFunc)shard_thread_func, shard, error);
+    if (!shard->thread) {
+        if (shard->previous)
+            g_thread_unref (shard->previous);
+        g_main_loop_unref (shard->loop);
+        g_main_context_unref (shard->context);
+        g_free (shard->path);
+        g_slice_free (Shard, shard);
+        return NULL;
+    }
+
+    g_debug ("shard for '%s' started", path);
+    g_hash_table_replace (self->priv->shards, shard->path, shard);
+    return shard;
+}
+
+static gboolean device_info_is_unused (DeviceInfo *info);
+
+static void
+shard_release_client (QmiProxy *self,
+                      Shard    *shard)
+{
+    gboolean last;
+
+    g_mutex_lock (&self->priv->lock);
+    g_assert (shard->n_clients > 0);
+    /* The shard stays around while its device is kept open */
+    last = (--shard->n_clients == 0 && !(shard->device_info && device_info_is_unused (shard->device_info)));
+    /* Once finishing, no new client will get routed to this shard; it stays
+     * in the table until the device is closed */
+    if (last)
+        shard->finishing = TRUE;
+    g_mutex_unlock (&self->priv->lock);
+
+    if (last)
+        shard_quit (shard->loop);
+}
+
+/*****************************************************************************/
+/* Track/untrack clients */
+
+static void
+track_client (QmiProxy *self,
+              Client   *client)
+{
+    g_mutex_lock (&self->priv->lock);
+    g_hash_table_add (self->priv->clients, client_ref (client));
+    g_mutex_unlock (&self->priv->lock);
+    notify_n_clients (self);
+}
+
+static gboolean device_info_remove_client (DeviceInfo *info,
+                                           Client     *client);
+static void     device_info_release       (QmiProxy   *self,
+                                           Shard      *shard,
+                                           DeviceInfo *info);
+static void     handoff_complete          (QmiProxy   *self,
+                                           gboolean    handed_off);
+
+static void
+untrack_client (QmiProxy *self,
+                Client   *client)
+{
+    DeviceInfo *device_info;
+    gboolean    tracked;
+
+    /* If the new proxy goes away while draining, just go on */
+    if (self->priv->handoff && self->priv->handoff->client == client) {
+        g_debug ("new proxy gone: handoff aborted");
+        handoff_complete (self, FALSE);
+    }
+
+    device_info = client->device_info;
+
+    /* Disconnect the client explicitly when untracking */
+    client_disconnect (client);
+
+    /* Nobody will get the responses of the requests still pending, so
+     * don't keep them waiting in the device */
+    g_cancellable_cancel (client->cancellable);
+
+    g_mutex_lock (&self->priv->lock);
+    tracked = g_hash_table_steal (self->priv->clients, client);
+    g_mutex_unlock (&self->priv->lock);
+
+    /* If no more clients using the device, close and cleanup, or keep it
+     * open for a while */
+    if (device_info && device_info_remove_client (device_info, client))
+        device_info_release (self, client->shard, device_info);
+
+    if (!tracked)
+        return;
+
+    /* In sharded mode, the shard finishes once left without clients */
+    if (client->shard)
+        shard_release_client (self, client->shard);
+
+    client_unref (client);
+    notify_n_clients (self);
+}
+
+/*****************************************************************************/
+/* Device info */
+
+#define BUILD_CLIENT_INFO_KEY(service, cid) GUINT_TO_POINTER (((guint)(service) << 8) | (guint)(cid))
+
+static gboolean
+client_monitors_service (Client *client,
+                         guint8  service)
+{
+    return !!(client->monitored_services[service / 32] & (1u << (service % 32)));
+}
+
+static void
+indication_cb (QmiDevice  *device,
+               QmiMessage *message,
+               DeviceInfo *info)
+{
+    guint8  service;
+    guint8  cid;
+    Client *owner = NULL;
+    GError *error = NULL;
+
+    service = (guint8) qmi_message_get_service (message);
+    cid = qmi_message_get_client_id (message);
+
+    /* Broadcast messages are forwarded once to each client with any CID in
+     * the same service */
+    if (cid == QMI_CID_BROADCAST) {
+        GHashTableIter iter;
+        Client *client;
+
+        if (info->clients_by_service[service]) {
+            g_hash_table_iter_init (&iter, info->clients_by_service[service]);
+            while (g_hash_table_iter_next (&iter, (gpointer *)&client, NULL)) {
+                if (!client_wants_indication (client, message))
+                    continue;
+                if (!client_send_message (client, message, &error)) {
+                    g_warning ("couldn't forward indication to client: %s", error->message);
+                    g_clear_error (&error);
+                }
+            }
+        }
+    } else {
+        owner = g_hash_table_lookup (info->clients_by_cid, BUILD_CLIENT_INFO_KEY (service, cid));
+        if (owner &&
+            client_wants_indication (owner, message) &&
+            !client_send_message (owner, message, &error)) {
+            g_warning ("couldn't forward indication to client: %s", error->message);
+            g_clear_error (&error);
+        }
+    }
+
+    /* Monitoring clients get a copy of all the indications of the services
+     * they monitor, unless they already got it above */
+    if (g_hash_table_size (info->monitors) > 0) {
+        GHashTableIter iter;
+        Client *client;
+
+        g_hash_table_iter_init (&iter, info->monitors);
+        while (g_hash_table_iter_next (&iter, (gpointer *)&client, NULL)) {
+            if (!client_monitors_service (client, service))
+                continue;
+            if (cid == QMI_CID_BROADCAST ?
+                (info->clients_by_service[service] && g_hash_table_contains (info->clients_by_service[service], client)) :
+                (client == owner))
+                continue;
+            if (!client_wants_indication (client, message))
+                continue;
+            if (!client_send_message (client, message, &error)) {
+                g_warning ("couldn't forward indication to monitoring client: %s", error->message);
+                g_clear_error (&error);
+            }
+        }
+    }
+}
+
+static void device_info_drop (QmiProxy   *self,
+                              Shard      *shard,
+                              DeviceInfo *info);
+
+static void
+device_removed_cb (QmiDevice  *device,
+                   DeviceInfo *info)
+{
+    GList *clients;
+    GList *l;
+    Shard *shard = NULL;
+
+    /* Never kept open once gone */
+    info->keep_open = FALSE;
+    if (info->linger_source) {
+        g_source_destroy (info->linger_source);
+        g_source_unref (info->linger_source);
+        info->linger_source = NULL;
+    }
+
+    /* Untracking the last client frees the device info */
+    clients = g_hash_table_get_keys (info->clients);
+    if (!clients) {
+        Shard *candidate;
+
+        /* Unused already, find out where it's stored */
+        g_mutex_lock (&info->proxy->priv->lock);
+        candidate = g_hash_table_lookup (info->proxy->priv->shards, qmi_device_get_path (device));
+        if (candidate && candidate->device_info == info)
+            shard = candidate;
+        g_mutex_unlock (&info->proxy->priv->lock);
+
+        device_info_drop (info->proxy, shard, info);
+        return;
+    }
+
+    g_list_foreach (clients, (GFunc)client_ref, NULL);
+    for (l = clients; l; l = g_list_next (l))
+        untrack_client (((Client *) l->data)->proxy, (Client *) l->data);
+    g_list_free_full (clients, (GDestroyNotify)client_unref);
+}
+
+static DeviceInfo *
+device_info_new (QmiProxy  *proxy,
+                 QmiDevice *device)
+{
+    DeviceInfo *info;
+
+    info = g_slice_new0 (DeviceInfo);
+    info->proxy = proxy;
+    info->device = g_object_ref (device);
+    info->clients = g_hash_table_new (g_direct_hash, g_direct_equal);
+    info->clients_by_cid = g_hash_table_new (g_direct_hash, g_direct_equal);
+    info->monitors = g_hash_table_new (g_direct_hash, g_direct_equal);
+    info->ctl_next_trid = 1;
+    g_queue_init (&info->ctl_queue);
+    info->fair_window = proxy->priv->fair_queue_window;
+    if (info->fair_window)
+        info->fair_in_flight = g_hash_table_new (g_direct_hash, g_direct_equal);
+    g_queue_init (&info->fair_clients);
+
+    /* Register for device indications */
+    info->indication_id = g_signal_connect (device,
+                                            "indication",
+                                            G_CALLBACK (indication_cb),
+                                            info);
+    info->device_removed_id = g_signal_connect (device,
+                                                "device-removed",
+                                                G_CALLBACK (device_removed_cb),
+                                                info);
+    return info;
+}
+
+static void
+device_info_free (DeviceInfo *info)
+{
+    guint i;
+
+    if (info->linger_source) {
+        g_source_destroy (info->linger_source);
+        g_source_unref (info->linger_source);
+    }
+
+    g_signal_handler_disconnect (info->device, info->indication_id);
+    g_signal_handler_disconnect (info->device, info->device_removed_id);
+
+    device_info_clear_ctl_requests (info);
+    device_info_clear_fair_requests (info, NULL);
+    if (info->fair_in_flight) {
+        GHashTableIter  iter;
+        Request        *request;
+
+        /* Requests already forwarded still complete on their own */
+        g_hash_table_iter_init (&iter, info->fair_in_flight);
+        while (g_hash_table_iter_next (&iter, (gpointer *)&request, NULL))
+            request->fair_device_info = NULL;
+        g_hash_table_unref (info->fair_in_flight);
+    }
+
+    g_debug ("closing device '%s': no longer used", qmi_device_get_path_display (info->device));
+    qmi_device_close (info->device, NULL);
+    g_object_unref (info->device);
+
+    for (i = 0; i < G_N_ELEMENTS (info->clients_by_service); i++) {
+        if (info->clients_by_service[i])
+            g_hash_table_unref (info->clients_by_service[i]);
+    }
+    g_hash_table_unref (info->monitors);
+    g_hash_table_unref (info->clients_by_cid);
+    g_hash_table_unref (info->clients);
+    g_slice_free (DeviceInfo, info);
+}
+
+static void
+device_info_track_cid (DeviceInfo *info,
+                       Client     *client,
+                       QmiService  service,
+                       guint8      cid)
+{
+    GHashTable *clients;
+    guint       n;
+
+    g_hash_table_insert (info->clients_by_cid, BUILD_CLIENT_INFO_KEY (service, cid), client);
+
+    clients = info->clients_by_service[(guint8) service];
+    if (!clients) {
+        clients = g_hash_table_new (g_direct_hash, g_direct_equal);
+        info->clients_by_service[(guint8) service] = clients;
+    }
+    n = GPOINTER_TO_UINT (g_hash_table_lookup (clients, client));
+    g_hash_table_insert (clients, client, GUINT_TO_POINTER (n + 1));
+}
+
+static void
+device_info_untrack_cid (DeviceInfo *info,
+                         Client     *client,
+                         QmiService  service,
+                         guint8      cid)
+{
+    GHashTable *clients;
+    guint       n;
+
+    if (g_hash_table_lookup (info->clients_by_cid, BUILD_CLIENT_INFO_KEY (service, cid)) == client)
+        g_hash_table_remove (info->clients_by_cid, BUILD_CLIENT_INFO_KEY (service, cid));
+
+    clients = info->clients_by_service[(guint8) service];
+    if (!clients)
+        return;
+    n = GPOINTER_TO_UINT (g_hash_table_lookup (clients, client));
+    if (n > 1)
+        g_hash_table_insert (clients, client, GUINT_TO_POINTER (n - 1));
+    else
+        g_hash_table_remove (clients, client);
+}
+
+static void
+device_info_add_client (DeviceInfo *info,
+                        Client     *client)
+{
+    guint i;
+
+    g_assert (!client->device_info);
+    client->device_info = info;
+    g_hash_table_add (info->clients, client);
+    if (client->monitoring)
+        g_hash_table_add (info->monitors, client);
+
+    if (info->linger_source) {
+        g_debug ("reusing device '%s' kept open", qmi_device_get_path_display (info->device));
+        g_source_destroy (info->linger_source);
+        g_source_unref (info->linger_source);
+        info->linger_source = NULL;
+    }
+
+    for (i = 0; i < client->qmi_client_info_array->len; i++) {
+        QmiClientInfo *cinfo;
+
+        cinfo = &g_array_index (client->qmi_client_info_array, QmiClientInfo, i);
+        device_info_track_cid (info, client, cinfo->service, cinfo->cid);
+    }
+}
+
+/* Returns TRUE if the device is no longer used by any client */
+static gboolean
+device_info_remove_client (DeviceInfo *info,
+                           Client     *client)
+{
+    guint i;
+
+    g_assert (client->device_info == info);
+
+    for (i = 0; i < client->qmi_client_info_array->len; i++) {
+        QmiClientInfo *cinfo;
+
+        cinfo = &g_array_index (client->qmi_client_info_array, QmiClientInfo, i);
+        device_info_untrack_cid (info, client, cinfo->service, cinfo->cid);
+    }
+
+    /* Requests still waiting won't ever be sent */
+    device_info_clear_fair_requests (info, client);
+
+    g_hash_table_remove (info->monitors, client);
+    g_hash_table_remove (info->clients, client);
+    client->device_info = NULL;
+
+    return (g_hash_table_size (info->clients) == 0);
+}
+
+/* Whether the device is kept open without clients; in sharded mode, must be
+ * called with the proxy lock held */
+static gboolean
+device_info_is_unused (DeviceInfo *info)
+{
+    return (info->linger_source || info->keep_open);
+}
+
+/* Closes the device, which must be unused */
+static void
+device_info_drop (QmiProxy   *self,
+                  Shard      *shard,
+                  DeviceInfo *info)
+{
+    gboolean quit = FALSE;
+
+    if (!shard) {
+        /* Frees the device info */
+        g_hash_table_remove (self->priv->devices, qmi_device_get_path (info->device));
+        return;
+    }
+
+    /* Shards without clients finish along with their device, unless a new
+     * client was just routed to them */
+    g_mutex_lock (&self->priv->lock);
+    shard->device_info = NULL;
+    info->keep_open = FALSE;
+    if (shard->n_clients == 0) {
+        shard->finishing = TRUE;
+        quit = TRUE;
+    }
+    g_mutex_unlock (&self->priv->lock);
+
+    device_info_free (info);
+    if (quit)
+        shard_quit (shard->loop);
+}
+
+typedef struct {
+    QmiProxy   *self;
+    Shard      *shard;
+    DeviceInfo *info;
+} LingerContext;
+
+static gboolean
+device_linger_timeout_cb (LingerContext *ctx)
+{
+    g_debug ("closing device '%s': no clients for a while", qmi_device_get_path_display (ctx->info->device));
+
+    g_source_unref (ctx->info->linger_source);
+    ctx->info->linger_source = NULL;
+    device_info_drop (ctx->self, ctx->shard, ctx->info);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+linger_context_free (LingerContext *ctx)
+{
+    g_slice_free (LingerContext, ctx);
+}
+
+/* Called once the device is left without clients */
+static void
+device_info_release (QmiProxy   *self,
+                     Shard      *shard,
+                     DeviceInfo *info)
+{
+    const gchar *path;
+    guint        linger;
+    gboolean     keep_open = FALSE;
+    guint        i;
+
+    path = qmi_device_get_path (info->device);
+
+    g_mutex_lock (&self->priv->lock);
+    linger = self->priv->device_linger;
+    for (i = 0; self->priv->keep_open && self->priv->keep_open[i] && !keep_open; i++)
+        keep_open = g_str_equal (self->priv->keep_open[i], path);
+    g_mutex_unlock (&self->priv->lock);
+
+    if (keep_open) {
+        g_debug ("keeping device '%s' open", qmi_device_get_path_display (info->device));
+        g_mutex_lock (&self->priv->lock);
+        info->keep_open = TRUE;
+        g_mutex_unlock (&self->priv->lock);
+        return;
+    }
+
+    if (linger) {
+        LingerContext *ctx;
+        GSource       *source;
+
+        g_debug ("keeping device '%s' open for %u seconds", qmi_device_get_path_display (info->device), linger);
+
+        ctx = g_slice_new (LingerContext);
+        ctx->self = self;
+        ctx->shard = shard;
+        ctx->info = info;
+
+        source = g_timeout_source_new_seconds (linger);
+        g_source_set_callback (source,
+                               (GSourceFunc) device_linger_timeout_cb,
+                               ctx,
+                               (GDestroyNotify) linger_context_free);
+        g_source_attach (source, shard ? shard->context : self->priv->main_context);
+        g_mutex_lock (&self->priv->lock);
+        info->linger_source = source;
+        g_mutex_unlock (&self->priv->lock);
+        return;
+    }
+
+    device_info_drop (self, shard, info);
+}
+
+static DeviceInfo *
+find_device_info (QmiProxy    *self,
+                  Client      *client,
+                  const gchar *path)
+{
+    /* In sharded mode, the shard serves one single device */
+    if (client->shard)
+        return client->shard->device_info;
+
+    return g_hash_table_lookup (self->priv->devices, path);
+}
+
+static void
+client_set_stats_device (Client *client)
+{
+    g_mutex_lock (&client->stats_lock);
+    g_free (client->stats.device_path);
+    client->stats.device_path = g_strdup (qmi_device_get_path (client->device));
+    if (client->stats_device)
+        g_object_unref (client->stats_device);
+    client->stats_device = g_object_ref (client->device);
+    g_mutex_unlock (&client->stats_lock);
+}
+
+static void
+complete_internal_proxy_open (QmiProxy *self,
+                              Client   *client)
+{
+    QmiMessage *response;
+    GError *error = NULL;
+
+    g_debug ("connection to QMI device '%s' established", qmi_device_get_path (client->device));
+
+    client_set_stats_device (client);
+
+    g_assert (client->internal_proxy_open_request != NULL);
+    response = qmi_message_response_new (client->internal_proxy_open_request, QMI_PROTOCOL_ERROR_NONE);
+    qmi_message_unref (client->internal_proxy_open_request);
+    client->internal_proxy_open_request = NULL;
+
+    /* Let the client know it may abort its requests, filter and monitor
+     * indications, and query the transactions and statistics */
+    {
+        gsize tlv_offset;
+
+        tlv_offset = qmi_message_tlv_write_init (response, QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN_OUTPUT_TLV_ABORT_SUPPORTED, NULL);
+        g_assert (tlv_offset > 0);
+        qmi_message_tlv_write_guint8 (response, 1, NULL);
+        qmi_message_tlv_write_complete (response, tlv_offset, NULL);
+
+        tlv_offset = qmi_message_tlv_write_init (response, QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN_OUTPUT_TLV_INDICATION_FILTER_SUPPORTED, NULL);
+        g_assert (tlv_offset > 0);
+        qmi_message_tlv_write_guint8 (response, 1, NULL);
+        qmi_message_tlv_write_complete (response, tlv_offset, NULL);
+
+        tlv_offset = qmi_message_tlv_write_init (response, QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN_OUTPUT_TLV_TRANSACTIONS_SUPPORTED, NULL);
+        g_assert (tlv_offset > 0);
+        qmi_message_tlv_write_guint8 (response, 1, NULL);
+        qmi_message_tlv_write_complete (response, tlv_offset, NULL);
+
+        tlv_offset = qmi_message_tlv_write_init (response, QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN_OUTPUT_TLV_STATS_SUPPORTED, NULL);
+        g_assert (tlv_offset > 0);
+        qmi_message_tlv_write_guint8 (response, 1, NULL);
+        qmi_message_tlv_write_complete (response, tlv_offset, NULL);
+
+        tlv_offset = qmi_message_tlv_write_init (response, QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN_OUTPUT_TLV_MONITOR_SUPPORTED, NULL);
+        g_assert (tlv_offset > 0);
+        qmi_message_tlv_write_guint8 (response, 1, NULL);
+        qmi_message_tlv_write_complete (response, tlv_offset, NULL);
+    }
+
+    if (!client_send_message (client, response, &error)) {
+        g_warning ("couldn't send proxy open response to client: %s", error->message);
+        g_error_free (error);
+        untrack_client (self, client);
+    }
+
+    qmi_message_unref (response);
+}
+
+/* A single open of a device is run at a time, no matter how many clients
+ * ask for it while in progress: they all wait for the same one */
+struct _PendingOpen {
+    QmiProxy  *proxy;
+    Shard     *shard;
+    gchar     *path;
+    QmiDevice *device;
+    GList     *clients; /* full refs */
+};
+
+static PendingOpen *
+find_pending_open (QmiProxy    *self,
+                   Client      *client,
+                   const gchar *path)
+{
+    if (client->shard)
+        return client->shard->pending_open;
+
+    return g_hash_table_lookup (self->priv->pending_opens, path);
+}
+
+static void
+pending_open_complete (PendingOpen *pending,
+                       GError      *error)
+{
+    QmiProxy   *self = pending->proxy;
+    DeviceInfo *info = NULL;
+    guint       n_clients = 0;
+    GList      *l;
+
+    if (pending->shard)
+        pending->shard->pending_open = NULL;
+    else
+        g_hash_table_remove (self->priv->pending_opens, pending->path);
+
+    if (error)
+        g_debug ("couldn't open QMI device: %s", error->message);
+    else {
+        /* Store device in the proxy (or in the shard) independently */
+        info = device_info_new (self, pending->device);
+        if (pending->shard)
+            pending->shard->device_info = info;
+        else
+            g_hash_table_insert (self->priv->devices, g_strdup (pending->path), info);
+    }
+
+    for (l = pending->clients; l; l = g_list_next (l)) {
+        Client *client = l->data;
+
+        /* Skip the clients that went away while waiting */
+        if (!client->connection)
+            continue;
+
+        if (!info) {
+            untrack_client (self, client);
+            continue;
+        }
+
+        /* Keep a reference to the device in the client */
+        client->device = g_object_ref (info->device);
+        device_info_add_client (info, client);
+        complete_internal_proxy_open (self, client);
+        n_clients++;
+    }
+
+    /* If all the clients went away, same as if the last one had */
+    if (info && !n_clients)
+        device_info_release (self, pending->shard, info);
+
+    g_list_free_full (pending->clients, (GDestroyNotify)client_unref);
+    if (pending->device)
+        g_object_unref (pending->device);
+    g_free (pending->path);
+    g_slice_free (PendingOpen, pending);
+}
+
+static void
+device_open_ready (QmiDevice    *device,
+                   GAsyncResult *res,
+                   PendingOpen  *pending)
+{
+    GError *error = NULL;
+
+    if (!qmi_device_open_finish (device, res, &error)) {
+        pending_open_complete (pending, error);
+        g_error_free (error);
+        return;
+    }
+
+    pending_open_complete (pending, NULL);
+}
+
+static void
+device_trace (QmiDevice            *device,
+              const QmiTraceRecord *record,
+              QmiTraceRing         *ring)
+{
+    qmi_trace_ring_add (ring, record);
+}
+
+static void
+device_apply_settings (QmiProxy  *self,
+                       QmiDevice *device)
+{
+    if (self->priv->coalesce_requests)
+        g_object_set (device, QMI_DEVICE_COALESCE_REQUESTS, TRUE, NULL);
+    if (self->priv->response_cache)
+        g_object_set (device, QMI_DEVICE_RESPONSE_CACHE, TRUE, NULL);
+    if (self->priv->indication_cache)
+        g_object_set (device, QMI_DEVICE_INDICATION_CACHE, TRUE, NULL);
+    if (self->priv->io_uring)
+        g_object_set (device, QMI_DEVICE_IO_URING, TRUE, NULL);
+    if (self->priv->trace_ring)
+        qmi_device_set_trace_func (device,
+                                   (QmiDeviceTraceFn) device_trace,
+                                   qmi_trace_ring_ref (self->priv->trace_ring),
+                                   (GDestroyNotify) qmi_trace_ring_unref);
+}
+
+static void
+device_new_ready (GObject      *source,
+                  GAsyncResult *res,
+                  PendingOpen  *pending)
+{
+    QmiProxy *self = pending->proxy;
+    GError *error = NULL;
+
+    pending->device = qmi_device_new_finish (res, &error);
+    if (!pending->device) {
+        pending_open_complete (pending, error);
+        g_error_free (error);
+        return;
+    }
+
+    device_apply_settings (self, pending->device);
+    qmi_device_open (pending->device,
+                     QMI_DEVICE_OPEN_FLAGS_NONE,
+                     10,
+                     NULL,
+                     (GAsyncReadyCallback)device_open_ready,
+                     pending);
+}
+
+static gboolean
+open_device_for_client (QmiProxy    *self,
+                        Client      *client,
+                        const gchar *device_file_path)
+{
+    DeviceInfo  *info;
+    PendingOpen *pending;
+    GFile       *file;
+
+    info = find_device_info (self, client, device_file_path);
+    if (info) {
+        /* Keep a reference to the device in the client */
+        client->device = g_object_ref (info->device);
+        device_info_add_client (info, client);
+
+        complete_internal_proxy_open (self, client);
+        return FALSE;
+    }
+
+    /* Wait for the open already in progress, if any */
+    pending = find_pending_open (self, client, device_file_path);
+    if (pending) {
+        g_debug ("waiting for QMI device '%s' being open", device_file_path);
+        pending->clients = g_list_append (pending->clients, client_ref (client));
+        return TRUE;
+    }
+
+    /* Need to create a device ourselves */
+    pending = g_slice_new0 (PendingOpen);
+    pending->proxy = self;
+    pending->shard = client->shard;
+    pending->path = g_strdup (device_file_path);
+    pending->clients = g_list_append (NULL, client_ref (client));
+    if (pending->shard)
+        pending->shard->pending_open = pending;
+    else
+        g_hash_table_insert (self->priv->pending_opens, pending->path, pending);
+
+    /* Not only paths, also e.g. qrtr:// URIs */
+    file = g_file_new_for_commandline_arg (device_file_path);
+    qmi_device_new (file,
+                    NULL,
+                    (GAsyncReadyCallback)device_new_ready,
+                    pending);
+    g_object_unref (file);
+    return TRUE;
+}
+
+static void parse_request (QmiProxy *self,
+                           Client   *client);
+
+static gboolean
+shard_handoff_idle (Client *client)
+{
+    QmiProxy *self = client->proxy;
+
+    /* From now on, the client is fully handled in the shard thread */
+    client->shard_handoff = FALSE;
+    client_setup_readable_source (client, client->shard->context);
+    if (!g_queue_is_empty (client->output_queue))
+        client_output_flush (client);
+
+    open_device_for_client (self, client, client->shard->path);
+
+    /* Process any other request already received */
+    if (client->buffer && client->buffer->len > 0)
+        parse_request (self, client);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+route_client_to_shard (QmiProxy    *self,
+                       Client      *client,
+                       const gchar *device_file_path)
+{
+    Shard  *shard;
+    GError *error = NULL;
+
+    g_mutex_lock (&self->priv->lock);
+    shard = shard_get_for_path (self, device_file_path, &error);
+    if (shard)
+        shard->n_clients++;
+    g_mutex_unlock (&self->priv->lock);
+
+    if (!shard) {
+        g_warning ("couldn't create shard for QMI device file '%s': %s", device_file_path, error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    /* The client is passed to the shard once we're done reading from it in
+     * the main context */
+    client->shard = shard;
+    client->shard_handoff = TRUE;
+    return TRUE;
+}
+
+static gboolean
+process_internal_proxy_open (QmiProxy   *self,
                              Client     *client,
                              QmiMessage *message)
 {
-    const guint8 *buffer;
-    guint16 buffer_len;
-    gchar *device_file_path;
+    const guint8 *buffer;
+    guint16 buffer_len;
+    gchar *device_file_path;
+    gboolean processed;
+
+    buffer = qmi_message_get_raw_tlv (message,
+                                      QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN_INPUT_TLV_DEVICE_PATH,
+                                      &buffer_len);
+    if (!buffer) {
+        g_debug ("ignoring message from client: invalid proxy open request");
+        return FALSE;
+    }
+
+    if (client->shard) {
+        g_debug ("ignoring message from client: proxy already open");
+        return FALSE;
+    }
+
+    qmi_utils_read_string_from_buffer (&buffer, &buffer_len, 0, 0, &device_file_path);
+    g_debug ("valid request to open connection to QMI device file: %s", device_file_path);
+
+    /* Keep it */
+    client->internal_proxy_open_request = qmi_message_ref (message);
+
+    if (self->priv->sharded)
+        processed = route_client_to_shard (self, client, device_file_path);
+    else
+        processed = open_device_for_client (self, client, device_file_path);
+
+    g_free (device_file_path);
+    return processed;
+}
+
+/* Returns TRUE if a new QMI client was tracked, given in @out_info */
+static gboolean
+track_cid (Client *client,
+           gboolean track,
+           QmiMessage *message,
+           QmiClientInfo *out_info)
+{
+    const guint8 *buffer;
+    guint16 buffer_len;
+    guint16 error_status;
+    guint16 error_code;
+    guint8 tmp;
+    QmiClientInfo info;
+    guint i;
+    gboolean exists;
+
+    buffer = qmi_message_get_raw_tlv (message, QMI_MESSAGE_OUTPUT_TLV_RESULT, &buffer_len);
+    if (!buffer || buffer_len != 4) {
+        g_warning ("invalid 'CTL allocate CID' response: missing or invalid result TLV");
+        return FALSE;
+    }
+
+    qmi_utils_read_guint16_from_buffer (&buffer, &buffer_len, QMI_ENDIAN_LITTLE, &error_status);
+    if (error_status != 0x00)
+        return FALSE;
+
+    qmi_utils_read_guint16_from_buffer (&buffer, &buffer_len, QMI_ENDIAN_LITTLE, &error_code);
+    if (error_code != QMI_PROTOCOL_ERROR_NONE)
+        return FALSE;
+
+    buffer = qmi_message_get_raw_tlv (message, QMI_MESSAGE_OUTPUT_TLV_ALLOCATION_INFO, &buffer_len);
+    if (!buffer || buffer_len != 2) {
+        g_warning ("invalid 'CTL allocate CID' response: missing or invalid allocation info TLV");
+        return FALSE;
+    }
+
+    qmi_utils_read_guint8_from_buffer (&buffer, &buffer_len, &tmp);
+    info.service = (QmiService)tmp;
+    qmi_utils_read_guint8_from_buffer (&buffer, &buffer_len, &(info.cid));
+
+
+    /* Check if it already exists */
+    for (i = 0; i < client->qmi_client_info_array->len; i++) {
+        QmiClientInfo *existing;
+
+        existing = &g_array_index (client->qmi_client_info_array, QmiClientInfo, i);
+        if (existing->service == info.service && existing->cid == info.cid)
+            break;
+    }
+    exists = (i < client->qmi_client_info_array->len);
+
+    if (track && !exists) {
+        g_debug ("QMI client tracked [%s,%s,%u]",
+                 qmi_device_get_path_display (client->device),
+                 qmi_service_get_string (info.service),
+                 info.cid);
+        g_array_append_val (client->qmi_client_info_array, info);
+        if (client->device_info)
+            device_info_track_cid (client->device_info, client, info.service, info.cid);
+        if (out_info)
+            *out_info = info;
+        return TRUE;
+    }
+
+    if (!track && exists) {
+        g_debug ("QMI client untracked [%s,%s,%u]",
+                 qmi_device_get_path_display (client->device),
+                 qmi_service_get_string (info.service),
+                 info.cid);
+        g_array_remove_index (client->qmi_client_info_array, i);
+        if (client->device_info)
+            device_info_untrack_cid (client->device_info, client, info.service, info.cid);
+    }
+
+    return FALSE;
+}
+
+/* The current state kept by the device is given to the new QMI client right
+ * after the response allocating it, as the device itself does for its own
+ * clients */
+static void
+client_replay_cached_indications (Client              *client,
+                                  const QmiClientInfo *info)
+{
+    GPtrArray *cached;
+    guint      i;
+    GError    *error = NULL;
+
+    cached = qmi_device_get_cached_indications (client->device, info->service);
+    for (i = 0; i < cached->len; i++) {
+        QmiMessage *message;
+        QmiMessage *replayed;
+
+        message = g_ptr_array_index (cached, i);
+        if (!client_wants_indication (client, message))
+            continue;
+
+        replayed = __qmi_message_copy_for_transaction (message,
+                                                       info->cid,
+                                                       qmi_message_get_transaction_id (message));
+        if (!client_send_message (client, replayed, &error)) {
+            g_warning ("couldn't replay cached indication to client: %s", error->message);
+            g_clear_error (&error);
+        }
+        qmi_message_unref (replayed);
+    }
+    g_ptr_array_unref (cached);
+}
+
+struct _Request {
+    QmiProxy     *self;   /* Full ref */
+    Client       *client; /* Full ref */
+    guint8        in_trid;
+    guint32       key;    /* 0 if not tracked in the client */
+    /* CTL requests: the device using the transaction id given to the
+     * request, if any, and the message while waiting for one */
+    DeviceInfo   *device_info;
+    guint8        out_trid;
+    QmiMessage   *message;
+    /* Service requests, when fair queuing: the device whose window the
+     * request takes once forwarded, or whether it's still waiting */
+    DeviceInfo   *fair_device_info;
+    gboolean      fair_queued;
+    GCancellable *cancellable;
+    gulong        client_cancelled_id;
+    gint64        start_time;
+};
+
+#define BUILD_REQUEST_KEY(service, cid, trid) (((guint32)(service) << 24) | ((guint32)(cid) << 16) | (guint32)(trid))
+
+static void device_info_release_ctl_trid (Request *request);
+static void device_info_release_fair_slot (Request *request);
+
+static void
+request_client_cancelled (GCancellable *client_cancellable,
+                          Request      *request)
+{
+    g_cancellable_cancel (request->cancellable);
+}
+
+static void
+request_free (Request *request)
+{
+    if (!request)
+        return;
+    /* Never called from within the cancellation handler, as the device
+     * always completes the commands from an idle */
+    g_cancellable_disconnect (request->client->cancellable, request->client_cancelled_id);
+    device_info_release_ctl_trid (request);
+    device_info_release_fair_slot (request);
+    if (request->message)
+        qmi_message_unref (request->message);
+    if (request->key && g_hash_table_lookup (request->client->requests, GUINT_TO_POINTER (request->key)) == request)
+        g_hash_table_remove (request->client->requests, GUINT_TO_POINTER (request->key));
+    g_mutex_lock (&request->client->stats_lock);
+    request->client->stats.n_pending_requests--;
+    g_mutex_unlock (&request->client->stats_lock);
+
+    g_object_unref (request->cancellable);
+    client_unref (request->client);
+    g_object_unref (request->self);
+    g_slice_free (Request, request);
+    __qmi_utils_live_object_add (QMI_UTILS_LIVE_OBJECT_PROXY_REQUEST, -1);
+}
+
+static gboolean
+process_internal_proxy_abort (QmiProxy   *self,
+                              Client     *client,
+                              QmiMessage *message)
+{
+    const guint8 *buffer;
+    guint16 buffer_len;
+    guint16 trid;
+    Request *request;
+    QmiMessage *response;
+    GError *error = NULL;
+
+    buffer = qmi_message_get_raw_tlv (message,
+                                      QMI_MESSAGE_CTL_INTERNAL_PROXY_ABORT_INPUT_TLV_TRANSACTION,
+                                      &buffer_len);
+    if (!buffer || buffer_len != 4) {
+        g_debug ("ignoring message from client: invalid proxy abort request");
+        return FALSE;
+    }
+
+    memcpy (&trid, &buffer[2], sizeof (trid));
+    trid = GUINT16_FROM_LE (trid);
+
+    /* The request may have already been completed */
+    request = g_hash_table_lookup (client->requests, GUINT_TO_POINTER (BUILD_REQUEST_KEY (buffer[0], buffer[1], trid)));
+    if (request) {
+        g_debug ("aborting request [%s,%u,%u] from client",
+                 qmi_service_get_string ((QmiService) buffer[0]), buffer[1], trid);
+        g_cancellable_cancel (request->cancellable);
+    }
+
+    response = qmi_message_response_new (message, QMI_PROTOCOL_ERROR_NONE);
+    if (!client_send_message (client, response, &error)) {
+        g_warning ("couldn't send proxy abort response to client: %s", error->message);
+        g_error_free (error);
+        untrack_client (self, client);
+    }
+    qmi_message_unref (response);
+
+    return TRUE;
+}
+
+static gboolean
+clear_indication_filter_service (gpointer key,
+                                 gpointer value,
+                                 gpointer service)
+{
+    return ((GPOINTER_TO_UINT (key) >> 16) == GPOINTER_TO_UINT (service));
+}
+
+static gboolean
+process_internal_proxy_set_indication_filter (QmiProxy   *self,
+                                              Client     *client,
+                                              QmiMessage *message)
+{
+    const guint8 *buffer;
+    guint16 buffer_len;
+    const guint8 *ids = NULL;
+    guint16 ids_len = 0;
+    guint n_ids = 0;
+    guint8 service;
+    QmiProtocolError status = QMI_PROTOCOL_ERROR_NONE;
+    QmiMessage *response;
+    GError *error = NULL;
+
+    /* Validate the whole request before touching the current filter */
+    buffer = qmi_message_get_raw_tlv (message,
+                                      QMI_MESSAGE_CTL_INTERNAL_PROXY_SET_INDICATION_FILTER_INPUT_TLV_SERVICE,
+                                      &buffer_len);
+    ids = qmi_message_get_raw_tlv (message,
+                                   QMI_MESSAGE_CTL_INTERNAL_PROXY_SET_INDICATION_FILTER_INPUT_TLV_INDICATIONS,
+                                   &ids_len);
+    if (!buffer || buffer_len != 1)
+        status = QMI_PROTOCOL_ERROR_MISSING_ARGUMENT;
+    else if (ids && (ids_len < 1 || ids_len != 1 + (2 * ids[0])))
+        status = QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE;
+
+    if (status != QMI_PROTOCOL_ERROR_NONE) {
+        g_debug ("invalid proxy indication filter request from client: %s",
+                 qmi_protocol_error_get_string (status));
+        goto out;
+    }
+
+    service = buffer[0];
+
+    /* Replace whatever filter was set for the service */
+    if (client->indication_filter)
+        g_hash_table_foreach_remove (client->indication_filter,
+                                     clear_indication_filter_service,
+                                     GUINT_TO_POINTER (service));
+    client->indication_filtered_services[service / 32] &= ~(1u << (service % 32));
+
+    /* Without the list of indications, all are forwarded again */
+    if (ids) {
+        guint i;
+
+        n_ids = ids[0];
+        if (!client->indication_filter)
+            client->indication_filter = g_hash_table_new (g_direct_hash, g_direct_equal);
+        for (i = 0; i < n_ids; i++) {
+            guint16 message_id;
+
+            memcpy (&message_id, &ids[1 + (2 * i)], sizeof (message_id));
+            g_hash_table_add (client->indication_filter,
+                              BUILD_INDICATION_FILTER_KEY (service, GUINT16_FROM_LE (message_id)));
+        }
+        client->indication_filtered_services[service / 32] |= (1u << (service % 32));
+
+        g_debug ("client indication filter set [%s]: %u indications",
+                 qmi_service_get_string ((QmiService) service), n_ids);
+    } else
+        g_debug ("client indication filter removed [%s]",
+                 qmi_service_get_string ((QmiService) service));
+
+out:
+    response = qmi_message_response_new (message, status);
+    if (!client_send_message (client, response, &error)) {
+        g_warning ("couldn't send proxy indication filter response to client: %s", error->message);
+        g_error_free (error);
+        untrack_client (self, client);
+    }
+    qmi_message_unref (response);
+
+    return TRUE;
+}
+
+static gboolean
+process_internal_proxy_monitor (QmiProxy   *self,
+                                Client     *client,
+                                QmiMessage *message)
+{
+    const guint8 *buffer;
+    guint16 buffer_len;
+    QmiMessage *response;
+    GError *error = NULL;
+    guint i;
+
+    buffer = qmi_message_get_raw_tlv (message,
+                                      QMI_MESSAGE_CTL_INTERNAL_PROXY_MONITOR_INPUT_TLV_SERVICES,
+                                      &buffer_len);
+    if (!buffer || buffer_len < 1 || buffer_len != 1 + buffer[0]) {
+        g_debug ("ignoring message from client: invalid proxy monitor request");
+        return FALSE;
+    }
+
+    /* Replace whatever services were monitored; an empty list stops
+     * monitoring */
+    memset (client->monitored_services, 0, sizeof (client->monitored_services));
+    for (i = 0; i < buffer[0]; i++)
+        client->monitored_services[buffer[1 + i] / 32] |= (1u << (buffer[1 + i] % 32));
+    client->monitoring = (buffer[0] > 0);
+
+    if (client->device_info) {
+        if (client->monitoring)
+            g_hash_table_add (client->device_info->monitors, client);
+        else
+            g_hash_table_remove (client->device_info->monitors, client);
+    }
+
+    g_debug ("client monitoring %u services", (guint) buffer[0]);
+
+    response = qmi_message_response_new (message, QMI_PROTOCOL_ERROR_NONE);
+    if (!client_send_message (client, response, &error)) {
+        g_warning ("couldn't send proxy monitor response to client: %s", error->message);
+        g_error_free (error);
+        untrack_client (self, client);
+    }
+    qmi_message_unref (response);
+
+    return TRUE;
+}
+
+/* Each transaction takes 27 bytes, and the whole response must fit in the
+ * 16bit length of the QMUX header, along with the headers and the result
+ * TLV */
+#define PROXY_TRANSACTIONS_MAX ((G_MAXUINT16 - 32) / 27)
+
+typedef struct {
+    Client     *client;
+    QmiMessage *message;
+} GetTransactionsContext;
+
+static Client *
+device_info_lookup_transaction_owner (DeviceInfo                     *info,
+                                      const QmiDeviceTransactionInfo *transaction)
+{
+    /* CTL requests are forwarded with a transaction id of their own, the
+     * others with the CID allocated to the client */
+    if (transaction->service == QMI_SERVICE_CTL) {
+        Request *request;
+
+        request = info->ctl_requests[(guint8) transaction->transaction_id];
+        return (request ? request->client : NULL);
+    }
+
+    return g_hash_table_lookup (info->clients_by_cid,
+                                BUILD_CLIENT_INFO_KEY (transaction->service, transaction->client_id));
+}
+
+static void
+device_get_transactions_ready (QmiDevice              *device,
+                               GAsyncResult           *res,
+                               GetTransactionsContext *ctx)
+{
+    Client *client;
+    GArray *transactions;
+    QmiMessage *response;
+    GError *error = NULL;
+
+    client = ctx->client;
+    transactions = qmi_device_get_transactions_finish (device, res, &error);
+    if (!transactions) {
+        g_debug ("couldn't get transactions: %s", error->message);
+        response = qmi_message_response_new (ctx->message, QMI_PROTOCOL_ERROR_INTERNAL);
+        g_error_free (error);
+    } else {
+        guint n_transactions;
+        gsize tlv_offset;
+        guint i;
+
+        n_transactions = MIN (transactions->len, PROXY_TRANSACTIONS_MAX);
+        response = qmi_message_response_new (ctx->message, QMI_PROTOCOL_ERROR_NONE);
+        if (n_transactions > 0) {
+            tlv_offset = qmi_message_tlv_write_init (response, QMI_MESSAGE_CTL_INTERNAL_PROXY_GET_TRANSACTIONS_OUTPUT_TLV_TRANSACTIONS, NULL);
+            g_assert (tlv_offset > 0);
+            qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, n_transactions, NULL);
+            for (i = 0; i < n_transactions; i++) {
+                QmiDeviceTransactionInfo *transaction;
+                Client                   *owner = NULL;
+
+                transaction = &g_array_index (transactions, QmiDeviceTransactionInfo, i);
+                if (client->device_info)
+                    owner = device_info_lookup_transaction_owner (client->device_info, transaction);
+
+                qmi_message_tlv_write_guint8  (response, (guint8) transaction->service, NULL);
+                qmi_message_tlv_write_guint8  (response, transaction->client_id, NULL);
+                qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, transaction->transaction_id, NULL);
+                qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, transaction->message_id, NULL);
+                qmi_message_tlv_write_guint8  (response, transaction->in_flight ? 1 : 0, NULL);
+                qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, transaction->age, NULL);
+                qmi_message_tlv_write_gint64  (response, QMI_ENDIAN_LITTLE, transaction->timeout_remaining, NULL);
+                qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, owner ? owner->pid : 0, NULL);
+            }
+            qmi_message_tlv_write_complete (response, tlv_offset, NULL);
+        }
+        if (n_transactions < transactions->len)
+            g_debug ("reporting only %u out of %u transactions", n_transactions, transactions->len);
+        g_array_unref (transactions);
+    }
+
+    if (!client_send_message (client, response, &error)) {
+        g_warning ("couldn't send proxy transactions response to client: %s", error->message);
+        g_error_free (error);
+        untrack_client (client->proxy, client);
+    }
+    qmi_message_unref (response);
+
+    qmi_message_unref (ctx->message);
+    client_unref (ctx->client);
+    g_slice_free (GetTransactionsContext, ctx);
+}
+
+static gboolean
+process_internal_proxy_get_transactions (QmiProxy   *self,
+                                         Client     *client,
+                                         QmiMessage *message)
+{
+    GetTransactionsContext *ctx;
+
+    if (!client->device) {
+        g_debug ("ignoring message from client: proxy transactions request without device");
+        return FALSE;
+    }
+
+    ctx = g_slice_new (GetTransactionsContext);
+    ctx->client = client_ref (client);
+    ctx->message = qmi_message_ref (message);
+
+    /* The device of the proxy is never opened through a proxy itself, so this
+     * is just a snapshot of its own transactions table */
+    qmi_device_get_transactions (client->device,
+                                 5,
+                                 NULL,
+                                 (GAsyncReadyCallback)device_get_transactions_ready,
+                                 ctx);
+    return TRUE;
+}
+
+/* Room for the stats TLVs in the response, which must fit in the 16bit
+ * length of the QMUX header along with the headers and the result TLV */
+#define PROXY_STATS_MAX_SIZE (G_MAXUINT16 - 32)
+
+/* Fixed size of each element in the stats TLVs, besides the path */
+#define PROXY_STATS_DEVICE_SIZE 105
+#define PROXY_STATS_CLIENT_SIZE 93
+
+/* Device paths longer than the size prefix allows are truncated */
+static gsize
+stats_path_length (const gchar *path)
+{
+    return (path ? MIN (strlen (path), G_MAXUINT8) : 0);
+}
+
+static void
+stats_write_path (QmiMessage  *response,
+                  const gchar *path)
+{
+    qmi_message_tlv_write_string (response, 1, path ? path : "", stats_path_length (path), NULL);
+}
+
+static void
+write_device_stats (QmiMessage *response,
+                    GArray     *devices,
+                    gsize      *budget)
+{
+    gsize tlv_offset;
+    gsize size = 5;
+    guint n = 0;
+    guint i;
+
+    /* As many as fit in what's left of the message, TLV header included */
+    while (n < devices->len) {
+        gsize element_size;
+
+        element_size = PROXY_STATS_DEVICE_SIZE + stats_path_length (g_array_index (devices, QmiProxyDeviceStats, n).device_path);
+        if (size + element_size > *budget)
+            break;
+        size += element_size;
+        n++;
+    }
+    if (!n)
+        return;
+    *budget -= size;
+
+    tlv_offset = qmi_message_tlv_write_init (response, QMI_MESSAGE_CTL_INTERNAL_PROXY_GET_STATS_OUTPUT_TLV_DEVICES, NULL);
+    g_assert (tlv_offset > 0);
+    qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, n, NULL);
+    for (i = 0; i < n; i++) {
+        QmiProxyDeviceStats *stats;
+
+        stats = &g_array_index (devices, QmiProxyDeviceStats, i);
+        stats_write_path (response, stats->device_path);
+        qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, stats->n_clients, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->n_requests, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->n_responses, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->n_timeouts, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->n_aborts, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->n_indications, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->n_coalesced, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->n_cached, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->bytes_sent, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->bytes_received, NULL);
+        qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, stats->n_in_flight, NULL);
+        qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, stats->output_queue_length, NULL);
+        qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, stats->throttled_queue_length, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->latency_mean, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->latency_p99, NULL);
+    }
+    qmi_message_tlv_write_complete (response, tlv_offset, NULL);
+}
+
+static void
+write_client_stats (QmiMessage *response,
+                    GArray     *clients,
+                    gsize      *budget)
+{
+    gsize tlv_offset;
+    gsize size = 5;
+    guint n = 0;
+    guint i;
+
+    /* As many as fit in what's left of the message, TLV header included */
+    while (n < clients->len) {
+        gsize element_size;
+
+        element_size = PROXY_STATS_CLIENT_SIZE + stats_path_length (g_array_index (clients, QmiProxyClientStats, n).device_path);
+        if (size + element_size > *budget)
+            break;
+        size += element_size;
+        n++;
+    }
+    if (!n)
+        return;
+    *budget -= size;
+
+    tlv_offset = qmi_message_tlv_write_init (response, QMI_MESSAGE_CTL_INTERNAL_PROXY_GET_STATS_OUTPUT_TLV_CLIENTS, NULL);
+    g_assert (tlv_offset > 0);
+    qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, n, NULL);
+    for (i = 0; i < n; i++) {
+        QmiProxyClientStats *stats;
+
+        stats = &g_array_index (clients, QmiProxyClientStats, i);
+        stats_write_path (response, stats->device_path);
+        qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, stats->pid, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->n_requests, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->n_responses, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->n_timeouts, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->n_aborts, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->n_indications, NULL);
+        qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, stats->n_pending_requests, NULL);
+        qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, stats->n_queued_requests, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->bytes_received, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->bytes_sent, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->latency_max, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->latency_total, NULL);
+        qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, stats->latency_p99, NULL);
+    }
+    qmi_message_tlv_write_complete (response, tlv_offset, NULL);
+}
+
+static gboolean
+process_internal_proxy_get_stats (QmiProxy   *self,
+                                  Client     *client,
+                                  QmiMessage *message)
+{
+    GArray *devices;
+    GArray *clients;
+    QmiMessage *response;
+    GError *error = NULL;
+    gsize budget = PROXY_STATS_MAX_SIZE;
+
+    devices = qmi_proxy_get_device_stats (self);
+    clients = qmi_proxy_get_client_stats (self);
+
+    response = qmi_message_response_new (message, QMI_PROTOCOL_ERROR_NONE);
+    write_device_stats (response, devices, &budget);
+    write_client_stats (response, clients, &budget);
+    g_array_unref (devices);
+    g_array_unref (clients);
+
+    if (!client_send_message (client, response, &error)) {
+        g_warning ("couldn't send proxy stats response to client: %s", error->message);
+        g_error_free (error);
+        untrack_client (self, client);
+    }
+    qmi_message_unref (response);
+
+    return TRUE;
+}
+
+static void
+device_command_ready (QmiDevice *device,
+                      GAsyncResult *res,
+                      Request *request)
+{
+    QmiMessage *response;
+    GError *error = NULL;
+    gboolean allocated = FALSE;
+    QmiClientInfo allocated_info;
+
+    response = qmi_device_command_finish (device, res, &error);
+
+    g_mutex_lock (&request->client->stats_lock);
+    if (response) {
+        guint64 latency;
+
+        latency = (guint64) (g_get_monotonic_time () - request->start_time);
+        client_stats_add_latency (request->client, latency);
+    } else if (g_error_matches (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TIMEOUT))
+        request->client->stats.n_timeouts++;
+    else if (g_error_matches (error, QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_ABORTED))
+        request->client->stats.n_aborts++;
+    g_mutex_unlock (&request->client->stats_lock);
+
+    if (!response) {
+        /* Aborted on request of the client, or because it went away */
+        if (g_cancellable_is_cancelled (request->cancellable))
+            g_debug ("request to device aborted: %s", error->message);
+        else
+            g_warning ("sending request to device failed: %s", error->message);
+        g_error_free (error);
+        request_free (request);
+        return;
+    }
+
+    if (qmi_message_get_service (response) == QMI_SERVICE_CTL) {
+        QmiMessage *rewritten;
+
+        /* The response may be shared with the device (e.g. in its response
+         * cache), so never modify it in place */
+        rewritten = __qmi_message_copy_for_transaction (response,
+                                                        qmi_message_get_client_id (response),
+                                                        request->in_trid);
+        qmi_message_unref (response);
+        response = rewritten;
+
+        if (qmi_message_get_message_id (response) == QMI_MESSAGE_CTL_ALLOCATE_CID)
+            allocated = track_cid (request->client, TRUE, response, &allocated_info);
+        else if (qmi_message_get_message_id (response) == QMI_MESSAGE_CTL_RELEASE_CID)
+            track_cid (request->client, FALSE, response, NULL);
+    }
+
+    if (!client_send_message (request->client, response, &error)) {
+        g_warning ("sending request to device failed: %s", error->message);
+        g_error_free (error);
+        untrack_client (request->self, request->client);
+    } else if (allocated)
+        client_replay_cached_indications (request->client, &allocated_info);
+
+    qmi_message_unref (response);
+    request_free (request);
+}
+
+static void
+request_send (Request    *request,
+              QmiMessage *message)
+{
+    /* The timeout needs to be big enough for any kind of transaction to
+     * complete, otherwise the remote clients will lose the reply if they
+     * configured a timeout bigger than this internal one. Clients abort
+     * the request themselves once they give up waiting for it (or when they
+     * go away), so this is just an upper limit.
+     *
+     * Note: the proxy will not translate vendor-specific messages in its
+     * logs (as it doesn't have the orignal message context with the vendor id).
+     */
+    QMI_PROBE_MESSAGE_VALUE (proxy_forward, message, 1);
+    qmi_device_command (request->client->device,
+                        message,
+                        300,
+                        request->cancellable,
+                        (GAsyncReadyCallback)device_command_ready,
+                        request);
+}
+
+/* Gives the request a transaction id not used by any other CTL request
+ * forwarded to the device */
+static gboolean
+device_info_reserve_ctl_trid (DeviceInfo *info,
+                              Request    *request)
+{
+    guint i;
+
+    for (i = 0; i < G_MAXUINT8; i++) {
+        guint8 trid;
+
+        /* 0 is never used, the device would give its own */
+        trid = info->ctl_next_trid;
+        info->ctl_next_trid = (trid == G_MAXUINT8 ? 1 : trid + 1);
+        if (!info->ctl_requests[trid]) {
+            info->ctl_requests[trid] = request;
+            request->device_info = info;
+            request->out_trid = trid;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void
+device_info_send_ctl_request (DeviceInfo *info,
+                              Request    *request,
+                              QmiMessage *message)
+{
+    /* Wait for some other CTL request to complete if all transaction ids
+     * are in use */
+    if (!g_queue_is_empty (&info->ctl_queue) || !device_info_reserve_ctl_trid (info, request)) {
+        g_debug ("queueing CTL request: no transaction id available");
+        request->message = qmi_message_ref (message);
+        g_queue_push_tail (&info->ctl_queue, request);
+        return;
+    }
+
+    qmi_message_set_transaction_id (message, request->out_trid);
+    request_send (request, message);
+}
+
+static void
+device_info_release_ctl_trid (Request *request)
+{
+    DeviceInfo *info;
+
+    info = request->device_info;
+    if (!info)
+        return;
+
+    g_assert (info->ctl_requests[request->out_trid] == request);
+    info->ctl_requests[request->out_trid] = NULL;
+    request->device_info = NULL;
+
+    /* Send as many queued requests as transaction ids are available */
+    while (!g_queue_is_empty (&info->ctl_queue)) {
+        Request    *next;
+        QmiMessage *message;
+
+        next = g_queue_peek_head (&info->ctl_queue);
+
+        /* The client went away while the request was queued */
+        if (g_cancellable_is_cancelled (next->cancellable)) {
+            g_queue_pop_head (&info->ctl_queue);
+            request_free (next);
+            continue;
+        }
+
+        if (!device_info_reserve_ctl_trid (info, next))
+            break;
+        g_queue_pop_head (&info->ctl_queue);
+
+        message = next->message;
+        next->message = NULL;
+        qmi_message_set_transaction_id (message, next->out_trid);
+        request_send (next, message);
+        qmi_message_unref (message);
+    }
+}
+
+static void
+device_info_clear_ctl_requests (DeviceInfo *info)
+{
+    Request *request;
+    guint    i;
+
+    /* Requests already forwarded still complete on their own; the queued
+     * ones won't ever be sent */
+    for (i = 0; i < G_N_ELEMENTS (info->ctl_requests); i++) {
+        if (info->ctl_requests[i]) {
+            info->ctl_requests[i]->device_info = NULL;
+            info->ctl_requests[i] = NULL;
+        }
+    }
+    while ((request = g_queue_pop_head (&info->ctl_queue)) != NULL)
+        request_free (request);
+}
+
+/* Fair queuing of the service requests: once the window of the device is
+ * full, the requests of each client wait in a queue of its own, and clients
+ * with requests waiting take turns to fill the slots freed, one request each
+ * time, so that a client issuing requests in bulk only delays the requests of
+ * the others by one request per turn. */
+
+static void
+device_info_send_fair_request (DeviceInfo *info,
+                               Request    *request,
+                               QmiMessage *message)
+{
+    g_hash_table_add (info->fair_in_flight, request);
+    request->fair_device_info = info;
+    request_send (request, message);
+}
+
+static void
+device_info_queue_fair_request (DeviceInfo *info,
+                                Request    *request,
+                                QmiMessage *message)
+{
+    Client *client;
+
+    if (g_hash_table_size (info->fair_in_flight) < info->fair_window && g_queue_is_empty (&info->fair_clients)) {
+        device_info_send_fair_request (info, request, message);
+        return;
+    }
+
+    /* Clients are in the round-robin list while they have requests waiting */
+    client = request->client;
+    if (g_queue_is_empty (&client->fair_queue))
+        g_queue_push_tail_link (&info->fair_clients, &client->fair_link);
+
+    request->message = qmi_message_ref (message);
+    request->fair_queued = TRUE;
+    g_queue_push_tail (&client->fair_queue, request);
+
+    g_mutex_lock (&client->stats_lock);
+    client->stats.n_queued_requests++;
+    g_mutex_unlock (&client->stats_lock);
+}
+
+static void
+device_info_release_fair_slot (Request *request)
+{
+    DeviceInfo *info;
+
+    info = request->fair_device_info;
+    if (!info)
+        return;
+
+    g_hash_table_remove (info->fair_in_flight, request);
+    request->fair_device_info = NULL;
+
+    /* Fill the window, taking one request of each client in turn */
+    while (g_hash_table_size (info->fair_in_flight) < info->fair_window && !g_queue_is_empty (&info->fair_clients)) {
+        GList      *link;
+        Client     *client;
+        Request    *next;
+        QmiMessage *message;
+
+        link = g_queue_pop_head_link (&info->fair_clients);
+        client = link->data;
+        next = g_queue_pop_head (&client->fair_queue);
+        if (!g_queue_is_empty (&client->fair_queue))
+            g_queue_push_tail_link (&info->fair_clients, link);
+        next->fair_queued = FALSE;
+
+        g_mutex_lock (&client->stats_lock);
+        client->stats.n_queued_requests--;
+        g_mutex_unlock (&client->stats_lock);
+
+        /* Aborted while waiting */
+        if (g_cancellable_is_cancelled (next->cancellable)) {
+            request_free (next);
+            continue;
+        }
+
+        message = next->message;
+        next->message = NULL;
+        device_info_send_fair_request (info, next, message);
+        qmi_message_unref (message);
+    }
+}
+
+/* Drops the requests waiting, of the given client or of all of them */
+static void
+device_info_clear_fair_requests (DeviceInfo *info,
+                                 Client     *client)
+{
+    GList *l;
+    GList *next;
+
+    for (l = info->fair_clients.head; l; l = next) {
+        Client  *waiting;
+        Request *request;
+
+        next = l->next;
+        waiting = l->data;
+        if (client && waiting != client)
+            continue;
+
+        g_queue_unlink (&info->fair_clients, l);
+        while ((request = g_queue_pop_head (&waiting->fair_queue)) != NULL) {
+            request->fair_queued = FALSE;
+            request_free (request);
+        }
+
+        g_mutex_lock (&waiting->stats_lock);
+        waiting->stats.n_queued_requests = 0;
+        g_mutex_unlock (&waiting->stats_lock);
+    }
+}
+
+static gboolean process_internal_proxy_handoff (QmiProxy   *self,
+                                                Client     *client,
+                                                QmiMessage *message);
+
+static gboolean
+process_message (QmiProxy   *self,
+                 Client     *client,
+                 QmiMessage *message)
+{
+    Request *request;
+
+    /* Accept only request messages from the client */
+    if (!qmi_message_is_request (message)) {
+        g_debug ("invalid message from client: not a request message");
+        return FALSE;
+    }
+
+    if (qmi_message_get_service (message) == QMI_SERVICE_CTL &&
+        qmi_message_get_message_id (message) == QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN)
+        return process_internal_proxy_open (self, client, message);
+
+    if (qmi_message_get_service (message) == QMI_SERVICE_CTL &&
+        qmi_message_get_message_id (message) == QMI_MESSAGE_CTL_INTERNAL_PROXY_ABORT)
+        return process_internal_proxy_abort (self, client, message);
+
+    if (qmi_message_get_service (message) == QMI_SERVICE_CTL &&
+        qmi_message_get_message_id (message) == QMI_MESSAGE_CTL_INTERNAL_PROXY_SET_INDICATION_FILTER)
+        return process_internal_proxy_set_indication_filter (self, client, message);
+
+    if (qmi_message_get_service (message) == QMI_SERVICE_CTL &&
+        qmi_message_get_message_id (message) == QMI_MESSAGE_CTL_INTERNAL_PROXY_GET_TRANSACTIONS)
+        return process_internal_proxy_get_transactions (self, client, message);
+
+    if (qmi_message_get_service (message) == QMI_SERVICE_CTL &&
+        qmi_message_get_message_id (message) == QMI_MESSAGE_CTL_INTERNAL_PROXY_GET_STATS)
+        return process_internal_proxy_get_stats (self, client, message);
+
+    if (qmi_message_get_service (message) == QMI_SERVICE_CTL &&
+        qmi_message_get_message_id (message) == QMI_MESSAGE_CTL_INTERNAL_PROXY_MONITOR)
+        return process_internal_proxy_monitor (self, client, message);
+
+    if (qmi_message_get_service (message) == QMI_SERVICE_CTL &&
+        qmi_message_get_message_id (message) == QMI_MESSAGE_CTL_INTERNAL_PROXY_HANDOFF)
+        return process_internal_proxy_handoff (self, client, message);
+
+    request = g_slice_new0 (Request);
+    __qmi_utils_live_object_add (QMI_UTILS_LIVE_OBJECT_PROXY_REQUEST, 1);
+    request->self = g_object_ref (self);
+    request->client = client_ref (client);
+    request->cancellable = g_cancellable_new ();
+    request->start_time = g_get_monotonic_time ();
+
+    g_mutex_lock (&client->stats_lock);
+    client->stats.n_requests++;
+    client->stats.n_pending_requests++;
+    g_mutex_unlock (&client->stats_lock);
+
+    /* Note: called right away if the client is already gone */
+    request->client_cancelled_id = g_cancellable_connect (client->cancellable,
+                                                          G_CALLBACK (request_client_cancelled),
+                                                          request,
+                                                          NULL);
+
+    if (qmi_message_get_service (message) == QMI_SERVICE_CTL) {
+        /* The transaction id is remapped, so that requests of different
+         * clients don't overwrite each other in the device */
+        request->in_trid = qmi_message_get_transaction_id (message);
+        if (client->device_info) {
+            device_info_send_ctl_request (client->device_info, request, message);
+            return TRUE;
+        }
+        qmi_message_set_transaction_id (message, 0);
+    } else {
+        /* Service requests may be aborted by the client; CTL ones are never
+         * aborted, so that CID allocations are always tracked */
+        request->key = BUILD_REQUEST_KEY (qmi_message_get_service (message),
+                                          qmi_message_get_client_id (message),
+                                          qmi_message_get_transaction_id (message));
+        g_hash_table_insert (client->requests, GUINT_TO_POINTER (request->key), request);
+        if (client->device_info && client->device_info->fair_window) {
+            device_info_queue_fair_request (client->device_info, request, message);
+            return TRUE;
+        }
+    }
+
+    request_send (request, message);
+    return TRUE;
+}
+
+/* Answers a request with malformed TLVs, without forwarding it */
+static void
+client_reject_message (QmiProxy   *self,
+                       Client     *client,
+                       QmiMessage *message)
+{
+    QmiMessage *response;
+    GError     *error = NULL;
+
+    if (!qmi_message_is_request (message))
+        return;
+
+    g_mutex_lock (&client->stats_lock);
+    client->stats.bytes_received += message->len;
+    g_mutex_unlock (&client->stats_lock);
+
+    response = qmi_message_response_new (message, QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE);
+    if (!client_send_message (client, response, &error)) {
+        g_warning ("couldn't send malformed request response to client: %s", error->message);
+        g_error_free (error);
+        untrack_client (self, client);
+    }
+    qmi_message_unref (response);
+}
+
+/* While draining before a handoff, requests are kept in the buffer, so that
+ * they're either processed by the new proxy or once the handoff is aborted */
+static gboolean
+client_is_held (Client *client)
+{
+    Handoff *handoff = client->proxy->priv->handoff;
+
+    return (handoff && handoff->client != client);
+}
+
+static void
+parse_request (QmiProxy *self,
+               Client   *client)
+{
+    while (client->buffer_offset < client->buffer->len && !client->shard_handoff && !client_is_held (client)) {
+        GError *error = NULL;
+        QmiMessage *message;
+        const guint8 *data;
+        gsize data_len;
+        gsize consumed = 0;
+
+        data = &client->buffer->data[client->buffer_offset];
+        data_len = client->buffer->len - client->buffer_offset;
+
+        /* Every message received must start with the QMUX marker.
+         * If it doesn't, we broke framing :-/
+         * If we broke framing, an error should be reported and the device
+         * should get closed */
+        if (data[0] != QMI_MESSAGE_QMUX_MARKER) {
+            /* TODO: Report fatal error */
+            g_warning ("QMI framing error detected");
+            break;
+        }
+
+        /* Frames are validated in place, and only copied out once a
+         * complete one is available. The contents of the TLVs of service
+         * requests are opaque to the proxy, but their lengths are still
+         * checked here, so that a malformed request is rejected by the
+         * proxy, and never reaches the device. */
+        message = __qmi_message_new_from_raw_data_opaque (data, data_len, &consumed, &error);
+        client->buffer_offset += consumed;
+        if (!message) {
+            if (!error)
+                /* More data we need */
+                break;
+
+            /* Warn about the issue */
+            g_warning ("Invalid QMI message received: '%s'",
+                       error->message);
+            g_error_free (error);
+        } else if (!__qmi_message_check_tlvs (message, &error)) {
+            /* The headers are valid, so the client can be told */
+            g_debug ("rejecting malformed QMI message: '%s'", error->message);
+            g_error_free (error);
+            client_reject_message (self, client, message);
+            qmi_message_unref (message);
+        } else {
+            g_mutex_lock (&client->stats_lock);
+            client->stats.bytes_received += message->len;
+            g_mutex_unlock (&client->stats_lock);
+
+            /* Play with the received message */
+            process_message (self, client, message);
+            qmi_message_unref (message);
+        }
+    }
+
+    /* Drop all the already processed data in one single step, instead of
+     * once per parsed message */
+    if (client->buffer_offset == client->buffer->len)
+        g_byte_array_set_size (client->buffer, 0);
+    else if (client->buffer_offset > 0)
+        g_byte_array_remove_range (client->buffer, 0, client->buffer_offset);
+    client->buffer_offset = 0;
+}
+
+/* Compares the whole strings, so that the time taken doesn't tell how
+ * much of the token was right */
+static gboolean
+auth_token_equal (const gchar *token,
+                  gsize        token_len,
+                  const gchar *expected)
+{
+    gsize   expected_len;
+    gsize   i;
+    guint8  diff;
+
+    expected_len = strlen (expected);
+    diff = (token_len != expected_len);
+    for (i = 0; i < token_len; i++)
+        diff |= (guint8) token[i] ^ (guint8) expected[expected_len ? i % expected_len : 0];
+    return !diff;
+}
+
+/* Returns FALSE if the client must be disconnected, and keeps the client
+ * pending until the whole preamble is received */
+static gboolean
+client_authenticate (QmiProxy  *self,
+                     Client    *client,
+                     GError   **error)
+{
+    const gchar *data;
+    const gchar *end;
+    gsize        len;
+    gsize        preamble_len;
+
+    data = (const gchar *) client->buffer->data;
+    len = MIN (client->buffer->len, REMOTE_AUTH_MAX_LENGTH);
+    preamble_len = strlen (REMOTE_AUTH_PREAMBLE);
+
+    if (strncmp (data, REMOTE_AUTH_PREAMBLE, MIN (len, preamble_len)) != 0) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
+                     "missing authentication preamble");
+        return FALSE;
+    }
+
+    end = memchr (data, '\n', len);
+    if (!end) {
+        if (len == REMOTE_AUTH_MAX_LENGTH) {
+            g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
+                         "authentication preamble too long");
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    if ((gsize)(end - data) < preamble_len ||
+        !auth_token_equal (data + preamble_len, end - data - preamble_len, self->priv->auth_token)) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
+                     "invalid authentication token");
+        return FALSE;
+    }
+
+    g_debug ("Client (%d) authenticated", g_socket_get_fd (g_socket_connection_get_socket (client->connection)));
+    client->auth_pending = FALSE;
+    client->buffer_offset = end - data + 1;
+    return TRUE;
+}
+
+static gboolean
+connection_readable_cb (GSocket *socket,
+                        GIOCondition condition,
+                        Client *client)
+{
+    QmiProxy *self;
+    GError *error = NULL;
+    gssize r;
+
+    self = client->proxy;
+
+    if (condition & G_IO_HUP || condition & G_IO_ERR) {
+        untrack_client (self, client);
+        return FALSE;
+    }
+
+    if (!(condition & G_IO_IN || condition & G_IO_PRI))
+        return TRUE;
+
+    if (!G_UNLIKELY (client->buffer))
+        client->buffer = g_byte_array_sized_new (BUFFER_SIZE);
+
+    /* Keep on reading until the socket tells us there is nothing else
+     * available, reading directly into the tail of the input buffer, so
+     * that all the requests received are parsed in one go */
+    while (TRUE) {
+        guint len;
+        gsize chunk;
+
+        /* Read whatever is already queued in the socket with one single
+         * call; the buffer is reused, so it only grows up to the largest
+         * burst seen */
+        chunk = MAX (g_socket_get_available_bytes (socket), BUFFER_SIZE);
+
+        len = client->buffer->len;
+        g_byte_array_set_size (client->buffer, len + chunk);
+        r = g_socket_receive (socket,
+                              (gchar *) &client->buffer->data[len],
+                              chunk,
+                              NULL,
+                              &error);
+        g_byte_array_set_size (client->buffer, len + MAX (r, 0));
+
+        /* A short read means the socket is drained, no need to wait for
+         * it to tell us it would block */
+        if (r > 0 && (gsize) r < chunk)
+            break;
+
+        if (r < 0) {
+            if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+                /* Fully drained */
+                g_error_free (error);
+                break;
+            }
+
+            g_warning ("Error reading from istream: %s", error ? error->message : "unknown");
+            if (error)
+                g_error_free (error);
+            untrack_client (self, client);
+            return FALSE;
+        }
+
+        /* Connection closed, HUP will be reported right away */
+        if (r == 0)
+            break;
+    }
+
+    if (client->buffer->len == 0)
+        return TRUE;
+
+    return client_process_input (self, client);
+}
+
+static gboolean
+client_tls_readable_cb (GObject *stream,
+                        Client  *client)
+{
+    QmiProxy *self;
+    GError   *error = NULL;
+    gssize    r;
+
+    self = client->proxy;
+
+    if (!G_UNLIKELY (client->buffer))
+        client->buffer = g_byte_array_sized_new (BUFFER_SIZE);
+
+    /* Decrypted data may already be buffered in the TLS connection, so
+     * keep on reading until told it would block */
+    while (TRUE) {
+        guint len;
+
+        len = client->buffer->len;
+        g_byte_array_set_size (client->buffer, len + BUFFER_SIZE);
+        r = g_pollable_input_stream_read_nonblocking (G_POLLABLE_INPUT_STREAM (stream),
+                                                      &client->buffer->data[len],
+                                                      BUFFER_SIZE,
+                                                      NULL,
+                                                      &error);
+        g_byte_array_set_size (client->buffer, len + MAX (r, 0));
+
+        if (r > 0)
+            continue;
+
+        if (r < 0 && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+            g_error_free (error);
+            break;
+        }
+
+        if (r < 0) {
+            g_warning ("Error reading from istream: %s", error->message);
+            g_error_free (error);
+        }
+
+        /* Connection closed */
+        untrack_client (self, client);
+        return FALSE;
+    }
+
+    if (client->buffer->len == 0)
+        return TRUE;
+
+    return client_process_input (self, client);
+}
+
+static void
+client_io_uring_read_cb (const guint8 *data,
+                         gsize         len,
+                         const GError *error,
+                         Client       *client)
+{
+    if (error || !len) {
+        if (error)
+            g_warning ("Error reading from istream: %s", error->message);
+        untrack_client (client->proxy, client);
+        return;
+    }
+
+    if (!G_UNLIKELY (client->buffer))
+        client->buffer = g_byte_array_sized_new (BUFFER_SIZE);
+    g_byte_array_append (client->buffer, data, len);
+
+    /* The client may be untracked while processing the requests */
+    client_ref (client);
+    client_process_input (client->proxy, client);
+    client_unref (client);
+}
+
+/* Returns FALSE if the client must not be read any more */
+static gboolean
+client_process_input (QmiProxy *self,
+                      Client   *client)
+{
+    GError *error = NULL;
+
+    /* Nothing else is accepted from remote clients until authenticated */
+    if (client->auth_pending) {
+        if (!client_authenticate (self, client, &error)) {
+            g_warning ("Client (%d) not allowed: %s",
+                       g_socket_get_fd (g_socket_connection_get_socket (client->connection)), error->message);
+            g_error_free (error);
+            untrack_client (self, client);
+            return FALSE;
+        }
+        if (client->auth_pending)
+            return TRUE;
+    }
+
+    /* Try to parse input messages */
+    parse_request (self, client);
+
+    /* Once the device path is known, the client is moved to its shard */
+    if (client->shard_handoff) {
+        GSource *source;
+
+        client_stop_reading (client);
+
+        source = g_idle_source_new ();
+        g_source_set_callback (source,
+                               (GSourceFunc)shard_handoff_idle,
+                               client_ref (client),
+                               (GDestroyNotify)client_unref);
+        g_source_attach (source, client->shard->context);
+        g_source_unref (source);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Not reading yet */
+static Client *
+client_new (QmiProxy          *self,
+            GSocketConnection *connection,
+            gboolean           remote,
+            guint32            pid)
+{
+    Client *client;
+
+    client = g_slice_new0 (Client);
+    __qmi_utils_live_object_add (QMI_UTILS_LIVE_OBJECT_PROXY_CLIENT, 1);
+    client->ref_count = 1;
+    client->proxy = self;
+    client->connection = g_object_ref (connection);
+    client->output_queue = g_queue_new ();
+    client->epoll = self->priv->epoll;
+    /* Shards take over the socket while it's read, which the io_uring
+     * doesn't allow without losing data */
+    client->io_uring = (self->priv->io_uring && !self->priv->sharded);
+    client->remote = remote;
+    /* Writes must never block the proxy */
+    g_socket_set_blocking (g_socket_connection_get_socket (connection), FALSE);
+    client->qmi_client_info_array = g_array_sized_new (FALSE, FALSE, sizeof (QmiClientInfo), 8);
+    client->requests = g_hash_table_new (g_direct_hash, g_direct_equal);
+    client->cancellable = g_cancellable_new ();
+    client->pid = pid;
+    client->stats.pid = client->pid;
+    g_queue_init (&client->fair_queue);
+    client->fair_link.data = client;
+    g_mutex_init (&client->stats_lock);
+    return client;
+}
+
+static void
+client_tls_handshake_ready (GTlsConnection *tls_connection,
+                            GAsyncResult   *res,
+                            Client         *client)
+{
+    GError *error = NULL;
+
+    if (!g_tls_connection_handshake_finish (tls_connection, res, &error)) {
+        /* Cancelled once untracked */
+        if (client->connection) {
+            g_warning ("Client (%d) not allowed: TLS handshake failed: %s",
+                       g_socket_get_fd (g_socket_connection_get_socket (client->connection)), error->message);
+            untrack_client (client->proxy, client);
+        }
+        g_error_free (error);
+        client_unref (client);
+        return;
+    }
+
+    if (client->connection)
+        client_setup_readable_source (client, g_main_context_get_thread_default ());
+    client_unref (client);
+}
+
+static void
+incoming_cb (GSocketService *service,
+             GSocketConnection *connection,
+             GObject *unused,
+             QmiProxy *self)
+{
+    Client *client;
+    GCredentials *credentials;
+    GIOStream *tls_connection = NULL;
+    GError *error = NULL;
+    gboolean remote;
+    uid_t uid = 0;
+    pid_t pid = 0;
+
+    g_debug ("Client (%d) connection open...", g_socket_get_fd (g_socket_connection_get_socket (connection)));
+
+    /* Remote clients have no credentials, they authenticate with the token
+     * instead */
+    remote = G_IS_TCP_CONNECTION (connection);
+    if (remote) {
+        /* Requests are already batched by the clients themselves */
+        if (!g_socket_set_option (g_socket_connection_get_socket (connection), IPPROTO_TCP, TCP_NODELAY, 1, &error)) {
+            g_debug ("Couldn't disable Nagle's algorithm: %s", error->message);
+            g_clear_error (&error);
+        }
+        if (self->priv->tls_certificate) {
+            tls_connection = g_tls_server_connection_new (G_IO_STREAM (connection),
+                                                          self->priv->tls_certificate,
+                                                          &error);
+            if (!tls_connection) {
+                g_warning ("Client not allowed: Error setting up TLS: %s", error->message);
+                g_error_free (error);
+                return;
+            }
+        }
+        goto allowed;
+    }
+
+    credentials = g_socket_get_credentials (g_socket_connection_get_socket (connection), &error);
+    if (!credentials) {
+        g_warning ("Client not allowed: Error getting socket credentials: %s", error->message);
+        g_error_free (error);
+        return;
+    }
+
+    uid = g_credentials_get_unix_user (credentials, &error);
+    pid = g_credentials_get_unix_pid (credentials, NULL);
+    g_object_unref (credentials);
+    if (error) {
+        g_warning ("Client not allowed: Error getting unix user id: %s", error->message);
+        g_error_free (error);
+        return;
+    }
+    if (!__qmi_user_allowed (uid, &error)) {
+        g_warning ("Client not allowed: %s", error->message);
+        g_error_free (error);
+        return;
+    }
+
+allowed:
+    /* Create client */
+    client = client_new (self, connection, remote, (pid > 0 ? (guint32) pid : 0));
+    client->auth_pending = remote;
+    client->same_user = (!remote && uid == getuid ());
+
+    /* Nothing is read from TLS clients until the handshake is done, and
+     * neither the epoll core nor the io_uring engine can be used as the
+     * raw socket is never read */
+    if (tls_connection) {
+        client->tls_connection = tls_connection;
+        client->epoll = FALSE;
+        client->io_uring = FALSE;
+        track_client (self, client);
+        g_tls_connection_handshake_async (G_TLS_CONNECTION (tls_connection),
+                                          G_PRIORITY_DEFAULT,
+                                          client->cancellable,
+                                          (GAsyncReadyCallback)client_tls_handshake_ready,
+                                          client_ref (client));
+        client_unref (client);
+        return;
+    }
+
+    client_setup_readable_source (client, g_main_context_get_thread_default ());
+
+    /* Keep the client info around */
+    track_client (self, client);
+
+    client_unref (client);
+}
+
+static GSocket *
+create_listening_socket (GError **error)
+{
+    GSocketAddress *socket_address;
+    GSocket *socket;
+
+    socket = g_socket_new (G_SOCKET_FAMILY_UNIX,
+                           G_SOCKET_TYPE_STREAM,
+                           G_SOCKET_PROTOCOL_DEFAULT,
+                           error);
+    if (!socket)
+        return NULL;
+
+    /* Bind to address */
+    socket_address = (g_unix_socket_address_new_with_type (
+                          QMI_PROXY_SOCKET_PATH,
+                          -1,
+                          G_UNIX_SOCKET_ADDRESS_ABSTRACT));
+    if (!g_socket_bind (socket, socket_address, TRUE, error)) {
+        g_object_unref (socket_address);
+        g_object_unref (socket);
+        return NULL;
+    }
+    g_object_unref (socket_address);
+
+    g_debug ("creating UNIX socket service...");
+
+    /* Listen */
+    if (!g_socket_listen (socket, error)) {
+        g_object_unref (socket);
+        return NULL;
+    }
+
+    return socket;
+}
+
+static void
+socket_service_new (QmiProxy *self)
+{
+    self->priv->socket_service = g_socket_service_new ();
+    g_signal_connect (self->priv->socket_service, "incoming", G_CALLBACK (incoming_cb), self);
+}
+
+static gboolean
+add_listening_socket (QmiProxy  *self,
+                      GSocket   *socket,
+                      GError   **error)
+{
+    if (!g_socket_listener_add_socket (G_SOCKET_LISTENER (self->priv->socket_service),
+                                       socket,
+                                       NULL, /* don't pass an object, will take a reference */
+                                       error))
+        return FALSE;
+
+    g_ptr_array_add (self->priv->listening_sockets, g_object_ref (socket));
+    return TRUE;
+}
+
+static gboolean
+setup_socket_service (QmiProxy *self,
+                      GSocket  *listening_socket,
+                      GError  **error)
+{
+    GSocket *socket;
+
+    if (listening_socket) {
+        if (g_socket_get_family (listening_socket) != G_SOCKET_FAMILY_UNIX ||
+            g_socket_get_socket_type (listening_socket) != G_SOCKET_TYPE_STREAM) {
+            g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS,
+                         "Listening socket is not a UNIX stream socket");
+            return FALSE;
+        }
+        g_debug ("using inherited UNIX socket...");
+        socket = g_object_ref (listening_socket);
+    } else {
+        socket = create_listening_socket (error);
+        if (!socket)
+            return FALSE;
+    }
+
+    /* Create socket service */
+    socket_service_new (self);
+    if (!add_listening_socket (self, socket, error)) {
+        g_prefix_error (error, "Error adding socket at '%s' to socket service: ", QMI_PROXY_SOCKET_PATH);
+        g_object_unref (socket);
+        return FALSE;
+    }
+
+    g_debug ("starting UNIX socket service at '%s'...", QMI_PROXY_SOCKET_PATH);
+    g_socket_service_start (self->priv->socket_service);
+    g_object_unref (socket);
+    return TRUE;
+}
+
+/*****************************************************************************/
+
+static QmiProxy *
+proxy_new (GSocket   *listening_socket,
+           gboolean   sharded,
+           GError   **error)
+{
+    QmiProxy *self;
+
+    if (!__qmi_user_allowed (getuid (), error))
+        return NULL;
+
+    self = g_object_new (QMI_TYPE_PROXY, NULL);
+    self->priv->sharded = sharded;
+    if (!setup_socket_service (self, listening_socket, error))
+        g_clear_object (&self);
+    return self;
+}
+
+QmiProxy *
+qmi_proxy_new (GError **error)
+{
+    return proxy_new (NULL, FALSE, error);
+}
+
+QmiProxy *
+qmi_proxy_new_sharded (GError **error)
+{
+    return proxy_new (NULL, TRUE, error);
+}
+
+QmiProxy *
+qmi_proxy_new_with_socket (GSocket   *listening_socket,
+                           gboolean   sharded,
+                           GError   **error)
+{
+    g_return_val_if_fail (G_IS_SOCKET (listening_socket), NULL);
+
+    return proxy_new (listening_socket, sharded, error);
+}
+
+QmiProxy *
+qmi_proxy_new_for_handoff (GError **error)
+{
+    QmiProxy *self;
+
+    if (!__qmi_user_allowed (getuid (), error))
+        return NULL;
+
+    /* Listening sockets are added once received from the running proxy */
+    self = g_object_new (QMI_TYPE_PROXY, NULL);
+    socket_service_new (self);
+    g_socket_service_stop (self->priv->socket_service);
+    return self;
+}
+
+void
+qmi_proxy_set_tls_certificate (QmiProxy        *self,
+                               GTlsCertificate *certificate)
+{
+    g_return_if_fail (QMI_IS_PROXY (self));
+    g_return_if_fail (G_IS_TLS_CERTIFICATE (certificate));
+    /* Listeners already added may not be using TLS */
+    g_return_if_fail (!self->priv->auth_token);
+
+    g_clear_object (&self->priv->tls_certificate);
+    self->priv->tls_certificate = g_object_ref (certificate);
+}
+
+gboolean
+qmi_proxy_add_tcp_listener (QmiProxy     *self,
+                            const gchar  *address,
+                            guint16       port,
+                            const gchar  *auth_token,
+                            guint16      *bound_port,
+                            GError      **error)
+{
+    GInetAddress   *inet_address;
+    GSocketAddress *socket_address;
+    GSocketAddress *effective_address;
+    GSocket        *socket;
+
+    g_return_val_if_fail (QMI_IS_PROXY (self), FALSE);
+    g_return_val_if_fail (auth_token != NULL, FALSE);
+
+    if (!auth_token[0] || strchr (auth_token, '\n') ||
+        strlen (REMOTE_AUTH_PREAMBLE) + strlen (auth_token) >= REMOTE_AUTH_MAX_LENGTH) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS,
+                     "Invalid authentication token");
+        return FALSE;
+    }
+
+    /* All the listeners share the same token */
+    if (self->priv->auth_token && g_strcmp0 (self->priv->auth_token, auth_token) != 0) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS,
+                     "A different authentication token is already in use");
+        return FALSE;
+    }
+
+    if (address) {
+        inet_address = g_inet_address_new_from_string (address);
+        if (!inet_address) {
+            g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS,
+                         "Invalid address: '%s'", address);
+            return FALSE;
+        }
+    } else
+        inet_address = g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4);
+
+    /* Anyone in the network could read the token and the traffic */
+    if (!g_inet_address_get_is_loopback (inet_address) && !self->priv->tls_certificate) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_UNSUPPORTED,
+                     "Listening in non-loopback address '%s' requires TLS", address);
+        g_object_unref (inet_address);
+        return FALSE;
+    }
+
+    socket_address = g_inet_socket_address_new (inet_address, port);
+
+    /* The socket is created explicitly, so that it can be handed over */
+    socket = g_socket_new (g_inet_address_get_family (inet_address),
+                           G_SOCKET_TYPE_STREAM,
+                           G_SOCKET_PROTOCOL_TCP,
+                           error);
+    g_object_unref (inet_address);
+    if (!socket ||
+        !g_socket_bind (socket, socket_address, TRUE, error) ||
+        !g_socket_listen (socket, error) ||
+        !add_listening_socket (self, socket, error)) {
+        g_prefix_error (error, "Error adding TCP listener: ");
+        g_object_unref (socket_address);
+        if (socket)
+            g_object_unref (socket);
+        return FALSE;
+    }
+    g_object_unref (socket_address);
+
+    effective_address = g_socket_get_local_address (socket, error);
+    g_object_unref (socket);
+    if (!effective_address) {
+        g_prefix_error (error, "Error adding TCP listener: ");
+        return FALSE;
+    }
+
+    if (!self->priv->auth_token)
+        self->priv->auth_token = g_strdup (auth_token);
+
+    port = g_inet_socket_address_get_port (G_INET_SOCKET_ADDRESS (effective_address));
+    g_debug ("accepting remote clients at TCP port %u...", port);
+    if (bound_port)
+        *bound_port = port;
+    g_object_unref (effective_address);
+    return TRUE;
+}
+
+/*****************************************************************************/
+/* Handoff to a new proxy
+ *
+ * A new proxy started while this one is running connects as a client and
+ * asks for a handoff. The requests in flight are first given some time to
+ * complete, without accepting new clients nor processing new requests; then
+ * the listening sockets, the device files and the client sockets are passed
+ * to the new proxy as file descriptors, together with the state needed to
+ * go on using them: the CIDs allocated by each client, the data received and
+ * not yet processed, the data not yet sent, and the indication filters.
+ * Nothing is closed or open again, and the clients don't notice the switch,
+ * except for the responses to the requests still in flight when the drain
+ * timeout expires, which are lost.
+ *
+ * Not supported in sharded mode. */
+
+static void
+handoff_free (Handoff *handoff)
+{
+    if (handoff->drain_source) {
+        g_source_destroy (handoff->drain_source);
+        g_source_unref (handoff->drain_source);
+    }
+    qmi_message_unref (handoff->request);
+    client_unref (handoff->client);
+    g_slice_free (Handoff, handoff);
+}
+
+static void
+handoff_complete (QmiProxy *self,
+                  gboolean  handed_off)
+{
+    GList *clients;
+    GList *l;
+
+    g_clear_pointer (&self->priv->handoff, handoff_free);
+
+    if (handed_off) {
+        g_debug ("devices and clients handed over to the new proxy");
+        self->priv->handed_off = TRUE;
+        g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_HANDED_OFF]);
+        return;
+    }
+
+    g_socket_service_start (self->priv->socket_service);
+
+    /* Process the requests received while draining */
+    g_mutex_lock (&self->priv->lock);
+    clients = g_hash_table_get_keys (self->priv->clients);
+    g_list_foreach (clients, (GFunc)client_ref, NULL);
+    g_mutex_unlock (&self->priv->lock);
+
+    for (l = clients; l; l = g_list_next (l)) {
+        Client *client = l->data;
+
+        if (client->connection && client->buffer && client->buffer->len > 0 && !client->auth_pending)
+            parse_request (self, client);
+    }
+    g_list_free_full (clients, (GDestroyNotify)client_unref);
+}
+
+static gint32
+handoff_add_fd (GArray *fds,
+                gint    fd)
+{
+    g_array_append_val (fds, fd);
+    return (gint32) (fds->len - 1);
+}
+
+/* Writes all the data, with the control message given along the first
+ * bytes, if any */
+static gboolean
+handoff_send (GSocket                *socket,
+              const guint8           *data,
+              gsize                   data_len,
+              GSocketControlMessage  *control,
+              GCancellable           *cancellable,
+              GError                **error)
+{
+    gsize sent = 0;
+
+    while (sent < data_len) {
+        GOutputVector vector;
+        gssize        r;
+
+        vector.buffer = &data[sent];
+        vector.size = data_len - sent;
+        r = g_socket_send_message (socket,
+                                   NULL, /* address */
+                                   &vector,
+                                   1,
+                                   control ? &control : NULL,
+                                   control ? 1 : 0,
+                                   0, /* flags */
+                                   cancellable,
+                                   error);
+        if (r < 0)
+            return FALSE;
+        sent += r;
+        control = NULL;
+    }
+    return TRUE;
+}
+
+/* Reads exactly the amount of data requested, collecting in @fds all the
+ * file descriptors received along */
+static gboolean
+handoff_receive (GSocket       *socket,
+                 guint8        *data,
+                 gsize          data_len,
+                 GArray        *fds,
+                 GCancellable  *cancellable,
+                 GError       **error)
+{
+    gsize received = 0;
+
+    while (received < data_len) {
+        GInputVector            vector;
+        GSocketControlMessage **messages = NULL;
+        gint                    n_messages = 0;
+        gint                    flags = 0;
+        gssize                  r;
+        gint                    i;
+
+        vector.buffer = &data[received];
+        vector.size = data_len - received;
+        r = g_socket_receive_message (socket,
+                                      NULL, /* address */
+                                      &vector,
+                                      1,
+                                      &messages,
+                                      &n_messages,
+                                      &flags,
+                                      cancellable,
+                                      error);
+
+        for (i = 0; i < n_messages; i++) {
+            if (G_IS_UNIX_FD_MESSAGE (messages[i])) {
+                gint *stolen;
+                gint  n_stolen = 0;
+
+                stolen = g_unix_fd_message_steal_fds (G_UNIX_FD_MESSAGE (messages[i]), &n_stolen);
+                if (fds)
+                    g_array_append_vals (fds, stolen, n_stolen);
+                else {
+                    while (n_stolen > 0)
+                        close (stolen[--n_stolen]);
+                }
+                g_free (stolen);
+            }
+            g_object_unref (messages[i]);
+        }
+        g_free (messages);
+
+        if (r < 0)
+            return FALSE;
+        if (r == 0) {
+            g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
+                         "Connection closed");
+            return FALSE;
+        }
+        received += r;
+    }
+    return TRUE;
+}
+
+/*****************************************************************************/
+/* Handoff to a new proxy: handing over */
+
+typedef struct {
+    DeviceInfo *info;
+    gint        fd;
+    GByteArray *pending_input;
+} HandoffDevice;
+
+static void
+handoff_device_free (HandoffDevice *device)
+{
+    g_byte_array_unref (device->pending_input);
+    g_slice_free (HandoffDevice, device);
+}
 
-    buffer = qmi_message_get_raw_tlv (message,
-                                      QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN_INPUT_TLV_DEVICE_PATH,
-                                      &buffer_len);
-    if (!buffer) {
-        g_debug ("ignoring message from client: invalid proxy open request");
-        return FALSE;
+static GVariant *
+handoff_build_client (Client *client,
+                      GArray *fds)
+{
+    GVariantBuilder  cids_builder;
+    GVariantBuilder  keys_builder;
+    GByteArray      *output;
+    GVariant        *input_variant;
+    GVariant        *output_variant;
+    GList           *l;
+    gsize            offset;
+    guint            i;
+
+    g_variant_builder_init (&cids_builder, G_VARIANT_TYPE ("a(yy)"));
+    for (i = 0; i < client->qmi_client_info_array->len; i++) {
+        QmiClientInfo *cinfo;
+
+        cinfo = &g_array_index (client->qmi_client_info_array, QmiClientInfo, i);
+        g_variant_builder_add (&cids_builder, "(yy)", (guint8) cinfo->service, cinfo->cid);
     }
 
-    qmi_utils_read_string_from_buffer (&buffer, &buffer_len, 0, 0, &device_file_path);
-    g_debug ("valid request to open connection to QMI device file: %s", device_file_path);
+    g_variant_builder_init (&keys_builder, G_VARIANT_TYPE ("au"));
+    if (client->indication_filter) {
+        GHashTableIter iter;
+        gpointer       key;
 
-    /* Keep it */
-    client->internal_proxy_open_request = qmi_message_ref (message);
+        g_hash_table_iter_init (&iter, client->indication_filter);
+        while (g_hash_table_iter_next (&iter, &key, NULL))
+            g_variant_builder_add (&keys_builder, "u", GPOINTER_TO_UINT (key));
+    }
 
-    client->device = find_device_for_path (self, device_file_path);
+    /* Whatever was not written yet, as one single chunk */
+    output = g_byte_array_sized_new (client->output_pending);
+    offset = client->output_offset;
+    for (l = g_queue_peek_head_link (client->output_queue); l; l = g_list_next (l)) {
+        QmiMessage *message = l->data;
 
-    /* Need to create a device ourselves */
-    if (!client->device) {
-        GFile *file;
+        g_byte_array_append (output, &message->data[offset], message->len - offset);
+        offset = 0;
+    }
+    output_variant = g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE, output->data, output->len, 1);
+    g_byte_array_unref (output);
+
+    input_variant = g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE,
+                                               client->buffer ? &client->buffer->data[client->buffer_offset] : NULL,
+                                               client->buffer ? client->buffer->len - client->buffer_offset : 0,
+                                               1);
+
+    return g_variant_new ("(hbbusa(yy)@ay@ay@au@au@aub)",
+                          handoff_add_fd (fds, g_socket_get_fd (g_socket_connection_get_socket (client->connection))),
+                          client->remote,
+                          client->auth_pending,
+                          client->pid,
+                          client->device ? qmi_device_get_path (client->device) : "",
+                          &cids_builder,
+                          input_variant,
+                          output_variant,
+                          g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32,
+                                                     client->indication_filtered_services,
+                                                     G_N_ELEMENTS (client->indication_filtered_services),
+                                                     sizeof (guint32)),
+                          &keys_builder,
+                          g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32,
+                                                     client->monitored_services,
+                                                     G_N_ELEMENTS (client->monitored_services),
+                                                     sizeof (guint32)),
+                          client->monitoring);
+}
 
-        file = g_file_new_for_path (device_file_path);
-        qmi_device_new (file,
-                        NULL,
-                        (GAsyncReadyCallback)device_new_ready,
-                        client_ref (client)); /* Full ref */
-        g_object_unref (file);
-        g_free (device_file_path);
-        return TRUE;
+static GVariant *
+handoff_build_state (QmiProxy  *self,
+                     GPtrArray *devices,
+                     GPtrArray *clients,
+                     GArray    *fds)
+{
+    GVariantBuilder sockets_builder;
+    GVariantBuilder devices_builder;
+    GVariantBuilder clients_builder;
+    guint           i;
+
+    g_variant_builder_init (&sockets_builder, G_VARIANT_TYPE ("ah"));
+    for (i = 0; i < self->priv->listening_sockets->len; i++)
+        g_variant_builder_add (&sockets_builder, "h",
+                               handoff_add_fd (fds, g_socket_get_fd (g_ptr_array_index (self->priv->listening_sockets, i))));
+
+    g_variant_builder_init (&devices_builder, G_VARIANT_TYPE ("a(shay)"));
+    for (i = 0; i < devices->len; i++) {
+        HandoffDevice *device = g_ptr_array_index (devices, i);
+
+        g_variant_builder_add (&devices_builder, "(sh@ay)",
+                               qmi_device_get_path (device->info->device),
+                               handoff_add_fd (fds, device->fd),
+                               g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE,
+                                                          device->pending_input->data,
+                                                          device->pending_input->len,
+                                                          1));
     }
 
-    g_free (device_file_path);
+    g_variant_builder_init (&clients_builder, G_VARIANT_TYPE ("a" HANDOFF_CLIENT_FORMAT));
+    for (i = 0; i < clients->len; i++)
+        g_variant_builder_add_value (&clients_builder, handoff_build_client (g_ptr_array_index (clients, i), fds));
 
-    /* Keep a reference to the device in the client */
-    g_object_ref (client->device);
+    return g_variant_ref_sink (g_variant_new (HANDOFF_STATE_FORMAT,
+                                              HANDOFF_STATE_VERSION,
+                                              &sockets_builder,
+                                              self->priv->auth_token ? self->priv->auth_token : "",
+                                              &devices_builder,
+                                              &clients_builder));
+}
 
-    complete_internal_proxy_open (self, client);
-    return FALSE;
+static gboolean
+handoff_send_state (Handoff   *handoff,
+                    GArray    *fds,
+                    GVariant  *state,
+                    GError   **error)
+{
+    GSocket      *socket;
+    QmiMessage   *response;
+    const guint8 *raw;
+    gsize         raw_len = 0;
+    guint8        header[5];
+    guint8        marker;
+    guint32       state_len;
+    guint         i;
+    gboolean      sent;
+
+    /* The whole exchange is synchronous, as nothing else is going on */
+    socket = g_socket_connection_get_socket (handoff->client->connection);
+    g_socket_set_blocking (socket, TRUE);
+    g_socket_set_timeout (socket, HANDOFF_SOCKET_TIMEOUT);
+
+    response = qmi_message_response_new (handoff->request, QMI_PROTOCOL_ERROR_NONE);
+    raw = qmi_message_get_raw (response, &raw_len, error);
+    sent = (raw && handoff_send (socket, raw, raw_len, NULL, NULL, error));
+    qmi_message_unref (response);
+    if (!sent)
+        return FALSE;
+
+    for (i = 0; i < fds->len; i += HANDOFF_MAX_FDS_PER_MESSAGE) {
+        GUnixFDList           *fd_list;
+        GSocketControlMessage *control;
+        guint                  j;
+
+        marker = HANDOFF_MARKER_FDS;
+        fd_list = g_unix_fd_list_new ();
+        for (j = i; j < fds->len && j < i + HANDOFF_MAX_FDS_PER_MESSAGE; j++) {
+            if (g_unix_fd_list_append (fd_list, g_array_index (fds, gint, j), error) < 0) {
+                g_object_unref (fd_list);
+                return FALSE;
+            }
+        }
+        control = g_unix_fd_message_new_with_fd_list (fd_list);
+        g_object_unref (fd_list);
+        sent = handoff_send (socket, &marker, 1, control, NULL, error);
+        g_object_unref (control);
+        if (!sent)
+            return FALSE;
+    }
+
+    state_len = GUINT32_TO_LE ((guint32) g_variant_get_size (state));
+    header[0] = HANDOFF_MARKER_STATE;
+    memcpy (&header[1], &state_len, 4);
+    if (!handoff_send (socket, header, sizeof (header), NULL, NULL, error) ||
+        !handoff_send (socket, g_variant_get_data (state), g_variant_get_size (state), NULL, NULL, error))
+        return FALSE;
+
+    /* Once the new proxy has everything, we're done */
+    if (!handoff_receive (socket, &marker, 1, NULL, NULL, error))
+        return FALSE;
+    if (marker != HANDOFF_MARKER_ADOPTED) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
+                     "Unexpected handoff reply: 0x%02x", marker);
+        return FALSE;
+    }
+
+    marker = HANDOFF_MARKER_DONE;
+    return handoff_send (socket, &marker, 1, NULL, NULL, error);
 }
 
 static void
-track_cid (Client *client,
-           gboolean track,
-           QmiMessage *message)
+handoff_run (QmiProxy *self)
 {
-    const guint8 *buffer;
-    guint16 buffer_len;
-    guint16 error_status;
-    guint16 error_code;
-    guint8 tmp;
-    QmiClientInfo info;
-    guint i;
-    gboolean exists;
+    Handoff       *handoff;
+    Client        *handoff_client;
+    GPtrArray     *clients;
+    GPtrArray     *devices;
+    GArray        *fds;
+    GVariant      *state;
+    GList         *tracked;
+    GList         *l;
+    GHashTableIter iter;
+    DeviceInfo    *info;
+    GError        *error = NULL;
+    gboolean       handed_off = FALSE;
+    guint          i;
+
+    handoff = self->priv->handoff;
+    handoff_client = client_ref (handoff->client);
+    client_stop_reading (handoff_client);
+
+    g_mutex_lock (&self->priv->lock);
+    tracked = g_hash_table_get_keys (self->priv->clients);
+    g_list_foreach (tracked, (GFunc)client_ref, NULL);
+    g_mutex_unlock (&self->priv->lock);
+
+    /* Clients still waiting for a device being open can't be handed over */
+    clients = g_ptr_array_new_with_free_func ((GDestroyNotify)client_unref);
+    for (l = tracked; l; l = g_list_next (l)) {
+        Client *client = l->data;
 
-    buffer = qmi_message_get_raw_tlv (message, QMI_MESSAGE_OUTPUT_TLV_RESULT, &buffer_len);
-    if (!buffer || buffer_len != 4) {
-        g_warning ("invalid 'CTL allocate CID' response: missing or invalid result TLV");
-        return;
+        if (client == handoff_client)
+            continue;
+        /* Nor TLS sessions, which live in this process only */
+        if (!client->connection || client->stalled || client->internal_proxy_open_request || client->tls_connection) {
+            g_debug ("Client (%d) not ready for handoff, disconnecting",
+                     client->connection ? g_socket_get_fd (g_socket_connection_get_socket (client->connection)) : -1);
+            untrack_client (self, client);
+            continue;
+        }
+        client_stop_reading (client);
+        g_ptr_array_add (clients, client_ref (client));
     }
+    g_list_free_full (tracked, (GDestroyNotify)client_unref);
 
-    qmi_utils_read_guint16_from_buffer (&buffer, &buffer_len, QMI_ENDIAN_LITTLE, &error_status);
-    if (error_status != 0x00)
-        return;
+    devices = g_ptr_array_new_with_free_func ((GDestroyNotify)handoff_device_free);
+    fds = g_array_new (FALSE, FALSE, sizeof (gint));
 
-    qmi_utils_read_guint16_from_buffer (&buffer, &buffer_len, QMI_ENDIAN_LITTLE, &error_code);
-    if (error_code != QMI_PROTOCOL_ERROR_NONE)
-        return;
+    g_hash_table_iter_init (&iter, self->priv->devices);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&info)) {
+        HandoffDevice *device;
 
-    buffer = qmi_message_get_raw_tlv (message, QMI_MESSAGE_OUTPUT_TLV_ALLOCATION_INFO, &buffer_len);
-    if (!buffer || buffer_len != 2) {
-        g_warning ("invalid 'CTL allocate CID' response: missing or invalid allocation info TLV");
-        return;
+        device = g_slice_new0 (HandoffDevice);
+        device->info = info;
+        if (!__qmi_device_handoff_pause (info->device, &device->fd, &device->pending_input, &error)) {
+            g_slice_free (HandoffDevice, device);
+            goto out;
+        }
+        g_ptr_array_add (devices, device);
     }
 
-    qmi_utils_read_guint8_from_buffer (&buffer, &buffer_len, &tmp);
-    info.service = (QmiService)tmp;
-    qmi_utils_read_guint8_from_buffer (&buffer, &buffer_len, &(info.cid));
+    state = handoff_build_state (self, devices, clients, fds);
+    g_debug ("handing over %u devices and %u clients (%u file descriptors, %" G_GSIZE_FORMAT " bytes of state)...",
+             devices->len, clients->len, fds->len, g_variant_get_size (state));
+    handed_off = handoff_send_state (handoff, fds, state, &error);
+    g_variant_unref (state);
 
+out:
+    if (handed_off) {
+        /* The new proxy owns the connections from now on, so they're closed
+         * without sending anything else; the requests still in flight are
+         * never answered */
+        for (i = 0; i < clients->len; i++)
+            client_disconnect (g_ptr_array_index (clients, i));
+    } else {
+        g_warning ("couldn't hand over to the new proxy: %s", error->message);
+        g_error_free (error);
 
-    /* Check if it already exists */
-    for (i = 0; i < client->qmi_client_info_array->len; i++) {
-        QmiClientInfo *existing;
+        for (i = 0; i < devices->len; i++)
+            __qmi_device_handoff_resume (((HandoffDevice *) g_ptr_array_index (devices, i))->info->device);
+        for (i = 0; i < clients->len; i++) {
+            Client *client = g_ptr_array_index (clients, i);
 
-        existing = &g_array_index (client->qmi_client_info_array, QmiClientInfo, i);
-        if (existing->service == info.service && existing->cid == info.cid)
-            break;
+            client_setup_readable_source (client, self->priv->main_context);
+            if (!g_queue_is_empty (client->output_queue))
+                client_output_flush (client);
+        }
     }
-    exists = (i < client->qmi_client_info_array->len);
 
-    if (track && !exists) {
-        g_debug ("QMI client tracked [%s,%s,%u]",
-                 qmi_device_get_path_display (client->device),
-                 qmi_service_get_string (info.service),
-                 info.cid);
-        g_array_append_val (client->qmi_client_info_array, info);
-    } else if (!track && exists) {
-        g_debug ("QMI client untracked [%s,%s,%u]",
-                 qmi_device_get_path_display (client->device),
-                 qmi_service_get_string (info.service),
-                 info.cid);
-        g_array_remove_index (client->qmi_client_info_array, i);
+    g_array_unref (fds);
+    g_ptr_array_unref (devices);
+    g_ptr_array_unref (clients);
+
+    handoff_complete (self, handed_off);
+    untrack_client (self, handoff_client);
+    client_unref (handoff_client);
+}
+
+static gboolean
+handoff_drained (QmiProxy *self)
+{
+    GHashTableIter  iter;
+    Client         *client;
+    gboolean        drained = TRUE;
+
+    if (g_hash_table_size (self->priv->pending_opens) > 0)
+        return FALSE;
+
+    g_mutex_lock (&self->priv->lock);
+    g_hash_table_iter_init (&iter, self->priv->clients);
+    while (drained && g_hash_table_iter_next (&iter, (gpointer *)&client, NULL)) {
+        g_mutex_lock (&client->stats_lock);
+        drained = (client->stats.n_pending_requests == 0);
+        g_mutex_unlock (&client->stats_lock);
+    }
+    g_mutex_unlock (&self->priv->lock);
+
+    return drained;
+}
+
+static gboolean
+handoff_drain_cb (QmiProxy *self)
+{
+    Handoff *handoff = self->priv->handoff;
+
+    if (!handoff_drained (self)) {
+        if (g_get_monotonic_time () < handoff->deadline)
+            return G_SOURCE_CONTINUE;
+        g_debug ("handoff drain timed out: responses to the requests in flight will be lost");
     }
+
+    g_clear_pointer (&handoff->drain_source, g_source_unref);
+    handoff_run (self);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+process_internal_proxy_handoff (QmiProxy   *self,
+                                Client     *client,
+                                QmiMessage *message)
+{
+    const guint8     *buffer;
+    guint16           buffer_len;
+    guint32           drain_timeout = HANDOFF_DEFAULT_DRAIN_TIMEOUT;
+    QmiProtocolError  error_status = QMI_PROTOCOL_ERROR_NONE;
+    Handoff          *handoff;
+
+    if (self->priv->sharded || self->priv->io_uring)
+        error_status = QMI_PROTOCOL_ERROR_NOT_SUPPORTED;
+    else if (!client->same_user)
+        error_status = QMI_PROTOCOL_ERROR_ACCESS_DENIED;
+    else if (self->priv->handoff || self->priv->handed_off)
+        error_status = QMI_PROTOCOL_ERROR_DEVICE_IN_USE;
+
+    if (error_status != QMI_PROTOCOL_ERROR_NONE) {
+        QmiMessage *response;
+        GError     *error = NULL;
+
+        g_debug ("refusing handoff: %s", qmi_protocol_error_get_string (error_status));
+        response = qmi_message_response_new (message, error_status);
+        if (!client_send_message (client, response, &error)) {
+            g_warning ("couldn't send proxy handoff response to client: %s", error->message);
+            g_error_free (error);
+            untrack_client (self, client);
+        }
+        qmi_message_unref (response);
+        return TRUE;
+    }
+
+    buffer = qmi_message_get_raw_tlv (message,
+                                      QMI_MESSAGE_CTL_INTERNAL_PROXY_HANDOFF_INPUT_TLV_DRAIN_TIMEOUT,
+                                      &buffer_len);
+    if (buffer && buffer_len == 4) {
+        memcpy (&drain_timeout, buffer, 4);
+        drain_timeout = GUINT32_FROM_LE (drain_timeout);
+    }
+
+    g_debug ("handoff requested: draining requests for up to %u seconds...", drain_timeout);
+
+    /* New clients wait in the listening sockets for the new proxy */
+    g_socket_service_stop (self->priv->socket_service);
+
+    handoff = g_slice_new0 (Handoff);
+    handoff->client = client_ref (client);
+    handoff->request = qmi_message_ref (message);
+    handoff->deadline = g_get_monotonic_time () + (gint64) drain_timeout * G_USEC_PER_SEC;
+    handoff->drain_source = g_timeout_source_new (HANDOFF_DRAIN_POLL_MS);
+    g_source_set_callback (handoff->drain_source,
+                           (GSourceFunc) handoff_drain_cb,
+                           self,
+                           NULL);
+    g_source_attach (handoff->drain_source, self->priv->main_context);
+    self->priv->handoff = handoff;
+    return TRUE;
 }
 
+/*****************************************************************************/
+/* Handoff to a new proxy: taking over */
+
 typedef struct {
-    QmiProxy *self;   /* Full ref */
-    Client   *client; /* Full ref */
-    guint8    in_trid;
-} Request;
+    guint      drain_timeout;
+    GSocket   *socket;
+    GArray    *fds; /* -1 once taken */
+    GVariant  *state;
+    GVariant  *devices;
+    guint      device_i;
+} ReceiveHandoffContext;
 
 static void
-request_free (Request *request)
+receive_handoff_context_free (ReceiveHandoffContext *ctx)
 {
-    if (!request)
-        return;
-    client_unref (request->client);
-    g_object_unref (request->self);
-    g_slice_free (Request, request);
+    guint i;
+
+    for (i = 0; i < ctx->fds->len; i++) {
+        if (g_array_index (ctx->fds, gint, i) >= 0)
+            close (g_array_index (ctx->fds, gint, i));
+    }
+    g_array_unref (ctx->fds);
+    if (ctx->devices)
+        g_variant_unref (ctx->devices);
+    if (ctx->state)
+        g_variant_unref (ctx->state);
+    if (ctx->socket)
+        g_object_unref (ctx->socket);
+    g_slice_free (ReceiveHandoffContext, ctx);
 }
 
-static void
-device_command_ready (QmiDevice *device,
-                      GAsyncResult *res,
-                      Request *request)
+static gint
+receive_handoff_take_fd (ReceiveHandoffContext  *ctx,
+                         gint32                  index,
+                         GError                **error)
 {
-    QmiMessage *response;
-    GError *error = NULL;
+    gint fd;
 
-    response = qmi_device_command_finish (device, res, &error);
-    if (!response) {
-        g_warning ("sending request to device failed: %s", error->message);
-        g_error_free (error);
-        request_free (request);
-        return;
+    if (index < 0 || (guint) index >= ctx->fds->len || g_array_index (ctx->fds, gint, index) < 0) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_MESSAGE,
+                     "Invalid file descriptor index in handoff state: %d", index);
+        return -1;
     }
 
-    if (qmi_message_get_service (response) == QMI_SERVICE_CTL) {
-        qmi_message_set_transaction_id (response, request->in_trid);
-        if (qmi_message_get_message_id (response) == QMI_MESSAGE_CTL_ALLOCATE_CID)
-            track_cid (request->client, TRUE, response);
-        else if (qmi_message_get_message_id (response) == QMI_MESSAGE_CTL_RELEASE_CID)
-            track_cid (request->client, FALSE, response);
+    fd = g_array_index (ctx->fds, gint, index);
+    g_array_index (ctx->fds, gint, index) = -1;
+    return fd;
+}
+
+/* Run in a thread, as all the operations are blocking */
+static gboolean
+receive_handoff_state (ReceiveHandoffContext  *ctx,
+                       GCancellable           *cancellable,
+                       GError                **error)
+{
+    GSocketAddress   *address;
+    QmiMessage       *request;
+    QmiMessage       *response;
+    GByteArray       *buffer;
+    const guint8     *raw;
+    gsize             raw_len = 0;
+    guint16           qmux_len;
+    guint32           drain_timeout;
+    guint32           state_len;
+    guint8            marker;
+    guint8           *state_data;
+    QmiProtocolError  result;
+    gboolean          connected;
+
+    ctx->socket = g_socket_new (G_SOCKET_FAMILY_UNIX, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT, error);
+    if (!ctx->socket)
+        return FALSE;
+    /* The response comes once the requests in flight are drained */
+    g_socket_set_timeout (ctx->socket, ctx->drain_timeout + HANDOFF_SOCKET_TIMEOUT);
+
+    address = g_unix_socket_address_new_with_type (QMI_PROXY_SOCKET_PATH, -1, G_UNIX_SOCKET_ADDRESS_ABSTRACT);
+    connected = g_socket_connect (ctx->socket, address, cancellable, error);
+    g_object_unref (address);
+    if (!connected) {
+        g_prefix_error (error, "Cannot connect to the running proxy: ");
+        return FALSE;
     }
 
-    if (!client_send_message (request->client, response, &error)) {
-        g_warning ("sending request to device failed: %s", error->message);
-        g_error_free (error);
-        untrack_client (request->self, request->client);
+    request = qmi_message_new (QMI_SERVICE_CTL, 0, 1, QMI_MESSAGE_CTL_INTERNAL_PROXY_HANDOFF);
+    drain_timeout = GUINT32_TO_LE (ctx->drain_timeout);
+    qmi_message_add_raw_tlv (request,
+                             QMI_MESSAGE_CTL_INTERNAL_PROXY_HANDOFF_INPUT_TLV_DRAIN_TIMEOUT,
+                             (const guint8 *) &drain_timeout,
+                             4,
+                             NULL);
+    raw = qmi_message_get_raw (request, &raw_len, error);
+    connected = (raw && handoff_send (ctx->socket, raw, raw_len, NULL, cancellable, error));
+    qmi_message_unref (request);
+    if (!connected)
+        return FALSE;
+
+    /* QMUX marker and length, which doesn't include the marker */
+    buffer = g_byte_array_sized_new (BUFFER_SIZE);
+    g_byte_array_set_size (buffer, 3);
+    if (!handoff_receive (ctx->socket, buffer->data, 3, NULL, cancellable, error)) {
+        g_byte_array_unref (buffer);
+        return FALSE;
+    }
+    memcpy (&qmux_len, &buffer->data[1], 2);
+    qmux_len = GUINT16_FROM_LE (qmux_len);
+    if (buffer->data[0] != QMI_MESSAGE_QMUX_MARKER || qmux_len < 2) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_MESSAGE,
+                     "Invalid handoff response");
+        g_byte_array_unref (buffer);
+        return FALSE;
+    }
+    g_byte_array_set_size (buffer, qmux_len + 1);
+    if (!handoff_receive (ctx->socket, &buffer->data[3], qmux_len - 2, NULL, cancellable, error)) {
+        g_byte_array_unref (buffer);
+        return FALSE;
     }
+    response = qmi_message_new_from_raw (buffer, error);
+    g_byte_array_unref (buffer);
+    if (!response)
+        return FALSE;
 
+    result = qmi_message_get_result_code (response);
     qmi_message_unref (response);
-    request_free (request);
+    if (result != QMI_PROTOCOL_ERROR_NONE) {
+        g_set_error (error, QMI_PROTOCOL_ERROR, result,
+                     "Handoff refused by the running proxy: %s",
+                     qmi_protocol_error_get_string (result));
+        return FALSE;
+    }
+
+    /* File descriptors, and then the state */
+    while (TRUE) {
+        if (!handoff_receive (ctx->socket, &marker, 1, ctx->fds, cancellable, error))
+            return FALSE;
+        if (marker == HANDOFF_MARKER_STATE)
+            break;
+        if (marker != HANDOFF_MARKER_FDS) {
+            g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_MESSAGE,
+                         "Unexpected handoff data: 0x%02x", marker);
+            return FALSE;
+        }
+    }
+
+    if (!handoff_receive (ctx->socket, (guint8 *) &state_len, 4, NULL, cancellable, error))
+        return FALSE;
+    state_len = GUINT32_FROM_LE (state_len);
+    if (state_len > HANDOFF_STATE_MAX_LENGTH) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_MESSAGE,
+                     "Handoff state too long: %u bytes", state_len);
+        return FALSE;
+    }
+
+    state_data = g_malloc (state_len);
+    if (!handoff_receive (ctx->socket, state_data, state_len, NULL, cancellable, error)) {
+        g_free (state_data);
+        return FALSE;
+    }
+    ctx->state = g_variant_ref_sink (g_variant_new_from_data (G_VARIANT_TYPE (HANDOFF_STATE_FORMAT),
+                                                              state_data,
+                                                              state_len,
+                                                              FALSE,
+                                                              g_free,
+                                                              state_data));
+
+    {
+        guint32 version;
+
+        g_variant_get_child (ctx->state, 0, "u", &version);
+        if (version != HANDOFF_STATE_VERSION) {
+            g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_UNSUPPORTED,
+                         "Unsupported handoff state version: %u", version);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static void
+receive_handoff_thread (GTask                 *task,
+                        QmiProxy              *self,
+                        ReceiveHandoffContext *ctx,
+                        GCancellable          *cancellable)
+{
+    GError *error = NULL;
+
+    if (!receive_handoff_state (ctx, cancellable, &error))
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
+}
+
+/* Drops everything adopted, without sending anything, as the clients and
+ * devices are still handled by the old proxy */
+static void
+receive_handoff_abort (QmiProxy *self)
+{
+    GHashTableIter  iter;
+    Client         *client;
+
+    g_mutex_lock (&self->priv->lock);
+    g_hash_table_iter_init (&iter, self->priv->clients);
+    while (g_hash_table_iter_next (&iter, (gpointer *)&client, NULL)) {
+        client->device_info = NULL;
+        client_disconnect (client);
+    }
+    g_hash_table_remove_all (self->priv->devices);
+    g_hash_table_remove_all (self->priv->clients);
+    g_mutex_unlock (&self->priv->lock);
+
+    g_socket_listener_close (G_SOCKET_LISTENER (self->priv->socket_service));
+    g_ptr_array_set_size (self->priv->listening_sockets, 0);
+    g_clear_pointer (&self->priv->auth_token, g_free);
 }
 
 static gboolean
-process_message (QmiProxy   *self,
-                 Client     *client,
-                 QmiMessage *message)
+receive_handoff_client (QmiProxy               *self,
+                        ReceiveHandoffContext  *ctx,
+                        GVariant               *variant,
+                        GError                **error)
 {
-    Request *request;
+    gint32              fd_index;
+    gboolean            remote;
+    gboolean            auth_pending;
+    guint32             pid;
+    const gchar        *path;
+    GVariant           *cids;
+    GVariant           *input;
+    GVariant           *output;
+    GVariant           *filtered;
+    GVariant           *keys;
+    GVariant           *monitored;
+    gboolean            monitoring;
+    gint                fd;
+    GSocket            *socket;
+    GSocketConnection  *connection;
+    Client             *client;
+    GVariantIter        iter;
+    const guint8       *data;
+    const guint32      *words;
+    gsize               len;
+    guint8              service;
+    guint8              cid;
+    guint32             key;
+    gboolean            success = FALSE;
+
+    g_variant_get (variant, "(hbbu&s@a(yy)@ay@ay@au@au@aub)",
+                   &fd_index, &remote, &auth_pending, &pid, &path,
+                   &cids, &input, &output, &filtered, &keys, &monitored, &monitoring);
+
+    fd = receive_handoff_take_fd (ctx, fd_index, error);
+    if (fd < 0)
+        goto out;
+    socket = g_socket_new_from_fd (fd, error);
+    if (!socket) {
+        close (fd);
+        goto out;
+    }
+    connection = g_socket_connection_factory_create_connection (socket);
+    g_object_unref (socket);
 
-    /* Accept only request messages from the client */
-    if (!qmi_message_is_request (message)) {
-        g_debug ("invalid message from client: not a request message");
-        return FALSE;
+    client = client_new (self, connection, remote, pid);
+    g_object_unref (connection);
+    client->auth_pending = auth_pending;
+
+    data = g_variant_get_fixed_array (input, &len, 1);
+    if (len > 0) {
+        client->buffer = g_byte_array_sized_new (MAX (BUFFER_SIZE, len));
+        g_byte_array_append (client->buffer, data, len);
     }
 
-    if (qmi_message_get_service (message) == QMI_SERVICE_CTL &&
-        qmi_message_get_message_id (message) == QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN)
-        return process_internal_proxy_open (self, client, message);
+    data = g_variant_get_fixed_array (output, &len, 1);
+    if (len > 0) {
+        GByteArray *pending;
 
-    request = g_slice_new0 (Request);
-    request->self = g_object_ref (self);
-    request->client = client_ref (client);
+        pending = g_byte_array_sized_new (len);
+        g_byte_array_append (pending, data, len);
+        g_queue_push_tail (client->output_queue, pending);
+        client->output_pending = len;
+    }
 
-    if (qmi_message_get_service (message) == QMI_SERVICE_CTL) {
-        request->in_trid = qmi_message_get_transaction_id (message);
-        qmi_message_set_transaction_id (message, 0);
+    g_variant_iter_init (&iter, cids);
+    while (g_variant_iter_next (&iter, "(yy)", &service, &cid)) {
+        QmiClientInfo cinfo;
+
+        cinfo.service = (QmiService) service;
+        cinfo.cid = cid;
+        g_array_append_val (client->qmi_client_info_array, cinfo);
     }
 
-    /* The timeout needs to be big enough for any kind of transaction to
-     * complete, otherwise the remote clients will lose the reply if they
-     * configured a timeout bigger than this internal one. We should likely
-     * make this value configurable per-client, instead of a hardcoded value.
-     *
-     * Note: the proxy will not translate vendor-specific messages in its
-     * logs (as it doesn't have the orignal message context with the vendor id).
-     */
-    qmi_device_command (client->device,
-                        message,
-                        300,
-                        NULL,
-                        (GAsyncReadyCallback)device_command_ready,
-                        request);
+    words = g_variant_get_fixed_array (filtered, &len, sizeof (guint32));
+    memcpy (client->indication_filtered_services, words,
+            MIN (len, G_N_ELEMENTS (client->indication_filtered_services)) * sizeof (guint32));
+    g_variant_iter_init (&iter, keys);
+    while (g_variant_iter_next (&iter, "u", &key)) {
+        if (!client->indication_filter)
+            client->indication_filter = g_hash_table_new (g_direct_hash, g_direct_equal);
+        g_hash_table_add (client->indication_filter, GUINT_TO_POINTER (key));
+    }
+
+    words = g_variant_get_fixed_array (monitored, &len, sizeof (guint32));
+    memcpy (client->monitored_services, words,
+            MIN (len, G_N_ELEMENTS (client->monitored_services)) * sizeof (guint32));
+    client->monitoring = monitoring;
+
+    if (path[0]) {
+        DeviceInfo *info;
+
+        info = g_hash_table_lookup (self->priv->devices, path);
+        if (!info) {
+            g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_MESSAGE,
+                         "Client using device '%s' not handed over", path);
+            client_unref (client);
+            goto out;
+        }
+        client->device = g_object_ref (info->device);
+        device_info_add_client (info, client);
+        client_set_stats_device (client);
+    }
+
+    track_client (self, client);
+    client_unref (client);
+    success = TRUE;
+
+out:
+    g_variant_unref (cids);
+    g_variant_unref (input);
+    g_variant_unref (output);
+    g_variant_unref (filtered);
+    g_variant_unref (keys);
+    g_variant_unref (monitored);
+    return success;
+}
+
+static gboolean
+receive_handoff_adopt (QmiProxy               *self,
+                       ReceiveHandoffContext  *ctx,
+                       GError                **error)
+{
+    GVariant     *child;
+    GVariantIter  iter;
+    GVariant     *client;
+    gint32        fd_index;
+    const gchar  *auth_token;
+
+    child = g_variant_get_child_value (ctx->state, 1);
+    g_variant_iter_init (&iter, child);
+    while (g_variant_iter_next (&iter, "h", &fd_index)) {
+        GSocket *socket;
+        gint     fd;
+
+        fd = receive_handoff_take_fd (ctx, fd_index, error);
+        socket = (fd >= 0 ? g_socket_new_from_fd (fd, error) : NULL);
+        if (!socket) {
+            if (fd >= 0)
+                close (fd);
+            g_variant_unref (child);
+            return FALSE;
+        }
+        if (!add_listening_socket (self, socket, error)) {
+            g_object_unref (socket);
+            g_variant_unref (child);
+            return FALSE;
+        }
+        g_object_unref (socket);
+    }
+    g_variant_unref (child);
+
+    g_variant_get_child (ctx->state, 2, "&s", &auth_token);
+    if (auth_token[0])
+        self->priv->auth_token = g_strdup (auth_token);
+
+    child = g_variant_get_child_value (ctx->state, 4);
+    g_variant_iter_init (&iter, child);
+    while ((client = g_variant_iter_next_value (&iter)) != NULL) {
+        gboolean adopted;
+
+        adopted = receive_handoff_client (self, ctx, client, error);
+        g_variant_unref (client);
+        if (!adopted) {
+            g_variant_unref (child);
+            return FALSE;
+        }
+    }
+    g_variant_unref (child);
+
     return TRUE;
 }
 
 static void
-parse_request (QmiProxy *self,
-               Client   *client)
+receive_handoff_start (QmiProxy *self)
 {
-    do {
-        GError *error = NULL;
-        QmiMessage *message;
+    GList          *clients;
+    GList          *l;
+    GHashTableIter  iter;
+    DeviceInfo     *info;
+    GPtrArray      *unused;
+    guint           i;
+
+    /* Devices without clients are kept open, or closed, as if the last
+     * client had just gone away */
+    unused = g_ptr_array_new ();
+    g_hash_table_iter_init (&iter, self->priv->devices);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&info)) {
+        __qmi_device_handoff_resume (info->device);
+        if (g_hash_table_size (info->clients) == 0)
+            g_ptr_array_add (unused, info);
+    }
+    for (i = 0; i < unused->len; i++)
+        device_info_release (self, NULL, g_ptr_array_index (unused, i));
+    g_ptr_array_unref (unused);
 
-        /* Every message received must start with the QMUX marker.
-         * If it doesn't, we broke framing :-/
-         * If we broke framing, an error should be reported and the device
-         * should get closed */
-        if (client->buffer->len > 0 &&
-            client->buffer->data[0] != QMI_MESSAGE_QMUX_MARKER) {
-            /* TODO: Report fatal error */
-            g_warning ("QMI framing error detected");
-            return;
-        }
+    g_socket_service_start (self->priv->socket_service);
 
-        message = qmi_message_new_from_raw (client->buffer, &error);
-        if (!message) {
-            if (!error)
-                /* More data we need */
-                return;
+    g_mutex_lock (&self->priv->lock);
+    clients = g_hash_table_get_keys (self->priv->clients);
+    g_list_foreach (clients, (GFunc)client_ref, NULL);
+    g_mutex_unlock (&self->priv->lock);
 
-            /* Warn about the issue */
-            g_warning ("Invalid QMI message received: '%s'",
-                       error->message);
-            g_error_free (error);
-        } else {
-            /* Play with the received message */
-            process_message (self, client, message);
-            qmi_message_unref (message);
-        }
-    } while (client->buffer->len > 0);
+    for (l = clients; l; l = g_list_next (l)) {
+        Client *client = l->data;
+
+        if (!client->connection)
+            continue;
+        client_setup_readable_source (client, self->priv->main_context);
+        if (!g_queue_is_empty (client->output_queue))
+            client_output_flush (client);
+        if (client->buffer && client->buffer->len > 0 && !client->auth_pending)
+            parse_request (self, client);
+    }
+    g_list_free_full (clients, (GDestroyNotify)client_unref);
 }
 
 static gboolean
-connection_readable_cb (GSocket *socket,
-                        GIOCondition condition,
-                        Client *client)
+receive_handoff_confirm (ReceiveHandoffContext  *ctx,
+                         GError                **error)
 {
-    QmiProxy *self;
-    guint8 buffer[BUFFER_SIZE];
-    GError *error = NULL;
-    gssize r;
+    guint8 marker;
 
-    self = client->proxy;
+    g_socket_set_timeout (ctx->socket, HANDOFF_SOCKET_TIMEOUT);
 
-    if (condition & G_IO_HUP || condition & G_IO_ERR) {
-        untrack_client (self, client);
+    marker = HANDOFF_MARKER_ADOPTED;
+    if (!handoff_send (ctx->socket, &marker, 1, NULL, NULL, error) ||
+        !handoff_receive (ctx->socket, &marker, 1, NULL, NULL, error))
         return FALSE;
-    }
-
-    if (!(condition & G_IO_IN || condition & G_IO_PRI))
-        return TRUE;
 
-    r = g_input_stream_read (g_io_stream_get_input_stream (G_IO_STREAM (client->connection)),
-                             buffer,
-                             BUFFER_SIZE,
-                             NULL,
-                             &error);
-    if (r < 0) {
-        g_warning ("Error reading from istream: %s", error ? error->message : "unknown");
-        if (error)
-            g_error_free (error);
-        untrack_client (self, client);
+    if (marker != HANDOFF_MARKER_DONE) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
+                     "Unexpected handoff reply: 0x%02x", marker);
         return FALSE;
     }
-
-    if (r == 0)
-        return TRUE;
-
-    /* else, r > 0 */
-    if (!G_UNLIKELY (client->buffer))
-        client->buffer = g_byte_array_sized_new (r);
-    g_byte_array_append (client->buffer, buffer, r);
-
-    /* Try to parse input messages */
-    parse_request (self, client);
-
     return TRUE;
 }
 
 static void
-incoming_cb (GSocketService *service,
-             GSocketConnection *connection,
-             GObject *unused,
-             QmiProxy *self)
+receive_handoff_fail (GTask  *task,
+                      GError *error)
 {
-    Client *client;
-    GCredentials *credentials;
-    GError *error = NULL;
-    uid_t uid;
+    receive_handoff_abort (g_task_get_source_object (task));
+    g_task_return_error (task, error);
+    g_object_unref (task);
+}
 
-    g_debug ("Client (%d) connection open...", g_socket_get_fd (g_socket_connection_get_socket (connection)));
+static void receive_handoff_next_device (GTask *task);
 
-    credentials = g_socket_get_credentials (g_socket_connection_get_socket (connection), &error);
-    if (!credentials) {
-        g_warning ("Client not allowed: Error getting socket credentials: %s", error->message);
-        g_error_free (error);
+static void
+receive_handoff_device_new_ready (GObject      *source,
+                                  GAsyncResult *res,
+                                  GTask        *task)
+{
+    QmiProxy              *self;
+    ReceiveHandoffContext *ctx;
+    QmiDevice             *device;
+    const gchar           *path;
+    gint32                 fd_index;
+    GVariant              *input;
+    const guint8          *data;
+    gsize                  len;
+    gint                   fd;
+    GError                *error = NULL;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    device = qmi_device_new_finish (res, &error);
+    if (!device) {
+        receive_handoff_fail (task, error);
         return;
     }
 
-    uid = g_credentials_get_unix_user (credentials, &error);
-    g_object_unref (credentials);
-    if (error) {
-        g_warning ("Client not allowed: Error getting unix user id: %s", error->message);
-        g_error_free (error);
+    g_variant_get_child (ctx->devices, ctx->device_i, "(&sh@ay)", &path, &fd_index, &input);
+    data = g_variant_get_fixed_array (input, &len, 1);
+
+    fd = receive_handoff_take_fd (ctx, fd_index, &error);
+    device_apply_settings (self, device);
+    if (fd < 0 || !__qmi_device_handoff_adopt (device, fd, data, len, &error)) {
+        if (fd >= 0)
+            close (fd);
+        g_variant_unref (input);
+        g_object_unref (device);
+        receive_handoff_fail (task, error);
         return;
     }
-    if (!__qmi_user_allowed (uid, &error)) {
-        g_warning ("Client not allowed: %s", error->message);
-        g_error_free (error);
-        return;
-    }
-
-    /* Create client */
-    client = g_slice_new0 (Client);
-    client->ref_count = 1;
-    client->proxy = self;
-    client->connection = g_object_ref (connection);
-    client->connection_readable_source = g_socket_create_source (g_socket_connection_get_socket (client->connection),
-                                                                 G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP,
-                                                                 NULL);
-    g_source_set_callback (client->connection_readable_source,
-                           (GSourceFunc)connection_readable_cb,
-                           client,
-                           NULL);
-    g_source_attach (client->connection_readable_source, g_main_context_get_thread_default ());
-    client->qmi_client_info_array = g_array_sized_new (FALSE, FALSE, sizeof (QmiClientInfo), 8);
+    g_variant_unref (input);
 
-    /* Keep the client info around */
-    track_client (self, client);
+    g_hash_table_insert (self->priv->devices, g_strdup (path), device_info_new (self, device));
+    g_object_unref (device);
 
-    client_unref (client);
+    ctx->device_i++;
+    receive_handoff_next_device (task);
 }
 
-static gboolean
-setup_socket_service (QmiProxy *self,
-                      GError **error)
+static void
+receive_handoff_next_device (GTask *task)
 {
-    GSocketAddress *socket_address;
-    GSocket *socket;
+    QmiProxy              *self;
+    ReceiveHandoffContext *ctx;
+    const gchar           *path;
+    GFile                 *file;
+    GError                *error = NULL;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    if (ctx->device_i < g_variant_n_children (ctx->devices)) {
+        g_variant_get_child (ctx->devices, ctx->device_i, "(&sh@ay)", &path, NULL, NULL);
+        g_debug ("adopting QMI device '%s'...", path);
+        file = g_file_new_for_path (path);
+        qmi_device_new (file,
+                        g_task_get_cancellable (task),
+                        (GAsyncReadyCallback) receive_handoff_device_new_ready,
+                        task);
+        g_object_unref (file);
+        return;
+    }
 
-    socket = g_socket_new (G_SOCKET_FAMILY_UNIX,
-                           G_SOCKET_TYPE_STREAM,
-                           G_SOCKET_PROTOCOL_DEFAULT,
-                           error);
-    if (!socket)
-        return FALSE;
+    /* All devices adopted; only start once the old proxy is done */
+    if (!receive_handoff_adopt (self, ctx, &error) ||
+        !receive_handoff_confirm (ctx, &error)) {
+        receive_handoff_fail (task, error);
+        return;
+    }
 
-    /* Bind to address */
-    socket_address = (g_unix_socket_address_new_with_type (
-                          QMI_PROXY_SOCKET_PATH,
-                          -1,
-                          G_UNIX_SOCKET_ADDRESS_ABSTRACT));
-    if (!g_socket_bind (socket, socket_address, TRUE, error))
-        return FALSE;
-    g_object_unref (socket_address);
+    g_debug ("handoff done: %u devices and %u clients adopted",
+             g_hash_table_size (self->priv->devices),
+             g_hash_table_size (self->priv->clients));
+    receive_handoff_start (self);
 
-    g_debug ("creating UNIX socket service...");
+    g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+}
 
-    /* Listen */
-    if (!g_socket_listen (socket, error)) {
-        g_object_unref (socket);
-        return FALSE;
-    }
+static void
+receive_handoff_state_ready (QmiProxy     *self,
+                             GAsyncResult *res,
+                             GTask        *task)
+{
+    ReceiveHandoffContext *ctx;
+    GError                *error = NULL;
 
-    /* Create socket service */
-    self->priv->socket_service = g_socket_service_new ();
-    g_signal_connect (self->priv->socket_service, "incoming", G_CALLBACK (incoming_cb), self);
-    if (!g_socket_listener_add_socket (G_SOCKET_LISTENER (self->priv->socket_service),
-                                       socket,
-                                       NULL, /* don't pass an object, will take a reference */
-                                       error)) {
-        g_prefix_error (error, "Error adding socket at '%s' to socket service: ", QMI_PROXY_SOCKET_PATH);
-        g_object_unref (socket);
-        return FALSE;
+    if (!g_task_propagate_boolean (G_TASK (res), &error)) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
     }
 
-    g_debug ("starting UNIX socket service at '%s'...", QMI_PROXY_SOCKET_PATH);
-    g_socket_service_start (self->priv->socket_service);
-    g_object_unref (socket);
-    return TRUE;
+    ctx = g_task_get_task_data (task);
+    ctx->devices = g_variant_get_child_value (ctx->state, 3);
+    receive_handoff_next_device (task);
 }
 
-/*****************************************************************************/
+gboolean
+qmi_proxy_receive_handoff_finish (QmiProxy      *self,
+                                  GAsyncResult  *res,
+                                  GError       **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
 
-QmiProxy *
-qmi_proxy_new (GError **error)
+void
+qmi_proxy_receive_handoff (QmiProxy            *self,
+                           guint                drain_timeout,
+                           GCancellable        *cancellable,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
 {
-    QmiProxy *self;
+    GTask                 *task;
+    GTask                 *thread_task;
+    ReceiveHandoffContext *ctx;
 
-    if (!__qmi_user_allowed (getuid (), error))
-        return NULL;
+    g_return_if_fail (QMI_IS_PROXY (self));
 
-    self = g_object_new (QMI_TYPE_PROXY, NULL);
-    if (!setup_socket_service (self, error))
-        g_clear_object (&self);
-    return self;
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    if (self->priv->sharded ||
+        self->priv->listening_sockets->len > 0 ||
+        g_hash_table_size (self->priv->clients) > 0) {
+        g_task_return_new_error (task, QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE,
+                                 "Handoff only supported in proxies created with qmi_proxy_new_for_handoff()");
+        g_object_unref (task);
+        return;
+    }
+
+    ctx = g_slice_new0 (ReceiveHandoffContext);
+    ctx->drain_timeout = drain_timeout;
+    ctx->fds = g_array_new (FALSE, FALSE, sizeof (gint));
+    g_task_set_task_data (task, ctx, (GDestroyNotify) receive_handoff_context_free);
+
+    /* The context is owned by the main task */
+    thread_task = g_task_new (self, cancellable, (GAsyncReadyCallback) receive_handoff_state_ready, task);
+    g_task_set_task_data (thread_task, ctx, NULL);
+    g_task_run_in_thread (thread_task, (GTaskThreadFunc) receive_handoff_thread);
+    g_object_unref (thread_task);
 }
 
 static void
@@ -822,6 +5174,63 @@ qmi_proxy_init (QmiProxy *self)
     self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
                                               QMI_TYPE_PROXY,
                                               QmiProxyPrivate);
+
+    g_mutex_init (&self->priv->lock);
+    self->priv->clients = g_hash_table_new_full (g_direct_hash, g_direct_equal, (GDestroyNotify)client_unref, NULL);
+    self->priv->devices = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)device_info_free);
+    self->priv->pending_opens = g_hash_table_new (g_str_hash, g_str_equal);
+    self->priv->shards = g_hash_table_new (g_str_hash, g_str_equal);
+    self->priv->main_context = g_main_context_ref_thread_default ();
+    self->priv->listening_sockets = g_ptr_array_new_with_free_func (g_object_unref);
+}
+
+static void
+set_property (GObject *object,
+              guint prop_id,
+              const GValue *value,
+              GParamSpec *pspec)
+{
+    QmiProxy *self = QMI_PROXY (object);
+
+    switch (prop_id) {
+    case PROP_COALESCE_REQUESTS:
+        self->priv->coalesce_requests = g_value_get_boolean (value);
+        break;
+    case PROP_RESPONSE_CACHE:
+        self->priv->response_cache = g_value_get_boolean (value);
+        break;
+    case PROP_INDICATION_CACHE:
+        self->priv->indication_cache = g_value_get_boolean (value);
+        break;
+    case PROP_TRACE_RING:
+        if (self->priv->trace_ring)
+            qmi_trace_ring_unref (self->priv->trace_ring);
+        self->priv->trace_ring = g_value_dup_boxed (value);
+        break;
+    case PROP_EPOLL:
+        self->priv->epoll = g_value_get_boolean (value);
+        break;
+    case PROP_IO_URING:
+        self->priv->io_uring = g_value_get_boolean (value);
+        break;
+    case PROP_FAIR_QUEUE_WINDOW:
+        self->priv->fair_queue_window = g_value_get_uint (value);
+        break;
+    case PROP_DEVICE_LINGER:
+        g_mutex_lock (&self->priv->lock);
+        self->priv->device_linger = g_value_get_uint (value);
+        g_mutex_unlock (&self->priv->lock);
+        break;
+    case PROP_KEEP_OPEN:
+        g_mutex_lock (&self->priv->lock);
+        g_strfreev (self->priv->keep_open);
+        self->priv->keep_open = g_value_dup_boxed (value);
+        g_mutex_unlock (&self->priv->lock);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
 }
 
 static void
@@ -834,7 +5243,41 @@ get_property (GObject *object,
 
     switch (prop_id) {
     case PROP_N_CLIENTS:
-        g_value_set_uint (value, g_list_length (self->priv->clients));
+        g_value_set_uint (value, qmi_proxy_get_n_clients (self));
+        break;
+    case PROP_COALESCE_REQUESTS:
+        g_value_set_boolean (value, self->priv->coalesce_requests);
+        break;
+    case PROP_RESPONSE_CACHE:
+        g_value_set_boolean (value, self->priv->response_cache);
+        break;
+    case PROP_INDICATION_CACHE:
+        g_value_set_boolean (value, self->priv->indication_cache);
+        break;
+    case PROP_TRACE_RING:
+        g_value_set_boxed (value, self->priv->trace_ring);
+        break;
+    case PROP_EPOLL:
+        g_value_set_boolean (value, self->priv->epoll);
+        break;
+    case PROP_IO_URING:
+        g_value_set_boolean (value, self->priv->io_uring);
+        break;
+    case PROP_FAIR_QUEUE_WINDOW:
+        g_value_set_uint (value, self->priv->fair_queue_window);
+        break;
+    case PROP_HANDED_OFF:
+        g_value_set_boolean (value, self->priv->handed_off);
+        break;
+    case PROP_DEVICE_LINGER:
+        g_mutex_lock (&self->priv->lock);
+        g_value_set_uint (value, self->priv->device_linger);
+        g_mutex_unlock (&self->priv->lock);
+        break;
+    case PROP_KEEP_OPEN:
+        g_mutex_lock (&self->priv->lock);
+        g_value_set_boxed (value, self->priv->keep_open);
+        g_mutex_unlock (&self->priv->lock);
         break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -846,10 +5289,61 @@ static void
 dispose (GObject *object)
 {
     QmiProxyPrivate *priv = QMI_PROXY (object)->priv;
+    GHashTableIter iter;
+    Shard *shard;
+    Client *client;
+    GPtrArray *threads;
+    GPtrArray *loops;
+    guint i;
 
-    if (priv->clients) {
-        g_list_free_full (priv->clients, (GDestroyNotify) client_unref);
-        priv->clients = NULL;
+    g_clear_pointer (&priv->handoff, handoff_free);
+
+    /* Stop all shards; the ones already without clients finish on their
+     * own. Shards may go away as soon as the lock is released, so keep
+     * references to what's needed to stop them. */
+    threads = g_ptr_array_new ();
+    loops = g_ptr_array_new ();
+    g_mutex_lock (&priv->lock);
+    g_hash_table_iter_init (&iter, priv->shards);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&shard)) {
+        g_atomic_pointer_set (&shard->proxy, NULL);
+        /* A shard waiting for the one finalizing the proxy can't be joined */
+        if (g_atomic_pointer_get (&shard->previous) == g_thread_self ()) {
+            shard_quit (shard->loop);
+            continue;
+        }
+        g_ptr_array_add (threads, g_thread_ref (shard->thread));
+        g_ptr_array_add (loops, g_main_loop_ref (shard->loop));
+    }
+    g_hash_table_remove_all (priv->shards);
+    g_mutex_unlock (&priv->lock);
+
+    for (i = 0; i < threads->len; i++) {
+        GThread *thread = g_ptr_array_index (threads, i);
+
+        shard_quit (g_ptr_array_index (loops, i));
+        g_main_loop_unref (g_ptr_array_index (loops, i));
+        /* The last reference to the proxy may be dropped in a shard thread */
+        if (thread == g_thread_self ())
+            g_thread_unref (thread);
+        else
+            g_thread_join (thread);
+    }
+    g_ptr_array_unref (threads);
+    g_ptr_array_unref (loops);
+
+    /* Devices are closed right away, and clients just released */
+    g_mutex_lock (&priv->lock);
+    g_hash_table_iter_init (&iter, priv->clients);
+    while (g_hash_table_iter_next (&iter, (gpointer *)&client, NULL))
+        client->device_info = NULL;
+    g_hash_table_remove_all (priv->devices);
+    g_hash_table_remove_all (priv->clients);
+    g_mutex_unlock (&priv->lock);
+
+    if (priv->epoll_core) {
+        epoll_core_free (priv->epoll_core);
+        priv->epoll_core = NULL;
     }
 
     if (priv->socket_service) {
@@ -863,6 +5357,27 @@ dispose (GObject *object)
     G_OBJECT_CLASS (qmi_proxy_parent_class)->dispose (object);
 }
 
+static void
+finalize (GObject *object)
+{
+    QmiProxyPrivate *priv = QMI_PROXY (object)->priv;
+
+    g_ptr_array_unref (priv->listening_sockets);
+    g_hash_table_unref (priv->shards);
+    g_hash_table_unref (priv->devices);
+    g_hash_table_unref (priv->pending_opens);
+    g_hash_table_unref (priv->clients);
+    g_main_context_unref (priv->main_context);
+    if (priv->trace_ring)
+        qmi_trace_ring_unref (priv->trace_ring);
+    g_strfreev (priv->keep_open);
+    g_free (priv->auth_token);
+    g_clear_object (&priv->tls_certificate);
+    g_mutex_clear (&priv->lock);
+
+    G_OBJECT_CLASS (qmi_proxy_parent_class)->finalize (object);
+}
+
 static void
 qmi_proxy_class_init (QmiProxyClass *proxy_class)
 {
@@ -871,7 +5386,9 @@ qmi_proxy_class_init (QmiProxyClass *proxy_class)
     g_type_class_add_private (object_class, sizeof (QmiProxyPrivate));
 
     object_class->get_property = get_property;
+    object_class->set_property = set_property;
     object_class->dispose = dispose;
+    object_class->finalize = finalize;
 
     /**
      * QmiProxy:qmi-proxy-n-clients
@@ -887,4 +5404,138 @@ qmi_proxy_class_init (QmiProxyClass *proxy_class)
                            0,
                            G_PARAM_READABLE);
     g_object_class_install_property (object_class, PROP_N_CLIENTS, properties[PROP_N_CLIENTS]);
+
+    /**
+     * QmiProxy:qmi-proxy-coalesce-requests
+     *
+     * Since: 1.20
+     */
+    properties[PROP_COALESCE_REQUESTS] =
+        g_param_spec_boolean (QMI_PROXY_COALESCE_REQUESTS,
+                              "Coalesce requests",
+                              "Whether identical idempotent requests from any client are coalesced",
+                              FALSE,
+                              G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_COALESCE_REQUESTS, properties[PROP_COALESCE_REQUESTS]);
+
+    /**
+     * QmiProxy:qmi-proxy-response-cache
+     *
+     * Since: 1.20
+     */
+    properties[PROP_RESPONSE_CACHE] =
+        g_param_spec_boolean (QMI_PROXY_RESPONSE_CACHE,
+                              "Response cache",
+                              "Whether responses to requests querying rarely changing information are cached",
+                              FALSE,
+                              G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_RESPONSE_CACHE, properties[PROP_RESPONSE_CACHE]);
+
+    /**
+     * QmiProxy:qmi-proxy-indication-cache
+     *
+     * Since: 1.20
+     */
+    properties[PROP_INDICATION_CACHE] =
+        g_param_spec_boolean (QMI_PROXY_INDICATION_CACHE,
+                              "Indication cache",
+                              "Whether the last indications reporting the device state are replayed to new clients",
+                              FALSE,
+                              G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_INDICATION_CACHE, properties[PROP_INDICATION_CACHE]);
+
+    /**
+     * QmiProxy:qmi-proxy-trace-ring
+     *
+     * Since: 1.20
+     */
+    properties[PROP_TRACE_RING] =
+        g_param_spec_boxed (QMI_PROXY_TRACE_RING,
+                            "Trace ring",
+                            "Ring where the traffic of all the devices open by the proxy is recorded",
+                            qmi_trace_ring_get_type (),
+                            G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_TRACE_RING, properties[PROP_TRACE_RING]);
+
+    /**
+     * QmiProxy:qmi-proxy-device-linger
+     *
+     * Since: 1.20
+     */
+    properties[PROP_DEVICE_LINGER] =
+        g_param_spec_uint (QMI_PROXY_DEVICE_LINGER,
+                           "Device linger",
+                           "Seconds devices are kept open once left without clients",
+                           0,
+                           G_MAXUINT,
+                           0,
+                           G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_DEVICE_LINGER, properties[PROP_DEVICE_LINGER]);
+
+    /**
+     * QmiProxy:qmi-proxy-keep-open
+     *
+     * Since: 1.20
+     */
+    properties[PROP_KEEP_OPEN] =
+        g_param_spec_boxed (QMI_PROXY_KEEP_OPEN,
+                            "Keep open",
+                            "Paths of the devices never closed once open",
+                            G_TYPE_STRV,
+                            G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_KEEP_OPEN, properties[PROP_KEEP_OPEN]);
+
+    /**
+     * QmiProxy:qmi-proxy-epoll
+     *
+     * Since: 1.20
+     */
+    properties[PROP_EPOLL] =
+        g_param_spec_boolean (QMI_PROXY_EPOLL,
+                              "epoll",
+                              "Whether the sockets of all the clients are multiplexed with epoll",
+                              FALSE,
+                              G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_EPOLL, properties[PROP_EPOLL]);
+
+    /**
+     * QmiProxy:qmi-proxy-io-uring
+     *
+     * Since: 1.20
+     */
+    properties[PROP_IO_URING] =
+        g_param_spec_boolean (QMI_PROXY_IO_URING,
+                              "io_uring",
+                              "Whether the clients and devices use the io_uring I/O engine",
+                              FALSE,
+                              G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_IO_URING, properties[PROP_IO_URING]);
+
+    /**
+     * QmiProxy:qmi-proxy-fair-queue-window
+     *
+     * Since: 1.20
+     */
+    properties[PROP_FAIR_QUEUE_WINDOW] =
+        g_param_spec_uint (QMI_PROXY_FAIR_QUEUE_WINDOW,
+                           "Fair queue window",
+                           "Service requests forwarded to each device at a time, with the clients taking turns",
+                           0,
+                           G_MAXUINT,
+                           0,
+                           G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_FAIR_QUEUE_WINDOW, properties[PROP_FAIR_QUEUE_WINDOW]);
+
+    /**
+     * QmiProxy:qmi-proxy-handed-off
+     *
+     * Since: 1.20
+     */
+    properties[PROP_HANDED_OFF] =
+        g_param_spec_boolean (QMI_PROXY_HANDED_OFF,
+                              "Handed off",
+                              "Whether the devices and clients were handed over to a new proxy",
+                              FALSE,
+                              G_PARAM_READABLE);
+    g_object_class_install_property (object_class, PROP_HANDED_OFF, properties[PROP_HANDED_OFF]);
 }
@@ -70,6 +70,152 @@ typedef struct _QmiProxyPrivate QmiProxyPrivate;
  */
 #define QMI_PROXY_N_CLIENTS   "qmi-proxy-n-clients"
 
+/**
+ * QMI_PROXY_COALESCE_REQUESTS:
+ *
+ * Symbol defining the #QmiProxy:qmi-proxy-coalesce-requests property.
+ *
+ * When enabled, the devices open by the proxy coalesce identical idempotent
+ * requests, even if coming from different clients, as with the
+ * #QmiDevice:device-coalesce-requests property.
+ *
+ * Since: 1.20
+ */
+#define QMI_PROXY_COALESCE_REQUESTS "qmi-proxy-coalesce-requests"
+
+/**
+ * QMI_PROXY_RESPONSE_CACHE:
+ *
+ * Symbol defining the #QmiProxy:qmi-proxy-response-cache property.
+ *
+ * When enabled, the devices open by the proxy keep the responses to requests
+ * querying rarely changing information, shared by all clients, as with the
+ * #QmiDevice:device-response-cache property.
+ *
+ * Since: 1.20
+ */
+#define QMI_PROXY_RESPONSE_CACHE "qmi-proxy-response-cache"
+
+/**
+ * QMI_PROXY_INDICATION_CACHE:
+ *
+ * Symbol defining the #QmiProxy:qmi-proxy-indication-cache property.
+ *
+ * When enabled, the devices open by the proxy keep the last indications
+ * reporting their current state, and each new QMI client allocated by any
+ * client of the proxy gets them right after the allocation response, as with
+ * the #QmiDevice:device-indication-cache property.
+ *
+ * Since: 1.20
+ */
+#define QMI_PROXY_INDICATION_CACHE "qmi-proxy-indication-cache"
+
+/**
+ * QMI_PROXY_TRACE_RING:
+ *
+ * Symbol defining the #QmiProxy:qmi-proxy-trace-ring property.
+ *
+ * When set, the raw QMI frames sent and received by all the devices open by
+ * the proxy afterwards are kept in the given #QmiTraceRing, as with
+ * qmi_device_set_trace_func(), so that whole sessions of the proxy clients
+ * can be recorded.
+ *
+ * Since: 1.20
+ */
+#define QMI_PROXY_TRACE_RING "qmi-proxy-trace-ring"
+
+/**
+ * QMI_PROXY_DEVICE_LINGER:
+ *
+ * Symbol defining the #QmiProxy:qmi-proxy-device-linger property.
+ *
+ * Number of seconds devices are kept open once the last client using them
+ * goes away, or 0 to close them right away. Clients opening the device in
+ * the meantime get it without going through the whole open sequence again.
+ *
+ * Since: 1.20
+ */
+#define QMI_PROXY_DEVICE_LINGER "qmi-proxy-device-linger"
+
+/**
+ * QMI_PROXY_KEEP_OPEN:
+ *
+ * Symbol defining the #QmiProxy:qmi-proxy-keep-open property.
+ *
+ * Array of paths of the devices that are never closed once open, until
+ * either the proxy or the device go away.
+ *
+ * Since: 1.20
+ */
+#define QMI_PROXY_KEEP_OPEN "qmi-proxy-keep-open"
+
+/**
+ * QMI_PROXY_EPOLL:
+ *
+ * Symbol defining the #QmiProxy:qmi-proxy-epoll property.
+ *
+ * When enabled, the sockets of the clients connecting afterwards are not
+ * watched each with its own #GSource; instead, all the ones handled in the
+ * same main context are multiplexed with one single epoll instance, with
+ * edge-triggered notifications. The cost of each main context iteration then
+ * depends on the clients with traffic, not on the number of clients
+ * connected. Only supported in Linux; elsewhere, clients use their own
+ * sources as usual.
+ *
+ * Since: 1.20
+ */
+#define QMI_PROXY_EPOLL "qmi-proxy-epoll"
+
+/**
+ * QMI_PROXY_IO_URING:
+ *
+ * Symbol defining the #QmiProxy:qmi-proxy-io-uring property.
+ *
+ * When enabled, the sockets of the clients connecting afterwards, and the
+ * devices opened afterwards, are read and written through one io_uring per
+ * main context (see %QMI_DEVICE_IO_URING), completed through one single
+ * source, instead of being watched for readiness. Takes precedence over
+ * %QMI_PROXY_EPOLL. Not used for the clients of a sharded proxy, and a proxy
+ * using it cannot hand over its state to a new one.
+ *
+ * Only available if the library was built with io_uring support; otherwise,
+ * or if the io_uring cannot be created or is disabled with the
+ * LIBQMI_DISABLE_IO_URING environment variable, the other engines are used
+ * as usual.
+ *
+ * Since: 1.20
+ */
+#define QMI_PROXY_IO_URING "qmi-proxy-io-uring"
+
+/**
+ * QMI_PROXY_FAIR_QUEUE_WINDOW:
+ *
+ * Symbol defining the #QmiProxy:qmi-proxy-fair-queue-window property.
+ *
+ * Maximum number of service requests forwarded to each device opened
+ * afterwards at a time, or 0 to forward them right away. Requests beyond the
+ * window wait in the proxy, in a queue per client, and the clients with
+ * requests waiting take turns, one request each, as slots become free; so
+ * a client issuing requests in bulk doesn't delay the requests of others by
+ * more than one request per turn. CTL requests are never queued.
+ *
+ * Since: 1.20
+ */
+#define QMI_PROXY_FAIR_QUEUE_WINDOW "qmi-proxy-fair-queue-window"
+
+/**
+ * QMI_PROXY_HANDED_OFF:
+ *
+ * Symbol defining the #QmiProxy:qmi-proxy-handed-off property.
+ *
+ * Set once the proxy handed over all its devices and clients to a new proxy,
+ * as requested with qmi_proxy_receive_handoff(); the proxy no longer does
+ * anything from then on, and should just be disposed.
+ *
+ * Since: 1.20
+ */
+#define QMI_PROXY_HANDED_OFF "qmi-proxy-handed-off"
+
 /**
  * QmiProxy:
  *
@@ -93,7 +239,7 @@ GType qmi_proxy_get_type (void);
  * qmi_proxy_new:
  * @error: Return location for error or %NULL.
  *
- * Creates a #QmiProxy listening in the default proxy addess.
+ * Creates a #QmiProxy listening in the default proxy address.
  *
  * Returns: A newly created #QmiProxy, or #NULL if @error is set.
  *
@@ -101,6 +247,167 @@ GType qmi_proxy_get_type (void);
  */
 QmiProxy *qmi_proxy_new (GError **error);
 
+/**
+ * qmi_proxy_new_sharded:
+ * @error: Return location for error or %NULL.
+ *
+ * Creates a #QmiProxy listening in the default proxy address, which handles
+ * each QMI device, together with all the clients connected to it, in its own
+ * thread and main context.
+ *
+ * New clients are accepted in the thread-default main context of the caller,
+ * and moved to the thread of the device they request to open.
+ *
+ * Returns: A newly created #QmiProxy, or #NULL if @error is set.
+ *
+ * Since: 1.20
+ */
+QmiProxy *qmi_proxy_new_sharded (GError **error);
+
+/**
+ * qmi_proxy_new_with_socket:
+ * @listening_socket: a #GSocket, bound and listening.
+ * @sharded: whether each device is handled in its own thread, as with qmi_proxy_new_sharded().
+ * @error: Return location for error or %NULL.
+ *
+ * Creates a #QmiProxy accepting clients in an already listening UNIX socket,
+ * e.g. one inherited from the process that spawned the proxy, or passed by
+ * systemd with socket activation.
+ *
+ * Clients that connected to @listening_socket before the proxy was created
+ * are accepted right away.
+ *
+ * Returns: A newly created #QmiProxy, or #NULL if @error is set.
+ *
+ * Since: 1.20
+ */
+QmiProxy *qmi_proxy_new_with_socket (GSocket   *listening_socket,
+                                     gboolean   sharded,
+                                     GError   **error);
+
+/**
+ * qmi_proxy_new_for_handoff:
+ * @error: Return location for error or %NULL.
+ *
+ * Creates a #QmiProxy to take over the devices and clients of the proxy
+ * currently running, with qmi_proxy_receive_handoff(). The proxy doesn't
+ * listen anywhere until then.
+ *
+ * Returns: A newly created #QmiProxy, or #NULL if @error is set.
+ *
+ * Since: 1.20
+ */
+QmiProxy *qmi_proxy_new_for_handoff (GError **error);
+
+/**
+ * qmi_proxy_receive_handoff:
+ * @self: a #QmiProxy created with qmi_proxy_new_for_handoff().
+ * @drain_timeout: maximum number of seconds the running proxy waits for the requests in flight to complete.
+ * @cancellable: a #GCancellable or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously takes over the proxy running in the default proxy address,
+ * e.g. to upgrade it without closing any device nor disconnecting any client.
+ *
+ * The running proxy stops accepting clients and processing new requests, and
+ * waits up to @drain_timeout seconds for the requests in flight to complete.
+ * It then passes its listening sockets, the file descriptors of its open
+ * devices and of its clients, and the state of each client, including the
+ * allocated CIDs and the data not yet processed or sent, to @self, which goes
+ * on from there without opening anything again. Responses to the requests
+ * still in flight once @drain_timeout expires are lost, and clients waiting
+ * for a device being open are disconnected.
+ *
+ * If either proxy fails or goes away before the handoff is complete, the
+ * running proxy just goes on as before. Otherwise, it reports it through the
+ * #QmiProxy:qmi-proxy-handed-off property.
+ *
+ * Only proxies not sharded, running as the same user, may be taken over. Any
+ * setting of the running proxy must be set in @self as well beforehand.
+ *
+ * When the operation is finished, @callback will be invoked. You can then call
+ * qmi_proxy_receive_handoff_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_proxy_receive_handoff (QmiProxy            *self,
+                                guint                drain_timeout,
+                                GCancellable        *cancellable,
+                                GAsyncReadyCallback  callback,
+                                gpointer             user_data);
+
+/**
+ * qmi_proxy_receive_handoff_finish:
+ * @self: a #QmiProxy.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_proxy_receive_handoff().
+ *
+ * Returns: %TRUE if the devices and clients of the running proxy were taken over, %FALSE if @error is set.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_proxy_receive_handoff_finish (QmiProxy      *self,
+                                           GAsyncResult  *res,
+                                           GError       **error);
+
+/**
+ * qmi_proxy_set_tls_certificate:
+ * @self: a #QmiProxy.
+ * @certificate: a #GTlsCertificate, with its private key.
+ *
+ * Makes the proxy present @certificate to remote clients, and all the
+ * connections accepted by its TCP listeners go through TLS from then on, as
+ * expected by devices with a tls:// proxy path.
+ *
+ * Must be called before adding any TCP listener.
+ *
+ * Since: 1.20
+ */
+void qmi_proxy_set_tls_certificate (QmiProxy        *self,
+                                    GTlsCertificate *certificate);
+
+/**
+ * qmi_proxy_add_tcp_listener:
+ * @self: a #QmiProxy.
+ * @address: (nullable): the IP address to listen in, or %NULL to listen only in the IPv4 loopback interface.
+ * @port: the TCP port to listen in, or 0 to let the system choose one.
+ * @auth_token: the token remote clients must authenticate with.
+ * @bound_port: (out) (optional): return location for the port actually used, or %NULL.
+ * @error: Return location for error or %NULL.
+ *
+ * Makes the proxy accept remote clients over TCP as well, so that devices can
+ * be used from other hosts or containers, as with the
+ * #QmiDevice:device-proxy-path property set to a tcp:// or tls:// address.
+ *
+ * Remote clients don't go through the UNIX user checks of local clients;
+ * instead, they must send "QMI-PROXY-AUTH <token>" and a newline right after
+ * connecting, before any QMI message, or they are disconnected. All the TCP
+ * listeners of the proxy share the same token.
+ *
+ * Whoever knows the token has the same full control of the devices as a local
+ * client allowed by the proxy. Without TLS, both the token and the QMI
+ * traffic (e.g. PIN codes or SMS contents) can be read and modified by anyone
+ * able to see the connection, so only loopback addresses are allowed unless a
+ * certificate was given with qmi_proxy_set_tls_certificate(). Even on
+ * loopback, every local user and container sharing the network namespace can
+ * connect, so the token should be kept where only the intended users can read
+ * it. TLS only authenticates the proxy to the clients; the clients are still
+ * authenticated by the token alone, and failed attempts are not rate limited.
+ *
+ * Returns: %TRUE if the listener was added, %FALSE if @error is set.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_proxy_add_tcp_listener (QmiProxy     *self,
+                                     const gchar  *address,
+                                     guint16       port,
+                                     const gchar  *auth_token,
+                                     guint16      *bound_port,
+                                     GError      **error);
+
 /**
  * qmi_proxy_get_n_clients:
  * @self: a #QmiProxy.
@@ -113,4 +420,118 @@ QmiProxy *qmi_proxy_new (GError **error);
  */
 guint qmi_proxy_get_n_clients (QmiProxy *self);
 
+/**
+ * QmiProxyClientStats:
+ * @device_path: path of the device used by the client, or %NULL if not open yet.
+ * @n_requests: number of requests forwarded from the client to the device.
+ * @n_responses: number of responses forwarded from the device to the client.
+ * @n_timeouts: number of requests that timed out in the device.
+ * @n_aborts: number of requests aborted by the client, or because it went away.
+ * @n_indications: number of indications forwarded to the client.
+ * @n_pending_requests: number of requests currently waiting for a response.
+ * @bytes_received: number of bytes received from the client.
+ * @bytes_sent: number of bytes sent to the client.
+ * @latency_max: maximum response latency, in microseconds.
+ * @latency_total: sum of all response latencies, in microseconds.
+ * @pid: process ID of the client, or 0 if unknown.
+ * @n_queued_requests: number of requests currently waiting for room in the window set with #QmiProxy:qmi-proxy-fair-queue-window.
+ * @latency_p99: 99th percentile of the most recent response latencies, in microseconds.
+ *
+ * Traffic statistics of a client of the #QmiProxy. Latencies are measured
+ * from the moment the request is received from the client until the response
+ * is forwarded to it, so they include any time the request waits in the
+ * device queues.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    gchar   *device_path;
+    guint64  n_requests;
+    guint64  n_responses;
+    guint64  n_timeouts;
+    guint64  n_aborts;
+    guint64  n_indications;
+    guint    n_pending_requests;
+    guint64  bytes_received;
+    guint64  bytes_sent;
+    guint64  latency_max;
+    guint64  latency_total;
+    guint32  pid;
+    guint    n_queued_requests;
+    guint64  latency_p99;
+} QmiProxyClientStats;
+
+/**
+ * qmi_proxy_get_client_stats:
+ * @self: a #QmiProxy.
+ *
+ * Get the traffic statistics of each client currently connected to the proxy.
+ *
+ * This method may be called from any thread.
+ *
+ * Returns: (transfer full) (element-type QmiProxyClientStats): a #GArray of #QmiProxyClientStats elements. The returned value should be freed with g_array_unref().
+ *
+ * Since: 1.20
+ */
+GArray *qmi_proxy_get_client_stats (QmiProxy *self);
+
+/**
+ * QmiProxyDeviceStats:
+ * @device_path: path of the device.
+ * @n_clients: number of clients using the device.
+ * @n_requests: number of requests sent to the device.
+ * @n_responses: number of responses received from the device.
+ * @n_timeouts: number of requests that timed out in the device.
+ * @n_aborts: number of requests aborted in the device.
+ * @n_indications: number of indications received from the device.
+ * @n_coalesced: number of requests answered with the response of an identical one, see #QmiProxy:qmi-proxy-coalesce-requests.
+ * @n_cached: number of requests answered from the response cache, see #QmiProxy:qmi-proxy-response-cache.
+ * @bytes_sent: number of bytes sent to the device.
+ * @bytes_received: number of bytes received from the device.
+ * @n_in_flight: number of requests currently waiting for a response.
+ * @output_queue_length: number of messages currently waiting to be written.
+ * @throttled_queue_length: number of requests currently waiting for an in-flight slot.
+ * @latency_mean: mean forwarding latency of the clients using the device, in microseconds.
+ * @latency_p99: 99th percentile of the most recent forwarding latencies of the clients using the device, in microseconds.
+ *
+ * Traffic statistics of a device used by the clients of the #QmiProxy, as
+ * reported by qmi_device_get_stats(). Forwarding latencies are measured as
+ * in #QmiProxyClientStats.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    gchar   *device_path;
+    guint    n_clients;
+    guint64  n_requests;
+    guint64  n_responses;
+    guint64  n_timeouts;
+    guint64  n_aborts;
+    guint64  n_indications;
+    guint64  n_coalesced;
+    guint64  n_cached;
+    guint64  bytes_sent;
+    guint64  bytes_received;
+    guint    n_in_flight;
+    guint    output_queue_length;
+    guint    throttled_queue_length;
+    guint64  latency_mean;
+    guint64  latency_p99;
+} QmiProxyDeviceStats;
+
+/**
+ * qmi_proxy_get_device_stats:
+ * @self: a #QmiProxy.
+ *
+ * Get the traffic statistics of each device currently used by the clients
+ * connected to the proxy.
+ *
+ * This method may be called from any thread.
+ *
+ * Returns: (transfer full) (element-type QmiProxyDeviceStats): a #GArray of #QmiProxyDeviceStats elements. The returned value should be freed with g_array_unref().
+ *
+ * Since: 1.20
+ */
+GArray *qmi_proxy_get_device_stats (QmiProxy *self);
+
 #endif /* QMI_PROXY_H */
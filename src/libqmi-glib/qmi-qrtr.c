@@ -0,0 +1,925 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <gio/gio.h>
+
+#include "qmi-qrtr.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+#include "qmi-enum-types.h"
+
+#if defined HAVE_LINUX_QRTR_H
+
+#include <sys/socket.h>
+#include <linux/qrtr.h>
+#include <glib-unix.h>
+
+#ifndef AF_QIPCRTR
+#define AF_QIPCRTR 42
+#endif
+
+#define QRTR_URI_PREFIX QMI_QRTR_URI_SCHEME "://"
+
+#define QMUX_HEADER_SIZE  6
+#define QMUX_FLAG_SERVICE 0x80
+
+/* Max size of a received message, so that the length in the QMUX header
+ * prepended to it doesn't overflow */
+#define QRTR_MAX_MESSAGE_SIZE (G_MAXUINT16 + 1 - QMUX_HEADER_SIZE)
+
+#define QRTR_CTL_MESSAGE_GET_VERSION_INFO 0x0021
+#define QRTR_CTL_MESSAGE_ALLOCATE_CID     0x0022
+#define QRTR_CTL_MESSAGE_RELEASE_CID      0x0023
+#define QRTR_CTL_MESSAGE_SYNC             0x0027
+
+#define QRTR_CLIENT_KEY(service, cid) \
+    GUINT_TO_POINTER (((guint)(service) << 8) | (guint)(cid))
+
+/* Server of a QMI service published in the QRTR node */
+typedef struct {
+    gboolean present;
+    guint32  port;
+    guint8   version;
+} QrtrServer;
+
+/* Client of a QMI service, each one with its own QRTR socket */
+typedef struct {
+    QmiQrtrNode *node;
+    guint8       service;
+    guint8       cid;
+    gint         fd;
+    GSource     *input_source;
+    GSource     *output_source;
+    GQueue       output_queue;
+} QrtrClient;
+
+struct _QmiQrtrNode {
+    guint32               node;
+    gchar                *path_display;
+    GMainContext         *context;
+    QmiQrtrNodeCallbacks  callbacks;
+    gpointer              user_data;
+
+    /* Control socket tracking the servers of the node */
+    gint                  ctrl_fd;
+    GSource              *ctrl_source;
+
+    /* Ongoing open operation */
+    QmiQrtrNodeOpenFn     open_callback;
+    gpointer              open_user_data;
+    GSource              *open_timeout_source;
+
+    /* Servers indexed by service; clients indexed by service and CID, only
+     * once open */
+    QrtrServer            servers[G_MAXUINT8 + 1];
+    GHashTable           *clients;
+
+    /* CTL responses built locally, processed in an idle */
+    GQueue                ctl_responses;
+    GSource              *ctl_source;
+};
+
+/*****************************************************************************/
+/* Sockets */
+
+static gint
+qrtr_socket_new_default (void)
+{
+    return socket (AF_QIPCRTR, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+}
+
+static gint
+qrtr_getsockname_default (gint     fd,
+                          guint32 *node,
+                          guint32 *port)
+{
+    struct sockaddr_qrtr sq;
+    socklen_t            sq_len = sizeof (sq);
+
+    if (getsockname (fd, (struct sockaddr *) &sq, &sq_len) < 0)
+        return -1;
+
+    *node = sq.sq_node;
+    *port = sq.sq_port;
+    return 0;
+}
+
+static gssize
+qrtr_sendto_default (gint          fd,
+                     const guint8 *data,
+                     gsize         len,
+                     guint32       node,
+                     guint32       port)
+{
+    struct sockaddr_qrtr sq;
+
+    memset (&sq, 0, sizeof (sq));
+    sq.sq_family = AF_QIPCRTR;
+    sq.sq_node = node;
+    sq.sq_port = port;
+    return sendto (fd, data, len, 0, (struct sockaddr *) &sq, sizeof (sq));
+}
+
+static gssize
+qrtr_recvfrom_default (gint     fd,
+                       guint8  *data,
+                       gsize    len,
+                       guint32 *node,
+                       guint32 *port)
+{
+    struct sockaddr_qrtr sq;
+    socklen_t            sq_len = sizeof (sq);
+    gssize               r;
+
+    memset (&sq, 0, sizeof (sq));
+    r = recvfrom (fd, data, len, 0, (struct sockaddr *) &sq, &sq_len);
+    if (r >= 0) {
+        *node = sq.sq_node;
+        *port = sq.sq_port;
+    }
+    return r;
+}
+
+static const QmiQrtrSocketOps default_socket_ops = {
+    .socket_new  = qrtr_socket_new_default,
+    .getsockname = qrtr_getsockname_default,
+    .sendto      = qrtr_sendto_default,
+    .recvfrom    = qrtr_recvfrom_default,
+};
+
+static const QmiQrtrSocketOps *socket_ops = &default_socket_ops;
+
+void
+__qmi_qrtr_set_socket_ops (const QmiQrtrSocketOps *ops)
+{
+    socket_ops = (ops ? ops : &default_socket_ops);
+}
+
+static gint
+qrtr_socket_new (GError **error)
+{
+    gint fd;
+
+    fd = socket_ops->socket_new ();
+    if (fd < 0) {
+        gint saved_errno = errno;
+
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_FAILED,
+                     "Cannot create QRTR socket: %s",
+                     g_strerror (saved_errno));
+    }
+    return fd;
+}
+
+/*****************************************************************************/
+
+gboolean
+__qmi_qrtr_parse_uri (const gchar *uri,
+                      guint32     *node)
+{
+    const gchar *str;
+    gchar       *end = NULL;
+    guint64      value;
+
+    if (g_ascii_strncasecmp (uri, QRTR_URI_PREFIX, strlen (QRTR_URI_PREFIX)) != 0)
+        return FALSE;
+
+    str = uri + strlen (QRTR_URI_PREFIX);
+    if (!g_ascii_isdigit (*str))
+        return FALSE;
+
+    value = g_ascii_strtoull (str, &end, 10);
+    if (value > G_MAXUINT32 || (*end && g_strcmp0 (end, "/") != 0))
+        return FALSE;
+
+    *node = (guint32) value;
+    return TRUE;
+}
+
+guint
+__qmi_qrtr_node_get_n_servers (QmiQrtrNode *node)
+{
+    guint n = 0;
+    guint i;
+
+    for (i = 0; i <= G_MAXUINT8; i++) {
+        if (node->servers[i].present)
+            n++;
+    }
+    return n;
+}
+
+gboolean
+__qmi_qrtr_node_is_open (QmiQrtrNode *node)
+{
+    return !!node->clients;
+}
+
+/*****************************************************************************/
+/* Clients */
+
+static void
+qrtr_client_free (QrtrClient *client)
+{
+    if (client->input_source) {
+        g_source_destroy (client->input_source);
+        g_source_unref (client->input_source);
+    }
+    if (client->output_source) {
+        g_source_destroy (client->output_source);
+        g_source_unref (client->output_source);
+    }
+    while (!g_queue_is_empty (&client->output_queue))
+        qmi_message_unref (g_queue_pop_head (&client->output_queue));
+
+    /* The server gets notified about the client being gone */
+    close (client->fd);
+    g_slice_free (QrtrClient, client);
+}
+
+static gboolean qrtr_client_output_cb (gint          fd,
+                                       GIOCondition  condition,
+                                       QrtrClient   *client);
+
+static void
+qrtr_client_flush (QrtrClient *client)
+{
+    QmiQrtrNode *node;
+    QmiMessage  *message;
+
+    node = client->node;
+
+    while ((message = g_queue_peek_head (&client->output_queue)) != NULL) {
+        const QrtrServer *server;
+        const guint8     *raw;
+        gsize             raw_len = 0;
+        GError           *error = NULL;
+
+        server = &node->servers[client->service];
+        if (!server->present) {
+            error = g_error_new (QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_WRONG_STATE,
+                                 "Service '%s' gone from QRTR node %u",
+                                 qmi_service_get_string (client->service),
+                                 node->node);
+        } else {
+            /* Already validated when the request was issued */
+            raw = qmi_message_get_raw (message, &raw_len, NULL);
+            g_assert (raw && raw_len > QMUX_HEADER_SIZE);
+
+            if (socket_ops->sendto (client->fd,
+                                    &raw[QMUX_HEADER_SIZE],
+                                    raw_len - QMUX_HEADER_SIZE,
+                                    node->node,
+                                    server->port) < 0) {
+                gint saved_errno = errno;
+
+                if (saved_errno == EINTR)
+                    continue;
+
+                /* Flow controlled by the server, retried once allowed */
+                if (saved_errno == EAGAIN || saved_errno == EWOULDBLOCK) {
+                    if (!client->output_source) {
+                        client->output_source = g_unix_fd_source_new (client->fd, G_IO_OUT);
+                        g_source_set_callback (client->output_source,
+                                               (GSourceFunc) qrtr_client_output_cb,
+                                               client,
+                                               NULL);
+                        g_source_attach (client->output_source, node->context);
+                    }
+                    return;
+                }
+
+                error = g_error_new (QMI_CORE_ERROR,
+                                     QMI_CORE_ERROR_FAILED,
+                                     "Cannot send QRTR message: %s",
+                                     g_strerror (saved_errno));
+            }
+        }
+
+        g_queue_pop_head (&client->output_queue);
+        if (error) {
+            node->callbacks.send_error (message, error, node->user_data);
+            g_error_free (error);
+        }
+        qmi_message_unref (message);
+    }
+}
+
+static gboolean
+qrtr_client_output_cb (gint          fd,
+                       GIOCondition  condition,
+                       QrtrClient   *client)
+{
+    g_clear_pointer (&client->output_source, g_source_unref);
+    qrtr_client_flush (client);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+qrtr_client_input_cb (gint          fd,
+                      GIOCondition  condition,
+                      QrtrClient   *client)
+{
+    QmiQrtrNode *node;
+    GByteArray  *buffer;
+    gboolean     received = FALSE;
+    gboolean     broken = FALSE;
+
+    node = client->node;
+    buffer = node->callbacks.get_buffer (node->user_data);
+
+    /* Each message is read right after room for its QMUX header, which is
+     * filled in once the size is known */
+    while (TRUE) {
+        const QrtrServer *server;
+        guint32           from_node = 0;
+        guint32           from_port = 0;
+        guint8           *header;
+        guint             len;
+        gssize            r;
+
+        len = buffer->len;
+        g_byte_array_set_size (buffer, len + QMUX_HEADER_SIZE + QRTR_MAX_MESSAGE_SIZE);
+        r = socket_ops->recvfrom (fd,
+                                  &buffer->data[len + QMUX_HEADER_SIZE],
+                                  QRTR_MAX_MESSAGE_SIZE,
+                                  &from_node,
+                                  &from_port);
+        if (r < 0) {
+            gint saved_errno = errno;
+
+            g_byte_array_set_size (buffer, len);
+            if (saved_errno == EINTR)
+                continue;
+            if (saved_errno != EAGAIN && saved_errno != EWOULDBLOCK) {
+                g_warning ("[%s] Cannot read from QRTR socket of '%s' client %u: %s",
+                           node->path_display,
+                           qmi_service_get_string (client->service),
+                           client->cid,
+                           g_strerror (saved_errno));
+                broken = TRUE;
+            }
+            break;
+        }
+
+        /* Only messages from the server itself, not control ones */
+        server = &node->servers[client->service];
+        if (r == 0 || !server->present || from_node != node->node || from_port != server->port) {
+            g_byte_array_set_size (buffer, len);
+            continue;
+        }
+
+        header = &buffer->data[len];
+        header[0] = QMI_MESSAGE_QMUX_MARKER;
+        header[1] = (guint8) ((r + QMUX_HEADER_SIZE - 1) & 0xFF);
+        header[2] = (guint8) (((r + QMUX_HEADER_SIZE - 1) >> 8) & 0xFF);
+        header[3] = QMUX_FLAG_SERVICE;
+        header[4] = client->service;
+        header[5] = client->cid;
+        g_byte_array_set_size (buffer, len + QMUX_HEADER_SIZE + r);
+        received = TRUE;
+    }
+
+    if (broken)
+        g_clear_pointer (&client->input_source, g_source_unref);
+
+    /* The client may be released while processing the messages, so nothing
+     * else is done afterwards */
+    if (received)
+        node->callbacks.input (node->user_data);
+
+    return (broken ? G_SOURCE_REMOVE : G_SOURCE_CONTINUE);
+}
+
+static QrtrClient *
+qrtr_client_new (QmiQrtrNode  *node,
+                 guint8        service,
+                 guint8        cid,
+                 GError      **error)
+{
+    QrtrClient *client;
+    gint        fd;
+
+    fd = qrtr_socket_new (error);
+    if (fd < 0)
+        return NULL;
+
+    client = g_slice_new0 (QrtrClient);
+    client->node = node;
+    client->service = service;
+    client->cid = cid;
+    client->fd = fd;
+    g_queue_init (&client->output_queue);
+
+    client->input_source = g_unix_fd_source_new (fd, G_IO_IN);
+    g_source_set_callback (client->input_source,
+                           (GSourceFunc) qrtr_client_input_cb,
+                           client,
+                           NULL);
+    g_source_attach (client->input_source, node->context);
+
+    g_hash_table_insert (node->clients, QRTR_CLIENT_KEY (service, cid), client);
+    g_debug ("[%s] QRTR socket created for '%s' client %u",
+             node->path_display,
+             qmi_service_get_string (service),
+             cid);
+    return client;
+}
+
+/*****************************************************************************/
+/* CTL emulation */
+
+static QmiMessage *
+qrtr_ctl_response_new (QmiQrtrNode *node,
+                       QmiMessage  *request)
+{
+    QmiMessage *response;
+    gsize       tlv_offset = 0;
+    gsize       offset = 0;
+    guint8      service = 0;
+    guint8      cid = 0;
+    gboolean    success;
+
+    switch (qmi_message_get_message_id (request)) {
+    case QRTR_CTL_MESSAGE_GET_VERSION_INFO: {
+        guint n_services;
+        guint i;
+
+        /* CTL itself too, within the max number of items in the list */
+        n_services = MIN (__qmi_qrtr_node_get_n_servers (node), G_MAXUINT8 - 1);
+
+        response = qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+        success = ((tlv_offset = qmi_message_tlv_write_init (response, 0x01, NULL)) > 0 &&
+                   qmi_message_tlv_write_guint8 (response, (guint8) (n_services + 1), NULL) &&
+                   qmi_message_tlv_write_guint8 (response, QMI_SERVICE_CTL, NULL) &&
+                   qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, 1, NULL) &&
+                   qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, 0, NULL));
+        for (i = 1; success && i <= G_MAXUINT8 && n_services > 0; i++) {
+            if (!node->servers[i].present)
+                continue;
+            /* Only the major version is published */
+            success = (qmi_message_tlv_write_guint8 (response, (guint8) i, NULL) &&
+                       qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, node->servers[i].version, NULL) &&
+                       qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, 0, NULL));
+            n_services--;
+        }
+        if (success)
+            success = qmi_message_tlv_write_complete (response, tlv_offset, NULL);
+        break;
+    }
+
+    case QRTR_CTL_MESSAGE_ALLOCATE_CID: {
+        GError *error = NULL;
+        guint   i;
+
+        tlv_offset = qmi_message_tlv_read_init (request, 0x01, NULL, NULL);
+        if (!tlv_offset || !qmi_message_tlv_read_guint8 (request, tlv_offset, &offset, &service, NULL))
+            return qmi_message_response_new (request, QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE);
+
+        if (service == QMI_SERVICE_CTL || !node->servers[service].present)
+            return qmi_message_response_new (request, QMI_PROTOCOL_ERROR_INVALID_SERVICE_TYPE);
+
+        /* Lowest CID not in use, the broadcast one excluded */
+        for (i = 1; i < G_MAXUINT8; i++) {
+            if (!g_hash_table_lookup (node->clients, QRTR_CLIENT_KEY (service, i)))
+                break;
+        }
+        if (i == G_MAXUINT8)
+            return qmi_message_response_new (request, QMI_PROTOCOL_ERROR_CLIENT_IDS_EXHAUSTED);
+        cid = (guint8) i;
+
+        if (!qrtr_client_new (node, service, cid, &error)) {
+            g_warning ("[%s] %s", node->path_display, error->message);
+            g_error_free (error);
+            return qmi_message_response_new (request, QMI_PROTOCOL_ERROR_INTERNAL);
+        }
+
+        response = qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+        success = ((tlv_offset = qmi_message_tlv_write_init (response, 0x01, NULL)) > 0 &&
+                   qmi_message_tlv_write_guint8 (response, service, NULL) &&
+                   qmi_message_tlv_write_guint8 (response, cid, NULL) &&
+                   qmi_message_tlv_write_complete (response, tlv_offset, NULL));
+        break;
+    }
+
+    case QRTR_CTL_MESSAGE_RELEASE_CID:
+        tlv_offset = qmi_message_tlv_read_init (request, 0x01, NULL, NULL);
+        if (!tlv_offset ||
+            !qmi_message_tlv_read_guint8 (request, tlv_offset, &offset, &service, NULL) ||
+            !qmi_message_tlv_read_guint8 (request, tlv_offset, &offset, &cid, NULL))
+            return qmi_message_response_new (request, QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE);
+
+        /* Closing the socket releases the client in the server */
+        if (!g_hash_table_remove (node->clients, QRTR_CLIENT_KEY (service, cid)))
+            return qmi_message_response_new (request, QMI_PROTOCOL_ERROR_INVALID_CLIENT_ID);
+
+        response = qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+        success = ((tlv_offset = qmi_message_tlv_write_init (response, 0x01, NULL)) > 0 &&
+                   qmi_message_tlv_write_guint8 (response, service, NULL) &&
+                   qmi_message_tlv_write_guint8 (response, cid, NULL) &&
+                   qmi_message_tlv_write_complete (response, tlv_offset, NULL));
+        break;
+
+    case QRTR_CTL_MESSAGE_SYNC:
+        /* All clients released, as the modem would do */
+        g_hash_table_remove_all (node->clients);
+        return qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+
+    default:
+        return qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NOT_SUPPORTED);
+    }
+
+    if (!success) {
+        qmi_message_unref (response);
+        return qmi_message_response_new (request, QMI_PROTOCOL_ERROR_INTERNAL);
+    }
+    return response;
+}
+
+/* Responses are processed as if read from the device */
+static gboolean
+qrtr_ctl_responses_cb (QmiQrtrNode *node)
+{
+    GByteArray *buffer;
+    QmiMessage *response;
+
+    g_clear_pointer (&node->ctl_source, g_source_unref);
+
+    buffer = node->callbacks.get_buffer (node->user_data);
+    while ((response = g_queue_pop_head (&node->ctl_responses)) != NULL) {
+        const guint8 *raw;
+        gsize         raw_len = 0;
+
+        raw = qmi_message_get_raw (response, &raw_len, NULL);
+        if (raw)
+            g_byte_array_append (buffer, raw, raw_len);
+        qmi_message_unref (response);
+    }
+
+    node->callbacks.input (node->user_data);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+qrtr_ctl_command (QmiQrtrNode *node,
+                  QmiMessage  *request)
+{
+    g_queue_push_tail (&node->ctl_responses, qrtr_ctl_response_new (node, request));
+
+    if (node->ctl_source)
+        return;
+
+    node->ctl_source = g_idle_source_new ();
+    g_source_set_callback (node->ctl_source, (GSourceFunc) qrtr_ctl_responses_cb, node, NULL);
+    g_source_attach (node->ctl_source, node->context);
+}
+
+/*****************************************************************************/
+
+gboolean
+__qmi_qrtr_node_send (QmiQrtrNode  *node,
+                      QmiMessage   *message,
+                      GError      **error)
+{
+    QrtrClient *client;
+    guint8      service;
+    guint8      cid;
+
+    g_assert (node->clients);
+
+    service = (guint8) qmi_message_get_service (message);
+    if (service == QMI_SERVICE_CTL) {
+        qrtr_ctl_command (node, message);
+        return TRUE;
+    }
+
+    if (!node->servers[service].present) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_UNSUPPORTED,
+                     "Service '%s' not available in QRTR node %u",
+                     qmi_service_get_string (service),
+                     node->node);
+        return FALSE;
+    }
+
+    /* CIDs not allocated through CTL (e.g. reused from a previous run) get
+     * their socket right away, as a new client of the server */
+    cid = qmi_message_get_client_id (message);
+    client = g_hash_table_lookup (node->clients, QRTR_CLIENT_KEY (service, cid));
+    if (!client) {
+        client = qrtr_client_new (node, service, cid, error);
+        if (!client)
+            return FALSE;
+    }
+
+    g_queue_push_tail (&client->output_queue, qmi_message_ref (message));
+    if (!client->output_source)
+        qrtr_client_flush (client);
+    return TRUE;
+}
+
+/*****************************************************************************/
+/* Open */
+
+static void
+qrtr_open_complete (QmiQrtrNode *node,
+                    GError      *error)
+{
+    QmiQrtrNodeOpenFn callback;
+
+    if (node->open_timeout_source) {
+        g_source_destroy (node->open_timeout_source);
+        g_clear_pointer (&node->open_timeout_source, g_source_unref);
+    }
+
+    /* Ready to send messages from now on */
+    if (!error)
+        node->clients = g_hash_table_new_full (g_direct_hash,
+                                               g_direct_equal,
+                                               NULL,
+                                               (GDestroyNotify) qrtr_client_free);
+
+    callback = node->open_callback;
+    node->open_callback = NULL;
+    callback (node, error, node->open_user_data);
+}
+
+static gboolean
+qrtr_open_timeout_cb (QmiQrtrNode *node)
+{
+    qrtr_open_complete (node,
+                        g_error_new (QMI_CORE_ERROR,
+                                     QMI_CORE_ERROR_TIMEOUT,
+                                     "Timed out looking up QRTR servers in node %u",
+                                     node->node));
+    return G_SOURCE_REMOVE;
+}
+
+/* Returns TRUE if the last server of the node is gone */
+static gboolean
+qrtr_ctrl_process (QmiQrtrNode                *node,
+                   const struct qrtr_ctrl_pkt *pkt)
+{
+    QrtrServer *server;
+    guint32     cmd;
+    guint32     service;
+    guint32     instance;
+    guint32     server_node;
+    guint32     port;
+
+    cmd = GUINT32_FROM_LE (pkt->cmd);
+    if (cmd != QRTR_TYPE_NEW_SERVER && cmd != QRTR_TYPE_DEL_SERVER)
+        return FALSE;
+
+    service     = GUINT32_FROM_LE (pkt->server.service);
+    instance    = GUINT32_FROM_LE (pkt->server.instance);
+    server_node = GUINT32_FROM_LE (pkt->server.node);
+    port        = GUINT32_FROM_LE (pkt->server.port);
+
+    /* End of the initial lookup */
+    if (cmd == QRTR_TYPE_NEW_SERVER && !service && !instance && !server_node && !port) {
+        if (node->open_callback)
+            qrtr_open_complete (node,
+                                __qmi_qrtr_node_get_n_servers (node) ?
+                                NULL :
+                                g_error_new (QMI_CORE_ERROR,
+                                             QMI_CORE_ERROR_FAILED,
+                                             "No QMI services found in QRTR node %u",
+                                             node->node));
+        return FALSE;
+    }
+
+    /* QRTR service IDs are the QMI service types */
+    if (server_node != node->node || service == QMI_SERVICE_CTL || service > G_MAXUINT8)
+        return FALSE;
+
+    server = &node->servers[service];
+
+    if (cmd == QRTR_TYPE_NEW_SERVER) {
+        /* Only the first instance of each service is used */
+        if (server->present)
+            return FALSE;
+        server->present = TRUE;
+        server->port = port;
+        server->version = (guint8) (instance & 0xFF);
+        g_debug ("[%s] QRTR server of service '%s' (%u) at port %u (version %u)",
+                 node->path_display,
+                 qmi_service_get_string ((QmiService) service),
+                 service,
+                 port,
+                 server->version);
+        return FALSE;
+    }
+
+    if (!server->present || server->port != port)
+        return FALSE;
+    server->present = FALSE;
+    g_debug ("[%s] QRTR server of service '%s' (%u) gone",
+             node->path_display,
+             qmi_service_get_string ((QmiService) service),
+             service);
+
+    /* All servers go away when the remote processor is restarted */
+    if (node->clients && !__qmi_qrtr_node_get_n_servers (node)) {
+        g_warning ("[%s] No QMI services left in QRTR node %u",
+                   node->path_display, node->node);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static gboolean
+qrtr_ctrl_input_cb (gint         fd,
+                    GIOCondition condition,
+                    QmiQrtrNode *node)
+{
+    gboolean keep = TRUE;
+    gboolean removed = FALSE;
+
+    while (TRUE) {
+        struct qrtr_ctrl_pkt pkt;
+        guint32              from_node = 0;
+        guint32              from_port = 0;
+        gssize               r;
+
+        r = socket_ops->recvfrom (fd, (guint8 *) &pkt, sizeof (pkt), &from_node, &from_port);
+        if (r < 0) {
+            gint saved_errno = errno;
+
+            if (saved_errno == EINTR)
+                continue;
+            if (saved_errno != EAGAIN && saved_errno != EWOULDBLOCK) {
+                g_warning ("[%s] Cannot read from QRTR control socket: %s",
+                           node->path_display, g_strerror (saved_errno));
+                keep = FALSE;
+                if (node->open_callback)
+                    qrtr_open_complete (node,
+                                        g_error_new (QMI_CORE_ERROR,
+                                                     QMI_CORE_ERROR_FAILED,
+                                                     "Cannot lookup QRTR servers: %s",
+                                                     g_strerror (saved_errno)));
+            }
+            break;
+        }
+
+        /* Only packets from the name service */
+        if ((gsize) r < sizeof (pkt) || from_port != QRTR_PORT_CTRL)
+            continue;
+
+        if (qrtr_ctrl_process (node, &pkt))
+            removed = TRUE;
+    }
+
+    /* The node may be freed when reporting the removal, so nothing else is
+     * done afterwards */
+    if (removed)
+        node->callbacks.removed (node->user_data);
+
+    return (keep ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE);
+}
+
+gboolean
+__qmi_qrtr_node_open (QmiQrtrNode        *node,
+                      guint               timeout,
+                      QmiQrtrNodeOpenFn   callback,
+                      gpointer            user_data,
+                      GError            **error)
+{
+    struct qrtr_ctrl_pkt pkt;
+    guint32              local_node = 0;
+    guint32              local_port = 0;
+    gint                 saved_errno;
+
+    g_assert (node->ctrl_fd < 0);
+
+    node->ctrl_fd = qrtr_socket_new (error);
+    if (node->ctrl_fd < 0)
+        return FALSE;
+
+    /* The lookup goes to the name service in the local node */
+    if (socket_ops->getsockname (node->ctrl_fd, &local_node, &local_port) < 0) {
+        saved_errno = errno;
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_FAILED,
+                     "Cannot get local QRTR node: %s",
+                     g_strerror (saved_errno));
+        return FALSE;
+    }
+
+    /* Lookup of all services: all the current servers are reported, then an
+     * empty one, then any change */
+    memset (&pkt, 0, sizeof (pkt));
+    pkt.cmd = GUINT32_TO_LE (QRTR_TYPE_NEW_LOOKUP);
+    if (socket_ops->sendto (node->ctrl_fd, (const guint8 *) &pkt, sizeof (pkt), local_node, QRTR_PORT_CTRL) < 0) {
+        saved_errno = errno;
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_FAILED,
+                     "Cannot lookup QRTR servers: %s",
+                     g_strerror (saved_errno));
+        return FALSE;
+    }
+
+    g_debug ("[%s] looking up QRTR servers in node %u...",
+             node->path_display, node->node);
+
+    /* All set up before the sources are attached, as they may be dispatched
+     * right away in another thread */
+    node->open_callback = callback;
+    node->open_user_data = user_data;
+    if (timeout > 0) {
+        node->open_timeout_source = g_timeout_source_new_seconds (timeout);
+        g_source_set_callback (node->open_timeout_source,
+                               (GSourceFunc) qrtr_open_timeout_cb,
+                               node,
+                               NULL);
+        g_source_attach (node->open_timeout_source, node->context);
+    }
+    node->ctrl_source = g_unix_fd_source_new (node->ctrl_fd, G_IO_IN);
+    g_source_set_callback (node->ctrl_source,
+                           (GSourceFunc) qrtr_ctrl_input_cb,
+                           node,
+                           NULL);
+    g_source_attach (node->ctrl_source, node->context);
+    return TRUE;
+}
+
+/*****************************************************************************/
+
+QmiQrtrNode *
+__qmi_qrtr_node_new (guint32                     node_id,
+                     const gchar                *path_display,
+                     GMainContext               *context,
+                     const QmiQrtrNodeCallbacks *callbacks,
+                     gpointer                    user_data)
+{
+    QmiQrtrNode *node;
+
+    node = g_slice_new0 (QmiQrtrNode);
+    node->node = node_id;
+    node->path_display = g_strdup (path_display);
+    node->context = g_main_context_ref (context);
+    node->callbacks = *callbacks;
+    node->user_data = user_data;
+    node->ctrl_fd = -1;
+    g_queue_init (&node->ctl_responses);
+    return node;
+}
+
+void
+__qmi_qrtr_node_free (QmiQrtrNode *node)
+{
+    if (node->open_timeout_source) {
+        g_source_destroy (node->open_timeout_source);
+        g_source_unref (node->open_timeout_source);
+    }
+    if (node->ctrl_source) {
+        g_source_destroy (node->ctrl_source);
+        g_source_unref (node->ctrl_source);
+    }
+    if (node->ctrl_fd >= 0)
+        close (node->ctrl_fd);
+    g_clear_pointer (&node->clients, g_hash_table_unref);
+
+    if (node->ctl_source) {
+        g_source_destroy (node->ctl_source);
+        g_source_unref (node->ctl_source);
+    }
+    while (!g_queue_is_empty (&node->ctl_responses))
+        qmi_message_unref (g_queue_pop_head (&node->ctl_responses));
+
+    g_main_context_unref (node->context);
+    g_free (node->path_display);
+    g_slice_free (QmiQrtrNode, node);
+}
+
+#endif /* HAVE_LINUX_QRTR_H */
@@ -0,0 +1,139 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_QRTR_H_
+#define _LIBQMI_GLIB_QMI_QRTR_H_
+
+#if !defined (LIBQMI_GLIB_COMPILATION)
+#error "This is a private header."
+#endif
+
+#include <glib.h>
+
+#include "qmi-message.h"
+
+G_BEGIN_DECLS
+
+/*
+ * QRTR transport of QmiDevice.
+ *
+ * In SoC-integrated modems each QMI service is published as a QRTR server in
+ * the node of the modem, and each client talks to it through its own QRTR
+ * socket; there is neither QMUX framing nor CTL service. CIDs are still given
+ * to the clients, just to identify their sockets, so that messages keep their
+ * QMUX layout: the QMUX header is skipped when sending and prepended when
+ * receiving, and CTL requests are replied locally.
+ *
+ * A node is created when the device is opened, and all its sources are
+ * attached to the given context, where all the callbacks are called. The
+ * node must be freed once that context no longer runs, or from within it.
+ */
+
+#define QMI_QRTR_URI_SCHEME "qrtr"
+
+typedef struct _QmiQrtrNode QmiQrtrNode;
+
+typedef struct {
+    /* Buffer where the received messages are appended, in QMUX format */
+    GByteArray * (* get_buffer)   (gpointer user_data);
+    /* Messages were appended to the buffer; the node may be freed here */
+    void         (* input)        (gpointer user_data);
+    /* A request given to __qmi_qrtr_node_send() couldn't be sent after all */
+    void         (* send_error)   (QmiMessage   *message,
+                                   const GError *error,
+                                   gpointer      user_data);
+    /* No servers left in the node once open; the node may be freed here */
+    void         (* removed)      (gpointer user_data);
+} QmiQrtrNodeCallbacks;
+
+/* Completion of __qmi_qrtr_node_open(), @error owned by the callback. The
+ * node must not be freed from within the callback. */
+typedef void (* QmiQrtrNodeOpenFn) (QmiQrtrNode *node,
+                                    GError      *error,
+                                    gpointer     user_data);
+
+/* System calls on QRTR sockets, with addresses given as node and port and
+ * errors in errno. Only meant to be replaced in tests, given sockets that
+ * can be polled and closed as any other file descriptor. */
+typedef struct {
+    gint   (* socket_new)  (void);
+    gint   (* getsockname) (gint          fd,
+                            guint32      *node,
+                            guint32      *port);
+    gssize (* sendto)      (gint          fd,
+                            const guint8 *data,
+                            gsize         len,
+                            guint32       node,
+                            guint32       port);
+    gssize (* recvfrom)    (gint          fd,
+                            guint8       *data,
+                            gsize         len,
+                            guint32      *node,
+                            guint32      *port);
+} QmiQrtrSocketOps;
+
+G_GNUC_INTERNAL
+void         __qmi_qrtr_set_socket_ops (const QmiQrtrSocketOps *ops);
+
+/* Node given in a qrtr://<node> URI */
+G_GNUC_INTERNAL
+gboolean     __qmi_qrtr_parse_uri      (const gchar *uri,
+                                        guint32     *node);
+
+G_GNUC_INTERNAL
+QmiQrtrNode *__qmi_qrtr_node_new       (guint32                     node,
+                                        const gchar                *path_display,
+                                        GMainContext               *context,
+                                        const QmiQrtrNodeCallbacks *callbacks,
+                                        gpointer                    user_data);
+
+G_GNUC_INTERNAL
+void         __qmi_qrtr_node_free      (QmiQrtrNode *node);
+
+/* Looks up the servers in the node, reported through @callback once all
+ * known, or if @timeout seconds elapse before, unless 0 */
+G_GNUC_INTERNAL
+gboolean     __qmi_qrtr_node_open      (QmiQrtrNode        *node,
+                                        guint               timeout,
+                                        QmiQrtrNodeOpenFn   callback,
+                                        gpointer            user_data,
+                                        GError            **error);
+
+/* Whether the lookup is finished and requests can be sent */
+G_GNUC_INTERNAL
+gboolean     __qmi_qrtr_node_is_open   (QmiQrtrNode *node);
+
+G_GNUC_INTERNAL
+guint        __qmi_qrtr_node_get_n_servers (QmiQrtrNode *node);
+
+/* CTL requests are replied through the input callback, the others are sent
+ * to the server of their service through the socket of their client, which
+ * is created if not there yet */
+G_GNUC_INTERNAL
+gboolean     __qmi_qrtr_node_send      (QmiQrtrNode  *node,
+                                        QmiMessage   *message,
+                                        GError      **error);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_QRTR_H_ */
@@ -0,0 +1,704 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "qmi-schema.h"
+#include "qmi-message.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+/*****************************************************************************/
+/* Binary layout, as written by qmi-codegen --schema; all integers are little
+ * endian, all offsets are given from the start of the file, and 0 is used as
+ * offset when there is nothing to point to:
+ *
+ *   Header (32 bytes):
+ *     magic "QMISCHM\0" (8), version (4), n_services (4),
+ *     services offset (4), strings offset (4), strings size (4), reserved (4)
+ *   Service (16 bytes), sorted by id:
+ *     id (2), reserved (2), name (4), n_messages (4), messages offset (4)
+ *   Message (24 bytes), sorted by kind, id and vendor:
+ *     id (2), vendor (2, 0 if generic), kind (1, 0 request/response or
+ *     1 indication), reserved (3), name (4), n_input_tlvs (2),
+ *     n_output_tlvs (2), input TLVs offset (4), output TLVs offset (4)
+ *   TLV (12 bytes):
+ *     type (1), reserved (3), name (4), field offset (4)
+ *   Field (24 bytes), same contents as a QmiTlvField:
+ *     type (1), flags (1), size (1), endian (1), length (2), n_members (2),
+ *     name (4), values offset (4), members offset (4), reserved (4)
+ *   Values table, for enums and flags:
+ *     n_values (4), reserved (4), and n_values entries (16 bytes) with
+ *     value (8, signed), nick (4), reserved (4)
+ *   Strings:
+ *     NUL-terminated strings, names and nicks given as offsets in this blob
+ *
+ * The whole database is validated when loaded, and converted to the same
+ * compact TLV descriptors used by the library itself, so that messages are
+ * translated by the same interpreter without any further bounds checks. */
+
+#define SCHEMA_MAGIC        "QMISCHM"
+#define SCHEMA_VERSION      1
+#define SCHEMA_HEADER_SIZE  32
+#define SCHEMA_SERVICE_SIZE 16
+#define SCHEMA_MESSAGE_SIZE 24
+#define SCHEMA_TLV_SIZE     12
+#define SCHEMA_FIELD_SIZE   24
+#define SCHEMA_VALUE_SIZE   16
+
+/* Nesting of structs and arrays */
+#define SCHEMA_MAX_DEPTH 16
+
+typedef struct {
+    guint16                 id;
+    guint16                 vendor;
+    gboolean                indication;
+    const gchar            *name;
+    guint                   n_input_tlvs;
+    const QmiTlvDescriptor *input_tlvs;
+    guint                   n_output_tlvs;
+    const QmiTlvDescriptor *output_tlvs;
+} SchemaMessage;
+
+typedef struct {
+    guint16        id;
+    const gchar   *name;
+    guint          n_messages;
+    SchemaMessage *messages;
+} SchemaService;
+
+struct _QmiSchema {
+    volatile gint ref_count;
+
+    GBytes        *bytes;
+    guint          n_services;
+    SchemaService *services;
+
+    /* All descriptors built from the database */
+    GPtrArray *allocations;
+};
+
+/*****************************************************************************/
+
+typedef struct {
+    const guint8 *data;
+    gsize         size;
+    const gchar  *strings;
+    guint32       strings_size;
+    GPtrArray    *allocations;
+    /* Values tables already built, by offset */
+    GHashTable   *values;
+} LoadContext;
+
+static guint16
+read_uint16 (const guint8 *ptr)
+{
+    guint16 tmp;
+
+    memcpy (&tmp, ptr, sizeof (tmp));
+    return GUINT16_FROM_LE (tmp);
+}
+
+static guint32
+read_uint32 (const guint8 *ptr)
+{
+    guint32 tmp;
+
+    memcpy (&tmp, ptr, sizeof (tmp));
+    return GUINT32_FROM_LE (tmp);
+}
+
+static gint64
+read_int64 (const guint8 *ptr)
+{
+    guint64 tmp;
+
+    memcpy (&tmp, ptr, sizeof (tmp));
+    return (gint64) GUINT64_FROM_LE (tmp);
+}
+
+static gpointer
+load_context_alloc (LoadContext *ctx,
+                    gsize        size)
+{
+    gpointer mem;
+
+    mem = g_malloc0 (MAX (size, 1));
+    g_ptr_array_add (ctx->allocations, mem);
+    return mem;
+}
+
+static const guint8 *
+load_context_get_block (LoadContext  *ctx,
+                        guint32       offset,
+                        guint32       n_items,
+                        gsize         item_size,
+                        const gchar  *what,
+                        GError      **error)
+{
+    if (offset < SCHEMA_HEADER_SIZE ||
+        offset > ctx->size ||
+        n_items > (ctx->size - offset) / item_size) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_INVALID_MESSAGE,
+                     "Invalid schema: %s out of bounds (offset %u, %u items)",
+                     what, offset, n_items);
+        return NULL;
+    }
+    return &ctx->data[offset];
+}
+
+static gboolean
+load_context_get_string (LoadContext  *ctx,
+                         guint32       offset,
+                         const gchar **out,
+                         GError      **error)
+{
+    /* The blob is NUL-terminated, so any offset in it is a valid string */
+    if (offset >= ctx->strings_size) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_INVALID_MESSAGE,
+                     "Invalid schema: string out of bounds (offset %u)",
+                     offset);
+        return FALSE;
+    }
+    *out = &ctx->strings[offset];
+    return TRUE;
+}
+
+static const QmiTlvFieldValues *
+load_values (LoadContext  *ctx,
+             guint32       offset,
+             GError      **error)
+{
+    QmiTlvFieldValues *values;
+    QmiTlvFieldValue  *entries;
+    const guint8      *ptr;
+    guint32            n_values;
+    guint              i;
+
+    values = g_hash_table_lookup (ctx->values, GUINT_TO_POINTER (offset));
+    if (values)
+        return values;
+
+    if (!(ptr = load_context_get_block (ctx, offset, 1, 8, "values", error)))
+        return NULL;
+    n_values = read_uint32 (ptr);
+    if (!(ptr = load_context_get_block (ctx, offset + 8, n_values, SCHEMA_VALUE_SIZE, "values", error)))
+        return NULL;
+
+    entries = load_context_alloc (ctx, n_values * sizeof (QmiTlvFieldValue));
+    for (i = 0; i < n_values; i++, ptr += SCHEMA_VALUE_SIZE) {
+        entries[i].value = read_int64 (ptr);
+        if (!load_context_get_string (ctx, read_uint32 (ptr + 8), &entries[i].nick, error))
+            return NULL;
+    }
+
+    values = load_context_alloc (ctx, sizeof (QmiTlvFieldValues));
+    values->n_values = n_values;
+    values->values = entries;
+    g_hash_table_insert (ctx->values, GUINT_TO_POINTER (offset), values);
+    return values;
+}
+
+static gboolean
+field_integer_size_valid (const QmiTlvField *field)
+{
+    if (field->flags & QMI_TLV_FIELD_FLAG_SIGNED)
+        return (field->size == 1 || field->size == 2 || field->size == 4 || field->size == 8);
+    return (field->size >= 1 && field->size <= 8);
+}
+
+static const QmiTlvField *
+load_fields (LoadContext  *ctx,
+             guint32       offset,
+             guint         n_fields,
+             guint         depth,
+             GError      **error)
+{
+    QmiTlvField  *fields;
+    const guint8 *ptr;
+    guint         i;
+
+    if (depth > SCHEMA_MAX_DEPTH) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_INVALID_MESSAGE,
+                     "Invalid schema: fields nested too deep");
+        return NULL;
+    }
+
+    if (!(ptr = load_context_get_block (ctx, offset, n_fields, SCHEMA_FIELD_SIZE, "fields", error)))
+        return NULL;
+
+    fields = load_context_alloc (ctx, n_fields * sizeof (QmiTlvField));
+    for (i = 0; i < n_fields; i++, ptr += SCHEMA_FIELD_SIZE) {
+        QmiTlvField *field = &fields[i];
+        guint32      name_offset;
+        guint32      values_offset;
+        guint32      members_offset;
+        gboolean     valid;
+
+        field->type      = ptr[0];
+        field->flags     = ptr[1];
+        field->size      = ptr[2];
+        field->endian    = ptr[3] ? QMI_ENDIAN_BIG : QMI_ENDIAN_LITTLE;
+        field->length    = read_uint16 (ptr + 4);
+        field->n_members = read_uint16 (ptr + 6);
+        name_offset      = read_uint32 (ptr + 8);
+        values_offset    = read_uint32 (ptr + 12);
+        members_offset   = read_uint32 (ptr + 16);
+
+        if (!load_context_get_string (ctx, name_offset, &field->name, error))
+            return NULL;
+
+        /* Anything the interpreter would choke on is rejected here */
+        switch ((QmiTlvFieldType) field->type) {
+        case QMI_TLV_FIELD_TYPE_UINT:
+        case QMI_TLV_FIELD_TYPE_INT:
+        case QMI_TLV_FIELD_TYPE_BOOLEAN:
+            valid = field_integer_size_valid (field);
+            break;
+        case QMI_TLV_FIELD_TYPE_ENUM:
+        case QMI_TLV_FIELD_TYPE_FLAGS:
+        case QMI_TLV_FIELD_TYPE_FLAGS64:
+            valid = field_integer_size_valid (field) && values_offset != 0;
+            if (valid && !(field->values = load_values (ctx, values_offset, error)))
+                return NULL;
+            break;
+        case QMI_TLV_FIELD_TYPE_FLOAT:
+        case QMI_TLV_FIELD_TYPE_FIXED_SIZE_STRING:
+        case QMI_TLV_FIELD_TYPE_RESULT:
+            valid = TRUE;
+            break;
+        case QMI_TLV_FIELD_TYPE_STRING:
+            valid = (field->size <= 2);
+            break;
+        case QMI_TLV_FIELD_TYPE_ARRAY:
+            valid = (field->size <= 8 &&
+                     field->n_members == ((field->flags & QMI_TLV_FIELD_FLAG_SEQUENCE) ? 2 : 1));
+            break;
+        case QMI_TLV_FIELD_TYPE_STRUCT:
+            valid = TRUE;
+            break;
+        default:
+            valid = FALSE;
+            break;
+        }
+
+        if (!valid) {
+            g_set_error (error,
+                         QMI_CORE_ERROR,
+                         QMI_CORE_ERROR_INVALID_MESSAGE,
+                         "Invalid schema: unsupported field (type %u, size %u)",
+                         field->type, field->size);
+            return NULL;
+        }
+
+        if (field->n_members > 0 &&
+            !(field->members = load_fields (ctx, members_offset, field->n_members, depth + 1, error)))
+            return NULL;
+
+        /* The array sequence is read as an integer */
+        if (field->type == QMI_TLV_FIELD_TYPE_ARRAY &&
+            (field->flags & QMI_TLV_FIELD_FLAG_SEQUENCE) &&
+            (field->members[0].type > QMI_TLV_FIELD_TYPE_FLAGS64 ||
+             field->members[0].type == QMI_TLV_FIELD_TYPE_FLOAT)) {
+            g_set_error (error,
+                         QMI_CORE_ERROR,
+                         QMI_CORE_ERROR_INVALID_MESSAGE,
+                         "Invalid schema: array sequence is not an integer");
+            return NULL;
+        }
+    }
+
+    return fields;
+}
+
+static const QmiTlvDescriptor *
+load_tlvs (LoadContext  *ctx,
+           guint32       offset,
+           guint         n_tlvs,
+           GError      **error)
+{
+    QmiTlvDescriptor *tlvs;
+    const guint8     *ptr;
+    guint             i;
+
+    if (!n_tlvs)
+        return NULL;
+
+    if (!(ptr = load_context_get_block (ctx, offset, n_tlvs, SCHEMA_TLV_SIZE, "TLVs", error)))
+        return NULL;
+
+    tlvs = load_context_alloc (ctx, n_tlvs * sizeof (QmiTlvDescriptor));
+    for (i = 0; i < n_tlvs; i++, ptr += SCHEMA_TLV_SIZE) {
+        tlvs[i].type = ptr[0];
+        if (!load_context_get_string (ctx, read_uint32 (ptr + 4), &tlvs[i].name, error) ||
+            !(tlvs[i].field = load_fields (ctx, read_uint32 (ptr + 8), 1, 0, error)))
+            return NULL;
+    }
+    return tlvs;
+}
+
+static gboolean
+load_service (LoadContext    *ctx,
+              const guint8   *ptr,
+              SchemaService  *service,
+              GError        **error)
+{
+    const guint8 *messages;
+    guint         i;
+
+    service->id = read_uint16 (ptr);
+    service->n_messages = read_uint32 (ptr + 8);
+    if (!load_context_get_string (ctx, read_uint32 (ptr + 4), &service->name, error))
+        return FALSE;
+
+    if (!service->n_messages)
+        return TRUE;
+
+    if (!(messages = load_context_get_block (ctx, read_uint32 (ptr + 12), service->n_messages, SCHEMA_MESSAGE_SIZE, "messages", error)))
+        return FALSE;
+
+    service->messages = load_context_alloc (ctx, service->n_messages * sizeof (SchemaMessage));
+    for (i = 0; i < service->n_messages; i++, messages += SCHEMA_MESSAGE_SIZE) {
+        SchemaMessage *message = &service->messages[i];
+
+        message->id            = read_uint16 (messages);
+        message->vendor        = read_uint16 (messages + 2);
+        message->indication    = (messages[4] != 0);
+        message->n_input_tlvs  = read_uint16 (messages + 12);
+        message->n_output_tlvs = read_uint16 (messages + 14);
+
+        if (!load_context_get_string (ctx, read_uint32 (messages + 8), &message->name, error))
+            return FALSE;
+        if (message->n_input_tlvs &&
+            !(message->input_tlvs = load_tlvs (ctx, read_uint32 (messages + 16), message->n_input_tlvs, error)))
+            return FALSE;
+        if (message->n_output_tlvs &&
+            !(message->output_tlvs = load_tlvs (ctx, read_uint32 (messages + 20), message->n_output_tlvs, error)))
+            return FALSE;
+
+        /* Lookups are binary searches */
+        if (i > 0) {
+            const SchemaMessage *previous = &service->messages[i - 1];
+
+            if (previous->indication > message->indication ||
+                (previous->indication == message->indication &&
+                 (previous->id > message->id ||
+                  (previous->id == message->id && previous->vendor >= message->vendor)))) {
+                g_set_error (error,
+                             QMI_CORE_ERROR,
+                             QMI_CORE_ERROR_INVALID_MESSAGE,
+                             "Invalid schema: messages of service '%s' not sorted",
+                             service->name);
+                return FALSE;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+QmiSchema *
+qmi_schema_new_from_bytes (GBytes  *bytes,
+                           GError **error)
+{
+    QmiSchema    *self;
+    LoadContext   ctx;
+    const guint8 *services;
+    guint32       strings_offset;
+    guint         i;
+
+    g_return_val_if_fail (bytes != NULL, NULL);
+
+    memset (&ctx, 0, sizeof (ctx));
+    ctx.data = g_bytes_get_data (bytes, &ctx.size);
+
+    if (ctx.size < SCHEMA_HEADER_SIZE || memcmp (ctx.data, SCHEMA_MAGIC, sizeof (SCHEMA_MAGIC)) != 0) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_INVALID_MESSAGE,
+                     "Not a QMI schema database");
+        return NULL;
+    }
+
+    if (read_uint32 (ctx.data + 8) != SCHEMA_VERSION) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_UNSUPPORTED,
+                     "Unsupported QMI schema database version: %u",
+                     read_uint32 (ctx.data + 8));
+        return NULL;
+    }
+
+    strings_offset = read_uint32 (ctx.data + 20);
+    ctx.strings_size = read_uint32 (ctx.data + 24);
+    if (!ctx.strings_size ||
+        !load_context_get_block (&ctx, strings_offset, ctx.strings_size, 1, "strings", error))
+        return NULL;
+    ctx.strings = (const gchar *) &ctx.data[strings_offset];
+    if (ctx.strings[ctx.strings_size - 1] != '\0') {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_INVALID_MESSAGE,
+                     "Invalid schema: strings not terminated");
+        return NULL;
+    }
+
+    self = g_slice_new0 (QmiSchema);
+    self->ref_count = 1;
+    self->bytes = g_bytes_ref (bytes);
+    self->allocations = g_ptr_array_new_with_free_func (g_free);
+    self->n_services = read_uint32 (ctx.data + 12);
+
+    ctx.allocations = self->allocations;
+    ctx.values = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    if (!(services = load_context_get_block (&ctx, read_uint32 (ctx.data + 16), self->n_services, SCHEMA_SERVICE_SIZE, "services", error)))
+        goto failed;
+
+    self->services = load_context_alloc (&ctx, self->n_services * sizeof (SchemaService));
+    for (i = 0; i < self->n_services; i++, services += SCHEMA_SERVICE_SIZE) {
+        if (!load_service (&ctx, services, &self->services[i], error))
+            goto failed;
+        if (i > 0 && self->services[i - 1].id >= self->services[i].id) {
+            g_set_error (error,
+                         QMI_CORE_ERROR,
+                         QMI_CORE_ERROR_INVALID_MESSAGE,
+                         "Invalid schema: services not sorted");
+            goto failed;
+        }
+    }
+
+    g_hash_table_unref (ctx.values);
+    return self;
+
+failed:
+    g_hash_table_unref (ctx.values);
+    qmi_schema_unref (self);
+    return NULL;
+}
+
+QmiSchema *
+qmi_schema_new_from_file (const gchar  *path,
+                          GError      **error)
+{
+    GMappedFile *mapped;
+    GBytes      *bytes;
+    QmiSchema   *self;
+
+    g_return_val_if_fail (path != NULL, NULL);
+
+    if (!(mapped = g_mapped_file_new (path, FALSE, error)))
+        return NULL;
+
+    bytes = g_mapped_file_get_bytes (mapped);
+    g_mapped_file_unref (mapped);
+
+    self = qmi_schema_new_from_bytes (bytes, error);
+    g_bytes_unref (bytes);
+    return self;
+}
+
+GType
+qmi_schema_get_type (void)
+{
+    static volatile gsize g_define_type_id__volatile = 0;
+
+    if (g_once_init_enter (&g_define_type_id__volatile)) {
+        GType g_define_type_id =
+            g_boxed_type_register_static (g_intern_static_string ("QmiSchema"),
+                                          (GBoxedCopyFunc) qmi_schema_ref,
+                                          (GBoxedFreeFunc) qmi_schema_unref);
+
+        g_once_init_leave (&g_define_type_id__volatile, g_define_type_id);
+    }
+
+    return g_define_type_id__volatile;
+}
+
+QmiSchema *
+qmi_schema_ref (QmiSchema *self)
+{
+    g_return_val_if_fail (self != NULL, NULL);
+
+    g_atomic_int_inc (&self->ref_count);
+    return self;
+}
+
+void
+qmi_schema_unref (QmiSchema *self)
+{
+    g_return_if_fail (self != NULL);
+
+    if (g_atomic_int_dec_and_test (&self->ref_count)) {
+        g_ptr_array_unref (self->allocations);
+        g_bytes_unref (self->bytes);
+        g_slice_free (QmiSchema, self);
+    }
+}
+
+/*****************************************************************************/
+
+static const SchemaService *
+find_service (QmiSchema *self,
+              guint16    id)
+{
+    guint lo = 0;
+    guint hi = self->n_services;
+
+    while (lo < hi) {
+        guint mid;
+
+        mid = lo + (hi - lo) / 2;
+        if (self->services[mid].id < id)
+            lo = mid + 1;
+        else if (self->services[mid].id > id)
+            hi = mid;
+        else
+            return &self->services[mid];
+    }
+    return NULL;
+}
+
+static gint
+message_cmp (const SchemaMessage *message,
+             gboolean             indication,
+             guint16              id,
+             guint16              vendor)
+{
+    if (message->indication != indication)
+        return message->indication ? 1 : -1;
+    if (message->id != id)
+        return (message->id > id) ? 1 : -1;
+    return (message->vendor > vendor) - (message->vendor < vendor);
+}
+
+/* Same rules as the generated code: indications are matched by id alone,
+ * requests and responses by id and vendor */
+static const SchemaMessage *
+find_message (QmiSchema         *self,
+              QmiMessage        *message,
+              QmiMessageContext *context)
+{
+    const SchemaService *service;
+    gboolean             indication;
+    guint16              id;
+    guint16              vendor;
+    guint                lo;
+    guint                hi;
+
+    if (!(service = find_service (self, (guint16) qmi_message_get_service (message))))
+        return NULL;
+
+    indication = !!qmi_message_is_indication (message);
+    id = qmi_message_get_message_id (message);
+    vendor = (indication || !context) ? QMI_MESSAGE_VENDOR_GENERIC : qmi_message_context_get_vendor_id (context);
+
+    /* First message with the kind, id and vendor, or with the kind and id if
+     * an indication */
+    lo = 0;
+    hi = service->n_messages;
+    while (lo < hi) {
+        guint mid;
+
+        mid = lo + (hi - lo) / 2;
+        if (message_cmp (&service->messages[mid], indication, id, vendor) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo >= service->n_messages)
+        return NULL;
+    if (indication) {
+        if (service->messages[lo].indication && service->messages[lo].id == id)
+            return &service->messages[lo];
+        return NULL;
+    }
+    if (message_cmp (&service->messages[lo], indication, id, vendor) == 0)
+        return &service->messages[lo];
+    return NULL;
+}
+
+const gchar *
+qmi_schema_get_message_name (QmiSchema         *self,
+                             QmiMessage        *message,
+                             QmiMessageContext *message_context)
+{
+    const SchemaMessage *schema_message;
+
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (message != NULL, NULL);
+
+    schema_message = find_message (self, message, message_context);
+    return (schema_message ? schema_message->name : NULL);
+}
+
+gchar *
+qmi_schema_get_printable (QmiSchema         *self,
+                          QmiMessage        *message,
+                          QmiMessageContext *message_context,
+                          const gchar       *line_prefix)
+{
+    const SchemaMessage *schema_message;
+    GString             *printable;
+
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (message != NULL, NULL);
+
+    if (!line_prefix)
+        line_prefix = "";
+
+    printable = g_string_new ("");
+    __qmi_message_append_printable_header (message, line_prefix, printable);
+
+    schema_message = find_message (self, message, message_context);
+    if (!schema_message) {
+        g_string_append_printf (printable,
+                                "%s  message     = (0x%04x)\n",
+                                line_prefix, qmi_message_get_message_id (message));
+        __qmi_message_append_tlvs_printable (message, line_prefix, NULL, 0, printable);
+        return g_string_free (printable, FALSE);
+    }
+
+    g_string_append_printf (printable,
+                            "%s  message     = \"%s\" (0x%04x)\n",
+                            line_prefix, schema_message->name, schema_message->id);
+
+    if (!schema_message->indication && !qmi_message_is_response (message))
+        __qmi_message_append_tlvs_printable (message, line_prefix,
+                                             schema_message->input_tlvs, schema_message->n_input_tlvs,
+                                             printable);
+    else
+        __qmi_message_append_tlvs_printable (message, line_prefix,
+                                             schema_message->output_tlvs, schema_message->n_output_tlvs,
+                                             printable);
+
+    return g_string_free (printable, FALSE);
+}
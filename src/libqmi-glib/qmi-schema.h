@@ -0,0 +1,155 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_SCHEMA_H_
+#define _LIBQMI_GLIB_QMI_SCHEMA_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include "qmi-message.h"
+#include "qmi-message-context.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-schema
+ * @title: QmiSchema
+ * @short_description: runtime decoding of QMI messages
+ *
+ * The #QmiSchema is a database with the description of the contents of QMI
+ * messages, loaded at runtime from a binary file generated by qmi-codegen
+ * (by default installed as <filename>qmi-schema.bin</filename> in the libqmi
+ * data directory).
+ *
+ * It allows building the printable representation of messages of services,
+ * or of service versions, that this build of the library was not compiled
+ * with support for, without rebuilding the library.
+ */
+
+/**
+ * QmiSchema:
+ *
+ * An opaque type representing a QMI schema database.
+ *
+ * Since: 1.20
+ */
+typedef struct _QmiSchema QmiSchema;
+
+GType qmi_schema_get_type (void);
+
+/**
+ * qmi_schema_new_from_bytes:
+ * @bytes: a #GBytes with the contents of the binary schema database.
+ * @error: Return location for error or %NULL.
+ *
+ * Loads a #QmiSchema from the given contents, which are fully validated
+ * before being used.
+ *
+ * Returns: (transfer full): a newly created #QmiSchema, or %NULL if @error is set. The returned value should be freed with qmi_schema_unref().
+ *
+ * Since: 1.20
+ */
+QmiSchema *qmi_schema_new_from_bytes (GBytes  *bytes,
+                                      GError **error);
+
+/**
+ * qmi_schema_new_from_file:
+ * @path: path to the binary schema database.
+ * @error: Return location for error or %NULL.
+ *
+ * Loads a #QmiSchema from the given file, which is mapped in memory.
+ *
+ * Returns: (transfer full): a newly created #QmiSchema, or %NULL if @error is set. The returned value should be freed with qmi_schema_unref().
+ *
+ * Since: 1.20
+ */
+QmiSchema *qmi_schema_new_from_file (const gchar  *path,
+                                     GError      **error);
+
+/**
+ * qmi_schema_ref:
+ * @self: a #QmiSchema.
+ *
+ * Atomically increments the reference count of @self by one.
+ *
+ * Returns: (transfer full) the new reference to @self.
+ *
+ * Since: 1.20
+ */
+QmiSchema *qmi_schema_ref (QmiSchema *self);
+
+/**
+ * qmi_schema_unref:
+ * @self: a #QmiSchema.
+ *
+ * Atomically decrements the reference count of @self by one.
+ * If the reference count drops to 0, @self is completely disposed.
+ *
+ * Since: 1.20
+ */
+void qmi_schema_unref (QmiSchema *self);
+
+/**
+ * qmi_schema_get_message_name:
+ * @self: a #QmiSchema.
+ * @message: a #QmiMessage.
+ * @message_context: (nullable): a #QmiMessageContext, or %NULL.
+ *
+ * Gets the name of the message as given in the schema.
+ *
+ * Returns: (transfer none): the name of the message, or %NULL if not found in the schema.
+ *
+ * Since: 1.20
+ */
+const gchar *qmi_schema_get_message_name (QmiSchema         *self,
+                                          QmiMessage        *message,
+                                          QmiMessageContext *message_context);
+
+/**
+ * qmi_schema_get_printable:
+ * @self: a #QmiSchema.
+ * @message: a #QmiMessage.
+ * @message_context: (nullable): a #QmiMessageContext, or %NULL.
+ * @line_prefix: prefix string to use in each new generated line.
+ *
+ * Gets a printable string with the contents of the whole QMI message, as
+ * qmi_message_get_printable_full() does, but translating the TLVs with the
+ * descriptions in the schema.
+ *
+ * Returns: (transfer full): a newly allocated string, which should be freed with g_free().
+ *
+ * Since: 1.20
+ */
+gchar *qmi_schema_get_printable (QmiSchema         *self,
+                                 QmiMessage        *message,
+                                 QmiMessageContext *message_context,
+                                 const gchar       *line_prefix);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_SCHEMA_H_ */
@@ -0,0 +1,332 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "qmi-trace.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+#define TRACE_MAGIC        "QMITRACE"
+#define TRACE_MAGIC_LENGTH 8
+#define TRACE_VERSION      1
+#define TRACE_HEADER_SIZE  16
+
+/* Record header: length (4), direction (1), reserved (1), path length (2),
+ * timestamp (8) and latency (8) */
+#define RECORD_HEADER_SIZE 24
+
+/*****************************************************************************/
+
+struct _QmiTraceRing {
+    volatile gint ref_count;
+
+    GMutex  mutex;
+    guint8 *buffer;
+    gsize   size;
+    gint64  max_age;
+
+    /* Offset of the oldest record, and bytes used from there on, wrapping
+     * around the end of the buffer */
+    gsize   head;
+    gsize   used;
+};
+
+QmiTraceRing *
+qmi_trace_ring_new (gsize max_size,
+                    guint max_age)
+{
+    QmiTraceRing *self;
+
+    g_return_val_if_fail (max_size >= RECORD_HEADER_SIZE, NULL);
+
+    self = g_slice_new0 (QmiTraceRing);
+    self->ref_count = 1;
+    g_mutex_init (&self->mutex);
+    self->buffer = g_malloc (max_size);
+    self->size = max_size;
+    self->max_age = (gint64) max_age * G_USEC_PER_SEC;
+    return self;
+}
+
+GType
+qmi_trace_ring_get_type (void)
+{
+    static volatile gsize g_define_type_id__volatile = 0;
+
+    if (g_once_init_enter (&g_define_type_id__volatile)) {
+        GType g_define_type_id =
+            g_boxed_type_register_static (g_intern_static_string ("QmiTraceRing"),
+                                          (GBoxedCopyFunc) qmi_trace_ring_ref,
+                                          (GBoxedFreeFunc) qmi_trace_ring_unref);
+
+        g_once_init_leave (&g_define_type_id__volatile, g_define_type_id);
+    }
+
+    return g_define_type_id__volatile;
+}
+
+QmiTraceRing *
+qmi_trace_ring_ref (QmiTraceRing *self)
+{
+    g_return_val_if_fail (self != NULL, NULL);
+
+    g_atomic_int_inc (&self->ref_count);
+    return self;
+}
+
+void
+qmi_trace_ring_unref (QmiTraceRing *self)
+{
+    g_return_if_fail (self != NULL);
+
+    if (g_atomic_int_dec_and_test (&self->ref_count)) {
+        g_mutex_clear (&self->mutex);
+        g_free (self->buffer);
+        g_slice_free (QmiTraceRing, self);
+    }
+}
+
+/*****************************************************************************/
+/* Ring buffer I/O, wrapping around the end of the buffer */
+
+static void
+ring_write (QmiTraceRing  *self,
+            gsize          offset,
+            gconstpointer  data,
+            gsize          length)
+{
+    gsize first;
+
+    offset %= self->size;
+    first = MIN (length, self->size - offset);
+    memcpy (&self->buffer[offset], data, first);
+    if (first < length)
+        memcpy (self->buffer, (const guint8 *) data + first, length - first);
+}
+
+static void
+ring_read (QmiTraceRing *self,
+           gsize         offset,
+           gpointer      data,
+           gsize         length)
+{
+    gsize first;
+
+    offset %= self->size;
+    first = MIN (length, self->size - offset);
+    memcpy (data, &self->buffer[offset], first);
+    if (first < length)
+        memcpy ((guint8 *) data + first, self->buffer, length - first);
+}
+
+static void
+ring_peek_oldest (QmiTraceRing *self,
+                  guint32      *length,
+                  gint64       *timestamp)
+{
+    guint8 header[RECORD_HEADER_SIZE];
+
+    ring_read (self, self->head, header, RECORD_HEADER_SIZE);
+    memcpy (length, &header[0], 4);
+    *length = GUINT32_FROM_LE (*length);
+    memcpy (timestamp, &header[8], 8);
+    *timestamp = GINT64_FROM_LE (*timestamp);
+}
+
+static void
+ring_drop_oldest (QmiTraceRing *self,
+                  guint32       length)
+{
+    self->head = (self->head + length) % self->size;
+    self->used -= length;
+}
+
+/*****************************************************************************/
+
+void
+qmi_trace_ring_add (QmiTraceRing         *self,
+                    const QmiTraceRecord *record)
+{
+    guint8  header[RECORD_HEADER_SIZE];
+    gsize   path_length;
+    gsize   length;
+    guint32 length_le;
+    guint16 path_length_le;
+    gint64  timestamp_le;
+    gint64  latency_le;
+    gsize   offset;
+
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (record != NULL);
+
+    path_length = (record->path ? strlen (record->path) : 0) + 1;
+    if (path_length > G_MAXUINT16)
+        path_length = G_MAXUINT16;
+    length = RECORD_HEADER_SIZE + path_length + record->raw_length;
+    if (length > self->size)
+        return;
+
+    length_le      = GUINT32_TO_LE ((guint32) length);
+    path_length_le = GUINT16_TO_LE ((guint16) path_length);
+    timestamp_le   = GINT64_TO_LE (record->timestamp);
+    latency_le     = GINT64_TO_LE (record->latency);
+    memcpy (&header[0], &length_le, 4);
+    header[4] = record->sent ? 1 : 0;
+    header[5] = 0;
+    memcpy (&header[6], &path_length_le, 2);
+    memcpy (&header[8], &timestamp_le, 8);
+    memcpy (&header[16], &latency_le, 8);
+
+    g_mutex_lock (&self->mutex);
+
+    /* Discard the records that are too old, and then the ones needed to have
+     * room for the new one */
+    while (self->used > 0) {
+        guint32 oldest_length;
+        gint64  oldest_timestamp;
+
+        ring_peek_oldest (self, &oldest_length, &oldest_timestamp);
+        if ((self->size - self->used >= length) &&
+            (!self->max_age || (record->timestamp - oldest_timestamp) <= self->max_age))
+            break;
+        ring_drop_oldest (self, oldest_length);
+    }
+
+    offset = self->head + self->used;
+    ring_write (self, offset, header, RECORD_HEADER_SIZE);
+    offset += RECORD_HEADER_SIZE;
+    ring_write (self, offset, record->path ? record->path : "", path_length - 1);
+    offset += path_length - 1;
+    ring_write (self, offset, "", 1);
+    offset += 1;
+    if (record->raw_length)
+        ring_write (self, offset, record->raw, record->raw_length);
+    self->used += length;
+
+    g_mutex_unlock (&self->mutex);
+}
+
+GBytes *
+qmi_trace_ring_dump (QmiTraceRing *self)
+{
+    guint8  *data;
+    gsize    data_length;
+    guint32  version_le;
+
+    g_return_val_if_fail (self != NULL, NULL);
+
+    g_mutex_lock (&self->mutex);
+    data_length = TRACE_HEADER_SIZE + self->used;
+    data = g_malloc0 (data_length);
+    ring_read (self, self->head, &data[TRACE_HEADER_SIZE], self->used);
+    g_mutex_unlock (&self->mutex);
+
+    memcpy (data, TRACE_MAGIC, TRACE_MAGIC_LENGTH);
+    version_le = GUINT32_TO_LE (TRACE_VERSION);
+    memcpy (&data[TRACE_MAGIC_LENGTH], &version_le, 4);
+
+    return g_bytes_new_take (data, data_length);
+}
+
+/*****************************************************************************/
+
+gboolean
+qmi_trace_foreach_record (const guint8             *data,
+                          gsize                     data_length,
+                          QmiTraceForeachRecordFn   func,
+                          gpointer                  user_data,
+                          GError                  **error)
+{
+    guint32 version;
+    gsize   offset;
+
+    g_return_val_if_fail (func != NULL, FALSE);
+
+    if (data_length < TRACE_HEADER_SIZE || memcmp (data, TRACE_MAGIC, TRACE_MAGIC_LENGTH) != 0) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_INVALID_ARGS,
+                     "Not a QMI trace");
+        return FALSE;
+    }
+
+    memcpy (&version, &data[TRACE_MAGIC_LENGTH], 4);
+    version = GUINT32_FROM_LE (version);
+    if (version != TRACE_VERSION) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_UNSUPPORTED,
+                     "Unsupported QMI trace version: %u",
+                     version);
+        return FALSE;
+    }
+
+    for (offset = TRACE_HEADER_SIZE; offset < data_length; ) {
+        const guint8   *header;
+        QmiTraceRecord  record;
+        guint32         length;
+        guint16         path_length;
+
+        if (data_length - offset < RECORD_HEADER_SIZE) {
+            g_set_error (error,
+                         QMI_CORE_ERROR,
+                         QMI_CORE_ERROR_INVALID_MESSAGE,
+                         "Truncated record header at offset %" G_GSIZE_FORMAT,
+                         offset);
+            return FALSE;
+        }
+
+        header = &data[offset];
+        memcpy (&length, &header[0], 4);
+        length = GUINT32_FROM_LE (length);
+        memcpy (&path_length, &header[6], 2);
+        path_length = GUINT16_FROM_LE (path_length);
+        if (length > data_length - offset ||
+            path_length == 0 ||
+            length < RECORD_HEADER_SIZE + path_length ||
+            header[RECORD_HEADER_SIZE + path_length - 1] != '\0') {
+            g_set_error (error,
+                         QMI_CORE_ERROR,
+                         QMI_CORE_ERROR_INVALID_MESSAGE,
+                         "Invalid record at offset %" G_GSIZE_FORMAT,
+                         offset);
+            return FALSE;
+        }
+
+        record.sent = (header[4] != 0);
+        memcpy (&record.timestamp, &header[8], 8);
+        record.timestamp = GINT64_FROM_LE (record.timestamp);
+        memcpy (&record.latency, &header[16], 8);
+        record.latency = GINT64_FROM_LE (record.latency);
+        record.path = (const gchar *) &header[RECORD_HEADER_SIZE];
+        record.raw = &header[RECORD_HEADER_SIZE + path_length];
+        record.raw_length = length - RECORD_HEADER_SIZE - path_length;
+
+        func (&record, user_data);
+        offset += length;
+    }
+
+    return TRUE;
+}
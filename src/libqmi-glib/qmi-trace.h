@@ -0,0 +1,197 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_TRACE_H_
+#define _LIBQMI_GLIB_QMI_TRACE_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-trace
+ * @title: QmiTraceRing
+ * @short_description: binary recording of the QMI traffic
+ *
+ * The #QmiTraceRing keeps the raw QMI frames sent and received by one or more
+ * #QmiDevice objects in a fixed-size memory area, overwriting the oldest ones
+ * when full. It is meant to be fed from the trace function set with
+ * qmi_device_set_trace_func(), so that the latest traffic can always be kept
+ * around at a much lower cost than with the text traces enabled with
+ * qmi_utils_set_traces_enabled().
+ *
+ * The contents of the ring can be serialized with qmi_trace_ring_dump(), and
+ * the serialized data parsed back with qmi_trace_foreach_record(), e.g. in
+ * order to decode the traffic offline with qmicli --trace-decode.
+ *
+ * The serialized format starts with a 16-byte header with the "QMITRACE"
+ * magic, a 32-bit version (1) and 32 reserved bits. The header is followed by
+ * the records, oldest first, each one with a 32-bit total length, an 8-bit
+ * direction (1 if sent, 0 if received), 8 reserved bits, the 16-bit length of
+ * the device path including its NUL byte, a 64-bit monotonic timestamp and a
+ * 64-bit latency, both in microseconds, and then the device path and the raw
+ * QMI frame. All integers are little endian.
+ */
+
+/**
+ * QmiTraceRecord:
+ * @timestamp: monotonic time when the frame was sent or received, in microseconds.
+ * @latency: for responses matched to a request, time elapsed since the request was sent, in microseconds; -1 otherwise.
+ * @sent: %TRUE if the frame was sent to the device, %FALSE if received from it.
+ * @path: the path of the device.
+ * @raw: the raw QMI frame.
+ * @raw_length: length of @raw.
+ *
+ * A single frame of QMI traffic.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    gint64        timestamp;
+    gint64        latency;
+    gboolean      sent;
+    const gchar  *path;
+    const guint8 *raw;
+    gsize         raw_length;
+} QmiTraceRecord;
+
+/**
+ * QmiTraceRing:
+ *
+ * An opaque type representing a ring of QMI traffic records.
+ *
+ * Since: 1.20
+ */
+typedef struct _QmiTraceRing QmiTraceRing;
+
+GType qmi_trace_ring_get_type (void);
+
+/**
+ * qmi_trace_ring_new:
+ * @max_size: size of the ring, in bytes.
+ * @max_age: maximum age of the records kept, in seconds, or 0 to keep them until the ring is full.
+ *
+ * Create a new empty #QmiTraceRing.
+ *
+ * Records older than @max_age with respect to the newest one are discarded
+ * when new ones are added, as are the oldest ones when there is no more room.
+ *
+ * Returns: (transfer full): a newly created #QmiTraceRing. The returned value should be freed with qmi_trace_ring_unref().
+ *
+ * Since: 1.20
+ */
+QmiTraceRing *qmi_trace_ring_new (gsize max_size,
+                                  guint max_age);
+
+/**
+ * qmi_trace_ring_ref:
+ * @self: a #QmiTraceRing.
+ *
+ * Atomically increments the reference count of @self by one.
+ *
+ * Returns: (transfer full) the new reference to @self.
+ *
+ * Since: 1.20
+ */
+QmiTraceRing *qmi_trace_ring_ref (QmiTraceRing *self);
+
+/**
+ * qmi_trace_ring_unref:
+ * @self: a #QmiTraceRing.
+ *
+ * Atomically decrements the reference count of @self by one.
+ * If the reference count drops to 0, @self is completely disposed.
+ *
+ * Since: 1.20
+ */
+void qmi_trace_ring_unref (QmiTraceRing *self);
+
+/**
+ * qmi_trace_ring_add:
+ * @self: a #QmiTraceRing.
+ * @record: a #QmiTraceRecord.
+ *
+ * Copies @record into the ring, discarding as many old records as needed.
+ * Records not fitting in the whole ring are ignored.
+ *
+ * This method is thread-safe.
+ *
+ * Since: 1.20
+ */
+void qmi_trace_ring_add (QmiTraceRing         *self,
+                         const QmiTraceRecord *record);
+
+/**
+ * qmi_trace_ring_dump:
+ * @self: a #QmiTraceRing.
+ *
+ * Serializes the records currently in the ring.
+ *
+ * This method is thread-safe.
+ *
+ * Returns: (transfer full): a #GBytes with the serialized records. The returned value should be freed with g_bytes_unref().
+ *
+ * Since: 1.20
+ */
+GBytes *qmi_trace_ring_dump (QmiTraceRing *self);
+
+/**
+ * QmiTraceForeachRecordFn:
+ * @record: a #QmiTraceRecord, only valid during the call.
+ * @user_data: user data.
+ *
+ * Callback used to iterate over the records of a serialized trace.
+ *
+ * Since: 1.20
+ */
+typedef void (* QmiTraceForeachRecordFn) (const QmiTraceRecord *record,
+                                          gpointer              user_data);
+
+/**
+ * qmi_trace_foreach_record:
+ * @data: serialized records, as given by qmi_trace_ring_dump().
+ * @data_length: length of @data.
+ * @func: the function to call for each record.
+ * @user_data: user data to pass to the function.
+ * @error: Return location for error or %NULL.
+ *
+ * Calls the given function for each record in the serialized trace, oldest first.
+ *
+ * Returns: %TRUE if the whole trace was parsed, %FALSE if @error is set.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_trace_foreach_record (const guint8             *data,
+                                   gsize                     data_length,
+                                   QmiTraceForeachRecordFn   func,
+                                   gpointer                  user_data,
+                                   GError                  **error);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_TRACE_H_ */
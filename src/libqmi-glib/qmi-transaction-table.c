@@ -0,0 +1,160 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+
+#include "qmi-transaction-table.h"
+
+/* Initial number of slots, must be a power of 2 */
+#define INITIAL_LOG2_SIZE 4
+
+guint
+__qmi_transaction_table_slot (const QmiTransactionTable *table,
+                              guint32                    key)
+{
+    /* Fibonacci hashing; the high bits of the product depend on all the bits
+     * of the key, so keys only differing in service or client id spread as
+     * well as sequential transaction ids do */
+    return (guint)((guint32)(key * 2654435769u) >> (32 - table->log2_size));
+}
+
+gpointer
+__qmi_transaction_table_lookup (const QmiTransactionTable *table,
+                                guint32                    key)
+{
+    guint i;
+
+    if (!table->n_items)
+        return NULL;
+
+    for (i = __qmi_transaction_table_slot (table, key);
+         table->entries[i].value;
+         i = (i + 1) & (table->size - 1)) {
+        if (table->entries[i].key == key)
+            return table->entries[i].value;
+    }
+
+    return NULL;
+}
+
+static void
+transaction_table_grow (QmiTransactionTable *table)
+{
+    QmiTransactionTableEntry *old_entries;
+    guint                     old_size;
+    guint                     i;
+
+    old_entries = table->entries;
+    old_size = table->size;
+
+    table->log2_size = (old_size ? table->log2_size + 1 : INITIAL_LOG2_SIZE);
+    table->size = 1u << table->log2_size;
+    table->entries = g_new0 (QmiTransactionTableEntry, table->size);
+    table->n_items = 0;
+
+    for (i = 0; i < old_size; i++) {
+        if (old_entries[i].value)
+            __qmi_transaction_table_insert (table, old_entries[i].key, old_entries[i].value);
+    }
+    g_free (old_entries);
+}
+
+void
+__qmi_transaction_table_insert (QmiTransactionTable *table,
+                                guint32              key,
+                                gpointer             value)
+{
+    guint i;
+
+    g_assert (value != NULL);
+
+    /* Keep load factor below 1/2 so that probe sequences stay short */
+    if ((table->n_items + 1) * 2 > table->size)
+        transaction_table_grow (table);
+
+    for (i = __qmi_transaction_table_slot (table, key);
+         table->entries[i].value;
+         i = (i + 1) & (table->size - 1)) {
+        if (table->entries[i].key == key) {
+            table->entries[i].value = value;
+            return;
+        }
+    }
+
+    table->entries[i].key = key;
+    table->entries[i].value = value;
+    table->n_items++;
+}
+
+gpointer
+__qmi_transaction_table_remove (QmiTransactionTable *table,
+                                guint32              key)
+{
+    gpointer value;
+    guint    i;
+    guint    j;
+
+    if (!table->n_items)
+        return NULL;
+
+    for (i = __qmi_transaction_table_slot (table, key);
+         table->entries[i].value;
+         i = (i + 1) & (table->size - 1)) {
+        if (table->entries[i].key == key)
+            break;
+    }
+
+    if (!table->entries[i].value)
+        return NULL;
+
+    value = table->entries[i].value;
+    table->entries[i].value = NULL;
+    table->n_items--;
+
+    /* Backward shift deletion: move up any following entry in the same
+     * cluster that would otherwise become unreachable */
+    for (j = (i + 1) & (table->size - 1);
+         table->entries[j].value;
+         j = (j + 1) & (table->size - 1)) {
+        guint home;
+
+        home = __qmi_transaction_table_slot (table, table->entries[j].key);
+        /* Move if home is not cyclically within (i, j] */
+        if ((i <= j) ? ((home <= i) || (home > j)) : ((home <= i) && (home > j))) {
+            table->entries[i] = table->entries[j];
+            table->entries[j].value = NULL;
+            i = j;
+        }
+    }
+
+    return value;
+}
+
+void
+__qmi_transaction_table_clear (QmiTransactionTable *table)
+{
+    g_clear_pointer (&table->entries, g_free);
+    table->size = 0;
+    table->log2_size = 0;
+    table->n_items = 0;
+}
@@ -0,0 +1,85 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_TRANSACTION_TABLE_H_
+#define _LIBQMI_GLIB_QMI_TRANSACTION_TABLE_H_
+
+#if !defined (LIBQMI_GLIB_COMPILATION)
+#error "This is a private header."
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Open-addressed table of ongoing transactions, keyed by service, client id
+ * and transaction id. A slot with a NULL value is empty.
+ *
+ * Keys are spread with Fibonacci hashing, taking the high bits of the
+ * product so that all the bits of the key (and not just the transaction id
+ * in the low ones) select the slot. Collisions are resolved with linear
+ * probing, and removals shift back the following entries of the cluster, so
+ * there are no tombstones. The load factor is kept below 1/2.
+ *
+ * A zero-initialized table is a valid empty one.
+ */
+
+typedef struct {
+    guint32  key;
+    gpointer value;
+} QmiTransactionTableEntry;
+
+typedef struct {
+    QmiTransactionTableEntry *entries;
+    guint                     size;
+    guint                     log2_size;
+    guint                     n_items;
+} QmiTransactionTable;
+
+G_GNUC_INTERNAL
+guint    __qmi_transaction_table_slot   (const QmiTransactionTable *table,
+                                         guint32                    key);
+
+G_GNUC_INTERNAL
+gpointer __qmi_transaction_table_lookup (const QmiTransactionTable *table,
+                                         guint32                    key);
+
+/* Replaces the value if the key is already in the table */
+G_GNUC_INTERNAL
+void     __qmi_transaction_table_insert (QmiTransactionTable *table,
+                                         guint32              key,
+                                         gpointer             value);
+
+/* Returns the value removed, or NULL if the key wasn't in the table */
+G_GNUC_INTERNAL
+gpointer __qmi_transaction_table_remove (QmiTransactionTable *table,
+                                         guint32              key);
+
+/* Frees the slots; the values aren't touched */
+G_GNUC_INTERNAL
+void     __qmi_transaction_table_clear  (QmiTransactionTable *table);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_TRANSACTION_TABLE_H_ */
@@ -0,0 +1,486 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "qmi-uim-card-status-cache.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+static void async_initable_iface_init (GAsyncInitableIface *iface);
+
+G_DEFINE_TYPE_EXTENDED (QmiUimCardStatusCache, qmi_uim_card_status_cache, G_TYPE_OBJECT, 0,
+                        G_IMPLEMENT_INTERFACE (G_TYPE_ASYNC_INITABLE, async_initable_iface_init))
+
+/* Timeout of each request sent */
+#define REQUEST_TIMEOUT 10
+
+/* UIM indications, only used as invalidation events */
+#define CARD_STATUS_INDICATION_ID 0x0032
+#define REFRESH_INDICATION_ID     0x0033
+
+enum {
+    PROP_0,
+    PROP_CLIENT,
+    PROP_LAST
+};
+
+enum {
+    SIGNAL_INVALIDATED,
+    SIGNAL_LAST
+};
+
+static GParamSpec *properties[PROP_LAST];
+static guint       signals[SIGNAL_LAST] = { 0 };
+
+struct _QmiUimCardStatusCachePrivate {
+    QmiClientUim *client;
+    guint         card_status_id;
+    guint         refresh_id;
+
+    QmiMessageUimGetCardStatusOutput *card_status;
+
+    /* Increased on every invalidation, so that a response to a request sent
+     * before one is never cached */
+    guint generation;
+
+    /* Reads waiting for the ongoing request */
+    gboolean request_running;
+    guint    request_generation;
+    guint    request_timeout;
+    GList   *pending_tasks;
+};
+
+static void card_status_request (QmiUimCardStatusCache *self);
+
+/*****************************************************************************/
+
+QmiClientUim *
+qmi_uim_card_status_cache_peek_client (QmiUimCardStatusCache *self)
+{
+    g_return_val_if_fail (QMI_IS_UIM_CARD_STATUS_CACHE (self), NULL);
+
+    return self->priv->client;
+}
+
+QmiMessageUimGetCardStatusOutput *
+qmi_uim_card_status_cache_peek_card_status (QmiUimCardStatusCache *self)
+{
+    g_return_val_if_fail (QMI_IS_UIM_CARD_STATUS_CACHE (self), NULL);
+
+    return self->priv->card_status;
+}
+
+/*****************************************************************************/
+/* Invalidation */
+
+static void
+invalidate (QmiUimCardStatusCache *self)
+{
+    self->priv->generation++;
+    if (self->priv->card_status) {
+        qmi_message_uim_get_card_status_output_unref (self->priv->card_status);
+        self->priv->card_status = NULL;
+    }
+    g_signal_emit (self, signals[SIGNAL_INVALIDATED], 0);
+}
+
+static void
+indication_cb (QmiClient             *client,
+               QmiMessage            *message,
+               QmiUimCardStatusCache *self)
+{
+    /* The contents are never parsed, the next read will query them */
+    g_debug ("UIM card status invalidated by indication 0x%04x", qmi_message_get_message_id (message));
+    invalidate (self);
+}
+
+/*****************************************************************************/
+/* Get card status */
+
+QmiMessageUimGetCardStatusOutput *
+qmi_uim_card_status_cache_get_card_status_finish (QmiUimCardStatusCache  *self,
+                                                  GAsyncResult           *res,
+                                                  GError                **error)
+{
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+static void
+pending_tasks_complete (QmiUimCardStatusCache            *self,
+                        QmiMessageUimGetCardStatusOutput *output,
+                        const GError                     *error)
+{
+    GList *tasks;
+    GList *l;
+
+    tasks = self->priv->pending_tasks;
+    self->priv->pending_tasks = NULL;
+
+    for (l = tasks; l; l = g_list_next (l)) {
+        GTask *task = G_TASK (l->data);
+
+        if (error)
+            g_task_return_error (task, g_error_copy (error));
+        else
+            g_task_return_pointer (task,
+                                   qmi_message_uim_get_card_status_output_ref (output),
+                                   (GDestroyNotify) qmi_message_uim_get_card_status_output_unref);
+        g_object_unref (task);
+    }
+    g_list_free (tasks);
+}
+
+static void
+get_card_status_ready (QmiClientUim          *client,
+                       GAsyncResult          *res,
+                       QmiUimCardStatusCache *self)
+{
+    QmiMessageUimGetCardStatusOutput *output;
+    GError                           *error = NULL;
+
+    self->priv->request_running = FALSE;
+
+    output = qmi_client_uim_get_card_status_finish (client, res, &error);
+    if (output && !qmi_message_uim_get_card_status_output_get_result (output, &error)) {
+        qmi_message_uim_get_card_status_output_unref (output);
+        output = NULL;
+    }
+
+    if (!output) {
+        pending_tasks_complete (self, NULL, error);
+        g_error_free (error);
+        g_object_unref (self);
+        return;
+    }
+
+    /* Invalidated while the request was ongoing, the output may be stale */
+    if (self->priv->generation != self->priv->request_generation) {
+        qmi_message_uim_get_card_status_output_unref (output);
+        card_status_request (self);
+        g_object_unref (self);
+        return;
+    }
+
+    g_assert (!self->priv->card_status);
+    self->priv->card_status = qmi_message_uim_get_card_status_output_ref (output);
+    pending_tasks_complete (self, output, NULL);
+    qmi_message_uim_get_card_status_output_unref (output);
+    g_object_unref (self);
+}
+
+static void
+card_status_request (QmiUimCardStatusCache *self)
+{
+    self->priv->request_running = TRUE;
+    self->priv->request_generation = self->priv->generation;
+    qmi_client_uim_get_card_status (self->priv->client,
+                                    NULL,
+                                    self->priv->request_timeout,
+                                    NULL,
+                                    (GAsyncReadyCallback)get_card_status_ready,
+                                    g_object_ref (self));
+}
+
+void
+qmi_uim_card_status_cache_get_card_status (QmiUimCardStatusCache *self,
+                                           guint                  timeout,
+                                           GCancellable          *cancellable,
+                                           GAsyncReadyCallback    callback,
+                                           gpointer               user_data)
+{
+    GTask *task;
+
+    g_return_if_fail (QMI_IS_UIM_CARD_STATUS_CACHE (self));
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    if (self->priv->card_status) {
+        g_task_return_pointer (task,
+                               qmi_message_uim_get_card_status_output_ref (self->priv->card_status),
+                               (GDestroyNotify) qmi_message_uim_get_card_status_output_unref);
+        g_object_unref (task);
+        return;
+    }
+
+    /* Cancelling a read only completes it with an error, the request itself
+     * is shared */
+    self->priv->pending_tasks = g_list_append (self->priv->pending_tasks, task);
+    if (self->priv->request_running)
+        return;
+
+    self->priv->request_timeout = timeout;
+    card_status_request (self);
+}
+
+/*****************************************************************************/
+/* New cache */
+
+QmiUimCardStatusCache *
+qmi_uim_card_status_cache_new_finish (GAsyncResult  *res,
+                                      GError       **error)
+{
+    GObject *ret;
+    GObject *source_object;
+
+    source_object = g_async_result_get_source_object (res);
+    ret = g_async_initable_new_finish (G_ASYNC_INITABLE (source_object), res, error);
+    g_object_unref (source_object);
+
+    return (ret ? QMI_UIM_CARD_STATUS_CACHE (ret) : NULL);
+}
+
+void
+qmi_uim_card_status_cache_new (QmiClientUim        *client,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data)
+{
+    g_return_if_fail (QMI_IS_CLIENT_UIM (client));
+
+    g_async_initable_new_async (QMI_TYPE_UIM_CARD_STATUS_CACHE,
+                                G_PRIORITY_DEFAULT,
+                                cancellable,
+                                callback,
+                                user_data,
+                                QMI_UIM_CARD_STATUS_CACHE_CLIENT, client,
+                                NULL);
+}
+
+/*****************************************************************************/
+/* Async init */
+
+static void
+indication_callbacks_remove (QmiUimCardStatusCache *self)
+{
+    if (self->priv->card_status_id) {
+        qmi_client_remove_indication_callback (QMI_CLIENT (self->priv->client), self->priv->card_status_id);
+        self->priv->card_status_id = 0;
+    }
+    if (self->priv->refresh_id) {
+        qmi_client_remove_indication_callback (QMI_CLIENT (self->priv->client), self->priv->refresh_id);
+        self->priv->refresh_id = 0;
+    }
+}
+
+static gboolean
+initable_init_finish (GAsyncInitable  *initable,
+                      GAsyncResult    *result,
+                      GError         **error)
+{
+    return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static void
+register_events_ready (QmiClientUim *client,
+                       GAsyncResult *res,
+                       GTask        *task)
+{
+    QmiUimCardStatusCache             *self;
+    QmiMessageUimRegisterEventsOutput *output;
+    GError                            *error = NULL;
+
+    self = g_task_get_source_object (task);
+
+    output = qmi_client_uim_register_events_finish (client, res, &error);
+    if (!output || !qmi_message_uim_register_events_output_get_result (output, &error)) {
+        g_prefix_error (&error, "Couldn't enable card status indications: ");
+        indication_callbacks_remove (self);
+        g_task_return_error (task, error);
+    } else
+        g_task_return_boolean (task, TRUE);
+
+    if (output)
+        qmi_message_uim_register_events_output_unref (output);
+    g_object_unref (task);
+}
+
+static void
+initable_init_async (GAsyncInitable      *initable,
+                     int                  io_priority,
+                     GCancellable        *cancellable,
+                     GAsyncReadyCallback  callback,
+                     gpointer             user_data)
+{
+    QmiUimCardStatusCache            *self;
+    QmiMessageUimRegisterEventsInput *input;
+    GTask                            *task;
+
+    self = QMI_UIM_CARD_STATUS_CACHE (initable);
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    if (!self->priv->client) {
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_INVALID_ARGS,
+                                 "Cannot initialize UIM card status cache: No client given");
+        g_object_unref (task);
+        return;
+    }
+
+    /* Listen before enabling the indications, so that no change is lost */
+    self->priv->card_status_id = qmi_client_add_indication_callback (QMI_CLIENT (self->priv->client),
+                                                                     CARD_STATUS_INDICATION_ID,
+                                                                     (QmiClientIndicationCallback) indication_cb,
+                                                                     self,
+                                                                     NULL);
+    self->priv->refresh_id = qmi_client_add_indication_callback (QMI_CLIENT (self->priv->client),
+                                                                 REFRESH_INDICATION_ID,
+                                                                 (QmiClientIndicationCallback) indication_cb,
+                                                                 self,
+                                                                 NULL);
+
+    input = qmi_message_uim_register_events_input_new ();
+    qmi_message_uim_register_events_input_set_event_registration_mask (input, QMI_UIM_EVENT_REGISTRATION_FLAG_CARD_STATUS, NULL);
+    qmi_client_uim_register_events (self->priv->client,
+                                    input,
+                                    REQUEST_TIMEOUT,
+                                    cancellable,
+                                    (GAsyncReadyCallback)register_events_ready,
+                                    task);
+    qmi_message_uim_register_events_input_unref (input);
+}
+
+/*****************************************************************************/
+
+static void
+set_property (GObject      *object,
+              guint         prop_id,
+              const GValue *value,
+              GParamSpec   *pspec)
+{
+    QmiUimCardStatusCache *self = QMI_UIM_CARD_STATUS_CACHE (object);
+
+    switch (prop_id) {
+    case PROP_CLIENT:
+        g_assert (self->priv->client == NULL);
+        self->priv->client = g_value_dup_object (value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+get_property (GObject    *object,
+              guint       prop_id,
+              GValue     *value,
+              GParamSpec *pspec)
+{
+    QmiUimCardStatusCache *self = QMI_UIM_CARD_STATUS_CACHE (object);
+
+    switch (prop_id) {
+    case PROP_CLIENT:
+        g_value_set_object (value, self->priv->client);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+qmi_uim_card_status_cache_init (QmiUimCardStatusCache *self)
+{
+    self->priv = G_TYPE_INSTANCE_GET_PRIVATE ((self),
+                                              QMI_TYPE_UIM_CARD_STATUS_CACHE,
+                                              QmiUimCardStatusCachePrivate);
+}
+
+static void
+dispose (GObject *object)
+{
+    QmiUimCardStatusCache *self = QMI_UIM_CARD_STATUS_CACHE (object);
+
+    /* The indications are left enabled, other users of the client may be
+     * listening to them */
+    if (self->priv->client) {
+        indication_callbacks_remove (self);
+        g_clear_object (&self->priv->client);
+    }
+
+    if (self->priv->card_status) {
+        qmi_message_uim_get_card_status_output_unref (self->priv->card_status);
+        self->priv->card_status = NULL;
+    }
+
+    /* Pending reads keep a reference, so there are never any left here */
+    g_assert (!self->priv->pending_tasks);
+
+    G_OBJECT_CLASS (qmi_uim_card_status_cache_parent_class)->dispose (object);
+}
+
+static void
+async_initable_iface_init (GAsyncInitableIface *iface)
+{
+    iface->init_async = initable_init_async;
+    iface->init_finish = initable_init_finish;
+}
+
+static void
+qmi_uim_card_status_cache_class_init (QmiUimCardStatusCacheClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    g_type_class_add_private (object_class, sizeof (QmiUimCardStatusCachePrivate));
+
+    object_class->get_property = get_property;
+    object_class->set_property = set_property;
+    object_class->dispose = dispose;
+
+    /**
+     * QmiUimCardStatusCache:uim-card-status-cache-client:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_CLIENT] =
+        g_param_spec_object (QMI_UIM_CARD_STATUS_CACHE_CLIENT,
+                             "UIM client",
+                             "The UIM client reporting the card status",
+                             QMI_TYPE_CLIENT_UIM,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_CLIENT, properties[PROP_CLIENT]);
+
+    /**
+     * QmiUimCardStatusCache::invalidated:
+     * @object: A #QmiUimCardStatusCache.
+     *
+     * The ::invalidated signal is emitted when a card status change or a
+     * refresh is reported by the device, and the cached card status is
+     * dropped.
+     *
+     * Since: 1.20
+     */
+    signals[SIGNAL_INVALIDATED] =
+        g_signal_new (QMI_UIM_CARD_STATUS_CACHE_SIGNAL_INVALIDATED,
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      0);
+}
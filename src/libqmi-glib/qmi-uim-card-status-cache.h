@@ -0,0 +1,209 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_UIM_CARD_STATUS_CACHE_H_
+#define _LIBQMI_GLIB_QMI_UIM_CARD_STATUS_CACHE_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "qmi-enums-uim.h"
+#include "qmi-uim.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-uim-card-status-cache
+ * @title: QmiUimCardStatusCache
+ * @short_description: cached UIM card status
+ *
+ * The #QmiUimCardStatusCache keeps the last output of the UIM Get Card Status
+ * request of a #QmiClientUim, so that the SIM state can be read from memory
+ * instead of polling the device.
+ *
+ * The card status indications are enabled when the cache is created, and the
+ * cached output is dropped whenever a UIM Card Status or Refresh indication is
+ * received, so that the next read queries the device again. Consumers wanting
+ * to know about SIM hot-swap or PIN state changes may listen to the
+ * #QmiUimCardStatusCache::invalidated signal instead of polling.
+ *
+ * Concurrent reads while the cache is empty share the same request.
+ */
+
+#define QMI_TYPE_UIM_CARD_STATUS_CACHE            (qmi_uim_card_status_cache_get_type ())
+#define QMI_UIM_CARD_STATUS_CACHE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), QMI_TYPE_UIM_CARD_STATUS_CACHE, QmiUimCardStatusCache))
+#define QMI_UIM_CARD_STATUS_CACHE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  QMI_TYPE_UIM_CARD_STATUS_CACHE, QmiUimCardStatusCacheClass))
+#define QMI_IS_UIM_CARD_STATUS_CACHE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), QMI_TYPE_UIM_CARD_STATUS_CACHE))
+#define QMI_IS_UIM_CARD_STATUS_CACHE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  QMI_TYPE_UIM_CARD_STATUS_CACHE))
+#define QMI_UIM_CARD_STATUS_CACHE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  QMI_TYPE_UIM_CARD_STATUS_CACHE, QmiUimCardStatusCacheClass))
+
+typedef struct _QmiUimCardStatusCache QmiUimCardStatusCache;
+typedef struct _QmiUimCardStatusCacheClass QmiUimCardStatusCacheClass;
+typedef struct _QmiUimCardStatusCachePrivate QmiUimCardStatusCachePrivate;
+
+/**
+ * QMI_UIM_CARD_STATUS_CACHE_CLIENT:
+ *
+ * Symbol defining the #QmiUimCardStatusCache:uim-card-status-cache-client property.
+ *
+ * Since: 1.20
+ */
+#define QMI_UIM_CARD_STATUS_CACHE_CLIENT "uim-card-status-cache-client"
+
+/**
+ * QMI_UIM_CARD_STATUS_CACHE_SIGNAL_INVALIDATED:
+ *
+ * Symbol defining the #QmiUimCardStatusCache::invalidated signal.
+ *
+ * Since: 1.20
+ */
+#define QMI_UIM_CARD_STATUS_CACHE_SIGNAL_INVALIDATED "invalidated"
+
+/**
+ * QmiUimCardStatusCache:
+ *
+ * The #QmiUimCardStatusCache structure contains private data and should only be
+ * accessed using the provided API.
+ *
+ * Since: 1.20
+ */
+struct _QmiUimCardStatusCache {
+    /*< private >*/
+    GObject parent;
+    QmiUimCardStatusCachePrivate *priv;
+};
+
+struct _QmiUimCardStatusCacheClass {
+    /*< private >*/
+    GObjectClass parent;
+};
+
+GType qmi_uim_card_status_cache_get_type (void);
+
+/**
+ * qmi_uim_card_status_cache_new:
+ * @client: a #QmiClientUim.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the initialization is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously creates a #QmiUimCardStatusCache, enabling the card status
+ * indications of @client.
+ *
+ * When the operation is finished, @callback will be invoked in the
+ * <link linkend="g-main-context-push-thread-default">thread-default main context</link>
+ * of the thread you are calling this method from. You can then call
+ * qmi_uim_card_status_cache_new_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_uim_card_status_cache_new (QmiClientUim        *client,
+                                    GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data);
+
+/**
+ * qmi_uim_card_status_cache_new_finish:
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_uim_card_status_cache_new().
+ *
+ * Returns: (transfer full): a newly created #QmiUimCardStatusCache, or %NULL if @error is set.
+ *
+ * Since: 1.20
+ */
+QmiUimCardStatusCache *qmi_uim_card_status_cache_new_finish (GAsyncResult  *res,
+                                                             GError       **error);
+
+/**
+ * qmi_uim_card_status_cache_peek_client:
+ * @self: a #QmiUimCardStatusCache.
+ *
+ * Get the #QmiClientUim used by the cache, without increasing the reference
+ * count on the returned object.
+ *
+ * Returns: (transfer none): a #QmiClientUim. Do not free the returned object, it is owned by @self.
+ *
+ * Since: 1.20
+ */
+QmiClientUim *qmi_uim_card_status_cache_peek_client (QmiUimCardStatusCache *self);
+
+/**
+ * qmi_uim_card_status_cache_peek_card_status:
+ * @self: a #QmiUimCardStatusCache.
+ *
+ * Gets the cached card status, without querying the device.
+ *
+ * Returns: (transfer none): a #QmiMessageUimGetCardStatusOutput, or %NULL if the card status isn't cached. Do not free the returned value, it is owned by @self and only valid until the cache is invalidated.
+ *
+ * Since: 1.20
+ */
+QmiMessageUimGetCardStatusOutput *qmi_uim_card_status_cache_peek_card_status (QmiUimCardStatusCache *self);
+
+/**
+ * qmi_uim_card_status_cache_get_card_status:
+ * @self: a #QmiUimCardStatusCache.
+ * @timeout: maximum time to wait for the method to complete, in seconds.
+ * @cancellable: a #GCancellable or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the request is satisfied.
+ * @user_data: user data to pass to @callback.
+ *
+ * Asynchronously gets the card status, from the cache if available, or with a
+ * UIM Get Card Status request otherwise.
+ *
+ * When the operation is finished, @callback will be called. You can then call
+ * qmi_uim_card_status_cache_get_card_status_finish() to get the result of the
+ * operation.
+ *
+ * Since: 1.20
+ */
+void qmi_uim_card_status_cache_get_card_status (QmiUimCardStatusCache *self,
+                                                guint                  timeout,
+                                                GCancellable          *cancellable,
+                                                GAsyncReadyCallback    callback,
+                                                gpointer               user_data);
+
+/**
+ * qmi_uim_card_status_cache_get_card_status_finish:
+ * @self: a #QmiUimCardStatusCache.
+ * @res: the #GAsyncResult obtained from the #GAsyncReadyCallback passed to qmi_uim_card_status_cache_get_card_status().
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an async operation started with qmi_uim_card_status_cache_get_card_status().
+ *
+ * Returns: (transfer full): a #QmiMessageUimGetCardStatusOutput, or %NULL if @error is set. The returned value should be freed with qmi_message_uim_get_card_status_output_unref().
+ *
+ * Since: 1.20
+ */
+QmiMessageUimGetCardStatusOutput *qmi_uim_card_status_cache_get_card_status_finish (QmiUimCardStatusCache  *self,
+                                                                                    GAsyncResult           *res,
+                                                                                    GError                **error);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_UIM_CARD_STATUS_CACHE_H_ */
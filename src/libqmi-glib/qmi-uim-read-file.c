@@ -0,0 +1,367 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "qmi-uim-read-file.h"
+#include "qmi-errors.h"
+#include "qmi-enum-types.h"
+
+/* Timeout of each request sent */
+#define REQUEST_TIMEOUT 10
+
+typedef struct {
+    QmiUimSessionType  session_type;
+    gchar             *application_identifier;
+    guint16            file_id;
+    GArray            *file_path;
+    guint              window;
+
+    /* File attributes */
+    QmiUimFileType     file_type;
+    guint16            file_size;
+    guint16            record_size;
+
+    /* Reads are either records or transparent chunks, each one filling
+     * 'unit_size' bytes of the contents, the last one maybe less */
+    GArray            *contents;
+    guint              unit_size;
+    guint              n_units;
+    guint              next_unit;
+    guint              n_pending;
+    gboolean           completed;
+} ReadFileContext;
+
+typedef struct {
+    GTask *task;
+    guint  unit;
+} ReadUnitContext;
+
+static void
+read_file_context_free (ReadFileContext *ctx)
+{
+    if (ctx->contents)
+        g_array_unref (ctx->contents);
+    g_array_unref (ctx->file_path);
+    g_free (ctx->application_identifier);
+    g_slice_free (ReadFileContext, ctx);
+}
+
+GArray *
+qmi_client_uim_read_file_finish (QmiClientUim    *self,
+                                 GAsyncResult    *res,
+                                 QmiUimFileType  *file_type,
+                                 guint16         *record_size,
+                                 GError         **error)
+{
+    ReadFileContext *ctx;
+    GArray          *contents;
+
+    contents = g_task_propagate_pointer (G_TASK (res), error);
+    if (!contents)
+        return NULL;
+
+    ctx = g_task_get_task_data (G_TASK (res));
+    if (file_type)
+        *file_type = ctx->file_type;
+    if (record_size)
+        *record_size = ctx->record_size;
+    return contents;
+}
+
+static void
+read_file_complete (GTask  *task,
+                    GError *error)
+{
+    ReadFileContext *ctx;
+
+    ctx = g_task_get_task_data (task);
+
+    /* Reads still in flight may fail after the operation is over */
+    if (ctx->completed) {
+        if (error)
+            g_error_free (error);
+        return;
+    }
+    ctx->completed = TRUE;
+
+    if (error)
+        g_task_return_error (task, error);
+    else
+        g_task_return_pointer (task, g_array_ref (ctx->contents), (GDestroyNotify) g_array_unref);
+}
+
+static void read_file_next (GTask *task);
+
+static void
+read_unit_store (GTask        *task,
+                 guint         unit,
+                 const GArray *read_result)
+{
+    ReadFileContext *ctx;
+    guint            offset;
+    guint            len;
+
+    ctx = g_task_get_task_data (task);
+
+    /* Never write past the unit, even if the card returns more */
+    offset = unit * ctx->unit_size;
+    len = MIN (read_result->len, MIN (ctx->unit_size, ctx->contents->len - offset));
+    memcpy (&ctx->contents->data[offset], read_result->data, len);
+}
+
+static void
+read_unit_done (ReadUnitContext *unit_ctx)
+{
+    GTask           *task;
+    ReadFileContext *ctx;
+
+    task = unit_ctx->task;
+    ctx = g_task_get_task_data (task);
+    g_slice_free (ReadUnitContext, unit_ctx);
+
+    g_assert (ctx->n_pending > 0);
+    ctx->n_pending--;
+
+    if (!ctx->completed) {
+        if (ctx->next_unit < ctx->n_units)
+            read_file_next (task);
+        else if (ctx->n_pending == 0)
+            read_file_complete (task, NULL);
+    }
+
+    g_object_unref (task);
+}
+
+static void
+read_record_ready (QmiClientUim    *client,
+                   GAsyncResult    *res,
+                   ReadUnitContext *unit_ctx)
+{
+    QmiMessageUimReadRecordOutput *output;
+    GError                        *error = NULL;
+    GArray                        *read_result = NULL;
+
+    output = qmi_client_uim_read_record_finish (client, res, &error);
+    if (!output ||
+        !qmi_message_uim_read_record_output_get_result (output, &error) ||
+        !qmi_message_uim_read_record_output_get_read_result (output, &read_result, &error)) {
+        g_prefix_error (&error, "Couldn't read record %u: ", unit_ctx->unit + 1);
+        read_file_complete (unit_ctx->task, error);
+    } else
+        read_unit_store (unit_ctx->task, unit_ctx->unit, read_result);
+
+    if (output)
+        qmi_message_uim_read_record_output_unref (output);
+    read_unit_done (unit_ctx);
+}
+
+static void
+read_transparent_ready (QmiClientUim    *client,
+                        GAsyncResult    *res,
+                        ReadUnitContext *unit_ctx)
+{
+    QmiMessageUimReadTransparentOutput *output;
+    GError                             *error = NULL;
+    GArray                             *read_result = NULL;
+
+    output = qmi_client_uim_read_transparent_finish (client, res, &error);
+    if (!output ||
+        !qmi_message_uim_read_transparent_output_get_result (output, &error) ||
+        !qmi_message_uim_read_transparent_output_get_read_result (output, &read_result, &error)) {
+        g_prefix_error (&error, "Couldn't read chunk %u: ", unit_ctx->unit);
+        read_file_complete (unit_ctx->task, error);
+    } else
+        read_unit_store (unit_ctx->task, unit_ctx->unit, read_result);
+
+    if (output)
+        qmi_message_uim_read_transparent_output_unref (output);
+    read_unit_done (unit_ctx);
+}
+
+static void
+read_file_next (GTask *task)
+{
+    QmiClientUim    *self;
+    ReadFileContext *ctx;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    while (ctx->n_pending < ctx->window && ctx->next_unit < ctx->n_units) {
+        ReadUnitContext *unit_ctx;
+
+        unit_ctx = g_slice_new (ReadUnitContext);
+        unit_ctx->task = g_object_ref (task);
+        unit_ctx->unit = ctx->next_unit++;
+        ctx->n_pending++;
+
+        if (ctx->file_type == QMI_UIM_FILE_TYPE_TRANSPARENT) {
+            QmiMessageUimReadTransparentInput *input;
+            guint16                            offset;
+
+            offset = unit_ctx->unit * ctx->unit_size;
+            input = qmi_message_uim_read_transparent_input_new ();
+            qmi_message_uim_read_transparent_input_set_session_information (input, ctx->session_type, ctx->application_identifier, NULL);
+            qmi_message_uim_read_transparent_input_set_file (input, ctx->file_id, ctx->file_path, NULL);
+            qmi_message_uim_read_transparent_input_set_read_information (input, offset, MIN (ctx->unit_size, ctx->file_size - offset), NULL);
+            qmi_client_uim_read_transparent (self,
+                                             input,
+                                             REQUEST_TIMEOUT,
+                                             g_task_get_cancellable (task),
+                                             (GAsyncReadyCallback) read_transparent_ready,
+                                             unit_ctx);
+            qmi_message_uim_read_transparent_input_unref (input);
+        } else {
+            QmiMessageUimReadRecordInput *input;
+
+            /* Records are numbered from 1 */
+            input = qmi_message_uim_read_record_input_new ();
+            qmi_message_uim_read_record_input_set_session_information (input, ctx->session_type, ctx->application_identifier, NULL);
+            qmi_message_uim_read_record_input_set_file (input, ctx->file_id, ctx->file_path, NULL);
+            qmi_message_uim_read_record_input_set_record (input, unit_ctx->unit + 1, ctx->record_size, NULL);
+            qmi_client_uim_read_record (self,
+                                        input,
+                                        REQUEST_TIMEOUT,
+                                        g_task_get_cancellable (task),
+                                        (GAsyncReadyCallback) read_record_ready,
+                                        unit_ctx);
+            qmi_message_uim_read_record_input_unref (input);
+        }
+    }
+}
+
+static void
+get_file_attributes_ready (QmiClientUim *self,
+                           GAsyncResult *res,
+                           GTask        *task)
+{
+    QmiMessageUimGetFileAttributesOutput *output;
+    ReadFileContext                      *ctx;
+    GError                               *error = NULL;
+    guint16                               record_count = 0;
+
+    ctx = g_task_get_task_data (task);
+
+    output = qmi_client_uim_get_file_attributes_finish (self, res, &error);
+    if (!output ||
+        !qmi_message_uim_get_file_attributes_output_get_result (output, &error) ||
+        !qmi_message_uim_get_file_attributes_output_get_file_attributes (output,
+                                                                          &ctx->file_size,
+                                                                          NULL,
+                                                                          &ctx->file_type,
+                                                                          &ctx->record_size,
+                                                                          &record_count,
+                                                                          NULL, NULL, NULL, NULL, NULL,
+                                                                          NULL, NULL, NULL, NULL, NULL,
+                                                                          NULL,
+                                                                          &error)) {
+        g_prefix_error (&error, "Couldn't get file attributes: ");
+        g_task_return_error (task, error);
+        goto out;
+    }
+
+    switch (ctx->file_type) {
+    case QMI_UIM_FILE_TYPE_TRANSPARENT:
+        ctx->record_size = 0;
+        ctx->unit_size = QMI_UIM_READ_FILE_CHUNK_SIZE;
+        ctx->n_units = (ctx->file_size + ctx->unit_size - 1) / ctx->unit_size;
+        ctx->contents = g_array_sized_new (FALSE, TRUE, sizeof (guint8), ctx->file_size);
+        g_array_set_size (ctx->contents, ctx->file_size);
+        break;
+    case QMI_UIM_FILE_TYPE_CYCLIC:
+    case QMI_UIM_FILE_TYPE_LINEAR_FIXED:
+        ctx->unit_size = ctx->record_size;
+        ctx->n_units = (ctx->record_size > 0) ? record_count : 0;
+        ctx->contents = g_array_sized_new (FALSE, TRUE, sizeof (guint8), ctx->n_units * ctx->unit_size);
+        g_array_set_size (ctx->contents, ctx->n_units * ctx->unit_size);
+        break;
+    case QMI_UIM_FILE_TYPE_DEDICATED_FILE:
+    case QMI_UIM_FILE_TYPE_MASTER_FILE:
+    default:
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_UNSUPPORTED,
+                                 "Cannot read file of type '%s'",
+                                 qmi_uim_file_type_get_string (ctx->file_type));
+        goto out;
+    }
+
+    /* Empty file */
+    if (ctx->n_units == 0) {
+        ctx->completed = TRUE;
+        g_task_return_pointer (task, g_array_ref (ctx->contents), (GDestroyNotify) g_array_unref);
+        goto out;
+    }
+
+    read_file_next (task);
+
+out:
+    if (output)
+        qmi_message_uim_get_file_attributes_output_unref (output);
+    g_object_unref (task);
+}
+
+void
+qmi_client_uim_read_file (QmiClientUim        *self,
+                          QmiUimSessionType    session_type,
+                          const gchar         *application_identifier,
+                          guint16              file_id,
+                          GArray              *file_path,
+                          guint                window,
+                          GCancellable        *cancellable,
+                          GAsyncReadyCallback  callback,
+                          gpointer             user_data)
+{
+    GTask                               *task;
+    ReadFileContext                     *ctx;
+    QmiMessageUimGetFileAttributesInput *input;
+
+    g_return_if_fail (QMI_IS_CLIENT_UIM (self));
+    g_return_if_fail (application_identifier != NULL);
+    g_return_if_fail (file_path != NULL);
+    g_return_if_fail (window > 0);
+
+    ctx = g_slice_new0 (ReadFileContext);
+    ctx->session_type = session_type;
+    ctx->application_identifier = g_strdup (application_identifier);
+    ctx->file_id = file_id;
+    ctx->file_path = g_array_ref (file_path);
+    ctx->window = window;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_task_data (task, ctx, (GDestroyNotify) read_file_context_free);
+
+    input = qmi_message_uim_get_file_attributes_input_new ();
+    qmi_message_uim_get_file_attributes_input_set_session_information (input, session_type, application_identifier, NULL);
+    qmi_message_uim_get_file_attributes_input_set_file (input, file_id, file_path, NULL);
+    qmi_client_uim_get_file_attributes (self,
+                                        input,
+                                        REQUEST_TIMEOUT,
+                                        cancellable,
+                                        (GAsyncReadyCallback) get_file_attributes_ready,
+                                        task);
+    qmi_message_uim_get_file_attributes_input_unref (input);
+}
@@ -0,0 +1,119 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_UIM_READ_FILE_H_
+#define _LIBQMI_GLIB_QMI_UIM_READ_FILE_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "qmi-enums-uim.h"
+#include "qmi-uim.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-uim-read-file
+ * @title: UIM file reading
+ * @short_description: reading of whole files using the UIM service
+ *
+ * Helpers to read whole elementary files from the card, e.g. a phonebook or
+ * the SMS storage, issuing as many UIM Read Record or UIM Read Transparent
+ * requests as needed.
+ */
+
+/**
+ * QMI_UIM_READ_FILE_CHUNK_SIZE:
+ *
+ * Maximum number of bytes requested in each UIM Read Transparent request.
+ *
+ * Since: 1.20
+ */
+#define QMI_UIM_READ_FILE_CHUNK_SIZE 0x400
+
+/**
+ * qmi_client_uim_read_file:
+ * @self: a #QmiClientUim.
+ * @session_type: a #QmiUimSessionType.
+ * @application_identifier: the application identifier, or "" if not required by @session_type.
+ * @file_id: the id of the file.
+ * @file_path: (element-type guint8): the path of the file, as given to UIM Read Record and UIM Read Transparent.
+ * @window: maximum number of read requests in flight, at least 1.
+ * @cancellable: a #GCancellable or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: user data to pass to @callback.
+ *
+ * Asynchronously reads the whole contents of an elementary file.
+ *
+ * The attributes of the file are queried once with UIM Get File Attributes.
+ * Then, every record of a linear fixed or cyclic file is read with UIM Read
+ * Record, or the contents of a transparent file are read with UIM Read
+ * Transparent in chunks of %QMI_UIM_READ_FILE_CHUNK_SIZE bytes. Up to @window
+ * of these requests are kept in flight.
+ *
+ * When the operation is finished, @callback will be called. You can then call
+ * qmi_client_uim_read_file_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_client_uim_read_file (QmiClientUim        *self,
+                               QmiUimSessionType    session_type,
+                               const gchar         *application_identifier,
+                               guint16              file_id,
+                               GArray              *file_path,
+                               guint                window,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data);
+
+/**
+ * qmi_client_uim_read_file_finish:
+ * @self: a #QmiClientUim.
+ * @res: the #GAsyncResult obtained from the #GAsyncReadyCallback passed to qmi_client_uim_read_file().
+ * @file_type: (out) (optional): return location for the #QmiUimFileType of the file, or %NULL.
+ * @record_size: (out) (optional): return location for the size of each record, 0 for transparent files; or %NULL.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an async operation started with qmi_client_uim_read_file().
+ *
+ * For record-based files, the returned buffer contains all records one
+ * after the other, each of them exactly @record_size bytes long, starting
+ * with the first one.
+ *
+ * Returns: (transfer full) (element-type guint8): the contents of the file, or %NULL if @error is set. The returned value should be freed with g_array_unref().
+ *
+ * Since: 1.20
+ */
+GArray *qmi_client_uim_read_file_finish (QmiClientUim    *self,
+                                         GAsyncResult    *res,
+                                         QmiUimFileType  *file_type,
+                                         guint16         *record_size,
+                                         GError         **error);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_UIM_READ_FILE_H_ */
@@ -33,6 +33,7 @@
 
 #include "qmi-utils.h"
 #include "qmi-error-types.h"
+#include "qmi-enum-types.h"
 
 /**
  * SECTION:qmi-utils
@@ -44,40 +45,64 @@
 
 /*****************************************************************************/
 
+static const gchar hex_digits[] = "0123456789ABCDEF";
+
+/* Writes the 3N-1 chars of the hexadecimal representation of the N input
+ * bytes, without a trailing NUL */
+static void
+str_hex_write (gchar        *out,
+               const guint8 *data,
+               gsize         size,
+               gchar         delimiter)
+{
+    gsize i;
+
+    for (i = 0; i < size; i++) {
+        if (i > 0)
+            *(out++) = delimiter;
+        *(out++) = hex_digits[data[i] >> 4];
+        *(out++) = hex_digits[data[i] & 0x0F];
+    }
+}
+
 gchar *
 __qmi_utils_str_hex (gconstpointer mem,
                      gsize size,
                      gchar delimiter)
 {
-    const guint8 *data = mem;
-    gsize i;
-    gsize j;
-    gsize new_str_length;
     gchar *new_str;
 
+    if (!size)
+        return NULL;
+
     /* Get new string length. If input string has N bytes, we need:
      * - 1 byte for last NUL char
      * - 2N bytes for hexadecimal char representation of each byte...
      * - N-1 bytes for the separator ':'
      * So... a total of (1+2N+N-1) = 3N bytes are needed... */
-    new_str_length =  3 * size;
-
-    /* Allocate memory for new array and initialize contents to NUL */
-    new_str = g_malloc0 (new_str_length);
-
-    /* Print hexadecimal representation of each byte... */
-    for (i = 0, j = 0; i < size; i++, j += 3) {
-        /* Print character in output string... */
-        snprintf (&new_str[j], 3, "%02X", data[i]);
-        /* And if needed, add separator */
-        if (i != (size - 1) )
-            new_str[j + 2] = delimiter;
-    }
-
-    /* Set output string */
+    new_str = g_malloc (3 * size);
+    str_hex_write (new_str, mem, size, delimiter);
+    new_str[3 * size - 1] = '\0';
     return new_str;
 }
 
+void
+__qmi_utils_str_hex_append (GString       *str,
+                            gconstpointer  mem,
+                            gsize          size,
+                            gchar          delimiter)
+{
+    gsize len;
+
+    if (!size)
+        return;
+
+    /* Grow the string once, and then write in place */
+    len = str->len;
+    g_string_set_size (str, len + 3 * size - 1);
+    str_hex_write (&str->str[len], mem, size, delimiter);
+}
+
 /*****************************************************************************/
 
 gboolean
@@ -370,6 +395,108 @@ qmi_utils_read_gfloat_from_buffer (const guint8 **buffer,
     *buffer_size = (*buffer_size) - 4;
 }
 
+void
+qmi_utils_read_guint16_array_from_buffer (const guint8 **buffer,
+                                         guint16       *buffer_size,
+                                         QmiEndian      endian,
+                                         guint          n_items,
+                                         guint16       *out)
+{
+    guint i;
+
+    g_assert (out != NULL || n_items == 0);
+    g_assert (buffer != NULL);
+    g_assert (buffer_size != NULL);
+    g_assert (n_items <= (guint)(*buffer_size / 2));
+
+    if (!n_items)
+        return;
+
+    /* Bounds are checked once, and the conversion loops are simple enough
+     * to be vectorized, or removed altogether if no swap is needed */
+    memcpy (out, &((*buffer)[0]), n_items * 2);
+    if (endian == QMI_ENDIAN_BIG) {
+        for (i = 0; i < n_items; i++)
+            out[i] = GUINT16_FROM_BE (out[i]);
+    } else {
+        for (i = 0; i < n_items; i++)
+            out[i] = GUINT16_FROM_LE (out[i]);
+    }
+
+    print_read_bytes_trace ("guint16 array", &(*buffer)[0], out, n_items * 2);
+
+    *buffer = &((*buffer)[n_items * 2]);
+    *buffer_size = (*buffer_size) - (n_items * 2);
+}
+
+void
+qmi_utils_read_guint32_array_from_buffer (const guint8 **buffer,
+                                         guint16       *buffer_size,
+                                         QmiEndian      endian,
+                                         guint          n_items,
+                                         guint32       *out)
+{
+    guint i;
+
+    g_assert (out != NULL || n_items == 0);
+    g_assert (buffer != NULL);
+    g_assert (buffer_size != NULL);
+    g_assert (n_items <= (guint)(*buffer_size / 4));
+
+    if (!n_items)
+        return;
+
+    /* Bounds are checked once, and the conversion loops are simple enough
+     * to be vectorized, or removed altogether if no swap is needed */
+    memcpy (out, &((*buffer)[0]), n_items * 4);
+    if (endian == QMI_ENDIAN_BIG) {
+        for (i = 0; i < n_items; i++)
+            out[i] = GUINT32_FROM_BE (out[i]);
+    } else {
+        for (i = 0; i < n_items; i++)
+            out[i] = GUINT32_FROM_LE (out[i]);
+    }
+
+    print_read_bytes_trace ("guint32 array", &(*buffer)[0], out, n_items * 4);
+
+    *buffer = &((*buffer)[n_items * 4]);
+    *buffer_size = (*buffer_size) - (n_items * 4);
+}
+
+void
+qmi_utils_read_guint64_array_from_buffer (const guint8 **buffer,
+                                         guint16       *buffer_size,
+                                         QmiEndian      endian,
+                                         guint          n_items,
+                                         guint64       *out)
+{
+    guint i;
+
+    g_assert (out != NULL || n_items == 0);
+    g_assert (buffer != NULL);
+    g_assert (buffer_size != NULL);
+    g_assert (n_items <= (guint)(*buffer_size / 8));
+
+    if (!n_items)
+        return;
+
+    /* Bounds are checked once, and the conversion loops are simple enough
+     * to be vectorized, or removed altogether if no swap is needed */
+    memcpy (out, &((*buffer)[0]), n_items * 8);
+    if (endian == QMI_ENDIAN_BIG) {
+        for (i = 0; i < n_items; i++)
+            out[i] = GUINT64_FROM_BE (out[i]);
+    } else {
+        for (i = 0; i < n_items; i++)
+            out[i] = GUINT64_FROM_LE (out[i]);
+    }
+
+    print_read_bytes_trace ("guint64 array", &(*buffer)[0], out, n_items * 8);
+
+    *buffer = &((*buffer)[n_items * 8]);
+    *buffer_size = (*buffer_size) - (n_items * 8);
+}
+
 void
 qmi_utils_write_guint8_to_buffer (guint8  **buffer,
                                   guint16  *buffer_size,
@@ -755,6 +882,80 @@ __qmi_utils_get_driver (const gchar *cdc_wdm_path)
     return driver;
 }
 
+static gchar *
+read_sysfs_attribute (const gchar *dir,
+                      const gchar *attribute)
+{
+    gchar *path;
+    gchar *contents = NULL;
+
+    path = g_build_filename (dir, attribute, NULL);
+    if (g_file_get_contents (path, &contents, NULL, NULL))
+        g_strstrip (contents);
+    g_free (path);
+    return contents;
+}
+
+gchar *
+__qmi_utils_get_device_identity (const gchar *cdc_wdm_path)
+{
+    static const gchar *subsystems[] = { "usbmisc", "usb" };
+    guint  i;
+    gchar *device_basename;
+    gchar *identity = NULL;
+
+    device_basename = g_path_get_basename (cdc_wdm_path);
+
+    for (i = 0; !identity && i < G_N_ELEMENTS (subsystems); i++) {
+        gchar *tmp;
+        gchar *path;
+        gchar *usb_device_path;
+        gchar *vid;
+        gchar *pid;
+        gchar *serial;
+        gchar *revision;
+
+        /* The device link points to the USB interface, and the attributes we
+         * want are in the parent USB device, e.g. for cdc-wdm0:
+         *    $ realpath /sys/class/usbmisc/cdc-wdm0/device/..
+         *    /sys/devices/pci0000:00/0000:00:14.0/usb2/2-3
+         */
+        tmp = g_strdup_printf ("/sys/class/%s/%s/device", subsystems[i], device_basename);
+        path = realpath (tmp, NULL);
+        g_free (tmp);
+
+        if (!path)
+            continue;
+
+        usb_device_path = g_path_get_dirname (path);
+        g_free (path);
+
+        vid      = read_sysfs_attribute (usb_device_path, "idVendor");
+        pid      = read_sysfs_attribute (usb_device_path, "idProduct");
+        serial   = read_sysfs_attribute (usb_device_path, "serial");
+        revision = read_sysfs_attribute (usb_device_path, "bcdDevice");
+
+        /* Serial number and revision are optional */
+        if (vid && pid) {
+            identity = g_strdup_printf ("%s-%s-%s-%s", vid, pid,
+                                        serial   ? serial   : "",
+                                        revision ? revision : "");
+            /* Usable as a file name */
+            g_strcanon (identity, G_CSET_A_2_Z G_CSET_a_2_z G_CSET_DIGITS "-_.", '_');
+        }
+
+        g_free (vid);
+        g_free (pid);
+        g_free (serial);
+        g_free (revision);
+        g_free (usb_device_path);
+    }
+
+    g_free (device_basename);
+
+    return identity;
+}
+
 /*****************************************************************************/
 
 static volatile gint __traces_enabled = FALSE;
@@ -770,3 +971,468 @@ qmi_utils_set_traces_enabled (gboolean enabled)
 {
     g_atomic_int_set (&__traces_enabled, enabled);
 }
+
+static volatile gint __traces_summary_only = FALSE;
+
+gboolean
+qmi_utils_get_traces_summary_only (void)
+{
+    return (gboolean) g_atomic_int_get (&__traces_summary_only);
+}
+
+void
+qmi_utils_set_traces_summary_only (gboolean summary_only)
+{
+    g_atomic_int_set (&__traces_summary_only, summary_only);
+}
+
+/*****************************************************************************/
+
+typedef enum {
+    TRACES_FILTER_DIRECTION_ANY,
+    TRACES_FILTER_DIRECTION_SENT,
+    TRACES_FILTER_DIRECTION_RECEIVED,
+} TracesFilterDirection;
+
+typedef struct {
+    gchar                 *str;
+    /* One bit per service, none set for any service */
+    guint8                 services[256 / 8];
+    gboolean               any_service;
+    /* Message ids, NULL for any message */
+    GArray                *message_ids;
+    GPatternSpec          *device;
+    TracesFilterDirection  direction;
+    guint                  sample;
+    guint                  n_matched;
+} TracesFilter;
+
+G_LOCK_DEFINE_STATIC (traces_filter);
+static TracesFilter *__traces_filter;
+
+static void
+traces_filter_free (TracesFilter *filter)
+{
+    if (filter->message_ids)
+        g_array_unref (filter->message_ids);
+    if (filter->device)
+        g_pattern_spec_free (filter->device);
+    g_free (filter->str);
+    g_slice_free (TracesFilter, filter);
+}
+
+static gboolean
+traces_filter_parse_service (TracesFilter  *filter,
+                             const gchar   *str,
+                             GError       **error)
+{
+    GEnumClass *enum_class;
+    GEnumValue *value;
+    guint64     num;
+    gchar      *end = NULL;
+
+    num = g_ascii_strtoull (str, &end, 0);
+    if (end && end != str && *end == '\0' && num <= 0xFF) {
+        filter->services[num / 8] |= (1 << (num % 8));
+        return TRUE;
+    }
+
+    enum_class = G_ENUM_CLASS (g_type_class_ref (QMI_TYPE_SERVICE));
+    value = g_enum_get_value_by_nick (enum_class, str);
+    if (value && value->value >= 0)
+        filter->services[value->value / 8] |= (1 << (value->value % 8));
+    g_type_class_unref (enum_class);
+
+    if (!value || value->value < 0) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS,
+                     "Invalid service in traces filter: '%s'", str);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean
+traces_filter_parse_item (TracesFilter  *filter,
+                          const gchar   *key,
+                          const gchar   *value,
+                          GError       **error)
+{
+    gchar  **values;
+    guint64  num;
+    gchar   *end = NULL;
+    guint    i;
+
+    if (g_str_equal (key, "service")) {
+        values = g_strsplit (value, ",", -1);
+        for (i = 0; values[i]; i++) {
+            if (!traces_filter_parse_service (filter, values[i], error)) {
+                g_strfreev (values);
+                return FALSE;
+            }
+        }
+        g_strfreev (values);
+        filter->any_service = FALSE;
+        return TRUE;
+    }
+
+    if (g_str_equal (key, "message")) {
+        if (!filter->message_ids)
+            filter->message_ids = g_array_new (FALSE, FALSE, sizeof (guint16));
+        values = g_strsplit (value, ",", -1);
+        for (i = 0; values[i]; i++) {
+            guint16 message_id;
+
+            num = g_ascii_strtoull (values[i], &end, 0);
+            if (!end || end == values[i] || *end != '\0' || num > G_MAXUINT16) {
+                g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS,
+                             "Invalid message id in traces filter: '%s'", values[i]);
+                g_strfreev (values);
+                return FALSE;
+            }
+            message_id = (guint16) num;
+            g_array_append_val (filter->message_ids, message_id);
+        }
+        g_strfreev (values);
+        return TRUE;
+    }
+
+    if (g_str_equal (key, "device")) {
+        if (filter->device)
+            g_pattern_spec_free (filter->device);
+        filter->device = g_pattern_spec_new (value);
+        return TRUE;
+    }
+
+    if (g_str_equal (key, "direction")) {
+        if (g_str_equal (value, "sent"))
+            filter->direction = TRACES_FILTER_DIRECTION_SENT;
+        else if (g_str_equal (value, "received"))
+            filter->direction = TRACES_FILTER_DIRECTION_RECEIVED;
+        else if (g_str_equal (value, "any"))
+            filter->direction = TRACES_FILTER_DIRECTION_ANY;
+        else {
+            g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS,
+                         "Invalid direction in traces filter: '%s'", value);
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    if (g_str_equal (key, "sample")) {
+        num = g_ascii_strtoull (value, &end, 10);
+        if (!end || end == value || *end != '\0' || num == 0 || num > G_MAXUINT) {
+            g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS,
+                         "Invalid sample rate in traces filter: '%s'", value);
+            return FALSE;
+        }
+        filter->sample = (guint) num;
+        return TRUE;
+    }
+
+    g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS,
+                 "Unknown key in traces filter: '%s'", key);
+    return FALSE;
+}
+
+static TracesFilter *
+traces_filter_new (const gchar  *str,
+                   GError      **error)
+{
+    TracesFilter  *filter;
+    gchar        **items;
+    guint          i;
+
+    filter = g_slice_new0 (TracesFilter);
+    filter->str = g_strdup (str);
+    filter->any_service = TRUE;
+    filter->sample = 1;
+
+    items = g_strsplit (str, ";", -1);
+    for (i = 0; items[i]; i++) {
+        gchar *item;
+        gchar *value;
+
+        item = g_strstrip (items[i]);
+        if (!item[0])
+            continue;
+
+        value = strchr (item, '=');
+        if (!value) {
+            g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS,
+                         "Invalid item in traces filter: '%s'", item);
+            break;
+        }
+        *(value++) = '\0';
+
+        if (!traces_filter_parse_item (filter, g_strstrip (item), g_strstrip (value), error))
+            break;
+    }
+
+    if (items[i]) {
+        g_strfreev (items);
+        traces_filter_free (filter);
+        return NULL;
+    }
+
+    g_strfreev (items);
+    return filter;
+}
+
+static void
+traces_filter_replace (TracesFilter *filter)
+{
+    TracesFilter *old_filter;
+
+    G_LOCK (traces_filter);
+    old_filter = __traces_filter;
+    __traces_filter = filter;
+    G_UNLOCK (traces_filter);
+
+    if (old_filter)
+        traces_filter_free (old_filter);
+}
+
+static void
+traces_filter_init (void)
+{
+    static gsize initialized = 0;
+
+    /* The environment is only checked once, before the filter is first
+     * used or set */
+    if (g_once_init_enter (&initialized)) {
+        const gchar *str;
+
+        str = g_getenv ("LIBQMI_TRACES_FILTER");
+        if (str && str[0]) {
+            TracesFilter *filter;
+            GError       *error = NULL;
+
+            filter = traces_filter_new (str, &error);
+            if (filter)
+                traces_filter_replace (filter);
+            else {
+                g_warning ("Ignoring LIBQMI_TRACES_FILTER: %s", error->message);
+                g_error_free (error);
+            }
+        }
+        g_once_init_leave (&initialized, 1);
+    }
+}
+
+gboolean
+qmi_utils_set_traces_filter (const gchar  *filter,
+                             GError      **error)
+{
+    TracesFilter *new_filter = NULL;
+
+    traces_filter_init ();
+
+    if (filter && filter[0]) {
+        new_filter = traces_filter_new (filter, error);
+        if (!new_filter)
+            return FALSE;
+    }
+
+    traces_filter_replace (new_filter);
+    return TRUE;
+}
+
+gchar *
+qmi_utils_get_traces_filter (void)
+{
+    gchar *str = NULL;
+
+    traces_filter_init ();
+
+    G_LOCK (traces_filter);
+    if (__traces_filter)
+        str = g_strdup (__traces_filter->str);
+    G_UNLOCK (traces_filter);
+
+    return str;
+}
+
+gboolean
+qmi_utils_traces_filter_check (const gchar *path,
+                               QmiService   service,
+                               guint16      message_id,
+                               gboolean     sent)
+{
+    TracesFilter *filter;
+    gboolean      match = FALSE;
+
+    traces_filter_init ();
+
+    G_LOCK (traces_filter);
+
+    filter = __traces_filter;
+    if (!filter) {
+        match = TRUE;
+        goto out;
+    }
+
+    if (!filter->any_service &&
+        (service < 0 || service > 0xFF || !(filter->services[service / 8] & (1 << (service % 8)))))
+        goto out;
+
+    if (filter->message_ids) {
+        guint i;
+
+        for (i = 0; i < filter->message_ids->len; i++) {
+            if (g_array_index (filter->message_ids, guint16, i) == message_id)
+                break;
+        }
+        if (i == filter->message_ids->len)
+            goto out;
+    }
+
+    if ((filter->direction == TRACES_FILTER_DIRECTION_SENT && !sent) ||
+        (filter->direction == TRACES_FILTER_DIRECTION_RECEIVED && sent))
+        goto out;
+
+    if (filter->device && (!path || !g_pattern_match_string (filter->device, path)))
+        goto out;
+
+    /* Only one of every 'sample' matching messages */
+    match = ((filter->n_matched++ % filter->sample) == 0);
+
+out:
+    G_UNLOCK (traces_filter);
+    return match;
+}
+
+/*****************************************************************************/
+
+static volatile gint __accounting_enabled = FALSE;
+static volatile gint __live_objects[QMI_UTILS_LIVE_OBJECT_LAST];
+
+static gboolean
+accounting_enabled (void)
+{
+    static gsize initialized = 0;
+
+    /* The environment is only checked once, before the first object */
+    if (g_once_init_enter (&initialized)) {
+        if (g_getenv ("LIBQMI_ACCOUNTING"))
+            g_atomic_int_set (&__accounting_enabled, TRUE);
+        g_once_init_leave (&initialized, 1);
+    }
+
+    return (gboolean) g_atomic_int_get (&__accounting_enabled);
+}
+
+gboolean
+qmi_utils_get_accounting_enabled (void)
+{
+    return accounting_enabled ();
+}
+
+void
+qmi_utils_set_accounting_enabled (gboolean enabled)
+{
+    /* Don't let a later environment check override this */
+    accounting_enabled ();
+    g_atomic_int_set (&__accounting_enabled, enabled);
+}
+
+void
+qmi_utils_get_live_objects (QmiUtilsLiveObjects *live)
+{
+    g_return_if_fail (live != NULL);
+
+    live->messages       = g_atomic_int_get (&__live_objects[QMI_UTILS_LIVE_OBJECT_MESSAGE]);
+    live->containers     = g_atomic_int_get (&__live_objects[QMI_UTILS_LIVE_OBJECT_CONTAINER]);
+    live->transactions   = g_atomic_int_get (&__live_objects[QMI_UTILS_LIVE_OBJECT_TRANSACTION]);
+    live->proxy_clients  = g_atomic_int_get (&__live_objects[QMI_UTILS_LIVE_OBJECT_PROXY_CLIENT]);
+    live->proxy_requests = g_atomic_int_get (&__live_objects[QMI_UTILS_LIVE_OBJECT_PROXY_REQUEST]);
+}
+
+void
+__qmi_utils_live_object_add (QmiUtilsLiveObject object,
+                             gint               delta)
+{
+    if (G_LIKELY (!accounting_enabled ()))
+        return;
+
+    g_atomic_int_add (&__live_objects[object], delta);
+}
+
+/*****************************************************************************/
+
+/* Different strings interned at most, as they're never freed */
+#define INTERNED_STRINGS_MAX 4096
+
+typedef struct {
+    const gchar *str;
+    gsize        len;
+} InternedString;
+
+static volatile gint  __string_interning = FALSE;
+G_LOCK_DEFINE_STATIC (interned_strings);
+static GHashTable    *__interned_strings;
+
+static guint
+interned_string_hash (const InternedString *key)
+{
+    guint hash = 5381;
+    gsize i;
+
+    for (i = 0; i < key->len; i++)
+        hash = (hash << 5) + hash + (guint8) key->str[i];
+    return hash;
+}
+
+static gboolean
+interned_string_equal (const InternedString *a,
+                       const InternedString *b)
+{
+    return (a->len == b->len && memcmp (a->str, b->str, a->len) == 0);
+}
+
+gboolean
+qmi_utils_get_string_interning (void)
+{
+    return (gboolean) g_atomic_int_get (&__string_interning);
+}
+
+void
+qmi_utils_set_string_interning (gboolean enabled)
+{
+    g_atomic_int_set (&__string_interning, enabled);
+}
+
+const gchar *
+__qmi_utils_intern_string (const gchar *data,
+                           gsize        len)
+{
+    InternedString  lookup;
+    InternedString *interned;
+
+    if (G_LIKELY (!g_atomic_int_get (&__string_interning)))
+        return NULL;
+
+    lookup.str = data;
+    lookup.len = len;
+
+    G_LOCK (interned_strings);
+    if (G_UNLIKELY (!__interned_strings))
+        __interned_strings = g_hash_table_new ((GHashFunc) interned_string_hash,
+                                               (GEqualFunc) interned_string_equal);
+
+    interned = g_hash_table_lookup (__interned_strings, &lookup);
+    if (!interned && g_hash_table_size (__interned_strings) < INTERNED_STRINGS_MAX) {
+        gchar *str;
+
+        /* Key and string in a single allocation, never freed */
+        interned = g_malloc (sizeof (InternedString) + len + 1);
+        str = (gchar *) (interned + 1);
+        memcpy (str, data, len);
+        str[len] = '\0';
+        interned->str = str;
+        interned->len = len;
+        g_hash_table_add (__interned_strings, interned);
+    }
+    G_UNLOCK (interned_strings);
+
+    return (interned ? interned->str : NULL);
+}
@@ -31,6 +31,8 @@
 
 #include <glib.h>
 
+#include "qmi-enums.h"
+
 G_BEGIN_DECLS
 
 /**
@@ -300,6 +302,87 @@ void qmi_utils_read_gfloat_from_buffer  (const guint8 **buffer,
                                          guint16       *buffer_size,
                                          gfloat        *out);
 
+/**
+ * qmi_utils_read_guint16_array_from_buffer:
+ * @buffer: a buffer with raw binary data.
+ * @buffer_size: size of @buffer.
+ * @endian: endianness of firmware values; swapped to host byte order if necessary
+ * @n_items: number of items to read.
+ * @out: return location for the read items, with room for at least @n_items.
+ *
+ * Reads @n_items unsigned 16-bit integers from the buffer at once. The
+ * numbers in the buffer are expected to be given in the byte order specified by
+ * @endian, and this method takes care of converting them to the proper host
+ * endianness.
+ *
+ * The user needs to make sure that at least @n_items * 2 bytes are available
+ * in the buffer.
+ *
+ * Also note that both @buffer and @buffer_size get updated after the bytes
+ * read.
+ *
+ * Since: 1.20
+ */
+void qmi_utils_read_guint16_array_from_buffer (const guint8 **buffer,
+                                              guint16       *buffer_size,
+                                              QmiEndian      endian,
+                                              guint          n_items,
+                                              guint16       *out);
+
+/**
+ * qmi_utils_read_guint32_array_from_buffer:
+ * @buffer: a buffer with raw binary data.
+ * @buffer_size: size of @buffer.
+ * @endian: endianness of firmware values; swapped to host byte order if necessary
+ * @n_items: number of items to read.
+ * @out: return location for the read items, with room for at least @n_items.
+ *
+ * Reads @n_items unsigned 32-bit integers from the buffer at once. The
+ * numbers in the buffer are expected to be given in the byte order specified by
+ * @endian, and this method takes care of converting them to the proper host
+ * endianness.
+ *
+ * The user needs to make sure that at least @n_items * 4 bytes are available
+ * in the buffer.
+ *
+ * Also note that both @buffer and @buffer_size get updated after the bytes
+ * read.
+ *
+ * Since: 1.20
+ */
+void qmi_utils_read_guint32_array_from_buffer (const guint8 **buffer,
+                                              guint16       *buffer_size,
+                                              QmiEndian      endian,
+                                              guint          n_items,
+                                              guint32       *out);
+
+/**
+ * qmi_utils_read_guint64_array_from_buffer:
+ * @buffer: a buffer with raw binary data.
+ * @buffer_size: size of @buffer.
+ * @endian: endianness of firmware values; swapped to host byte order if necessary
+ * @n_items: number of items to read.
+ * @out: return location for the read items, with room for at least @n_items.
+ *
+ * Reads @n_items unsigned 64-bit integers from the buffer at once. The
+ * numbers in the buffer are expected to be given in the byte order specified by
+ * @endian, and this method takes care of converting them to the proper host
+ * endianness.
+ *
+ * The user needs to make sure that at least @n_items * 8 bytes are available
+ * in the buffer.
+ *
+ * Also note that both @buffer and @buffer_size get updated after the bytes
+ * read.
+ *
+ * Since: 1.20
+ */
+void qmi_utils_read_guint64_array_from_buffer (const guint8 **buffer,
+                                              guint16       *buffer_size,
+                                              QmiEndian      endian,
+                                              guint          n_items,
+                                              guint64       *out);
+
 /**
  * qmi_utils_write_guint8_to_buffer:
  * @buffer: a buffer.
@@ -639,6 +722,189 @@ gboolean qmi_utils_get_traces_enabled (void);
  */
 void qmi_utils_set_traces_enabled (gboolean enabled);
 
+/**
+ * qmi_utils_get_traces_summary_only:
+ *
+ * Checks whether QMI message traces, when enabled, only report a one-line
+ * summary of each message.
+ *
+ * Returns: %TRUE if only summaries are traced, %FALSE otherwise.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_utils_get_traces_summary_only (void);
+
+/**
+ * qmi_utils_set_traces_summary_only:
+ * @summary_only: %TRUE to trace only a summary of each message, %FALSE to trace the full contents.
+ *
+ * Sets whether QMI message traces, when enabled, only report the service,
+ * message, transaction and result of each message, instead of the full raw
+ * and translated contents.
+ *
+ * Since: 1.20
+ */
+void qmi_utils_set_traces_summary_only (gboolean summary_only);
+
+/**
+ * qmi_utils_set_traces_filter:
+ * @filter: (nullable): the filter, or %NULL to trace all messages.
+ * @error: Return location for error or %NULL.
+ *
+ * Sets which messages are traced when traces are enabled, so that the cost of
+ * formatting them is only paid for the ones of interest. The filter does not
+ * apply to the records given to the #QmiDeviceTraceFn of each #QmiDevice.
+ *
+ * The filter is a list of 'key=value' items separated by ';', all of which
+ * must match for the message to be traced:
+ * <itemizedlist>
+ * <listitem><para>'service': comma-separated list of service names (e.g. 'wds') or numbers.</para></listitem>
+ * <listitem><para>'message': comma-separated list of message ids, in decimal or in hexadecimal with a '0x' prefix.</para></listitem>
+ * <listitem><para>'device': pattern of the device path, with '*' and '?' wildcards.</para></listitem>
+ * <listitem><para>'direction': either 'sent', 'received' or 'any'.</para></listitem>
+ * <listitem><para>'sample': trace only one of every N messages otherwise matching the filter.</para></listitem>
+ * </itemizedlist>
+ *
+ * E.g. 'service=wds;device=/dev/cdc-wdm3;direction=sent'.
+ *
+ * The filter may also be given in the LIBQMI_TRACES_FILTER environment
+ * variable, read before the first message is traced.
+ *
+ * Returns: %TRUE if the filter is set, %FALSE if @error is set and the previous filter is kept.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_utils_set_traces_filter (const gchar  *filter,
+                                      GError      **error);
+
+/**
+ * qmi_utils_get_traces_filter:
+ *
+ * Gets the filter of the traced messages, as given to
+ * qmi_utils_set_traces_filter().
+ *
+ * Returns: (transfer full) (nullable): the filter, or %NULL if all messages are traced. The returned value should be freed with g_free().
+ *
+ * Since: 1.20
+ */
+gchar *qmi_utils_get_traces_filter (void);
+
+/**
+ * qmi_utils_traces_filter_check:
+ * @path: (nullable): the path of the device.
+ * @service: a #QmiService.
+ * @message_id: the message id.
+ * @sent: %TRUE if the message is sent to the device, %FALSE if received from it.
+ *
+ * Checks whether a message passes the filter set with
+ * qmi_utils_set_traces_filter(), e.g. to apply the same filter to custom
+ * traces. Each message passing all the other conditions of the filter counts
+ * for its 'sample' rate.
+ *
+ * Returns: %TRUE if the message should be traced, %FALSE otherwise.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_utils_traces_filter_check (const gchar *path,
+                                        QmiService   service,
+                                        guint16      message_id,
+                                        gboolean     sent);
+
+/* Live object accounting */
+
+/**
+ * QmiUtilsLiveObjects:
+ * @messages: references to #QmiMessage values, taken with the #QmiMessage constructors and qmi_message_ref() and not yet released with qmi_message_unref().
+ * @containers: input, output and indication output containers of the generated message API.
+ * @transactions: requests of a #QmiDevice waiting for their response.
+ * @proxy_clients: clients connected to a #QmiProxy.
+ * @proxy_requests: requests of the clients of a #QmiProxy waiting for their response.
+ *
+ * Counts of live objects of libqmi-glib, as given by qmi_utils_get_live_objects().
+ *
+ * Objects are only accounted while accounting is enabled, so the counts are
+ * only meaningful as differences between two snapshots taken while enabled,
+ * e.g. to see whether a workload that should leave the state unchanged
+ * leaves objects behind.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    gint messages;
+    gint containers;
+    gint transactions;
+    gint proxy_clients;
+    gint proxy_requests;
+} QmiUtilsLiveObjects;
+
+/**
+ * qmi_utils_get_accounting_enabled:
+ *
+ * Checks whether live objects are currently accounted. Accounting is disabled
+ * by default, unless the LIBQMI_ACCOUNTING environment variable is set.
+ *
+ * Returns: %TRUE if accounting is enabled, %FALSE otherwise.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_utils_get_accounting_enabled (void);
+
+/**
+ * qmi_utils_set_accounting_enabled:
+ * @enabled: %TRUE to enable accounting, %FALSE to disable it.
+ *
+ * Sets whether live objects are accounted. This should be done before any
+ * object is created, otherwise releasing the objects created before will make
+ * the counts decrease.
+ *
+ * Since: 1.20
+ */
+void qmi_utils_set_accounting_enabled (gboolean enabled);
+
+/**
+ * qmi_utils_get_live_objects:
+ * @live: (out caller-allocates): return location for the #QmiUtilsLiveObjects.
+ *
+ * Gets a snapshot of the counts of live objects.
+ *
+ * Since: 1.20
+ */
+void qmi_utils_get_live_objects (QmiUtilsLiveObjects *live);
+
+/* String interning */
+
+/**
+ * qmi_utils_get_string_interning:
+ *
+ * Checks whether the strings read from the outputs of the generated message
+ * API are currently interned.
+ *
+ * Returns: %TRUE if string interning is enabled, %FALSE otherwise.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_utils_get_string_interning (void);
+
+/**
+ * qmi_utils_set_string_interning:
+ * @enabled: %TRUE to enable string interning, %FALSE to disable it.
+ *
+ * Sets whether the strings read from the outputs of the generated message
+ * API are interned. Interning is disabled by default.
+ *
+ * When enabled, the string getters of the outputs (e.g. operator names, APNs
+ * or revision strings) return one single shared copy of each different
+ * string, which is never freed, instead of a copy owned by the output. The
+ * strings returned for the same contents are therefore the same pointer, and
+ * repeated requests returning the same values don't allocate new strings.
+ *
+ * Only a limited number of different strings are interned; once the limit is
+ * reached, new strings are copied as when interning is disabled.
+ *
+ * Since: 1.20
+ */
+void qmi_utils_set_string_interning (gboolean enabled);
+
 /* Other private methods */
 
 #if defined (LIBQMI_GLIB_COMPILATION)
@@ -647,10 +913,36 @@ gchar *__qmi_utils_str_hex (gconstpointer mem,
                             gsize size,
                             gchar delimiter);
 G_GNUC_INTERNAL
+void __qmi_utils_str_hex_append (GString *str,
+                                 gconstpointer mem,
+                                 gsize size,
+                                 gchar delimiter);
+G_GNUC_INTERNAL
 gboolean __qmi_user_allowed (uid_t uid,
                              GError **error);
 G_GNUC_INTERNAL
 gchar *__qmi_utils_get_driver (const gchar *cdc_wdm_path);
+G_GNUC_INTERNAL
+gchar *__qmi_utils_get_device_identity (const gchar *cdc_wdm_path);
+
+typedef enum {
+    QMI_UTILS_LIVE_OBJECT_MESSAGE,
+    QMI_UTILS_LIVE_OBJECT_CONTAINER,
+    QMI_UTILS_LIVE_OBJECT_TRANSACTION,
+    QMI_UTILS_LIVE_OBJECT_PROXY_CLIENT,
+    QMI_UTILS_LIVE_OBJECT_PROXY_REQUEST,
+    QMI_UTILS_LIVE_OBJECT_LAST
+} QmiUtilsLiveObject;
+
+/* No-op unless accounting is enabled */
+G_GNUC_INTERNAL
+void __qmi_utils_live_object_add (QmiUtilsLiveObject object,
+                                  gint               delta);
+
+/* NULL unless interning is enabled and the string can be interned */
+G_GNUC_INTERNAL
+const gchar *__qmi_utils_intern_string (const gchar *data,
+                                        gsize        len);
 #endif
 
 G_END_DECLS
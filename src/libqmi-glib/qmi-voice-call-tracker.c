@@ -0,0 +1,537 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "qmi-voice-call-tracker.h"
+
+G_DEFINE_TYPE (QmiVoiceCallTracker, qmi_voice_call_tracker, G_TYPE_OBJECT)
+
+#define ALL_CALL_STATUS_INDICATION_ID 0x002E
+
+/* VOICE All Call Status indication TLVs */
+#define ALL_CALL_STATUS_TLV_CALL_INFORMATION    0x01
+#define ALL_CALL_STATUS_TLV_REMOTE_PARTY_NUMBER 0x10
+
+/* ID, state, type, direction, mode, multipart indicator and ALS */
+#define CALL_INFORMATION_ELEMENT_SIZE 7
+
+/* ID, presentation indicator, and the number with a 1-byte length prefix */
+#define REMOTE_PARTY_NUMBER_HEADER_SIZE 3
+
+enum {
+    PROP_0,
+    PROP_CLIENT,
+    PROP_LAST
+};
+
+enum {
+    SIGNAL_CALL_ADDED,
+    SIGNAL_CALL_UPDATED,
+    SIGNAL_CALL_ENDED,
+    SIGNAL_LAST
+};
+
+static GParamSpec *properties[PROP_LAST];
+static guint       signals[SIGNAL_LAST] = { 0 };
+
+typedef struct {
+    QmiVoiceCallTrackerCall call;
+    /* Last indication reporting the call, 0 once ended */
+    guint                   generation;
+} Entry;
+
+typedef struct {
+    guint             signal;
+    guint8            id;
+    QmiVoiceCallState previous_state;
+} Event;
+
+struct _QmiVoiceCallTrackerPrivate {
+    QmiClientVoice *client;
+    guint           all_call_status_id;
+
+    /* Calls in the order they were added, and their index (plus one) in the
+     * array by call ID */
+    GArray *entries;
+    guint16 index_by_id[G_MAXUINT8 + 1];
+    guint   generation;
+
+    /* Remote party numbers of the indication being processed, by call ID;
+     * only the entries set are cleared afterwards */
+    const guint8 *numbers[G_MAXUINT8 + 1];
+};
+
+/*****************************************************************************/
+
+QmiClientVoice *
+qmi_voice_call_tracker_peek_client (QmiVoiceCallTracker *self)
+{
+    g_return_val_if_fail (QMI_IS_VOICE_CALL_TRACKER (self), NULL);
+
+    return self->priv->client;
+}
+
+guint
+qmi_voice_call_tracker_get_n_calls (QmiVoiceCallTracker *self)
+{
+    g_return_val_if_fail (QMI_IS_VOICE_CALL_TRACKER (self), 0);
+
+    return self->priv->entries->len;
+}
+
+const QmiVoiceCallTrackerCall *
+qmi_voice_call_tracker_peek_call (QmiVoiceCallTracker *self,
+                                  guint                index)
+{
+    g_return_val_if_fail (QMI_IS_VOICE_CALL_TRACKER (self), NULL);
+
+    if (index >= self->priv->entries->len)
+        return NULL;
+    return &g_array_index (self->priv->entries, Entry, index).call;
+}
+
+const QmiVoiceCallTrackerCall *
+qmi_voice_call_tracker_peek_call_by_id (QmiVoiceCallTracker *self,
+                                        guint8               id)
+{
+    guint index;
+
+    g_return_val_if_fail (QMI_IS_VOICE_CALL_TRACKER (self), NULL);
+
+    index = self->priv->index_by_id[id];
+    if (!index)
+        return NULL;
+    return &g_array_index (self->priv->entries, Entry, index - 1).call;
+}
+
+/*****************************************************************************/
+
+static gboolean
+numbers_load (QmiVoiceCallTracker *self,
+              QmiMessage          *message,
+              const guint8        *set[],
+              guint               *n_set)
+{
+    const guint8 *raw;
+    const guint8 *walker;
+    const guint8 *end;
+    guint16       raw_length = 0;
+    guint         n;
+    guint         i;
+
+    *n_set = 0;
+
+    raw = qmi_message_get_raw_tlv (message, ALL_CALL_STATUS_TLV_REMOTE_PARTY_NUMBER, &raw_length);
+    if (!raw)
+        return TRUE;
+    if (raw_length < 1)
+        return FALSE;
+
+    end = raw + raw_length;
+    walker = raw + 1;
+    n = raw[0];
+    for (i = 0; i < n; i++) {
+        if (end - walker < REMOTE_PARTY_NUMBER_HEADER_SIZE ||
+            end - walker - REMOTE_PARTY_NUMBER_HEADER_SIZE < walker[2])
+            break;
+        if (!self->priv->numbers[walker[0]])
+            set[(*n_set)++] = walker;
+        self->priv->numbers[walker[0]] = walker;
+        walker += REMOTE_PARTY_NUMBER_HEADER_SIZE + walker[2];
+    }
+
+    return (i == n);
+}
+
+static void
+numbers_clear (QmiVoiceCallTracker *self,
+               const guint8        *set[],
+               guint                n_set)
+{
+    guint i;
+
+    for (i = 0; i < n_set; i++)
+        self->priv->numbers[set[i][0]] = NULL;
+}
+
+static void
+call_load (QmiVoiceCallTracker     *self,
+           const guint8            *info,
+           QmiVoiceCallTrackerCall *call)
+{
+    const guint8 *number;
+
+    call->id = info[0];
+    call->state = (QmiVoiceCallState) info[1];
+    call->type = (QmiVoiceCallType) info[2];
+    call->direction = (QmiVoiceCallDirection) info[3];
+    call->mode = (QmiVoiceCallMode) info[4];
+    call->multipart_indicator = !!info[5];
+    call->als = (QmiVoiceAls) info[6];
+
+    /* If not given, the previous number is kept */
+    number = self->priv->numbers[call->id];
+    if (number) {
+        call->presentation = (QmiVoicePresentation) number[1];
+        memcpy (call->number, &number[REMOTE_PARTY_NUMBER_HEADER_SIZE], number[2]);
+        call->number[number[2]] = '\0';
+    }
+}
+
+static void
+entries_rebuild_index (QmiVoiceCallTracker *self,
+                       guint                from)
+{
+    guint i;
+
+    for (i = from; i < self->priv->entries->len; i++)
+        self->priv->index_by_id[g_array_index (self->priv->entries, Entry, i).call.id] = i + 1;
+}
+
+static void
+all_call_status_indication_cb (QmiClient           *client,
+                               QmiMessage          *message,
+                               QmiVoiceCallTracker *self)
+{
+    const guint8 *raw;
+    const guint8 *numbers_set[G_MAXUINT8];
+    guint16       raw_length = 0;
+    guint         n_numbers_set = 0;
+    Event         events[2 * (G_MAXUINT8 + 1)];
+    guint         first_removed;
+    guint         n_events = 0;
+    guint         n;
+    guint         i;
+
+    raw = qmi_message_get_raw_tlv (message, ALL_CALL_STATUS_TLV_CALL_INFORMATION, &raw_length);
+    if (!raw || raw_length < 1 || (gsize) raw_length < 1 + (gsize) raw[0] * CALL_INFORMATION_ELEMENT_SIZE) {
+        g_debug ("ignoring invalid all call status indication: wrong call information");
+        return;
+    }
+    if (!numbers_load (self, message, numbers_set, &n_numbers_set)) {
+        g_debug ("ignoring invalid all call status indication: wrong remote party number");
+        numbers_clear (self, numbers_set, n_numbers_set);
+        return;
+    }
+
+    if (++self->priv->generation == 0)
+        self->priv->generation = 1;
+
+    /* Merge the reported calls into the table */
+    n = raw[0];
+    for (i = 0; i < n; i++) {
+        const guint8            *info;
+        guint                    index;
+        Entry                   *entry;
+        QmiVoiceCallTrackerCall  call;
+
+        info = &raw[1 + i * CALL_INFORMATION_ELEMENT_SIZE];
+        index = self->priv->index_by_id[info[0]];
+
+        if (!index) {
+            Entry new_entry;
+
+            /* Ended before we knew about it */
+            if (info[1] == QMI_VOICE_CALL_STATE_END)
+                continue;
+
+            memset (&new_entry, 0, sizeof (new_entry));
+            call_load (self, info, &new_entry.call);
+            new_entry.generation = self->priv->generation;
+            g_array_append_val (self->priv->entries, new_entry);
+            self->priv->index_by_id[info[0]] = self->priv->entries->len;
+
+            events[n_events].signal = signals[SIGNAL_CALL_ADDED];
+            events[n_events].id = info[0];
+            n_events++;
+            continue;
+        }
+
+        entry = &g_array_index (self->priv->entries, Entry, index - 1);
+        /* Duplicated in the same indication */
+        if (entry->generation == self->priv->generation || entry->generation == 0)
+            continue;
+
+        memcpy (&call, &entry->call, sizeof (call));
+        call_load (self, info, &call);
+        entry->generation = (call.state == QMI_VOICE_CALL_STATE_END ? 0 : self->priv->generation);
+
+        if (call.state == QMI_VOICE_CALL_STATE_END) {
+            entry->call = call;
+            events[n_events].signal = signals[SIGNAL_CALL_ENDED];
+            events[n_events].id = info[0];
+            n_events++;
+        } else if (memcmp (&call, &entry->call, sizeof (call)) != 0) {
+            events[n_events].signal = signals[SIGNAL_CALL_UPDATED];
+            events[n_events].id = info[0];
+            events[n_events].previous_state = entry->call.state;
+            n_events++;
+            entry->call = call;
+        }
+    }
+
+    numbers_clear (self, numbers_set, n_numbers_set);
+
+    /* Calls no longer reported are gone as well */
+    for (i = 0; i < self->priv->entries->len; i++) {
+        Entry *entry;
+
+        entry = &g_array_index (self->priv->entries, Entry, i);
+        if (entry->generation != self->priv->generation && entry->generation != 0) {
+            entry->generation = 0;
+            events[n_events].signal = signals[SIGNAL_CALL_ENDED];
+            events[n_events].id = entry->call.id;
+            n_events++;
+        }
+    }
+
+    if (!n_events)
+        return;
+
+    /* Ended calls are kept in the table while the signals are emitted, so
+     * that all the calls referred to are valid for the handlers */
+    g_object_ref (self);
+    for (i = 0; i < n_events; i++) {
+        const QmiVoiceCallTrackerCall *call;
+
+        call = qmi_voice_call_tracker_peek_call_by_id (self, events[i].id);
+        if (events[i].signal == signals[SIGNAL_CALL_UPDATED])
+            g_signal_emit (self, events[i].signal, 0, call, events[i].previous_state);
+        else
+            g_signal_emit (self, events[i].signal, 0, call);
+    }
+
+    first_removed = self->priv->entries->len;
+    for (i = self->priv->entries->len; i > 0; i--) {
+        Entry *entry;
+
+        entry = &g_array_index (self->priv->entries, Entry, i - 1);
+        if (entry->generation == 0) {
+            self->priv->index_by_id[entry->call.id] = 0;
+            g_array_remove_index (self->priv->entries, i - 1);
+            first_removed = i - 1;
+        }
+    }
+    entries_rebuild_index (self, first_removed);
+    g_object_unref (self);
+}
+
+/*****************************************************************************/
+
+QmiVoiceCallTracker *
+qmi_voice_call_tracker_new (QmiClientVoice *client)
+{
+    g_return_val_if_fail (QMI_IS_CLIENT_VOICE (client), NULL);
+
+    return QMI_VOICE_CALL_TRACKER (g_object_new (QMI_TYPE_VOICE_CALL_TRACKER,
+                                                 QMI_VOICE_CALL_TRACKER_CLIENT, client,
+                                                 NULL));
+}
+
+static void
+set_property (GObject      *object,
+              guint         prop_id,
+              const GValue *value,
+              GParamSpec   *pspec)
+{
+    QmiVoiceCallTracker *self = QMI_VOICE_CALL_TRACKER (object);
+
+    switch (prop_id) {
+    case PROP_CLIENT:
+        g_assert (self->priv->client == NULL);
+        self->priv->client = g_value_dup_object (value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+get_property (GObject    *object,
+              guint       prop_id,
+              GValue     *value,
+              GParamSpec *pspec)
+{
+    QmiVoiceCallTracker *self = QMI_VOICE_CALL_TRACKER (object);
+
+    switch (prop_id) {
+    case PROP_CLIENT:
+        g_value_set_object (value, self->priv->client);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+constructed (GObject *object)
+{
+    QmiVoiceCallTracker *self = QMI_VOICE_CALL_TRACKER (object);
+
+    G_OBJECT_CLASS (qmi_voice_call_tracker_parent_class)->constructed (object);
+
+    /* Indications are read as raw messages, they are never fully parsed */
+    if (self->priv->client)
+        self->priv->all_call_status_id =
+            qmi_client_add_indication_callback (QMI_CLIENT (self->priv->client),
+                                                ALL_CALL_STATUS_INDICATION_ID,
+                                                (QmiClientIndicationCallback) all_call_status_indication_cb,
+                                                self,
+                                                NULL);
+}
+
+static void
+qmi_voice_call_tracker_init (QmiVoiceCallTracker *self)
+{
+    self->priv = G_TYPE_INSTANCE_GET_PRIVATE ((self),
+                                              QMI_TYPE_VOICE_CALL_TRACKER,
+                                              QmiVoiceCallTrackerPrivate);
+
+    self->priv->entries = g_array_new (FALSE, FALSE, sizeof (Entry));
+}
+
+static void
+dispose (GObject *object)
+{
+    QmiVoiceCallTracker *self = QMI_VOICE_CALL_TRACKER (object);
+
+    if (self->priv->client) {
+        if (self->priv->all_call_status_id) {
+            qmi_client_remove_indication_callback (QMI_CLIENT (self->priv->client), self->priv->all_call_status_id);
+            self->priv->all_call_status_id = 0;
+        }
+        g_clear_object (&self->priv->client);
+    }
+
+    G_OBJECT_CLASS (qmi_voice_call_tracker_parent_class)->dispose (object);
+}
+
+static void
+finalize (GObject *object)
+{
+    QmiVoiceCallTracker *self = QMI_VOICE_CALL_TRACKER (object);
+
+    g_array_unref (self->priv->entries);
+
+    G_OBJECT_CLASS (qmi_voice_call_tracker_parent_class)->finalize (object);
+}
+
+static void
+qmi_voice_call_tracker_class_init (QmiVoiceCallTrackerClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    g_type_class_add_private (object_class, sizeof (QmiVoiceCallTrackerPrivate));
+
+    object_class->get_property = get_property;
+    object_class->set_property = set_property;
+    object_class->constructed = constructed;
+    object_class->dispose = dispose;
+    object_class->finalize = finalize;
+
+    /**
+     * QmiVoiceCallTracker:voice-call-tracker-client:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_CLIENT] =
+        g_param_spec_object (QMI_VOICE_CALL_TRACKER_CLIENT,
+                             "VOICE client",
+                             "The VOICE client reporting the calls",
+                             QMI_TYPE_CLIENT_VOICE,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_CLIENT, properties[PROP_CLIENT]);
+
+    /**
+     * QmiVoiceCallTracker::call-added:
+     * @object: A #QmiVoiceCallTracker.
+     * @call: the new #QmiVoiceCallTrackerCall.
+     *
+     * The ::call-added signal is emitted when a call is reported for the
+     * first time.
+     *
+     * Since: 1.20
+     */
+    signals[SIGNAL_CALL_ADDED] =
+        g_signal_new (QMI_VOICE_CALL_TRACKER_SIGNAL_CALL_ADDED,
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      1,
+                      G_TYPE_POINTER);
+
+    /**
+     * QmiVoiceCallTracker::call-updated:
+     * @object: A #QmiVoiceCallTracker.
+     * @call: the updated #QmiVoiceCallTrackerCall.
+     * @previous_state: the #QmiVoiceCallState of the call before the update.
+     *
+     * The ::call-updated signal is emitted when any of the values of a call
+     * change, e.g. its state.
+     *
+     * Since: 1.20
+     */
+    signals[SIGNAL_CALL_UPDATED] =
+        g_signal_new (QMI_VOICE_CALL_TRACKER_SIGNAL_CALL_UPDATED,
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      2,
+                      G_TYPE_POINTER,
+                      G_TYPE_UINT);
+
+    /**
+     * QmiVoiceCallTracker::call-ended:
+     * @object: A #QmiVoiceCallTracker.
+     * @call: the ended #QmiVoiceCallTrackerCall.
+     *
+     * The ::call-ended signal is emitted when a call is reported as ended,
+     * or is no longer reported. The call is removed from the table right
+     * after the signal.
+     *
+     * Since: 1.20
+     */
+    signals[SIGNAL_CALL_ENDED] =
+        g_signal_new (QMI_VOICE_CALL_TRACKER_SIGNAL_CALL_ENDED,
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      1,
+                      G_TYPE_POINTER);
+}
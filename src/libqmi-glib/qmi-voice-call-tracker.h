@@ -0,0 +1,227 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_VOICE_CALL_TRACKER_H_
+#define _LIBQMI_GLIB_QMI_VOICE_CALL_TRACKER_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+
+#include "qmi-enums-voice.h"
+#include "qmi-voice.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-voice-call-tracker
+ * @title: QmiVoiceCallTracker
+ * @short_description: tracking of the voice calls reported by a device
+ *
+ * The #QmiVoiceCallTracker keeps a table of the calls reported in the VOICE
+ * All Call Status indications of a #QmiClientVoice, and reports the changes
+ * in each of them with separate signals, so that users don't need to compare
+ * the call lists of consecutive indications themselves.
+ *
+ * The indications are read directly from the raw messages, and each one is
+ * compared with the table in a single pass over its calls.
+ */
+
+/**
+ * QMI_VOICE_CALL_TRACKER_NUMBER_MAX_LENGTH:
+ *
+ * Maximum length of the remote party number of a call.
+ *
+ * Since: 1.20
+ */
+#define QMI_VOICE_CALL_TRACKER_NUMBER_MAX_LENGTH 255
+
+/**
+ * QmiVoiceCallTrackerCall:
+ * @id: the call ID.
+ * @state: a #QmiVoiceCallState.
+ * @type: a #QmiVoiceCallType.
+ * @direction: a #QmiVoiceCallDirection.
+ * @mode: a #QmiVoiceCallMode.
+ * @multipart_indicator: whether the call information is split in several indications.
+ * @als: a #QmiVoiceAls.
+ * @presentation: a #QmiVoicePresentation, valid only if @number is not empty.
+ * @number: the remote party number, NUL-terminated, empty if not reported.
+ *
+ * A call in a #QmiVoiceCallTracker.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    guint8                id;
+    QmiVoiceCallState     state;
+    QmiVoiceCallType      type;
+    QmiVoiceCallDirection direction;
+    QmiVoiceCallMode      mode;
+    gboolean              multipart_indicator;
+    QmiVoiceAls           als;
+    QmiVoicePresentation  presentation;
+    gchar                 number[QMI_VOICE_CALL_TRACKER_NUMBER_MAX_LENGTH + 1];
+} QmiVoiceCallTrackerCall;
+
+#define QMI_TYPE_VOICE_CALL_TRACKER            (qmi_voice_call_tracker_get_type ())
+#define QMI_VOICE_CALL_TRACKER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), QMI_TYPE_VOICE_CALL_TRACKER, QmiVoiceCallTracker))
+#define QMI_VOICE_CALL_TRACKER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  QMI_TYPE_VOICE_CALL_TRACKER, QmiVoiceCallTrackerClass))
+#define QMI_IS_VOICE_CALL_TRACKER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), QMI_TYPE_VOICE_CALL_TRACKER))
+#define QMI_IS_VOICE_CALL_TRACKER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  QMI_TYPE_VOICE_CALL_TRACKER))
+#define QMI_VOICE_CALL_TRACKER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  QMI_TYPE_VOICE_CALL_TRACKER, QmiVoiceCallTrackerClass))
+
+typedef struct _QmiVoiceCallTracker QmiVoiceCallTracker;
+typedef struct _QmiVoiceCallTrackerClass QmiVoiceCallTrackerClass;
+typedef struct _QmiVoiceCallTrackerPrivate QmiVoiceCallTrackerPrivate;
+
+/**
+ * QMI_VOICE_CALL_TRACKER_CLIENT:
+ *
+ * Symbol defining the #QmiVoiceCallTracker:voice-call-tracker-client property.
+ *
+ * Since: 1.20
+ */
+#define QMI_VOICE_CALL_TRACKER_CLIENT "voice-call-tracker-client"
+
+/**
+ * QMI_VOICE_CALL_TRACKER_SIGNAL_CALL_ADDED:
+ *
+ * Symbol defining the #QmiVoiceCallTracker::call-added signal.
+ *
+ * Since: 1.20
+ */
+#define QMI_VOICE_CALL_TRACKER_SIGNAL_CALL_ADDED "call-added"
+
+/**
+ * QMI_VOICE_CALL_TRACKER_SIGNAL_CALL_UPDATED:
+ *
+ * Symbol defining the #QmiVoiceCallTracker::call-updated signal.
+ *
+ * Since: 1.20
+ */
+#define QMI_VOICE_CALL_TRACKER_SIGNAL_CALL_UPDATED "call-updated"
+
+/**
+ * QMI_VOICE_CALL_TRACKER_SIGNAL_CALL_ENDED:
+ *
+ * Symbol defining the #QmiVoiceCallTracker::call-ended signal.
+ *
+ * Since: 1.20
+ */
+#define QMI_VOICE_CALL_TRACKER_SIGNAL_CALL_ENDED "call-ended"
+
+/**
+ * QmiVoiceCallTracker:
+ *
+ * The #QmiVoiceCallTracker structure contains private data and should only be
+ * accessed using the provided API.
+ *
+ * Since: 1.20
+ */
+struct _QmiVoiceCallTracker {
+    /*< private >*/
+    GObject parent;
+    QmiVoiceCallTrackerPrivate *priv;
+};
+
+struct _QmiVoiceCallTrackerClass {
+    /*< private >*/
+    GObjectClass parent;
+};
+
+GType qmi_voice_call_tracker_get_type (void);
+
+/**
+ * qmi_voice_call_tracker_new:
+ * @client: a #QmiClientVoice.
+ *
+ * Creates a #QmiVoiceCallTracker for the calls reported to @client, with an
+ * empty call table.
+ *
+ * Returns: (transfer full): a newly created #QmiVoiceCallTracker. The returned value should be freed with g_object_unref().
+ *
+ * Since: 1.20
+ */
+QmiVoiceCallTracker *qmi_voice_call_tracker_new (QmiClientVoice *client);
+
+/**
+ * qmi_voice_call_tracker_peek_client:
+ * @self: a #QmiVoiceCallTracker.
+ *
+ * Get the #QmiClientVoice used by the tracker, without increasing the
+ * reference count on the returned object.
+ *
+ * Returns: (transfer none): a #QmiClientVoice. Do not free the returned object, it is owned by @self.
+ *
+ * Since: 1.20
+ */
+QmiClientVoice *qmi_voice_call_tracker_peek_client (QmiVoiceCallTracker *self);
+
+/**
+ * qmi_voice_call_tracker_get_n_calls:
+ * @self: a #QmiVoiceCallTracker.
+ *
+ * Gets the number of calls currently in the table.
+ *
+ * Returns: the number of calls.
+ *
+ * Since: 1.20
+ */
+guint qmi_voice_call_tracker_get_n_calls (QmiVoiceCallTracker *self);
+
+/**
+ * qmi_voice_call_tracker_peek_call:
+ * @self: a #QmiVoiceCallTracker.
+ * @index: the index of the call in the table, in the order they were added.
+ *
+ * Gets one of the calls in the table. The returned call is valid until the
+ * next indication is processed.
+ *
+ * Returns: (transfer none): a #QmiVoiceCallTrackerCall, or %NULL if there is no such call.
+ *
+ * Since: 1.20
+ */
+const QmiVoiceCallTrackerCall *qmi_voice_call_tracker_peek_call (QmiVoiceCallTracker *self,
+                                                                 guint                index);
+
+/**
+ * qmi_voice_call_tracker_peek_call_by_id:
+ * @self: a #QmiVoiceCallTracker.
+ * @id: a call ID.
+ *
+ * Gets the call with the given ID. The returned call is valid until the next
+ * indication is processed.
+ *
+ * Returns: (transfer none): a #QmiVoiceCallTrackerCall, or %NULL if there is no such call.
+ *
+ * Since: 1.20
+ */
+const QmiVoiceCallTrackerCall *qmi_voice_call_tracker_peek_call_by_id (QmiVoiceCallTracker *self,
+                                                                       guint8               id);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_VOICE_CALL_TRACKER_H_ */
@@ -0,0 +1,777 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <net/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_addr.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "qmi-wds-link.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+/* How long to wait for the kernel to reply to the requests, in seconds */
+#define NETLINK_TIMEOUT 5
+
+/* Big enough for any message sent by the kernel, even in dumps */
+#define NETLINK_BUFFER_SIZE 32768
+
+typedef struct {
+    guint8 family;
+    guint8 prefix_length;
+    guint8 address[16];
+} LinkAddress;
+
+#define LINK_ADDRESS_SIZE(family) ((family) == AF_INET ? 4 : 16)
+
+typedef struct {
+    QmiDeviceExpectedDataFormat format;
+    gboolean                    default_route;
+    guint32                     mtu;
+    /* One for each IP family, at most */
+    LinkAddress                 addresses[2];
+    guint                       n_addresses;
+    LinkAddress                 gateways[2];
+    guint                       n_gateways;
+    gchar                      *iface;
+} ConfigureLinkContext;
+
+static void
+configure_link_context_free (ConfigureLinkContext *ctx)
+{
+    g_free (ctx->iface);
+    g_slice_free (ConfigureLinkContext, ctx);
+}
+
+gboolean
+qmi_device_configure_link_finish (QmiDevice     *self,
+                                  GAsyncResult  *res,
+                                  GError       **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+/*****************************************************************************/
+/* Netlink requests */
+
+typedef struct {
+    const gchar *description;
+    gboolean     ignore_missing;
+} NetlinkStep;
+
+/* Requests sent all at once, each of them acknowledged separately */
+typedef struct {
+    GByteArray *buffer;
+    GArray     *steps;
+    guint32     first_seq;
+} NetlinkBatch;
+
+static NetlinkBatch *
+netlink_batch_new (guint32 first_seq)
+{
+    NetlinkBatch *batch;
+
+    batch = g_slice_new (NetlinkBatch);
+    batch->buffer = g_byte_array_new ();
+    batch->steps = g_array_new (FALSE, FALSE, sizeof (NetlinkStep));
+    batch->first_seq = first_seq;
+    return batch;
+}
+
+static void
+netlink_batch_free (NetlinkBatch *batch)
+{
+    g_byte_array_unref (batch->buffer);
+    g_array_unref (batch->steps);
+    g_slice_free (NetlinkBatch, batch);
+}
+
+static void
+netlink_batch_append_aligned (NetlinkBatch  *batch,
+                              gconstpointer  data,
+                              gsize          data_len)
+{
+    static const guint8 padding[NLMSG_ALIGNTO] = { 0 };
+
+    g_byte_array_append (batch->buffer, data, data_len);
+    if (NLMSG_ALIGN (data_len) != data_len)
+        g_byte_array_append (batch->buffer, padding, NLMSG_ALIGN (data_len) - data_len);
+}
+
+/* Returns the offset of the new message in the batch */
+static gsize
+netlink_batch_add (NetlinkBatch  *batch,
+                   guint16        type,
+                   guint16        flags,
+                   gconstpointer  payload,
+                   gsize          payload_len,
+                   const gchar   *description,
+                   gboolean       ignore_missing)
+{
+    struct nlmsghdr hdr;
+    NetlinkStep     step;
+    gsize           offset;
+
+    offset = batch->buffer->len;
+
+    memset (&hdr, 0, sizeof (hdr));
+    hdr.nlmsg_len = NLMSG_LENGTH (payload_len);
+    hdr.nlmsg_type = type;
+    hdr.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | flags;
+    hdr.nlmsg_seq = batch->first_seq + batch->steps->len;
+    netlink_batch_append_aligned (batch, &hdr, sizeof (hdr));
+    netlink_batch_append_aligned (batch, payload, payload_len);
+
+    step.description = description;
+    step.ignore_missing = ignore_missing;
+    g_array_append_val (batch->steps, step);
+    return offset;
+}
+
+static void
+netlink_batch_add_attribute (NetlinkBatch  *batch,
+                             gsize          offset,
+                             guint16        type,
+                             gconstpointer  data,
+                             gsize          data_len)
+{
+    struct rtattr attr;
+
+    attr.rta_len = RTA_LENGTH (data_len);
+    attr.rta_type = type;
+    netlink_batch_append_aligned (batch, &attr, sizeof (attr));
+    netlink_batch_append_aligned (batch, data, data_len);
+
+    ((struct nlmsghdr *) &batch->buffer->data[offset])->nlmsg_len = batch->buffer->len - offset;
+}
+
+static gboolean
+netlink_batch_run (gint           fd,
+                   NetlinkBatch  *batch,
+                   GError       **error)
+{
+    guint32  buffer[NETLINK_BUFFER_SIZE / sizeof (guint32)];
+    GError  *inner_error = NULL;
+    guint    n_acked = 0;
+
+    if (send (fd, batch->buffer->data, batch->buffer->len, 0) < 0) {
+        gint errsv = errno;
+
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     "Couldn't send netlink requests: %s", g_strerror (errsv));
+        return FALSE;
+    }
+
+    /* Every request is acknowledged, even if another one failed before */
+    while (n_acked < batch->steps->len) {
+        struct nlmsghdr *hdr;
+        gssize           n;
+        gint             len;
+
+        n = recv (fd, buffer, sizeof (buffer), 0);
+        if (n < 0) {
+            gint errsv = errno;
+
+            if (errsv == EINTR)
+                continue;
+            g_clear_error (&inner_error);
+            g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                         "Couldn't receive netlink replies: %s", g_strerror (errsv));
+            return FALSE;
+        }
+
+        len = (gint) n;
+        for (hdr = (struct nlmsghdr *) buffer; NLMSG_OK (hdr, len); hdr = NLMSG_NEXT (hdr, len)) {
+            struct nlmsgerr *err;
+            NetlinkStep     *step;
+
+            if (hdr->nlmsg_type != NLMSG_ERROR ||
+                hdr->nlmsg_seq < batch->first_seq ||
+                hdr->nlmsg_seq >= batch->first_seq + batch->steps->len)
+                continue;
+
+            n_acked++;
+            err = NLMSG_DATA (hdr);
+            if (!err->error || inner_error)
+                continue;
+
+            /* Something we wanted to remove may already be gone */
+            step = &g_array_index (batch->steps, NetlinkStep, hdr->nlmsg_seq - batch->first_seq);
+            if (step->ignore_missing && (err->error == -EADDRNOTAVAIL || err->error == -ESRCH || err->error == -ENOENT))
+                continue;
+
+            inner_error = g_error_new (G_IO_ERROR, g_io_error_from_errno (-err->error),
+                                       "Couldn't %s: %s", step->description, g_strerror (-err->error));
+        }
+    }
+
+    if (inner_error) {
+        g_propagate_error (error, inner_error);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gint
+netlink_open (GError **error)
+{
+    struct sockaddr_nl addr;
+    struct timeval     timeout = { NETLINK_TIMEOUT, 0 };
+    gint               fd;
+
+    fd = socket (AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) {
+        gint errsv = errno;
+
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     "Couldn't create netlink socket: %s", g_strerror (errsv));
+        return -1;
+    }
+
+    memset (&addr, 0, sizeof (addr));
+    addr.nl_family = AF_NETLINK;
+    if (setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout)) < 0 ||
+        bind (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0) {
+        gint errsv = errno;
+
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     "Couldn't setup netlink socket: %s", g_strerror (errsv));
+        close (fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/* Loads the addresses in the interface not managed by the kernel itself,
+ * i.e. all but the link-local ones */
+static gboolean
+netlink_dump_addresses (gint            fd,
+                        guint32         seq,
+                        guint           ifindex,
+                        GArray         *addresses,
+                        GError        **error)
+{
+    struct {
+        struct nlmsghdr  hdr;
+        struct ifaddrmsg ifa;
+    } request;
+    guint32 buffer[NETLINK_BUFFER_SIZE / sizeof (guint32)];
+
+    memset (&request, 0, sizeof (request));
+    request.hdr.nlmsg_len = NLMSG_LENGTH (sizeof (struct ifaddrmsg));
+    request.hdr.nlmsg_type = RTM_GETADDR;
+    request.hdr.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.hdr.nlmsg_seq = seq;
+    request.ifa.ifa_family = AF_UNSPEC;
+
+    if (send (fd, &request, request.hdr.nlmsg_len, 0) < 0) {
+        gint errsv = errno;
+
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     "Couldn't send netlink request: %s", g_strerror (errsv));
+        return FALSE;
+    }
+
+    while (TRUE) {
+        struct nlmsghdr *hdr;
+        gssize           n;
+        gint             len;
+
+        n = recv (fd, buffer, sizeof (buffer), 0);
+        if (n < 0) {
+            gint errsv = errno;
+
+            if (errsv == EINTR)
+                continue;
+            g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                         "Couldn't receive netlink replies: %s", g_strerror (errsv));
+            return FALSE;
+        }
+
+        len = (gint) n;
+        for (hdr = (struct nlmsghdr *) buffer; NLMSG_OK (hdr, len); hdr = NLMSG_NEXT (hdr, len)) {
+            struct ifaddrmsg *ifa;
+            struct rtattr    *attr;
+            gint              attr_len;
+            LinkAddress       address;
+            gboolean          found = FALSE;
+
+            if (hdr->nlmsg_seq != seq)
+                continue;
+            if (hdr->nlmsg_type == NLMSG_DONE)
+                return TRUE;
+            if (hdr->nlmsg_type == NLMSG_ERROR) {
+                struct nlmsgerr *err = NLMSG_DATA (hdr);
+
+                g_set_error (error, G_IO_ERROR, g_io_error_from_errno (-err->error),
+                             "Couldn't load addresses: %s", g_strerror (-err->error));
+                return FALSE;
+            }
+            if (hdr->nlmsg_type != RTM_NEWADDR)
+                continue;
+
+            ifa = NLMSG_DATA (hdr);
+            if (ifa->ifa_index != ifindex ||
+                ifa->ifa_scope == RT_SCOPE_LINK ||
+                (ifa->ifa_family != AF_INET && ifa->ifa_family != AF_INET6))
+                continue;
+
+            memset (&address, 0, sizeof (address));
+            address.family = ifa->ifa_family;
+            address.prefix_length = ifa->ifa_prefixlen;
+
+            /* In IPv4 the local address is the one to look at, as the other
+             * one is the peer in point-to-point links */
+            attr_len = IFA_PAYLOAD (hdr);
+            for (attr = IFA_RTA (ifa); RTA_OK (attr, attr_len); attr = RTA_NEXT (attr, attr_len)) {
+                if (RTA_PAYLOAD (attr) != LINK_ADDRESS_SIZE (address.family))
+                    continue;
+                if (attr->rta_type == IFA_LOCAL || (attr->rta_type == IFA_ADDRESS && !found)) {
+                    memcpy (address.address, RTA_DATA (attr), LINK_ADDRESS_SIZE (address.family));
+                    found = TRUE;
+                }
+            }
+
+            if (found)
+                g_array_append_val (addresses, address);
+        }
+    }
+}
+
+static void
+netlink_batch_add_link (NetlinkBatch *batch,
+                        guint         ifindex,
+                        gboolean      up,
+                        guint32       mtu)
+{
+    struct ifinfomsg ifi;
+    gsize            offset;
+
+    memset (&ifi, 0, sizeof (ifi));
+    ifi.ifi_family = AF_UNSPEC;
+    ifi.ifi_index = (gint) ifindex;
+    ifi.ifi_flags = up ? IFF_UP : 0;
+    ifi.ifi_change = IFF_UP;
+
+    offset = netlink_batch_add (batch, RTM_NEWLINK, 0, &ifi, sizeof (ifi),
+                                up ? "bring the interface up" : "bring the interface down",
+                                FALSE);
+    if (mtu)
+        netlink_batch_add_attribute (batch, offset, IFLA_MTU, &mtu, sizeof (mtu));
+}
+
+static void
+netlink_batch_add_address (NetlinkBatch      *batch,
+                           guint              ifindex,
+                           const LinkAddress *address,
+                           gboolean           add)
+{
+    struct ifaddrmsg ifa;
+    gsize            offset;
+
+    memset (&ifa, 0, sizeof (ifa));
+    ifa.ifa_family = address->family;
+    ifa.ifa_prefixlen = address->prefix_length;
+    ifa.ifa_scope = RT_SCOPE_UNIVERSE;
+    ifa.ifa_index = ifindex;
+    /* The address is given by the network, don't delay its use */
+    if (add && address->family == AF_INET6)
+        ifa.ifa_flags = IFA_F_NODAD;
+
+    if (add)
+        offset = netlink_batch_add (batch, RTM_NEWADDR, NLM_F_CREATE | NLM_F_REPLACE, &ifa, sizeof (ifa),
+                                    address->family == AF_INET ? "add IPv4 address" : "add IPv6 address",
+                                    FALSE);
+    else
+        offset = netlink_batch_add (batch, RTM_DELADDR, 0, &ifa, sizeof (ifa),
+                                    "remove previous address",
+                                    TRUE);
+
+    if (address->family == AF_INET)
+        netlink_batch_add_attribute (batch, offset, IFA_LOCAL, address->address, 4);
+    netlink_batch_add_attribute (batch, offset, IFA_ADDRESS, address->address, LINK_ADDRESS_SIZE (address->family));
+}
+
+static void
+netlink_batch_add_default_route (NetlinkBatch      *batch,
+                                 guint              ifindex,
+                                 guint8             family,
+                                 const LinkAddress *gateway)
+{
+    struct rtmsg rtm;
+    gsize        offset;
+    guint32      oif = ifindex;
+
+    memset (&rtm, 0, sizeof (rtm));
+    rtm.rtm_family = family;
+    rtm.rtm_table = RT_TABLE_MAIN;
+    rtm.rtm_protocol = RTPROT_BOOT;
+    rtm.rtm_type = RTN_UNICAST;
+    /* Without gateway, the route goes directly through the link */
+    rtm.rtm_scope = gateway ? RT_SCOPE_UNIVERSE : RT_SCOPE_LINK;
+    if (gateway)
+        rtm.rtm_flags = RTNH_F_ONLINK;
+
+    offset = netlink_batch_add (batch, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_REPLACE, &rtm, sizeof (rtm),
+                                family == AF_INET ? "add IPv4 default route" : "add IPv6 default route",
+                                FALSE);
+    netlink_batch_add_attribute (batch, offset, RTA_OIF, &oif, sizeof (oif));
+    if (gateway)
+        netlink_batch_add_attribute (batch, offset, RTA_GATEWAY, gateway->address, LINK_ADDRESS_SIZE (family));
+}
+
+/*****************************************************************************/
+
+static gboolean
+lookup_ifindex (const gchar  *iface,
+                guint        *out_ifindex,
+                GError      **error)
+{
+    *out_ifindex = if_nametoindex (iface);
+    if (!*out_ifindex) {
+        gint errsv = errno;
+
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     "Couldn't find interface '%s': %s", iface, g_strerror (errsv));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void
+link_down_thread (GTask                *task,
+                  gpointer              source_object,
+                  ConfigureLinkContext *ctx,
+                  GCancellable         *cancellable)
+{
+    NetlinkBatch *batch;
+    GError       *error = NULL;
+    guint         ifindex;
+    gint          fd;
+
+    if (!lookup_ifindex (ctx->iface, &ifindex, &error) ||
+        (fd = netlink_open (&error)) < 0) {
+        g_task_return_error (task, error);
+        return;
+    }
+
+    batch = netlink_batch_new (1);
+    netlink_batch_add_link (batch, ifindex, FALSE, 0);
+    if (!netlink_batch_run (fd, batch, &error))
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
+    netlink_batch_free (batch);
+    close (fd);
+}
+
+static void
+link_configure_thread (GTask                *task,
+                       gpointer              source_object,
+                       ConfigureLinkContext *ctx,
+                       GCancellable         *cancellable)
+{
+    NetlinkBatch *batch = NULL;
+    GArray       *previous = NULL;
+    GError       *error = NULL;
+    guint         ifindex;
+    gint          fd = -1;
+    guint         i;
+    guint         j;
+
+    if (g_cancellable_set_error_if_cancelled (cancellable, &error) ||
+        !lookup_ifindex (ctx->iface, &ifindex, &error) ||
+        (fd = netlink_open (&error)) < 0)
+        goto out;
+
+    previous = g_array_new (FALSE, FALSE, sizeof (LinkAddress));
+    if (!netlink_dump_addresses (fd, 1, ifindex, previous, &error))
+        goto out;
+
+    batch = netlink_batch_new (2);
+
+    /* Addresses of previous connections, unless reused */
+    for (i = 0; i < previous->len; i++) {
+        const LinkAddress *address;
+        gboolean           reused = FALSE;
+
+        address = &g_array_index (previous, LinkAddress, i);
+        for (j = 0; j < ctx->n_addresses && !reused; j++)
+            reused = (address->family == ctx->addresses[j].family &&
+                      address->prefix_length == ctx->addresses[j].prefix_length &&
+                      !memcmp (address->address, ctx->addresses[j].address, LINK_ADDRESS_SIZE (address->family)));
+        if (!reused)
+            netlink_batch_add_address (batch, ifindex, address, FALSE);
+    }
+
+    netlink_batch_add_link (batch, ifindex, TRUE, ctx->mtu);
+
+    for (i = 0; i < ctx->n_addresses; i++)
+        netlink_batch_add_address (batch, ifindex, &ctx->addresses[i], TRUE);
+
+    for (i = 0; ctx->default_route && i < ctx->n_addresses; i++) {
+        const LinkAddress *gateway = NULL;
+
+        for (j = 0; j < ctx->n_gateways && !gateway; j++) {
+            if (ctx->gateways[j].family == ctx->addresses[i].family)
+                gateway = &ctx->gateways[j];
+        }
+        netlink_batch_add_default_route (batch, ifindex, ctx->addresses[i].family, gateway);
+    }
+
+    netlink_batch_run (fd, batch, &error);
+
+out:
+    if (batch)
+        netlink_batch_free (batch);
+    if (previous)
+        g_array_unref (previous);
+    if (fd >= 0)
+        close (fd);
+
+    if (error)
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
+}
+
+/*****************************************************************************/
+
+static void
+link_configure_run (GTask *task)
+{
+    ConfigureLinkContext *ctx;
+
+    ctx = g_task_get_task_data (task);
+    g_debug ("[%s] configuring link %s",
+             qmi_device_get_path_display (g_task_get_source_object (task)),
+             ctx->iface);
+    g_task_run_in_thread (task, (GTaskThreadFunc)link_configure_thread);
+    g_object_unref (task);
+}
+
+static void
+update_expected_data_format_ready (QmiDevice    *device,
+                                   GAsyncResult *res,
+                                   GTask        *task)
+{
+    GError *error = NULL;
+
+    if (!qmi_device_update_expected_data_format_finish (device, res, &error)) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    link_configure_run (task);
+}
+
+static void
+link_down_ready (QmiDevice    *device,
+                 GAsyncResult *res,
+                 GTask        *task)
+{
+    ConfigureLinkContext *ctx;
+    GError               *error = NULL;
+
+    if (!g_task_propagate_boolean (G_TASK (res), &error)) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    /* Now that the interface is down, the kernel allows the change */
+    ctx = g_task_get_task_data (task);
+    qmi_device_update_expected_data_format (device,
+                                            ctx->format,
+                                            g_task_get_cancellable (task),
+                                            (GAsyncReadyCallback)update_expected_data_format_ready,
+                                            task);
+}
+
+static void
+load_expected_data_format_ready (QmiDevice    *device,
+                                 GAsyncResult *res,
+                                 GTask        *task)
+{
+    ConfigureLinkContext        *ctx;
+    QmiDeviceExpectedDataFormat  expected;
+    GTask                       *subtask;
+    GError                      *error = NULL;
+
+    expected = qmi_device_load_expected_data_format_finish (device, res, &error);
+    if (expected == QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    ctx = g_task_get_task_data (task);
+    if (expected == ctx->format) {
+        link_configure_run (task);
+        return;
+    }
+
+    g_debug ("[%s] switching link %s to %s data format",
+             qmi_device_get_path_display (device),
+             ctx->iface,
+             qmi_device_expected_data_format_get_string (ctx->format));
+
+    subtask = g_task_new (device, g_task_get_cancellable (task), (GAsyncReadyCallback)link_down_ready, task);
+    g_task_set_task_data (subtask, ctx, NULL);
+    g_task_run_in_thread (subtask, (GTaskThreadFunc)link_down_thread);
+    g_object_unref (subtask);
+}
+
+static void
+load_wwan_iface_ready (QmiDevice    *device,
+                       GAsyncResult *res,
+                       GTask        *task)
+{
+    ConfigureLinkContext *ctx;
+    const gchar          *iface;
+    GError               *error = NULL;
+
+    iface = qmi_device_load_wwan_iface_finish (device, res, &error);
+    if (!iface) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    ctx = g_task_get_task_data (task);
+    ctx->iface = g_strdup (iface);
+
+    if (ctx->format == QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN) {
+        link_configure_run (task);
+        return;
+    }
+
+    qmi_device_load_expected_data_format (device,
+                                          g_task_get_cancellable (task),
+                                          (GAsyncReadyCallback)load_expected_data_format_ready,
+                                          task);
+}
+
+static void
+link_address_from_ipv4 (LinkAddress *address,
+                        guint32      value,
+                        guint8       prefix_length)
+{
+    memset (address, 0, sizeof (*address));
+    address->family = AF_INET;
+    address->prefix_length = prefix_length;
+    address->address[0] = (guint8) (value >> 24);
+    address->address[1] = (guint8) (value >> 16);
+    address->address[2] = (guint8) (value >> 8);
+    address->address[3] = (guint8) value;
+}
+
+static void
+link_address_from_ipv6 (LinkAddress *address,
+                        GArray      *value,
+                        guint8       prefix_length)
+{
+    guint i;
+
+    memset (address, 0, sizeof (*address));
+    address->family = AF_INET6;
+    address->prefix_length = prefix_length;
+    for (i = 0; i < value->len && i < 8; i++) {
+        guint16 word = g_array_index (value, guint16, i);
+
+        address->address[2 * i] = (guint8) (word >> 8);
+        address->address[2 * i + 1] = (guint8) word;
+    }
+}
+
+void
+qmi_device_configure_link (QmiDevice                             *self,
+                           QmiMessageWdsGetCurrentSettingsOutput *settings,
+                           QmiDeviceExpectedDataFormat            format,
+                           gboolean                               default_route,
+                           GCancellable                          *cancellable,
+                           GAsyncReadyCallback                    callback,
+                           gpointer                               user_data)
+{
+    ConfigureLinkContext *ctx;
+    GTask                *task;
+    guint32               ipv4;
+    guint32               ipv4_mask;
+    GArray               *ipv6;
+    guint8                ipv6_prefix;
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (settings != NULL);
+
+    ctx = g_slice_new0 (ConfigureLinkContext);
+    ctx->format = format;
+    ctx->default_route = default_route;
+    qmi_message_wds_get_current_settings_output_get_mtu (settings, &ctx->mtu, NULL);
+
+    if (qmi_message_wds_get_current_settings_output_get_ipv4_address (settings, &ipv4, NULL)) {
+        guint8 prefix_length = 32;
+
+        /* Subnet masks are always contiguous */
+        if (qmi_message_wds_get_current_settings_output_get_ipv4_gateway_subnet_mask (settings, &ipv4_mask, NULL)) {
+            prefix_length = 0;
+            while (prefix_length < 32 && (ipv4_mask & (0x80000000 >> prefix_length)))
+                prefix_length++;
+        }
+        link_address_from_ipv4 (&ctx->addresses[ctx->n_addresses++], ipv4, prefix_length);
+
+        if (qmi_message_wds_get_current_settings_output_get_ipv4_gateway_address (settings, &ipv4, NULL))
+            link_address_from_ipv4 (&ctx->gateways[ctx->n_gateways++], ipv4, 32);
+    }
+
+    if (qmi_message_wds_get_current_settings_output_get_ipv6_address (settings, &ipv6, &ipv6_prefix, NULL)) {
+        link_address_from_ipv6 (&ctx->addresses[ctx->n_addresses++], ipv6, ipv6_prefix);
+
+        if (qmi_message_wds_get_current_settings_output_get_ipv6_gateway_address (settings, &ipv6, &ipv6_prefix, NULL))
+            link_address_from_ipv6 (&ctx->gateways[ctx->n_gateways++], ipv6, 128);
+    }
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_task_data (task, ctx, (GDestroyNotify)configure_link_context_free);
+
+    if (!ctx->n_addresses) {
+        g_task_return_new_error (task, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS,
+                                 "No IP address given in the current settings");
+        g_object_unref (task);
+        return;
+    }
+
+    qmi_device_load_wwan_iface (self,
+                                cancellable,
+                                (GAsyncReadyCallback)load_wwan_iface_ready,
+                                task);
+}
@@ -0,0 +1,108 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_WDS_LINK_H_
+#define _LIBQMI_GLIB_QMI_WDS_LINK_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "qmi-device.h"
+#include "qmi-wds.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-wds-link
+ * @title: WDS link configuration
+ * @short_description: configuration of the network interface of a connected device
+ *
+ * Helpers to configure the network interface of a #QmiDevice (e.g. the one of
+ * a qmi_wwan driver) with the IP settings given by WDS Get Current Settings
+ * once a network is started, talking to the kernel directly over rtnetlink,
+ * instead of running external tools like ip(8) or a DHCP client.
+ */
+
+/**
+ * qmi_device_configure_link:
+ * @self: a #QmiDevice.
+ * @settings: a #QmiMessageWdsGetCurrentSettingsOutput, as received once the network is started.
+ * @format: the #QmiDeviceExpectedDataFormat the interface should use, or %QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN to leave it untouched.
+ * @default_route: whether default routes through the interface should be added.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously configures the network interface of @self, as given by
+ * qmi_device_get_wwan_iface(), with the IPv4 and IPv6 addresses, gateways
+ * and MTU found in @settings.
+ *
+ * If the expected data format of the interface needs to be changed to
+ * @format, the interface is brought down before updating it, as the kernel
+ * doesn't allow changing it otherwise, see
+ * qmi_device_update_expected_data_format().
+ *
+ * The rest of the configuration is applied in one single batch of rtnetlink
+ * requests: the addresses previously configured in the interface are
+ * removed, the MTU is set, the interface is brought up and the new addresses
+ * and routes are added. The DNS servers in @settings are not configured, as
+ * that is not handled by the kernel.
+ *
+ * This operation needs the CAP_NET_ADMIN capability.
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * qmi_device_configure_link_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_configure_link (QmiDevice                             *self,
+                                QmiMessageWdsGetCurrentSettingsOutput *settings,
+                                QmiDeviceExpectedDataFormat            format,
+                                gboolean                               default_route,
+                                GCancellable                          *cancellable,
+                                GAsyncReadyCallback                    callback,
+                                gpointer                               user_data);
+
+/**
+ * qmi_device_configure_link_finish:
+ * @self: a #QmiDevice.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_configure_link().
+ *
+ * Returns: %TRUE if the interface is configured, %FALSE if @error is set.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_device_configure_link_finish (QmiDevice     *self,
+                                           GAsyncResult  *res,
+                                           GError       **error);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_WDS_LINK_H_ */
@@ -0,0 +1,557 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "qmi-wds-mux-sessions.h"
+#include "qmi-wda.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+/* Timeout of each request sent, except for WDS Start Network */
+#define REQUEST_TIMEOUT 10
+
+/* Same timeout as used by qmicli */
+#define START_NETWORK_TIMEOUT 45
+
+typedef struct {
+    QmiDataEndpointType  endpoint_type;
+    guint32              endpoint_interface_number;
+    guint32              dl_max_datagrams;
+    guint32              dl_max_size;
+
+    /* Both with one element per session */
+    GArray              *settings;
+    GArray              *sessions;
+
+    QmiClientWda        *client_wda;
+    guint                n_pending;
+} MuxSessionsContext;
+
+typedef struct {
+    GTask *task;
+    guint  i;
+} MuxSessionContext;
+
+static void
+mux_session_settings_clear (QmiWdsMuxSessionSettings *settings)
+{
+    g_free ((gchar *) settings->apn);
+}
+
+static void
+mux_session_clear (QmiWdsMuxSession *session)
+{
+    g_clear_object (&session->client);
+    g_clear_error (&session->error);
+}
+
+static void
+mux_sessions_context_free (MuxSessionsContext *ctx)
+{
+    if (ctx->client_wda)
+        g_object_unref (ctx->client_wda);
+    if (ctx->sessions)
+        g_array_unref (ctx->sessions);
+    g_array_unref (ctx->settings);
+    g_slice_free (MuxSessionsContext, ctx);
+}
+
+GArray *
+qmi_device_start_mux_sessions_finish (QmiDevice     *self,
+                                      GAsyncResult  *res,
+                                      guint32       *dl_max_datagrams,
+                                      guint32       *dl_max_size,
+                                      GError       **error)
+{
+    MuxSessionsContext *ctx;
+    GArray             *sessions;
+
+    sessions = g_task_propagate_pointer (G_TASK (res), error);
+    if (!sessions)
+        return NULL;
+
+    ctx = g_task_get_task_data (G_TASK (res));
+    if (dl_max_datagrams)
+        *dl_max_datagrams = ctx->dl_max_datagrams;
+    if (dl_max_size)
+        *dl_max_size = ctx->dl_max_size;
+    return sessions;
+}
+
+/* Releases the clients of all sessions, when the whole operation fails */
+static void
+release_all_clients (GTask *task)
+{
+    QmiDevice          *self;
+    MuxSessionsContext *ctx;
+    guint               i;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    if (ctx->client_wda)
+        qmi_device_release_client (self,
+                                   QMI_CLIENT (ctx->client_wda),
+                                   QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID,
+                                   REQUEST_TIMEOUT, NULL, NULL, NULL);
+
+    for (i = 0; i < ctx->sessions->len; i++) {
+        QmiWdsMuxSession *session;
+
+        session = &g_array_index (ctx->sessions, QmiWdsMuxSession, i);
+        if (session->client)
+            qmi_device_release_client (self,
+                                       QMI_CLIENT (session->client),
+                                       QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID,
+                                       REQUEST_TIMEOUT, NULL, NULL, NULL);
+    }
+}
+
+static void
+mux_sessions_op_done (GTask *task)
+{
+    MuxSessionsContext *ctx;
+    GArray             *sessions;
+
+    ctx = g_task_get_task_data (task);
+
+    g_assert (ctx->n_pending > 0);
+    if (--ctx->n_pending > 0)
+        return;
+
+    sessions = ctx->sessions;
+    ctx->sessions = NULL;
+    g_task_return_pointer (task, sessions, (GDestroyNotify) g_array_unref);
+}
+
+/*****************************************************************************/
+/* Each session */
+
+static void
+mux_session_done (MuxSessionContext *session_ctx)
+{
+    GTask *task;
+
+    task = session_ctx->task;
+    g_slice_free (MuxSessionContext, session_ctx);
+
+    mux_sessions_op_done (task);
+    g_object_unref (task);
+}
+
+static void
+release_client_ready (QmiDevice         *self,
+                      GAsyncResult      *res,
+                      MuxSessionContext *session_ctx)
+{
+    GError *error = NULL;
+
+    if (!qmi_device_release_client_finish (self, res, &error)) {
+        g_debug ("couldn't release WDS client: %s", error->message);
+        g_error_free (error);
+    }
+
+    mux_session_done (session_ctx);
+}
+
+static void
+mux_session_fail (MuxSessionContext *session_ctx,
+                  GError            *error)
+{
+    MuxSessionsContext *ctx;
+    QmiWdsMuxSession   *session;
+    QmiClientWds       *client;
+
+    ctx = g_task_get_task_data (session_ctx->task);
+    session = &g_array_index (ctx->sessions, QmiWdsMuxSession, session_ctx->i);
+
+    g_prefix_error (&error, "Mux ID %u: ", session->mux_id);
+    session->error = error;
+
+    /* The client is not given to the caller */
+    client = session->client;
+    session->client = NULL;
+    qmi_device_release_client (g_task_get_source_object (session_ctx->task),
+                               QMI_CLIENT (client),
+                               QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID,
+                               REQUEST_TIMEOUT,
+                               NULL,
+                               (GAsyncReadyCallback) release_client_ready,
+                               session_ctx);
+    g_object_unref (client);
+}
+
+static void
+start_network_ready (QmiClientWds      *client,
+                     GAsyncResult      *res,
+                     MuxSessionContext *session_ctx)
+{
+    QmiMessageWdsStartNetworkOutput *output;
+    MuxSessionsContext              *ctx;
+    QmiWdsMuxSession                *session;
+    GError                          *error = NULL;
+
+    ctx = g_task_get_task_data (session_ctx->task);
+    session = &g_array_index (ctx->sessions, QmiWdsMuxSession, session_ctx->i);
+
+    output = qmi_client_wds_start_network_finish (client, res, &error);
+    if (!output ||
+        !qmi_message_wds_start_network_output_get_result (output, &error) ||
+        !qmi_message_wds_start_network_output_get_packet_data_handle (output, &session->packet_data_handle, &error)) {
+        g_prefix_error (&error, "Couldn't start network: ");
+        mux_session_fail (session_ctx, error);
+    } else
+        mux_session_done (session_ctx);
+
+    if (output)
+        qmi_message_wds_start_network_output_unref (output);
+}
+
+static void
+start_network (MuxSessionContext *session_ctx)
+{
+    MuxSessionsContext              *ctx;
+    QmiWdsMuxSessionSettings        *settings;
+    QmiWdsMuxSession                *session;
+    QmiMessageWdsStartNetworkInput  *input;
+
+    ctx = g_task_get_task_data (session_ctx->task);
+    settings = &g_array_index (ctx->settings, QmiWdsMuxSessionSettings, session_ctx->i);
+    session = &g_array_index (ctx->sessions, QmiWdsMuxSession, session_ctx->i);
+
+    input = qmi_message_wds_start_network_input_new ();
+    if (settings->apn)
+        qmi_message_wds_start_network_input_set_apn (input, settings->apn, NULL);
+    if (settings->ip_family != QMI_WDS_IP_FAMILY_UNSPECIFIED)
+        qmi_message_wds_start_network_input_set_ip_family_preference (input, settings->ip_family, NULL);
+    qmi_client_wds_start_network (session->client,
+                                  input,
+                                  START_NETWORK_TIMEOUT,
+                                  g_task_get_cancellable (session_ctx->task),
+                                  (GAsyncReadyCallback) start_network_ready,
+                                  session_ctx);
+    qmi_message_wds_start_network_input_unref (input);
+}
+
+static void
+set_ip_family_ready (QmiClientWds      *client,
+                     GAsyncResult      *res,
+                     MuxSessionContext *session_ctx)
+{
+    QmiMessageWdsSetIpFamilyOutput *output;
+    GError                         *error = NULL;
+
+    /* Not fatal, the preference is also given in WDS Start Network */
+    output = qmi_client_wds_set_ip_family_finish (client, res, &error);
+    if (!output || !qmi_message_wds_set_ip_family_output_get_result (output, &error)) {
+        g_debug ("couldn't set IP family: %s", error->message);
+        g_error_free (error);
+    }
+
+    if (output)
+        qmi_message_wds_set_ip_family_output_unref (output);
+    start_network (session_ctx);
+}
+
+static void
+bind_mux_data_port_ready (QmiClientWds      *client,
+                          GAsyncResult      *res,
+                          MuxSessionContext *session_ctx)
+{
+    QmiMessageWdsBindMuxDataPortOutput *output;
+    QmiMessageWdsSetIpFamilyInput      *input;
+    MuxSessionsContext                 *ctx;
+    QmiWdsMuxSessionSettings           *settings;
+    GError                             *error = NULL;
+
+    output = qmi_client_wds_bind_mux_data_port_finish (client, res, &error);
+    if (!output || !qmi_message_wds_bind_mux_data_port_output_get_result (output, &error)) {
+        g_prefix_error (&error, "Couldn't bind mux data port: ");
+        mux_session_fail (session_ctx, error);
+        if (output)
+            qmi_message_wds_bind_mux_data_port_output_unref (output);
+        return;
+    }
+    qmi_message_wds_bind_mux_data_port_output_unref (output);
+
+    ctx = g_task_get_task_data (session_ctx->task);
+    settings = &g_array_index (ctx->settings, QmiWdsMuxSessionSettings, session_ctx->i);
+    if (settings->ip_family == QMI_WDS_IP_FAMILY_UNSPECIFIED) {
+        start_network (session_ctx);
+        return;
+    }
+
+    input = qmi_message_wds_set_ip_family_input_new ();
+    qmi_message_wds_set_ip_family_input_set_preference (input, settings->ip_family, NULL);
+    qmi_client_wds_set_ip_family (client,
+                                  input,
+                                  REQUEST_TIMEOUT,
+                                  g_task_get_cancellable (session_ctx->task),
+                                  (GAsyncReadyCallback) set_ip_family_ready,
+                                  session_ctx);
+    qmi_message_wds_set_ip_family_input_unref (input);
+}
+
+static void
+mux_session_start (GTask *task,
+                   guint  i)
+{
+    MuxSessionsContext                *ctx;
+    MuxSessionContext                 *session_ctx;
+    QmiWdsMuxSession                  *session;
+    QmiMessageWdsBindMuxDataPortInput *input;
+
+    ctx = g_task_get_task_data (task);
+    session = &g_array_index (ctx->sessions, QmiWdsMuxSession, i);
+
+    session_ctx = g_slice_new (MuxSessionContext);
+    session_ctx->task = g_object_ref (task);
+    session_ctx->i = i;
+    ctx->n_pending++;
+
+    input = qmi_message_wds_bind_mux_data_port_input_new ();
+    qmi_message_wds_bind_mux_data_port_input_set_endpoint_info (input,
+                                                                ctx->endpoint_type,
+                                                                ctx->endpoint_interface_number,
+                                                                NULL);
+    qmi_message_wds_bind_mux_data_port_input_set_mux_id (input, session->mux_id, NULL);
+    qmi_message_wds_bind_mux_data_port_input_set_client_type (input, QMI_WDS_CLIENT_TYPE_TETHERED, NULL);
+    qmi_client_wds_bind_mux_data_port (session->client,
+                                       input,
+                                       REQUEST_TIMEOUT,
+                                       g_task_get_cancellable (task),
+                                       (GAsyncReadyCallback) bind_mux_data_port_ready,
+                                       session_ctx);
+    qmi_message_wds_bind_mux_data_port_input_unref (input);
+}
+
+/*****************************************************************************/
+/* Data format */
+
+static void
+release_wda_client_ready (QmiDevice    *self,
+                          GAsyncResult *res,
+                          GTask        *task)
+{
+    GError *error = NULL;
+
+    if (!qmi_device_release_client_finish (self, res, &error)) {
+        g_debug ("couldn't release WDA client: %s", error->message);
+        g_error_free (error);
+    }
+
+    mux_sessions_op_done (task);
+    g_object_unref (task);
+}
+
+static void
+set_data_format_ready (QmiClientWda *client,
+                       GAsyncResult *res,
+                       GTask        *task)
+{
+    QmiMessageWdaSetDataFormatOutput *output;
+    MuxSessionsContext               *ctx;
+    QmiWdaLinkLayerProtocol           link_layer_protocol;
+    QmiWdaDataAggregationProtocol     aggregation_protocol;
+    GError                           *error = NULL;
+    guint                             i;
+
+    ctx = g_task_get_task_data (task);
+
+    output = qmi_client_wda_set_data_format_finish (client, res, &error);
+    if (!output || !qmi_message_wda_set_data_format_output_get_result (output, &error)) {
+        g_prefix_error (&error, "Couldn't set data format: ");
+        goto failed;
+    }
+
+    /* The device may not support the requested format, and just report the
+     * one in use */
+    if ((qmi_message_wda_set_data_format_output_get_link_layer_protocol (output, &link_layer_protocol, NULL) &&
+         link_layer_protocol != QMI_WDA_LINK_LAYER_PROTOCOL_RAW_IP) ||
+        (qmi_message_wda_set_data_format_output_get_downlink_data_aggregation_protocol (output, &aggregation_protocol, NULL) &&
+         aggregation_protocol != QMI_WDA_DATA_AGGREGATION_PROTOCOL_QMAP)) {
+        error = g_error_new (QMI_CORE_ERROR,
+                             QMI_CORE_ERROR_UNSUPPORTED,
+                             "Raw-IP with QMAP aggregation not supported");
+        goto failed;
+    }
+
+    qmi_message_wda_set_data_format_output_get_downlink_data_aggregation_max_datagrams (output, &ctx->dl_max_datagrams, NULL);
+    qmi_message_wda_set_data_format_output_get_downlink_data_aggregation_max_size (output, &ctx->dl_max_size, NULL);
+    qmi_message_wda_set_data_format_output_unref (output);
+
+    /* The WDA client is no longer needed, release it while the sessions are
+     * started */
+    ctx->n_pending = 1;
+    qmi_device_release_client (g_task_get_source_object (task),
+                               QMI_CLIENT (ctx->client_wda),
+                               QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID,
+                               REQUEST_TIMEOUT,
+                               NULL,
+                               (GAsyncReadyCallback) release_wda_client_ready,
+                               task);
+    g_clear_object (&ctx->client_wda);
+
+    for (i = 0; i < ctx->sessions->len; i++) {
+        if (g_array_index (ctx->sessions, QmiWdsMuxSession, i).client)
+            mux_session_start (task, i);
+    }
+    return;
+
+failed:
+    if (output)
+        qmi_message_wda_set_data_format_output_unref (output);
+    release_all_clients (task);
+    g_task_return_error (task, error);
+    g_object_unref (task);
+}
+
+static void
+allocate_clients_ready (QmiDevice    *self,
+                        GAsyncResult *res,
+                        GTask        *task)
+{
+    MuxSessionsContext              *ctx;
+    QmiMessageWdaSetDataFormatInput *input;
+    GPtrArray                       *clients;
+    GPtrArray                       *errors = NULL;
+    GError                          *error = NULL;
+    guint                            i;
+
+    ctx = g_task_get_task_data (task);
+
+    clients = qmi_device_allocate_clients_finish (self, res, &errors, &error);
+    if (!clients) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    /* The WDA client goes first, then one WDS client per session */
+    if (g_ptr_array_index (clients, 0))
+        ctx->client_wda = g_object_ref (g_ptr_array_index (clients, 0));
+    for (i = 0; i < ctx->sessions->len; i++) {
+        QmiWdsMuxSession *session;
+
+        session = &g_array_index (ctx->sessions, QmiWdsMuxSession, i);
+        if (g_ptr_array_index (clients, i + 1))
+            session->client = g_object_ref (g_ptr_array_index (clients, i + 1));
+        else
+            session->error = g_error_copy (g_ptr_array_index (errors, i + 1));
+    }
+
+    if (!ctx->client_wda) {
+        error = g_error_copy (g_ptr_array_index (errors, 0));
+        g_prefix_error (&error, "Couldn't allocate WDA client: ");
+        release_all_clients (task);
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        goto out;
+    }
+
+    input = qmi_message_wda_set_data_format_input_new ();
+    qmi_message_wda_set_data_format_input_set_link_layer_protocol (input, QMI_WDA_LINK_LAYER_PROTOCOL_RAW_IP, NULL);
+    qmi_message_wda_set_data_format_input_set_uplink_data_aggregation_protocol (input, QMI_WDA_DATA_AGGREGATION_PROTOCOL_QMAP, NULL);
+    qmi_message_wda_set_data_format_input_set_downlink_data_aggregation_protocol (input, QMI_WDA_DATA_AGGREGATION_PROTOCOL_QMAP, NULL);
+    if (ctx->dl_max_datagrams)
+        qmi_message_wda_set_data_format_input_set_downlink_data_aggregation_max_datagrams (input, ctx->dl_max_datagrams, NULL);
+    if (ctx->dl_max_size)
+        qmi_message_wda_set_data_format_input_set_downlink_data_aggregation_max_size (input, ctx->dl_max_size, NULL);
+    qmi_message_wda_set_data_format_input_set_endpoint_info (input,
+                                                             ctx->endpoint_type,
+                                                             ctx->endpoint_interface_number,
+                                                             NULL);
+    qmi_client_wda_set_data_format (ctx->client_wda,
+                                    input,
+                                    REQUEST_TIMEOUT,
+                                    g_task_get_cancellable (task),
+                                    (GAsyncReadyCallback) set_data_format_ready,
+                                    task);
+    qmi_message_wda_set_data_format_input_unref (input);
+
+out:
+    g_ptr_array_unref (errors);
+    g_ptr_array_unref (clients);
+}
+
+void
+qmi_device_start_mux_sessions (QmiDevice                       *self,
+                               QmiDataEndpointType              endpoint_type,
+                               guint32                          endpoint_interface_number,
+                               guint32                          dl_max_datagrams,
+                               guint32                          dl_max_size,
+                               const QmiWdsMuxSessionSettings  *settings,
+                               guint                            n_settings,
+                               GCancellable                    *cancellable,
+                               GAsyncReadyCallback              callback,
+                               gpointer                         user_data)
+{
+    GTask              *task;
+    MuxSessionsContext *ctx;
+    QmiService         *services;
+    guint               i;
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (settings != NULL);
+    g_return_if_fail (n_settings > 0);
+
+    ctx = g_slice_new0 (MuxSessionsContext);
+    ctx->endpoint_type = endpoint_type;
+    ctx->endpoint_interface_number = endpoint_interface_number;
+    ctx->dl_max_datagrams = dl_max_datagrams;
+    ctx->dl_max_size = dl_max_size;
+    ctx->settings = g_array_sized_new (FALSE, FALSE, sizeof (QmiWdsMuxSessionSettings), n_settings);
+    g_array_set_clear_func (ctx->settings, (GDestroyNotify) mux_session_settings_clear);
+    ctx->sessions = g_array_sized_new (FALSE, TRUE, sizeof (QmiWdsMuxSession), n_settings);
+    g_array_set_clear_func (ctx->sessions, (GDestroyNotify) mux_session_clear);
+    g_array_set_size (ctx->sessions, n_settings);
+
+    services = g_new (QmiService, n_settings + 1);
+    services[0] = QMI_SERVICE_WDA;
+    for (i = 0; i < n_settings; i++) {
+        QmiWdsMuxSessionSettings copy;
+
+        copy = settings[i];
+        copy.apn = g_strdup (settings[i].apn);
+        g_array_append_val (ctx->settings, copy);
+        g_array_index (ctx->sessions, QmiWdsMuxSession, i).mux_id = settings[i].mux_id;
+        services[i + 1] = QMI_SERVICE_WDS;
+    }
+
+    /* The clients of the sessions started are given to the caller even if
+     * cancelled afterwards */
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_check_cancellable (task, FALSE);
+    g_task_set_task_data (task, ctx, (GDestroyNotify) mux_sessions_context_free);
+
+    qmi_device_allocate_clients (self,
+                                 services,
+                                 n_settings + 1,
+                                 REQUEST_TIMEOUT,
+                                 cancellable,
+                                 (GAsyncReadyCallback) allocate_clients_ready,
+                                 task);
+    g_free (services);
+}
@@ -0,0 +1,162 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_WDS_MUX_SESSIONS_H_
+#define _LIBQMI_GLIB_QMI_WDS_MUX_SESSIONS_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "qmi-enums.h"
+#include "qmi-enums-wds.h"
+#include "qmi-device.h"
+#include "qmi-wds.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-wds-mux-sessions
+ * @title: WDS multiplexed data sessions
+ * @short_description: setup of multiple data sessions over a single QMAP link
+ *
+ * Helpers to setup multiple packet data sessions over a single network link
+ * (e.g. the one of a qmi_wwan or rmnet interface), each of them bound to a
+ * different QMAP mux ID, so that a single control port and a single link are
+ * used for all of them.
+ *
+ * The device is configured through WDA to use QMAP aggregation on the data
+ * endpoint, one #QmiClientWds is allocated for each session, and the networks
+ * of all sessions are started at the same time.
+ */
+
+/**
+ * QmiWdsMuxSessionSettings:
+ * @mux_id: the QMAP mux ID to bind the session to.
+ * @apn: the APN to connect to, or %NULL to use the one in the default profile.
+ * @ip_family: a #QmiWdsIpFamily, or %QMI_WDS_IP_FAMILY_UNSPECIFIED to use the device default.
+ *
+ * The settings of one of the sessions to start with qmi_device_start_mux_sessions().
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    guint8          mux_id;
+    const gchar    *apn;
+    QmiWdsIpFamily  ip_family;
+} QmiWdsMuxSessionSettings;
+
+/**
+ * QmiWdsMuxSession:
+ * @mux_id: the QMAP mux ID the session is bound to.
+ * @client: the #QmiClientWds handling the session, or %NULL if @error is set.
+ * @packet_data_handle: the packet data handle of the started network, to be used in WDS Stop Network.
+ * @error: the reason why the session couldn't be started, or %NULL.
+ *
+ * One of the sessions started with qmi_device_start_mux_sessions().
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    guint8        mux_id;
+    QmiClientWds *client;
+    guint32       packet_data_handle;
+    GError       *error;
+} QmiWdsMuxSession;
+
+/**
+ * qmi_device_start_mux_sessions:
+ * @self: a #QmiDevice.
+ * @endpoint_type: the #QmiDataEndpointType of the data endpoint.
+ * @endpoint_interface_number: the interface number of the data endpoint.
+ * @dl_max_datagrams: the maximum number of datagrams aggregated in each downlink transfer, or 0 to use the device default.
+ * @dl_max_size: the maximum size of each downlink transfer, in bytes, or 0 to use the device default.
+ * @settings: (array length=n_settings): the #QmiWdsMuxSessionSettings of each session.
+ * @n_settings: the number of elements in @settings, at least 1.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously configures the data endpoint to use raw-IP with QMAP
+ * aggregation in both directions, and starts one packet data session for
+ * each of the given @settings on the same endpoint.
+ *
+ * The WDA client and all the #QmiClientWds needed are allocated at once with
+ * qmi_device_allocate_clients(). Once the data format is set with WDA Set Data
+ * Format, every session is bound to its mux ID with WDS Bind Mux Data Port
+ * and its network is started with WDS Start Network, all sessions at the same
+ * time.
+ *
+ * The kernel side of the link (e.g. the raw-IP and QMAP settings of a
+ * qmi_wwan interface, see qmi_device_set_expected_data_format()) is not
+ * configured by this method. The network links of each mux ID can be setup
+ * with qmi_device_add_mux_link(), which reuses the ones already created, so
+ * that they don't need to be torn down when the sessions are restarted.
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * qmi_device_start_mux_sessions_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_start_mux_sessions (QmiDevice                       *self,
+                                    QmiDataEndpointType              endpoint_type,
+                                    guint32                          endpoint_interface_number,
+                                    guint32                          dl_max_datagrams,
+                                    guint32                          dl_max_size,
+                                    const QmiWdsMuxSessionSettings  *settings,
+                                    guint                            n_settings,
+                                    GCancellable                    *cancellable,
+                                    GAsyncReadyCallback              callback,
+                                    gpointer                         user_data);
+
+/**
+ * qmi_device_start_mux_sessions_finish:
+ * @self: a #QmiDevice.
+ * @res: a #GAsyncResult.
+ * @dl_max_datagrams: (out) (optional): return location for the maximum number of datagrams aggregated in each downlink transfer, as accepted by the device, or %NULL.
+ * @dl_max_size: (out) (optional): return location for the maximum size of each downlink transfer, as accepted by the device, or %NULL.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_start_mux_sessions().
+ *
+ * The operation only fails if the data format cannot be set. The result of
+ * each individual session is given in the returned array instead, with one
+ * element per requested session, in the same order. The clients of the
+ * sessions that couldn't be started are already released.
+ *
+ * Returns: (transfer full) (element-type QmiWdsMuxSession): a #GArray of #QmiWdsMuxSession elements, or %NULL if @error is set. The returned value should be freed with g_array_unref().
+ *
+ * Since: 1.20
+ */
+GArray *qmi_device_start_mux_sessions_finish (QmiDevice     *self,
+                                              GAsyncResult  *res,
+                                              guint32       *dl_max_datagrams,
+                                              guint32       *dl_max_size,
+                                              GError       **error);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_WDS_MUX_SESSIONS_H_ */
@@ -0,0 +1,296 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "qmi-wds-profile-inventory.h"
+
+/* Timeout of each request sent */
+#define REQUEST_TIMEOUT 10
+
+typedef struct {
+    guint              max_in_flight;
+
+    /* One element per profile listed */
+    GArray            *profiles;
+    guint              next;
+    guint              n_pending;
+
+    GSource           *cancellable_source;
+    gboolean           completed;
+} GetAllProfilesContext;
+
+typedef struct {
+    GTask *task;
+    guint  i;
+} ProfileContext;
+
+static void
+profile_settings_clear (QmiWdsProfileSettings *settings)
+{
+    g_free (settings->profile_name);
+    g_free (settings->apn_name);
+    g_free (settings->username);
+}
+
+static void
+get_all_profiles_context_free (GetAllProfilesContext *ctx)
+{
+    g_assert (!ctx->cancellable_source);
+
+    if (ctx->profiles)
+        g_array_unref (ctx->profiles);
+    g_slice_free (GetAllProfilesContext, ctx);
+}
+
+GArray *
+qmi_client_wds_get_all_profiles_finish (QmiClientWds  *self,
+                                        GAsyncResult  *res,
+                                        GError       **error)
+{
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+static void
+get_all_profiles_complete (GTask  *task,
+                           GError *error)
+{
+    GetAllProfilesContext *ctx;
+
+    ctx = g_task_get_task_data (task);
+
+    /* Requests still in flight may finish after the operation is over */
+    if (ctx->completed) {
+        if (error)
+            g_error_free (error);
+        return;
+    }
+    ctx->completed = TRUE;
+
+    if (ctx->cancellable_source) {
+        g_source_destroy (ctx->cancellable_source);
+        g_source_unref (ctx->cancellable_source);
+        ctx->cancellable_source = NULL;
+    }
+
+    if (error)
+        g_task_return_error (task, error);
+    else {
+        g_task_return_pointer (task, ctx->profiles, (GDestroyNotify) g_array_unref);
+        ctx->profiles = NULL;
+    }
+
+    /* Drop the reference held while running */
+    g_object_unref (task);
+}
+
+static gboolean
+get_all_profiles_cancelled_cb (GCancellable *cancellable,
+                               GTask        *task)
+{
+    get_all_profiles_complete (task,
+                               g_error_new (G_IO_ERROR,
+                                            G_IO_ERROR_CANCELLED,
+                                            "Operation was cancelled"));
+    return G_SOURCE_REMOVE;
+}
+
+static void get_all_profiles_next (GTask *task);
+
+static void
+get_profile_settings_ready (QmiClientWds   *client,
+                            GAsyncResult   *res,
+                            ProfileContext *profile_ctx)
+{
+    GetAllProfilesContext                 *ctx;
+    QmiMessageWdsGetProfileSettingsOutput *output;
+    QmiWdsProfileSettings                 *settings;
+    GError                                *error = NULL;
+    const gchar                           *str;
+
+    ctx = g_task_get_task_data (profile_ctx->task);
+    ctx->n_pending--;
+
+    output = qmi_client_wds_get_profile_settings_finish (client, res, &error);
+    if (ctx->completed) {
+        g_clear_error (&error);
+        goto out;
+    }
+
+    settings = &g_array_index (ctx->profiles, QmiWdsProfileSettings, profile_ctx->i);
+    if (!output || !qmi_message_wds_get_profile_settings_output_get_result (output, &error)) {
+        g_prefix_error (&error, "Profile #%u: ", settings->profile_index);
+        get_all_profiles_complete (profile_ctx->task, error);
+        goto out;
+    }
+
+    if (qmi_message_wds_get_profile_settings_output_get_profile_name (output, &str, NULL)) {
+        g_free (settings->profile_name);
+        settings->profile_name = g_strdup (str);
+    }
+    if (qmi_message_wds_get_profile_settings_output_get_apn_name (output, &str, NULL))
+        settings->apn_name = g_strdup (str);
+    if (qmi_message_wds_get_profile_settings_output_get_username (output, &str, NULL))
+        settings->username = g_strdup (str);
+    qmi_message_wds_get_profile_settings_output_get_pdp_type (output, &settings->pdp_type, NULL);
+    qmi_message_wds_get_profile_settings_output_get_authentication (output, &settings->authentication, NULL);
+
+    get_all_profiles_next (profile_ctx->task);
+
+out:
+    if (output)
+        qmi_message_wds_get_profile_settings_output_unref (output);
+    g_object_unref (profile_ctx->task);
+    g_slice_free (ProfileContext, profile_ctx);
+}
+
+static void
+get_all_profiles_next (GTask *task)
+{
+    GetAllProfilesContext *ctx;
+    QmiClientWds          *client;
+
+    ctx = g_task_get_task_data (task);
+    client = QMI_CLIENT_WDS (g_task_get_source_object (task));
+
+    /* Keep the window full while there are profiles left */
+    while (ctx->next < ctx->profiles->len && ctx->n_pending < ctx->max_in_flight) {
+        QmiMessageWdsGetProfileSettingsInput *input;
+        QmiWdsProfileSettings                *settings;
+        ProfileContext                       *profile_ctx;
+
+        settings = &g_array_index (ctx->profiles, QmiWdsProfileSettings, ctx->next);
+
+        profile_ctx = g_slice_new (ProfileContext);
+        profile_ctx->task = g_object_ref (task);
+        profile_ctx->i = ctx->next++;
+        ctx->n_pending++;
+
+        input = qmi_message_wds_get_profile_settings_input_new ();
+        qmi_message_wds_get_profile_settings_input_set_profile_id (input,
+                                                                   settings->profile_type,
+                                                                   settings->profile_index,
+                                                                   NULL);
+        qmi_client_wds_get_profile_settings (client,
+                                             input,
+                                             REQUEST_TIMEOUT,
+                                             NULL,
+                                             (GAsyncReadyCallback) get_profile_settings_ready,
+                                             profile_ctx);
+        qmi_message_wds_get_profile_settings_input_unref (input);
+    }
+
+    if (!ctx->n_pending)
+        get_all_profiles_complete (task, NULL);
+}
+
+static void
+get_profile_list_ready (QmiClientWds *client,
+                        GAsyncResult *res,
+                        GTask        *task)
+{
+    GetAllProfilesContext             *ctx;
+    QmiMessageWdsGetProfileListOutput *output;
+    GError                            *error = NULL;
+    GArray                            *list = NULL;
+    guint                              i;
+
+    ctx = g_task_get_task_data (task);
+
+    output = qmi_client_wds_get_profile_list_finish (client, res, &error);
+    if (ctx->completed) {
+        g_clear_error (&error);
+        goto out;
+    }
+
+    if (!output ||
+        !qmi_message_wds_get_profile_list_output_get_result (output, &error) ||
+        !qmi_message_wds_get_profile_list_output_get_profile_list (output, &list, &error)) {
+        get_all_profiles_complete (task, error);
+        goto out;
+    }
+
+    /* All elements are given from the start, so that the results keep the
+     * order of the list regardless of the order of the responses */
+    g_array_set_size (ctx->profiles, list->len);
+    for (i = 0; i < list->len; i++) {
+        QmiMessageWdsGetProfileListOutputProfileListProfile *element;
+        QmiWdsProfileSettings                               *settings;
+
+        element = &g_array_index (list, QmiMessageWdsGetProfileListOutputProfileListProfile, i);
+        settings = &g_array_index (ctx->profiles, QmiWdsProfileSettings, i);
+        settings->profile_type = element->profile_type;
+        settings->profile_index = element->profile_index;
+        settings->profile_name = g_strdup (element->profile_name);
+    }
+
+    get_all_profiles_next (task);
+
+out:
+    if (output)
+        qmi_message_wds_get_profile_list_output_unref (output);
+    g_object_unref (task);
+}
+
+void
+qmi_client_wds_get_all_profiles (QmiClientWds        *self,
+                                 QmiWdsProfileType    profile_type,
+                                 guint                max_in_flight,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data)
+{
+    GTask                            *task;
+    GetAllProfilesContext            *ctx;
+    QmiMessageWdsGetProfileListInput *input;
+
+    g_return_if_fail (QMI_IS_CLIENT_WDS (self));
+    g_return_if_fail (max_in_flight > 0);
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    ctx = g_slice_new0 (GetAllProfilesContext);
+    ctx->max_in_flight = max_in_flight;
+    ctx->profiles = g_array_new (FALSE, TRUE, sizeof (QmiWdsProfileSettings));
+    g_array_set_clear_func (ctx->profiles, (GDestroyNotify) profile_settings_clear);
+    g_task_set_task_data (task, ctx, (GDestroyNotify) get_all_profiles_context_free);
+
+    /* The reference of the task is kept until the operation is completed,
+     * so that requests in flight can be ignored once cancelled */
+    if (cancellable) {
+        ctx->cancellable_source = g_cancellable_source_new (cancellable);
+        g_source_set_callback (ctx->cancellable_source, (GSourceFunc) get_all_profiles_cancelled_cb, task, NULL);
+        g_source_attach (ctx->cancellable_source, g_task_get_context (task));
+    }
+
+    input = qmi_message_wds_get_profile_list_input_new ();
+    qmi_message_wds_get_profile_list_input_set_profile_type (input, profile_type, NULL);
+    qmi_client_wds_get_profile_list (self,
+                                     input,
+                                     REQUEST_TIMEOUT,
+                                     NULL,
+                                     (GAsyncReadyCallback) get_profile_list_ready,
+                                     g_object_ref (task));
+    qmi_message_wds_get_profile_list_input_unref (input);
+}
@@ -0,0 +1,128 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_WDS_PROFILE_INVENTORY_H_
+#define _LIBQMI_GLIB_QMI_WDS_PROFILE_INVENTORY_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "qmi-enums-wds.h"
+#include "qmi-wds.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-wds-profile-inventory
+ * @title: WDS profile inventory
+ * @short_description: retrieval of the settings of all the profiles
+ *
+ * Helpers to get the main settings of all the profiles of a given type,
+ * issuing WDS Get Profile List and then up to a given number of WDS Get
+ * Profile Settings requests at the same time, instead of waiting for each
+ * one to finish before sending the next one.
+ *
+ * Both WDS Get Profile List and WDS Get Profile Settings responses are kept
+ * in the response cache of the #QmiDevice, if enabled with the
+ * #QmiDevice:device-response-cache property, until WDS Create Profile,
+ * WDS Modify Profile or WDS Delete Profile are sent in the same device.
+ */
+
+/**
+ * QmiWdsProfileSettings:
+ * @profile_type: a #QmiWdsProfileType.
+ * @profile_index: the profile index.
+ * @profile_name: the profile name, or %NULL if not given.
+ * @pdp_type: a #QmiWdsPdpType, or %QMI_WDS_PDP_TYPE_IPV4 if not given.
+ * @apn_name: the APN name, or %NULL if not given.
+ * @authentication: a #QmiWdsAuthentication mask, or %QMI_WDS_AUTHENTICATION_NONE if not given.
+ * @username: the username, or %NULL if not given.
+ *
+ * The main settings of one of the profiles listed by
+ * qmi_client_wds_get_all_profiles(). The password is not included, it can be
+ * retrieved with qmi_client_wds_get_profile_settings() when needed.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    QmiWdsProfileType     profile_type;
+    guint8                profile_index;
+    gchar                *profile_name;
+    QmiWdsPdpType         pdp_type;
+    gchar                *apn_name;
+    QmiWdsAuthentication  authentication;
+    gchar                *username;
+} QmiWdsProfileSettings;
+
+/**
+ * qmi_client_wds_get_all_profiles:
+ * @self: a #QmiClientWds.
+ * @profile_type: a #QmiWdsProfileType.
+ * @max_in_flight: the maximum number of WDS Get Profile Settings requests sent at the same time, at least 1.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously gets the settings of all the profiles of type
+ * @profile_type.
+ *
+ * The profiles are listed with WDS Get Profile List, and then the settings
+ * of each of them are requested with WDS Get Profile Settings, keeping up to
+ * @max_in_flight requests sent at any time. If the settings of any of the
+ * profiles cannot be retrieved, the operation fails.
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * qmi_client_wds_get_all_profiles_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_client_wds_get_all_profiles (QmiClientWds        *self,
+                                      QmiWdsProfileType    profile_type,
+                                      guint                max_in_flight,
+                                      GCancellable        *cancellable,
+                                      GAsyncReadyCallback  callback,
+                                      gpointer             user_data);
+
+/**
+ * qmi_client_wds_get_all_profiles_finish:
+ * @self: a #QmiClientWds.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_client_wds_get_all_profiles().
+ *
+ * Returns: (transfer full) (element-type QmiWdsProfileSettings): a #GArray of #QmiWdsProfileSettings elements, in the same order as given in WDS Get Profile List; or %NULL if @error is set. The returned value should be freed with g_array_unref().
+ *
+ * Since: 1.20
+ */
+GArray *qmi_client_wds_get_all_profiles_finish (QmiClientWds  *self,
+                                                GAsyncResult  *res,
+                                                GError       **error);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_WDS_PROFILE_INVENTORY_H_ */
@@ -0,0 +1,500 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "qmi-wds-start-networks.h"
+
+/* Timeout of each request sent, except for WDS Start Network */
+#define REQUEST_TIMEOUT 10
+
+/* Same timeout as used by qmicli */
+#define START_NETWORK_TIMEOUT 45
+
+/* Same settings as requested by qmicli */
+#define REQUESTED_SETTINGS                                              \
+    (QMI_WDS_GET_CURRENT_SETTINGS_REQUESTED_SETTINGS_DNS_ADDRESS      | \
+     QMI_WDS_GET_CURRENT_SETTINGS_REQUESTED_SETTINGS_GRANTED_QOS      | \
+     QMI_WDS_GET_CURRENT_SETTINGS_REQUESTED_SETTINGS_IP_ADDRESS       | \
+     QMI_WDS_GET_CURRENT_SETTINGS_REQUESTED_SETTINGS_GATEWAY_INFO     | \
+     QMI_WDS_GET_CURRENT_SETTINGS_REQUESTED_SETTINGS_MTU              | \
+     QMI_WDS_GET_CURRENT_SETTINGS_REQUESTED_SETTINGS_DOMAIN_NAME_LIST | \
+     QMI_WDS_GET_CURRENT_SETTINGS_REQUESTED_SETTINGS_IP_FAMILY)
+
+typedef struct {
+    /* All with one element per network */
+    GArray   *settings;
+    GArray   *networks;
+    gboolean *started;
+
+    guint     n_pending;
+
+    /* First error found, in the order of the networks */
+    GError   *error;
+    guint     error_i;
+} StartNetworksContext;
+
+typedef struct {
+    GTask *task;
+    guint  i;
+} NetworkContext;
+
+static void
+network_clear (QmiWdsNetwork *network)
+{
+    g_clear_object (&network->client);
+    if (network->current_settings) {
+        qmi_message_wds_get_current_settings_output_unref (network->current_settings);
+        network->current_settings = NULL;
+    }
+}
+
+static void
+start_networks_context_free (StartNetworksContext *ctx)
+{
+    if (ctx->error)
+        g_error_free (ctx->error);
+    if (ctx->networks)
+        g_array_unref (ctx->networks);
+    g_array_unref (ctx->settings);
+    g_free (ctx->started);
+    g_slice_free (StartNetworksContext, ctx);
+}
+
+GArray *
+qmi_device_start_networks_finish (QmiDevice     *self,
+                                  GAsyncResult  *res,
+                                  GError       **error)
+{
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+static NetworkContext *
+network_context_new (GTask *task,
+                     guint  i)
+{
+    StartNetworksContext *ctx;
+    NetworkContext       *network_ctx;
+
+    ctx = g_task_get_task_data (task);
+    ctx->n_pending++;
+
+    network_ctx = g_slice_new (NetworkContext);
+    network_ctx->task = g_object_ref (task);
+    network_ctx->i = i;
+    return network_ctx;
+}
+
+static void
+network_failed (NetworkContext *network_ctx,
+                GError         *error)
+{
+    StartNetworksContext *ctx;
+
+    ctx = g_task_get_task_data (network_ctx->task);
+
+    g_prefix_error (&error, "Network #%u: ", network_ctx->i);
+    g_debug ("%s", error->message);
+    if (!ctx->error || network_ctx->i < ctx->error_i) {
+        if (ctx->error)
+            g_error_free (ctx->error);
+        ctx->error = error;
+        ctx->error_i = network_ctx->i;
+    } else
+        g_error_free (error);
+}
+
+/*****************************************************************************/
+/* Cleanup on failure */
+
+static void
+cleanup_done (NetworkContext *network_ctx)
+{
+    GTask                *task;
+    StartNetworksContext *ctx;
+
+    task = network_ctx->task;
+    ctx = g_task_get_task_data (task);
+    g_slice_free (NetworkContext, network_ctx);
+
+    g_assert (ctx->n_pending > 0);
+    if (--ctx->n_pending == 0) {
+        g_task_return_error (task, ctx->error);
+        ctx->error = NULL;
+    }
+    g_object_unref (task);
+}
+
+static void
+release_client_ready (QmiDevice      *self,
+                      GAsyncResult   *res,
+                      NetworkContext *network_ctx)
+{
+    GError *error = NULL;
+
+    if (!qmi_device_release_client_finish (self, res, &error)) {
+        g_debug ("couldn't release WDS client: %s", error->message);
+        g_error_free (error);
+    }
+
+    cleanup_done (network_ctx);
+}
+
+static void
+cleanup_release_client (NetworkContext *network_ctx)
+{
+    StartNetworksContext *ctx;
+    QmiWdsNetwork        *network;
+
+    ctx = g_task_get_task_data (network_ctx->task);
+    network = &g_array_index (ctx->networks, QmiWdsNetwork, network_ctx->i);
+
+    qmi_device_release_client (g_task_get_source_object (network_ctx->task),
+                               QMI_CLIENT (network->client),
+                               QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID,
+                               REQUEST_TIMEOUT,
+                               NULL,
+                               (GAsyncReadyCallback) release_client_ready,
+                               network_ctx);
+}
+
+static void
+stop_network_ready (QmiClientWds   *client,
+                    GAsyncResult   *res,
+                    NetworkContext *network_ctx)
+{
+    QmiMessageWdsStopNetworkOutput *output;
+    GError                         *error = NULL;
+
+    output = qmi_client_wds_stop_network_finish (client, res, &error);
+    if (!output || !qmi_message_wds_stop_network_output_get_result (output, &error)) {
+        g_debug ("couldn't stop network: %s", error->message);
+        g_error_free (error);
+    }
+
+    if (output)
+        qmi_message_wds_stop_network_output_unref (output);
+    cleanup_release_client (network_ctx);
+}
+
+static void
+cleanup (GTask *task)
+{
+    StartNetworksContext *ctx;
+    guint                 i;
+
+    ctx = g_task_get_task_data (task);
+
+    for (i = 0; i < ctx->networks->len; i++) {
+        QmiWdsNetwork  *network;
+        NetworkContext *network_ctx;
+
+        network = &g_array_index (ctx->networks, QmiWdsNetwork, i);
+        if (!network->client)
+            continue;
+
+        network_ctx = network_context_new (task, i);
+        if (ctx->started[i]) {
+            QmiMessageWdsStopNetworkInput *input;
+
+            input = qmi_message_wds_stop_network_input_new ();
+            qmi_message_wds_stop_network_input_set_packet_data_handle (input, network->packet_data_handle, NULL);
+            qmi_client_wds_stop_network (network->client,
+                                         input,
+                                         REQUEST_TIMEOUT,
+                                         NULL,
+                                         (GAsyncReadyCallback) stop_network_ready,
+                                         network_ctx);
+            qmi_message_wds_stop_network_input_unref (input);
+        } else
+            cleanup_release_client (network_ctx);
+    }
+
+    /* No client to release */
+    if (ctx->n_pending == 0) {
+        g_task_return_error (task, ctx->error);
+        ctx->error = NULL;
+    }
+}
+
+/*****************************************************************************/
+/* Each network */
+
+static void
+network_done (NetworkContext *network_ctx)
+{
+    GTask                *task;
+    StartNetworksContext *ctx;
+
+    task = network_ctx->task;
+    ctx = g_task_get_task_data (task);
+    g_slice_free (NetworkContext, network_ctx);
+
+    g_assert (ctx->n_pending > 0);
+    if (--ctx->n_pending == 0) {
+        if (ctx->error)
+            cleanup (task);
+        else {
+            GArray *networks;
+
+            networks = ctx->networks;
+            ctx->networks = NULL;
+            g_task_return_pointer (task, networks, (GDestroyNotify) g_array_unref);
+        }
+    }
+    g_object_unref (task);
+}
+
+static void
+get_current_settings_ready (QmiClientWds   *client,
+                            GAsyncResult   *res,
+                            NetworkContext *network_ctx)
+{
+    QmiMessageWdsGetCurrentSettingsOutput *output;
+    StartNetworksContext                  *ctx;
+    GError                                *error = NULL;
+
+    ctx = g_task_get_task_data (network_ctx->task);
+
+    /* Not fatal, the network is already started */
+    output = qmi_client_wds_get_current_settings_finish (client, res, &error);
+    if (!output || !qmi_message_wds_get_current_settings_output_get_result (output, &error)) {
+        g_debug ("couldn't get current settings: %s", error->message);
+        g_error_free (error);
+        if (output)
+            qmi_message_wds_get_current_settings_output_unref (output);
+    } else
+        g_array_index (ctx->networks, QmiWdsNetwork, network_ctx->i).current_settings = output;
+
+    network_done (network_ctx);
+}
+
+static void
+start_network_ready (QmiClientWds   *client,
+                     GAsyncResult   *res,
+                     NetworkContext *network_ctx)
+{
+    QmiMessageWdsStartNetworkOutput       *output;
+    QmiMessageWdsGetCurrentSettingsInput  *input;
+    StartNetworksContext                  *ctx;
+    GError                                *error = NULL;
+
+    ctx = g_task_get_task_data (network_ctx->task);
+
+    output = qmi_client_wds_start_network_finish (client, res, &error);
+    if (!output ||
+        !qmi_message_wds_start_network_output_get_result (output, &error) ||
+        !qmi_message_wds_start_network_output_get_packet_data_handle (
+            output,
+            &g_array_index (ctx->networks, QmiWdsNetwork, network_ctx->i).packet_data_handle,
+            &error)) {
+        g_prefix_error (&error, "Couldn't start network: ");
+        network_failed (network_ctx, error);
+        if (output)
+            qmi_message_wds_start_network_output_unref (output);
+        network_done (network_ctx);
+        return;
+    }
+    qmi_message_wds_start_network_output_unref (output);
+    ctx->started[network_ctx->i] = TRUE;
+
+    /* No need to query the settings if other network already failed */
+    if (ctx->error) {
+        network_done (network_ctx);
+        return;
+    }
+
+    input = qmi_message_wds_get_current_settings_input_new ();
+    qmi_message_wds_get_current_settings_input_set_requested_settings (input, REQUESTED_SETTINGS, NULL);
+    qmi_client_wds_get_current_settings (client,
+                                         input,
+                                         REQUEST_TIMEOUT,
+                                         g_task_get_cancellable (network_ctx->task),
+                                         (GAsyncReadyCallback) get_current_settings_ready,
+                                         network_ctx);
+    qmi_message_wds_get_current_settings_input_unref (input);
+}
+
+static void
+start_network (NetworkContext *network_ctx)
+{
+    StartNetworksContext           *ctx;
+    QmiWdsNetworkSettings          *settings;
+    QmiMessageWdsStartNetworkInput *input;
+
+    ctx = g_task_get_task_data (network_ctx->task);
+    settings = &g_array_index (ctx->settings, QmiWdsNetworkSettings, network_ctx->i);
+
+    input = qmi_message_wds_start_network_input_new ();
+    if (settings->profile_index)
+        qmi_message_wds_start_network_input_set_profile_index_3gpp (input, settings->profile_index, NULL);
+    if (settings->ip_family != QMI_WDS_IP_FAMILY_UNSPECIFIED)
+        qmi_message_wds_start_network_input_set_ip_family_preference (input, settings->ip_family, NULL);
+    qmi_client_wds_start_network (g_array_index (ctx->networks, QmiWdsNetwork, network_ctx->i).client,
+                                  input,
+                                  START_NETWORK_TIMEOUT,
+                                  g_task_get_cancellable (network_ctx->task),
+                                  (GAsyncReadyCallback) start_network_ready,
+                                  network_ctx);
+    qmi_message_wds_start_network_input_unref (input);
+}
+
+static void
+set_ip_family_ready (QmiClientWds   *client,
+                     GAsyncResult   *res,
+                     NetworkContext *network_ctx)
+{
+    QmiMessageWdsSetIpFamilyOutput *output;
+    GError                         *error = NULL;
+
+    /* Not fatal, the preference is also given in WDS Start Network */
+    output = qmi_client_wds_set_ip_family_finish (client, res, &error);
+    if (!output || !qmi_message_wds_set_ip_family_output_get_result (output, &error)) {
+        g_debug ("couldn't set IP family: %s", error->message);
+        g_error_free (error);
+    }
+
+    if (output)
+        qmi_message_wds_set_ip_family_output_unref (output);
+    start_network (network_ctx);
+}
+
+static void
+network_start (GTask *task,
+               guint  i)
+{
+    StartNetworksContext          *ctx;
+    NetworkContext                *network_ctx;
+    QmiWdsNetworkSettings         *settings;
+    QmiMessageWdsSetIpFamilyInput *input;
+
+    ctx = g_task_get_task_data (task);
+    settings = &g_array_index (ctx->settings, QmiWdsNetworkSettings, i);
+    network_ctx = network_context_new (task, i);
+
+    if (settings->ip_family == QMI_WDS_IP_FAMILY_UNSPECIFIED) {
+        start_network (network_ctx);
+        return;
+    }
+
+    input = qmi_message_wds_set_ip_family_input_new ();
+    qmi_message_wds_set_ip_family_input_set_preference (input, settings->ip_family, NULL);
+    qmi_client_wds_set_ip_family (g_array_index (ctx->networks, QmiWdsNetwork, i).client,
+                                  input,
+                                  REQUEST_TIMEOUT,
+                                  g_task_get_cancellable (task),
+                                  (GAsyncReadyCallback) set_ip_family_ready,
+                                  network_ctx);
+    qmi_message_wds_set_ip_family_input_unref (input);
+}
+
+static void
+allocate_clients_ready (QmiDevice    *self,
+                        GAsyncResult *res,
+                        GTask        *task)
+{
+    StartNetworksContext *ctx;
+    GPtrArray            *clients;
+    GPtrArray            *errors = NULL;
+    GError               *error = NULL;
+    guint                 i;
+
+    ctx = g_task_get_task_data (task);
+
+    clients = qmi_device_allocate_clients_finish (self, res, &errors, &error);
+    if (!clients) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    for (i = 0; i < clients->len; i++) {
+        if (g_ptr_array_index (clients, i)) {
+            g_array_index (ctx->networks, QmiWdsNetwork, i).client = g_object_ref (g_ptr_array_index (clients, i));
+            continue;
+        }
+        if (!ctx->error) {
+            ctx->error = g_error_copy (g_ptr_array_index (errors, i));
+            ctx->error_i = i;
+            g_prefix_error (&ctx->error, "Network #%u: Couldn't allocate WDS client: ", i);
+        }
+    }
+    g_ptr_array_unref (errors);
+    g_ptr_array_unref (clients);
+
+    /* Don't start any network if not all clients are available */
+    if (ctx->error) {
+        cleanup (task);
+        g_object_unref (task);
+        return;
+    }
+
+    for (i = 0; i < ctx->networks->len; i++)
+        network_start (task, i);
+    g_object_unref (task);
+}
+
+void
+qmi_device_start_networks (QmiDevice                    *self,
+                           const QmiWdsNetworkSettings  *settings,
+                           guint                         n_settings,
+                           GCancellable                 *cancellable,
+                           GAsyncReadyCallback           callback,
+                           gpointer                      user_data)
+{
+    GTask                *task;
+    StartNetworksContext *ctx;
+    QmiService           *services;
+    guint                 i;
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (settings != NULL);
+    g_return_if_fail (n_settings > 0);
+
+    ctx = g_slice_new0 (StartNetworksContext);
+    ctx->settings = g_array_sized_new (FALSE, FALSE, sizeof (QmiWdsNetworkSettings), n_settings);
+    g_array_append_vals (ctx->settings, settings, n_settings);
+    ctx->networks = g_array_sized_new (FALSE, TRUE, sizeof (QmiWdsNetwork), n_settings);
+    g_array_set_clear_func (ctx->networks, (GDestroyNotify) network_clear);
+    g_array_set_size (ctx->networks, n_settings);
+    ctx->started = g_new0 (gboolean, n_settings);
+
+    /* On cancellation, the networks already started are stopped before
+     * returning the error */
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_check_cancellable (task, FALSE);
+    g_task_set_task_data (task, ctx, (GDestroyNotify) start_networks_context_free);
+
+    services = g_new (QmiService, n_settings);
+    for (i = 0; i < n_settings; i++)
+        services[i] = QMI_SERVICE_WDS;
+    qmi_device_allocate_clients (self,
+                                 services,
+                                 n_settings,
+                                 REQUEST_TIMEOUT,
+                                 cancellable,
+                                 (GAsyncReadyCallback) allocate_clients_ready,
+                                 task);
+    g_free (services);
+}
@@ -0,0 +1,131 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_WDS_START_NETWORKS_H_
+#define _LIBQMI_GLIB_QMI_WDS_START_NETWORKS_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "qmi-enums-wds.h"
+#include "qmi-device.h"
+#include "qmi-wds.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-wds-start-networks
+ * @title: WDS concurrent network start
+ * @short_description: start of multiple packet data networks at the same time
+ *
+ * Helpers to bring up several packet data networks (e.g. IPv4 and IPv6 on the
+ * same APN, or different APNs) at the same time, each of them on its own
+ * #QmiClientWds, instead of waiting for each WDS Start Network to finish
+ * before sending the next one.
+ */
+
+/**
+ * QmiWdsNetworkSettings:
+ * @profile_index: the 3GPP profile index, or 0 to use the default profile.
+ * @ip_family: a #QmiWdsIpFamily, or %QMI_WDS_IP_FAMILY_UNSPECIFIED to use the device default.
+ *
+ * The settings of one of the networks to start with qmi_device_start_networks().
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    guint8          profile_index;
+    QmiWdsIpFamily  ip_family;
+} QmiWdsNetworkSettings;
+
+/**
+ * QmiWdsNetwork:
+ * @client: the #QmiClientWds handling the network.
+ * @packet_data_handle: the packet data handle of the network, to be used in WDS Stop Network.
+ * @current_settings: the #QmiMessageWdsGetCurrentSettingsOutput of the network, or %NULL if they couldn't be retrieved.
+ *
+ * One of the networks started with qmi_device_start_networks().
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    QmiClientWds                          *client;
+    guint32                                packet_data_handle;
+    QmiMessageWdsGetCurrentSettingsOutput *current_settings;
+} QmiWdsNetwork;
+
+/**
+ * qmi_device_start_networks:
+ * @self: a #QmiDevice.
+ * @settings: (array length=n_settings): the #QmiWdsNetworkSettings of each network.
+ * @n_settings: the number of elements in @settings, at least 1.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously starts one packet data network for each of the given
+ * @settings.
+ *
+ * All the #QmiClientWds needed are allocated at once with
+ * qmi_device_allocate_clients(). Then, the WDS Set IP Family, WDS Start Network
+ * and WDS Get Current Settings sequences of all networks run at the same time,
+ * each one on its own client.
+ *
+ * If any of the networks cannot be started, the ones already started are
+ * stopped, all the clients are released, and the operation fails.
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * qmi_device_start_networks_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_device_start_networks (QmiDevice                    *self,
+                                const QmiWdsNetworkSettings  *settings,
+                                guint                         n_settings,
+                                GCancellable                 *cancellable,
+                                GAsyncReadyCallback           callback,
+                                gpointer                      user_data);
+
+/**
+ * qmi_device_start_networks_finish:
+ * @self: a #QmiDevice.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_start_networks().
+ *
+ * Returns: (transfer full) (element-type QmiWdsNetwork): a #GArray of #QmiWdsNetwork elements, one for each of the requested networks, in the same order; or %NULL if @error is set. The returned value should be freed with g_array_unref().
+ *
+ * Since: 1.20
+ */
+GArray *qmi_device_start_networks_finish (QmiDevice     *self,
+                                          GAsyncResult  *res,
+                                          GError       **error);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_WDS_START_NETWORKS_H_ */
@@ -0,0 +1,653 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "qmi-wds-stats-sampler.h"
+#include "qmi-enums-wds.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+static void async_initable_iface_init (GAsyncInitableIface *iface);
+
+G_DEFINE_TYPE_EXTENDED (QmiWdsStatsSampler, qmi_wds_stats_sampler, G_TYPE_OBJECT, 0,
+                        G_IMPLEMENT_INTERFACE (G_TYPE_ASYNC_INITABLE, async_initable_iface_init))
+
+/* Timeout of each request sent */
+#define REQUEST_TIMEOUT 10
+
+#define MAX_HISTORY_SIZE 86400
+
+/* Values reported by some devices when a counter is not available */
+#define UNKNOWN_COUNTER_32 G_MAXUINT32
+#define UNKNOWN_COUNTER_64 G_MAXUINT64
+
+enum {
+    PROP_0,
+    PROP_CLIENT,
+    PROP_INTERVAL,
+    PROP_HISTORY_SIZE,
+    PROP_LAST
+};
+
+enum {
+    SIGNAL_UPDATED,
+    SIGNAL_LAST
+};
+
+static GParamSpec *properties[PROP_LAST];
+static guint       signals[SIGNAL_LAST] = { 0 };
+
+struct _QmiWdsStatsSamplerPrivate {
+    QmiClientWds *client;
+    guint         interval;
+    guint         history_size;
+
+    /* Sampling, in the context where the sampler was created */
+    GMainContext *context;
+    gboolean      polling;
+    gulong        event_report_id;
+    GSource      *poll_source;
+    gboolean      poll_pending;
+
+    /* Ring of samples, allocated once; the lock allows reading them from
+     * other threads */
+    GMutex             samples_lock;
+    QmiWdsStatsSample *samples;
+    guint              samples_head;
+    guint              n_samples;
+};
+
+/*****************************************************************************/
+
+QmiClientWds *
+qmi_wds_stats_sampler_peek_client (QmiWdsStatsSampler *self)
+{
+    g_return_val_if_fail (QMI_IS_WDS_STATS_SAMPLER (self), NULL);
+
+    return self->priv->client;
+}
+
+gboolean
+qmi_wds_stats_sampler_get_polling (QmiWdsStatsSampler *self)
+{
+    g_return_val_if_fail (QMI_IS_WDS_STATS_SAMPLER (self), FALSE);
+
+    return self->priv->polling;
+}
+
+guint
+qmi_wds_stats_sampler_get_n_samples (QmiWdsStatsSampler *self)
+{
+    guint n_samples;
+
+    g_return_val_if_fail (QMI_IS_WDS_STATS_SAMPLER (self), 0);
+
+    g_mutex_lock (&self->priv->samples_lock);
+    n_samples = self->priv->n_samples;
+    g_mutex_unlock (&self->priv->samples_lock);
+    return n_samples;
+}
+
+gboolean
+qmi_wds_stats_sampler_get_sample (QmiWdsStatsSampler *self,
+                                  guint               index,
+                                  QmiWdsStatsSample  *sample)
+{
+    gboolean found = FALSE;
+
+    g_return_val_if_fail (QMI_IS_WDS_STATS_SAMPLER (self), FALSE);
+    g_return_val_if_fail (sample != NULL, FALSE);
+
+    g_mutex_lock (&self->priv->samples_lock);
+    if (index < self->priv->n_samples) {
+        guint position;
+
+        position = (self->priv->samples_head + self->priv->history_size - index) % self->priv->history_size;
+        *sample = self->priv->samples[position];
+        found = TRUE;
+    }
+    g_mutex_unlock (&self->priv->samples_lock);
+    return found;
+}
+
+/*****************************************************************************/
+/* New samples */
+
+#define COUNTER_DELTA(current, previous) \
+    ((current) >= (previous) ? (current) - (previous) : (current))
+
+/* Only the totals given; the rest is computed with respect to the latest
+ * sample, which is overwritten if the history is full */
+static void
+samples_add (QmiWdsStatsSampler *self,
+             guint64             tx_bytes,
+             guint64             rx_bytes,
+             guint32             tx_packets,
+             guint32             rx_packets)
+{
+    QmiWdsStatsSample  previous = { 0 };
+    QmiWdsStatsSample *sample;
+    gboolean           has_previous;
+
+    g_mutex_lock (&self->priv->samples_lock);
+
+    has_previous = (self->priv->n_samples > 0);
+    if (has_previous) {
+        previous = self->priv->samples[self->priv->samples_head];
+        self->priv->samples_head = (self->priv->samples_head + 1) % self->priv->history_size;
+    }
+    if (self->priv->n_samples < self->priv->history_size)
+        self->priv->n_samples++;
+
+    sample = &self->priv->samples[self->priv->samples_head];
+    memset (sample, 0, sizeof (QmiWdsStatsSample));
+    sample->timestamp = g_get_monotonic_time ();
+    sample->tx_bytes = tx_bytes;
+    sample->rx_bytes = rx_bytes;
+    sample->tx_packets = tx_packets;
+    sample->rx_packets = rx_packets;
+
+    if (has_previous) {
+        sample->interval = sample->timestamp - previous.timestamp;
+        sample->tx_bytes_delta = COUNTER_DELTA (tx_bytes, previous.tx_bytes);
+        sample->rx_bytes_delta = COUNTER_DELTA (rx_bytes, previous.rx_bytes);
+        sample->tx_packets_delta = COUNTER_DELTA (tx_packets, previous.tx_packets);
+        sample->rx_packets_delta = COUNTER_DELTA (rx_packets, previous.rx_packets);
+        if (sample->interval > 0) {
+            sample->tx_rate = ((gdouble) sample->tx_bytes_delta * G_USEC_PER_SEC) / sample->interval;
+            sample->rx_rate = ((gdouble) sample->rx_bytes_delta * G_USEC_PER_SEC) / sample->interval;
+        }
+    }
+
+    g_mutex_unlock (&self->priv->samples_lock);
+
+    g_signal_emit (self, signals[SIGNAL_UPDATED], 0);
+}
+
+/* Counters not given keep the value of the latest sample */
+static void
+samples_latest_totals (QmiWdsStatsSampler *self,
+                       guint64            *tx_bytes,
+                       guint64            *rx_bytes,
+                       guint32            *tx_packets,
+                       guint32            *rx_packets)
+{
+    QmiWdsStatsSample latest;
+
+    if (!qmi_wds_stats_sampler_get_sample (self, 0, &latest))
+        memset (&latest, 0, sizeof (latest));
+
+    *tx_bytes = latest.tx_bytes;
+    *rx_bytes = latest.rx_bytes;
+    *tx_packets = latest.tx_packets;
+    *rx_packets = latest.rx_packets;
+}
+
+static void
+event_report_indication_cb (QmiClientWds                      *client,
+                            QmiIndicationWdsEventReportOutput *output,
+                            QmiWdsStatsSampler                *self)
+{
+    guint64  tx_bytes;
+    guint64  rx_bytes;
+    guint32  tx_packets;
+    guint32  rx_packets;
+    guint64  value64;
+    guint32  value32;
+    gboolean found = FALSE;
+
+    samples_latest_totals (self, &tx_bytes, &rx_bytes, &tx_packets, &rx_packets);
+
+    if (qmi_indication_wds_event_report_output_get_tx_bytes_ok (output, &value64, NULL) && value64 != UNKNOWN_COUNTER_64) {
+        tx_bytes = value64;
+        found = TRUE;
+    }
+    if (qmi_indication_wds_event_report_output_get_rx_bytes_ok (output, &value64, NULL) && value64 != UNKNOWN_COUNTER_64) {
+        rx_bytes = value64;
+        found = TRUE;
+    }
+    if (qmi_indication_wds_event_report_output_get_tx_packets_ok (output, &value32, NULL) && value32 != UNKNOWN_COUNTER_32) {
+        tx_packets = value32;
+        found = TRUE;
+    }
+    if (qmi_indication_wds_event_report_output_get_rx_packets_ok (output, &value32, NULL) && value32 != UNKNOWN_COUNTER_32) {
+        rx_packets = value32;
+        found = TRUE;
+    }
+
+    /* Not a transfer statistics report */
+    if (!found)
+        return;
+
+    samples_add (self, tx_bytes, rx_bytes, tx_packets, rx_packets);
+}
+
+/*****************************************************************************/
+/* Polling */
+
+static void
+get_packet_statistics_ready (QmiClientWds       *client,
+                             GAsyncResult       *res,
+                             QmiWdsStatsSampler *self)
+{
+    QmiMessageWdsGetPacketStatisticsOutput *output;
+    GError                                 *error = NULL;
+    guint64                                 tx_bytes;
+    guint64                                 rx_bytes;
+    guint32                                 tx_packets;
+    guint32                                 rx_packets;
+    guint64                                 value64;
+    guint32                                 value32;
+
+    self->priv->poll_pending = FALSE;
+
+    output = qmi_client_wds_get_packet_statistics_finish (client, res, &error);
+    if (!output || !qmi_message_wds_get_packet_statistics_output_get_result (output, &error)) {
+        /* e.g. out of call */
+        g_debug ("couldn't get packet statistics: %s", error->message);
+        g_error_free (error);
+    } else {
+        samples_latest_totals (self, &tx_bytes, &rx_bytes, &tx_packets, &rx_packets);
+        if (qmi_message_wds_get_packet_statistics_output_get_tx_bytes_ok (output, &value64, NULL) && value64 != UNKNOWN_COUNTER_64)
+            tx_bytes = value64;
+        if (qmi_message_wds_get_packet_statistics_output_get_rx_bytes_ok (output, &value64, NULL) && value64 != UNKNOWN_COUNTER_64)
+            rx_bytes = value64;
+        if (qmi_message_wds_get_packet_statistics_output_get_tx_packets_ok (output, &value32, NULL) && value32 != UNKNOWN_COUNTER_32)
+            tx_packets = value32;
+        if (qmi_message_wds_get_packet_statistics_output_get_rx_packets_ok (output, &value32, NULL) && value32 != UNKNOWN_COUNTER_32)
+            rx_packets = value32;
+        samples_add (self, tx_bytes, rx_bytes, tx_packets, rx_packets);
+    }
+
+    if (output)
+        qmi_message_wds_get_packet_statistics_output_unref (output);
+    g_object_unref (self);
+}
+
+static gboolean
+poll_cb (QmiWdsStatsSampler *self)
+{
+    QmiMessageWdsGetPacketStatisticsInput *input;
+
+    /* Never more than one request at a time, even if the device is slow */
+    if (self->priv->poll_pending)
+        return G_SOURCE_CONTINUE;
+
+    input = qmi_message_wds_get_packet_statistics_input_new ();
+    qmi_message_wds_get_packet_statistics_input_set_mask (input,
+                                                          (QMI_WDS_PACKET_STATISTICS_MASK_FLAG_TX_BYTES_OK |
+                                                           QMI_WDS_PACKET_STATISTICS_MASK_FLAG_RX_BYTES_OK |
+                                                           QMI_WDS_PACKET_STATISTICS_MASK_FLAG_TX_PACKETS_OK |
+                                                           QMI_WDS_PACKET_STATISTICS_MASK_FLAG_RX_PACKETS_OK),
+                                                          NULL);
+    self->priv->poll_pending = TRUE;
+    qmi_client_wds_get_packet_statistics (self->priv->client,
+                                          input,
+                                          REQUEST_TIMEOUT,
+                                          NULL,
+                                          (GAsyncReadyCallback)get_packet_statistics_ready,
+                                          g_object_ref (self));
+    qmi_message_wds_get_packet_statistics_input_unref (input);
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+polling_start (QmiWdsStatsSampler *self)
+{
+    g_assert (!self->priv->poll_source);
+
+    self->priv->polling = TRUE;
+
+    /* Second-based timeouts are fired at the same time for all the samplers
+     * with the same interval, so the process wakes up once for all of them */
+    self->priv->poll_source = g_timeout_source_new_seconds (self->priv->interval);
+    g_source_set_callback (self->priv->poll_source, (GSourceFunc)poll_cb, self, NULL);
+    g_source_attach (self->priv->poll_source, self->priv->context);
+
+    /* Initial sample, so that rates are known from the first tick */
+    poll_cb (self);
+}
+
+/*****************************************************************************/
+/* New sampler */
+
+QmiWdsStatsSampler *
+qmi_wds_stats_sampler_new_finish (GAsyncResult  *res,
+                                  GError       **error)
+{
+    GObject *ret;
+    GObject *source_object;
+
+    source_object = g_async_result_get_source_object (res);
+    ret = g_async_initable_new_finish (G_ASYNC_INITABLE (source_object), res, error);
+    g_object_unref (source_object);
+
+    return (ret ? QMI_WDS_STATS_SAMPLER (ret) : NULL);
+}
+
+void
+qmi_wds_stats_sampler_new (QmiClientWds        *client,
+                           guint                interval,
+                           guint                history_size,
+                           GCancellable        *cancellable,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
+{
+    g_return_if_fail (QMI_IS_CLIENT_WDS (client));
+    g_return_if_fail (interval >= 1 && interval <= G_MAXUINT8);
+    g_return_if_fail (history_size >= 1 && history_size <= MAX_HISTORY_SIZE);
+
+    g_async_initable_new_async (QMI_TYPE_WDS_STATS_SAMPLER,
+                                G_PRIORITY_DEFAULT,
+                                cancellable,
+                                callback,
+                                user_data,
+                                QMI_WDS_STATS_SAMPLER_CLIENT,       client,
+                                QMI_WDS_STATS_SAMPLER_INTERVAL,     interval,
+                                QMI_WDS_STATS_SAMPLER_HISTORY_SIZE, history_size,
+                                NULL);
+}
+
+/*****************************************************************************/
+/* Async init */
+
+static gboolean
+initable_init_finish (GAsyncInitable  *initable,
+                      GAsyncResult    *result,
+                      GError         **error)
+{
+    return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static void
+set_event_report_ready (QmiClientWds *client,
+                        GAsyncResult *res,
+                        GTask        *task)
+{
+    QmiWdsStatsSampler                *self;
+    QmiMessageWdsSetEventReportOutput *output;
+    GError                            *error = NULL;
+
+    self = g_task_get_source_object (task);
+
+    output = qmi_client_wds_set_event_report_finish (client, res, &error);
+    if (g_task_return_error_if_cancelled (task)) {
+        g_clear_error (&error);
+        if (output)
+            qmi_message_wds_set_event_report_output_unref (output);
+        g_object_unref (task);
+        return;
+    }
+
+    if (!output || !qmi_message_wds_set_event_report_output_get_result (output, &error)) {
+        g_debug ("transfer statistics not reported in indications, polling instead: %s", error->message);
+        g_error_free (error);
+        polling_start (self);
+    } else
+        self->priv->event_report_id = g_signal_connect (self->priv->client,
+                                                        "event-report",
+                                                        G_CALLBACK (event_report_indication_cb),
+                                                        self);
+
+    if (output)
+        qmi_message_wds_set_event_report_output_unref (output);
+
+    g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+}
+
+static void
+initable_init_async (GAsyncInitable      *initable,
+                     int                  io_priority,
+                     GCancellable        *cancellable,
+                     GAsyncReadyCallback  callback,
+                     gpointer             user_data)
+{
+    QmiWdsStatsSampler               *self;
+    QmiMessageWdsSetEventReportInput *input;
+    GTask                            *task;
+
+    self = QMI_WDS_STATS_SAMPLER (initable);
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    if (!self->priv->client) {
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_INVALID_ARGS,
+                                 "Cannot initialize WDS statistics sampler: No client given");
+        g_object_unref (task);
+        return;
+    }
+
+    self->priv->context = g_main_context_ref_thread_default ();
+    self->priv->samples = g_new0 (QmiWdsStatsSample, self->priv->history_size);
+
+    input = qmi_message_wds_set_event_report_input_new ();
+    qmi_message_wds_set_event_report_input_set_transfer_statistics (input,
+                                                                    (guint8) self->priv->interval,
+                                                                    (QMI_WDS_SET_EVENT_REPORT_TRANSFER_STATISTICS_REPORT_TX_BYTES_OK |
+                                                                     QMI_WDS_SET_EVENT_REPORT_TRANSFER_STATISTICS_REPORT_RX_BYTES_OK |
+                                                                     QMI_WDS_SET_EVENT_REPORT_TRANSFER_STATISTICS_REPORT_TX_PACKETS_OK |
+                                                                     QMI_WDS_SET_EVENT_REPORT_TRANSFER_STATISTICS_REPORT_RX_PACKETS_OK),
+                                                                    NULL);
+    qmi_client_wds_set_event_report (self->priv->client,
+                                     input,
+                                     REQUEST_TIMEOUT,
+                                     cancellable,
+                                     (GAsyncReadyCallback)set_event_report_ready,
+                                     task);
+    qmi_message_wds_set_event_report_input_unref (input);
+}
+
+/*****************************************************************************/
+
+static void
+set_property (GObject      *object,
+              guint         prop_id,
+              const GValue *value,
+              GParamSpec   *pspec)
+{
+    QmiWdsStatsSampler *self = QMI_WDS_STATS_SAMPLER (object);
+
+    switch (prop_id) {
+    case PROP_CLIENT:
+        g_assert (self->priv->client == NULL);
+        self->priv->client = g_value_dup_object (value);
+        break;
+    case PROP_INTERVAL:
+        self->priv->interval = g_value_get_uint (value);
+        break;
+    case PROP_HISTORY_SIZE:
+        self->priv->history_size = g_value_get_uint (value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+get_property (GObject    *object,
+              guint       prop_id,
+              GValue     *value,
+              GParamSpec *pspec)
+{
+    QmiWdsStatsSampler *self = QMI_WDS_STATS_SAMPLER (object);
+
+    switch (prop_id) {
+    case PROP_CLIENT:
+        g_value_set_object (value, self->priv->client);
+        break;
+    case PROP_INTERVAL:
+        g_value_set_uint (value, self->priv->interval);
+        break;
+    case PROP_HISTORY_SIZE:
+        g_value_set_uint (value, self->priv->history_size);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+qmi_wds_stats_sampler_init (QmiWdsStatsSampler *self)
+{
+    self->priv = G_TYPE_INSTANCE_GET_PRIVATE ((self),
+                                              QMI_TYPE_WDS_STATS_SAMPLER,
+                                              QmiWdsStatsSamplerPrivate);
+
+    g_mutex_init (&self->priv->samples_lock);
+}
+
+static void
+dispose (GObject *object)
+{
+    QmiWdsStatsSampler *self = QMI_WDS_STATS_SAMPLER (object);
+
+    if (self->priv->poll_source) {
+        g_source_destroy (self->priv->poll_source);
+        g_source_unref (self->priv->poll_source);
+        self->priv->poll_source = NULL;
+    }
+
+    if (self->priv->client) {
+        if (self->priv->event_report_id) {
+            QmiMessageWdsSetEventReportInput *input;
+
+            g_signal_handler_disconnect (self->priv->client, self->priv->event_report_id);
+            self->priv->event_report_id = 0;
+
+            /* Stop the periodic reports, no need to wait for the result */
+            input = qmi_message_wds_set_event_report_input_new ();
+            qmi_message_wds_set_event_report_input_set_transfer_statistics (input, 0, 0, NULL);
+            qmi_client_wds_set_event_report (self->priv->client, input, REQUEST_TIMEOUT, NULL, NULL, NULL);
+            qmi_message_wds_set_event_report_input_unref (input);
+        }
+        g_clear_object (&self->priv->client);
+    }
+
+    if (self->priv->context) {
+        g_main_context_unref (self->priv->context);
+        self->priv->context = NULL;
+    }
+
+    G_OBJECT_CLASS (qmi_wds_stats_sampler_parent_class)->dispose (object);
+}
+
+static void
+finalize (GObject *object)
+{
+    QmiWdsStatsSampler *self = QMI_WDS_STATS_SAMPLER (object);
+
+    g_free (self->priv->samples);
+    g_mutex_clear (&self->priv->samples_lock);
+
+    G_OBJECT_CLASS (qmi_wds_stats_sampler_parent_class)->finalize (object);
+}
+
+static void
+async_initable_iface_init (GAsyncInitableIface *iface)
+{
+    iface->init_async = initable_init_async;
+    iface->init_finish = initable_init_finish;
+}
+
+static void
+qmi_wds_stats_sampler_class_init (QmiWdsStatsSamplerClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    g_type_class_add_private (object_class, sizeof (QmiWdsStatsSamplerPrivate));
+
+    object_class->get_property = get_property;
+    object_class->set_property = set_property;
+    object_class->dispose = dispose;
+    object_class->finalize = finalize;
+
+    /**
+     * QmiWdsStatsSampler:wds-stats-sampler-client:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_CLIENT] =
+        g_param_spec_object (QMI_WDS_STATS_SAMPLER_CLIENT,
+                             "WDS client",
+                             "The WDS client of the sampled connection",
+                             QMI_TYPE_CLIENT_WDS,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_CLIENT, properties[PROP_CLIENT]);
+
+    /**
+     * QmiWdsStatsSampler:wds-stats-sampler-interval:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_INTERVAL] =
+        g_param_spec_uint (QMI_WDS_STATS_SAMPLER_INTERVAL,
+                           "Interval",
+                           "Sampling interval, in seconds",
+                           1,
+                           G_MAXUINT8,
+                           1,
+                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_INTERVAL, properties[PROP_INTERVAL]);
+
+    /**
+     * QmiWdsStatsSampler:wds-stats-sampler-history-size:
+     *
+     * Since: 1.20
+     */
+    properties[PROP_HISTORY_SIZE] =
+        g_param_spec_uint (QMI_WDS_STATS_SAMPLER_HISTORY_SIZE,
+                           "History size",
+                           "Number of samples kept",
+                           1,
+                           MAX_HISTORY_SIZE,
+                           60,
+                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_HISTORY_SIZE, properties[PROP_HISTORY_SIZE]);
+
+    /**
+     * QmiWdsStatsSampler::updated:
+     * @object: A #QmiWdsStatsSampler.
+     *
+     * The ::updated signal is emitted whenever a new sample is added to the
+     * history, with all the counters of the connection at once.
+     *
+     * Since: 1.20
+     */
+    signals[SIGNAL_UPDATED] =
+        g_signal_new (QMI_WDS_STATS_SAMPLER_SIGNAL_UPDATED,
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      0);
+}
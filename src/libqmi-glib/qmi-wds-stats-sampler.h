@@ -0,0 +1,262 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_WDS_STATS_SAMPLER_H_
+#define _LIBQMI_GLIB_QMI_WDS_STATS_SAMPLER_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "qmi-wds.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-wds-stats-sampler
+ * @title: QmiWdsStatsSampler
+ * @short_description: periodic sampling of the WDS transfer statistics
+ *
+ * The #QmiWdsStatsSampler periodically samples the byte and packet counters
+ * of the data connection handled by a #QmiClientWds, and keeps the latest
+ * samples, including the differences with respect to the previous one and
+ * the transfer rates, in a fixed-size history.
+ *
+ * Whenever possible, the device is asked to report the counters periodically
+ * in WDS Event Report indications, so that no request is needed for each
+ * sample. If the device doesn't support it, WDS Get Packet Statistics is
+ * polled instead, aligned with the polling of all other samplers using the
+ * same interval, so that the process wakes up once for all of them.
+ *
+ * No memory is allocated per sample.
+ */
+
+/**
+ * QmiWdsStatsSample:
+ * @timestamp: monotonic time when the sample was taken, in microseconds.
+ * @interval: time elapsed since the previous sample, in microseconds, or 0 if this is the first one.
+ * @tx_bytes: total number of bytes correctly sent.
+ * @rx_bytes: total number of bytes correctly received.
+ * @tx_packets: total number of packets correctly sent.
+ * @rx_packets: total number of packets correctly received.
+ * @tx_bytes_delta: number of bytes sent since the previous sample.
+ * @rx_bytes_delta: number of bytes received since the previous sample.
+ * @tx_packets_delta: number of packets sent since the previous sample.
+ * @rx_packets_delta: number of packets received since the previous sample.
+ * @tx_rate: average transmission rate since the previous sample, in bytes per second.
+ * @rx_rate: average reception rate since the previous sample, in bytes per second.
+ *
+ * A sample of the transfer statistics. If the counters are reset by the device
+ * (e.g. on a new connection), the deltas are computed from zero.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    gint64  timestamp;
+    gint64  interval;
+    guint64 tx_bytes;
+    guint64 rx_bytes;
+    guint32 tx_packets;
+    guint32 rx_packets;
+    guint64 tx_bytes_delta;
+    guint64 rx_bytes_delta;
+    guint32 tx_packets_delta;
+    guint32 rx_packets_delta;
+    gdouble tx_rate;
+    gdouble rx_rate;
+} QmiWdsStatsSample;
+
+#define QMI_TYPE_WDS_STATS_SAMPLER            (qmi_wds_stats_sampler_get_type ())
+#define QMI_WDS_STATS_SAMPLER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), QMI_TYPE_WDS_STATS_SAMPLER, QmiWdsStatsSampler))
+#define QMI_WDS_STATS_SAMPLER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  QMI_TYPE_WDS_STATS_SAMPLER, QmiWdsStatsSamplerClass))
+#define QMI_IS_WDS_STATS_SAMPLER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), QMI_TYPE_WDS_STATS_SAMPLER))
+#define QMI_IS_WDS_STATS_SAMPLER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  QMI_TYPE_WDS_STATS_SAMPLER))
+#define QMI_WDS_STATS_SAMPLER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  QMI_TYPE_WDS_STATS_SAMPLER, QmiWdsStatsSamplerClass))
+
+typedef struct _QmiWdsStatsSampler QmiWdsStatsSampler;
+typedef struct _QmiWdsStatsSamplerClass QmiWdsStatsSamplerClass;
+typedef struct _QmiWdsStatsSamplerPrivate QmiWdsStatsSamplerPrivate;
+
+/**
+ * QMI_WDS_STATS_SAMPLER_CLIENT:
+ *
+ * Symbol defining the #QmiWdsStatsSampler:wds-stats-sampler-client property.
+ *
+ * Since: 1.20
+ */
+#define QMI_WDS_STATS_SAMPLER_CLIENT "wds-stats-sampler-client"
+
+/**
+ * QMI_WDS_STATS_SAMPLER_INTERVAL:
+ *
+ * Symbol defining the #QmiWdsStatsSampler:wds-stats-sampler-interval property.
+ *
+ * Since: 1.20
+ */
+#define QMI_WDS_STATS_SAMPLER_INTERVAL "wds-stats-sampler-interval"
+
+/**
+ * QMI_WDS_STATS_SAMPLER_HISTORY_SIZE:
+ *
+ * Symbol defining the #QmiWdsStatsSampler:wds-stats-sampler-history-size property.
+ *
+ * Since: 1.20
+ */
+#define QMI_WDS_STATS_SAMPLER_HISTORY_SIZE "wds-stats-sampler-history-size"
+
+/**
+ * QMI_WDS_STATS_SAMPLER_SIGNAL_UPDATED:
+ *
+ * Symbol defining the #QmiWdsStatsSampler::updated signal.
+ *
+ * Since: 1.20
+ */
+#define QMI_WDS_STATS_SAMPLER_SIGNAL_UPDATED "updated"
+
+/**
+ * QmiWdsStatsSampler:
+ *
+ * The #QmiWdsStatsSampler structure contains private data and should only be
+ * accessed using the provided API.
+ *
+ * Since: 1.20
+ */
+struct _QmiWdsStatsSampler {
+    /*< private >*/
+    GObject parent;
+    QmiWdsStatsSamplerPrivate *priv;
+};
+
+struct _QmiWdsStatsSamplerClass {
+    /*< private >*/
+    GObjectClass parent;
+};
+
+GType qmi_wds_stats_sampler_get_type (void);
+
+/**
+ * qmi_wds_stats_sampler_new:
+ * @client: a #QmiClientWds.
+ * @interval: the sampling interval, in seconds, between 1 and 255.
+ * @history_size: the number of samples to keep, at least 1.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the initialization is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously creates a #QmiWdsStatsSampler for the data connection handled
+ * by @client, and starts sampling.
+ *
+ * When the operation is finished, @callback will be invoked in the
+ * <link linkend="g-main-context-push-thread-default">thread-default main context</link>
+ * of the thread you are calling this method from, which is also the one where
+ * the sampling is done. You can then call qmi_wds_stats_sampler_new_finish()
+ * to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_wds_stats_sampler_new (QmiClientWds        *client,
+                                guint                interval,
+                                guint                history_size,
+                                GCancellable        *cancellable,
+                                GAsyncReadyCallback  callback,
+                                gpointer             user_data);
+
+/**
+ * qmi_wds_stats_sampler_new_finish:
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_wds_stats_sampler_new().
+ *
+ * Returns: (transfer full): a newly created #QmiWdsStatsSampler, or %NULL if @error is set.
+ *
+ * Since: 1.20
+ */
+QmiWdsStatsSampler *qmi_wds_stats_sampler_new_finish (GAsyncResult  *res,
+                                                      GError       **error);
+
+/**
+ * qmi_wds_stats_sampler_peek_client:
+ * @self: a #QmiWdsStatsSampler.
+ *
+ * Get the #QmiClientWds used by the sampler, without increasing the reference
+ * count on the returned object.
+ *
+ * Returns: (transfer none): a #QmiClientWds. Do not free the returned object, it is owned by @self.
+ *
+ * Since: 1.20
+ */
+QmiClientWds *qmi_wds_stats_sampler_peek_client (QmiWdsStatsSampler *self);
+
+/**
+ * qmi_wds_stats_sampler_get_polling:
+ * @self: a #QmiWdsStatsSampler.
+ *
+ * Gets whether the statistics are polled, because the device doesn't report
+ * them in indications.
+ *
+ * Returns: %TRUE if polling, %FALSE otherwise.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_wds_stats_sampler_get_polling (QmiWdsStatsSampler *self);
+
+/**
+ * qmi_wds_stats_sampler_get_n_samples:
+ * @self: a #QmiWdsStatsSampler.
+ *
+ * Gets the number of samples currently in the history, which is never more
+ * than the history size given when creating the sampler.
+ *
+ * This method may be called from any thread.
+ *
+ * Returns: the number of samples.
+ *
+ * Since: 1.20
+ */
+guint qmi_wds_stats_sampler_get_n_samples (QmiWdsStatsSampler *self);
+
+/**
+ * qmi_wds_stats_sampler_get_sample:
+ * @self: a #QmiWdsStatsSampler.
+ * @index: the index of the sample in the history, 0 being the latest one.
+ * @sample: (out): a placeholder for the output #QmiWdsStatsSample.
+ *
+ * Gets a copy of one of the samples in the history.
+ *
+ * This method may be called from any thread.
+ *
+ * Returns: %TRUE if @sample is set, %FALSE if there is no such sample.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_wds_stats_sampler_get_sample (QmiWdsStatsSampler *self,
+                                           guint               index,
+                                           QmiWdsStatsSample  *sample);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_WDS_STATS_SAMPLER_H_ */
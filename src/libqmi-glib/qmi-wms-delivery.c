@@ -0,0 +1,220 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "qmi-wms-delivery.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+/* Timeout of each request sent */
+#define REQUEST_TIMEOUT 10
+
+/* Classes of 3GPP point-to-point messages with a route */
+static const QmiWmsMessageClass route_classes[] = {
+    QMI_WMS_MESSAGE_CLASS_0,
+    QMI_WMS_MESSAGE_CLASS_1,
+    QMI_WMS_MESSAGE_CLASS_2,
+    QMI_WMS_MESSAGE_CLASS_3,
+    QMI_WMS_MESSAGE_CLASS_NONE,
+};
+
+static void set_routes (GTask              *task,
+                        QmiWmsDeliveryMode  mode);
+
+gboolean
+qmi_client_wms_setup_direct_delivery_finish (QmiClientWms        *self,
+                                             GAsyncResult        *res,
+                                             QmiWmsDeliveryMode  *out_mode,
+                                             GError             **error)
+{
+    gssize mode;
+
+    mode = g_task_propagate_int (G_TASK (res), error);
+    if (mode < 0)
+        return FALSE;
+
+    if (out_mode)
+        *out_mode = (QmiWmsDeliveryMode) mode;
+    return TRUE;
+}
+
+static void
+set_event_report_ready (QmiClientWms *self,
+                        GAsyncResult *res,
+                        GTask        *task)
+{
+    QmiMessageWmsSetEventReportOutput *output;
+    GError                            *error = NULL;
+
+    output = qmi_client_wms_set_event_report_finish (self, res, &error);
+    if (!output || !qmi_message_wms_set_event_report_output_get_result (output, &error)) {
+        g_prefix_error (&error, "Couldn't enable new message reports: ");
+        g_task_return_error (task, error);
+    } else
+        g_task_return_int (task, GPOINTER_TO_INT (g_task_get_task_data (task)));
+
+    if (output)
+        qmi_message_wms_set_event_report_output_unref (output);
+    g_object_unref (task);
+}
+
+static void
+set_routes_ready (QmiClientWms *self,
+                  GAsyncResult *res,
+                  GTask        *task)
+{
+    QmiMessageWmsSetRoutesOutput     *output;
+    QmiMessageWmsSetEventReportInput *input;
+    QmiWmsDeliveryMode                mode;
+    GError                           *error = NULL;
+
+    mode = (QmiWmsDeliveryMode) GPOINTER_TO_INT (g_task_get_task_data (task));
+
+    output = qmi_client_wms_set_routes_finish (self, res, &error);
+    if (!output || !qmi_message_wms_set_routes_output_get_result (output, &error)) {
+        if (output)
+            qmi_message_wms_set_routes_output_unref (output);
+
+        if (g_cancellable_is_cancelled (g_task_get_cancellable (task))) {
+            g_task_return_error (task, error);
+            g_object_unref (task);
+            return;
+        }
+
+        /* Fallback to the stored messages, as long as they're notified */
+        if (mode == QMI_WMS_DELIVERY_MODE_TRANSFER) {
+            g_debug ("transfer routes not supported: %s", error->message);
+            g_error_free (error);
+            set_routes (task, QMI_WMS_DELIVERY_MODE_STORE_AND_NOTIFY);
+            return;
+        }
+
+        /* Otherwise keep the routes configured in the modem */
+        g_debug ("couldn't set store and notify routes: %s", error->message);
+        g_error_free (error);
+    } else
+        qmi_message_wms_set_routes_output_unref (output);
+
+    input = qmi_message_wms_set_event_report_input_new ();
+    qmi_message_wms_set_event_report_input_set_new_mt_message_indicator (input, TRUE, NULL);
+    qmi_client_wms_set_event_report (self,
+                                     input,
+                                     REQUEST_TIMEOUT,
+                                     g_task_get_cancellable (task),
+                                     (GAsyncReadyCallback) set_event_report_ready,
+                                     task);
+    qmi_message_wms_set_event_report_input_unref (input);
+}
+
+static void
+set_routes (GTask              *task,
+            QmiWmsDeliveryMode  mode)
+{
+    QmiMessageWmsSetRoutesInput *input;
+    GArray                      *route_list;
+    guint                        i;
+
+    g_task_set_task_data (task, GINT_TO_POINTER (mode), NULL);
+
+    route_list = g_array_sized_new (FALSE, FALSE, sizeof (QmiMessageWmsSetRoutesInputRouteListElement), G_N_ELEMENTS (route_classes));
+    for (i = 0; i < G_N_ELEMENTS (route_classes); i++) {
+        QmiMessageWmsSetRoutesInputRouteListElement route;
+
+        route.message_type = QMI_WMS_MESSAGE_TYPE_POINT_TO_POINT;
+        route.message_class = route_classes[i];
+
+        /* Class 2 messages are meant to be stored in the SIM card */
+        if (route.message_class == QMI_WMS_MESSAGE_CLASS_2) {
+            route.storage = QMI_WMS_STORAGE_TYPE_UIM;
+            route.receipt_action = QMI_WMS_RECEIPT_ACTION_STORE_AND_NOTIFY;
+        } else if (mode == QMI_WMS_DELIVERY_MODE_TRANSFER) {
+            route.storage = QMI_WMS_STORAGE_TYPE_NONE;
+            route.receipt_action = QMI_WMS_RECEIPT_ACTION_TRANSFER_AND_ACK;
+        } else {
+            route.storage = QMI_WMS_STORAGE_TYPE_NV;
+            route.receipt_action = QMI_WMS_RECEIPT_ACTION_STORE_AND_NOTIFY;
+        }
+        g_array_append_val (route_list, route);
+    }
+
+    input = qmi_message_wms_set_routes_input_new ();
+    qmi_message_wms_set_routes_input_set_route_list (input, route_list, NULL);
+    if (mode == QMI_WMS_DELIVERY_MODE_TRANSFER)
+        qmi_message_wms_set_routes_input_set_transfer_status_report (input, QMI_WMS_TRANSFER_INDICATION_CLIENT, NULL);
+    qmi_client_wms_set_routes (g_task_get_source_object (task),
+                               input,
+                               REQUEST_TIMEOUT,
+                               g_task_get_cancellable (task),
+                               (GAsyncReadyCallback) set_routes_ready,
+                               task);
+    qmi_message_wms_set_routes_input_unref (input);
+    g_array_unref (route_list);
+}
+
+void
+qmi_client_wms_setup_direct_delivery (QmiClientWms        *self,
+                                      GCancellable        *cancellable,
+                                      GAsyncReadyCallback  callback,
+                                      gpointer             user_data)
+{
+    g_return_if_fail (QMI_IS_CLIENT_WMS (self));
+
+    set_routes (g_task_new (self, cancellable, callback, user_data),
+                QMI_WMS_DELIVERY_MODE_TRANSFER);
+}
+
+/*****************************************************************************/
+
+gboolean
+qmi_wms_pdu_view_init_from_event_report (QmiWmsPduView                      *view,
+                                         QmiIndicationWmsEventReportOutput  *output,
+                                         GError                            **error)
+{
+    QmiWmsMessageFormat  format;
+    GArray              *raw_data = NULL;
+
+    g_return_val_if_fail (view != NULL, FALSE);
+    g_return_val_if_fail (output != NULL, FALSE);
+
+    if (!qmi_indication_wms_event_report_output_get_transfer_route_mt_message (output,
+                                                                              NULL,
+                                                                              NULL,
+                                                                              &format,
+                                                                              &raw_data,
+                                                                              error))
+        return FALSE;
+
+    if (format != QMI_WMS_MESSAGE_FORMAT_GSM_WCDMA_POINT_TO_POINT) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_UNSUPPORTED,
+                     "Unsupported message format: %s",
+                     qmi_wms_message_format_get_string (format));
+        return FALSE;
+    }
+
+    /* The raw data array is owned by the output */
+    return qmi_wms_pdu_view_init (view, (const guint8 *) raw_data->data, raw_data->len, error);
+}
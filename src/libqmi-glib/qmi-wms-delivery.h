@@ -0,0 +1,119 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_WMS_DELIVERY_H_
+#define _LIBQMI_GLIB_QMI_WMS_DELIVERY_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "qmi-enums-wms.h"
+#include "qmi-wms.h"
+#include "qmi-wms-pdu.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-wms-delivery
+ * @title: WMS direct delivery
+ * @short_description: delivery of incoming messages within the WMS Event Report indications
+ *
+ * Helpers to have incoming messages delivered within the WMS Event Report
+ * indications, instead of stored and then notified, which otherwise requires
+ * a WMS Raw Read and a WMS Delete request per message.
+ */
+
+/**
+ * qmi_client_wms_setup_direct_delivery:
+ * @self: a #QmiClientWms.
+ * @cancellable: a #GCancellable or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: user data to pass to @callback.
+ *
+ * Asynchronously configures the message routes so that incoming messages are
+ * given in the Transfer Route MT Message TLV of the WMS Event Report
+ * indications, and enables the reports of new messages.
+ *
+ * The messages are acknowledged by the modem itself, with
+ * %QMI_WMS_RECEIPT_ACTION_TRANSFER_AND_ACK. Class 2 messages, which are
+ * specific to the SIM card, are still stored in the SIM card and notified with
+ * the MT Message TLV.
+ *
+ * If the transfer routes aren't supported by the firmware, all messages are
+ * stored and notified instead, and %QMI_WMS_DELIVERY_MODE_STORE_AND_NOTIFY is
+ * reported.
+ *
+ * When the operation is finished, @callback will be called. You can then call
+ * qmi_client_wms_setup_direct_delivery_finish() to get the result of the
+ * operation.
+ *
+ * Since: 1.20
+ */
+void qmi_client_wms_setup_direct_delivery (QmiClientWms        *self,
+                                           GCancellable        *cancellable,
+                                           GAsyncReadyCallback  callback,
+                                           gpointer             user_data);
+
+/**
+ * qmi_client_wms_setup_direct_delivery_finish:
+ * @self: a #QmiClientWms.
+ * @res: the #GAsyncResult obtained from the #GAsyncReadyCallback passed to qmi_client_wms_setup_direct_delivery().
+ * @out_mode: (out) (optional): return location for the #QmiWmsDeliveryMode configured, or %NULL.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an async operation started with qmi_client_wms_setup_direct_delivery().
+ *
+ * Returns: %TRUE if the delivery is configured, %FALSE if @error is set.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_client_wms_setup_direct_delivery_finish (QmiClientWms        *self,
+                                                      GAsyncResult        *res,
+                                                      QmiWmsDeliveryMode  *out_mode,
+                                                      GError             **error);
+
+/**
+ * qmi_wms_pdu_view_init_from_event_report:
+ * @view: a #QmiWmsPduView.
+ * @output: a #QmiIndicationWmsEventReportOutput.
+ * @error: Return location for error or %NULL.
+ *
+ * Parses the PDU given in the Transfer Route MT Message TLV of @output into
+ * @view, without copying it. @output must be kept valid while @view is in use.
+ *
+ * Returns: %TRUE if @view is initialized, %FALSE if @error is set, e.g. if
+ * @output doesn't have a 3GPP point-to-point message.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_wms_pdu_view_init_from_event_report (QmiWmsPduView                      *view,
+                                                  QmiIndicationWmsEventReportOutput  *output,
+                                                  GError                            **error);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_WMS_DELIVERY_H_ */
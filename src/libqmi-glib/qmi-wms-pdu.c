@@ -0,0 +1,711 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <string.h>
+
+#include "qmi-wms-pdu.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+/* Address fields are at most 12 octets long, i.e. 20 semi-octets */
+#define ADDRESS_MAX_DIGITS 20
+
+/* User data is at most 140 octets long, i.e. 160 septets */
+#define USER_DATA_MAX_SIZE     140
+#define USER_DATA_MAX_SEPTETS  160
+
+#define TIMESTAMP_SIZE 7
+
+/* Type of number */
+#define TYPE_OF_NUMBER_MASK          0x70
+#define TYPE_OF_NUMBER_INTERNATIONAL 0x10
+#define TYPE_OF_NUMBER_ALPHANUMERIC  0x50
+
+/* First octet */
+#define FIRST_OCTET_MTI_MASK 0x03
+#define FIRST_OCTET_VPF_MASK 0x18
+#define FIRST_OCTET_UDHI     0x40
+
+/* Status report parameter indicator */
+#define PARAMETER_INDICATOR_PID       0x01
+#define PARAMETER_INDICATOR_DCS       0x02
+#define PARAMETER_INDICATOR_UDL       0x04
+#define PARAMETER_INDICATOR_EXTENSION 0x80
+
+/* Information elements in the user data header */
+#define IEI_CONCATENATED_8BIT  0x00
+#define IEI_CONCATENATED_16BIT 0x08
+
+/*****************************************************************************/
+/* Reader over the raw data, all reads are bounds checked */
+
+typedef struct {
+    const guint8 *data;
+    gsize         length;
+    gsize         offset;
+} PduReader;
+
+static gboolean
+pdu_read_bytes (PduReader     *reader,
+                gsize          n_bytes,
+                const guint8 **out,
+                const gchar   *field,
+                GError       **error)
+{
+    if (reader->length - reader->offset < n_bytes) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_INVALID_MESSAGE,
+                     "Cannot read %s: expected %" G_GSIZE_FORMAT " bytes, only %" G_GSIZE_FORMAT " available",
+                     field, n_bytes, reader->length - reader->offset);
+        return FALSE;
+    }
+    *out = &reader->data[reader->offset];
+    reader->offset += n_bytes;
+    return TRUE;
+}
+
+static gboolean
+pdu_read_guint8 (PduReader    *reader,
+                 guint8       *out,
+                 const gchar  *field,
+                 GError      **error)
+{
+    const guint8 *value;
+
+    if (!pdu_read_bytes (reader, 1, &value, field, error))
+        return FALSE;
+    *out = value[0];
+    return TRUE;
+}
+
+/* TP-OA, TP-DA and TP-RA, with the length given in semi-octets */
+static gboolean
+pdu_read_address (PduReader         *reader,
+                  QmiWmsPduAddress  *address,
+                  const gchar       *field,
+                  GError           **error)
+{
+    if (!pdu_read_guint8 (reader, &address->n_digits, field, error) ||
+        !pdu_read_guint8 (reader, &address->type_of_address, field, error))
+        return FALSE;
+
+    if (address->n_digits > ADDRESS_MAX_DIGITS) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_INVALID_MESSAGE,
+                     "Cannot read %s: too long (%u digits)",
+                     field, address->n_digits);
+        return FALSE;
+    }
+
+    address->value_length = (address->n_digits + 1) / 2;
+    return pdu_read_bytes (reader, address->value_length, &address->value, field, error);
+}
+
+/* SMSC address, with the length given in octets */
+static gboolean
+pdu_read_smsc_address (PduReader         *reader,
+                       QmiWmsPduAddress  *address,
+                       GError           **error)
+{
+    guint8 length;
+
+    if (!pdu_read_guint8 (reader, &length, "SMSC address", error))
+        return FALSE;
+    if (length == 0)
+        return TRUE;
+
+    if (length - 1 > ADDRESS_MAX_DIGITS / 2) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_INVALID_MESSAGE,
+                     "Cannot read SMSC address: too long (%u bytes)",
+                     length);
+        return FALSE;
+    }
+
+    if (!pdu_read_guint8 (reader, &address->type_of_address, "SMSC address", error) ||
+        !pdu_read_bytes (reader, length - 1, &address->value, "SMSC address", error))
+        return FALSE;
+
+    /* The last semi-octet may be a filler */
+    address->value_length = length - 1;
+    address->n_digits = address->value_length * 2;
+    if (address->value_length && (address->value[address->value_length - 1] & 0xF0) == 0xF0)
+        address->n_digits--;
+    return TRUE;
+}
+
+static guint8
+semi_octet_to_number (guint8 value)
+{
+    return (value & 0x0F) * 10 + ((value >> 4) & 0x0F);
+}
+
+static gboolean
+pdu_read_timestamp (PduReader           *reader,
+                    QmiWmsPduTimestamp  *timestamp,
+                    const gchar         *field,
+                    GError             **error)
+{
+    const guint8 *value;
+
+    if (!pdu_read_bytes (reader, TIMESTAMP_SIZE, &value, field, error))
+        return FALSE;
+
+    timestamp->year   = semi_octet_to_number (value[0]);
+    timestamp->month  = semi_octet_to_number (value[1]);
+    timestamp->day    = semi_octet_to_number (value[2]);
+    timestamp->hour   = semi_octet_to_number (value[3]);
+    timestamp->minute = semi_octet_to_number (value[4]);
+    timestamp->second = semi_octet_to_number (value[5]);
+    /* The sign is given in the 4th bit */
+    timestamp->timezone = (gint8) semi_octet_to_number (value[6] & 0xF7);
+    if (value[6] & 0x08)
+        timestamp->timezone = -timestamp->timezone;
+    return TRUE;
+}
+
+/*****************************************************************************/
+
+static QmiWmsPduEncoding
+encoding_from_data_coding_scheme (guint8 dcs)
+{
+    switch (dcs >> 4) {
+    case 0x0: case 0x1: case 0x2: case 0x3:
+    case 0x4: case 0x5: case 0x6: case 0x7:
+        /* General data coding and automatic deletion groups */
+        if (dcs & 0x20)
+            return QMI_WMS_PDU_ENCODING_UNKNOWN;
+        switch ((dcs >> 2) & 0x03) {
+        case 0x0: return QMI_WMS_PDU_ENCODING_GSM7;
+        case 0x1: return QMI_WMS_PDU_ENCODING_8BIT;
+        case 0x2: return QMI_WMS_PDU_ENCODING_UCS2;
+        default:  return QMI_WMS_PDU_ENCODING_UNKNOWN;
+        }
+    case 0xC: case 0xD:
+        /* Message waiting indication, discard or store */
+        return QMI_WMS_PDU_ENCODING_GSM7;
+    case 0xE:
+        /* Message waiting indication, store, UCS-2 */
+        return QMI_WMS_PDU_ENCODING_UCS2;
+    case 0xF:
+        /* Data coding/message class */
+        return (dcs & 0x04) ? QMI_WMS_PDU_ENCODING_8BIT : QMI_WMS_PDU_ENCODING_GSM7;
+    default:
+        /* Reserved coding groups are to be handled as GSM 7-bit */
+        return QMI_WMS_PDU_ENCODING_GSM7;
+    }
+}
+
+static void
+parse_user_data_header (QmiWmsPduView *view)
+{
+    const guint8 *udh = view->user_data_header;
+    guint         i = 0;
+
+    while (i + 2 <= view->user_data_header_length) {
+        guint8 iei = udh[i];
+        guint8 iedl = udh[i + 1];
+
+        if (i + 2 + iedl > view->user_data_header_length)
+            break;
+
+        /* Only the last concatenation information element is used */
+        if (iei == IEI_CONCATENATED_8BIT && iedl == 3 && udh[i + 3] > 0 &&
+            udh[i + 4] > 0 && udh[i + 4] <= udh[i + 3]) {
+            view->concatenated = TRUE;
+            view->concat_reference = udh[i + 2];
+            view->concat_total = udh[i + 3];
+            view->concat_sequence = udh[i + 4];
+        } else if (iei == IEI_CONCATENATED_16BIT && iedl == 4 && udh[i + 4] > 0 &&
+                   udh[i + 5] > 0 && udh[i + 5] <= udh[i + 4]) {
+            view->concatenated = TRUE;
+            view->concat_reference = (udh[i + 2] << 8) | udh[i + 3];
+            view->concat_total = udh[i + 4];
+            view->concat_sequence = udh[i + 5];
+        }
+
+        i += 2 + iedl;
+    }
+}
+
+static gboolean
+pdu_read_user_data (PduReader      *reader,
+                    QmiWmsPduView  *view,
+                    GError        **error)
+{
+    gsize size;
+
+    if (!pdu_read_guint8 (reader, &view->user_data_length, "TP-UDL", error))
+        return FALSE;
+
+    if (view->encoding == QMI_WMS_PDU_ENCODING_GSM7) {
+        if (view->user_data_length > USER_DATA_MAX_SEPTETS) {
+            g_set_error (error,
+                         QMI_CORE_ERROR,
+                         QMI_CORE_ERROR_INVALID_MESSAGE,
+                         "Cannot read TP-UD: too long (%u septets)",
+                         view->user_data_length);
+            return FALSE;
+        }
+        size = ((gsize) view->user_data_length * 7 + 7) / 8;
+    } else {
+        if (view->user_data_length > USER_DATA_MAX_SIZE) {
+            g_set_error (error,
+                         QMI_CORE_ERROR,
+                         QMI_CORE_ERROR_INVALID_MESSAGE,
+                         "Cannot read TP-UD: too long (%u bytes)",
+                         view->user_data_length);
+            return FALSE;
+        }
+        size = view->user_data_length;
+    }
+
+    if (!size)
+        return TRUE;
+
+    if (!pdu_read_bytes (reader, size, &view->user_data, "TP-UD", error))
+        return FALSE;
+    view->user_data_size = size;
+
+    if (view->first_octet & FIRST_OCTET_UDHI) {
+        if (view->user_data[0] + 1 > size) {
+            g_set_error (error,
+                         QMI_CORE_ERROR,
+                         QMI_CORE_ERROR_INVALID_MESSAGE,
+                         "Cannot read user data header: too long (%u bytes)",
+                         view->user_data[0]);
+            return FALSE;
+        }
+        view->user_data_header = &view->user_data[1];
+        view->user_data_header_length = view->user_data[0];
+        parse_user_data_header (view);
+    }
+
+    return TRUE;
+}
+
+static gboolean
+parse_deliver (PduReader      *reader,
+               QmiWmsPduView  *view,
+               GError        **error)
+{
+    if (!pdu_read_address (reader, &view->address, "TP-OA", error) ||
+        !pdu_read_guint8 (reader, &view->protocol_identifier, "TP-PID", error) ||
+        !pdu_read_guint8 (reader, &view->data_coding_scheme, "TP-DCS", error) ||
+        !pdu_read_timestamp (reader, &view->timestamp, "TP-SCTS", error))
+        return FALSE;
+
+    view->encoding = encoding_from_data_coding_scheme (view->data_coding_scheme);
+    return pdu_read_user_data (reader, view, error);
+}
+
+static gboolean
+parse_submit (PduReader      *reader,
+              QmiWmsPduView  *view,
+              GError        **error)
+{
+    const guint8 *validity_period;
+    gsize         validity_period_size;
+
+    if (!pdu_read_guint8 (reader, &view->message_reference, "TP-MR", error) ||
+        !pdu_read_address (reader, &view->address, "TP-DA", error) ||
+        !pdu_read_guint8 (reader, &view->protocol_identifier, "TP-PID", error) ||
+        !pdu_read_guint8 (reader, &view->data_coding_scheme, "TP-DCS", error))
+        return FALSE;
+
+    /* Not given, relative, or enhanced/absolute */
+    switch ((view->first_octet & FIRST_OCTET_VPF_MASK) >> 3) {
+    case 0x0:  validity_period_size = 0; break;
+    case 0x2:  validity_period_size = 1; break;
+    default:   validity_period_size = 7; break;
+    }
+    if (!pdu_read_bytes (reader, validity_period_size, &validity_period, "TP-VP", error))
+        return FALSE;
+
+    view->encoding = encoding_from_data_coding_scheme (view->data_coding_scheme);
+    return pdu_read_user_data (reader, view, error);
+}
+
+static gboolean
+parse_status_report (PduReader      *reader,
+                     QmiWmsPduView  *view,
+                     GError        **error)
+{
+    guint8 parameter_indicator;
+    guint8 extension;
+
+    if (!pdu_read_guint8 (reader, &view->message_reference, "TP-MR", error) ||
+        !pdu_read_address (reader, &view->address, "TP-RA", error) ||
+        !pdu_read_timestamp (reader, &view->timestamp, "TP-SCTS", error) ||
+        !pdu_read_timestamp (reader, &view->discharge_time, "TP-DT", error) ||
+        !pdu_read_guint8 (reader, &view->status, "TP-ST", error))
+        return FALSE;
+
+    /* All the remaining fields are optional */
+    if (reader->offset == reader->length)
+        return TRUE;
+
+    if (!pdu_read_guint8 (reader, &parameter_indicator, "TP-PI", error))
+        return FALSE;
+    for (extension = parameter_indicator; extension & PARAMETER_INDICATOR_EXTENSION; ) {
+        if (!pdu_read_guint8 (reader, &extension, "TP-PI", error))
+            return FALSE;
+    }
+
+    if ((parameter_indicator & PARAMETER_INDICATOR_PID) &&
+        !pdu_read_guint8 (reader, &view->protocol_identifier, "TP-PID", error))
+        return FALSE;
+    if ((parameter_indicator & PARAMETER_INDICATOR_DCS) &&
+        !pdu_read_guint8 (reader, &view->data_coding_scheme, "TP-DCS", error))
+        return FALSE;
+
+    view->encoding = encoding_from_data_coding_scheme (view->data_coding_scheme);
+    if (parameter_indicator & PARAMETER_INDICATOR_UDL)
+        return pdu_read_user_data (reader, view, error);
+    return TRUE;
+}
+
+gboolean
+qmi_wms_pdu_view_init (QmiWmsPduView  *view,
+                       const guint8   *data,
+                       gsize           data_length,
+                       GError        **error)
+{
+    PduReader reader;
+
+    g_return_val_if_fail (view != NULL, FALSE);
+    g_return_val_if_fail (data != NULL || data_length == 0, FALSE);
+
+    memset (view, 0, sizeof (QmiWmsPduView));
+    reader.data = data;
+    reader.length = data_length;
+    reader.offset = 0;
+
+    if (!pdu_read_smsc_address (&reader, &view->smsc, error) ||
+        !pdu_read_guint8 (&reader, &view->first_octet, "first octet", error))
+        return FALSE;
+
+    switch (view->first_octet & FIRST_OCTET_MTI_MASK) {
+    case QMI_WMS_PDU_TYPE_DELIVER:
+        view->type = QMI_WMS_PDU_TYPE_DELIVER;
+        return parse_deliver (&reader, view, error);
+    case QMI_WMS_PDU_TYPE_SUBMIT:
+        view->type = QMI_WMS_PDU_TYPE_SUBMIT;
+        return parse_submit (&reader, view, error);
+    case QMI_WMS_PDU_TYPE_STATUS_REPORT:
+        view->type = QMI_WMS_PDU_TYPE_STATUS_REPORT;
+        return parse_status_report (&reader, view, error);
+    default:
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_INVALID_MESSAGE,
+                     "Unsupported TP-MTI: 0x%02x",
+                     view->first_octet & FIRST_OCTET_MTI_MASK);
+        return FALSE;
+    }
+}
+
+gsize
+qmi_wms_pdu_view_get_text (const QmiWmsPduView *view,
+                           gchar               *out,
+                           gsize                out_size)
+{
+    gsize header_size = 0;
+
+    g_return_val_if_fail (view != NULL, 0);
+    g_return_val_if_fail (out != NULL || out_size == 0, 0);
+
+    if (view->user_data_header)
+        header_size = view->user_data_header_length + 1;
+
+    if (view->user_data && view->encoding == QMI_WMS_PDU_ENCODING_GSM7) {
+        guint8 unpacked[USER_DATA_MAX_SEPTETS];
+        guint  n_septets;
+        guint  header_septets;
+
+        /* The text starts at the first septet boundary after the header */
+        n_septets = qmi_charset_gsm7_unpack (view->user_data, view->user_data_size, view->user_data_length, unpacked);
+        header_septets = (header_size * 8 + 6) / 7;
+        if (header_septets < n_septets)
+            return qmi_charset_gsm7_unpacked_to_utf8 (&unpacked[header_septets], n_septets - header_septets, out, out_size);
+    } else if (view->user_data && view->encoding == QMI_WMS_PDU_ENCODING_UCS2) {
+        return qmi_charset_ucs2_to_utf8 (&view->user_data[header_size], view->user_data_size - header_size, QMI_ENDIAN_BIG, out, out_size);
+    }
+
+    if (out_size > 0)
+        out[0] = '\0';
+    return 0;
+}
+
+static const gchar bcd_digits[16] = "0123456789*#abc";
+
+gsize
+qmi_wms_pdu_address_to_string (const QmiWmsPduAddress *address,
+                               gchar                  *out,
+                               gsize                   out_size)
+{
+    gchar str[QMI_WMS_PDU_ADDRESS_MAX_SIZE];
+    gsize len = 0;
+    guint i;
+
+    g_return_val_if_fail (address != NULL, 0);
+    g_return_val_if_fail (out != NULL || out_size == 0, 0);
+
+    if (address->value &&
+        (address->type_of_address & TYPE_OF_NUMBER_MASK) == TYPE_OF_NUMBER_ALPHANUMERIC) {
+        guint8 unpacked[(ADDRESS_MAX_DIGITS * 4) / 7];
+        guint  n_septets;
+
+        n_septets = qmi_charset_gsm7_unpack (address->value, address->value_length, (address->n_digits * 4) / 7, unpacked);
+        return qmi_charset_gsm7_unpacked_to_utf8 (unpacked, n_septets, out, out_size);
+    }
+
+    if (address->value && (address->type_of_address & TYPE_OF_NUMBER_MASK) == TYPE_OF_NUMBER_INTERNATIONAL)
+        str[len++] = '+';
+
+    /* Low semi-octet first, and stop at the filler if any */
+    for (i = 0; address->value && i < address->n_digits && i < ADDRESS_MAX_DIGITS; i++) {
+        guint8 digit;
+
+        digit = (i % 2) ? (address->value[i / 2] >> 4) : (address->value[i / 2] & 0x0F);
+        if (digit == 0x0F)
+            break;
+        str[len++] = bcd_digits[digit];
+    }
+    str[len] = '\0';
+
+    /* Only ASCII, so it may be truncated anywhere */
+    if (out_size > 0) {
+        gsize n = MIN (len, out_size - 1);
+
+        memcpy (out, str, n);
+        out[n] = '\0';
+    }
+    return len;
+}
+
+/*****************************************************************************/
+/* Concatenated messages */
+
+typedef struct {
+    gchar   address[QMI_WMS_PDU_ADDRESS_MAX_SIZE];
+    guint16 reference;
+    guint8  total;
+} PartsKey;
+
+typedef struct {
+    PartsKey  key;
+    gint64    first_seen;
+    GList    *link;
+    guint     n_received;
+    gchar   **texts;
+} Parts;
+
+struct _QmiWmsPduAssembler {
+    volatile gint ref_count;
+
+    gint64      max_age;
+    /* Messages keyed by PartsKey, and the same ones from the oldest to the
+     * newest, to expire them */
+    GHashTable *parts;
+    GQueue      parts_by_age;
+};
+
+static guint
+parts_key_hash (const PartsKey *key)
+{
+    return g_str_hash (key->address) ^ (key->reference << 8) ^ key->total;
+}
+
+static gboolean
+parts_key_equal (const PartsKey *a,
+                 const PartsKey *b)
+{
+    return (a->reference == b->reference &&
+            a->total == b->total &&
+            g_str_equal (a->address, b->address));
+}
+
+static void
+parts_free (Parts *parts)
+{
+    guint i;
+
+    for (i = 0; i < parts->key.total; i++)
+        g_free (parts->texts[i]);
+    g_free (parts->texts);
+    g_slice_free (Parts, parts);
+}
+
+static void
+assembler_remove (QmiWmsPduAssembler *self,
+                  Parts              *parts)
+{
+    g_queue_delete_link (&self->parts_by_age, parts->link);
+    /* Frees the parts */
+    g_hash_table_remove (self->parts, &parts->key);
+}
+
+static void
+assembler_expire (QmiWmsPduAssembler *self,
+                  gint64              now)
+{
+    Parts *parts;
+
+    if (!self->max_age)
+        return;
+
+    while ((parts = g_queue_peek_head (&self->parts_by_age)) != NULL &&
+           now - parts->first_seen > self->max_age)
+        assembler_remove (self, parts);
+}
+
+QmiWmsPduAssembler *
+qmi_wms_pdu_assembler_new (guint max_age)
+{
+    QmiWmsPduAssembler *self;
+
+    self = g_slice_new0 (QmiWmsPduAssembler);
+    self->ref_count = 1;
+    self->max_age = (gint64) max_age * G_USEC_PER_SEC;
+    self->parts = g_hash_table_new_full ((GHashFunc) parts_key_hash,
+                                         (GEqualFunc) parts_key_equal,
+                                         NULL,
+                                         (GDestroyNotify) parts_free);
+    g_queue_init (&self->parts_by_age);
+    return self;
+}
+
+GType
+qmi_wms_pdu_assembler_get_type (void)
+{
+    static volatile gsize g_define_type_id__volatile = 0;
+
+    if (g_once_init_enter (&g_define_type_id__volatile)) {
+        GType g_define_type_id =
+            g_boxed_type_register_static (g_intern_static_string ("QmiWmsPduAssembler"),
+                                          (GBoxedCopyFunc) qmi_wms_pdu_assembler_ref,
+                                          (GBoxedFreeFunc) qmi_wms_pdu_assembler_unref);
+
+        g_once_init_leave (&g_define_type_id__volatile, g_define_type_id);
+    }
+
+    return g_define_type_id__volatile;
+}
+
+QmiWmsPduAssembler *
+qmi_wms_pdu_assembler_ref (QmiWmsPduAssembler *self)
+{
+    g_return_val_if_fail (self != NULL, NULL);
+
+    g_atomic_int_inc (&self->ref_count);
+    return self;
+}
+
+void
+qmi_wms_pdu_assembler_unref (QmiWmsPduAssembler *self)
+{
+    g_return_if_fail (self != NULL);
+
+    if (g_atomic_int_dec_and_test (&self->ref_count)) {
+        g_queue_clear (&self->parts_by_age);
+        g_hash_table_unref (self->parts);
+        g_slice_free (QmiWmsPduAssembler, self);
+    }
+}
+
+static gchar *
+build_text (const QmiWmsPduView *view)
+{
+    gchar text[QMI_WMS_PDU_TEXT_MAX_SIZE];
+
+    qmi_wms_pdu_view_get_text (view, text, sizeof (text));
+    return g_strdup (text);
+}
+
+gboolean
+qmi_wms_pdu_assembler_add (QmiWmsPduAssembler   *self,
+                           const QmiWmsPduView  *view,
+                           gchar               **out_text)
+{
+    PartsKey  key;
+    Parts    *parts;
+    gint64    now;
+    GString  *text;
+    guint     i;
+
+    g_return_val_if_fail (self != NULL, FALSE);
+    g_return_val_if_fail (view != NULL, FALSE);
+    g_return_val_if_fail (out_text != NULL, FALSE);
+
+    now = g_get_monotonic_time ();
+    assembler_expire (self, now);
+
+    if (!view->concatenated) {
+        *out_text = build_text (view);
+        return TRUE;
+    }
+
+    memset (&key, 0, sizeof (key));
+    qmi_wms_pdu_address_to_string (&view->address, key.address, sizeof (key.address));
+    key.reference = view->concat_reference;
+    key.total = view->concat_total;
+
+    parts = g_hash_table_lookup (self->parts, &key);
+    if (!parts) {
+        parts = g_slice_new0 (Parts);
+        parts->key = key;
+        parts->first_seen = now;
+        parts->texts = g_new0 (gchar *, key.total);
+        g_queue_push_tail (&self->parts_by_age, parts);
+        parts->link = g_queue_peek_tail_link (&self->parts_by_age);
+        g_hash_table_insert (self->parts, &parts->key, parts);
+    }
+
+    /* Duplicates are ignored */
+    if (parts->texts[view->concat_sequence - 1])
+        return FALSE;
+
+    parts->texts[view->concat_sequence - 1] = build_text (view);
+    if (++parts->n_received < parts->key.total)
+        return FALSE;
+
+    text = g_string_new (NULL);
+    for (i = 0; i < parts->key.total; i++)
+        g_string_append (text, parts->texts[i]);
+    assembler_remove (self, parts);
+
+    *out_text = g_string_free (text, FALSE);
+    return TRUE;
+}
+
+guint
+qmi_wms_pdu_assembler_get_n_pending (QmiWmsPduAssembler *self)
+{
+    g_return_val_if_fail (self != NULL, 0);
+
+    return g_hash_table_size (self->parts);
+}
@@ -0,0 +1,326 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_WMS_PDU_H_
+#define _LIBQMI_GLIB_QMI_WMS_PDU_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include "qmi-enums-wms.h"
+#include "qmi-charsets.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-wms-pdu
+ * @title: WMS PDU parser
+ * @short_description: parsing of 3GPP SMS PDUs
+ *
+ * Helpers to parse the 3GPP SMS PDUs given in the raw message data of e.g.
+ * WMS Raw Read responses or WMS Event Report indications, when in
+ * %QMI_WMS_MESSAGE_FORMAT_GSM_WCDMA_POINT_TO_POINT format: the SMSC address
+ * followed by a SMS-DELIVER, SMS-SUBMIT or SMS-STATUS-REPORT TPDU, as given
+ * in 3GPP TS 23.040.
+ *
+ * A #QmiWmsPduView is parsed in place: it doesn't allocate any memory and it
+ * refers to the given raw data, which must be kept valid while the view is
+ * in use.
+ *
+ * Concatenated messages can be reassembled with a #QmiWmsPduAssembler, which
+ * keeps the text of each part until all the parts of the same message are
+ * received.
+ */
+
+/**
+ * QMI_WMS_PDU_ADDRESS_MAX_SIZE:
+ *
+ * Size of the buffer needed for the longest address string built with
+ * qmi_wms_pdu_address_to_string(), including the trailing NUL byte.
+ *
+ * Since: 1.20
+ */
+#define QMI_WMS_PDU_ADDRESS_MAX_SIZE 32
+
+/**
+ * QMI_WMS_PDU_TEXT_MAX_SIZE:
+ *
+ * Size of the buffer needed for the longest text built with
+ * qmi_wms_pdu_view_get_text(), including the trailing NUL byte.
+ *
+ * Since: 1.20
+ */
+#define QMI_WMS_PDU_TEXT_MAX_SIZE QMI_CHARSET_GSM7_UTF8_SIZE (160)
+
+/**
+ * QmiWmsPduAddress:
+ * @type_of_address: the type of address octet, including the type of number and numbering plan.
+ * @n_digits: number of semi-octets in @value.
+ * @value: the address value, as given in the PDU, or %NULL if not given.
+ * @value_length: length of @value, in bytes.
+ *
+ * An address field within a PDU, referring to the raw data of the PDU.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    guint8        type_of_address;
+    guint8        n_digits;
+    const guint8 *value;
+    guint8        value_length;
+} QmiWmsPduAddress;
+
+/**
+ * QmiWmsPduTimestamp:
+ * @year: the year, from 0 to 99.
+ * @month: the month, from 1 to 12.
+ * @day: the day of the month, from 1 to 31.
+ * @hour: the hour, from 0 to 23.
+ * @minute: the minute, from 0 to 59.
+ * @second: the second, from 0 to 59.
+ * @timezone: offset from UTC, in quarters of an hour.
+ *
+ * A timestamp within a PDU.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    guint8 year;
+    guint8 month;
+    guint8 day;
+    guint8 hour;
+    guint8 minute;
+    guint8 second;
+    gint8  timezone;
+} QmiWmsPduTimestamp;
+
+/**
+ * QmiWmsPduView:
+ * @type: a #QmiWmsPduType.
+ * @smsc: the SMSC address; with a %NULL value if not given.
+ * @first_octet: the first octet of the TPDU.
+ * @message_reference: the TP-MR, in SMS-SUBMIT and SMS-STATUS-REPORT.
+ * @address: the TP-OA in SMS-DELIVER, the TP-DA in SMS-SUBMIT, or the TP-RA in SMS-STATUS-REPORT.
+ * @protocol_identifier: the TP-PID, 0 if not given.
+ * @data_coding_scheme: the TP-DCS, 0 if not given.
+ * @encoding: a #QmiWmsPduEncoding, from @data_coding_scheme.
+ * @timestamp: the TP-SCTS, in SMS-DELIVER and SMS-STATUS-REPORT.
+ * @discharge_time: the TP-DT, in SMS-STATUS-REPORT.
+ * @status: the TP-ST, in SMS-STATUS-REPORT.
+ * @user_data_length: the TP-UDL: in septets with %QMI_WMS_PDU_ENCODING_GSM7, in octets otherwise.
+ * @user_data: the TP-UD, including the user data header if any, or %NULL if not given.
+ * @user_data_size: size of @user_data, in bytes.
+ * @user_data_header: the user data header, without its length octet, or %NULL if not given.
+ * @user_data_header_length: length of @user_data_header, in bytes.
+ * @concatenated: whether the PDU is part of a concatenated message.
+ * @concat_reference: the reference of the concatenated message.
+ * @concat_total: the number of parts of the concatenated message.
+ * @concat_sequence: the sequence number of this part, from 1 to @concat_total.
+ *
+ * A PDU parsed in place with qmi_wms_pdu_view_init(). Fields not applicable to
+ * the PDU type are set to 0.
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    QmiWmsPduType       type;
+    QmiWmsPduAddress    smsc;
+    guint8              first_octet;
+    guint8              message_reference;
+    QmiWmsPduAddress    address;
+    guint8              protocol_identifier;
+    guint8              data_coding_scheme;
+    QmiWmsPduEncoding   encoding;
+    QmiWmsPduTimestamp  timestamp;
+    QmiWmsPduTimestamp  discharge_time;
+    guint8              status;
+    guint8              user_data_length;
+    const guint8       *user_data;
+    gsize               user_data_size;
+    const guint8       *user_data_header;
+    guint8              user_data_header_length;
+    gboolean            concatenated;
+    guint16             concat_reference;
+    guint8              concat_total;
+    guint8              concat_sequence;
+} QmiWmsPduView;
+
+/**
+ * qmi_wms_pdu_view_init:
+ * @view: a #QmiWmsPduView.
+ * @data: raw message data, starting with the SMSC address.
+ * @data_length: length of @data.
+ * @error: Return location for error or %NULL.
+ *
+ * Parses the PDU in @data into @view, without copying it.
+ *
+ * Returns: %TRUE if @view is initialized, %FALSE if @error is set.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_wms_pdu_view_init (QmiWmsPduView  *view,
+                                const guint8   *data,
+                                gsize           data_length,
+                                GError        **error);
+
+/**
+ * qmi_wms_pdu_view_get_text:
+ * @view: a #QmiWmsPduView.
+ * @out: return location for the UTF-8 text.
+ * @out_size: size of @out, in bytes.
+ *
+ * Decodes the text in the user data of @view, skipping the user data header,
+ * into a NUL-terminated UTF-8 string. Only %QMI_WMS_PDU_ENCODING_GSM7 and
+ * %QMI_WMS_PDU_ENCODING_UCS2 user data are decoded; an empty string is given
+ * otherwise.
+ *
+ * If @out is not big enough, the text is truncated as in
+ * qmi_charset_gsm7_unpacked_to_utf8(). A buffer of
+ * %QMI_WMS_PDU_TEXT_MAX_SIZE bytes is always big enough.
+ *
+ * Returns: the length of the whole UTF-8 text, not including the trailing NUL
+ * byte.
+ *
+ * Since: 1.20
+ */
+gsize qmi_wms_pdu_view_get_text (const QmiWmsPduView *view,
+                                 gchar               *out,
+                                 gsize                out_size);
+
+/**
+ * qmi_wms_pdu_address_to_string:
+ * @address: a #QmiWmsPduAddress.
+ * @out: return location for the address string.
+ * @out_size: size of @out, in bytes.
+ *
+ * Builds a NUL-terminated string with the digits of @address, with a
+ * leading '+' for international numbers, or with the decoded text of
+ * alphanumeric addresses.
+ *
+ * If @out is not big enough, the string is truncated as in
+ * qmi_charset_gsm7_unpacked_to_utf8(). A buffer of
+ * %QMI_WMS_PDU_ADDRESS_MAX_SIZE bytes is always big enough.
+ *
+ * Returns: the length of the whole string, not including the trailing NUL
+ * byte.
+ *
+ * Since: 1.20
+ */
+gsize qmi_wms_pdu_address_to_string (const QmiWmsPduAddress *address,
+                                     gchar                  *out,
+                                     gsize                   out_size);
+
+/*****************************************************************************/
+/* Concatenated messages */
+
+/**
+ * QmiWmsPduAssembler:
+ *
+ * An opaque type keeping the parts of concatenated messages until they are
+ * complete.
+ *
+ * A #QmiWmsPduAssembler is not thread-safe.
+ *
+ * Since: 1.20
+ */
+typedef struct _QmiWmsPduAssembler QmiWmsPduAssembler;
+
+GType qmi_wms_pdu_assembler_get_type (void);
+
+/**
+ * qmi_wms_pdu_assembler_new:
+ * @max_age: maximum time to wait for all the parts of a message, in seconds, or 0 to wait forever.
+ *
+ * Create a new empty #QmiWmsPduAssembler.
+ *
+ * The parts of messages not completed within @max_age seconds since their
+ * first part was added are discarded.
+ *
+ * Returns: (transfer full): a newly created #QmiWmsPduAssembler. The returned value should be freed with qmi_wms_pdu_assembler_unref().
+ *
+ * Since: 1.20
+ */
+QmiWmsPduAssembler *qmi_wms_pdu_assembler_new (guint max_age);
+
+/**
+ * qmi_wms_pdu_assembler_ref:
+ * @self: a #QmiWmsPduAssembler.
+ *
+ * Atomically increments the reference count of @self by one.
+ *
+ * Returns: (transfer full) the new reference to @self.
+ *
+ * Since: 1.20
+ */
+QmiWmsPduAssembler *qmi_wms_pdu_assembler_ref (QmiWmsPduAssembler *self);
+
+/**
+ * qmi_wms_pdu_assembler_unref:
+ * @self: a #QmiWmsPduAssembler.
+ *
+ * Atomically decrements the reference count of @self by one.
+ * If the reference count drops to 0, @self is completely disposed.
+ *
+ * Since: 1.20
+ */
+void qmi_wms_pdu_assembler_unref (QmiWmsPduAssembler *self);
+
+/**
+ * qmi_wms_pdu_assembler_add:
+ * @self: a #QmiWmsPduAssembler.
+ * @view: a #QmiWmsPduView.
+ * @out_text: (out) (transfer full): return location for the whole text of the message.
+ *
+ * Adds the text of the PDU in @view to the message it is part of, looked up by
+ * the address, reference number and number of parts. Duplicated parts are
+ * ignored.
+ *
+ * PDUs not part of a concatenated message are complete by themselves.
+ *
+ * Returns: %TRUE if the message is complete, and @out_text is set; %FALSE otherwise.
+ *
+ * Since: 1.20
+ */
+gboolean qmi_wms_pdu_assembler_add (QmiWmsPduAssembler   *self,
+                                    const QmiWmsPduView  *view,
+                                    gchar               **out_text);
+
+/**
+ * qmi_wms_pdu_assembler_get_n_pending:
+ * @self: a #QmiWmsPduAssembler.
+ *
+ * Gets the number of messages with parts still missing.
+ *
+ * Returns: the number of incomplete messages.
+ *
+ * Since: 1.20
+ */
+guint qmi_wms_pdu_assembler_get_n_pending (QmiWmsPduAssembler *self);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_WMS_PDU_H_ */
@@ -0,0 +1,357 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "qmi-wms-sweep.h"
+
+/* Timeout of each request sent */
+#define REQUEST_TIMEOUT 10
+
+typedef struct {
+    QmiWmsStorageType  storage_type;
+    QmiWmsMessageMode  message_mode;
+    QmiWmsSweepFlags   flags;
+    guint              window;
+
+    /* One slot per listed message, without raw data until read */
+    GArray            *messages;
+    guint              next;
+    guint              n_pending;
+} SweepContext;
+
+typedef struct {
+    GTask *task;
+    guint  i;
+} SweepMessageContext;
+
+static void
+sweep_message_clear (QmiWmsSweepMessage *message)
+{
+    if (message->raw_data)
+        g_array_unref (message->raw_data);
+}
+
+static void
+sweep_context_free (SweepContext *ctx)
+{
+    if (ctx->messages)
+        g_array_unref (ctx->messages);
+    g_slice_free (SweepContext, ctx);
+}
+
+GArray *
+qmi_client_wms_sweep_finish (QmiClientWms  *self,
+                             GAsyncResult  *res,
+                             GError       **error)
+{
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+static void
+sweep_complete (GTask *task)
+{
+    SweepContext *ctx;
+    GArray       *result;
+    guint         i;
+
+    ctx = g_task_get_task_data (task);
+
+    result = g_array_sized_new (FALSE, FALSE, sizeof (QmiWmsSweepMessage), ctx->messages->len);
+    g_array_set_clear_func (result, (GDestroyNotify) sweep_message_clear);
+    for (i = 0; i < ctx->messages->len; i++) {
+        QmiWmsSweepMessage *message;
+
+        /* Skip the messages not read, and transfer the raw data of the
+         * others */
+        message = &g_array_index (ctx->messages, QmiWmsSweepMessage, i);
+        if (!message->raw_data)
+            continue;
+        g_array_append_val (result, *message);
+        message->raw_data = NULL;
+    }
+
+    g_task_return_pointer (task, result, (GDestroyNotify) g_array_unref);
+}
+
+static void sweep_next (GTask *task);
+
+static void
+sweep_message_done (SweepMessageContext *message_ctx)
+{
+    GTask        *task;
+    SweepContext *ctx;
+
+    task = message_ctx->task;
+    ctx = g_task_get_task_data (task);
+    g_slice_free (SweepMessageContext, message_ctx);
+
+    g_assert (ctx->n_pending > 0);
+    ctx->n_pending--;
+
+    /* Once cancelled, just wait for the messages being processed */
+    if (g_cancellable_is_cancelled (g_task_get_cancellable (task)))
+        ctx->next = ctx->messages->len;
+
+    if (ctx->next < ctx->messages->len)
+        sweep_next (task);
+    else if (ctx->n_pending == 0)
+        sweep_complete (task);
+
+    g_object_unref (task);
+}
+
+static void
+delete_ready (QmiClientWms        *client,
+              GAsyncResult        *res,
+              SweepMessageContext *message_ctx)
+{
+    QmiMessageWmsDeleteOutput *output;
+    GError                    *error = NULL;
+
+    output = qmi_client_wms_delete_finish (client, res, &error);
+    if (!output || !qmi_message_wms_delete_output_get_result (output, &error)) {
+        g_debug ("couldn't delete message: %s", error->message);
+        g_error_free (error);
+    }
+
+    if (output)
+        qmi_message_wms_delete_output_unref (output);
+    sweep_message_done (message_ctx);
+}
+
+static void
+modify_tag_ready (QmiClientWms        *client,
+                  GAsyncResult        *res,
+                  SweepMessageContext *message_ctx)
+{
+    QmiMessageWmsModifyTagOutput *output;
+    GError                       *error = NULL;
+
+    output = qmi_client_wms_modify_tag_finish (client, res, &error);
+    if (!output || !qmi_message_wms_modify_tag_output_get_result (output, &error)) {
+        g_debug ("couldn't tag message as read: %s", error->message);
+        g_error_free (error);
+    }
+
+    if (output)
+        qmi_message_wms_modify_tag_output_unref (output);
+    sweep_message_done (message_ctx);
+}
+
+static void
+raw_read_ready (QmiClientWms        *client,
+                GAsyncResult        *res,
+                SweepMessageContext *message_ctx)
+{
+    QmiMessageWmsRawReadOutput *output;
+    SweepContext               *ctx;
+    QmiWmsSweepMessage         *message;
+    GError                     *error = NULL;
+    GArray                     *raw_data = NULL;
+
+    ctx = g_task_get_task_data (message_ctx->task);
+    message = &g_array_index (ctx->messages, QmiWmsSweepMessage, message_ctx->i);
+
+    output = qmi_client_wms_raw_read_finish (client, res, &error);
+    if (!output ||
+        !qmi_message_wms_raw_read_output_get_result (output, &error) ||
+        !qmi_message_wms_raw_read_output_get_raw_message_data (output,
+                                                               &message->message_tag,
+                                                               &message->format,
+                                                               &raw_data,
+                                                               &error)) {
+        g_debug ("couldn't read message at index %u: %s", message->memory_index, error->message);
+        g_error_free (error);
+        if (output)
+            qmi_message_wms_raw_read_output_unref (output);
+        sweep_message_done (message_ctx);
+        return;
+    }
+
+    message->raw_data = g_array_ref (raw_data);
+    qmi_message_wms_raw_read_output_unref (output);
+
+    if (ctx->flags & QMI_WMS_SWEEP_FLAGS_DELETE) {
+        QmiMessageWmsDeleteInput *input;
+
+        input = qmi_message_wms_delete_input_new ();
+        qmi_message_wms_delete_input_set_memory_storage (input, ctx->storage_type, NULL);
+        qmi_message_wms_delete_input_set_memory_index (input, message->memory_index, NULL);
+        qmi_message_wms_delete_input_set_message_mode (input, ctx->message_mode, NULL);
+        qmi_client_wms_delete (client,
+                               input,
+                               REQUEST_TIMEOUT,
+                               g_task_get_cancellable (message_ctx->task),
+                               (GAsyncReadyCallback) delete_ready,
+                               message_ctx);
+        qmi_message_wms_delete_input_unref (input);
+        return;
+    }
+
+    if ((ctx->flags & QMI_WMS_SWEEP_FLAGS_MARK_READ) &&
+        message->message_tag == QMI_WMS_MESSAGE_TAG_TYPE_MT_NOT_READ) {
+        QmiMessageWmsModifyTagInput *input;
+
+        input = qmi_message_wms_modify_tag_input_new ();
+        qmi_message_wms_modify_tag_input_set_message_tag (input,
+                                                          ctx->storage_type,
+                                                          message->memory_index,
+                                                          QMI_WMS_MESSAGE_TAG_TYPE_MT_READ,
+                                                          NULL);
+        qmi_message_wms_modify_tag_input_set_message_mode (input, ctx->message_mode, NULL);
+        qmi_client_wms_modify_tag (client,
+                                   input,
+                                   REQUEST_TIMEOUT,
+                                   g_task_get_cancellable (message_ctx->task),
+                                   (GAsyncReadyCallback) modify_tag_ready,
+                                   message_ctx);
+        qmi_message_wms_modify_tag_input_unref (input);
+        return;
+    }
+
+    sweep_message_done (message_ctx);
+}
+
+static void
+sweep_next (GTask *task)
+{
+    QmiClientWms *self;
+    SweepContext *ctx;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    while (ctx->n_pending < ctx->window && ctx->next < ctx->messages->len) {
+        SweepMessageContext       *message_ctx;
+        QmiMessageWmsRawReadInput *input;
+
+        message_ctx = g_slice_new (SweepMessageContext);
+        message_ctx->task = g_object_ref (task);
+        message_ctx->i = ctx->next++;
+        ctx->n_pending++;
+
+        input = qmi_message_wms_raw_read_input_new ();
+        qmi_message_wms_raw_read_input_set_message_memory_storage_id (
+            input,
+            ctx->storage_type,
+            g_array_index (ctx->messages, QmiWmsSweepMessage, message_ctx->i).memory_index,
+            NULL);
+        qmi_message_wms_raw_read_input_set_message_mode (input, ctx->message_mode, NULL);
+        qmi_client_wms_raw_read (self,
+                                 input,
+                                 REQUEST_TIMEOUT,
+                                 g_task_get_cancellable (task),
+                                 (GAsyncReadyCallback) raw_read_ready,
+                                 message_ctx);
+        qmi_message_wms_raw_read_input_unref (input);
+    }
+}
+
+static void
+list_messages_ready (QmiClientWms *self,
+                     GAsyncResult *res,
+                     GTask        *task)
+{
+    QmiMessageWmsListMessagesOutput *output;
+    SweepContext                    *ctx;
+    GError                          *error = NULL;
+    GArray                          *message_list = NULL;
+    guint                            i;
+
+    ctx = g_task_get_task_data (task);
+
+    output = qmi_client_wms_list_messages_finish (self, res, &error);
+    if (!output ||
+        !qmi_message_wms_list_messages_output_get_result (output, &error) ||
+        !qmi_message_wms_list_messages_output_get_message_list (output, &message_list, &error)) {
+        g_prefix_error (&error, "Couldn't list messages: ");
+        g_task_return_error (task, error);
+        goto out;
+    }
+
+    ctx->messages = g_array_sized_new (FALSE, TRUE, sizeof (QmiWmsSweepMessage), message_list->len);
+    g_array_set_clear_func (ctx->messages, (GDestroyNotify) sweep_message_clear);
+    g_array_set_size (ctx->messages, message_list->len);
+    for (i = 0; i < message_list->len; i++) {
+        QmiMessageWmsListMessagesOutputMessageListElement *element;
+        QmiWmsSweepMessage                                *message;
+
+        element = &g_array_index (message_list, QmiMessageWmsListMessagesOutputMessageListElement, i);
+        message = &g_array_index (ctx->messages, QmiWmsSweepMessage, i);
+        message->memory_index = element->memory_index;
+        message->message_tag = element->message_tag;
+    }
+
+    /* Empty store */
+    if (ctx->messages->len == 0) {
+        sweep_complete (task);
+        goto out;
+    }
+
+    sweep_next (task);
+
+out:
+    if (output)
+        qmi_message_wms_list_messages_output_unref (output);
+    g_object_unref (task);
+}
+
+void
+qmi_client_wms_sweep (QmiClientWms        *self,
+                      QmiWmsStorageType    storage_type,
+                      QmiWmsMessageMode    message_mode,
+                      QmiWmsSweepFlags     flags,
+                      guint                window,
+                      GCancellable        *cancellable,
+                      GAsyncReadyCallback  callback,
+                      gpointer             user_data)
+{
+    GTask                          *task;
+    SweepContext                   *ctx;
+    QmiMessageWmsListMessagesInput *input;
+
+    g_return_if_fail (QMI_IS_CLIENT_WMS (self));
+    g_return_if_fail (window > 0);
+
+    ctx = g_slice_new0 (SweepContext);
+    ctx->storage_type = storage_type;
+    ctx->message_mode = message_mode;
+    ctx->flags = flags;
+    ctx->window = window;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_task_data (task, ctx, (GDestroyNotify) sweep_context_free);
+
+    input = qmi_message_wms_list_messages_input_new ();
+    qmi_message_wms_list_messages_input_set_storage_type (input, storage_type, NULL);
+    qmi_message_wms_list_messages_input_set_message_mode (input, message_mode, NULL);
+    qmi_client_wms_list_messages (self,
+                                  input,
+                                  REQUEST_TIMEOUT,
+                                  cancellable,
+                                  (GAsyncReadyCallback) list_messages_ready,
+                                  task);
+    qmi_message_wms_list_messages_input_unref (input);
+}
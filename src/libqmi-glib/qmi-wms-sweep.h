@@ -0,0 +1,120 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_WMS_SWEEP_H_
+#define _LIBQMI_GLIB_QMI_WMS_SWEEP_H_
+
+#if !defined (__LIBQMI_GLIB_H_INSIDE__) && !defined (LIBQMI_GLIB_COMPILATION)
+#error "Only <libqmi-glib.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "qmi-enums-wms.h"
+#include "qmi-wms.h"
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:qmi-wms-sweep
+ * @title: WMS message store sweep
+ * @short_description: reading of all messages in a WMS message store
+ *
+ * Helpers to read, and optionally tag as read or delete, all the messages
+ * in a message store, issuing the WMS List Messages, WMS Raw Read, WMS
+ * Modify Tag and WMS Delete requests as needed.
+ */
+
+/**
+ * QmiWmsSweepMessage:
+ * @memory_index: the index of the message in the store.
+ * @message_tag: a #QmiWmsMessageTagType, as read, before any change requested with #QmiWmsSweepFlags.
+ * @format: a #QmiWmsMessageFormat.
+ * @raw_data: (element-type guint8): the raw message data.
+ *
+ * A message read from the store with qmi_client_wms_sweep().
+ *
+ * Since: 1.20
+ */
+typedef struct {
+    guint32               memory_index;
+    QmiWmsMessageTagType  message_tag;
+    QmiWmsMessageFormat   format;
+    GArray               *raw_data;
+} QmiWmsSweepMessage;
+
+/**
+ * qmi_client_wms_sweep:
+ * @self: a #QmiClientWms.
+ * @storage_type: a #QmiWmsStorageType.
+ * @message_mode: a #QmiWmsMessageMode.
+ * @flags: a mask of #QmiWmsSweepFlags values.
+ * @window: maximum number of messages being processed at the same time, at least 1.
+ * @cancellable: a #GCancellable or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: user data to pass to @callback.
+ *
+ * Asynchronously reads all the messages in the @storage_type store.
+ *
+ * The messages in the store are listed once with WMS List Messages. Then,
+ * each of them is read with WMS Raw Read, and then tagged as read or deleted
+ * as requested in @flags. Up to @window messages are processed at the same
+ * time.
+ *
+ * Messages that cannot be read are skipped, and never deleted. Failing to
+ * tag or delete a message doesn't make the operation fail either.
+ *
+ * When the operation is finished, @callback will be called. You can then call
+ * qmi_client_wms_sweep_finish() to get the result of the operation.
+ *
+ * Since: 1.20
+ */
+void qmi_client_wms_sweep (QmiClientWms        *self,
+                           QmiWmsStorageType    storage_type,
+                           QmiWmsMessageMode    message_mode,
+                           QmiWmsSweepFlags     flags,
+                           guint                window,
+                           GCancellable        *cancellable,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data);
+
+/**
+ * qmi_client_wms_sweep_finish:
+ * @self: a #QmiClientWms.
+ * @res: the #GAsyncResult obtained from the #GAsyncReadyCallback passed to qmi_client_wms_sweep().
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an async operation started with qmi_client_wms_sweep().
+ *
+ * Returns: (transfer full) (element-type QmiWmsSweepMessage): the messages read, in the order given by WMS List Messages, or %NULL if @error is set. The returned value should be freed with g_array_unref().
+ *
+ * Since: 1.20
+ */
+GArray *qmi_client_wms_sweep_finish (QmiClientWms  *self,
+                                     GAsyncResult  *res,
+                                     GError       **error);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_WMS_SWEEP_H_ */
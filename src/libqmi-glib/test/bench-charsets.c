@@ -0,0 +1,129 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+#include <string.h>
+#include <libqmi-glib.h>
+
+#include "bench-common.h"
+
+/* A full single-part SMS: 160 septets in 140 bytes */
+#define SMS_N_SEPTETS 160
+#define SMS_PACKED_LEN 140
+
+/*****************************************************************************/
+
+static void
+build_gsm7_sample (guint8 *packed)
+{
+    static const gchar text[] = "Your verification code is 482913. It expires in 10 minutes (ref: ";
+    guint8 unpacked[SMS_N_SEPTETS];
+    guint  i;
+
+    /* Mostly plain ASCII text, with some characters of the extension table */
+    for (i = 0; i < SMS_N_SEPTETS; i++)
+        unpacked[i] = (guint8) text[i % (sizeof (text) - 1)];
+    for (i = 0; i < SMS_N_SEPTETS; i += 40) {
+        unpacked[i] = 0x1B;
+        unpacked[i + 1] = 0x65;
+    }
+
+    /* And pack it */
+    memset (packed, 0, SMS_PACKED_LEN);
+    for (i = 0; i < SMS_N_SEPTETS; i++) {
+        guint bit = i * 7;
+
+        packed[bit / 8] |= (guint8)(unpacked[i] << (bit % 8));
+        if ((bit % 8) > 1)
+            packed[(bit / 8) + 1] |= (guint8)(unpacked[i] >> (8 - (bit % 8)));
+    }
+}
+
+static void
+bench_gsm7_unpack (void)
+{
+    guint8 packed[SMS_PACKED_LEN];
+    guint8 unpacked[SMS_N_SEPTETS];
+    guint  i;
+
+    build_gsm7_sample (packed);
+
+    g_test_timer_start ();
+    for (i = 0; i < bench_iterations (); i++)
+        g_assert_cmpuint (qmi_charset_gsm7_unpack (packed, sizeof (packed), SMS_N_SEPTETS, unpacked), ==, SMS_N_SEPTETS);
+    bench_report ("charsets/gsm7-unpack", g_test_timer_elapsed ());
+}
+
+static void
+bench_gsm7_to_utf8 (void)
+{
+    guint8 packed[SMS_PACKED_LEN];
+    guint8 unpacked[SMS_N_SEPTETS];
+    gchar  utf8[QMI_CHARSET_GSM7_UTF8_SIZE (SMS_N_SEPTETS)];
+    gsize  total = 0;
+    guint  i;
+
+    build_gsm7_sample (packed);
+
+    /* Whole decoding of the text of a PDU, unpacking included */
+    g_test_timer_start ();
+    for (i = 0; i < bench_iterations (); i++) {
+        guint n_septets;
+
+        n_septets = qmi_charset_gsm7_unpack (packed, sizeof (packed), SMS_N_SEPTETS, unpacked);
+        total += qmi_charset_gsm7_unpacked_to_utf8 (unpacked, n_septets, utf8, sizeof (utf8));
+    }
+    bench_report ("charsets/gsm7-to-utf8", g_test_timer_elapsed ());
+    g_assert_cmpuint (total, >, 0);
+}
+
+static void
+bench_ucs2_to_utf8 (void)
+{
+    /* A full single-part UCS-2 SMS: 70 characters, mixing ASCII and
+     * non-ASCII ones */
+    guint8 ucs2[140];
+    gchar  utf8[QMI_CHARSET_UCS2_UTF8_SIZE (sizeof (ucs2))];
+    gsize  total = 0;
+    guint  i;
+
+    for (i = 0; i < sizeof (ucs2); i += 2) {
+        guint16 c = (i % 8) ? (guint16)('a' + (i % 26)) : 0x043F;
+
+        ucs2[i] = (guint8)(c >> 8);
+        ucs2[i + 1] = (guint8)(c & 0xFF);
+    }
+
+    g_test_timer_start ();
+    for (i = 0; i < bench_iterations (); i++)
+        total += qmi_charset_ucs2_to_utf8 (ucs2, sizeof (ucs2), QMI_ENDIAN_BIG, utf8, sizeof (utf8));
+    bench_report ("charsets/ucs2-to-utf8", g_test_timer_elapsed ());
+    g_assert_cmpuint (total, >, 0);
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    bench_init (100, 1000000);
+
+    g_test_add_func ("/libqmi-glib/bench/charsets/gsm7-unpack",  bench_gsm7_unpack);
+    g_test_add_func ("/libqmi-glib/bench/charsets/gsm7-to-utf8", bench_gsm7_to_utf8);
+    g_test_add_func ("/libqmi-glib/bench/charsets/ucs2-to-utf8", bench_ucs2_to_utf8);
+
+    return g_test_run ();
+}
@@ -0,0 +1,316 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bench-common.h"
+
+/*****************************************************************************/
+
+static guint n_iterations;
+
+void
+bench_init (guint quick_iterations,
+            guint perf_iterations)
+{
+    n_iterations = g_test_perf () ? perf_iterations : quick_iterations;
+}
+
+guint
+bench_iterations (void)
+{
+    return n_iterations;
+}
+
+void
+bench_report_value (const gchar *name,
+                    gdouble      value,
+                    const gchar *unit,
+                    gboolean     maximize)
+{
+    if (maximize)
+        g_test_maximized_result (value, "%s: %.1f %s", name, value, unit);
+    else
+        g_test_minimized_result (value, "%s: %.1f %s", name, value, unit);
+    if (g_test_perf ())
+        g_print ("%s\t%u\t%.1f\t%s\n", name, n_iterations, value, unit);
+}
+
+void
+bench_report (const gchar *name,
+              gdouble      elapsed)
+{
+    bench_report_value (name, (elapsed * 1e9) / n_iterations, "ns/iteration", FALSE);
+}
+
+gsize
+bench_get_resident_size (void)
+{
+    gchar *contents = NULL;
+    gsize  resident = 0;
+    gchar **fields;
+
+    /* Linux only, second field in pages */
+    if (!g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+        return 0;
+
+    fields = g_strsplit (contents, " ", -1);
+    if (g_strv_length (fields) > 1)
+        resident = (gsize) g_ascii_strtoull (fields[1], NULL, 10) * sysconf (_SC_PAGESIZE);
+    g_strfreev (fields);
+    g_free (contents);
+    return resident;
+}
+
+/*****************************************************************************/
+/* Allocation counting, replacing the allocator entry points of the C library
+ * with ones forwarding to the glibc implementation */
+
+#if defined (BENCH_COUNT_ALLOCATIONS) && defined (__GLIBC__)
+
+extern void *__libc_malloc  (size_t size);
+extern void *__libc_calloc  (size_t n_members, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static volatile gint n_allocations;
+
+void *
+malloc (size_t size)
+{
+    g_atomic_int_inc (&n_allocations);
+    return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n_members,
+        size_t size)
+{
+    g_atomic_int_inc (&n_allocations);
+    return __libc_calloc (n_members, size);
+}
+
+void *
+realloc (void   *ptr,
+         size_t  size)
+{
+    g_atomic_int_inc (&n_allocations);
+    return __libc_realloc (ptr, size);
+}
+
+gboolean
+bench_allocations_counted (void)
+{
+    return TRUE;
+}
+
+guint
+bench_get_allocations (void)
+{
+    return (guint) g_atomic_int_get (&n_allocations);
+}
+
+#else
+
+gboolean
+bench_allocations_counted (void)
+{
+    return FALSE;
+}
+
+guint
+bench_get_allocations (void)
+{
+    return 0;
+}
+
+#endif
+
+/*****************************************************************************/
+
+static void
+write_tlv_guint32 (QmiMessage *self,
+                   guint8      type,
+                   guint32     value)
+{
+    gsize init_offset;
+
+    init_offset = qmi_message_tlv_write_init (self, type, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_guint32 (self, QMI_ENDIAN_LITTLE, value, NULL));
+    g_assert (qmi_message_tlv_write_complete (self, init_offset, NULL));
+}
+
+static void
+write_tlv_guint64 (QmiMessage *self,
+                   guint8      type,
+                   guint64     value)
+{
+    gsize init_offset;
+
+    init_offset = qmi_message_tlv_write_init (self, type, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_guint64 (self, QMI_ENDIAN_LITTLE, value, NULL));
+    g_assert (qmi_message_tlv_write_complete (self, init_offset, NULL));
+}
+
+static void
+write_tlv_rssi_ecio (QmiMessage *self,
+                     guint8      type,
+                     gint8       rssi,
+                     gint16      ecio)
+{
+    gsize init_offset;
+
+    init_offset = qmi_message_tlv_write_init (self, type, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_gint8 (self, rssi, NULL));
+    g_assert (qmi_message_tlv_write_gint16 (self, QMI_ENDIAN_LITTLE, ecio, NULL));
+    g_assert (qmi_message_tlv_write_complete (self, init_offset, NULL));
+}
+
+static void
+build_nas_get_signal_info (QmiMessage *self)
+{
+    gsize init_offset;
+
+    /* CDMA */
+    write_tlv_rssi_ecio (self, 0x10, -75, -10);
+
+    /* HDR */
+    init_offset = qmi_message_tlv_write_init (self, 0x11, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_gint8 (self, -80, NULL));
+    g_assert (qmi_message_tlv_write_gint16 (self, QMI_ENDIAN_LITTLE, -12, NULL));
+    g_assert (qmi_message_tlv_write_guint8 (self, QMI_NAS_EVDO_SINR_LEVEL_5, NULL));
+    g_assert (qmi_message_tlv_write_gint32 (self, QMI_ENDIAN_LITTLE, -85, NULL));
+    g_assert (qmi_message_tlv_write_complete (self, init_offset, NULL));
+
+    /* GSM */
+    init_offset = qmi_message_tlv_write_init (self, 0x12, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_gint8 (self, -70, NULL));
+    g_assert (qmi_message_tlv_write_complete (self, init_offset, NULL));
+
+    /* WCDMA */
+    write_tlv_rssi_ecio (self, 0x13, -65, -6);
+
+    /* LTE */
+    init_offset = qmi_message_tlv_write_init (self, 0x14, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_gint8 (self, -60, NULL));
+    g_assert (qmi_message_tlv_write_gint8 (self, -9, NULL));
+    g_assert (qmi_message_tlv_write_gint16 (self, QMI_ENDIAN_LITTLE, -95, NULL));
+    g_assert (qmi_message_tlv_write_gint16 (self, QMI_ENDIAN_LITTLE, 132, NULL));
+    g_assert (qmi_message_tlv_write_complete (self, init_offset, NULL));
+}
+
+static void
+build_wds_get_packet_statistics (QmiMessage *self)
+{
+    guint8 type;
+
+    /* Packet counters */
+    for (type = 0x10; type <= 0x15; type++)
+        write_tlv_guint32 (self, type, 1000000 + type);
+
+    /* Byte counters */
+    for (type = 0x19; type <= 0x1C; type++)
+        write_tlv_guint64 (self, type, G_GUINT64_CONSTANT (4000000000) + type);
+
+    /* Dropped packets */
+    write_tlv_guint32 (self, 0x1D, 12);
+    write_tlv_guint32 (self, 0x1E, 34);
+}
+
+static void
+build_dms_list_stored_images (QmiMessage *self)
+{
+    static const gchar *build_ids[] = {
+        "02.14.03.00_GENERIC",
+        "02.14.03.00_VERIZON",
+        "002.015_000",
+        "002.012_000",
+    };
+    gsize init_offset;
+    guint i;
+    guint j;
+
+    init_offset = qmi_message_tlv_write_init (self, 0x01, NULL);
+    g_assert (init_offset);
+
+    /* Two images (modem and PRI), with two entries each */
+    g_assert (qmi_message_tlv_write_guint8 (self, 2, NULL));
+    for (i = 0; i < 2; i++) {
+        g_assert (qmi_message_tlv_write_guint8 (self, i ? QMI_DMS_FIRMWARE_IMAGE_TYPE_PRI : QMI_DMS_FIRMWARE_IMAGE_TYPE_MODEM, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (self, 4, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (self, 0, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (self, 2, NULL));
+        for (j = 0; j < 2; j++) {
+            guint k;
+
+            g_assert (qmi_message_tlv_write_guint8 (self, j, NULL));
+            g_assert (qmi_message_tlv_write_guint8 (self, 0, NULL));
+            for (k = 0; k < 16; k++)
+                g_assert (qmi_message_tlv_write_guint8 (self, (guint8) ((i << 4) | (j << 2) | k), NULL));
+            g_assert (qmi_message_tlv_write_string (self, 1, build_ids[(i * 2) + j], -1, NULL));
+        }
+    }
+
+    g_assert (qmi_message_tlv_write_complete (self, init_offset, NULL));
+}
+
+QmiMessage *
+bench_build_request (QmiService service,
+                     guint8     client_id,
+                     guint16    message_id)
+{
+    QmiMessage *self;
+
+    self = qmi_message_new (service, client_id, 0, message_id);
+
+    /* Mandatory statistics mask */
+    if (service == QMI_SERVICE_WDS && message_id == 0x0024)
+        write_tlv_guint32 (self, 0x01, BENCH_WDS_PACKET_STATISTICS_MASK);
+
+    return self;
+}
+
+QmiMessage *
+bench_build_response (QmiMessage *request)
+{
+    QmiMessage *self;
+
+    self = qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+
+    switch (qmi_message_get_service (request)) {
+    case QMI_SERVICE_NAS:
+        g_assert_cmpuint (qmi_message_get_message_id (request), ==, 0x004F);
+        build_nas_get_signal_info (self);
+        break;
+    case QMI_SERVICE_WDS:
+        g_assert_cmpuint (qmi_message_get_message_id (request), ==, 0x0024);
+        build_wds_get_packet_statistics (self);
+        break;
+    case QMI_SERVICE_DMS:
+        g_assert_cmpuint (qmi_message_get_message_id (request), ==, 0x0049);
+        build_dms_list_stored_images (self);
+        break;
+    default:
+        g_assert_not_reached ();
+    }
+
+    return self;
+}
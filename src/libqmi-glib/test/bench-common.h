@@ -0,0 +1,60 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <glib.h>
+#include <libqmi-glib.h>
+
+/*****************************************************************************/
+/* Benchmark reporting
+ *
+ * Benchmarks run a small number of iterations by default, so that they can be
+ * used as plain tests; the full number of iterations is only run in perf mode
+ * (-m perf), where a tab-separated line with the benchmark name, the number of
+ * iterations, the measured value and its unit is also printed for each one. */
+
+void  bench_init         (guint        quick_iterations,
+                          guint        perf_iterations);
+guint bench_iterations   (void);
+void  bench_report_value (const gchar *name,
+                          gdouble      value,
+                          const gchar *unit,
+                          gboolean     maximize);
+void  bench_report       (const gchar *name,
+                          gdouble      elapsed);
+
+/* Resident memory of the process, in bytes, or 0 if unknown */
+gsize bench_get_resident_size (void);
+
+/* Number of malloc(), calloc() and realloc() calls done so far by the whole
+ * process. Only counted in programs built with BENCH_COUNT_ALLOCATIONS and
+ * glibc; bench_allocations_counted() returns FALSE otherwise. */
+gboolean bench_allocations_counted (void);
+guint    bench_get_allocations     (void);
+
+/*****************************************************************************/
+/* Sample NAS Get Signal Info, WDS Get Packet Statistics and DMS List Stored
+ * Images messages, with all the TLVs given in real world responses */
+
+#define BENCH_WDS_PACKET_STATISTICS_MASK 0x000003FF
+
+QmiMessage *bench_build_request  (QmiService service,
+                                  guint8     client_id,
+                                  guint16    message_id);
+QmiMessage *bench_build_response (QmiMessage *request);
+
+#endif /* BENCH_COMMON_H */
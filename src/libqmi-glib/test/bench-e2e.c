@@ -0,0 +1,508 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+/*
+ * End-to-end benchmarks, with a simulated modem answering every request right
+ * away with a canned response, and able to emit indication storms.
+ *
+ * In direct mode the QmiDevice talks to the simulated modem as if it were the
+ * proxy, as in the tests. In proxy mode a QmiProxy runs in this same process,
+ * and the simulated modem is reached by the proxy through a pseudo terminal,
+ * as if it were a real cdc-wdm port.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <unistd.h>
+#include <libqmi-glib.h>
+
+#include "test-port-context.h"
+#include "bench-common.h"
+
+/* Vendor specific TLV in the emitted indications, with the monotonic time
+ * when they were written by the simulated modem */
+#define INDICATION_TIMESTAMP_TLV 0x7F
+
+typedef enum {
+    BENCH_MODE_DIRECT,
+    BENCH_MODE_PROXY,
+} BenchMode;
+
+typedef struct {
+    const gchar *name;
+    BenchMode    mode;
+    guint        concurrency;
+} BenchCase;
+
+typedef struct {
+    const BenchCase *bench_case;
+    GMainLoop       *loop;
+    TestPortContext *port;
+    QmiProxy        *proxy;
+    QmiDevice       *device;
+    QmiClient       *nas;
+    QmiClient       *wds;
+
+    /* Only used in the simulated modem thread */
+    guint8           next_cid;
+
+    /* Requests */
+    guint            n_sent;
+    guint            n_completed;
+    gint64           latency_total;
+
+    /* Indications */
+    gint64           storm_start;
+    gint64           last_timestamp;
+    guint            n_received;
+} BenchContext;
+
+/*****************************************************************************/
+/* Simulated modem */
+
+static GByteArray *
+modem_respond (TestPortContext *port,
+               GByteArray      *request_raw,
+               BenchContext    *bench)
+{
+    QmiMessage *request = (QmiMessage *) request_raw;
+    QmiMessage *response;
+    gsize       init_offset;
+    gsize       offset = 0;
+    guint8      service;
+    guint8      cid;
+
+    if (qmi_message_get_service (request) == QMI_SERVICE_NAS &&
+        qmi_message_get_message_id (request) == 0x004F)
+        return bench_build_response (request);
+
+    response = qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+    if (qmi_message_get_service (request) != QMI_SERVICE_CTL)
+        return response;
+
+    switch (qmi_message_get_message_id (request)) {
+    case 0x0022: /* Allocate CID */
+        init_offset = qmi_message_tlv_read_init (request, 0x01, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint8 (request, init_offset, &offset, &service, NULL));
+        cid = ++bench->next_cid;
+        break;
+    case 0x0023: /* Release CID */
+        init_offset = qmi_message_tlv_read_init (request, 0x01, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint8 (request, init_offset, &offset, &service, NULL));
+        g_assert (qmi_message_tlv_read_guint8 (request, init_offset, &offset, &cid, NULL));
+        break;
+    default:
+        /* e.g. internal proxy open, in direct mode */
+        return response;
+    }
+
+    init_offset = qmi_message_tlv_write_init (response, 0x01, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_guint8 (response, service, NULL));
+    g_assert (qmi_message_tlv_write_guint8 (response, cid, NULL));
+    g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+    return response;
+}
+
+static gboolean
+modem_emit_indication_storm (BenchContext *bench)
+{
+    guint i;
+
+    bench->storm_start = g_get_monotonic_time ();
+    for (i = 0; i < bench_iterations (); i++) {
+        QmiMessage *indication;
+        gsize       init_offset;
+
+        /* WDS Event Report, broadcast. There is no indication constructor, so
+         * just set the flag in the QMI service header of a new request */
+        indication = qmi_message_new (QMI_SERVICE_WDS, QMI_CID_BROADCAST, 0, 0x0001);
+        ((GByteArray *) indication)->data[6] |= 0x04;
+
+        init_offset = qmi_message_tlv_write_init (indication, INDICATION_TIMESTAMP_TLV, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_gint64 (indication, QMI_ENDIAN_LITTLE, g_get_monotonic_time (), NULL));
+        g_assert (qmi_message_tlv_write_complete (indication, init_offset, NULL));
+
+        test_port_context_write (bench->port, indication->data, indication->len);
+        qmi_message_unref (indication);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/*****************************************************************************/
+/* Setup and teardown */
+
+static void
+device_new_ready (GObject      *source,
+                  GAsyncResult *res,
+                  BenchContext *bench)
+{
+    GError *error = NULL;
+
+    bench->device = qmi_device_new_finish (res, &error);
+    g_assert_no_error (error);
+    g_main_loop_quit (bench->loop);
+}
+
+static void
+device_open_ready (QmiDevice    *device,
+                   GAsyncResult *res,
+                   BenchContext *bench)
+{
+    GError *error = NULL;
+
+    g_assert (qmi_device_open_finish (device, res, &error));
+    g_assert_no_error (error);
+    g_main_loop_quit (bench->loop);
+}
+
+static void
+device_allocate_client_ready (QmiDevice    *device,
+                              GAsyncResult *res,
+                              QmiClient   **client)
+{
+    GError *error = NULL;
+
+    *client = qmi_device_allocate_client_finish (device, res, &error);
+    g_assert_no_error (error);
+    g_assert (QMI_IS_CLIENT (*client));
+}
+
+static void
+allocate_client (BenchContext  *bench,
+                 QmiService     service,
+                 QmiClient    **client)
+{
+    qmi_device_allocate_client (bench->device, service, QMI_CID_NONE, 10, NULL,
+                                (GAsyncReadyCallback) device_allocate_client_ready,
+                                client);
+    while (!*client)
+        g_main_context_iteration (NULL, TRUE);
+}
+
+static void
+bench_setup (BenchContext    *bench,
+             const BenchCase *bench_case)
+{
+    static guint  num = 0;
+    GFile        *file;
+    GError       *error = NULL;
+    gchar        *path = NULL;
+
+    memset (bench, 0, sizeof (BenchContext));
+    bench->bench_case = bench_case;
+    bench->loop = g_main_loop_new (NULL, FALSE);
+
+    if (bench_case->mode == BENCH_MODE_PROXY) {
+        bench->port = test_port_context_new_pty ();
+        bench->proxy = qmi_proxy_new (&error);
+        g_assert_no_error (error);
+    } else {
+        path = g_strdup_printf ("/dev/qmibench%08lu%04u", (gulong) getpid (), num++);
+        bench->port = test_port_context_new (path);
+    }
+    test_port_context_set_responder (bench->port, (TestPortContextResponderFn) modem_respond, bench);
+    test_port_context_start (bench->port);
+
+    file = g_file_new_for_path (test_port_context_get_name (bench->port));
+    if (path)
+        g_async_initable_new_async (QMI_TYPE_DEVICE, G_PRIORITY_DEFAULT, NULL,
+                                    (GAsyncReadyCallback) device_new_ready, bench,
+                                    QMI_DEVICE_FILE,          file,
+                                    QMI_DEVICE_NO_FILE_CHECK, TRUE,
+                                    QMI_DEVICE_PROXY_PATH,    path,
+                                    NULL);
+    else
+        g_async_initable_new_async (QMI_TYPE_DEVICE, G_PRIORITY_DEFAULT, NULL,
+                                    (GAsyncReadyCallback) device_new_ready, bench,
+                                    QMI_DEVICE_FILE,          file,
+                                    QMI_DEVICE_NO_FILE_CHECK, TRUE,
+                                    NULL);
+    g_object_unref (file);
+    g_free (path);
+    g_main_loop_run (bench->loop);
+
+    qmi_device_open (bench->device, QMI_DEVICE_OPEN_FLAGS_PROXY, 10, NULL,
+                     (GAsyncReadyCallback) device_open_ready,
+                     bench);
+    g_main_loop_run (bench->loop);
+
+    allocate_client (bench, QMI_SERVICE_NAS, &bench->nas);
+    allocate_client (bench, QMI_SERVICE_WDS, &bench->wds);
+}
+
+static void
+device_release_client_ready (QmiDevice    *device,
+                             GAsyncResult *res,
+                             QmiClient   **client)
+{
+    GError *error = NULL;
+
+    g_assert (qmi_device_release_client_finish (device, res, &error));
+    g_assert_no_error (error);
+    g_clear_object (client);
+}
+
+static void
+release_client (BenchContext  *bench,
+                QmiClient    **client)
+{
+    qmi_device_release_client (bench->device, *client,
+                               QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID, 10, NULL,
+                               (GAsyncReadyCallback) device_release_client_ready,
+                               client);
+    while (*client)
+        g_main_context_iteration (NULL, TRUE);
+}
+
+static void
+device_close_ready (QmiDevice    *device,
+                    GAsyncResult *res,
+                    BenchContext *bench)
+{
+    GError *error = NULL;
+
+    g_assert (qmi_device_close_finish (device, res, &error));
+    g_assert_no_error (error);
+    g_main_loop_quit (bench->loop);
+}
+
+static void
+bench_teardown (BenchContext    *bench,
+                const BenchCase *bench_case)
+{
+    release_client (bench, &bench->nas);
+    release_client (bench, &bench->wds);
+
+    qmi_device_close_async (bench->device, 10, NULL,
+                            (GAsyncReadyCallback) device_close_ready,
+                            bench);
+    g_main_loop_run (bench->loop);
+    g_object_unref (bench->device);
+
+    if (bench->proxy)
+        g_object_unref (bench->proxy);
+
+    test_port_context_stop (bench->port);
+    test_port_context_free (bench->port);
+    g_main_loop_unref (bench->loop);
+}
+
+/*****************************************************************************/
+/* Requests */
+
+typedef struct {
+    BenchContext *bench;
+    gint64        start;
+} RequestContext;
+
+static void send_request (BenchContext *bench);
+
+static void
+request_ready (QmiClientNas   *client,
+               GAsyncResult   *res,
+               RequestContext *ctx)
+{
+    QmiMessageNasGetSignalInfoOutput *output;
+    BenchContext *bench = ctx->bench;
+    GError *error = NULL;
+
+    output = qmi_client_nas_get_signal_info_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+    qmi_message_nas_get_signal_info_output_unref (output);
+
+    bench->latency_total += g_get_monotonic_time () - ctx->start;
+    g_slice_free (RequestContext, ctx);
+
+    if (++bench->n_completed == bench_iterations ()) {
+        g_main_loop_quit (bench->loop);
+        return;
+    }
+
+    if (bench->n_sent < bench_iterations ())
+        send_request (bench);
+}
+
+static void
+send_request (BenchContext *bench)
+{
+    RequestContext *ctx;
+
+    ctx = g_slice_new (RequestContext);
+    ctx->bench = bench;
+    ctx->start = g_get_monotonic_time ();
+    bench->n_sent++;
+
+    qmi_client_nas_get_signal_info (QMI_CLIENT_NAS (bench->nas), NULL, 10, NULL,
+                                    (GAsyncReadyCallback) request_ready,
+                                    ctx);
+}
+
+static void
+bench_requests (BenchContext    *bench,
+                const BenchCase *bench_case)
+{
+    gsize   resident_start;
+    gdouble elapsed;
+    gchar  *prefix;
+    gchar  *name;
+    guint   i;
+
+    resident_start = bench_get_resident_size ();
+    g_test_timer_start ();
+    for (i = 0; i < MIN (bench_case->concurrency, bench_iterations ()); i++)
+        send_request (bench);
+    g_main_loop_run (bench->loop);
+    elapsed = g_test_timer_elapsed ();
+
+    prefix = g_strdup_printf ("e2e/%s/requests-%u", bench_case->name, bench_case->concurrency);
+
+    name = g_strdup_printf ("%s/throughput", prefix);
+    bench_report_value (name, elapsed > 0 ? bench_iterations () / elapsed : 0.0, "requests/s", TRUE);
+    g_free (name);
+
+    name = g_strdup_printf ("%s/latency", prefix);
+    bench_report_value (name, (gdouble) bench->latency_total / bench_iterations (), "us/request", FALSE);
+    g_free (name);
+
+    name = g_strdup_printf ("%s/memory-growth", prefix);
+    bench_report_value (name, ((gdouble) bench_get_resident_size () - resident_start) / 1024.0, "KiB", FALSE);
+    g_free (name);
+
+    g_free (prefix);
+}
+
+/*****************************************************************************/
+/* Indications */
+
+static void
+device_indication_cb (QmiDevice    *device,
+                      QmiMessage   *message,
+                      BenchContext *bench)
+{
+    gsize  init_offset;
+    gsize  offset = 0;
+    gint64 timestamp;
+
+    /* Emitted before the indication is dispatched to the clients */
+    init_offset = qmi_message_tlv_read_init (message, INDICATION_TIMESTAMP_TLV, NULL, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_read_gint64 (message, init_offset, &offset, QMI_ENDIAN_LITTLE, &timestamp, NULL));
+    bench->last_timestamp = timestamp;
+}
+
+static void
+wds_event_report_cb (QmiClientWds                      *client,
+                     QmiIndicationWdsEventReportOutput *output,
+                     BenchContext                      *bench)
+{
+    bench->latency_total += g_get_monotonic_time () - bench->last_timestamp;
+    if (++bench->n_received == bench_iterations ())
+        g_main_loop_quit (bench->loop);
+}
+
+static void
+bench_indications (BenchContext    *bench,
+                   const BenchCase *bench_case)
+{
+    gsize   resident_start;
+    gdouble elapsed;
+    gulong  device_indication_id;
+    gulong  event_report_id;
+    gchar  *name;
+
+    device_indication_id = g_signal_connect (bench->device,
+                                             QMI_DEVICE_SIGNAL_INDICATION,
+                                             G_CALLBACK (device_indication_cb),
+                                             bench);
+    event_report_id = g_signal_connect (bench->wds,
+                                        "event-report",
+                                        G_CALLBACK (wds_event_report_cb),
+                                        bench);
+
+    resident_start = bench_get_resident_size ();
+    test_port_context_invoke (bench->port, (GSourceFunc) modem_emit_indication_storm, bench);
+    g_main_loop_run (bench->loop);
+    elapsed = (gdouble) (g_get_monotonic_time () - bench->storm_start) / G_USEC_PER_SEC;
+
+    g_signal_handler_disconnect (bench->wds, event_report_id);
+    g_signal_handler_disconnect (bench->device, device_indication_id);
+
+    name = g_strdup_printf ("e2e/%s/indications/throughput", bench_case->name);
+    bench_report_value (name, elapsed > 0 ? bench_iterations () / elapsed : 0.0, "indications/s", TRUE);
+    g_free (name);
+
+    name = g_strdup_printf ("e2e/%s/indications/dispatch-latency", bench_case->name);
+    bench_report_value (name, (gdouble) bench->latency_total / bench_iterations (), "us/indication", FALSE);
+    g_free (name);
+
+    name = g_strdup_printf ("e2e/%s/indications/memory-growth", bench_case->name);
+    bench_report_value (name, ((gdouble) bench_get_resident_size () - resident_start) / 1024.0, "KiB", FALSE);
+    g_free (name);
+}
+
+/*****************************************************************************/
+
+typedef void (*BenchFunc) (BenchContext *, gconstpointer);
+
+static const BenchCase bench_cases[] = {
+    { "direct", BENCH_MODE_DIRECT, 1  },
+    { "direct", BENCH_MODE_DIRECT, 16 },
+    { "proxy",  BENCH_MODE_PROXY,  1  },
+    { "proxy",  BENCH_MODE_PROXY,  16 },
+};
+
+int main (int argc, char **argv)
+{
+    guint i;
+
+    g_test_init (&argc, &argv, NULL);
+
+    /* The QmiDevice created by the proxy complains about the pseudo terminal
+     * not being a cdc-wdm port, that's fine */
+    g_log_set_always_fatal (G_LOG_LEVEL_ERROR | G_LOG_LEVEL_CRITICAL);
+
+    bench_init (10, 20000);
+
+    for (i = 0; i < G_N_ELEMENTS (bench_cases); i++) {
+        gchar *path;
+
+        path = g_strdup_printf ("/libqmi-glib/bench/e2e/%s/requests-%u",
+                                bench_cases[i].name, bench_cases[i].concurrency);
+        g_test_add (path, BenchContext, &bench_cases[i],
+                    (BenchFunc) bench_setup,
+                    (BenchFunc) bench_requests,
+                    (BenchFunc) bench_teardown);
+        g_free (path);
+
+        /* One indication storm per mode */
+        if (bench_cases[i].concurrency != 1)
+            continue;
+
+        path = g_strdup_printf ("/libqmi-glib/bench/e2e/%s/indications", bench_cases[i].name);
+        g_test_add (path, BenchContext, &bench_cases[i],
+                    (BenchFunc) bench_setup,
+                    (BenchFunc) bench_indications,
+                    (BenchFunc) bench_teardown);
+        g_free (path);
+    }
+
+    return g_test_run ();
+}
@@ -0,0 +1,203 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+/*
+ * The generated response parsers are only reachable through the client API,
+ * so these benchmarks time whole request/response round-trips through the
+ * virtual test port. Each message is run twice, once with a response carrying
+ * just the result TLV and once with a full response: the difference between
+ * both is the cost of parsing the extra TLVs.
+ */
+
+#include <config.h>
+#include <libqmi-glib.h>
+
+#include "test-fixture.h"
+#include "bench-common.h"
+
+typedef struct {
+    const gchar *name;
+    QmiService   service;
+    guint16      message_id;
+    gboolean     full;
+} GeneratedBench;
+
+/*****************************************************************************/
+
+static void
+nas_get_signal_info_ready (QmiClientNas *client,
+                           GAsyncResult *res,
+                           TestFixture  *fixture)
+{
+    QmiMessageNasGetSignalInfoOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_nas_get_signal_info_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+    qmi_message_nas_get_signal_info_output_unref (output);
+
+    test_fixture_loop_stop (fixture);
+}
+
+static void
+wds_get_packet_statistics_ready (QmiClientWds *client,
+                                 GAsyncResult *res,
+                                 TestFixture  *fixture)
+{
+    QmiMessageWdsGetPacketStatisticsOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_wds_get_packet_statistics_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+    qmi_message_wds_get_packet_statistics_output_unref (output);
+
+    test_fixture_loop_stop (fixture);
+}
+
+static void
+dms_list_stored_images_ready (QmiClientDms *client,
+                              GAsyncResult *res,
+                              TestFixture  *fixture)
+{
+    QmiMessageDmsListStoredImagesOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_dms_list_stored_images_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+    qmi_message_dms_list_stored_images_output_unref (output);
+
+    test_fixture_loop_stop (fixture);
+}
+
+static void
+run_request (TestFixture          *fixture,
+             const GeneratedBench *bench,
+             gpointer              input)
+{
+    QmiClient *client;
+
+    client = fixture->service_info[bench->service].client;
+
+    switch (bench->service) {
+    case QMI_SERVICE_NAS:
+        qmi_client_nas_get_signal_info (QMI_CLIENT_NAS (client), NULL, 3, NULL,
+                                        (GAsyncReadyCallback) nas_get_signal_info_ready,
+                                        fixture);
+        break;
+    case QMI_SERVICE_WDS:
+        qmi_client_wds_get_packet_statistics (QMI_CLIENT_WDS (client), input, 3, NULL,
+                                              (GAsyncReadyCallback) wds_get_packet_statistics_ready,
+                                              fixture);
+        break;
+    case QMI_SERVICE_DMS:
+        qmi_client_dms_list_stored_images (QMI_CLIENT_DMS (client), NULL, 3, NULL,
+                                           (GAsyncReadyCallback) dms_list_stored_images_ready,
+                                           fixture);
+        break;
+    default:
+        g_assert_not_reached ();
+    }
+
+    test_fixture_loop_run (fixture);
+}
+
+static void
+bench_generated (TestFixture          *fixture,
+                 const GeneratedBench *bench)
+{
+    QmiMessage                            *request;
+    QmiMessage                            *response;
+    QmiMessageWdsGetPacketStatisticsInput *input = NULL;
+    const guint8                          *request_raw;
+    const guint8                          *response_raw;
+    gsize                                  request_raw_length;
+    gsize                                  response_raw_length;
+    gchar                                 *report_name;
+    guint                                  i;
+
+    /* Don't time the text traces enabled by the fixture */
+    qmi_utils_set_traces_enabled (FALSE);
+
+    request = bench_build_request (bench->service,
+                                   qmi_client_get_cid (fixture->service_info[bench->service].client),
+                                   bench->message_id);
+    response = (bench->full ?
+                bench_build_response (request) :
+                qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NOT_SUPPORTED));
+    request_raw = qmi_message_get_raw (request, &request_raw_length, NULL);
+    response_raw = qmi_message_get_raw (response, &response_raw_length, NULL);
+
+    if (bench->service == QMI_SERVICE_WDS) {
+        input = qmi_message_wds_get_packet_statistics_input_new ();
+        qmi_message_wds_get_packet_statistics_input_set_mask (input, BENCH_WDS_PACKET_STATISTICS_MASK, NULL);
+    }
+
+    g_test_timer_start ();
+    for (i = 0; i < bench_iterations (); i++) {
+        test_port_context_set_command (fixture->ctx,
+                                       request_raw, request_raw_length,
+                                       response_raw, response_raw_length,
+                                       fixture->service_info[bench->service].transaction_id++);
+        run_request (fixture, bench, input);
+    }
+    report_name = g_strdup_printf ("generated/%s/%s", bench->name, bench->full ? "full" : "result-only");
+    bench_report (report_name, g_test_timer_elapsed ());
+    g_free (report_name);
+
+    if (input)
+        qmi_message_wds_get_packet_statistics_input_unref (input);
+    qmi_message_unref (response);
+    qmi_message_unref (request);
+}
+
+/*****************************************************************************/
+
+static const GeneratedBench benchs[] = {
+    { "nas-get-signal-info",       QMI_SERVICE_NAS, 0x004F, FALSE },
+    { "nas-get-signal-info",       QMI_SERVICE_NAS, 0x004F, TRUE  },
+    { "wds-get-packet-statistics", QMI_SERVICE_WDS, 0x0024, FALSE },
+    { "wds-get-packet-statistics", QMI_SERVICE_WDS, 0x0024, TRUE  },
+    { "dms-list-stored-images",    QMI_SERVICE_DMS, 0x0049, FALSE },
+    { "dms-list-stored-images",    QMI_SERVICE_DMS, 0x0049, TRUE  },
+};
+
+int main (int argc, char **argv)
+{
+    guint i;
+
+    g_test_init (&argc, &argv, NULL);
+
+    /* Transaction IDs are 16-bit, keep well below the wrap around */
+    bench_init (10, 5000);
+
+    for (i = 0; i < G_N_ELEMENTS (benchs); i++) {
+        gchar *path;
+
+        path = g_strdup_printf ("/libqmi-glib/bench/generated/%s/%s",
+                                benchs[i].name, benchs[i].full ? "full" : "result-only");
+        g_test_add (path,
+                    TestFixture,
+                    &benchs[i],
+                    (TCFunc)test_fixture_setup,
+                    (TCFunc)bench_generated,
+                    (TCFunc)test_fixture_teardown);
+        g_free (path);
+    }
+
+    return g_test_run ();
+}
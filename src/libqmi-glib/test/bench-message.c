@@ -0,0 +1,228 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+#include <libqmi-glib.h>
+
+#include "bench-common.h"
+
+/* Number of messages given at once to qmi_message_new_from_raw() */
+#define N_BATCH_MESSAGES 16
+
+/*****************************************************************************/
+
+static QmiMessage *
+build_sample (QmiService service,
+              guint16    message_id)
+{
+    QmiMessage *request;
+    QmiMessage *response;
+
+    request = bench_build_request (service, 1, message_id);
+    response = bench_build_response (request);
+    qmi_message_unref (request);
+    return response;
+}
+
+/*****************************************************************************/
+/* Raw buffer to message, including the message validity checks */
+
+static void
+bench_message_new_from_raw (void)
+{
+    QmiMessage *sample;
+    GByteArray *buffer;
+    guint       i;
+    guint       j;
+
+    sample = build_sample (QMI_SERVICE_NAS, 0x004F);
+    buffer = g_byte_array_sized_new (sample->len * N_BATCH_MESSAGES);
+
+    g_test_timer_start ();
+    for (i = 0; i < bench_iterations (); i++) {
+        /* Several messages in the same buffer, as when read in one go from the
+         * device */
+        for (j = 0; j < N_BATCH_MESSAGES; j++)
+            g_byte_array_append (buffer, sample->data, sample->len);
+        for (j = 0; j < N_BATCH_MESSAGES; j++) {
+            QmiMessage *message;
+
+            message = qmi_message_new_from_raw (buffer, NULL);
+            g_assert (message);
+            qmi_message_unref (message);
+        }
+        g_assert_cmpuint (buffer->len, ==, 0);
+    }
+    bench_report ("message/new-from-raw", g_test_timer_elapsed () / N_BATCH_MESSAGES);
+
+    g_byte_array_unref (buffer);
+    qmi_message_unref (sample);
+}
+
+/*****************************************************************************/
+/* TLV read/write primitives */
+
+static void
+bench_tlv_write (void)
+{
+    guint i;
+
+    g_test_timer_start ();
+    for (i = 0; i < bench_iterations (); i++) {
+        QmiMessage *message;
+
+        message = build_sample (QMI_SERVICE_WDS, 0x0024);
+        qmi_message_unref (message);
+    }
+    bench_report ("tlv/write-integers", g_test_timer_elapsed ());
+}
+
+static void
+bench_tlv_read (void)
+{
+    QmiMessage *sample;
+    guint64     total = 0;
+    guint       i;
+
+    sample = build_sample (QMI_SERVICE_WDS, 0x0024);
+
+    g_test_timer_start ();
+    for (i = 0; i < bench_iterations (); i++) {
+        guint8 type;
+
+        for (type = 0x10; type <= 0x1E; type++) {
+            gsize   init_offset;
+            gsize   offset = 0;
+            guint32 value32;
+            guint64 value64;
+
+            init_offset = qmi_message_tlv_read_init (sample, type, NULL, NULL);
+            if (!init_offset)
+                continue;
+            if (type >= 0x19 && type <= 0x1C) {
+                g_assert (qmi_message_tlv_read_guint64 (sample, init_offset, &offset, QMI_ENDIAN_LITTLE, &value64, NULL));
+                total += value64;
+            } else {
+                g_assert (qmi_message_tlv_read_guint32 (sample, init_offset, &offset, QMI_ENDIAN_LITTLE, &value32, NULL));
+                total += value32;
+            }
+        }
+    }
+    bench_report ("tlv/read-integers", g_test_timer_elapsed ());
+    g_assert_cmpuint (total, >, 0);
+
+    qmi_message_unref (sample);
+}
+
+static void
+bench_tlv_read_string (void)
+{
+    QmiMessage *sample;
+    guint       i;
+
+    sample = build_sample (QMI_SERVICE_DMS, 0x0049);
+
+    g_test_timer_start ();
+    for (i = 0; i < bench_iterations (); i++) {
+        gsize  init_offset;
+        gsize  offset = 0;
+        guint8 n_images;
+        guint  j;
+
+        /* Walk the whole image list, reading all build ID strings */
+        init_offset = qmi_message_tlv_read_init (sample, 0x01, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint8 (sample, init_offset, &offset, &n_images, NULL));
+        for (j = 0; j < n_images; j++) {
+            guint8 header[3];
+            guint8 n_entries;
+            guint  k;
+
+            for (k = 0; k < G_N_ELEMENTS (header); k++)
+                g_assert (qmi_message_tlv_read_guint8 (sample, init_offset, &offset, &header[k], NULL));
+            g_assert (qmi_message_tlv_read_guint8 (sample, init_offset, &offset, &n_entries, NULL));
+            for (k = 0; k < n_entries; k++) {
+                guint8  unused;
+                gchar   unique_id[16];
+                gchar  *build_id;
+
+                g_assert (qmi_message_tlv_read_guint8 (sample, init_offset, &offset, &unused, NULL));
+                g_assert (qmi_message_tlv_read_guint8 (sample, init_offset, &offset, &unused, NULL));
+                g_assert (qmi_message_tlv_read_fixed_size_string (sample, init_offset, &offset, sizeof (unique_id), unique_id, NULL));
+                g_assert (qmi_message_tlv_read_string (sample, init_offset, &offset, 1, 0, &build_id, NULL));
+                g_free (build_id);
+            }
+        }
+    }
+    bench_report ("tlv/read-strings", g_test_timer_elapsed ());
+
+    qmi_message_unref (sample);
+}
+
+/*****************************************************************************/
+/* Printable generation, going through the generated TLV printable helpers */
+
+static void
+bench_printable (gconstpointer data)
+{
+    const gchar *name = data;
+    QmiMessage  *sample;
+    GString     *printable;
+    gchar       *report_name;
+    guint        i;
+
+    if (g_str_equal (name, "nas-get-signal-info"))
+        sample = build_sample (QMI_SERVICE_NAS, 0x004F);
+    else if (g_str_equal (name, "wds-get-packet-statistics"))
+        sample = build_sample (QMI_SERVICE_WDS, 0x0024);
+    else if (g_str_equal (name, "dms-list-stored-images"))
+        sample = build_sample (QMI_SERVICE_DMS, 0x0049);
+    else
+        g_assert_not_reached ();
+
+    printable = g_string_sized_new (4096);
+
+    g_test_timer_start ();
+    for (i = 0; i < bench_iterations (); i++) {
+        g_string_truncate (printable, 0);
+        qmi_message_append_printable (sample, NULL, "", printable);
+    }
+    report_name = g_strdup_printf ("printable/%s", name);
+    bench_report (report_name, g_test_timer_elapsed ());
+    g_free (report_name);
+
+    g_string_free (printable, TRUE);
+    qmi_message_unref (sample);
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    bench_init (100, 100000);
+
+    g_test_add_func ("/libqmi-glib/bench/message/new-from-raw", bench_message_new_from_raw);
+    g_test_add_func ("/libqmi-glib/bench/tlv/write-integers",   bench_tlv_write);
+    g_test_add_func ("/libqmi-glib/bench/tlv/read-integers",    bench_tlv_read);
+    g_test_add_func ("/libqmi-glib/bench/tlv/read-strings",     bench_tlv_read_string);
+
+    g_test_add_data_func ("/libqmi-glib/bench/printable/nas-get-signal-info",       "nas-get-signal-info",       bench_printable);
+    g_test_add_data_func ("/libqmi-glib/bench/printable/wds-get-packet-statistics", "wds-get-packet-statistics", bench_printable);
+    g_test_add_data_func ("/libqmi-glib/bench/printable/dms-list-stored-images",    "dms-list-stored-images",    bench_printable);
+
+    return g_test_run ();
+}
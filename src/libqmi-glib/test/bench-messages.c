@@ -0,0 +1,194 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+/*
+ * Per-message benchmarks of every message known by qmi-codegen, using the
+ * sample messages generated with 'qmi-codegen --bench'. For each message, one
+ * iteration builds and serializes the request, reads the maximal-size response
+ * (or indication) from its raw buffer, parses it with the generated parser
+ * and builds its printable representation, as done for each message exchanged
+ * by a QmiClient with verbose logging enabled. Both the time and the number
+ * of allocations per iteration are reported, so that changes in the code
+ * generator can be evaluated for all messages at once.
+ */
+
+#include <config.h>
+#include <libqmi-glib.h>
+
+#include "bench-common.h"
+#include "bench-messages.h"
+
+#define CLIENT_ID 1
+
+/*****************************************************************************/
+
+static void
+add_tlvs (QmiMessage   *message,
+          const guint8 *raw,
+          gsize         raw_length)
+{
+    gsize offset = 0;
+
+    while (offset < raw_length) {
+        guint8  type;
+        guint16 length;
+
+        g_assert_cmpuint (offset + 3, <=, raw_length);
+        type = raw[offset];
+        length = (guint16) (raw[offset + 1] | (raw[offset + 2] << 8));
+        g_assert_cmpuint (offset + 3 + length, <=, raw_length);
+        g_assert (qmi_message_add_raw_tlv (message, type, &raw[offset + 3], length, NULL));
+        offset += 3 + length;
+    }
+}
+
+static QmiMessage *
+build_request (const BenchMessage *bench,
+               guint16             transaction_id)
+{
+    QmiMessage *request;
+
+    request = qmi_message_new (bench->service, CLIENT_ID, transaction_id, bench->message_id);
+    add_tlvs (request, bench->input, bench->input_length);
+    return request;
+}
+
+static GByteArray *
+build_sample (const BenchMessage *bench)
+{
+    QmiMessage   *message;
+    const guint8 *raw;
+    gsize         raw_length = 0;
+    GByteArray   *sample;
+
+    if (bench->indication) {
+        message = qmi_message_new (bench->service, CLIENT_ID, 0, bench->message_id);
+        ((GByteArray *) message)->data[6] |= (bench->service == QMI_SERVICE_CTL ? QMI_CTL_FLAG_INDICATION : QMI_SERVICE_FLAG_INDICATION);
+    } else {
+        QmiMessage *request;
+
+        request = build_request (bench, 1);
+        message = qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+        qmi_message_unref (request);
+    }
+    add_tlvs (message, bench->output, bench->output_length);
+
+    raw = qmi_message_get_raw (message, &raw_length, NULL);
+    g_assert (raw);
+    sample = g_byte_array_sized_new (raw_length);
+    g_byte_array_append (sample, raw, raw_length);
+    qmi_message_unref (message);
+    return sample;
+}
+
+/*****************************************************************************/
+
+static void
+bench_message (gconstpointer data)
+{
+    const BenchMessage *bench = data;
+    QmiMessageContext  *context;
+    GByteArray         *sample;
+    GByteArray         *buffer;
+    GString            *printable;
+    GError             *error = NULL;
+    guint               n_allocations;
+    gdouble             elapsed;
+    gchar              *report_name;
+    guint               i;
+
+    context = qmi_message_context_new ();
+    if (bench->vendor_id)
+        qmi_message_context_set_vendor_id (context, bench->vendor_id);
+
+    /* The sample must be fully parseable, or only part of it would be timed */
+    sample = build_sample (bench);
+    buffer = g_byte_array_sized_new (sample->len);
+    g_byte_array_append (buffer, sample->data, sample->len);
+    {
+        QmiMessage *message;
+
+        message = qmi_message_new_from_raw (buffer, &error);
+        g_assert_no_error (error);
+        g_assert (message);
+        qmi_message_validate (message, context, &error);
+        g_assert_no_error (error);
+        qmi_message_unref (message);
+    }
+
+    printable = g_string_sized_new (4096);
+
+    n_allocations = bench_get_allocations ();
+    g_test_timer_start ();
+    for (i = 0; i < bench_iterations (); i++) {
+        QmiMessage   *request;
+        QmiMessage   *message;
+        const guint8 *raw;
+        gsize         raw_length = 0;
+
+        request = build_request (bench, (guint16) ((i % G_MAXUINT8) + 1));
+        raw = qmi_message_get_raw (request, &raw_length, NULL);
+        g_assert (raw && raw_length);
+
+        g_byte_array_append (buffer, sample->data, sample->len);
+        message = qmi_message_new_from_raw (buffer, NULL);
+        g_assert (message);
+        g_assert (qmi_message_validate (message, context, NULL));
+
+        g_string_truncate (printable, 0);
+        qmi_message_append_printable (message, context, "", printable);
+
+        qmi_message_unref (message);
+        qmi_message_unref (request);
+    }
+    elapsed = g_test_timer_elapsed ();
+    n_allocations = bench_get_allocations () - n_allocations;
+
+    report_name = g_strdup_printf ("messages/%s", bench->name);
+    bench_report (report_name, elapsed);
+    g_free (report_name);
+
+    if (bench_allocations_counted ()) {
+        report_name = g_strdup_printf ("messages/%s/allocations", bench->name);
+        bench_report_value (report_name, (gdouble) n_allocations / bench_iterations (), "allocations/iteration", FALSE);
+        g_free (report_name);
+    }
+
+    g_string_free (printable, TRUE);
+    g_byte_array_unref (buffer);
+    g_byte_array_unref (sample);
+    qmi_message_context_unref (context);
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    guint i;
+
+    g_test_init (&argc, &argv, NULL);
+
+    bench_init (10, 10000);
+
+    for (i = 0; bench_messages[i].name; i++) {
+        gchar *path;
+
+        path = g_strdup_printf ("/libqmi-glib/bench/messages/%s", bench_messages[i].name);
+        g_test_add_data_func (path, &bench_messages[i], bench_message);
+        g_free (path);
+    }
+
+    return g_test_run ();
+}
@@ -0,0 +1,40 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef BENCH_MESSAGES_H
+#define BENCH_MESSAGES_H
+
+#include <glib.h>
+#include <libqmi-glib.h>
+
+/* Sample message of the table generated by 'qmi-codegen --bench', with
+ * all the TLVs known for the message given as raw TLVs (type, 16-bit little
+ * endian length and value), except for the result TLV */
+typedef struct {
+    const gchar  *name;
+    QmiService    service;
+    guint16       message_id;
+    guint16       vendor_id;
+    gboolean      indication;
+    const guint8 *input;
+    gsize         input_length;
+    const guint8 *output;
+    gsize         output_length;
+} BenchMessage;
+
+/* Terminated with an item with a NULL name */
+extern const BenchMessage bench_messages[];
+
+#endif /* BENCH_MESSAGES_H */
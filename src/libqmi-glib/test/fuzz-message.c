@@ -0,0 +1,375 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+/*
+ * Fuzzing entry point for the message parsing: each input is split into
+ * messages with qmi_message_new_from_raw(), and each message is then given to
+ * qmi_message_get_printable_full() and to qmi_message_validate(), which runs
+ * the generated response or indication parser of the message.
+ *
+ * When built with -DFUZZ_LIBFUZZER, only LLVMFuzzerTestOneInput() is built, to
+ * be linked with libFuzzer. Otherwise a main() is included, which runs the
+ * inputs in the given files or directories once, as AFL expects, or in a loop
+ * reporting the messages parsed per second (--benchmark), and which can also
+ * write a seed corpus (--write-corpus).
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <libqmi-glib.h>
+
+static void
+ignore_log (const gchar    *log_domain,
+            GLogLevelFlags  log_level,
+            const gchar    *message,
+            gpointer        user_data)
+{
+}
+
+/* Returns the number of messages processed */
+static guint
+fuzz_one (const guint8 *data,
+          gsize         size)
+{
+    GByteArray *buffer;
+    guint       n_messages = 0;
+
+    buffer = g_byte_array_sized_new (size);
+    g_byte_array_append (buffer, data, size);
+
+    while (buffer->len > 0) {
+        QmiMessage *message;
+        gchar      *printable;
+        guint       len;
+
+        len = buffer->len;
+        message = qmi_message_new_from_raw (buffer, NULL);
+        if (!message) {
+            /* Skip invalid complete messages, stop on incomplete ones */
+            if (buffer->len == len)
+                break;
+            continue;
+        }
+
+        printable = qmi_message_get_printable_full (message, NULL, "");
+        g_free (printable);
+        qmi_message_validate (message, NULL, NULL);
+        qmi_message_unref (message);
+        n_messages++;
+    }
+
+    g_byte_array_unref (buffer);
+    return n_messages;
+}
+
+int LLVMFuzzerTestOneInput (const uint8_t *data, size_t size);
+
+int
+LLVMFuzzerTestOneInput (const uint8_t *data,
+                        size_t         size)
+{
+    static gboolean initialized;
+
+    /* Warnings about unread TLV contents are expected */
+    if (!initialized) {
+        g_log_set_handler ("Qmi", G_LOG_LEVEL_WARNING | G_LOG_LEVEL_MESSAGE | G_LOG_LEVEL_INFO | G_LOG_LEVEL_DEBUG, ignore_log, NULL);
+        initialized = TRUE;
+    }
+
+    fuzz_one (data, size);
+    return 0;
+}
+
+#if !defined (FUZZ_LIBFUZZER)
+
+#include "bench-common.h"
+
+static gchar    *write_corpus_dir;
+static gboolean  benchmark_flag;
+static gint      iterations = 100;
+static gboolean  quiet_flag;
+
+static GOptionEntry main_entries[] = {
+    { "write-corpus", 'w', 0, G_OPTION_ARG_FILENAME, &write_corpus_dir,
+      "Write a seed corpus in the given directory",
+      "[PATH]"
+    },
+    { "benchmark", 'b', 0, G_OPTION_ARG_NONE, &benchmark_flag,
+      "Replay the inputs in a loop and report the messages parsed per second",
+      NULL
+    },
+    { "iterations", 'n', 0, G_OPTION_ARG_INT, &iterations,
+      "Number of times the inputs are replayed in benchmark mode (default 100)",
+      "[N]"
+    },
+    { "quiet", 'q', 0, G_OPTION_ARG_NONE, &quiet_flag,
+      "Only print the benchmark results",
+      NULL
+    },
+    { NULL }
+};
+
+/*****************************************************************************/
+/* Seed corpus */
+
+static void
+write_seed (const gchar  *name,
+            const guint8 *data,
+            gsize         size)
+{
+    gchar  *path;
+    GError *error = NULL;
+
+    path = g_build_filename (write_corpus_dir, name, NULL);
+    if (!g_file_set_contents (path, (const gchar *) data, size, &error)) {
+        g_printerr ("error: couldn't write seed: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+    g_free (path);
+}
+
+static void
+write_message_seed (const gchar *kind,
+                    QmiMessage  *message)
+{
+    const guint8 *raw;
+    gsize         raw_length = 0;
+    gchar        *name;
+
+    raw = qmi_message_get_raw (message, &raw_length, NULL);
+    g_assert (raw);
+    name = g_strdup_printf ("%s-0x%02x-0x%04x",
+                            kind,
+                            qmi_message_get_service (message),
+                            qmi_message_get_message_id (message));
+    write_seed (name, raw, raw_length);
+    g_free (name);
+}
+
+static gboolean
+is_known (QmiMessage *message)
+{
+    GError   *error = NULL;
+    gboolean  known;
+
+    /* Anything but unknown messages, parsing may fail without TLVs */
+    if (qmi_message_validate (message, NULL, &error))
+        return TRUE;
+    known = !g_error_matches (error, QMI_CORE_ERROR, QMI_CORE_ERROR_UNSUPPORTED);
+    g_error_free (error);
+    return known;
+}
+
+static guint
+write_corpus (void)
+{
+    static const struct {
+        QmiService service;
+        guint16    message_id;
+    } samples[] = {
+        { QMI_SERVICE_NAS, 0x004F },
+        { QMI_SERVICE_WDS, 0x0024 },
+        { QMI_SERVICE_DMS, 0x0049 },
+    };
+    guint service;
+    guint message_id;
+    guint i;
+    guint n_seeds = 0;
+
+    if (g_mkdir_with_parents (write_corpus_dir, 0755) < 0) {
+        g_printerr ("error: couldn't create corpus directory: %s\n", g_strerror (errno));
+        exit (EXIT_FAILURE);
+    }
+
+    /* Full responses, as given by real devices */
+    for (i = 0; i < G_N_ELEMENTS (samples); i++) {
+        QmiMessage *request;
+        QmiMessage *response;
+
+        request = bench_build_request (samples[i].service, 1, samples[i].message_id);
+        response = bench_build_response (request);
+        write_message_seed ("full", response);
+        qmi_message_unref (response);
+        qmi_message_unref (request);
+        n_seeds++;
+    }
+
+    /* A minimal response of each known message, and a minimal indication of
+     * each known indication, so that every generated parser is reached */
+    for (service = QMI_SERVICE_CTL; service <= QMI_SERVICE_PDC; service++) {
+        for (message_id = 0; message_id <= G_MAXUINT16; message_id++) {
+            QmiMessage   *request;
+            QmiMessage   *indication;
+            const guint8 *raw;
+            gsize         raw_length = 0;
+            GByteArray   *buffer;
+
+            request = qmi_message_new ((QmiService) service, service == QMI_SERVICE_CTL ? 0 : 1, 1, (guint16) message_id);
+            if (is_known (request)) {
+                QmiMessage *response;
+
+                response = qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+                write_message_seed ("response", response);
+                qmi_message_unref (response);
+                n_seeds++;
+            }
+
+            /* Indications have the indication flag in the service header, and
+             * no transaction ID */
+            raw = qmi_message_get_raw (request, &raw_length, NULL);
+            g_assert (raw && raw_length > 7);
+            buffer = g_byte_array_sized_new (raw_length);
+            g_byte_array_append (buffer, raw, raw_length);
+            buffer->data[6] = (service == QMI_SERVICE_CTL ? QMI_CTL_FLAG_INDICATION : QMI_SERVICE_FLAG_INDICATION);
+            memset (&buffer->data[7], 0, service == QMI_SERVICE_CTL ? 1 : 2);
+            indication = qmi_message_new_from_raw (buffer, NULL);
+            g_assert (indication);
+            if (is_known (indication)) {
+                write_message_seed ("indication", indication);
+                n_seeds++;
+            }
+            qmi_message_unref (indication);
+            g_byte_array_unref (buffer);
+
+            qmi_message_unref (request);
+        }
+    }
+
+    return n_seeds;
+}
+
+/*****************************************************************************/
+/* Corpus replay */
+
+static void
+load_input (GPtrArray   *inputs,
+            const gchar *path)
+{
+    GError *error = NULL;
+    gchar  *contents;
+    gsize   length;
+
+    if (g_file_test (path, G_FILE_TEST_IS_DIR)) {
+        GDir        *dir;
+        const gchar *name;
+
+        dir = g_dir_open (path, 0, &error);
+        if (!dir) {
+            g_printerr ("error: couldn't open corpus directory: %s\n", error->message);
+            exit (EXIT_FAILURE);
+        }
+        while ((name = g_dir_read_name (dir)) != NULL) {
+            gchar *child;
+
+            child = g_build_filename (path, name, NULL);
+            load_input (inputs, child);
+            g_free (child);
+        }
+        g_dir_close (dir);
+        return;
+    }
+
+    if (!g_file_get_contents (path, &contents, &length, &error)) {
+        g_printerr ("error: couldn't read input: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+    g_ptr_array_add (inputs, g_bytes_new_take (contents, length));
+}
+
+static guint
+replay (GPtrArray *inputs)
+{
+    guint n_messages = 0;
+    guint i;
+
+    for (i = 0; i < inputs->len; i++) {
+        gconstpointer data;
+        gsize         size;
+
+        data = g_bytes_get_data (g_ptr_array_index (inputs, i), &size);
+        n_messages += fuzz_one (data, size);
+    }
+    return n_messages;
+}
+
+int main (int argc, char **argv)
+{
+    GOptionContext *context;
+    GError         *error = NULL;
+    GPtrArray      *inputs;
+    GTimer         *timer;
+    guint           n_messages = 0;
+    gint            i;
+
+    context = g_option_context_new ("[FILE|DIRECTORY...] - Replay fuzzing inputs of QMI messages");
+    g_option_context_add_main_entries (context, main_entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("error: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+    g_option_context_free (context);
+
+    g_log_set_handler ("Qmi", G_LOG_LEVEL_WARNING | G_LOG_LEVEL_MESSAGE | G_LOG_LEVEL_INFO | G_LOG_LEVEL_DEBUG, ignore_log, NULL);
+
+    if (write_corpus_dir) {
+        guint n_seeds;
+
+        n_seeds = write_corpus ();
+        if (!quiet_flag)
+            g_print ("%u seeds written to %s\n", n_seeds, write_corpus_dir);
+        g_free (write_corpus_dir);
+        return EXIT_SUCCESS;
+    }
+
+    if (argc < 2) {
+        g_printerr ("error: no inputs given\n");
+        exit (EXIT_FAILURE);
+    }
+
+    inputs = g_ptr_array_new_with_free_func ((GDestroyNotify) g_bytes_unref);
+    for (i = 1; i < argc; i++)
+        load_input (inputs, argv[i]);
+
+    if (!benchmark_flag) {
+        n_messages = replay (inputs);
+        if (!quiet_flag)
+            g_print ("%u inputs replayed, %u messages parsed\n", inputs->len, n_messages);
+        g_ptr_array_unref (inputs);
+        return EXIT_SUCCESS;
+    }
+
+    if (iterations <= 0) {
+        g_printerr ("error: invalid number of iterations\n");
+        exit (EXIT_FAILURE);
+    }
+
+    /* Same line format as the other benchmarks */
+    timer = g_timer_new ();
+    for (i = 0; i < iterations; i++)
+        n_messages += replay (inputs);
+    g_timer_stop (timer);
+    g_print ("fuzz/corpus-replay\t%d\t%.1f\tmessages/s\n",
+             iterations, n_messages / g_timer_elapsed (timer, NULL));
+    g_timer_destroy (timer);
+
+    g_ptr_array_unref (inputs);
+    return EXIT_SUCCESS;
+}
+
+#endif /* !FUZZ_LIBFUZZER */
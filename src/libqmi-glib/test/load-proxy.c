@@ -0,0 +1,857 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+/*
+ * Sustained load on a qmi-proxy process from many simulated clients.
+ *
+ * A simulated modem is exposed through a pseudo terminal, and a qmi-proxy
+ * process is spawned for it. Each simulated client is a QmiDevice opened
+ * through the proxy, with a NAS, a WDS and a DMS client, which keeps on
+ * sending requests chosen randomly from the configured mix, one at a time.
+ * The simulated modem also emits broadcast WDS Event Report indications at
+ * the configured rate, which the proxy delivers to every WDS client.
+ *
+ * At the end, the CPU time and memory of the proxy process, read from /proc,
+ * are reported along with the request latency distribution of all clients
+ * and of each one.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+#include <libqmi-glib.h>
+
+#include "test-port-context.h"
+#include "bench-common.h"
+
+#define MAX_CLIENTS 250
+
+typedef enum {
+    REQUEST_TYPE_NAS_GET_SIGNAL_INFO,
+    REQUEST_TYPE_WDS_GET_PACKET_STATISTICS,
+    REQUEST_TYPE_DMS_LIST_STORED_IMAGES,
+    N_REQUEST_TYPES
+} RequestType;
+
+static const struct {
+    const gchar *name;
+    QmiService   service;
+    guint16      message_id;
+} request_types[N_REQUEST_TYPES] = {
+    [REQUEST_TYPE_NAS_GET_SIGNAL_INFO]       = { "nas-get-signal-info",       QMI_SERVICE_NAS, 0x004F },
+    [REQUEST_TYPE_WDS_GET_PACKET_STATISTICS] = { "wds-get-packet-statistics", QMI_SERVICE_WDS, 0x0024 },
+    [REQUEST_TYPE_DMS_LIST_STORED_IMAGES]    = { "dms-list-stored-images",    QMI_SERVICE_DMS, 0x0049 },
+};
+
+typedef struct _LoadContext LoadContext;
+
+typedef struct {
+    LoadContext *load;
+    QmiDevice   *device;
+    QmiClient   *clients[N_REQUEST_TYPES];
+    GArray      *latencies;
+    gint64       request_start;
+    gboolean     ongoing;
+    guint        n_failed;
+    guint        n_indications;
+} LoadClient;
+
+typedef struct {
+    guint64 cpu_time; /* microseconds */
+    gsize   resident;
+} ProcessStats;
+
+struct _LoadContext {
+    GMainLoop       *loop;
+    TestPortContext *port;
+    GPid             proxy_pid;
+    gboolean         proxy_exited;
+    GPtrArray       *clients;
+    GRand           *rand;
+    guint            weights[N_REQUEST_TYPES];
+    guint            total_weight;
+    QmiMessageWdsGetPacketStatisticsInput *wds_input;
+
+    /* Only used in the simulated modem thread */
+    guint8           next_cid[G_MAXUINT8 + 1];
+
+    /* Shared with the simulated modem thread */
+    volatile gint    stopping;
+    volatile gint    n_indications_emitted;
+
+    gboolean         stopped;
+    guint            n_ongoing;
+    gsize            peak_resident;
+};
+
+static gint     n_clients = 10;
+static gint     duration = 10;
+static gchar   *mix_str;
+static gint     interval;
+static gint     indication_rate = 10;
+static gchar   *proxy_str;
+static gchar   *proxy_args_str;
+static gboolean quiet_flag;
+
+static GOptionEntry main_entries[] = {
+    { "clients", 'c', 0, G_OPTION_ARG_INT, &n_clients,
+      "Number of simulated clients (default 10)",
+      "[N]"
+    },
+    { "duration", 'd', 0, G_OPTION_ARG_INT, &duration,
+      "Duration of the load, in seconds (default 10)",
+      "[SECS]"
+    },
+    { "mix", 'm', 0, G_OPTION_ARG_STRING, &mix_str,
+      "Weights of each request type, e.g. \"nas-get-signal-info=3,dms-list-stored-images=1\" (default all the same)",
+      "[NAME=WEIGHT,...]"
+    },
+    { "interval", 'i', 0, G_OPTION_ARG_INT, &interval,
+      "Time each client waits between a response and its next request, in milliseconds (default 0)",
+      "[MS]"
+    },
+    { "indication-rate", 'r', 0, G_OPTION_ARG_INT, &indication_rate,
+      "Broadcast indications emitted per second (default 10)",
+      "[N]"
+    },
+    { "proxy", 'p', 0, G_OPTION_ARG_FILENAME, &proxy_str,
+      "Path of the qmi-proxy program (default the one in the build tree)",
+      "[PATH]"
+    },
+    { "proxy-args", 'a', 0, G_OPTION_ARG_STRING, &proxy_args_str,
+      "Additional arguments for qmi-proxy, e.g. \"--sharded --coalesce-requests\"",
+      "[ARGS]"
+    },
+    { "quiet", 'q', 0, G_OPTION_ARG_NONE, &quiet_flag,
+      "Only print tab-separated lines with the results, as the benchmarks",
+      NULL
+    },
+    { NULL }
+};
+
+/*****************************************************************************/
+/* Proxy process statistics, Linux only */
+
+static gboolean
+get_process_stats (GPid          pid,
+                   ProcessStats *stats)
+{
+    gchar   *path;
+    gchar   *contents = NULL;
+    gchar   *fields_start;
+    gchar  **fields;
+    gboolean success = FALSE;
+
+    memset (stats, 0, sizeof (ProcessStats));
+
+    path = g_strdup_printf ("/proc/%d/stat", (gint) pid);
+    if (!g_file_get_contents (path, &contents, NULL, NULL))
+        goto out;
+
+    /* The program name may have spaces, so skip it; utime and stime are then
+     * the 12th and 13th fields, in clock ticks */
+    fields_start = strrchr (contents, ')');
+    if (!fields_start)
+        goto out;
+    fields = g_strsplit (fields_start + 2, " ", -1);
+    if (g_strv_length (fields) > 12) {
+        guint64 ticks;
+
+        ticks = g_ascii_strtoull (fields[11], NULL, 10) + g_ascii_strtoull (fields[12], NULL, 10);
+        stats->cpu_time = (ticks * G_USEC_PER_SEC) / sysconf (_SC_CLK_TCK);
+        success = TRUE;
+    }
+    g_strfreev (fields);
+    g_free (contents);
+    contents = NULL;
+    g_free (path);
+
+    /* Second field in pages */
+    path = g_strdup_printf ("/proc/%d/statm", (gint) pid);
+    if (success && g_file_get_contents (path, &contents, NULL, NULL)) {
+        fields = g_strsplit (contents, " ", -1);
+        if (g_strv_length (fields) > 1)
+            stats->resident = (gsize) g_ascii_strtoull (fields[1], NULL, 10) * sysconf (_SC_PAGESIZE);
+        g_strfreev (fields);
+    }
+
+out:
+    g_free (contents);
+    g_free (path);
+    return success;
+}
+
+/*****************************************************************************/
+/* Simulated modem */
+
+static GByteArray *
+modem_respond (TestPortContext *port,
+               GByteArray      *request_raw,
+               LoadContext     *load)
+{
+    QmiMessage *request = (QmiMessage *) request_raw;
+    QmiMessage *response;
+    gsize       init_offset;
+    gsize       offset = 0;
+    guint8      service;
+    guint8      cid;
+    guint       i;
+
+    for (i = 0; i < N_REQUEST_TYPES; i++) {
+        if (qmi_message_get_service (request) == request_types[i].service &&
+            qmi_message_get_message_id (request) == request_types[i].message_id)
+            return bench_build_response (request);
+    }
+
+    response = qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+    if (qmi_message_get_service (request) != QMI_SERVICE_CTL)
+        return response;
+
+    switch (qmi_message_get_message_id (request)) {
+    case 0x0022: /* Allocate CID */
+        init_offset = qmi_message_tlv_read_init (request, 0x01, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint8 (request, init_offset, &offset, &service, NULL));
+        cid = ++load->next_cid[service];
+        break;
+    case 0x0023: /* Release CID */
+        init_offset = qmi_message_tlv_read_init (request, 0x01, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint8 (request, init_offset, &offset, &service, NULL));
+        g_assert (qmi_message_tlv_read_guint8 (request, init_offset, &offset, &cid, NULL));
+        break;
+    default:
+        return response;
+    }
+
+    init_offset = qmi_message_tlv_write_init (response, 0x01, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_guint8 (response, service, NULL));
+    g_assert (qmi_message_tlv_write_guint8 (response, cid, NULL));
+    g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+    return response;
+}
+
+static gboolean
+modem_emit_indication (LoadContext *load)
+{
+    QmiMessage *indication;
+
+    if (g_atomic_int_get (&load->stopping))
+        return G_SOURCE_REMOVE;
+
+    /* WDS Event Report, broadcast. There is no indication constructor, so
+     * just set the flag in the QMI service header of a new request */
+    indication = qmi_message_new (QMI_SERVICE_WDS, QMI_CID_BROADCAST, 0, 0x0001);
+    ((GByteArray *) indication)->data[6] |= 0x04;
+    test_port_context_write (load->port, indication->data, indication->len);
+    qmi_message_unref (indication);
+    g_atomic_int_inc (&load->n_indications_emitted);
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+modem_start_indications (LoadContext *load)
+{
+    GSource *source;
+
+    /* Runs in the simulated modem thread */
+    source = g_timeout_source_new (1000 / indication_rate);
+    g_source_set_callback (source, (GSourceFunc) modem_emit_indication, load, NULL);
+    g_source_attach (source, g_main_context_get_thread_default ());
+    g_source_unref (source);
+    return G_SOURCE_REMOVE;
+}
+
+/*****************************************************************************/
+/* Proxy process */
+
+static void
+proxy_exited_cb (GPid         pid,
+                 gint         status,
+                 LoadContext *load)
+{
+    load->proxy_exited = TRUE;
+    g_spawn_close_pid (pid);
+    if (load->loop && g_main_loop_is_running (load->loop))
+        g_main_loop_quit (load->loop);
+}
+
+static gboolean
+proxy_spawn (LoadContext  *load,
+             GError      **error)
+{
+    GPtrArray      *argv;
+    gchar         **extra_argv = NULL;
+    GSocketAddress *address;
+    GSocketClient  *socket_client;
+    gboolean        success;
+    guint           i;
+
+    argv = g_ptr_array_new ();
+    g_ptr_array_add (argv, proxy_str ? proxy_str : QMI_PROXY_BUILD_PATH);
+    g_ptr_array_add (argv, "--no-exit");
+    if (proxy_args_str && !g_shell_parse_argv (proxy_args_str, NULL, &extra_argv, error)) {
+        g_ptr_array_unref (argv);
+        return FALSE;
+    }
+    for (i = 0; extra_argv && extra_argv[i]; i++)
+        g_ptr_array_add (argv, extra_argv[i]);
+    g_ptr_array_add (argv, NULL);
+
+    success = g_spawn_async (NULL, (gchar **) argv->pdata, NULL, G_SPAWN_DO_NOT_REAP_CHILD,
+                             NULL, NULL, &load->proxy_pid, error);
+    g_ptr_array_unref (argv);
+    g_strfreev (extra_argv);
+    if (!success)
+        return FALSE;
+    g_child_watch_add (load->proxy_pid, (GChildWatchFunc) proxy_exited_cb, load);
+
+    /* Wait for the proxy to be listening */
+    address = g_unix_socket_address_new_with_type (QMI_PROXY_SOCKET_PATH, -1, G_UNIX_SOCKET_ADDRESS_ABSTRACT);
+    socket_client = g_socket_client_new ();
+    for (i = 0; i < 50 && !load->proxy_exited; i++) {
+        GSocketConnection *connection;
+
+        connection = g_socket_client_connect (socket_client, G_SOCKET_CONNECTABLE (address), NULL, NULL);
+        if (connection) {
+            g_object_unref (connection);
+            break;
+        }
+        g_usleep (100000);
+        g_main_context_iteration (NULL, FALSE);
+    }
+    g_object_unref (socket_client);
+    g_object_unref (address);
+
+    if (load->proxy_exited || i == 50) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
+                     "qmi-proxy not available (is another one running?)");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*****************************************************************************/
+/* Simulated clients */
+
+static void send_request (LoadClient *client);
+
+static gboolean
+send_request_cb (LoadClient *client)
+{
+    send_request (client);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+request_done (LoadClient *client,
+              gboolean    success)
+{
+    LoadContext *load = client->load;
+    gint64       latency;
+
+    latency = g_get_monotonic_time () - client->request_start;
+    if (success)
+        g_array_append_val (client->latencies, latency);
+    else
+        client->n_failed++;
+
+    client->ongoing = FALSE;
+    load->n_ongoing--;
+
+    if (load->stopped) {
+        if (!load->n_ongoing)
+            g_main_loop_quit (load->loop);
+        return;
+    }
+
+    if (interval > 0)
+        g_timeout_add (interval, (GSourceFunc) send_request_cb, client);
+    else
+        send_request (client);
+}
+
+static void
+nas_get_signal_info_ready (QmiClientNas *nas,
+                           GAsyncResult *res,
+                           LoadClient   *client)
+{
+    QmiMessageNasGetSignalInfoOutput *output;
+
+    output = qmi_client_nas_get_signal_info_finish (nas, res, NULL);
+    if (output)
+        qmi_message_nas_get_signal_info_output_unref (output);
+    request_done (client, !!output);
+}
+
+static void
+wds_get_packet_statistics_ready (QmiClientWds *wds,
+                                 GAsyncResult *res,
+                                 LoadClient   *client)
+{
+    QmiMessageWdsGetPacketStatisticsOutput *output;
+
+    output = qmi_client_wds_get_packet_statistics_finish (wds, res, NULL);
+    if (output)
+        qmi_message_wds_get_packet_statistics_output_unref (output);
+    request_done (client, !!output);
+}
+
+static void
+dms_list_stored_images_ready (QmiClientDms *dms,
+                              GAsyncResult *res,
+                              LoadClient   *client)
+{
+    QmiMessageDmsListStoredImagesOutput *output;
+
+    output = qmi_client_dms_list_stored_images_finish (dms, res, NULL);
+    if (output)
+        qmi_message_dms_list_stored_images_output_unref (output);
+    request_done (client, !!output);
+}
+
+static void
+send_request (LoadClient *client)
+{
+    LoadContext *load = client->load;
+    guint        value;
+    guint        i;
+
+    if (load->stopped)
+        return;
+
+    value = g_rand_int_range (load->rand, 0, load->total_weight);
+    for (i = 0; value >= load->weights[i]; i++)
+        value -= load->weights[i];
+
+    client->ongoing = TRUE;
+    client->request_start = g_get_monotonic_time ();
+    load->n_ongoing++;
+
+    switch (i) {
+    case REQUEST_TYPE_NAS_GET_SIGNAL_INFO:
+        qmi_client_nas_get_signal_info (QMI_CLIENT_NAS (client->clients[i]), NULL, 10, NULL,
+                                        (GAsyncReadyCallback) nas_get_signal_info_ready,
+                                        client);
+        break;
+    case REQUEST_TYPE_WDS_GET_PACKET_STATISTICS:
+        qmi_client_wds_get_packet_statistics (QMI_CLIENT_WDS (client->clients[i]), load->wds_input, 10, NULL,
+                                              (GAsyncReadyCallback) wds_get_packet_statistics_ready,
+                                              client);
+        break;
+    case REQUEST_TYPE_DMS_LIST_STORED_IMAGES:
+        qmi_client_dms_list_stored_images (QMI_CLIENT_DMS (client->clients[i]), NULL, 10, NULL,
+                                           (GAsyncReadyCallback) dms_list_stored_images_ready,
+                                           client);
+        break;
+    default:
+        g_assert_not_reached ();
+    }
+}
+
+static void
+wds_event_report_cb (QmiClientWds                      *wds,
+                     QmiIndicationWdsEventReportOutput *output,
+                     LoadClient                        *client)
+{
+    client->n_indications++;
+}
+
+static void
+device_new_ready (GObject      *source,
+                  GAsyncResult *res,
+                  LoadClient   *client)
+{
+    GError *error = NULL;
+
+    client->device = qmi_device_new_finish (res, &error);
+    if (!client->device) {
+        g_printerr ("error: couldn't create device: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+    g_main_loop_quit (client->load->loop);
+}
+
+static void
+device_open_ready (QmiDevice    *device,
+                   GAsyncResult *res,
+                   LoadClient   *client)
+{
+    GError *error = NULL;
+
+    if (!qmi_device_open_finish (device, res, &error)) {
+        g_printerr ("error: couldn't open device through the proxy: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+    g_main_loop_quit (client->load->loop);
+}
+
+static void
+device_allocate_client_ready (QmiDevice    *device,
+                              GAsyncResult *res,
+                              LoadClient   *client)
+{
+    GError    *error = NULL;
+    QmiClient *qmi_client;
+    guint      i;
+
+    qmi_client = qmi_device_allocate_client_finish (device, res, &error);
+    if (!qmi_client) {
+        g_printerr ("error: couldn't allocate client: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+
+    for (i = 0; i < N_REQUEST_TYPES; i++) {
+        if (request_types[i].service == qmi_client_get_service (qmi_client)) {
+            client->clients[i] = qmi_client;
+            break;
+        }
+    }
+    g_main_loop_quit (client->load->loop);
+}
+
+static LoadClient *
+load_client_new (LoadContext *load)
+{
+    LoadClient *client;
+    GFile      *file;
+    guint       i;
+
+    client = g_slice_new0 (LoadClient);
+    client->load = load;
+    client->latencies = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+    file = g_file_new_for_path (test_port_context_get_name (load->port));
+    g_async_initable_new_async (QMI_TYPE_DEVICE, G_PRIORITY_DEFAULT, NULL,
+                                (GAsyncReadyCallback) device_new_ready, client,
+                                QMI_DEVICE_FILE,          file,
+                                QMI_DEVICE_NO_FILE_CHECK, TRUE,
+                                NULL);
+    g_object_unref (file);
+    g_main_loop_run (load->loop);
+
+    qmi_device_open (client->device, QMI_DEVICE_OPEN_FLAGS_PROXY, 10, NULL,
+                     (GAsyncReadyCallback) device_open_ready,
+                     client);
+    g_main_loop_run (load->loop);
+
+    for (i = 0; i < N_REQUEST_TYPES; i++) {
+        qmi_device_allocate_client (client->device, request_types[i].service, QMI_CID_NONE, 10, NULL,
+                                    (GAsyncReadyCallback) device_allocate_client_ready,
+                                    client);
+        g_main_loop_run (load->loop);
+    }
+
+    g_signal_connect (client->clients[REQUEST_TYPE_WDS_GET_PACKET_STATISTICS],
+                      "event-report",
+                      G_CALLBACK (wds_event_report_cb),
+                      client);
+    return client;
+}
+
+static void
+device_close_ready (QmiDevice    *device,
+                    GAsyncResult *res,
+                    LoadContext  *load)
+{
+    qmi_device_close_finish (device, res, NULL);
+    g_main_loop_quit (load->loop);
+}
+
+static void
+load_client_free (LoadClient *client)
+{
+    guint i;
+
+    for (i = 0; i < N_REQUEST_TYPES; i++) {
+        g_signal_handlers_disconnect_by_data (client->clients[i], client);
+        g_object_unref (client->clients[i]);
+    }
+
+    /* Closing the device releases all its clients in the proxy */
+    qmi_device_close_async (client->device, 10, NULL,
+                            (GAsyncReadyCallback) device_close_ready,
+                            client->load);
+    g_main_loop_run (client->load->loop);
+    g_object_unref (client->device);
+
+    g_array_unref (client->latencies);
+    g_slice_free (LoadClient, client);
+}
+
+/*****************************************************************************/
+/* Reporting */
+
+static gint
+cmp_latency (const gint64 *a,
+             const gint64 *b)
+{
+    return (*a > *b) - (*a < *b);
+}
+
+/* Expects a sorted array */
+static gint64
+percentile (GArray *values,
+            guint   percent)
+{
+    if (!values->len)
+        return 0;
+    return g_array_index (values, gint64, MIN (values->len - 1, (values->len * percent) / 100));
+}
+
+static void
+report (const gchar *name,
+        gdouble      value,
+        const gchar *unit)
+{
+    if (quiet_flag)
+        g_print ("load/%u-clients/%s\t%u\t%.1f\t%s\n", n_clients, name, duration, value, unit);
+    else
+        g_print ("%-28s %.1f %s\n", name, value, unit);
+}
+
+static void
+report_distribution (const gchar *name,
+                     GArray      *values)
+{
+    gchar *aux;
+
+    g_array_sort (values, (GCompareFunc) cmp_latency);
+
+    aux = g_strdup_printf ("%s/p50", name);
+    report (aux, (gdouble) percentile (values, 50), "us");
+    g_free (aux);
+    aux = g_strdup_printf ("%s/p90", name);
+    report (aux, (gdouble) percentile (values, 90), "us");
+    g_free (aux);
+    aux = g_strdup_printf ("%s/p99", name);
+    report (aux, (gdouble) percentile (values, 99), "us");
+    g_free (aux);
+    aux = g_strdup_printf ("%s/max", name);
+    report (aux, (gdouble) (values->len ? g_array_index (values, gint64, values->len - 1) : 0), "us");
+    g_free (aux);
+}
+
+static void
+report_results (LoadContext        *load,
+                gdouble             elapsed,
+                const ProcessStats *start,
+                const ProcessStats *end)
+{
+    GArray *all;
+    GArray *client_p50;
+    GArray *client_p99;
+    guint   n_failed = 0;
+    guint   min_indications = G_MAXUINT;
+    guint   max_indications = 0;
+    guint   i;
+
+    all = g_array_new (FALSE, FALSE, sizeof (gint64));
+    client_p50 = g_array_new (FALSE, FALSE, sizeof (gint64));
+    client_p99 = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+    for (i = 0; i < load->clients->len; i++) {
+        LoadClient *client = g_ptr_array_index (load->clients, i);
+        gint64      value;
+
+        g_array_append_vals (all, client->latencies->data, client->latencies->len);
+        g_array_sort (client->latencies, (GCompareFunc) cmp_latency);
+        value = percentile (client->latencies, 50);
+        g_array_append_val (client_p50, value);
+        value = percentile (client->latencies, 99);
+        g_array_append_val (client_p99, value);
+
+        n_failed += client->n_failed;
+        min_indications = MIN (min_indications, client->n_indications);
+        max_indications = MAX (max_indications, client->n_indications);
+    }
+
+    report ("requests/throughput", elapsed > 0 ? all->len / elapsed : 0.0, "requests/s");
+    report ("requests/failed", (gdouble) n_failed, "requests");
+    report_distribution ("latency", all);
+
+    /* How fair the proxy is with its clients */
+    report_distribution ("client-latency-p50", client_p50);
+    report_distribution ("client-latency-p99", client_p99);
+
+    report ("indications/emitted", (gdouble) g_atomic_int_get (&load->n_indications_emitted), "indications");
+    report ("indications/client-min", (gdouble) min_indications, "indications");
+    report ("indications/client-max", (gdouble) max_indications, "indications");
+
+    report ("proxy/cpu", elapsed > 0 ? (100.0 * (end->cpu_time - start->cpu_time)) / (elapsed * G_USEC_PER_SEC) : 0.0, "%");
+    report ("proxy/memory-start", start->resident / 1024.0, "KiB");
+    report ("proxy/memory-peak", load->peak_resident / 1024.0, "KiB");
+    report ("proxy/memory-end", end->resident / 1024.0, "KiB");
+
+    g_array_unref (client_p99);
+    g_array_unref (client_p50);
+    g_array_unref (all);
+}
+
+/*****************************************************************************/
+
+static gboolean
+parse_mix (LoadContext  *load,
+           GError      **error)
+{
+    gchar **items;
+    guint   i;
+
+    if (!mix_str) {
+        for (i = 0; i < N_REQUEST_TYPES; i++)
+            load->weights[i] = 1;
+        load->total_weight = N_REQUEST_TYPES;
+        return TRUE;
+    }
+
+    items = g_strsplit (mix_str, ",", -1);
+    for (i = 0; items[i]; i++) {
+        gchar **pair;
+        guint   j;
+
+        pair = g_strsplit (items[i], "=", 2);
+        for (j = 0; j < N_REQUEST_TYPES; j++) {
+            if (g_str_equal (pair[0], request_types[j].name))
+                break;
+        }
+        if (j == N_REQUEST_TYPES || !pair[1]) {
+            g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS,
+                         "invalid request mix item '%s'", items[i]);
+            g_strfreev (pair);
+            g_strfreev (items);
+            return FALSE;
+        }
+        load->weights[j] = (guint) g_ascii_strtoull (pair[1], NULL, 10);
+        load->total_weight += load->weights[j];
+        g_strfreev (pair);
+    }
+    g_strfreev (items);
+
+    if (!load->total_weight) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS,
+                     "request mix without any request");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean
+sample_cb (LoadContext *load)
+{
+    ProcessStats stats;
+
+    if (get_process_stats (load->proxy_pid, &stats))
+        load->peak_resident = MAX (load->peak_resident, stats.resident);
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+stop_cb (LoadContext *load)
+{
+    load->stopped = TRUE;
+    g_atomic_int_set (&load->stopping, TRUE);
+    if (!load->n_ongoing)
+        g_main_loop_quit (load->loop);
+    return G_SOURCE_REMOVE;
+}
+
+int main (int argc, char **argv)
+{
+    GOptionContext *context;
+    GError         *error = NULL;
+    LoadContext     load;
+    ProcessStats    start_stats;
+    ProcessStats    end_stats;
+    gint64          start;
+    gdouble         elapsed;
+    guint           sample_id;
+    gint            i;
+
+    context = g_option_context_new ("- Sustained load on qmi-proxy from simulated clients");
+    g_option_context_add_main_entries (context, main_entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("error: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+    g_option_context_free (context);
+
+    /* Each client allocates one CID per service in the simulated modem */
+    if (n_clients <= 0 || n_clients > MAX_CLIENTS || duration <= 0 || interval < 0 ||
+        indication_rate < 0 || indication_rate > 1000) {
+        g_printerr ("error: invalid arguments\n");
+        exit (EXIT_FAILURE);
+    }
+
+    memset (&load, 0, sizeof (LoadContext));
+    if (!parse_mix (&load, &error)) {
+        g_printerr ("error: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+
+    load.loop = g_main_loop_new (NULL, FALSE);
+    load.rand = g_rand_new_with_seed (0);
+    load.wds_input = qmi_message_wds_get_packet_statistics_input_new ();
+    qmi_message_wds_get_packet_statistics_input_set_mask (load.wds_input, BENCH_WDS_PACKET_STATISTICS_MASK, NULL);
+
+    load.port = test_port_context_new_pty ();
+    test_port_context_set_responder (load.port, (TestPortContextResponderFn) modem_respond, &load);
+    test_port_context_start (load.port);
+
+    if (!proxy_spawn (&load, &error)) {
+        g_printerr ("error: couldn't spawn qmi-proxy: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+
+    load.clients = g_ptr_array_new_with_free_func ((GDestroyNotify) load_client_free);
+    for (i = 0; i < n_clients; i++)
+        g_ptr_array_add (load.clients, load_client_new (&load));
+
+    /* Sustained load */
+    get_process_stats (load.proxy_pid, &start_stats);
+    load.peak_resident = start_stats.resident;
+    start = g_get_monotonic_time ();
+    if (indication_rate > 0)
+        test_port_context_invoke (load.port, (GSourceFunc) modem_start_indications, &load);
+    for (i = 0; i < n_clients; i++)
+        send_request (g_ptr_array_index (load.clients, i));
+    sample_id = g_timeout_add (100, (GSourceFunc) sample_cb, &load);
+    g_timeout_add_seconds (duration, (GSourceFunc) stop_cb, &load);
+    g_main_loop_run (load.loop);
+    elapsed = (gdouble) (g_get_monotonic_time () - start) / G_USEC_PER_SEC;
+    get_process_stats (load.proxy_pid, &end_stats);
+    g_source_remove (sample_id);
+
+    if (load.proxy_exited) {
+        g_printerr ("error: qmi-proxy exited during the load\n");
+        exit (EXIT_FAILURE);
+    }
+
+    report_results (&load, elapsed, &start_stats, &end_stats);
+
+    g_ptr_array_unref (load.clients);
+    kill (load.proxy_pid, SIGTERM);
+    test_port_context_stop (load.port);
+    test_port_context_free (load.port);
+    qmi_message_wds_get_packet_statistics_input_unref (load.wds_input);
+    g_rand_free (load.rand);
+    g_main_loop_unref (load.loop);
+
+    return EXIT_SUCCESS;
+}
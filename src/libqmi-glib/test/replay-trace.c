@@ -0,0 +1,603 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+/*
+ * Replays a binary trace of a QMI session, as recorded with
+ * 'qmicli --trace-record' or 'qmi-proxy --trace-record', against a simulated
+ * modem, so that the client side processing of real world traffic can be
+ * measured without the modem.
+ *
+ * The requests sent in the trace are sent again with a QmiDevice, and the
+ * simulated modem answers each one with the response recorded for it, after
+ * the recorded latency. The received indications are written by the simulated
+ * modem at the same point of the session. Responses and indications are
+ * parsed with qmi_message_validate(), as a client would do.
+ *
+ * By default the session is replayed at its original speed; with --max-speed
+ * all the delays are skipped, and requests are only held back while another
+ * one with the same transaction is ongoing.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <libqmi-glib.h>
+
+#include "test-port-context.h"
+
+#define REQUEST_TIMEOUT_SECS 10
+
+/* How long to wait for indications still not received once all requests are
+ * done */
+#define INDICATIONS_GRACE_PERIOD_MS 1000
+
+typedef struct _Replay Replay;
+
+typedef struct {
+    Replay     *replay;
+    gint64      offset;  /* since the first record */
+    gint64      latency; /* responses only */
+    gboolean    sent;
+    QmiMessage *message;
+} ReplayRecord;
+
+struct _Replay {
+    GMainLoop       *loop;
+    TestPortContext *port;
+    QmiDevice       *device;
+
+    /* Requests sent and indications received, in order */
+    GPtrArray       *records;
+    guint            n_requests;
+    guint            n_indications;
+    gint64           recorded_duration;
+
+    /* Recorded responses, as queues indexed by transaction; only used in the
+     * simulated modem thread once started */
+    GHashTable      *responses;
+    volatile gint    started;
+    volatile gint    n_unmatched;
+
+    /* Progress, only used in the main thread */
+    gint64           start;
+    guint            next_record;
+    guint            timeout_id;
+    GHashTable      *ongoing;
+    guint            n_completed;
+    guint            n_failed;
+    guint            n_received;
+};
+
+static gchar    *path_str;
+static gboolean  max_speed_flag;
+static gboolean  quiet_flag;
+static gboolean  verbose_flag;
+
+static GOptionEntry main_entries[] = {
+    { "path", 'p', 0, G_OPTION_ARG_STRING, &path_str,
+      "Replay only the traffic of the given device path (default: the first one in the trace)",
+      "[PATH]"
+    },
+    { "max-speed", 'm', 0, G_OPTION_ARG_NONE, &max_speed_flag,
+      "Replay as fast as possible, instead of at the original speed",
+      NULL
+    },
+    { "quiet", 'q', 0, G_OPTION_ARG_NONE, &quiet_flag,
+      "Only print a tab-separated line with the results, as the benchmarks",
+      NULL
+    },
+    { "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose_flag,
+      "Print the requests that failed",
+      NULL
+    },
+    { NULL }
+};
+
+static gpointer
+build_transaction_key (QmiMessage *message)
+{
+    return GUINT_TO_POINTER ((((guint) qmi_message_get_service (message) << 8 |
+                               qmi_message_get_client_id (message)) << 16) |
+                             qmi_message_get_transaction_id (message));
+}
+
+static gint64
+get_thread_cpu_time (void)
+{
+    struct timespec ts;
+
+    if (clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts) < 0)
+        return 0;
+    return ((gint64) ts.tv_sec * G_USEC_PER_SEC) + (ts.tv_nsec / 1000);
+}
+
+/*****************************************************************************/
+/* Trace loading */
+
+typedef struct {
+    Replay *replay;
+    gint64  first_timestamp;
+    guint   n_skipped;
+} LoadContext;
+
+static void
+replay_record_free (ReplayRecord *record)
+{
+    qmi_message_unref (record->message);
+    g_slice_free (ReplayRecord, record);
+}
+
+static void
+load_record (const QmiTraceRecord *record,
+             LoadContext          *ctx)
+{
+    Replay       *replay = ctx->replay;
+    ReplayRecord *replay_record;
+    GByteArray   *buffer;
+    QmiMessage   *message;
+
+    if (!path_str)
+        path_str = g_strdup (record->path);
+    else if (!g_str_equal (path_str, record->path))
+        return;
+
+    buffer = g_byte_array_sized_new (record->raw_length);
+    g_byte_array_append (buffer, record->raw, record->raw_length);
+    message = qmi_message_new_from_raw (buffer, NULL);
+    g_byte_array_unref (buffer);
+    if (!message) {
+        ctx->n_skipped++;
+        return;
+    }
+
+    if (!ctx->first_timestamp)
+        ctx->first_timestamp = record->timestamp;
+
+    replay_record = g_slice_new0 (ReplayRecord);
+    replay_record->replay = replay;
+    replay_record->offset = record->timestamp - ctx->first_timestamp;
+    replay_record->latency = MAX (record->latency, 0);
+    replay_record->sent = record->sent;
+    replay_record->message = message;
+    replay->recorded_duration = replay_record->offset;
+
+    /* Responses are given by the simulated modem */
+    if (qmi_message_is_response (message)) {
+        gpointer  key;
+        GQueue   *queue;
+
+        key = build_transaction_key (message);
+        queue = g_hash_table_lookup (replay->responses, key);
+        if (!queue) {
+            queue = g_queue_new ();
+            g_hash_table_insert (replay->responses, key, queue);
+        }
+        g_queue_push_tail (queue, replay_record);
+        return;
+    }
+
+    if (replay_record->sent)
+        replay->n_requests++;
+    else if (qmi_message_is_indication (message))
+        replay->n_indications++;
+    else {
+        /* Requests received, e.g. by a fake modem, are not replayed */
+        replay_record_free (replay_record);
+        ctx->n_skipped++;
+        return;
+    }
+    g_ptr_array_add (replay->records, replay_record);
+}
+
+static void
+response_queue_free (GQueue *queue)
+{
+    g_queue_free_full (queue, (GDestroyNotify) replay_record_free);
+}
+
+static gboolean
+load_trace (Replay       *replay,
+            const gchar  *trace_path,
+            GError      **error)
+{
+    LoadContext  ctx = { replay, 0, 0 };
+    gchar       *contents;
+    gsize        contents_length;
+    gboolean     result;
+
+    if (!g_file_get_contents (trace_path, &contents, &contents_length, error))
+        return FALSE;
+
+    replay->records = g_ptr_array_new_with_free_func ((GDestroyNotify) replay_record_free);
+    replay->responses = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) response_queue_free);
+    result = qmi_trace_foreach_record ((const guint8 *) contents,
+                                       contents_length,
+                                       (QmiTraceForeachRecordFn) load_record,
+                                       &ctx,
+                                       error);
+    g_free (contents);
+
+    if (result && ctx.n_skipped > 0 && !quiet_flag)
+        g_printerr ("warning: skipped %u frames which aren't replayable\n", ctx.n_skipped);
+    return result;
+}
+
+/*****************************************************************************/
+/* Simulated modem */
+
+static gboolean
+modem_write_record (ReplayRecord *record)
+{
+    test_port_context_write (record->replay->port, record->message->data, record->message->len);
+    return G_SOURCE_REMOVE;
+}
+
+static GByteArray *
+modem_respond (TestPortContext *port,
+               GByteArray      *request_raw,
+               Replay          *replay)
+{
+    QmiMessage   *request = (QmiMessage *) request_raw;
+    ReplayRecord *record = NULL;
+    GQueue       *queue = NULL;
+
+    /* Requests done while opening the replaying device, e.g. the internal
+     * proxy open, are not part of the replayed session */
+    if (g_atomic_int_get (&replay->started))
+        queue = g_hash_table_lookup (replay->responses, build_transaction_key (request));
+    if (queue) {
+        /* Transaction IDs are reused during long sessions, so look for the
+         * first response to this same message */
+        GList *l;
+
+        for (l = queue->head; l; l = g_list_next (l)) {
+            if (qmi_message_get_message_id (((ReplayRecord *) l->data)->message) == qmi_message_get_message_id (request)) {
+                record = l->data;
+                g_queue_delete_link (queue, l);
+                break;
+            }
+        }
+    }
+
+    /* Requests whose response was not recorded are just acknowledged */
+    if (!record) {
+        if (g_atomic_int_get (&replay->started))
+            g_atomic_int_inc (&replay->n_unmatched);
+        return qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+    }
+
+    if (max_speed_flag || record->latency == 0) {
+        GByteArray *response;
+
+        response = g_byte_array_sized_new (record->message->len);
+        g_byte_array_append (response, record->message->data, record->message->len);
+        replay_record_free (record);
+        return response;
+    }
+
+    {
+        GSource *source;
+
+        source = g_timeout_source_new (record->latency / 1000);
+        g_source_set_callback (source,
+                               (GSourceFunc) modem_write_record,
+                               record,
+                               (GDestroyNotify) replay_record_free);
+        g_source_attach (source, g_main_context_get_thread_default ());
+        g_source_unref (source);
+    }
+    return NULL;
+}
+
+/*****************************************************************************/
+/* Replay */
+
+static void replay_due_records (Replay *replay);
+
+static gboolean
+grace_period_timeout_cb (Replay *replay)
+{
+    replay->timeout_id = 0;
+    g_main_loop_quit (replay->loop);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+check_finished (Replay *replay)
+{
+    if (replay->next_record < replay->records->len || g_hash_table_size (replay->ongoing) > 0)
+        return;
+
+    if (replay->n_received >= replay->n_indications) {
+        g_main_loop_quit (replay->loop);
+        return;
+    }
+
+    /* Indications may be missing if they were not dispatched, so don't
+     * wait forever for them */
+    if (!replay->timeout_id)
+        replay->timeout_id = g_timeout_add (INDICATIONS_GRACE_PERIOD_MS,
+                                            (GSourceFunc) grace_period_timeout_cb,
+                                            replay);
+}
+
+static void
+command_ready (QmiDevice    *device,
+               GAsyncResult *res,
+               ReplayRecord *record)
+{
+    Replay     *replay = record->replay;
+    QmiMessage *response;
+    GError     *error = NULL;
+
+    g_hash_table_remove (replay->ongoing, build_transaction_key (record->message));
+
+    response = qmi_device_command_full_finish (device, res, &error);
+    if (!response) {
+        if (verbose_flag)
+            g_printerr ("request at %.3fs failed: %s\n",
+                        (gdouble) record->offset / G_USEC_PER_SEC, error->message);
+        g_error_free (error);
+        replay->n_failed++;
+    } else {
+        qmi_message_validate (response, NULL, NULL);
+        qmi_message_unref (response);
+        replay->n_completed++;
+    }
+
+    /* A request may have been held back waiting for this one */
+    replay_due_records (replay);
+    check_finished (replay);
+}
+
+static void
+device_indication_cb (QmiDevice  *device,
+                      QmiMessage *message,
+                      Replay     *replay)
+{
+    qmi_message_validate (message, NULL, NULL);
+    replay->n_received++;
+    check_finished (replay);
+}
+
+static gboolean
+replay_timeout_cb (Replay *replay)
+{
+    replay->timeout_id = 0;
+    replay_due_records (replay);
+    check_finished (replay);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+replay_due_records (Replay *replay)
+{
+    gint64 now;
+
+    /* Waiting for the next record to be due */
+    if (replay->timeout_id)
+        return;
+
+    now = g_get_monotonic_time () - replay->start;
+    while (replay->next_record < replay->records->len) {
+        ReplayRecord *record;
+        gpointer      key;
+
+        record = g_ptr_array_index (replay->records, replay->next_record);
+        if (!max_speed_flag && record->offset > now) {
+            replay->timeout_id = g_timeout_add ((record->offset - now) / 1000,
+                                                (GSourceFunc) replay_timeout_cb,
+                                                replay);
+            return;
+        }
+
+        if (!record->sent) {
+            test_port_context_invoke (replay->port, (GSourceFunc) modem_write_record, record);
+            replay->next_record++;
+            continue;
+        }
+
+        /* Never more than one ongoing request per transaction */
+        key = build_transaction_key (record->message);
+        if (g_hash_table_contains (replay->ongoing, key))
+            return;
+        g_hash_table_add (replay->ongoing, key);
+
+        qmi_device_command_full (replay->device,
+                                 record->message,
+                                 NULL,
+                                 REQUEST_TIMEOUT_SECS,
+                                 NULL,
+                                 (GAsyncReadyCallback) command_ready,
+                                 record);
+        replay->next_record++;
+    }
+}
+
+/*****************************************************************************/
+/* Setup and teardown */
+
+static void
+device_new_ready (GObject      *source,
+                  GAsyncResult *res,
+                  Replay       *replay)
+{
+    GError *error = NULL;
+
+    replay->device = qmi_device_new_finish (res, &error);
+    if (!replay->device) {
+        g_printerr ("error: couldn't create device: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+    g_main_loop_quit (replay->loop);
+}
+
+static void
+device_open_ready (QmiDevice    *device,
+                   GAsyncResult *res,
+                   Replay       *replay)
+{
+    GError *error = NULL;
+
+    if (!qmi_device_open_finish (device, res, &error)) {
+        g_printerr ("error: couldn't open device: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+    g_main_loop_quit (replay->loop);
+}
+
+static void
+device_close_ready (QmiDevice    *device,
+                    GAsyncResult *res,
+                    Replay       *replay)
+{
+    qmi_device_close_finish (device, res, NULL);
+    g_main_loop_quit (replay->loop);
+}
+
+static void
+replay_setup (Replay *replay)
+{
+    GFile *file;
+    gchar *path;
+
+    replay->loop = g_main_loop_new (NULL, FALSE);
+    replay->ongoing = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    /* The simulated modem acts as the proxy the device talks to */
+    path = g_strdup_printf ("/dev/qmireplay%08lu", (gulong) getpid ());
+    replay->port = test_port_context_new (path);
+    test_port_context_set_responder (replay->port, (TestPortContextResponderFn) modem_respond, replay);
+    test_port_context_start (replay->port);
+
+    file = g_file_new_for_path (path);
+    g_async_initable_new_async (QMI_TYPE_DEVICE, G_PRIORITY_DEFAULT, NULL,
+                                (GAsyncReadyCallback) device_new_ready, replay,
+                                QMI_DEVICE_FILE,          file,
+                                QMI_DEVICE_NO_FILE_CHECK, TRUE,
+                                QMI_DEVICE_PROXY_PATH,    path,
+                                NULL);
+    g_object_unref (file);
+    g_free (path);
+    g_main_loop_run (replay->loop);
+
+    qmi_device_open (replay->device, QMI_DEVICE_OPEN_FLAGS_PROXY, 10, NULL,
+                     (GAsyncReadyCallback) device_open_ready,
+                     replay);
+    g_main_loop_run (replay->loop);
+
+    g_signal_connect (replay->device,
+                      QMI_DEVICE_SIGNAL_INDICATION,
+                      G_CALLBACK (device_indication_cb),
+                      replay);
+}
+
+static void
+replay_teardown (Replay *replay)
+{
+    qmi_device_close_async (replay->device, 10, NULL,
+                            (GAsyncReadyCallback) device_close_ready,
+                            replay);
+    g_main_loop_run (replay->loop);
+    g_object_unref (replay->device);
+
+    test_port_context_stop (replay->port);
+    test_port_context_free (replay->port);
+
+    g_hash_table_unref (replay->ongoing);
+    g_hash_table_unref (replay->responses);
+    g_ptr_array_unref (replay->records);
+    g_main_loop_unref (replay->loop);
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    GOptionContext *context;
+    GError         *error = NULL;
+    Replay          replay;
+    gint64          cpu_start;
+    gint64          cpu_time;
+    gint64          wall_time;
+    guint           n_frames;
+
+    context = g_option_context_new ("TRACE - Replay a binary trace of a QMI session against a simulated modem");
+    g_option_context_add_main_entries (context, main_entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("error: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+    g_option_context_free (context);
+
+    if (argc != 2) {
+        g_printerr ("error: a single trace must be given\n");
+        exit (EXIT_FAILURE);
+    }
+
+    memset (&replay, 0, sizeof (Replay));
+    if (!load_trace (&replay, argv[1], &error)) {
+        g_printerr ("error: couldn't load trace: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+    if (!replay.records->len) {
+        g_printerr ("error: nothing to replay\n");
+        exit (EXIT_FAILURE);
+    }
+
+    replay_setup (&replay);
+
+    /* Only the traffic of the replayed session is measured */
+    g_atomic_int_set (&replay.started, TRUE);
+    replay.start = g_get_monotonic_time ();
+    cpu_start = get_thread_cpu_time ();
+    replay_due_records (&replay);
+    check_finished (&replay);
+    g_main_loop_run (replay.loop);
+    cpu_time = get_thread_cpu_time () - cpu_start;
+    wall_time = g_get_monotonic_time () - replay.start;
+
+    if (replay.timeout_id)
+        g_source_remove (replay.timeout_id);
+
+    n_frames = replay.n_completed + replay.n_failed + replay.n_received;
+
+    if (quiet_flag)
+        g_print ("replay/%s/client-cpu\t%u\t%.1f\tns/frame\n",
+                 max_speed_flag ? "max-speed" : "original-speed",
+                 n_frames,
+                 n_frames ? ((gdouble) cpu_time * 1000.0) / n_frames : 0.0);
+    else {
+        g_print ("trace:             %s (%s)\n", argv[1], path_str);
+        g_print ("mode:              %s\n", max_speed_flag ? "max speed" : "original speed");
+        g_print ("requests:          %u completed, %u failed, of %u\n",
+                 replay.n_completed, replay.n_failed, replay.n_requests);
+        g_print ("unmatched:         %d requests without recorded response\n",
+                 g_atomic_int_get (&replay.n_unmatched));
+        g_print ("indications:       %u received, of %u\n", replay.n_received, replay.n_indications);
+        g_print ("wall time:         %.3f s (recorded %.3f s)\n",
+                 (gdouble) wall_time / G_USEC_PER_SEC,
+                 (gdouble) replay.recorded_duration / G_USEC_PER_SEC);
+        g_print ("client CPU time:   %.3f s\n", (gdouble) cpu_time / G_USEC_PER_SEC);
+        g_print ("client CPU/frame:  %.1f us\n", n_frames ? (gdouble) cpu_time / n_frames : 0.0);
+    }
+
+    replay_teardown (&replay);
+    g_free (path_str);
+
+    return (replay.n_failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+}
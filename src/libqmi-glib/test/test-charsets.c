@@ -0,0 +1,122 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <glib-object.h>
+#include <string.h>
+#include "qmi-charsets.h"
+
+/*****************************************************************************/
+
+/* Bit by bit unpacking, to compare against */
+static void
+gsm7_unpack_slow (const guint8 *packed,
+                  guint         n_septets,
+                  guint8       *out)
+{
+    guint i;
+
+    for (i = 0; i < n_septets; i++) {
+        guint start_bit;
+        guint j;
+
+        start_bit = i * 7;
+        out[i] = 0;
+        for (j = 0; j < 7; j++) {
+            guint bit = start_bit + j;
+
+            if (packed[bit / 8] & (1 << (bit % 8)))
+                out[i] |= (1 << j);
+        }
+    }
+}
+
+static void
+test_charsets_gsm7_unpack (void)
+{
+    guint8 packed[64];
+    guint8 unpacked[80];
+    guint8 expected[80];
+    guint  i;
+
+    for (i = 0; i < G_N_ELEMENTS (packed); i++)
+        packed[i] = (guint8)(i * 37 + 11);
+
+    /* Cover all the possible tail lengths */
+    for (i = 0; i <= (G_N_ELEMENTS (packed) * 8) / 7; i++) {
+        g_assert_cmpuint (qmi_charset_gsm7_unpack (packed, sizeof (packed), i, unpacked), ==, i);
+        gsm7_unpack_slow (packed, i, expected);
+        g_assert (memcmp (unpacked, expected, i) == 0);
+    }
+
+    /* Not enough data */
+    g_assert_cmpuint (qmi_charset_gsm7_unpack (packed, 7, 9, unpacked), ==, 8);
+}
+
+static void
+test_charsets_gsm7_to_utf8 (void)
+{
+    static const guint8 packed[] = { 0xE8, 0x32, 0x9B, 0xFD, 0x46, 0x97, 0xD9, 0xEC, 0x37 };
+    /* €, @, £, escape not followed by an extended character, A */
+    static const guint8 gsm[] = { 0x1B, 0x65, 0x00, 0x01, 0x1B, 0x41 };
+    guint8 unpacked[10];
+    gchar  utf8[32];
+    guint  n_septets;
+
+    n_septets = qmi_charset_gsm7_unpack (packed, sizeof (packed), 10, unpacked);
+    g_assert_cmpuint (n_septets, ==, 10);
+    g_assert_cmpuint (qmi_charset_gsm7_unpacked_to_utf8 (unpacked, n_septets, utf8, sizeof (utf8)), ==, 10);
+    g_assert_cmpstr (utf8, ==, "hellohello");
+
+    g_assert_cmpuint (qmi_charset_gsm7_unpacked_to_utf8 (gsm, sizeof (gsm), utf8, sizeof (utf8)), ==, 9);
+    g_assert_cmpstr (utf8, ==, "\xe2\x82\xac" "@" "\xc2\xa3" "\xc2\xa0" "A");
+    g_assert_cmpuint (strlen (utf8) + 1, <=, QMI_CHARSET_GSM7_UTF8_SIZE (sizeof (gsm)));
+
+    /* Never truncated in the middle of a character */
+    g_assert_cmpuint (qmi_charset_gsm7_unpacked_to_utf8 (gsm, sizeof (gsm), utf8, 6), ==, 9);
+    g_assert_cmpstr (utf8, ==, "\xe2\x82\xac" "@");
+}
+
+static void
+test_charsets_ucs2_to_utf8 (void)
+{
+    /* H, €, U+1F600 as a surrogate pair, an unpaired surrogate, A, NUL, B */
+    static const guint8 ucs2_le[] = {
+        0x48, 0x00, 0xAC, 0x20, 0x3D, 0xD8, 0x00, 0xDE, 0x00, 0xD8, 0x41, 0x00, 0x00, 0x00, 0x42, 0x00
+    };
+    static const guint8 ucs2_be[] = { 0x00, 0x48, 0x00, 0x69 };
+    gchar utf8[32];
+
+    g_assert_cmpuint (qmi_charset_ucs2_to_utf8 (ucs2_le, sizeof (ucs2_le), QMI_ENDIAN_LITTLE, utf8, sizeof (utf8)), ==, 12);
+    g_assert_cmpstr (utf8, ==, "H" "\xe2\x82\xac" "\xf0\x9f\x98\x80" "\xef\xbf\xbd" "A");
+
+    g_assert_cmpuint (qmi_charset_ucs2_to_utf8 (ucs2_be, sizeof (ucs2_be), QMI_ENDIAN_BIG, utf8, sizeof (utf8)), ==, 2);
+    g_assert_cmpstr (utf8, ==, "Hi");
+
+    /* Just the length */
+    g_assert_cmpuint (qmi_charset_ucs2_to_utf8 (ucs2_be, sizeof (ucs2_be), QMI_ENDIAN_BIG, NULL, 0), ==, 2);
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/libqmi-glib/charsets/gsm7-unpack",  test_charsets_gsm7_unpack);
+    g_test_add_func ("/libqmi-glib/charsets/gsm7-to-utf8", test_charsets_gsm7_to_utf8);
+    g_test_add_func ("/libqmi-glib/charsets/ucs2-to-utf8", test_charsets_ucs2_to_utf8);
+
+    return g_test_run ();
+}
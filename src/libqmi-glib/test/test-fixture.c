@@ -25,7 +25,13 @@ static const QmiService services [] = {
     QMI_SERVICE_DMS,
     QMI_SERVICE_NAS,
     QMI_SERVICE_WDS,
-    QMI_SERVICE_PDS
+    QMI_SERVICE_PDS,
+    QMI_SERVICE_PDC,
+    QMI_SERVICE_UIM,
+    QMI_SERVICE_WMS,
+    QMI_SERVICE_VOICE,
+    QMI_SERVICE_PBM,
+    QMI_SERVICE_LOC
 };
 
 static void
@@ -277,6 +283,12 @@ test_fixture_teardown (TestFixture *fixture)
             0x01,       /* cid: 1 */
         };
 
+        /* Device already disposed by the test, e.g. after a hangup */
+        if (!fixture->device) {
+            g_clear_object (&fixture->service_info[services[i]].client);
+            continue;
+        }
+
         expected[15] = services[i];
         response[22] = services[i];
         test_port_context_set_command (fixture->ctx,
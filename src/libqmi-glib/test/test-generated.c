@@ -14,6 +14,9 @@
  */
 
 #include <config.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
 #include <libqmi-glib.h>
 
 #include "test-fixture.h"
@@ -27,624 +30,5679 @@ test_generated_core (TestFixture *fixture)
 }
 
 /*****************************************************************************/
-/* DMS Get IDs */
+/* Batched client allocation */
 
-static void
-dms_get_ids_ready (QmiClientDms *client,
-                   GAsyncResult *res,
-                   TestFixture  *fixture)
+static GByteArray *
+allocate_clients_responder (TestPortContext *ctx,
+                            GByteArray      *request,
+                            gpointer         user_data)
 {
-    QmiMessageDmsGetIdsOutput *output;
-    GError *error = NULL;
-    gboolean st;
-    const gchar *str;
+    QmiMessage *response;
+    gsize       init_offset;
+    gsize       offset = 0;
+    guint8      service;
+    guint8     *next_cid = user_data;
 
-    output = qmi_client_dms_get_ids_finish (client, res, &error);
-    g_assert_no_error (error);
-    g_assert (output);
+    g_assert_cmpuint (qmi_message_get_service ((QmiMessage *)request), ==, QMI_SERVICE_CTL);
+    g_assert_cmpuint (qmi_message_get_message_id ((QmiMessage *)request), ==, 0x0022);
 
-    st = qmi_message_dms_get_ids_output_get_result (output, &error);
-    g_assert_no_error (error);
-    g_assert (st);
+    init_offset = qmi_message_tlv_read_init ((QmiMessage *)request, 0x01, NULL, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_read_guint8 ((QmiMessage *)request, init_offset, &offset, &service, NULL));
 
-    /* [/dev/cdc-wdm3] Device IDs retrieved:
-     * 	 ESN: '80997874'
-     * 	IMEI: '359225050039973'
-     * 	MEID: '35922505003997' */
-    st = qmi_message_dms_get_ids_output_get_esn (output, &str, &error);
-    g_assert_no_error (error);
-    g_assert (st);
-    g_assert_cmpstr (str, ==, "80997874");
+    /* Refuse VOICE clients, to test partial failures */
+    if (service == QMI_SERVICE_VOICE)
+        return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_CLIENT_IDS_EXHAUSTED);
 
-    st = qmi_message_dms_get_ids_output_get_imei (output, &str, &error);
-    g_assert_no_error (error);
-    g_assert (st);
-    g_assert_cmpstr (str, ==, "359225050039973");
+    response = qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+    init_offset = qmi_message_tlv_write_init (response, 0x01, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_guint8 (response, service, NULL));
+    g_assert (qmi_message_tlv_write_guint8 (response, (*next_cid)++, NULL));
+    g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+    return response;
+}
 
-    st = qmi_message_dms_get_ids_output_get_meid (output, &str, &error);
+static void
+allocate_clients_ready (QmiDevice    *device,
+                        GAsyncResult *res,
+                        TestFixture  *fixture)
+{
+    GPtrArray *clients;
+    GPtrArray *errors = NULL;
+    GError    *error = NULL;
+    guint      i;
+
+    clients = qmi_device_allocate_clients_finish (device, res, &errors, &error);
     g_assert_no_error (error);
-    g_assert (st);
-    g_assert_cmpstr (str, ==, "35922505003997");
+    g_assert (clients);
+    g_assert (errors);
+    g_assert_cmpuint (clients->len, ==, 4);
+    g_assert_cmpuint (errors->len, ==, 4);
 
-    qmi_message_dms_get_ids_output_unref (output);
+    /* Same order as requested */
+    g_assert (QMI_IS_CLIENT_WDS (g_ptr_array_index (clients, 0)));
+    g_assert (QMI_IS_CLIENT_WDS (g_ptr_array_index (clients, 1)));
+    g_assert (QMI_IS_CLIENT_UIM (g_ptr_array_index (clients, 3)));
+    g_assert (!g_ptr_array_index (clients, 2));
+    g_assert_cmpuint (qmi_client_get_cid (g_ptr_array_index (clients, 0)), !=,
+                      qmi_client_get_cid (g_ptr_array_index (clients, 1)));
+
+    for (i = 0; i < errors->len; i++) {
+        if (i == 2)
+            g_assert_error (g_ptr_array_index (errors, i), QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_CLIENT_IDS_EXHAUSTED);
+        else
+            g_assert (!g_ptr_array_index (errors, i));
+    }
+
+    for (i = 0; i < clients->len; i++) {
+        if (g_ptr_array_index (clients, i))
+            qmi_device_release_client (device,
+                                       g_ptr_array_index (clients, i),
+                                       QMI_DEVICE_RELEASE_CLIENT_FLAGS_NONE,
+                                       1, NULL, NULL, NULL);
+    }
 
+    g_ptr_array_unref (errors);
+    g_ptr_array_unref (clients);
     test_fixture_loop_stop (fixture);
 }
 
 static void
-test_generated_dms_get_ids (TestFixture *fixture)
+test_generated_core_allocate_clients (TestFixture *fixture)
 {
-    guint8 expected[] = {
-        0x01,
-        0x0C, 0x00, 0x00, 0x02, 0x01,
-        0x00, 0xFF, 0xFF, 0x25, 0x00, 0x00, 0x00
-    };
-    guint8 response[] = {
-        0x01,
-        0x45, 0x00, 0x80, 0x02, 0x01,
-        0x02, 0xFF, 0xFF, 0x25, 0x00, 0x39, 0x00, 0x02,
-        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x13, 0x01,
-        0x00, 0x42, 0x12, 0x0E, 0x00, 0x33, 0x35, 0x39,
-        0x32, 0x32, 0x35, 0x30, 0x35, 0x30, 0x30, 0x33,
-        0x39, 0x39, 0x37, 0x10, 0x08, 0x00, 0x38, 0x30,
-        0x39, 0x39, 0x37, 0x38, 0x37, 0x34, 0x11, 0x0F,
-        0x00, 0x33, 0x35, 0x39, 0x32, 0x32, 0x35, 0x30,
-        0x35, 0x30, 0x30, 0x33, 0x39, 0x39, 0x37, 0x33
+    static const QmiService services[] = {
+        QMI_SERVICE_WDS,
+        QMI_SERVICE_WDS,
+        QMI_SERVICE_VOICE,
+        QMI_SERVICE_UIM,
     };
+    guint8 next_cid = 0x10;
 
-    test_port_context_set_command (fixture->ctx,
-                                   expected, G_N_ELEMENTS (expected),
-                                   response, G_N_ELEMENTS (response),
-                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
-
-    qmi_client_dms_get_ids (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
-                            (GAsyncReadyCallback) dms_get_ids_ready,
-                            fixture);
+    test_port_context_set_responder (fixture->ctx, allocate_clients_responder, &next_cid);
+    qmi_device_allocate_clients (fixture->device, services, G_N_ELEMENTS (services), 3, NULL,
+                                 (GAsyncReadyCallback) allocate_clients_ready,
+                                 fixture);
     test_fixture_loop_run (fixture);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+
+    /* The four requests got a transaction ID each */
+    fixture->service_info[QMI_SERVICE_CTL].transaction_id += G_N_ELEMENTS (services);
 }
 
 /*****************************************************************************/
-/* DMS UIM Get PIN Status */
+/* Batch of commands */
 
-static void
-dms_uim_get_pin_status_ready (QmiClientDms *client,
-                              GAsyncResult *res,
-                              TestFixture  *fixture)
+static GByteArray *
+command_batch_responder (TestPortContext *ctx,
+                         GByteArray      *request,
+                         gpointer         user_data)
 {
-    QmiMessageDmsUimGetPinStatusOutput *output;
-    GError *error = NULL;
-    gboolean st;
-    QmiDmsUimPinStatus current_status;
-    guint8 verify_retries_left;
-    guint8 unblock_retries_left;
-
-    output = qmi_client_dms_uim_get_pin_status_finish (client, res, &error);
-    g_assert_no_error (error);
-    g_assert (output);
-
-    st = qmi_message_dms_uim_get_pin_status_output_get_result (output, &error);
-    g_assert_no_error (error);
-    g_assert (st);
+    guint *n_requests = user_data;
 
-    /* [/dev/cdc-wdm3] PIN1:
-     *   Status: enabled-not-verified
-     *   Verify: 3
-     *  Unblock: 10
-     * [/dev/cdc-wdm3] PIN2:
-     *   Status: enabled-not-verified
-     *   Verify: 2
-     *  Unblock: 10
-     */
+    g_assert_cmpuint (qmi_message_get_service ((QmiMessage *)request), ==, QMI_SERVICE_DMS);
+    (*n_requests)++;
+    return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+}
 
-    st = (qmi_message_dms_uim_get_pin_status_output_get_pin1_status (
-              output,
-              &current_status,
-              &verify_retries_left,
-              &unblock_retries_left,
-              &error));
-    g_assert_no_error (error);
-    g_assert (st);
-    g_assert_cmpuint (current_status, ==, QMI_DMS_UIM_PIN_STATUS_ENABLED_NOT_VERIFIED);
-    g_assert_cmpuint (verify_retries_left, ==, 3);
-    g_assert_cmpuint (unblock_retries_left, ==, 10);
+static void
+command_batch_ready (QmiDevice    *device,
+                     GAsyncResult *res,
+                     TestFixture  *fixture)
+{
+    GPtrArray *responses;
+    GPtrArray *errors = NULL;
+    GError    *error = NULL;
+    guint      i;
 
-    st = (qmi_message_dms_uim_get_pin_status_output_get_pin2_status (
-              output,
-              &current_status,
-              &verify_retries_left,
-              &unblock_retries_left,
-              &error));
+    responses = qmi_device_command_batch_finish (device, res, &errors, &error);
     g_assert_no_error (error);
-    g_assert (st);
-    g_assert_cmpuint (current_status, ==, QMI_DMS_UIM_PIN_STATUS_ENABLED_NOT_VERIFIED);
-    g_assert_cmpuint (verify_retries_left, ==, 2);
-    g_assert_cmpuint (unblock_retries_left, ==, 10);
+    g_assert (responses);
+    g_assert (errors);
+    g_assert_cmpuint (responses->len, ==, 3);
+    g_assert_cmpuint (errors->len, ==, 3);
 
-    qmi_message_dms_uim_get_pin_status_output_unref (output);
+    /* Same order as requested; the second one has no client id */
+    for (i = 0; i < responses->len; i++) {
+        if (i == 1) {
+            g_assert (!g_ptr_array_index (responses, i));
+            g_assert_error (g_ptr_array_index (errors, i), QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED);
+        } else {
+            g_assert (g_ptr_array_index (responses, i));
+            g_assert (qmi_message_is_response (g_ptr_array_index (responses, i)));
+            g_assert (!g_ptr_array_index (errors, i));
+        }
+    }
 
+    g_ptr_array_unref (errors);
+    g_ptr_array_unref (responses);
     test_fixture_loop_stop (fixture);
 }
 
 static void
-test_generated_dms_uim_get_pin_status (TestFixture *fixture)
+test_generated_core_command_batch (TestFixture *fixture)
 {
-    guint8 expected[] = {
-        0x01,
-        0x0C, 0x00, 0x00, 0x02, 0x01,
-        0x00, 0xFF, 0xFF, 0x2B, 0x00, 0x00, 0x00
-    };
-    guint8 response[] = {
-        0x01,
-        0x1F, 0x00, 0x80, 0x02, 0x01,
-        0x02, 0xFF, 0xFF, 0x2B, 0x00, 0x13, 0x00, 0x02,
-        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x12, 0x03,
-        0x00, 0x01, 0x02, 0x0A, 0x11, 0x03, 0x00, 0x01,
-        0x03, 0x0A
-    };
+    QmiClient  *client;
+    QmiMessage *messages[3];
+    guint       n_requests = 0;
+    guint       i;
 
-    test_port_context_set_command (fixture->ctx,
-                                   expected, G_N_ELEMENTS (expected),
-                                   response, G_N_ELEMENTS (response),
-                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+    client = fixture->service_info[QMI_SERVICE_DMS].client;
+    messages[0] = qmi_message_new (QMI_SERVICE_DMS, qmi_client_get_cid (client), qmi_client_get_next_transaction_id (client), 0x0025);
+    messages[1] = qmi_message_new (QMI_SERVICE_DMS, 0, 1, 0x0025);
+    messages[2] = qmi_message_new (QMI_SERVICE_DMS, qmi_client_get_cid (client), qmi_client_get_next_transaction_id (client), 0x0025);
 
-    qmi_client_dms_uim_get_pin_status (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
-                                       (GAsyncReadyCallback) dms_uim_get_pin_status_ready,
-                                       fixture);
+    test_port_context_set_responder (fixture->ctx, command_batch_responder, &n_requests);
+    qmi_device_command_batch (fixture->device, messages, NULL, G_N_ELEMENTS (messages), 3, NULL,
+                              (GAsyncReadyCallback) command_batch_ready,
+                              fixture);
     test_fixture_loop_run (fixture);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+    g_assert_cmpuint (n_requests, ==, 2);
+
+    for (i = 0; i < G_N_ELEMENTS (messages); i++)
+        qmi_message_unref (messages[i]);
+
+    /* Two requests got a transaction ID each */
+    fixture->service_info[QMI_SERVICE_DMS].transaction_id += 2;
 }
 
 /*****************************************************************************/
-/* DMS UIM Verify PIN */
+/* Stats read from another thread */
 
-static void
-dms_uim_verify_pin_ready (QmiClientDms *client,
-                          GAsyncResult *res,
-                          TestFixture  *fixture)
+typedef struct {
+    TestFixture *fixture;
+    guint        n_pending;
+} StatsLengthsContext;
+
+static gpointer
+stats_lengths_get (QmiDevice *device)
 {
-    QmiMessageDmsUimVerifyPinOutput *output;
-    GError *error = NULL;
-    gboolean st;
+    QmiDeviceStats *stats;
 
-    output = qmi_client_dms_uim_verify_pin_finish (client, res, &error);
-    g_assert_no_error (error);
-    g_assert (output);
+    stats = g_new0 (QmiDeviceStats, 1);
+    qmi_device_get_stats (device, stats);
+    return stats;
+}
 
-    st = qmi_message_dms_uim_verify_pin_output_get_result (output, &error);
-    g_assert_no_error (error);
-    g_assert (st);
+static QmiDeviceStats *
+stats_lengths_get_in_thread (QmiDevice *device)
+{
+    return g_thread_join (g_thread_new ("stats", (GThreadFunc) stats_lengths_get, device));
+}
 
-    qmi_message_dms_uim_verify_pin_output_unref (output);
+static void
+stats_lengths_command_ready (QmiDevice           *device,
+                             GAsyncResult        *res,
+                             StatsLengthsContext *ctx)
+{
+    QmiMessage *response;
+    GError     *error = NULL;
 
-    test_fixture_loop_stop (fixture);
+    response = qmi_device_command_full_finish (device, res, &error);
+    g_assert_no_error (error);
+    g_assert (response);
+    qmi_message_unref (response);
+    if (--ctx->n_pending == 0)
+        test_fixture_loop_stop (ctx->fixture);
 }
 
 static void
-test_generated_dms_uim_verify_pin (TestFixture *fixture)
+test_generated_core_stats_lengths (TestFixture *fixture)
 {
-    QmiMessageDmsUimVerifyPinInput *input;
-    gboolean st;
-    GError *error = NULL;
-    guint8 expected[] = {
-        0x01,
-        0x15, 0x00, 0x00, 0x02, 0x01,
-        0x00, 0x01, 0x00, 0x28, 0x00, 0x09, 0x00, 0x01,
-        0x06, 0x00, 0x01, 0x04, 0x31, 0x32, 0x33, 0x34
-    };
-    guint8 response[] = {
-        0x01,
-        0x13, 0x00, 0x80, 0x02, 0x01,
-        0x02, 0xFF, 0xFF, 0x28, 0x00, 0x07, 0x00, 0x02,
-        0x04, 0x00, 0x00, 0x00, 0x00, 0x00
-    };
+    StatsLengthsContext  ctx = { fixture, 2 };
+    QmiClient           *client;
+    QmiDeviceStats      *stats;
+    guint                n_requests = 0;
+    guint                i;
 
-    test_port_context_set_command (fixture->ctx,
-                                   expected, G_N_ELEMENTS (expected),
-                                   response, G_N_ELEMENTS (response),
-                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+    client = fixture->service_info[QMI_SERVICE_DMS].client;
+    qmi_device_set_service_max_in_flight (fixture->device, QMI_SERVICE_DMS, 1);
+    test_port_context_set_responder (fixture->ctx, command_batch_responder, &n_requests);
 
-    input = qmi_message_dms_uim_verify_pin_input_new ();
-    st = qmi_message_dms_uim_verify_pin_input_set_info (input, QMI_DMS_UIM_PIN_ID_PIN, "1234", &error);
-    g_assert_no_error (error);
-    g_assert (st);
+    for (i = 0; i < 2; i++) {
+        QmiMessage *message;
 
-    qmi_client_dms_uim_verify_pin (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), input, 3, NULL,
-                                   (GAsyncReadyCallback) dms_uim_verify_pin_ready,
-                                   fixture);
+        message = qmi_message_new (QMI_SERVICE_DMS, qmi_client_get_cid (client), qmi_client_get_next_transaction_id (client), 0x0025);
+        qmi_device_command_full (fixture->device, message, NULL, 3, NULL,
+                                 (GAsyncReadyCallback) stats_lengths_command_ready,
+                                 &ctx);
+        qmi_message_unref (message);
+    }
 
-    qmi_message_dms_uim_verify_pin_input_unref (input);
+    /* One sent, the other one waiting for the in-flight slot */
+    stats = stats_lengths_get_in_thread (fixture->device);
+    g_assert_cmpuint (stats->n_in_flight, ==, 1);
+    g_assert_cmpuint (stats->throttled_queue_length, ==, 1);
+    g_free (stats);
 
     test_fixture_loop_run (fixture);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+    qmi_device_set_service_max_in_flight (fixture->device, QMI_SERVICE_DMS, 0);
+    g_assert_cmpuint (n_requests, ==, 2);
+
+    stats = stats_lengths_get_in_thread (fixture->device);
+    g_assert_cmpuint (stats->n_in_flight, ==, 0);
+    g_assert_cmpuint (stats->throttled_queue_length, ==, 0);
+    g_assert_cmpuint (stats->output_queue_length, ==, 0);
+    g_free (stats);
+
+    fixture->service_info[QMI_SERVICE_DMS].transaction_id += 2;
 }
 
 /*****************************************************************************/
-/* DMS Get Time
- *
- * Note: the original device time in the real-life binary message used had the
- * time source set to QMI_DMS_TIME_SOURCE_DEVICE. This value has been modified
- * to explicitly make the 6-byte long uint read different from an 8-byte long
- * read of the same buffer, as QMI_DMS_TIME_SOURCE_DEVICE is actually 0x0000.
- */
+/* Requests held by the port until explicitly answered */
+
+typedef struct {
+    TestFixture *fixture;
+    GMutex       mutex;
+    GPtrArray   *held;
+    /* Transaction ids of all the requests received, in order */
+    GArray      *received;
+    guint        n_pending;
+} HeldContext;
 
 static void
-dms_get_time_ready (QmiClientDms *client,
-                    GAsyncResult *res,
-                    TestFixture  *fixture)
+held_context_init (HeldContext *ctx,
+                   TestFixture *fixture)
 {
-    QmiMessageDmsGetTimeOutput *output;
-    GError *error = NULL;
-    gboolean st;
-    guint64 device_time_time_count;
-    QmiDmsTimeSource device_time_time_source;
-    guint64 system_time;
-    guint64 user_time;
+    memset (ctx, 0, sizeof (HeldContext));
+    ctx->fixture = fixture;
+    g_mutex_init (&ctx->mutex);
+    ctx->held = g_ptr_array_new_with_free_func ((GDestroyNotify) g_byte_array_unref);
+    ctx->received = g_array_new (FALSE, FALSE, sizeof (guint16));
+}
 
-    output = qmi_client_dms_get_time_finish (client, res, &error);
-    g_assert_no_error (error);
-    g_assert (output);
+static void
+held_context_clear (HeldContext *ctx)
+{
+    g_ptr_array_unref (ctx->held);
+    g_array_unref (ctx->received);
+    g_mutex_clear (&ctx->mutex);
+}
 
-    st = qmi_message_dms_get_time_output_get_result (output, &error);
-    g_assert_no_error (error);
-    g_assert (st);
+static GByteArray *
+held_responder (TestPortContext *port,
+                GByteArray      *request,
+                HeldContext     *ctx)
+{
+    guint16 transaction_id;
 
-    st = qmi_message_dms_get_time_output_get_device_time (output, &device_time_time_count, &device_time_time_source, &error);
-    g_assert_no_error (error);
-    g_assert (st);
-    g_assert_cmpuint (device_time_time_count, == , 884789480513ULL);
-    g_assert_cmpuint (device_time_time_source, ==, QMI_DMS_TIME_SOURCE_HDR_NETWORK);
+    transaction_id = qmi_message_get_transaction_id ((QmiMessage *)request);
+    g_mutex_lock (&ctx->mutex);
+    g_ptr_array_add (ctx->held, g_byte_array_ref (request));
+    g_array_append_val (ctx->received, transaction_id);
+    g_mutex_unlock (&ctx->mutex);
+    return NULL;
+}
 
-    st = qmi_message_dms_get_time_output_get_system_time (output, &system_time, &error);
-    g_assert_no_error (error);
-    g_assert (st);
-    g_assert_cmpuint (system_time, ==, 1105986850641ULL);
+/* Run in the port thread */
+static gboolean
+held_answer_all (HeldContext *ctx)
+{
+    guint i;
 
-    st = qmi_message_dms_get_time_output_get_user_time (output, &user_time, &error);
-    g_assert_no_error (error);
-    g_assert (st);
-    g_assert_cmpuint (user_time, ==, 11774664);
+    g_mutex_lock (&ctx->mutex);
+    for (i = 0; i < ctx->held->len; i++) {
+        QmiMessage *response;
 
-    qmi_message_dms_get_time_output_unref (output);
+        response = qmi_message_response_new (g_ptr_array_index (ctx->held, i), QMI_PROTOCOL_ERROR_NONE);
+        test_port_context_write (ctx->fixture->ctx, response->data, response->len);
+        qmi_message_unref (response);
+    }
+    g_ptr_array_set_size (ctx->held, 0);
+    g_mutex_unlock (&ctx->mutex);
+    return G_SOURCE_REMOVE;
+}
 
-    test_fixture_loop_stop (fixture);
+static guint
+held_get_n_received (HeldContext *ctx)
+{
+    guint n;
+
+    g_mutex_lock (&ctx->mutex);
+    n = ctx->received->len;
+    g_mutex_unlock (&ctx->mutex);
+    return n;
 }
 
+/* Iterates the thread-default context until the port got @n_received
+ * requests in total */
 static void
-test_generated_dms_get_time (TestFixture *fixture)
+held_wait_received (HeldContext *ctx,
+                    guint        n_received)
 {
-    guint8 expected[] = {
-        0x01,
-        0x0C, 0x00, 0x00, 0x02, 0x01, 0x00, 0x01, 0x00, 0x2F, 0x00,
-        0x00, 0x00
-    };
-    guint8 response[] = {
-        0x01,
-        0x34, 0x00, 0x80, 0x02, 0x01, 0x02, 0x01, 0x00, 0x2F, 0x00,
-        0x28, 0x00,
-        0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00,
-        0x01, 0x08, 0x00, 0x41, 0x0C, 0x90, 0x01, 0xCE, 0x00, 0x02, 0x00, /* Note: last 0x0200 for HDR network source */
-        0x10, 0x08, 0x00, 0x51, 0x0F, 0xF4, 0x81, 0x01, 0x01, 0x00, 0x00,
-        0x11, 0x08, 0x00, 0xC8, 0xAA, 0xB3, 0x00, 0x00, 0x00, 0x00, 0x00
+    gint64 deadline;
+
+    deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;
+    while (held_get_n_received (ctx) < n_received) {
+        g_assert_cmpint (g_get_monotonic_time (), <, deadline);
+        if (!g_main_context_iteration (NULL, FALSE))
+            g_usleep (1000);
+    }
+}
+
+static guint16
+held_get_received (HeldContext *ctx,
+                   guint        i)
+{
+    guint16 transaction_id;
+
+    g_mutex_lock (&ctx->mutex);
+    g_assert_cmpuint (i, <, ctx->received->len);
+    transaction_id = g_array_index (ctx->received, guint16, i);
+    g_mutex_unlock (&ctx->mutex);
+    return transaction_id;
+}
+
+static void
+held_command_ready (QmiDevice    *device,
+                    GAsyncResult *res,
+                    HeldContext  *ctx)
+{
+    QmiMessage *response;
+    GError     *error = NULL;
+
+    response = qmi_device_command_full_finish (device, res, &error);
+    g_assert_no_error (error);
+    g_assert (response);
+    qmi_message_unref (response);
+    if (--ctx->n_pending == 0)
+        test_fixture_loop_stop (ctx->fixture);
+}
+
+/* Returns the transaction id of the request */
+static guint16
+held_command (HeldContext        *ctx,
+              QmiService          service,
+              QmiMessagePriority  priority)
+{
+    QmiClient         *client;
+    QmiMessage        *message;
+    QmiMessageContext *message_context;
+    guint16            transaction_id;
+
+    client = ctx->fixture->service_info[service].client;
+    transaction_id = qmi_client_get_next_transaction_id (client);
+    ctx->fixture->service_info[service].transaction_id++;
+
+    message = qmi_message_new (service, qmi_client_get_cid (client), transaction_id, 0x0020);
+    message_context = qmi_message_context_new ();
+    qmi_message_context_set_priority (message_context, priority);
+
+    ctx->n_pending++;
+    qmi_device_command_full (ctx->fixture->device, message, message_context, 10, NULL,
+                             (GAsyncReadyCallback) held_command_ready,
+                             ctx);
+    qmi_message_context_unref (message_context);
+    qmi_message_unref (message);
+    return transaction_id;
+}
+
+/*****************************************************************************/
+/* In-flight window */
+
+static void
+assert_in_flight (QmiDevice *device,
+                  guint      n_in_flight,
+                  guint      n_throttled)
+{
+    QmiDeviceStats stats;
+
+    qmi_device_get_stats (device, &stats);
+    g_assert_cmpuint (stats.n_in_flight, ==, n_in_flight);
+    g_assert_cmpuint (stats.throttled_queue_length, ==, n_throttled);
+}
+
+static void
+test_generated_core_in_flight_window (TestFixture *fixture)
+{
+    HeldContext ctx;
+    guint16     transaction_ids[4];
+    guint       i;
+
+    held_context_init (&ctx, fixture);
+    test_port_context_set_responder (fixture->ctx, (TestPortContextResponderFn) held_responder, &ctx);
+
+    /* Never more than two requests at the device, the rest sent in order
+     * as slots are freed */
+    g_object_set (fixture->device, QMI_DEVICE_MAX_IN_FLIGHT, 2, NULL);
+    for (i = 0; i < G_N_ELEMENTS (transaction_ids); i++)
+        transaction_ids[i] = held_command (&ctx, QMI_SERVICE_DMS, QMI_MESSAGE_PRIORITY_NORMAL);
+    held_wait_received (&ctx, 2);
+    assert_in_flight (fixture->device, 2, 2);
+
+    test_port_context_invoke (fixture->ctx, (GSourceFunc) held_answer_all, &ctx);
+    held_wait_received (&ctx, 4);
+    assert_in_flight (fixture->device, 2, 0);
+
+    test_port_context_invoke (fixture->ctx, (GSourceFunc) held_answer_all, &ctx);
+    test_fixture_loop_run (fixture);
+    for (i = 0; i < G_N_ELEMENTS (transaction_ids); i++)
+        g_assert_cmpuint (held_get_received (&ctx, i), ==, transaction_ids[i]);
+    assert_in_flight (fixture->device, 0, 0);
+    g_object_set (fixture->device, QMI_DEVICE_MAX_IN_FLIGHT, 0, NULL);
+
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+    held_context_clear (&ctx);
+}
+
+static void
+test_generated_core_in_flight_window_by_service (TestFixture *fixture)
+{
+    HeldContext ctx;
+    guint16     dms_first;
+    guint16     dms_second;
+    guint16     nas;
+
+    held_context_init (&ctx, fixture);
+    test_port_context_set_responder (fixture->ctx, (TestPortContextResponderFn) held_responder, &ctx);
+
+    /* A service at its limit doesn't hold back others with free slots */
+    qmi_device_set_service_max_in_flight (fixture->device, QMI_SERVICE_DMS, 1);
+    dms_first = held_command (&ctx, QMI_SERVICE_DMS, QMI_MESSAGE_PRIORITY_NORMAL);
+    dms_second = held_command (&ctx, QMI_SERVICE_DMS, QMI_MESSAGE_PRIORITY_NORMAL);
+    nas = held_command (&ctx, QMI_SERVICE_NAS, QMI_MESSAGE_PRIORITY_NORMAL);
+    held_wait_received (&ctx, 2);
+    assert_in_flight (fixture->device, 2, 1);
+    g_assert_cmpuint (held_get_received (&ctx, 0), ==, dms_first);
+    g_assert_cmpuint (held_get_received (&ctx, 1), ==, nas);
+
+    /* Removing the limit sends the waiting one right away */
+    qmi_device_set_service_max_in_flight (fixture->device, QMI_SERVICE_DMS, 0);
+    held_wait_received (&ctx, 3);
+    g_assert_cmpuint (held_get_received (&ctx, 2), ==, dms_second);
+    assert_in_flight (fixture->device, 3, 0);
+
+    test_port_context_invoke (fixture->ctx, (GSourceFunc) held_answer_all, &ctx);
+    test_fixture_loop_run (fixture);
+    assert_in_flight (fixture->device, 0, 0);
+
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+    held_context_clear (&ctx);
+}
+
+/*****************************************************************************/
+/* Priority of the requests waiting to be sent */
+
+static void
+test_generated_core_priority (TestFixture *fixture)
+{
+    HeldContext ctx;
+    guint16     expected[6];
+    guint16     low;
+    guint16     normal;
+    guint16     high;
+    guint16     low_nas;
+    guint16     high_nas;
+    guint       i;
+
+    held_context_init (&ctx, fixture);
+    test_port_context_set_responder (fixture->ctx, (TestPortContextResponderFn) held_responder, &ctx);
+
+    /* One single request at a time, so all the others wait */
+    g_object_set (fixture->device, QMI_DEVICE_MAX_IN_FLIGHT, 1, NULL);
+    expected[0] = held_command (&ctx, QMI_SERVICE_DMS, QMI_MESSAGE_PRIORITY_NORMAL);
+    held_wait_received (&ctx, 1);
+
+    /* Higher priority first, in the order they were issued within the same
+     * priority, whatever the service */
+    low = held_command (&ctx, QMI_SERVICE_DMS, QMI_MESSAGE_PRIORITY_LOW);
+    normal = held_command (&ctx, QMI_SERVICE_DMS, QMI_MESSAGE_PRIORITY_NORMAL);
+    high = held_command (&ctx, QMI_SERVICE_DMS, QMI_MESSAGE_PRIORITY_HIGH);
+    low_nas = held_command (&ctx, QMI_SERVICE_NAS, QMI_MESSAGE_PRIORITY_LOW);
+    high_nas = held_command (&ctx, QMI_SERVICE_NAS, QMI_MESSAGE_PRIORITY_HIGH);
+    assert_in_flight (fixture->device, 1, 5);
+    expected[1] = high;
+    expected[2] = high_nas;
+    expected[3] = normal;
+    expected[4] = low;
+    expected[5] = low_nas;
+
+    for (i = 1; i < G_N_ELEMENTS (expected); i++) {
+        test_port_context_invoke (fixture->ctx, (GSourceFunc) held_answer_all, &ctx);
+        held_wait_received (&ctx, i + 1);
+        assert_in_flight (fixture->device, 1, G_N_ELEMENTS (expected) - i - 1);
+    }
+    test_port_context_invoke (fixture->ctx, (GSourceFunc) held_answer_all, &ctx);
+    test_fixture_loop_run (fixture);
+
+    for (i = 0; i < G_N_ELEMENTS (expected); i++)
+        g_assert_cmpuint (held_get_received (&ctx, i), ==, expected[i]);
+    g_object_set (fixture->device, QMI_DEVICE_MAX_IN_FLIGHT, 0, NULL);
+
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+    held_context_clear (&ctx);
+}
+
+/*****************************************************************************/
+/* Requests sharing a cancellable */
+
+typedef struct {
+    HeldContext held;
+    guint       n_aborted;
+    guint       n_completed;
+} CancellableContext;
+
+static void
+cancellable_command_ready (QmiDevice          *device,
+                           GAsyncResult       *res,
+                           CancellableContext *ctx)
+{
+    QmiMessage *response;
+    GError     *error = NULL;
+
+    response = qmi_device_command_full_finish (device, res, &error);
+    if (response) {
+        g_assert_no_error (error);
+        qmi_message_unref (response);
+        ctx->n_completed++;
+    } else {
+        g_assert_error (error, QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_ABORTED);
+        g_error_free (error);
+        ctx->n_aborted++;
+    }
+}
+
+static void
+cancellable_command (CancellableContext *ctx,
+                     QmiService          service,
+                     GCancellable       *cancellable)
+{
+    QmiClient  *client;
+    QmiMessage *message;
+
+    client = ctx->held.fixture->service_info[service].client;
+    message = qmi_message_new (service,
+                               qmi_client_get_cid (client),
+                               qmi_client_get_next_transaction_id (client),
+                               0x0020);
+    ctx->held.fixture->service_info[service].transaction_id++;
+    qmi_device_command_full (ctx->held.fixture->device, message, NULL, 10, cancellable,
+                             (GAsyncReadyCallback) cancellable_command_ready,
+                             ctx);
+    qmi_message_unref (message);
+}
+
+static void
+test_generated_core_shared_cancellable (TestFixture *fixture)
+{
+    CancellableContext  ctx;
+    GCancellable       *shared;
+    GCancellable       *other;
+
+    memset (&ctx, 0, sizeof (CancellableContext));
+    held_context_init (&ctx.held, fixture);
+    test_port_context_set_responder (fixture->ctx, (TestPortContextResponderFn) held_responder, &ctx.held);
+
+    shared = g_cancellable_new ();
+    other = g_cancellable_new ();
+    cancellable_command (&ctx, QMI_SERVICE_DMS, shared);
+    cancellable_command (&ctx, QMI_SERVICE_NAS, shared);
+    cancellable_command (&ctx, QMI_SERVICE_DMS, shared);
+    cancellable_command (&ctx, QMI_SERVICE_DMS, other);
+    held_wait_received (&ctx.held, 4);
+    assert_in_flight (fixture->device, 4, 0);
+
+    /* Cancelling aborts all the requests given the cancellable, and only
+     * those */
+    g_cancellable_cancel (shared);
+    while (ctx.n_aborted < 3)
+        g_main_context_iteration (NULL, TRUE);
+    g_assert_cmpuint (ctx.n_completed, ==, 0);
+    assert_in_flight (fixture->device, 1, 0);
+
+    /* A request given the already cancelled one is aborted right away */
+    cancellable_command (&ctx, QMI_SERVICE_DMS, shared);
+    while (ctx.n_aborted < 4)
+        g_main_context_iteration (NULL, TRUE);
+    assert_in_flight (fixture->device, 1, 0);
+
+    /* The other one is still usable by new requests */
+    cancellable_command (&ctx, QMI_SERVICE_NAS, other);
+    held_wait_received (&ctx.held, 5);
+    assert_in_flight (fixture->device, 2, 0);
+
+    /* The responses to the aborted requests are just ignored */
+    test_port_context_invoke (fixture->ctx, (GSourceFunc) held_answer_all, &ctx.held);
+    while (ctx.n_completed < 2)
+        g_main_context_iteration (NULL, TRUE);
+    g_assert_cmpuint (ctx.n_aborted, ==, 4);
+    assert_in_flight (fixture->device, 0, 0);
+
+    g_object_unref (shared);
+    g_object_unref (other);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+    held_context_clear (&ctx.held);
+}
+
+/*****************************************************************************/
+/* Batched client release */
+
+typedef struct {
+    HeldContext  held;
+    GPtrArray   *clients;
+} ReleaseClientsContext;
+
+static void
+release_clients_allocate_ready (QmiDevice             *device,
+                                GAsyncResult          *res,
+                                ReleaseClientsContext *ctx)
+{
+    GError *error = NULL;
+
+    ctx->clients = qmi_device_allocate_clients_finish (device, res, NULL, &error);
+    g_assert_no_error (error);
+    g_assert (ctx->clients);
+    test_fixture_loop_stop (ctx->held.fixture);
+}
+
+/* Run in the port thread: the second release fails */
+static gboolean
+release_clients_answer (ReleaseClientsContext *ctx)
+{
+    guint i;
+
+    g_mutex_lock (&ctx->held.mutex);
+    for (i = 0; i < ctx->held.held->len; i++) {
+        QmiMessage *response;
+
+        response = qmi_message_response_new (g_ptr_array_index (ctx->held.held, i),
+                                             i == 1 ? QMI_PROTOCOL_ERROR_INVALID_CLIENT_ID : QMI_PROTOCOL_ERROR_NONE);
+        test_port_context_write (ctx->held.fixture->ctx, response->data, response->len);
+        qmi_message_unref (response);
+    }
+    g_ptr_array_set_size (ctx->held.held, 0);
+    g_mutex_unlock (&ctx->held.mutex);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+release_clients_ready (QmiDevice             *device,
+                       GAsyncResult          *res,
+                       ReleaseClientsContext *ctx)
+{
+    GPtrArray *errors = NULL;
+    GError    *error = NULL;
+
+    g_assert (!qmi_device_release_clients_finish (device, res, &errors, &error));
+    g_assert_error (error, QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_INVALID_CLIENT_ID);
+    g_error_free (error);
+
+    /* Same order as given */
+    g_assert (errors);
+    g_assert_cmpuint (errors->len, ==, 3);
+    g_assert (!g_ptr_array_index (errors, 0));
+    g_assert_error (g_ptr_array_index (errors, 1), QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_INVALID_CLIENT_ID);
+    g_assert (!g_ptr_array_index (errors, 2));
+    g_ptr_array_unref (errors);
+    test_fixture_loop_stop (ctx->held.fixture);
+}
+
+static void
+test_generated_core_release_clients (TestFixture *fixture)
+{
+    static const QmiService services[] = {
+        QMI_SERVICE_WDS,
+        QMI_SERVICE_WDS,
+        QMI_SERVICE_UIM,
     };
+    ReleaseClientsContext ctx;
+    guint8                next_cid = 0x10;
+    guint                 i;
 
-    test_port_context_set_command (fixture->ctx,
-                                   expected, G_N_ELEMENTS (expected),
-                                   response, G_N_ELEMENTS (response),
-                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+    memset (&ctx, 0, sizeof (ReleaseClientsContext));
+    held_context_init (&ctx.held, fixture);
 
-    qmi_client_dms_get_time (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
-                             (GAsyncReadyCallback) dms_get_time_ready,
-                             fixture);
+    test_port_context_set_responder (fixture->ctx, allocate_clients_responder, &next_cid);
+    qmi_device_allocate_clients (fixture->device, services, G_N_ELEMENTS (services), 3, NULL,
+                                 (GAsyncReadyCallback) release_clients_allocate_ready,
+                                 &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.clients->len, ==, G_N_ELEMENTS (services));
 
+    /* All the releases reach the port before any of them is answered */
+    test_port_context_set_responder (fixture->ctx, (TestPortContextResponderFn) held_responder, &ctx.held);
+    qmi_device_release_clients (fixture->device,
+                                (QmiClient **) ctx.clients->pdata, ctx.clients->len,
+                                QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID, 3, NULL,
+                                (GAsyncReadyCallback) release_clients_ready,
+                                &ctx);
+    held_wait_received (&ctx.held, G_N_ELEMENTS (services));
+    g_mutex_lock (&ctx.held.mutex);
+    for (i = 0; i < ctx.held.held->len; i++) {
+        QmiMessage *request = g_ptr_array_index (ctx.held.held, i);
+
+        g_assert_cmpuint (qmi_message_get_service (request), ==, QMI_SERVICE_CTL);
+        g_assert_cmpuint (qmi_message_get_message_id (request), ==, 0x0023);
+    }
+    g_mutex_unlock (&ctx.held.mutex);
+
+    test_port_context_invoke (fixture->ctx, (GSourceFunc) release_clients_answer, &ctx);
     test_fixture_loop_run (fixture);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+
+    /* Allocations and releases got a transaction ID each */
+    fixture->service_info[QMI_SERVICE_CTL].transaction_id += 2 * G_N_ELEMENTS (services);
+
+    g_ptr_array_unref (ctx.clients);
+    held_context_clear (&ctx.held);
 }
 
 /*****************************************************************************/
-/* NAS Network Scan */
+/* Devices shared within the process */
+
+#define SHARED_N_CONSUMERS 3
+
 typedef struct {
-    guint16 mcc;
-    guint16 mnc;
-    gboolean includes_pcs_digit;
-    QmiNasNetworkStatus network_status;
-    QmiNasRadioInterface rat;
-    const gchar *description;
+    TestFixture *fixture;
+    QmiDevice   *devices[SHARED_N_CONSUMERS];
+    guint        n_devices;
+    guint        n_pending;
+} SharedContext;
 
-} NetworkScanResult;
+static GByteArray *
+shared_responder (TestPortContext *port,
+                  GByteArray      *request,
+                  gpointer         user_data)
+{
+    return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+}
 
-static NetworkScanResult scan_results[] =  {
-    {
-        .mcc = 214,
-        .mnc = 1,
-        .includes_pcs_digit = FALSE,
-        .network_status = (QMI_NAS_NETWORK_STATUS_AVAILABLE |
-                           QMI_NAS_NETWORK_STATUS_ROAMING |
-                           QMI_NAS_NETWORK_STATUS_NOT_FORBIDDEN |
-                           QMI_NAS_NETWORK_STATUS_NOT_PREFERRED),
-        .rat = QMI_NAS_RADIO_INTERFACE_GSM,
-        .description = "voda ES"
-    },
-    {
-        .mcc = 214,
-        .mnc = 3,
-        .includes_pcs_digit = FALSE,
-        .network_status = (QMI_NAS_NETWORK_STATUS_AVAILABLE |
-                           QMI_NAS_NETWORK_STATUS_ROAMING |
-                           QMI_NAS_NETWORK_STATUS_NOT_FORBIDDEN |
-                           QMI_NAS_NETWORK_STATUS_NOT_PREFERRED),
-        .rat = QMI_NAS_RADIO_INTERFACE_GSM,
-        .description = "Orange"
-    },
-    {
-        .mcc = 214,
-        .mnc = 4,
-        .includes_pcs_digit = FALSE,
-        .network_status = (QMI_NAS_NETWORK_STATUS_AVAILABLE |
-                           QMI_NAS_NETWORK_STATUS_ROAMING |
-                           QMI_NAS_NETWORK_STATUS_NOT_FORBIDDEN |
-                           QMI_NAS_NETWORK_STATUS_NOT_PREFERRED),
-        .rat = QMI_NAS_RADIO_INTERFACE_UMTS,
-        .description = "YOIGO"
-    },
-    {
-        .mcc = 214,
-        .mnc = 1,
-        .includes_pcs_digit = FALSE,
-        .network_status = (QMI_NAS_NETWORK_STATUS_AVAILABLE |
-                           QMI_NAS_NETWORK_STATUS_ROAMING |
-                           QMI_NAS_NETWORK_STATUS_NOT_FORBIDDEN |
-                           QMI_NAS_NETWORK_STATUS_NOT_PREFERRED),
-        .rat = QMI_NAS_RADIO_INTERFACE_UMTS,
-        .description = "voda ES"
-    },
-    {
-        .mcc = 214,
-        .mnc = 4,
-        .includes_pcs_digit = FALSE,
-        .network_status = (QMI_NAS_NETWORK_STATUS_AVAILABLE |
-                           QMI_NAS_NETWORK_STATUS_ROAMING |
-                           QMI_NAS_NETWORK_STATUS_NOT_FORBIDDEN |
-                           QMI_NAS_NETWORK_STATUS_NOT_PREFERRED),
-        .rat = QMI_NAS_RADIO_INTERFACE_GSM,
-        .description = "YOIGO"
-    },
-    {
-        .mcc = 214,
-        .mnc = 7,
-        .includes_pcs_digit = FALSE,
-        .network_status = (QMI_NAS_NETWORK_STATUS_AVAILABLE |
-                           QMI_NAS_NETWORK_STATUS_ROAMING |
-                           QMI_NAS_NETWORK_STATUS_NOT_FORBIDDEN |
-                           QMI_NAS_NETWORK_STATUS_NOT_PREFERRED),
-        .rat = QMI_NAS_RADIO_INTERFACE_GSM,
-        .description = "Movistar"
-    },
-    {
-        .mcc = 214,
-        .mnc = 7,
-        .includes_pcs_digit = FALSE,
-        .network_status = (QMI_NAS_NETWORK_STATUS_AVAILABLE |
-                           QMI_NAS_NETWORK_STATUS_ROAMING |
-                           QMI_NAS_NETWORK_STATUS_NOT_FORBIDDEN |
-                           QMI_NAS_NETWORK_STATUS_NOT_PREFERRED),
-        .rat = QMI_NAS_RADIO_INTERFACE_UMTS,
-        .description = "Movistar"
-    },
-    {
-        .mcc = 214,
-        .mnc = 3,
-        .includes_pcs_digit = FALSE,
-        .network_status = (QMI_NAS_NETWORK_STATUS_CURRENT_SERVING |
-                           QMI_NAS_NETWORK_STATUS_ROAMING |
-                           QMI_NAS_NETWORK_STATUS_NOT_FORBIDDEN |
-                           QMI_NAS_NETWORK_STATUS_NOT_PREFERRED),
-        .rat = QMI_NAS_RADIO_INTERFACE_UMTS,
-        .description = ""
-    },
-};
+static void
+shared_device_ready (GObject       *source,
+                     GAsyncResult  *res,
+                     SharedContext *ctx)
+{
+    QmiDevice *device;
+    GError    *error = NULL;
+
+    device = qmi_device_new_shared_finish (res, &error);
+    g_assert_no_error (error);
+    g_assert (QMI_IS_DEVICE (device));
+    g_assert (qmi_device_is_open (device));
+    ctx->devices[ctx->n_devices++] = device;
+    if (--ctx->n_pending == 0)
+        test_fixture_loop_stop (ctx->fixture);
+}
 
 static void
-nas_network_scan_ready (QmiClientNas *client,
-                        GAsyncResult *res,
-                        TestFixture  *fixture)
+shared_device_get (SharedContext *ctx,
+                   GFile         *file,
+                   guint          n_consumers)
+{
+    guint i;
+
+    ctx->n_devices = 0;
+    ctx->n_pending = n_consumers;
+    for (i = 0; i < n_consumers; i++)
+        qmi_device_new_shared (file, QMI_DEVICE_OPEN_FLAGS_NONE, 5, NULL,
+                               (GAsyncReadyCallback) shared_device_ready,
+                               ctx);
+    test_fixture_loop_run (ctx->fixture);
+}
+
+static void
+test_generated_core_shared_device (TestFixture *fixture)
+{
+    SharedContext    ctx;
+    TestPortContext *port;
+    GFile           *file;
+    QmiDevice       *device;
+    gint64           deadline;
+    guint            i;
+
+    memset (&ctx, 0, sizeof (SharedContext));
+    ctx.fixture = fixture;
+
+    /* A port of its own, opened directly */
+    port = test_port_context_new_pty ();
+    test_port_context_set_responder (port, shared_responder, NULL);
+    test_port_context_start (port);
+    file = g_file_new_for_path (test_port_context_get_name (port));
+
+    /* Consumers asking while the device is being opened, and afterwards,
+     * all get the same one */
+    shared_device_get (&ctx, file, SHARED_N_CONSUMERS - 1);
+    ctx.n_pending = 1;
+    qmi_device_new_shared (file, QMI_DEVICE_OPEN_FLAGS_NONE, 5, NULL,
+                           (GAsyncReadyCallback) shared_device_ready,
+                           &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_devices, ==, SHARED_N_CONSUMERS);
+    for (i = 1; i < SHARED_N_CONSUMERS; i++)
+        g_assert (ctx.devices[i] == ctx.devices[0]);
+
+    /* Only weak references are kept by the registry: the device goes away
+     * with the last consumer */
+    device = ctx.devices[0];
+    g_object_add_weak_pointer (G_OBJECT (device), (gpointer *) &device);
+    for (i = 0; i < SHARED_N_CONSUMERS; i++)
+        g_object_unref (ctx.devices[i]);
+    deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;
+    while (device) {
+        g_assert_cmpint (g_get_monotonic_time (), <, deadline);
+        if (!g_main_context_iteration (NULL, FALSE))
+            g_usleep (1000);
+    }
+
+    /* ...and the next consumer gets a new one, open again */
+    shared_device_get (&ctx, file, 1);
+    g_assert_cmpuint (ctx.n_devices, ==, 1);
+    g_object_unref (ctx.devices[0]);
+
+    g_object_unref (file);
+    test_port_context_stop (port);
+    test_port_context_free (port);
+}
+
+/*****************************************************************************/
+/* Device groups */
+
+#define GROUP_N_PORTS 3
+
+typedef struct {
+    TestFixture    *fixture;
+    QmiDeviceGroup *group;
+    QmiClient      *client;
+} GroupContext;
+
+static GByteArray *
+group_responder (TestPortContext *port,
+                 GByteArray      *request_raw,
+                 gpointer         user_data)
+{
+    QmiMessage *request = (QmiMessage *) request_raw;
+    QmiMessage *response;
+    gsize       init_offset;
+    gsize       offset = 0;
+    guint8      service;
+
+    response = qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+    if (qmi_message_get_service (request) != QMI_SERVICE_CTL ||
+        qmi_message_get_message_id (request) != 0x0022)
+        return response;
+
+    /* Allocate CID: a single client per port is enough here */
+    init_offset = qmi_message_tlv_read_init (request, 0x01, NULL, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_read_guint8 (request, init_offset, &offset, &service, NULL));
+    init_offset = qmi_message_tlv_write_init (response, 0x01, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_guint8 (response, service, NULL));
+    g_assert (qmi_message_tlv_write_guint8 (response, 1, NULL));
+    g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+    return response;
+}
+
+static void
+group_new_ready (GObject      *source,
+                 GAsyncResult *res,
+                 GroupContext *ctx)
+{
+    GError *error = NULL;
+
+    ctx->group = qmi_device_group_new_finish (res, &error);
+    g_assert_no_error (error);
+    g_assert (QMI_IS_DEVICE_GROUP (ctx->group));
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+group_allocate_client_ready (QmiDeviceGroup *group,
+                             GAsyncResult   *res,
+                             GroupContext   *ctx)
+{
+    GError *error = NULL;
+
+    ctx->client = qmi_device_group_allocate_client_finish (group, res, &error);
+    g_assert_no_error (error);
+    g_assert (QMI_IS_CLIENT (ctx->client));
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+test_generated_core_device_group (TestFixture *fixture)
+{
+    GroupContext     ctx;
+    TestPortContext *ports[GROUP_N_PORTS];
+    GFile           *files[GROUP_N_PORTS + 1];
+    QmiDevice       *devices[GROUP_N_PORTS];
+    guint            i;
+
+    memset (&ctx, 0, sizeof (GroupContext));
+    ctx.fixture = fixture;
+
+    /* Ports of their own, plus one that can't be opened, in the middle */
+    for (i = 0; i < GROUP_N_PORTS; i++) {
+        ports[i] = test_port_context_new_pty ();
+        test_port_context_set_responder (ports[i], group_responder, NULL);
+        test_port_context_start (ports[i]);
+    }
+    files[0] = g_file_new_for_path (test_port_context_get_name (ports[0]));
+    files[1] = g_file_new_for_path ("/dev/nonexistent-qmi-port");
+    files[2] = g_file_new_for_path (test_port_context_get_name (ports[1]));
+    files[3] = g_file_new_for_path (test_port_context_get_name (ports[2]));
+
+    qmi_device_group_new (files, G_N_ELEMENTS (files), QMI_DEVICE_OPEN_FLAGS_NONE, 5, NULL,
+                          (GAsyncReadyCallback) group_new_ready,
+                          &ctx);
+    test_fixture_loop_run (fixture);
+
+    /* The failed port is skipped, and the order of the other ones kept */
+    g_assert_cmpuint (qmi_device_group_get_n_devices (ctx.group), ==, GROUP_N_PORTS);
+    for (i = 0; i < GROUP_N_PORTS; i++) {
+        devices[i] = qmi_device_group_peek_device (ctx.group, i);
+        g_assert (qmi_device_is_open (devices[i]));
+        g_assert_cmpstr (qmi_device_get_path (devices[i]), ==, test_port_context_get_name (ports[i]));
+    }
+
+    /* Slow services all go to the last device */
+    g_assert (qmi_device_group_peek_service_device (ctx.group, QMI_SERVICE_UIM) == devices[2]);
+    g_assert (qmi_device_group_peek_service_device (ctx.group, QMI_SERVICE_PDC) == devices[2]);
+    g_assert (qmi_device_group_peek_service_device (ctx.group, QMI_SERVICE_PBM) == devices[2]);
+    g_assert (qmi_device_group_peek_service_device (ctx.group, QMI_SERVICE_WMS) == devices[2]);
+
+    /* The other ones are spread over the remaining devices, and stay bound */
+    g_assert (qmi_device_group_peek_service_device (ctx.group, QMI_SERVICE_NAS) == devices[0]);
+    g_assert (qmi_device_group_peek_service_device (ctx.group, QMI_SERVICE_WDS) == devices[1]);
+    g_assert (qmi_device_group_peek_service_device (ctx.group, QMI_SERVICE_DMS) == devices[0]);
+    g_assert (qmi_device_group_peek_service_device (ctx.group, QMI_SERVICE_VOICE) == devices[1]);
+    g_assert (qmi_device_group_peek_service_device (ctx.group, QMI_SERVICE_NAS) == devices[0]);
+
+    /* An explicit binding overrides the selection, and releases the load
+     * on the previous device */
+    qmi_device_group_set_service_device (ctx.group, QMI_SERVICE_NAS, 2);
+    g_assert (qmi_device_group_peek_service_device (ctx.group, QMI_SERVICE_NAS) == devices[2]);
+    g_assert (qmi_device_group_peek_service_device (ctx.group, QMI_SERVICE_LOC) == devices[0]);
+
+    /* Clients are allocated in the device bound to their service */
+    qmi_device_group_allocate_client (ctx.group, QMI_SERVICE_WDS, QMI_CID_NONE, 5, NULL,
+                                      (GAsyncReadyCallback) group_allocate_client_ready,
+                                      &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert ((QmiDevice *) qmi_client_peek_device (ctx.client) == devices[1]);
+    g_assert_cmpuint (qmi_client_get_service (ctx.client), ==, QMI_SERVICE_WDS);
+    g_object_unref (ctx.client);
+
+    g_object_unref (ctx.group);
+    for (i = 0; i < G_N_ELEMENTS (files); i++)
+        g_object_unref (files[i]);
+    for (i = 0; i < GROUP_N_PORTS; i++) {
+        test_port_context_stop (ports[i]);
+        test_port_context_free (ports[i]);
+    }
+}
+
+/*****************************************************************************/
+/* Dedicated I/O thread */
+
+#define IO_THREAD_N_REQUESTS 3
+
+typedef struct {
+    HeldContext   held;
+    QmiDevice    *device;
+    /* The thread issuing the requests, with its own context */
+    GThread      *caller_thread;
+    GMainContext *caller_context;
+    GMutex        mutex;
+    GCond         cond;
+    gboolean      requests_held;
+    guint16       next_transaction_id;
+    guint         n_pending;
+    guint         n_ok;
+    guint         n_closed;
+} IoThreadContext;
+
+static GByteArray *
+io_thread_responder (TestPortContext *port,
+                     GByteArray      *request,
+                     IoThreadContext *ctx)
+{
+    /* Internal proxy open */
+    if (qmi_message_get_service ((QmiMessage *)request) == QMI_SERVICE_CTL)
+        return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+
+    return held_responder (port, request, &ctx->held);
+}
+
+static void
+io_thread_device_new_ready (GObject         *source,
+                            GAsyncResult    *res,
+                            IoThreadContext *ctx)
+{
+    GError *error = NULL;
+
+    ctx->device = qmi_device_new_finish (res, &error);
+    g_assert_no_error (error);
+    test_fixture_loop_stop (ctx->held.fixture);
+}
+
+static void
+io_thread_device_open_ready (QmiDevice       *device,
+                             GAsyncResult    *res,
+                             IoThreadContext *ctx)
+{
+    GError *error = NULL;
+
+    g_assert (qmi_device_open_finish (device, res, &error));
+    g_assert_no_error (error);
+    test_fixture_loop_stop (ctx->held.fixture);
+}
+
+static void
+io_thread_command_ready (QmiDevice       *device,
+                         GAsyncResult    *res,
+                         IoThreadContext *ctx)
+{
+    QmiMessage *response;
+    GError     *error = NULL;
+
+    /* Completed in the context of the caller, not in the I/O thread nor in
+     * the one where the device was opened */
+    g_assert (g_thread_self () == ctx->caller_thread);
+    g_assert (g_main_context_is_owner (ctx->caller_context));
+    g_assert (g_main_context_get_thread_default () == ctx->caller_context);
+
+    response = qmi_device_command_full_finish (device, res, &error);
+    if (response) {
+        g_assert (qmi_message_is_response (response));
+        qmi_message_unref (response);
+        ctx->n_ok++;
+    } else {
+        g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE);
+        g_error_free (error);
+        ctx->n_closed++;
+    }
+    ctx->n_pending--;
+}
+
+static void
+io_thread_issue_requests (IoThreadContext *ctx)
+{
+    guint i;
+
+    for (i = 0; i < IO_THREAD_N_REQUESTS; i++) {
+        QmiMessage *message;
+
+        /* No client allocated, just a CID */
+        message = qmi_message_new (QMI_SERVICE_DMS, 1, ctx->next_transaction_id++, 0x0020);
+        ctx->n_pending++;
+        qmi_device_command_full (ctx->device, message, NULL, 10, NULL,
+                                 (GAsyncReadyCallback) io_thread_command_ready,
+                                 ctx);
+        qmi_message_unref (message);
+    }
+}
+
+static gpointer
+io_thread_caller_func (IoThreadContext *ctx)
+{
+    ctx->caller_thread = g_thread_self ();
+    ctx->caller_context = g_main_context_new ();
+    g_main_context_push_thread_default (ctx->caller_context);
+
+    /* Replies read in the I/O thread */
+    io_thread_issue_requests (ctx);
+    held_wait_received (&ctx->held, IO_THREAD_N_REQUESTS);
+    test_port_context_invoke (ctx->held.fixture->ctx, (GSourceFunc) held_answer_all, &ctx->held);
+    while (ctx->n_pending)
+        g_main_context_iteration (ctx->caller_context, TRUE);
+    g_assert_cmpuint (ctx->n_ok, ==, IO_THREAD_N_REQUESTS);
+
+    /* Requests still waiting for their replies when the device is closed
+     * from the main thread */
+    io_thread_issue_requests (ctx);
+    held_wait_received (&ctx->held, 2 * IO_THREAD_N_REQUESTS);
+    g_mutex_lock (&ctx->mutex);
+    ctx->requests_held = TRUE;
+    g_cond_signal (&ctx->cond);
+    g_mutex_unlock (&ctx->mutex);
+    while (ctx->n_pending)
+        g_main_context_iteration (ctx->caller_context, TRUE);
+    g_assert_cmpuint (ctx->n_closed, ==, IO_THREAD_N_REQUESTS);
+
+    g_main_context_pop_thread_default (ctx->caller_context);
+    g_main_context_unref (ctx->caller_context);
+    return NULL;
+}
+
+static void
+test_generated_core_io_thread (TestFixture *fixture)
+{
+    IoThreadContext  ctx;
+    GFile           *file;
+    GThread         *thread;
+
+    memset (&ctx, 0, sizeof (IoThreadContext));
+    held_context_init (&ctx.held, fixture);
+    g_mutex_init (&ctx.mutex);
+    g_cond_init (&ctx.cond);
+    ctx.next_transaction_id = 1;
+    test_port_context_set_responder (fixture->ctx, (TestPortContextResponderFn) io_thread_responder, &ctx);
+
+    /* A second device on the same port, with its own I/O thread */
+    file = g_file_new_for_path (fixture->path);
+    g_async_initable_new_async (QMI_TYPE_DEVICE,
+                                G_PRIORITY_DEFAULT,
+                                NULL,
+                                (GAsyncReadyCallback) io_thread_device_new_ready,
+                                &ctx,
+                                QMI_DEVICE_FILE,          file,
+                                QMI_DEVICE_NO_FILE_CHECK, TRUE,
+                                QMI_DEVICE_PROXY_PATH,    fixture->path,
+                                NULL);
+    g_object_unref (file);
+    test_fixture_loop_run (fixture);
+
+    qmi_device_open (ctx.device, QMI_DEVICE_OPEN_FLAGS_PROXY | QMI_DEVICE_OPEN_FLAGS_IO_THREAD, 5, NULL,
+                     (GAsyncReadyCallback) io_thread_device_open_ready,
+                     &ctx);
+    test_fixture_loop_run (fixture);
+
+    thread = g_thread_new ("caller", (GThreadFunc) io_thread_caller_func, &ctx);
+
+    g_mutex_lock (&ctx.mutex);
+    while (!ctx.requests_held)
+        g_cond_wait (&ctx.cond, &ctx.mutex);
+    g_mutex_unlock (&ctx.mutex);
+    g_assert (qmi_device_close (ctx.device, NULL));
+
+    g_thread_join (thread);
+    g_object_unref (ctx.device);
+
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+    g_cond_clear (&ctx.cond);
+    g_mutex_clear (&ctx.mutex);
+    held_context_clear (&ctx.held);
+}
+
+/*****************************************************************************/
+/* io_uring engine, and the default one when it's unavailable at runtime */
+
+#define IO_URING_N_REQUESTS 16
+
+typedef struct {
+    TestFixture *fixture;
+    QmiDevice   *device;
+    guint        n_pending;
+    guint        n_ok;
+} IoUringContext;
+
+static GByteArray *
+io_uring_responder (TestPortContext *port,
+                    GByteArray      *request,
+                    IoUringContext  *ctx)
+{
+    /* Internal proxy open included */
+    return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+}
+
+static void
+io_uring_device_new_ready (GObject        *source,
+                           GAsyncResult   *res,
+                           IoUringContext *ctx)
+{
+    GError *error = NULL;
+
+    ctx->device = qmi_device_new_finish (res, &error);
+    g_assert_no_error (error);
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+io_uring_device_open_ready (QmiDevice      *device,
+                            GAsyncResult   *res,
+                            IoUringContext *ctx)
+{
+    GError *error = NULL;
+
+    g_assert (qmi_device_open_finish (device, res, &error));
+    g_assert_no_error (error);
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+io_uring_command_ready (QmiDevice      *device,
+                        GAsyncResult   *res,
+                        IoUringContext *ctx)
+{
+    QmiMessage *response;
+    GError     *error = NULL;
+
+    response = qmi_device_command_full_finish (device, res, &error);
+    g_assert_no_error (error);
+    g_assert (qmi_message_is_response (response));
+    qmi_message_unref (response);
+    ctx->n_ok++;
+    if (!--ctx->n_pending)
+        test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+io_uring_run (TestFixture *fixture,
+              gboolean     disabled)
+{
+    IoUringContext  ctx;
+    GFile          *file;
+    guint           i;
+
+    memset (&ctx, 0, sizeof (IoUringContext));
+    ctx.fixture = fixture;
+    test_port_context_set_responder (fixture->ctx, (TestPortContextResponderFn) io_uring_responder, &ctx);
+
+    /* A second device on the same port, requesting the engine */
+    file = g_file_new_for_path (fixture->path);
+    g_async_initable_new_async (QMI_TYPE_DEVICE,
+                                G_PRIORITY_DEFAULT,
+                                NULL,
+                                (GAsyncReadyCallback) io_uring_device_new_ready,
+                                &ctx,
+                                QMI_DEVICE_FILE,          file,
+                                QMI_DEVICE_NO_FILE_CHECK, TRUE,
+                                QMI_DEVICE_PROXY_PATH,    fixture->path,
+                                QMI_DEVICE_IO_URING,      TRUE,
+                                NULL);
+    g_object_unref (file);
+    test_fixture_loop_run (fixture);
+
+    /* The engine is set up when the device is opened, and without a ring it
+     * falls back to the default one */
+    if (disabled) {
+        g_setenv ("LIBQMI_DISABLE_IO_URING", "1", TRUE);
+        g_test_expect_message ("Qmi", G_LOG_LEVEL_DEBUG, "*io_uring engine unavailable, using the default one*");
+    }
+    qmi_device_open (ctx.device, QMI_DEVICE_OPEN_FLAGS_PROXY, 5, NULL,
+                     (GAsyncReadyCallback) io_uring_device_open_ready,
+                     &ctx);
+    test_fixture_loop_run (fixture);
+    if (disabled) {
+        g_test_assert_expected_messages ();
+        g_unsetenv ("LIBQMI_DISABLE_IO_URING");
+    }
+
+    /* All written together and read back, whatever the engine */
+    for (i = 0; i < IO_URING_N_REQUESTS; i++) {
+        QmiMessage *message;
+
+        message = qmi_message_new (QMI_SERVICE_DMS, 1, i + 1, 0x0020);
+        ctx.n_pending++;
+        qmi_device_command_full (ctx.device, message, NULL, 10, NULL,
+                                 (GAsyncReadyCallback) io_uring_command_ready,
+                                 &ctx);
+        qmi_message_unref (message);
+    }
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_ok, ==, IO_URING_N_REQUESTS);
+
+    g_assert (qmi_device_close (ctx.device, NULL));
+    g_object_unref (ctx.device);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+}
+
+static void
+test_generated_core_io_uring (TestFixture *fixture)
+{
+    io_uring_run (fixture, FALSE);
+}
+
+static void
+test_generated_core_io_uring_fallback (TestFixture *fixture)
+{
+    io_uring_run (fixture, TRUE);
+}
+
+/*****************************************************************************/
+/* Output queue, with the port not reading */
+
+/* Large enough so that a few of them fill the socket buffers */
+#define OUTPUT_QUEUE_LARGE_TLV_SIZE 60000
+#define OUTPUT_QUEUE_N_LARGE        8
+
+typedef struct {
+    TestFixture *fixture;
+    GMutex       mutex;
+    GCond        cond;
+    gboolean     blocked;
+    gboolean     released;
+    guint        n_requests;
+    guint        n_pending;
+    guint        n_ok;
+    guint        n_aborted;
+    guint        n_closed;
+    guint        n_rejected;
+} OutputQueueContext;
+
+static gboolean
+output_queue_block (OutputQueueContext *ctx)
+{
+    /* Nothing is read while the port thread is kept here */
+    g_mutex_lock (&ctx->mutex);
+    ctx->blocked = TRUE;
+    g_cond_signal (&ctx->cond);
+    while (!ctx->released)
+        g_cond_wait (&ctx->cond, &ctx->mutex);
+    ctx->blocked = FALSE;
+    g_cond_signal (&ctx->cond);
+    g_mutex_unlock (&ctx->mutex);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+output_queue_block_port (OutputQueueContext *ctx)
+{
+    test_port_context_invoke (ctx->fixture->ctx, (GSourceFunc) output_queue_block, ctx);
+    g_mutex_lock (&ctx->mutex);
+    while (!ctx->blocked)
+        g_cond_wait (&ctx->cond, &ctx->mutex);
+    g_mutex_unlock (&ctx->mutex);
+}
+
+static void
+output_queue_release_port (OutputQueueContext *ctx)
+{
+    g_mutex_lock (&ctx->mutex);
+    ctx->released = TRUE;
+    g_cond_signal (&ctx->cond);
+    while (ctx->blocked)
+        g_cond_wait (&ctx->cond, &ctx->mutex);
+    g_mutex_unlock (&ctx->mutex);
+}
+
+static GByteArray *
+output_queue_responder (TestPortContext    *port,
+                        GByteArray         *request,
+                        OutputQueueContext *ctx)
+{
+    g_assert_cmpuint (qmi_message_get_service ((QmiMessage *)request), ==, QMI_SERVICE_DMS);
+    ctx->n_requests++;
+    return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+}
+
+static GByteArray *
+output_queue_drop_responder (TestPortContext *port,
+                             GByteArray      *request,
+                             gpointer         user_data)
+{
+    /* Nowhere to write the response once the device is closed */
+    return NULL;
+}
+
+static void
+output_queue_command_ready (QmiDevice          *device,
+                            GAsyncResult       *res,
+                            OutputQueueContext *ctx)
+{
+    QmiMessage *response;
+    GError     *error = NULL;
+
+    response = qmi_device_command_full_finish (device, res, &error);
+    if (response) {
+        g_assert (qmi_message_is_response (response));
+        qmi_message_unref (response);
+        ctx->n_ok++;
+    } else if (g_error_matches (error, QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_ABORTED)) {
+        /* Never written */
+        ctx->n_aborted++;
+    } else if (g_error_matches (error, QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE) &&
+               strstr (error->message, "closed")) {
+        /* Written, no response */
+        ctx->n_closed++;
+    } else {
+        /* Queue full */
+        g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE);
+        ctx->n_rejected++;
+    }
+    g_clear_error (&error);
+
+    if (--ctx->n_pending == 0)
+        test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+output_queue_command (OutputQueueContext *ctx,
+                      gboolean            large)
+{
+    QmiClient  *client;
+    QmiMessage *message;
+
+    client = ctx->fixture->service_info[QMI_SERVICE_DMS].client;
+    message = qmi_message_new (QMI_SERVICE_DMS, qmi_client_get_cid (client), qmi_client_get_next_transaction_id (client), 0x0025);
+    if (large) {
+        guint8 *data;
+
+        data = g_malloc0 (OUTPUT_QUEUE_LARGE_TLV_SIZE);
+        g_assert (qmi_message_add_raw_tlv (message, 0x10, data, OUTPUT_QUEUE_LARGE_TLV_SIZE, NULL));
+        g_free (data);
+    }
+
+    ctx->n_pending++;
+    qmi_device_command_full (ctx->fixture->device, message, NULL, 10, NULL,
+                             (GAsyncReadyCallback) output_queue_command_ready,
+                             ctx);
+    qmi_message_unref (message);
+    ctx->fixture->service_info[QMI_SERVICE_DMS].transaction_id++;
+}
+
+static guint
+output_queue_get_length (OutputQueueContext *ctx)
+{
+    QmiDeviceStats stats;
+
+    qmi_device_get_stats (ctx->fixture->device, &stats);
+    return stats.output_queue_length;
+}
+
+/* Fills the socket buffers, so that the next messages wait in the queue */
+static void
+output_queue_fill (OutputQueueContext *ctx)
+{
+    guint i;
+
+    output_queue_block_port (ctx);
+    for (i = 0; i < OUTPUT_QUEUE_N_LARGE; i++)
+        output_queue_command (ctx, TRUE);
+    g_assert_cmpuint (output_queue_get_length (ctx), >, 0);
+}
+
+static void
+test_generated_core_output_queue (TestFixture *fixture)
+{
+    OutputQueueContext ctx = { fixture };
+    QmiDeviceStats     stats;
+    guint              n_issued;
+    guint              length;
+
+    g_mutex_init (&ctx.mutex);
+    g_cond_init (&ctx.cond);
+    test_port_context_set_responder (fixture->ctx, (TestPortContextResponderFn) output_queue_responder, &ctx);
+
+    /* Requests are queued without blocking while the port isn't reading,
+     * until the queue is full and new ones are rejected right away */
+    output_queue_fill (&ctx);
+    n_issued = OUTPUT_QUEUE_N_LARGE;
+    do {
+        length = output_queue_get_length (&ctx);
+        output_queue_command (&ctx, FALSE);
+        n_issued++;
+        g_assert_cmpuint (n_issued, <, 1000);
+    } while (output_queue_get_length (&ctx) > length);
+
+    /* Once the port reads again, all the queued ones are written and
+     * answered */
+    output_queue_release_port (&ctx);
+    test_fixture_loop_run (fixture);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+
+    g_assert_cmpuint (ctx.n_rejected, ==, 1);
+    g_assert_cmpuint (ctx.n_ok, ==, n_issued - 1);
+    g_assert_cmpuint (ctx.n_requests, ==, n_issued - 1);
+    qmi_device_get_stats (fixture->device, &stats);
+    g_assert_cmpuint (stats.output_queue_length, ==, 0);
+
+    g_cond_clear (&ctx.cond);
+    g_mutex_clear (&ctx.mutex);
+}
+
+static void
+test_generated_core_output_queue_close (TestFixture *fixture)
+{
+    OutputQueueContext ctx = { fixture };
+    guint              i;
+
+    g_mutex_init (&ctx.mutex);
+    g_cond_init (&ctx.cond);
+    test_port_context_set_responder (fixture->ctx, (TestPortContextResponderFn) output_queue_responder, &ctx);
+
+    output_queue_fill (&ctx);
+    for (i = 0; i < 4; i++)
+        output_queue_command (&ctx, FALSE);
+
+    /* Closing completes all of them right away, without waiting for their
+     * timeouts: those not written yet as aborted */
+    g_assert (qmi_device_close (fixture->device, NULL));
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_ok, ==, 0);
+    g_assert_cmpuint (ctx.n_rejected, ==, 0);
+    g_assert_cmpuint (ctx.n_aborted, >=, 4);
+    g_assert_cmpuint (ctx.n_aborted + ctx.n_closed, ==, OUTPUT_QUEUE_N_LARGE + 4);
+
+    test_port_context_set_responder (fixture->ctx, output_queue_drop_responder, NULL);
+    output_queue_release_port (&ctx);
+    g_cond_clear (&ctx.cond);
+    g_mutex_clear (&ctx.mutex);
+
+    /* No connection left to release the clients */
+    g_clear_object (&fixture->device);
+}
+
+/*****************************************************************************/
+/* Data received along with a hangup */
+
+typedef struct {
+    TestFixture *fixture;
+    GMutex       mutex;
+    GCond        cond;
+    gboolean     hung_up;
+    guint        n_indications;
+    gboolean     removed;
+} HangupContext;
+
+static gboolean
+hangup_write_and_close (HangupContext *ctx)
+{
+    QmiMessage *indication;
+
+    /* WDS Event Report, broadcast. There is no indication constructor, so
+     * just set the flag in the QMI service header of a new request */
+    indication = qmi_message_new (QMI_SERVICE_WDS, QMI_CID_BROADCAST, 0, 0x0001);
+    ((GByteArray *) indication)->data[6] |= 0x04;
+    test_port_context_write (ctx->fixture->ctx, indication->data, indication->len);
+    qmi_message_unref (indication);
+    test_port_context_close_clients (ctx->fixture->ctx);
+
+    g_mutex_lock (&ctx->mutex);
+    ctx->hung_up = TRUE;
+    g_cond_signal (&ctx->cond);
+    g_mutex_unlock (&ctx->mutex);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+hangup_indication_cb (QmiDevice     *device,
+                      GByteArray    *indication,
+                      HangupContext *ctx)
+{
+    /* Reported before the removal */
+    g_assert (!ctx->removed);
+    ctx->n_indications++;
+}
+
+static void
+hangup_removed_cb (QmiDevice     *device,
+                   HangupContext *ctx)
+{
+    ctx->removed = TRUE;
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+test_generated_core_hangup_with_data (TestFixture *fixture)
+{
+    HangupContext ctx = { fixture };
+
+    g_mutex_init (&ctx.mutex);
+    g_cond_init (&ctx.cond);
+    g_signal_connect (fixture->device, QMI_DEVICE_SIGNAL_INDICATION, G_CALLBACK (hangup_indication_cb), &ctx);
+    g_signal_connect (fixture->device, QMI_DEVICE_SIGNAL_REMOVED, G_CALLBACK (hangup_removed_cb), &ctx);
+
+    /* Both the indication and the hangup are already there when the device
+     * wakes up, so they are read in the same input callback */
+    test_port_context_invoke (fixture->ctx, (GSourceFunc) hangup_write_and_close, &ctx);
+    g_mutex_lock (&ctx.mutex);
+    while (!ctx.hung_up)
+        g_cond_wait (&ctx.cond, &ctx.mutex);
+    g_mutex_unlock (&ctx.mutex);
+
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_indications, ==, 1);
+    g_assert (ctx.removed);
+
+    g_signal_handlers_disconnect_by_data (fixture->device, &ctx);
+    g_cond_clear (&ctx.cond);
+    g_mutex_clear (&ctx.mutex);
+
+    /* No connection left to release the clients */
+    g_assert (qmi_device_close (fixture->device, NULL));
+    g_clear_object (&fixture->device);
+}
+
+/*****************************************************************************/
+/* Low-power mode */
+
+static GByteArray *
+low_power_responder (TestPortContext *ctx,
+                     GByteArray      *request,
+                     gpointer         user_data)
+{
+    guint8 *expected = user_data;
+    guint8  tlv_type;
+
+    g_assert_cmpuint (qmi_message_get_service ((QmiMessage *)request), ==, QMI_SERVICE_DMS);
+    g_assert_cmpuint (qmi_message_get_message_id ((QmiMessage *)request), ==, 0x0001);
+
+    /* Power state and PIN state reporting */
+    for (tlv_type = 0x10; tlv_type <= 0x12; tlv_type += 2) {
+        gsize  init_offset;
+        gsize  offset = 0;
+        guint8 value;
+
+        init_offset = qmi_message_tlv_read_init ((QmiMessage *)request, tlv_type, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint8 ((QmiMessage *)request, init_offset, &offset, &value, NULL));
+        g_assert_cmpuint (value, ==, *expected);
+    }
+
+    return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+}
+
+static void
+low_power_command_ready (QmiDevice    *device,
+                         GAsyncResult *res,
+                         TestFixture  *fixture)
+{
+    QmiMessage *response;
+    GError     *error = NULL;
+
+    response = qmi_device_command_full_finish (device, res, &error);
+    g_assert_no_error (error);
+    g_assert (response);
+    qmi_message_unref (response);
+    test_fixture_loop_stop (fixture);
+}
+
+static void
+low_power_ready (QmiDevice    *device,
+                 GAsyncResult *res,
+                 TestFixture  *fixture)
+{
+    GError *error = NULL;
+
+    g_assert (qmi_device_set_low_power_finish (device, res, &error));
+    g_assert_no_error (error);
+    test_fixture_loop_stop (fixture);
+}
+
+static void
+test_generated_core_low_power (TestFixture *fixture)
+{
+    QmiClient  *client;
+    QmiMessage *request;
+    guint8      expected = 1;
+
+    /* Registration sent by the client, with the reports enabled */
+    client = fixture->service_info[QMI_SERVICE_DMS].client;
+    request = qmi_message_new (QMI_SERVICE_DMS, qmi_client_get_cid (client), qmi_client_get_next_transaction_id (client), 0x0001);
+    g_assert (qmi_message_add_raw_tlv (request, 0x10, &expected, 1, NULL));
+    g_assert (qmi_message_add_raw_tlv (request, 0x12, &expected, 1, NULL));
+
+    test_port_context_set_responder (fixture->ctx, low_power_responder, &expected);
+    qmi_device_command_full (fixture->device, request, NULL, 3, NULL,
+                             (GAsyncReadyCallback) low_power_command_ready,
+                             fixture);
+    test_fixture_loop_run (fixture);
+    qmi_message_unref (request);
+
+    /* Disabled */
+    expected = 0;
+    qmi_device_set_low_power (fixture->device, TRUE, NULL,
+                              (GAsyncReadyCallback) low_power_ready,
+                              fixture);
+    test_fixture_loop_run (fixture);
+
+    /* Already in low-power mode, nothing sent */
+    qmi_device_set_low_power (fixture->device, TRUE, NULL,
+                              (GAsyncReadyCallback) low_power_ready,
+                              fixture);
+    test_fixture_loop_run (fixture);
+
+    /* Restored */
+    expected = 1;
+    qmi_device_set_low_power (fixture->device, FALSE, NULL,
+                              (GAsyncReadyCallback) low_power_ready,
+                              fixture);
+    test_fixture_loop_run (fixture);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+
+    /* Three requests got a transaction ID each */
+    fixture->service_info[QMI_SERVICE_DMS].transaction_id += 3;
+}
+
+/*****************************************************************************/
+/* DMS Get IDs */
+
+static void
+dms_get_ids_ready (QmiClientDms *client,
+                   GAsyncResult *res,
+                   TestFixture  *fixture)
+{
+    QmiMessageDmsGetIdsOutput *output;
+    GError *error = NULL;
+    gboolean st;
+    const gchar *str;
+
+    output = qmi_client_dms_get_ids_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+
+    st = qmi_message_dms_get_ids_output_get_result (output, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+
+    /* [/dev/cdc-wdm3] Device IDs retrieved:
+     * 	 ESN: '80997874'
+     * 	IMEI: '359225050039973'
+     * 	MEID: '35922505003997' */
+    st = qmi_message_dms_get_ids_output_get_esn (output, &str, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+    g_assert_cmpstr (str, ==, "80997874");
+
+    st = qmi_message_dms_get_ids_output_get_imei (output, &str, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+    g_assert_cmpstr (str, ==, "359225050039973");
+
+    st = qmi_message_dms_get_ids_output_get_meid (output, &str, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+    g_assert_cmpstr (str, ==, "35922505003997");
+
+    qmi_message_dms_get_ids_output_unref (output);
+
+    test_fixture_loop_stop (fixture);
+}
+
+static void
+test_generated_dms_get_ids (TestFixture *fixture)
+{
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x02, 0x01,
+        0x00, 0xFF, 0xFF, 0x25, 0x00, 0x00, 0x00
+    };
+    guint8 response[] = {
+        0x01,
+        0x45, 0x00, 0x80, 0x02, 0x01,
+        0x02, 0xFF, 0xFF, 0x25, 0x00, 0x39, 0x00, 0x02,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x13, 0x01,
+        0x00, 0x42, 0x12, 0x0E, 0x00, 0x33, 0x35, 0x39,
+        0x32, 0x32, 0x35, 0x30, 0x35, 0x30, 0x30, 0x33,
+        0x39, 0x39, 0x37, 0x10, 0x08, 0x00, 0x38, 0x30,
+        0x39, 0x39, 0x37, 0x38, 0x37, 0x34, 0x11, 0x0F,
+        0x00, 0x33, 0x35, 0x39, 0x32, 0x32, 0x35, 0x30,
+        0x35, 0x30, 0x30, 0x33, 0x39, 0x39, 0x37, 0x33
+    };
+
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   response, G_N_ELEMENTS (response),
+                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
+                            (GAsyncReadyCallback) dms_get_ids_ready,
+                            fixture);
+    test_fixture_loop_run (fixture);
+}
+
+/*****************************************************************************/
+/* DMS Get IDs, driven from an external event loop */
+
+static void
+external_loop_dms_get_ids_ready (QmiClientDms *client,
+                                 GAsyncResult *res,
+                                 gboolean     *done)
+{
+    QmiMessageDmsGetIdsOutput *output;
+    GError *error = NULL;
+    const gchar *str;
+
+    output = qmi_client_dms_get_ids_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+    g_assert (qmi_message_dms_get_ids_output_get_imei (output, &str, &error));
+    g_assert_no_error (error);
+    g_assert_cmpstr (str, ==, "359225050039973");
+    qmi_message_dms_get_ids_output_unref (output);
+
+    *done = TRUE;
+}
+
+static void
+test_generated_dms_get_ids_external_loop (TestFixture *fixture)
+{
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x02, 0x01,
+        0x00, 0xFF, 0xFF, 0x25, 0x00, 0x00, 0x00
+    };
+    guint8 response[] = {
+        0x01,
+        0x45, 0x00, 0x80, 0x02, 0x01,
+        0x02, 0xFF, 0xFF, 0x25, 0x00, 0x39, 0x00, 0x02,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x13, 0x01,
+        0x00, 0x42, 0x12, 0x0E, 0x00, 0x33, 0x35, 0x39,
+        0x32, 0x32, 0x35, 0x30, 0x35, 0x30, 0x30, 0x33,
+        0x39, 0x39, 0x37, 0x10, 0x08, 0x00, 0x38, 0x30,
+        0x39, 0x39, 0x37, 0x38, 0x37, 0x34, 0x11, 0x0F,
+        0x00, 0x33, 0x35, 0x39, 0x32, 0x32, 0x35, 0x30,
+        0x35, 0x30, 0x30, 0x33, 0x39, 0x39, 0x37, 0x33
+    };
+    GPollFD  fds[16];
+    gboolean done = FALSE;
+
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   response, G_N_ELEMENTS (response),
+                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
+                            (GAsyncReadyCallback) external_loop_dms_get_ids_ready,
+                            &done);
+
+    /* Plain poll() loop, no GMainLoop */
+    while (!done) {
+        gint   n_fds;
+        gint64 deadline;
+        gint   timeout = -1;
+
+        n_fds = qmi_device_query (fixture->device, fds, G_N_ELEMENTS (fds), &deadline);
+        g_assert_cmpint (n_fds, <=, G_N_ELEMENTS (fds));
+        if (deadline >= 0)
+            timeout = (gint) MAX (0, (deadline - g_get_monotonic_time () + 999) / 1000);
+        g_assert_cmpint (g_poll (fds, n_fds, timeout), >=, 0);
+        qmi_device_dispatch (fixture->device, fds, n_fds);
+    }
+}
+
+/*****************************************************************************/
+/* DMS Get IDs, coalesced */
+
+typedef struct {
+    TestFixture *fixture;
+    guint        n_pending;
+} CoalescedContext;
+
+static void
+coalesced_dms_get_ids_ready (QmiClientDms     *client,
+                             GAsyncResult     *res,
+                             CoalescedContext *ctx)
+{
+    QmiMessageDmsGetIdsOutput *output;
+    GError *error = NULL;
+    gboolean st;
+    const gchar *str;
+
+    output = qmi_client_dms_get_ids_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+
+    st = qmi_message_dms_get_ids_output_get_esn (output, &str, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+    g_assert_cmpstr (str, ==, "80997874");
+
+    qmi_message_dms_get_ids_output_unref (output);
+
+    g_assert_cmpuint (ctx->n_pending, >, 0);
+    if (--ctx->n_pending == 0)
+        test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+test_generated_dms_get_ids_coalesced (TestFixture *fixture)
+{
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x02, 0x01,
+        0x00, 0xFF, 0xFF, 0x25, 0x00, 0x00, 0x00
+    };
+    guint8 response[] = {
+        0x01,
+        0x45, 0x00, 0x80, 0x02, 0x01,
+        0x02, 0xFF, 0xFF, 0x25, 0x00, 0x39, 0x00, 0x02,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x13, 0x01,
+        0x00, 0x42, 0x12, 0x0E, 0x00, 0x33, 0x35, 0x39,
+        0x32, 0x32, 0x35, 0x30, 0x35, 0x30, 0x30, 0x33,
+        0x39, 0x39, 0x37, 0x10, 0x08, 0x00, 0x38, 0x30,
+        0x39, 0x39, 0x37, 0x38, 0x37, 0x34, 0x11, 0x0F,
+        0x00, 0x33, 0x35, 0x39, 0x32, 0x32, 0x35, 0x30,
+        0x35, 0x30, 0x30, 0x33, 0x39, 0x39, 0x37, 0x33
+    };
+    CoalescedContext ctx = { fixture, 2 };
+    QmiDeviceStats   stats;
+
+    g_object_set (fixture->device, QMI_DEVICE_COALESCE_REQUESTS, TRUE, NULL);
+
+    /* Only the first request is expected in the device */
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   response, G_N_ELEMENTS (response),
+                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
+                            (GAsyncReadyCallback) coalesced_dms_get_ids_ready,
+                            &ctx);
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
+                            (GAsyncReadyCallback) coalesced_dms_get_ids_ready,
+                            &ctx);
+    test_fixture_loop_run (fixture);
+
+    /* The coalesced request still got its own transaction ID */
+    fixture->service_info[QMI_SERVICE_DMS].transaction_id++;
+
+    qmi_device_get_stats (fixture->device, &stats);
+    g_assert_cmpuint (stats.n_coalesced, ==, 1);
+}
+
+/*****************************************************************************/
+/* DMS Get IDs, cached */
+
+static void
+test_generated_dms_get_ids_cached (TestFixture *fixture)
+{
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x02, 0x01,
+        0x00, 0xFF, 0xFF, 0x25, 0x00, 0x00, 0x00
+    };
+    guint8 response[] = {
+        0x01,
+        0x45, 0x00, 0x80, 0x02, 0x01,
+        0x02, 0xFF, 0xFF, 0x25, 0x00, 0x39, 0x00, 0x02,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x13, 0x01,
+        0x00, 0x42, 0x12, 0x0E, 0x00, 0x33, 0x35, 0x39,
+        0x32, 0x32, 0x35, 0x30, 0x35, 0x30, 0x30, 0x33,
+        0x39, 0x39, 0x37, 0x10, 0x08, 0x00, 0x38, 0x30,
+        0x39, 0x39, 0x37, 0x38, 0x37, 0x34, 0x11, 0x0F,
+        0x00, 0x33, 0x35, 0x39, 0x32, 0x32, 0x35, 0x30,
+        0x35, 0x30, 0x30, 0x33, 0x39, 0x39, 0x37, 0x33
+    };
+    CoalescedContext ctx = { fixture, 1 };
+    QmiDeviceStats   stats;
+
+    g_object_set (fixture->device, QMI_DEVICE_RESPONSE_CACHE, TRUE, NULL);
+
+    /* Only the first request is expected in the device */
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   response, G_N_ELEMENTS (response),
+                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
+                            (GAsyncReadyCallback) coalesced_dms_get_ids_ready,
+                            &ctx);
+    test_fixture_loop_run (fixture);
+
+    /* The second one is answered from the cache */
+    ctx.n_pending = 1;
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
+                            (GAsyncReadyCallback) coalesced_dms_get_ids_ready,
+                            &ctx);
+    test_fixture_loop_run (fixture);
+    fixture->service_info[QMI_SERVICE_DMS].transaction_id++;
+
+    qmi_device_get_stats (fixture->device, &stats);
+    g_assert_cmpuint (stats.n_cached, ==, 1);
+}
+
+/*****************************************************************************/
+/* DMS Get IDs, no reply */
+
+typedef struct {
+    TestFixture *fixture;
+    guint64      n_responses;
+} NoReplyContext;
+
+static gboolean
+no_reply_check_response (NoReplyContext *ctx)
+{
+    QmiDeviceStats stats;
+
+    qmi_device_get_stats (ctx->fixture->device, &stats);
+    if (stats.n_responses <= ctx->n_responses)
+        return G_SOURCE_CONTINUE;
+
+    test_fixture_loop_stop (ctx->fixture);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+test_generated_dms_get_ids_no_reply (TestFixture *fixture)
+{
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x02, 0x01,
+        0x00, 0xFF, 0xFF, 0x25, 0x00, 0x00, 0x00
+    };
+    guint8 response[] = {
+        0x01,
+        0x13, 0x00, 0x80, 0x02, 0x01,
+        0x02, 0xFF, 0xFF, 0x25, 0x00, 0x07, 0x00, 0x02,
+        0x04, 0x00, 0x01, 0x00, 0x03, 0x00
+    };
+    NoReplyContext ctx = { fixture, 0 };
+    QmiDeviceStats stats;
+    guint64        n_no_reply_errors;
+
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   response, G_N_ELEMENTS (response),
+                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+
+    qmi_device_get_stats (fixture->device, &stats);
+    ctx.n_responses = stats.n_responses;
+    n_no_reply_errors = stats.n_no_reply_errors;
+
+    /* The error in the response is only accounted */
+    qmi_client_dms_get_ids_no_reply (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL);
+    g_timeout_add (10, (GSourceFunc) no_reply_check_response, &ctx);
+    test_fixture_loop_run (fixture);
+
+    qmi_device_get_stats (fixture->device, &stats);
+    g_assert_cmpuint (stats.n_no_reply_errors, ==, n_no_reply_errors + 1);
+    g_assert_cmpuint (stats.n_in_flight, ==, 0);
+}
+
+/*****************************************************************************/
+/* DMS Get IDs, interned strings */
+
+typedef struct {
+    TestFixture               *fixture;
+    QmiMessageDmsGetIdsOutput *output;
+} InternedContext;
+
+static void
+interned_dms_get_ids_ready (QmiClientDms    *client,
+                            GAsyncResult    *res,
+                            InternedContext *ctx)
+{
+    GError *error = NULL;
+
+    ctx->output = qmi_client_dms_get_ids_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (ctx->output);
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+test_generated_dms_get_ids_interned (TestFixture *fixture)
+{
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x02, 0x01,
+        0x00, 0xFF, 0xFF, 0x25, 0x00, 0x00, 0x00
+    };
+    guint8 response[] = {
+        0x01,
+        0x45, 0x00, 0x80, 0x02, 0x01,
+        0x02, 0xFF, 0xFF, 0x25, 0x00, 0x39, 0x00, 0x02,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x13, 0x01,
+        0x00, 0x42, 0x12, 0x0E, 0x00, 0x33, 0x35, 0x39,
+        0x32, 0x32, 0x35, 0x30, 0x35, 0x30, 0x30, 0x33,
+        0x39, 0x39, 0x37, 0x10, 0x08, 0x00, 0x38, 0x30,
+        0x39, 0x39, 0x37, 0x38, 0x37, 0x34, 0x11, 0x0F,
+        0x00, 0x33, 0x35, 0x39, 0x32, 0x32, 0x35, 0x30,
+        0x35, 0x30, 0x30, 0x33, 0x39, 0x39, 0x37, 0x33
+    };
+    InternedContext            ctx = { fixture, NULL };
+    QmiMessageDmsGetIdsOutput *outputs[2];
+    const gchar               *esn[2];
+    const gchar               *imei[2];
+    guint                      i;
+
+    qmi_utils_set_string_interning (TRUE);
+
+    for (i = 0; i < G_N_ELEMENTS (outputs); i++) {
+        test_port_context_set_command (fixture->ctx,
+                                       expected, G_N_ELEMENTS (expected),
+                                       response, G_N_ELEMENTS (response),
+                                       fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+
+        qmi_client_dms_get_ids (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
+                                (GAsyncReadyCallback) interned_dms_get_ids_ready,
+                                &ctx);
+        test_fixture_loop_run (fixture);
+
+        outputs[i] = ctx.output;
+        g_assert (qmi_message_dms_get_ids_output_get_esn (outputs[i], &esn[i], NULL));
+        g_assert (qmi_message_dms_get_ids_output_get_imei (outputs[i], &imei[i], NULL));
+    }
+
+    /* Same contents, same pointer, outliving the outputs */
+    g_assert_cmpstr (esn[0], ==, "80997874");
+    g_assert (esn[0] == esn[1]);
+    g_assert (imei[0] == imei[1]);
+    g_assert (esn[0] != imei[0]);
+
+    qmi_message_dms_get_ids_output_unref (outputs[0]);
+    qmi_message_dms_get_ids_output_unref (outputs[1]);
+    g_assert_cmpstr (esn[0], ==, "80997874");
+
+    qmi_utils_set_string_interning (FALSE);
+}
+
+/*****************************************************************************/
+/* DMS Get IDs, stalled callback */
+
+typedef struct {
+    TestFixture *fixture;
+    guint        n_stalls;
+    guint        service;
+    guint        message_id;
+    guint64      duration;
+} StallContext;
+
+static void
+stall_dms_get_ids_ready (QmiClientDms *client,
+                         GAsyncResult *res,
+                         StallContext *ctx)
+{
+    /* Block the main context for longer than the threshold */
+    g_usleep (20000);
+    dms_get_ids_ready (client, res, ctx->fixture);
+}
+
+static void
+device_callback_stall_cb (QmiDevice    *device,
+                          guint         service,
+                          guint         message_id,
+                          const gchar  *callback,
+                          guint64       duration,
+                          StallContext *ctx)
+{
+    g_assert (callback != NULL);
+    ctx->n_stalls++;
+    ctx->service = service;
+    ctx->message_id = message_id;
+    ctx->duration = duration;
+}
+
+static void
+test_generated_dms_get_ids_stall (TestFixture *fixture)
+{
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x02, 0x01,
+        0x00, 0xFF, 0xFF, 0x25, 0x00, 0x00, 0x00
+    };
+    guint8 response[] = {
+        0x01,
+        0x45, 0x00, 0x80, 0x02, 0x01,
+        0x02, 0xFF, 0xFF, 0x25, 0x00, 0x39, 0x00, 0x02,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x13, 0x01,
+        0x00, 0x42, 0x12, 0x0E, 0x00, 0x33, 0x35, 0x39,
+        0x32, 0x32, 0x35, 0x30, 0x35, 0x30, 0x30, 0x33,
+        0x39, 0x39, 0x37, 0x10, 0x08, 0x00, 0x38, 0x30,
+        0x39, 0x39, 0x37, 0x38, 0x37, 0x34, 0x11, 0x0F,
+        0x00, 0x33, 0x35, 0x39, 0x32, 0x32, 0x35, 0x30,
+        0x35, 0x30, 0x30, 0x33, 0x39, 0x39, 0x37, 0x33
+    };
+    StallContext   ctx = { fixture, 0 };
+    QmiDeviceStats stats;
+    guint64        n_callback_stalls;
+    gulong         handler_id;
+
+    g_object_set (fixture->device, QMI_DEVICE_STALL_THRESHOLD, 5, NULL);
+    handler_id = g_signal_connect (fixture->device,
+                                   QMI_DEVICE_SIGNAL_CALLBACK_STALL,
+                                   G_CALLBACK (device_callback_stall_cb),
+                                   &ctx);
+
+    qmi_device_get_stats (fixture->device, &stats);
+    n_callback_stalls = stats.n_callback_stalls;
+
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   response, G_N_ELEMENTS (response),
+                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
+                            (GAsyncReadyCallback) stall_dms_get_ids_ready,
+                            &ctx);
+    test_fixture_loop_run (fixture);
+
+    g_assert_cmpuint (ctx.n_stalls, ==, 1);
+    g_assert_cmpuint (ctx.service, ==, QMI_SERVICE_DMS);
+    g_assert_cmpuint (ctx.message_id, ==, 0x0025);
+    g_assert_cmpuint (ctx.duration, >=, 20000);
+
+    qmi_device_get_stats (fixture->device, &stats);
+    g_assert_cmpuint (stats.n_callback_stalls, ==, n_callback_stalls + 1);
+    g_assert_cmpuint (stats.callback_stall_max, >=, 20000);
+
+    g_signal_handler_disconnect (fixture->device, handler_id);
+    g_object_set (fixture->device, QMI_DEVICE_STALL_THRESHOLD, 0, NULL);
+}
+
+/*****************************************************************************/
+/* DMS Get IDs, parsed in a worker thread */
+
+static void
+test_generated_dms_get_ids_offloaded (TestFixture *fixture)
+{
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x02, 0x01,
+        0x00, 0xFF, 0xFF, 0x25, 0x00, 0x00, 0x00
+    };
+    guint8 response[] = {
+        0x01,
+        0x45, 0x00, 0x80, 0x02, 0x01,
+        0x02, 0xFF, 0xFF, 0x25, 0x00, 0x39, 0x00, 0x02,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x13, 0x01,
+        0x00, 0x42, 0x12, 0x0E, 0x00, 0x33, 0x35, 0x39,
+        0x32, 0x32, 0x35, 0x30, 0x35, 0x30, 0x30, 0x33,
+        0x39, 0x39, 0x37, 0x10, 0x08, 0x00, 0x38, 0x30,
+        0x39, 0x39, 0x37, 0x38, 0x37, 0x34, 0x11, 0x0F,
+        0x00, 0x33, 0x35, 0x39, 0x32, 0x32, 0x35, 0x30,
+        0x35, 0x30, 0x30, 0x33, 0x39, 0x39, 0x37, 0x33
+    };
+    QmiDeviceStats stats;
+    guint64        n_offloaded;
+
+    qmi_device_get_stats (fixture->device, &stats);
+    n_offloaded = stats.n_offloaded;
+
+    /* Large enough response */
+    g_object_set (fixture->device, QMI_DEVICE_OFFLOAD_THRESHOLD, 64, NULL);
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   response, G_N_ELEMENTS (response),
+                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
+                            (GAsyncReadyCallback) dms_get_ids_ready,
+                            fixture);
+    test_fixture_loop_run (fixture);
+
+    qmi_device_get_stats (fixture->device, &stats);
+    g_assert_cmpuint (stats.n_offloaded, ==, n_offloaded + 1);
+
+    /* Too small response, parsed right away */
+    g_object_set (fixture->device, QMI_DEVICE_OFFLOAD_THRESHOLD, 1024, NULL);
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   response, G_N_ELEMENTS (response),
+                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
+                            (GAsyncReadyCallback) dms_get_ids_ready,
+                            fixture);
+    test_fixture_loop_run (fixture);
+
+    qmi_device_get_stats (fixture->device, &stats);
+    g_assert_cmpuint (stats.n_offloaded, ==, n_offloaded + 1);
+
+    /* Configured message, regardless of the size */
+    qmi_device_set_offloaded_message (fixture->device, QMI_SERVICE_DMS, 0x0025, TRUE);
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   response, G_N_ELEMENTS (response),
+                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
+                            (GAsyncReadyCallback) dms_get_ids_ready,
+                            fixture);
+    test_fixture_loop_run (fixture);
+
+    qmi_device_get_stats (fixture->device, &stats);
+    g_assert_cmpuint (stats.n_offloaded, ==, n_offloaded + 2);
+
+    qmi_device_set_offloaded_message (fixture->device, QMI_SERVICE_DMS, 0x0025, FALSE);
+    g_object_set (fixture->device, QMI_DEVICE_OFFLOAD_THRESHOLD, 0, NULL);
+}
+
+/*****************************************************************************/
+/* DMS Get IDs, adaptive timeouts */
+
+static void
+test_generated_dms_get_ids_adaptive_timeout (TestFixture *fixture)
+{
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x02, 0x01,
+        0x00, 0xFF, 0xFF, 0x25, 0x00, 0x00, 0x00
+    };
+    guint8 response[] = {
+        0x01,
+        0x45, 0x00, 0x80, 0x02, 0x01,
+        0x02, 0xFF, 0xFF, 0x25, 0x00, 0x39, 0x00, 0x02,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x13, 0x01,
+        0x00, 0x42, 0x12, 0x0E, 0x00, 0x33, 0x35, 0x39,
+        0x32, 0x32, 0x35, 0x30, 0x35, 0x30, 0x30, 0x33,
+        0x39, 0x39, 0x37, 0x10, 0x08, 0x00, 0x38, 0x30,
+        0x39, 0x39, 0x37, 0x38, 0x37, 0x34, 0x11, 0x0F,
+        0x00, 0x33, 0x35, 0x39, 0x32, 0x32, 0x35, 0x30,
+        0x35, 0x30, 0x30, 0x33, 0x39, 0x39, 0x37, 0x33
+    };
+    CoalescedContext ctx = { fixture, 0 };
+    guint            i;
+
+    g_object_set (fixture->device, QMI_DEVICE_ADAPTIVE_TIMEOUTS, TRUE, NULL);
+    qmi_device_set_adaptive_timeout_params (fixture->device, 4.0, 500, 0);
+
+    /* Not enough samples yet */
+    g_assert_cmpuint (qmi_device_get_adaptive_timeout (fixture->device, QMI_SERVICE_DMS, 0x0025), ==, 0);
+
+    for (i = 0; i < 8; i++) {
+        test_port_context_set_command (fixture->ctx,
+                                       expected, G_N_ELEMENTS (expected),
+                                       response, G_N_ELEMENTS (response),
+                                       fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+
+        ctx.n_pending = 1;
+        qmi_client_dms_get_ids (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
+                                (GAsyncReadyCallback) coalesced_dms_get_ids_ready,
+                                &ctx);
+        test_fixture_loop_run (fixture);
+    }
+
+    /* Replies are immediate, so the learnt timeout is clamped to the minimum */
+    g_assert_cmpuint (qmi_device_get_adaptive_timeout (fixture->device, QMI_SERVICE_DMS, 0x0025), ==, 500);
+}
+
+/*****************************************************************************/
+/* DMS Get IDs, unresponsive device */
+
+typedef struct {
+    TestFixture *fixture;
+    gboolean     unresponsive;
+} UnresponsiveContext;
+
+static GByteArray *
+unresponsive_responder (TestPortContext *ctx,
+                        GByteArray      *request,
+                        gpointer         user_data)
+{
+    /* Nothing is ever replied */
+    return NULL;
+}
+
+static void
+device_unresponsive_cb (QmiDevice           *device,
+                        UnresponsiveContext *ctx)
+{
+    ctx->unresponsive = TRUE;
+}
+
+static void
+unresponsive_dms_get_ids_ready (QmiClientDms        *client,
+                                GAsyncResult        *res,
+                                UnresponsiveContext *ctx)
+{
+    QmiMessageDmsGetIdsOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_dms_get_ids_finish (client, res, &error);
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_UNRESPONSIVE);
+    g_assert (!output);
+    g_error_free (error);
+
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+test_generated_dms_get_ids_unresponsive (TestFixture *fixture)
+{
+    UnresponsiveContext ctx = { fixture, FALSE };
+    gulong              unresponsive_id;
+    gint64              start;
+
+    unresponsive_id = g_signal_connect (fixture->device,
+                                        QMI_DEVICE_SIGNAL_UNRESPONSIVE,
+                                        G_CALLBACK (device_unresponsive_cb),
+                                        &ctx);
+    qmi_device_set_health_check_params (fixture->device, 0, 1, 1);
+    g_object_set (fixture->device, QMI_DEVICE_HEALTH_CHECK, TRUE, NULL);
+    test_port_context_set_responder (fixture->ctx, unresponsive_responder, NULL);
+
+    /* Pinged after 1s, the ping times out after another 1s, all way before
+     * the request itself would */
+    start = g_get_monotonic_time ();
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 10, NULL,
+                            (GAsyncReadyCallback) unresponsive_dms_get_ids_ready,
+                            &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpint (g_get_monotonic_time () - start, <, 5 * G_USEC_PER_SEC);
+
+    /* The signal is emitted right after the requests are completed */
+    while (!ctx.unresponsive)
+        g_main_context_iteration (NULL, TRUE);
+
+    g_object_set (fixture->device, QMI_DEVICE_HEALTH_CHECK, FALSE, NULL);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+    g_signal_handler_disconnect (fixture->device, unresponsive_id);
+
+    fixture->service_info[QMI_SERVICE_DMS].transaction_id++;
+    fixture->service_info[QMI_SERVICE_CTL].transaction_id++;
+}
+
+/*****************************************************************************/
+/* DMS Get IDs, polled */
+
+static void
+poller_dms_get_ids_response (QmiPoller    *poller,
+                             QmiClient    *client,
+                             QmiMessage   *response,
+                             const GError *error,
+                             TestFixture  *fixture)
+{
+    g_assert_no_error (error);
+    g_assert (response);
+    g_assert (client == fixture->service_info[QMI_SERVICE_DMS].client);
+    g_assert_cmpuint (qmi_message_get_message_id (response), ==, 0x0025);
+    g_assert (qmi_message_is_response (response));
+
+    test_fixture_loop_stop (fixture);
+}
+
+static void
+test_generated_dms_get_ids_polled (TestFixture *fixture)
+{
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x02, 0x01,
+        0x00, 0xFF, 0xFF, 0x25, 0x00, 0x00, 0x00
+    };
+    guint8 response[] = {
+        0x01,
+        0x45, 0x00, 0x80, 0x02, 0x01,
+        0x02, 0xFF, 0xFF, 0x25, 0x00, 0x39, 0x00, 0x02,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x13, 0x01,
+        0x00, 0x42, 0x12, 0x0E, 0x00, 0x33, 0x35, 0x39,
+        0x32, 0x32, 0x35, 0x30, 0x35, 0x30, 0x30, 0x33,
+        0x39, 0x39, 0x37, 0x10, 0x08, 0x00, 0x38, 0x30,
+        0x39, 0x39, 0x37, 0x38, 0x37, 0x34, 0x11, 0x0F,
+        0x00, 0x33, 0x35, 0x39, 0x32, 0x32, 0x35, 0x30,
+        0x35, 0x30, 0x30, 0x33, 0x39, 0x39, 0x37, 0x33
+    };
+    QmiPoller  *poller;
+    QmiMessage *request;
+    QmiClient  *client;
+    guint       id;
+
+    client = fixture->service_info[QMI_SERVICE_DMS].client;
+
+    /* The first request is sent right away */
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   response, G_N_ELEMENTS (response),
+                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+
+    poller = qmi_poller_new (1000, 0);
+    request = qmi_message_new (QMI_SERVICE_DMS, 0, 0, 0x0025);
+    id = qmi_poller_add (poller, client, request, 60, 3,
+                         (QmiPollerResponseCallback) poller_dms_get_ids_response,
+                         fixture, NULL);
+    g_assert_cmpuint (id, !=, 0);
+    qmi_message_unref (request);
+
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (qmi_poller_get_backoff (poller, client), ==, 1);
+
+    qmi_poller_remove (poller, id);
+    g_assert_cmpuint (qmi_poller_get_backoff (poller, client), ==, 0);
+    g_object_unref (poller);
+}
+
+/*****************************************************************************/
+/* DMS UIM Get PIN Status */
+
+static void
+dms_uim_get_pin_status_ready (QmiClientDms *client,
+                              GAsyncResult *res,
+                              TestFixture  *fixture)
+{
+    QmiMessageDmsUimGetPinStatusOutput *output;
+    GError *error = NULL;
+    gboolean st;
+    QmiDmsUimPinStatus current_status;
+    guint8 verify_retries_left;
+    guint8 unblock_retries_left;
+
+    output = qmi_client_dms_uim_get_pin_status_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+
+    st = qmi_message_dms_uim_get_pin_status_output_get_result (output, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+
+    /* [/dev/cdc-wdm3] PIN1:
+     *   Status: enabled-not-verified
+     *   Verify: 3
+     *  Unblock: 10
+     * [/dev/cdc-wdm3] PIN2:
+     *   Status: enabled-not-verified
+     *   Verify: 2
+     *  Unblock: 10
+     */
+
+    st = (qmi_message_dms_uim_get_pin_status_output_get_pin1_status (
+              output,
+              &current_status,
+              &verify_retries_left,
+              &unblock_retries_left,
+              &error));
+    g_assert_no_error (error);
+    g_assert (st);
+    g_assert_cmpuint (current_status, ==, QMI_DMS_UIM_PIN_STATUS_ENABLED_NOT_VERIFIED);
+    g_assert_cmpuint (verify_retries_left, ==, 3);
+    g_assert_cmpuint (unblock_retries_left, ==, 10);
+
+    st = (qmi_message_dms_uim_get_pin_status_output_get_pin2_status (
+              output,
+              &current_status,
+              &verify_retries_left,
+              &unblock_retries_left,
+              &error));
+    g_assert_no_error (error);
+    g_assert (st);
+    g_assert_cmpuint (current_status, ==, QMI_DMS_UIM_PIN_STATUS_ENABLED_NOT_VERIFIED);
+    g_assert_cmpuint (verify_retries_left, ==, 2);
+    g_assert_cmpuint (unblock_retries_left, ==, 10);
+
+    qmi_message_dms_uim_get_pin_status_output_unref (output);
+
+    test_fixture_loop_stop (fixture);
+}
+
+static void
+test_generated_dms_uim_get_pin_status (TestFixture *fixture)
+{
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x02, 0x01,
+        0x00, 0xFF, 0xFF, 0x2B, 0x00, 0x00, 0x00
+    };
+    guint8 response[] = {
+        0x01,
+        0x1F, 0x00, 0x80, 0x02, 0x01,
+        0x02, 0xFF, 0xFF, 0x2B, 0x00, 0x13, 0x00, 0x02,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x12, 0x03,
+        0x00, 0x01, 0x02, 0x0A, 0x11, 0x03, 0x00, 0x01,
+        0x03, 0x0A
+    };
+
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   response, G_N_ELEMENTS (response),
+                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+
+    qmi_client_dms_uim_get_pin_status (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
+                                       (GAsyncReadyCallback) dms_uim_get_pin_status_ready,
+                                       fixture);
+    test_fixture_loop_run (fixture);
+}
+
+/*****************************************************************************/
+/* DMS UIM Verify PIN */
+
+static void
+dms_uim_verify_pin_ready (QmiClientDms *client,
+                          GAsyncResult *res,
+                          TestFixture  *fixture)
+{
+    QmiMessageDmsUimVerifyPinOutput *output;
+    GError *error = NULL;
+    gboolean st;
+
+    output = qmi_client_dms_uim_verify_pin_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+
+    st = qmi_message_dms_uim_verify_pin_output_get_result (output, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+
+    qmi_message_dms_uim_verify_pin_output_unref (output);
+
+    test_fixture_loop_stop (fixture);
+}
+
+static void
+test_generated_dms_uim_verify_pin (TestFixture *fixture)
+{
+    QmiMessageDmsUimVerifyPinInput *input;
+    gboolean st;
+    GError *error = NULL;
+    guint8 expected[] = {
+        0x01,
+        0x15, 0x00, 0x00, 0x02, 0x01,
+        0x00, 0x01, 0x00, 0x28, 0x00, 0x09, 0x00, 0x01,
+        0x06, 0x00, 0x01, 0x04, 0x31, 0x32, 0x33, 0x34
+    };
+    guint8 response[] = {
+        0x01,
+        0x13, 0x00, 0x80, 0x02, 0x01,
+        0x02, 0xFF, 0xFF, 0x28, 0x00, 0x07, 0x00, 0x02,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   response, G_N_ELEMENTS (response),
+                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+
+    input = qmi_message_dms_uim_verify_pin_input_new ();
+    st = qmi_message_dms_uim_verify_pin_input_set_info (input, QMI_DMS_UIM_PIN_ID_PIN, "1234", &error);
+    g_assert_no_error (error);
+    g_assert (st);
+
+    qmi_client_dms_uim_verify_pin (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), input, 3, NULL,
+                                   (GAsyncReadyCallback) dms_uim_verify_pin_ready,
+                                   fixture);
+
+    qmi_message_dms_uim_verify_pin_input_unref (input);
+
+    test_fixture_loop_run (fixture);
+}
+
+/*****************************************************************************/
+/* DMS Get Time
+ *
+ * Note: the original device time in the real-life binary message used had the
+ * time source set to QMI_DMS_TIME_SOURCE_DEVICE. This value has been modified
+ * to explicitly make the 6-byte long uint read different from an 8-byte long
+ * read of the same buffer, as QMI_DMS_TIME_SOURCE_DEVICE is actually 0x0000.
+ */
+
+static void
+dms_get_time_ready (QmiClientDms *client,
+                    GAsyncResult *res,
+                    TestFixture  *fixture)
+{
+    QmiMessageDmsGetTimeOutput *output;
+    GError *error = NULL;
+    gboolean st;
+    guint64 device_time_time_count;
+    QmiDmsTimeSource device_time_time_source;
+    guint64 system_time;
+    guint64 user_time;
+
+    output = qmi_client_dms_get_time_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+
+    st = qmi_message_dms_get_time_output_get_result (output, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+
+    st = qmi_message_dms_get_time_output_get_device_time (output, &device_time_time_count, &device_time_time_source, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+    g_assert_cmpuint (device_time_time_count, == , 884789480513ULL);
+    g_assert_cmpuint (device_time_time_source, ==, QMI_DMS_TIME_SOURCE_HDR_NETWORK);
+
+    st = qmi_message_dms_get_time_output_get_system_time (output, &system_time, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+    g_assert_cmpuint (system_time, ==, 1105986850641ULL);
+
+    st = qmi_message_dms_get_time_output_get_user_time (output, &user_time, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+    g_assert_cmpuint (user_time, ==, 11774664);
+
+    qmi_message_dms_get_time_output_unref (output);
+
+    test_fixture_loop_stop (fixture);
+}
+
+static void
+test_generated_dms_get_time (TestFixture *fixture)
+{
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x02, 0x01, 0x00, 0x01, 0x00, 0x2F, 0x00,
+        0x00, 0x00
+    };
+    guint8 response[] = {
+        0x01,
+        0x34, 0x00, 0x80, 0x02, 0x01, 0x02, 0x01, 0x00, 0x2F, 0x00,
+        0x28, 0x00,
+        0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x01, 0x08, 0x00, 0x41, 0x0C, 0x90, 0x01, 0xCE, 0x00, 0x02, 0x00, /* Note: last 0x0200 for HDR network source */
+        0x10, 0x08, 0x00, 0x51, 0x0F, 0xF4, 0x81, 0x01, 0x01, 0x00, 0x00,
+        0x11, 0x08, 0x00, 0xC8, 0xAA, 0xB3, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   response, G_N_ELEMENTS (response),
+                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+
+    qmi_client_dms_get_time (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
+                             (GAsyncReadyCallback) dms_get_time_ready,
+                             fixture);
+
+    test_fixture_loop_run (fixture);
+}
+
+/*****************************************************************************/
+/* NAS Network Scan */
+typedef struct {
+    guint16 mcc;
+    guint16 mnc;
+    gboolean includes_pcs_digit;
+    QmiNasNetworkStatus network_status;
+    QmiNasRadioInterface rat;
+    const gchar *description;
+
+} NetworkScanResult;
+
+static NetworkScanResult scan_results[] =  {
+    {
+        .mcc = 214,
+        .mnc = 1,
+        .includes_pcs_digit = FALSE,
+        .network_status = (QMI_NAS_NETWORK_STATUS_AVAILABLE |
+                           QMI_NAS_NETWORK_STATUS_ROAMING |
+                           QMI_NAS_NETWORK_STATUS_NOT_FORBIDDEN |
+                           QMI_NAS_NETWORK_STATUS_NOT_PREFERRED),
+        .rat = QMI_NAS_RADIO_INTERFACE_GSM,
+        .description = "voda ES"
+    },
+    {
+        .mcc = 214,
+        .mnc = 3,
+        .includes_pcs_digit = FALSE,
+        .network_status = (QMI_NAS_NETWORK_STATUS_AVAILABLE |
+                           QMI_NAS_NETWORK_STATUS_ROAMING |
+                           QMI_NAS_NETWORK_STATUS_NOT_FORBIDDEN |
+                           QMI_NAS_NETWORK_STATUS_NOT_PREFERRED),
+        .rat = QMI_NAS_RADIO_INTERFACE_GSM,
+        .description = "Orange"
+    },
+    {
+        .mcc = 214,
+        .mnc = 4,
+        .includes_pcs_digit = FALSE,
+        .network_status = (QMI_NAS_NETWORK_STATUS_AVAILABLE |
+                           QMI_NAS_NETWORK_STATUS_ROAMING |
+                           QMI_NAS_NETWORK_STATUS_NOT_FORBIDDEN |
+                           QMI_NAS_NETWORK_STATUS_NOT_PREFERRED),
+        .rat = QMI_NAS_RADIO_INTERFACE_UMTS,
+        .description = "YOIGO"
+    },
+    {
+        .mcc = 214,
+        .mnc = 1,
+        .includes_pcs_digit = FALSE,
+        .network_status = (QMI_NAS_NETWORK_STATUS_AVAILABLE |
+                           QMI_NAS_NETWORK_STATUS_ROAMING |
+                           QMI_NAS_NETWORK_STATUS_NOT_FORBIDDEN |
+                           QMI_NAS_NETWORK_STATUS_NOT_PREFERRED),
+        .rat = QMI_NAS_RADIO_INTERFACE_UMTS,
+        .description = "voda ES"
+    },
+    {
+        .mcc = 214,
+        .mnc = 4,
+        .includes_pcs_digit = FALSE,
+        .network_status = (QMI_NAS_NETWORK_STATUS_AVAILABLE |
+                           QMI_NAS_NETWORK_STATUS_ROAMING |
+                           QMI_NAS_NETWORK_STATUS_NOT_FORBIDDEN |
+                           QMI_NAS_NETWORK_STATUS_NOT_PREFERRED),
+        .rat = QMI_NAS_RADIO_INTERFACE_GSM,
+        .description = "YOIGO"
+    },
+    {
+        .mcc = 214,
+        .mnc = 7,
+        .includes_pcs_digit = FALSE,
+        .network_status = (QMI_NAS_NETWORK_STATUS_AVAILABLE |
+                           QMI_NAS_NETWORK_STATUS_ROAMING |
+                           QMI_NAS_NETWORK_STATUS_NOT_FORBIDDEN |
+                           QMI_NAS_NETWORK_STATUS_NOT_PREFERRED),
+        .rat = QMI_NAS_RADIO_INTERFACE_GSM,
+        .description = "Movistar"
+    },
+    {
+        .mcc = 214,
+        .mnc = 7,
+        .includes_pcs_digit = FALSE,
+        .network_status = (QMI_NAS_NETWORK_STATUS_AVAILABLE |
+                           QMI_NAS_NETWORK_STATUS_ROAMING |
+                           QMI_NAS_NETWORK_STATUS_NOT_FORBIDDEN |
+                           QMI_NAS_NETWORK_STATUS_NOT_PREFERRED),
+        .rat = QMI_NAS_RADIO_INTERFACE_UMTS,
+        .description = "Movistar"
+    },
+    {
+        .mcc = 214,
+        .mnc = 3,
+        .includes_pcs_digit = FALSE,
+        .network_status = (QMI_NAS_NETWORK_STATUS_CURRENT_SERVING |
+                           QMI_NAS_NETWORK_STATUS_ROAMING |
+                           QMI_NAS_NETWORK_STATUS_NOT_FORBIDDEN |
+                           QMI_NAS_NETWORK_STATUS_NOT_PREFERRED),
+        .rat = QMI_NAS_RADIO_INTERFACE_UMTS,
+        .description = ""
+    },
+};
+
+static void
+nas_network_scan_ready (QmiClientNas *client,
+                        GAsyncResult *res,
+                        TestFixture  *fixture)
+{
+    QmiMessageNasNetworkScanOutput *output;
+    GError *error = NULL;
+    gboolean st;
+    GArray *network_information = NULL;
+    GArray *radio_access_technology = NULL;
+    GArray *mnc_pcs_digit_include_status = NULL;
+    QmiNasNetworkScanIter iter;
+    QmiNasNetworkScanResult result;
+    guint i;
+
+    output = qmi_client_nas_network_scan_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+
+    st = qmi_message_nas_network_scan_output_get_result (output, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+
+    st = (qmi_message_nas_network_scan_output_get_network_information (
+              output,
+              &network_information,
+              &error));
+    g_assert_no_error (error);
+    g_assert (st);
+    g_assert (network_information);
+    g_assert_cmpuint (network_information->len, ==, 8);
+    for (i = 0; i < network_information->len; i++) {
+        QmiMessageNasNetworkScanOutputNetworkInformationElement *el;
+
+        el = &g_array_index (network_information, QmiMessageNasNetworkScanOutputNetworkInformationElement, i);
+
+        g_assert_cmpuint (el->mcc, ==, scan_results[i].mcc);
+        g_assert_cmpuint (el->mnc, ==, scan_results[i].mnc);
+        g_assert_cmpuint (el->network_status, ==, scan_results[i].network_status);
+        g_assert_cmpstr  (el->description, ==, scan_results[i].description);
+    }
+
+    st = (qmi_message_nas_network_scan_output_get_radio_access_technology (
+              output,
+              &radio_access_technology,
+              &error));
+    g_assert_no_error (error);
+    g_assert (st);
+    g_assert (radio_access_technology);
+    g_assert_cmpuint (radio_access_technology->len, ==, 8);
+    for (i = 0; i < radio_access_technology->len; i++) {
+        QmiMessageNasNetworkScanOutputRadioAccessTechnologyElement *el;
+
+        el = &g_array_index (radio_access_technology, QmiMessageNasNetworkScanOutputRadioAccessTechnologyElement, i);
+
+        g_assert_cmpuint (el->mcc, ==, scan_results[i].mcc);
+        g_assert_cmpuint (el->mnc, ==, scan_results[i].mnc);
+        g_assert_cmpuint (el->radio_interface, ==, scan_results[i].rat);
+    }
+
+    st = (qmi_message_nas_network_scan_output_get_mnc_pcs_digit_include_status (
+              output,
+              &mnc_pcs_digit_include_status,
+              &error));
+    g_assert_no_error (error);
+    g_assert (st);
+    g_assert (mnc_pcs_digit_include_status);
+    g_assert_cmpuint (mnc_pcs_digit_include_status->len, ==, 8);
+    for (i = 0; i < mnc_pcs_digit_include_status->len; i++) {
+        QmiMessageNasNetworkScanOutputMncPcsDigitIncludeStatusElement *el;
+
+        el = &g_array_index (mnc_pcs_digit_include_status, QmiMessageNasNetworkScanOutputMncPcsDigitIncludeStatusElement, i);
+
+        g_assert_cmpuint (el->mcc, ==, scan_results[i].mcc);
+        g_assert_cmpuint (el->mnc, ==, scan_results[i].mnc);
+        g_assert_cmpuint (el->includes_pcs_digit, ==, scan_results[i].includes_pcs_digit);
+    }
+
+    /* Same results when walking the message */
+    st = qmi_nas_network_scan_iter_init (&iter, output, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+    for (i = 0; qmi_nas_network_scan_iter_next (&iter, &result); i++) {
+        g_assert_cmpuint (i, <, G_N_ELEMENTS (scan_results));
+        g_assert_cmpuint (result.mcc, ==, scan_results[i].mcc);
+        g_assert_cmpuint (result.mnc, ==, scan_results[i].mnc);
+        g_assert_cmpuint (result.network_status, ==, scan_results[i].network_status);
+        g_assert_cmpuint (result.description_length, ==, strlen (scan_results[i].description));
+        g_assert (strncmp (result.description, scan_results[i].description, result.description_length) == 0);
+        g_assert_cmpuint (result.radio_interface, ==, scan_results[i].rat);
+        g_assert_cmpuint (result.mnc_includes_pcs_digit, ==, scan_results[i].includes_pcs_digit);
+    }
+    g_assert_cmpuint (i, ==, G_N_ELEMENTS (scan_results));
+
+    qmi_message_nas_network_scan_output_unref (output);
+
+    test_fixture_loop_stop (fixture);
+}
+
+static void
+nas_get_cell_location_info_ready (QmiClientNas *client,
+                                  GAsyncResult *res,
+                                  TestFixture  *fixture)
+{
+    QmiMessageNasGetCellLocationInfoOutput *output;
+    GError *error = NULL;
+    gboolean st;
+    QmiNasCellInfo *info;
+    const QmiNasCellInfoGeranCell *geran;
+    guint n_cells = 0;
+
+    output = qmi_client_nas_get_cell_location_info_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+
+    st = qmi_message_nas_get_cell_location_info_output_get_result (output, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+
+    info = qmi_nas_cell_info_new (output, &error);
+    g_assert_no_error (error);
+    g_assert (info);
+
+    geran = qmi_nas_cell_info_get_geran_cells (info, &n_cells);
+    g_assert (geran);
+    g_assert_cmpuint (n_cells, ==, 3);
+    g_assert_cmpuint (geran[0].cell_id, ==, 0x6F7D);
+    g_assert_cmpuint (geran[0].lac, ==, 0xB3);
+    g_assert_cmpuint (geran[0].arfcn, ==, 0x4D);
+    g_assert_cmpuint (geran[0].bsic, ==, 0x11);
+    g_assert_cmpuint (geran[0].rx_level, ==, 0x2A);
+    g_assert_cmpuint (geran[1].cell_id, ==, 0x3C8A);
+    g_assert_cmpuint (geran[1].arfcn, ==, 0x63);
+    g_assert_cmpuint (geran[2].cell_id, ==, 0x3C89);
+    g_assert_cmpuint (geran[2].rx_level, ==, 0x0D);
+
+    g_assert (!qmi_nas_cell_info_get_umts_cells (info, &n_cells));
+    g_assert_cmpuint (n_cells, ==, 0);
+    g_assert (!qmi_nas_cell_info_get_lte_intrafrequency_cells (info, &n_cells));
+    g_assert_cmpuint (n_cells, ==, 0);
+
+    qmi_nas_cell_info_unref (info);
+    qmi_message_nas_get_cell_location_info_output_unref (output);
+
+    test_fixture_loop_stop (fixture);
+}
+
+static void
+test_generated_nas_network_scan (TestFixture *fixture)
+{
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x03, 0x01,
+        0x00, 0xFF, 0xFF, 0x21, 0x00, 0x00, 0x00
+    };
+    guint8 response[] = {
+        0x01,
+        0x43, 0x01, 0x80, 0x03, 0x01,
+        0x02, 0xFF, 0xFF, 0x21, 0x00, 0x37, 0x01, 0x02,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x60,
+        0x00, 0x08, 0x00, 0xD6, 0x00, 0x01, 0x00, 0xAA,
+        0x07, 0x76, 0x6F, 0x64, 0x61, 0x20, 0x45, 0x53,
+        0xD6, 0x00, 0x03, 0x00, 0xAA, 0x06, 0x4F, 0x72,
+        0x61, 0x6E, 0x67, 0x65, 0xD6, 0x00, 0x04, 0x00,
+        0xAA, 0x05, 0x59, 0x4F, 0x49, 0x47, 0x4F, 0xD6,
+        0x00, 0x01, 0x00, 0xAA, 0x07, 0x76, 0x6F, 0x64,
+        0x61, 0x20, 0x45, 0x53, 0xD6, 0x00, 0x04, 0x00,
+        0xAA, 0x05, 0x59, 0x4F, 0x49, 0x47, 0x4F, 0xD6,
+        0x00, 0x07, 0x00, 0xAA, 0x08, 0x4D, 0x6F, 0x76,
+        0x69, 0x73, 0x74, 0x61, 0x72, 0xD6, 0x00, 0x07,
+        0x00, 0xAA, 0x08, 0x4D, 0x6F, 0x76, 0x69, 0x73,
+        0x74, 0x61, 0x72, 0xD6, 0x00, 0x03, 0x00, 0xA9,
+        0x00, 0x11, 0x2A, 0x00, 0x08, 0x00, 0xD6, 0x00,
+        0x01, 0x00, 0x04, 0xD6, 0x00, 0x03, 0x00, 0x04,
+        0xD6, 0x00, 0x04, 0x00, 0x05, 0xD6, 0x00, 0x01,
+        0x00, 0x05, 0xD6, 0x00, 0x04, 0x00, 0x04, 0xD6,
+        0x00, 0x07, 0x00, 0x04, 0xD6, 0x00, 0x07, 0x00,
+        0x05, 0xD6, 0x00, 0x03, 0x00, 0x05, 0x12, 0x2A,
+        0x00, 0x08, 0x00, 0xD6, 0x00, 0x01, 0x00, 0x00,
+        0xD6, 0x00, 0x03, 0x00, 0x00, 0xD6, 0x00, 0x04,
+        0x00, 0x00, 0xD6, 0x00, 0x01, 0x00, 0x00, 0xD6,
+        0x00, 0x04, 0x00, 0x00, 0xD6, 0x00, 0x07, 0x00,
+        0x00, 0xD6, 0x00, 0x07, 0x00, 0x00, 0xD6, 0x00,
+        0x03, 0x00, 0x00, 0x13, 0x04, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x14, 0x69, 0x00, 0x08, 0xD6, 0x00,
+        0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0xD6, 0x00, 0x03, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0xD6, 0x00, 0x04, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xD6,
+        0x00, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   response, G_N_ELEMENTS (response),
+                                   fixture->service_info[QMI_SERVICE_NAS].transaction_id++);
+
+    qmi_client_nas_network_scan (QMI_CLIENT_NAS (fixture->service_info[QMI_SERVICE_NAS].client), NULL, 3, NULL,
+                                 (GAsyncReadyCallback) nas_network_scan_ready,
+                                 fixture);
+
+    test_fixture_loop_run (fixture);
+}
+
+static void
+test_generated_nas_get_cell_location_info (TestFixture *fixture)
+{
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x03, 0x01,
+        0x00, 0x01, 0x00, 0x43, 0x00, 0x00, 0x00
+    };
+    guint8 response[] = {
+        0x01,
+        0x53, 0x00, 0x80, 0x03, 0x01,
+        0x02, 0x01, 0x00, 0x43, 0x00, 0x47, 0x00, 0x02,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x3D,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF,
+        0xFF, 0x28, 0x00, 0x03, 0x7D, 0x6F, 0x00, 0x00,
+        0x32, 0xF4, 0x51, 0xB3, 0x00, 0x4D, 0x00, 0x11,
+        0x2A, 0x00, 0x8A, 0x3C, 0x00, 0x00, 0x32, 0xF4,
+        0x51, 0xB3, 0x00, 0x63, 0x00, 0x30, 0x14, 0x00,
+        0x89, 0x3C, 0x00, 0x00, 0x32, 0xF4, 0x51, 0xB3,
+        0x00, 0x59, 0x00, 0x11, 0x0D, 0x00
+    };
+
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   response, G_N_ELEMENTS (response),
+                                   fixture->service_info[QMI_SERVICE_NAS].transaction_id++);
+
+    qmi_client_nas_get_cell_location_info (QMI_CLIENT_NAS (fixture->service_info[QMI_SERVICE_NAS].client), NULL, 3, NULL,
+                                           (GAsyncReadyCallback) nas_get_cell_location_info_ready,
+                                           fixture);
+
+    test_fixture_loop_run (fixture);
+}
+
+/*****************************************************************************/
+/* NAS state mirror */
+
+typedef struct {
+    TestFixture       *fixture;
+    QmiNasStateMirror *mirror;
+} StateMirrorContext;
+
+static GByteArray *
+state_mirror_responder (TestPortContext *ctx,
+                        GByteArray      *request,
+                        gpointer         user_data)
+{
+    QmiMessage *response;
+    gsize       init_offset;
+
+    g_assert_cmpuint (qmi_message_get_service ((QmiMessage *)request), ==, QMI_SERVICE_NAS);
+
+    response = qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+
+    switch (qmi_message_get_message_id ((QmiMessage *)request)) {
+    case 0x0024: /* Get Serving System */
+        init_offset = qmi_message_tlv_write_init (response, 0x01, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint8 (response, QMI_NAS_REGISTRATION_STATE_REGISTERED, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (response, QMI_NAS_ATTACH_STATE_ATTACHED, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (response, QMI_NAS_ATTACH_STATE_ATTACHED, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (response, QMI_NAS_NETWORK_TYPE_3GPP, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (response, 1, NULL));
+        g_assert (qmi_message_tlv_write_gint8 (response, QMI_NAS_RADIO_INTERFACE_LTE, NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+
+        init_offset = qmi_message_tlv_write_init (response, 0x12, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, 214, NULL));
+        g_assert (qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, 3, NULL));
+        g_assert (qmi_message_tlv_write_string (response, 1, "Orange", -1, NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        break;
+    case 0x004F: /* Get Signal Info */
+        init_offset = qmi_message_tlv_write_init (response, 0x12, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_gint8 (response, -70, NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        break;
+    default:
+        /* Register Indications and Config Signal Info */
+        break;
+    }
+
+    return (GByteArray *)response;
+}
+
+static gboolean
+state_mirror_emit_signal_info (StateMirrorContext *ctx)
+{
+    QmiMessage *indication;
+    gsize       init_offset;
+
+    /* NAS Signal Info, now only with LTE */
+    indication = qmi_message_new (QMI_SERVICE_NAS,
+                                  qmi_client_get_cid (ctx->fixture->service_info[QMI_SERVICE_NAS].client),
+                                  0,
+                                  0x0051);
+    ((GByteArray *) indication)->data[6] |= 0x04;
+
+    init_offset = qmi_message_tlv_write_init (indication, 0x14, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_gint8 (indication, -60, NULL));
+    g_assert (qmi_message_tlv_write_gint8 (indication, -9, NULL));
+    g_assert (qmi_message_tlv_write_gint16 (indication, QMI_ENDIAN_LITTLE, -95, NULL));
+    g_assert (qmi_message_tlv_write_gint16 (indication, QMI_ENDIAN_LITTLE, 132, NULL));
+    g_assert (qmi_message_tlv_write_complete (indication, init_offset, NULL));
+
+    test_port_context_write (ctx->fixture->ctx, indication->data, indication->len);
+    qmi_message_unref (indication);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+state_mirror_new_ready (GObject            *source,
+                        GAsyncResult       *res,
+                        StateMirrorContext *ctx)
+{
+    GError *error = NULL;
+
+    ctx->mirror = qmi_nas_state_mirror_new_finish (res, &error);
+    g_assert_no_error (error);
+    g_assert (ctx->mirror);
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+state_mirror_updated (QmiNasStateMirror  *mirror,
+                      StateMirrorContext *ctx)
+{
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+test_generated_nas_state_mirror (TestFixture *fixture)
+{
+    StateMirrorContext       ctx = { fixture, NULL };
+    QmiNasStateSnapshot     *snapshot;
+    QmiNasRegistrationState  registration_state;
+    GArray                  *radio_interfaces;
+    guint16                  mcc;
+    guint16                  mnc;
+    const gchar             *description;
+    gint8                    rssi;
+    gint16                   rsrp;
+    gulong                   updated_id;
+
+    test_port_context_set_responder (fixture->ctx, state_mirror_responder, NULL);
+    qmi_nas_state_mirror_new (QMI_CLIENT_NAS (fixture->service_info[QMI_SERVICE_NAS].client), NULL,
+                              (GAsyncReadyCallback) state_mirror_new_ready,
+                              &ctx);
+    test_fixture_loop_run (fixture);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+
+    /* Register Indications, Config Signal Info, Get Serving System and
+     * Get Signal Info */
+    fixture->service_info[QMI_SERVICE_NAS].transaction_id += 4;
+
+    /* Initial state loaded from the responses */
+    snapshot = qmi_nas_state_mirror_get_snapshot (ctx.mirror);
+    g_assert (qmi_nas_state_snapshot_get_serving_system (snapshot, &registration_state, NULL, NULL, NULL, &radio_interfaces));
+    g_assert_cmpuint (registration_state, ==, QMI_NAS_REGISTRATION_STATE_REGISTERED);
+    g_assert_cmpuint (radio_interfaces->len, ==, 1);
+    g_assert_cmpint (g_array_index (radio_interfaces, QmiNasRadioInterface, 0), ==, QMI_NAS_RADIO_INTERFACE_LTE);
+    g_assert (qmi_nas_state_snapshot_get_current_plmn (snapshot, &mcc, &mnc, &description));
+    g_assert_cmpuint (mcc, ==, 214);
+    g_assert_cmpuint (mnc, ==, 3);
+    g_assert_cmpstr (description, ==, "Orange");
+    g_assert (!qmi_nas_state_snapshot_get_lac_3gpp (snapshot, NULL));
+    g_assert (qmi_nas_state_snapshot_get_gsm_signal_strength (snapshot, &rssi));
+    g_assert_cmpint (rssi, ==, -70);
+    g_assert (!qmi_nas_state_snapshot_get_lte_signal_strength (snapshot, NULL, NULL, NULL, NULL));
+
+    /* The signal state is replaced by the one in the indication, and the
+     * serving system state kept as it was. The old snapshot is unchanged. */
+    updated_id = g_signal_connect (ctx.mirror,
+                                   QMI_NAS_STATE_MIRROR_SIGNAL_UPDATED,
+                                   G_CALLBACK (state_mirror_updated),
+                                   &ctx);
+    test_port_context_invoke (fixture->ctx, (GSourceFunc) state_mirror_emit_signal_info, &ctx);
+    test_fixture_loop_run (fixture);
+    g_signal_handler_disconnect (ctx.mirror, updated_id);
+
+    g_assert (qmi_nas_state_snapshot_get_gsm_signal_strength (snapshot, NULL));
+    qmi_nas_state_snapshot_unref (snapshot);
+
+    snapshot = qmi_nas_state_mirror_get_snapshot (ctx.mirror);
+    g_assert (!qmi_nas_state_snapshot_get_gsm_signal_strength (snapshot, NULL));
+    g_assert (qmi_nas_state_snapshot_get_lte_signal_strength (snapshot, &rssi, NULL, &rsrp, NULL));
+    g_assert_cmpint (rssi, ==, -60);
+    g_assert_cmpint (rsrp, ==, -95);
+    g_assert (qmi_nas_state_snapshot_get_current_plmn (snapshot, &mcc, NULL, NULL));
+    g_assert_cmpuint (mcc, ==, 214);
+    qmi_nas_state_snapshot_unref (snapshot);
+
+    g_object_unref (ctx.mirror);
+}
+
+typedef struct {
+    StateMirrorContext *ctx;
+    gint8               rssi;
+    gint16              rsrp;
+} StateMirrorLteSignal;
+
+static gboolean
+state_mirror_emit_lte_signal_info (StateMirrorLteSignal *signal)
+{
+    QmiMessage *indication;
+    gsize       init_offset;
+
+    indication = qmi_message_new (QMI_SERVICE_NAS,
+                                  qmi_client_get_cid (signal->ctx->fixture->service_info[QMI_SERVICE_NAS].client),
+                                  0,
+                                  0x0051);
+    ((GByteArray *) indication)->data[6] |= 0x04;
+
+    init_offset = qmi_message_tlv_write_init (indication, 0x14, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_gint8 (indication, signal->rssi, NULL));
+    g_assert (qmi_message_tlv_write_gint8 (indication, -9, NULL));
+    g_assert (qmi_message_tlv_write_gint16 (indication, QMI_ENDIAN_LITTLE, signal->rsrp, NULL));
+    g_assert (qmi_message_tlv_write_gint16 (indication, QMI_ENDIAN_LITTLE, 132, NULL));
+    g_assert (qmi_message_tlv_write_complete (indication, init_offset, NULL));
+
+    test_port_context_write (signal->ctx->fixture->ctx, indication->data, indication->len);
+    qmi_message_unref (indication);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+state_mirror_updated_count (QmiNasStateMirror *mirror,
+                            guint             *n_updates)
+{
+    (*n_updates)++;
+}
+
+static void
+test_generated_nas_state_mirror_resolution (TestFixture *fixture)
+{
+    StateMirrorContext   ctx = { fixture, NULL };
+    StateMirrorLteSignal signals[] = {
+        { &ctx, -60,  -95 },
+        { &ctx, -62,  -97 }, /* less than 5dB away, ignored */
+        { &ctx, -66, -101 },
+    };
+    QmiNasStateSnapshot *snapshot;
+    gint8                rssi;
+    gint16               rsrp;
+    gulong               updated_id;
+    gulong               count_id;
+    guint                n_updates = 0;
+    guint                i;
+
+    test_port_context_set_responder (fixture->ctx, state_mirror_responder, NULL);
+    qmi_nas_state_mirror_new_full (QMI_CLIENT_NAS (fixture->service_info[QMI_SERVICE_NAS].client), 5, NULL,
+                                   (GAsyncReadyCallback) state_mirror_new_ready,
+                                   &ctx);
+    test_fixture_loop_run (fixture);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+    fixture->service_info[QMI_SERVICE_NAS].transaction_id += 4;
+
+    updated_id = g_signal_connect (ctx.mirror,
+                                   QMI_NAS_STATE_MIRROR_SIGNAL_UPDATED,
+                                   G_CALLBACK (state_mirror_updated),
+                                   &ctx);
+    count_id = g_signal_connect (ctx.mirror,
+                                 QMI_NAS_STATE_MIRROR_SIGNAL_UPDATED,
+                                 G_CALLBACK (state_mirror_updated_count),
+                                 &n_updates);
+
+    /* The radio interface change is always reported */
+    test_port_context_invoke (fixture->ctx, (GSourceFunc) state_mirror_emit_lte_signal_info, &signals[0]);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (n_updates, ==, 1);
+
+    /* Indications are processed in order, so the next update is the one
+     * of the last indication */
+    for (i = 1; i < G_N_ELEMENTS (signals); i++)
+        test_port_context_invoke (fixture->ctx, (GSourceFunc) state_mirror_emit_lte_signal_info, &signals[i]);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (n_updates, ==, 2);
+
+    g_signal_handler_disconnect (ctx.mirror, updated_id);
+    g_signal_handler_disconnect (ctx.mirror, count_id);
+
+    snapshot = qmi_nas_state_mirror_get_snapshot (ctx.mirror);
+    g_assert (qmi_nas_state_snapshot_get_lte_signal_strength (snapshot, &rssi, NULL, &rsrp, NULL));
+    g_assert_cmpint (rssi, ==, -66);
+    g_assert_cmpint (rsrp, ==, -101);
+    qmi_nas_state_snapshot_unref (snapshot);
+
+    g_object_unref (ctx.mirror);
+}
+
+static void
+indication_callback_signal_info (QmiClient          *client,
+                                 QmiMessage         *message,
+                                 StateMirrorContext *ctx)
+{
+    const guint8 *raw;
+    guint16       raw_length = 0;
+
+    g_assert_cmpuint (qmi_message_get_message_id (message), ==, 0x0051);
+    raw = qmi_message_get_raw_tlv (message, 0x14, &raw_length);
+    g_assert (raw);
+    g_assert_cmpuint (raw_length, ==, 6);
+    g_assert_cmpint ((gint8) raw[0], ==, -60);
+
+    /* Removing it from within the callback is allowed */
+    qmi_client_remove_indication_callback (client, GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (client), "callback-id")));
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+test_generated_nas_indication_callback (TestFixture *fixture)
+{
+    StateMirrorContext  ctx = { fixture, NULL };
+    QmiClient          *client;
+    guint               callback_id;
+
+    client = fixture->service_info[QMI_SERVICE_NAS].client;
+    callback_id = qmi_client_add_indication_callback (client,
+                                                      0x0051,
+                                                      (QmiClientIndicationCallback) indication_callback_signal_info,
+                                                      &ctx,
+                                                      NULL);
+    g_assert_cmpuint (callback_id, >, 0);
+    g_object_set_data (G_OBJECT (client), "callback-id", GUINT_TO_POINTER (callback_id));
+
+    test_port_context_invoke (fixture->ctx, (GSourceFunc) state_mirror_emit_signal_info, &ctx);
+    test_fixture_loop_run (fixture);
+
+    g_object_set_data (G_OBJECT (client), "callback-id", NULL);
+}
+
+static void
+indication_cache_allocate_ready (QmiDevice          *device,
+                                 GAsyncResult       *res,
+                                 StateMirrorContext *ctx)
+{
+    QmiClient *client;
+    GError    *error = NULL;
+    guint      callback_id;
+
+    client = qmi_device_allocate_client_finish (device, res, &error);
+    g_assert_no_error (error);
+    g_assert (QMI_IS_CLIENT_NAS (client));
+
+    /* The cached indication is reported once given the client */
+    callback_id = qmi_client_add_indication_callback (client,
+                                                      0x0051,
+                                                      (QmiClientIndicationCallback) indication_callback_signal_info,
+                                                      ctx,
+                                                      NULL);
+    g_object_set_data (G_OBJECT (client), "callback-id", GUINT_TO_POINTER (callback_id));
+    g_object_set_data_full (G_OBJECT (device), "cached-client", client, g_object_unref);
+}
+
+static void
+test_generated_nas_indication_cache (TestFixture *fixture)
+{
+    StateMirrorContext  ctx = { fixture, NULL };
+    QmiClient          *client;
+    GPtrArray          *cached;
+    guint8              next_cid = 0x10;
+
+    g_object_set (fixture->device, QMI_DEVICE_INDICATION_CACHE, TRUE, NULL);
+
+    /* Received by the existing client, and kept */
+    client = fixture->service_info[QMI_SERVICE_NAS].client;
+    g_object_set_data (G_OBJECT (client), "callback-id",
+                       GUINT_TO_POINTER (qmi_client_add_indication_callback (client,
+                                                                             0x0051,
+                                                                             (QmiClientIndicationCallback) indication_callback_signal_info,
+                                                                             &ctx,
+                                                                             NULL)));
+    test_port_context_invoke (fixture->ctx, (GSourceFunc) state_mirror_emit_signal_info, &ctx);
+    test_fixture_loop_run (fixture);
+    g_object_set_data (G_OBJECT (client), "callback-id", NULL);
+
+    cached = qmi_device_get_cached_indications (fixture->device, QMI_SERVICE_NAS);
+    g_assert_cmpuint (cached->len, ==, 1);
+    g_assert_cmpuint (qmi_message_get_message_id (g_ptr_array_index (cached, 0)), ==, 0x0051);
+    g_ptr_array_unref (cached);
+    cached = qmi_device_get_cached_indications (fixture->device, QMI_SERVICE_WDS);
+    g_assert_cmpuint (cached->len, ==, 0);
+    g_ptr_array_unref (cached);
+
+    /* And replayed to a new client of the same service */
+    test_port_context_set_responder (fixture->ctx, allocate_clients_responder, &next_cid);
+    qmi_device_allocate_client (fixture->device, QMI_SERVICE_NAS, QMI_CID_NONE, 10, NULL,
+                                (GAsyncReadyCallback) indication_cache_allocate_ready,
+                                &ctx);
+    test_fixture_loop_run (fixture);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+    fixture->service_info[QMI_SERVICE_CTL].transaction_id++;
+
+    client = g_object_get_data (G_OBJECT (fixture->device), "cached-client");
+    g_assert (client);
+    g_object_set_data (G_OBJECT (client), "callback-id", NULL);
+    qmi_device_release_client (fixture->device, client, QMI_DEVICE_RELEASE_CLIENT_FLAGS_NONE, 1, NULL, NULL, NULL);
+    g_object_set_data (G_OBJECT (fixture->device), "cached-client", NULL);
+
+    g_object_set (fixture->device, QMI_DEVICE_INDICATION_CACHE, FALSE, NULL);
+    cached = qmi_device_get_cached_indications (fixture->device, QMI_SERVICE_NAS);
+    g_assert_cmpuint (cached->len, ==, 0);
+    g_ptr_array_unref (cached);
+}
+
+
+/*****************************************************************************/
+/* WDS statistics sampler */
+
+typedef struct {
+    TestFixture        *fixture;
+    QmiWdsStatsSampler *sampler;
+    gboolean            event_report_supported;
+    guint               n_updates;
+    guint               n_updates_expected;
+    guint64             n_responses;
+} StatsSamplerContext;
+
+static GByteArray *
+stats_sampler_responder (TestPortContext *ctx,
+                         GByteArray      *request,
+                         gpointer         user_data)
+{
+    StatsSamplerContext *sampler_ctx = user_data;
+    QmiMessage          *response;
+    gsize                init_offset;
+
+    g_assert_cmpuint (qmi_message_get_service ((QmiMessage *)request), ==, QMI_SERVICE_WDS);
+
+    switch (qmi_message_get_message_id ((QmiMessage *)request)) {
+    case 0x0001: /* Set Event Report */
+        return qmi_message_response_new ((QmiMessage *)request,
+                                         (sampler_ctx->event_report_supported ?
+                                          QMI_PROTOCOL_ERROR_NONE :
+                                          QMI_PROTOCOL_ERROR_NOT_SUPPORTED));
+    case 0x0024: /* Get Packet Statistics */
+        response = qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+        init_offset = qmi_message_tlv_write_init (response, 0x19, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, 1000, NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        init_offset = qmi_message_tlv_write_init (response, 0x1A, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint64 (response, QMI_ENDIAN_LITTLE, 5000, NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        return response;
+    default:
+        g_assert_not_reached ();
+    }
+}
+
+static gboolean
+stats_sampler_emit_event_reports (StatsSamplerContext *ctx)
+{
+    guint i;
+
+    for (i = 0; i < 2; i++) {
+        QmiMessage *indication;
+        gsize       init_offset;
+
+        /* WDS Event Report, with the byte counters only */
+        indication = qmi_message_new (QMI_SERVICE_WDS,
+                                      qmi_client_get_cid (ctx->fixture->service_info[QMI_SERVICE_WDS].client),
+                                      0,
+                                      0x0001);
+        ((GByteArray *) indication)->data[6] |= 0x04;
+
+        init_offset = qmi_message_tlv_write_init (indication, 0x19, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint64 (indication, QMI_ENDIAN_LITTLE, 1000 + (i * 200), NULL));
+        g_assert (qmi_message_tlv_write_complete (indication, init_offset, NULL));
+        init_offset = qmi_message_tlv_write_init (indication, 0x1A, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint64 (indication, QMI_ENDIAN_LITTLE, 5000 + (i * 3000), NULL));
+        g_assert (qmi_message_tlv_write_complete (indication, init_offset, NULL));
+
+        test_port_context_write (ctx->fixture->ctx, indication->data, indication->len);
+        qmi_message_unref (indication);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static void
+stats_sampler_new_ready (GObject             *source,
+                         GAsyncResult        *res,
+                         StatsSamplerContext *ctx)
+{
+    GError *error = NULL;
+
+    ctx->sampler = qmi_wds_stats_sampler_new_finish (res, &error);
+    g_assert_no_error (error);
+    g_assert (ctx->sampler);
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+stats_sampler_updated (QmiWdsStatsSampler  *sampler,
+                       StatsSamplerContext *ctx)
+{
+    ctx->n_updates++;
+    if (ctx->sampler && ctx->n_updates >= ctx->n_updates_expected)
+        test_fixture_loop_stop (ctx->fixture);
+}
+
+static gboolean
+stats_sampler_check_response (StatsSamplerContext *ctx)
+{
+    QmiDeviceStats stats;
+
+    qmi_device_get_stats (ctx->fixture->device, &stats);
+    if (stats.n_responses <= ctx->n_responses)
+        return G_SOURCE_CONTINUE;
+
+    test_fixture_loop_stop (ctx->fixture);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+test_generated_wds_stats_sampler (TestFixture *fixture)
+{
+    StatsSamplerContext ctx = { fixture, NULL, TRUE, 0, 0, 0 };
+    QmiWdsStatsSample   sample;
+    QmiDeviceStats      stats;
+
+    test_port_context_set_responder (fixture->ctx, stats_sampler_responder, &ctx);
+    qmi_wds_stats_sampler_new (QMI_CLIENT_WDS (fixture->service_info[QMI_SERVICE_WDS].client), 1, 4, NULL,
+                               (GAsyncReadyCallback) stats_sampler_new_ready,
+                               &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert (!qmi_wds_stats_sampler_get_polling (ctx.sampler));
+    g_assert_cmpuint (qmi_wds_stats_sampler_get_n_samples (ctx.sampler), ==, 0);
+
+    g_signal_connect (ctx.sampler,
+                      QMI_WDS_STATS_SAMPLER_SIGNAL_UPDATED,
+                      G_CALLBACK (stats_sampler_updated),
+                      &ctx);
+    ctx.n_updates_expected = 2;
+    test_port_context_invoke (fixture->ctx, (GSourceFunc) stats_sampler_emit_event_reports, &ctx);
+    test_fixture_loop_run (fixture);
+
+    g_assert_cmpuint (qmi_wds_stats_sampler_get_n_samples (ctx.sampler), ==, 2);
+    g_assert (qmi_wds_stats_sampler_get_sample (ctx.sampler, 0, &sample));
+    g_assert_cmpuint (sample.tx_bytes, ==, 1200);
+    g_assert_cmpuint (sample.rx_bytes, ==, 8000);
+    g_assert_cmpuint (sample.tx_bytes_delta, ==, 200);
+    g_assert_cmpuint (sample.rx_bytes_delta, ==, 3000);
+    g_assert (qmi_wds_stats_sampler_get_sample (ctx.sampler, 1, &sample));
+    g_assert_cmpuint (sample.tx_bytes, ==, 1000);
+    g_assert_cmpuint (sample.interval, ==, 0);
+    g_assert (!qmi_wds_stats_sampler_get_sample (ctx.sampler, 2, &sample));
+
+    /* Wait for the reports to be disabled before going on */
+    qmi_device_get_stats (fixture->device, &stats);
+    ctx.n_responses = stats.n_responses;
+    g_object_unref (ctx.sampler);
+    g_timeout_add (10, (GSourceFunc) stats_sampler_check_response, &ctx);
+    test_fixture_loop_run (fixture);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+
+    /* Enable and disable reports */
+    fixture->service_info[QMI_SERVICE_WDS].transaction_id += 2;
+}
+
+static void
+test_generated_wds_stats_sampler_polling (TestFixture *fixture)
+{
+    StatsSamplerContext ctx = { fixture, NULL, FALSE, 0, 1, 0 };
+    QmiWdsStatsSample   sample;
+
+    test_port_context_set_responder (fixture->ctx, stats_sampler_responder, &ctx);
+    qmi_wds_stats_sampler_new (QMI_CLIENT_WDS (fixture->service_info[QMI_SERVICE_WDS].client), 255, 4, NULL,
+                               (GAsyncReadyCallback) stats_sampler_new_ready,
+                               &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert (qmi_wds_stats_sampler_get_polling (ctx.sampler));
+
+    /* The initial poll may complete before or after the sampler is ready */
+    if (qmi_wds_stats_sampler_get_n_samples (ctx.sampler) == 0) {
+        g_signal_connect (ctx.sampler,
+                          QMI_WDS_STATS_SAMPLER_SIGNAL_UPDATED,
+                          G_CALLBACK (stats_sampler_updated),
+                          &ctx);
+        test_fixture_loop_run (fixture);
+    }
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+
+    g_assert_cmpuint (qmi_wds_stats_sampler_get_n_samples (ctx.sampler), ==, 1);
+    g_assert (qmi_wds_stats_sampler_get_sample (ctx.sampler, 0, &sample));
+    g_assert_cmpuint (sample.tx_bytes, ==, 1000);
+    g_assert_cmpuint (sample.rx_bytes, ==, 5000);
+    g_object_unref (ctx.sampler);
+
+    /* Set Event Report and Get Packet Statistics */
+    fixture->service_info[QMI_SERVICE_WDS].transaction_id += 2;
+}
+
+/*****************************************************************************/
+/* KPI sampler */
+
+static GByteArray *
+kpi_sampler_responder (TestPortContext *ctx,
+                       GByteArray      *request,
+                       gpointer         user_data)
+{
+    QmiMessage   *response;
+    gsize         init_offset;
+    const guint8 *raw;
+    guint16       raw_length = 0;
+
+    if (qmi_message_get_service ((QmiMessage *)request) == QMI_SERVICE_WDS) {
+        g_assert_cmpuint (qmi_message_get_message_id ((QmiMessage *)request), ==, 0x0023);
+        response = qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+        init_offset = qmi_message_tlv_write_init (response, 0x01, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, 50000000, NULL));
+        g_assert (qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, 150000000, NULL));
+        g_assert (qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, 0, NULL));
+        g_assert (qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, 0, NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        return (GByteArray *)response;
+    }
+
+    g_assert_cmpuint (qmi_message_get_service ((QmiMessage *)request), ==, QMI_SERVICE_NAS);
+
+    switch (qmi_message_get_message_id ((QmiMessage *)request)) {
+    case 0x004F: /* Get Signal Info */
+        response = qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+        init_offset = qmi_message_tlv_write_init (response, 0x14, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_gint8 (response, -60, NULL));
+        g_assert (qmi_message_tlv_write_gint8 (response, -9, NULL));
+        g_assert (qmi_message_tlv_write_gint16 (response, QMI_ENDIAN_LITTLE, -95, NULL));
+        g_assert (qmi_message_tlv_write_gint16 (response, QMI_ENDIAN_LITTLE, 132, NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        return (GByteArray *)response;
+    case 0x005A: /* Get Tx Rx Info, primary chain tuned and in traffic */
+        raw = qmi_message_get_raw_tlv ((QmiMessage *)request, 0x01, &raw_length);
+        g_assert (raw);
+        g_assert_cmpuint (raw_length, ==, 1);
+        g_assert_cmpint ((gint8) raw[0], ==, QMI_NAS_RADIO_INTERFACE_LTE);
+        response = qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+        init_offset = qmi_message_tlv_write_init (response, 0x10, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint8 (response, 1, NULL));
+        g_assert (qmi_message_tlv_write_gint32 (response, QMI_ENDIAN_LITTLE, -650, NULL));
+        g_assert (qmi_message_tlv_write_gint32 (response, QMI_ENDIAN_LITTLE, 0, NULL));
+        g_assert (qmi_message_tlv_write_gint32 (response, QMI_ENDIAN_LITTLE, 0, NULL));
+        g_assert (qmi_message_tlv_write_gint32 (response, QMI_ENDIAN_LITTLE, -950, NULL));
+        g_assert (qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, 0, NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        init_offset = qmi_message_tlv_write_init (response, 0x12, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint8 (response, 1, NULL));
+        g_assert (qmi_message_tlv_write_gint32 (response, QMI_ENDIAN_LITTLE, 120, NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        return (GByteArray *)response;
+    case 0x00AC: /* Get LTE Cphy CA Info */
+        return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NOT_SUPPORTED);
+    default:
+        g_assert_not_reached ();
+    }
+}
+
+static void
+kpi_sampler_updated (QmiKpiSampler *sampler,
+                     TestFixture   *fixture)
+{
+    test_fixture_loop_stop (fixture);
+}
+
+static void
+test_generated_kpi_sampler (TestFixture *fixture)
+{
+    QmiKpiSampler   *sampler;
+    QmiKpiAggregate  aggregate;
+    GBytes          *bytes;
+    const gchar     *csv;
+    gsize            size;
+    gint32           value;
+    gint64           timestamp = 0;
+
+    test_port_context_set_responder (fixture->ctx, kpi_sampler_responder, NULL);
+    sampler = qmi_kpi_sampler_new (NULL,
+                                   QMI_CLIENT_NAS (fixture->service_info[QMI_SERVICE_NAS].client),
+                                   QMI_CLIENT_WDS (fixture->service_info[QMI_SERVICE_WDS].client),
+                                   60, 4);
+    g_signal_connect (sampler,
+                      QMI_KPI_SAMPLER_SIGNAL_UPDATED,
+                      G_CALLBACK (kpi_sampler_updated),
+                      fixture);
+    test_fixture_loop_run (fixture);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+
+    /* All the responses of the burst in the same sample */
+    g_assert_cmpuint (qmi_kpi_sampler_get_n_samples (sampler), ==, 1);
+    g_assert (qmi_kpi_sampler_get_value (sampler, 0, QMI_KPI_METRIC_LTE_RSSI, &timestamp, &value));
+    g_assert_cmpint (value, ==, -60);
+    g_assert_cmpint (timestamp, >, 0);
+    g_assert (qmi_kpi_sampler_get_value (sampler, 0, QMI_KPI_METRIC_LTE_RSRP, NULL, &value));
+    g_assert_cmpint (value, ==, -95);
+    g_assert (qmi_kpi_sampler_get_value (sampler, 0, QMI_KPI_METRIC_LTE_RX0_POWER, NULL, &value));
+    g_assert_cmpint (value, ==, -650);
+    g_assert (!qmi_kpi_sampler_get_value (sampler, 0, QMI_KPI_METRIC_LTE_RX1_POWER, NULL, NULL));
+    g_assert (qmi_kpi_sampler_get_value (sampler, 0, QMI_KPI_METRIC_LTE_TX_POWER, NULL, &value));
+    g_assert_cmpint (value, ==, 120);
+    g_assert (!qmi_kpi_sampler_get_value (sampler, 0, QMI_KPI_METRIC_LTE_PCELL_PCI, NULL, NULL));
+    g_assert (!qmi_kpi_sampler_get_value (sampler, 0, QMI_KPI_METRIC_GSM_RSSI, NULL, NULL));
+    g_assert (qmi_kpi_sampler_get_value (sampler, 0, QMI_KPI_METRIC_RX_RATE, NULL, &value));
+    g_assert_cmpint (value, ==, 150000);
+    g_assert (!qmi_kpi_sampler_get_value (sampler, 1, QMI_KPI_METRIC_LTE_RSSI, NULL, NULL));
+
+    g_assert (qmi_kpi_sampler_aggregate (sampler, QMI_KPI_METRIC_LTE_SNR, 0, &aggregate));
+    g_assert_cmpuint (aggregate.n_values, ==, 1);
+    g_assert_cmpint (aggregate.min, ==, 132);
+    g_assert_cmpint (aggregate.max, ==, 132);
+    g_assert_cmpfloat (aggregate.mean, ==, 132.0);
+    g_assert (!qmi_kpi_sampler_aggregate (sampler, QMI_KPI_METRIC_LTE_SCELL_STATE, G_USEC_PER_SEC, &aggregate));
+
+    bytes = qmi_kpi_sampler_export (sampler, QMI_KPI_EXPORT_FORMAT_CSV);
+    csv = g_bytes_get_data (bytes, &size);
+    g_assert (g_str_has_prefix (csv, "timestamp,lte-rssi,lte-rsrq,lte-rsrp,lte-snr,"));
+    g_assert (g_strstr_len (csv, size, ",-60,-9,-95,132,,,,-650,,120,"));
+    g_assert (g_str_has_suffix (csv, ",50000,150000\n"));
+    g_bytes_unref (bytes);
+
+    bytes = qmi_kpi_sampler_export (sampler, QMI_KPI_EXPORT_FORMAT_BINARY);
+    g_assert_cmpuint (g_bytes_get_size (bytes), ==, 16 + 12 + 4 * QMI_KPI_METRIC_LAST);
+    g_assert (memcmp (g_bytes_get_data (bytes, NULL), "QKPI\x01\x00", 6) == 0);
+    g_bytes_unref (bytes);
+
+    g_object_unref (sampler);
+
+    /* Signal Info, Tx Rx Info and LTE Cphy CA Info; Channel Rates */
+    fixture->service_info[QMI_SERVICE_NAS].transaction_id += 3;
+    fixture->service_info[QMI_SERVICE_WDS].transaction_id += 1;
+}
+
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* PDC Load Config */
+
+typedef struct {
+    TestFixture *fixture;
+    gsize        size;
+    gsize        received;      /* port thread only */
+    goffset      loaded;
+    guint        n_progress;
+} LoadConfigContext;
+
+static GByteArray *
+load_config_responder (TestPortContext *ctx,
+                       GByteArray      *request,
+                       gpointer         user_data)
+{
+    LoadConfigContext *load_ctx = user_data;
+    QmiMessage        *indication;
+    gsize              init_offset;
+    gsize              offset = 0;
+    guint32            token;
+    const guint8      *chunk;
+    guint16            chunk_tlv_length;
+
+    g_assert_cmpuint (qmi_message_get_service ((QmiMessage *)request), ==, QMI_SERVICE_PDC);
+    g_assert_cmpuint (qmi_message_get_message_id ((QmiMessage *)request), ==, 0x0026);
+
+    init_offset = qmi_message_tlv_read_init ((QmiMessage *)request, 0x10, NULL, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_read_guint32 ((QmiMessage *)request, init_offset, &offset, QMI_ENDIAN_LITTLE, &token, NULL));
+
+    /* Type, 20-byte id with its length, total size and chunk length */
+    chunk = qmi_message_get_raw_tlv ((QmiMessage *)request, 0x01, &chunk_tlv_length);
+    g_assert (chunk);
+    g_assert_cmpuint (chunk_tlv_length, >, 4 + 1 + 20 + 4 + 2);
+    load_ctx->received += chunk_tlv_length - (4 + 1 + 20 + 4 + 2);
+    g_assert_cmpuint (load_ctx->received, <=, load_ctx->size);
+
+    /* The indication may be processed before the response */
+    indication = qmi_message_new (QMI_SERVICE_PDC, qmi_message_get_client_id ((QmiMessage *)request), 0, 0x0026);
+    ((GByteArray *) indication)->data[6] |= 0x04;
+    init_offset = qmi_message_tlv_write_init (indication, 0x01, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_guint16 (indication, QMI_ENDIAN_LITTLE, 0, NULL));
+    g_assert (qmi_message_tlv_write_complete (indication, init_offset, NULL));
+    init_offset = qmi_message_tlv_write_init (indication, 0x10, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_guint32 (indication, QMI_ENDIAN_LITTLE, token, NULL));
+    g_assert (qmi_message_tlv_write_complete (indication, init_offset, NULL));
+    init_offset = qmi_message_tlv_write_init (indication, 0x12, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_guint32 (indication, QMI_ENDIAN_LITTLE, load_ctx->size - load_ctx->received, NULL));
+    g_assert (qmi_message_tlv_write_complete (indication, init_offset, NULL));
+    test_port_context_write (ctx, indication->data, indication->len);
+    qmi_message_unref (indication);
+
+    return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+}
+
+static void
+load_config_progress (goffset            current_num_bytes,
+                      goffset            total_num_bytes,
+                      LoadConfigContext *ctx)
+{
+    g_assert_cmpint (total_num_bytes, ==, ctx->size);
+    g_assert_cmpint (current_num_bytes, >, ctx->loaded);
+    ctx->loaded = current_num_bytes;
+    ctx->n_progress++;
+}
+
+static void
+load_config_ready (QmiClientPdc      *client,
+                   GAsyncResult      *res,
+                   LoadConfigContext *ctx)
+{
+    GError *error = NULL;
+    GArray *id;
+
+    id = qmi_client_pdc_load_config_from_file_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (id);
+    g_assert_cmpuint (id->len, ==, 20);
+    g_array_unref (id);
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+test_generated_pdc_load_config (TestFixture *fixture)
+{
+    LoadConfigContext  ctx = { fixture, 0, 0, 0, 0 };
+    GError            *error = NULL;
+    gchar             *path;
+    gchar             *contents;
+    gint               fd;
+
+    /* Three chunks, the last one not full */
+    ctx.size = (2 * QMI_PDC_LOAD_CONFIG_CHUNK_SIZE) + 100;
+    contents = g_malloc (ctx.size);
+    memset (contents, 0xAB, ctx.size);
+    fd = g_file_open_tmp ("test-pdc-load-config-XXXXXX", &path, &error);
+    g_assert_no_error (error);
+    close (fd);
+    g_assert (g_file_set_contents (path, contents, ctx.size, &error));
+    g_assert_no_error (error);
+    g_free (contents);
+
+    test_port_context_set_responder (fixture->ctx, load_config_responder, &ctx);
+    qmi_client_pdc_load_config_from_file (QMI_CLIENT_PDC (fixture->service_info[QMI_SERVICE_PDC].client),
+                                          path,
+                                          QMI_PDC_CONFIGURATION_TYPE_SOFTWARE,
+                                          2,
+                                          (GFileProgressCallback) load_config_progress,
+                                          &ctx,
+                                          NULL,
+                                          (GAsyncReadyCallback) load_config_ready,
+                                          &ctx);
+    test_fixture_loop_run (fixture);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+
+    g_assert_cmpint (ctx.loaded, ==, ctx.size);
+    g_assert_cmpuint (ctx.n_progress, ==, 3);
+
+    /* One request per chunk */
+    fixture->service_info[QMI_SERVICE_PDC].transaction_id += 3;
+
+    g_unlink (path);
+    g_free (path);
+}
+
+/*****************************************************************************/
+/* UIM Read File */
+
+#define READ_FILE_RECORD_COUNT 5
+#define READ_FILE_RECORD_SIZE  4
+
+static GByteArray *
+read_file_responder (TestPortContext *ctx,
+                     GByteArray      *request,
+                     gpointer         user_data)
+{
+    QmiMessage *response;
+    gsize       init_offset;
+    gsize       offset = 0;
+    guint16     record_number;
+    guint16     record_length;
+    guint8      record[READ_FILE_RECORD_SIZE];
+    guint       i;
+
+    g_assert_cmpuint (qmi_message_get_service ((QmiMessage *)request), ==, QMI_SERVICE_UIM);
+
+    response = qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+
+    switch (qmi_message_get_message_id ((QmiMessage *)request)) {
+    case 0x0024: /* Get File Attributes */
+        init_offset = qmi_message_tlv_write_init (response, 0x11, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, READ_FILE_RECORD_COUNT * READ_FILE_RECORD_SIZE, NULL));
+        g_assert (qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, 0x6F3A, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (response, QMI_UIM_FILE_TYPE_LINEAR_FIXED, NULL));
+        g_assert (qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, READ_FILE_RECORD_SIZE, NULL));
+        g_assert (qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, READ_FILE_RECORD_COUNT, NULL));
+        /* Read, write, increase, deactivate and activate security attributes */
+        for (i = 0; i < 5; i++) {
+            g_assert (qmi_message_tlv_write_guint8 (response, QMI_UIM_SECURITY_ATTRIBUTE_LOGIC_ALWAYS, NULL));
+            g_assert (qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, 0, NULL));
+        }
+        g_assert (qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, 0, NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        break;
+    case 0x0021: /* Read Record */
+        init_offset = qmi_message_tlv_read_init ((QmiMessage *)request, 0x03, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint16 ((QmiMessage *)request, init_offset, &offset, QMI_ENDIAN_LITTLE, &record_number, NULL));
+        g_assert (qmi_message_tlv_read_guint16 ((QmiMessage *)request, init_offset, &offset, QMI_ENDIAN_LITTLE, &record_length, NULL));
+        g_assert_cmpuint (record_number, >=, 1);
+        g_assert_cmpuint (record_number, <=, READ_FILE_RECORD_COUNT);
+        g_assert_cmpuint (record_length, ==, READ_FILE_RECORD_SIZE);
+
+        memset (record, record_number, sizeof (record));
+        init_offset = qmi_message_tlv_write_init (response, 0x11, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_string (response, 2, (const gchar *) record, sizeof (record), NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        break;
+    default:
+        g_assert_not_reached ();
+    }
+
+    return response;
+}
+
+static void
+read_file_ready (QmiClientUim *client,
+                 GAsyncResult *res,
+                 TestFixture  *fixture)
+{
+    GError         *error = NULL;
+    GArray         *contents;
+    QmiUimFileType  file_type;
+    guint16         record_size;
+    guint           i;
+
+    contents = qmi_client_uim_read_file_finish (client, res, &file_type, &record_size, &error);
+    g_assert_no_error (error);
+    g_assert (contents);
+    g_assert_cmpuint (file_type, ==, QMI_UIM_FILE_TYPE_LINEAR_FIXED);
+    g_assert_cmpuint (record_size, ==, READ_FILE_RECORD_SIZE);
+    g_assert_cmpuint (contents->len, ==, READ_FILE_RECORD_COUNT * READ_FILE_RECORD_SIZE);
+
+    /* Records in order, whatever the order of the responses */
+    for (i = 0; i < contents->len; i++)
+        g_assert_cmpuint (contents->data[i], ==, 1 + (i / READ_FILE_RECORD_SIZE));
+
+    g_array_unref (contents);
+    test_fixture_loop_stop (fixture);
+}
+
+static void
+test_generated_uim_read_file (TestFixture *fixture)
+{
+    GArray *file_path;
+    guint8  path[] = { 0x00, 0x3F, 0x10, 0x7F };
+
+    file_path = g_array_sized_new (FALSE, FALSE, sizeof (guint8), G_N_ELEMENTS (path));
+    g_array_append_vals (file_path, path, G_N_ELEMENTS (path));
+
+    test_port_context_set_responder (fixture->ctx, read_file_responder, NULL);
+    qmi_client_uim_read_file (QMI_CLIENT_UIM (fixture->service_info[QMI_SERVICE_UIM].client),
+                              QMI_UIM_SESSION_TYPE_CARD_SLOT_1,
+                              "",
+                              0x6F3A,
+                              file_path,
+                              3,
+                              NULL,
+                              (GAsyncReadyCallback) read_file_ready,
+                              fixture);
+    test_fixture_loop_run (fixture);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+    g_array_unref (file_path);
+
+    /* Get File Attributes and one Read Record per record */
+    fixture->service_info[QMI_SERVICE_UIM].transaction_id += 1 + READ_FILE_RECORD_COUNT;
+}
+
+/*****************************************************************************/
+/* UIM card status cache */
+
+typedef struct {
+    TestFixture           *fixture;
+    QmiUimCardStatusCache *cache;
+    guint                  n_register_events;
+    guint                  n_get_card_status;
+    guint                  n_invalidated;
+} CardStatusCacheContext;
+
+static GByteArray *
+card_status_cache_responder (TestPortContext *ctx,
+                             GByteArray      *request,
+                             gpointer         user_data)
+{
+    CardStatusCacheContext *cache_ctx = user_data;
+
+    g_assert_cmpuint (qmi_message_get_service ((QmiMessage *)request), ==, QMI_SERVICE_UIM);
+
+    switch (qmi_message_get_message_id ((QmiMessage *)request)) {
+    case 0x002E: /* Register Events */
+        cache_ctx->n_register_events++;
+        break;
+    case 0x002F: /* Get Card Status */
+        cache_ctx->n_get_card_status++;
+        break;
+    default:
+        g_assert_not_reached ();
+    }
+
+    return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+}
+
+static gboolean
+card_status_cache_emit_indication (CardStatusCacheContext *ctx)
+{
+    QmiMessage *indication;
+
+    /* UIM Card Status, contents are not looked at */
+    indication = qmi_message_new (QMI_SERVICE_UIM,
+                                  qmi_client_get_cid (ctx->fixture->service_info[QMI_SERVICE_UIM].client),
+                                  0,
+                                  0x0032);
+    ((GByteArray *) indication)->data[6] |= 0x04;
+
+    test_port_context_write (ctx->fixture->ctx, indication->data, indication->len);
+    qmi_message_unref (indication);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+card_status_cache_new_ready (GObject                *source,
+                             GAsyncResult           *res,
+                             CardStatusCacheContext *ctx)
+{
+    GError *error = NULL;
+
+    ctx->cache = qmi_uim_card_status_cache_new_finish (res, &error);
+    g_assert_no_error (error);
+    g_assert (ctx->cache);
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+card_status_cache_get_ready (QmiUimCardStatusCache  *cache,
+                             GAsyncResult           *res,
+                             CardStatusCacheContext *ctx)
+{
+    QmiMessageUimGetCardStatusOutput *output;
+    GError                           *error = NULL;
+
+    output = qmi_uim_card_status_cache_get_card_status_finish (cache, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+    qmi_message_uim_get_card_status_output_unref (output);
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+card_status_cache_invalidated (QmiUimCardStatusCache  *cache,
+                               CardStatusCacheContext *ctx)
+{
+    ctx->n_invalidated++;
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+test_generated_uim_card_status_cache (TestFixture *fixture)
+{
+    CardStatusCacheContext ctx = { fixture, NULL, 0, 0, 0 };
+
+    test_port_context_set_responder (fixture->ctx, card_status_cache_responder, &ctx);
+    qmi_uim_card_status_cache_new (QMI_CLIENT_UIM (fixture->service_info[QMI_SERVICE_UIM].client), NULL,
+                                   (GAsyncReadyCallback) card_status_cache_new_ready,
+                                   &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_register_events, ==, 1);
+    g_assert (!qmi_uim_card_status_cache_peek_card_status (ctx.cache));
+
+    g_signal_connect (ctx.cache,
+                      QMI_UIM_CARD_STATUS_CACHE_SIGNAL_INVALIDATED,
+                      G_CALLBACK (card_status_cache_invalidated),
+                      &ctx);
+
+    /* First read queries the device */
+    qmi_uim_card_status_cache_get_card_status (ctx.cache, 3, NULL, (GAsyncReadyCallback) card_status_cache_get_ready, &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_get_card_status, ==, 1);
+    g_assert (qmi_uim_card_status_cache_peek_card_status (ctx.cache));
+
+    /* Second one is a memory read */
+    qmi_uim_card_status_cache_get_card_status (ctx.cache, 3, NULL, (GAsyncReadyCallback) card_status_cache_get_ready, &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_get_card_status, ==, 1);
+
+    /* A status change drops the cached value */
+    test_port_context_invoke (fixture->ctx, (GSourceFunc) card_status_cache_emit_indication, &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_invalidated, ==, 1);
+    g_assert (!qmi_uim_card_status_cache_peek_card_status (ctx.cache));
+
+    qmi_uim_card_status_cache_get_card_status (ctx.cache, 3, NULL, (GAsyncReadyCallback) card_status_cache_get_ready, &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_get_card_status, ==, 2);
+
+    g_object_unref (ctx.cache);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+
+    /* Register Events and two Get Card Status */
+    fixture->service_info[QMI_SERVICE_UIM].transaction_id += 3;
+}
+
+/*****************************************************************************/
+/* WMS sweep */
+
+typedef struct {
+    TestFixture *fixture;
+    guint32      deleted;    /* port thread only, until completed */
+} SweepContext;
+
+static const guint32 sweep_indices[] = { 3, 7, 9 };
+
+static GByteArray *
+sweep_responder (TestPortContext *ctx,
+                 GByteArray      *request,
+                 gpointer         user_data)
+{
+    SweepContext *sweep_ctx = user_data;
+    QmiMessage   *response;
+    gsize         init_offset;
+    gsize         offset = 0;
+    guint8        storage_type;
+    guint32       memory_index;
+    guint         i;
+
+    g_assert_cmpuint (qmi_message_get_service ((QmiMessage *)request), ==, QMI_SERVICE_WMS);
+
+    switch (qmi_message_get_message_id ((QmiMessage *)request)) {
+    case 0x0031: /* List Messages */
+        response = qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+        init_offset = qmi_message_tlv_write_init (response, 0x01, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, G_N_ELEMENTS (sweep_indices), NULL));
+        for (i = 0; i < G_N_ELEMENTS (sweep_indices); i++) {
+            g_assert (qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, sweep_indices[i], NULL));
+            g_assert (qmi_message_tlv_write_guint8 (response, QMI_WMS_MESSAGE_TAG_TYPE_MT_NOT_READ, NULL));
+        }
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        return response;
+    case 0x0022: /* Raw Read */
+        init_offset = qmi_message_tlv_read_init ((QmiMessage *)request, 0x01, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint8 ((QmiMessage *)request, init_offset, &offset, &storage_type, NULL));
+        g_assert (qmi_message_tlv_read_guint32 ((QmiMessage *)request, init_offset, &offset, QMI_ENDIAN_LITTLE, &memory_index, NULL));
+        g_assert_cmpuint (storage_type, ==, QMI_WMS_STORAGE_TYPE_NV);
+
+        /* The message at index 7 cannot be read */
+        if (memory_index == 7)
+            return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_INVALID_INDEX);
+
+        response = qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+        init_offset = qmi_message_tlv_write_init (response, 0x01, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint8 (response, QMI_WMS_MESSAGE_TAG_TYPE_MT_NOT_READ, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (response, QMI_WMS_MESSAGE_FORMAT_GSM_WCDMA_POINT_TO_POINT, NULL));
+        g_assert (qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, 1, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (response, (guint8) memory_index, NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        return response;
+    case 0x0024: /* Delete */
+        init_offset = qmi_message_tlv_read_init ((QmiMessage *)request, 0x10, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint32 ((QmiMessage *)request, init_offset, &offset, QMI_ENDIAN_LITTLE, &memory_index, NULL));
+        sweep_ctx->deleted |= (1 << memory_index);
+        return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+    default:
+        g_assert_not_reached ();
+    }
+}
+
+static void
+sweep_ready (QmiClientWms *client,
+             GAsyncResult *res,
+             SweepContext *ctx)
+{
+    GError             *error = NULL;
+    GArray             *messages;
+    QmiWmsSweepMessage *message;
+
+    messages = qmi_client_wms_sweep_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (messages);
+
+    /* The message not read is skipped */
+    g_assert_cmpuint (messages->len, ==, 2);
+    message = &g_array_index (messages, QmiWmsSweepMessage, 0);
+    g_assert_cmpuint (message->memory_index, ==, 3);
+    g_assert_cmpuint (message->format, ==, QMI_WMS_MESSAGE_FORMAT_GSM_WCDMA_POINT_TO_POINT);
+    g_assert_cmpuint (message->raw_data->len, ==, 1);
+    g_assert_cmpuint (message->raw_data->data[0], ==, 3);
+    message = &g_array_index (messages, QmiWmsSweepMessage, 1);
+    g_assert_cmpuint (message->memory_index, ==, 9);
+    g_assert_cmpuint (message->raw_data->data[0], ==, 9);
+
+    g_array_unref (messages);
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+test_generated_wms_sweep (TestFixture *fixture)
+{
+    SweepContext ctx = { fixture, 0 };
+
+    test_port_context_set_responder (fixture->ctx, sweep_responder, &ctx);
+    qmi_client_wms_sweep (QMI_CLIENT_WMS (fixture->service_info[QMI_SERVICE_WMS].client),
+                          QMI_WMS_STORAGE_TYPE_NV,
+                          QMI_WMS_MESSAGE_MODE_GSM_WCDMA,
+                          QMI_WMS_SWEEP_FLAGS_DELETE,
+                          2,
+                          NULL,
+                          (GAsyncReadyCallback) sweep_ready,
+                          &ctx);
+    test_fixture_loop_run (fixture);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+
+    /* Only the messages read are deleted */
+    g_assert_cmpuint (ctx.deleted, ==, (1 << 3) | (1 << 9));
+
+    /* List Messages, 3 Raw Reads and 2 Deletes */
+    fixture->service_info[QMI_SERVICE_WMS].transaction_id += 6;
+}
+
+/*****************************************************************************/
+/* PDS NMEA stream */
+
+typedef struct {
+    TestFixture      *fixture;
+    QmiPdsNmeaStream *stream;
+    guint             n_available;
+    guint             n_expected;
+    guint64           n_responses;
+} NmeaStreamContext;
+
+static const gchar *nmea_reports[] = {
+    "$GPGGA,1*00\r\n$GPRMC,1*00\r\n",
+    "$GPGGA,2*00",
+    "$GPRMC,2*00",
+    "$GPGGA,3*00",
+};
+
+static GByteArray *
+nmea_stream_responder (TestPortContext *ctx,
+                       GByteArray      *request,
+                       gpointer         user_data)
+{
+    g_assert_cmpuint (qmi_message_get_service ((QmiMessage *)request), ==, QMI_SERVICE_PDS);
+    g_assert_cmpuint (qmi_message_get_message_id ((QmiMessage *)request), ==, 0x0001);
+    return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+}
+
+static gboolean
+nmea_stream_emit_event_reports (NmeaStreamContext *ctx)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (nmea_reports); i++) {
+        QmiMessage *indication;
+        gsize       init_offset;
+
+        /* PDS Event Report, with the NMEA position only */
+        indication = qmi_message_new (QMI_SERVICE_PDS,
+                                      qmi_client_get_cid (ctx->fixture->service_info[QMI_SERVICE_PDS].client),
+                                      0,
+                                      0x0001);
+        ((GByteArray *) indication)->data[6] |= 0x04;
+
+        init_offset = qmi_message_tlv_write_init (indication, 0x10, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_string (indication, 0, nmea_reports[i], -1, NULL));
+        g_assert (qmi_message_tlv_write_complete (indication, init_offset, NULL));
+
+        test_port_context_write (ctx->fixture->ctx, indication->data, indication->len);
+        qmi_message_unref (indication);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static void
+nmea_stream_new_ready (GObject           *source,
+                       GAsyncResult      *res,
+                       NmeaStreamContext *ctx)
+{
+    GError *error = NULL;
+
+    ctx->stream = qmi_pds_nmea_stream_new_finish (res, &error);
+    g_assert_no_error (error);
+    g_assert (ctx->stream);
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+nmea_stream_available (QmiPdsNmeaStream  *stream,
+                       NmeaStreamContext *ctx)
+{
+    ctx->n_available++;
+}
+
+static gboolean
+nmea_stream_check_sentences (NmeaStreamContext *ctx)
+{
+    if (qmi_pds_nmea_stream_get_n_sentences (ctx->stream) < ctx->n_expected)
+        return G_SOURCE_CONTINUE;
+
+    test_fixture_loop_stop (ctx->fixture);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+nmea_stream_check_response (NmeaStreamContext *ctx)
+{
+    QmiDeviceStats stats;
+
+    qmi_device_get_stats (ctx->fixture->device, &stats);
+    if (stats.n_responses <= ctx->n_responses)
+        return G_SOURCE_CONTINUE;
+
+    test_fixture_loop_stop (ctx->fixture);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+test_generated_pds_nmea_stream (TestFixture *fixture)
+{
+    NmeaStreamContext  ctx = { fixture, NULL, 0, 0, 0 };
+    QmiPdsNmeaSentence sentences[2];
+    QmiDeviceStats     stats;
+
+    test_port_context_set_responder (fixture->ctx, nmea_stream_responder, &ctx);
+    qmi_pds_nmea_stream_new (QMI_CLIENT_PDS (fixture->service_info[QMI_SERVICE_PDS].client), FALSE, 3, 2, NULL,
+                             (GAsyncReadyCallback) nmea_stream_new_ready,
+                             &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (qmi_pds_nmea_stream_get_n_sentences (ctx.stream), ==, 0);
+
+    g_signal_connect (ctx.stream,
+                      QMI_PDS_NMEA_STREAM_SIGNAL_AVAILABLE,
+                      G_CALLBACK (nmea_stream_available),
+                      &ctx);
+
+    /* One in every two sentences of each type */
+    ctx.n_expected = 3;
+    test_port_context_invoke (fixture->ctx, (GSourceFunc) nmea_stream_emit_event_reports, &ctx);
+    g_timeout_add (10, (GSourceFunc) nmea_stream_check_sentences, &ctx);
+    test_fixture_loop_run (fixture);
+
+    g_assert_cmpuint (ctx.n_available, ==, 1);
+    g_assert_cmpuint (qmi_pds_nmea_stream_get_n_sentences (ctx.stream), ==, 3);
+    g_assert_cmpuint (qmi_pds_nmea_stream_get_n_dropped (ctx.stream), ==, 0);
+
+    g_assert_cmpuint (qmi_pds_nmea_stream_read (ctx.stream, sentences, G_N_ELEMENTS (sentences)), ==, 2);
+    g_assert_cmpstr (sentences[0].sentence, ==, "$GPGGA,1*00");
+    g_assert_cmpuint (sentences[0].length, ==, 11);
+    g_assert_cmpint (sentences[0].operation_mode, ==, QMI_PDS_OPERATION_MODE_UNKNOWN);
+    g_assert_cmpstr (sentences[1].sentence, ==, "$GPRMC,1*00");
+    g_assert_cmpuint (qmi_pds_nmea_stream_read (ctx.stream, sentences, G_N_ELEMENTS (sentences)), ==, 1);
+    g_assert_cmpstr (sentences[0].sentence, ==, "$GPGGA,3*00");
+    g_assert_cmpuint (qmi_pds_nmea_stream_read (ctx.stream, sentences, G_N_ELEMENTS (sentences)), ==, 0);
+
+    /* Wait for the reports to be disabled before going on */
+    qmi_device_get_stats (fixture->device, &stats);
+    ctx.n_responses = stats.n_responses;
+    g_object_unref (ctx.stream);
+    g_timeout_add (10, (GSourceFunc) nmea_stream_check_response, &ctx);
+    test_fixture_loop_run (fixture);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+
+    /* Enable and disable reports */
+    fixture->service_info[QMI_SERVICE_PDS].transaction_id += 2;
+}
+
+/*****************************************************************************/
+/* VOICE call tracker */
+
+typedef struct {
+    TestFixture *fixture;
+    GString     *events;
+} CallTrackerContext;
+
+static void
+call_tracker_emit_all_call_status (CallTrackerContext *ctx,
+                                   guint8              n_calls,
+                                   QmiVoiceCallState   state)
+{
+    QmiMessage *indication;
+    gsize       init_offset;
+
+    indication = qmi_message_new (QMI_SERVICE_VOICE,
+                                  qmi_client_get_cid (ctx->fixture->service_info[QMI_SERVICE_VOICE].client),
+                                  0,
+                                  0x002E);
+    ((GByteArray *) indication)->data[6] |= 0x04;
+
+    init_offset = qmi_message_tlv_write_init (indication, 0x01, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_guint8 (indication, n_calls, NULL));
+    if (n_calls) {
+        g_assert (qmi_message_tlv_write_guint8 (indication, 1, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (indication, state, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (indication, QMI_VOICE_CALL_TYPE_VOICE, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (indication, QMI_VOICE_CALL_DIRECTION_MT, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (indication, QMI_VOICE_CALL_MODE_LTE, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (indication, 0, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (indication, QMI_VOICE_ALS_LINE_1, NULL));
+    }
+    g_assert (qmi_message_tlv_write_complete (indication, init_offset, NULL));
+
+    init_offset = qmi_message_tlv_write_init (indication, 0x10, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_guint8 (indication, n_calls, NULL));
+    if (n_calls) {
+        g_assert (qmi_message_tlv_write_guint8 (indication, 1, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (indication, QMI_VOICE_PRESENTATION_ALLOWED, NULL));
+        g_assert (qmi_message_tlv_write_string (indication, 1, "+34600000000", -1, NULL));
+    }
+    g_assert (qmi_message_tlv_write_complete (indication, init_offset, NULL));
+
+    test_port_context_write (ctx->fixture->ctx, indication->data, indication->len);
+    qmi_message_unref (indication);
+}
+
+static gboolean
+call_tracker_emit_indications (CallTrackerContext *ctx)
+{
+    /* New call, answered, same state again, and gone */
+    call_tracker_emit_all_call_status (ctx, 1, QMI_VOICE_CALL_STATE_INCOMING);
+    call_tracker_emit_all_call_status (ctx, 1, QMI_VOICE_CALL_STATE_CONVERSATION);
+    call_tracker_emit_all_call_status (ctx, 1, QMI_VOICE_CALL_STATE_CONVERSATION);
+    call_tracker_emit_all_call_status (ctx, 0, QMI_VOICE_CALL_STATE_UNKNOWN);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+call_tracker_call_added (QmiVoiceCallTracker           *tracker,
+                         const QmiVoiceCallTrackerCall *call,
+                         CallTrackerContext            *ctx)
+{
+    g_assert_cmpuint (call->id, ==, 1);
+    g_assert_cmpuint (call->state, ==, QMI_VOICE_CALL_STATE_INCOMING);
+    g_assert_cmpuint (call->direction, ==, QMI_VOICE_CALL_DIRECTION_MT);
+    g_assert_cmpstr (call->number, ==, "+34600000000");
+    g_assert (qmi_voice_call_tracker_peek_call_by_id (tracker, 1) == call);
+    g_string_append (ctx->events, "added;");
+}
+
+static void
+call_tracker_call_updated (QmiVoiceCallTracker           *tracker,
+                           const QmiVoiceCallTrackerCall *call,
+                           guint                          previous_state,
+                           CallTrackerContext            *ctx)
+{
+    g_assert_cmpuint (previous_state, ==, QMI_VOICE_CALL_STATE_INCOMING);
+    g_assert_cmpuint (call->state, ==, QMI_VOICE_CALL_STATE_CONVERSATION);
+    g_string_append (ctx->events, "updated;");
+}
+
+static void
+call_tracker_call_ended (QmiVoiceCallTracker           *tracker,
+                         const QmiVoiceCallTrackerCall *call,
+                         CallTrackerContext            *ctx)
+{
+    g_assert_cmpuint (call->id, ==, 1);
+    g_assert_cmpuint (qmi_voice_call_tracker_get_n_calls (tracker), ==, 1);
+    g_string_append (ctx->events, "ended;");
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+test_generated_voice_call_tracker (TestFixture *fixture)
+{
+    CallTrackerContext   ctx = { fixture, NULL };
+    QmiVoiceCallTracker *tracker;
+
+    ctx.events = g_string_new (NULL);
+    tracker = qmi_voice_call_tracker_new (QMI_CLIENT_VOICE (fixture->service_info[QMI_SERVICE_VOICE].client));
+    g_assert_cmpuint (qmi_voice_call_tracker_get_n_calls (tracker), ==, 0);
+
+    g_signal_connect (tracker, QMI_VOICE_CALL_TRACKER_SIGNAL_CALL_ADDED,   G_CALLBACK (call_tracker_call_added),   &ctx);
+    g_signal_connect (tracker, QMI_VOICE_CALL_TRACKER_SIGNAL_CALL_UPDATED, G_CALLBACK (call_tracker_call_updated), &ctx);
+    g_signal_connect (tracker, QMI_VOICE_CALL_TRACKER_SIGNAL_CALL_ENDED,   G_CALLBACK (call_tracker_call_ended),   &ctx);
+
+    test_port_context_invoke (fixture->ctx, (GSourceFunc) call_tracker_emit_indications, &ctx);
+    test_fixture_loop_run (fixture);
+
+    g_assert_cmpstr (ctx.events->str, ==, "added;updated;ended;");
+    g_assert_cmpuint (qmi_voice_call_tracker_get_n_calls (tracker), ==, 0);
+    g_assert (!qmi_voice_call_tracker_peek_call_by_id (tracker, 1));
+
+    g_object_unref (tracker);
+    g_string_free (ctx.events, TRUE);
+}
+
+/*****************************************************************************/
+/* PBM phonebook reading */
+
+typedef struct {
+    TestFixture *fixture;
+    guint        n_batches;
+    GString     *records;
+} ReadPhonebookContext;
+
+/* Records 1, 2 and 5 exist, out of 6 */
+static const guint16 phonebook_record_ids[] = { 1, 2, 5 };
+
+static GByteArray *
+read_phonebook_responder (TestPortContext *ctx,
+                          GByteArray      *request,
+                          gpointer         user_data)
+{
+    QmiMessage *indication;
+    gsize       init_offset;
+    gsize       offset = 0;
+    guint8      session_type;
+    guint16     phonebook_type;
+    guint16     start;
+    guint16     end;
+    guint       n_records = 0;
+    guint       i;
+    QmiMessage *response;
+
+    g_assert_cmpuint (qmi_message_get_service ((QmiMessage *)request), ==, QMI_SERVICE_PBM);
+    g_assert_cmpuint (qmi_message_get_message_id ((QmiMessage *)request), ==, 0x0004);
+
+    init_offset = qmi_message_tlv_read_init ((QmiMessage *)request, 0x01, NULL, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_read_guint8 ((QmiMessage *)request, init_offset, &offset, &session_type, NULL));
+    g_assert (qmi_message_tlv_read_guint16 ((QmiMessage *)request, init_offset, &offset, QMI_ENDIAN_LITTLE, &phonebook_type, NULL));
+    g_assert (qmi_message_tlv_read_guint16 ((QmiMessage *)request, init_offset, &offset, QMI_ENDIAN_LITTLE, &start, NULL));
+    g_assert (qmi_message_tlv_read_guint16 ((QmiMessage *)request, init_offset, &offset, QMI_ENDIAN_LITTLE, &end, NULL));
+    g_assert_cmpuint (session_type, ==, QMI_PBM_SESSION_TYPE_GW_PRIMARY);
+    g_assert_cmpuint (phonebook_type, ==, QMI_PBM_PHONEBOOK_TYPE_ADN);
+    g_assert_cmpuint (end - start + 1, ==, 2);
+
+    for (i = 0; i < G_N_ELEMENTS (phonebook_record_ids); i++) {
+        if (phonebook_record_ids[i] >= start && phonebook_record_ids[i] <= end)
+            n_records++;
+    }
+    if (!n_records)
+        return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NO_ENTRY);
+
+    /* The indication may be processed before the response */
+    indication = qmi_message_new (QMI_SERVICE_PBM, qmi_message_get_client_id ((QmiMessage *)request), 0, 0x0004);
+    ((GByteArray *) indication)->data[6] |= 0x04;
+    init_offset = qmi_message_tlv_write_init (indication, 0x01, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_guint16 (indication, QMI_ENDIAN_LITTLE, 1, NULL));
+    g_assert (qmi_message_tlv_write_guint8 (indication, session_type, NULL));
+    g_assert (qmi_message_tlv_write_guint16 (indication, QMI_ENDIAN_LITTLE, phonebook_type, NULL));
+    g_assert (qmi_message_tlv_write_guint8 (indication, n_records, NULL));
+    for (i = 0; i < G_N_ELEMENTS (phonebook_record_ids); i++) {
+        gchar *number;
+
+        if (phonebook_record_ids[i] < start || phonebook_record_ids[i] > end)
+            continue;
+
+        number = g_strdup_printf ("+3460000000%u", phonebook_record_ids[i]);
+        g_assert (qmi_message_tlv_write_guint16 (indication, QMI_ENDIAN_LITTLE, phonebook_record_ids[i], NULL));
+        g_assert (qmi_message_tlv_write_guint8 (indication, 1, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (indication, 1, NULL));
+        g_assert (qmi_message_tlv_write_string (indication, 1, number, -1, NULL));
+        /* UCS-2 name, a single letter */
+        g_assert (qmi_message_tlv_write_guint8 (indication, 2, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (indication, 0x00, NULL));
+        g_assert (qmi_message_tlv_write_guint8 (indication, 'A' + phonebook_record_ids[i], NULL));
+        g_free (number);
+    }
+    g_assert (qmi_message_tlv_write_complete (indication, init_offset, NULL));
+    test_port_context_write (ctx, indication->data, indication->len);
+    qmi_message_unref (indication);
+
+    response = qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+    init_offset = qmi_message_tlv_write_init (response, 0x10, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, n_records, NULL));
+    g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+    return response;
+}
+
+static void
+read_phonebook_records (QmiClientPbm         *client,
+                        const QmiPbmRecord   *records,
+                        guint                 n_records,
+                        ReadPhonebookContext *ctx)
+{
+    guint i;
+
+    g_assert_cmpuint (n_records, >, 0);
+    g_assert_cmpuint (n_records, <=, 2);
+    for (i = 0; i < n_records; i++) {
+        g_assert_cmpuint (records[i].number_type, ==, 1);
+        g_assert_cmpuint (records[i].name_length, ==, 2);
+        g_assert_cmpuint (records[i].name[1], ==, 'A' + records[i].record_id);
+        g_string_append_printf (ctx->records, "%u:%s;", records[i].record_id, records[i].number);
+    }
+    ctx->n_batches++;
+}
+
+static void
+read_phonebook_ready (QmiClientPbm         *client,
+                      GAsyncResult         *res,
+                      ReadPhonebookContext *ctx)
+{
+    GError *error = NULL;
+    guint   n_records = 0;
+
+    g_assert (qmi_client_pbm_read_phonebook_finish (client, res, &n_records, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (n_records, ==, G_N_ELEMENTS (phonebook_record_ids));
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+test_generated_pbm_read_phonebook (TestFixture *fixture)
+{
+    ReadPhonebookContext ctx = { fixture, 0, NULL };
+
+    ctx.records = g_string_new (NULL);
+
+    test_port_context_set_responder (fixture->ctx, read_phonebook_responder, &ctx);
+    qmi_client_pbm_read_phonebook (QMI_CLIENT_PBM (fixture->service_info[QMI_SERVICE_PBM].client),
+                                   QMI_PBM_SESSION_TYPE_GW_PRIMARY,
+                                   QMI_PBM_PHONEBOOK_TYPE_ADN,
+                                   1, 6, 2,
+                                   (QmiPbmReadPhonebookCallback) read_phonebook_records,
+                                   &ctx,
+                                   NULL,
+                                   (GAsyncReadyCallback) read_phonebook_ready,
+                                   &ctx);
+    test_fixture_loop_run (fixture);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+
+    /* The empty page doesn't give a batch */
+    g_assert_cmpuint (ctx.n_batches, ==, 2);
+    g_assert_cmpstr (ctx.records->str, ==, "1:+34600000001;2:+34600000002;5:+34600000005;");
+    g_string_free (ctx.records, TRUE);
+
+    /* One request per page */
+    fixture->service_info[QMI_SERVICE_PBM].transaction_id += 3;
+}
+
+/*****************************************************************************/
+/* LOC session mux */
+
+typedef struct {
+    TestFixture      *fixture;
+    QmiLocSessionMux *mux;
+    guint             n_register_events;
+    guint             n_starts;
+    guint             n_stops;
+    guint32           start_interval;
+    guint             expected_interval;
+    guint64           n_expected_indications;
+    guint64           n_responses;
+    guint             n_fast;
+    guint             n_slow;
+    gdouble           latitude;
+} SessionMuxContext;
+
+static GByteArray *
+session_mux_responder (TestPortContext *ctx,
+                       GByteArray      *request,
+                       gpointer         user_data)
+{
+    SessionMuxContext *mux_ctx = user_data;
+    const guint8      *raw;
+    guint16            raw_length;
+
+    g_assert_cmpuint (qmi_message_get_service ((QmiMessage *)request), ==, QMI_SERVICE_LOC);
+
+    switch (qmi_message_get_message_id ((QmiMessage *)request)) {
+    case 0x0021:
+        mux_ctx->n_register_events++;
+        break;
+    case 0x0022:
+        raw = qmi_message_get_raw_tlv ((QmiMessage *)request, 0x13, &raw_length);
+        g_assert (raw);
+        g_assert_cmpuint (raw_length, ==, 4);
+        mux_ctx->start_interval = raw[0] | (raw[1] << 8) | (raw[2] << 16) | (raw[3] << 24);
+        mux_ctx->n_starts++;
+        break;
+    case 0x0023:
+        mux_ctx->n_stops++;
+        break;
+    default:
+        g_assert_not_reached ();
+    }
+
+    return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+}
+
+static gboolean
+session_mux_emit_position_reports (SessionMuxContext *ctx)
+{
+    guint i;
+
+    for (i = 0; i < 3; i++) {
+        QmiMessage *indication;
+        gsize       init_offset;
+        gdouble     latitude;
+        guint64     latitude_raw;
+
+        /* LOC Position Report, with status, session id and latitude */
+        indication = qmi_message_new (QMI_SERVICE_LOC,
+                                      qmi_client_get_cid (ctx->fixture->service_info[QMI_SERVICE_LOC].client),
+                                      0,
+                                      0x0024);
+        ((GByteArray *) indication)->data[6] |= 0x04;
+
+        init_offset = qmi_message_tlv_write_init (indication, 0x01, NULL);
+        g_assert (qmi_message_tlv_write_guint32 (indication, QMI_ENDIAN_LITTLE, QMI_LOC_SESSION_STATUS_SUCCESS, NULL));
+        g_assert (qmi_message_tlv_write_complete (indication, init_offset, NULL));
+
+        init_offset = qmi_message_tlv_write_init (indication, 0x02, NULL);
+        g_assert (qmi_message_tlv_write_guint8 (indication, 0x4d, NULL));
+        g_assert (qmi_message_tlv_write_complete (indication, init_offset, NULL));
+
+        latitude = 42.0 + i;
+        memcpy (&latitude_raw, &latitude, sizeof (latitude_raw));
+        init_offset = qmi_message_tlv_write_init (indication, 0x10, NULL);
+        g_assert (qmi_message_tlv_write_guint64 (indication, QMI_ENDIAN_LITTLE, latitude_raw, NULL));
+        g_assert (qmi_message_tlv_write_complete (indication, init_offset, NULL));
+
+        test_port_context_write (ctx->fixture->ctx, indication->data, indication->len);
+        qmi_message_unref (indication);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static void
+session_mux_position_fast (QmiLocSessionMux     *mux,
+                           const QmiLocPosition *position,
+                           SessionMuxContext    *ctx)
+{
+    g_assert_cmpint (position->session_status, ==, QMI_LOC_SESSION_STATUS_SUCCESS);
+    g_assert_cmpuint (position->fields, ==, QMI_LOC_POSITION_FIELD_LATITUDE);
+    ctx->latitude = position->latitude;
+    ctx->n_fast++;
+}
+
+static void
+session_mux_position_slow (QmiLocSessionMux     *mux,
+                           const QmiLocPosition *position,
+                           SessionMuxContext    *ctx)
+{
+    ctx->n_slow++;
+}
+
+static gboolean
+session_mux_check_interval (SessionMuxContext *ctx)
+{
+    if (qmi_loc_session_mux_get_interval (ctx->mux) != ctx->expected_interval)
+        return G_SOURCE_CONTINUE;
+
+    test_fixture_loop_stop (ctx->fixture);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+session_mux_check_indications (SessionMuxContext *ctx)
+{
+    QmiDeviceStats stats;
+
+    qmi_device_get_stats (ctx->fixture->device, &stats);
+    if (stats.n_indications < ctx->n_expected_indications || stats.pending_indications_length > 0)
+        return G_SOURCE_CONTINUE;
+
+    test_fixture_loop_stop (ctx->fixture);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+session_mux_check_response (SessionMuxContext *ctx)
+{
+    QmiDeviceStats stats;
+
+    qmi_device_get_stats (ctx->fixture->device, &stats);
+    if (stats.n_responses <= ctx->n_responses)
+        return G_SOURCE_CONTINUE;
+
+    test_fixture_loop_stop (ctx->fixture);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+test_generated_loc_session_mux (TestFixture *fixture)
+{
+    SessionMuxContext  ctx = { fixture, NULL };
+    QmiLocSessionMux  *other;
+    QmiDeviceStats     stats;
+    guint              slow_id;
+    guint              fast_id;
+
+    test_port_context_set_responder (fixture->ctx, session_mux_responder, &ctx);
+
+    /* Shared by all the users of the client */
+    ctx.mux = qmi_loc_session_mux_get (QMI_CLIENT_LOC (fixture->service_info[QMI_SERVICE_LOC].client));
+    other = qmi_loc_session_mux_get (QMI_CLIENT_LOC (fixture->service_info[QMI_SERVICE_LOC].client));
+    g_assert (ctx.mux == other);
+    g_object_unref (other);
+    g_assert_cmpuint (qmi_loc_session_mux_get_interval (ctx.mux), ==, 0);
+
+    /* First subscriber starts the session */
+    slow_id = qmi_loc_session_mux_subscribe (ctx.mux, 5000, (QmiLocSessionMuxPositionCallback) session_mux_position_slow, &ctx, NULL);
+    ctx.expected_interval = 5000;
+    g_timeout_add (10, (GSourceFunc) session_mux_check_interval, &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_register_events, ==, 1);
+    g_assert_cmpuint (ctx.n_starts, ==, 1);
+    g_assert_cmpuint (ctx.start_interval, ==, 5000);
+
+    /* A faster subscriber reconfigures it */
+    fast_id = qmi_loc_session_mux_subscribe (ctx.mux, 1000, (QmiLocSessionMuxPositionCallback) session_mux_position_fast, &ctx, NULL);
+    ctx.expected_interval = 1000;
+    g_timeout_add (10, (GSourceFunc) session_mux_check_interval, &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_register_events, ==, 1);
+    g_assert_cmpuint (ctx.n_starts, ==, 2);
+    g_assert_cmpuint (ctx.start_interval, ==, 1000);
+
+    /* Reports received back to back are decimated for both subscribers */
+    qmi_device_get_stats (fixture->device, &stats);
+    ctx.n_expected_indications = stats.n_indications + 3;
+    test_port_context_invoke (fixture->ctx, (GSourceFunc) session_mux_emit_position_reports, &ctx);
+    g_timeout_add (10, (GSourceFunc) session_mux_check_indications, &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_fast, ==, 1);
+    g_assert_cmpuint (ctx.n_slow, ==, 1);
+    g_assert_cmpfloat (ctx.latitude, ==, 42.0);
+
+    /* Back to the slower interval */
+    qmi_loc_session_mux_unsubscribe (ctx.mux, fast_id);
+    ctx.expected_interval = 5000;
+    g_timeout_add (10, (GSourceFunc) session_mux_check_interval, &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_starts, ==, 3);
+    g_assert_cmpuint (ctx.start_interval, ==, 5000);
+
+    /* Last subscriber stops the session */
+    qmi_device_get_stats (fixture->device, &stats);
+    ctx.n_responses = stats.n_responses;
+    qmi_loc_session_mux_unsubscribe (ctx.mux, slow_id);
+    g_assert_cmpuint (qmi_loc_session_mux_get_interval (ctx.mux), ==, 0);
+    g_timeout_add (10, (GSourceFunc) session_mux_check_response, &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_stops, ==, 1);
+
+    g_object_unref (ctx.mux);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+
+    /* Register Events, three Starts and Stop */
+    fixture->service_info[QMI_SERVICE_LOC].transaction_id += 5;
+}
+
+/*****************************************************************************/
+/* LOC indications, bounded queue */
+
+typedef struct {
+    TestFixture *fixture;
+    guint64      n_expected_indications;
+    guint        n_reports;
+    guint8       session_id;
+} IndicationQueueContext;
+
+static gboolean
+indication_queue_emit_position_reports (IndicationQueueContext *ctx)
+{
+    GByteArray *buffer;
+    guint       i;
+
+    /* All written at once, so that they're queued before being reported */
+    buffer = g_byte_array_new ();
+    for (i = 0; i < 3; i++) {
+        QmiMessage *indication;
+        gsize       init_offset;
+
+        /* LOC Position Report, with status and session id */
+        indication = qmi_message_new (QMI_SERVICE_LOC,
+                                      qmi_client_get_cid (ctx->fixture->service_info[QMI_SERVICE_LOC].client),
+                                      0,
+                                      0x0024);
+        ((GByteArray *) indication)->data[6] |= 0x04;
+
+        init_offset = qmi_message_tlv_write_init (indication, 0x01, NULL);
+        g_assert (qmi_message_tlv_write_guint32 (indication, QMI_ENDIAN_LITTLE, QMI_LOC_SESSION_STATUS_SUCCESS, NULL));
+        g_assert (qmi_message_tlv_write_complete (indication, init_offset, NULL));
+
+        init_offset = qmi_message_tlv_write_init (indication, 0x02, NULL);
+        g_assert (qmi_message_tlv_write_guint8 (indication, 0x40 + i, NULL));
+        g_assert (qmi_message_tlv_write_complete (indication, init_offset, NULL));
+
+        g_byte_array_append (buffer, indication->data, indication->len);
+        qmi_message_unref (indication);
+    }
+
+    test_port_context_write (ctx->fixture->ctx, buffer->data, buffer->len);
+    g_byte_array_unref (buffer);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+indication_queue_position_report_cb (QmiClientLoc                        *client,
+                                     QmiIndicationLocPositionReportOutput *output,
+                                     IndicationQueueContext               *ctx)
+{
+    g_assert (qmi_indication_loc_position_report_output_get_session_id (output, &ctx->session_id, NULL));
+    ctx->n_reports++;
+}
+
+static gboolean
+indication_queue_check_indications (IndicationQueueContext *ctx)
+{
+    QmiDeviceStats stats;
+
+    qmi_device_get_stats (ctx->fixture->device, &stats);
+    if (stats.n_indications < ctx->n_expected_indications || stats.pending_indications_length > 0)
+        return G_SOURCE_CONTINUE;
+
+    test_fixture_loop_stop (ctx->fixture);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+test_generated_loc_indication_queue_limit (TestFixture *fixture)
+{
+    IndicationQueueContext  ctx = { fixture, 0 };
+    QmiClient              *client;
+    QmiDeviceStats          stats;
+    guint64                 n_indications_dropped;
+    gulong                  handler_id;
+
+    client = fixture->service_info[QMI_SERVICE_LOC].client;
+    handler_id = g_signal_connect (client, "position-report",
+                                   G_CALLBACK (indication_queue_position_report_cb),
+                                   &ctx);
+
+    /* Only the newest one is reported when coalescing */
+    qmi_client_set_indication_queue_limit (client, 1, QMI_CLIENT_INDICATION_OVERFLOW_COALESCE);
+    qmi_device_get_stats (fixture->device, &stats);
+    ctx.n_expected_indications = stats.n_indications + 3;
+    n_indications_dropped = stats.n_indications_dropped;
+    test_port_context_invoke (fixture->ctx, (GSourceFunc) indication_queue_emit_position_reports, &ctx);
+    g_timeout_add (10, (GSourceFunc) indication_queue_check_indications, &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_reports, ==, 1);
+    g_assert_cmpuint (ctx.session_id, ==, 0x42);
+    g_assert_cmpuint (qmi_client_get_indication_drops (client), ==, 2);
+
+    /* Only the oldest one when dropping the newest */
+    ctx.n_reports = 0;
+    qmi_client_set_indication_queue_limit (client, 1, QMI_CLIENT_INDICATION_OVERFLOW_DROP_NEWEST);
+    ctx.n_expected_indications += 3;
+    test_port_context_invoke (fixture->ctx, (GSourceFunc) indication_queue_emit_position_reports, &ctx);
+    g_timeout_add (10, (GSourceFunc) indication_queue_check_indications, &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_reports, ==, 1);
+    g_assert_cmpuint (ctx.session_id, ==, 0x40);
+    g_assert_cmpuint (qmi_client_get_indication_drops (client), ==, 4);
+
+    qmi_device_get_stats (fixture->device, &stats);
+    g_assert_cmpuint (stats.n_indications_dropped, ==, n_indications_dropped + 4);
+
+    qmi_client_set_indication_queue_limit (client, 0, QMI_CLIENT_INDICATION_OVERFLOW_DROP_OLDEST);
+    g_signal_handler_disconnect (client, handler_id);
+}
+
+/*****************************************************************************/
+/* WDS profile inventory */
+
+typedef struct {
+    TestFixture *fixture;
+    guint        n_requests;
+} ProfileInventoryContext;
+
+static const guint8 inventory_profile_indexes[] = { 1, 2, 5 };
+
+static GByteArray *
+profile_inventory_responder (TestPortContext *ctx,
+                             GByteArray      *request,
+                             gpointer         user_data)
+{
+    ProfileInventoryContext *inventory_ctx = user_data;
+    QmiMessage              *response;
+    gsize                    init_offset;
+    gsize                    offset = 0;
+    guint8                   profile_type;
+    guint8                   profile_index;
+    gchar                   *str;
+    guint                    i;
+
+    g_assert_cmpuint (qmi_message_get_service ((QmiMessage *)request), ==, QMI_SERVICE_WDS);
+    inventory_ctx->n_requests++;
+
+    response = qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+
+    switch (qmi_message_get_message_id ((QmiMessage *)request)) {
+    case 0x002A: /* Get Profile List */
+        init_offset = qmi_message_tlv_write_init (response, 0x01, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint8 (response, G_N_ELEMENTS (inventory_profile_indexes), NULL));
+        for (i = 0; i < G_N_ELEMENTS (inventory_profile_indexes); i++) {
+            str = g_strdup_printf ("profile%u", inventory_profile_indexes[i]);
+            g_assert (qmi_message_tlv_write_guint8 (response, QMI_WDS_PROFILE_TYPE_3GPP, NULL));
+            g_assert (qmi_message_tlv_write_guint8 (response, inventory_profile_indexes[i], NULL));
+            g_assert (qmi_message_tlv_write_string (response, 1, str, -1, NULL));
+            g_free (str);
+        }
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        break;
+    case 0x002B: /* Get Profile Settings */
+        init_offset = qmi_message_tlv_read_init ((QmiMessage *)request, 0x01, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint8 ((QmiMessage *)request, init_offset, &offset, &profile_type, NULL));
+        g_assert (qmi_message_tlv_read_guint8 ((QmiMessage *)request, init_offset, &offset, &profile_index, NULL));
+        g_assert_cmpuint (profile_type, ==, QMI_WDS_PROFILE_TYPE_3GPP);
+
+        /* APN Name */
+        str = g_strdup_printf ("apn%u", profile_index);
+        init_offset = qmi_message_tlv_write_init (response, 0x14, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_string (response, 0, str, -1, NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        g_free (str);
+
+        /* Authentication, only in the last profile */
+        if (profile_index == 5) {
+            init_offset = qmi_message_tlv_write_init (response, 0x1D, NULL);
+            g_assert (init_offset);
+            g_assert (qmi_message_tlv_write_guint8 (response, QMI_WDS_AUTHENTICATION_CHAP, NULL));
+            g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        }
+        break;
+    case 0x0029: /* Delete Profile */
+        break;
+    default:
+        g_assert_not_reached ();
+    }
+
+    return response;
+}
+
+static void
+get_all_profiles_ready (QmiClientWds            *client,
+                        GAsyncResult            *res,
+                        ProfileInventoryContext *ctx)
+{
+    GError *error = NULL;
+    GArray *profiles;
+    guint   i;
+
+    profiles = qmi_client_wds_get_all_profiles_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (profiles);
+    g_assert_cmpuint (profiles->len, ==, G_N_ELEMENTS (inventory_profile_indexes));
+    for (i = 0; i < profiles->len; i++) {
+        QmiWdsProfileSettings *settings;
+        gchar                 *str;
+
+        settings = &g_array_index (profiles, QmiWdsProfileSettings, i);
+        g_assert_cmpuint (settings->profile_type, ==, QMI_WDS_PROFILE_TYPE_3GPP);
+        g_assert_cmpuint (settings->profile_index, ==, inventory_profile_indexes[i]);
+        str = g_strdup_printf ("profile%u", inventory_profile_indexes[i]);
+        g_assert_cmpstr (settings->profile_name, ==, str);
+        g_free (str);
+        str = g_strdup_printf ("apn%u", inventory_profile_indexes[i]);
+        g_assert_cmpstr (settings->apn_name, ==, str);
+        g_free (str);
+        g_assert (!settings->username);
+        g_assert_cmpuint (settings->authentication, ==,
+                          (settings->profile_index == 5 ? QMI_WDS_AUTHENTICATION_CHAP : QMI_WDS_AUTHENTICATION_NONE));
+    }
+    g_array_unref (profiles);
+
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+inventory_delete_profile_ready (QmiClientWds            *client,
+                                GAsyncResult            *res,
+                                ProfileInventoryContext *ctx)
 {
-    QmiMessageNasNetworkScanOutput *output;
-    GError *error = NULL;
-    gboolean st;
-    GArray *network_information = NULL;
-    GArray *radio_access_technology = NULL;
-    GArray *mnc_pcs_digit_include_status = NULL;
-    guint i;
+    QmiMessageWdsDeleteProfileOutput *output;
+    GError                           *error = NULL;
 
-    output = qmi_client_nas_network_scan_finish (client, res, &error);
+    output = qmi_client_wds_delete_profile_finish (client, res, &error);
     g_assert_no_error (error);
     g_assert (output);
+    qmi_message_wds_delete_profile_output_unref (output);
 
-    st = qmi_message_nas_network_scan_output_get_result (output, &error);
-    g_assert_no_error (error);
-    g_assert (st);
+    test_fixture_loop_stop (ctx->fixture);
+}
 
-    st = (qmi_message_nas_network_scan_output_get_network_information (
-              output,
-              &network_information,
-              &error));
-    g_assert_no_error (error);
-    g_assert (st);
-    g_assert (network_information);
-    g_assert_cmpuint (network_information->len, ==, 8);
-    for (i = 0; i < network_information->len; i++) {
-        QmiMessageNasNetworkScanOutputNetworkInformationElement *el;
+static void
+test_generated_wds_get_all_profiles (TestFixture *fixture)
+{
+    ProfileInventoryContext          ctx = { fixture, 0 };
+    QmiClientWds                    *client;
+    QmiMessageWdsDeleteProfileInput *input;
 
-        el = &g_array_index (network_information, QmiMessageNasNetworkScanOutputNetworkInformationElement, i);
+    client = QMI_CLIENT_WDS (fixture->service_info[QMI_SERVICE_WDS].client);
+    g_object_set (fixture->device, QMI_DEVICE_RESPONSE_CACHE, TRUE, NULL);
+    test_port_context_set_responder (fixture->ctx, profile_inventory_responder, &ctx);
 
-        g_assert_cmpuint (el->mcc, ==, scan_results[i].mcc);
-        g_assert_cmpuint (el->mnc, ==, scan_results[i].mnc);
-        g_assert_cmpuint (el->network_status, ==, scan_results[i].network_status);
-        g_assert_cmpstr  (el->description, ==, scan_results[i].description);
+    /* List and one request per profile */
+    qmi_client_wds_get_all_profiles (client, QMI_WDS_PROFILE_TYPE_3GPP, 2, NULL,
+                                     (GAsyncReadyCallback) get_all_profiles_ready,
+                                     &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_requests, ==, 4);
+
+    /* All answered from the cache */
+    qmi_client_wds_get_all_profiles (client, QMI_WDS_PROFILE_TYPE_3GPP, 2, NULL,
+                                     (GAsyncReadyCallback) get_all_profiles_ready,
+                                     &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_requests, ==, 4);
+
+    /* Deleting a profile makes the cached profiles useless */
+    input = qmi_message_wds_delete_profile_input_new ();
+    qmi_message_wds_delete_profile_input_set_profile_identifier (input, QMI_WDS_PROFILE_TYPE_3GPP, 9, NULL);
+    qmi_client_wds_delete_profile (client, input, 3, NULL,
+                                   (GAsyncReadyCallback) inventory_delete_profile_ready,
+                                   &ctx);
+    qmi_message_wds_delete_profile_input_unref (input);
+    test_fixture_loop_run (fixture);
+
+    qmi_client_wds_get_all_profiles (client, QMI_WDS_PROFILE_TYPE_3GPP, 2, NULL,
+                                     (GAsyncReadyCallback) get_all_profiles_ready,
+                                     &ctx);
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_requests, ==, 9);
+
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+
+    /* Cached requests also get a transaction ID */
+    fixture->service_info[QMI_SERVICE_WDS].transaction_id += 13;
+}
+
+/*****************************************************************************/
+/* WDS mux sessions */
+
+/* Release CID */
+static GByteArray *
+release_cid_response (GByteArray *request)
+{
+    QmiMessage *response;
+    gsize       init_offset;
+    gsize       offset = 0;
+    guint8      service;
+    guint8      cid;
+
+    g_assert_cmpuint (qmi_message_get_service ((QmiMessage *)request), ==, QMI_SERVICE_CTL);
+    g_assert_cmpuint (qmi_message_get_message_id ((QmiMessage *)request), ==, 0x0023);
+
+    init_offset = qmi_message_tlv_read_init ((QmiMessage *)request, 0x01, NULL, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_read_guint8 ((QmiMessage *)request, init_offset, &offset, &service, NULL));
+    g_assert (qmi_message_tlv_read_guint8 ((QmiMessage *)request, init_offset, &offset, &cid, NULL));
+
+    response = qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+    init_offset = qmi_message_tlv_write_init (response, 0x01, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_guint8 (response, service, NULL));
+    g_assert (qmi_message_tlv_write_guint8 (response, cid, NULL));
+    g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+    return response;
+}
+
+typedef struct {
+    TestFixture *fixture;
+    guint8       next_cid;
+    guint8       mux_ids[256];   /* per WDS client ID */
+    guint        n_released;
+} MuxSessionsContext;
+
+static GByteArray *
+mux_sessions_responder (TestPortContext *ctx,
+                        GByteArray      *request,
+                        gpointer         user_data)
+{
+    MuxSessionsContext *mux_ctx = user_data;
+    QmiMessage         *response;
+    gsize               init_offset;
+    gsize               offset = 0;
+    guint32             value;
+    guint8              mux_id;
+    guint8              ip_family;
+
+    switch (qmi_message_get_service ((QmiMessage *)request)) {
+    case QMI_SERVICE_CTL:
+        if (qmi_message_get_message_id ((QmiMessage *)request) == 0x0023) {
+            mux_ctx->n_released++;
+            return release_cid_response (request);
+        }
+        /* Allocate CID */
+        return allocate_clients_responder (ctx, request, &mux_ctx->next_cid);
+    case QMI_SERVICE_WDA:
+        g_assert_cmpuint (qmi_message_get_message_id ((QmiMessage *)request), ==, 0x0020);
+        init_offset = qmi_message_tlv_read_init ((QmiMessage *)request, 0x13, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint32 ((QmiMessage *)request, init_offset, &offset, QMI_ENDIAN_LITTLE, &value, NULL));
+        g_assert_cmpuint (value, ==, QMI_WDA_DATA_AGGREGATION_PROTOCOL_QMAP);
+
+        /* Accept QMAP, but with smaller aggregation limits */
+        response = qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+        init_offset = qmi_message_tlv_write_init (response, 0x11, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, QMI_WDA_LINK_LAYER_PROTOCOL_RAW_IP, NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        init_offset = qmi_message_tlv_write_init (response, 0x13, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, QMI_WDA_DATA_AGGREGATION_PROTOCOL_QMAP, NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        init_offset = qmi_message_tlv_write_init (response, 0x15, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, 16, NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        init_offset = qmi_message_tlv_write_init (response, 0x16, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, 8192, NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        return response;
+    case QMI_SERVICE_WDS:
+        break;
+    default:
+        g_assert_not_reached ();
     }
 
-    st = (qmi_message_nas_network_scan_output_get_radio_access_technology (
-              output,
-              &radio_access_technology,
-              &error));
-    g_assert_no_error (error);
-    g_assert (st);
-    g_assert (radio_access_technology);
-    g_assert_cmpuint (radio_access_technology->len, ==, 8);
-    for (i = 0; i < radio_access_technology->len; i++) {
-        QmiMessageNasNetworkScanOutputRadioAccessTechnologyElement *el;
+    switch (qmi_message_get_message_id ((QmiMessage *)request)) {
+    case 0x00A2: /* Bind Mux Data Port */
+        init_offset = qmi_message_tlv_read_init ((QmiMessage *)request, 0x11, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint8 ((QmiMessage *)request, init_offset, &offset, &mux_id, NULL));
 
-        el = &g_array_index (radio_access_technology, QmiMessageNasNetworkScanOutputRadioAccessTechnologyElement, i);
+        /* Refuse mux ID 3, to test partial failures */
+        if (mux_id == 3)
+            return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_INVALID_ARGUMENT);
+        mux_ctx->mux_ids[qmi_message_get_client_id ((QmiMessage *)request)] = mux_id;
+        return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+    case 0x004D: /* Set IP Family */
+        init_offset = qmi_message_tlv_read_init ((QmiMessage *)request, 0x01, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint8 ((QmiMessage *)request, init_offset, &offset, &ip_family, NULL));
+        g_assert_cmpuint (ip_family, ==, QMI_WDS_IP_FAMILY_IPV6);
+        return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+    case 0x0020: /* Start Network */
+        /* Always bound before */
+        mux_id = mux_ctx->mux_ids[qmi_message_get_client_id ((QmiMessage *)request)];
+        g_assert_cmpuint (mux_id, !=, 0);
 
-        g_assert_cmpuint (el->mcc, ==, scan_results[i].mcc);
-        g_assert_cmpuint (el->mnc, ==, scan_results[i].mnc);
-        g_assert_cmpuint (el->radio_interface, ==, scan_results[i].rat);
+        response = qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+        init_offset = qmi_message_tlv_write_init (response, 0x01, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, 0x1000 | mux_id, NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        return response;
+    default:
+        g_assert_not_reached ();
     }
+}
 
-    st = (qmi_message_nas_network_scan_output_get_mnc_pcs_digit_include_status (
-              output,
-              &mnc_pcs_digit_include_status,
-              &error));
+static void
+mux_sessions_ready (QmiDevice          *device,
+                    GAsyncResult       *res,
+                    MuxSessionsContext *ctx)
+{
+    GError           *error = NULL;
+    GArray           *sessions;
+    QmiWdsMuxSession *session;
+    guint32           dl_max_datagrams = 0;
+    guint32           dl_max_size = 0;
+    guint             i;
+
+    sessions = qmi_device_start_mux_sessions_finish (device, res, &dl_max_datagrams, &dl_max_size, &error);
     g_assert_no_error (error);
-    g_assert (st);
-    g_assert (mnc_pcs_digit_include_status);
-    g_assert_cmpuint (mnc_pcs_digit_include_status->len, ==, 8);
-    for (i = 0; i < mnc_pcs_digit_include_status->len; i++) {
-        QmiMessageNasNetworkScanOutputMncPcsDigitIncludeStatusElement *el;
+    g_assert (sessions);
+    g_assert_cmpuint (dl_max_datagrams, ==, 16);
+    g_assert_cmpuint (dl_max_size, ==, 8192);
+    g_assert_cmpuint (sessions->len, ==, 3);
 
-        el = &g_array_index (mnc_pcs_digit_include_status, QmiMessageNasNetworkScanOutputMncPcsDigitIncludeStatusElement, i);
+    for (i = 0; i < 2; i++) {
+        session = &g_array_index (sessions, QmiWdsMuxSession, i);
+        g_assert_no_error (session->error);
+        g_assert (QMI_IS_CLIENT_WDS (session->client));
+        g_assert_cmpuint (session->mux_id, ==, i + 1);
+        g_assert_cmpuint (session->packet_data_handle, ==, 0x1000 | (i + 1));
+        qmi_device_release_client (device,
+                                   QMI_CLIENT (session->client),
+                                   QMI_DEVICE_RELEASE_CLIENT_FLAGS_NONE,
+                                   1, NULL, NULL, NULL);
+    }
 
-        g_assert_cmpuint (el->mcc, ==, scan_results[i].mcc);
-        g_assert_cmpuint (el->mnc, ==, scan_results[i].mnc);
-        g_assert_cmpuint (el->includes_pcs_digit, ==, scan_results[i].includes_pcs_digit);
+    /* The session that couldn't be bound is released */
+    session = &g_array_index (sessions, QmiWdsMuxSession, 2);
+    g_assert_error (session->error, QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_INVALID_ARGUMENT);
+    g_assert (!session->client);
+    g_assert_cmpuint (session->mux_id, ==, 3);
+
+    g_array_unref (sessions);
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+test_generated_wds_mux_sessions (TestFixture *fixture)
+{
+    static const QmiWdsMuxSessionSettings settings[] = {
+        { 1, "internet", QMI_WDS_IP_FAMILY_UNSPECIFIED },
+        { 2, "ims",      QMI_WDS_IP_FAMILY_IPV6        },
+        { 3, "other",    QMI_WDS_IP_FAMILY_UNSPECIFIED },
+    };
+    MuxSessionsContext ctx = { fixture, 0x10 };
+
+    test_port_context_set_responder (fixture->ctx, mux_sessions_responder, &ctx);
+    qmi_device_start_mux_sessions (fixture->device,
+                                   QMI_DATA_ENDPOINT_TYPE_HSUSB,
+                                   4,
+                                   32,
+                                   16384,
+                                   settings,
+                                   G_N_ELEMENTS (settings),
+                                   NULL,
+                                   (GAsyncReadyCallback) mux_sessions_ready,
+                                   &ctx);
+    test_fixture_loop_run (fixture);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+
+    /* Both the WDA client and the client of the failed session */
+    g_assert_cmpuint (ctx.n_released, ==, 2);
+
+    /* Four Allocate CID and two Release CID requests */
+    fixture->service_info[QMI_SERVICE_CTL].transaction_id += 6;
+}
+
+/*****************************************************************************/
+/* WDS start networks */
+
+typedef struct {
+    TestFixture    *fixture;
+    guint8          next_cid;
+    QmiWdsIpFamily  failed_ip_family;
+    guint8          ip_families[256];   /* per WDS client ID */
+    guint           n_stopped;
+    guint           n_released;
+} StartNetworksContext;
+
+static GByteArray *
+start_networks_responder (TestPortContext *ctx,
+                          GByteArray      *request,
+                          gpointer         user_data)
+{
+    StartNetworksContext *start_ctx = user_data;
+    QmiMessage           *response;
+    gsize                 init_offset;
+    gsize                 offset = 0;
+    guint8                cid;
+    guint8                ip_family;
+    guint32               packet_data_handle;
+
+    if (qmi_message_get_service ((QmiMessage *)request) == QMI_SERVICE_CTL) {
+        if (qmi_message_get_message_id ((QmiMessage *)request) == 0x0023) {
+            start_ctx->n_released++;
+            return release_cid_response (request);
+        }
+        return allocate_clients_responder (ctx, request, &start_ctx->next_cid);
     }
 
-    qmi_message_nas_network_scan_output_unref (output);
+    g_assert_cmpuint (qmi_message_get_service ((QmiMessage *)request), ==, QMI_SERVICE_WDS);
+    cid = qmi_message_get_client_id ((QmiMessage *)request);
 
-    test_fixture_loop_stop (fixture);
+    switch (qmi_message_get_message_id ((QmiMessage *)request)) {
+    case 0x004D: /* Set IP Family */
+        init_offset = qmi_message_tlv_read_init ((QmiMessage *)request, 0x01, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint8 ((QmiMessage *)request, init_offset, &offset, &ip_family, NULL));
+        start_ctx->ip_families[cid] = ip_family;
+        return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+    case 0x0020: /* Start Network */
+        init_offset = qmi_message_tlv_read_init ((QmiMessage *)request, 0x19, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint8 ((QmiMessage *)request, init_offset, &offset, &ip_family, NULL));
+        g_assert_cmpuint (ip_family, ==, start_ctx->ip_families[cid]);
+
+        if (ip_family == start_ctx->failed_ip_family)
+            return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_CALL_FAILED);
+
+        response = qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+        init_offset = qmi_message_tlv_write_init (response, 0x01, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, 0x1000 | ip_family, NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        return response;
+    case 0x002D: /* Get Current Settings */
+        response = qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+        init_offset = qmi_message_tlv_write_init (response, 0x2B, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint8 (response, start_ctx->ip_families[cid], NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        return response;
+    case 0x0021: /* Stop Network */
+        init_offset = qmi_message_tlv_read_init ((QmiMessage *)request, 0x01, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint32 ((QmiMessage *)request, init_offset, &offset, QMI_ENDIAN_LITTLE, &packet_data_handle, NULL));
+        g_assert_cmpuint (packet_data_handle, ==, 0x1000 | start_ctx->ip_families[cid]);
+        start_ctx->n_stopped++;
+        return qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+    default:
+        g_assert_not_reached ();
+    }
 }
 
+static const QmiWdsNetworkSettings start_networks_settings[] = {
+    { 1, QMI_WDS_IP_FAMILY_IPV4 },
+    { 1, QMI_WDS_IP_FAMILY_IPV6 },
+};
+
 static void
-nas_get_cell_location_info_ready (QmiClientNas *client,
-                                  GAsyncResult *res,
-                                  TestFixture  *fixture)
+start_networks_ready (QmiDevice            *device,
+                      GAsyncResult         *res,
+                      StartNetworksContext *ctx)
 {
-    QmiMessageNasGetCellLocationInfoOutput *output;
     GError *error = NULL;
-    gboolean st;
+    GArray *networks;
+    guint   i;
 
-    output = qmi_client_nas_get_cell_location_info_finish (client, res, &error);
-    g_assert_no_error (error);
-    g_assert (output);
+    networks = qmi_device_start_networks_finish (device, res, &error);
+    if (ctx->failed_ip_family) {
+        g_assert_error (error, QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_CALL_FAILED);
+        g_assert (!networks);
+        g_error_free (error);
+        test_fixture_loop_stop (ctx->fixture);
+        return;
+    }
 
-    st = qmi_message_nas_get_cell_location_info_output_get_result (output, &error);
     g_assert_no_error (error);
-    g_assert (st);
+    g_assert (networks);
+    g_assert_cmpuint (networks->len, ==, G_N_ELEMENTS (start_networks_settings));
 
-    qmi_message_nas_get_cell_location_info_output_unref (output);
+    for (i = 0; i < networks->len; i++) {
+        QmiWdsNetwork  *network;
+        QmiWdsIpFamily  ip_family;
 
-    test_fixture_loop_stop (fixture);
+        network = &g_array_index (networks, QmiWdsNetwork, i);
+        g_assert (QMI_IS_CLIENT_WDS (network->client));
+        g_assert_cmpuint (network->packet_data_handle, ==, 0x1000 | start_networks_settings[i].ip_family);
+        g_assert (network->current_settings);
+        g_assert (qmi_message_wds_get_current_settings_output_get_ip_family (network->current_settings, &ip_family, NULL));
+        g_assert_cmpuint (ip_family, ==, start_networks_settings[i].ip_family);
+        qmi_device_release_client (device,
+                                   QMI_CLIENT (network->client),
+                                   QMI_DEVICE_RELEASE_CLIENT_FLAGS_NONE,
+                                   1, NULL, NULL, NULL);
+    }
+
+    g_array_unref (networks);
+    test_fixture_loop_stop (ctx->fixture);
 }
 
 static void
-test_generated_nas_network_scan (TestFixture *fixture)
+start_networks_run (TestFixture          *fixture,
+                    StartNetworksContext *ctx)
 {
-    guint8 expected[] = {
-        0x01,
-        0x0C, 0x00, 0x00, 0x03, 0x01,
-        0x00, 0xFF, 0xFF, 0x21, 0x00, 0x00, 0x00
-    };
-    guint8 response[] = {
-        0x01,
-        0x43, 0x01, 0x80, 0x03, 0x01,
-        0x02, 0xFF, 0xFF, 0x21, 0x00, 0x37, 0x01, 0x02,
-        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x60,
-        0x00, 0x08, 0x00, 0xD6, 0x00, 0x01, 0x00, 0xAA,
-        0x07, 0x76, 0x6F, 0x64, 0x61, 0x20, 0x45, 0x53,
-        0xD6, 0x00, 0x03, 0x00, 0xAA, 0x06, 0x4F, 0x72,
-        0x61, 0x6E, 0x67, 0x65, 0xD6, 0x00, 0x04, 0x00,
-        0xAA, 0x05, 0x59, 0x4F, 0x49, 0x47, 0x4F, 0xD6,
-        0x00, 0x01, 0x00, 0xAA, 0x07, 0x76, 0x6F, 0x64,
-        0x61, 0x20, 0x45, 0x53, 0xD6, 0x00, 0x04, 0x00,
-        0xAA, 0x05, 0x59, 0x4F, 0x49, 0x47, 0x4F, 0xD6,
-        0x00, 0x07, 0x00, 0xAA, 0x08, 0x4D, 0x6F, 0x76,
-        0x69, 0x73, 0x74, 0x61, 0x72, 0xD6, 0x00, 0x07,
-        0x00, 0xAA, 0x08, 0x4D, 0x6F, 0x76, 0x69, 0x73,
-        0x74, 0x61, 0x72, 0xD6, 0x00, 0x03, 0x00, 0xA9,
-        0x00, 0x11, 0x2A, 0x00, 0x08, 0x00, 0xD6, 0x00,
-        0x01, 0x00, 0x04, 0xD6, 0x00, 0x03, 0x00, 0x04,
-        0xD6, 0x00, 0x04, 0x00, 0x05, 0xD6, 0x00, 0x01,
-        0x00, 0x05, 0xD6, 0x00, 0x04, 0x00, 0x04, 0xD6,
-        0x00, 0x07, 0x00, 0x04, 0xD6, 0x00, 0x07, 0x00,
-        0x05, 0xD6, 0x00, 0x03, 0x00, 0x05, 0x12, 0x2A,
-        0x00, 0x08, 0x00, 0xD6, 0x00, 0x01, 0x00, 0x00,
-        0xD6, 0x00, 0x03, 0x00, 0x00, 0xD6, 0x00, 0x04,
-        0x00, 0x00, 0xD6, 0x00, 0x01, 0x00, 0x00, 0xD6,
-        0x00, 0x04, 0x00, 0x00, 0xD6, 0x00, 0x07, 0x00,
-        0x00, 0xD6, 0x00, 0x07, 0x00, 0x00, 0xD6, 0x00,
-        0x03, 0x00, 0x00, 0x13, 0x04, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x14, 0x69, 0x00, 0x08, 0xD6, 0x00,
-        0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0xD6, 0x00, 0x03, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0xD6, 0x00, 0x04, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xD6,
-        0x00, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-    };
+    test_port_context_set_responder (fixture->ctx, start_networks_responder, ctx);
+    qmi_device_start_networks (fixture->device,
+                               start_networks_settings,
+                               G_N_ELEMENTS (start_networks_settings),
+                               NULL,
+                               (GAsyncReadyCallback) start_networks_ready,
+                               ctx);
+    test_fixture_loop_run (fixture);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+}
 
-    test_port_context_set_command (fixture->ctx,
-                                   expected, G_N_ELEMENTS (expected),
-                                   response, G_N_ELEMENTS (response),
-                                   fixture->service_info[QMI_SERVICE_NAS].transaction_id++);
+static void
+test_generated_wds_start_networks (TestFixture *fixture)
+{
+    StartNetworksContext ctx = { fixture, 0x10, QMI_WDS_IP_FAMILY_UNKNOWN };
 
-    qmi_client_nas_network_scan (QMI_CLIENT_NAS (fixture->service_info[QMI_SERVICE_NAS].client), NULL, 3, NULL,
-                                 (GAsyncReadyCallback) nas_network_scan_ready,
-                                 fixture);
+    start_networks_run (fixture, &ctx);
+    g_assert_cmpuint (ctx.n_stopped, ==, 0);
+    g_assert_cmpuint (ctx.n_released, ==, 0);
 
-    test_fixture_loop_run (fixture);
+    /* Two Allocate CID requests */
+    fixture->service_info[QMI_SERVICE_CTL].transaction_id += 2;
 }
 
 static void
-test_generated_nas_get_cell_location_info (TestFixture *fixture)
+test_generated_wds_start_networks_failed (TestFixture *fixture)
 {
-    guint8 expected[] = {
-        0x01,
-        0x0C, 0x00, 0x00, 0x03, 0x01,
-        0x00, 0x01, 0x00, 0x43, 0x00, 0x00, 0x00
-    };
-    guint8 response[] = {
-        0x01,
-        0x53, 0x00, 0x80, 0x03, 0x01,
-        0x02, 0x01, 0x00, 0x43, 0x00, 0x47, 0x00, 0x02,
-        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x3D,
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF,
-        0xFF, 0x28, 0x00, 0x03, 0x7D, 0x6F, 0x00, 0x00,
-        0x32, 0xF4, 0x51, 0xB3, 0x00, 0x4D, 0x00, 0x11,
-        0x2A, 0x00, 0x8A, 0x3C, 0x00, 0x00, 0x32, 0xF4,
-        0x51, 0xB3, 0x00, 0x63, 0x00, 0x30, 0x14, 0x00,
-        0x89, 0x3C, 0x00, 0x00, 0x32, 0xF4, 0x51, 0xB3,
-        0x00, 0x59, 0x00, 0x11, 0x0D, 0x00
-    };
+    StartNetworksContext ctx = { fixture, 0x10, QMI_WDS_IP_FAMILY_IPV6 };
 
-    test_port_context_set_command (fixture->ctx,
-                                   expected, G_N_ELEMENTS (expected),
-                                   response, G_N_ELEMENTS (response),
-                                   fixture->service_info[QMI_SERVICE_NAS].transaction_id++);
+    start_networks_run (fixture, &ctx);
 
-    qmi_client_nas_get_cell_location_info (QMI_CLIENT_NAS (fixture->service_info[QMI_SERVICE_NAS].client), NULL, 3, NULL,
-                                           (GAsyncReadyCallback) nas_get_cell_location_info_ready,
-                                           fixture);
+    /* The IPv4 network is stopped, and both clients released */
+    g_assert_cmpuint (ctx.n_stopped, ==, 1);
+    g_assert_cmpuint (ctx.n_released, ==, 2);
+
+    /* Two Allocate CID and two Release CID requests */
+    fixture->service_info[QMI_SERVICE_CTL].transaction_id += 4;
+}
+
+/*****************************************************************************/
+/* WDS link configuration */
+
+typedef struct {
+    TestFixture                           *fixture;
+    gboolean                               with_ipv4;
+    QmiMessageWdsGetCurrentSettingsOutput *settings;
+    GError                                *error;
+} LinkContext;
+
+static GByteArray *
+configure_link_responder (TestPortContext *ctx,
+                          GByteArray      *request,
+                          gpointer         user_data)
+{
+    LinkContext *link_ctx = user_data;
+    QmiMessage  *response;
+    gsize        init_offset;
 
+    g_assert_cmpuint (qmi_message_get_service ((QmiMessage *)request), ==, QMI_SERVICE_WDS);
+    g_assert_cmpuint (qmi_message_get_message_id ((QmiMessage *)request), ==, 0x002D);
+
+    response = qmi_message_response_new ((QmiMessage *)request, QMI_PROTOCOL_ERROR_NONE);
+    if (!link_ctx->with_ipv4)
+        return response;
+
+    /* 10.0.0.2/24 */
+    init_offset = qmi_message_tlv_write_init (response, 0x1E, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, 0x0A000002, NULL));
+    g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+    init_offset = qmi_message_tlv_write_init (response, 0x21, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_guint32 (response, QMI_ENDIAN_LITTLE, 0xFFFFFF00, NULL));
+    g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+    return response;
+}
+
+static void
+configure_link_settings_ready (QmiClientWds *client,
+                               GAsyncResult *res,
+                               LinkContext  *ctx)
+{
+    GError *error = NULL;
+
+    ctx->settings = qmi_client_wds_get_current_settings_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (ctx->settings);
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+configure_link_ready (QmiDevice    *device,
+                      GAsyncResult *res,
+                      LinkContext  *ctx)
+{
+    g_assert (!qmi_device_configure_link_finish (device, res, &ctx->error));
+    g_assert (ctx->error);
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+configure_link_run (TestFixture *fixture,
+                    LinkContext *ctx)
+{
+    test_port_context_set_responder (fixture->ctx, configure_link_responder, ctx);
+    qmi_client_wds_get_current_settings (QMI_CLIENT_WDS (fixture->service_info[QMI_SERVICE_WDS].client),
+                                         NULL, 3, NULL,
+                                         (GAsyncReadyCallback) configure_link_settings_ready,
+                                         ctx);
+    test_fixture_loop_run (fixture);
+    test_port_context_set_responder (fixture->ctx, NULL, NULL);
+    fixture->service_info[QMI_SERVICE_WDS].transaction_id++;
+
+    qmi_device_configure_link (fixture->device, ctx->settings,
+                               QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN, TRUE, NULL,
+                               (GAsyncReadyCallback) configure_link_ready,
+                               ctx);
     test_fixture_loop_run (fixture);
+    qmi_message_wds_get_current_settings_output_unref (ctx->settings);
 }
 
+static void
+test_generated_wds_configure_link_no_address (TestFixture *fixture)
+{
+    LinkContext ctx = { fixture, FALSE };
+
+    /* Refused before looking for the interface */
+    configure_link_run (fixture, &ctx);
+    g_assert_error (ctx.error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS);
+    g_error_free (ctx.error);
+}
 
-/*****************************************************************************/
+static void
+test_generated_wds_configure_link_no_iface (TestFixture *fixture)
+{
+    LinkContext ctx = { fixture, TRUE };
+
+    /* The settings are valid, but the simulated modem has no network
+     * interface, so nothing can be configured */
+    configure_link_run (fixture, &ctx);
+    g_assert (!g_error_matches (ctx.error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS));
+    g_error_free (ctx.error);
+}
 
 int main (int argc, char **argv)
 {
@@ -652,15 +5710,73 @@ int main (int argc, char **argv)
 
     /* Test the setup/teardown test methods */
     TEST_ADD ("/libqmi-glib/generated/core", test_generated_core);
+    TEST_ADD ("/libqmi-glib/generated/core/allocate-clients", test_generated_core_allocate_clients);
+    TEST_ADD ("/libqmi-glib/generated/core/command-batch",    test_generated_core_command_batch);
+    TEST_ADD ("/libqmi-glib/generated/core/low-power",        test_generated_core_low_power);
+    TEST_ADD ("/libqmi-glib/generated/core/stats-lengths",    test_generated_core_stats_lengths);
+    TEST_ADD ("/libqmi-glib/generated/core/hangup-with-data", test_generated_core_hangup_with_data);
+    TEST_ADD ("/libqmi-glib/generated/core/output-queue",     test_generated_core_output_queue);
+    TEST_ADD ("/libqmi-glib/generated/core/output-queue-close", test_generated_core_output_queue_close);
+    TEST_ADD ("/libqmi-glib/generated/core/in-flight-window", test_generated_core_in_flight_window);
+    TEST_ADD ("/libqmi-glib/generated/core/in-flight-window-by-service", test_generated_core_in_flight_window_by_service);
+    TEST_ADD ("/libqmi-glib/generated/core/priority",         test_generated_core_priority);
+    TEST_ADD ("/libqmi-glib/generated/core/shared-cancellable", test_generated_core_shared_cancellable);
+    TEST_ADD ("/libqmi-glib/generated/core/release-clients",  test_generated_core_release_clients);
+    TEST_ADD ("/libqmi-glib/generated/core/shared-device",    test_generated_core_shared_device);
+    TEST_ADD ("/libqmi-glib/generated/core/device-group",     test_generated_core_device_group);
+    TEST_ADD ("/libqmi-glib/generated/core/io-thread",        test_generated_core_io_thread);
+    TEST_ADD ("/libqmi-glib/generated/core/io-uring",         test_generated_core_io_uring);
+    TEST_ADD ("/libqmi-glib/generated/core/io-uring-fallback", test_generated_core_io_uring_fallback);
 
     /* DMS */
     TEST_ADD ("/libqmi-glib/generated/dms/get-ids",                test_generated_dms_get_ids);
+    TEST_ADD ("/libqmi-glib/generated/dms/get-ids-external-loop",  test_generated_dms_get_ids_external_loop);
+    TEST_ADD ("/libqmi-glib/generated/dms/get-ids-coalesced",      test_generated_dms_get_ids_coalesced);
+    TEST_ADD ("/libqmi-glib/generated/dms/get-ids-cached",         test_generated_dms_get_ids_cached);
+    TEST_ADD ("/libqmi-glib/generated/dms/get-ids-no-reply",       test_generated_dms_get_ids_no_reply);
+    TEST_ADD ("/libqmi-glib/generated/dms/get-ids-interned",       test_generated_dms_get_ids_interned);
+    TEST_ADD ("/libqmi-glib/generated/dms/get-ids-stall",          test_generated_dms_get_ids_stall);
+    TEST_ADD ("/libqmi-glib/generated/dms/get-ids-offloaded",      test_generated_dms_get_ids_offloaded);
+    TEST_ADD ("/libqmi-glib/generated/dms/get-ids-polled",         test_generated_dms_get_ids_polled);
+    TEST_ADD ("/libqmi-glib/generated/dms/get-ids-adaptive",       test_generated_dms_get_ids_adaptive_timeout);
+    TEST_ADD ("/libqmi-glib/generated/dms/get-ids-unresponsive",   test_generated_dms_get_ids_unresponsive);
     TEST_ADD ("/libqmi-glib/generated/dms/uim-get-pin-status",     test_generated_dms_uim_get_pin_status);
     TEST_ADD ("/libqmi-glib/generated/dms/uim-verify-pin",         test_generated_dms_uim_verify_pin);
     TEST_ADD ("/libqmi-glib/generated/dms/get-time",               test_generated_dms_get_time);
     /* NAS */
     TEST_ADD ("/libqmi-glib/generated/nas/network-scan",           test_generated_nas_network_scan);
     TEST_ADD ("/libqmi-glib/generated/nas/get-cell-location-info", test_generated_nas_get_cell_location_info);
+    TEST_ADD ("/libqmi-glib/generated/nas/state-mirror",           test_generated_nas_state_mirror);
+    TEST_ADD ("/libqmi-glib/generated/nas/state-mirror-resolution", test_generated_nas_state_mirror_resolution);
+    TEST_ADD ("/libqmi-glib/generated/nas/indication-callback",    test_generated_nas_indication_callback);
+    TEST_ADD ("/libqmi-glib/generated/nas/indication-cache",       test_generated_nas_indication_cache);
+    /* WDS */
+    TEST_ADD ("/libqmi-glib/generated/wds/stats-sampler",          test_generated_wds_stats_sampler);
+    TEST_ADD ("/libqmi-glib/generated/wds/stats-sampler-polling",  test_generated_wds_stats_sampler_polling);
+    TEST_ADD ("/libqmi-glib/generated/wds/mux-sessions",           test_generated_wds_mux_sessions);
+    TEST_ADD ("/libqmi-glib/generated/wds/get-all-profiles",       test_generated_wds_get_all_profiles);
+    TEST_ADD ("/libqmi-glib/generated/wds/start-networks",         test_generated_wds_start_networks);
+    TEST_ADD ("/libqmi-glib/generated/wds/start-networks-failed",  test_generated_wds_start_networks_failed);
+    TEST_ADD ("/libqmi-glib/generated/wds/configure-link-no-address", test_generated_wds_configure_link_no_address);
+    TEST_ADD ("/libqmi-glib/generated/wds/configure-link-no-iface",   test_generated_wds_configure_link_no_iface);
+
+    TEST_ADD ("/libqmi-glib/generated/kpi-sampler",                test_generated_kpi_sampler);
+    /* PDC */
+    TEST_ADD ("/libqmi-glib/generated/pdc/load-config",            test_generated_pdc_load_config);
+    /* UIM */
+    TEST_ADD ("/libqmi-glib/generated/uim/read-file",              test_generated_uim_read_file);
+    TEST_ADD ("/libqmi-glib/generated/uim/card-status-cache",      test_generated_uim_card_status_cache);
+    /* WMS */
+    TEST_ADD ("/libqmi-glib/generated/wms/sweep",                  test_generated_wms_sweep);
+    /* PDS */
+    TEST_ADD ("/libqmi-glib/generated/pds/nmea-stream",            test_generated_pds_nmea_stream);
+
+    TEST_ADD ("/libqmi-glib/generated/voice/call-tracker",         test_generated_voice_call_tracker);
+
+    TEST_ADD ("/libqmi-glib/generated/pbm/read-phonebook",         test_generated_pbm_read_phonebook);
+
+    TEST_ADD ("/libqmi-glib/generated/loc/session-mux",            test_generated_loc_session_mux);
+    TEST_ADD ("/libqmi-glib/generated/loc/indication-queue-limit", test_generated_loc_indication_queue_limit);
 
     return g_test_run ();
 }
@@ -0,0 +1,502 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <glib.h>
+#include <gio/gio.h>
+#include <gio/gunixfdlist.h>
+
+#include "qmi-low-power.h"
+
+/* Iterates the main context until the condition holds, or fails after a
+ * while */
+#define wait_until(condition) G_STMT_START {                            \
+        gint64 deadline;                                                \
+                                                                        \
+        deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;        \
+        while (!(condition)) {                                          \
+            g_assert_cmpint (g_get_monotonic_time (), <, deadline);     \
+            if (!g_main_context_iteration (NULL, FALSE))                \
+                g_usleep (1000);                                        \
+        }                                                               \
+    } G_STMT_END
+
+/*****************************************************************************/
+/* Indication registrations */
+
+static const guint8 enabled = 1;
+
+static QmiMessage *
+registration_new (QmiService service,
+                  guint8     cid,
+                  guint16    message_id)
+{
+    return qmi_message_new (service, cid, 1, message_id);
+}
+
+static void
+registration_add_tlv (QmiMessage *message,
+                      guint8      type,
+                      guint8      first,
+                      guint8      second)
+{
+    guint8 value[2] = { first, second };
+
+    g_assert (qmi_message_add_raw_tlv (message, type, value, second ? 2 : 1, NULL));
+}
+
+static void
+registration_record (QmiIndicationRegistrations *registrations,
+                     QmiMessage                 *message,
+                     gboolean                    expected)
+{
+    g_assert_cmpuint (__qmi_indication_registrations_record (registrations, message), ==, expected);
+    qmi_message_unref (message);
+}
+
+static void
+assert_tlv (QmiMessage *message,
+            guint8      type,
+            guint8      first,
+            guint8      second)
+{
+    const guint8 *value;
+    guint16       length = 0;
+
+    value = qmi_message_get_raw_tlv (message, type, &length);
+    g_assert (value);
+    g_assert_cmpuint (length, ==, second ? 2 : 1);
+    g_assert_cmpuint (value[0], ==, first);
+    if (second)
+        g_assert_cmpuint (value[1], ==, second);
+}
+
+/* Only the client with CID 1 is there */
+static gboolean
+transaction_id_fn (QmiService  service,
+                   guint8      cid,
+                   guint16    *transaction_id,
+                   guint16    *next)
+{
+    if (cid != 1)
+        return FALSE;
+    *transaction_id = (*next)++;
+    return TRUE;
+}
+
+static QmiMessage *
+set_low_power (QmiIndicationRegistrations *registrations,
+               gboolean                    low_power,
+               guint16                    *next)
+{
+    GPtrArray  *messages;
+    QmiMessage *message;
+
+    messages = __qmi_indication_registrations_set_low_power (registrations,
+                                                             low_power,
+                                                             (QmiIndicationRegistrationsTransactionIdFn)transaction_id_fn,
+                                                             next);
+    g_assert (messages);
+    g_assert_cmpuint (messages->len, ==, 1);
+    message = qmi_message_ref (g_ptr_array_index (messages, 0));
+    g_ptr_array_unref (messages);
+
+    g_assert_cmpuint (qmi_message_get_service (message), ==, QMI_SERVICE_DMS);
+    g_assert_cmpuint (qmi_message_get_client_id (message), ==, 1);
+    g_assert_cmpuint (qmi_message_get_message_id (message), ==, 0x0001);
+    g_assert_cmpuint (qmi_message_get_transaction_id (message), ==, *next - 1);
+    return message;
+}
+
+static void
+test_indication_registrations_record (void)
+{
+    QmiIndicationRegistrations *registrations;
+
+    registrations = __qmi_indication_registrations_new ();
+
+    /* Neither CTL nor other requests are recorded */
+    registration_record (registrations, registration_new (QMI_SERVICE_CTL, 0, 0x0001), FALSE);
+    registration_record (registrations, registration_new (QMI_SERVICE_DMS, 1, 0x0020), FALSE);
+    registration_record (registrations, registration_new (QMI_SERVICE_WDS, 1, 0x0002), FALSE);
+
+    /* Set Event Report and Register Indications are */
+    registration_record (registrations, registration_new (QMI_SERVICE_DMS, 1, 0x0001), TRUE);
+    registration_record (registrations, registration_new (QMI_SERVICE_WDS, 1, 0x0001), TRUE);
+    registration_record (registrations, registration_new (QMI_SERVICE_NAS, 1, 0x0002), TRUE);
+    registration_record (registrations, registration_new (QMI_SERVICE_NAS, 1, 0x0003), TRUE);
+
+    __qmi_indication_registrations_free (registrations);
+}
+
+static void
+test_indication_registrations_low_power (void)
+{
+    QmiIndicationRegistrations *registrations;
+    QmiMessage                 *message;
+    GPtrArray                  *messages;
+    guint16                     next = 10;
+
+    registrations = __qmi_indication_registrations_new ();
+
+    /* Power state reports enabled and then disabled, PIN state reports and
+     * battery level limits enabled */
+    message = registration_new (QMI_SERVICE_DMS, 1, 0x0001);
+    registration_add_tlv (message, 0x10, enabled, 0);
+    registration_add_tlv (message, 0x12, enabled, 0);
+    registration_record (registrations, message, TRUE);
+    message = registration_new (QMI_SERVICE_DMS, 1, 0x0001);
+    registration_add_tlv (message, 0x10, 0, 0);
+    registration_add_tlv (message, 0x11, 5, 90);
+    registration_record (registrations, message, TRUE);
+
+    /* Of a client that is gone, skipped */
+    message = registration_new (QMI_SERVICE_DMS, 2, 0x0001);
+    registration_add_tlv (message, 0x12, enabled, 0);
+    registration_record (registrations, message, TRUE);
+
+    /* Disabled, with the whole battery level range */
+    message = set_low_power (registrations, TRUE, &next);
+    assert_tlv (message, 0x10, 0, 0);
+    assert_tlv (message, 0x11, 0, 100);
+    assert_tlv (message, 0x12, 0, 0);
+    qmi_message_unref (message);
+
+    /* Already in low-power mode */
+    g_assert (!__qmi_indication_registrations_set_low_power (registrations,
+                                                             TRUE,
+                                                             (QmiIndicationRegistrationsTransactionIdFn)transaction_id_fn,
+                                                             &next));
+
+    /* Restored with the last values */
+    message = set_low_power (registrations, FALSE, &next);
+    assert_tlv (message, 0x10, 0, 0);
+    assert_tlv (message, 0x11, 5, 90);
+    assert_tlv (message, 0x12, enabled, 0);
+    qmi_message_unref (message);
+
+    /* Nothing to send once the client is forgotten */
+    __qmi_indication_registrations_forget (registrations, QMI_SERVICE_DMS, 1);
+    messages = __qmi_indication_registrations_set_low_power (registrations,
+                                                             TRUE,
+                                                             (QmiIndicationRegistrationsTransactionIdFn)transaction_id_fn,
+                                                             &next);
+    g_assert (messages);
+    g_assert_cmpuint (messages->len, ==, 0);
+    g_ptr_array_unref (messages);
+
+    /* Low-power mode left when cleared */
+    __qmi_indication_registrations_clear (registrations);
+    g_assert (!__qmi_indication_registrations_set_low_power (registrations,
+                                                             FALSE,
+                                                             (QmiIndicationRegistrationsTransactionIdFn)transaction_id_fn,
+                                                             &next));
+
+    __qmi_indication_registrations_free (registrations);
+}
+
+/*****************************************************************************/
+/* Fake logind in a private bus, handing out the write end of a pipe as the
+ * inhibitor, so that its release is seen as a hangup in the read end */
+
+static const gchar logind_introspection[] =
+    "<node>"
+    "  <interface name='" QMI_SUSPEND_MONITOR_LOGIND_INTERFACE "'>"
+    "    <method name='Inhibit'>"
+    "      <arg type='s' name='what' direction='in'/>"
+    "      <arg type='s' name='who' direction='in'/>"
+    "      <arg type='s' name='why' direction='in'/>"
+    "      <arg type='s' name='mode' direction='in'/>"
+    "      <arg type='h' name='fd' direction='out'/>"
+    "    </method>"
+    "    <signal name='PrepareForSleep'>"
+    "      <arg type='b' name='start'/>"
+    "    </signal>"
+    "  </interface>"
+    "</node>";
+
+typedef struct {
+    GDBusConnection *connection;
+    GDBusNodeInfo   *node_info;
+    guint            registration_id;
+    /* Read ends of the inhibitors taken */
+    GArray          *inhibitors;
+} FakeLogind;
+
+static GDBusConnection *
+bus_connection_new (GTestDBus *bus)
+{
+    GDBusConnection *connection;
+    GError          *error = NULL;
+
+    connection = g_dbus_connection_new_for_address_sync (g_test_dbus_get_bus_address (bus),
+                                                         (G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                                          G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+                                                         NULL,
+                                                         NULL,
+                                                         &error);
+    g_assert_no_error (error);
+    return connection;
+}
+
+static void
+fake_logind_method_call (GDBusConnection       *connection,
+                         const gchar           *sender,
+                         const gchar           *object_path,
+                         const gchar           *interface_name,
+                         const gchar           *method_name,
+                         GVariant              *parameters,
+                         GDBusMethodInvocation *invocation,
+                         FakeLogind            *logind)
+{
+    GUnixFDList *fd_list;
+    const gchar *what;
+    const gchar *mode;
+    gint         fds[2];
+    gint         index;
+
+    g_variant_get (parameters, "(&s&s&s&s)", &what, NULL, NULL, &mode);
+    g_assert_cmpstr (what, ==, "sleep");
+    g_assert_cmpstr (mode, ==, "delay");
+
+    g_assert_cmpint (pipe (fds), ==, 0);
+    fd_list = g_unix_fd_list_new ();
+    index = g_unix_fd_list_append (fd_list, fds[1], NULL);
+    g_assert_cmpint (index, >=, 0);
+    close (fds[1]);
+    g_array_append_val (logind->inhibitors, fds[0]);
+
+    g_dbus_method_invocation_return_value_with_unix_fd_list (invocation,
+                                                             g_variant_new ("(h)", index),
+                                                             fd_list);
+    g_object_unref (fd_list);
+}
+
+static const GDBusInterfaceVTable logind_vtable = {
+    (GDBusInterfaceMethodCallFunc)fake_logind_method_call,
+    NULL,
+    NULL,
+};
+
+static FakeLogind *
+fake_logind_new (GTestDBus *bus)
+{
+    FakeLogind *logind;
+    GVariant   *reply;
+    GError     *error = NULL;
+    guint32     result;
+
+    logind = g_slice_new0 (FakeLogind);
+    logind->inhibitors = g_array_new (FALSE, FALSE, sizeof (gint));
+    logind->connection = bus_connection_new (bus);
+    logind->node_info = g_dbus_node_info_new_for_xml (logind_introspection, &error);
+    g_assert_no_error (error);
+
+    logind->registration_id = g_dbus_connection_register_object (logind->connection,
+                                                                 QMI_SUSPEND_MONITOR_LOGIND_OBJECT_PATH,
+                                                                 logind->node_info->interfaces[0],
+                                                                 &logind_vtable,
+                                                                 logind,
+                                                                 NULL,
+                                                                 &error);
+    g_assert_no_error (error);
+
+    /* DBUS_NAME_FLAG_DO_NOT_QUEUE, replied DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER */
+    reply = g_dbus_connection_call_sync (logind->connection,
+                                         "org.freedesktop.DBus",
+                                         "/org/freedesktop/DBus",
+                                         "org.freedesktop.DBus",
+                                         "RequestName",
+                                         g_variant_new ("(su)", QMI_SUSPEND_MONITOR_LOGIND_BUS_NAME, 4),
+                                         G_VARIANT_TYPE ("(u)"),
+                                         G_DBUS_CALL_FLAGS_NONE,
+                                         -1,
+                                         NULL,
+                                         &error);
+    g_assert_no_error (error);
+    g_variant_get (reply, "(u)", &result);
+    g_assert_cmpuint (result, ==, 1);
+    g_variant_unref (reply);
+
+    return logind;
+}
+
+static void
+fake_logind_free (FakeLogind *logind)
+{
+    guint i;
+
+    for (i = 0; i < logind->inhibitors->len; i++)
+        close (g_array_index (logind->inhibitors, gint, i));
+    g_array_unref (logind->inhibitors);
+    g_dbus_connection_unregister_object (logind->connection, logind->registration_id);
+    g_dbus_node_info_unref (logind->node_info);
+    g_object_unref (logind->connection);
+    g_slice_free (FakeLogind, logind);
+}
+
+static void
+fake_logind_prepare_for_sleep (FakeLogind *logind,
+                               gboolean    start)
+{
+    GError *error = NULL;
+
+    g_dbus_connection_emit_signal (logind->connection,
+                                   NULL,
+                                   QMI_SUSPEND_MONITOR_LOGIND_OBJECT_PATH,
+                                   QMI_SUSPEND_MONITOR_LOGIND_INTERFACE,
+                                   "PrepareForSleep",
+                                   g_variant_new ("(b)", start),
+                                   &error);
+    g_assert_no_error (error);
+}
+
+static gboolean
+fake_logind_inhibitor_released (FakeLogind *logind,
+                                guint       i)
+{
+    struct pollfd pfd;
+
+    g_assert_cmpuint (i, <, logind->inhibitors->len);
+
+    memset (&pfd, 0, sizeof (pfd));
+    pfd.fd = g_array_index (logind->inhibitors, gint, i);
+    pfd.events = POLLIN;
+    g_assert_cmpint (poll (&pfd, 1, 0), >=, 0);
+    return !!(pfd.revents & (POLLIN | POLLHUP));
+}
+
+/*****************************************************************************/
+/* Suspend monitor */
+
+typedef struct {
+    FakeLogind *logind;
+    guint       n_events;
+    gboolean    suspending;
+} MonitorContext;
+
+static void
+monitor_cb (QmiSuspendMonitor *monitor,
+            gboolean           suspending,
+            MonitorContext    *ctx)
+{
+    ctx->n_events++;
+    ctx->suspending = suspending;
+}
+
+static void
+test_suspend_monitor (void)
+{
+    GTestDBus         *bus;
+    GDBusConnection   *connection;
+    QmiSuspendMonitor *monitor;
+    MonitorContext     ctx;
+
+    bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+    g_test_dbus_up (bus);
+
+    memset (&ctx, 0, sizeof (ctx));
+    ctx.logind = fake_logind_new (bus);
+    connection = bus_connection_new (bus);
+
+    /* Inhibitor taken right away */
+    monitor = __qmi_suspend_monitor_new (connection, "test", (QmiSuspendMonitorFn)monitor_cb, &ctx);
+    wait_until (ctx.logind->inhibitors->len == 1);
+    g_assert (!fake_logind_inhibitor_released (ctx.logind, 0));
+
+    /* Held while suspending, until released */
+    fake_logind_prepare_for_sleep (ctx.logind, TRUE);
+    wait_until (ctx.n_events == 1);
+    g_assert (ctx.suspending);
+    g_assert (!fake_logind_inhibitor_released (ctx.logind, 0));
+    __qmi_suspend_monitor_release (monitor);
+    wait_until (fake_logind_inhibitor_released (ctx.logind, 0));
+
+    /* Taken again after resuming */
+    fake_logind_prepare_for_sleep (ctx.logind, FALSE);
+    wait_until (ctx.n_events == 2);
+    g_assert (!ctx.suspending);
+    wait_until (ctx.logind->inhibitors->len == 2);
+
+    /* Released when the monitor is gone, even if not while suspending */
+    fake_logind_prepare_for_sleep (ctx.logind, TRUE);
+    wait_until (ctx.n_events == 3);
+    g_assert (!fake_logind_inhibitor_released (ctx.logind, 1));
+    __qmi_suspend_monitor_free (monitor);
+    wait_until (fake_logind_inhibitor_released (ctx.logind, 1));
+
+    g_object_unref (connection);
+    fake_logind_free (ctx.logind);
+    g_test_dbus_down (bus);
+    g_object_unref (bus);
+}
+
+static gboolean
+loop_quit_cb (GMainLoop *loop)
+{
+    g_main_loop_quit (loop);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+test_suspend_monitor_free_inhibiting (void)
+{
+    GTestDBus         *bus;
+    GDBusConnection   *connection;
+    QmiSuspendMonitor *monitor;
+    GMainLoop         *loop;
+    MonitorContext     ctx;
+
+    bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+    g_test_dbus_up (bus);
+
+    memset (&ctx, 0, sizeof (ctx));
+    ctx.logind = fake_logind_new (bus);
+    connection = bus_connection_new (bus);
+
+    /* Freed with the Inhibit call still ongoing, its reply is ignored and
+     * the inhibitor released, if ever taken */
+    monitor = __qmi_suspend_monitor_new (connection, "test", (QmiSuspendMonitorFn)monitor_cb, &ctx);
+    __qmi_suspend_monitor_free (monitor);
+
+    loop = g_main_loop_new (NULL, FALSE);
+    g_timeout_add (100, (GSourceFunc)loop_quit_cb, loop);
+    g_main_loop_run (loop);
+    g_main_loop_unref (loop);
+
+    if (ctx.logind->inhibitors->len)
+        wait_until (fake_logind_inhibitor_released (ctx.logind, 0));
+
+    g_object_unref (connection);
+    fake_logind_free (ctx.logind);
+    g_test_dbus_down (bus);
+    g_object_unref (bus);
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/libqmi-glib/low-power/indication-registrations/record",    test_indication_registrations_record);
+    g_test_add_func ("/libqmi-glib/low-power/indication-registrations/low-power", test_indication_registrations_low_power);
+    g_test_add_func ("/libqmi-glib/low-power/suspend-monitor",                    test_suspend_monitor);
+    g_test_add_func ("/libqmi-glib/low-power/suspend-monitor/free-inhibiting",    test_suspend_monitor_free_inhibiting);
+
+    return g_test_run ();
+}
@@ -18,7 +18,9 @@
 #include <string.h>
 #include <stdio.h>
 
+#include "qmi-version.h"
 #include "qmi-message.h"
+#include "qmi-schema.h"
 #include "qmi-errors.h"
 #include "qmi-error-types.h"
 #include "qmi-utils.h"
@@ -174,6 +176,85 @@ test_message_parse_complete_and_complete (void)
     test_message_parse_common (buffer, sizeof (buffer), 2);
 }
 
+static void
+test_message_frame_iter (void)
+{
+    const guint8 buffer[] = {
+        /* Valid: NAS Get Signal Strength response */
+        0x01, 0x26, 0x00, 0x80, 0x03, 0x01, 0x02, 0x01, 0x00, 0x20, 0x00, 0x1a,
+        0x00, 0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x00, 0x9b,
+        0x05, 0x11, 0x04, 0x00, 0x01, 0x00, 0x65, 0x05, 0x12, 0x04, 0x00, 0x01,
+        0x00, 0x11, 0x05,
+        /* Invalid: TLV value runs over the message */
+        0x01, 0x10, 0x00, 0x80, 0x06, 0x03, 0x04, 0x01, 0x00, 0x01, 0x00, 0x04,
+        0x00, 0x11, 0x05, 0x00, 0x01,
+        /* Valid again */
+        0x01, 0x26, 0x00, 0x80, 0x03, 0x01, 0x02, 0x02, 0x00, 0x20, 0x00, 0x1a,
+        0x00, 0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x00, 0x9b,
+        0x05, 0x11, 0x04, 0x00, 0x01, 0x00, 0x65, 0x05, 0x12, 0x04, 0x00, 0x01,
+        0x00, 0x11, 0x05,
+        /* Partial */
+        0x01, 0x26, 0x00, 0x80, 0x03, 0x01
+    };
+    guint8              buffer_copy[sizeof (buffer)];
+    QmiMessageFrameIter iter;
+    QmiMessageFrame     frame;
+    QmiMessage         *message;
+    GError             *error = NULL;
+
+    memcpy (buffer_copy, buffer, sizeof (buffer));
+
+    qmi_message_frame_iter_init (&iter, buffer, sizeof (buffer));
+
+    g_assert (qmi_message_frame_iter_next (&iter, &frame, &error));
+    g_assert_no_error (error);
+    g_assert (frame.data == buffer);
+    g_assert_cmpuint (frame.offset, ==, 0);
+    g_assert_cmpuint (frame.length, ==, 39);
+    g_assert_cmpuint (frame.service, ==, QMI_SERVICE_NAS);
+    g_assert_cmpuint (frame.client_id, ==, 1);
+    g_assert_cmpuint (frame.transaction_id, ==, 1);
+    g_assert_cmpuint (frame.message_id, ==, 0x0020);
+    g_assert (frame.response);
+    g_assert (!frame.indication);
+    g_assert (frame.tlvs == &buffer[13]);
+    g_assert_cmpuint (frame.tlvs_length, ==, 26);
+
+    /* The invalid message is reported and skipped */
+    g_assert (!qmi_message_frame_iter_next (&iter, &frame, &error));
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_MESSAGE);
+    g_clear_error (&error);
+    g_assert_cmpuint (qmi_message_frame_iter_get_offset (&iter), ==, 56);
+
+    g_assert (qmi_message_frame_iter_next (&iter, &frame, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (frame.offset, ==, 56);
+    g_assert_cmpuint (frame.transaction_id, ==, 2);
+
+    /* Materialized, same contents as when parsed from a GByteArray */
+    message = qmi_message_new_from_frame (&frame);
+    g_assert (message);
+    g_assert_cmpuint (qmi_message_get_transaction_id (message), ==, 2);
+    _g_assert_cmpmem (((GByteArray *) message)->data, ((GByteArray *) message)->len,
+                      &buffer[56], 39);
+    qmi_message_unref (message);
+
+    /* Only the partial message left */
+    g_assert (!qmi_message_frame_iter_next (&iter, &frame, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (qmi_message_frame_iter_get_offset (&iter), ==, 95);
+
+    /* Invalid messages skipped silently without error location */
+    qmi_message_frame_iter_init (&iter, buffer, sizeof (buffer));
+    g_assert (qmi_message_frame_iter_next (&iter, &frame, NULL));
+    g_assert (qmi_message_frame_iter_next (&iter, &frame, NULL));
+    g_assert_cmpuint (frame.offset, ==, 56);
+    g_assert (!qmi_message_frame_iter_next (&iter, &frame, NULL));
+
+    /* Never modified */
+    g_assert (memcmp (buffer, buffer_copy, sizeof (buffer)) == 0);
+}
+
 static void
 test_message_overflow_common (const guint8 *buffer,
                               guint buffer_len)
@@ -239,6 +320,145 @@ test_message_parse_missing_size (void)
 
 /*****************************************************************************/
 
+#if QMI_SERVICE_DMS_SUPPORTED
+
+static void
+test_message_json (void)
+{
+    QmiMessage *message;
+    GByteArray *array;
+    GError *error = NULL;
+    gchar *json;
+    const guint8 buffer[] = {
+        0x01, 0x1F, 0x00, 0x80, 0x02, 0x01, 0x02, 0x02, 0x00, 0x21, 0x00, 0x13,
+        0x00, 0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x04, 0x00, 0x51,
+        0x4D, 0x49, 0x22, 0x30, 0x02, 0x00, 0xAA, 0xBB
+    };
+
+    array = g_byte_array_sized_new (sizeof (buffer));
+    g_byte_array_append (array, buffer, sizeof (buffer));
+    message = qmi_message_new_from_raw (array, &error);
+    g_assert_no_error (error);
+    g_assert (message);
+
+    json = qmi_message_get_json (message, NULL);
+    g_assert_cmpstr (json, ==,
+                     "{\"service\":\"dms\",\"client\":1,\"transaction\":2,\"type\":\"response\","
+                     "\"message\":\"Get Manufacturer\",\"message-id\":33,\"tlvs\":["
+                     "{\"type\":2,\"name\":\"Result\",\"value\":{\"status\":\"success\"}},"
+                     "{\"type\":1,\"name\":\"Manufacturer\",\"value\":\"QMI\\\"\"},"
+                     "{\"type\":48,\"raw\":\"AA:BB\"}]}");
+    g_free (json);
+
+    g_byte_array_unref (array);
+    qmi_message_unref (message);
+}
+
+static void
+test_message_validate (void)
+{
+    QmiMessage *message;
+    GByteArray *array;
+    GError *error = NULL;
+    gboolean valid;
+    const guint8 buffer_valid[] = {
+        0x01, 0x1F, 0x00, 0x80, 0x02, 0x01, 0x02, 0x02, 0x00, 0x21, 0x00, 0x13,
+        0x00, 0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x04, 0x00, 0x51,
+        0x4D, 0x49, 0x22, 0x30, 0x02, 0x00, 0xAA, 0xBB
+    };
+    /* Successful response without the mandatory Manufacturer TLV */
+    const guint8 buffer_invalid[] = {
+        0x01, 0x13, 0x00, 0x80, 0x02, 0x01, 0x02, 0x02, 0x00, 0x21, 0x00, 0x07,
+        0x00, 0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+
+    array = g_byte_array_sized_new (sizeof (buffer_valid) + sizeof (buffer_invalid));
+    g_byte_array_append (array, buffer_valid, sizeof (buffer_valid));
+    g_byte_array_append (array, buffer_invalid, sizeof (buffer_invalid));
+
+    message = qmi_message_new_from_raw (array, &error);
+    g_assert_no_error (error);
+    g_assert (message);
+    valid = qmi_message_validate (message, NULL, &error);
+    g_assert_no_error (error);
+    g_assert (valid);
+    qmi_message_unref (message);
+
+    message = qmi_message_new_from_raw (array, &error);
+    g_assert_no_error (error);
+    g_assert (message);
+    valid = qmi_message_validate (message, NULL, &error);
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TLV_NOT_FOUND);
+    g_assert (!valid);
+    g_clear_error (&error);
+    qmi_message_unref (message);
+
+    /* Unknown message */
+    message = qmi_message_new (QMI_SERVICE_DMS, 0x01, 0x02, 0xFFFF);
+    valid = qmi_message_validate (message, NULL, &error);
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_UNSUPPORTED);
+    g_assert (!valid);
+    g_clear_error (&error);
+    qmi_message_unref (message);
+
+    g_byte_array_unref (array);
+}
+
+static void
+test_message_parse_into (void)
+{
+    QmiMessage *message;
+    GByteArray *array;
+    GError *error = NULL;
+    QmiMessageDmsGetPowerStateOutputStruct out;
+    guint64 mask;
+    gboolean st;
+    const guint8 buffer_ok[] = {
+        0x01, 0x18, 0x00, 0x80, 0x02, 0x01, 0x02, 0x02, 0x00, 0x26, 0x00, 0x0C,
+        0x00, 0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x00, 0x01,
+        0x50
+    };
+    /* Failed response, with just the result */
+    const guint8 buffer_failed[] = {
+        0x01, 0x13, 0x00, 0x80, 0x02, 0x01, 0x02, 0x03, 0x00, 0x26, 0x00, 0x07,
+        0x00, 0x02, 0x04, 0x00, 0x01, 0x00, 0x03, 0x00
+    };
+
+    array = g_byte_array_sized_new (sizeof (buffer_ok) + sizeof (buffer_failed));
+    g_byte_array_append (array, buffer_ok, sizeof (buffer_ok));
+    g_byte_array_append (array, buffer_failed, sizeof (buffer_failed));
+
+    message = qmi_message_new_from_raw (array, &error);
+    g_assert_no_error (error);
+    g_assert (message);
+    memset (&out, 0xFF, sizeof (out));
+    st = qmi_message_dms_get_power_state_response_parse_into (message, &out, &mask, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+    g_assert_cmpuint (mask, ==, QMI_MESSAGE_DMS_GET_POWER_STATE_OUTPUT_FIELD_INFO);
+    g_assert_cmpuint (out.arg_info_power_state_flags, ==, 0x01);
+    g_assert_cmpuint (out.arg_info_battery_level, ==, 0x50);
+    qmi_message_unref (message);
+
+    /* The same struct is reused, and cleared */
+    message = qmi_message_new_from_raw (array, &error);
+    g_assert_no_error (error);
+    g_assert (message);
+    st = qmi_message_dms_get_power_state_response_parse_into (message, &out, &mask, &error);
+    g_assert_error (error, QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_INTERNAL);
+    g_assert (!st);
+    g_clear_error (&error);
+    g_assert_cmpuint (mask, ==, 0);
+    g_assert_cmpuint (out.arg_info_battery_level, ==, 0);
+    qmi_message_unref (message);
+
+    g_byte_array_unref (array);
+}
+
+#endif /* QMI_SERVICE_DMS_SUPPORTED */
+
+/*****************************************************************************/
+
 static void
 test_message_new_request (void)
 {
@@ -356,6 +576,31 @@ test_message_new_response_error (void)
     qmi_message_unref (response);
 }
 
+static void
+test_message_get_result_code (void)
+{
+    QmiMessage *request;
+    QmiMessage *response;
+
+    request = qmi_message_new (QMI_SERVICE_DMS, 0x01, 0x02, 0xFFFF);
+    g_assert (request);
+
+    /* Requests have no result */
+    g_assert_cmpuint (qmi_message_get_result_code (request), ==, QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE);
+
+    response = qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+    g_assert (response);
+    g_assert_cmpuint (qmi_message_get_result_code (response), ==, QMI_PROTOCOL_ERROR_NONE);
+    qmi_message_unref (response);
+
+    response = qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NO_EFFECT);
+    g_assert (response);
+    g_assert_cmpuint (qmi_message_get_result_code (response), ==, QMI_PROTOCOL_ERROR_NO_EFFECT);
+    qmi_message_unref (response);
+
+    qmi_message_unref (request);
+}
+
 /*****************************************************************************/
 
 static void
@@ -1503,6 +1748,176 @@ test_message_set_transaction_id_services (void)
 
 /*****************************************************************************/
 
+static void
+test_message_tlv_lookup (void)
+{
+    GByteArray   *buffer;
+    QmiMessage   *message;
+    GError       *error = NULL;
+    const guint8 *raw;
+    guint16       raw_length = 0;
+    gsize         offset;
+    gsize         value_offset = 0;
+    guint8        value;
+    guint8        added[] = { 0xEE };
+    guint8        dms_message[] = {
+        0x01, 0x19, 0x00, 0x00, 0x02, 0x01, 0x02, 0x01, 0x00, 0x25, 0x00, 0x0D, 0x00,
+        0x01, 0x01, 0x00, 0xAA,       /* First TLV 0x01 */
+        0x02, 0x02, 0x00, 0xBB, 0xCC, /* TLV 0x02 */
+        0x01, 0x01, 0x00, 0xDD        /* Second TLV 0x01, never looked up */
+    };
+
+    buffer = g_byte_array_append (g_byte_array_sized_new (G_N_ELEMENTS (dms_message)), dms_message, G_N_ELEMENTS (dms_message));
+    message = qmi_message_new_from_raw (buffer, &error);
+    g_assert_no_error (error);
+    g_assert (message);
+
+    /* The first TLV of each type is the one found */
+    raw = qmi_message_get_raw_tlv (message, 0x01, &raw_length);
+    g_assert (raw);
+    g_assert_cmpuint (raw_length, ==, 1);
+    g_assert_cmpuint (raw[0], ==, 0xAA);
+
+    offset = qmi_message_tlv_read_init (message, 0x02, &raw_length, &error);
+    g_assert_no_error (error);
+    g_assert_cmpuint (offset, >, 0);
+    g_assert_cmpuint (raw_length, ==, 2);
+
+    g_assert (!qmi_message_get_raw_tlv (message, 0x10, &raw_length));
+    g_assert (!qmi_message_tlv_read_init (message, 0x10, NULL, &error));
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TLV_NOT_FOUND);
+    g_clear_error (&error);
+
+    /* TLVs added afterwards must be found as well */
+    g_assert (qmi_message_add_raw_tlv (message, 0x10, added, sizeof (added), &error));
+    g_assert_no_error (error);
+    raw = qmi_message_get_raw_tlv (message, 0x10, &raw_length);
+    g_assert (raw);
+    g_assert_cmpuint (raw_length, ==, 1);
+    g_assert_cmpuint (raw[0], ==, 0xEE);
+
+    offset = qmi_message_tlv_read_init (message, 0x01, NULL, &error);
+    g_assert_no_error (error);
+    g_assert (qmi_message_tlv_read_guint8 (message, offset, &value_offset, &value, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (value, ==, 0xAA);
+
+    qmi_message_unref (message);
+    g_byte_array_unref (buffer);
+}
+
+/*****************************************************************************/
+
+/* One DMS request (0x0001) with one enum TLV (0x01) */
+static const guint8 test_schema[] = {
+    /* header */
+    'Q', 'M', 'I', 'S', 'C', 'H', 'M', '\0',
+    0x01, 0x00, 0x00, 0x00, /* version */
+    0x01, 0x00, 0x00, 0x00, /* n_services */
+    0x20, 0x00, 0x00, 0x00, /* services */
+    0x84, 0x00, 0x00, 0x00, /* strings */
+    0x16, 0x00, 0x00, 0x00, /* strings size */
+    0x00, 0x00, 0x00, 0x00,
+    /* service */
+    0x02, 0x00, 0x00, 0x00, /* DMS */
+    0x01, 0x00, 0x00, 0x00, /* "dms" */
+    0x01, 0x00, 0x00, 0x00, /* n_messages */
+    0x30, 0x00, 0x00, 0x00, /* messages */
+    /* message */
+    0x01, 0x00, 0x00, 0x00, /* id, vendor */
+    0x00, 0x00, 0x00, 0x00, /* request/response */
+    0x05, 0x00, 0x00, 0x00, /* "Test" */
+    0x01, 0x00, 0x00, 0x00, /* n_input_tlvs, n_output_tlvs */
+    0x48, 0x00, 0x00, 0x00, /* input TLVs */
+    0x00, 0x00, 0x00, 0x00, /* output TLVs */
+    /* TLV */
+    0x01, 0x00, 0x00, 0x00, /* type */
+    0x0A, 0x00, 0x00, 0x00, /* "Mode" */
+    0x54, 0x00, 0x00, 0x00, /* field */
+    /* field */
+    0x04, 0x00, 0x01, 0x00, /* enum, 1 byte */
+    0x00, 0x00, 0x00, 0x00, /* length, n_members */
+    0x00, 0x00, 0x00, 0x00, /* "" */
+    0x6C, 0x00, 0x00, 0x00, /* values */
+    0x00, 0x00, 0x00, 0x00, /* members */
+    0x00, 0x00, 0x00, 0x00,
+    /* values */
+    0x01, 0x00, 0x00, 0x00, /* n_values */
+    0x00, 0x00, 0x00, 0x00,
+    0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x0F, 0x00, 0x00, 0x00, /* "online" */
+    0x00, 0x00, 0x00, 0x00,
+    /* strings */
+    '\0', 'd', 'm', 's', '\0', 'T', 'e', 's', 't', '\0', 'M', 'o', 'd', 'e', '\0',
+    'o', 'n', 'l', 'i', 'n', 'e', '\0'
+};
+
+static void
+test_message_schema (void)
+{
+    GBytes      *bytes;
+    QmiSchema   *schema;
+    QmiMessage  *self;
+    GError      *error = NULL;
+    gsize        init_offset;
+    gboolean     ret;
+    gchar       *printable;
+
+    bytes = g_bytes_new_static (test_schema, sizeof (test_schema));
+    schema = qmi_schema_new_from_bytes (bytes, &error);
+    g_assert_no_error (error);
+    g_assert (schema);
+    g_bytes_unref (bytes);
+
+    self = qmi_message_new (QMI_SERVICE_DMS, 0x01, 0x02, 0x0001);
+    init_offset = qmi_message_tlv_write_init (self, 0x01, &error);
+    g_assert_no_error (error);
+    ret = qmi_message_tlv_write_guint8 (self, 0x03, &error);
+    g_assert_no_error (error);
+    g_assert (ret);
+    ret = qmi_message_tlv_write_complete (self, init_offset, &error);
+    g_assert_no_error (error);
+    g_assert (ret);
+
+    g_assert_cmpstr (qmi_schema_get_message_name (schema, self, NULL), ==, "Test");
+    printable = qmi_schema_get_printable (schema, self, NULL, "");
+    g_assert (strstr (printable, "message     = \"Test\" (0x0001)") != NULL);
+    g_assert (strstr (printable, "type       = \"Mode\" (0x01)") != NULL);
+    g_assert (strstr (printable, "translated = online") != NULL);
+    g_free (printable);
+    qmi_message_unref (self);
+
+    /* Unknown to the schema */
+    self = qmi_message_new (QMI_SERVICE_DMS, 0x01, 0x02, 0x0002);
+    g_assert (qmi_schema_get_message_name (schema, self, NULL) == NULL);
+    qmi_message_unref (self);
+
+    qmi_schema_unref (schema);
+}
+
+static void
+test_message_schema_truncated (void)
+{
+    gsize i;
+
+    /* Every offset points somewhere in the file, so any truncation must be
+     * rejected when loading */
+    for (i = 0; i < sizeof (test_schema); i++) {
+        GBytes    *bytes;
+        QmiSchema *schema;
+        GError    *error = NULL;
+
+        bytes = g_bytes_new_static (test_schema, i);
+        schema = qmi_schema_new_from_bytes (bytes, &error);
+        g_assert (error);
+        g_assert (!schema);
+        g_error_free (error);
+        g_bytes_unref (bytes);
+    }
+}
+
+/*****************************************************************************/
+
 int main (int argc, char **argv)
 {
     g_test_init (&argc, &argv, NULL);
@@ -1513,10 +1928,18 @@ int main (int argc, char **argv)
     g_test_add_func ("/libqmi-glib/message/parse/complete-and-complete", test_message_parse_complete_and_complete);
     g_test_add_func ("/libqmi-glib/message/parse/wrong-tlv",             test_message_parse_wrong_tlv);
     g_test_add_func ("/libqmi-glib/message/parse/missing-size",          test_message_parse_missing_size);
+    g_test_add_func ("/libqmi-glib/message/parse/frame-iter",            test_message_frame_iter);
+
+#if QMI_SERVICE_DMS_SUPPORTED
+    g_test_add_func ("/libqmi-glib/message/json",       test_message_json);
+    g_test_add_func ("/libqmi-glib/message/validate",   test_message_validate);
+    g_test_add_func ("/libqmi-glib/message/parse-into", test_message_parse_into);
+#endif
 
     g_test_add_func ("/libqmi-glib/message/new/request",        test_message_new_request);
     g_test_add_func ("/libqmi-glib/message/new/response/ok",    test_message_new_response_ok);
     g_test_add_func ("/libqmi-glib/message/new/response/error", test_message_new_response_error);
+    g_test_add_func ("/libqmi-glib/message/get-result-code",    test_message_get_result_code);
 
     g_test_add_func ("/libqmi-glib/message/tlv-write/empty",           test_message_tlv_write_empty);
     g_test_add_func ("/libqmi-glib/message/tlv-write/reset",           test_message_tlv_write_reset);
@@ -1534,5 +1957,10 @@ int main (int argc, char **argv)
     g_test_add_func ("/libqmi-glib/message/set-transaction-id/ctl",      test_message_set_transaction_id_ctl);
     g_test_add_func ("/libqmi-glib/message/set-transaction-id/services", test_message_set_transaction_id_services);
 
+    g_test_add_func ("/libqmi-glib/message/tlv-lookup", test_message_tlv_lookup);
+
+    g_test_add_func ("/libqmi-glib/message/schema",           test_message_schema);
+    g_test_add_func ("/libqmi-glib/message/schema/truncated", test_message_schema_truncated);
+
     return g_test_run ();
 }
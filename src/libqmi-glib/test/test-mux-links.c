@@ -0,0 +1,277 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "qmi-mux-links.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+#define WWAN_IFACE "wwan0"
+
+/*****************************************************************************/
+/* Fake sysfs tree of network interfaces */
+
+static void
+sysfs_write (const gchar *sysfs_net_path,
+             const gchar *relative_path,
+             const gchar *contents)
+{
+    gchar *path;
+    gchar *dirname;
+
+    path = g_build_filename (sysfs_net_path, relative_path, NULL);
+    dirname = g_path_get_dirname (path);
+    g_assert_cmpint (g_mkdir_with_parents (dirname, 0755), ==, 0);
+    g_assert (g_file_set_contents (path, contents, -1, NULL));
+    g_free (dirname);
+    g_free (path);
+}
+
+static gchar *
+sysfs_read (const gchar *sysfs_net_path,
+            const gchar *relative_path)
+{
+    gchar *path;
+    gchar *contents = NULL;
+
+    path = g_build_filename (sysfs_net_path, relative_path, NULL);
+    g_assert (g_file_get_contents (path, &contents, NULL, NULL));
+    g_free (path);
+    return contents;
+}
+
+static void
+sysfs_add_link (const gchar *sysfs_net_path,
+                const gchar *ifname,
+                guint8       mux_id)
+{
+    gchar *relative_path;
+    gchar *contents;
+
+    relative_path = g_strdup_printf (WWAN_IFACE "/upper_%s", ifname);
+    sysfs_write (sysfs_net_path, relative_path, "");
+    g_free (relative_path);
+
+    /* As printed by qmi_wwan */
+    relative_path = g_strdup_printf ("%s/qmap/mux_id", ifname);
+    contents = g_strdup_printf ("0x%02x\n", mux_id);
+    sysfs_write (sysfs_net_path, relative_path, contents);
+    g_free (contents);
+    g_free (relative_path);
+}
+
+static gchar *
+sysfs_new (void)
+{
+    gchar *sysfs_net_path;
+
+    sysfs_net_path = g_dir_make_tmp ("test-mux-links-XXXXXX", NULL);
+    g_assert (sysfs_net_path);
+
+    sysfs_write (sysfs_net_path, WWAN_IFACE "/qmi/add_mux", "");
+    sysfs_write (sysfs_net_path, WWAN_IFACE "/qmi/del_mux", "");
+    /* Upper devices without mux ID are not links */
+    sysfs_write (sysfs_net_path, WWAN_IFACE "/upper_br0", "");
+    sysfs_add_link (sysfs_net_path, "qmimux1", 3);
+    sysfs_add_link (sysfs_net_path, "qmimux0", 1);
+    return sysfs_net_path;
+}
+
+static void
+sysfs_remove (const gchar *path)
+{
+    GDir        *dir;
+    const gchar *name;
+
+    dir = g_dir_open (path, 0, NULL);
+    if (dir) {
+        while ((name = g_dir_read_name (dir))) {
+            gchar *child;
+
+            child = g_build_filename (path, name, NULL);
+            sysfs_remove (child);
+            g_free (child);
+        }
+        g_dir_close (dir);
+    }
+    g_assert_cmpint (g_remove (path), ==, 0);
+}
+
+static void
+assert_links (GArray      *links,
+              const gchar *expected)
+{
+    GString *str;
+    guint    i;
+
+    str = g_string_new ("");
+    for (i = 0; i < links->len; i++) {
+        QmiDeviceMuxLink *link;
+
+        link = &g_array_index (links, QmiDeviceMuxLink, i);
+        g_string_append_printf (str, "%s%s:%u", i ? "," : "", link->ifname, link->mux_id);
+    }
+    g_assert_cmpstr (str->str, ==, expected);
+    g_string_free (str, TRUE);
+}
+
+/*****************************************************************************/
+
+static void
+test_mux_links_list (void)
+{
+    gchar  *sysfs_net_path;
+    GArray *links;
+    GError *error = NULL;
+
+    sysfs_net_path = sysfs_new ();
+
+    /* Sorted by mux ID, and only the upper devices with one */
+    links = __qmi_mux_links_list (sysfs_net_path, "test", WWAN_IFACE, &error);
+    g_assert_no_error (error);
+    assert_links (links, "qmimux0:1,qmimux1:3");
+    g_array_unref (links);
+
+    /* Not a network interface */
+    links = __qmi_mux_links_list (sysfs_net_path, "test", "wwan1", &error);
+    g_assert_error (error, G_FILE_ERROR, G_FILE_ERROR_NOENT);
+    g_assert (!links);
+    g_clear_error (&error);
+
+    sysfs_remove (sysfs_net_path);
+    g_free (sysfs_net_path);
+}
+
+static void
+test_mux_links_add_existing (void)
+{
+    gchar  *sysfs_net_path;
+    gchar  *ifname;
+    gchar  *contents;
+    GArray *links;
+    GError *error = NULL;
+
+    sysfs_net_path = sysfs_new ();
+
+    /* The cached name is reused without looking up the links */
+    ifname = __qmi_mux_link_add (sysfs_net_path, "test", WWAN_IFACE, 3, "qmimux1", &links, &error);
+    g_assert_no_error (error);
+    g_assert_cmpstr (ifname, ==, "qmimux1");
+    g_assert (!links);
+    g_free (ifname);
+
+    /* A cached name which is now the link of another mux ID is not */
+    ifname = __qmi_mux_link_add (sysfs_net_path, "test", WWAN_IFACE, 3, "qmimux0", &links, &error);
+    g_assert_no_error (error);
+    g_assert_cmpstr (ifname, ==, "qmimux1");
+    assert_links (links, "qmimux0:1,qmimux1:3");
+    g_array_unref (links);
+    g_free (ifname);
+
+    /* Nor one which isn't a link of the WWAN iface any more */
+    ifname = __qmi_mux_link_add (sysfs_net_path, "test", WWAN_IFACE, 1, "qmimux7", NULL, &error);
+    g_assert_no_error (error);
+    g_assert_cmpstr (ifname, ==, "qmimux0");
+    g_free (ifname);
+
+    /* In none of the cases a new link was requested */
+    contents = sysfs_read (sysfs_net_path, WWAN_IFACE "/qmi/add_mux");
+    g_assert_cmpstr (contents, ==, "");
+    g_free (contents);
+
+    sysfs_remove (sysfs_net_path);
+    g_free (sysfs_net_path);
+}
+
+static void
+test_mux_links_add_new (void)
+{
+    gchar  *sysfs_net_path;
+    gchar  *ifname;
+    gchar  *contents;
+    GArray *links = NULL;
+    GError *error = NULL;
+
+    sysfs_net_path = sysfs_new ();
+
+    /* The mux ID is requested to the driver, but no link shows up */
+    ifname = __qmi_mux_link_add (sysfs_net_path, "test", WWAN_IFACE, 5, NULL, &links, &error);
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED);
+    g_assert (!ifname);
+    g_assert (!links);
+    g_clear_error (&error);
+    contents = sysfs_read (sysfs_net_path, WWAN_IFACE "/qmi/add_mux");
+    g_assert_cmpstr (contents, ==, "5");
+    g_free (contents);
+
+    /* The driver doesn't support adding links */
+    sysfs_remove (sysfs_net_path);
+    g_mkdir_with_parents (sysfs_net_path, 0755);
+    sysfs_write (sysfs_net_path, WWAN_IFACE "/qmi/raw_ip", "Y\n");
+    ifname = __qmi_mux_link_add (sysfs_net_path, "test", WWAN_IFACE, 5, NULL, &links, &error);
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+    g_assert (g_str_has_prefix (error->message, "Link not created: "));
+    g_assert (!ifname);
+    g_assert (!links);
+    g_clear_error (&error);
+
+    sysfs_remove (sysfs_net_path);
+    g_free (sysfs_net_path);
+}
+
+static void
+test_mux_links_delete (void)
+{
+    gchar  *sysfs_net_path;
+    gchar  *contents;
+    GArray *links;
+    GError *error = NULL;
+
+    sysfs_net_path = sysfs_new ();
+
+    /* Without a link there is nothing to delete */
+    g_assert (__qmi_mux_link_delete (sysfs_net_path, "test", WWAN_IFACE, 7, &links, &error));
+    g_assert_no_error (error);
+    assert_links (links, "qmimux0:1,qmimux1:3");
+    g_array_unref (links);
+    contents = sysfs_read (sysfs_net_path, WWAN_IFACE "/qmi/del_mux");
+    g_assert_cmpstr (contents, ==, "");
+    g_free (contents);
+
+    g_assert (__qmi_mux_link_delete (sysfs_net_path, "test", WWAN_IFACE, 3, NULL, &error));
+    g_assert_no_error (error);
+    contents = sysfs_read (sysfs_net_path, WWAN_IFACE "/qmi/del_mux");
+    g_assert_cmpstr (contents, ==, "3");
+    g_free (contents);
+
+    sysfs_remove (sysfs_net_path);
+    g_free (sysfs_net_path);
+}
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/libqmi-glib/mux-links/list",         test_mux_links_list);
+    g_test_add_func ("/libqmi-glib/mux-links/add-existing", test_mux_links_add_existing);
+    g_test_add_func ("/libqmi-glib/mux-links/add-new",      test_mux_links_add_new);
+    g_test_add_func ("/libqmi-glib/mux-links/delete",       test_mux_links_delete);
+
+    return g_test_run ();
+}
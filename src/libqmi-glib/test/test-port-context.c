@@ -15,13 +15,22 @@
  * Higly based on the test-port-context setup in ModemManager.
  */
 
+#define _GNU_SOURCE
 #include <config.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
 
+#include <glib-unix.h>
 #include <gio/gio.h>
 #include <gio/gunixsocketaddress.h>
+#include <gio/gunixinputstream.h>
+#include <gio/gunixoutputstream.h>
 #include <libqmi-glib.h>
 
 #include "test-port-context.h"
@@ -34,12 +43,17 @@ struct _TestPortContext {
     gboolean ready;
     GCond ready_cond;
     GMutex ready_mutex;
+    GMainContext *context;
     GMainLoop *loop;
     GSocketService *socket_service;
+    gint pty_master;
+    gint pty_slave;
     GList *clients;
     GMutex command_mutex;
     GByteArray *command;
     GByteArray *response;
+    TestPortContextResponderFn responder;
+    gpointer responder_data;
 };
 
 /*****************************************************************************/
@@ -102,9 +116,25 @@ test_port_context_set_command (TestPortContext *ctx,
     g_mutex_unlock (&ctx->command_mutex);
 }
 
-static GByteArray *
-process_next_command (TestPortContext *ctx,
-                      GByteArray      *buffer)
+void
+test_port_context_set_responder (TestPortContext            *ctx,
+                                 TestPortContextResponderFn  responder,
+                                 gpointer                    user_data)
+{
+    g_mutex_lock (&ctx->command_mutex);
+    {
+        ctx->responder = responder;
+        ctx->responder_data = user_data;
+    }
+    g_mutex_unlock (&ctx->command_mutex);
+}
+
+/* Returns FALSE if there is no full message in the buffer; otherwise, the
+ * response is given, if any */
+static gboolean
+process_next_command (TestPortContext  *ctx,
+                      GByteArray       *buffer,
+                      GByteArray      **out_response)
 {
     QmiMessage   *message;
     GError       *error = NULL;
@@ -121,11 +151,13 @@ process_next_command (TestPortContext *ctx,
     if (buffer->len > 0 && buffer->data[0] != QMI_MESSAGE_QMUX_MARKER)
         g_assert_not_reached ();
 
+    *out_response = NULL;
+
     message = qmi_message_new_from_raw (buffer, &error);
     if (!message) {
         if (!error)
             /* More data we need */
-            return NULL;
+            return FALSE;
         /* Fail */
         g_assert_no_error (error);
     }
@@ -135,6 +167,23 @@ process_next_command (TestPortContext *ctx,
     g_assert_no_error (error);
     g_assert (message_raw);
 
+    /* If no explicit command expected, let the responder build the response
+     * for whatever we got */
+    g_mutex_lock (&ctx->command_mutex);
+    if (!ctx->command && ctx->responder) {
+        TestPortContextResponderFn  responder;
+        gpointer                    responder_data;
+
+        responder = ctx->responder;
+        responder_data = ctx->responder_data;
+        g_mutex_unlock (&ctx->command_mutex);
+
+        *out_response = responder (ctx, message, responder_data);
+        qmi_message_unref (message);
+        return TRUE;
+    }
+    g_mutex_unlock (&ctx->command_mutex);
+
     /* Get printables to compare (we'll just get a nicer error if they are
      * different), compared to a simple memcmp(). */
     g_mutex_lock (&ctx->command_mutex);
@@ -160,7 +209,8 @@ process_next_command (TestPortContext *ctx,
     }
     g_mutex_unlock (&ctx->command_mutex);
 
-    return response;
+    *out_response = response;
+    return TRUE;
 }
 
 /*****************************************************************************/
@@ -168,6 +218,8 @@ process_next_command (TestPortContext *ctx,
 typedef struct {
     TestPortContext *ctx;
     GSocketConnection *connection;
+    GInputStream *istream;
+    GOutputStream *ostream;
     GSource *connection_readable_source;
     GByteArray *buffer;
 } Client;
@@ -177,10 +229,13 @@ client_free (Client *client)
 {
     g_source_destroy (client->connection_readable_source);
     g_source_unref (client->connection_readable_source);
-    g_output_stream_close (g_io_stream_get_output_stream (G_IO_STREAM (client->connection)), NULL, NULL);
+    g_output_stream_close (client->ostream, NULL, NULL);
     if (client->buffer)
         g_byte_array_unref (client->buffer);
-    g_object_unref (client->connection);
+    g_object_unref (client->istream);
+    g_object_unref (client->ostream);
+    if (client->connection)
+        g_object_unref (client->connection);
     g_slice_free (Client, client);
 }
 
@@ -196,12 +251,11 @@ client_parse_request (Client *client)
 {
     GByteArray *response;
 
-    do {
-        response = process_next_command (client->ctx, client->buffer);
+    while (process_next_command (client->ctx, client->buffer, &response)) {
         if (response) {
             GError *error = NULL;
 
-            if (!g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (client->connection)),
+            if (!g_output_stream_write_all (client->ostream,
                                             response->data,
                                             response->len,
                                             NULL, /* bytes_written */
@@ -212,13 +266,12 @@ client_parse_request (Client *client)
             }
             g_byte_array_unref (response);
         }
-    } while (response);
+    }
 }
 
 static gboolean
-connection_readable_cb (GSocket *socket,
-                        GIOCondition condition,
-                        Client *client)
+client_readable (Client *client,
+                 GIOCondition condition)
 {
     guint8 buffer[BUFFER_SIZE];
     GError *error = NULL;
@@ -233,7 +286,7 @@ connection_readable_cb (GSocket *socket,
     if (!(condition & G_IO_IN || condition & G_IO_PRI))
         return TRUE;
 
-    r = g_input_stream_read (g_io_stream_get_input_stream (G_IO_STREAM (client->connection)),
+    r = g_input_stream_read (client->istream,
                              buffer,
                              BUFFER_SIZE,
                              NULL,
@@ -262,6 +315,22 @@ connection_readable_cb (GSocket *socket,
     return TRUE;
 }
 
+static gboolean
+connection_readable_cb (GSocket *socket,
+                        GIOCondition condition,
+                        Client *client)
+{
+    return client_readable (client, condition);
+}
+
+static gboolean
+pty_readable_cb (gint fd,
+                 GIOCondition condition,
+                 Client *client)
+{
+    return client_readable (client, condition);
+}
+
 static Client *
 client_new (TestPortContext *ctx,
             GSocketConnection *connection)
@@ -271,6 +340,8 @@ client_new (TestPortContext *ctx,
     client = g_slice_new0 (Client);
     client->ctx = ctx;
     client->connection = g_object_ref (connection);
+    client->istream = g_object_ref (g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+    client->ostream = g_object_ref (g_io_stream_get_output_stream (G_IO_STREAM (connection)));
     client->connection_readable_source = g_socket_create_source (g_socket_connection_get_socket (client->connection),
                                                                  G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP,
                                                                  NULL);
@@ -283,6 +354,26 @@ client_new (TestPortContext *ctx,
     return client;
 }
 
+static Client *
+client_new_pty (TestPortContext *ctx)
+{
+    Client *client;
+
+    /* The pty master is owned by the context, not by the streams */
+    client = g_slice_new0 (Client);
+    client->ctx = ctx;
+    client->istream = g_unix_input_stream_new (ctx->pty_master, FALSE);
+    client->ostream = g_unix_output_stream_new (ctx->pty_master, FALSE);
+    client->connection_readable_source = g_unix_fd_source_new (ctx->pty_master, G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP);
+    g_source_set_callback (client->connection_readable_source,
+                           (GSourceFunc)pty_readable_cb,
+                           client,
+                           NULL);
+    g_source_attach (client->connection_readable_source, g_main_context_get_thread_default ());
+
+    return client;
+}
+
 /* /\*****************************************************************************\/ */
 
 static void
@@ -342,12 +433,6 @@ create_socket_service (TestPortContext *ctx)
     /* And store it */
     ctx->socket_service = service;
 
-    /* Signal that the thread is ready */
-    g_mutex_lock (&ctx->ready_mutex);
-    ctx->ready = TRUE;
-    g_cond_signal (&ctx->ready_cond);
-    g_mutex_unlock (&ctx->ready_mutex);
-
     if (socket)
         g_object_unref (socket);
     if (address)
@@ -356,6 +441,54 @@ create_socket_service (TestPortContext *ctx)
 
 /*****************************************************************************/
 
+void
+test_port_context_write (TestPortContext *ctx,
+                         const guint8    *data,
+                         gsize            data_size)
+{
+    GList *l;
+
+    g_assert (g_main_context_is_owner (ctx->context));
+
+    for (l = ctx->clients; l; l = g_list_next (l)) {
+        Client *client = l->data;
+        GError *error = NULL;
+
+        if (!g_output_stream_write_all (client->ostream, data, data_size, NULL, NULL, &error)) {
+            g_warning ("Cannot write to client: %s", error->message);
+            g_error_free (error);
+        }
+    }
+}
+
+void
+test_port_context_close_clients (TestPortContext *ctx)
+{
+    GList *l;
+
+    g_assert (g_main_context_is_owner (ctx->context));
+
+    for (l = ctx->clients; l; l = g_list_next (l)) {
+        Client *client = l->data;
+
+        if (client->connection)
+            g_io_stream_close (G_IO_STREAM (client->connection), NULL, NULL);
+    }
+    g_list_free_full (ctx->clients, (GDestroyNotify)client_free);
+    ctx->clients = NULL;
+}
+
+void
+test_port_context_invoke (TestPortContext *ctx,
+                          GSourceFunc      func,
+                          gpointer         user_data)
+{
+    g_assert (ctx->context != NULL);
+    g_main_context_invoke (ctx->context, func, user_data);
+}
+
+/*****************************************************************************/
+
 void
 test_port_context_stop (TestPortContext *ctx)
 {
@@ -375,8 +508,18 @@ port_context_thread_func (TestPortContext *ctx)
 
     thread_context = g_main_context_new ();
     g_main_context_push_thread_default (thread_context);
+    ctx->context = thread_context;
 
-    create_socket_service (ctx);
+    if (ctx->pty_master >= 0)
+        ctx->clients = g_list_append (ctx->clients, client_new_pty (ctx));
+    else
+        create_socket_service (ctx);
+
+    /* Signal that the thread is ready */
+    g_mutex_lock (&ctx->ready_mutex);
+    ctx->ready = TRUE;
+    g_cond_signal (&ctx->ready_cond);
+    g_mutex_unlock (&ctx->ready_mutex);
 
     g_assert (ctx->loop == NULL);
     ctx->loop = g_main_loop_new (g_main_context_get_thread_default (), FALSE);
@@ -420,6 +563,12 @@ test_port_context_free (TestPortContext *ctx)
             g_socket_service_stop (ctx->socket_service);
         g_object_unref (ctx->socket_service);
     }
+    if (ctx->pty_slave >= 0)
+        close (ctx->pty_slave);
+    if (ctx->pty_master >= 0)
+        close (ctx->pty_master);
+    if (ctx->context)
+        g_main_context_unref (ctx->context);
     g_free (ctx->name);
     if (ctx->command)
         g_byte_array_unref (ctx->command);
@@ -435,8 +584,44 @@ test_port_context_new (const gchar *name)
 
     ctx = g_slice_new0 (TestPortContext);
     ctx->name = g_strdup (name);
+    ctx->pty_master = -1;
+    ctx->pty_slave = -1;
     g_cond_init (&ctx->ready_cond);
     g_mutex_init (&ctx->ready_mutex);
     g_mutex_init (&ctx->command_mutex);
     return ctx;
 }
+
+TestPortContext *
+test_port_context_new_pty (void)
+{
+    TestPortContext *ctx;
+    struct termios   options;
+    const gchar     *slave_name;
+    gint             master;
+
+    master = posix_openpt (O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt (master) < 0 || unlockpt (master) < 0 || !(slave_name = ptsname (master)))
+        g_error ("Cannot create pseudo terminal: %s", g_strerror (errno));
+
+    ctx = test_port_context_new (slave_name);
+    ctx->pty_master = master;
+
+    /* Keep the slave always open, so that the master never reports a hangup
+     * while no one else has it open, and don't allow any kind of processing
+     * of the data between both ends */
+    ctx->pty_slave = open (slave_name, O_RDWR | O_NOCTTY);
+    if (ctx->pty_slave < 0 || tcgetattr (ctx->pty_slave, &options) < 0)
+        g_error ("Cannot open pseudo terminal '%s': %s", slave_name, g_strerror (errno));
+    cfmakeraw (&options);
+    if (tcsetattr (ctx->pty_slave, TCSANOW, &options) < 0)
+        g_error ("Cannot setup pseudo terminal '%s': %s", slave_name, g_strerror (errno));
+
+    return ctx;
+}
+
+const gchar *
+test_port_context_get_name (TestPortContext *ctx)
+{
+    return ctx->name;
+}
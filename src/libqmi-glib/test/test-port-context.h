@@ -23,7 +23,16 @@
 
 typedef struct _TestPortContext TestPortContext;
 
+/* Builds the response to a request for which no explicit command was set,
+ * run in the port thread; or returns NULL to leave the request unanswered,
+ * e.g. to answer it later with test_port_context_write() */
+typedef GByteArray * (* TestPortContextResponderFn) (TestPortContext *ctx,
+                                                     GByteArray      *request,
+                                                     gpointer         user_data);
+
 TestPortContext *test_port_context_new           (const gchar     *name);
+TestPortContext *test_port_context_new_pty       (void);
+const gchar     *test_port_context_get_name      (TestPortContext *ctx);
 void             test_port_context_start         (TestPortContext *ctx);
 void             test_port_context_stop          (TestPortContext *ctx);
 void             test_port_context_free          (TestPortContext *ctx);
@@ -33,5 +42,15 @@ void             test_port_context_set_command   (TestPortContext *ctx,
                                                   const guint8    *response,
                                                   gsize            response_size,
                                                   guint16          transaction_id);
+void             test_port_context_set_responder (TestPortContext *ctx,
+                                                  TestPortContextResponderFn responder,
+                                                  gpointer         user_data);
+void             test_port_context_invoke        (TestPortContext *ctx,
+                                                  GSourceFunc      func,
+                                                  gpointer         user_data);
+void             test_port_context_write         (TestPortContext *ctx,
+                                                  const guint8    *data,
+                                                  gsize            data_size);
+void             test_port_context_close_clients (TestPortContext *ctx);
 
 #endif /* TEST_PORT_CONTEXT_H */
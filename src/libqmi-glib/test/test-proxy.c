@@ -0,0 +1,862 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+/*
+ * Proxy tests: a QmiProxy runs in this same process, listening in its own
+ * abstract socket so that it doesn't clash with any proxy running in the
+ * system, and the devices it opens are simulated modems in pseudo-terminals.
+ * Clients connect to it with regular QmiDevice objects in proxy mode.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <unistd.h>
+#include <gio/gunixsocketaddress.h>
+#include <libqmi-glib.h>
+
+#include "test-port-context.h"
+
+#define N_MODEMS 2
+
+/*****************************************************************************/
+/* Simulated modem */
+
+typedef struct {
+    TestPortContext *port;
+
+    /* Only used in the simulated modem thread */
+    guint8           next_cid;
+
+    /* Shared with the test */
+    GMutex           mutex;
+    gboolean         hold;
+    guint16          hold_ctl_message_id;
+    GPtrArray       *held;
+    GArray          *received;
+} Modem;
+
+static GByteArray *
+modem_respond (TestPortContext *port,
+               GByteArray      *request_raw,
+               Modem           *modem)
+{
+    QmiMessage *request = (QmiMessage *) request_raw;
+    QmiMessage *response;
+    gsize       init_offset;
+    gsize       offset = 0;
+    guint8      service;
+    guint8      cid;
+
+    /* Service requests are recorded by client id, and held if requested */
+    if (qmi_message_get_service (request) != QMI_SERVICE_CTL) {
+        cid = qmi_message_get_client_id (request);
+        g_mutex_lock (&modem->mutex);
+        g_array_append_val (modem->received, cid);
+        if (modem->hold) {
+            g_ptr_array_add (modem->held, g_byte_array_ref (request_raw));
+            g_mutex_unlock (&modem->mutex);
+            return NULL;
+        }
+        g_mutex_unlock (&modem->mutex);
+        return qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+    }
+
+    g_mutex_lock (&modem->mutex);
+    if (modem->hold_ctl_message_id &&
+        qmi_message_get_message_id (request) == modem->hold_ctl_message_id) {
+        g_ptr_array_add (modem->held, g_byte_array_ref (request_raw));
+        g_mutex_unlock (&modem->mutex);
+        return NULL;
+    }
+    g_mutex_unlock (&modem->mutex);
+
+    response = qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+    switch (qmi_message_get_message_id (request)) {
+    case 0x0022: /* Allocate CID */
+        init_offset = qmi_message_tlv_read_init (request, 0x01, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint8 (request, init_offset, &offset, &service, NULL));
+        if (++modem->next_cid == QMI_CID_BROADCAST)
+            modem->next_cid = 1;
+        cid = modem->next_cid;
+        break;
+    case 0x0023: /* Release CID */
+        init_offset = qmi_message_tlv_read_init (request, 0x01, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint8 (request, init_offset, &offset, &service, NULL));
+        g_assert (qmi_message_tlv_read_guint8 (request, init_offset, &offset, &cid, NULL));
+        break;
+    default:
+        return response;
+    }
+
+    init_offset = qmi_message_tlv_write_init (response, 0x01, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_guint8 (response, service, NULL));
+    g_assert (qmi_message_tlv_write_guint8 (response, cid, NULL));
+    g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+    return response;
+}
+
+static void
+modem_init (Modem *modem)
+{
+    memset (modem, 0, sizeof (Modem));
+    g_mutex_init (&modem->mutex);
+    modem->held = g_ptr_array_new_with_free_func ((GDestroyNotify) g_byte_array_unref);
+    modem->received = g_array_new (FALSE, FALSE, sizeof (guint8));
+    modem->port = test_port_context_new_pty ();
+    test_port_context_set_responder (modem->port, (TestPortContextResponderFn) modem_respond, modem);
+    test_port_context_start (modem->port);
+}
+
+static void
+modem_clear (Modem *modem)
+{
+    test_port_context_stop (modem->port);
+    test_port_context_free (modem->port);
+    g_ptr_array_unref (modem->held);
+    g_array_unref (modem->received);
+    g_mutex_clear (&modem->mutex);
+}
+
+static void
+modem_set_hold (Modem    *modem,
+                gboolean  hold)
+{
+    g_mutex_lock (&modem->mutex);
+    modem->hold = hold;
+    g_mutex_unlock (&modem->mutex);
+}
+
+static void
+modem_set_hold_ctl (Modem   *modem,
+                    guint16  message_id)
+{
+    g_mutex_lock (&modem->mutex);
+    modem->hold_ctl_message_id = message_id;
+    g_mutex_unlock (&modem->mutex);
+}
+
+static guint
+modem_get_n_held (Modem *modem)
+{
+    guint n;
+
+    g_mutex_lock (&modem->mutex);
+    n = modem->held->len;
+    g_mutex_unlock (&modem->mutex);
+    return n;
+}
+
+/* Run in the port thread. Held requests are answered in the reverse order,
+ * each response with the position of its request in TLV 0x01, so that the
+ * clients can tell whether they got the response to their own request */
+static gboolean
+modem_answer_held (Modem *modem)
+{
+    guint i;
+
+    g_mutex_lock (&modem->mutex);
+    for (i = modem->held->len; i > 0; i--) {
+        QmiMessage *response;
+        gsize       init_offset;
+
+        response = qmi_message_response_new (g_ptr_array_index (modem->held, i - 1), QMI_PROTOCOL_ERROR_NONE);
+        init_offset = qmi_message_tlv_write_init (response, 0x01, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_write_guint8 (response, (guint8) (i - 1), NULL));
+        g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+        test_port_context_write (modem->port, response->data, response->len);
+        qmi_message_unref (response);
+    }
+    g_ptr_array_set_size (modem->held, 0);
+    g_mutex_unlock (&modem->mutex);
+    return G_SOURCE_REMOVE;
+}
+
+static guint
+modem_get_n_received (Modem *modem)
+{
+    guint n;
+
+    g_mutex_lock (&modem->mutex);
+    n = modem->received->len;
+    g_mutex_unlock (&modem->mutex);
+    return n;
+}
+
+/* Run in the port thread */
+static gboolean
+modem_emit_indication (Modem *modem)
+{
+    QmiMessage *indication;
+
+    /* WDS Event Report, broadcast */
+    indication = qmi_message_new (QMI_SERVICE_WDS, QMI_CID_BROADCAST, 0, 0x0001);
+    ((GByteArray *) indication)->data[6] |= 0x04;
+    test_port_context_write (modem->port, indication->data, indication->len);
+    qmi_message_unref (indication);
+    return G_SOURCE_REMOVE;
+}
+
+/*****************************************************************************/
+/* Proxy and its clients */
+
+typedef struct {
+    QmiProxy *proxy;
+    gchar    *proxy_path;
+    Modem     modems[N_MODEMS];
+} ProxyContext;
+
+static void
+async_ready (GObject       *source,
+             GAsyncResult  *res,
+             GAsyncResult **out)
+{
+    *out = g_object_ref (res);
+}
+
+/* Returns a full reference */
+static GAsyncResult *
+wait_async (GAsyncResult **res)
+{
+    while (!*res)
+        g_main_context_iteration (NULL, TRUE);
+    return *res;
+}
+
+/* Iterates the main context until the condition holds, or fails after a
+ * while */
+#define wait_until(condition) G_STMT_START {                            \
+        gint64 deadline;                                                \
+                                                                        \
+        deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;        \
+        while (!(condition)) {                                          \
+            g_assert_cmpint (g_get_monotonic_time (), <, deadline);     \
+            if (!g_main_context_iteration (NULL, FALSE))                \
+                g_usleep (1000);                                        \
+        }                                                               \
+    } G_STMT_END
+
+/* Fails if the proxy can't be created, e.g. if not running as root */
+static gboolean
+proxy_context_init (ProxyContext *ctx,
+                    gboolean      sharded)
+{
+    static guint    num = 0;
+    GSocket        *socket;
+    GSocketAddress *address;
+    GError         *error = NULL;
+    guint           i;
+
+    memset (ctx, 0, sizeof (ProxyContext));
+    ctx->proxy_path = g_strdup_printf ("qmi-proxy-test-%lu-%u", (gulong) getpid (), num++);
+
+    socket = g_socket_new (G_SOCKET_FAMILY_UNIX, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT, &error);
+    g_assert_no_error (error);
+    address = g_unix_socket_address_new_with_type (ctx->proxy_path, -1, G_UNIX_SOCKET_ADDRESS_ABSTRACT);
+    g_assert (g_socket_bind (socket, address, TRUE, &error));
+    g_assert_no_error (error);
+    g_assert (g_socket_listen (socket, &error));
+    g_assert_no_error (error);
+    g_object_unref (address);
+
+    ctx->proxy = qmi_proxy_new_with_socket (socket, sharded, &error);
+    g_object_unref (socket);
+    if (!ctx->proxy) {
+        g_test_message ("skipped, couldn't create proxy: %s", error->message);
+        g_error_free (error);
+        g_free (ctx->proxy_path);
+        return FALSE;
+    }
+
+    for (i = 0; i < N_MODEMS; i++)
+        modem_init (&ctx->modems[i]);
+    return TRUE;
+}
+
+static void
+proxy_context_clear (ProxyContext *ctx)
+{
+    guint i;
+
+    g_object_unref (ctx->proxy);
+    for (i = 0; i < N_MODEMS; i++)
+        modem_clear (&ctx->modems[i]);
+    g_free (ctx->proxy_path);
+}
+
+static QmiDevice *
+device_new (ProxyContext *ctx,
+            Modem        *modem)
+{
+    GAsyncResult *res = NULL;
+    GError       *error = NULL;
+    GFile        *file;
+    QmiDevice    *device;
+
+    file = g_file_new_for_path (test_port_context_get_name (modem->port));
+    g_async_initable_new_async (QMI_TYPE_DEVICE, G_PRIORITY_DEFAULT, NULL,
+                                (GAsyncReadyCallback) async_ready, &res,
+                                QMI_DEVICE_FILE,          file,
+                                QMI_DEVICE_NO_FILE_CHECK, TRUE,
+                                QMI_DEVICE_PROXY_PATH,    ctx->proxy_path,
+                                NULL);
+    g_object_unref (file);
+    device = qmi_device_new_finish (wait_async (&res), &error);
+    g_assert_no_error (error);
+    g_object_unref (res);
+    return device;
+}
+
+static QmiDevice *
+device_open (ProxyContext *ctx,
+             Modem        *modem)
+{
+    GAsyncResult *res = NULL;
+    GError       *error = NULL;
+    QmiDevice    *device;
+
+    device = device_new (ctx, modem);
+    qmi_device_open (device, QMI_DEVICE_OPEN_FLAGS_PROXY, 10, NULL,
+                     (GAsyncReadyCallback) async_ready, &res);
+    g_assert (qmi_device_open_finish (device, wait_async (&res), &error));
+    g_assert_no_error (error);
+    g_object_unref (res);
+    return device;
+}
+
+static void
+device_close (QmiDevice *device)
+{
+    GAsyncResult *res = NULL;
+    GError       *error = NULL;
+
+    qmi_device_close_async (device, 10, NULL,
+                            (GAsyncReadyCallback) async_ready, &res);
+    g_assert (qmi_device_close_finish (device, wait_async (&res), &error));
+    g_assert_no_error (error);
+    g_object_unref (res);
+    g_object_unref (device);
+}
+
+static QmiClient *
+allocate_client (QmiDevice  *device,
+                 QmiService  service)
+{
+    GAsyncResult *res = NULL;
+    GError       *error = NULL;
+    QmiClient    *client;
+
+    qmi_device_allocate_client (device, service, QMI_CID_NONE, 10, NULL,
+                                (GAsyncReadyCallback) async_ready, &res);
+    client = qmi_device_allocate_client_finish (device, wait_async (&res), &error);
+    g_assert_no_error (error);
+    g_assert (QMI_IS_CLIENT (client));
+    g_object_unref (res);
+    return client;
+}
+
+static void
+release_client (QmiDevice *device,
+                QmiClient *client)
+{
+    GAsyncResult *res = NULL;
+    GError       *error = NULL;
+
+    qmi_device_release_client (device, client,
+                               QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID, 10, NULL,
+                               (GAsyncReadyCallback) async_ready, &res);
+    g_assert (qmi_device_release_client_finish (device, wait_async (&res), &error));
+    g_assert_no_error (error);
+    g_object_unref (res);
+    g_object_unref (client);
+}
+
+/* A request with no TLVs, only answered with the result by the modem */
+static QmiMessage *
+client_build_request (QmiClient *client)
+{
+    return qmi_message_new (qmi_client_get_service (client),
+                            qmi_client_get_cid (client),
+                            qmi_client_get_next_transaction_id (client),
+                            0x0020);
+}
+
+static void
+client_send_request (QmiClient     *client,
+                     GAsyncResult **res)
+{
+    QmiMessage *request;
+
+    request = client_build_request (client);
+    qmi_device_command_full (QMI_DEVICE (qmi_client_peek_device (client)),
+                             request, NULL, 10, NULL,
+                             (GAsyncReadyCallback) async_ready, res);
+    qmi_message_unref (request);
+}
+
+/* Returns the result of the response */
+static QmiProtocolError
+client_wait_request (QmiClient     *client,
+                     GAsyncResult **res)
+{
+    QmiMessage       *response;
+    QmiProtocolError  status;
+    GError           *error = NULL;
+
+    response = qmi_device_command_full_finish (QMI_DEVICE (qmi_client_peek_device (client)),
+                                               wait_async (res), &error);
+    g_assert_no_error (error);
+    g_assert (response);
+    g_assert_cmpuint (qmi_message_get_client_id (response), ==, qmi_client_get_cid (client));
+    status = qmi_message_get_result_code (response);
+    qmi_message_unref (response);
+    g_clear_object (res);
+    return status;
+}
+
+/* A request with the given raw TLV data, and headers reporting its length, so
+ * that only the TLVs themselves may be malformed */
+static QmiMessage *
+client_build_raw_request (QmiClient    *client,
+                          const guint8 *tlvs,
+                          gsize         tlvs_len)
+{
+    GByteArray *request;
+
+    request = (GByteArray *) client_build_request (client);
+    g_byte_array_append (request, tlvs, tlvs_len);
+
+    /* QMUX length, and TLVs length in the QMI service header */
+    request->data[1] = (guint8) ((request->len - 1) & 0xFF);
+    request->data[2] = (guint8) ((request->len - 1) >> 8);
+    request->data[11] = (guint8) (tlvs_len & 0xFF);
+    request->data[12] = (guint8) (tlvs_len >> 8);
+    return (QmiMessage *) request;
+}
+
+static void
+client_request (QmiClient *client)
+{
+    GAsyncResult *res = NULL;
+
+    client_send_request (client, &res);
+    g_assert_cmpint (client_wait_request (client, &res), ==, QMI_PROTOCOL_ERROR_NONE);
+}
+
+static void
+wds_event_report_cb (QmiClientWds                      *wds,
+                     QmiIndicationWdsEventReportOutput *output,
+                     guint                             *n_indications)
+{
+    (*n_indications)++;
+}
+
+static guint
+proxy_get_device_n_clients (QmiProxy *proxy,
+                            Modem    *modem)
+{
+    GArray *stats;
+    guint   n_clients = 0;
+    guint   i;
+
+    stats = qmi_proxy_get_device_stats (proxy);
+    for (i = 0; i < stats->len; i++) {
+        QmiProxyDeviceStats *device_stats;
+
+        device_stats = &g_array_index (stats, QmiProxyDeviceStats, i);
+        if (g_str_equal (device_stats->device_path, test_port_context_get_name (modem->port)))
+            n_clients = device_stats->n_clients;
+    }
+    g_array_unref (stats);
+    return n_clients;
+}
+
+/*****************************************************************************/
+
+static void
+test_proxy_sharded (void)
+{
+    ProxyContext  ctx;
+    QmiDevice    *a1;
+    QmiDevice    *a2;
+    QmiDevice    *b1;
+    QmiClient    *wds_a1;
+    QmiClient    *wds_a2;
+    QmiClient    *wds_b1;
+    guint         n_indications_a1 = 0;
+    guint         n_indications_a2 = 0;
+    guint         n_indications_b1 = 0;
+
+    if (!proxy_context_init (&ctx, TRUE))
+        return;
+
+    /* Two clients of one modem and one of the other, each modem handled by
+     * its own shard */
+    a1 = device_open (&ctx, &ctx.modems[0]);
+    a2 = device_open (&ctx, &ctx.modems[0]);
+    b1 = device_open (&ctx, &ctx.modems[1]);
+    wds_a1 = allocate_client (a1, QMI_SERVICE_WDS);
+    wds_a2 = allocate_client (a2, QMI_SERVICE_WDS);
+    wds_b1 = allocate_client (b1, QMI_SERVICE_WDS);
+    g_signal_connect (wds_a1, "event-report", G_CALLBACK (wds_event_report_cb), &n_indications_a1);
+    g_signal_connect (wds_a2, "event-report", G_CALLBACK (wds_event_report_cb), &n_indications_a2);
+    g_signal_connect (wds_b1, "event-report", G_CALLBACK (wds_event_report_cb), &n_indications_b1);
+
+    client_request (wds_a1);
+    client_request (wds_a2);
+    client_request (wds_b1);
+    g_assert_cmpuint (modem_get_n_received (&ctx.modems[0]), ==, 2);
+    g_assert_cmpuint (modem_get_n_received (&ctx.modems[1]), ==, 1);
+
+    g_assert_cmpuint (qmi_proxy_get_n_clients (ctx.proxy), ==, 3);
+    g_assert_cmpuint (proxy_get_device_n_clients (ctx.proxy, &ctx.modems[0]), ==, 2);
+    g_assert_cmpuint (proxy_get_device_n_clients (ctx.proxy, &ctx.modems[1]), ==, 1);
+
+    /* Indications of each modem reach only the clients of that modem */
+    test_port_context_invoke (ctx.modems[0].port, (GSourceFunc) modem_emit_indication, &ctx.modems[0]);
+    wait_until (n_indications_a1 == 1 && n_indications_a2 == 1);
+    test_port_context_invoke (ctx.modems[1].port, (GSourceFunc) modem_emit_indication, &ctx.modems[1]);
+    wait_until (n_indications_b1 == 1);
+    g_assert_cmpuint (n_indications_a1, ==, 1);
+    g_assert_cmpuint (n_indications_a2, ==, 1);
+
+    g_signal_handlers_disconnect_by_data (wds_a1, &n_indications_a1);
+    g_signal_handlers_disconnect_by_data (wds_a2, &n_indications_a2);
+    g_signal_handlers_disconnect_by_data (wds_b1, &n_indications_b1);
+    release_client (a1, wds_a1);
+    release_client (a2, wds_a2);
+    device_close (a1);
+    device_close (a2);
+
+    /* The shard of the first modem is finishing now, but the modem can be
+     * used again right away */
+    a1 = device_open (&ctx, &ctx.modems[0]);
+    wds_a1 = allocate_client (a1, QMI_SERVICE_WDS);
+    client_request (wds_a1);
+    g_assert_cmpuint (modem_get_n_received (&ctx.modems[0]), ==, 3);
+
+    /* The other modem is unaffected */
+    client_request (wds_b1);
+    g_assert_cmpuint (modem_get_n_received (&ctx.modems[1]), ==, 2);
+
+    release_client (a1, wds_a1);
+    release_client (b1, wds_b1);
+    device_close (a1);
+    device_close (b1);
+
+    proxy_context_clear (&ctx);
+}
+
+static QmiProtocolError
+client_raw_request (QmiClient    *client,
+                    const guint8 *tlvs,
+                    gsize         tlvs_len)
+{
+    GAsyncResult *res = NULL;
+    QmiMessage   *request;
+
+    request = client_build_raw_request (client, tlvs, tlvs_len);
+    qmi_device_command_full (QMI_DEVICE (qmi_client_peek_device (client)),
+                             request, NULL, 10, NULL,
+                             (GAsyncReadyCallback) async_ready, &res);
+    qmi_message_unref (request);
+    return client_wait_request (client, &res);
+}
+
+static void
+test_proxy_malformed_tlvs (void)
+{
+    ProxyContext  ctx;
+    QmiDevice    *device;
+    QmiClient    *wds;
+    /* Only the type and one byte of the length */
+    static const guint8 truncated_header[] = { 0x10, 0x04 };
+    /* 4 bytes announced, 2 given */
+    static const guint8 truncated_value[] = { 0x10, 0x04, 0x00, 0xAA, 0xBB };
+    /* A valid TLV followed by one announcing the largest length possible */
+    static const guint8 oversized[] = { 0x01, 0x01, 0x00, 0xAA, 0x10, 0xFF, 0xFF, 0xBB };
+    /* Two valid TLVs */
+    static const guint8 valid[] = { 0x01, 0x01, 0x00, 0xAA, 0x10, 0x02, 0x00, 0xBB, 0xCC };
+
+    if (!proxy_context_init (&ctx, FALSE))
+        return;
+
+    device = device_open (&ctx, &ctx.modems[0]);
+    wds = allocate_client (device, QMI_SERVICE_WDS);
+
+    /* Rejected by the proxy itself, the modem never sees them */
+    g_assert_cmpint (client_raw_request (wds, truncated_header, sizeof (truncated_header)), ==, QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE);
+    g_assert_cmpint (client_raw_request (wds, truncated_value, sizeof (truncated_value)), ==, QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE);
+    g_assert_cmpint (client_raw_request (wds, oversized, sizeof (oversized)), ==, QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE);
+    g_assert_cmpuint (modem_get_n_received (&ctx.modems[0]), ==, 0);
+
+    /* The client is still served */
+    g_assert_cmpint (client_raw_request (wds, valid, sizeof (valid)), ==, QMI_PROTOCOL_ERROR_NONE);
+    g_assert_cmpuint (modem_get_n_received (&ctx.modems[0]), ==, 1);
+
+    release_client (device, wds);
+    device_close (device);
+    proxy_context_clear (&ctx);
+}
+
+static void
+test_proxy_ctl_transaction_ids (void)
+{
+    ProxyContext  ctx;
+    QmiDevice    *devices[2];
+    GAsyncResult *res[2] = { NULL, NULL };
+    guint8        trids[2];
+    guint         i;
+
+    if (!proxy_context_init (&ctx, FALSE))
+        return;
+
+    /* Version info requests are held by the modem */
+    modem_set_hold_ctl (&ctx.modems[0], 0x0021);
+
+    /* Both clients use the same CTL transaction id, and both requests are
+     * in the modem at the same time */
+    for (i = 0; i < G_N_ELEMENTS (devices); i++) {
+        QmiMessage *request;
+
+        devices[i] = device_open (&ctx, &ctx.modems[0]);
+        request = qmi_message_new (QMI_SERVICE_CTL, 0, 42, 0x0021);
+        qmi_device_command_full (devices[i], request, NULL, 10, NULL,
+                                 (GAsyncReadyCallback) async_ready, &res[i]);
+        qmi_message_unref (request);
+        wait_until (modem_get_n_held (&ctx.modems[0]) == i + 1);
+    }
+
+    /* The proxy gave them different transaction ids in the modem */
+    g_mutex_lock (&ctx.modems[0].mutex);
+    for (i = 0; i < G_N_ELEMENTS (trids); i++)
+        trids[i] = qmi_message_get_transaction_id (g_ptr_array_index (ctx.modems[0].held, i));
+    g_mutex_unlock (&ctx.modems[0].mutex);
+    g_assert_cmpuint (trids[0], !=, 0);
+    g_assert_cmpuint (trids[1], !=, 0);
+    g_assert_cmpuint (trids[0], !=, trids[1]);
+
+    /* Answered in the reverse order, each client gets the response to its
+     * own request, with its own transaction id */
+    test_port_context_invoke (ctx.modems[0].port, (GSourceFunc) modem_answer_held, &ctx.modems[0]);
+    for (i = 0; i < G_N_ELEMENTS (devices); i++) {
+        QmiMessage *response;
+        GError     *error = NULL;
+        gsize       init_offset;
+        gsize       offset = 0;
+        guint8      position;
+
+        response = qmi_device_command_full_finish (devices[i], wait_async (&res[i]), &error);
+        g_assert_no_error (error);
+        g_assert_cmpuint (qmi_message_get_transaction_id (response), ==, 42);
+        g_assert_cmpint (qmi_message_get_result_code (response), ==, QMI_PROTOCOL_ERROR_NONE);
+        init_offset = qmi_message_tlv_read_init (response, 0x01, NULL, &error);
+        g_assert_no_error (error);
+        g_assert (qmi_message_tlv_read_guint8 (response, init_offset, &offset, &position, &error));
+        g_assert_no_error (error);
+        g_assert_cmpuint (position, ==, i);
+        qmi_message_unref (response);
+        g_object_unref (res[i]);
+    }
+
+    for (i = 0; i < G_N_ELEMENTS (devices); i++)
+        device_close (devices[i]);
+    proxy_context_clear (&ctx);
+}
+
+static guint
+proxy_get_n_queued_requests (QmiProxy *proxy)
+{
+    GArray *stats;
+    guint   n_queued = 0;
+    guint   i;
+
+    stats = qmi_proxy_get_client_stats (proxy);
+    for (i = 0; i < stats->len; i++)
+        n_queued += g_array_index (stats, QmiProxyClientStats, i).n_queued_requests;
+    g_array_unref (stats);
+    return n_queued;
+}
+
+#define N_FLOOD_REQUESTS 10
+
+static void
+test_proxy_fair_queue (void)
+{
+    ProxyContext  ctx;
+    QmiDevice    *flood_device;
+    QmiDevice    *other_device;
+    QmiClient    *flood;
+    QmiClient    *other;
+    GAsyncResult *flood_res[N_FLOOD_REQUESTS] = { NULL };
+    GAsyncResult *other_res = NULL;
+    guint8        other_cid;
+    guint         other_position;
+    guint         i;
+
+    if (!proxy_context_init (&ctx, FALSE))
+        return;
+
+    /* One service request in the modem at a time */
+    g_object_set (ctx.proxy, QMI_PROXY_FAIR_QUEUE_WINDOW, 1, NULL);
+    flood_device = device_open (&ctx, &ctx.modems[0]);
+    other_device = device_open (&ctx, &ctx.modems[0]);
+    flood = allocate_client (flood_device, QMI_SERVICE_WDS);
+    other = allocate_client (other_device, QMI_SERVICE_WDS);
+    other_cid = qmi_client_get_cid (other);
+
+    /* One client sends many requests in bulk: the first one is held in the
+     * modem, the rest wait in the proxy */
+    modem_set_hold (&ctx.modems[0], TRUE);
+    for (i = 0; i < N_FLOOD_REQUESTS; i++)
+        client_send_request (flood, &flood_res[i]);
+    wait_until (modem_get_n_received (&ctx.modems[0]) == 1 &&
+                proxy_get_n_queued_requests (ctx.proxy) == N_FLOOD_REQUESTS - 1);
+
+    /* The other client sends a single one, after all of them */
+    client_send_request (other, &other_res);
+    wait_until (proxy_get_n_queued_requests (ctx.proxy) == N_FLOOD_REQUESTS);
+
+    /* Once the modem answers everything, all complete */
+    modem_set_hold (&ctx.modems[0], FALSE);
+    test_port_context_invoke (ctx.modems[0].port, (GSourceFunc) modem_answer_held, &ctx.modems[0]);
+    for (i = 0; i < N_FLOOD_REQUESTS; i++)
+        g_assert_cmpint (client_wait_request (flood, &flood_res[i]), ==, QMI_PROTOCOL_ERROR_NONE);
+    g_assert_cmpint (client_wait_request (other, &other_res), ==, QMI_PROTOCOL_ERROR_NONE);
+    g_assert_cmpuint (modem_get_n_received (&ctx.modems[0]), ==, N_FLOOD_REQUESTS + 1);
+    g_assert_cmpuint (proxy_get_n_queued_requests (ctx.proxy), ==, 0);
+
+    /* ...but the request of the other client was sent to the modem after at
+     * most one more of the flooding client, not after all of them */
+    g_mutex_lock (&ctx.modems[0].mutex);
+    for (other_position = 0; other_position < ctx.modems[0].received->len; other_position++) {
+        if (g_array_index (ctx.modems[0].received, guint8, other_position) == other_cid)
+            break;
+    }
+    g_mutex_unlock (&ctx.modems[0].mutex);
+    g_assert_cmpuint (other_position, <=, 2);
+
+    release_client (flood_device, flood);
+    release_client (other_device, other);
+    device_close (flood_device);
+    device_close (other_device);
+    proxy_context_clear (&ctx);
+}
+
+#define N_CONCURRENT_OPENS 3
+
+static void
+test_proxy_concurrent_open (void)
+{
+    ProxyContext  ctx;
+    QmiDevice    *devices[N_CONCURRENT_OPENS];
+    GAsyncResult *res[N_CONCURRENT_OPENS] = { NULL };
+    GArray       *stats;
+    guint         i;
+
+    if (!proxy_context_init (&ctx, FALSE))
+        return;
+
+    /* All the clients ask the proxy to open the modem before any of the
+     * opens completes */
+    for (i = 0; i < N_CONCURRENT_OPENS; i++)
+        devices[i] = device_new (&ctx, &ctx.modems[0]);
+    for (i = 0; i < N_CONCURRENT_OPENS; i++)
+        qmi_device_open (devices[i], QMI_DEVICE_OPEN_FLAGS_PROXY, 10, NULL,
+                         (GAsyncReadyCallback) async_ready, &res[i]);
+    for (i = 0; i < N_CONCURRENT_OPENS; i++) {
+        GError *error = NULL;
+
+        g_assert (qmi_device_open_finish (devices[i], wait_async (&res[i]), &error));
+        g_assert_no_error (error);
+        g_object_unref (res[i]);
+    }
+
+    /* The modem was opened only once, and is shared by all of them */
+    stats = qmi_proxy_get_device_stats (ctx.proxy);
+    g_assert_cmpuint (stats->len, ==, 1);
+    g_assert_cmpstr (g_array_index (stats, QmiProxyDeviceStats, 0).device_path, ==, test_port_context_get_name (ctx.modems[0].port));
+    g_assert_cmpuint (g_array_index (stats, QmiProxyDeviceStats, 0).n_clients, ==, N_CONCURRENT_OPENS);
+    g_array_unref (stats);
+
+    for (i = 0; i < N_CONCURRENT_OPENS; i++) {
+        QmiClient *wds;
+
+        wds = allocate_client (devices[i], QMI_SERVICE_WDS);
+        client_request (wds);
+        release_client (devices[i], wds);
+    }
+    g_assert_cmpuint (modem_get_n_received (&ctx.modems[0]), ==, N_CONCURRENT_OPENS);
+
+    for (i = 0; i < N_CONCURRENT_OPENS; i++)
+        device_close (devices[i]);
+    proxy_context_clear (&ctx);
+}
+
+/*****************************************************************************/
+
+static void
+test_proxy_tcp_listener_address (void)
+{
+    ProxyContext       ctx;
+    GSocketClient     *socket_client;
+    GSocketConnection *connection;
+    GError            *error = NULL;
+    guint16            port = 0;
+
+    if (!proxy_context_init (&ctx, FALSE))
+        return;
+
+    /* Without TLS, the token would go in cleartext through the network */
+    g_assert (!qmi_proxy_add_tcp_listener (ctx.proxy, "0.0.0.0", 0, "secret", NULL, &error));
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_UNSUPPORTED);
+    g_clear_error (&error);
+
+    /* Only loopback by default... */
+    g_assert (qmi_proxy_add_tcp_listener (ctx.proxy, NULL, 0, "secret", &port, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (port, !=, 0);
+
+    socket_client = g_socket_client_new ();
+    connection = g_socket_client_connect_to_host (socket_client, "127.0.0.1", port, NULL, &error);
+    g_assert_no_error (error);
+    g_object_unref (connection);
+    g_object_unref (socket_client);
+
+    /* ...or when explicitly requested */
+    g_assert (qmi_proxy_add_tcp_listener (ctx.proxy, "127.0.0.1", 0, "secret", NULL, &error));
+    g_assert_no_error (error);
+
+    proxy_context_clear (&ctx);
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/libqmi-glib/proxy/sharded",             test_proxy_sharded);
+    g_test_add_func ("/libqmi-glib/proxy/malformed-tlvs",      test_proxy_malformed_tlvs);
+    g_test_add_func ("/libqmi-glib/proxy/ctl-transaction-ids", test_proxy_ctl_transaction_ids);
+    g_test_add_func ("/libqmi-glib/proxy/fair-queue",          test_proxy_fair_queue);
+    g_test_add_func ("/libqmi-glib/proxy/concurrent-open",     test_proxy_concurrent_open);
+    g_test_add_func ("/libqmi-glib/proxy/tcp-listener-address", test_proxy_tcp_listener_address);
+
+    return g_test_run ();
+}
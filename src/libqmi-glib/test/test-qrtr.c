@@ -0,0 +1,1085 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib-unix.h>
+
+#include "qmi-qrtr.h"
+#include "qmi-message.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+#if defined HAVE_LINUX_QRTR_H
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/qrtr.h>
+
+#define LOCAL_NODE 1
+#define MODEM_NODE 0
+#define DMS_PORT   10
+#define NAS_PORT   11
+#define OTHER_PORT 12
+
+#define WAIT_TIMEOUT_MS 5000
+
+/*****************************************************************************/
+/* Mocked QRTR sockets
+ *
+ * Each socket is one end of a UNIX socket pair, the other one being the peer
+ * used by the test, either as name service or as server. Each message is
+ * sent with the QRTR address in front: the destination one from the node,
+ * the source one to the node. */
+
+typedef struct {
+    guint32 node;
+    guint32 port;
+} MockAddress;
+
+typedef struct {
+    gint    fd;
+    gint    peer_fd;
+    guint32 port;
+} MockSocket;
+
+static GMutex     mock_mutex;
+static GCond      mock_cond;
+static GPtrArray *mock_sockets;
+static guint32    mock_next_port;
+/* Errors forced in the system calls, if not 0 */
+static gint       mock_socket_errno;
+static gint       mock_send_errno;
+
+static MockSocket *
+mock_socket_lookup (gint fd)
+{
+    guint i;
+
+    for (i = 0; i < mock_sockets->len; i++) {
+        MockSocket *sock = g_ptr_array_index (mock_sockets, i);
+
+        if (sock->fd == fd)
+            return sock;
+    }
+    g_assert_not_reached ();
+    return NULL;
+}
+
+static gint
+mock_socket_new (void)
+{
+    MockSocket *sock;
+    gint        fds[2];
+
+    if (mock_socket_errno) {
+        errno = mock_socket_errno;
+        return -1;
+    }
+
+    if (socketpair (AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0)
+        return -1;
+    g_assert (g_unix_set_fd_nonblocking (fds[0], TRUE, NULL));
+
+    sock = g_new0 (MockSocket, 1);
+    sock->fd = fds[0];
+    sock->peer_fd = fds[1];
+
+    g_mutex_lock (&mock_mutex);
+    sock->port = mock_next_port++;
+    g_ptr_array_add (mock_sockets, sock);
+    g_cond_broadcast (&mock_cond);
+    g_mutex_unlock (&mock_mutex);
+    return sock->fd;
+}
+
+static gint
+mock_getsockname (gint     fd,
+                  guint32 *node,
+                  guint32 *port)
+{
+    g_mutex_lock (&mock_mutex);
+    *node = LOCAL_NODE;
+    *port = mock_socket_lookup (fd)->port;
+    g_mutex_unlock (&mock_mutex);
+    return 0;
+}
+
+static gssize
+mock_sendto (gint          fd,
+             const guint8 *data,
+             gsize         len,
+             guint32       node,
+             guint32       port)
+{
+    MockAddress  to = { node, port };
+    struct iovec vectors[2];
+    gssize       r;
+
+    if (mock_send_errno) {
+        errno = mock_send_errno;
+        return -1;
+    }
+
+    vectors[0].iov_base = &to;
+    vectors[0].iov_len = sizeof (to);
+    vectors[1].iov_base = (guint8 *) data;
+    vectors[1].iov_len = len;
+    r = writev (fd, vectors, G_N_ELEMENTS (vectors));
+    return (r < 0 ? r : (gssize) len);
+}
+
+static gssize
+mock_recvfrom (gint     fd,
+               guint8  *data,
+               gsize    len,
+               guint32 *node,
+               guint32 *port)
+{
+    MockAddress  from = { 0, 0 };
+    struct iovec vectors[2];
+    gssize       r;
+
+    vectors[0].iov_base = &from;
+    vectors[0].iov_len = sizeof (from);
+    vectors[1].iov_base = data;
+    vectors[1].iov_len = len;
+    r = readv (fd, vectors, G_N_ELEMENTS (vectors));
+    if (r < 0)
+        return r;
+
+    /* Nothing else is expected from the peers */
+    g_assert_cmpint (r, >=, (gssize) sizeof (from));
+    *node = from.node;
+    *port = from.port;
+    return r - sizeof (from);
+}
+
+static const QmiQrtrSocketOps mock_socket_ops = {
+    .socket_new  = mock_socket_new,
+    .getsockname = mock_getsockname,
+    .sendto      = mock_sendto,
+    .recvfrom    = mock_recvfrom,
+};
+
+static void
+mock_socket_free (MockSocket *sock)
+{
+    /* The one given to the node is closed by the node */
+    close (sock->peer_fd);
+    g_free (sock);
+}
+
+static void
+mock_setup (void)
+{
+    mock_sockets = g_ptr_array_new_with_free_func ((GDestroyNotify) mock_socket_free);
+    mock_next_port = 0x4000;
+    mock_socket_errno = 0;
+    mock_send_errno = 0;
+    __qmi_qrtr_set_socket_ops (&mock_socket_ops);
+}
+
+static void
+mock_teardown (void)
+{
+    __qmi_qrtr_set_socket_ops (NULL);
+    g_clear_pointer (&mock_sockets, g_ptr_array_unref);
+}
+
+/* Sockets are given in creation order, the first one being the control
+ * socket used for the lookup */
+static MockSocket *
+mock_wait_socket (guint index)
+{
+    MockSocket *sock;
+    gint64      deadline;
+
+    deadline = g_get_monotonic_time () + WAIT_TIMEOUT_MS * G_TIME_SPAN_MILLISECOND;
+    g_mutex_lock (&mock_mutex);
+    while (mock_sockets->len <= index)
+        g_assert (g_cond_wait_until (&mock_cond, &mock_mutex, deadline));
+    sock = g_ptr_array_index (mock_sockets, index);
+    g_mutex_unlock (&mock_mutex);
+    return sock;
+}
+
+/* Returns the payload of the next message the peer gets, or NULL if the
+ * socket of the node was closed */
+static GByteArray *
+peer_recv (MockSocket  *sock,
+           MockAddress *to)
+{
+    struct pollfd pfd = { sock->peer_fd, POLLIN, 0 };
+    GByteArray   *payload;
+    struct iovec  vectors[2];
+    gssize        r;
+
+    g_assert_cmpint (poll (&pfd, 1, WAIT_TIMEOUT_MS), ==, 1);
+
+    payload = g_byte_array_sized_new (G_MAXUINT16 + 1);
+    g_byte_array_set_size (payload, G_MAXUINT16 + 1);
+    vectors[0].iov_base = to;
+    vectors[0].iov_len = sizeof (*to);
+    vectors[1].iov_base = payload->data;
+    vectors[1].iov_len = payload->len;
+    r = readv (sock->peer_fd, vectors, G_N_ELEMENTS (vectors));
+    g_assert_cmpint (r, >=, 0);
+    if (r == 0) {
+        g_byte_array_unref (payload);
+        return NULL;
+    }
+
+    g_assert_cmpint (r, >=, (gssize) sizeof (*to));
+    g_byte_array_set_size (payload, r - sizeof (*to));
+    return payload;
+}
+
+static void
+peer_send (MockSocket   *sock,
+           guint32       node,
+           guint32       port,
+           const guint8 *data,
+           gsize         len)
+{
+    MockAddress  from = { node, port };
+    struct iovec vectors[2];
+
+    vectors[0].iov_base = &from;
+    vectors[0].iov_len = sizeof (from);
+    vectors[1].iov_base = (guint8 *) data;
+    vectors[1].iov_len = len;
+    g_assert_cmpint (writev (sock->peer_fd, vectors, G_N_ELEMENTS (vectors)), ==, (gssize) (sizeof (from) + len));
+}
+
+/*****************************************************************************/
+/* Name service and servers */
+
+static void
+name_service_expect_lookup (MockSocket *ctrl)
+{
+    GByteArray                 *payload;
+    const struct qrtr_ctrl_pkt *pkt;
+    MockAddress                 to;
+
+    payload = peer_recv (ctrl, &to);
+    g_assert (payload);
+    g_assert_cmpuint (to.node, ==, LOCAL_NODE);
+    g_assert_cmpuint (to.port, ==, QRTR_PORT_CTRL);
+    g_assert_cmpuint (payload->len, ==, sizeof (struct qrtr_ctrl_pkt));
+    pkt = (const struct qrtr_ctrl_pkt *) payload->data;
+    g_assert_cmpuint (GUINT32_FROM_LE (pkt->cmd), ==, QRTR_TYPE_NEW_LOOKUP);
+    g_byte_array_unref (payload);
+}
+
+/* All zeros for the end of the lookup */
+static void
+name_service_send (MockSocket *ctrl,
+                   guint32     cmd,
+                   guint32     service,
+                   guint32     instance,
+                   guint32     node,
+                   guint32     port)
+{
+    struct qrtr_ctrl_pkt pkt;
+
+    memset (&pkt, 0, sizeof (pkt));
+    pkt.cmd = GUINT32_TO_LE (cmd);
+    pkt.server.service = GUINT32_TO_LE (service);
+    pkt.server.instance = GUINT32_TO_LE (instance);
+    pkt.server.node = GUINT32_TO_LE (node);
+    pkt.server.port = GUINT32_TO_LE (port);
+    peer_send (ctrl, LOCAL_NODE, QRTR_PORT_CTRL, (const guint8 *) &pkt, sizeof (pkt));
+}
+
+/* Checks that the server got @request without QMUX header, and replies */
+static void
+server_reply (MockSocket       *client,
+              guint32           port,
+              const GByteArray *payload,
+              QmiMessage       *request)
+{
+    QmiMessage   *response;
+    const guint8 *raw;
+    gsize         raw_len = 0;
+    GError       *error = NULL;
+
+    raw = qmi_message_get_raw (request, &raw_len, &error);
+    g_assert_no_error (error);
+    g_assert_cmpuint (payload->len, ==, raw_len - 6);
+    g_assert (memcmp (payload->data, &raw[6], payload->len) == 0);
+
+    response = qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+    raw = qmi_message_get_raw (response, &raw_len, &error);
+    g_assert_no_error (error);
+    peer_send (client, MODEM_NODE, port, &raw[6], raw_len - 6);
+    qmi_message_unref (response);
+}
+
+/*****************************************************************************/
+/* Node run in its own I/O thread, as in QmiDevice */
+
+typedef struct {
+    GMainContext *context;
+    GMainLoop    *loop;
+    GThread      *thread;
+    QmiQrtrNode  *node;
+    GMutex        mutex;
+    GCond         cond;
+    /* Only used in the I/O thread */
+    GByteArray   *buffer;
+    /* Results of the callbacks */
+    guint         n_opened;
+    GError       *open_error;
+    GPtrArray    *received;
+    guint         n_send_errors;
+    GError       *send_error;
+    guint         n_removed;
+    guint         n_invocations;
+} NodeContext;
+
+static void
+node_context_signal (NodeContext *ctx)
+{
+    g_cond_broadcast (&ctx->cond);
+    g_mutex_unlock (&ctx->mutex);
+}
+
+static GByteArray *
+node_get_buffer (NodeContext *ctx)
+{
+    g_assert (g_main_context_is_owner (ctx->context));
+    return ctx->buffer;
+}
+
+static void
+node_input (NodeContext *ctx)
+{
+    QmiMessage *message;
+    GError     *error = NULL;
+
+    g_assert (g_main_context_is_owner (ctx->context));
+
+    g_mutex_lock (&ctx->mutex);
+    while ((message = qmi_message_new_from_raw (ctx->buffer, &error)) != NULL)
+        g_ptr_array_add (ctx->received, message);
+    g_assert_no_error (error);
+    node_context_signal (ctx);
+}
+
+static void
+node_send_error (QmiMessage   *message,
+                 const GError *error,
+                 NodeContext  *ctx)
+{
+    g_assert (g_main_context_is_owner (ctx->context));
+
+    g_mutex_lock (&ctx->mutex);
+    ctx->n_send_errors++;
+    g_clear_error (&ctx->send_error);
+    ctx->send_error = g_error_copy (error);
+    node_context_signal (ctx);
+}
+
+static void
+node_removed (NodeContext *ctx)
+{
+    g_assert (g_main_context_is_owner (ctx->context));
+
+    g_mutex_lock (&ctx->mutex);
+    ctx->n_removed++;
+    node_context_signal (ctx);
+}
+
+static const QmiQrtrNodeCallbacks node_callbacks = {
+    .get_buffer = (GByteArray * (*) (gpointer)) node_get_buffer,
+    .input      = (void (*) (gpointer)) node_input,
+    .send_error = (void (*) (QmiMessage *, const GError *, gpointer)) node_send_error,
+    .removed    = (void (*) (gpointer)) node_removed,
+};
+
+static void
+node_open_ready (QmiQrtrNode *node,
+                 GError      *error,
+                 NodeContext *ctx)
+{
+    g_assert (g_main_context_is_owner (ctx->context));
+    g_assert (node == ctx->node);
+
+    g_mutex_lock (&ctx->mutex);
+    ctx->n_opened++;
+    ctx->open_error = error;
+    node_context_signal (ctx);
+}
+
+static gpointer
+node_context_thread_func (NodeContext *ctx)
+{
+    g_main_context_push_thread_default (ctx->context);
+    g_main_loop_run (ctx->loop);
+    g_main_context_pop_thread_default (ctx->context);
+    return NULL;
+}
+
+static NodeContext *
+node_context_new (void)
+{
+    NodeContext *ctx;
+
+    ctx = g_new0 (NodeContext, 1);
+    g_mutex_init (&ctx->mutex);
+    g_cond_init (&ctx->cond);
+    ctx->context = g_main_context_new ();
+    ctx->loop = g_main_loop_new (ctx->context, FALSE);
+    ctx->buffer = g_byte_array_new ();
+    ctx->received = g_ptr_array_new_with_free_func ((GDestroyNotify) qmi_message_unref);
+    ctx->node = __qmi_qrtr_node_new (MODEM_NODE, "test", ctx->context, &node_callbacks, ctx);
+    ctx->thread = g_thread_new ("io", (GThreadFunc) node_context_thread_func, ctx);
+    return ctx;
+}
+
+static void
+node_context_stop (NodeContext *ctx)
+{
+    g_main_loop_quit (ctx->loop);
+    g_thread_join (ctx->thread);
+    ctx->thread = NULL;
+}
+
+/* The node is freed once its context no longer runs */
+static void
+node_context_free (NodeContext *ctx)
+{
+    if (ctx->thread)
+        node_context_stop (ctx);
+    if (ctx->node)
+        __qmi_qrtr_node_free (ctx->node);
+
+    g_clear_error (&ctx->open_error);
+    g_clear_error (&ctx->send_error);
+    g_ptr_array_unref (ctx->received);
+    g_byte_array_unref (ctx->buffer);
+    g_main_loop_unref (ctx->loop);
+    g_main_context_unref (ctx->context);
+    g_cond_clear (&ctx->cond);
+    g_mutex_clear (&ctx->mutex);
+    g_free (ctx);
+}
+
+/* Waits for the given counter, updated by the callbacks, to reach @value */
+static void
+node_context_wait (NodeContext *ctx,
+                   guint       *counter,
+                   guint        value)
+{
+    gint64 deadline;
+
+    deadline = g_get_monotonic_time () + WAIT_TIMEOUT_MS * G_TIME_SPAN_MILLISECOND;
+    g_mutex_lock (&ctx->mutex);
+    while (*counter < value)
+        g_assert (g_cond_wait_until (&ctx->cond, &ctx->mutex, deadline));
+    g_mutex_unlock (&ctx->mutex);
+}
+
+static void
+node_context_wait_received (NodeContext *ctx,
+                            guint        n_received)
+{
+    node_context_wait (ctx, &ctx->received->len, n_received);
+}
+
+static void
+node_context_wait_open (NodeContext *ctx)
+{
+    node_context_wait (ctx, &ctx->n_opened, 1);
+}
+
+typedef struct {
+    NodeContext *ctx;
+    GSourceFunc  func;
+    gpointer     data;
+} Invocation;
+
+static gboolean
+invocation_cb (Invocation *invocation)
+{
+    NodeContext *ctx = invocation->ctx;
+
+    invocation->func (invocation->data);
+
+    g_mutex_lock (&ctx->mutex);
+    ctx->n_invocations++;
+    node_context_signal (ctx);
+    g_free (invocation);
+    return G_SOURCE_REMOVE;
+}
+
+/* The node is only used in its context, as in QmiDevice */
+static void
+node_context_invoke (NodeContext *ctx,
+                     GSourceFunc  func,
+                     gpointer     data)
+{
+    Invocation *invocation;
+    guint       n_invocations;
+
+    g_mutex_lock (&ctx->mutex);
+    n_invocations = ctx->n_invocations;
+    g_mutex_unlock (&ctx->mutex);
+
+    invocation = g_new0 (Invocation, 1);
+    invocation->ctx = ctx;
+    invocation->func = func;
+    invocation->data = data;
+    g_main_context_invoke (ctx->context, (GSourceFunc) invocation_cb, invocation);
+    node_context_wait (ctx, &ctx->n_invocations, n_invocations + 1);
+}
+
+/* Opens the node with the given servers, each one a service and port pair */
+static void
+node_context_open (NodeContext   *ctx,
+                   const guint32 *servers,
+                   guint          n_servers)
+{
+    MockSocket *ctrl;
+    GError     *error = NULL;
+    guint       i;
+
+    g_assert (__qmi_qrtr_node_open (ctx->node, 5, (QmiQrtrNodeOpenFn) node_open_ready, ctx, &error));
+    g_assert_no_error (error);
+
+    ctrl = mock_wait_socket (0);
+    name_service_expect_lookup (ctrl);
+    for (i = 0; i < n_servers; i++)
+        name_service_send (ctrl, QRTR_TYPE_NEW_SERVER, servers[2 * i], 1, MODEM_NODE, servers[2 * i + 1]);
+    name_service_send (ctrl, QRTR_TYPE_NEW_SERVER, 0, 0, 0, 0);
+
+    node_context_wait_open (ctx);
+}
+
+typedef struct {
+    NodeContext *ctx;
+    QmiMessage  *message;
+    gboolean     sent;
+    GError      *error;
+} SendContext;
+
+static gboolean
+send_cb (SendContext *send)
+{
+    send->sent = __qmi_qrtr_node_send (send->ctx->node, send->message, &send->error);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+node_context_try_send (NodeContext  *ctx,
+                       QmiMessage   *message,
+                       GError      **error)
+{
+    SendContext send = { ctx, message, FALSE, NULL };
+
+    node_context_invoke (ctx, (GSourceFunc) send_cb, &send);
+    if (!send.sent)
+        g_propagate_error (error, send.error);
+    return send.sent;
+}
+
+static void
+node_context_send (NodeContext *ctx,
+                   QmiMessage  *message)
+{
+    GError *error = NULL;
+
+    g_assert (node_context_try_send (ctx, message, &error));
+    g_assert_no_error (error);
+}
+
+/* Sends a request and waits for the next message received */
+static QmiMessage *
+node_context_command (NodeContext *ctx,
+                      QmiMessage  *request)
+{
+    guint n_received;
+
+    g_mutex_lock (&ctx->mutex);
+    n_received = ctx->received->len;
+    g_mutex_unlock (&ctx->mutex);
+
+    node_context_send (ctx, request);
+    node_context_wait_received (ctx, n_received + 1);
+    return qmi_message_ref (g_ptr_array_index (ctx->received, n_received));
+}
+
+typedef struct {
+    NodeContext *ctx;
+    guint        n_servers;
+} NServersContext;
+
+static gboolean
+n_servers_cb (NServersContext *n_servers)
+{
+    n_servers->n_servers = __qmi_qrtr_node_get_n_servers (n_servers->ctx->node);
+    return G_SOURCE_REMOVE;
+}
+
+/* Changes in the servers are only known once read in the I/O thread */
+static void
+node_context_wait_n_servers (NodeContext *ctx,
+                             guint        n_servers)
+{
+    gint64 deadline;
+
+    deadline = g_get_monotonic_time () + WAIT_TIMEOUT_MS * G_TIME_SPAN_MILLISECOND;
+    while (TRUE) {
+        NServersContext current = { ctx, 0 };
+
+        node_context_invoke (ctx, (GSourceFunc) n_servers_cb, &current);
+        if (current.n_servers == n_servers)
+            break;
+        g_assert_cmpint (g_get_monotonic_time (), <, deadline);
+        g_usleep (10 * G_TIME_SPAN_MILLISECOND);
+    }
+}
+
+/*****************************************************************************/
+/* CTL emulation */
+
+/* The service and CID TLV only if given, not negative */
+static QmiMessage *
+ctl_request_new (guint16 message_id,
+                 gint    service,
+                 gint    cid)
+{
+    static guint8  transaction_id;
+    QmiMessage    *request;
+    gsize          tlv_offset;
+    GError        *error = NULL;
+
+    request = qmi_message_new (QMI_SERVICE_CTL, 0, ++transaction_id, message_id);
+    if (service < 0)
+        return request;
+
+    tlv_offset = qmi_message_tlv_write_init (request, 0x01, &error);
+    g_assert_no_error (error);
+    g_assert (qmi_message_tlv_write_guint8 (request, (guint8) service, &error));
+    if (cid >= 0)
+        g_assert (qmi_message_tlv_write_guint8 (request, (guint8) cid, &error));
+    g_assert (qmi_message_tlv_write_complete (request, tlv_offset, &error));
+    g_assert_no_error (error);
+    return request;
+}
+
+/* Returns the result of a CTL request, replied locally */
+static QmiProtocolError
+ctl_command (NodeContext *ctx,
+             guint16      message_id,
+             gint         service,
+             gint         cid,
+             QmiMessage **out_response)
+{
+    QmiMessage       *request;
+    QmiMessage       *response;
+    QmiProtocolError  result;
+
+    request = ctl_request_new (message_id, service, cid);
+    response = node_context_command (ctx, request);
+    g_assert (qmi_message_is_response (response));
+    g_assert_cmpuint (qmi_message_get_service (response), ==, QMI_SERVICE_CTL);
+    g_assert_cmpuint (qmi_message_get_message_id (response), ==, message_id);
+    g_assert_cmpuint (qmi_message_get_transaction_id (response), ==, qmi_message_get_transaction_id (request));
+    qmi_message_unref (request);
+
+    result = qmi_message_get_result_code (response);
+    if (out_response)
+        *out_response = response;
+    else
+        qmi_message_unref (response);
+    return result;
+}
+
+/* Returns the CID allocated, checking the service given back */
+static guint8
+ctl_allocate_cid (NodeContext *ctx,
+                  QmiService   service)
+{
+    QmiMessage *response = NULL;
+    gsize       tlv_offset;
+    gsize       offset = 0;
+    guint8      value = 0;
+    guint8      cid = 0;
+    GError     *error = NULL;
+
+    g_assert_cmpuint (ctl_command (ctx, 0x0022, service, -1, &response), ==, QMI_PROTOCOL_ERROR_NONE);
+    tlv_offset = qmi_message_tlv_read_init (response, 0x01, NULL, &error);
+    g_assert_no_error (error);
+    g_assert (qmi_message_tlv_read_guint8 (response, tlv_offset, &offset, &value, &error));
+    g_assert (qmi_message_tlv_read_guint8 (response, tlv_offset, &offset, &cid, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (value, ==, service);
+    qmi_message_unref (response);
+    return cid;
+}
+
+/*****************************************************************************/
+
+static void
+test_qrtr_io_thread (void)
+{
+    static const guint32  servers[] = { QMI_SERVICE_DMS, DMS_PORT };
+    NodeContext          *ctx;
+    MockSocket           *client;
+    QmiMessage           *request;
+    QmiMessage           *response;
+    GByteArray           *payload;
+    MockAddress           to;
+
+    mock_setup ();
+    ctx = node_context_new ();
+
+    /* Open completed in the I/O thread */
+    node_context_open (ctx, servers, G_N_ELEMENTS (servers) / 2);
+    g_assert_no_error (ctx->open_error);
+    g_assert (__qmi_qrtr_node_is_open (ctx->node));
+    g_assert_cmpuint (__qmi_qrtr_node_get_n_servers (ctx->node), ==, 1);
+
+    /* Request sent through a new socket for the client, to the server */
+    request = qmi_message_new (QMI_SERVICE_DMS, 1, 0x1234, 0x0020);
+    node_context_send (ctx, request);
+    client = mock_wait_socket (1);
+    payload = peer_recv (client, &to);
+    g_assert (payload);
+    g_assert_cmpuint (to.node, ==, MODEM_NODE);
+    g_assert_cmpuint (to.port, ==, DMS_PORT);
+
+    /* Reply processed in the I/O thread, as if read from the device */
+    server_reply (client, DMS_PORT, payload, request);
+    node_context_wait_received (ctx, 1);
+    response = g_ptr_array_index (ctx->received, 0);
+    g_assert (qmi_message_is_response (response));
+    g_assert_cmpuint (qmi_message_get_service (response), ==, QMI_SERVICE_DMS);
+    g_assert_cmpuint (qmi_message_get_client_id (response), ==, 1);
+    g_assert_cmpuint (qmi_message_get_transaction_id (response), ==, 0x1234);
+    g_assert_cmpuint (qmi_message_get_message_id (response), ==, 0x0020);
+    g_assert_cmpuint (ctx->n_send_errors, ==, 0);
+
+    g_byte_array_unref (payload);
+    qmi_message_unref (request);
+    node_context_free (ctx);
+    mock_teardown ();
+}
+
+/* Large enough so that a few of them fill the socket buffers */
+#define CLOSE_LARGE_TLV_SIZE 60000
+#define CLOSE_N_LARGE        16
+
+static void
+test_qrtr_close_in_flight (void)
+{
+    static const guint32  servers[] = { QMI_SERVICE_DMS, DMS_PORT };
+    NodeContext          *ctx;
+    MockSocket           *client;
+    GByteArray           *payload;
+    MockAddress           to;
+    guint8               *tlv;
+    guint                 n_sent = 0;
+    guint                 i;
+
+    mock_setup ();
+    ctx = node_context_new ();
+    node_context_open (ctx, servers, G_N_ELEMENTS (servers) / 2);
+    g_assert_no_error (ctx->open_error);
+
+    /* The server doesn't read, so the requests are flow controlled and kept
+     * queued in the node */
+    tlv = g_malloc0 (CLOSE_LARGE_TLV_SIZE);
+    for (i = 0; i < CLOSE_N_LARGE; i++) {
+        QmiMessage *request;
+        GError     *error = NULL;
+
+        request = qmi_message_new (QMI_SERVICE_DMS, 1, i + 1, 0x0020);
+        g_assert (qmi_message_add_raw_tlv (request, 0x10, tlv, CLOSE_LARGE_TLV_SIZE, &error));
+        g_assert_no_error (error);
+        node_context_send (ctx, request);
+        qmi_message_unref (request);
+    }
+    g_free (tlv);
+
+    /* Freed with the requests in flight, without reporting any error, as the
+     * transactions are failed by the device itself */
+    client = mock_wait_socket (1);
+    node_context_stop (ctx);
+    g_clear_pointer (&ctx->node, __qmi_qrtr_node_free);
+    g_assert_cmpuint (ctx->n_send_errors, ==, 0);
+    g_assert_cmpuint (ctx->received->len, ==, 0);
+
+    /* Only whole requests were sent before the socket was closed */
+    while ((payload = peer_recv (client, &to)) != NULL) {
+        g_assert_cmpuint (to.port, ==, DMS_PORT);
+        g_assert_cmpuint (payload->len, >, CLOSE_LARGE_TLV_SIZE);
+        g_byte_array_unref (payload);
+        n_sent++;
+    }
+    g_assert_cmpuint (n_sent, <, CLOSE_N_LARGE);
+
+    node_context_free (ctx);
+    mock_teardown ();
+}
+
+static void
+test_qrtr_parse_uri (void)
+{
+    guint32 node = G_MAXUINT32;
+
+    g_assert (__qmi_qrtr_parse_uri ("qrtr://0", &node));
+    g_assert_cmpuint (node, ==, 0);
+    g_assert (__qmi_qrtr_parse_uri ("qrtr://12/", &node));
+    g_assert_cmpuint (node, ==, 12);
+    g_assert (__qmi_qrtr_parse_uri ("QRTR://4294967295", &node));
+    g_assert_cmpuint (node, ==, G_MAXUINT32);
+
+    g_assert (!__qmi_qrtr_parse_uri ("qrtr://", &node));
+    g_assert (!__qmi_qrtr_parse_uri ("qrtr://-1", &node));
+    g_assert (!__qmi_qrtr_parse_uri ("qrtr://x", &node));
+    g_assert (!__qmi_qrtr_parse_uri ("qrtr://1/2", &node));
+    g_assert (!__qmi_qrtr_parse_uri ("qrtr://4294967296", &node));
+    g_assert (!__qmi_qrtr_parse_uri ("/dev/cdc-wdm0", &node));
+    g_assert_cmpuint (node, ==, G_MAXUINT32);
+}
+
+static void
+test_qrtr_servers (void)
+{
+    NodeContext *ctx;
+    MockSocket  *ctrl;
+    MockSocket  *dms1;
+    MockSocket  *dms2;
+    MockSocket  *nas;
+    QmiMessage  *request;
+    QmiMessage  *response = NULL;
+    GByteArray  *payload;
+    MockAddress  to;
+    gsize        tlv_offset;
+    gsize        offset = 0;
+    guint8       n_services = 0;
+    guint        n_received;
+    guint        i;
+    GError      *error = NULL;
+    static const guint16 versions[][2] = {
+        { QMI_SERVICE_CTL, 1 },
+        { QMI_SERVICE_DMS, 1 },
+        { QMI_SERVICE_NAS, 5 },
+    };
+
+    mock_setup ();
+    ctx = node_context_new ();
+
+    g_assert (__qmi_qrtr_node_open (ctx->node, 5, (QmiQrtrNodeOpenFn) node_open_ready, ctx, &error));
+    g_assert_no_error (error);
+    ctrl = mock_wait_socket (0);
+    name_service_expect_lookup (ctrl);
+    name_service_send (ctrl, QRTR_TYPE_NEW_SERVER, QMI_SERVICE_DMS, 1, MODEM_NODE, DMS_PORT);
+    name_service_send (ctrl, QRTR_TYPE_NEW_SERVER, QMI_SERVICE_NAS, 5, MODEM_NODE, NAS_PORT);
+    /* Ignored: other instances, other nodes, CTL and non-QMI services */
+    name_service_send (ctrl, QRTR_TYPE_NEW_SERVER, QMI_SERVICE_DMS, 2, MODEM_NODE, OTHER_PORT);
+    name_service_send (ctrl, QRTR_TYPE_NEW_SERVER, QMI_SERVICE_WDS, 1, MODEM_NODE + 5, OTHER_PORT);
+    name_service_send (ctrl, QRTR_TYPE_NEW_SERVER, QMI_SERVICE_CTL, 1, MODEM_NODE, OTHER_PORT);
+    name_service_send (ctrl, QRTR_TYPE_NEW_SERVER, 0x1234, 1, MODEM_NODE, OTHER_PORT);
+    name_service_send (ctrl, QRTR_TYPE_NEW_SERVER, 0, 0, 0, 0);
+    node_context_wait_open (ctx);
+    g_assert_no_error (ctx->open_error);
+    node_context_wait_n_servers (ctx, 2);
+
+    /* Services published with the instance as major version, CTL included */
+    g_assert_cmpuint (ctl_command (ctx, 0x0021, -1, -1, &response), ==, QMI_PROTOCOL_ERROR_NONE);
+    tlv_offset = qmi_message_tlv_read_init (response, 0x01, NULL, &error);
+    g_assert_no_error (error);
+    g_assert (qmi_message_tlv_read_guint8 (response, tlv_offset, &offset, &n_services, &error));
+    g_assert_cmpuint (n_services, ==, G_N_ELEMENTS (versions));
+    for (i = 0; i < n_services; i++) {
+        guint8  service = 0;
+        guint16 major = 0;
+        guint16 minor = 0;
+
+        g_assert (qmi_message_tlv_read_guint8 (response, tlv_offset, &offset, &service, &error));
+        g_assert (qmi_message_tlv_read_guint16 (response, tlv_offset, &offset, QMI_ENDIAN_LITTLE, &major, &error));
+        g_assert (qmi_message_tlv_read_guint16 (response, tlv_offset, &offset, QMI_ENDIAN_LITTLE, &minor, &error));
+        g_assert_no_error (error);
+        g_assert_cmpuint (service, ==, versions[i][0]);
+        g_assert_cmpuint (major, ==, versions[i][1]);
+        g_assert_cmpuint (minor, ==, 0);
+    }
+    qmi_message_unref (response);
+
+    /* Each CID allocated gets its own socket */
+    g_assert_cmpuint (ctl_allocate_cid (ctx, QMI_SERVICE_DMS), ==, 1);
+    dms1 = mock_wait_socket (1);
+    g_assert_cmpuint (ctl_allocate_cid (ctx, QMI_SERVICE_DMS), ==, 2);
+    dms2 = mock_wait_socket (2);
+
+    /* Requests go through the socket of their client to the server of their
+     * service, and only replies from that server are taken */
+    request = qmi_message_new (QMI_SERVICE_DMS, 2, 0x0100, 0x0020);
+    node_context_send (ctx, request);
+    payload = peer_recv (dms2, &to);
+    g_assert (payload);
+    g_assert_cmpuint (to.node, ==, MODEM_NODE);
+    g_assert_cmpuint (to.port, ==, DMS_PORT);
+    server_reply (dms2, OTHER_PORT, payload, request);
+    peer_send (dms2, MODEM_NODE + 5, DMS_PORT, payload->data, payload->len);
+    server_reply (dms2, DMS_PORT, payload, request);
+    n_received = ctx->received->len;
+    node_context_wait_received (ctx, n_received + 1);
+    response = g_ptr_array_index (ctx->received, n_received);
+    g_assert (qmi_message_is_response (response));
+    g_assert_cmpuint (qmi_message_get_service (response), ==, QMI_SERVICE_DMS);
+    g_assert_cmpuint (qmi_message_get_client_id (response), ==, 2);
+    g_assert_cmpuint (qmi_message_get_transaction_id (response), ==, 0x0100);
+    g_byte_array_unref (payload);
+    qmi_message_unref (request);
+
+    /* CIDs not allocated through CTL get their socket when first used */
+    request = qmi_message_new (QMI_SERVICE_NAS, 7, 0x0200, 0x0020);
+    node_context_send (ctx, request);
+    nas = mock_wait_socket (3);
+    payload = peer_recv (nas, &to);
+    g_assert (payload);
+    g_assert_cmpuint (to.port, ==, NAS_PORT);
+    server_reply (nas, NAS_PORT, payload, request);
+    node_context_wait_received (ctx, n_received + 2);
+    response = g_ptr_array_index (ctx->received, n_received + 1);
+    g_assert_cmpuint (qmi_message_get_service (response), ==, QMI_SERVICE_NAS);
+    g_assert_cmpuint (qmi_message_get_client_id (response), ==, 7);
+    g_assert_cmpuint (qmi_message_get_transaction_id (response), ==, 0x0200);
+    g_assert_cmpuint (ctx->received->len, ==, n_received + 2);
+    g_byte_array_unref (payload);
+
+    /* Releasing a CID closes its socket, the others are kept */
+    g_assert_cmpuint (ctl_command (ctx, 0x0023, QMI_SERVICE_DMS, 1, NULL), ==, QMI_PROTOCOL_ERROR_NONE);
+    g_assert (!peer_recv (dms1, &to));
+    g_assert_cmpuint (ctl_allocate_cid (ctx, QMI_SERVICE_DMS), ==, 1);
+
+    /* Servers are only removed from the port they were added with */
+    name_service_send (ctrl, QRTR_TYPE_DEL_SERVER, QMI_SERVICE_NAS, 5, MODEM_NODE, OTHER_PORT);
+    name_service_send (ctrl, QRTR_TYPE_DEL_SERVER, QMI_SERVICE_NAS, 5, MODEM_NODE, NAS_PORT);
+    node_context_wait_n_servers (ctx, 1);
+    g_assert (!node_context_try_send (ctx, request, &error));
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_UNSUPPORTED);
+    g_clear_error (&error);
+    qmi_message_unref (request);
+
+    g_assert_cmpuint (ctx->n_send_errors, ==, 0);
+    g_assert_cmpuint (ctx->n_removed, ==, 0);
+    node_context_free (ctx);
+    mock_teardown ();
+}
+
+static void
+test_qrtr_errors (void)
+{
+    static const guint32  servers[] = { QMI_SERVICE_DMS, DMS_PORT };
+    NodeContext          *ctx;
+    QmiMessage           *request;
+    GError               *error = NULL;
+
+    /* No QRTR sockets */
+    mock_setup ();
+    ctx = node_context_new ();
+    mock_socket_errno = EAFNOSUPPORT;
+    g_assert (!__qmi_qrtr_node_open (ctx->node, 5, (QmiQrtrNodeOpenFn) node_open_ready, ctx, &error));
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED);
+    g_clear_error (&error);
+    node_context_free (ctx);
+    mock_teardown ();
+
+    /* No services in the node */
+    mock_setup ();
+    ctx = node_context_new ();
+    node_context_open (ctx, NULL, 0);
+    g_assert_error (ctx->open_error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED);
+    g_assert (!__qmi_qrtr_node_is_open (ctx->node));
+    node_context_free (ctx);
+    mock_teardown ();
+
+    mock_setup ();
+    ctx = node_context_new ();
+    node_context_open (ctx, servers, G_N_ELEMENTS (servers) / 2);
+    g_assert_no_error (ctx->open_error);
+
+    /* CTL requests the node cannot serve */
+    g_assert_cmpuint (ctl_command (ctx, 0x0022, QMI_SERVICE_NAS, -1, NULL), ==, QMI_PROTOCOL_ERROR_INVALID_SERVICE_TYPE);
+    g_assert_cmpuint (ctl_command (ctx, 0x0022, QMI_SERVICE_CTL, -1, NULL), ==, QMI_PROTOCOL_ERROR_INVALID_SERVICE_TYPE);
+    g_assert_cmpuint (ctl_command (ctx, 0x0022, -1, -1, NULL), ==, QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE);
+    g_assert_cmpuint (ctl_command (ctx, 0x0023, QMI_SERVICE_DMS, -1, NULL), ==, QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE);
+    g_assert_cmpuint (ctl_command (ctx, 0x0023, QMI_SERVICE_DMS, 9, NULL), ==, QMI_PROTOCOL_ERROR_INVALID_CLIENT_ID);
+    g_assert_cmpuint (ctl_command (ctx, 0x0020, -1, -1, NULL), ==, QMI_PROTOCOL_ERROR_NOT_SUPPORTED);
+
+    /* Requests to services not in the node */
+    request = qmi_message_new (QMI_SERVICE_NAS, 1, 0x0100, 0x0020);
+    g_assert (!node_context_try_send (ctx, request, &error));
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_UNSUPPORTED);
+    g_clear_error (&error);
+    qmi_message_unref (request);
+
+    /* No sockets for new clients */
+    mock_socket_errno = EMFILE;
+    request = qmi_message_new (QMI_SERVICE_DMS, 1, 0x0200, 0x0020);
+    g_assert (!node_context_try_send (ctx, request, &error));
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED);
+    g_clear_error (&error);
+    g_test_expect_message (NULL, G_LOG_LEVEL_WARNING, "*Cannot create QRTR socket*");
+    g_assert_cmpuint (ctl_command (ctx, 0x0022, QMI_SERVICE_DMS, -1, NULL), ==, QMI_PROTOCOL_ERROR_INTERNAL);
+    g_test_assert_expected_messages ();
+    mock_socket_errno = 0;
+
+    /* Requests that cannot be sent are reported asynchronously, as they may
+     * be queued before failing */
+    mock_send_errno = EPIPE;
+    node_context_send (ctx, request);
+    g_assert_cmpuint (ctx->n_send_errors, ==, 1);
+    g_assert_error (ctx->send_error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED);
+    mock_send_errno = 0;
+    qmi_message_unref (request);
+
+    /* Reported once all the servers are gone */
+    g_test_expect_message (NULL, G_LOG_LEVEL_WARNING, "*No QMI services left*");
+    name_service_send (mock_wait_socket (0), QRTR_TYPE_DEL_SERVER, QMI_SERVICE_DMS, 1, MODEM_NODE, DMS_PORT);
+    node_context_wait (ctx, &ctx->n_removed, 1);
+    g_test_assert_expected_messages ();
+    g_assert_cmpuint (__qmi_qrtr_node_get_n_servers (ctx->node), ==, 0);
+
+    node_context_free (ctx);
+    mock_teardown ();
+}
+
+#endif /* HAVE_LINUX_QRTR_H */
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+#if defined HAVE_LINUX_QRTR_H
+    g_test_add_func ("/libqmi-glib/qrtr/parse-uri",       test_qrtr_parse_uri);
+    g_test_add_func ("/libqmi-glib/qrtr/servers",         test_qrtr_servers);
+    g_test_add_func ("/libqmi-glib/qrtr/errors",          test_qrtr_errors);
+    g_test_add_func ("/libqmi-glib/qrtr/io-thread",       test_qrtr_io_thread);
+    g_test_add_func ("/libqmi-glib/qrtr/close-in-flight", test_qrtr_close_in_flight);
+#endif
+
+    return g_test_run ();
+}
@@ -0,0 +1,413 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+/*
+ * Soak tests: the same workload of a client connecting to a simulated modem,
+ * sending requests, receiving indications and disconnecting, is run again and
+ * again, and every iteration must leave the same number of live objects as
+ * the previous one; so e.g. a transaction or a message leaked in every
+ * reconnection makes the test fail.
+ *
+ * Run with -m slow for many more iterations, which also checks that the
+ * resident memory of the process doesn't keep growing.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <unistd.h>
+#include <libqmi-glib.h>
+
+#include "test-port-context.h"
+#include "bench-common.h"
+
+#define N_WARMUP_ITERATIONS 3
+#define N_QUICK_ITERATIONS  50
+#define N_SLOW_ITERATIONS   1000
+#define N_REQUESTS          5
+#define N_INDICATIONS       5
+
+/* Allowed average growth of the resident memory per iteration in slow mode,
+ * to ignore allocator noise */
+#define MAX_RESIDENT_GROWTH_PER_ITERATION 256
+
+typedef struct {
+    TestPortContext *port;
+    QmiProxy        *proxy;
+    gchar           *proxy_path;
+
+    /* Only used in the simulated modem thread */
+    guint8           next_cid;
+} SoakContext;
+
+/*****************************************************************************/
+/* Simulated modem */
+
+static GByteArray *
+modem_respond (TestPortContext *port,
+               GByteArray      *request_raw,
+               SoakContext     *ctx)
+{
+    QmiMessage *request = (QmiMessage *) request_raw;
+    QmiMessage *response;
+    gsize       init_offset;
+    gsize       offset = 0;
+    guint8      service;
+    guint8      cid;
+
+    if ((qmi_message_get_service (request) == QMI_SERVICE_NAS &&
+         qmi_message_get_message_id (request) == 0x004F) ||
+        (qmi_message_get_service (request) == QMI_SERVICE_WDS &&
+         qmi_message_get_message_id (request) == 0x0024))
+        return bench_build_response (request);
+
+    response = qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+    if (qmi_message_get_service (request) != QMI_SERVICE_CTL)
+        return response;
+
+    switch (qmi_message_get_message_id (request)) {
+    case 0x0022: /* Allocate CID */
+        init_offset = qmi_message_tlv_read_init (request, 0x01, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint8 (request, init_offset, &offset, &service, NULL));
+        /* CIDs are reused, as in real devices */
+        if (++ctx->next_cid == QMI_CID_BROADCAST)
+            ctx->next_cid = 1;
+        cid = ctx->next_cid;
+        break;
+    case 0x0023: /* Release CID */
+        init_offset = qmi_message_tlv_read_init (request, 0x01, NULL, NULL);
+        g_assert (init_offset);
+        g_assert (qmi_message_tlv_read_guint8 (request, init_offset, &offset, &service, NULL));
+        g_assert (qmi_message_tlv_read_guint8 (request, init_offset, &offset, &cid, NULL));
+        break;
+    default:
+        /* e.g. internal proxy open, in direct mode */
+        return response;
+    }
+
+    init_offset = qmi_message_tlv_write_init (response, 0x01, NULL);
+    g_assert (init_offset);
+    g_assert (qmi_message_tlv_write_guint8 (response, service, NULL));
+    g_assert (qmi_message_tlv_write_guint8 (response, cid, NULL));
+    g_assert (qmi_message_tlv_write_complete (response, init_offset, NULL));
+    return response;
+}
+
+static gboolean
+modem_emit_indications (SoakContext *ctx)
+{
+    guint i;
+
+    for (i = 0; i < N_INDICATIONS; i++) {
+        QmiMessage *indication;
+
+        /* WDS Event Report, broadcast. There is no indication constructor, so
+         * just set the flag in the QMI service header of a new request */
+        indication = qmi_message_new (QMI_SERVICE_WDS, QMI_CID_BROADCAST, 0, 0x0001);
+        ((GByteArray *) indication)->data[6] |= 0x04;
+        test_port_context_write (ctx->port, indication->data, indication->len);
+        qmi_message_unref (indication);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/*****************************************************************************/
+/* Workload */
+
+static void
+async_ready (GObject       *source,
+             GAsyncResult  *res,
+             GAsyncResult **out)
+{
+    *out = g_object_ref (res);
+}
+
+/* Returns a full reference */
+static GAsyncResult *
+wait_async (GAsyncResult **res)
+{
+    while (!*res)
+        g_main_context_iteration (NULL, TRUE);
+    return *res;
+}
+
+static QmiClient *
+allocate_client (QmiDevice  *device,
+                 QmiService  service)
+{
+    GAsyncResult *res = NULL;
+    GError       *error = NULL;
+    QmiClient    *client;
+
+    qmi_device_allocate_client (device, service, QMI_CID_NONE, 10, NULL,
+                                (GAsyncReadyCallback) async_ready, &res);
+    client = qmi_device_allocate_client_finish (device, wait_async (&res), &error);
+    g_assert_no_error (error);
+    g_assert (QMI_IS_CLIENT (client));
+    g_object_unref (res);
+    return client;
+}
+
+static void
+release_client (QmiDevice *device,
+                QmiClient *client)
+{
+    GAsyncResult *res = NULL;
+    GError       *error = NULL;
+
+    qmi_device_release_client (device, client,
+                               QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID, 10, NULL,
+                               (GAsyncReadyCallback) async_ready, &res);
+    g_assert (qmi_device_release_client_finish (device, wait_async (&res), &error));
+    g_assert_no_error (error);
+    g_object_unref (res);
+    g_object_unref (client);
+}
+
+static void
+wds_event_report_cb (QmiClientWds                      *wds,
+                     QmiIndicationWdsEventReportOutput *output,
+                     guint                             *n_indications)
+{
+    (*n_indications)++;
+}
+
+static void
+run_iteration (SoakContext *ctx)
+{
+    GAsyncResult *res = NULL;
+    GError       *error = NULL;
+    GFile        *file;
+    QmiDevice    *device;
+    QmiClient    *nas;
+    QmiClient    *wds;
+    QmiMessageWdsGetPacketStatisticsInput *wds_input;
+    guint         n_indications = 0;
+    guint         i;
+
+    file = g_file_new_for_path (test_port_context_get_name (ctx->port));
+    if (ctx->proxy_path)
+        g_async_initable_new_async (QMI_TYPE_DEVICE, G_PRIORITY_DEFAULT, NULL,
+                                    (GAsyncReadyCallback) async_ready, &res,
+                                    QMI_DEVICE_FILE,          file,
+                                    QMI_DEVICE_NO_FILE_CHECK, TRUE,
+                                    QMI_DEVICE_PROXY_PATH,    ctx->proxy_path,
+                                    NULL);
+    else
+        g_async_initable_new_async (QMI_TYPE_DEVICE, G_PRIORITY_DEFAULT, NULL,
+                                    (GAsyncReadyCallback) async_ready, &res,
+                                    QMI_DEVICE_FILE,          file,
+                                    QMI_DEVICE_NO_FILE_CHECK, TRUE,
+                                    NULL);
+    g_object_unref (file);
+    device = qmi_device_new_finish (wait_async (&res), &error);
+    g_assert_no_error (error);
+    g_clear_object (&res);
+
+    qmi_device_open (device, QMI_DEVICE_OPEN_FLAGS_PROXY, 10, NULL,
+                     (GAsyncReadyCallback) async_ready, &res);
+    g_assert (qmi_device_open_finish (device, wait_async (&res), &error));
+    g_assert_no_error (error);
+    g_clear_object (&res);
+
+    nas = allocate_client (device, QMI_SERVICE_NAS);
+    wds = allocate_client (device, QMI_SERVICE_WDS);
+    g_signal_connect (wds, "event-report", G_CALLBACK (wds_event_report_cb), &n_indications);
+
+    wds_input = qmi_message_wds_get_packet_statistics_input_new ();
+    qmi_message_wds_get_packet_statistics_input_set_mask (wds_input, BENCH_WDS_PACKET_STATISTICS_MASK, NULL);
+    for (i = 0; i < N_REQUESTS; i++) {
+        QmiMessageNasGetSignalInfoOutput       *nas_output;
+        QmiMessageWdsGetPacketStatisticsOutput *wds_output;
+
+        qmi_client_nas_get_signal_info (QMI_CLIENT_NAS (nas), NULL, 10, NULL,
+                                        (GAsyncReadyCallback) async_ready, &res);
+        nas_output = qmi_client_nas_get_signal_info_finish (QMI_CLIENT_NAS (nas), wait_async (&res), &error);
+        g_assert_no_error (error);
+        g_assert (nas_output);
+        qmi_message_nas_get_signal_info_output_unref (nas_output);
+        g_clear_object (&res);
+
+        qmi_client_wds_get_packet_statistics (QMI_CLIENT_WDS (wds), wds_input, 10, NULL,
+                                              (GAsyncReadyCallback) async_ready, &res);
+        wds_output = qmi_client_wds_get_packet_statistics_finish (QMI_CLIENT_WDS (wds), wait_async (&res), &error);
+        g_assert_no_error (error);
+        g_assert (wds_output);
+        qmi_message_wds_get_packet_statistics_output_unref (wds_output);
+        g_clear_object (&res);
+    }
+    qmi_message_wds_get_packet_statistics_input_unref (wds_input);
+
+    test_port_context_invoke (ctx->port, (GSourceFunc) modem_emit_indications, ctx);
+    while (n_indications < N_INDICATIONS)
+        g_main_context_iteration (NULL, TRUE);
+    g_signal_handlers_disconnect_by_data (wds, &n_indications);
+
+    release_client (device, nas);
+    release_client (device, wds);
+
+    qmi_device_close_async (device, 10, NULL,
+                            (GAsyncReadyCallback) async_ready, &res);
+    g_assert (qmi_device_close_finish (device, wait_async (&res), &error));
+    g_assert_no_error (error);
+    g_clear_object (&res);
+    g_object_unref (device);
+}
+
+/* Cleanups may be still ongoing in idles, or in the proxy, so give them
+ * some time */
+static void
+assert_live_objects (const QmiUtilsLiveObjects *expected,
+                     guint                      iteration)
+{
+    QmiUtilsLiveObjects live;
+    gint64              deadline;
+
+    deadline = g_get_monotonic_time () + G_USEC_PER_SEC;
+    for (;;) {
+        qmi_utils_get_live_objects (&live);
+        if (!memcmp (&live, expected, sizeof (QmiUtilsLiveObjects)) ||
+            g_get_monotonic_time () > deadline)
+            break;
+        if (!g_main_context_iteration (NULL, FALSE))
+            g_usleep (1000);
+    }
+
+    if (memcmp (&live, expected, sizeof (QmiUtilsLiveObjects)))
+        g_test_message ("iteration %u left objects behind", iteration);
+    g_assert_cmpint (live.messages,       ==, expected->messages);
+    g_assert_cmpint (live.containers,     ==, expected->containers);
+    g_assert_cmpint (live.transactions,   ==, expected->transactions);
+    g_assert_cmpint (live.proxy_clients,  ==, expected->proxy_clients);
+    g_assert_cmpint (live.proxy_requests, ==, expected->proxy_requests);
+}
+
+static void
+run_soak (SoakContext *ctx)
+{
+    QmiUtilsLiveObjects baseline;
+    gsize               resident_start;
+    gsize               resident_end;
+    guint               n_iterations;
+    guint               i;
+
+    for (i = 0; i < N_WARMUP_ITERATIONS; i++)
+        run_iteration (ctx);
+
+    /* Let the cleanups of the warmup finish before taking the baseline */
+    g_usleep (100000);
+    while (g_main_context_iteration (NULL, FALSE));
+    qmi_utils_get_live_objects (&baseline);
+    resident_start = bench_get_resident_size ();
+
+    n_iterations = g_test_slow () ? N_SLOW_ITERATIONS : N_QUICK_ITERATIONS;
+    for (i = 0; i < n_iterations; i++) {
+        run_iteration (ctx);
+        assert_live_objects (&baseline, i);
+    }
+
+    /* Only reliable with enough iterations */
+    resident_end = bench_get_resident_size ();
+    if (g_test_slow () && resident_start && resident_end > resident_start)
+        g_assert_cmpuint ((resident_end - resident_start) / n_iterations, <=, MAX_RESIDENT_GROWTH_PER_ITERATION);
+}
+
+/*****************************************************************************/
+
+static void
+test_soak_direct (void)
+{
+    static guint num = 0;
+    SoakContext  ctx;
+
+    /* The simulated modem is the proxy itself */
+    memset (&ctx, 0, sizeof (SoakContext));
+    ctx.proxy_path = g_strdup_printf ("/dev/qmisoak%08lu%04u", (gulong) getpid (), num++);
+    ctx.port = test_port_context_new (ctx.proxy_path);
+    test_port_context_set_responder (ctx.port, (TestPortContextResponderFn) modem_respond, &ctx);
+    test_port_context_start (ctx.port);
+
+    run_soak (&ctx);
+
+    test_port_context_stop (ctx.port);
+    test_port_context_free (ctx.port);
+    g_free (ctx.proxy_path);
+}
+
+static void
+run_soak_proxy (guint    device_linger,
+                gboolean epoll)
+{
+    SoakContext  ctx;
+    GError      *error = NULL;
+
+    /* The simulated modem is reached by a proxy in this same process */
+    memset (&ctx, 0, sizeof (SoakContext));
+    ctx.proxy = qmi_proxy_new (&error);
+    if (!ctx.proxy) {
+        /* e.g. if there's already a proxy running in the system */
+        g_test_message ("skipped, couldn't create proxy: %s", error->message);
+        g_error_free (error);
+        return;
+    }
+    /* The device kept open between iterations is part of the baseline */
+    g_object_set (ctx.proxy,
+                  QMI_PROXY_DEVICE_LINGER, device_linger,
+                  QMI_PROXY_EPOLL,         epoll,
+                  NULL);
+    ctx.port = test_port_context_new_pty ();
+    test_port_context_set_responder (ctx.port, (TestPortContextResponderFn) modem_respond, &ctx);
+    test_port_context_start (ctx.port);
+
+    run_soak (&ctx);
+
+    g_object_unref (ctx.proxy);
+    test_port_context_stop (ctx.port);
+    test_port_context_free (ctx.port);
+}
+
+static void
+test_soak_proxy (void)
+{
+    run_soak_proxy (0, FALSE);
+}
+
+static void
+test_soak_proxy_linger (void)
+{
+    run_soak_proxy (60, FALSE);
+}
+
+static void
+test_soak_proxy_epoll (void)
+{
+    run_soak_proxy (0, TRUE);
+}
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    /* Before any object is created */
+    qmi_utils_set_accounting_enabled (TRUE);
+
+    g_test_add_func ("/libqmi-glib/soak/direct", test_soak_direct);
+    g_test_add_func ("/libqmi-glib/soak/proxy",  test_soak_proxy);
+    g_test_add_func ("/libqmi-glib/soak/proxy-linger", test_soak_proxy_linger);
+    g_test_add_func ("/libqmi-glib/soak/proxy-epoll",  test_soak_proxy_epoll);
+
+    return g_test_run ();
+}
@@ -0,0 +1,197 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <glib-object.h>
+#include <string.h>
+#include "qmi-trace.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+/* Record header plus "/dev/cdc-wdm0" and its NUL byte */
+#define RECORD_OVERHEAD (24 + 14)
+
+static void
+add_record (QmiTraceRing *ring,
+            gint64        timestamp,
+            guint8        value)
+{
+    QmiTraceRecord record;
+    guint8         raw[10];
+
+    memset (raw, value, sizeof (raw));
+    record.timestamp = timestamp;
+    record.latency = (timestamp % 2) ? -1 : timestamp * 10;
+    record.sent = (timestamp % 2);
+    record.path = "/dev/cdc-wdm0";
+    record.raw = raw;
+    record.raw_length = sizeof (raw);
+    qmi_trace_ring_add (ring, &record);
+}
+
+typedef struct {
+    guint  n_records;
+    gint64 timestamps[16];
+} CollectContext;
+
+static void
+collect_record (const QmiTraceRecord *record,
+                CollectContext       *ctx)
+{
+    guint i;
+
+    g_assert_cmpstr (record->path, ==, "/dev/cdc-wdm0");
+    g_assert_cmpuint (record->raw_length, ==, 10);
+    for (i = 0; i < record->raw_length; i++)
+        g_assert_cmpuint (record->raw[i], ==, (guint8) record->timestamp);
+    g_assert_cmpint (record->latency, ==, (record->timestamp % 2) ? -1 : record->timestamp * 10);
+    g_assert (record->sent == (record->timestamp % 2));
+
+    g_assert_cmpuint (ctx->n_records, <, G_N_ELEMENTS (ctx->timestamps));
+    ctx->timestamps[ctx->n_records++] = record->timestamp;
+}
+
+static void
+check_ring (QmiTraceRing *ring,
+            gint64        first,
+            gint64        last)
+{
+    CollectContext  ctx = { 0 };
+    GBytes         *bytes;
+    GError         *error = NULL;
+    gboolean        parsed;
+    guint           i;
+
+    bytes = qmi_trace_ring_dump (ring);
+    parsed = qmi_trace_foreach_record (g_bytes_get_data (bytes, NULL),
+                                       g_bytes_get_size (bytes),
+                                       (QmiTraceForeachRecordFn) collect_record,
+                                       &ctx,
+                                       &error);
+    g_assert_no_error (error);
+    g_assert (parsed);
+    g_bytes_unref (bytes);
+
+    g_assert_cmpuint (ctx.n_records, ==, last - first + 1);
+    for (i = 0; i < ctx.n_records; i++)
+        g_assert_cmpint (ctx.timestamps[i], ==, first + i);
+}
+
+static void
+test_trace_ring_wrap (void)
+{
+    QmiTraceRing *ring;
+    gint64        i;
+
+    /* Room for 3 records and a half */
+    ring = qmi_trace_ring_new (3 * (RECORD_OVERHEAD + 10) + (RECORD_OVERHEAD + 10) / 2, 0);
+
+    add_record (ring, 1, 1);
+    add_record (ring, 2, 2);
+    check_ring (ring, 1, 2);
+
+    /* Oldest records dropped, the newest ones wrapping around the end */
+    for (i = 3; i <= 10; i++) {
+        add_record (ring, i, (guint8) i);
+        check_ring (ring, MAX (1, i - 2), i);
+    }
+
+    qmi_trace_ring_unref (ring);
+}
+
+static void
+test_trace_ring_max_age (void)
+{
+    QmiTraceRing *ring;
+
+    ring = qmi_trace_ring_new (4096, 1);
+
+    add_record (ring, 1, 1);
+    add_record (ring, 2, 2);
+    check_ring (ring, 1, 2);
+
+    /* One second later than the first record, still kept */
+    add_record (ring, 1 + G_USEC_PER_SEC, (guint8) (1 + G_USEC_PER_SEC));
+    {
+        CollectContext  ctx = { 0 };
+        GBytes         *bytes;
+
+        bytes = qmi_trace_ring_dump (ring);
+        g_assert (qmi_trace_foreach_record (g_bytes_get_data (bytes, NULL),
+                                            g_bytes_get_size (bytes),
+                                            (QmiTraceForeachRecordFn) collect_record,
+                                            &ctx,
+                                            NULL));
+        g_bytes_unref (bytes);
+        g_assert_cmpuint (ctx.n_records, ==, 3);
+    }
+
+    /* More than one second later than the first two records */
+    add_record (ring, 3 + G_USEC_PER_SEC, (guint8) (3 + G_USEC_PER_SEC));
+    {
+        CollectContext  ctx = { 0 };
+        GBytes         *bytes;
+
+        bytes = qmi_trace_ring_dump (ring);
+        g_assert (qmi_trace_foreach_record (g_bytes_get_data (bytes, NULL),
+                                            g_bytes_get_size (bytes),
+                                            (QmiTraceForeachRecordFn) collect_record,
+                                            &ctx,
+                                            NULL));
+        g_bytes_unref (bytes);
+        g_assert_cmpuint (ctx.n_records, ==, 2);
+        g_assert_cmpint (ctx.timestamps[0], ==, 1 + G_USEC_PER_SEC);
+        g_assert_cmpint (ctx.timestamps[1], ==, 3 + G_USEC_PER_SEC);
+    }
+
+    qmi_trace_ring_unref (ring);
+}
+
+static void
+test_trace_invalid (void)
+{
+    static const guint8 not_a_trace[] = "NOTATRACE-AT-ALL";
+    static const guint8 truncated[] = {
+        'Q', 'M', 'I', 'T', 'R', 'A', 'C', 'E',
+        0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0xFF, 0x00, 0x00, 0x00
+    };
+    CollectContext ctx = { 0 };
+    GError        *error = NULL;
+
+    g_assert (!qmi_trace_foreach_record (not_a_trace, sizeof (not_a_trace),
+                                         (QmiTraceForeachRecordFn) collect_record, &ctx,
+                                         &error));
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS);
+    g_clear_error (&error);
+
+    g_assert (!qmi_trace_foreach_record (truncated, sizeof (truncated),
+                                         (QmiTraceForeachRecordFn) collect_record, &ctx,
+                                         &error));
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_MESSAGE);
+    g_clear_error (&error);
+
+    g_assert_cmpuint (ctx.n_records, ==, 0);
+}
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/libqmi-glib/trace/ring-wrap",    test_trace_ring_wrap);
+    g_test_add_func ("/libqmi-glib/trace/ring-max-age", test_trace_ring_max_age);
+    g_test_add_func ("/libqmi-glib/trace/invalid",      test_trace_invalid);
+
+    return g_test_run ();
+}
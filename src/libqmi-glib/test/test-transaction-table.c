@@ -0,0 +1,292 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+
+#include <glib.h>
+#include "qmi-transaction-table.h"
+
+/* Same layout as the keys built by the device */
+#define KEY(service, client_id, transaction_id) \
+    ((guint32)((((service) << 8) | (client_id)) << 16) | (transaction_id))
+
+/* Values only need to be non-NULL and distinct */
+#define VALUE(i) GUINT_TO_POINTER ((i) + 1)
+
+/* Find @n_keys keys all with the home slot @slot, for the current size of
+ * the table */
+static void
+find_colliding_keys (const QmiTransactionTable *table,
+                     guint                      slot,
+                     guint32                   *keys,
+                     guint                      n_keys)
+{
+    guint32 key;
+    guint   n = 0;
+
+    for (key = 1; n < n_keys; key++) {
+        if (__qmi_transaction_table_slot (table, key) == slot)
+            keys[n++] = key;
+    }
+}
+
+static void
+assert_table_consistent (const QmiTransactionTable *table)
+{
+    guint i;
+    guint n = 0;
+
+    g_assert_cmpuint (table->size, ==, 1u << table->log2_size);
+    g_assert_cmpuint (table->n_items * 2, <=, table->size);
+
+    for (i = 0; i < table->size; i++) {
+        guint home;
+        guint j;
+
+        if (!table->entries[i].value)
+            continue;
+        n++;
+
+        /* No empty slot between an entry and its home slot, or else lookups
+         * would stop before reaching it */
+        home = __qmi_transaction_table_slot (table, table->entries[i].key);
+        for (j = home; j != i; j = (j + 1) & (table->size - 1))
+            g_assert (table->entries[j].value != NULL);
+
+        g_assert (__qmi_transaction_table_lookup (table, table->entries[i].key) == table->entries[i].value);
+    }
+    g_assert_cmpuint (n, ==, table->n_items);
+}
+
+static void
+test_transaction_table_empty (void)
+{
+    QmiTransactionTable table = { 0 };
+
+    g_assert (__qmi_transaction_table_lookup (&table, KEY (1, 1, 1)) == NULL);
+    g_assert (__qmi_transaction_table_remove (&table, KEY (1, 1, 1)) == NULL);
+
+    __qmi_transaction_table_insert (&table, KEY (1, 1, 1), VALUE (1));
+    g_assert_cmpuint (table.size, ==, 16);
+    g_assert_cmpuint (table.log2_size, ==, 4);
+    g_assert_cmpuint (table.n_items, ==, 1);
+
+    /* Inserting the same key again replaces the value */
+    __qmi_transaction_table_insert (&table, KEY (1, 1, 1), VALUE (2));
+    g_assert_cmpuint (table.n_items, ==, 1);
+    g_assert (__qmi_transaction_table_lookup (&table, KEY (1, 1, 1)) == VALUE (2));
+
+    g_assert (__qmi_transaction_table_remove (&table, KEY (1, 1, 1)) == VALUE (2));
+    g_assert_cmpuint (table.n_items, ==, 0);
+    g_assert (__qmi_transaction_table_lookup (&table, KEY (1, 1, 1)) == NULL);
+
+    __qmi_transaction_table_clear (&table);
+    g_assert (table.entries == NULL);
+}
+
+static void
+test_transaction_table_spread (void)
+{
+    QmiTransactionTable  table = { 0 };
+    guint                service;
+    guint                client_id;
+    gboolean             used[16] = { FALSE };
+    guint                n_used = 0;
+    guint                i;
+
+    __qmi_transaction_table_insert (&table, KEY (0, 0, 1), VALUE (0));
+    g_assert_cmpuint (table.size, ==, G_N_ELEMENTS (used));
+
+    /* Keys with the same transaction id and different services or clients
+     * must not all land in the same slot, as they would if only the low bits
+     * of the hash were used */
+    for (service = 1; service < 32; service++) {
+        for (client_id = 1; client_id < 8; client_id++)
+            used[__qmi_transaction_table_slot (&table, KEY (service, client_id, 1))] = TRUE;
+    }
+    for (i = 0; i < G_N_ELEMENTS (used); i++)
+        n_used += used[i];
+    g_assert_cmpuint (n_used, >, G_N_ELEMENTS (used) / 2);
+
+    __qmi_transaction_table_clear (&table);
+}
+
+static void
+common_test_collisions (guint slot)
+{
+    QmiTransactionTable table = { 0 };
+    guint32             keys[6];
+    guint               i;
+
+    /* Force the size to 16 so that the keys found collide */
+    __qmi_transaction_table_insert (&table, 0, VALUE (100));
+    g_assert (__qmi_transaction_table_remove (&table, 0) == VALUE (100));
+    g_assert_cmpuint (table.size, ==, 16);
+
+    find_colliding_keys (&table, slot, keys, G_N_ELEMENTS (keys));
+    for (i = 0; i < G_N_ELEMENTS (keys); i++)
+        __qmi_transaction_table_insert (&table, keys[i], VALUE (i));
+    /* Still under half full, so no growth happened */
+    g_assert_cmpuint (table.size, ==, 16);
+    assert_table_consistent (&table);
+
+    /* All in one single cluster starting at the home slot */
+    for (i = 0; i < G_N_ELEMENTS (keys); i++) {
+        g_assert (table.entries[(slot + i) & (table.size - 1)].key == keys[i]);
+        g_assert (__qmi_transaction_table_lookup (&table, keys[i]) == VALUE (i));
+    }
+
+    /* Removing the head of the cluster shifts back all the others */
+    g_assert (__qmi_transaction_table_remove (&table, keys[0]) == VALUE (0));
+    assert_table_consistent (&table);
+    g_assert (__qmi_transaction_table_lookup (&table, keys[0]) == NULL);
+    for (i = 1; i < G_N_ELEMENTS (keys); i++)
+        g_assert (table.entries[(slot + i - 1) & (table.size - 1)].key == keys[i]);
+    g_assert (table.entries[(slot + G_N_ELEMENTS (keys) - 1) & (table.size - 1)].value == NULL);
+
+    /* Removing from the middle keeps the tail reachable */
+    g_assert (__qmi_transaction_table_remove (&table, keys[3]) == VALUE (3));
+    assert_table_consistent (&table);
+    g_assert (__qmi_transaction_table_lookup (&table, keys[3]) == NULL);
+    g_assert (__qmi_transaction_table_lookup (&table, keys[4]) == VALUE (4));
+    g_assert (__qmi_transaction_table_lookup (&table, keys[5]) == VALUE (5));
+
+    /* Removing a key not in the table, but with the same home, changes nothing */
+    g_assert (__qmi_transaction_table_remove (&table, keys[0]) == NULL);
+    g_assert_cmpuint (table.n_items, ==, 4);
+
+    /* And the slots freed are reused */
+    __qmi_transaction_table_insert (&table, keys[0], VALUE (0));
+    __qmi_transaction_table_insert (&table, keys[3], VALUE (3));
+    assert_table_consistent (&table);
+    for (i = 0; i < G_N_ELEMENTS (keys); i++)
+        g_assert (__qmi_transaction_table_lookup (&table, keys[i]) == VALUE (i));
+
+    for (i = 0; i < G_N_ELEMENTS (keys); i++) {
+        g_assert (__qmi_transaction_table_remove (&table, keys[i]) == VALUE (i));
+        assert_table_consistent (&table);
+    }
+    g_assert_cmpuint (table.n_items, ==, 0);
+
+    __qmi_transaction_table_clear (&table);
+}
+
+static void
+test_transaction_table_collisions (void)
+{
+    common_test_collisions (3);
+}
+
+static void
+test_transaction_table_collisions_wrap (void)
+{
+    /* The cluster wraps around the end of the table */
+    common_test_collisions (14);
+}
+
+static void
+test_transaction_table_mixed_clusters (void)
+{
+    QmiTransactionTable table = { 0 };
+    guint32             keys_a[3];
+    guint32             keys_b[3];
+
+    __qmi_transaction_table_insert (&table, 0, VALUE (100));
+    g_assert (__qmi_transaction_table_remove (&table, 0) == VALUE (100));
+
+    /* Two adjacent home slots, so that the clusters merge; entries of the
+     * second one must only be shifted back up to their own home slot */
+    find_colliding_keys (&table, 5, keys_a, G_N_ELEMENTS (keys_a));
+    find_colliding_keys (&table, 6, keys_b, G_N_ELEMENTS (keys_b));
+
+    __qmi_transaction_table_insert (&table, keys_a[0], VALUE (0));
+    __qmi_transaction_table_insert (&table, keys_b[0], VALUE (10));
+    __qmi_transaction_table_insert (&table, keys_a[1], VALUE (1));
+    __qmi_transaction_table_insert (&table, keys_b[1], VALUE (11));
+    __qmi_transaction_table_insert (&table, keys_a[2], VALUE (2));
+    __qmi_transaction_table_insert (&table, keys_b[2], VALUE (12));
+    assert_table_consistent (&table);
+
+    g_assert (__qmi_transaction_table_remove (&table, keys_b[0]) == VALUE (10));
+    assert_table_consistent (&table);
+    g_assert (__qmi_transaction_table_remove (&table, keys_a[0]) == VALUE (0));
+    assert_table_consistent (&table);
+    g_assert (__qmi_transaction_table_lookup (&table, keys_a[1]) == VALUE (1));
+    g_assert (__qmi_transaction_table_lookup (&table, keys_a[2]) == VALUE (2));
+    g_assert (__qmi_transaction_table_lookup (&table, keys_b[1]) == VALUE (11));
+    g_assert (__qmi_transaction_table_lookup (&table, keys_b[2]) == VALUE (12));
+    /* A key is never moved before its home slot */
+    g_assert (table.entries[5].key != keys_b[1] && table.entries[5].key != keys_b[2]);
+
+    __qmi_transaction_table_clear (&table);
+}
+
+static void
+test_transaction_table_growth (void)
+{
+    QmiTransactionTable table = { 0 };
+    guint               service;
+    guint               transaction_id;
+    guint               n = 0;
+
+    /* Several clients with the same transaction ids, as happens when many
+     * clients of different services run requests at the same time */
+    for (service = 1; service <= 8; service++) {
+        for (transaction_id = 1; transaction_id <= 128; transaction_id++) {
+            __qmi_transaction_table_insert (&table, KEY (service, 1, transaction_id), VALUE (n));
+            n++;
+        }
+    }
+    g_assert_cmpuint (table.n_items, ==, n);
+    g_assert_cmpuint (table.size, ==, 2048);
+    g_assert_cmpuint (table.log2_size, ==, 11);
+    assert_table_consistent (&table);
+
+    /* Remove every other one, the rest must still be found */
+    n = 0;
+    for (service = 1; service <= 8; service++) {
+        for (transaction_id = 1; transaction_id <= 128; transaction_id++) {
+            if (n % 2)
+                g_assert (__qmi_transaction_table_remove (&table, KEY (service, 1, transaction_id)) == VALUE (n));
+            n++;
+        }
+    }
+    assert_table_consistent (&table);
+
+    n = 0;
+    for (service = 1; service <= 8; service++) {
+        for (transaction_id = 1; transaction_id <= 128; transaction_id++) {
+            g_assert (__qmi_transaction_table_lookup (&table, KEY (service, 1, transaction_id)) ==
+                      ((n % 2) ? NULL : VALUE (n)));
+            n++;
+        }
+    }
+    g_assert_cmpuint (table.n_items, ==, n / 2);
+
+    __qmi_transaction_table_clear (&table);
+}
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/libqmi-glib/transaction-table/empty",          test_transaction_table_empty);
+    g_test_add_func ("/libqmi-glib/transaction-table/spread",         test_transaction_table_spread);
+    g_test_add_func ("/libqmi-glib/transaction-table/collisions",     test_transaction_table_collisions);
+    g_test_add_func ("/libqmi-glib/transaction-table/collisions-wrap", test_transaction_table_collisions_wrap);
+    g_test_add_func ("/libqmi-glib/transaction-table/mixed-clusters", test_transaction_table_mixed_clusters);
+    g_test_add_func ("/libqmi-glib/transaction-table/growth",         test_transaction_table_growth);
+
+    return g_test_run ();
+}
@@ -16,6 +16,8 @@
 #include <glib-object.h>
 #include <string.h>
 #include "qmi-utils.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
 
 static void
 test_utils_uint8 (void)
@@ -1209,6 +1211,98 @@ test_utils_uint_sized_8_unaligned_be (void)
     common_test_utils_uint_sized_unaligned_be (8);
 }
 
+static void
+test_utils_uint_arrays (void)
+{
+    static const guint8 in_buffer[16] = {
+        0x0F, 0x50, 0xEB, 0xE2, 0xB6, 0x00, 0x00, 0x00,
+        0x50, 0x0F, 0xE2, 0xEB, 0x00, 0xB6, 0x00, 0x00
+    };
+    guint16 values16[4];
+    guint32 values32[2];
+    guint64 values64[1];
+    guint16 in_buffer_size;
+    const guint8 *in_buffer_walker;
+
+    in_buffer_size = sizeof (in_buffer);
+    in_buffer_walker = &in_buffer[0];
+
+    qmi_utils_read_guint16_array_from_buffer (&in_buffer_walker, &in_buffer_size, QMI_ENDIAN_LITTLE, 4, values16);
+    g_assert_cmpuint (values16[0], ==, 0x500F);
+    g_assert_cmpuint (values16[1], ==, 0xE2EB);
+    g_assert_cmpuint (values16[2], ==, 0x00B6);
+    g_assert_cmpuint (values16[3], ==, 0x0000);
+    g_assert_cmpuint (in_buffer_size, ==, 8);
+
+    qmi_utils_read_guint32_array_from_buffer (&in_buffer_walker, &in_buffer_size, QMI_ENDIAN_BIG, 2, values32);
+    g_assert_cmpuint (values32[0], ==, 0x500FE2EB);
+    g_assert_cmpuint (values32[1], ==, 0x00B60000);
+    g_assert_cmpuint (in_buffer_size, ==, 0);
+
+    /* Nothing to read */
+    qmi_utils_read_guint64_array_from_buffer (&in_buffer_walker, &in_buffer_size, QMI_ENDIAN_LITTLE, 0, NULL);
+    g_assert_cmpuint (in_buffer_size, ==, 0);
+
+    in_buffer_size = 8;
+    in_buffer_walker = &in_buffer[8];
+    qmi_utils_read_guint64_array_from_buffer (&in_buffer_walker, &in_buffer_size, QMI_ENDIAN_BIG, 1, values64);
+    g_assert_cmpuint (values64[0], ==, G_GUINT64_CONSTANT (0x500FE2EB00B60000));
+    g_assert_cmpuint (in_buffer_size, ==, 0);
+}
+
+static void
+test_utils_traces_filter (void)
+{
+    GError *error = NULL;
+    gchar  *str;
+
+    /* No filter, everything traced */
+    g_assert (qmi_utils_traces_filter_check ("/dev/cdc-wdm0", QMI_SERVICE_WDS, 0x0020, TRUE));
+
+    g_assert (qmi_utils_set_traces_filter ("service=wds,nas; message=0x20,36; device=/dev/cdc-wdm3; direction=sent", &error));
+    g_assert_no_error (error);
+    str = qmi_utils_get_traces_filter ();
+    g_assert_cmpstr (str, ==, "service=wds,nas; message=0x20,36; device=/dev/cdc-wdm3; direction=sent");
+    g_free (str);
+
+    g_assert (qmi_utils_traces_filter_check ("/dev/cdc-wdm3", QMI_SERVICE_WDS, 0x0020, TRUE));
+    g_assert (qmi_utils_traces_filter_check ("/dev/cdc-wdm3", QMI_SERVICE_NAS, 0x0024, TRUE));
+    g_assert (!qmi_utils_traces_filter_check ("/dev/cdc-wdm3", QMI_SERVICE_DMS, 0x0020, TRUE));
+    g_assert (!qmi_utils_traces_filter_check ("/dev/cdc-wdm3", QMI_SERVICE_WDS, 0x0021, TRUE));
+    g_assert (!qmi_utils_traces_filter_check ("/dev/cdc-wdm3", QMI_SERVICE_WDS, 0x0020, FALSE));
+    g_assert (!qmi_utils_traces_filter_check ("/dev/cdc-wdm4", QMI_SERVICE_WDS, 0x0020, TRUE));
+
+    /* One of every three messages */
+    g_assert (qmi_utils_set_traces_filter ("service=2;device=*wdm*;sample=3", &error));
+    g_assert_no_error (error);
+    g_assert (qmi_utils_traces_filter_check ("/dev/cdc-wdm0", QMI_SERVICE_DMS, 0x0001, FALSE));
+    g_assert (!qmi_utils_traces_filter_check ("/dev/cdc-wdm0", QMI_SERVICE_DMS, 0x0001, FALSE));
+    g_assert (!qmi_utils_traces_filter_check ("/dev/cdc-wdm0", QMI_SERVICE_DMS, 0x0001, FALSE));
+    g_assert (qmi_utils_traces_filter_check ("/dev/cdc-wdm0", QMI_SERVICE_DMS, 0x0001, FALSE));
+
+    /* Invalid filters keep the previous one */
+    g_assert (!qmi_utils_set_traces_filter ("service=foo", &error));
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS);
+    g_clear_error (&error);
+    g_assert (!qmi_utils_set_traces_filter ("message=0x10000", &error));
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS);
+    g_clear_error (&error);
+    g_assert (!qmi_utils_set_traces_filter ("sample=0", &error));
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS);
+    g_clear_error (&error);
+    g_assert (!qmi_utils_set_traces_filter ("direction", &error));
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS);
+    g_clear_error (&error);
+    str = qmi_utils_get_traces_filter ();
+    g_assert_cmpstr (str, ==, "service=2;device=*wdm*;sample=3");
+    g_free (str);
+
+    g_assert (qmi_utils_set_traces_filter (NULL, &error));
+    g_assert_no_error (error);
+    g_assert (!qmi_utils_get_traces_filter ());
+    g_assert (qmi_utils_traces_filter_check (NULL, QMI_SERVICE_WDS, 0x0020, TRUE));
+}
+
 int main (int argc, char **argv)
 {
     g_test_init (&argc, &argv, NULL);
@@ -1260,5 +1354,9 @@ int main (int argc, char **argv)
     g_test_add_func ("/libqmi-glib/utils/uint-sized-4-unaligned-BE", test_utils_uint_sized_4_unaligned_be);
     g_test_add_func ("/libqmi-glib/utils/uint-sized-8-unaligned-BE", test_utils_uint_sized_8_unaligned_be);
 
+    g_test_add_func ("/libqmi-glib/utils/uint-arrays", test_utils_uint_arrays);
+
+    g_test_add_func ("/libqmi-glib/utils/traces-filter", test_utils_traces_filter);
+
     return g_test_run ();
 }
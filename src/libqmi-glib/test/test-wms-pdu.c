@@ -0,0 +1,207 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <glib-object.h>
+#include <string.h>
+#include "qmi-wms-pdu.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+/*****************************************************************************/
+
+/* SMSC +31624000000, from +31641600986: "How are you?" */
+static const guint8 pdu_deliver[] = {
+    0x07, 0x91, 0x13, 0x26, 0x04, 0x00, 0x00, 0xF0, 0x04, 0x0B, 0x91, 0x13, 0x46, 0x61, 0x00, 0x89,
+    0xF6, 0x00, 0x00, 0x20, 0x80, 0x62, 0x91, 0x73, 0x14, 0x80, 0x0C, 0xC8, 0xF7, 0x1D, 0x14, 0x96,
+    0x97, 0x41, 0xF9, 0x77, 0xFD, 0x07
+};
+
+/* No SMSC, from "Info": "Hello " and "world{}", reference 0x2A */
+static const guint8 pdu_concat_1[] = {
+    0x00, 0x44, 0x08, 0xD0, 0x49, 0xB7, 0xF9, 0x0D, 0x00, 0x00, 0x81, 0x10, 0x20, 0x30, 0x40, 0x50,
+    0x4A, 0x0D, 0x05, 0x00, 0x03, 0x2A, 0x02, 0x01, 0x90, 0x65, 0x36, 0xFB, 0x0D, 0x02
+};
+static const guint8 pdu_concat_2[] = {
+    0x00, 0x44, 0x08, 0xD0, 0x49, 0xB7, 0xF9, 0x0D, 0x00, 0x00, 0x81, 0x10, 0x20, 0x30, 0x40, 0x50,
+    0x4A, 0x10, 0x05, 0x00, 0x03, 0x2A, 0x02, 0x02, 0xEE, 0x6F, 0x39, 0x9B, 0xBC, 0x41, 0x6D, 0x52
+};
+
+/* No SMSC, to 1234567 with relative validity: "Привет €" in UCS-2, single
+ * part with a 16-bit reference */
+static const guint8 pdu_submit[] = {
+    0x00, 0x51, 0x07, 0x07, 0x81, 0x21, 0x43, 0x65, 0xF7, 0x00, 0x08, 0xA7, 0x17, 0x06, 0x08, 0x04,
+    0x12, 0x34, 0x01, 0x01, 0x04, 0x1F, 0x04, 0x40, 0x04, 0x38, 0x04, 0x32, 0x04, 0x35, 0x04, 0x42,
+    0x00, 0x20, 0x20, 0xAC
+};
+
+/* SMSC +4412, for +447700900123, delivered */
+static const guint8 pdu_status_report[] = {
+    0x03, 0x91, 0x44, 0x21, 0x06, 0x07, 0x0C, 0x91, 0x44, 0x77, 0x00, 0x09, 0x10, 0x32, 0x81, 0x21,
+    0x13, 0x32, 0x95, 0x85, 0x40, 0x91, 0x10, 0x10, 0x00, 0x00, 0x10, 0x40, 0x00
+};
+
+/*****************************************************************************/
+
+static void
+test_wms_pdu_deliver (void)
+{
+    QmiWmsPduView view;
+    GError       *error = NULL;
+    gchar         address[QMI_WMS_PDU_ADDRESS_MAX_SIZE];
+    gchar         text[QMI_WMS_PDU_TEXT_MAX_SIZE];
+
+    g_assert (qmi_wms_pdu_view_init (&view, pdu_deliver, sizeof (pdu_deliver), &error));
+    g_assert_no_error (error);
+
+    g_assert_cmpuint (view.type, ==, QMI_WMS_PDU_TYPE_DELIVER);
+    qmi_wms_pdu_address_to_string (&view.smsc, address, sizeof (address));
+    g_assert_cmpstr (address, ==, "+31624000000");
+    qmi_wms_pdu_address_to_string (&view.address, address, sizeof (address));
+    g_assert_cmpstr (address, ==, "+31641600986");
+
+    g_assert_cmpuint (view.encoding, ==, QMI_WMS_PDU_ENCODING_GSM7);
+    g_assert_cmpuint (view.timestamp.year, ==, 2);
+    g_assert_cmpuint (view.timestamp.month, ==, 8);
+    g_assert_cmpuint (view.timestamp.day, ==, 26);
+    g_assert_cmpuint (view.timestamp.hour, ==, 19);
+    g_assert_cmpuint (view.timestamp.minute, ==, 37);
+    g_assert_cmpuint (view.timestamp.second, ==, 41);
+    g_assert_cmpint (view.timestamp.timezone, ==, 8);
+    g_assert (!view.concatenated);
+
+    /* The view refers to the given data */
+    g_assert (view.user_data == &pdu_deliver[27]);
+    g_assert_cmpuint (qmi_wms_pdu_view_get_text (&view, text, sizeof (text)), ==, 12);
+    g_assert_cmpstr (text, ==, "How are you?");
+}
+
+static void
+test_wms_pdu_submit (void)
+{
+    QmiWmsPduView view;
+    GError       *error = NULL;
+    gchar         address[QMI_WMS_PDU_ADDRESS_MAX_SIZE];
+    gchar         text[QMI_WMS_PDU_TEXT_MAX_SIZE];
+
+    g_assert (qmi_wms_pdu_view_init (&view, pdu_submit, sizeof (pdu_submit), &error));
+    g_assert_no_error (error);
+
+    g_assert_cmpuint (view.type, ==, QMI_WMS_PDU_TYPE_SUBMIT);
+    g_assert (view.smsc.value == NULL);
+    g_assert_cmpuint (view.message_reference, ==, 0x07);
+    qmi_wms_pdu_address_to_string (&view.address, address, sizeof (address));
+    g_assert_cmpstr (address, ==, "1234567");
+
+    g_assert_cmpuint (view.encoding, ==, QMI_WMS_PDU_ENCODING_UCS2);
+    g_assert (view.concatenated);
+    g_assert_cmpuint (view.concat_reference, ==, 0x1234);
+    g_assert_cmpuint (view.concat_total, ==, 1);
+    g_assert_cmpuint (view.concat_sequence, ==, 1);
+
+    qmi_wms_pdu_view_get_text (&view, text, sizeof (text));
+    g_assert_cmpstr (text, ==, "Привет €");
+}
+
+static void
+test_wms_pdu_status_report (void)
+{
+    QmiWmsPduView view;
+    GError       *error = NULL;
+    gchar         address[QMI_WMS_PDU_ADDRESS_MAX_SIZE];
+
+    g_assert (qmi_wms_pdu_view_init (&view, pdu_status_report, sizeof (pdu_status_report), &error));
+    g_assert_no_error (error);
+
+    g_assert_cmpuint (view.type, ==, QMI_WMS_PDU_TYPE_STATUS_REPORT);
+    qmi_wms_pdu_address_to_string (&view.smsc, address, sizeof (address));
+    g_assert_cmpstr (address, ==, "+4412");
+    g_assert_cmpuint (view.message_reference, ==, 0x07);
+    qmi_wms_pdu_address_to_string (&view.address, address, sizeof (address));
+    g_assert_cmpstr (address, ==, "+447700900123");
+    g_assert_cmpuint (view.timestamp.year, ==, 18);
+    g_assert_cmpuint (view.discharge_time.year, ==, 19);
+    g_assert_cmpuint (view.discharge_time.second, ==, 1);
+    g_assert_cmpuint (view.status, ==, 0x00);
+    g_assert (view.user_data == NULL);
+}
+
+static void
+test_wms_pdu_invalid (void)
+{
+    QmiWmsPduView view;
+    GError       *error = NULL;
+    gsize         i;
+
+    /* Every truncated PDU fails */
+    for (i = 0; i < sizeof (pdu_deliver); i++) {
+        g_assert (!qmi_wms_pdu_view_init (&view, pdu_deliver, i, &error));
+        g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_MESSAGE);
+        g_clear_error (&error);
+    }
+}
+
+static void
+test_wms_pdu_assembler (void)
+{
+    QmiWmsPduAssembler *assembler;
+    QmiWmsPduView       view;
+    gchar              *text = NULL;
+    gchar               address[QMI_WMS_PDU_ADDRESS_MAX_SIZE];
+
+    assembler = qmi_wms_pdu_assembler_new (0);
+
+    /* Parts in reverse order */
+    g_assert (qmi_wms_pdu_view_init (&view, pdu_concat_2, sizeof (pdu_concat_2), NULL));
+    g_assert (view.concatenated);
+    g_assert_cmpuint (view.concat_reference, ==, 0x2A);
+    g_assert_cmpuint (view.concat_sequence, ==, 2);
+    g_assert_cmpint (view.timestamp.timezone, ==, -24);
+    qmi_wms_pdu_address_to_string (&view.address, address, sizeof (address));
+    g_assert_cmpstr (address, ==, "Info");
+    g_assert (!qmi_wms_pdu_assembler_add (assembler, &view, &text));
+    g_assert_cmpuint (qmi_wms_pdu_assembler_get_n_pending (assembler), ==, 1);
+
+    /* Duplicates are ignored */
+    g_assert (!qmi_wms_pdu_assembler_add (assembler, &view, &text));
+
+    g_assert (qmi_wms_pdu_view_init (&view, pdu_concat_1, sizeof (pdu_concat_1), NULL));
+    g_assert (qmi_wms_pdu_assembler_add (assembler, &view, &text));
+    g_assert_cmpstr (text, ==, "Hello world{}");
+    g_free (text);
+    g_assert_cmpuint (qmi_wms_pdu_assembler_get_n_pending (assembler), ==, 0);
+
+    /* Not concatenated */
+    g_assert (qmi_wms_pdu_view_init (&view, pdu_deliver, sizeof (pdu_deliver), NULL));
+    g_assert (qmi_wms_pdu_assembler_add (assembler, &view, &text));
+    g_assert_cmpstr (text, ==, "How are you?");
+    g_free (text);
+
+    qmi_wms_pdu_assembler_unref (assembler);
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/libqmi-glib/wms-pdu/deliver",       test_wms_pdu_deliver);
+    g_test_add_func ("/libqmi-glib/wms-pdu/submit",        test_wms_pdu_submit);
+    g_test_add_func ("/libqmi-glib/wms-pdu/status-report", test_wms_pdu_status_report);
+    g_test_add_func ("/libqmi-glib/wms-pdu/invalid",       test_wms_pdu_invalid);
+    g_test_add_func ("/libqmi-glib/wms-pdu/assembler",     test_wms_pdu_assembler);
+
+    return g_test_run ();
+}
@@ -0,0 +1,777 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * qmi-decode -- Offline decoder of captured QMI traffic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+/*
+ * Decodes the QMI messages found in one or more captures, which may be:
+ *  - pcap or pcapng captures of usbmon (e.g. from tcpdump -i usbmon1 or
+ *    Wireshark), from which the CDC-WDM control transfers are extracted:
+ *    the data of the SEND_ENCAPSULATED_COMMAND submissions as messages sent,
+ *    and the data of the GET_ENCAPSULATED_RESPONSE completions as messages
+ *    received.
+ *  - binary traces, as recorded with qmicli or qmi-proxy --trace-record.
+ *
+ * All the captures are read first, and their records merged by time. The
+ * records are then decoded in a pool of worker threads, straight from the
+ * mapped files, and printed in order as soon as each one is ready.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <locale.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <libqmi-glib.h>
+
+#define PROGRAM_NAME    "qmi-decode"
+#define PROGRAM_VERSION PACKAGE_VERSION
+
+/* pcap magic numbers, as read in the file byte order */
+#define PCAP_MAGIC_USEC         0xa1b2c3d4
+#define PCAP_MAGIC_NSEC         0xa1b23c4d
+#define PCAPNG_BLOCK_SHB        0x0a0d0d0a
+#define PCAPNG_BLOCK_IDB        0x00000001
+#define PCAPNG_BLOCK_EPB        0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1a2b3c4d
+#define PCAPNG_OPTION_TSRESOL   9
+
+/* usbmon link types, with the length of their packet header */
+#define LINKTYPE_USB_LINUX           189
+#define LINKTYPE_USB_LINUX_MMAPPED   220
+#define USBMON_HEADER_SIZE           48
+#define USBMON_MMAPPED_HEADER_SIZE   64
+
+#define USB_TRANSFER_TYPE_CONTROL 2
+
+/* CDC class requests carrying QMI messages */
+#define CDC_SEND_ENCAPSULATED_COMMAND_TYPE 0x21
+#define CDC_SEND_ENCAPSULATED_COMMAND      0x00
+#define CDC_GET_ENCAPSULATED_RESPONSE_TYPE 0xa1
+#define CDC_GET_ENCAPSULATED_RESPONSE      0x01
+
+/* Main options */
+static gchar *format_str;
+static gint jobs_int;
+static gchar *schema_str;
+static gboolean version_flag;
+static gchar **files_strv;
+
+static GOptionEntry main_entries[] = {
+    { "format", 'f', 0, G_OPTION_ARG_STRING, &format_str,
+      "Output format (default text)",
+      "[text|json]"
+    },
+    { "jobs", 'j', 0, G_OPTION_ARG_INT, &jobs_int,
+      "Number of worker threads decoding messages (default one per processor)",
+      "[N]"
+    },
+    { "schema", 's', 0, G_OPTION_ARG_FILENAME, &schema_str,
+      "Translate the messages with the given binary schema database, in text output",
+      "[PATH]"
+    },
+    { "version", 'V', 0, G_OPTION_ARG_NONE, &version_flag,
+      "Print version",
+      NULL
+    },
+    { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &files_strv,
+      NULL,
+      "[FILE...]"
+    },
+    { NULL }
+};
+
+static void
+print_version_and_exit (void)
+{
+    g_print ("\n"
+             PROGRAM_NAME " " PROGRAM_VERSION "\n"
+             "Copyright (C) 2018 Aleksander Morgado\n"
+             "License GPLv2+: GNU GPL version 2 or later <http://gnu.org/licenses/gpl-2.0.html>\n"
+             "This is free software: you are free to change and redistribute it.\n"
+             "There is NO WARRANTY, to the extent permitted by law.\n"
+             "\n");
+    exit (EXIT_SUCCESS);
+}
+
+/*****************************************************************************/
+/* Records */
+
+typedef struct {
+    gint64        timestamp; /* microseconds */
+    guint         source;
+    guint         index;
+    const gchar  *label; /* interned */
+    gboolean      sent;
+    gint64        latency;
+    const guint8 *data;  /* in the mapped file, or owned */
+    gsize         length;
+    guint8       *owned;
+    /* Set by the workers */
+    gchar        *output;
+    gboolean      done;
+} Record;
+
+static void
+record_free (Record *record)
+{
+    g_free (record->owned);
+    g_free (record->output);
+    g_slice_free (Record, record);
+}
+
+static gint
+record_cmp (const Record **a,
+            const Record **b)
+{
+    if ((*a)->timestamp != (*b)->timestamp)
+        return ((*a)->timestamp < (*b)->timestamp ? -1 : 1);
+    if ((*a)->source != (*b)->source)
+        return ((*a)->source < (*b)->source ? -1 : 1);
+    return ((*a)->index < (*b)->index ? -1 : ((*a)->index > (*b)->index));
+}
+
+typedef struct {
+    guint      source;
+    GPtrArray *records;
+    /* Pending GET_ENCAPSULATED_RESPONSE transfers, by URB id */
+    GHashTable *pending;
+} Reader;
+
+static void
+reader_add (Reader       *reader,
+            gint64        timestamp,
+            const gchar  *label,
+            gboolean      sent,
+            gint64        latency,
+            const guint8 *data,
+            gsize         length,
+            guint8       *owned)
+{
+    Record *record;
+
+    record = g_slice_new0 (Record);
+    record->timestamp = timestamp;
+    record->source = reader->source;
+    record->index = reader->records->len;
+    record->label = label;
+    record->sent = sent;
+    record->latency = latency;
+    record->data = data;
+    record->length = length;
+    record->owned = owned;
+    g_ptr_array_add (reader->records, record);
+}
+
+/*****************************************************************************/
+/* usbmon packets
+ *
+ * The packet header is in the byte order of the host where it was captured,
+ * assumed to be little endian. */
+
+static void
+reader_add_usbmon_packet (Reader       *reader,
+                          const guint8 *packet,
+                          gsize         packet_length,
+                          gsize         header_size,
+                          gint64        timestamp)
+{
+    guint64       id;
+    guint8        event_type;
+    guint8        devnum;
+    guint16       busnum;
+    gboolean      has_setup;
+    gboolean      has_data;
+    guint32       data_length;
+    const guint8 *setup;
+    gchar        *label;
+
+    if (packet_length < header_size)
+        return;
+    if (packet[9] != USB_TRANSFER_TYPE_CONTROL)
+        return;
+
+    memcpy (&id, &packet[0], 8);
+    id = GUINT64_FROM_LE (id);
+    event_type = packet[8];
+    devnum = packet[11];
+    busnum = (guint16) (packet[12] | (packet[13] << 8));
+    has_setup = (packet[14] == 0);
+    has_data = (packet[15] == 0);
+    data_length = (guint32) (packet[36] | (packet[37] << 8) | (packet[38] << 16) | ((guint32) packet[39] << 24));
+    data_length = MIN (data_length, packet_length - header_size);
+    setup = &packet[40];
+
+    label = g_strdup_printf ("usb %u.%u", busnum, devnum);
+
+    if (event_type == 'S' && has_setup) {
+        if (setup[0] == CDC_SEND_ENCAPSULATED_COMMAND_TYPE && setup[1] == CDC_SEND_ENCAPSULATED_COMMAND) {
+            /* Sent with the submission */
+            if (has_data && data_length > 0)
+                reader_add (reader, timestamp, g_intern_string (label), TRUE, -1,
+                            &packet[header_size], data_length, NULL);
+        } else if (setup[0] == CDC_GET_ENCAPSULATED_RESPONSE_TYPE && setup[1] == CDC_GET_ENCAPSULATED_RESPONSE) {
+            /* Received with the completion */
+            g_hash_table_add (reader->pending, g_memdup (&id, sizeof (id)));
+        }
+    } else if ((event_type == 'C' || event_type == 'E') && g_hash_table_remove (reader->pending, &id)) {
+        if (event_type == 'C' && has_data && data_length > 0)
+            reader_add (reader, timestamp, g_intern_string (label), FALSE, -1,
+                        &packet[header_size], data_length, NULL);
+    }
+
+    g_free (label);
+}
+
+static gboolean
+usbmon_header_size (guint32   linktype,
+                    gsize    *header_size,
+                    GError  **error)
+{
+    switch (linktype) {
+    case LINKTYPE_USB_LINUX:
+        *header_size = USBMON_HEADER_SIZE;
+        return TRUE;
+    case LINKTYPE_USB_LINUX_MMAPPED:
+        *header_size = USBMON_MMAPPED_HEADER_SIZE;
+        return TRUE;
+    default:
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                     "unsupported link type %u: not a usbmon capture", linktype);
+        return FALSE;
+    }
+}
+
+/*****************************************************************************/
+/* pcap */
+
+static guint32
+read_u32 (const guint8 *data,
+          gboolean      swap)
+{
+    guint32 value;
+
+    memcpy (&value, data, 4);
+    return (swap ? GUINT32_SWAP_LE_BE (value) : value);
+}
+
+static guint16
+read_u16 (const guint8 *data,
+          gboolean      swap)
+{
+    guint16 value;
+
+    memcpy (&value, data, 2);
+    return (swap ? GUINT16_SWAP_LE_BE (value) : value);
+}
+
+static gboolean
+reader_parse_pcap (Reader        *reader,
+                   const guint8  *data,
+                   gsize          length,
+                   GError       **error)
+{
+    guint32  magic;
+    gboolean swap;
+    gboolean nsec;
+    gsize    header_size;
+    gsize    offset;
+
+    magic = read_u32 (data, FALSE);
+    swap = (magic == GUINT32_SWAP_LE_BE (PCAP_MAGIC_USEC) || magic == GUINT32_SWAP_LE_BE (PCAP_MAGIC_NSEC));
+    nsec = (read_u32 (data, swap) == PCAP_MAGIC_NSEC);
+
+    if (length < 24) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "truncated pcap header");
+        return FALSE;
+    }
+    if (!usbmon_header_size (read_u32 (&data[20], swap), &header_size, error))
+        return FALSE;
+
+    for (offset = 24; offset + 16 <= length; ) {
+        guint32 ts_sec;
+        guint32 ts_frac;
+        guint32 captured;
+
+        ts_sec = read_u32 (&data[offset], swap);
+        ts_frac = read_u32 (&data[offset + 4], swap);
+        captured = read_u32 (&data[offset + 8], swap);
+        offset += 16;
+        if (captured > length - offset) {
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                         "truncated pcap record at offset %" G_GSIZE_FORMAT, offset - 16);
+            return FALSE;
+        }
+
+        reader_add_usbmon_packet (reader, &data[offset], captured, header_size,
+                                  (gint64) ts_sec * G_USEC_PER_SEC + (nsec ? ts_frac / 1000 : ts_frac));
+        offset += captured;
+    }
+
+    return TRUE;
+}
+
+/*****************************************************************************/
+/* pcapng */
+
+typedef struct {
+    gsize   header_size;
+    gboolean supported;
+    /* Timestamp resolution: either a power of 10 or of 2 */
+    guint8  tsresol;
+} PcapngInterface;
+
+static gint64
+pcapng_timestamp_to_usec (guint64 ts,
+                          guint8  tsresol)
+{
+    guint exponent;
+
+    exponent = tsresol & 0x7f;
+    if (tsresol & 0x80)
+        return (gint64) ((ts >> exponent) * G_USEC_PER_SEC + (((ts & ((G_GUINT64_CONSTANT (1) << exponent) - 1)) * G_USEC_PER_SEC) >> exponent));
+
+    for (; exponent > 6; exponent--)
+        ts /= 10;
+    for (; exponent < 6; exponent++)
+        ts *= 10;
+    return (gint64) ts;
+}
+
+static void
+pcapng_parse_idb (const guint8 *body,
+                  gsize         body_length,
+                  gboolean      swap,
+                  GArray       *interfaces)
+{
+    PcapngInterface iface = { 0, FALSE, 6 };
+    gsize           offset;
+
+    if (body_length < 8)
+        return;
+
+    iface.supported = usbmon_header_size (read_u16 (body, swap), &iface.header_size, NULL);
+    for (offset = 8; offset + 4 <= body_length; ) {
+        guint16 code;
+        guint16 option_length;
+
+        code = read_u16 (&body[offset], swap);
+        option_length = read_u16 (&body[offset + 2], swap);
+        offset += 4;
+        if (!code || option_length > body_length - offset)
+            break;
+        if (code == PCAPNG_OPTION_TSRESOL && option_length == 1)
+            iface.tsresol = body[offset];
+        offset += (option_length + 3) & ~3;
+    }
+
+    g_array_append_val (interfaces, iface);
+}
+
+static gboolean
+reader_parse_pcapng (Reader        *reader,
+                     const guint8  *data,
+                     gsize          length,
+                     GError       **error)
+{
+    GArray   *interfaces;
+    gboolean  swap = FALSE;
+    gboolean  any_supported = FALSE;
+    gsize     offset;
+
+    interfaces = g_array_new (FALSE, FALSE, sizeof (PcapngInterface));
+
+    for (offset = 0; offset + 12 <= length; ) {
+        guint32       block_type;
+        guint32       block_length;
+        const guint8 *body;
+        gsize         body_length;
+
+        block_type = read_u32 (&data[offset], FALSE);
+
+        /* Each section has its own byte order and interfaces */
+        if (block_type == PCAPNG_BLOCK_SHB) {
+            swap = (read_u32 (&data[offset + 8], FALSE) != PCAPNG_BYTE_ORDER_MAGIC);
+            g_array_set_size (interfaces, 0);
+        } else
+            block_type = read_u32 (&data[offset], swap);
+
+        block_length = read_u32 (&data[offset + 4], swap);
+        if (block_length < 12 || block_length > length - offset) {
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                         "invalid pcapng block at offset %" G_GSIZE_FORMAT, offset);
+            g_array_unref (interfaces);
+            return FALSE;
+        }
+        body = &data[offset + 8];
+        body_length = block_length - 12;
+
+        if (block_type == PCAPNG_BLOCK_IDB) {
+            pcapng_parse_idb (body, body_length, swap, interfaces);
+            any_supported |= g_array_index (interfaces, PcapngInterface, interfaces->len - 1).supported;
+        } else if (block_type == PCAPNG_BLOCK_EPB && body_length >= 20) {
+            guint32 interface_id;
+            guint32 captured;
+
+            interface_id = read_u32 (body, swap);
+            captured = read_u32 (&body[12], swap);
+            if (interface_id < interfaces->len && captured <= body_length - 20) {
+                PcapngInterface *iface;
+
+                iface = &g_array_index (interfaces, PcapngInterface, interface_id);
+                if (iface->supported)
+                    reader_add_usbmon_packet (reader, &body[20], captured, iface->header_size,
+                                              pcapng_timestamp_to_usec (((guint64) read_u32 (&body[4], swap) << 32) | read_u32 (&body[8], swap),
+                                                                        iface->tsresol));
+            }
+        }
+
+        offset += block_length;
+    }
+
+    g_array_unref (interfaces);
+
+    if (!any_supported) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                     "no usbmon interface in the capture");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*****************************************************************************/
+/* Binary traces */
+
+static void
+trace_record_cb (const QmiTraceRecord *trace_record,
+                 Reader               *reader)
+{
+    guint8 *raw;
+
+    /* The record is only valid during the call */
+    raw = g_memdup (trace_record->raw, trace_record->raw_length);
+    reader_add (reader,
+                trace_record->timestamp,
+                g_intern_string (trace_record->path),
+                trace_record->sent,
+                trace_record->latency,
+                raw,
+                trace_record->raw_length,
+                raw);
+}
+
+/*****************************************************************************/
+
+static gboolean
+reader_parse (Reader        *reader,
+              const guint8  *data,
+              gsize          length,
+              GError       **error)
+{
+    guint32 magic;
+
+    if (length >= 8 && memcmp (data, "QMITRACE", 8) == 0)
+        return qmi_trace_foreach_record (data, length, (QmiTraceForeachRecordFn) trace_record_cb, reader, error);
+
+    if (length < 4) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "unknown file format");
+        return FALSE;
+    }
+
+    magic = read_u32 (data, FALSE);
+    if (magic == PCAPNG_BLOCK_SHB)
+        return reader_parse_pcapng (reader, data, length, error);
+    if (magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC ||
+        magic == GUINT32_SWAP_LE_BE (PCAP_MAGIC_USEC) || magic == GUINT32_SWAP_LE_BE (PCAP_MAGIC_NSEC))
+        return reader_parse_pcap (reader, data, length, error);
+
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "unknown file format");
+    return FALSE;
+}
+
+/*****************************************************************************/
+/* Decoding */
+
+typedef struct {
+    gboolean   json;
+    QmiSchema *schema;
+    gint64     first_timestamp;
+    GMutex     lock;
+    GCond      cond;
+} Decoder;
+
+static void
+json_append_string (GString     *json,
+                    const gchar *str)
+{
+    g_string_append_c (json, '"');
+    for (; *str; str++) {
+        switch (*str) {
+        case '"':  g_string_append (json, "\\\""); break;
+        case '\\': g_string_append (json, "\\\\"); break;
+        case '\n': g_string_append (json, "\\n");  break;
+        default:
+            if ((guchar) *str < 0x20)
+                g_string_append_printf (json, "\\u%04x", (guint) *str);
+            else
+                g_string_append_c (json, *str);
+            break;
+        }
+    }
+    g_string_append_c (json, '"');
+}
+
+static void
+decode_append_header (Decoder *decoder,
+                      Record  *record,
+                      GString *output)
+{
+    gint64 elapsed;
+
+    elapsed = record->timestamp - decoder->first_timestamp;
+
+    if (decoder->json) {
+        g_string_append_printf (output,
+                                "{\"time\":\"%" G_GINT64_FORMAT ".%06" G_GINT64_FORMAT "\",\"source\":",
+                                elapsed / G_USEC_PER_SEC, elapsed % G_USEC_PER_SEC);
+        json_append_string (output, record->label);
+        g_string_append_printf (output, ",\"direction\":\"%s\"", record->sent ? "sent" : "received");
+        if (record->latency >= 0)
+            g_string_append_printf (output, ",\"latency\":%" G_GINT64_FORMAT, record->latency);
+        return;
+    }
+
+    g_string_append_printf (output,
+                            "[%" G_GINT64_FORMAT ".%06" G_GINT64_FORMAT "] [%s] %s",
+                            elapsed / G_USEC_PER_SEC, elapsed % G_USEC_PER_SEC,
+                            record->label,
+                            record->sent ? "sent" : "received");
+    if (record->latency >= 0)
+        g_string_append_printf (output, " (latency: %" G_GINT64_FORMAT " us)", record->latency);
+    g_string_append_c (output, '\n');
+}
+
+static void
+decode_append_error (Decoder     *decoder,
+                     Record      *record,
+                     const gchar *message,
+                     GString     *output)
+{
+    decode_append_header (decoder, record, output);
+    if (decoder->json) {
+        g_string_append (output, ",\"error\":");
+        json_append_string (output, message);
+        g_string_append (output, "}\n");
+    } else
+        g_string_append_printf (output, "  invalid message: %s\n", message);
+}
+
+static void
+decode_append_message (Decoder         *decoder,
+                       Record          *record,
+                       QmiMessageFrame *frame,
+                       GString         *output)
+{
+    QmiMessage *message;
+
+    decode_append_header (decoder, record, output);
+
+    message = qmi_message_new_from_frame (frame);
+    if (decoder->json) {
+        g_string_append (output, ",\"message\":");
+        qmi_message_append_json (message, NULL, output);
+        g_string_append (output, "}\n");
+    } else if (decoder->schema) {
+        gchar *printable;
+
+        printable = qmi_schema_get_printable (decoder->schema, message, NULL, "  ");
+        g_string_append (output, printable);
+        g_string_append_c (output, '\n');
+        g_free (printable);
+    } else {
+        qmi_message_append_printable (message, NULL, "  ", output);
+        g_string_append_c (output, '\n');
+    }
+    qmi_message_unref (message);
+}
+
+/* Run in the worker threads */
+static void
+decode_record (Record  *record,
+               Decoder *decoder)
+{
+    QmiMessageFrameIter  iter;
+    QmiMessageFrame      frame;
+    GString             *output;
+    GError              *error = NULL;
+    gsize                remaining;
+
+    output = g_string_sized_new (1024);
+
+    /* Usually one single message per transfer or record */
+    qmi_message_frame_iter_init (&iter, record->data, record->length);
+    while (TRUE) {
+        if (qmi_message_frame_iter_next (&iter, &frame, &error)) {
+            decode_append_message (decoder, record, &frame, output);
+            continue;
+        }
+        if (!error)
+            break;
+        decode_append_error (decoder, record, error->message, output);
+        g_clear_error (&error);
+    }
+
+    /* e.g. truncated by the capture length */
+    remaining = record->length - qmi_message_frame_iter_get_offset (&iter);
+    if (remaining > 0) {
+        gchar *message;
+
+        message = g_strdup_printf ("incomplete message (%" G_GSIZE_FORMAT " bytes)", remaining);
+        decode_append_error (decoder, record, message, output);
+        g_free (message);
+    }
+
+    g_mutex_lock (&decoder->lock);
+    record->output = g_string_free (output, FALSE);
+    record->done = TRUE;
+    g_cond_broadcast (&decoder->cond);
+    g_mutex_unlock (&decoder->lock);
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    GError         *error = NULL;
+    GOptionContext *context;
+    GPtrArray      *mapped_files;
+    GPtrArray      *records;
+    GThreadPool    *pool;
+    Decoder         decoder = { 0 };
+    guint           i;
+
+    setlocale (LC_ALL, "");
+
+    /* Setup option context, process it and destroy it */
+    context = g_option_context_new ("- Decode the QMI messages in usbmon captures or binary traces");
+    g_option_context_add_main_entries (context, main_entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("error: %s\n",
+                    error->message);
+        exit (EXIT_FAILURE);
+    }
+    g_option_context_free (context);
+
+    if (version_flag)
+        print_version_and_exit ();
+
+    if (!files_strv || !files_strv[0]) {
+        g_printerr ("error: no capture given\n");
+        exit (EXIT_FAILURE);
+    }
+
+    if (!format_str || g_str_equal (format_str, "text"))
+        decoder.json = FALSE;
+    else if (g_str_equal (format_str, "json"))
+        decoder.json = TRUE;
+    else {
+        g_printerr ("error: invalid output format: '%s'\n", format_str);
+        exit (EXIT_FAILURE);
+    }
+
+    if (schema_str && !(decoder.schema = qmi_schema_new_from_file (schema_str, &error))) {
+        g_printerr ("error: couldn't load schema: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Read all records first, so that they're merged by time */
+    mapped_files = g_ptr_array_new_with_free_func ((GDestroyNotify) g_mapped_file_unref);
+    records = g_ptr_array_new_with_free_func ((GDestroyNotify) record_free);
+    for (i = 0; files_strv[i]; i++) {
+        GMappedFile *mapped;
+        Reader       reader;
+
+        mapped = g_mapped_file_new (files_strv[i], FALSE, &error);
+        if (!mapped) {
+            g_printerr ("error: couldn't read '%s': %s\n", files_strv[i], error->message);
+            exit (EXIT_FAILURE);
+        }
+        g_ptr_array_add (mapped_files, mapped);
+
+        reader.source = i;
+        reader.records = records;
+        reader.pending = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, NULL);
+        if (!reader_parse (&reader,
+                           (const guint8 *) g_mapped_file_get_contents (mapped),
+                           g_mapped_file_get_length (mapped),
+                           &error)) {
+            g_printerr ("error: couldn't decode '%s': %s\n", files_strv[i], error->message);
+            exit (EXIT_FAILURE);
+        }
+        g_hash_table_unref (reader.pending);
+    }
+
+    if (!records->len)
+        return EXIT_SUCCESS;
+
+    g_ptr_array_sort (records, (GCompareFunc) record_cmp);
+    decoder.first_timestamp = ((Record *) g_ptr_array_index (records, 0))->timestamp;
+
+    /* Decoded in parallel, printed in order */
+    g_mutex_init (&decoder.lock);
+    g_cond_init (&decoder.cond);
+    pool = g_thread_pool_new ((GFunc) decode_record,
+                              &decoder,
+                              jobs_int > 0 ? jobs_int : (gint) g_get_num_processors (),
+                              FALSE,
+                              &error);
+    if (!pool) {
+        g_printerr ("error: couldn't create worker threads: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+    for (i = 0; i < records->len; i++)
+        g_thread_pool_push (pool, g_ptr_array_index (records, i), NULL);
+
+    for (i = 0; i < records->len; i++) {
+        Record *record;
+
+        record = g_ptr_array_index (records, i);
+        g_mutex_lock (&decoder.lock);
+        while (!record->done)
+            g_cond_wait (&decoder.cond, &decoder.lock);
+        g_mutex_unlock (&decoder.lock);
+
+        fputs (record->output, stdout);
+        g_clear_pointer (&record->output, g_free);
+    }
+
+    g_thread_pool_free (pool, FALSE, TRUE);
+    g_mutex_clear (&decoder.lock);
+    g_cond_clear (&decoder.cond);
+    g_ptr_array_unref (records);
+    g_ptr_array_unref (mapped_files);
+    if (decoder.schema)
+        qmi_schema_unref (decoder.schema);
+
+    return EXIT_SUCCESS;
+}
@@ -141,6 +141,7 @@ receive_response (QfuAtDevice   *self,
 	fd_set          rd;
 	struct timeval  tv;
     gint            aux;
+    gint            cancellable_fd;
     gssize          rlen;
     gchar          *start;
 
@@ -148,9 +149,16 @@ receive_response (QfuAtDevice   *self,
     tv.tv_sec  = timeout_secs;
     tv.tv_usec = 0;
 
+    /* Wake up right away if cancelled, as probes in other ports may be
+     * cancelled as soon as one of them succeeds */
 	FD_ZERO (&rd);
 	FD_SET (self->priv->fd, &rd);
-    aux = select (self->priv->fd + 1, &rd, NULL, NULL, &tv);
+    cancellable_fd = g_cancellable_get_fd (cancellable);
+    if (cancellable_fd >= 0)
+        FD_SET (cancellable_fd, &rd);
+    aux = select (MAX (self->priv->fd, cancellable_fd) + 1, &rd, NULL, NULL, &tv);
+    if (cancellable_fd >= 0)
+        g_cancellable_release_fd (cancellable);
 
     if (g_cancellable_set_error_if_cancelled (cancellable, error))
         return -1;
@@ -271,6 +279,41 @@ qfu_at_device_boothold (QfuAtDevice  *self,
     return FALSE;
 }
 
+gboolean
+qfu_at_device_boothold_finish (QfuAtDevice   *self,
+                               GAsyncResult  *res,
+                               GError       **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void
+boothold_thread (GTask        *task,
+                 QfuAtDevice  *self,
+                 gpointer      unused,
+                 GCancellable *cancellable)
+{
+    GError *error = NULL;
+
+    if (!qfu_at_device_boothold (self, cancellable, &error))
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
+}
+
+void
+qfu_at_device_boothold_async (QfuAtDevice         *self,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data)
+{
+    GTask *task;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_run_in_thread (task, (GTaskThreadFunc) boothold_thread);
+    g_object_unref (task);
+}
+
 /******************************************************************************/
 
 static gboolean
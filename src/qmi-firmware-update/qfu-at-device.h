@@ -56,6 +56,15 @@ gboolean     qfu_at_device_boothold (QfuAtDevice   *self,
                                      GCancellable  *cancellable,
                                      GError       **error);
 
+/* The blocking operation, run in a thread */
+void         qfu_at_device_boothold_async  (QfuAtDevice          *self,
+                                            GCancellable         *cancellable,
+                                            GAsyncReadyCallback   callback,
+                                            gpointer              user_data);
+gboolean     qfu_at_device_boothold_finish (QfuAtDevice          *self,
+                                            GAsyncResult         *res,
+                                            GError              **error);
+
 G_END_DECLS
 
 #endif /* QFU_AT_DEVICE_H */
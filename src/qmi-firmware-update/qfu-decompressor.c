@@ -0,0 +1,296 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * qmi-firmware-update -- Command line tool to update firmware in QMI devices
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#if defined WITH_XZ
+# include <lzma.h>
+#endif
+#if defined WITH_ZSTD
+# include <zstd.h>
+#endif
+
+#include "qfu-decompressor.h"
+
+/******************************************************************************/
+/* xz */
+
+#if defined WITH_XZ
+
+#define QFU_TYPE_XZ_DECOMPRESSOR (qfu_xz_decompressor_get_type ())
+#define QFU_XZ_DECOMPRESSOR(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), QFU_TYPE_XZ_DECOMPRESSOR, QfuXzDecompressor))
+
+typedef struct {
+    GObject     parent;
+    lzma_stream stream;
+} QfuXzDecompressor;
+
+typedef struct {
+    GObjectClass parent;
+} QfuXzDecompressorClass;
+
+static GType qfu_xz_decompressor_get_type (void);
+static void  xz_converter_iface_init      (GConverterIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (QfuXzDecompressor, qfu_xz_decompressor, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_CONVERTER, xz_converter_iface_init))
+
+static gboolean
+xz_decoder_init (QfuXzDecompressor  *self,
+                 GError            **error)
+{
+    lzma_ret ret;
+
+    memset (&self->stream, 0, sizeof (self->stream));
+    ret = lzma_stream_decoder (&self->stream, UINT64_MAX, 0);
+    if (ret != LZMA_OK) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "couldn't initialize xz decoder (%u)", (guint) ret);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static GConverterResult
+xz_convert (GConverter       *converter,
+            const void       *inbuf,
+            gsize             inbuf_size,
+            void             *outbuf,
+            gsize             outbuf_size,
+            GConverterFlags   flags,
+            gsize            *bytes_read,
+            gsize            *bytes_written,
+            GError          **error)
+{
+    QfuXzDecompressor *self = QFU_XZ_DECOMPRESSOR (converter);
+    lzma_ret           ret;
+
+    self->stream.next_in   = inbuf;
+    self->stream.avail_in  = inbuf_size;
+    self->stream.next_out  = outbuf;
+    self->stream.avail_out = outbuf_size;
+
+    ret = lzma_code (&self->stream, (flags & G_CONVERTER_INPUT_AT_END) ? LZMA_FINISH : LZMA_RUN);
+
+    *bytes_read    = inbuf_size - self->stream.avail_in;
+    *bytes_written = outbuf_size - self->stream.avail_out;
+
+    switch (ret) {
+    case LZMA_STREAM_END:
+        return G_CONVERTER_FINISHED;
+    case LZMA_OK:
+    case LZMA_BUF_ERROR:
+        if (*bytes_read || *bytes_written)
+            return G_CONVERTER_CONVERTED;
+        if (flags & G_CONVERTER_INPUT_AT_END) {
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                         "truncated xz contents");
+            return G_CONVERTER_ERROR;
+        }
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                     "need more xz contents");
+        return G_CONVERTER_ERROR;
+    default:
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "xz decompression failed (%u)", (guint) ret);
+        return G_CONVERTER_ERROR;
+    }
+}
+
+static void
+xz_reset (GConverter *converter)
+{
+    QfuXzDecompressor *self = QFU_XZ_DECOMPRESSOR (converter);
+
+    lzma_end (&self->stream);
+    if (!xz_decoder_init (self, NULL))
+        g_warning ("[qfu-decompressor] couldn't reset xz decoder");
+}
+
+static void
+qfu_xz_decompressor_init (QfuXzDecompressor *self)
+{
+}
+
+static void
+xz_finalize (GObject *object)
+{
+    lzma_end (&QFU_XZ_DECOMPRESSOR (object)->stream);
+
+    G_OBJECT_CLASS (qfu_xz_decompressor_parent_class)->finalize (object);
+}
+
+static void
+xz_converter_iface_init (GConverterIface *iface)
+{
+    iface->convert = xz_convert;
+    iface->reset   = xz_reset;
+}
+
+static void
+qfu_xz_decompressor_class_init (QfuXzDecompressorClass *klass)
+{
+    G_OBJECT_CLASS (klass)->finalize = xz_finalize;
+}
+
+#endif /* WITH_XZ */
+
+/******************************************************************************/
+/* zstd */
+
+#if defined WITH_ZSTD
+
+#define QFU_TYPE_ZSTD_DECOMPRESSOR (qfu_zstd_decompressor_get_type ())
+#define QFU_ZSTD_DECOMPRESSOR(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), QFU_TYPE_ZSTD_DECOMPRESSOR, QfuZstdDecompressor))
+
+typedef struct {
+    GObject        parent;
+    ZSTD_DStream  *stream;
+} QfuZstdDecompressor;
+
+typedef struct {
+    GObjectClass parent;
+} QfuZstdDecompressorClass;
+
+static GType qfu_zstd_decompressor_get_type (void);
+static void  zstd_converter_iface_init      (GConverterIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (QfuZstdDecompressor, qfu_zstd_decompressor, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_CONVERTER, zstd_converter_iface_init))
+
+static GConverterResult
+zstd_convert (GConverter       *converter,
+              const void       *inbuf,
+              gsize             inbuf_size,
+              void             *outbuf,
+              gsize             outbuf_size,
+              GConverterFlags   flags,
+              gsize            *bytes_read,
+              gsize            *bytes_written,
+              GError          **error)
+{
+    QfuZstdDecompressor *self = QFU_ZSTD_DECOMPRESSOR (converter);
+    ZSTD_inBuffer        in = { inbuf, inbuf_size, 0 };
+    ZSTD_outBuffer       out = { outbuf, outbuf_size, 0 };
+    gsize                ret;
+
+    ret = ZSTD_decompressStream (self->stream, &out, &in);
+    if (ZSTD_isError (ret)) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "zstd decompression failed: %s", ZSTD_getErrorName (ret));
+        return G_CONVERTER_ERROR;
+    }
+
+    *bytes_read    = in.pos;
+    *bytes_written = out.pos;
+
+    /* Only single frame images */
+    if (ret == 0)
+        return G_CONVERTER_FINISHED;
+    if (in.pos || out.pos)
+        return G_CONVERTER_CONVERTED;
+    if (flags & G_CONVERTER_INPUT_AT_END) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "truncated zstd contents");
+        return G_CONVERTER_ERROR;
+    }
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                 "need more zstd contents");
+    return G_CONVERTER_ERROR;
+}
+
+static void
+zstd_reset (GConverter *converter)
+{
+    ZSTD_initDStream (QFU_ZSTD_DECOMPRESSOR (converter)->stream);
+}
+
+static void
+qfu_zstd_decompressor_init (QfuZstdDecompressor *self)
+{
+    self->stream = ZSTD_createDStream ();
+    g_assert (self->stream);
+    ZSTD_initDStream (self->stream);
+}
+
+static void
+zstd_finalize (GObject *object)
+{
+    ZSTD_freeDStream (QFU_ZSTD_DECOMPRESSOR (object)->stream);
+
+    G_OBJECT_CLASS (qfu_zstd_decompressor_parent_class)->finalize (object);
+}
+
+static void
+zstd_converter_iface_init (GConverterIface *iface)
+{
+    iface->convert = zstd_convert;
+    iface->reset   = zstd_reset;
+}
+
+static void
+qfu_zstd_decompressor_class_init (QfuZstdDecompressorClass *klass)
+{
+    G_OBJECT_CLASS (klass)->finalize = zstd_finalize;
+}
+
+#endif /* WITH_ZSTD */
+
+/******************************************************************************/
+
+GConverter *
+qfu_decompressor_new (QfuImageCompression   compression,
+                      GError              **error)
+{
+    switch (compression) {
+    case QFU_IMAGE_COMPRESSION_GZIP:
+        return G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+    case QFU_IMAGE_COMPRESSION_XZ:
+#if defined WITH_XZ
+    {
+        QfuXzDecompressor *self;
+
+        self = g_object_new (QFU_TYPE_XZ_DECOMPRESSOR, NULL);
+        if (!xz_decoder_init (self, error)) {
+            g_object_unref (self);
+            return NULL;
+        }
+        return G_CONVERTER (self);
+    }
+#else
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                     "xz compressed images not supported in this build");
+        return NULL;
+#endif
+    case QFU_IMAGE_COMPRESSION_ZSTD:
+#if defined WITH_ZSTD
+        return G_CONVERTER (g_object_new (QFU_TYPE_ZSTD_DECOMPRESSOR, NULL));
+#else
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                     "zstd compressed images not supported in this build");
+        return NULL;
+#endif
+    case QFU_IMAGE_COMPRESSION_NONE:
+    default:
+        g_assert_not_reached ();
+    }
+}
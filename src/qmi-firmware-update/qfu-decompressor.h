@@ -1,6 +1,6 @@
 /* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
 /*
- * qmicli -- Command line interface to control QMI devices
+ * qmi-firmware-update -- Command line tool to update firmware in QMI devices
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -15,15 +15,24 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *
- * Copyright (C) 2010-2017 Red Hat, Inc.
+ * Copyright (C) 2018 Aleksander Morgado <aleksander@aleksander.es>
  */
 
-#include "config.h"
+#ifndef QFU_DECOMPRESSOR_H
+#define QFU_DECOMPRESSOR_H
 
-guint8 * qmicli_charset_gsm_unpack           (const guint8 *gsm,
-                                              guint32 num_septets,
-                                              guint32 *out_unpacked_len);
+#include <glib-object.h>
+#include <gio/gio.h>
 
-guint8 * qmicli_charset_gsm_unpacked_to_utf8 (const guint8 *gsm,
-                                              guint32 len);
+#include "qfu-image.h"
 
+G_BEGIN_DECLS
+
+/* Converters decompressing image contents on the fly; gzip is always
+ * supported, xz and zstd only if built with liblzma and libzstd. */
+GConverter *qfu_decompressor_new (QfuImageCompression   compression,
+                                  GError              **error);
+
+G_END_DECLS
+
+#endif /* QFU_DECOMPRESSOR_H */
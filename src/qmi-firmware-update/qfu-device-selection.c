@@ -49,6 +49,29 @@ struct _QfuDeviceSelectionPrivate {
 
 /******************************************************************************/
 
+const gchar *
+qfu_device_selection_get_preferred_device (QfuDeviceSelection *self)
+{
+    if (self->priv->preferred_devices[QFU_UDEV_HELPER_DEVICE_TYPE_CDC_WDM])
+        return self->priv->preferred_devices[QFU_UDEV_HELPER_DEVICE_TYPE_CDC_WDM];
+    return self->priv->preferred_devices[QFU_UDEV_HELPER_DEVICE_TYPE_TTY];
+}
+
+/* The USB ids of the physical device, only known with udev */
+gboolean
+qfu_device_selection_get_usb_ids (QfuDeviceSelection *self,
+                                  guint16            *vid,
+                                  guint16            *pid)
+{
+#if defined WITH_UDEV
+    if (self->priv->sysfs_path)
+        return qfu_udev_helper_get_usb_ids (self->priv->sysfs_path, vid, pid);
+#endif
+    return FALSE;
+}
+
+/******************************************************************************/
+
 #if defined WITH_UDEV
 
 static GFile *
@@ -125,6 +148,23 @@ qfu_device_selection_get_single_tty (QfuDeviceSelection *self)
     return device_selection_get_single (self, QFU_UDEV_HELPER_DEVICE_TYPE_TTY);
 }
 
+/* The usbfs device of the USB interface exposing the given serial port, so
+ * that it can be driven directly with USB bulk transfers */
+GFile *
+qfu_device_selection_get_usbfs_for_tty (QfuDeviceSelection  *self,
+                                        GFile               *tty_file,
+                                        guint8              *interface_number,
+                                        GError             **error)
+{
+#if defined WITH_UDEV
+    return qfu_udev_helper_find_usbfs_by_file (tty_file, interface_number, error);
+#else
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                 "finding the USB device of a serial port requires udev support");
+    return NULL;
+#endif
+}
+
 /******************************************************************************/
 #if defined WITH_UDEV
 
@@ -56,6 +56,11 @@ QfuDeviceSelection *qfu_device_selection_new      (const gchar  *preferred_cdc_w
                                                    guint         preferred_devnum,
                                                    GError      **error);
 
+const gchar *qfu_device_selection_get_preferred_device (QfuDeviceSelection *self);
+gboolean     qfu_device_selection_get_usb_ids          (QfuDeviceSelection *self,
+                                                        guint16            *vid,
+                                                        guint16            *pid);
+
 GFile *qfu_device_selection_get_single_cdc_wdm      (QfuDeviceSelection   *self);
 #if defined WITH_UDEV
 void   qfu_device_selection_wait_for_cdc_wdm        (QfuDeviceSelection   *self,
@@ -69,6 +74,10 @@ GFile *qfu_device_selection_wait_for_cdc_wdm_finish (QfuDeviceSelection   *self,
 
 GFile *qfu_device_selection_get_single_tty      (QfuDeviceSelection   *self);
 GList *qfu_device_selection_get_multiple_ttys   (QfuDeviceSelection   *self);
+GFile *qfu_device_selection_get_usbfs_for_tty   (QfuDeviceSelection   *self,
+                                                 GFile                *tty_file,
+                                                 guint8               *interface_number,
+                                                 GError              **error);
 #if defined WITH_UDEV
 void   qfu_device_selection_wait_for_tty        (QfuDeviceSelection   *self,
                                                  GCancellable         *cancellable,
@@ -50,8 +50,12 @@ struct _QfuCweFileHeader {
     gchar   reserved2[20];
 } __attribute__ ((packed));
 
+/* Value of the "val" field when "imgcrc" is given */
+#define CWE_CRC_VALID 0x00000001
+
 typedef struct {
     guint             parent_image_index;
+    goffset           offset;
     QfuCweFileHeader  hdr;
     gchar            *type;
     gchar            *product;
@@ -352,6 +356,114 @@ read_header (QfuImage      *_self,
 
 /******************************************************************************/
 
+/* The CRC is computed in pieces of this size, to allow cancelling */
+#define CRC_PIECE_SIZE (1024 * 1024)
+
+typedef struct {
+    guint         image_i;
+    const guint8 *data;
+    gsize         length;
+    GCancellable *cancellable;
+    guint32       crc;
+} CrcJob;
+
+static void
+crc_job_run (CrcJob   *job,
+             gpointer  unused)
+{
+    guint32 crc = 0xffffffff;
+    gsize   done = 0;
+
+    while (done < job->length && !g_cancellable_is_cancelled (job->cancellable)) {
+        gsize n;
+
+        n = MIN (job->length - done, CRC_PIECE_SIZE);
+        crc = qfu_utils_crc32 (crc, job->data + done, n);
+        done += n;
+    }
+    job->crc = crc;
+}
+
+/* Each image, either the main one or an embedded one, has its own CRC;
+ * they're all computed at the same time, straight from the mapped file */
+static gboolean
+check_integrity (QfuImage      *_self,
+                 GCancellable  *cancellable,
+                 GError       **error)
+{
+    QfuImageCwe  *self = QFU_IMAGE_CWE (_self);
+    const guint8 *contents;
+    gsize         length = 0;
+    CrcJob       *jobs;
+    guint         n_jobs = 0;
+    GThreadPool  *pool;
+    gboolean      result = TRUE;
+    guint         i;
+
+    contents = qfu_image_get_mapped_contents (_self, &length);
+    if (!contents) {
+        g_debug ("[qfu-image-cwe] image not mapped: integrity check skipped");
+        return TRUE;
+    }
+
+    jobs = g_new0 (CrcJob, self->priv->images->len);
+    for (i = 0; i < self->priv->images->len; i++) {
+        ImageInfo *info;
+
+        info = &g_array_index (self->priv->images, ImageInfo, i);
+        if (GUINT32_FROM_BE (info->hdr.val) != CWE_CRC_VALID)
+            continue;
+
+        /* Bounds already validated when loading the headers */
+        jobs[n_jobs].image_i     = i;
+        jobs[n_jobs].data        = contents + info->offset + sizeof (QfuCweFileHeader);
+        jobs[n_jobs].length      = GUINT32_FROM_BE (info->hdr.imgsize);
+        jobs[n_jobs].cancellable = cancellable;
+        g_assert (info->offset + sizeof (QfuCweFileHeader) + jobs[n_jobs].length <= length);
+        n_jobs++;
+    }
+
+    if (!n_jobs) {
+        g_debug ("[qfu-image-cwe] no image CRC given: integrity check skipped");
+        goto out;
+    }
+
+    pool = g_thread_pool_new ((GFunc) crc_job_run, NULL, MIN (g_get_num_processors (), n_jobs), TRUE, NULL);
+    for (i = 0; i < n_jobs; i++)
+        g_thread_pool_push (pool, &jobs[i], NULL);
+    /* Wait for all jobs to finish */
+    g_thread_pool_free (pool, FALSE, TRUE);
+
+    if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+        result = FALSE;
+        goto out;
+    }
+
+    for (i = 0; i < n_jobs; i++) {
+        ImageInfo *info;
+        guint32    expected;
+
+        info = &g_array_index (self->priv->images, ImageInfo, jobs[i].image_i);
+        expected = GUINT32_FROM_BE (info->hdr.imgcrc);
+        g_debug ("[qfu-image-cwe] image #%u CRC: 0x%08x (expected 0x%08x)", jobs[i].image_i, jobs[i].crc, expected);
+
+        /* Not all tools apply the final inversion, so accept both */
+        if (jobs[i].crc != expected && ~jobs[i].crc != expected) {
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                         "CRC mismatch in %s image at offset %" G_GOFFSET_FORMAT ": expected 0x%08x, computed 0x%08x",
+                         info->type, info->offset, expected, jobs[i].crc);
+            result = FALSE;
+            break;
+        }
+    }
+
+out:
+    g_free (jobs);
+    return result;
+}
+
+/******************************************************************************/
+
 static void
 clear_image_info (ImageInfo *info)
 {
@@ -384,42 +496,57 @@ is_ascii_str (const gchar *str,
     return TRUE;
 }
 
+/* Headers are copied straight from the mapped file if available, without
+ * any seek or read. Headers are read at increasing offsets, so compressed
+ * images are decompressed only once while loading them. */
+static gboolean
+read_file_header (QfuImageCwe       *self,
+                  goffset            offset,
+                  QfuCweFileHeader  *hdr,
+                  GCancellable      *cancellable,
+                  GError           **error)
+{
+    gssize n_read;
+
+    n_read = qfu_image_read (QFU_IMAGE (self), offset, (guint8 *) hdr, sizeof (QfuCweFileHeader), cancellable, error);
+    if (n_read < 0) {
+        g_prefix_error (error, "couldn't read file header: ");
+        return FALSE;
+    }
+    if (n_read != sizeof (QfuCweFileHeader)) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "CWE firmware image file is too short: full header not available");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 static gboolean
 load_image_info (QfuImageCwe   *self,
-                 GInputStream  *input_stream,
+                 goffset        image_start_offset,
                  const gchar   *parent_prefix,
                  gint           parent_image_index,
                  goffset        parent_image_end_offset,
+                 goffset       *out_image_end_offset,
                  GCancellable  *cancellable,
                  GError       **error)
 {
     ImageInfo  info;
-    gssize     n_read;
     gchar     *image_prefix;
     guint      image_index;
-    goffset    image_start_offset;
     goffset    image_end_offset;
     goffset    walker;
 
-    /* Store image start offset */
-    image_start_offset = g_seekable_tell (G_SEEKABLE (input_stream));
-
     memset (&info, 0, sizeof (info));
 
-    /* Store parent image index */
+    /* Store parent image index and where the image starts */
     info.parent_image_index = parent_image_index;
+    info.offset = image_start_offset;
 
     /* Read header from file */
-    n_read = g_input_stream_read (input_stream, &(info.hdr), sizeof (QfuCweFileHeader), cancellable, error);
-    if (n_read < 0) {
-        g_prefix_error (error, "couldn't read file header: ");
+    if (!read_file_header (self, image_start_offset, &(info.hdr), cancellable, error))
         return FALSE;
-    }
-    if (n_read != sizeof (QfuCweFileHeader)) {
-        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-                     "CWE firmware image file is too short: full header not available");
-        return FALSE;
-    }
 
     /* No image size reported */
     if (!info.hdr.imgsize) {
@@ -454,26 +581,22 @@ load_image_info (QfuImageCwe   *self,
     g_debug ("[qfu-image-cwe] %simage offset range: [%" G_GOFFSET_FORMAT ",%" G_GOFFSET_FORMAT "]",
              parent_prefix, image_start_offset, image_end_offset);
 
-    /* And check if it has embedded images */
+    /* And check if it has embedded images, right after the header */
     image_prefix = g_strdup_printf ("%s  ", parent_prefix);
-    walker = image_start_offset;
+    walker = image_start_offset + sizeof (QfuCweFileHeader);
     while (walker < image_end_offset) {
-        goffset tested_offset;
+        goffset embedded_end_offset;
+
         /* Read embedded image */
-        tested_offset = g_seekable_tell (G_SEEKABLE (input_stream));
-        if (!load_image_info (self, input_stream, image_prefix, image_index, image_end_offset, cancellable, NULL))
+        if (!load_image_info (self, walker, image_prefix, image_index, image_end_offset, &embedded_end_offset, cancellable, NULL))
             break;
-        g_debug ("[qfu-image-cwe] %simage at offset %" G_GOFFSET_FORMAT " is valid", parent_prefix, tested_offset);
-        walker = g_seekable_tell (G_SEEKABLE (input_stream));
+        g_debug ("[qfu-image-cwe] %simage at offset %" G_GOFFSET_FORMAT " is valid", parent_prefix, walker);
+        walker = embedded_end_offset;
     }
     g_free (image_prefix);
 
-    /* Finally, seek to just after this image */
-    if (!g_seekable_seek (G_SEEKABLE (input_stream), image_end_offset, G_SEEK_SET, cancellable, error)) {
-        g_prefix_error (error, "couldn't seek after image: ");
-        return FALSE;
-    }
-
+    /* Finally, the next image starts just after this one */
+    *out_image_end_offset = image_end_offset;
     return TRUE;
 }
 
@@ -482,9 +605,8 @@ initable_init (GInitable     *initable,
                GCancellable  *cancellable,
                GError       **error)
 {
-    QfuImageCwe  *self;
-    GInputStream *input_stream = NULL;
-    gboolean      result = FALSE;
+    QfuImageCwe *self;
+    goffset      image_end_offset;
 
     self = QFU_IMAGE_CWE (initable);
 
@@ -492,17 +614,10 @@ initable_init (GInitable     *initable,
     if (!iface_initable_parent->init (initable, cancellable, error))
         return FALSE;
 
-    g_object_get (self, "input-stream", &input_stream, NULL);
-    g_assert (G_IS_FILE_INPUT_STREAM (input_stream));
-
     g_debug ("[qfu-image-cwe] reading image headers...");
-    if (!g_seekable_seek (G_SEEKABLE (input_stream), 0, G_SEEK_SET, cancellable, error)) {
-        g_prefix_error (error, "couldn't seek input stream: ");
-        goto out;
-    }
-    if (!load_image_info (self, input_stream, "", -1, (goffset) -1, cancellable, error)) {
+    if (!load_image_info (self, 0, "", -1, (goffset) -1, &image_end_offset, cancellable, error)) {
         g_prefix_error (error, "couldn't read file header: ");
-        goto out;
+        return FALSE;
     }
 
     g_debug ("[qfu-image-cwe] validating data size...");
@@ -510,18 +625,13 @@ initable_init (GInitable     *initable,
         g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
                      "CWE image file size mismatch (expected size: %" G_GUINT32_FORMAT " bytes, real size: %" G_GOFFSET_FORMAT " bytes)",
                      qfu_image_cwe_header_get_image_size (self), qfu_image_get_data_size (QFU_IMAGE (self)));
-        goto out;
+        return FALSE;
     }
 
     g_debug ("[qfu-image-cwe] preloading firmware/config/carrier...");
     parse_firmware_config_carrier (self);
 
-    /* Success! */
-    result = TRUE;
-
-out:
-    g_object_unref (input_stream);
-    return result;
+    return TRUE;
 }
 
 /******************************************************************************/
@@ -583,5 +693,5 @@ qfu_image_cwe_class_init (QfuImageCweClass *klass)
     image_class->get_header_size = get_header_size;
     image_class->get_data_size   = get_data_size;
     image_class->read_header     = read_header;
-
+    image_class->check_integrity = check_integrity;
 }
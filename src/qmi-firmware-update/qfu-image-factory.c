@@ -20,6 +20,8 @@
  * Copyright (C) 2016-2017 Aleksander Morgado <aleksander@aleksander.es>
  */
 
+#include <string.h>
+
 #include "qfu-image-factory.h"
 #include "qfu-image.h"
 #include "qfu-image-cwe.h"
@@ -36,6 +38,14 @@ qfu_image_factory_build (GFile        *file,
     g_assert (G_IS_FILE (file));
     basename = g_file_get_basename (file);
 
+    /* Compressed images are named after the uncompressed ones */
+    if (g_str_has_suffix (basename, ".gz"))
+        basename[strlen (basename) - 3] = '\0';
+    else if (g_str_has_suffix (basename, ".xz"))
+        basename[strlen (basename) - 3] = '\0';
+    else if (g_str_has_suffix (basename, ".zst"))
+        basename[strlen (basename) - 4] = '\0';
+
     /* guessing image type based on the well known Gobi 1k and 2k
      * filenames, and assumes anything else could be a CWE image
      *
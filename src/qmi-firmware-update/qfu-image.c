@@ -20,7 +20,13 @@
  * Copyright (C) 2016-2017 Aleksander Morgado <aleksander@aleksander.es>
  */
 
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include "qfu-image.h"
+#include "qfu-decompressor.h"
+#include "qfu-utils.h"
 #include "qfu-enum-types.h"
 
 static void initable_iface_init (GInitableIface *iface);
@@ -32,7 +38,6 @@ enum {
     PROP_0,
     PROP_FILE,
     PROP_IMAGE_TYPE,
-    PROP_INPUT_STREAM,
     PROP_LAST
 };
 
@@ -43,36 +48,188 @@ struct _QfuImagePrivate {
     GFile        *file;
     GFileInfo    *info;
     GInputStream *input_stream;
+    /* Whole file mapped, if possible, to send chunks without copying them */
+    GMappedFile  *mapped_file;
+    /* Images may be shared by updaters downloading from different threads */
+    GMutex        stream_mutex;
+    /* Uncompressed size */
+    goffset       size;
+
+    /* Compressed images are decompressed on the fly while reading, never
+     * expanded on disk; reading backwards restarts the decompression */
+    QfuImageCompression  compression;
+    GConverter          *converter;
+    GInputStream        *converter_stream;
+    goffset              converter_offset;
+
+    /* Asynchronous integrity check, run once and shared by all the updaters
+     * using the image */
+    gboolean  integrity_checked;
+    GError   *integrity_error;
+    GList    *integrity_waiters;
 };
 
 /******************************************************************************/
+/* Reading */
+
+/* Must be called with the stream mutex held */
+static gssize
+read_compressed (QfuImage      *self,
+                 goffset        offset,
+                 guint8        *out_buffer,
+                 gsize          size,
+                 GCancellable  *cancellable,
+                 GError       **error)
+{
+    gsize n_read = 0;
+
+    if (offset < self->priv->converter_offset) {
+        g_debug ("[qfu-image] restarting decompression to read at offset %" G_GOFFSET_FORMAT, offset);
+        if (!g_seekable_seek (G_SEEKABLE (self->priv->input_stream), 0, G_SEEK_SET, cancellable, error)) {
+            g_prefix_error (error, "couldn't seek input stream: ");
+            return -1;
+        }
+        g_converter_reset (self->priv->converter);
+        g_clear_object (&self->priv->converter_stream);
+        self->priv->converter_offset = 0;
+    }
+
+    if (!self->priv->converter_stream) {
+        self->priv->converter_stream = g_converter_input_stream_new (self->priv->input_stream, self->priv->converter);
+        g_filter_input_stream_set_close_base_stream (G_FILTER_INPUT_STREAM (self->priv->converter_stream), FALSE);
+    }
+
+    /* Forward seeks just decompress and discard the contents in between */
+    while (self->priv->converter_offset < offset) {
+        gssize n_skipped;
+
+        n_skipped = g_input_stream_skip (self->priv->converter_stream,
+                                         MIN (offset - self->priv->converter_offset, QFU_IMAGE_CHUNK_SIZE),
+                                         cancellable,
+                                         error);
+        if (n_skipped < 0) {
+            g_prefix_error (error, "couldn't decompress image: ");
+            return -1;
+        }
+        if (n_skipped == 0)
+            return 0;
+        self->priv->converter_offset += n_skipped;
+    }
+
+    if (!g_input_stream_read_all (self->priv->converter_stream, out_buffer, size, &n_read, cancellable, error)) {
+        g_prefix_error (error, "couldn't decompress image: ");
+        /* Unknown position, so restart next time */
+        self->priv->converter_offset = G_MAXINT64;
+        return -1;
+    }
+    self->priv->converter_offset += n_read;
+
+    return (gssize) n_read;
+}
+
+gssize
+qfu_image_read (QfuImage      *self,
+                goffset        offset,
+                guint8        *out_buffer,
+                gsize          size,
+                GCancellable  *cancellable,
+                GError       **error)
+{
+    gsize  n_read = 0;
+    gssize result;
+
+    g_return_val_if_fail (QFU_IS_IMAGE (self), -1);
+
+    /* Just copy from the mapping if available */
+    if (self->priv->mapped_file) {
+        gsize length;
+
+        length = g_mapped_file_get_length (self->priv->mapped_file);
+        if (offset >= length)
+            return 0;
+        n_read = MIN (size, length - offset);
+        memcpy (out_buffer, g_mapped_file_get_contents (self->priv->mapped_file) + offset, n_read);
+        return (gssize) n_read;
+    }
+
+    g_mutex_lock (&self->priv->stream_mutex);
+
+    if (self->priv->converter) {
+        result = read_compressed (self, offset, out_buffer, size, cancellable, error);
+        goto out;
+    }
+
+    /* Seek to the correct place: note that this is likely a noop if already in that offset */
+    if (!g_seekable_seek (G_SEEKABLE (self->priv->input_stream), offset, G_SEEK_SET, cancellable, error)) {
+        g_prefix_error (error, "couldn't seek input stream: ");
+        result = -1;
+        goto out;
+    }
+
+    if (!g_input_stream_read_all (self->priv->input_stream, out_buffer, size, &n_read, cancellable, error))
+        result = -1;
+    else
+        result = (gssize) n_read;
+
+out:
+    g_mutex_unlock (&self->priv->stream_mutex);
+    return result;
+}
+
+/******************************************************************************/
+
+gboolean
+qfu_image_check_chunk_size (QfuImage  *self,
+                            gsize      chunk_size,
+                            GError   **error)
+{
+    g_return_val_if_fail (QFU_IS_IMAGE (self), FALSE);
+
+    if (chunk_size < QFU_IMAGE_MIN_CHUNK_SIZE || chunk_size > QFU_IMAGE_MAX_CHUNK_SIZE) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                     "invalid chunk size: %" G_GSIZE_FORMAT " bytes", chunk_size);
+        return FALSE;
+    }
+
+    /* Chunks are identified by a 16-bit sequence number */
+    if (qfu_image_get_data_size (self) > ((goffset) G_MAXUINT16 * (goffset) chunk_size)) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                     "chunk size too small for the image: %" G_GSIZE_FORMAT " bytes", chunk_size);
+        return FALSE;
+    }
+
+    return TRUE;
+}
 
 gsize
 qfu_image_get_data_chunk_size (QfuImage *self,
+                               gsize     chunk_size,
                                guint16   chunk_i)
 {
-    gssize chunk_size = QFU_IMAGE_CHUNK_SIZE;
-    guint  n_chunks;
+    guint n_chunks;
 
-    n_chunks = qfu_image_get_n_data_chunks (self);
+    n_chunks = qfu_image_get_n_data_chunks (self, chunk_size);
     if (chunk_i == (n_chunks - 1)) {
-        chunk_size = qfu_image_get_data_size (self) - (chunk_i * QFU_IMAGE_CHUNK_SIZE);
-        g_assert (chunk_size > 0);
-    } else
-        chunk_size = QFU_IMAGE_CHUNK_SIZE;
+        gsize last_chunk_size;
+
+        last_chunk_size = qfu_image_get_data_size (self) - ((goffset) chunk_i * chunk_size);
+        g_assert (last_chunk_size > 0);
+        return last_chunk_size;
+    }
 
     return chunk_size;
 }
 
 gssize
 qfu_image_read_data_chunk (QfuImage      *self,
+                           gsize          chunk_size,
                            guint16        chunk_i,
                            guint8        *out_buffer,
                            gsize          out_buffer_size,
                            GCancellable  *cancellable,
                            GError       **error)
 {
-    gssize  chunk_size;
+    gssize  size;
     guint   n_chunks;
     goffset chunk_offset;
     gssize  n_read;
@@ -81,55 +238,354 @@ qfu_image_read_data_chunk (QfuImage      *self,
 
     g_debug ("[qfu-image] reading chunk #%u", chunk_i);
 
-    n_chunks = qfu_image_get_n_data_chunks (self);
+    n_chunks = qfu_image_get_n_data_chunks (self, chunk_size);
     if (chunk_i >= n_chunks) {
         g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
                      "invalid chunk index %u", chunk_i);
         return -1;
     }
 
-    /* Last chunk may be shorter than the default */
-    chunk_size = qfu_image_get_data_chunk_size (self, chunk_i);
-    g_debug ("[qfu-image] chunk #%u size: %" G_GSSIZE_FORMAT " bytes", chunk_i, chunk_size);
+    /* Last chunk may be shorter than the others */
+    size = qfu_image_get_data_chunk_size (self, chunk_size, chunk_i);
+    g_debug ("[qfu-image] chunk #%u size: %" G_GSSIZE_FORMAT " bytes", chunk_i, size);
 
     /* Make sure there's enough room */
-    if (out_buffer_size < chunk_size) {
+    if (out_buffer_size < size) {
         g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-                     "buffer too small to fit chunk size: %" G_GSIZE_FORMAT, chunk_size);
+                     "buffer too small to fit chunk size: %" G_GSIZE_FORMAT, size);
         return -1;
     }
 
     /* Compute chunk offset */
-    chunk_offset = qfu_image_get_header_size (self) + (chunk_i * QFU_IMAGE_CHUNK_SIZE);
+    chunk_offset = qfu_image_get_header_size (self) + ((goffset) chunk_i * chunk_size);
     g_debug ("[qfu-image] chunk #%u offset: %" G_GOFFSET_FORMAT " bytes", chunk_i, chunk_offset);
 
-    /* Seek to the correct place: note that this is likely a noop if already in that offset */
-    if (!g_seekable_seek (G_SEEKABLE (self->priv->input_stream), chunk_offset, G_SEEK_SET, cancellable, error)) {
-        g_prefix_error (error, "couldn't seek input stream: ");
-        return -1;
-    }
-
-    /* Read full chunk */
-    n_read = g_input_stream_read (self->priv->input_stream,
-                                  out_buffer,
-                                  chunk_size,
-                                  cancellable,
-                                  error);
+    /* Read full chunk, decompressing it straight into the output buffer if
+     * needed */
+    n_read = qfu_image_read (self, chunk_offset, out_buffer, size, cancellable, error);
     if (n_read < 0) {
         g_prefix_error (error, "couldn't read chunk %u", chunk_i);
         return -1;
     }
 
-    if (n_read != chunk_size) {
+    if (n_read != size) {
         g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
                      "couldn't read expected chunk %u size: %" G_GSSIZE_FORMAT " (%" G_GSSIZE_FORMAT " bytes read)",
-                     chunk_i, chunk_size, n_read);
+                     chunk_i, size, n_read);
         return -1;
     }
 
     g_debug ("[qfu-image] chunk #%u successfully read", chunk_i);
 
-    return chunk_size;
+    return size;
+}
+
+const guint8 *
+qfu_image_peek_data_chunk (QfuImage  *self,
+                           gsize      chunk_size,
+                           guint16    chunk_i,
+                           gsize     *out_chunk_size,
+                           GError   **error)
+{
+    const guint8 *contents;
+    gsize         size;
+    goffset       chunk_offset;
+    guint         n_chunks;
+
+    g_return_val_if_fail (QFU_IS_IMAGE (self), NULL);
+
+    if (!self->priv->mapped_file) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                     "image not mapped in memory");
+        return NULL;
+    }
+
+    n_chunks = qfu_image_get_n_data_chunks (self, chunk_size);
+    if (chunk_i >= n_chunks) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "invalid chunk index %u", chunk_i);
+        return NULL;
+    }
+
+    contents = (const guint8 *) g_mapped_file_get_contents (self->priv->mapped_file);
+    size = qfu_image_get_data_chunk_size (self, chunk_size, chunk_i);
+    chunk_offset = qfu_image_get_header_size (self) + ((goffset) chunk_i * chunk_size);
+
+    /* Read ahead the next chunk while this one is being sent */
+    if (chunk_i + 1 < n_chunks) {
+        goffset next_start;
+        goffset next_end;
+
+        /* The advised range must start at a page boundary */
+        next_end = chunk_offset + size + qfu_image_get_data_chunk_size (self, chunk_size, chunk_i + 1);
+        next_start = chunk_offset + size;
+        next_start -= next_start % sysconf (_SC_PAGESIZE);
+        posix_madvise ((gpointer) (contents + next_start), next_end - next_start, POSIX_MADV_WILLNEED);
+    }
+
+    g_debug ("[qfu-image] chunk #%u mapped (%" G_GSIZE_FORMAT " bytes at offset %" G_GOFFSET_FORMAT ")",
+             chunk_i, size, chunk_offset);
+
+    *out_chunk_size = size;
+    return contents + chunk_offset;
+}
+
+/******************************************************************************/
+
+const guint8 *
+qfu_image_get_mapped_contents (QfuImage *self,
+                               gsize    *out_length)
+{
+    g_return_val_if_fail (QFU_IS_IMAGE (self), NULL);
+
+    if (!self->priv->mapped_file)
+        return NULL;
+
+    *out_length = g_mapped_file_get_length (self->priv->mapped_file);
+    return (const guint8 *) g_mapped_file_get_contents (self->priv->mapped_file);
+}
+
+/******************************************************************************/
+/* Integrity check
+ *
+ * Successful checks are cached by device, inode, size and modification time
+ * of the file, so that the same images aren't checked again and again when
+ * updating one device after another. */
+
+#define INTEGRITY_CACHE_ATTRIBUTES          \
+    G_FILE_ATTRIBUTE_UNIX_DEVICE ","        \
+    G_FILE_ATTRIBUTE_UNIX_INODE ","         \
+    G_FILE_ATTRIBUTE_STANDARD_SIZE ","      \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED ","      \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC
+
+static gchar *
+integrity_cache_get_path (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "qmi-firmware-update", "integrity-checks", NULL);
+}
+
+/* The cache key identifies the exact file contents checked, or NULL if the
+ * file can't be identified */
+static gchar *
+integrity_cache_build_key (QfuImage     *self,
+                           GCancellable *cancellable)
+{
+    GFileInfo *info;
+    gchar     *key = NULL;
+
+    info = g_file_query_info (self->priv->file, INTEGRITY_CACHE_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, cancellable, NULL);
+    if (!info)
+        return NULL;
+
+    if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_DEVICE) &&
+        g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_INODE) &&
+        g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED))
+        key = g_strdup_printf ("%u:%" G_GUINT64_FORMAT ":%" G_GOFFSET_FORMAT ":%" G_GUINT64_FORMAT ".%06u",
+                               g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE),
+                               g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE),
+                               g_file_info_get_size (info),
+                               g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+                               g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC));
+
+    g_object_unref (info);
+    return key;
+}
+
+static gboolean
+integrity_cache_lookup (const gchar *uri,
+                        const gchar *key)
+{
+    GKeyFile *key_file;
+    gchar    *path;
+    gchar    *cached;
+    gboolean  found = FALSE;
+
+    path = integrity_cache_get_path ();
+    key_file = g_key_file_new ();
+    if (g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, NULL)) {
+        cached = g_key_file_get_string (key_file, uri, "checked", NULL);
+        found = !g_strcmp0 (cached, key);
+        g_free (cached);
+    }
+    g_key_file_free (key_file);
+    g_free (path);
+
+    return found;
+}
+
+static void
+integrity_cache_store (const gchar *uri,
+                       const gchar *key)
+{
+    GKeyFile *key_file;
+    gchar    *path;
+    gchar    *dir;
+    gchar    *data;
+    gsize     data_length;
+    GError   *error = NULL;
+
+    path = integrity_cache_get_path ();
+    dir = g_path_get_dirname (path);
+    key_file = g_key_file_new ();
+
+    /* Errors are ignored, the cache is only an optimization */
+    if (g_mkdir_with_parents (dir, 0755) < 0) {
+        g_debug ("[qfu-image] couldn't create integrity check cache directory (ignored)");
+        goto out;
+    }
+
+    g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, NULL);
+    g_key_file_set_string (key_file, uri, "checked", key);
+    data = g_key_file_to_data (key_file, &data_length, NULL);
+    if (!g_file_set_contents (path, data, data_length, &error)) {
+        g_debug ("[qfu-image] couldn't update integrity check cache (ignored): %s", error->message);
+        g_error_free (error);
+    }
+    g_free (data);
+
+out:
+    g_key_file_free (key_file);
+    g_free (dir);
+    g_free (path);
+}
+
+gboolean
+qfu_image_check_integrity (QfuImage      *self,
+                           GCancellable  *cancellable,
+                           GError       **error)
+{
+    gchar    *uri;
+    gchar    *key;
+    gboolean  result;
+
+    g_return_val_if_fail (QFU_IS_IMAGE (self), FALSE);
+
+    /* Nothing to check in this image type */
+    if (!QFU_IMAGE_GET_CLASS (self)->check_integrity)
+        return TRUE;
+
+    uri = g_file_get_uri (self->priv->file);
+    key = integrity_cache_build_key (self, cancellable);
+    if (key && integrity_cache_lookup (uri, key)) {
+        g_debug ("[qfu-image] integrity of '%s' already checked", qfu_image_get_display_name (self));
+        result = TRUE;
+        goto out;
+    }
+
+    g_debug ("[qfu-image] checking integrity of '%s'...", qfu_image_get_display_name (self));
+    result = QFU_IMAGE_GET_CLASS (self)->check_integrity (self, cancellable, error);
+    if (result && key)
+        integrity_cache_store (uri, key);
+
+out:
+    g_free (key);
+    g_free (uri);
+    return result;
+}
+
+/* Once checked, the header and first data chunk are paged in, so that the
+ * download starts right away */
+static void
+prefetch_first_chunk (QfuImage *self)
+{
+    gsize length;
+
+    if (!self->priv->mapped_file)
+        return;
+
+    length = MIN ((gsize) g_mapped_file_get_length (self->priv->mapped_file),
+                  (gsize) qfu_image_get_header_size (self) + QFU_IMAGE_CHUNK_SIZE);
+    posix_madvise (g_mapped_file_get_contents (self->priv->mapped_file), length, POSIX_MADV_WILLNEED);
+}
+
+static void
+check_integrity_thread (GTask        *task,
+                        QfuImage     *self,
+                        gpointer      unused,
+                        GCancellable *cancellable)
+{
+    GError *error = NULL;
+
+    if (!qfu_image_check_integrity (self, cancellable, &error)) {
+        g_task_return_error (task, error);
+        return;
+    }
+
+    prefetch_first_chunk (self);
+    g_task_return_boolean (task, TRUE);
+}
+
+static void
+check_integrity_thread_ready (QfuImage     *self,
+                              GAsyncResult *res)
+{
+    GError *error = NULL;
+    GList  *waiters;
+    GList  *l;
+
+    /* A cancelled check is not remembered, it may be requested again */
+    if (!g_task_propagate_boolean (G_TASK (res), &error) &&
+        g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_debug ("[qfu-image] integrity check of '%s' cancelled", qfu_image_get_display_name (self));
+    } else {
+        self->priv->integrity_checked = TRUE;
+        self->priv->integrity_error = (error ? g_error_copy (error) : NULL);
+    }
+
+    waiters = self->priv->integrity_waiters;
+    self->priv->integrity_waiters = NULL;
+    for (l = waiters; l; l = g_list_next (l)) {
+        if (error)
+            g_task_return_error (G_TASK (l->data), g_error_copy (error));
+        else
+            g_task_return_boolean (G_TASK (l->data), TRUE);
+        g_object_unref (l->data);
+    }
+    g_list_free (waiters);
+
+    if (error)
+        g_error_free (error);
+}
+
+gboolean
+qfu_image_check_integrity_finish (QfuImage      *self,
+                                  GAsyncResult  *res,
+                                  GError       **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+void
+qfu_image_check_integrity_async (QfuImage            *self,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data)
+{
+    GTask *task;
+    GTask *thread_task;
+
+    g_return_if_fail (QFU_IS_IMAGE (self));
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    if (self->priv->integrity_checked) {
+        if (self->priv->integrity_error)
+            g_task_return_error (task, g_error_copy (self->priv->integrity_error));
+        else
+            g_task_return_boolean (task, TRUE);
+        g_object_unref (task);
+        return;
+    }
+
+    /* Join the check already running, if any */
+    self->priv->integrity_waiters = g_list_append (self->priv->integrity_waiters, task);
+    if (self->priv->integrity_waiters->next)
+        return;
+
+    thread_task = g_task_new (self, cancellable, (GAsyncReadyCallback) check_integrity_thread_ready, NULL);
+    g_task_run_in_thread (thread_task, (GTaskThreadFunc) check_integrity_thread);
+    g_object_unref (thread_task);
 }
 
 /******************************************************************************/
@@ -150,12 +606,20 @@ qfu_image_get_display_name (QfuImage *self)
     return g_file_info_get_display_name (self->priv->info);
 }
 
+QfuImageCompression
+qfu_image_get_compression (QfuImage *self)
+{
+    g_return_val_if_fail (QFU_IS_IMAGE (self), QFU_IMAGE_COMPRESSION_NONE);
+
+    return self->priv->compression;
+}
+
 goffset
 qfu_image_get_size (QfuImage *self)
 {
     g_return_val_if_fail (QFU_IS_IMAGE (self), 0);
 
-    return g_file_info_get_size (self->priv->info);
+    return self->priv->size;
 }
 
 goffset
@@ -189,14 +653,17 @@ qfu_image_get_data_size (QfuImage *self)
 }
 
 guint16
-qfu_image_get_n_data_chunks (QfuImage *self)
+qfu_image_get_n_data_chunks (QfuImage *self,
+                             gsize     chunk_size)
 {
     goffset data_size;
 
+    g_assert (chunk_size > 0);
+
     data_size = qfu_image_get_data_size (self);
-    g_assert (data_size <= ((goffset) G_MAXUINT16 * (goffset) QFU_IMAGE_CHUNK_SIZE));
+    g_assert (data_size <= ((goffset) G_MAXUINT16 * (goffset) chunk_size));
 
-    return (guint16) (data_size / QFU_IMAGE_CHUNK_SIZE) + !!(data_size % QFU_IMAGE_CHUNK_SIZE);
+    return (guint16) (data_size / chunk_size) + !!(data_size % chunk_size);
 }
 
 /******************************************************************************/
@@ -221,6 +688,140 @@ get_data_size (QfuImage *self)
     return file_size;
 }
 
+/******************************************************************************/
+/* Compression */
+
+/* Longest magic */
+#define COMPRESSION_MAGIC_SIZE 6
+
+static QfuImageCompression
+compression_detect (const guint8 *magic,
+                    gsize         len)
+{
+    static const guint8 gzip_magic[] = { 0x1F, 0x8B };
+    static const guint8 xz_magic[]   = { 0xFD, '7', 'z', 'X', 'Z', 0x00 };
+    static const guint8 zstd_magic[] = { 0x28, 0xB5, 0x2F, 0xFD };
+
+    if (len >= sizeof (gzip_magic) && !memcmp (magic, gzip_magic, sizeof (gzip_magic)))
+        return QFU_IMAGE_COMPRESSION_GZIP;
+    if (len >= sizeof (xz_magic) && !memcmp (magic, xz_magic, sizeof (xz_magic)))
+        return QFU_IMAGE_COMPRESSION_XZ;
+    if (len >= sizeof (zstd_magic) && !memcmp (magic, zstd_magic, sizeof (zstd_magic)))
+        return QFU_IMAGE_COMPRESSION_ZSTD;
+    return QFU_IMAGE_COMPRESSION_NONE;
+}
+
+/* Reads the given number of bytes from the file, exactly */
+static gboolean
+read_file (QfuImage      *self,
+           goffset        offset,
+           guint8        *out_buffer,
+           gsize          size,
+           GCancellable  *cancellable,
+           GError       **error)
+{
+    gsize n_read = 0;
+
+    if (offset < 0 || offset + (goffset) size > g_file_info_get_size (self->priv->info)) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "compressed image is too short");
+        return FALSE;
+    }
+
+    if (!g_seekable_seek (G_SEEKABLE (self->priv->input_stream), offset, G_SEEK_SET, cancellable, error) ||
+        !g_input_stream_read_all (self->priv->input_stream, out_buffer, size, &n_read, cancellable, error))
+        return FALSE;
+
+    if (n_read != size) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "compressed image is too short");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* The uncompressed size is given in the container metadata: the gzip
+ * trailer, the xz index or the zstd frame header */
+static gboolean
+load_uncompressed_size (QfuImage      *self,
+                        GCancellable  *cancellable,
+                        GError       **error)
+{
+    goffset file_size;
+
+    file_size = g_file_info_get_size (self->priv->info);
+
+    switch (self->priv->compression) {
+    case QFU_IMAGE_COMPRESSION_GZIP: {
+        guint8 trailer[QFU_UTILS_GZIP_TRAILER_SIZE];
+
+        return (read_file (self, file_size - sizeof (trailer), trailer, sizeof (trailer), cancellable, error) &&
+                qfu_utils_gzip_get_uncompressed_size (trailer, sizeof (trailer), &self->priv->size, error));
+    }
+    case QFU_IMAGE_COMPRESSION_XZ: {
+        guint8    footer[QFU_UTILS_XZ_FOOTER_SIZE];
+        gsize     index_size;
+        guint8   *index;
+        gboolean  result;
+
+        /* Single stream files, without stream padding */
+        if (!read_file (self, file_size - sizeof (footer), footer, sizeof (footer), cancellable, error) ||
+            !qfu_utils_xz_get_index_size (footer, sizeof (footer), &index_size, error))
+            return FALSE;
+
+        index = g_malloc (index_size);
+        result = (read_file (self, file_size - sizeof (footer) - index_size, index, index_size, cancellable, error) &&
+                  qfu_utils_xz_get_uncompressed_size (index, index_size, &self->priv->size, error));
+        g_free (index);
+        return result;
+    }
+    case QFU_IMAGE_COMPRESSION_ZSTD: {
+        guint8 header[QFU_UTILS_ZSTD_MAX_HEADER_SIZE];
+        gsize  header_size;
+
+        header_size = MIN ((goffset) sizeof (header), file_size);
+        return (read_file (self, 0, header, header_size, cancellable, error) &&
+                qfu_utils_zstd_get_uncompressed_size (header, header_size, &self->priv->size, error));
+    }
+    case QFU_IMAGE_COMPRESSION_NONE:
+    default:
+        g_assert_not_reached ();
+    }
+}
+
+static gboolean
+setup_compression (QfuImage      *self,
+                   GCancellable  *cancellable,
+                   GError       **error)
+{
+    guint8 magic[COMPRESSION_MAGIC_SIZE];
+    gsize  n_read = 0;
+
+    if (!g_input_stream_read_all (self->priv->input_stream, magic, sizeof (magic), &n_read, cancellable, error))
+        return FALSE;
+
+    self->priv->compression = compression_detect (magic, n_read);
+    if (self->priv->compression == QFU_IMAGE_COMPRESSION_NONE) {
+        self->priv->size = g_file_info_get_size (self->priv->info);
+        return TRUE;
+    }
+
+    g_debug ("[qfu-image] %s compressed image", qfu_image_compression_get_string (self->priv->compression));
+    if (!load_uncompressed_size (self, cancellable, error)) {
+        g_prefix_error (error, "couldn't load uncompressed image size: ");
+        return FALSE;
+    }
+    g_debug ("[qfu-image] uncompressed size: %" G_GOFFSET_FORMAT " bytes", self->priv->size);
+
+    self->priv->converter = qfu_decompressor_new (self->priv->compression, error);
+    if (!self->priv->converter)
+        return FALSE;
+
+    /* Decompression starts from the beginning of the file */
+    if (!g_seekable_seek (G_SEEKABLE (self->priv->input_stream), 0, G_SEEK_SET, cancellable, error))
+        return FALSE;
+
+    return TRUE;
+}
+
 /******************************************************************************/
 
 static gboolean
@@ -229,6 +830,7 @@ initable_init (GInitable     *initable,
                GError       **error)
 {
     QfuImage *self;
+    gchar    *path;
 
     self = QFU_IMAGE (initable);
     g_assert (self->priv->file);
@@ -243,17 +845,42 @@ initable_init (GInitable     *initable,
     if (!self->priv->info)
         return FALSE;
 
+    /* Open file for reading. Kept open while the input stream reference is valid. */
+    g_debug ("[qfu-image] opening file for reading...");
+    self->priv->input_stream = G_INPUT_STREAM (g_file_read (self->priv->file, cancellable, error));
+    if (!self->priv->input_stream)
+        return FALSE;
+
+    /* Detect compression, which also gives the real image size */
+    if (!setup_compression (self, cancellable, error))
+        return FALSE;
+
     /* Check minimum file size */
     if (qfu_image_get_size (self) < qfu_image_get_header_size (self)) {
         g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "image is too short");
         return FALSE;
     }
 
-    /* Open file for reading. Kept open while the input stream reference is valid. */
-    g_debug ("[qfu-image] opening file for reading...");
-    self->priv->input_stream = G_INPUT_STREAM (g_file_read (self->priv->file, cancellable, error));
-    if (!self->priv->input_stream)
-        return FALSE;
+    /* Map the file as well, if it's a local uncompressed one; chunks are then
+     * read straight from the mapping, falling back to the input stream
+     * otherwise */
+    path = (self->priv->compression == QFU_IMAGE_COMPRESSION_NONE ? g_file_get_path (self->priv->file) : NULL);
+    if (path && qfu_image_get_size (self) > 0) {
+        GError *inner_error = NULL;
+
+        self->priv->mapped_file = g_mapped_file_new (path, FALSE, &inner_error);
+        if (!self->priv->mapped_file) {
+            g_debug ("[qfu-image] couldn't map file (ignored): %s", inner_error->message);
+            g_error_free (inner_error);
+        } else if (g_mapped_file_get_length (self->priv->mapped_file) != qfu_image_get_size (self)) {
+            g_debug ("[qfu-image] mapped file size mismatch (ignored)");
+            g_clear_pointer (&self->priv->mapped_file, g_mapped_file_unref);
+        } else
+            posix_madvise (g_mapped_file_get_contents (self->priv->mapped_file),
+                           g_mapped_file_get_length (self->priv->mapped_file),
+                           POSIX_MADV_SEQUENTIAL);
+    }
+    g_free (path);
 
     return TRUE;
 }
@@ -281,6 +908,8 @@ qfu_image_init (QfuImage *self)
 {
     self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, QFU_TYPE_IMAGE, QfuImagePrivate);
     self->priv->image_type = QFU_IMAGE_TYPE_UNKNOWN;
+    self->priv->compression = QFU_IMAGE_COMPRESSION_NONE;
+    g_mutex_init (&self->priv->stream_mutex);
 }
 
 static void
@@ -319,9 +948,6 @@ get_property (GObject    *object,
     case PROP_IMAGE_TYPE:
         g_value_set_enum (value, self->priv->image_type);
         break;
-    case PROP_INPUT_STREAM:
-        g_value_set_object (value, self->priv->input_stream);
-        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -333,6 +959,9 @@ dispose (GObject *object)
 {
     QfuImage *self = QFU_IMAGE (object);
 
+    g_clear_pointer (&self->priv->mapped_file, g_mapped_file_unref);
+    g_clear_object (&self->priv->converter_stream);
+    g_clear_object (&self->priv->converter);
     g_clear_object (&self->priv->input_stream);
     g_clear_object (&self->priv->info);
     g_clear_object (&self->priv->file);
@@ -340,6 +969,18 @@ dispose (GObject *object)
     G_OBJECT_CLASS (qfu_image_parent_class)->dispose (object);
 }
 
+static void
+finalize (GObject *object)
+{
+    QfuImage *self = QFU_IMAGE (object);
+
+    g_assert (!self->priv->integrity_waiters);
+    g_clear_error (&self->priv->integrity_error);
+    g_mutex_clear (&self->priv->stream_mutex);
+
+    G_OBJECT_CLASS (qfu_image_parent_class)->finalize (object);
+}
+
 static void
 initable_iface_init (GInitableIface *iface)
 {
@@ -354,6 +995,7 @@ qfu_image_class_init (QfuImageClass *klass)
     g_type_class_add_private (object_class, sizeof (QfuImagePrivate));
 
     object_class->dispose      = dispose;
+    object_class->finalize     = finalize;
     object_class->get_property = get_property;
     object_class->set_property = set_property;
 
@@ -376,12 +1018,4 @@ qfu_image_class_init (QfuImageClass *klass)
                            QFU_IMAGE_TYPE_UNKNOWN,
                            G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
     g_object_class_install_property (object_class, PROP_IMAGE_TYPE, properties[PROP_IMAGE_TYPE]);
-
-    properties[PROP_INPUT_STREAM] =
-        g_param_spec_object ("input-stream",
-                             "Input stream",
-                             "Input stream object",
-                             G_TYPE_FILE_INPUT_STREAM,
-                             G_PARAM_READABLE);
-    g_object_class_install_property (object_class, PROP_INPUT_STREAM, properties[PROP_INPUT_STREAM]);
 }
@@ -49,8 +49,19 @@ typedef enum {
     QFU_IMAGE_TYPE_CWE              = 0x80,
 } QfuImageType;
 
-/* Default chunk size */
-#define QFU_IMAGE_CHUNK_SIZE (1024 * 1024)
+/* Images may be given compressed, and are then decompressed on the fly */
+typedef enum {
+    QFU_IMAGE_COMPRESSION_NONE,
+    QFU_IMAGE_COMPRESSION_GZIP,
+    QFU_IMAGE_COMPRESSION_XZ,
+    QFU_IMAGE_COMPRESSION_ZSTD,
+} QfuImageCompression;
+
+/* Default chunk size, and the limits of the ones that may be negotiated
+ * with the device instead */
+#define QFU_IMAGE_CHUNK_SIZE     (1024 * 1024)
+#define QFU_IMAGE_MIN_CHUNK_SIZE 1024
+#define QFU_IMAGE_MAX_CHUNK_SIZE (16 * 1024 * 1024)
 
 #define QFU_TYPE_IMAGE            (qfu_image_get_type ())
 #define QFU_IMAGE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), QFU_TYPE_IMAGE, QfuImage))
@@ -71,13 +82,16 @@ struct _QfuImage {
 struct _QfuImageClass {
     GObjectClass parent;
 
-    goffset (* get_header_size) (QfuImage      *self);
-    gssize  (* read_header)     (QfuImage      *self,
-                                 guint8        *out_buffer,
-                                 gsize          out_buffer_size,
-                                 GCancellable  *cancellable,
-                                 GError       **error);
-    goffset (* get_data_size)   (QfuImage      *self);
+    goffset  (* get_header_size) (QfuImage      *self);
+    gssize   (* read_header)     (QfuImage      *self,
+                                  guint8        *out_buffer,
+                                  gsize          out_buffer_size,
+                                  GCancellable  *cancellable,
+                                  GError       **error);
+    goffset  (* get_data_size)   (QfuImage      *self);
+    gboolean (* check_integrity) (QfuImage      *self,
+                                  GCancellable  *cancellable,
+                                  GError       **error);
 };
 
 GType         qfu_image_get_type            (void);
@@ -95,15 +109,57 @@ gssize        qfu_image_read_header         (QfuImage      *self,
                                              GCancellable  *cancellable,
                                              GError       **error);
 goffset       qfu_image_get_data_size       (QfuImage      *self);
-guint16       qfu_image_get_n_data_chunks   (QfuImage      *self);
+
+/* The data is split in chunks of the size given, all of them full except
+ * for the last one */
+gboolean      qfu_image_check_chunk_size    (QfuImage      *self,
+                                             gsize          chunk_size,
+                                             GError       **error);
+guint16       qfu_image_get_n_data_chunks   (QfuImage      *self,
+                                             gsize          chunk_size);
 gsize         qfu_image_get_data_chunk_size (QfuImage      *self,
+                                             gsize          chunk_size,
                                              guint16        chunk_i);
 gssize        qfu_image_read_data_chunk     (QfuImage      *self,
+                                             gsize          chunk_size,
                                              guint16        chunk_i,
                                              guint8        *out_buffer,
                                              gsize          out_buffer_size,
                                              GCancellable  *cancellable,
                                              GError       **error);
+const guint8 *qfu_image_peek_data_chunk     (QfuImage      *self,
+                                             gsize          chunk_size,
+                                             guint16        chunk_i,
+                                             gsize         *out_chunk_size,
+                                             GError       **error);
+
+gboolean      qfu_image_check_integrity     (QfuImage      *self,
+                                             GCancellable  *cancellable,
+                                             GError       **error);
+
+/* Runs the integrity check in a thread; concurrent requests share the same
+ * check, and its result is kept for later ones */
+void          qfu_image_check_integrity_async  (QfuImage             *self,
+                                                GCancellable         *cancellable,
+                                                GAsyncReadyCallback   callback,
+                                                gpointer              user_data);
+gboolean      qfu_image_check_integrity_finish (QfuImage             *self,
+                                                GAsyncResult         *res,
+                                                GError              **error);
+
+QfuImageCompression qfu_image_get_compression (QfuImage *self);
+
+/* Only for subclasses: the whole file contents, if mapped */
+const guint8 *qfu_image_get_mapped_contents (QfuImage      *self,
+                                             gsize         *out_length);
+
+/* Only for subclasses: read the (uncompressed) contents at the given offset */
+gssize        qfu_image_read                (QfuImage      *self,
+                                             goffset        offset,
+                                             guint8        *out_buffer,
+                                             gsize          size,
+                                             GCancellable  *cancellable,
+                                             GError       **error);
 
 G_END_DECLS
 
@@ -21,6 +21,7 @@
 
 #include <config.h>
 #include <errno.h>
+#include <string.h>
 
 #include <glib.h>
 #include <glib/gprintf.h>
@@ -32,68 +33,309 @@
 #endif
 
 #include "qfu-log.h"
+#include "qfu-utils.h"
 
 static gboolean  stdout_silent_flag;
 static gboolean  stdout_verbose_flag;
 static FILE     *verbose_log_file;
 
+/*****************************************************************************/
+/* Asynchronous writer
+ *
+ * When verbose, messages are not written by the thread logging them, but
+ * queued and written by a background thread, so that the download timing
+ * doesn't depend on how fast the logs are written. The queue is bounded;
+ * messages logged while it is full are dropped, and the number of dropped
+ * messages is reported afterwards. Hex dumps of frames are also built by the
+ * background thread, from a copy of the printable bytes. Errors wait until
+ * everything logged before them is written, as they may abort the program. */
+
+/* Max number of messages waiting to be written */
+#define LOG_QUEUE_MAX_LENGTH 4096
+
+typedef struct {
+    time_t        time;
+    const gchar  *level;
+    gboolean      err;
+    gchar        *message;
+    /* Deferred hex dump, with static prefix and suffix strings */
+    const gchar  *hex_prefix;
+    const gchar  *hex_suffix;
+    guint8       *hex_data;
+    gsize         hex_data_size;
+    gsize         hex_total_size;
+} LogEntry;
+
+static GThread  *writer_thread;
+static GMutex    writer_lock;
+static GCond     writer_cond;
+static GCond     writer_drained_cond;
+static GQueue    writer_queue = G_QUEUE_INIT;
+static gboolean  writer_busy;
+static gboolean  writer_stopping;
+static guint     writer_n_dropped;
+
 static void
-log_handler (const gchar    *log_domain,
-             GLogLevelFlags  log_level,
-             const gchar    *message,
-             gpointer        user_data)
+log_entry_free (LogEntry *entry)
 {
-    const gchar *log_level_str;
-    time_t       now;
-    gchar        time_str[64];
-    struct tm   *local_time;
-    gboolean     err;
+    g_free (entry->message);
+    g_free (entry->hex_data);
+    g_slice_free (LogEntry, entry);
+}
 
-    /* Nothing to do if we're silent */
-    if (stdout_silent_flag && !verbose_log_file)
+static void
+log_write (time_t       now,
+           const gchar *log_level_str,
+           gboolean     err,
+           const gchar *message)
+{
+    gchar     time_str[64];
+    struct tm local_time;
+
+    /* Messages may also be logged from worker threads */
+    localtime_r (&now, &local_time);
+    strftime (time_str, 64, "%d %b %Y, %H:%M:%S", &local_time);
+
+    if (verbose_log_file)
+        g_fprintf (verbose_log_file,
+                   "[%s] %s %s\n",
+                   time_str,
+                   log_level_str,
+                   message);
+
+    if (stdout_verbose_flag || err)
+        g_fprintf (err ? stderr : stdout,
+                   "[%s] %s %s\n",
+                   time_str,
+                   log_level_str,
+                   message);
+}
+
+static void
+log_entry_write (LogEntry *entry)
+{
+    gchar *printable;
+    gchar *message;
+
+    if (!entry->hex_prefix) {
+        log_write (entry->time, entry->level, entry->err, entry->message);
+        return;
+    }
+
+    printable = qfu_utils_str_hex (entry->hex_data, entry->hex_data_size, ':');
+    if (entry->hex_suffix)
+        message = g_strdup_printf ("%s %s%s [%" G_GSIZE_FORMAT ", %s]",
+                                   entry->hex_prefix,
+                                   printable ? printable : "",
+                                   entry->hex_data_size < entry->hex_total_size ? "..." : "",
+                                   entry->hex_total_size,
+                                   entry->hex_suffix);
+    else
+        message = g_strdup_printf ("%s %s%s [%" G_GSIZE_FORMAT "]",
+                                   entry->hex_prefix,
+                                   printable ? printable : "",
+                                   entry->hex_data_size < entry->hex_total_size ? "..." : "",
+                                   entry->hex_total_size);
+    log_write (entry->time, entry->level, entry->err, message);
+    g_free (message);
+    g_free (printable);
+}
+
+static gpointer
+writer_thread_func (gpointer unused)
+{
+    g_mutex_lock (&writer_lock);
+    while (TRUE) {
+        GQueue entries = G_QUEUE_INIT;
+        guint  n_dropped;
+
+        while (g_queue_is_empty (&writer_queue) && !writer_n_dropped && !writer_stopping) {
+            writer_busy = FALSE;
+            g_cond_broadcast (&writer_drained_cond);
+            g_cond_wait (&writer_cond, &writer_lock);
+        }
+        if (g_queue_is_empty (&writer_queue) && !writer_n_dropped)
+            break;
+
+        /* Write the whole batch without the lock */
+        writer_busy = TRUE;
+        entries = writer_queue;
+        g_queue_init (&writer_queue);
+        n_dropped = writer_n_dropped;
+        writer_n_dropped = 0;
+        g_mutex_unlock (&writer_lock);
+
+        while (!g_queue_is_empty (&entries)) {
+            LogEntry *entry;
+
+            entry = g_queue_pop_head (&entries);
+            log_entry_write (entry);
+            log_entry_free (entry);
+        }
+
+        if (n_dropped > 0) {
+            gchar *message;
+
+            message = g_strdup_printf ("%u log messages dropped", n_dropped);
+            log_write (time (NULL), "-Warning **", FALSE, message);
+            g_free (message);
+        }
+
+        if (verbose_log_file)
+            fflush (verbose_log_file);
+        if (stdout_verbose_flag)
+            fflush (stdout);
+
+        g_mutex_lock (&writer_lock);
+    }
+    writer_busy = FALSE;
+    g_cond_broadcast (&writer_drained_cond);
+    g_mutex_unlock (&writer_lock);
+    return NULL;
+}
+
+static void
+writer_push (LogEntry *entry)
+{
+    gboolean err;
+
+    err = entry->err;
+
+    g_mutex_lock (&writer_lock);
+    if (g_queue_get_length (&writer_queue) >= LOG_QUEUE_MAX_LENGTH && !err) {
+        writer_n_dropped++;
+        log_entry_free (entry);
+    } else {
+        g_queue_push_tail (&writer_queue, entry);
+        g_cond_signal (&writer_cond);
+    }
+
+    /* Wait until errors are written */
+    if (err && writer_thread != g_thread_self ()) {
+        while (!g_queue_is_empty (&writer_queue) || writer_busy)
+            g_cond_wait (&writer_drained_cond, &writer_lock);
+    }
+    g_mutex_unlock (&writer_lock);
+}
+
+static void
+writer_start (void)
+{
+    GError *error = NULL;
+
+    writer_thread = g_thread_try_new ("qfu-log", writer_thread_func, NULL, &error);
+    if (!writer_thread) {
+        g_printerr ("warning: cannot start log writer thread, logging synchronously: %s\n", error->message);
+        g_error_free (error);
+    }
+}
+
+static void
+writer_stop (void)
+{
+    if (!writer_thread)
         return;
 
-    now = time ((time_t *) NULL);
-    local_time = localtime (&now);
-    strftime (time_str, 64, "%d %b %Y, %H:%M:%S", local_time);
-    err = FALSE;
+    g_mutex_lock (&writer_lock);
+    writer_stopping = TRUE;
+    g_cond_signal (&writer_cond);
+    g_mutex_unlock (&writer_lock);
+
+    g_thread_join (writer_thread);
+    writer_thread = NULL;
+}
+
+/*****************************************************************************/
+
+static const gchar *
+log_level_get_string (GLogLevelFlags  log_level,
+                      gboolean       *err)
+{
+    *err = FALSE;
 
     switch (log_level) {
     case G_LOG_LEVEL_WARNING:
-        log_level_str = "-Warning **";
-        break;
+        return "-Warning **";
 
     case G_LOG_LEVEL_CRITICAL:
     case G_LOG_FLAG_FATAL:
     case G_LOG_LEVEL_ERROR:
-        log_level_str = "-Error **";
-        err = TRUE;
-        break;
+        *err = TRUE;
+        return "-Error **";
 
     case G_LOG_LEVEL_DEBUG:
-        log_level_str = "[Debug]";
-        break;
+        return "[Debug]";
 
     default:
-        log_level_str = "";
-        break;
+        return "";
     }
+}
 
-    if (verbose_log_file) {
-        g_fprintf (verbose_log_file,
-                   "[%s] %s %s\n",
-                   time_str,
-                   log_level_str,
-                   message);
+static void
+log_handler (const gchar    *log_domain,
+             GLogLevelFlags  log_level,
+             const gchar    *message,
+             gpointer        user_data)
+{
+    const gchar *log_level_str;
+    gboolean     err;
+
+    /* Nothing to do if we're silent */
+    if (stdout_silent_flag && !verbose_log_file)
+        return;
+
+    log_level_str = log_level_get_string (log_level, &err);
+
+    if (writer_thread) {
+        LogEntry *entry;
+
+        entry = g_slice_new0 (LogEntry);
+        entry->time = time (NULL);
+        entry->level = log_level_str;
+        entry->err = err;
+        entry->message = g_strdup (message);
+        writer_push (entry);
+        return;
+    }
+
+    log_write (time (NULL), log_level_str, err, message);
+    if (verbose_log_file)
         fflush (verbose_log_file);
+}
+
+void
+qfu_log_debug_hex (const gchar  *prefix,
+                   gconstpointer data,
+                   gsize         data_size,
+                   gsize         total_size,
+                   const gchar  *suffix)
+{
+    LogEntry *entry;
+    gchar    *printable;
+
+    if (!qfu_log_get_verbose ())
+        return;
+
+    /* Synchronous logging, formatted right away */
+    if (!writer_thread) {
+        printable = qfu_utils_str_hex (data, data_size, ':');
+        if (suffix)
+            g_debug ("%s %s%s [%" G_GSIZE_FORMAT ", %s]", prefix, printable ? printable : "", data_size < total_size ? "..." : "", total_size, suffix);
+        else
+            g_debug ("%s %s%s [%" G_GSIZE_FORMAT "]", prefix, printable ? printable : "", data_size < total_size ? "..." : "", total_size);
+        g_free (printable);
+        return;
     }
 
-    if (stdout_verbose_flag || err)
-        g_fprintf (err ? stderr : stdout,
-                   "[%s] %s %s\n",
-                   time_str,
-                   log_level_str,
-                   message);
+    entry = g_slice_new0 (LogEntry);
+    entry->time = time (NULL);
+    entry->level = "[Debug]";
+    entry->hex_prefix = prefix;
+    entry->hex_suffix = suffix;
+    entry->hex_data = g_memdup (data, data_size);
+    entry->hex_data_size = data_size;
+    entry->hex_total_size = total_size;
+    writer_push (entry);
 }
 
 gboolean
@@ -131,6 +373,10 @@ qfu_log_init (gboolean     stdout_verbose,
         }
     }
 
+    /* Verbose logs are written in the background */
+    if (stdout_verbose_flag || verbose_log_file)
+        writer_start ();
+
     /* Default application logging */
     g_log_set_handler (NULL,  G_LOG_LEVEL_MASK, log_handler, NULL);
 
@@ -152,6 +398,9 @@ qfu_log_init (gboolean     stdout_verbose,
 void
 qfu_log_shutdown (void)
 {
+    /* Everything queued is written before closing */
+    writer_stop ();
+
     if (verbose_log_file)
         fclose (verbose_log_file);
 }
@@ -33,6 +33,15 @@ void     qfu_log_shutdown           (void);
 gboolean qfu_log_get_verbose        (void);
 gboolean qfu_log_get_verbose_stdout (void);
 
+/* Debug message with a hex dump of the first data_size bytes of a buffer of
+ * total_size bytes, built in the background when possible. The prefix and
+ * suffix must be static strings. */
+void     qfu_log_debug_hex          (const gchar   *prefix,
+                                     gconstpointer  data,
+                                     gsize          data_size,
+                                     gsize          total_size,
+                                     const gchar   *suffix);
+
 G_END_DECLS
 
 #endif /* QFU_LOG_H */
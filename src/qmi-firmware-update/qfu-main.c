@@ -30,6 +30,7 @@
 #include <gio/gio.h>
 
 #include "qfu-log.h"
+#include "qfu-image.h"
 #include "qfu-operation.h"
 #include "qfu-device-selection.h"
 #include "qfu-udev-helpers.h"
@@ -48,8 +49,8 @@ static guint   devnum;
 static guint16 vid;
 static guint16 pid;
 #endif
-static gchar *cdc_wdm_str;
-static gchar *tty_str;
+static gchar **cdc_wdm_strv;
+static gchar **tty_strv;
 
 #if defined MM_RUNTIME_CHECK_ENABLED
 static gboolean ignore_mm_runtime_check_flag;
@@ -75,6 +76,12 @@ static gboolean   action_update_qdl_flag;
 
 /* Verify */
 static gboolean   action_verify_flag;
+static gchar     *verify_summary_str;
+
+/* QDL download, in both update operations */
+static gint       qdl_window_size_int;
+static gint       qdl_chunk_size_int;
+static gboolean   qdl_usb_flag;
 
 /* Main */
 static gchar    **image_strv;
@@ -199,12 +206,12 @@ static GOptionEntry context_selection_entries[] = {
       "VID[:PID]"
     },
 #endif /* WITH_UDEV */
-    { "cdc-wdm", 'w', 0, G_OPTION_ARG_FILENAME, &cdc_wdm_str,
-      "Select device by QMI/MBIM cdc-wdm device path (e.g. /dev/cdc-wdm0).",
+    { "cdc-wdm", 'w', 0, G_OPTION_ARG_FILENAME_ARRAY, &cdc_wdm_strv,
+      "Select device by QMI/MBIM cdc-wdm device path (e.g. /dev/cdc-wdm0); may be given multiple times in update operations.",
       "[PATH]"
     },
-    { "tty", 't', 0, G_OPTION_ARG_FILENAME, &tty_str,
-      "Select device by serial device path (e.g. /dev/ttyUSB2).",
+    { "tty", 't', 0, G_OPTION_ARG_FILENAME_ARRAY, &tty_strv,
+      "Select device by serial device path (e.g. /dev/ttyUSB2); may be given multiple times in update operations.",
       "[PATH]"
     },
     { NULL }
@@ -269,6 +276,10 @@ static GOptionEntry context_verify_entries[] = {
       "Analyze and verify firmware images.",
       NULL
     },
+    { "verify-summary", 0, 0, G_OPTION_ARG_FILENAME, &verify_summary_str,
+      "Write a JSON summary of the verification to the given file, or to stdout if '-'.",
+      "[PATH]"
+    },
     { NULL }
 };
 
@@ -292,6 +303,20 @@ static GOptionEntry context_main_entries[] = {
       "Open a cdc-wdm device in either QMI or MBIM mode (default)",
       NULL
     },
+    { "qdl-window-size", 0, 0, G_OPTION_ARG_INT, &qdl_window_size_int,
+      "Number of image chunks to keep in flight while downloading (default: as many as the device accepts, up to 8).",
+      "[N]"
+    },
+    { "qdl-chunk-size", 0, 0, G_OPTION_ARG_INT, &qdl_chunk_size_int,
+      "Size of the image chunks, in bytes, while downloading (default: 1 MiB, or less if the device advertises a smaller maximum).",
+      "[N]"
+    },
+#if defined WITH_UDEV
+    { "qdl-usb", 0, 0, G_OPTION_ARG_NONE, &qdl_usb_flag,
+      "Download with USB bulk transfers on the interface of the serial port, instead of through the serial driver.",
+      NULL
+    },
+#endif
 #if defined MM_RUNTIME_CHECK_ENABLED
     { "ignore-mm-runtime-check", 0, 0, G_OPTION_ARG_NONE, &ignore_mm_runtime_check_flag,
       "Ignore ModemManager runtime check",
@@ -424,6 +449,15 @@ print_help_examples (void)
              "    $ sudo " PROGRAM_NAME " \\\n"
              "          --update \\\n"
              "          -d 1199:68c0 \\\n"
+             "          9999999_9902574_SWI9X15C_05.05.66.00_00_GENNA-UMTS_005.028_000-field.spk\n"
+             "\n"
+             " e) An update operation running on several devices at the same time, each of\n"
+             "    them with its output prefixed by the name of its cdc-wdm device:\n"
+             "    $ sudo " PROGRAM_NAME " \\\n"
+             "          --update \\\n"
+             "          --cdc-wdm /dev/cdc-wdm0 \\\n"
+             "          --cdc-wdm /dev/cdc-wdm1 \\\n"
+             "          --cdc-wdm /dev/cdc-wdm2 \\\n"
              "          9999999_9902574_SWI9X15C_05.05.66.00_00_GENNA-UMTS_005.028_000-field.spk\n");
 
     g_print ("\n"
@@ -523,8 +557,9 @@ print_help_examples (void)
              "          SWI9X15C_05.05.58.00.cwe \\\n"
              "          SWI9X15C_05.05.58.00_Generic_005.025_002.nvu\n"
              "\n"
-             " b) Verify all .cwe, .nvu and .spk images inside a directory:\n"
-             "    $ find . -regex \".*\\.\\(nvu\\|spk\\|cwe\\)\" -exec " PROGRAM_NAME " -v -z {} \\;\n"
+             " b) Verify all .cwe, .nvu and .spk images inside a directory, with a JSON\n"
+             "    summary for scripts:\n"
+             "    $ find . -regex \".*\\.\\(nvu\\|spk\\|cwe\\)\" -exec " PROGRAM_NAME " -z --verify-summary=- {} +\n"
              "\n"
              " c) Image files may be given within .exe files; extract them with 7-Zip:\n"
              "    $ 7z x SWI9200M_3.5-Release13-SWI9200X_03.05.29.03.exe\n"
@@ -544,8 +579,9 @@ int main (int argc, char **argv)
     guint               n_actions_images_needed;
     guint               n_actions_device_needed;
     guint               n_actions_cdc_wdm_needed;
+    guint               n_actions_multiple_devices_allowed;
     gboolean            result = FALSE;
-    QfuDeviceSelection *device_selection = NULL;
+    GList              *device_selections = NULL;
     QmiDeviceOpenFlags  device_open_flags = QMI_DEVICE_OPEN_FLAGS_NONE;
 
     setlocale (LC_ALL, "");
@@ -614,12 +650,15 @@ int main (int argc, char **argv)
     n_actions_device_needed = (action_update_qdl_flag + action_reset_flag);
     /* Actions that allow using a cdc-wdm device */
     n_actions_cdc_wdm_needed = (action_reset_flag);
+    /* Actions that allow running on multiple devices at the same time */
+    n_actions_multiple_devices_allowed = (action_update_qdl_flag);
 
 #if defined WITH_UDEV
     n_actions                += action_update_flag;
     n_actions_cdc_wdm_needed += action_update_flag;
     n_actions_images_needed  += action_update_flag;
     n_actions_device_needed  += action_update_flag;
+    n_actions_multiple_devices_allowed += action_update_flag;
 #endif
 
     /* We don't allow multiple actions at the same time */
@@ -640,15 +679,59 @@ int main (int argc, char **argv)
 
     /* device selection must be performed for update and reset operations */
     if (n_actions_device_needed) {
+        guint n_cdc_wdm;
+        guint n_tty;
+
+        n_cdc_wdm = (cdc_wdm_strv ? g_strv_length (cdc_wdm_strv) : 0);
+        n_tty     = (tty_strv ? g_strv_length (tty_strv) : 0);
+
+        if (n_cdc_wdm + n_tty > 1) {
+            guint i;
+
+            /* One device selection per path given */
+            if (!n_actions_multiple_devices_allowed) {
+                g_printerr ("error: multiple devices may only be selected in update operations\n");
+                goto out;
+            }
 #if defined WITH_UDEV
-        device_selection = qfu_device_selection_new (cdc_wdm_str, tty_str, vid, pid, busnum, devnum, &error);
+            if (vid || devnum) {
+                g_printerr ("error: couldn't select device: Only one device selection option may be provided\n");
+                goto out;
+            }
+#endif
+            for (i = 0; i < (n_cdc_wdm + n_tty); i++) {
+                QfuDeviceSelection *device_selection;
+
+                device_selection = qfu_device_selection_new (i < n_cdc_wdm ? cdc_wdm_strv[i] : NULL,
+                                                             i < n_cdc_wdm ? NULL : tty_strv[i - n_cdc_wdm],
+                                                             0, 0, 0, 0, &error);
+                if (!device_selection) {
+                    g_printerr ("error: couldn't select device '%s': %s\n",
+                                i < n_cdc_wdm ? cdc_wdm_strv[i] : tty_strv[i - n_cdc_wdm],
+                                error->message);
+                    g_error_free (error);
+                    goto out;
+                }
+                device_selections = g_list_append (device_selections, device_selection);
+            }
+        } else {
+            QfuDeviceSelection *device_selection;
+
+#if defined WITH_UDEV
+            device_selection = qfu_device_selection_new (n_cdc_wdm ? cdc_wdm_strv[0] : NULL,
+                                                         n_tty ? tty_strv[0] : NULL,
+                                                         vid, pid, busnum, devnum, &error);
 #else
-        device_selection = qfu_device_selection_new (cdc_wdm_str, tty_str, 0, 0, 0, 0, &error);
+            device_selection = qfu_device_selection_new (n_cdc_wdm ? cdc_wdm_strv[0] : NULL,
+                                                         n_tty ? tty_strv[0] : NULL,
+                                                         0, 0, 0, 0, &error);
 #endif
-        if (!device_selection) {
-            g_printerr ("error: couldn't select device:: %s\n", error->message);
-            g_error_free (error);
-            goto out;
+            if (!device_selection) {
+                g_printerr ("error: couldn't select device:: %s\n", error->message);
+                g_error_free (error);
+                goto out;
+            }
+            device_selections = g_list_append (NULL, device_selection);
         }
 
 #if defined MM_RUNTIME_CHECK_ENABLED
@@ -694,11 +777,26 @@ int main (int argc, char **argv)
             device_open_flags |= QMI_DEVICE_OPEN_FLAGS_AUTO;
     }
 
+    /* Validate QDL window size, [1,G_MAXUINT8]; 0 flags that it's selected
+     * depending on what the device accepts */
+    if (qdl_window_size_int < 0 || qdl_window_size_int > G_MAXUINT8) {
+        g_printerr ("error: invalid QDL window size\n");
+        goto out;
+    }
+
+    /* Validate QDL chunk size; 0 flags that it's selected depending on what
+     * the device advertises */
+    if (qdl_chunk_size_int != 0 && (qdl_chunk_size_int < QFU_IMAGE_MIN_CHUNK_SIZE || qdl_chunk_size_int > QFU_IMAGE_MAX_CHUNK_SIZE)) {
+        g_printerr ("error: invalid QDL chunk size, must be within [%u,%u] bytes\n",
+                    QFU_IMAGE_MIN_CHUNK_SIZE, QFU_IMAGE_MAX_CHUNK_SIZE);
+        goto out;
+    }
+
     /* Run */
 
 #if defined WITH_UDEV
     if (action_update_flag) {
-        g_assert (QFU_IS_DEVICE_SELECTION (device_selection));
+        g_assert (device_selections);
 
         /* Validate storage index, just (0,G_MAXUINT8] for now. The value 0 is also not
          * valid, but we use it to flag when no specific index has been requested. */
@@ -708,7 +806,7 @@ int main (int argc, char **argv)
         }
 
         result = qfu_operation_update_run ((const gchar **) image_strv,
-                                           device_selection,
+                                           device_selections,
                                            firmware_version_str,
                                            config_version_str,
                                            carrier_str,
@@ -716,26 +814,32 @@ int main (int argc, char **argv)
                                            ignore_version_errors_flag,
                                            override_download_flag,
                                            (guint8) modem_storage_index_int,
-                                           skip_validation_flag);
+                                           skip_validation_flag,
+                                           (guint8) qdl_window_size_int,
+                                           (gsize) qdl_chunk_size_int,
+                                           qdl_usb_flag);
         goto out;
     }
 #endif /* WITH_UDEV */
 
     if (action_update_qdl_flag) {
-        g_assert (QFU_IS_DEVICE_SELECTION (device_selection));
+        g_assert (device_selections);
         result = qfu_operation_update_qdl_run ((const gchar **) image_strv,
-                                               device_selection);
+                                               device_selections,
+                                               (guint8) qdl_window_size_int,
+                                               (gsize) qdl_chunk_size_int,
+                                               qdl_usb_flag);
         goto out;
     }
 
     if (action_reset_flag) {
-        g_assert (QFU_IS_DEVICE_SELECTION (device_selection));
-        result = qfu_operation_reset_run (device_selection, device_open_flags);
+        g_assert (device_selections && !device_selections->next);
+        result = qfu_operation_reset_run (QFU_DEVICE_SELECTION (device_selections->data), device_open_flags);
         goto out;
     }
 
     if (action_verify_flag) {
-        result = qfu_operation_verify_run ((const gchar **) image_strv);
+        result = qfu_operation_verify_run ((const gchar **) image_strv, verify_summary_str);
         goto out;
     }
 
@@ -748,8 +852,7 @@ out:
     /* Clean exit for a clean memleak report */
     if (context)
         g_option_context_free (context);
-    if (device_selection)
-        g_object_unref (device_selection);
+    g_list_free_full (device_selections, g_object_unref);
 
     return (result ? EXIT_SUCCESS : EXIT_FAILURE);
 }
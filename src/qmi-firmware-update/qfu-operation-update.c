@@ -25,11 +25,14 @@
 
 #include "qfu-operation.h"
 #include "qfu-updater.h"
+#include "qfu-image-factory.h"
 
 typedef struct {
     GMainLoop    *loop;
     GCancellable *cancellable;
     gboolean      result;
+    guint         n_pending;
+    guint         n_failed;
 } UpdateOperation;
 
 static gboolean
@@ -55,39 +58,53 @@ signal_handler (UpdateOperation *operation)
 }
 
 static void
-run_ready (QfuUpdater        *updater,
-           GAsyncResult      *res,
+run_ready (QfuUpdater      *updater,
+           GAsyncResult    *res,
            UpdateOperation *operation)
 {
-    GError *error = NULL;
+    GError      *error = NULL;
+    const gchar *label;
+
+    label = qfu_updater_get_label (updater);
 
     if (!qfu_updater_run_finish (updater, res, &error)) {
-        g_printerr ("error: %s\n", error->message);
+        if (label)
+            g_printerr ("[%s] error: %s\n", label, error->message);
+        else
+            g_printerr ("error: %s\n", error->message);
         if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED))
             g_printerr ("note: you can ignore this error using --ignore-version-errors\n");
         g_error_free (error);
-    } else {
+        operation->n_failed++;
+        operation->result = FALSE;
+    } else if (label)
+        g_print ("[%s] firmware update operation finished successfully\n", label);
+    else
         g_print ("firmware update operation finished successfully\n");
-        operation->result = TRUE;
-    }
 
-    g_idle_add ((GSourceFunc) g_main_loop_quit, operation->loop);
+    g_assert (operation->n_pending > 0);
+    if (--operation->n_pending == 0)
+        g_idle_add ((GSourceFunc) g_main_loop_quit, operation->loop);
 }
 
 static gboolean
-operation_update_run (QfuUpdater   *updater,
+operation_update_run (GList        *updaters,
                       const gchar **images)
 {
     UpdateOperation operation = {
         .loop        = NULL,
         .cancellable = NULL,
-        .result      = FALSE,
+        .result      = TRUE,
+        .n_pending   = 0,
+        .n_failed    = 0,
     };
-    GList *image_file_list = NULL;
-    guint  i;
+    GList  *image_list = NULL;
+    GList  *l;
+    GError *error = NULL;
+    guint   i;
 
     g_assert (images);
-    g_assert (QFU_IS_UPDATER (updater));
+    g_assert (updaters);
 
     /* Create runtime context */
     operation.loop        = g_main_loop_new (NULL, FALSE);
@@ -98,15 +115,39 @@ operation_update_run (QfuUpdater   *updater,
     g_unix_signal_add (SIGHUP,  (GSourceFunc) signal_handler, &operation);
     g_unix_signal_add (SIGTERM, (GSourceFunc) signal_handler, &operation);
 
-    /* Create list of image files */
-    for (i = 0; images[i]; i++)
-        image_file_list = g_list_append (image_file_list, g_file_new_for_commandline_arg (images[i]));
+    /* Load the images once, they're shared by all the updaters */
+    for (i = 0; images[i]; i++) {
+        GFile    *file;
+        QfuImage *image;
+
+        file = g_file_new_for_commandline_arg (images[i]);
+        image = qfu_image_factory_build (file, operation.cancellable, &error);
+        g_object_unref (file);
+        if (!image) {
+            g_printerr ("error: %s\n", error->message);
+            g_error_free (error);
+            operation.result = FALSE;
+            goto out;
+        }
+        image_list = g_list_append (image_list, image);
+    }
+
+    /* The integrity of the images is checked by the updaters, in parallel
+     * with the preparation of the devices */
 
     /* Run! */
-    qfu_updater_run (updater, image_file_list, operation.cancellable, (GAsyncReadyCallback) run_ready, &operation);
-    g_list_free_full (image_file_list, g_object_unref);
+    for (l = updaters; l; l = g_list_next (l)) {
+        operation.n_pending++;
+        qfu_updater_run (QFU_UPDATER (l->data), image_list, operation.cancellable, (GAsyncReadyCallback) run_ready, &operation);
+    }
     g_main_loop_run (operation.loop);
 
+    if (updaters->next)
+        g_print ("firmware update operation finished in %u devices: %u failed\n",
+                 g_list_length (updaters), operation.n_failed);
+
+out:
+    g_list_free_full (image_list, g_object_unref);
     if (operation.cancellable)
         g_object_unref (operation.cancellable);
     if (operation.loop)
@@ -115,11 +156,34 @@ operation_update_run (QfuUpdater   *updater,
     return operation.result;
 }
 
+/* When updating several devices, each one gets its output prefixed by the
+ * name of the device selected */
+static void
+update_set_labels (GList *updaters,
+                   GList *device_selections)
+{
+    GList *l, *m;
+
+    if (!updaters->next)
+        return;
+
+    for (l = updaters, m = device_selections; l && m; l = g_list_next (l), m = g_list_next (m)) {
+        const gchar *preferred;
+        gchar       *label;
+
+        preferred = qfu_device_selection_get_preferred_device (QFU_DEVICE_SELECTION (m->data));
+        g_assert (preferred);
+        label = g_path_get_basename (preferred);
+        qfu_updater_set_label (QFU_UPDATER (l->data), label);
+        g_free (label);
+    }
+}
+
 #if defined WITH_UDEV
 
 gboolean
 qfu_operation_update_run (const gchar        **images,
-                          QfuDeviceSelection  *device_selection,
+                          GList               *device_selections,
                           const gchar         *firmware_version,
                           const gchar         *config_version,
                           const gchar         *carrier,
@@ -127,24 +191,35 @@ qfu_operation_update_run (const gchar        **images,
                           gboolean             ignore_version_errors,
                           gboolean             override_download,
                           guint8               modem_storage_index,
-                          gboolean             skip_validation)
+                          gboolean             skip_validation,
+                          guint8               qdl_window_size,
+                          gsize                qdl_chunk_size,
+                          gboolean             qdl_usb)
 {
-    QfuUpdater *updater = NULL;
-    gboolean    result;
+    GList    *updaters = NULL;
+    GList    *l;
+    gboolean  result;
 
     g_assert (images);
-
-    updater = qfu_updater_new (device_selection,
-                               firmware_version,
-                               config_version,
-                               carrier,
-                               device_open_flags,
-                               ignore_version_errors,
-                               override_download,
-                               modem_storage_index,
-                               skip_validation);
-    result = operation_update_run (updater, images);
-    g_object_unref (updater);
+    g_assert (device_selections);
+
+    for (l = device_selections; l; l = g_list_next (l))
+        updaters = g_list_append (updaters,
+                                  qfu_updater_new (QFU_DEVICE_SELECTION (l->data),
+                                                   firmware_version,
+                                                   config_version,
+                                                   carrier,
+                                                   device_open_flags,
+                                                   ignore_version_errors,
+                                                   override_download,
+                                                   modem_storage_index,
+                                                   skip_validation,
+                                                   qdl_window_size,
+                                                   qdl_chunk_size,
+                                                   qdl_usb));
+    update_set_labels (updaters, device_selections);
+    result = operation_update_run (updaters, images);
+    g_list_free_full (updaters, g_object_unref);
     return result;
 }
 
@@ -152,15 +227,22 @@ qfu_operation_update_run (const gchar        **images,
 
 gboolean
 qfu_operation_update_qdl_run (const gchar        **images,
-                              QfuDeviceSelection  *device_selection)
+                              GList               *device_selections,
+                              guint8               qdl_window_size,
+                              gsize                qdl_chunk_size,
+                              gboolean             qdl_usb)
 {
-    QfuUpdater *updater = NULL;
-    gboolean    result;
+    GList    *updaters = NULL;
+    GList    *l;
+    gboolean  result;
 
     g_assert (images);
+    g_assert (device_selections);
 
-    updater = qfu_updater_new_qdl (device_selection);
-    result = operation_update_run (updater, images);
-    g_object_unref (updater);
+    for (l = device_selections; l; l = g_list_next (l))
+        updaters = g_list_append (updaters, qfu_updater_new_qdl (QFU_DEVICE_SELECTION (l->data), qdl_window_size, qdl_chunk_size, qdl_usb));
+    update_set_labels (updaters, device_selections);
+    result = operation_update_run (updaters, images);
+    g_list_free_full (updaters, g_object_unref);
     return result;
 }
@@ -19,6 +19,8 @@
  * Copyright (C) 2016-2017 Aleksander Morgado <aleksander@aleksander.es>
  */
 
+#include <string.h>
+
 #include <glib-object.h>
 #include <gio/gio.h>
 
@@ -30,8 +32,39 @@
 
 #define VALIDATE_STR_NA(str) (str && str[0] ? str : "n/a")
 
+/* Images are verified in parallel, each job building its report in memory;
+ * reports are then printed in the same order as the images were given */
+typedef struct {
+    const gchar *image_path;
+    GString     *report;
+    gchar       *error;
+    gboolean     valid;
+
+    /* Summary */
+    gchar       *type;
+    gchar       *compression;
+    goffset      size;
+    gboolean     integrity_ok;
+    gchar       *firmware_version;
+    gchar       *config_version;
+    gchar       *carrier;
+} VerifyJob;
+
+static void
+verify_job_clear (VerifyJob *job)
+{
+    g_string_free (job->report, TRUE);
+    g_free (job->error);
+    g_free (job->type);
+    g_free (job->compression);
+    g_free (job->firmware_version);
+    g_free (job->config_version);
+    g_free (job->carrier);
+}
+
 static void
-print_image_cwe (QfuImageCwe *image,
+print_image_cwe (GString     *report,
+                 QfuImageCwe *image,
                  const gchar *indent_prefix,
                  const gchar *id_str,
                  guint        idx)
@@ -39,17 +72,17 @@ print_image_cwe (QfuImageCwe *image,
     guint i;
     guint j;
 
-    g_print ("%s-------------------------------------\n", indent_prefix);
-    g_print ("%s[cwe %s] type:    %s\n",
-             indent_prefix, id_str, VALIDATE_STR_NA (qfu_image_cwe_embedded_header_get_type (image, idx)));
-    g_print ("%s[cwe %s] product: %s\n",
-             indent_prefix, id_str, VALIDATE_STR_NA (qfu_image_cwe_embedded_header_get_product (image, idx)));
-    g_print ("%s[cwe %s] version: %s\n",
-             indent_prefix, id_str, VALIDATE_STR_NA (qfu_image_cwe_embedded_header_get_version (image, idx)));
-    g_print ("%s[cwe %s] date:    %s\n",
-             indent_prefix, id_str, VALIDATE_STR_NA (qfu_image_cwe_embedded_header_get_date (image, idx)));
-    g_print ("%s[cwe %s] size:    %" G_GUINT32_FORMAT "\n",
-             indent_prefix, id_str, qfu_image_cwe_embedded_header_get_image_size (image, idx));
+    g_string_append_printf (report, "%s-------------------------------------\n", indent_prefix);
+    g_string_append_printf (report, "%s[cwe %s] type:    %s\n",
+                            indent_prefix, id_str, VALIDATE_STR_NA (qfu_image_cwe_embedded_header_get_type (image, idx)));
+    g_string_append_printf (report, "%s[cwe %s] product: %s\n",
+                            indent_prefix, id_str, VALIDATE_STR_NA (qfu_image_cwe_embedded_header_get_product (image, idx)));
+    g_string_append_printf (report, "%s[cwe %s] version: %s\n",
+                            indent_prefix, id_str, VALIDATE_STR_NA (qfu_image_cwe_embedded_header_get_version (image, idx)));
+    g_string_append_printf (report, "%s[cwe %s] date:    %s\n",
+                            indent_prefix, id_str, VALIDATE_STR_NA (qfu_image_cwe_embedded_header_get_date (image, idx)));
+    g_string_append_printf (report, "%s[cwe %s] size:    %" G_GUINT32_FORMAT "\n",
+                            indent_prefix, id_str, qfu_image_cwe_embedded_header_get_image_size (image, idx));
 
     for (i = idx + 1, j = 0; i < qfu_image_cwe_get_n_embedded_headers (image); i++) {
         gchar *sub_id_str;
@@ -62,67 +95,194 @@ print_image_cwe (QfuImageCwe *image,
         sub_id_str = g_strdup_printf ("%s.%u", id_str, j++);
         sub_indent_prefix = g_strdup_printf ("%s    ", indent_prefix);
 
-        print_image_cwe (image, sub_indent_prefix, sub_id_str, i);
+        print_image_cwe (report, image, sub_indent_prefix, sub_id_str, i);
 
         g_free (sub_id_str);
         g_free (sub_indent_prefix);
     }
 }
 
-static gboolean
-operation_verify_run_single (const gchar *image_path)
+/* Runs in a worker thread: the image headers are read from the mapped file
+ * when possible, and nothing is printed from here */
+static void
+verify_job_run (VerifyJob *job,
+                gpointer   unused)
 {
     QfuImage *image;
     GFile    *file;
     GError   *error = NULL;
-    gboolean  result = FALSE;
+    GString  *report = job->report;
 
-    file = g_file_new_for_commandline_arg (image_path);
+    file = g_file_new_for_commandline_arg (job->image_path);
     image = qfu_image_factory_build (file, NULL, &error);
+    g_object_unref (file);
     if (!image) {
-        g_printerr ("error: couldn't detect image type: %s\n", error->message);
+        job->error = g_strdup_printf ("couldn't detect image type: %s", error->message);
         g_error_free (error);
-        goto out;
+        return;
     }
 
-    g_print ("\n");
-    g_print ("Firmware image:\n");
-    g_print ("  filename:      %s\n", qfu_image_get_display_name (image));
-    g_print ("  detected type: %s\n", qfu_image_type_get_string (qfu_image_get_image_type (image)));
-    g_print ("  size:          %" G_GOFFSET_FORMAT " bytes\n", qfu_image_get_size (image));
-    g_print ("    header:      %" G_GOFFSET_FORMAT " bytes\n", qfu_image_get_header_size (image));
-    g_print ("    data:        %" G_GOFFSET_FORMAT " bytes\n", qfu_image_get_data_size (image));
-    g_print ("  data chunks:   %" G_GUINT16_FORMAT " (%lu bytes/chunk)\n", qfu_image_get_n_data_chunks (image), (gulong) QFU_IMAGE_CHUNK_SIZE);
+    job->type = g_strdup (qfu_image_type_get_string (qfu_image_get_image_type (image)));
+    job->compression = g_strdup (qfu_image_compression_get_string (qfu_image_get_compression (image)));
+    job->size = qfu_image_get_size (image);
+
+    g_string_append (report, "\n");
+    g_string_append (report, "Firmware image:\n");
+    g_string_append_printf (report, "  filename:      %s\n", qfu_image_get_display_name (image));
+    g_string_append_printf (report, "  detected type: %s\n", job->type);
+    g_string_append_printf (report, "  compression:   %s\n", job->compression);
+    g_string_append_printf (report, "  size:          %" G_GOFFSET_FORMAT " bytes\n", job->size);
+    g_string_append_printf (report, "    header:      %" G_GOFFSET_FORMAT " bytes\n", qfu_image_get_header_size (image));
+    g_string_append_printf (report, "    data:        %" G_GOFFSET_FORMAT " bytes\n", qfu_image_get_data_size (image));
+    g_string_append_printf (report, "  data chunks:   %" G_GUINT16_FORMAT " (%lu bytes/chunk)\n", qfu_image_get_n_data_chunks (image, QFU_IMAGE_CHUNK_SIZE), (gulong) QFU_IMAGE_CHUNK_SIZE);
+
+    if (!qfu_image_check_integrity (image, NULL, &error)) {
+        g_string_append (report, "  integrity:     failed\n");
+        job->error = g_strdup_printf ("image integrity check failed: %s", error->message);
+        g_error_free (error);
+        goto out;
+    }
+    g_string_append (report, "  integrity:     ok\n");
+    job->integrity_ok = TRUE;
 
     if (QFU_IS_IMAGE_CWE (image)) {
         QfuImageCwe *image_cwe = QFU_IMAGE_CWE (image);
 
-        g_print ("  [cwe] detected firmware version: %s\n",
-                 VALIDATE_STR_NA (qfu_image_cwe_get_parsed_firmware_version (image_cwe)));
-        g_print ("  [cwe] detected config version:   %s\n",
-                 VALIDATE_STR_NA (qfu_image_cwe_get_parsed_config_version (image_cwe)));
-        g_print ("  [cwe] detected carrier:          %s\n",
-                 VALIDATE_STR_NA (qfu_image_cwe_get_parsed_carrier (image_cwe)));
+        job->firmware_version = g_strdup (qfu_image_cwe_get_parsed_firmware_version (image_cwe));
+        job->config_version   = g_strdup (qfu_image_cwe_get_parsed_config_version (image_cwe));
+        job->carrier          = g_strdup (qfu_image_cwe_get_parsed_carrier (image_cwe));
 
-        print_image_cwe (image_cwe, "  ", "0", 0);
+        g_string_append_printf (report, "  [cwe] detected firmware version: %s\n", VALIDATE_STR_NA (job->firmware_version));
+        g_string_append_printf (report, "  [cwe] detected config version:   %s\n", VALIDATE_STR_NA (job->config_version));
+        g_string_append_printf (report, "  [cwe] detected carrier:          %s\n", VALIDATE_STR_NA (job->carrier));
+
+        print_image_cwe (report, image_cwe, "  ", "0", 0);
     }
 
-    result = TRUE;
+    job->valid = TRUE;
 
 out:
-    if (image)
-        g_object_unref (image);
+    g_object_unref (image);
+}
+
+/******************************************************************************/
+/* Summary */
+
+static void
+summary_append_string (GString     *summary,
+                       const gchar *key,
+                       const gchar *value)
+{
+    const gchar *p;
+
+    g_string_append_printf (summary, ", \"%s\": ", key);
+    if (!value) {
+        g_string_append (summary, "null");
+        return;
+    }
+
+    g_string_append_c (summary, '"');
+    for (p = value; *p; p++) {
+        switch (*p) {
+        case '"':
+            g_string_append (summary, "\\\"");
+            break;
+        case '\\':
+            g_string_append (summary, "\\\\");
+            break;
+        default:
+            if ((guchar) *p < 0x20)
+                g_string_append_printf (summary, "\\u%04x", (guint) *p);
+            else
+                g_string_append_c (summary, *p);
+            break;
+        }
+    }
+    g_string_append_c (summary, '"');
+}
+
+/* A JSON array with one object per image, in the order given */
+static gboolean
+write_summary (const gchar *summary_path,
+               VerifyJob   *jobs,
+               guint        n_jobs)
+{
+    GString  *summary;
+    GError   *error = NULL;
+    gboolean  result = TRUE;
+    guint     i;
+
+    summary = g_string_new ("[\n");
+    for (i = 0; i < n_jobs; i++) {
+        g_string_append_printf (summary, "  { \"valid\": %s", jobs[i].valid ? "true" : "false");
+        summary_append_string (summary, "path", jobs[i].image_path);
+        summary_append_string (summary, "type", jobs[i].type);
+        summary_append_string (summary, "compression", jobs[i].compression);
+        g_string_append_printf (summary, ", \"size\": %" G_GOFFSET_FORMAT, jobs[i].size);
+        g_string_append_printf (summary, ", \"integrity\": %s", jobs[i].integrity_ok ? "true" : "false");
+        summary_append_string (summary, "firmware-version", jobs[i].firmware_version);
+        summary_append_string (summary, "config-version", jobs[i].config_version);
+        summary_append_string (summary, "carrier", jobs[i].carrier);
+        summary_append_string (summary, "error", jobs[i].error);
+        g_string_append_printf (summary, " }%s\n", (i < n_jobs - 1) ? "," : "");
+    }
+    g_string_append (summary, "]\n");
+
+    if (g_str_equal (summary_path, "-"))
+        g_print ("%s", summary->str);
+    else if (!g_file_set_contents (summary_path, summary->str, summary->len, &error)) {
+        g_printerr ("error: couldn't write verification summary: %s\n", error->message);
+        g_error_free (error);
+        result = FALSE;
+    }
+
+    g_string_free (summary, TRUE);
     return result;
 }
 
+/******************************************************************************/
+
 gboolean
-qfu_operation_verify_run (const gchar **images)
+qfu_operation_verify_run (const gchar **images,
+                          const gchar  *summary_path)
 {
-    guint invalid_images = 0;
-    guint i;
+    VerifyJob   *jobs;
+    GThreadPool *pool;
+    guint        n_jobs;
+    guint        invalid_images = 0;
+    gboolean     print_reports;
+    guint        i;
+
+    n_jobs = g_strv_length ((gchar **) images);
+    jobs = g_new0 (VerifyJob, n_jobs);
+    for (i = 0; i < n_jobs; i++) {
+        jobs[i].image_path = images[i];
+        jobs[i].report = g_string_new (NULL);
+    }
+
+    pool = g_thread_pool_new ((GFunc) verify_job_run, NULL, MIN (g_get_num_processors (), n_jobs), TRUE, NULL);
+    for (i = 0; i < n_jobs; i++)
+        g_thread_pool_push (pool, &jobs[i], NULL);
+    /* Wait for all jobs to finish */
+    g_thread_pool_free (pool, FALSE, TRUE);
+
+    /* The human-readable reports are not mixed with a summary in stdout */
+    print_reports = (!summary_path || !g_str_equal (summary_path, "-"));
+
+    for (i = 0; i < n_jobs; i++) {
+        if (print_reports)
+            g_print ("%s", jobs[i].report->str);
+        if (jobs[i].error)
+            g_printerr ("error: %s: %s\n", jobs[i].image_path, jobs[i].error);
+        invalid_images += !jobs[i].valid;
+    }
+
+    if (summary_path && !write_summary (summary_path, jobs, n_jobs))
+        invalid_images++;
 
-    for (i = 0; images[i] ; i++)
-        invalid_images += !operation_verify_run_single (images[i]);
+    for (i = 0; i < n_jobs; i++)
+        verify_job_clear (&jobs[i]);
+    g_free (jobs);
 
     return !invalid_images;
 }
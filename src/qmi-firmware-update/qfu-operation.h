@@ -32,7 +32,7 @@ G_BEGIN_DECLS
 
 #if defined WITH_UDEV
 gboolean qfu_operation_update_run     (const gchar        **images,
-                                       QfuDeviceSelection  *device_selection,
+                                       GList               *device_selections,
                                        const gchar         *firmware_version,
                                        const gchar         *config_version,
                                        const gchar         *carrier,
@@ -40,12 +40,19 @@ gboolean qfu_operation_update_run     (const gchar        **images,
                                        gboolean             ignore_version_errors,
                                        gboolean             override_download,
                                        guint8               modem_storage_index,
-                                       gboolean             skip_validation);
+                                       gboolean             skip_validation,
+                                       guint8               qdl_window_size,
+                                       gsize                qdl_chunk_size,
+                                       gboolean             qdl_usb);
 #endif
 
 gboolean qfu_operation_update_qdl_run (const gchar        **images,
-                                       QfuDeviceSelection  *device_selection);
-gboolean qfu_operation_verify_run     (const gchar        **images);
+                                       GList               *device_selections,
+                                       guint8               qdl_window_size,
+                                       gsize                qdl_chunk_size,
+                                       gboolean             qdl_usb);
+gboolean qfu_operation_verify_run     (const gchar        **images,
+                                       const gchar         *summary_path);
 gboolean qfu_operation_reset_run      (QfuDeviceSelection  *device_selection,
                                        QmiDeviceOpenFlags   device_open_flags);
 
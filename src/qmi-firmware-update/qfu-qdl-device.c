@@ -25,6 +25,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <termios.h>
 #include <unistd.h>
 
@@ -35,6 +36,7 @@
 #include "qfu-qdl-message.h"
 #include "qfu-dload-message.h"
 #include "qfu-qdl-device.h"
+#include "qfu-qdl-usb.h"
 #include "qfu-utils.h"
 #include "qfu-enum-types.h"
 
@@ -46,179 +48,95 @@ G_DEFINE_TYPE_EXTENDED (QfuQdlDevice, qfu_qdl_device, G_TYPE_OBJECT, 0,
 enum {
     PROP_0,
     PROP_FILE,
+    PROP_USB_INTERFACE,
     PROP_LAST
 };
 
 static GParamSpec *properties[PROP_LAST];
 
+#define PRIMARY_BUFFER_DEFAULT_SIZE   4096
 #define SECONDARY_BUFFER_DEFAULT_SIZE 512
 #define MAX_PRINTABLE_SIZE            80
 
 struct _QfuQdlDevicePrivate {
     GFile      *file;
+    /* Either a serial port, or the QDL interface of a USB device */
     gint        fd;
+    gint        usb_interface;
+    QfuQdlUsb  *usb;
     guint       qdl_version;
+    /* Maximum chunk size advertised in the hello response, if any, and the
+     * one used in the current session */
+    guint32     max_chunk_size;
+    gsize       chunk_size;
     GByteArray *buffer;
     GByteArray *secondary_buffer;
+    /* Bytes received after the last processed frame, e.g. other acks */
+    GByteArray *pending;
+    guint       n_acks_pending;
+
+    /* Async operations */
+    GAsyncQueue *operations;
+    GThread     *thread;
 };
 
 /******************************************************************************/
-/* HDLC */
-
-#define CONTROL 0x7e
-#define ESCAPE  0x7d
-#define MASK    0x20
-
-static gsize
-escape (const guint8 *in,
-        gsize         inlen,
-        guint8       *out,
-        gsize         outlen)
-{
-    gsize i, j;
-
-    for (i = 0, j = 0; i < inlen; i++) {
-        /* Caller should give a big enough buffer */
-        g_assert ((j + 1) < outlen);
-        if (in[i] == CONTROL || in[i] == ESCAPE) {
-            out[j++] = ESCAPE;
-            out[j++] = in[i] ^ MASK;
-        } else
-            out[j++] = in[i];
-    }
-    return j;
-}
-
-static gsize
-unescape (const guint8 *in,
-          gsize         inlen,
-          guint8       *out,
-          gsize         outlen)
-{
-    gsize    i, j = 0;
-    gboolean escaping = FALSE;
-
-    for (i = 0; i < inlen; i++) {
-        /* Caller should give a big enough buffer */
-        g_assert (j < outlen);
-        if (escaping) {
-            out[j++] = in[i] ^ MASK;
-            escaping = FALSE;
-        } else if (in[i] == ESCAPE) {
-            escaping = TRUE;
-        } else {
-            out[j++] = in[i];
-        }
-    }
-
-    return j;
-}
-
-/* copy a possibly escaped single byte to out */
-static gsize
-escape_byte (guint8  byte,
-             guint8 *out,
-             gsize   outlen)
-{
-    gsize j = 0;
-
-    if (byte == CONTROL || byte == ESCAPE) {
-        out[j++] = ESCAPE;
-        byte ^= MASK;
-    }
-    out[j++] = byte;
-    return j;
-}
-
-static gsize
-hdlc_max_framed_size (gsize unframed_size)
-{
-    /* 1 header byte, (2 * input size) bytes, 2 crc bytes and 1 trailing byte */
-    return 4 + (2 * unframed_size);
-}
-
-static gsize
-hdlc_frame (const guint8 *in,
-            gsize         inlen,
-            guint8       *out,
-            gsize         outlen)
-{
-    guint16 crc;
-    gsize j = 0;
+/* Device file, either a serial port or usbfs */
 
-    out[j++] = CONTROL;
-    j += escape (in, inlen, &out[j], outlen - j);
-    crc = qfu_utils_crc16 (in, inlen);
-    j += escape_byte (crc & 0xff, &out[j], outlen - j);
-    j += escape_byte (crc >> 8 & 0xff, &out[j], outlen - j);
-    out[j++] = CONTROL;
-
-    return j;
-}
-
-static gsize
-hdlc_max_unframed_size (gsize framed_size)
+static gboolean
+device_is_open (QfuQdlDevice *self)
 {
-    /* -1 header byte, -2 crc bytes and -1 trailing byte */
-    g_assert (framed_size > 3);
-    return framed_size - 3;
+    return (self->priv->usb || !(self->priv->fd < 0));
 }
 
-static gsize
-hdlc_unframe (const guint8 *in,
-              gsize         inlen,
-              guint8       *out,
-              gsize         outlen,
-              GError      **error)
+static void
+device_close (QfuQdlDevice *self)
 {
-    guint16 crc;
-    gsize j, i = inlen;
-
-    /* the first control char is optional */
-    if (*in == CONTROL) {
-        in++;
-        i--;
+    if (self->priv->usb) {
+        qfu_qdl_usb_close (self->priv->usb);
+        self->priv->usb = NULL;
     }
-    if (in[i - 1] == CONTROL)
-        i--;
-
-    j = unescape (in, i, out, outlen);
-    if (j < 2) {
-        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-                     "unescaping failed: too few bytes as output: %" G_GSIZE_FORMAT, j);
-        return 0;
+    if (!(self->priv->fd < 0)) {
+        close (self->priv->fd);
+        self->priv->fd = -1;
     }
-    j -= 2; /* remove the crc */
+}
 
-    /* verify the crc */
-    crc = qfu_utils_crc16 (out, j);
-    if (crc != (out[j] | out[j + 1] << 8)) {
-        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-                     "crc check failed: 0x%04x != 0x%04x\n", crc, out[j] | out[j + 1] << 8);
-        return 0;
-    }
+/******************************************************************************/
+/* HDLC */
 
-    return j;
-}
+#define CONTROL 0x7e
 
 /******************************************************************************/
 /* Send */
 
+/* The request may be given in several pieces, written all at once */
 static gboolean
-send_request (QfuQdlDevice  *self,
-              const guint8  *request,
-              gsize          request_size,
-              GCancellable  *cancellable,
-              GError       **error)
+send_request_iov (QfuQdlDevice        *self,
+                  const struct iovec  *iov,
+                  gint                 iovcnt,
+                  GCancellable        *cancellable,
+                  GError             **error)
 {
     gssize         wlen;
+    gsize          request_size = 0;
     fd_set         wr;
     gint           aux;
+    gint           i;
     struct timeval tv = {
         .tv_sec = 2,
         .tv_usec = 0,
     };
 
+    for (i = 0; i < iovcnt; i++)
+        request_size += iov[i].iov_len;
+
+    /* Debug output, only of the first piece */
+    qfu_log_debug_hex ("[qfu-qdl-device] >>", iov[0].iov_base, MIN (iov[0].iov_len, MAX_PRINTABLE_SIZE), request_size, NULL);
+
+    if (self->priv->usb)
+        return qfu_qdl_usb_write (self->priv->usb, iov, iovcnt, tv.tv_sec, cancellable, error);
+
     /* Wait for the fd to be writable and don't wait forever */
     FD_ZERO (&wr);
     FD_SET (self->priv->fd, &wr);
@@ -240,23 +158,7 @@ send_request (QfuQdlDevice  *self,
         return FALSE;
     }
 
-    /* Debug output */
-    if (qfu_log_get_verbose ()) {
-        gchar    *printable;
-        gsize     printable_size = request_size;
-        gboolean  shorted = FALSE;
-
-        if (printable_size > MAX_PRINTABLE_SIZE) {
-            printable_size = MAX_PRINTABLE_SIZE;
-            shorted = TRUE;
-        }
-
-        printable = qfu_utils_str_hex (request, printable_size, ':');
-        g_debug ("[qfu-qdl-device] >> %s%s [%" G_GSIZE_FORMAT "]", printable, shorted ? "..." : "", request_size);
-        g_free (printable);
-    }
-
-    wlen = write (self->priv->fd, request, request_size);
+    wlen = writev (self->priv->fd, iov, iovcnt);
     if (wlen < 0) {
         g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
                      "error writting: %s",
@@ -269,13 +171,28 @@ send_request (QfuQdlDevice  *self,
     if (wlen != request_size) {
         g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
                      "error writing: only %" G_GSSIZE_FORMAT "/%" G_GSIZE_FORMAT " bytes written",
-                     wlen, wlen);
+                     wlen, request_size);
         return FALSE;
     }
 
     return TRUE;
 }
 
+static gboolean
+send_request (QfuQdlDevice  *self,
+              const guint8  *request,
+              gsize          request_size,
+              GCancellable  *cancellable,
+              GError       **error)
+{
+    struct iovec iov = {
+        .iov_base = (gpointer) request,
+        .iov_len  = request_size,
+    };
+
+    return send_request_iov (self, &iov, 1, cancellable, error);
+}
+
 static gboolean
 send_framed_request (QfuQdlDevice  *self,
                      const guint8  *request,
@@ -287,27 +204,14 @@ send_framed_request (QfuQdlDevice  *self,
     gsize framed_size;
 
     /* Debug output */
-    if (qfu_log_get_verbose ()) {
-        gchar    *printable;
-        gsize     printable_size = request_size;
-        gboolean  shorted = FALSE;
-
-        if (printable_size > MAX_PRINTABLE_SIZE) {
-            printable_size = MAX_PRINTABLE_SIZE;
-            shorted = TRUE;
-        }
-
-        printable = qfu_utils_str_hex (request, printable_size, ':');
-        g_debug ("[qfu-qdl-device] >> %s%s [%" G_GSIZE_FORMAT ", unframed]", printable, shorted ? "..." : "", request_size);
-        g_free (printable);
-    }
+    qfu_log_debug_hex ("[qfu-qdl-device] >>", request, MIN (request_size, MAX_PRINTABLE_SIZE), request_size, "unframed");
 
-    max_framed_size = hdlc_max_framed_size (request_size);
+    max_framed_size = qfu_utils_hdlc_max_framed_size (request_size);
     if (G_UNLIKELY (max_framed_size > self->priv->secondary_buffer->len))
         g_byte_array_set_size (self->priv->secondary_buffer, max_framed_size);
 
     /* Pack into an HDLC frame */
-    framed_size = hdlc_frame (request, request_size, self->priv->secondary_buffer->data, self->priv->secondary_buffer->len);
+    framed_size = qfu_utils_hdlc_frame (request, request_size, self->priv->secondary_buffer->data, self->priv->secondary_buffer->len);
     g_assert (framed_size > 0);
 
     return send_request (self, self->priv->secondary_buffer->data, framed_size, cancellable, error);
@@ -316,21 +220,17 @@ send_framed_request (QfuQdlDevice  *self,
 /******************************************************************************/
 /* Receive */
 
+/* Receive in the primary buffer */
 static gssize
-receive_response (QfuQdlDevice  *self,
-                  guint          timeout_secs,
-                  guint8       **response,
-                  GCancellable  *cancellable,
-                  GError       **error)
+read_tty (QfuQdlDevice  *self,
+          guint          timeout_secs,
+          GCancellable  *cancellable,
+          GError       **error)
 {
 	fd_set         rd;
 	struct timeval tv;
     gint           aux;
     gssize         rlen;
-    guint8        *end;
-    gsize          frame_size;
-    gsize          max_unframed_size;
-    gsize          unframed_size;
 
     /* Use requested timeout */
     tv.tv_sec  = timeout_secs;
@@ -356,7 +256,6 @@ receive_response (QfuQdlDevice  *self,
         return -1;
     }
 
-    /* Receive in the primary buffer */
 	rlen = read (self->priv->fd, self->priv->buffer->data, self->priv->buffer->len);
 	if (rlen < 0) {
         g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
@@ -371,66 +270,98 @@ receive_response (QfuQdlDevice  *self,
         return -1;
     }
 
+    return rlen;
+}
+
+static gboolean
+receive_bytes (QfuQdlDevice  *self,
+               guint          timeout_secs,
+               GCancellable  *cancellable,
+               GError       **error)
+{
+    gssize rlen;
+
+    if (self->priv->usb)
+        rlen = qfu_qdl_usb_read (self->priv->usb, self->priv->buffer->data, self->priv->buffer->len, timeout_secs, cancellable, error);
+    else
+        rlen = read_tty (self, timeout_secs, cancellable, error);
+    if (rlen < 0)
+        return FALSE;
+
     /* Debug output */
-    if (qfu_log_get_verbose ()) {
-        gchar    *printable;
-        gsize     printable_size = rlen;
-        gboolean  shorted = FALSE;
-
-        if (printable_size > MAX_PRINTABLE_SIZE) {
-            printable_size = MAX_PRINTABLE_SIZE;
-            shorted = TRUE;
-        }
+    qfu_log_debug_hex ("[qfu-qdl-device] <<", self->priv->buffer->data, MIN ((gsize) rlen, MAX_PRINTABLE_SIZE), rlen, NULL);
+
+    g_byte_array_append (self->priv->pending, self->priv->buffer->data, rlen);
+    return TRUE;
+}
+
+static const guint8 *
+find_frame_end (QfuQdlDevice *self)
+{
+    if (self->priv->pending->len < 2)
+        return NULL;
+    return memchr (self->priv->pending->data + 1, CONTROL, self->priv->pending->len - 1);
+}
 
-        printable = qfu_utils_str_hex (self->priv->buffer->data, printable_size, ':');
-        g_debug ("[qfu-qdl-device] << %s%s [%" G_GSIZE_FORMAT "]", printable, shorted ? "..." : "", rlen);
-        g_free (printable);
+/* If keep_trailing is set, bytes received after the frame are kept for the
+ * next response, as when several acks are expected */
+static gssize
+receive_response (QfuQdlDevice  *self,
+                  guint          timeout_secs,
+                  gboolean       keep_trailing,
+                  guint8       **response,
+                  GCancellable  *cancellable,
+                  GError       **error)
+{
+    const guint8 *end;
+    gsize         frame_size;
+    gsize         max_unframed_size;
+    gsize         unframed_size;
+
+    /* A full frame may already be available since a previous read */
+    end = find_frame_end (self);
+    if (!end) {
+        if (!receive_bytes (self, timeout_secs, cancellable, error))
+            return -1;
+        end = find_frame_end (self);
     }
 
-    end = memchr (self->priv->buffer->data + 1, CONTROL, rlen - 1);
     if (!end) {
         g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
                      "HDLC trailing control character not found");
+        g_byte_array_set_size (self->priv->pending, 0);
         return -1;
     }
 
-    frame_size = end - self->priv->buffer->data + 1;
-    g_assert (frame_size <= rlen);
+    frame_size = end - self->priv->pending->data + 1;
+    g_assert (frame_size <= self->priv->pending->len);
     if (frame_size < 5) {
         g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
                      "minimum HDLC frame size not received");
+        g_byte_array_set_size (self->priv->pending, 0);
         return -1;
     }
 
-    if (frame_size < rlen)
-        g_debug ("[qfu-qdl-device] received %" G_GSIZE_FORMAT " trailing bytes after HDLC frame (ignored)",
-                 rlen - frame_size);
-
-    max_unframed_size = hdlc_max_unframed_size (frame_size);
+    max_unframed_size = qfu_utils_hdlc_max_unframed_size (frame_size);
     if (G_UNLIKELY (max_unframed_size > self->priv->secondary_buffer->len))
         g_byte_array_set_size (self->priv->secondary_buffer, max_unframed_size);
 
-    unframed_size = hdlc_unframe (self->priv->buffer->data, frame_size, self->priv->secondary_buffer->data, self->priv->secondary_buffer->len, error);
+    unframed_size = qfu_utils_hdlc_unframe (self->priv->pending->data, frame_size, self->priv->secondary_buffer->data, self->priv->secondary_buffer->len, error);
+    g_byte_array_remove_range (self->priv->pending, 0, frame_size);
+
+    if (self->priv->pending->len > 0 && !keep_trailing) {
+        g_debug ("[qfu-qdl-device] received %u trailing bytes after HDLC frame (ignored)",
+                 self->priv->pending->len);
+        g_byte_array_set_size (self->priv->pending, 0);
+    }
+
     if (unframed_size == 0) {
         g_prefix_error (error, "error unframing message: ");
         return -1;
     }
 
     /* Debug output */
-    if (qfu_log_get_verbose ()) {
-        gchar    *printable;
-        gsize     printable_size = unframed_size;
-        gboolean  shorted = FALSE;
-
-        if (printable_size > MAX_PRINTABLE_SIZE) {
-            printable_size = MAX_PRINTABLE_SIZE;
-            shorted = TRUE;
-        }
-
-        printable = qfu_utils_str_hex (self->priv->secondary_buffer->data, printable_size, ':');
-        g_debug ("[qfu-qdl-device] << %s%s [%" G_GSIZE_FORMAT ", unframed]", printable, shorted ? "..." : "", unframed_size);
-        g_free (printable);
-    }
+    qfu_log_debug_hex ("[qfu-qdl-device] <<", self->priv->secondary_buffer->data, MIN (unframed_size, MAX_PRINTABLE_SIZE), unframed_size, "unframed");
 
     if (response)
         *response = self->priv->secondary_buffer->data;
@@ -453,9 +384,9 @@ send_receive (QfuQdlDevice  *self,
 {
     gboolean sent;
 
-    if (self->priv->fd < 0) {
+    if (!device_is_open (self)) {
         g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "device is closed");
-        return FALSE;
+        return -1;
     }
 
     if (request_framed)
@@ -468,16 +399,40 @@ send_receive (QfuQdlDevice  *self,
     if (!response)
         return 0;
 
-    return receive_response (self, response_timeout_secs, response, cancellable, error);
+    return receive_response (self, response_timeout_secs, FALSE, response, cancellable, error);
 }
 
 /******************************************************************************/
 
 /******************************************************************************/
 
+gsize
+qfu_qdl_device_get_chunk_size (QfuQdlDevice *self)
+{
+    return self->priv->chunk_size;
+}
+
+/* Unless explicitly requested, the default chunk size is used, or a
+ * smaller one if that is the maximum the device advertised */
+static gsize
+negotiate_chunk_size (QfuQdlDevice *self,
+                      gsize         chunk_size)
+{
+    if (chunk_size)
+        return chunk_size;
+
+    if (self->priv->max_chunk_size > 0 && self->priv->max_chunk_size < QFU_IMAGE_CHUNK_SIZE)
+        return MAX (self->priv->max_chunk_size, QFU_IMAGE_MIN_CHUNK_SIZE);
+
+    return QFU_IMAGE_CHUNK_SIZE;
+}
+
 gboolean
 qfu_qdl_device_ufopen (QfuQdlDevice  *self,
                        QfuImage      *image,
+                       guint8         window_size,
+                       gsize          chunk_size,
+                       guint8        *device_window_size,
                        GCancellable  *cancellable,
                        GError       **error)
 {
@@ -485,7 +440,24 @@ qfu_qdl_device_ufopen (QfuQdlDevice  *self,
     gssize  rsplen;
     guint8 *rsp = NULL;
 
-    reqlen = qfu_qdl_request_ufopen_build (self->priv->buffer->data, self->priv->buffer->len, image, cancellable, error);
+    /* New session, no acks expected from any previous one */
+    self->priv->n_acks_pending = 0;
+    g_byte_array_set_size (self->priv->pending, 0);
+
+    chunk_size = negotiate_chunk_size (self, chunk_size);
+    if (!qfu_image_check_chunk_size (image, chunk_size, error))
+        return FALSE;
+    self->priv->chunk_size = chunk_size;
+    g_debug ("[qfu-qdl-device] chunk size: %" G_GSIZE_FORMAT " bytes (device maximum: %" G_GUINT32_FORMAT " bytes)",
+             chunk_size, self->priv->max_chunk_size);
+
+    /* Room for the image header in the open request, and for full chunks
+     * afterwards */
+    g_byte_array_set_size (self->priv->buffer,
+                           MAX (QFU_QDL_MESSAGE_MAX_SIZE (chunk_size),
+                                QFU_QDL_MESSAGE_MAX_HEADER_SIZE + qfu_image_get_header_size (image)));
+
+    reqlen = qfu_qdl_request_ufopen_build (self->priv->buffer->data, self->priv->buffer->len, image, window_size, cancellable, error);
     if (reqlen < 0)
         return FALSE;
 
@@ -495,7 +467,7 @@ qfu_qdl_device_ufopen (QfuQdlDevice  *self,
 
     switch (rsp[0]) {
     case QFU_QDL_CMD_OPEN_UNFRAMED_RSP:
-        return qfu_qdl_response_ufopen_parse (rsp, rsplen, error);
+        return qfu_qdl_response_ufopen_parse (rsp, rsplen, device_window_size, error);
     case QFU_QDL_CMD_ERROR:
         return qfu_qdl_response_error_parse (rsp, rsplen, error);
     default:
@@ -509,38 +481,75 @@ qfu_qdl_device_ufopen (QfuQdlDevice  *self,
 /******************************************************************************/
 
 gboolean
-qfu_qdl_device_ufwrite (QfuQdlDevice  *self,
-                        QfuImage      *image,
-                        guint16        sequence,
-                        GCancellable  *cancellable,
-                        GError       **error)
+qfu_qdl_device_ufwrite_send (QfuQdlDevice  *self,
+                             QfuImage      *image,
+                             guint16        sequence,
+                             GCancellable  *cancellable,
+                             GError       **error)
 {
-    gssize   reqlen;
-    gssize   rsplen;
-    guint8  *rsp = NULL;
-    guint16  ack_sequence = 0;
+    const guint8 *chunk;
+    gsize         chunk_size = 0;
+    GError       *inner_error = NULL;
 
-    reqlen = qfu_qdl_request_ufwrite_build (self->priv->buffer->data, self->priv->buffer->len, image, sequence, cancellable, error);
-    if (reqlen < 0)
+    if (!device_is_open (self)) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "device is closed");
         return FALSE;
+    }
+
+    /* Send the chunk straight from the mapped image if possible, with only
+     * the header built in the buffer */
+    chunk = qfu_image_peek_data_chunk (image, self->priv->chunk_size, sequence, &chunk_size, &inner_error);
+    if (chunk) {
+        struct iovec iov[2];
+
+        iov[0].iov_base = self->priv->buffer->data;
+        iov[0].iov_len  = qfu_qdl_request_ufwrite_header_build (self->priv->buffer->data, self->priv->buffer->len, sequence, chunk_size);
+        iov[1].iov_base = (gpointer) chunk;
+        iov[1].iov_len  = chunk_size;
+        if (!send_request_iov (self, iov, G_N_ELEMENTS (iov), cancellable, error))
+            return FALSE;
+    } else {
+        gssize reqlen;
+
+        if (!g_error_matches (inner_error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED)) {
+            g_propagate_error (error, inner_error);
+            return FALSE;
+        }
+        g_clear_error (&inner_error);
+
+        reqlen = qfu_qdl_request_ufwrite_build (self->priv->buffer->data, self->priv->buffer->len, image, self->priv->chunk_size, sequence, cancellable, error);
+        if (reqlen < 0)
+            return FALSE;
+
+        if (!send_request (self, self->priv->buffer->data, reqlen, cancellable, error))
+            return FALSE;
+    }
+
+    self->priv->n_acks_pending++;
+    return TRUE;
+}
+
+gboolean
+qfu_qdl_device_ufwrite_receive_ack (QfuQdlDevice  *self,
+                                    guint16       *ack_sequence,
+                                    GCancellable  *cancellable,
+                                    GError       **error)
+{
+    gssize  rsplen;
+    guint8 *rsp = NULL;
+
+    g_assert (self->priv->n_acks_pending > 0);
 
     /* NOTE: the last chunk will require a long timeout, so just define the
      * same one for all chunks */
-    rsplen = send_receive (self, self->priv->buffer->data, reqlen, FALSE, 120, &rsp, cancellable, error);
+    rsplen = receive_response (self, 120, self->priv->n_acks_pending > 1, &rsp, cancellable, error);
+    self->priv->n_acks_pending--;
     if (rsplen < 0)
         return FALSE;
 
     switch (rsp[0]) {
     case QFU_QDL_CMD_WRITE_UNFRAMED_RSP:
-        if (!qfu_qdl_response_ufwrite_parse (rsp, rsplen, &ack_sequence, error))
-            return FALSE;
-        if (ack_sequence != sequence) {
-            g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-                         "received ack for chunk #%" G_GUINT16_FORMAT " instead of chunk #%" G_GUINT16_FORMAT,
-                         ack_sequence, sequence);
-            return FALSE;
-        }
-        return TRUE;
+        return qfu_qdl_response_ufwrite_parse (rsp, rsplen, ack_sequence, error);
     case QFU_QDL_CMD_ERROR:
         return qfu_qdl_response_error_parse (rsp, rsplen, error);
     default:
@@ -601,7 +610,7 @@ qfu_qdl_device_hello (QfuQdlDevice  *self,
 
     switch (rsp[0]) {
     case QFU_QDL_CMD_HELLO_RSP:
-        return qfu_qdl_response_hello_parse (rsp, rsplen, error);
+        return qfu_qdl_response_hello_parse (rsp, rsplen, &self->priv->max_chunk_size, error);
     case QFU_QDL_CMD_ERROR:
         return qfu_qdl_response_error_parse (rsp, rsplen, error);
     default:
@@ -622,15 +631,14 @@ qfu_qdl_device_reset (QfuQdlDevice  *self,
     gsize  reqlen;
     gssize rsplen;
 
-    if (self->priv->fd < 0)
+    if (!device_is_open (self))
         return TRUE;
 
     reqlen = qfu_qdl_request_reset_build (self->priv->buffer->data, self->priv->buffer->len);
     rsplen = send_receive (self, self->priv->buffer->data, reqlen, TRUE, 0, NULL, cancellable, error);
 
     /* Close device after a reset, even if we got an error */
-    close (self->priv->fd);
-    self->priv->fd = -1;
+    device_close (self);
 
     if (rsplen < 0)
         return FALSE;
@@ -638,6 +646,402 @@ qfu_qdl_device_reset (QfuQdlDevice  *self,
     return TRUE;
 }
 
+/******************************************************************************/
+/* Async operations
+ *
+ * The serial port is operated with blocking calls, so the operations are run
+ * one after the other in a thread owned by the device, and their results are
+ * given back in the main context of the caller. */
+
+typedef struct {
+    GTask           *task;
+    GTaskThreadFunc  func;
+} Operation;
+
+static gpointer
+operation_thread (GAsyncQueue *operations)
+{
+    for (;;) {
+        Operation *op;
+
+        op = g_async_queue_pop (operations);
+
+        /* An operation without task asks to stop */
+        if (!op->task) {
+            g_slice_free (Operation, op);
+            break;
+        }
+
+        op->func (op->task,
+                  g_task_get_source_object (op->task),
+                  g_task_get_task_data (op->task),
+                  g_task_get_cancellable (op->task));
+        g_object_unref (op->task);
+        g_slice_free (Operation, op);
+    }
+
+    g_async_queue_unref (operations);
+    return NULL;
+}
+
+/* Takes ownership of the task */
+static void
+operation_queue (QfuQdlDevice    *self,
+                 GTask           *task,
+                 GTaskThreadFunc  func)
+{
+    Operation *op;
+
+    if (!self->priv->thread)
+        self->priv->thread = g_thread_new ("qfu-qdl-device",
+                                           (GThreadFunc) operation_thread,
+                                           g_async_queue_ref (self->priv->operations));
+
+    op = g_slice_new (Operation);
+    op->task = task;
+    op->func = func;
+    g_async_queue_push (self->priv->operations, op);
+}
+
+static void
+operation_thread_stop (QfuQdlDevice *self)
+{
+    if (!self->priv->thread)
+        return;
+
+    g_async_queue_push (self->priv->operations, g_slice_new0 (Operation));
+
+    /* The last reference may be dropped in the thread itself */
+    if (self->priv->thread == g_thread_self ())
+        g_thread_unref (self->priv->thread);
+    else
+        g_thread_join (self->priv->thread);
+    self->priv->thread = NULL;
+}
+
+/******************************************************************************/
+
+gboolean
+qfu_qdl_device_hello_finish (QfuQdlDevice  *self,
+                             GAsyncResult  *res,
+                             GError       **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void
+hello_thread (GTask        *task,
+              QfuQdlDevice *self,
+              gpointer      task_data,
+              GCancellable *cancellable)
+{
+    GError *error = NULL;
+
+    if (!qfu_qdl_device_hello (self, cancellable, &error))
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
+}
+
+void
+qfu_qdl_device_hello_async (QfuQdlDevice        *self,
+                            GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data)
+{
+    operation_queue (self, g_task_new (self, cancellable, callback, user_data), (GTaskThreadFunc) hello_thread);
+}
+
+/******************************************************************************/
+
+typedef struct {
+    QfuImage *image;
+    guint8    window_size;
+    gsize     chunk_size;
+    guint8    device_window_size;
+} UfopenContext;
+
+static void
+ufopen_context_free (UfopenContext *ctx)
+{
+    g_object_unref (ctx->image);
+    g_slice_free (UfopenContext, ctx);
+}
+
+gboolean
+qfu_qdl_device_ufopen_finish (QfuQdlDevice  *self,
+                              GAsyncResult  *res,
+                              guint8        *device_window_size,
+                              GError       **error)
+{
+    UfopenContext *ctx;
+
+    if (!g_task_propagate_boolean (G_TASK (res), error))
+        return FALSE;
+
+    ctx = g_task_get_task_data (G_TASK (res));
+    if (device_window_size)
+        *device_window_size = ctx->device_window_size;
+    return TRUE;
+}
+
+static void
+ufopen_thread (GTask         *task,
+               QfuQdlDevice  *self,
+               UfopenContext *ctx,
+               GCancellable  *cancellable)
+{
+    GError *error = NULL;
+
+    if (!qfu_qdl_device_ufopen (self, ctx->image, ctx->window_size, ctx->chunk_size, &ctx->device_window_size, cancellable, &error))
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
+}
+
+void
+qfu_qdl_device_ufopen_async (QfuQdlDevice        *self,
+                             QfuImage            *image,
+                             guint8               window_size,
+                             gsize                chunk_size,
+                             GCancellable        *cancellable,
+                             GAsyncReadyCallback  callback,
+                             gpointer             user_data)
+{
+    GTask         *task;
+    UfopenContext *ctx;
+
+    ctx = g_slice_new0 (UfopenContext);
+    ctx->image = g_object_ref (image);
+    ctx->window_size = window_size;
+    ctx->chunk_size = chunk_size;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_task_data (task, ctx, (GDestroyNotify) ufopen_context_free);
+    operation_queue (self, task, (GTaskThreadFunc) ufopen_thread);
+}
+
+/******************************************************************************/
+
+typedef struct {
+    QfuImage                        *image;
+    guint8                           window_size;
+    guint16                          n_chunks;
+    guint16                          n_acked_in_order;
+    QfuQdlDeviceUfwriteProgressFunc  progress_callback;
+    gpointer                         progress_user_data;
+    /* Shared with the main context for progress reporting */
+    volatile gint                    n_sent;
+    volatile gint                    n_acked;
+    volatile gint                    progress_pending;
+    volatile gint                    done;
+} UfwriteContext;
+
+static void
+ufwrite_context_free (UfwriteContext *ctx)
+{
+    g_object_unref (ctx->image);
+    g_slice_free (UfwriteContext, ctx);
+}
+
+gboolean
+qfu_qdl_device_ufwrite_finish (QfuQdlDevice  *self,
+                               GAsyncResult  *res,
+                               guint16       *n_acked_in_order,
+                               GError       **error)
+{
+    UfwriteContext *ctx;
+
+    /* Given even on error, e.g. to report where the download stopped */
+    ctx = g_task_get_task_data (G_TASK (res));
+    if (n_acked_in_order)
+        *n_acked_in_order = ctx->n_acked_in_order;
+
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static gboolean
+ufwrite_progress_idle (GTask *task)
+{
+    UfwriteContext *ctx;
+
+    ctx = g_task_get_task_data (task);
+    g_atomic_int_set (&ctx->progress_pending, FALSE);
+
+    /* Nothing else to report once the result is being given */
+    if (!g_atomic_int_get (&ctx->done))
+        ctx->progress_callback (g_task_get_source_object (task),
+                                (guint16) g_atomic_int_get (&ctx->n_sent),
+                                (guint16) g_atomic_int_get (&ctx->n_acked),
+                                ctx->n_chunks,
+                                ctx->progress_user_data);
+    return G_SOURCE_REMOVE;
+}
+
+/* At most one progress update is scheduled at a time, and it reports the
+ * latest values when run */
+static void
+ufwrite_report_progress (GTask          *task,
+                         UfwriteContext *ctx)
+{
+    GSource *source;
+
+    if (!ctx->progress_callback || !g_atomic_int_compare_and_exchange (&ctx->progress_pending, FALSE, TRUE))
+        return;
+
+    source = g_idle_source_new ();
+    g_source_set_callback (source, (GSourceFunc) ufwrite_progress_idle, g_object_ref (task), g_object_unref);
+    g_source_attach (source, g_task_get_context (task));
+    g_source_unref (source);
+}
+
+static void
+ufwrite_thread (GTask          *task,
+                QfuQdlDevice   *self,
+                UfwriteContext *ctx,
+                GCancellable   *cancellable)
+{
+    guint16   sequence = 0;
+    guint16   n_acked = 0;
+    gboolean *acked;
+    GError   *error = NULL;
+
+    /* Acks are matched by sequence number, so they may come in any order */
+    acked = g_new0 (gboolean, ctx->n_chunks);
+    while (n_acked < ctx->n_chunks) {
+        guint16 ack_sequence = 0;
+
+        /* Fill the window */
+        while (sequence < ctx->n_chunks && (sequence - n_acked) < ctx->window_size) {
+            if (!qfu_qdl_device_ufwrite_send (self, ctx->image, sequence, cancellable, &error))
+                goto out;
+            sequence++;
+            g_atomic_int_set (&ctx->n_sent, sequence);
+            ufwrite_report_progress (task, ctx);
+        }
+
+        if (!qfu_qdl_device_ufwrite_receive_ack (self, &ack_sequence, cancellable, &error))
+            goto out;
+
+        if (ack_sequence >= sequence || acked[ack_sequence]) {
+            error = g_error_new (G_IO_ERROR, G_IO_ERROR_FAILED,
+                                 "unexpected ack for chunk #%" G_GUINT16_FORMAT,
+                                 ack_sequence);
+            goto out;
+        }
+        acked[ack_sequence] = TRUE;
+        n_acked++;
+        while (ctx->n_acked_in_order < ctx->n_chunks && acked[ctx->n_acked_in_order])
+            ctx->n_acked_in_order++;
+        g_atomic_int_set (&ctx->n_acked, n_acked);
+        ufwrite_report_progress (task, ctx);
+    }
+
+    g_debug ("[qfu-qdl-device] all chunks ack-ed");
+
+out:
+    g_free (acked);
+
+    g_atomic_int_set (&ctx->done, TRUE);
+    if (error)
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
+}
+
+void
+qfu_qdl_device_ufwrite_async (QfuQdlDevice                    *self,
+                              QfuImage                        *image,
+                              guint8                           window_size,
+                              QfuQdlDeviceUfwriteProgressFunc  progress_callback,
+                              gpointer                         progress_user_data,
+                              GCancellable                    *cancellable,
+                              GAsyncReadyCallback              callback,
+                              gpointer                         user_data)
+{
+    GTask          *task;
+    UfwriteContext *ctx;
+
+    g_return_if_fail (window_size > 0);
+
+    ctx = g_slice_new0 (UfwriteContext);
+    ctx->image = g_object_ref (image);
+    ctx->window_size = window_size;
+    ctx->n_chunks = qfu_image_get_n_data_chunks (image, self->priv->chunk_size);
+    ctx->progress_callback = progress_callback;
+    ctx->progress_user_data = progress_user_data;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_task_data (task, ctx, (GDestroyNotify) ufwrite_context_free);
+    operation_queue (self, task, (GTaskThreadFunc) ufwrite_thread);
+}
+
+/******************************************************************************/
+
+gboolean
+qfu_qdl_device_ufclose_finish (QfuQdlDevice  *self,
+                               GAsyncResult  *res,
+                               GError       **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void
+ufclose_thread (GTask        *task,
+                QfuQdlDevice *self,
+                gpointer      task_data,
+                GCancellable *cancellable)
+{
+    GError *error = NULL;
+
+    if (!qfu_qdl_device_ufclose (self, cancellable, &error))
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
+}
+
+void
+qfu_qdl_device_ufclose_async (QfuQdlDevice        *self,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data)
+{
+    operation_queue (self, g_task_new (self, cancellable, callback, user_data), (GTaskThreadFunc) ufclose_thread);
+}
+
+/******************************************************************************/
+
+gboolean
+qfu_qdl_device_reset_finish (QfuQdlDevice  *self,
+                             GAsyncResult  *res,
+                             GError       **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void
+reset_thread (GTask        *task,
+              QfuQdlDevice *self,
+              gpointer      task_data,
+              GCancellable *cancellable)
+{
+    GError *error = NULL;
+
+    if (!qfu_qdl_device_reset (self, cancellable, &error))
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
+}
+
+void
+qfu_qdl_device_reset_async (QfuQdlDevice        *self,
+                            GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data)
+{
+    operation_queue (self, g_task_new (self, cancellable, callback, user_data), (GTaskThreadFunc) reset_thread);
+}
+
 /******************************************************************************/
 
 static gboolean
@@ -695,7 +1099,7 @@ qdl_device_detect_version (QfuQdlDevice  *self,
 
         /* Break right away on a successful parse, so that we finish with the
          * correct version tested */
-        if (qfu_qdl_response_hello_parse (rsp, rsplen, NULL))
+        if (qfu_qdl_response_hello_parse (rsp, rsplen, &self->priv->max_chunk_size, NULL))
             break;
     }
 
@@ -712,46 +1116,62 @@ qdl_device_detect_version (QfuQdlDevice  *self,
 }
 
 static gboolean
-initable_init (GInitable     *initable,
-               GCancellable  *cancellable,
-               GError       **error)
+open_tty (QfuQdlDevice  *self,
+          GError       **error)
 {
-    QfuQdlDevice   *self;
     struct termios  terminal_data;
-    gchar          *path = NULL;
-    GError         *inner_error = NULL;
-
-    self = QFU_QDL_DEVICE (initable);
-
-    if (g_cancellable_set_error_if_cancelled (cancellable, &inner_error))
-        goto out;
+    gchar          *path;
 
     path = g_file_get_path (self->priv->file);
     g_debug ("[qfu-qdl-device] opening TTY: %s", path);
-
     self->priv->fd = open (path, O_RDWR | O_NOCTTY);
+    g_free (path);
+
     if (self->priv->fd < 0) {
-        inner_error = g_error_new (G_IO_ERROR, G_IO_ERROR_FAILED,
-                                   "error opening serial device: %s",
-                                   g_strerror (errno));
-        goto out;
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "error opening serial device: %s",
+                     g_strerror (errno));
+        return FALSE;
     }
 
     g_debug ("[qfu-qdl-device] setting terminal in raw mode...");
     if (tcgetattr (self->priv->fd, &terminal_data) < 0) {
-        inner_error = g_error_new (G_IO_ERROR, G_IO_ERROR_FAILED,
-                                   "error getting serial port attributes: %s",
-                                   g_strerror (errno));
-        goto out;
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "error getting serial port attributes: %s",
+                     g_strerror (errno));
+        return FALSE;
     }
     cfmakeraw (&terminal_data);
     if (tcsetattr (self->priv->fd, TCSANOW, &terminal_data) < 0) {
-        inner_error = g_error_new (G_IO_ERROR, G_IO_ERROR_FAILED,
-                                   "error setting serial port attributes: %s",
-                                   g_strerror (errno));
-        goto out;
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "error setting serial port attributes: %s",
+                     g_strerror (errno));
+        return FALSE;
     }
 
+    return TRUE;
+}
+
+static gboolean
+initable_init (GInitable     *initable,
+               GCancellable  *cancellable,
+               GError       **error)
+{
+    QfuQdlDevice *self;
+    GError       *inner_error = NULL;
+
+    self = QFU_QDL_DEVICE (initable);
+
+    if (g_cancellable_set_error_if_cancelled (cancellable, &inner_error))
+        goto out;
+
+    if (self->priv->usb_interface >= 0) {
+        self->priv->usb = qfu_qdl_usb_open (self->priv->file, (guint8) self->priv->usb_interface, &inner_error);
+        if (!self->priv->usb)
+            goto out;
+    } else if (!open_tty (self, &inner_error))
+        goto out;
+
     if (!qdl_device_dload_sdp (self, cancellable, &inner_error)) {
         if (!g_error_matches (inner_error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
             goto out;
@@ -764,13 +1184,8 @@ initable_init (GInitable     *initable,
         goto out;
 
 out:
-    g_free (path);
-
     if (inner_error) {
-        if (!(self->priv->fd < 0)) {
-            close (self->priv->fd);
-            self->priv->fd = -1;
-        }
+        device_close (self);
         g_propagate_error (error, inner_error);
         return FALSE;
     }
@@ -794,18 +1209,40 @@ qfu_qdl_device_new (GFile         *file,
                                            NULL));
 }
 
+QfuQdlDevice *
+qfu_qdl_device_new_usb (GFile         *usbfs_file,
+                        guint8         interface_number,
+                        GCancellable  *cancellable,
+                        GError       **error)
+{
+    g_return_val_if_fail (G_IS_FILE (usbfs_file), NULL);
+
+    return QFU_QDL_DEVICE (g_initable_new (QFU_TYPE_QDL_DEVICE,
+                                           cancellable,
+                                           error,
+                                           "file",          usbfs_file,
+                                           "usb-interface", (gint) interface_number,
+                                           NULL));
+}
+
 
 static void
 qfu_qdl_device_init (QfuQdlDevice *self)
 {
     self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, QFU_TYPE_QDL_DEVICE, QfuQdlDevicePrivate);
     self->priv->fd = -1;
-    /* Long buffer for I/O */
+    self->priv->usb_interface = -1;
+    self->priv->chunk_size = QFU_IMAGE_CHUNK_SIZE;
+    /* Buffer for I/O, grown to fit full chunks once the chunk size is known */
     self->priv->buffer = g_byte_array_new ();
-    g_byte_array_set_size (self->priv->buffer, QFU_QDL_MESSAGE_MAX_SIZE);
+    g_byte_array_set_size (self->priv->buffer, PRIMARY_BUFFER_DEFAULT_SIZE);
     /* Shorter secondary buffer for framing/unframing */
     self->priv->secondary_buffer = g_byte_array_new ();
     g_byte_array_set_size (self->priv->secondary_buffer, SECONDARY_BUFFER_DEFAULT_SIZE);
+    /* Received bytes not yet processed */
+    self->priv->pending = g_byte_array_new ();
+    /* Operations for the async thread */
+    self->priv->operations = g_async_queue_new ();
 }
 
 static void
@@ -820,6 +1257,9 @@ set_property (GObject      *object,
     case PROP_FILE:
         self->priv->file = g_value_dup_object (value);
         break;
+    case PROP_USB_INTERFACE:
+        self->priv->usb_interface = g_value_get_int (value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -838,6 +1278,9 @@ get_property (GObject    *object,
     case PROP_FILE:
         g_value_set_object (value, self->priv->file);
         break;
+    case PROP_USB_INTERFACE:
+        g_value_set_int (value, self->priv->usb_interface);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -849,12 +1292,14 @@ dispose (GObject *object)
 {
     QfuQdlDevice *self = QFU_QDL_DEVICE (object);
 
-    if (!(self->priv->fd < 0)) {
-        close (self->priv->fd);
-        self->priv->fd = -1;
-    }
+    /* Pending operations hold a reference, so the thread is idle */
+    operation_thread_stop (self);
+    g_clear_pointer (&self->priv->operations, g_async_queue_unref);
+
+    device_close (self);
     g_clear_pointer (&self->priv->buffer,           g_byte_array_unref);
     g_clear_pointer (&self->priv->secondary_buffer, g_byte_array_unref);
+    g_clear_pointer (&self->priv->pending,          g_byte_array_unref);
     g_clear_object  (&self->priv->file);
 
     G_OBJECT_CLASS (qfu_qdl_device_parent_class)->dispose (object);
@@ -884,4 +1329,12 @@ qfu_qdl_device_class_init (QfuQdlDeviceClass *klass)
                              G_TYPE_FILE,
                              G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
     g_object_class_install_property (object_class, PROP_FILE, properties[PROP_FILE]);
+
+    properties[PROP_USB_INTERFACE] =
+        g_param_spec_int ("usb-interface",
+                          "USB interface",
+                          "Number of the QDL interface, if the file is a usbfs device instead of a serial port",
+                          -1, G_MAXUINT8, -1,
+                          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_USB_INTERFACE, properties[PROP_USB_INTERFACE]);
 }
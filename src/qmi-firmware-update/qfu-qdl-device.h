@@ -52,18 +52,30 @@ GType         qfu_qdl_device_get_type  (void);
 QfuQdlDevice *qfu_qdl_device_new       (GFile         *file,
                                         GCancellable  *cancellable,
                                         GError       **error);
-gboolean      qfu_qdl_device_hello     (QfuQdlDevice  *self,
+QfuQdlDevice *qfu_qdl_device_new_usb   (GFile         *usbfs_file,
+                                        guint8         interface_number,
                                         GCancellable  *cancellable,
                                         GError       **error);
-gboolean      qfu_qdl_device_ufopen    (QfuQdlDevice  *self,
-                                        QfuImage      *image,
+gboolean      qfu_qdl_device_hello     (QfuQdlDevice  *self,
                                         GCancellable  *cancellable,
                                         GError       **error);
-gboolean      qfu_qdl_device_ufwrite   (QfuQdlDevice  *self,
+gsize         qfu_qdl_device_get_chunk_size (QfuQdlDevice *self);
+gboolean      qfu_qdl_device_ufopen    (QfuQdlDevice  *self,
                                         QfuImage      *image,
-                                        guint16        sequence,
+                                        guint8         window_size,
+                                        gsize          chunk_size,
+                                        guint8        *device_window_size,
                                         GCancellable  *cancellable,
                                         GError       **error);
+gboolean      qfu_qdl_device_ufwrite_send        (QfuQdlDevice  *self,
+                                                  QfuImage      *image,
+                                                  guint16        sequence,
+                                                  GCancellable  *cancellable,
+                                                  GError       **error);
+gboolean      qfu_qdl_device_ufwrite_receive_ack (QfuQdlDevice  *self,
+                                                  guint16       *ack_sequence,
+                                                  GCancellable  *cancellable,
+                                                  GError       **error);
 gboolean      qfu_qdl_device_ufclose   (QfuQdlDevice  *self,
                                         GCancellable  *cancellable,
                                         GError       **error);
@@ -71,6 +83,62 @@ gboolean      qfu_qdl_device_reset     (QfuQdlDevice  *self,
                                         GCancellable  *cancellable,
                                         GError       **error);
 
+/* Async operations, run in order in a thread owned by the device */
+void          qfu_qdl_device_hello_async    (QfuQdlDevice         *self,
+                                             GCancellable         *cancellable,
+                                             GAsyncReadyCallback   callback,
+                                             gpointer              user_data);
+gboolean      qfu_qdl_device_hello_finish   (QfuQdlDevice         *self,
+                                             GAsyncResult         *res,
+                                             GError              **error);
+void          qfu_qdl_device_ufopen_async   (QfuQdlDevice         *self,
+                                             QfuImage             *image,
+                                             guint8                window_size,
+                                             gsize                 chunk_size,
+                                             GCancellable         *cancellable,
+                                             GAsyncReadyCallback   callback,
+                                             gpointer              user_data);
+gboolean      qfu_qdl_device_ufopen_finish  (QfuQdlDevice         *self,
+                                             GAsyncResult         *res,
+                                             guint8               *device_window_size,
+                                             GError              **error);
+void          qfu_qdl_device_ufclose_async  (QfuQdlDevice         *self,
+                                             GCancellable         *cancellable,
+                                             GAsyncReadyCallback   callback,
+                                             gpointer              user_data);
+gboolean      qfu_qdl_device_ufclose_finish (QfuQdlDevice         *self,
+                                             GAsyncResult         *res,
+                                             GError              **error);
+void          qfu_qdl_device_reset_async    (QfuQdlDevice         *self,
+                                             GCancellable         *cancellable,
+                                             GAsyncReadyCallback   callback,
+                                             gpointer              user_data);
+gboolean      qfu_qdl_device_reset_finish   (QfuQdlDevice         *self,
+                                             GAsyncResult         *res,
+                                             GError              **error);
+
+/* Writes all chunks of the image in the open session, keeping up to
+ * window_size of them in flight. Progress is reported in the main context
+ * of the caller, skipping updates if it falls behind. */
+typedef void (* QfuQdlDeviceUfwriteProgressFunc) (QfuQdlDevice *self,
+                                                  guint16       n_sent,
+                                                  guint16       n_acked,
+                                                  guint16       n_chunks,
+                                                  gpointer      user_data);
+
+void          qfu_qdl_device_ufwrite_async  (QfuQdlDevice                     *self,
+                                             QfuImage                         *image,
+                                             guint8                            window_size,
+                                             QfuQdlDeviceUfwriteProgressFunc   progress_callback,
+                                             gpointer                          progress_user_data,
+                                             GCancellable                     *cancellable,
+                                             GAsyncReadyCallback               callback,
+                                             gpointer                          user_data);
+gboolean      qfu_qdl_device_ufwrite_finish (QfuQdlDevice                     *self,
+                                             GAsyncResult                     *res,
+                                             guint16                          *n_acked_in_order,
+                                             GError                          **error);
+
 G_END_DECLS
 
 #endif /* QFU_QDL_DEVICE_H */
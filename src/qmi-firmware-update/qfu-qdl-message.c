@@ -115,7 +115,7 @@ struct _QdlHelloRsp {
     gchar   magic[32];
     guint8  maxver;
     guint8  minver;
-    guint32 reserved1;
+    guint32 maxblocksize;
     guint32 reserved2;
     guint8  reserved3;
     guint16 reserved4;
@@ -128,6 +128,7 @@ G_STATIC_ASSERT (sizeof (QdlHelloRsp) <= QFU_QDL_MESSAGE_MAX_HEADER_SIZE);
 gboolean
 qfu_qdl_response_hello_parse (const guint8  *buffer,
                               gsize          buffer_len,
+                              guint32       *max_chunk_size,
                               GError       **error)
 {
     QdlHelloRsp *rsp;
@@ -146,9 +147,12 @@ qfu_qdl_response_hello_parse (const guint8  *buffer,
     g_debug ("[qfu,qdl-message]   magic:           %.*s",   rsp->maxver <= 5 ? 24 : 32, rsp->magic);
     g_debug ("[qfu,qdl-message]   maximum version: %u",     rsp->maxver);
     g_debug ("[qfu,qdl-message]   minimum version: %u",     rsp->minver);
+    g_debug ("[qfu,qdl-message]   max block size:  %" G_GUINT32_FORMAT, GUINT32_FROM_LE (rsp->maxblocksize));
     g_debug ("[qfu,qdl-message]   features:        0x%02x", rsp->features);
 
-    /* For now, ignore fields */
+    /* Maximum size of the data written at once, or 0 if not advertised */
+    if (max_chunk_size)
+        *max_chunk_size = GUINT32_FROM_LE (rsp->maxblocksize);
 
     return TRUE;
 }
@@ -291,6 +295,7 @@ gssize
 qfu_qdl_request_ufopen_build (guint8        *buffer,
                               gsize          buffer_len,
                               QfuImage      *image,
+                              guint8         window_size,
                               GCancellable  *cancellable,
                               GError       **error)
 {
@@ -303,7 +308,7 @@ qfu_qdl_request_ufopen_build (guint8        *buffer,
     memset (req, 0, sizeof (QdlUfopenReq));
 	req->cmd        = QFU_QDL_CMD_OPEN_UNFRAMED_REQ;
 	req->type       = (guint8) qfu_image_get_image_type (image);
-	req->windowsize = 1; /* snooped */
+	req->windowsize = window_size;
 	req->length     = GUINT32_TO_LE (qfu_image_get_header_size (image) + qfu_image_get_data_size (image));
 	req->chunksize  = GUINT32_TO_LE (qfu_image_get_data_size (image));
 
@@ -335,6 +340,7 @@ G_STATIC_ASSERT (sizeof (QdlUfopenRsp) <= QFU_QDL_MESSAGE_MAX_HEADER_SIZE);
 gboolean
 qfu_qdl_response_ufopen_parse (const guint8  *buffer,
                                gsize          buffer_len,
+                               guint8        *window_size,
                                GError       **error)
 {
     QdlUfopenRsp *rsp;
@@ -354,7 +360,7 @@ qfu_qdl_response_ufopen_parse (const guint8  *buffer,
     g_debug ("[qfu,qdl-message]   window size: %u", rsp->windowsize);
     g_debug ("[qfu,qdl-message]   chunk size:  %" G_GUINT32_FORMAT, GUINT32_FROM_LE (rsp->chunksize));
 
-    /* For now, ignore all fields but build a GError based on status */
+    /* Only return window size and return GError based on status */
 
     /* Return error if status != 0 */
     if (rsp->status != 0) {
@@ -364,6 +370,9 @@ qfu_qdl_response_ufopen_parse (const guint8  *buffer,
         return FALSE;
     }
 
+    if (window_size)
+        *window_size = rsp->windowsize;
+
     return TRUE;
 }
 
@@ -382,40 +391,54 @@ struct _QdlUfwriteReq {
 
 G_STATIC_ASSERT (sizeof (QdlUfwriteReq) <= QFU_QDL_MESSAGE_MAX_HEADER_SIZE);
 
+gsize
+qfu_qdl_request_ufwrite_header_build (guint8  *buffer,
+                                      gsize    buffer_len,
+                                      guint16  sequence,
+                                      gsize    chunk_size)
+{
+    QdlUfwriteReq *req;
+
+    g_assert (buffer_len >= sizeof (QdlUfwriteReq));
+
+    /* The crc only covers the header, so the chunk may be sent apart */
+    req = (QdlUfwriteReq *) buffer;
+    memset (req, 0, sizeof (QdlUfwriteReq));
+	req->cmd       = QFU_QDL_CMD_WRITE_UNFRAMED_REQ;
+	req->sequence  = GUINT16_TO_LE (sequence);
+	req->reserved  = 0;
+	req->chunksize = GUINT32_TO_LE ((guint32) chunk_size);
+	req->crc       = GUINT16_TO_LE (qfu_utils_crc16 (buffer, sizeof (QdlUfwriteReq) - 2));
+
+    g_debug ("[qfu,qdl-message] sent %s:", qfu_qdl_cmd_get_string ((QfuQdlCmd) req->cmd));
+    g_debug ("[qfu,qdl-message]   sequence:   %" G_GUINT16_FORMAT, GUINT16_FROM_LE (req->sequence));
+    g_debug ("[qfu,qdl-message]   chunk size: %" G_GUINT32_FORMAT, GUINT32_FROM_LE (req->chunksize));
+
+	return sizeof (QdlUfwriteReq);
+}
+
 gssize
 qfu_qdl_request_ufwrite_build (guint8        *buffer,
                                gsize          buffer_len,
                                QfuImage      *image,
+                               gsize          chunk_size,
                                guint16        sequence,
                                GCancellable  *cancellable,
                                GError       **error)
 {
-    QdlUfwriteReq *req;
-    gssize         n_read;
+    gssize n_read;
 
     g_assert (buffer_len >= sizeof (QdlUfwriteReq));
 
     /* Append chunk */
-    n_read = qfu_image_read_data_chunk (image, sequence, buffer + sizeof (QdlUfwriteReq), buffer_len - sizeof (QdlUfwriteReq), cancellable, error);
+    n_read = qfu_image_read_data_chunk (image, chunk_size, sequence, buffer + sizeof (QdlUfwriteReq), buffer_len - sizeof (QdlUfwriteReq), cancellable, error);
     if (n_read < 0) {
         g_prefix_error (error, "couldn't read image chunk #%u: ", sequence);
         return -1;
     }
 
     /* Create request after appending, so that we have correct chunksize */
-    req = (QdlUfwriteReq *) buffer;
-    memset (req, 0, sizeof (QdlUfwriteReq));
-	req->cmd       = QFU_QDL_CMD_WRITE_UNFRAMED_REQ;
-	req->sequence  = GUINT16_TO_LE (sequence);
-	req->reserved  = 0;
-	req->chunksize = GUINT32_TO_LE ((guint32) n_read);
-	req->crc       = GUINT16_TO_LE (qfu_utils_crc16 (buffer, sizeof (QdlUfwriteReq) - 2));
-
-    g_debug ("[qfu,qdl-message] sent %s:", qfu_qdl_cmd_get_string ((QfuQdlCmd) req->cmd));
-    g_debug ("[qfu,qdl-message]   sequence:   %" G_GUINT16_FORMAT, GUINT16_FROM_LE (req->sequence));
-    g_debug ("[qfu,qdl-message]   chunk size: %" G_GUINT32_FORMAT, GUINT32_FROM_LE (req->chunksize));
-
-	return (sizeof (QdlUfopenReq) + n_read);
+	return (qfu_qdl_request_ufwrite_header_build (buffer, buffer_len, sequence, n_read) + n_read);
 }
 
 /* The response is HDLC framed, so the crc is part of the framing */
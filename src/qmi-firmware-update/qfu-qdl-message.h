@@ -33,8 +33,8 @@ G_BEGIN_DECLS
 /* Maximum QDL header size (i.e. without payload) */
 #define QFU_QDL_MESSAGE_MAX_HEADER_SIZE 50
 
-/* Maximum QDL message size (header and payload) */
-#define QFU_QDL_MESSAGE_MAX_SIZE (QFU_QDL_MESSAGE_MAX_HEADER_SIZE + QFU_IMAGE_CHUNK_SIZE)
+/* Maximum QDL message size (header and payload) for the given chunk size */
+#define QFU_QDL_MESSAGE_MAX_SIZE(chunk_size) (QFU_QDL_MESSAGE_MAX_HEADER_SIZE + (chunk_size))
 
 /* from GobiAPI_1.0.40/Core/QDLEnum.h and
  * GobiAPI_1.0.40/Core/QDLBuffers.h with additional details from USB
@@ -65,14 +65,20 @@ gsize  qfu_qdl_request_hello_build   (guint8        *buffer,
 gssize qfu_qdl_request_ufopen_build  (guint8        *buffer,
                                       gsize          buffer_len,
                                       QfuImage      *image,
+                                      guint8         window_size,
                                       GCancellable  *cancellable,
                                       GError       **error);
 gssize qfu_qdl_request_ufwrite_build (guint8        *buffer,
                                       gsize          buffer_len,
                                       QfuImage      *image,
+                                      gsize          chunk_size,
                                       guint16        sequence,
                                       GCancellable  *cancellable,
                                       GError       **error);
+gsize  qfu_qdl_request_ufwrite_header_build (guint8  *buffer,
+                                             gsize    buffer_len,
+                                             guint16  sequence,
+                                             gsize    chunk_size);
 gsize  qfu_qdl_request_ufclose_build (guint8        *buffer,
                                       gsize          buffer_len);
 gsize  qfu_qdl_request_reset_build   (guint8        *buffer,
@@ -82,12 +88,14 @@ gsize  qfu_qdl_request_reset_build   (guint8        *buffer,
 
 gboolean qfu_qdl_response_hello_parse    (const guint8  *buffer,
                                           gsize          buffer_len,
+                                          guint32       *max_chunk_size,
                                           GError       **error);
 gboolean qfu_qdl_response_error_parse    (const guint8  *buffer,
                                           gsize          buffer_len,
                                           GError       **error);
 gboolean qfu_qdl_response_ufopen_parse   (const guint8  *buffer,
                                           gsize          buffer_len,
+                                          guint8        *window_size,
                                           GError       **error);
 gboolean qfu_qdl_response_ufwrite_parse  (const guint8  *buffer,
                                           gsize          buffer_len,
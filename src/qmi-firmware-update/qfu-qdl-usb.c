@@ -0,0 +1,496 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * qmi-firmware-update -- Command line tool to update firmware in QMI devices
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <linux/usbdevice_fs.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "qfu-qdl-usb.h"
+
+/* Up to 128 KiB of a request in flight at any time */
+#define N_WRITE_TRANSFERS   8
+#define WRITE_TRANSFER_SIZE (16 * 1024)
+
+/* Standard descriptor types and endpoint attributes */
+#define USB_DT_CONFIG            0x02
+#define USB_DT_INTERFACE         0x04
+#define USB_DT_ENDPOINT          0x05
+#define USB_ENDPOINT_DIR_IN      0x80
+#define USB_ENDPOINT_XFER_MASK   0x03
+#define USB_ENDPOINT_XFER_BULK   0x02
+
+typedef struct {
+    struct usbdevfs_urb  urb;
+    guint8              *buffer;
+    gboolean             in_flight;
+} Transfer;
+
+struct _QfuQdlUsb {
+    gint      fd;
+    guint8    interface_number;
+    gboolean  interface_claimed;
+    gboolean  driver_disconnected;
+    guint8    endpoint_in;
+    guint16   max_packet_size_in;
+    guint8    endpoint_out;
+    guint16   max_packet_size_out;
+    Transfer  write_transfers[N_WRITE_TRANSFERS];
+    Transfer  read_transfer;
+};
+
+/******************************************************************************/
+/* Completions */
+
+/* Waits for the fd to report completed URBs, or a disconnection */
+static gboolean
+wait_completion (QfuQdlUsb     *self,
+                 guint          timeout_secs,
+                 GCancellable  *cancellable,
+                 GError       **error)
+{
+    struct pollfd fds[2];
+    GPollFD       cancellable_fd;
+    guint         n_fds = 1;
+    gint          aux;
+
+    fds[0].fd      = self->fd;
+    fds[0].events  = POLLOUT;
+    fds[0].revents = 0;
+    if (g_cancellable_make_pollfd (cancellable, &cancellable_fd)) {
+        fds[1].fd      = cancellable_fd.fd;
+        fds[1].events  = POLLIN;
+        fds[1].revents = 0;
+        n_fds++;
+    }
+
+    aux = poll (fds, n_fds, timeout_secs * 1000);
+
+    if (n_fds > 1)
+        g_cancellable_release_fd (cancellable);
+
+    if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        return FALSE;
+
+    if (aux < 0) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "error waiting for USB transfers: %s",
+                     g_strerror (errno));
+        return FALSE;
+    }
+
+    if (aux == 0) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "timed out waiting for USB transfers");
+        return FALSE;
+    }
+
+    if (fds[0].revents & (POLLERR | POLLHUP)) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "USB device is gone");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Returns the completed transfer, or NULL if none yet */
+static Transfer *
+reap_transfer (QfuQdlUsb  *self,
+               gboolean    block,
+               GError    **error)
+{
+    struct usbdevfs_urb *urb = NULL;
+    Transfer            *transfer;
+
+    if (ioctl (self->fd, block ? USBDEVFS_REAPURB : USBDEVFS_REAPURBNDELAY, &urb) < 0) {
+        if (errno != EAGAIN)
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                         "error reaping USB transfer: %s",
+                         g_strerror (errno));
+        return NULL;
+    }
+
+    transfer = (Transfer *) urb->usercontext;
+    transfer->in_flight = FALSE;
+    return transfer;
+}
+
+/* Any transfer left in flight after an error is cancelled, and reaped so that
+ * its buffer may be reused. */
+static void
+discard_transfers (QfuQdlUsb *self,
+                   Transfer  *transfers,
+                   guint      n_transfers)
+{
+    guint i;
+
+    for (i = 0; i < n_transfers; i++) {
+        /* EINVAL if already completed, waiting to be reaped */
+        if (transfers[i].in_flight)
+            ioctl (self->fd, USBDEVFS_DISCARDURB, &transfers[i].urb);
+    }
+
+    for (i = 0; i < n_transfers; i++) {
+        while (transfers[i].in_flight) {
+            if (!reap_transfer (self, TRUE, NULL))
+                transfers[i].in_flight = FALSE;
+        }
+    }
+}
+
+static gboolean
+submit_transfer (QfuQdlUsb  *self,
+                 Transfer   *transfer,
+                 guint8      endpoint,
+                 gsize       length,
+                 guint       flags,
+                 GError    **error)
+{
+    memset (&transfer->urb, 0, sizeof (transfer->urb));
+    transfer->urb.type          = USBDEVFS_URB_TYPE_BULK;
+    transfer->urb.endpoint      = endpoint;
+    transfer->urb.flags         = flags;
+    transfer->urb.buffer        = transfer->buffer;
+    transfer->urb.buffer_length = length;
+    transfer->urb.usercontext   = transfer;
+
+    if (ioctl (self->fd, USBDEVFS_SUBMITURB, &transfer->urb) < 0) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "error submitting USB transfer: %s",
+                     g_strerror (errno));
+        return FALSE;
+    }
+
+    transfer->in_flight = TRUE;
+    return TRUE;
+}
+
+/******************************************************************************/
+/* Write */
+
+/* The request is copied in full size transfers, so that only the last one is
+ * a short packet closing the request; if there is no short packet, a zero
+ * length one is sent instead. */
+gboolean
+qfu_qdl_usb_write (QfuQdlUsb          *self,
+                   const struct iovec *iov,
+                   gint                iovcnt,
+                   guint               timeout_secs,
+                   GCancellable       *cancellable,
+                   GError            **error)
+{
+    gsize  request_size = 0;
+    gsize  remaining;
+    gint   iov_i = 0;
+    gsize  iov_offset = 0;
+    guint  n_in_flight = 0;
+    gint   i;
+
+    for (i = 0; i < iovcnt; i++)
+        request_size += iov[i].iov_len;
+    remaining = request_size;
+
+    while (remaining > 0 || n_in_flight > 0) {
+        Transfer *transfer;
+        GError   *inner_error = NULL;
+
+        /* Fill in and submit all transfers available */
+        for (i = 0; remaining > 0 && i < N_WRITE_TRANSFERS; i++) {
+            gsize length = 0;
+            guint flags = 0;
+
+            transfer = &self->write_transfers[i];
+            if (transfer->in_flight)
+                continue;
+
+            while (length < WRITE_TRANSFER_SIZE && remaining > 0) {
+                gsize n;
+
+                n = MIN (iov[iov_i].iov_len - iov_offset, WRITE_TRANSFER_SIZE - length);
+                memcpy (&transfer->buffer[length], (const guint8 *) iov[iov_i].iov_base + iov_offset, n);
+                length     += n;
+                remaining  -= n;
+                iov_offset += n;
+                if (iov_offset == iov[iov_i].iov_len) {
+                    iov_i++;
+                    iov_offset = 0;
+                }
+            }
+
+            if (remaining == 0 && (request_size % self->max_packet_size_out) == 0)
+                flags |= USBDEVFS_URB_ZERO_PACKET;
+
+            if (!submit_transfer (self, transfer, self->endpoint_out, length, flags, error))
+                goto out;
+            n_in_flight++;
+        }
+
+        if (!wait_completion (self, timeout_secs, cancellable, error))
+            goto out;
+
+        while ((transfer = reap_transfer (self, FALSE, &inner_error)) != NULL) {
+            n_in_flight--;
+            if (transfer->urb.status != 0) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             "error writing: %s",
+                             g_strerror (-transfer->urb.status));
+                goto out;
+            }
+            if (transfer->urb.actual_length != transfer->urb.buffer_length) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             "error writing: only %d/%d bytes written",
+                             transfer->urb.actual_length, transfer->urb.buffer_length);
+                goto out;
+            }
+        }
+
+        if (inner_error) {
+            g_propagate_error (error, inner_error);
+            goto out;
+        }
+    }
+
+    return TRUE;
+
+out:
+    discard_transfers (self, self->write_transfers, N_WRITE_TRANSFERS);
+    return FALSE;
+}
+
+/******************************************************************************/
+/* Read */
+
+gssize
+qfu_qdl_usb_read (QfuQdlUsb     *self,
+                  guint8        *buffer,
+                  gsize          buffer_size,
+                  guint          timeout_secs,
+                  GCancellable  *cancellable,
+                  GError       **error)
+{
+    Transfer *transfer = &self->read_transfer;
+    gsize     length;
+
+    /* The device may send up to max packet size bytes in each packet, so don't
+     * request partial packets */
+    length = buffer_size - (buffer_size % self->max_packet_size_in);
+    g_assert (length > 0);
+
+    do {
+        GError *inner_error = NULL;
+
+        transfer->buffer = buffer;
+        if (!submit_transfer (self, transfer, self->endpoint_in, length, 0, error))
+            return -1;
+
+        if (!wait_completion (self, timeout_secs, cancellable, error)) {
+            discard_transfers (self, transfer, 1);
+            /* It may have completed anyway while being discarded */
+            if (transfer->urb.status != 0 || transfer->urb.actual_length == 0)
+                return -1;
+            g_clear_error (error);
+            break;
+        }
+
+        if (!reap_transfer (self, FALSE, &inner_error)) {
+            discard_transfers (self, transfer, 1);
+            if (inner_error)
+                g_propagate_error (error, inner_error);
+            else
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             "couldn't read response: no USB transfer completed");
+            return -1;
+        }
+
+        if (transfer->urb.status != 0) {
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                         "couldn't read response: %s",
+                         g_strerror (-transfer->urb.status));
+            return -1;
+        }
+
+        /* Zero length packets are just skipped */
+    } while (transfer->urb.actual_length == 0);
+
+    return transfer->urb.actual_length;
+}
+
+/******************************************************************************/
+/* Open/close */
+
+/* Bulk endpoints of the first alternate setting of the interface, in the first
+ * configuration, as QDL devices expose only one */
+static gboolean
+load_endpoints (QfuQdlUsb  *self,
+                GError    **error)
+{
+    guint8   descriptors[4096];
+    gssize   n_read;
+    gsize    offset;
+    guint    n_configs = 0;
+    gboolean in_interface = FALSE;
+
+    /* usbfs gives the device descriptor followed by the configuration ones */
+    n_read = read (self->fd, descriptors, sizeof (descriptors));
+    if (n_read < 0) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "couldn't read USB descriptors: %s",
+                     g_strerror (errno));
+        return FALSE;
+    }
+
+    for (offset = 0; offset + 2 <= (gsize) n_read; offset += descriptors[offset]) {
+        const guint8 *descriptor = &descriptors[offset];
+
+        if (descriptor[0] < 2 || offset + descriptor[0] > (gsize) n_read)
+            break;
+
+        if (descriptor[1] == USB_DT_CONFIG) {
+            if (n_configs++ > 0)
+                break;
+        } else if (descriptor[1] == USB_DT_INTERFACE && descriptor[0] >= 9) {
+            in_interface = (descriptor[2] == self->interface_number && descriptor[3] == 0);
+        } else if (descriptor[1] == USB_DT_ENDPOINT && descriptor[0] >= 7 && in_interface &&
+                   (descriptor[3] & USB_ENDPOINT_XFER_MASK) == USB_ENDPOINT_XFER_BULK) {
+            guint16 max_packet_size;
+
+            max_packet_size = (descriptor[4] | (descriptor[5] << 8)) & 0x07ff;
+            if (descriptor[2] & USB_ENDPOINT_DIR_IN) {
+                self->endpoint_in        = descriptor[2];
+                self->max_packet_size_in = max_packet_size;
+            } else {
+                self->endpoint_out        = descriptor[2];
+                self->max_packet_size_out = max_packet_size;
+            }
+        }
+    }
+
+    if (!self->max_packet_size_in || !self->max_packet_size_out) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                     "couldn't find bulk endpoints in USB interface %u",
+                     self->interface_number);
+        return FALSE;
+    }
+
+    g_debug ("[qfu-qdl-usb] bulk endpoints in interface %u: in 0x%02x (%u bytes), out 0x%02x (%u bytes)",
+             self->interface_number,
+             self->endpoint_in, self->max_packet_size_in,
+             self->endpoint_out, self->max_packet_size_out);
+    return TRUE;
+}
+
+QfuQdlUsb *
+qfu_qdl_usb_open (GFile   *usbfs_file,
+                  guint8   interface_number,
+                  GError **error)
+{
+    QfuQdlUsb              *self;
+    struct usbdevfs_ioctl   command;
+    unsigned int            aux;
+    gchar                  *path;
+    guint                   i;
+
+    self = g_slice_new0 (QfuQdlUsb);
+    self->interface_number = interface_number;
+    for (i = 0; i < N_WRITE_TRANSFERS; i++)
+        self->write_transfers[i].buffer = g_malloc (WRITE_TRANSFER_SIZE);
+
+    path = g_file_get_path (usbfs_file);
+    g_debug ("[qfu-qdl-usb] opening USB device: %s", path);
+    self->fd = open (path, O_RDWR | O_CLOEXEC);
+    g_free (path);
+    if (self->fd < 0) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "error opening USB device: %s",
+                     g_strerror (errno));
+        goto failed;
+    }
+
+    if (!load_endpoints (self, error))
+        goto failed;
+
+    /* Unbind the serial driver, if any */
+    memset (&command, 0, sizeof (command));
+    command.ifno       = interface_number;
+    command.ioctl_code = USBDEVFS_DISCONNECT;
+    if (ioctl (self->fd, USBDEVFS_IOCTL, &command) == 0)
+        self->driver_disconnected = TRUE;
+    else if (errno != ENODATA) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "error unbinding driver from USB interface %u: %s",
+                     interface_number, g_strerror (errno));
+        goto failed;
+    }
+
+    aux = interface_number;
+    if (ioctl (self->fd, USBDEVFS_CLAIMINTERFACE, &aux) < 0) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "error claiming USB interface %u: %s",
+                     interface_number, g_strerror (errno));
+        goto failed;
+    }
+    self->interface_claimed = TRUE;
+
+    return self;
+
+failed:
+    qfu_qdl_usb_close (self);
+    return NULL;
+}
+
+void
+qfu_qdl_usb_close (QfuQdlUsb *self)
+{
+    guint i;
+
+    if (!(self->fd < 0)) {
+        discard_transfers (self, self->write_transfers, N_WRITE_TRANSFERS);
+
+        if (self->interface_claimed) {
+            unsigned int aux = self->interface_number;
+
+            ioctl (self->fd, USBDEVFS_RELEASEINTERFACE, &aux);
+        }
+
+        /* Give the interface back to the serial driver */
+        if (self->driver_disconnected) {
+            struct usbdevfs_ioctl command;
+
+            memset (&command, 0, sizeof (command));
+            command.ifno       = self->interface_number;
+            command.ioctl_code = USBDEVFS_CONNECT;
+            ioctl (self->fd, USBDEVFS_IOCTL, &command);
+        }
+
+        close (self->fd);
+    }
+
+    for (i = 0; i < N_WRITE_TRANSFERS; i++)
+        g_free (self->write_transfers[i].buffer);
+    g_slice_free (QfuQdlUsb, self);
+}
@@ -0,0 +1,62 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * qmi-firmware-update -- Command line tool to update firmware in QMI devices
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef QFU_QDL_USB_H
+#define QFU_QDL_USB_H
+
+#include <sys/uio.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Bulk transport for the QDL protocol, talking to the USB interface directly
+ * through usbfs instead of through the serial driver bound to it. The
+ * interface is claimed while the transport is open, so the serial port goes
+ * away meanwhile, and the driver is bound again when it's closed.
+ *
+ * Writes are split in several URBs kept in flight at the same time; reads
+ * return whatever the device sent in one single bulk transfer.
+ */
+
+typedef struct _QfuQdlUsb QfuQdlUsb;
+
+QfuQdlUsb *qfu_qdl_usb_open  (GFile              *usbfs_file,
+                              guint8              interface_number,
+                              GError            **error);
+void       qfu_qdl_usb_close (QfuQdlUsb          *self);
+gboolean   qfu_qdl_usb_write (QfuQdlUsb          *self,
+                              const struct iovec *iov,
+                              gint                iovcnt,
+                              guint               timeout_secs,
+                              GCancellable       *cancellable,
+                              GError            **error);
+gssize     qfu_qdl_usb_read  (QfuQdlUsb          *self,
+                              guint8             *buffer,
+                              gsize               buffer_size,
+                              guint               timeout_secs,
+                              GCancellable       *cancellable,
+                              GError            **error);
+
+G_END_DECLS
+
+#endif /* QFU_QDL_USB_H */
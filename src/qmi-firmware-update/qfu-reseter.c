@@ -43,6 +43,22 @@ struct _QfuReseterPrivate {
 
 #define MAX_RETRIES 2
 
+/* Reset methods. The QMI ones are tried one after the other, unless one is
+ * cached for the device model, at the same time as AT in all ports */
+typedef enum {
+    RESET_METHOD_UNKNOWN,
+    RESET_METHOD_FIRMWARE_ID,
+    RESET_METHOD_BOOT_IMAGE_DOWNLOAD_MODE,
+    RESET_METHOD_AT,
+} ResetMethod;
+
+static const gchar *reset_method_str[] = {
+    [RESET_METHOD_UNKNOWN]                  = "unknown",
+    [RESET_METHOD_FIRMWARE_ID]              = "firmware-id",
+    [RESET_METHOD_BOOT_IMAGE_DOWNLOAD_MODE] = "boot-image-download-mode",
+    [RESET_METHOD_AT]                       = "at",
+};
+
 typedef struct {
     /* Files to use */
     GList      *ttys;
@@ -52,15 +68,29 @@ typedef struct {
     QmiClientDms *qmi_client;
     gboolean      ignore_release_cid;
     /* List of AT devices */
-    GList *at_devices;
-    GList *current;
-    /* Retries */
-    guint retries;
+    GList    *at_devices;
+    /* All methods are probed at the same time, the first one to succeed is
+     * used and the rest are cancelled */
+    GCancellable *cancellable;
+    GCancellable *task_cancellable;
+    gulong        task_cancellable_id;
+    guint         n_probes;
+    gboolean      done;
+    /* Cached method for the device model, if any */
+    gchar       *model;
+    ResetMethod  cached_method;
 } RunContext;
 
 static void
 run_context_free (RunContext *ctx)
 {
+    g_assert (ctx->n_probes == 0);
+
+    if (ctx->task_cancellable) {
+        g_cancellable_disconnect (ctx->task_cancellable, ctx->task_cancellable_id);
+        g_object_unref (ctx->task_cancellable);
+    }
+    g_object_unref (ctx->cancellable);
     if (ctx->cdc_wdm)
         g_object_unref (ctx->cdc_wdm);
     if (ctx->qmi_client) {
@@ -79,9 +109,95 @@ run_context_free (RunContext *ctx)
     }
     g_list_free_full (ctx->ttys, g_object_unref);
     g_list_free_full (ctx->at_devices, g_object_unref);
+    g_free (ctx->model);
     g_slice_free (RunContext, ctx);
 }
 
+/******************************************************************************/
+/* Reset method cache
+ *
+ * The method that worked last time for each device model, given as USB vid
+ * and pid, is kept, so that the QMI-based boothold of models that don't
+ * support 'set firmware id' goes straight to 'set boot image download mode'. */
+
+static gchar *
+reset_method_cache_get_path (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "qmi-firmware-update", "reset-methods", NULL);
+}
+
+static void
+reset_method_cache_lookup (RunContext *ctx)
+{
+    GKeyFile *key_file;
+    gchar    *path;
+    gchar    *method;
+    guint     i;
+
+    path = reset_method_cache_get_path ();
+    key_file = g_key_file_new ();
+    if (g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, NULL)) {
+        method = g_key_file_get_string (key_file, ctx->model, "method", NULL);
+        for (i = RESET_METHOD_UNKNOWN + 1; method && i < G_N_ELEMENTS (reset_method_str); i++) {
+            if (!g_strcmp0 (method, reset_method_str[i])) {
+                ctx->cached_method = (ResetMethod) i;
+                break;
+            }
+        }
+        g_free (method);
+    }
+    g_key_file_free (key_file);
+    g_free (path);
+
+    if (ctx->cached_method != RESET_METHOD_UNKNOWN)
+        g_debug ("[qfu-reseter] cached reset method for %s: %s", ctx->model, reset_method_str[ctx->cached_method]);
+}
+
+static void
+reset_method_cache_store (RunContext  *ctx,
+                          ResetMethod  method)
+{
+    GKeyFile *key_file;
+    gchar    *path;
+    gchar    *dir;
+    gchar    *data;
+    gsize     data_length;
+    GError   *error = NULL;
+
+    if (!ctx->model)
+        return;
+
+    /* Nothing to update */
+    if (method == ctx->cached_method)
+        return;
+
+    path = reset_method_cache_get_path ();
+    dir = g_path_get_dirname (path);
+    key_file = g_key_file_new ();
+
+    /* Errors are ignored, the cache is only an optimization */
+    if (g_mkdir_with_parents (dir, 0755) < 0) {
+        g_debug ("[qfu-reseter] couldn't create reset method cache directory (ignored)");
+        goto out;
+    }
+
+    g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, NULL);
+    g_key_file_set_string (key_file, ctx->model, "method", reset_method_str[method]);
+    /* Not used any more, all AT ports are tried at the same time */
+    g_key_file_remove_key (key_file, ctx->model, "at-port", NULL);
+    data = g_key_file_to_data (key_file, &data_length, NULL);
+    if (!g_file_set_contents (path, data, data_length, &error)) {
+        g_debug ("[qfu-reseter] couldn't update reset method cache (ignored): %s", error->message);
+        g_error_free (error);
+    }
+    g_free (data);
+
+out:
+    g_key_file_free (key_file);
+    g_free (dir);
+    g_free (path);
+}
+
 gboolean
 qfu_reseter_run_finish (QfuReseter    *self,
                          GAsyncResult  *res,
@@ -90,124 +206,136 @@ qfu_reseter_run_finish (QfuReseter    *self,
     return g_task_propagate_boolean (G_TASK (res), error);
 }
 
-static void run_context_step_at (GTask *task);
-
-static gboolean
-run_context_step_at_cb (GTask *task)
-{
-    run_context_step_at (task);
-    return FALSE;
-}
-
+/* Each probe completes once, with the method that worked, or with
+ * RESET_METHOD_UNKNOWN if it failed. The first success finishes the operation
+ * and cancels the rest; if all fail, the operation fails. */
 static void
-run_context_step_at_next (GTask *task)
+run_context_probe_complete (GTask       *task,
+                            ResetMethod  method)
 {
     RunContext *ctx;
 
     ctx = (RunContext *) g_task_get_task_data (task);
-    ctx->current = g_list_next (ctx->current);
 
-    if (!ctx->current) {
-        if (!ctx->retries) {
+    g_assert (ctx->n_probes > 0);
+    ctx->n_probes--;
+
+    if (!ctx->done) {
+        if (method != RESET_METHOD_UNKNOWN) {
+            ctx->done = TRUE;
+            g_debug ("[qfu-reseter] reset requested with method: %s", reset_method_str[method]);
+            reset_method_cache_store (ctx, method);
+            ctx->ignore_release_cid = TRUE;
+            g_cancellable_cancel (ctx->cancellable);
+            g_task_return_boolean (task, TRUE);
+        } else if (ctx->n_probes == 0) {
+            ctx->done = TRUE;
             g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
                                      "couldn't run reset operation");
-            g_object_unref (task);
-            return;
         }
-
-        /* Launch retry with the first device */
-        ctx->retries--;
-        ctx->current = ctx->at_devices;
     }
 
-    /* Schedule next step in an idle */
-    g_idle_add ((GSourceFunc) run_context_step_at_cb, task);
+    g_object_unref (task);
 }
 
-static gint
-device_sort_by_name_reversed (QfuAtDevice *a, QfuAtDevice *b)
-{
-    return strcmp (qfu_at_device_get_name (b), qfu_at_device_get_name (a));
-}
+/******************************************************************************/
+/* AT-based boothold, in all ports */
+
+typedef struct {
+    GTask *task;
+    guint  n_tries;
+} AtProbe;
 
 static void
-run_context_step_at (GTask *task)
+at_device_boothold_ready (QfuAtDevice  *at_device,
+                          GAsyncResult *res,
+                          AtProbe      *probe)
 {
-    RunContext  *ctx;
-    QfuAtDevice *at_device;
-    GError      *error = NULL;
+    RunContext *ctx;
+    GError     *error = NULL;
 
-    ctx = (RunContext *) g_task_get_task_data (task);
+    ctx = (RunContext *) g_task_get_task_data (probe->task);
 
-    /* If we get to AT reset after trying QMI, and we didn't find any port to
-     * use, return error */
-    if (!ctx->ttys) {
-        g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
-                                 "No devices found to run reset operation");
-        g_object_unref (task);
+    if (qfu_at_device_boothold_finish (at_device, res, &error)) {
+        g_debug ("[qfu-reseter] successfully run 'at boothold' operation in %s", qfu_at_device_get_name (at_device));
+        run_context_probe_complete (probe->task, RESET_METHOD_AT);
+        g_slice_free (AtProbe, probe);
         return;
     }
 
-    /* Initialize AT devices the first time we get here */
-    if (!ctx->at_devices) {
-        GList *l;
-
-        for (l = ctx->ttys; l; l = g_list_next (l)) {
-            at_device = qfu_at_device_new (G_FILE (l->data), g_task_get_cancellable (task), &error);
-            if (!at_device) {
-                g_task_return_error (task, error);
-                g_object_unref (task);
-                return;
-            }
-            ctx->at_devices = g_list_append (ctx->at_devices, at_device);
-        }
-
-        /* Sort by filename reversed; usually the TTY with biggest number is a
-         * good AT port */
-        ctx->at_devices = g_list_sort (ctx->at_devices, (GCompareFunc) device_sort_by_name_reversed);
-        /* Select first TTY to start */
-        ctx->current = ctx->at_devices;
-    } else
-        g_assert (ctx->current);
-
-    at_device = QFU_AT_DEVICE (ctx->current->data);
-    if (!qfu_at_device_boothold (at_device, g_task_get_cancellable (task), &error)) {
-        g_debug ("[qfu-reseter] error: %s", error->message);
+    /* Each device is tried MAX_RETRIES + 1 times, unless some other probe
+     * succeeded already */
+    probe->n_tries++;
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) || probe->n_tries > MAX_RETRIES) {
+        if (!ctx->done)
+            g_debug ("[qfu-reseter] error: %s: %s", qfu_at_device_get_name (at_device), error->message);
         g_error_free (error);
-        run_context_step_at_next (task);
+        run_context_probe_complete (probe->task, RESET_METHOD_UNKNOWN);
+        g_slice_free (AtProbe, probe);
         return;
     }
 
-    /* Success! */
-    g_debug ("[qfu-reseter] successfully run 'at boothold' operation");
-    ctx->ignore_release_cid = TRUE;
-    g_task_return_boolean (task, TRUE);
-    g_object_unref (task);
+    g_debug ("[qfu-reseter] error (retrying): %s: %s", qfu_at_device_get_name (at_device), error->message);
+    g_error_free (error);
+    qfu_at_device_boothold_async (at_device,
+                                  ctx->cancellable,
+                                  (GAsyncReadyCallback) at_device_boothold_ready,
+                                  probe);
 }
 
 static void
-power_cycle_ready (QmiClientDms *qmi_client,
-                   GAsyncResult *res,
-                   GTask        *task)
+run_context_probe_at (GTask *task)
 {
-    GError     *error = NULL;
     RunContext *ctx;
+    GList      *l;
 
     ctx = (RunContext *) g_task_get_task_data (task);
 
+    for (l = ctx->ttys; l; l = g_list_next (l)) {
+        QfuAtDevice *at_device;
+        GError      *error = NULL;
+
+        at_device = qfu_at_device_new (G_FILE (l->data), ctx->cancellable, &error);
+        if (!at_device) {
+            g_debug ("[qfu-reseter] error: couldn't open AT device: %s", error->message);
+            g_error_free (error);
+            continue;
+        }
+        ctx->at_devices = g_list_append (ctx->at_devices, at_device);
+    }
+
+    for (l = ctx->at_devices; l; l = g_list_next (l)) {
+        AtProbe *probe;
+
+        probe = g_slice_new0 (AtProbe);
+        probe->task = g_object_ref (task);
+        ctx->n_probes++;
+        qfu_at_device_boothold_async (QFU_AT_DEVICE (l->data),
+                                      ctx->cancellable,
+                                      (GAsyncReadyCallback) at_device_boothold_ready,
+                                      probe);
+    }
+}
+
+/******************************************************************************/
+/* QMI-based boothold */
+
+static void
+power_cycle_ready (QmiClientDms *qmi_client,
+                   GAsyncResult *res,
+                   GTask        *task)
+{
+    GError *error = NULL;
+
     if (!qfu_utils_power_cycle_finish (qmi_client, res, &error)) {
         g_debug ("[qfu-reseter] error: couldn't power cycle: %s", error->message);
         g_error_free (error);
-        g_debug ("[qfu-reseter] skipping QMI-based boothold");
-        run_context_step_at (task);
+        run_context_probe_complete (task, RESET_METHOD_UNKNOWN);
         return;
     }
 
     g_debug ("[qfu-reseter] reset requested successfully...");
-
-    ctx->ignore_release_cid = TRUE;
-    g_task_return_boolean (task, TRUE);
-    g_object_unref (task);
+    run_context_probe_complete (task, RESET_METHOD_BOOT_IMAGE_DOWNLOAD_MODE);
 }
 
 static void
@@ -227,8 +355,7 @@ set_boot_image_download_mode_ready (QmiClientDms *client,
         g_error_free (error);
         if (output)
             qmi_message_dms_set_boot_image_download_mode_output_unref (output);
-        g_debug ("[qfu-reseter] skipping QMI-based boothold");
-        run_context_step_at (task);
+        run_context_probe_complete (task, RESET_METHOD_UNKNOWN);
         return;
     }
 
@@ -236,8 +363,8 @@ set_boot_image_download_mode_ready (QmiClientDms *client,
 
     g_debug ("[qfu-reseter] successfully run 'set boot image download mode' operation");
 
-    qfu_utils_power_cycle (ctx->qmi_client,
-                           g_task_get_cancellable (task),
+    qfu_utils_power_cycle (client,
+                           ctx->cancellable,
                            (GAsyncReadyCallback) power_cycle_ready,
                            task);
 }
@@ -260,7 +387,7 @@ run_context_step_qmi_boot_image_download_mode (GTask *task)
     qmi_client_dms_set_boot_image_download_mode (self->priv->qmi_client ? self->priv->qmi_client : ctx->qmi_client,
                                                  input,
                                                  10,
-                                                 g_task_get_cancellable (task),
+                                                 ctx->cancellable,
                                                  (GAsyncReadyCallback) set_boot_image_download_mode_ready,
                                                  task);
     qmi_message_dms_set_boot_image_download_mode_input_unref (input);
@@ -273,16 +400,20 @@ set_firmware_id_ready (QmiClientDms *client,
 {
     QmiMessageDmsSetFirmwareIdOutput *output;
     GError                           *error = NULL;
-    RunContext                       *ctx;
-
-    ctx = (RunContext *) g_task_get_task_data (task);
 
     output = qmi_client_dms_set_firmware_id_finish (client, res, &error);
     if (!output || !qmi_message_dms_set_firmware_id_output_get_result (output, &error)) {
+        gboolean cancelled;
+
         g_debug ("[qfu-reseter] error: couldn't run 'set firmware id' operation: %s", error->message);
+        cancelled = g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
         g_error_free (error);
         if (output)
             qmi_message_dms_set_firmware_id_output_unref (output);
+        if (cancelled) {
+            run_context_probe_complete (task, RESET_METHOD_UNKNOWN);
+            return;
+        }
         g_debug ("[qfu-reseter] trying boot image download mode...");
         run_context_step_qmi_boot_image_download_mode (task);
         return;
@@ -291,9 +422,7 @@ set_firmware_id_ready (QmiClientDms *client,
     qmi_message_dms_set_firmware_id_output_unref (output);
 
     g_debug ("[qfu-reseter] successfully run 'set firmware id' operation");
-    ctx->ignore_release_cid = TRUE;
-    g_task_return_boolean (task, TRUE);
-    g_object_unref (task);
+    run_context_probe_complete (task, RESET_METHOD_FIRMWARE_ID);
 }
 
 static void
@@ -311,11 +440,27 @@ run_context_step_qmi_firmware_id (GTask *task)
     qmi_client_dms_set_firmware_id (self->priv->qmi_client ? self->priv->qmi_client : ctx->qmi_client,
                                     NULL,
                                     10,
-                                    g_task_get_cancellable (task),
+                                    ctx->cancellable,
                                     (GAsyncReadyCallback) set_firmware_id_ready,
                                     task);
 }
 
+static void
+run_context_step_qmi_method (GTask *task)
+{
+    RunContext *ctx;
+
+    ctx = (RunContext *) g_task_get_task_data (task);
+
+    /* Skip 'set firmware id' if it didn't work last time */
+    if (ctx->cached_method == RESET_METHOD_BOOT_IMAGE_DOWNLOAD_MODE) {
+        run_context_step_qmi_boot_image_download_mode (task);
+        return;
+    }
+
+    run_context_step_qmi_firmware_id (task);
+}
+
 static void
 new_client_dms_ready (gpointer      unused,
                       GAsyncResult *res,
@@ -329,17 +474,56 @@ new_client_dms_ready (gpointer      unused,
     if (!qfu_utils_new_client_dms_finish (res,
                                           &ctx->qmi_device,
                                           &ctx->qmi_client,
-                                          NULL, NULL, NULL, NULL, NULL, NULL,
+                                          NULL, NULL, NULL, NULL, NULL, NULL, NULL,
                                           &error)) {
-        /* Jump to AT-based boothold */
         g_debug ("[qfu-reseter] error: couldn't allocate QMI client: %s", error->message);
         g_error_free (error);
-        g_debug ("[qfu-reseter] skipping QMI-based boothold");
-        run_context_step_at (task);
+        run_context_probe_complete (task, RESET_METHOD_UNKNOWN);
         return;
     }
 
-    run_context_step_qmi_firmware_id (task);
+    run_context_step_qmi_method (task);
+}
+
+static void
+run_context_probe_qmi (GTask *task)
+{
+    RunContext *ctx;
+    QfuReseter *self;
+
+    ctx = (RunContext *) g_task_get_task_data (task);
+    self = g_task_get_source_object (task);
+
+    /* No QMI client given as input, and no cdc-wdm file available */
+    if (!self->priv->qmi_client && !ctx->cdc_wdm)
+        return;
+
+    ctx->n_probes++;
+    g_object_ref (task);
+
+    /* If we already got a QMI client as input, try QMI directly */
+    if (self->priv->qmi_client) {
+        run_context_step_qmi_method (task);
+        return;
+    }
+
+    /* Otherwise, try to allocate a QMI client */
+    qfu_utils_new_client_dms (ctx->cdc_wdm,
+                              3,
+                              self->priv->device_open_flags,
+                              FALSE,
+                              ctx->cancellable,
+                              (GAsyncReadyCallback) new_client_dms_ready,
+                              task);
+}
+
+/******************************************************************************/
+
+static void
+task_cancelled (GCancellable *task_cancellable,
+                GCancellable *cancellable)
+{
+    g_cancellable_cancel (cancellable);
 }
 
 void
@@ -350,9 +534,11 @@ qfu_reseter_run (QfuReseter          *self,
 {
     RunContext *ctx;
     GTask      *task;
+    guint16     vid;
+    guint16     pid;
 
     ctx = g_slice_new0 (RunContext);
-    ctx->retries = MAX_RETRIES;
+    ctx->cancellable = g_cancellable_new ();
 
     task = g_task_new (self, cancellable, callback, user_data);
     g_task_set_task_data (task, ctx, (GDestroyNotify) run_context_free);
@@ -369,27 +555,30 @@ qfu_reseter_run (QfuReseter          *self,
         return;
     }
 
-    /* If no cdc-wdm file available, try AT directly */
-    if (!ctx->cdc_wdm && !self->priv->qmi_client) {
-        run_context_step_at (task);
-        return;
+    /* Look for the method that worked last time with this model */
+    if (qfu_device_selection_get_usb_ids (self->priv->device_selection, &vid, &pid)) {
+        ctx->model = g_strdup_printf ("%04x:%04x", vid, pid);
+        reset_method_cache_lookup (ctx);
     }
 
-    /* If we already got a QMI client as input, try QMI directly */
-    if (self->priv->qmi_client) {
-        run_context_step_qmi_firmware_id (task);
-        return;
+    /* Cancelling the operation cancels all probes */
+    if (cancellable) {
+        ctx->task_cancellable = g_object_ref (cancellable);
+        ctx->task_cancellable_id = g_cancellable_connect (cancellable,
+                                                          G_CALLBACK (task_cancelled),
+                                                          ctx->cancellable,
+                                                          NULL);
     }
 
-    /* Otherwise, try to allocate a QMI client */
-    g_assert (ctx->cdc_wdm);
-    qfu_utils_new_client_dms (ctx->cdc_wdm,
-                              3,
-                              self->priv->device_open_flags,
-                              FALSE,
-                              cancellable,
-                              (GAsyncReadyCallback) new_client_dms_ready,
-                              task);
+    run_context_probe_qmi (task);
+    run_context_probe_at (task);
+
+    if (!ctx->n_probes) {
+        ctx->done = TRUE;
+        g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                 "couldn't run reset operation");
+    }
+    g_object_unref (task);
 }
 
 /******************************************************************************/
@@ -131,6 +131,7 @@ udev_helper_get_udev_device_details (GUdevDevice  *device,
 static gboolean
 udev_helper_get_udev_interface_details (GUdevDevice  *device,
                                         gchar       **out_driver,
+                                        guint8       *out_interface_number,
                                         GError      **error)
 {
     GUdevDevice *parent;
@@ -159,6 +160,20 @@ udev_helper_get_udev_interface_details (GUdevDevice  *device,
     if (out_driver)
         *out_driver = g_strdup (g_udev_device_get_driver (parent));
 
+    if (out_interface_number) {
+        const gchar *interface_number_str;
+        gulong       aux;
+
+        interface_number_str = g_udev_device_get_sysfs_attr (parent, "bInterfaceNumber");
+        aux = interface_number_str ? strtoul (interface_number_str, NULL, 16) : G_MAXULONG;
+        if (aux > G_MAXUINT8) {
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "couldn't read USB interface number");
+            g_object_unref (parent);
+            return FALSE;
+        }
+        *out_interface_number = (guint8) aux;
+    }
+
     g_object_unref (parent);
     return TRUE;
 }
@@ -230,6 +245,82 @@ qfu_udev_helper_find_by_file_path (const gchar  *path,
 
 /******************************************************************************/
 
+GFile *
+qfu_udev_helper_find_usbfs_by_file (GFile   *file,
+                                    guint8  *interface_number,
+                                    GError **error)
+{
+    GUdevClient *client;
+    GUdevDevice *device;
+    gchar       *basename;
+    gchar       *usbfs_path = NULL;
+    guint        busnum = 0;
+    guint        devnum = 0;
+    GFile       *usbfs_file = NULL;
+
+    client = g_udev_client_new (NULL);
+
+    basename = g_file_get_basename (file);
+    device = g_udev_client_query_by_subsystem_and_name (client, "tty", basename);
+    if (!device) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "device not found");
+        goto out;
+    }
+
+    if (!udev_helper_get_udev_interface_details (device, NULL, interface_number, error) ||
+        !udev_helper_get_udev_device_details (device, NULL, NULL, NULL, &busnum, &devnum, error))
+        goto out;
+
+    usbfs_path = g_strdup_printf ("/dev/bus/usb/%03u/%03u", busnum, devnum);
+    g_debug ("[qfu-udev] usbfs device for '%s' found: %s (interface %u)", basename, usbfs_path, *interface_number);
+    usbfs_file = g_file_new_for_path (usbfs_path);
+
+out:
+    g_free (usbfs_path);
+    g_free (basename);
+    g_clear_object (&device);
+    g_object_unref (client);
+    return usbfs_file;
+}
+
+/******************************************************************************/
+
+gboolean
+qfu_udev_helper_get_usb_ids (const gchar *sysfs_path,
+                             guint16     *vid,
+                             guint16     *pid)
+{
+    GUdevClient *client;
+    GUdevDevice *device;
+    const gchar *vid_str = NULL;
+    const gchar *pid_str = NULL;
+    gulong       vid_aux;
+    gulong       pid_aux;
+
+    client = g_udev_client_new (NULL);
+    device = g_udev_client_query_by_sysfs_path (client, sysfs_path);
+    if (device) {
+        vid_str = g_udev_device_get_sysfs_attr (device, "idVendor");
+        pid_str = g_udev_device_get_sysfs_attr (device, "idProduct");
+    }
+
+    if (vid_str && pid_str) {
+        vid_aux = strtoul (vid_str, NULL, 16);
+        pid_aux = strtoul (pid_str, NULL, 16);
+        if (vid_aux > 0 && vid_aux <= G_MAXUINT16 && pid_aux <= G_MAXUINT16) {
+            *vid = (guint16) vid_aux;
+            *pid = (guint16) pid_aux;
+        } else
+            vid_str = NULL;
+    }
+
+    g_clear_object (&device);
+    g_object_unref (client);
+    return (vid_str && pid_str);
+}
+
+/******************************************************************************/
+
 static gboolean
 udev_helper_device_already_added (GPtrArray   *ptr,
                                   const gchar *sysfs_path)
@@ -359,6 +450,35 @@ out:
 
 /******************************************************************************/
 
+static gboolean
+device_type_matches_driver (QfuUdevHelperDeviceType  type,
+                            const gchar             *driver)
+{
+    switch (type) {
+    case QFU_UDEV_HELPER_DEVICE_TYPE_TTY:
+        return (g_strcmp0 (driver, "qcserial") == 0);
+    case QFU_UDEV_HELPER_DEVICE_TYPE_CDC_WDM:
+        return (g_strcmp0 (driver, "qmi_wwan") == 0 || g_strcmp0 (driver, "cdc_mbim") == 0);
+    default:
+        break;
+    }
+
+    g_assert_not_reached ();
+    return FALSE;
+}
+
+static GFile *
+device_file_new (GUdevDevice *device)
+{
+    GFile *file;
+    gchar *device_path;
+
+    device_path = g_strdup_printf ("/dev/%s", g_udev_device_get_name (device));
+    file = g_file_new_for_path (device_path);
+    g_free (device_path);
+    return file;
+}
+
 static GFile *
 device_matches_sysfs_and_type (GUdevDevice             *device,
                                const gchar             *sysfs_path,
@@ -367,7 +487,6 @@ device_matches_sysfs_and_type (GUdevDevice             *device,
     GFile *file = NULL;
     gchar *device_sysfs_path = NULL;
     gchar *device_driver = NULL;
-    gchar *device_path = NULL;
 
     if (!udev_helper_get_udev_device_details (device,
                                               &device_sysfs_path, NULL, NULL, NULL, NULL,
@@ -382,25 +501,14 @@ device_matches_sysfs_and_type (GUdevDevice             *device,
 
     if (!udev_helper_get_udev_interface_details (device,
                                                  &device_driver,
+                                                 NULL,
                                                  NULL))
         goto out;
 
-    switch (type) {
-    case QFU_UDEV_HELPER_DEVICE_TYPE_TTY:
-        if (g_strcmp0 (device_driver, "qcserial") != 0)
-            goto out;
-        break;
-    case QFU_UDEV_HELPER_DEVICE_TYPE_CDC_WDM:
-        if (g_strcmp0 (device_driver, "qmi_wwan") != 0 && g_strcmp0 (device_driver, "cdc_mbim") != 0)
-            goto out;
-        break;
-    default:
-        g_assert_not_reached ();
-    }
+    if (!device_type_matches_driver (type, device_driver))
+        goto out;
 
-    device_path = g_strdup_printf ("/dev/%s", g_udev_device_get_name (device));
-    file = g_file_new_for_path (device_path);
-    g_free (device_path);
+    file = device_file_new (device);
 
 out:
     g_free (device_sysfs_path);
@@ -449,6 +557,44 @@ qfu_udev_helper_list_devices (QfuUdevHelperDeviceType  device_type,
     return files;
 }
 
+/******************************************************************************/
+/* Shared udev monitor
+ *
+ * A single monitor is used for all the operations, kept alive as long as
+ * there is any generic monitor or wait in place. The device selections own a
+ * generic monitor since they're created, so the monitor is already listening
+ * by the time a reset is requested.
+ *
+ * Waits subscribe to events by the sysfs path of the physical USB device, so
+ * each event only needs to be matched once, regardless of how many waits are
+ * in place. */
+
+static GUdevClient *shared_udev;
+static GHashTable  *wait_for_device_subscriptions;
+
+static void handle_uevent (GUdevClient *client,
+                           const char  *action,
+                           GUdevDevice *device,
+                           gpointer     user_data);
+
+static GUdevClient *
+shared_udev_get (void)
+{
+    static const gchar *all_list[] = {
+        "usbmisc", "usb",
+        "tty",
+        "net",
+        NULL };
+
+    if (shared_udev)
+        return g_object_ref (shared_udev);
+
+    shared_udev = g_udev_client_new (all_list);
+    g_object_add_weak_pointer (G_OBJECT (shared_udev), (gpointer *) &shared_udev);
+    g_signal_connect (shared_udev, "uevent", G_CALLBACK (handle_uevent), NULL);
+    return shared_udev;
+}
+
 /******************************************************************************/
 
 #define WAIT_FOR_DEVICE_TIMEOUT_SECS 120
@@ -458,7 +604,7 @@ typedef struct {
     GUdevClient             *udev;
     gchar                   *sysfs_path;
     guint                    timeout_id;
-    gulong                   uevent_id;
+    gboolean                 subscribed;
     gulong                   cancellable_id;
 } WaitForDeviceContext;
 
@@ -466,7 +612,7 @@ static void
 wait_for_device_context_free (WaitForDeviceContext *ctx)
 {
     g_assert (!ctx->timeout_id);
-    g_assert (!ctx->uevent_id);
+    g_assert (!ctx->subscribed);
     g_assert (!ctx->cancellable_id);
 
     g_object_unref (ctx->udev);
@@ -474,6 +620,46 @@ wait_for_device_context_free (WaitForDeviceContext *ctx)
     g_slice_free (WaitForDeviceContext, ctx);
 }
 
+static void
+wait_for_device_subscribe (GTask *task)
+{
+    WaitForDeviceContext *ctx;
+    GList                *tasks;
+
+    ctx = (WaitForDeviceContext *) g_task_get_task_data (task);
+    g_assert (!ctx->subscribed);
+
+    if (!wait_for_device_subscriptions)
+        wait_for_device_subscriptions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    tasks = g_hash_table_lookup (wait_for_device_subscriptions, ctx->sysfs_path);
+    tasks = g_list_append (tasks, task);
+    g_hash_table_replace (wait_for_device_subscriptions, g_strdup (ctx->sysfs_path), tasks);
+    ctx->subscribed = TRUE;
+}
+
+static void
+wait_for_device_unsubscribe (GTask *task)
+{
+    WaitForDeviceContext *ctx;
+    GList                *tasks;
+
+    ctx = (WaitForDeviceContext *) g_task_get_task_data (task);
+    g_assert (ctx->subscribed);
+    g_assert (wait_for_device_subscriptions);
+
+    tasks = g_hash_table_lookup (wait_for_device_subscriptions, ctx->sysfs_path);
+    tasks = g_list_remove (tasks, task);
+    if (tasks)
+        g_hash_table_replace (wait_for_device_subscriptions, g_strdup (ctx->sysfs_path), tasks);
+    else
+        g_hash_table_remove (wait_for_device_subscriptions, ctx->sysfs_path);
+    ctx->subscribed = FALSE;
+
+    if (!g_hash_table_size (wait_for_device_subscriptions))
+        g_clear_pointer (&wait_for_device_subscriptions, g_hash_table_unref);
+}
+
 GFile *
 qfu_udev_helper_wait_for_device_finish (GAsyncResult  *res,
                                         GError       **error)
@@ -482,30 +668,19 @@ qfu_udev_helper_wait_for_device_finish (GAsyncResult  *res,
 }
 
 static void
-handle_uevent (GUdevClient *client,
-               const char  *action,
-               GUdevDevice *device,
-               GTask       *task)
+wait_for_device_matched (GTask       *task,
+                         GUdevDevice *device)
 {
     WaitForDeviceContext *ctx;
-    GFile                *file;
 
     ctx = (WaitForDeviceContext *) g_task_get_task_data (task);
 
-    if (!g_str_equal (action, "add") && !g_str_equal (action, "move") && !g_str_equal (action, "change"))
-        return;
-
-    file = device_matches_sysfs_and_type (device, ctx->sysfs_path, ctx->device_type);
-    if (!file)
-        return;
-
     g_debug ("[qfu-udev] waiting device (%s) matched: %s",
              qfu_udev_helper_device_type_to_string (ctx->device_type),
              g_udev_device_get_name (device));
 
-    /* Disconnect this handler */
-    g_signal_handler_disconnect (ctx->udev, ctx->uevent_id);
-    ctx->uevent_id = 0;
+    /* Unsubscribe */
+    wait_for_device_unsubscribe (task);
 
     /* Disconnect the other handlers */
     g_cancellable_disconnect (g_task_get_cancellable (task), ctx->cancellable_id);
@@ -513,10 +688,63 @@ handle_uevent (GUdevClient *client,
     g_source_remove (ctx->timeout_id);
     ctx->timeout_id = 0;
 
-    g_task_return_pointer (task, file, g_object_unref);
+    g_task_return_pointer (task, device_file_new (device), g_object_unref);
     g_object_unref (task);
 }
 
+static void
+handle_uevent (GUdevClient *client,
+               const char  *action,
+               GUdevDevice *device,
+               gpointer     user_data)
+{
+    GList *tasks;
+    GList *l;
+    gchar *sysfs_path = NULL;
+    gchar *driver = NULL;
+
+    g_debug ("[qfu-udev] event: %s %s", action, g_udev_device_get_name (device));
+
+    if (!wait_for_device_subscriptions)
+        return;
+
+    if (!g_str_equal (action, "add") && !g_str_equal (action, "move") && !g_str_equal (action, "change"))
+        return;
+
+    /* Only the ports exposed by the modem are waited for */
+    if (g_strcmp0 (g_udev_device_get_subsystem (device), "tty") != 0 &&
+        g_strcmp0 (g_udev_device_get_subsystem (device), "usbmisc") != 0 &&
+        g_strcmp0 (g_udev_device_get_subsystem (device), "usb") != 0)
+        return;
+
+    if (!udev_helper_get_udev_device_details (device,
+                                              &sysfs_path, NULL, NULL, NULL, NULL,
+                                              NULL))
+        goto out;
+
+    tasks = g_hash_table_lookup (wait_for_device_subscriptions, sysfs_path);
+    if (!tasks)
+        goto out;
+
+    if (!udev_helper_get_udev_interface_details (device, &driver, NULL, NULL))
+        goto out;
+
+    /* Completing a wait unsubscribes it, so iterate a copy of the list */
+    tasks = g_list_copy (tasks);
+    for (l = tasks; l; l = g_list_next (l)) {
+        WaitForDeviceContext *ctx;
+
+        ctx = (WaitForDeviceContext *) g_task_get_task_data (G_TASK (l->data));
+        if (device_type_matches_driver (ctx->device_type, driver))
+            wait_for_device_matched (G_TASK (l->data), device);
+    }
+    g_list_free (tasks);
+
+out:
+    g_free (sysfs_path);
+    g_free (driver);
+}
+
 static gboolean
 wait_for_device_timed_out (GTask *task)
 {
@@ -530,8 +758,7 @@ wait_for_device_timed_out (GTask *task)
     /* Disconnect the other handlers */
     g_cancellable_disconnect (g_task_get_cancellable (task), ctx->cancellable_id);
     ctx->cancellable_id = 0;
-    g_signal_handler_disconnect (ctx->udev, ctx->uevent_id);
-    ctx->uevent_id = 0;
+    wait_for_device_unsubscribe (task);
 
     g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
                              "waiting for device at '%s' timed out",
@@ -555,8 +782,7 @@ wait_for_device_cancelled (GCancellable *cancellable,
     /* Disconnect the other handlers */
     g_source_remove (ctx->timeout_id);
     ctx->timeout_id = 0;
-    g_signal_handler_disconnect (ctx->udev, ctx->uevent_id);
-    ctx->uevent_id = 0;
+    wait_for_device_unsubscribe (task);
 
     g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_CANCELLED,
                              "waiting for device at '%s' cancelled",
@@ -574,25 +800,18 @@ qfu_udev_helper_wait_for_device (QfuUdevHelperDeviceType  device_type,
     GTask                *task;
     WaitForDeviceContext *ctx;
 
+    g_assert (device_type == QFU_UDEV_HELPER_DEVICE_TYPE_TTY || device_type == QFU_UDEV_HELPER_DEVICE_TYPE_CDC_WDM);
+
     ctx = g_slice_new0 (WaitForDeviceContext);
     ctx->device_type = device_type;
     ctx->sysfs_path = g_strdup (sysfs_path);
-
-    if (ctx->device_type == QFU_UDEV_HELPER_DEVICE_TYPE_TTY)
-        ctx->udev = g_udev_client_new (tty_subsys_list);
-    else if (ctx->device_type == QFU_UDEV_HELPER_DEVICE_TYPE_CDC_WDM)
-        ctx->udev = g_udev_client_new (cdc_wdm_subsys_list);
-    else
-        g_assert_not_reached ();
+    ctx->udev = shared_udev_get ();
 
     task = g_task_new (NULL, cancellable, callback, user_data);
     g_task_set_task_data (task, ctx, (GDestroyNotify) wait_for_device_context_free);
 
     /* Monitor for device additions. */
-    ctx->uevent_id = g_signal_connect (ctx->udev,
-                                       "uevent",
-                                       G_CALLBACK (handle_uevent),
-                                       task);
+    wait_for_device_subscribe (task);
 
     /* Allow cancellation */
     ctx->cancellable_id = g_cancellable_connect (cancellable,
@@ -605,7 +824,7 @@ qfu_udev_helper_wait_for_device (QfuUdevHelperDeviceType  device_type,
                                              (GSourceFunc) wait_for_device_timed_out,
                                              task);
 
-    /* Note: task ownership is shared between the signals and the timeout */
+    /* Note: task ownership is shared between the subscription and the timeout */
 }
 
 /******************************************************************************/
@@ -621,31 +840,14 @@ qfu_udev_helper_generic_monitor_free (QfuUdevHelperGenericMonitor *self)
     g_slice_free (QfuUdevHelperGenericMonitor, self);
 }
 
-static void
-handle_uevent_generic (GUdevClient *client,
-                       const char  *action,
-                       GUdevDevice *device,
-                       GTask       *task)
-{
-    g_debug ("[qfu-udev] event: %s %s", action, g_udev_device_get_name (device));
-}
-
 QfuUdevHelperGenericMonitor *
 qfu_udev_helper_generic_monitor_new (const gchar *sysfs_path)
 {
-    static const gchar *all_list[] = {
-        "usbmisc", "usb",
-        "tty",
-        "net",
-        NULL };
-
     QfuUdevHelperGenericMonitor *self;
 
+    /* All events are logged by the shared monitor */
     self = g_slice_new0 (QfuUdevHelperGenericMonitor);
-    self->udev = g_udev_client_new (all_list);
-
-    /* Monitor for device events. */
-    g_signal_connect (self->udev, "uevent", G_CALLBACK (handle_uevent_generic), NULL);
+    self->udev = shared_udev_get ();
     return self;
 }
 
@@ -48,6 +48,14 @@ gchar *qfu_udev_helper_find_by_device_info   (guint16       vid,
                                               guint         devnum,
                                               GError      **error);
 
+GFile *qfu_udev_helper_find_usbfs_by_file  (GFile        *file,
+                                            guint8       *interface_number,
+                                            GError      **error);
+
+gboolean qfu_udev_helper_get_usb_ids         (const gchar  *sysfs_path,
+                                              guint16      *vid,
+                                              guint16      *pid);
+
 GList *qfu_udev_helper_list_devices           (QfuUdevHelperDeviceType   device_type,
                                                const gchar              *sysfs_path);
 
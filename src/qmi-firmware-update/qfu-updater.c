@@ -27,7 +27,7 @@
 #include <libqmi-glib.h>
 
 #include "qfu-log.h"
-#include "qfu-image-factory.h"
+#include "qfu-image.h"
 #include "qfu-updater.h"
 #include "qfu-reseter.h"
 #include "qfu-utils.h"
@@ -50,6 +50,10 @@ typedef enum {
 struct _QfuUpdaterPrivate {
     UpdaterType         type;
     QfuDeviceSelection *device_selection;
+    gchar              *label;
+    guint8              qdl_window_size;
+    gsize               qdl_chunk_size;
+    gboolean            qdl_usb;
 #if defined WITH_UDEV
     gchar              *firmware_version;
     gchar              *config_version;
@@ -77,6 +81,62 @@ static const gchar *progress[] = {
     "(-*----)"
 };
 
+/******************************************************************************/
+
+static void updater_print (QfuUpdater  *self,
+                           const gchar *format,
+                           ...) G_GNUC_PRINTF (2, 3);
+
+static void
+updater_print (QfuUpdater  *self,
+               const gchar *format,
+               ...)
+{
+    va_list   args;
+    gchar    *str;
+    gchar   **lines;
+    GString  *output;
+    guint     i;
+
+    va_start (args, format);
+    str = g_strdup_vprintf (format, args);
+    va_end (args);
+
+    if (!self->priv->label) {
+        g_print ("%s", str);
+        g_free (str);
+        return;
+    }
+
+    /* Prefix every line with the device label, and print them all at once so
+     * that they aren't mixed with the output of other updaters */
+    output = g_string_new (NULL);
+    lines = g_strsplit (str, "\n", -1);
+    for (i = 0; lines[i]; i++) {
+        if (lines[i][0])
+            g_string_append_printf (output, "[%s] %s\n", self->priv->label, lines[i]);
+    }
+    g_print ("%s", output->str);
+
+    g_string_free (output, TRUE);
+    g_strfreev (lines);
+    g_free (str);
+}
+
+/* Progress animations redraw the current line, so they're only shown when
+ * there is a single updater printing to stdout */
+static gboolean
+updater_show_progress (QfuUpdater *self)
+{
+    return (!self->priv->label && !qfu_log_get_verbose_stdout ());
+}
+
+static gint
+image_sort_by_size (QfuImage *a, QfuImage *b)
+{
+    return qfu_image_get_size (b) - qfu_image_get_size (a);
+}
+
 /******************************************************************************/
 /* Run */
 
@@ -84,6 +144,14 @@ static const gchar *progress[] = {
 #define WAIT_FOR_BOOT_TIMEOUT_SECS 5
 #define WAIT_FOR_BOOT_RETRIES      12
 
+/* Window size requested when none given, if the device accepts it */
+#define QDL_AUTO_WINDOW_SIZE 8
+
+/* Retries after losing the QDL session in the middle of a download, and the
+ * time given to the device to drop the serial port, if it's going to */
+#define QDL_DOWNLOAD_RETRIES          3
+#define QDL_DOWNLOAD_RETRY_DELAY_SECS 2
+
 typedef enum {
 #if defined WITH_UDEV
     RUN_CONTEXT_STEP_QMI_CLIENT,
@@ -122,6 +190,7 @@ typedef struct {
     gchar                                    *revision;
     gboolean                                  supports_stored_image_management;
     guint8                                    max_modem_storage_index;
+    QmiMessageDmsListStoredImagesOutput      *stored_images;
     gboolean                                  supports_firmware_preference_management;
     QmiMessageDmsGetFirmwarePreferenceOutput *firmware_preference;
     QmiMessageDmsSwiGetCurrentFirmwareOutput *current_firmware;
@@ -137,7 +206,17 @@ typedef struct {
     GList    *pending_images;
     QfuImage *current_image;
 
+    /* Image integrity checks, run while the device is being prepared */
+    guint     n_images_checking;
+    GError   *images_error;
+    gboolean  images_waiting;
+
 #if defined WITH_UDEV
+    /* Images not downloaded because the device already stores their contents;
+     * kept around in case the device asks for them anyway. */
+    GList    *skipped_images;
+    gboolean  already_installed;
+
     /* QMI device and client */
     QmiDevice    *qmi_device;
     QmiClientDms *qmi_client;
@@ -157,6 +236,16 @@ typedef struct {
 
     /* QDL device */
     QfuQdlDevice *qdl_device;
+
+    /* Download of the current image */
+    GTimer   *download_timer;
+    guint8    download_window_size;
+    guint     download_n_tenths_reported;
+    gboolean  download_finalizing;
+
+    /* Download retries, and chunks acknowledged in order in the last try */
+    guint   download_retries;
+    guint16 download_n_acked;
 } RunContext;
 
 static void
@@ -171,6 +260,9 @@ run_context_free (RunContext *ctx)
         qmi_message_dms_get_firmware_preference_output_unref (ctx->firmware_preference);
     if (ctx->new_firmware_preference)
         qmi_message_dms_get_firmware_preference_output_unref (ctx->new_firmware_preference);
+    if (ctx->stored_images)
+        qmi_message_dms_list_stored_images_output_unref (ctx->stored_images);
+    g_list_free_full (ctx->skipped_images, g_object_unref);
     g_free (ctx->new_revision);
     g_free (ctx->revision);
     g_free (ctx->firmware_version);
@@ -196,13 +288,18 @@ run_context_free (RunContext *ctx)
 #endif
 
     if (ctx->qdl_device)
-        g_object_unref (&ctx->qdl_device);
+        g_object_unref (ctx->qdl_device);
     if (ctx->serial_file)
         g_object_unref (ctx->serial_file);
 
     if (ctx->current_image)
         g_object_unref (ctx->current_image);
     g_list_free_full (ctx->pending_images, g_object_unref);
+    if (ctx->images_error)
+        g_error_free (ctx->images_error);
+
+    if (ctx->download_timer)
+        g_timer_destroy (ctx->download_timer);
 
     g_slice_free (RunContext, ctx);
 }
@@ -218,7 +315,8 @@ qfu_updater_run_finish (QfuUpdater    *self,
 #if defined WITH_UDEV
 
 static void
-print_firmware_preference (QmiMessageDmsGetFirmwarePreferenceOutput *firmware_preference,
+print_firmware_preference (QfuUpdater                               *self,
+                           QmiMessageDmsGetFirmwarePreferenceOutput *firmware_preference,
                            const gchar                              *prefix)
 {
     GArray *array;
@@ -233,11 +331,11 @@ print_firmware_preference (QmiMessageDmsGetFirmwarePreferenceOutput *firmware_pr
 
             image = &g_array_index (array, QmiMessageDmsGetFirmwarePreferenceOutputListImage, i);
             unique_id_str = qfu_utils_get_firmware_image_unique_id_printable (image->unique_id);
-            g_print ("%simage '%s': unique id '%s', build id '%s'\n",
-                     prefix,
-                     qmi_dms_firmware_image_type_get_string (image->type),
-                     unique_id_str,
-                     image->build_id);
+            updater_print (self, "%simage '%s': unique id '%s', build id '%s'\n",
+                                 prefix,
+                                 qmi_dms_firmware_image_type_get_string (image->type),
+                                 unique_id_str,
+                                 image->build_id);
             g_free (unique_id_str);
         }
     } else
@@ -245,7 +343,8 @@ print_firmware_preference (QmiMessageDmsGetFirmwarePreferenceOutput *firmware_pr
 }
 
 static void
-print_current_firmware (QmiMessageDmsSwiGetCurrentFirmwareOutput *current_firmware,
+print_current_firmware (QfuUpdater                               *self,
+                        QmiMessageDmsSwiGetCurrentFirmwareOutput *current_firmware,
                         const gchar                              *prefix)
 {
     const gchar *model = NULL;
@@ -269,19 +368,19 @@ print_current_firmware (QmiMessageDmsSwiGetCurrentFirmwareOutput *current_firmwa
     qmi_message_dms_swi_get_current_firmware_output_get_config_version (current_firmware, &config_version, NULL);
 
     if (model)
-        g_print ("%sModel: %s\n", prefix, model);
+        updater_print (self, "%sModel: %s\n", prefix, model);
     if (boot_version)
-        g_print ("%sBoot version: %s\n", prefix, boot_version);
+        updater_print (self, "%sBoot version: %s\n", prefix, boot_version);
     if (amss_version)
-        g_print ("%sAMSS version: %s\n", prefix, amss_version);
+        updater_print (self, "%sAMSS version: %s\n", prefix, amss_version);
     if (sku_id)
-        g_print ("%sSKU ID: %s\n", prefix, sku_id);
+        updater_print (self, "%sSKU ID: %s\n", prefix, sku_id);
     if (package_id)
-        g_print ("%sPackage ID: %s\n", prefix, package_id);
+        updater_print (self, "%sPackage ID: %s\n", prefix, package_id);
     if (carrier_id)
-        g_print ("%sCarrier ID: %s\n", prefix, carrier_id);
+        updater_print (self, "%sCarrier ID: %s\n", prefix, carrier_id);
     if (config_version)
-        g_print ("%sConfig version: %s\n", prefix, config_version);
+        updater_print (self, "%sConfig version: %s\n", prefix, config_version);
 }
 
 #endif /* WITH_UDEV */
@@ -305,51 +404,58 @@ run_context_step_last (GTask *task)
 
 #if defined WITH_UDEV
     if (self->priv->type == UPDATER_TYPE_GENERIC) {
-        g_print ("\n"
-                 "------------------------------------------------------------------------\n");
+        if (ctx->already_installed) {
+            updater_print (self, "device already running the given firmware/config version: nothing to do\n");
+            g_task_return_boolean (task, TRUE);
+            g_object_unref (task);
+            return;
+        }
 
-        g_print ("\n"
-                 "   original firmware revision was:\n"
-                 "      %s\n", ctx->revision ? ctx->revision : "unknown");
+        updater_print (self, "\n"
+                             "------------------------------------------------------------------------\n");
+
+        updater_print (self, "\n"
+                             "   original firmware revision was:\n"
+                             "      %s\n", ctx->revision ? ctx->revision : "unknown");
         if (ctx->current_firmware) {
-            g_print ("   original running firmware details:\n");
-            print_current_firmware (ctx->current_firmware, "      ");
+            updater_print (self, "   original running firmware details:\n");
+            print_current_firmware (self, ctx->current_firmware, "      ");
         }
         if (ctx->firmware_preference) {
-            g_print ("   original firmware preference details:\n");
-            print_firmware_preference (ctx->firmware_preference, "      ");
+            updater_print (self, "   original firmware preference details:\n");
+            print_firmware_preference (self, ctx->firmware_preference, "      ");
         }
 
-        g_print ("\n"
-                 "   new firmware revision is:\n"
-                 "      %s\n", ctx->new_revision ? ctx->new_revision : "unknown");
+        updater_print (self, "\n"
+                             "   new firmware revision is:\n"
+                             "      %s\n", ctx->new_revision ? ctx->new_revision : "unknown");
         if (ctx->new_current_firmware) {
-            g_print ("   new running firmware details:\n");
-            print_current_firmware (ctx->new_current_firmware, "      ");
+            updater_print (self, "   new running firmware details:\n");
+            print_current_firmware (self, ctx->new_current_firmware, "      ");
         }
         if (ctx->new_firmware_preference) {
-            g_print ("   new firmware preference details:\n");
-            print_firmware_preference (ctx->new_firmware_preference, "      ");
+            updater_print (self, "   new firmware preference details:\n");
+            print_firmware_preference (self, ctx->new_firmware_preference, "      ");
         }
 
         if (ctx->new_supports_stored_image_management)
-            g_print ("\n"
-                     "   NOTE: this device supports stored image management\n"
-                     "   with qmicli operations:\n"
-                     "      --dms-list-stored-images\n"
-                     "      --dms-select-stored-image\n"
-                     "      --dms-delete-stored-image\n");
+            updater_print (self, "\n"
+                                 "   NOTE: this device supports stored image management\n"
+                                 "   with qmicli operations:\n"
+                                 "      --dms-list-stored-images\n"
+                                 "      --dms-select-stored-image\n"
+                                 "      --dms-delete-stored-image\n");
 
         if (ctx->new_supports_firmware_preference_management)
-            g_print ("\n"
-                     "   NOTE: this device supports firmware preference management\n"
-                     "   with qmicli operations:\n"
-                     "      --dms-get-firmware-preference\n"
-                     "      --dms-set-firmware-preference\n");
+            updater_print (self, "\n"
+                                 "   NOTE: this device supports firmware preference management\n"
+                                 "   with qmicli operations:\n"
+                                 "      --dms-get-firmware-preference\n"
+                                 "      --dms-set-firmware-preference\n");
 
-        g_print ("\n"
-                 "------------------------------------------------------------------------\n"
-                 "\n");
+        updater_print (self, "\n"
+                             "------------------------------------------------------------------------\n"
+                             "\n");
 
         g_task_return_boolean (task, TRUE);
         g_object_unref (task);
@@ -381,6 +487,64 @@ run_context_step_next (GTask *task, RunContextStep next)
     g_idle_add ((GSourceFunc) run_context_step_cb, task);
 }
 
+static void
+image_check_integrity_ready (QfuImage     *image,
+                             GAsyncResult *res,
+                             GTask        *task)
+{
+    RunContext *ctx;
+    GError     *error = NULL;
+
+    ctx = (RunContext *) g_task_get_task_data (task);
+
+    if (!qfu_image_check_integrity_finish (image, res, &error)) {
+        if (!ctx->images_error) {
+            g_prefix_error (&error, "invalid image '%s': ", qfu_image_get_display_name (image));
+            ctx->images_error = error;
+        } else
+            g_error_free (error);
+    }
+
+    g_assert (ctx->n_images_checking > 0);
+    ctx->n_images_checking--;
+
+    /* Resume the step that was waiting for the checks */
+    if (!ctx->n_images_checking && ctx->images_waiting) {
+        g_debug ("[qfu-updater] image integrity checks finished");
+        ctx->images_waiting = FALSE;
+        run_context_step (task);
+    }
+
+    g_object_unref (task);
+}
+
+/* The integrity of the images is checked while talking to the device, but it
+ * must be known before changing anything in it: so that a corrupted image
+ * doesn't leave the device in download mode. Returns TRUE if the step may go
+ * on; otherwise the step is run again once the checks finish, or the task
+ * has been completed with an error. */
+static gboolean
+run_context_images_checked (GTask *task)
+{
+    RunContext *ctx;
+
+    ctx = (RunContext *) g_task_get_task_data (task);
+
+    if (ctx->n_images_checking) {
+        g_debug ("[qfu-updater] waiting for %u image integrity checks...", ctx->n_images_checking);
+        ctx->images_waiting = TRUE;
+        return FALSE;
+    }
+
+    if (ctx->images_error) {
+        g_task_return_error (task, g_error_copy (ctx->images_error));
+        g_object_unref (task);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 #if defined WITH_UDEV
 
 static void
@@ -476,6 +640,7 @@ new_client_dms_after_ready (gpointer      unused,
                                           &ctx->new_revision,
                                           &ctx->new_supports_stored_image_management,
                                           NULL, /* we don't care about the max number of images */
+                                          NULL, /* we don't care about the stored images */
                                           &ctx->new_supports_firmware_preference_management,
                                           &ctx->new_firmware_preference,
                                           &ctx->new_current_firmware,
@@ -505,8 +670,8 @@ run_context_step_qmi_client_after (GTask *task)
     self = g_task_get_source_object (task);
 
     ctx->wait_for_boot_retries++;
-    g_print ("loading device information after the update (%u/%u)...\n",
-             ctx->wait_for_boot_retries, WAIT_FOR_BOOT_RETRIES);
+    updater_print (self, "loading device information after the update (%u/%u)...\n",
+                         ctx->wait_for_boot_retries, WAIT_FOR_BOOT_RETRIES);
 
     g_debug ("[qfu-updater] creating QMI DMS client after upgrade...");
     g_assert (ctx->cdc_wdm_file);
@@ -523,19 +688,21 @@ static gboolean
 wait_for_boot_ready (GTask *task)
 {
     RunContext *ctx;
+    QfuUpdater *self;
 
     ctx = (RunContext *) g_task_get_task_data (task);
+    self = g_task_get_source_object (task);
     ctx->wait_for_boot_seconds_elapsed++;
 
     if (ctx->wait_for_boot_seconds_elapsed < WAIT_FOR_BOOT_TIMEOUT_SECS) {
-        if (!qfu_log_get_verbose_stdout ())
+        if (updater_show_progress (self))
             g_print (CLEAR_LINE "%s %u",
                      progress[ctx->wait_for_boot_seconds_elapsed % G_N_ELEMENTS (progress)],
                      WAIT_FOR_BOOT_TIMEOUT_SECS - ctx->wait_for_boot_seconds_elapsed);
         return G_SOURCE_CONTINUE;
     }
 
-    if (!qfu_log_get_verbose_stdout ())
+    if (updater_show_progress (self))
         g_print (CLEAR_LINE);
 
     /* Go on */
@@ -547,17 +714,19 @@ static void
 run_context_step_wait_for_boot (GTask *task)
 {
     RunContext *ctx;
+    QfuUpdater *self;
 
     ctx = (RunContext *) g_task_get_task_data (task);
+    self = g_task_get_source_object (task);
     ctx->wait_for_boot_seconds_elapsed = 0;
 
     g_debug ("[qfu-updater] waiting some time (%us) before accessing the cdc-wdm device...",
              WAIT_FOR_BOOT_TIMEOUT_SECS);
 
-    if (!qfu_log_get_verbose_stdout ()) {
-        g_print ("waiting some time for the device to boot...\n");
+    if (!qfu_log_get_verbose_stdout ())
+        updater_print (self, "waiting some time for the device to boot...\n");
+    if (updater_show_progress (self))
         g_print ("%s %u", progress[0], WAIT_FOR_BOOT_TIMEOUT_SECS);
-    }
 
     g_timeout_add_seconds (1, (GSourceFunc) wait_for_boot_ready, task);
 }
@@ -588,7 +757,7 @@ wait_for_cdc_wdm_ready (QfuDeviceSelection *device_selection,
     g_debug ("[qfu-updater] cdc-wdm device found: %s", path);
     g_free (path);
 
-    g_print ("normal mode detected\n");
+    updater_print (self, "normal mode detected\n");
 
     /* If no need to validate, we're done */
     if (self->priv->skip_validation) {
@@ -596,13 +765,13 @@ wait_for_cdc_wdm_ready (QfuDeviceSelection *device_selection,
         return;
     }
 
-    g_print ("\n"
-             "------------------------------------------------------------------------\n"
-             "    NOTE: in order to validate which is the firmware running in the\n"
-             "    module, the program will wait for a complete boot; this process\n"
-             "    may take some time and several retries.\n"
-             "------------------------------------------------------------------------\n"
-             "\n");
+    updater_print (self, "\n"
+                         "------------------------------------------------------------------------\n"
+                         "    NOTE: in order to validate which is the firmware running in the\n"
+                         "    module, the program will wait for a complete boot; this process\n"
+                         "    may take some time and several retries.\n"
+                         "------------------------------------------------------------------------\n"
+                         "\n");
 
     /* Go on */
     run_context_step_next (task, ctx->step + 1);
@@ -626,23 +795,26 @@ run_context_step_wait_for_cdc_wdm (GTask *task)
 #endif /* WITH_UDEV */
 
 static void
-run_context_step_cleanup_qdl_device (GTask *task)
+qdl_device_reset_ready (QfuQdlDevice *qdl_device,
+                        GAsyncResult *res,
+                        GTask        *task)
 {
     RunContext *ctx;
     QfuUpdater *self;
+    GError     *error = NULL;
 
     ctx = (RunContext *) g_task_get_task_data (task);
     self = g_task_get_source_object (task);
 
-    g_assert (ctx->qdl_device);
-    g_assert (ctx->serial_file);
-
-    g_debug ("[qfu-updater] QDL reset");
-    qfu_qdl_device_reset (ctx->qdl_device, g_task_get_cancellable (task), NULL);
+    /* The device may go away before replying, so errors are not fatal */
+    if (!qfu_qdl_device_reset_finish (qdl_device, res, &error)) {
+        g_debug ("[qfu-updater] QDL reset failed: %s", error->message);
+        g_error_free (error);
+    }
     g_clear_object (&ctx->qdl_device);
     g_clear_object (&ctx->serial_file);
 
-    g_print ("rebooting in normal mode...\n");
+    updater_print (self, "rebooting in normal mode...\n");
 
     /* If we were running in QDL mode, we don't even wait for the reboot to finish */
     if (self->priv->type == UPDATER_TYPE_QDL) {
@@ -653,6 +825,23 @@ run_context_step_cleanup_qdl_device (GTask *task)
     run_context_step_next (task, ctx->step + 1);
 }
 
+static void
+run_context_step_cleanup_qdl_device (GTask *task)
+{
+    RunContext *ctx;
+
+    ctx = (RunContext *) g_task_get_task_data (task);
+
+    g_assert (ctx->qdl_device);
+    g_assert (ctx->serial_file);
+
+    g_debug ("[qfu-updater] QDL reset");
+    qfu_qdl_device_reset_async (ctx->qdl_device,
+                                g_task_get_cancellable (task),
+                                (GAsyncReadyCallback) qdl_device_reset_ready,
+                                task);
+}
+
 static void
 run_context_step_cleanup_image (GTask *task)
 {
@@ -674,85 +863,306 @@ run_context_step_cleanup_image (GTask *task)
     run_context_step_next (task, ctx->step + 1);
 }
 
+#if defined WITH_UDEV
+
 static void
-run_context_step_download_image (GTask *task)
+download_retry_wait_for_tty_ready (QfuDeviceSelection *device_selection,
+                                   GAsyncResult       *res,
+                                   GTask              *task)
 {
-    RunContext   *ctx;
-    guint16       sequence;
-    guint16       n_chunks;
-    GError       *error = NULL;
-    GCancellable *cancellable;
-    GTimer       *timer;
-    gdouble       elapsed;
-    gchar        *aux;
+    GError     *error = NULL;
+    RunContext *ctx;
 
     ctx = (RunContext *) g_task_get_task_data (task);
-    cancellable = g_task_get_cancellable (task);
 
-    timer = g_timer_new ();
+    g_assert (!ctx->serial_file);
+    ctx->serial_file = qfu_device_selection_wait_for_tty_finish (device_selection, res, &error);
+    if (!ctx->serial_file) {
+        g_prefix_error (&error, "error waiting for TTY to retry download: ");
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
 
-    aux = g_format_size ((guint64) qfu_image_get_size (ctx->current_image));
-    g_print ("downloading %s image: %s (%s)...\n",
-             qfu_image_type_get_string (qfu_image_get_image_type (ctx->current_image)),
-             qfu_image_get_display_name (ctx->current_image),
-             aux);
+    run_context_step_next (task, RUN_CONTEXT_STEP_QDL_DEVICE);
+}
+
+#endif
+
+static gboolean
+download_retry_delay_ready (GTask *task)
+{
+    RunContext *ctx;
+    QfuUpdater *self;
+
+    ctx = (RunContext *) g_task_get_task_data (task);
+    self = g_task_get_source_object (task);
+
+    /* If the serial port is still around, just reopen it */
+    g_assert (!ctx->serial_file);
+    ctx->serial_file = qfu_device_selection_get_single_tty (self->priv->device_selection);
+    if (ctx->serial_file) {
+        run_context_step_next (task, RUN_CONTEXT_STEP_QDL_DEVICE);
+        return G_SOURCE_REMOVE;
+    }
+
+#if defined WITH_UDEV
+    /* Otherwise, wait for the device to be back in download mode */
+    g_debug ("[qfu-updater] TTY device gone, waiting for it to come back...");
+    qfu_device_selection_wait_for_tty (self->priv->device_selection,
+                                       g_task_get_cancellable (task),
+                                       (GAsyncReadyCallback) download_retry_wait_for_tty_ready,
+                                       task);
+#else
+    g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                             "No serial device found to retry download");
+    g_object_unref (task);
+#endif
+    return G_SOURCE_REMOVE;
+}
+
+/* Schedules a new try of the current download, if the QDL session was lost.
+ * The protocol doesn't allow resuming a session, as a new one always starts
+ * with the first chunk of the image, so the current image is sent again;
+ * images already downloaded aren't, and the device isn't reset again. */
+static gboolean
+download_retry (GTask  *task,
+                GError *error)
+{
+    RunContext *ctx;
+    QfuUpdater *self;
+
+    ctx = (RunContext *) g_task_get_task_data (task);
+    self = g_task_get_source_object (task);
+
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) || ctx->download_retries >= QDL_DOWNLOAD_RETRIES)
+        return FALSE;
+    ctx->download_retries++;
+
+    if (ctx->current_image && ctx->qdl_device)
+        updater_print (self, "download interrupted after %u/%u chunks: %s\n",
+                             ctx->download_n_acked,
+                             qfu_image_get_n_data_chunks (ctx->current_image, qfu_qdl_device_get_chunk_size (ctx->qdl_device)),
+                             error->message);
+    else
+        updater_print (self, "download interrupted: %s\n", error->message);
+    updater_print (self, "retrying download (%u/%u)...\n", ctx->download_retries, QDL_DOWNLOAD_RETRIES);
+
+    g_clear_object (&ctx->qdl_device);
+    g_clear_object (&ctx->serial_file);
+    if (ctx->current_image) {
+        ctx->pending_images = g_list_prepend (ctx->pending_images, ctx->current_image);
+        ctx->current_image = NULL;
+    }
+    ctx->download_n_acked = 0;
+
+    g_timeout_add_seconds (QDL_DOWNLOAD_RETRY_DELAY_SECS, (GSourceFunc) download_retry_delay_ready, task);
+    return TRUE;
+}
+
+static void
+download_image_failed (GTask  *task,
+                       GError *error)
+{
+    if (download_retry (task, error)) {
+        g_error_free (error);
+        return;
+    }
+
+    g_prefix_error (&error, "error downloading image: ");
+    g_task_return_error (task, error);
+    g_object_unref (task);
+}
+
+static void
+qdl_device_ufclose_ready (QfuQdlDevice *qdl_device,
+                          GAsyncResult *res,
+                          GTask        *task)
+{
+    RunContext *ctx;
+    QfuUpdater *self;
+    GError     *error = NULL;
+    gdouble     elapsed;
+    gchar      *aux;
+
+    ctx = (RunContext *) g_task_get_task_data (task);
+    self = g_task_get_source_object (task);
+
+    if (!qfu_qdl_device_ufclose_finish (qdl_device, res, &error)) {
+        g_prefix_error (&error, "couldn't close session: ");
+        download_image_failed (task, error);
+        return;
+    }
+
+    elapsed = g_timer_elapsed (ctx->download_timer, NULL);
+    aux = g_format_size ((guint64) ((qfu_image_get_size (ctx->current_image)) / elapsed));
+    updater_print (self, "successfully downloaded in %.2lfs (%s/s)\n", elapsed, aux);
     g_free (aux);
 
-    if (!qfu_qdl_device_hello (ctx->qdl_device, cancellable, &error)) {
-        g_prefix_error (&error, "couldn't send greetings to device: ");
-        goto out;
+    /* Go on */
+    run_context_step_next (task, ctx->step + 1);
+}
+
+static void
+qdl_device_ufwrite_ready (QfuQdlDevice *qdl_device,
+                          GAsyncResult *res,
+                          GTask        *task)
+{
+    RunContext *ctx;
+    QfuUpdater *self;
+    GError     *error = NULL;
+
+    ctx = (RunContext *) g_task_get_task_data (task);
+    self = g_task_get_source_object (task);
+
+    if (!qfu_qdl_device_ufwrite_finish (qdl_device, res, &ctx->download_n_acked, &error)) {
+        g_prefix_error (&error, "couldn't write in session: ");
+        download_image_failed (task, error);
+        return;
     }
 
-    if (!qfu_qdl_device_ufopen (ctx->qdl_device, ctx->current_image, cancellable, &error)) {
-        g_prefix_error (&error, "couldn't open session: ");
-        goto out;
+    if (updater_show_progress (self))
+        g_print (CLEAR_LINE);
+
+    qfu_qdl_device_ufclose_async (ctx->qdl_device,
+                                  g_task_get_cancellable (task),
+                                  (GAsyncReadyCallback) qdl_device_ufclose_ready,
+                                  task);
+}
+
+static void
+qdl_device_ufwrite_progress (QfuQdlDevice *qdl_device,
+                             guint16       n_sent,
+                             guint16       n_acked,
+                             guint16       n_chunks,
+                             GTask        *task)
+{
+    RunContext *ctx;
+    QfuUpdater *self;
+
+    ctx = (RunContext *) g_task_get_task_data (task);
+    self = g_task_get_source_object (task);
+
+    /* The last chunk takes a lot longer, so it's reported on its own */
+    if (n_sent == n_chunks) {
+        if (ctx->download_finalizing)
+            return;
+        ctx->download_finalizing = TRUE;
+        if (updater_show_progress (self))
+            g_print (CLEAR_LINE "finalizing download... (may take more than one minute, be patient)\n");
+        else if (self->priv->label && !qfu_log_get_verbose_stdout ())
+            updater_print (self, "finalizing download... (may take more than one minute, be patient)\n");
+        return;
     }
 
-    n_chunks = qfu_image_get_n_data_chunks (ctx->current_image);
-    for (sequence = 0; sequence < n_chunks; sequence++) {
-        if (!qfu_log_get_verbose_stdout ()) {
-            /* Use n-1 chunks for progress reporting; because the last one will take
-             * a lot longer. */
-            if (n_chunks > 1 && sequence < (n_chunks - 1))
-                g_print (CLEAR_LINE "%s %04.1lf%%",
-                         progress[sequence % G_N_ELEMENTS (progress)],
-                         100.0 * ((gdouble) sequence / (gdouble) (n_chunks - 1)));
-            else if (sequence == (n_chunks - 1))
-                g_print (CLEAR_LINE "finalizing download... (may take more than one minute, be patient)\n");
-        }
-        if (!qfu_qdl_device_ufwrite (ctx->qdl_device, ctx->current_image, sequence, cancellable, &error)) {
-            g_prefix_error (&error, "couldn't write in session: ");
-            goto out;
+    if (updater_show_progress (self)) {
+        /* Use n-1 chunks for progress reporting */
+        g_print (CLEAR_LINE "%s %04.1lf%%",
+                 progress[n_sent % G_N_ELEMENTS (progress)],
+                 100.0 * ((gdouble) n_sent / (gdouble) (n_chunks - 1)));
+    } else if (self->priv->label && !qfu_log_get_verbose_stdout ()) {
+        /* One line every 10% when several updaters share stdout */
+        if ((10 * (guint) n_sent) / n_chunks > ctx->download_n_tenths_reported) {
+            ctx->download_n_tenths_reported = (10 * (guint) n_sent) / n_chunks;
+            updater_print (self, "downloaded %u%%\n", 10 * ctx->download_n_tenths_reported);
         }
     }
+}
 
-    g_debug ("[qfu-updater] all chunks ack-ed");
+static void
+qdl_device_ufopen_ready (QfuQdlDevice *qdl_device,
+                         GAsyncResult *res,
+                         GTask        *task)
+{
+    RunContext *ctx;
+    QfuUpdater *self;
+    GError     *error = NULL;
+    guint8      device_window_size = 0;
 
-    if (!qfu_log_get_verbose_stdout ())
-        g_print (CLEAR_LINE);
+    ctx = (RunContext *) g_task_get_task_data (task);
+    self = g_task_get_source_object (task);
 
-    if (!qfu_qdl_device_ufclose (ctx->qdl_device, cancellable, &error)) {
-        g_prefix_error (&error, "couldn't close session: ");
-        goto out;
+    if (!qfu_qdl_device_ufopen_finish (qdl_device, res, &device_window_size, &error)) {
+        g_prefix_error (&error, "couldn't open session: ");
+        download_image_failed (task, error);
+        return;
     }
 
-out:
-    elapsed = g_timer_elapsed (timer, NULL);
+    /* Unless explicitly requested, don't go over what the device accepts */
+    if (!self->priv->qdl_window_size)
+        ctx->download_window_size = CLAMP (device_window_size, 1, ctx->download_window_size);
+    g_debug ("[qfu-updater] keeping up to %u chunks of %" G_GSIZE_FORMAT " bytes in flight (device window size: %u)",
+             ctx->download_window_size, qfu_qdl_device_get_chunk_size (qdl_device), device_window_size);
+
+    qfu_qdl_device_ufwrite_async (ctx->qdl_device,
+                                  ctx->current_image,
+                                  ctx->download_window_size,
+                                  (QfuQdlDeviceUfwriteProgressFunc) qdl_device_ufwrite_progress,
+                                  task,
+                                  g_task_get_cancellable (task),
+                                  (GAsyncReadyCallback) qdl_device_ufwrite_ready,
+                                  task);
+}
 
-    g_timer_destroy (timer);
+static void
+qdl_device_hello_ready (QfuQdlDevice *qdl_device,
+                        GAsyncResult *res,
+                        GTask        *task)
+{
+    RunContext *ctx;
+    QfuUpdater *self;
+    GError     *error = NULL;
 
-    if (error) {
-        g_prefix_error (&error, "error downloading image: ");
-        g_task_return_error (task, error);
+    ctx = (RunContext *) g_task_get_task_data (task);
+    self = g_task_get_source_object (task);
+
+    if (!qfu_qdl_device_hello_finish (qdl_device, res, &error)) {
+        g_prefix_error (&error, "couldn't send greetings to device: ");
+        download_image_failed (task, error);
         return;
     }
 
-    aux = g_format_size ((guint64) ((qfu_image_get_size (ctx->current_image)) / elapsed));
-    g_print ("successfully downloaded in %.2lfs (%s/s)\n", elapsed, aux);
+    qfu_qdl_device_ufopen_async (ctx->qdl_device,
+                                 ctx->current_image,
+                                 ctx->download_window_size,
+                                 self->priv->qdl_chunk_size,
+                                 g_task_get_cancellable (task),
+                                 (GAsyncReadyCallback) qdl_device_ufopen_ready,
+                                 task);
+}
+
+/* The QDL device runs its operations in its own thread, so the main loop is
+ * left to the other updaters running at the same time, if any */
+static void
+run_context_step_download_image (GTask *task)
+{
+    RunContext *ctx;
+    QfuUpdater *self;
+    gchar      *aux;
+
+    ctx = (RunContext *) g_task_get_task_data (task);
+    self = g_task_get_source_object (task);
+
+    aux = g_format_size ((guint64) qfu_image_get_size (ctx->current_image));
+    updater_print (self, "downloading %s image: %s (%s)...\n",
+                         qfu_image_type_get_string (qfu_image_get_image_type (ctx->current_image)),
+                         qfu_image_get_display_name (ctx->current_image),
+                         aux);
     g_free (aux);
 
-    /* Go on */
-    run_context_step_next (task, ctx->step + 1);
+    if (!ctx->download_timer)
+        ctx->download_timer = g_timer_new ();
+    else
+        g_timer_start (ctx->download_timer);
+    ctx->download_window_size = self->priv->qdl_window_size ? self->priv->qdl_window_size : QDL_AUTO_WINDOW_SIZE;
+    ctx->download_n_tenths_reported = 0;
+    ctx->download_finalizing = FALSE;
+    ctx->download_n_acked = 0;
+
+    qfu_qdl_device_hello_async (ctx->qdl_device,
+                                g_task_get_cancellable (task),
+                                (GAsyncReadyCallback) qdl_device_hello_ready,
+                                task);
 }
 
 static void
@@ -762,6 +1172,9 @@ run_context_step_select_image (GTask *task)
 
     ctx = (RunContext *) g_task_get_task_data (task);
 
+    if (!run_context_images_checked (task))
+        return;
+
     g_assert (!ctx->current_image);
     g_assert (ctx->pending_images);
 
@@ -777,18 +1190,47 @@ run_context_step_select_image (GTask *task)
     run_context_step_next (task, ctx->step + 1);
 }
 
+static QfuQdlDevice *
+qdl_device_new_usb (QfuUpdater    *self,
+                    GFile         *serial_file,
+                    GCancellable  *cancellable,
+                    GError       **error)
+{
+    QfuQdlDevice *qdl_device;
+    GFile        *usbfs_file;
+    guint8        interface_number = 0;
+
+    usbfs_file = qfu_device_selection_get_usbfs_for_tty (self->priv->device_selection, serial_file, &interface_number, error);
+    if (!usbfs_file)
+        return NULL;
+
+    qdl_device = qfu_qdl_device_new_usb (usbfs_file, interface_number, cancellable, error);
+    g_object_unref (usbfs_file);
+    return qdl_device;
+}
+
 static void
 run_context_step_qdl_device (GTask *task)
 {
+    QfuUpdater *self;
     RunContext *ctx;
     GError     *error = NULL;
 
     ctx = (RunContext *) g_task_get_task_data (task);
+    self = g_task_get_source_object (task);
 
     g_assert (ctx->serial_file);
     g_assert (!ctx->qdl_device);
-    ctx->qdl_device = qfu_qdl_device_new (ctx->serial_file, g_task_get_cancellable (task), &error);
+    if (self->priv->qdl_usb)
+        ctx->qdl_device = qdl_device_new_usb (self, ctx->serial_file, g_task_get_cancellable (task), &error);
+    else
+        ctx->qdl_device = qfu_qdl_device_new (ctx->serial_file, g_task_get_cancellable (task), &error);
     if (!ctx->qdl_device) {
+        /* When retrying, the port may still be going away */
+        if (ctx->download_retries > 0 && download_retry (task, error)) {
+            g_error_free (error);
+            return;
+        }
         g_prefix_error (&error, "error creating device: ");
         g_task_return_error (task, error);
         g_object_unref (task);
@@ -807,9 +1249,11 @@ wait_for_tty_ready (QfuDeviceSelection *device_selection,
 {
     GError     *error = NULL;
     RunContext *ctx;
+    QfuUpdater *self;
     gchar      *path;
 
     ctx = (RunContext *) g_task_get_task_data (task);
+    self = g_task_get_source_object (task);
 
     g_assert (!ctx->serial_file);
     ctx->serial_file = qfu_device_selection_wait_for_tty_finish (device_selection, res, &error);
@@ -824,7 +1268,7 @@ wait_for_tty_ready (QfuDeviceSelection *device_selection,
     g_debug ("[qfu-updater] TTY device found: %s", path);
     g_free (path);
 
-    g_print ("download mode detected\n");
+    updater_print (self, "download mode detected\n");
 
     /* Go on */
     run_context_step_next (task, ctx->step + 1);
@@ -837,7 +1281,7 @@ run_context_step_wait_for_tty (GTask *task)
 
     self = g_task_get_source_object (task);
 
-    g_print ("rebooting in download mode...\n");
+    updater_print (self, "rebooting in download mode...\n");
 
     g_debug ("[qfu-updater] reset requested, now waiting for TTY device...");
     qfu_device_selection_wait_for_tty (self->priv->device_selection,
@@ -940,6 +1384,9 @@ run_context_step_power_cycle (GTask *task)
     ctx = (RunContext *) g_task_get_task_data (task);
     self = g_task_get_source_object (task);
 
+    if (!run_context_images_checked (task))
+        return;
+
     g_debug ("[qfu-updater] power cycling...");
     if (!ctx->boothold_reset) {
         qfu_utils_power_cycle (ctx->qmi_client,
@@ -964,18 +1411,179 @@ run_context_step_power_cycle (GTask *task)
     g_object_unref (reseter);
 }
 
+typedef enum {
+    IMAGE_CONTENTS_NONE  = 0,
+    IMAGE_CONTENTS_MODEM = 1 << 0,
+    IMAGE_CONTENTS_PRI   = 1 << 1,
+} ImageContents;
+
+/* Carrier PRI images (.nvu) only carry NVUP partitions; anything else but the
+ * SPKG package headers is considered part of the modem firmware. Images we
+ * can't look into are assumed to have both. */
+static ImageContents
+get_image_contents (QfuImage *image)
+{
+    QfuImageCwe   *cwe;
+    ImageContents  contents = IMAGE_CONTENTS_NONE;
+    guint          n_headers;
+    guint          i;
+
+    if (!QFU_IS_IMAGE_CWE (image))
+        return IMAGE_CONTENTS_MODEM | IMAGE_CONTENTS_PRI;
+
+    cwe = QFU_IMAGE_CWE (image);
+    n_headers = qfu_image_cwe_get_n_embedded_headers (cwe);
+    for (i = 0; i < n_headers; i++) {
+        const gchar *type;
+
+        type = qfu_image_cwe_embedded_header_get_type (cwe, i);
+        if (!g_strcmp0 (type, "NVUP"))
+            contents |= IMAGE_CONTENTS_PRI;
+        else if (g_strcmp0 (type, "SPKG") != 0)
+            contents |= IMAGE_CONTENTS_MODEM;
+    }
+
+    return (contents != IMAGE_CONTENTS_NONE ? contents : (IMAGE_CONTENTS_MODEM | IMAGE_CONTENTS_PRI));
+}
+
+/* Keeps as pending only the images with contents of the given types; the
+ * others are moved to the list of skipped images, from where they may be
+ * recovered by a later selection. */
+static void
+select_pending_images (RunContext *ctx,
+                       gboolean    need_modem,
+                       gboolean    need_pri)
+{
+    GList *all;
+    GList *l;
+
+    all = g_list_concat (ctx->pending_images, ctx->skipped_images);
+    ctx->pending_images = NULL;
+    ctx->skipped_images = NULL;
+
+    for (l = all; l; l = g_list_next (l)) {
+        ImageContents contents;
+
+        contents = get_image_contents (QFU_IMAGE (l->data));
+        if ((need_modem && (contents & IMAGE_CONTENTS_MODEM)) ||
+            (need_pri && (contents & IMAGE_CONTENTS_PRI)))
+            ctx->pending_images = g_list_prepend (ctx->pending_images, l->data);
+        else {
+            g_debug ("[qfu-updater] skipping image '%s': contents already stored in the device",
+                     qfu_image_get_display_name (QFU_IMAGE (l->data)));
+            ctx->skipped_images = g_list_prepend (ctx->skipped_images, l->data);
+        }
+    }
+    g_list_free (all);
+
+    ctx->pending_images = g_list_sort (ctx->pending_images, (GCompareFunc) image_sort_by_size);
+}
+
+static gboolean
+unique_id_matches (GArray      *unique_id,
+                   const gchar *str)
+{
+    gsize len;
+
+    len = strlen (str);
+    return (unique_id && unique_id->len >= len && !strncmp (unique_id->data, str, len));
+}
+
+/* Modem build ids are '<firmware version>_<unique suffix>'; carrier PRI build
+ * ids are '<firmware version>_<carrier>', with the config version as unique
+ * id. */
+static gboolean
+build_id_matches (const gchar *build_id,
+                  const gchar *firmware_version,
+                  const gchar *carrier)
+{
+    gsize len;
+
+    len = strlen (firmware_version);
+    if (!build_id || strncmp (build_id, firmware_version, len) != 0 || build_id[len] != '_')
+        return FALSE;
+    return (!carrier || !g_ascii_strcasecmp (&build_id[len + 1], carrier));
+}
+
+static void
+lookup_stored_images (RunContext  *ctx,
+                      const gchar *firmware_version,
+                      const gchar *config_version,
+                      const gchar *carrier,
+                      gboolean    *modem_stored,
+                      gboolean    *pri_stored)
+{
+    GArray *array = NULL;
+    guint   i;
+    guint   j;
+
+    *modem_stored = FALSE;
+    *pri_stored = FALSE;
+
+    if (!ctx->stored_images || !qmi_message_dms_list_stored_images_output_get_list (ctx->stored_images, &array, NULL))
+        return;
+
+    for (i = 0; i < array->len; i++) {
+        QmiMessageDmsListStoredImagesOutputListImage *image;
+
+        image = &g_array_index (array, QmiMessageDmsListStoredImagesOutputListImage, i);
+        for (j = 0; j < image->sublist->len; j++) {
+            QmiMessageDmsListStoredImagesOutputListImageSublistSublistElement *subimage;
+
+            subimage = &g_array_index (image->sublist, QmiMessageDmsListStoredImagesOutputListImageSublistSublistElement, j);
+            if (image->type == QMI_DMS_FIRMWARE_IMAGE_TYPE_MODEM &&
+                build_id_matches (subimage->build_id, firmware_version, NULL))
+                *modem_stored = TRUE;
+            else if (image->type == QMI_DMS_FIRMWARE_IMAGE_TYPE_PRI &&
+                     build_id_matches (subimage->build_id, firmware_version, carrier) &&
+                     unique_id_matches (subimage->unique_id, config_version))
+                *pri_stored = TRUE;
+        }
+    }
+}
+
+static gboolean
+firmware_preference_matches (RunContext  *ctx,
+                             const gchar *firmware_version,
+                             const gchar *config_version,
+                             const gchar *carrier)
+{
+    GArray   *array = NULL;
+    gboolean  modem_found = FALSE;
+    gboolean  pri_found = FALSE;
+    guint     i;
+
+    if (!ctx->firmware_preference || !qmi_message_dms_get_firmware_preference_output_get_list (ctx->firmware_preference, &array, NULL))
+        return FALSE;
+
+    for (i = 0; i < array->len; i++) {
+        QmiMessageDmsGetFirmwarePreferenceOutputListImage *image;
+
+        image = &g_array_index (array, QmiMessageDmsGetFirmwarePreferenceOutputListImage, i);
+        if (image->type == QMI_DMS_FIRMWARE_IMAGE_TYPE_MODEM)
+            modem_found = build_id_matches (image->build_id, firmware_version, NULL);
+        else if (image->type == QMI_DMS_FIRMWARE_IMAGE_TYPE_PRI)
+            pri_found = (build_id_matches (image->build_id, firmware_version, carrier) &&
+                         unique_id_matches (image->unique_id, config_version));
+    }
+
+    return (modem_found && pri_found);
+}
+
 static void
 set_firmware_preference_ready (QmiClientDms *client,
                                GAsyncResult *res,
                                GTask        *task)
 {
     RunContext                               *ctx;
+    QfuUpdater                               *self;
     QmiMessageDmsSetFirmwarePreferenceOutput *output;
     GError                                   *error = NULL;
     GArray                                   *array = NULL;
     guint                                     next_step;
 
     ctx = (RunContext *) g_task_get_task_data (task);
+    self = g_task_get_source_object (task);
 
     output = qmi_client_dms_set_firmware_preference_finish (client, res, &error);
     if (!output) {
@@ -999,19 +1607,25 @@ set_firmware_preference_ready (QmiClientDms *client,
     /* list images we need to download? */
     if (qmi_message_dms_set_firmware_preference_output_get_image_download_list (output, &array, &error)) {
         if (!array->len) {
-            g_print ("device already contains the given firmware/config version: no download needed\n");
-            g_print ("forcing the download may be requested with the --override-download option\n");
-            g_print ("now power cycling to apply the new firmware preference...\n");
+            updater_print (self, "device already contains the given firmware/config version: no download needed\n");
+            updater_print (self, "forcing the download may be requested with the --override-download option\n");
+            updater_print (self, "now power cycling to apply the new firmware preference...\n");
             g_list_free_full (ctx->pending_images, g_object_unref);
             ctx->pending_images = NULL;
         } else {
             GString                 *images = NULL;
             QmiDmsFirmwareImageType  type;
+            gboolean                 need_modem = FALSE;
+            gboolean                 need_pri = FALSE;
             guint                    i;
 
             images = g_string_new ("");
             for (i = 0; i < array->len; i++) {
                 type = g_array_index (array, QmiDmsFirmwareImageType, i);
+                if (type == QMI_DMS_FIRMWARE_IMAGE_TYPE_MODEM)
+                    need_modem = TRUE;
+                else if (type == QMI_DMS_FIRMWARE_IMAGE_TYPE_PRI)
+                    need_pri = TRUE;
                 g_string_append (images, qmi_dms_firmware_image_type_get_string (type));
                 if (i < array->len -1)
                     g_string_append (images, ", ");
@@ -1019,6 +1633,10 @@ set_firmware_preference_ready (QmiClientDms *client,
 
             g_debug ("[qfu-updater] need to download the following images: %s", images->str);
             g_string_free (images, TRUE);
+
+            /* The device knows best what it's missing */
+            if (!self->priv->override_download)
+                select_pending_images (ctx, need_modem, need_pri);
         }
     }
 
@@ -1044,6 +1662,9 @@ run_context_step_set_firmware_preference (GTask *task)
     ctx = (RunContext *) g_task_get_task_data (task);
     self = g_task_get_source_object (task);
 
+    if (!run_context_images_checked (task))
+        return;
+
     firmware_version = self->priv->firmware_version ? self->priv->firmware_version : ctx->firmware_version;
     config_version   = self->priv->config_version   ? self->priv->config_version   : ctx->config_version;
     carrier          = self->priv->carrier          ? self->priv->carrier          : ctx->carrier;
@@ -1052,10 +1673,10 @@ run_context_step_set_firmware_preference (GTask *task)
     g_assert (config_version);
     g_assert (carrier);
 
-    g_print ("setting firmware preference:\n");
-    g_print ("  firmware version: '%s'\n", firmware_version);
-    g_print ("  config version:   '%s'\n", config_version);
-    g_print ("  carrier:          '%s'\n", carrier);
+    updater_print (self, "setting firmware preference:\n");
+    updater_print (self, "  firmware version: '%s'\n", firmware_version);
+    updater_print (self, "  config version:   '%s'\n", config_version);
+    updater_print (self, "  carrier:          '%s'\n", carrier);
 
     /* Set modem image info */
     modem_image_id.type = QMI_DMS_FIRMWARE_IMAGE_TYPE_MODEM;
@@ -1286,6 +1907,36 @@ run_context_step_get_firmware_preference (GTask *task)
         return;
     }
 
+    /* Unless told otherwise, don't download what the device already has */
+    if (!self->priv->override_download) {
+        const gchar *firmware_version;
+        const gchar *config_version;
+        const gchar *carrier;
+        gboolean     modem_stored;
+        gboolean     pri_stored;
+
+        firmware_version = self->priv->firmware_version ? self->priv->firmware_version : ctx->firmware_version;
+        config_version   = self->priv->config_version   ? self->priv->config_version   : ctx->config_version;
+        carrier          = self->priv->carrier          ? self->priv->carrier          : ctx->carrier;
+
+        lookup_stored_images (ctx, firmware_version, config_version, carrier, &modem_stored, &pri_stored);
+        g_debug ("[qfu-updater] modem image %s stored in the device", modem_stored ? "already" : "not");
+        g_debug ("[qfu-updater] pri image %s stored in the device", pri_stored ? "already" : "not");
+
+        /* Both images stored and preferred: nothing to download and no reboot needed */
+        if (modem_stored && pri_stored && firmware_preference_matches (ctx, firmware_version, config_version, carrier)) {
+            ctx->already_installed = TRUE;
+            run_context_step_next (task, RUN_CONTEXT_STEP_CLEANUP_QMI_DEVICE_FULL);
+            return;
+        }
+
+        if (modem_stored || pri_stored) {
+            select_pending_images (ctx, !modem_stored, !pri_stored);
+            if (!ctx->pending_images)
+                updater_print (self, "device already contains the given firmware/config version: only switching preference\n");
+        }
+    }
+
     /* Go on */
     run_context_step_next (task, ctx->step + 1);
 }
@@ -1311,6 +1962,7 @@ new_client_dms_ready (gpointer      unused,
                                           &ctx->revision,
                                           &ctx->supports_stored_image_management,
                                           &ctx->max_modem_storage_index,
+                                          &ctx->stored_images,
                                           &ctx->supports_firmware_preference_management,
                                           &ctx->firmware_preference,
                                           &ctx->current_firmware,
@@ -1343,7 +1995,7 @@ run_context_step_qmi_client (GTask *task)
     ctx = (RunContext *) g_task_get_task_data (task);
     self = g_task_get_source_object (task);
 
-    g_print ("loading device information before the update...\n");
+    updater_print (self, "loading device information before the update...\n");
 
     g_debug ("[qfu-updater] creating QMI DMS client...");
     g_assert (ctx->cdc_wdm_file);
@@ -1405,61 +2057,30 @@ run_context_step (GTask *task)
     run_context_step_last (task);
 }
 
-static gint
-image_sort_by_size (QfuImage *a, QfuImage *b)
-{
-    return qfu_image_get_size (b) - qfu_image_get_size (a);
-}
-
-static gboolean
-preload_images (RunContext    *ctx,
-                GList         *image_file_list,
-                GCancellable  *cancellable,
-                GError       **error)
-{
-    GList *l;
-
-    /* Build QfuImage objects for each image file given */
-    for (l = image_file_list; l; l = g_list_next (l)) {
-        QfuImage *image;
-
-        image = qfu_image_factory_build (G_FILE (l->data), cancellable, error);
-        if (!image)
-            return FALSE;
-
-        ctx->pending_images = g_list_append (ctx->pending_images, image);
-    }
-
-    /* Sort by size, we want to download bigger images first, as that is usually
-     * the use case anyway, first flash e.g. the .cwe file, then the .nvu one. */
-    ctx->pending_images = g_list_sort (ctx->pending_images, (GCompareFunc) image_sort_by_size);
-
-    return TRUE;
-}
-
 void
 qfu_updater_run (QfuUpdater          *self,
-                 GList               *image_file_list,
+                 GList               *images,
                  GCancellable        *cancellable,
                  GAsyncReadyCallback  callback,
                  gpointer             user_data)
 {
     RunContext *ctx;
     GTask      *task;
-    GError     *error = NULL;
+    GList      *l;
 
-    g_assert (image_file_list);
+    g_assert (images);
 
     ctx = g_slice_new0 (RunContext);
 
     task = g_task_new (self, cancellable, callback, user_data);
     g_task_set_task_data (task, ctx, (GDestroyNotify) run_context_free);
 
-    if (!preload_images (ctx, image_file_list, cancellable, &error)) {
-        g_task_return_error (task, error);
-        g_object_unref (task);
-        return;
-    }
+    /* The images may be shared with other updaters, so keep our own list,
+     * sorted by size: we want to download bigger images first, as that is
+     * usually the use case anyway, first flash e.g. the .cwe file, then the
+     * .nvu one. */
+    ctx->pending_images = g_list_sort (g_list_copy_deep (images, (GCopyFunc) g_object_ref, NULL),
+                                       (GCompareFunc) image_sort_by_size);
 
     switch (self->priv->type) {
 #if defined WITH_UDEV
@@ -1488,6 +2109,16 @@ qfu_updater_run (QfuUpdater          *self,
         g_assert_not_reached ();
     }
 
+    /* Check the images while the device is prepared; the checks of images
+     * shared with other updaters are only run once */
+    for (l = ctx->pending_images; l; l = g_list_next (l)) {
+        ctx->n_images_checking++;
+        qfu_image_check_integrity_async (QFU_IMAGE (l->data),
+                                         cancellable,
+                                         (GAsyncReadyCallback) image_check_integrity_ready,
+                                         g_object_ref (task));
+    }
+
     run_context_step (task);
 }
 
@@ -1504,7 +2135,10 @@ qfu_updater_new (QfuDeviceSelection *device_selection,
                  gboolean            ignore_version_errors,
                  gboolean            override_download,
                  guint8              modem_storage_index,
-                 gboolean            skip_validation)
+                 gboolean            skip_validation,
+                 guint8              qdl_window_size,
+                 gsize               qdl_chunk_size,
+                 gboolean            qdl_usb)
 {
     QfuUpdater *self;
 
@@ -1521,6 +2155,9 @@ qfu_updater_new (QfuDeviceSelection *device_selection,
     self->priv->override_download = override_download;
     self->priv->modem_storage_index = modem_storage_index;
     self->priv->skip_validation = skip_validation;
+    self->priv->qdl_window_size = qdl_window_size;
+    self->priv->qdl_chunk_size = qdl_chunk_size;
+    self->priv->qdl_usb = qdl_usb;
 
     return self;
 }
@@ -1528,7 +2165,10 @@ qfu_updater_new (QfuDeviceSelection *device_selection,
 #endif
 
 QfuUpdater *
-qfu_updater_new_qdl (QfuDeviceSelection *device_selection)
+qfu_updater_new_qdl (QfuDeviceSelection *device_selection,
+                     guint8              qdl_window_size,
+                     gsize               qdl_chunk_size,
+                     gboolean            qdl_usb)
 {
     QfuUpdater *self;
 
@@ -1537,10 +2177,27 @@ qfu_updater_new_qdl (QfuDeviceSelection *device_selection)
     self = g_object_new (QFU_TYPE_UPDATER, NULL);
     self->priv->type = UPDATER_TYPE_QDL;
     self->priv->device_selection = g_object_ref (device_selection);
+    self->priv->qdl_window_size = qdl_window_size;
+    self->priv->qdl_chunk_size = qdl_chunk_size;
+    self->priv->qdl_usb = qdl_usb;
 
     return self;
 }
 
+const gchar *
+qfu_updater_get_label (QfuUpdater *self)
+{
+    return self->priv->label;
+}
+
+void
+qfu_updater_set_label (QfuUpdater  *self,
+                       const gchar *label)
+{
+    g_free (self->priv->label);
+    self->priv->label = g_strdup (label);
+}
+
 static void
 qfu_updater_init (QfuUpdater *self)
 {
@@ -1561,9 +2218,10 @@ dispose (GObject *object)
 static void
 finalize (GObject *object)
 {
-#if defined WITH_UDEV
     QfuUpdater *self = QFU_UPDATER (object);
 
+    g_free (self->priv->label);
+#if defined WITH_UDEV
     g_free (self->priv->firmware_version);
     g_free (self->priv->config_version);
     g_free (self->priv->carrier);
@@ -60,12 +60,21 @@ QfuUpdater *qfu_updater_new        (QfuDeviceSelection   *device_selection,
                                     gboolean              ignore_version_errors,
                                     gboolean              override_download,
                                     guint8                modem_storage_index,
-                                    gboolean              skip_validation);
+                                    gboolean              skip_validation,
+                                    guint8                qdl_window_size,
+                                    gsize                 qdl_chunk_size,
+                                    gboolean              qdl_usb);
 #endif
 
-QfuUpdater *qfu_updater_new_qdl    (QfuDeviceSelection   *device_selection);
+QfuUpdater *qfu_updater_new_qdl    (QfuDeviceSelection   *device_selection,
+                                    guint8                qdl_window_size,
+                                    gsize                 qdl_chunk_size,
+                                    gboolean              qdl_usb);
+const gchar *qfu_updater_get_label (QfuUpdater           *self);
+void        qfu_updater_set_label  (QfuUpdater           *self,
+                                    const gchar          *label);
 void        qfu_updater_run        (QfuUpdater           *self,
-                                    GList                *image_file_list,
+                                    GList                *images,
                                     GCancellable         *cancellable,
                                     GAsyncReadyCallback   callback,
                                     gpointer              user_data);
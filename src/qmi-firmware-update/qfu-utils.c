@@ -38,32 +38,32 @@ qfu_utils_str_hex (gconstpointer mem,
                    gsize         size,
                    gchar         delimiter)
 {
-    const guint8 *data = mem;
-    gsize         i;
-    gsize         j;
-    gsize         new_str_length;
-    gchar        *new_str;
+    static const gchar  hex_digits[] = "0123456789ABCDEF";
+    const guint8       *data = mem;
+    gsize               i;
+    gchar              *new_str;
+    gchar              *out;
+
+    if (!size)
+        return NULL;
 
     /* Get new string length. If input string has N bytes, we need:
      * - 1 byte for last NUL char
      * - 2N bytes for hexadecimal char representation of each byte...
      * - N-1 bytes for the separator ':'
      * So... a total of (1+2N+N-1) = 3N bytes are needed... */
-    new_str_length =  3 * size;
-
-    /* Allocate memory for new array and initialize contents to NUL */
-    new_str = g_malloc0 (new_str_length);
-
-    /* Print hexadecimal representation of each byte... */
-    for (i = 0, j = 0; i < size; i++, j += 3) {
-        /* Print character in output string... */
-        snprintf (&new_str[j], 3, "%02X", data[i]);
-        /* And if needed, add separator */
-        if (i != (size - 1) )
-            new_str[j + 2] = delimiter;
+    new_str = out = g_malloc (3 * size);
+
+    /* Write the hexadecimal representation of each byte, using a lookup
+     * table instead of a printf() call per byte */
+    for (i = 0; i < size; i++) {
+        if (i > 0)
+            *(out++) = delimiter;
+        *(out++) = hex_digits[data[i] >> 4];
+        *(out++) = hex_digits[data[i] & 0x0F];
     }
+    *out = '\0';
 
-    /* Set output string */
     return new_str;
 }
 
@@ -155,6 +155,28 @@ static const guint16 crc_table[256] = {
     0x7bc7, 0x6a4e, 0x58d5, 0x495c, 0x3de3, 0x2c6a, 0x1ef1, 0x0f78
 };
 
+/* Tables to process 8 bytes at a time ("slicing-by-8"): each one gives the
+ * CRC of the previous one followed by an additional zero byte, the first one
+ * being the single-byte table */
+static guint16 crc_tables[8][256];
+
+static void
+crc_tables_init (void)
+{
+    static gsize initialized = 0;
+
+    if (g_once_init_enter (&initialized)) {
+        guint i, k;
+
+        memcpy (crc_tables[0], crc_table, sizeof (crc_table));
+        for (k = 1; k < G_N_ELEMENTS (crc_tables); k++) {
+            for (i = 0; i < 256; i++)
+                crc_tables[k][i] = (crc_tables[k - 1][i] >> 8) ^ crc_table[crc_tables[k - 1][i] & 0xff];
+        }
+        g_once_init_leave (&initialized, 1);
+    }
+}
+
 /* Calculate the CRC for a buffer using a seed of 0xffff */
 guint16
 qfu_utils_crc16 (const guint8 *buffer,
@@ -162,11 +184,250 @@ qfu_utils_crc16 (const guint8 *buffer,
 {
     guint16 crc = 0xffff;
 
+    crc_tables_init ();
+
+    while (len >= 8) {
+        crc ^= buffer[0] | (buffer[1] << 8);
+        crc = crc_tables[7][crc & 0xff] ^ crc_tables[6][crc >> 8] ^
+              crc_tables[5][buffer[2]]  ^ crc_tables[4][buffer[3]] ^
+              crc_tables[3][buffer[4]]  ^ crc_tables[2][buffer[5]] ^
+              crc_tables[1][buffer[6]]  ^ crc_tables[0][buffer[7]];
+        buffer += 8;
+        len -= 8;
+    }
+
     while (len--)
             crc = crc_table[(crc ^ *buffer++) & 0xff] ^ (crc >> 8);
     return ~crc;
 }
 
+/******************************************************************************/
+/* CRC-32 */
+
+/* Reflected 0x04c11db7 polynomial, processed 8 bytes at a time as well */
+static guint32 crc32_tables[8][256];
+
+static void
+crc32_tables_init (void)
+{
+    static gsize initialized = 0;
+
+    if (g_once_init_enter (&initialized)) {
+        guint i, j, k;
+
+        for (i = 0; i < 256; i++) {
+            guint32 crc = i;
+
+            for (j = 0; j < 8; j++)
+                crc = (crc & 1) ? ((crc >> 1) ^ 0xedb88320) : (crc >> 1);
+            crc32_tables[0][i] = crc;
+        }
+        for (k = 1; k < G_N_ELEMENTS (crc32_tables); k++) {
+            for (i = 0; i < 256; i++)
+                crc32_tables[k][i] = (crc32_tables[k - 1][i] >> 8) ^ crc32_tables[0][crc32_tables[k - 1][i] & 0xff];
+        }
+        g_once_init_leave (&initialized, 1);
+    }
+}
+
+/* Update a CRC-32 with the given buffer, without any final inversion, so that
+ * it can be computed in several steps */
+guint32
+qfu_utils_crc32 (guint32       crc,
+                 const guint8 *buffer,
+                 gsize         len)
+{
+    crc32_tables_init ();
+
+    while (len >= 8) {
+        crc ^= (guint32) buffer[0] | ((guint32) buffer[1] << 8) | ((guint32) buffer[2] << 16) | ((guint32) buffer[3] << 24);
+        crc = crc32_tables[7][crc & 0xff]         ^ crc32_tables[6][(crc >> 8) & 0xff] ^
+              crc32_tables[5][(crc >> 16) & 0xff] ^ crc32_tables[4][crc >> 24]         ^
+              crc32_tables[3][buffer[4]]          ^ crc32_tables[2][buffer[5]]         ^
+              crc32_tables[1][buffer[6]]          ^ crc32_tables[0][buffer[7]];
+        buffer += 8;
+        len -= 8;
+    }
+
+    while (len--)
+        crc = crc32_tables[0][(crc ^ *buffer++) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+/******************************************************************************/
+/* HDLC */
+
+#define CONTROL 0x7e
+#define ESCAPE  0x7d
+#define MASK    0x20
+
+/* A word with the same byte in all positions */
+#define WORD_BYTES(byte) (G_GUINT64_CONSTANT (0x0101010101010101) * (byte))
+
+/* Non-zero if any of the bytes in the word is zero */
+#define WORD_HAS_ZERO_BYTE(v) (((v) - WORD_BYTES (0x01)) & ~(v) & WORD_BYTES (0x80))
+
+/* Number of bytes at the beginning of the buffer which don't need escaping;
+ * a word is checked at a time, until one with bytes to escape is found */
+static gsize
+hdlc_clean_run_length (const guint8 *in,
+                       gsize         inlen)
+{
+    gsize i = 0;
+
+    while (i + sizeof (guint64) <= inlen) {
+        guint64 v;
+
+        memcpy (&v, &in[i], sizeof (guint64));
+        if (WORD_HAS_ZERO_BYTE (v ^ WORD_BYTES (CONTROL)) || WORD_HAS_ZERO_BYTE (v ^ WORD_BYTES (ESCAPE)))
+            break;
+        i += sizeof (guint64);
+    }
+
+    while (i < inlen && in[i] != CONTROL && in[i] != ESCAPE)
+        i++;
+
+    return i;
+}
+
+static gsize
+hdlc_escape (const guint8 *in,
+             gsize         inlen,
+             guint8       *out,
+             gsize         outlen)
+{
+    gsize i = 0;
+    gsize j = 0;
+
+    while (i < inlen) {
+        gsize run;
+
+        /* Clean runs are copied as they are */
+        run = hdlc_clean_run_length (&in[i], inlen - i);
+        /* Caller should give a big enough buffer */
+        g_assert (j + run <= outlen);
+        memcpy (&out[j], &in[i], run);
+        i += run;
+        j += run;
+
+        if (i < inlen) {
+            g_assert ((j + 1) < outlen);
+            out[j++] = ESCAPE;
+            out[j++] = in[i++] ^ MASK;
+        }
+    }
+
+    return j;
+}
+
+static gsize
+hdlc_unescape (const guint8 *in,
+               gsize         inlen,
+               guint8       *out,
+               gsize         outlen)
+{
+    gsize i = 0;
+    gsize j = 0;
+
+    while (i < inlen) {
+        const guint8 *escape;
+        gsize         run;
+
+        /* Everything up to the next escape char is copied as it is */
+        escape = memchr (&in[i], ESCAPE, inlen - i);
+        run = escape ? (gsize) (escape - &in[i]) : inlen - i;
+        /* Caller should give a big enough buffer */
+        g_assert (j + run <= outlen);
+        memcpy (&out[j], &in[i], run);
+        i += run;
+        j += run;
+
+        if (escape) {
+            /* Skip the escape char; a trailing one is ignored */
+            i++;
+            if (i < inlen) {
+                g_assert (j < outlen);
+                out[j++] = in[i++] ^ MASK;
+            }
+        }
+    }
+
+    return j;
+}
+
+gsize
+qfu_utils_hdlc_max_framed_size (gsize unframed_size)
+{
+    /* 1 header byte, (2 * input size) bytes, 2 crc bytes and 1 trailing byte */
+    return 4 + (2 * unframed_size);
+}
+
+gsize
+qfu_utils_hdlc_frame (const guint8 *in,
+                      gsize         inlen,
+                      guint8       *out,
+                      gsize         outlen)
+{
+    guint16 crc;
+    guint8  crc_bytes[2];
+    gsize   j = 0;
+
+    out[j++] = CONTROL;
+    j += hdlc_escape (in, inlen, &out[j], outlen - j);
+    crc = qfu_utils_crc16 (in, inlen);
+    crc_bytes[0] = crc & 0xff;
+    crc_bytes[1] = crc >> 8 & 0xff;
+    j += hdlc_escape (crc_bytes, sizeof (crc_bytes), &out[j], outlen - j);
+    out[j++] = CONTROL;
+
+    return j;
+}
+
+gsize
+qfu_utils_hdlc_max_unframed_size (gsize framed_size)
+{
+    /* -1 header byte, -2 crc bytes and -1 trailing byte */
+    g_assert (framed_size > 3);
+    return framed_size - 3;
+}
+
+gsize
+qfu_utils_hdlc_unframe (const guint8  *in,
+                        gsize          inlen,
+                        guint8        *out,
+                        gsize          outlen,
+                        GError       **error)
+{
+    guint16 crc;
+    gsize j, i = inlen;
+
+    /* the first control char is optional */
+    if (*in == CONTROL) {
+        in++;
+        i--;
+    }
+    if (in[i - 1] == CONTROL)
+        i--;
+
+    j = hdlc_unescape (in, i, out, outlen);
+    if (j < 2) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "unescaping failed: too few bytes as output: %" G_GSIZE_FORMAT, j);
+        return 0;
+    }
+    j -= 2; /* remove the crc */
+
+    /* verify the crc */
+    crc = qfu_utils_crc16 (out, j);
+    if (crc != (out[j] | out[j + 1] << 8)) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "crc check failed: 0x%04x != 0x%04x\n", crc, out[j] | out[j + 1] << 8);
+        return 0;
+    }
+
+    return j;
+}
+
 /******************************************************************************/
 
 gboolean
@@ -214,6 +475,219 @@ out:
     return result;
 }
 
+/******************************************************************************/
+/* Compressed images
+ *
+ * The uncompressed size of an image is read from the container metadata, so
+ * that the image doesn't need to be decompressed in advance to know it. */
+
+static gboolean
+check_xz_crc32 (const guint8  *buffer,
+                gsize          len,
+                const guint8  *expected,
+                GError       **error)
+{
+    guint32 crc;
+
+    crc = ~qfu_utils_crc32 (0xffffffff, buffer, len);
+    if (crc != (expected[0] | expected[1] << 8 | expected[2] << 16 | (guint32) expected[3] << 24)) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "xz CRC mismatch");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Variable length integers, 7 bits per byte, up to 63 bits */
+static gboolean
+read_xz_varint (const guint8 *buffer,
+                gsize         len,
+                gsize        *offset,
+                guint64      *out_value)
+{
+    guint64 value = 0;
+    guint   i;
+
+    for (i = 0; i < 9 && *offset < len; i++) {
+        guint8 byte;
+
+        byte = buffer[(*offset)++];
+        value |= ((guint64) (byte & 0x7F)) << (i * 7);
+        if (!(byte & 0x80)) {
+            /* Not the shortest encoding */
+            if (i > 0 && byte == 0x00)
+                return FALSE;
+            *out_value = value;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+gboolean
+qfu_utils_gzip_get_uncompressed_size (const guint8  *trailer,
+                                      gsize          len,
+                                      goffset       *out_size,
+                                      GError       **error)
+{
+    guint32 size;
+
+    if (len < QFU_UTILS_GZIP_TRAILER_SIZE) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "gzip trailer too short");
+        return FALSE;
+    }
+
+    /* ISIZE, the size modulo 2^32, which is enough as images are never that
+     * big; single member files only */
+    size = trailer[len - 4] | trailer[len - 3] << 8 | trailer[len - 2] << 16 | (guint32) trailer[len - 1] << 24;
+    if (!size) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "empty gzip contents");
+        return FALSE;
+    }
+
+    *out_size = size;
+    return TRUE;
+}
+
+gboolean
+qfu_utils_xz_get_index_size (const guint8  *footer,
+                             gsize          len,
+                             gsize         *out_index_size,
+                             GError       **error)
+{
+    guint32 backward_size;
+
+    if (len != QFU_UTILS_XZ_FOOTER_SIZE || footer[10] != 'Y' || footer[11] != 'Z') {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "invalid xz stream footer");
+        return FALSE;
+    }
+
+    /* CRC32 of the backward size and the stream flags */
+    if (!check_xz_crc32 (&footer[4], 6, &footer[0], error)) {
+        g_prefix_error (error, "invalid xz stream footer: ");
+        return FALSE;
+    }
+
+    backward_size = footer[4] | footer[5] << 8 | footer[6] << 16 | (guint32) footer[7] << 24;
+    *out_index_size = ((gsize) backward_size + 1) * 4;
+    return TRUE;
+}
+
+gboolean
+qfu_utils_xz_get_uncompressed_size (const guint8  *index,
+                                    gsize          len,
+                                    goffset       *out_size,
+                                    GError       **error)
+{
+    guint64 n_records;
+    guint64 size = 0;
+    guint64 i;
+    gsize   offset = 1;
+
+    if (len < 8 || (len % 4) || index[0] != 0x00) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "invalid xz index");
+        return FALSE;
+    }
+
+    if (!check_xz_crc32 (index, len - 4, &index[len - 4], error)) {
+        g_prefix_error (error, "invalid xz index: ");
+        return FALSE;
+    }
+
+    /* One record per block, with the unpadded and the uncompressed sizes */
+    if (!read_xz_varint (index, len - 4, &offset, &n_records))
+        goto invalid;
+    for (i = 0; i < n_records; i++) {
+        guint64 unpadded_size;
+        guint64 uncompressed_size;
+
+        if (!read_xz_varint (index, len - 4, &offset, &unpadded_size) ||
+            !read_xz_varint (index, len - 4, &offset, &uncompressed_size))
+            goto invalid;
+        size += uncompressed_size;
+        if (size > G_MAXINT64)
+            goto invalid;
+    }
+
+    if (!size) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "empty xz contents");
+        return FALSE;
+    }
+
+    *out_size = (goffset) size;
+    return TRUE;
+
+invalid:
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                 "invalid xz index records");
+    return FALSE;
+}
+
+gboolean
+qfu_utils_zstd_get_uncompressed_size (const guint8  *header,
+                                      gsize          len,
+                                      goffset       *out_size,
+                                      GError       **error)
+{
+    static const guint did_sizes[] = { 0, 1, 2, 4 };
+    static const guint fcs_sizes[] = { 0, 2, 4, 8 };
+    guint8   descriptor;
+    gboolean single_segment;
+    gsize    offset;
+    guint    fcs_size;
+    guint64  size = 0;
+    guint    i;
+
+    if (len < 5 || header[0] != 0x28 || header[1] != 0xB5 || header[2] != 0x2F || header[3] != 0xFD) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "invalid zstd frame header");
+        return FALSE;
+    }
+
+    /* Frame header descriptor, with the size of the fields that follow */
+    descriptor = header[4];
+    if (descriptor & 0x08) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "invalid zstd frame header descriptor");
+        return FALSE;
+    }
+    single_segment = !!(descriptor & 0x20);
+    offset = 5 + (single_segment ? 0 : 1) + did_sizes[descriptor & 0x03];
+    fcs_size = fcs_sizes[descriptor >> 6];
+    if (!fcs_size && single_segment)
+        fcs_size = 1;
+
+    if (!fcs_size) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                     "zstd frame content size not given");
+        return FALSE;
+    }
+    if (offset + fcs_size > len) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "zstd frame header too short");
+        return FALSE;
+    }
+
+    for (i = 0; i < fcs_size; i++)
+        size |= ((guint64) header[offset + i]) << (i * 8);
+    if (fcs_size == 2)
+        size += 256;
+
+    if (!size || size > G_MAXINT64) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "invalid zstd frame content size");
+        return FALSE;
+    }
+
+    *out_size = (goffset) size;
+    return TRUE;
+}
+
 /******************************************************************************/
 
 typedef struct {
@@ -228,6 +702,7 @@ typedef struct {
     gboolean                                  supports_stored_image_management;
     gboolean                                  supports_stored_image_management_done;
     guint8                                    max_storage_index;
+    QmiMessageDmsListStoredImagesOutput      *stored_images;
     gboolean                                  supports_firmware_preference_management;
     QmiMessageDmsGetFirmwarePreferenceOutput *firmware_preference;
     gboolean                                  supports_firmware_preference_management_done;
@@ -242,6 +717,8 @@ new_client_dms_context_free (NewClientDmsContext *ctx)
         qmi_message_dms_swi_get_current_firmware_output_unref (ctx->current_firmware);
     if (ctx->firmware_preference)
         qmi_message_dms_get_firmware_preference_output_unref (ctx->firmware_preference);
+    if (ctx->stored_images)
+        qmi_message_dms_list_stored_images_output_unref (ctx->stored_images);
     if (ctx->qmi_client)
         g_object_unref (ctx->qmi_client);
     if (ctx->qmi_device)
@@ -257,6 +734,7 @@ qfu_utils_new_client_dms_finish (GAsyncResult  *res,
                                  gchar        **revision,
                                  gboolean      *supports_stored_image_management,
                                  guint8        *max_storage_index,
+                                 QmiMessageDmsListStoredImagesOutput **stored_images,
                                  gboolean      *supports_firmware_preference_management,
                                  QmiMessageDmsGetFirmwarePreferenceOutput **firmware_preference,
                                  QmiMessageDmsSwiGetCurrentFirmwareOutput **current_firmware,
@@ -278,6 +756,8 @@ qfu_utils_new_client_dms_finish (GAsyncResult  *res,
         *supports_stored_image_management = ctx->supports_stored_image_management;
     if (max_storage_index)
         *max_storage_index = ctx->max_storage_index;
+    if (stored_images)
+        *stored_images = (ctx->stored_images ? qmi_message_dms_list_stored_images_output_ref (ctx->stored_images) : NULL);
     if (supports_firmware_preference_management)
         *supports_firmware_preference_management = ctx->supports_firmware_preference_management;
     if (firmware_preference)
@@ -349,6 +829,9 @@ dms_list_stored_images_ready (QmiClientDms *client,
         GArray *array;
         guint i;
 
+        /* Store */
+        ctx->stored_images = qmi_message_dms_list_stored_images_output_ref (output);
+
         qmi_message_dms_list_stored_images_output_get_list (output, &array, NULL);
 
         for (i = 0; i < array->len; i++) {
@@ -39,6 +39,21 @@ gchar *qfu_utils_get_firmware_image_unique_id_printable (const GArray *unique_id
 
 guint16 qfu_utils_crc16 (const guint8 *buffer,
                          gsize         len);
+guint32 qfu_utils_crc32 (guint32       crc,
+                         const guint8 *buffer,
+                         gsize         len);
+
+gsize qfu_utils_hdlc_max_framed_size   (gsize          unframed_size);
+gsize qfu_utils_hdlc_frame             (const guint8  *in,
+                                        gsize          inlen,
+                                        guint8        *out,
+                                        gsize          outlen);
+gsize qfu_utils_hdlc_max_unframed_size (gsize          framed_size);
+gsize qfu_utils_hdlc_unframe           (const guint8  *in,
+                                        gsize          inlen,
+                                        guint8        *out,
+                                        gsize          outlen,
+                                        GError       **error);
 
 gboolean qfu_utils_parse_cwe_version_string (const gchar  *version,
                                              gchar       **firmware_version,
@@ -46,6 +61,29 @@ gboolean qfu_utils_parse_cwe_version_string (const gchar  *version,
                                              gchar       **carrier,
                                              GError      **error);
 
+/* Bytes needed from the end of gzip and xz files, and from the start of zstd
+ * files, to know the uncompressed size */
+#define QFU_UTILS_GZIP_TRAILER_SIZE    4
+#define QFU_UTILS_XZ_FOOTER_SIZE       12
+#define QFU_UTILS_ZSTD_MAX_HEADER_SIZE 18
+
+gboolean qfu_utils_gzip_get_uncompressed_size (const guint8  *trailer,
+                                               gsize          len,
+                                               goffset       *out_size,
+                                               GError       **error);
+gboolean qfu_utils_xz_get_index_size          (const guint8  *footer,
+                                               gsize          len,
+                                               gsize         *out_index_size,
+                                               GError       **error);
+gboolean qfu_utils_xz_get_uncompressed_size   (const guint8  *index,
+                                               gsize          len,
+                                               goffset       *out_size,
+                                               GError       **error);
+gboolean qfu_utils_zstd_get_uncompressed_size (const guint8  *header,
+                                               gsize          len,
+                                               goffset       *out_size,
+                                               GError       **error);
+
 void     qfu_utils_new_client_dms        (GFile                *cdc_wdm_file,
                                           guint                 retries,
                                           QmiDeviceOpenFlags    device_open_flags,
@@ -59,6 +97,7 @@ gboolean qfu_utils_new_client_dms_finish (GAsyncResult         *res,
                                           gchar               **revision,
                                           gboolean             *supports_stored_image_management,
                                           guint8               *max_storage_index,
+                                          QmiMessageDmsListStoredImagesOutput      **stored_images,
                                           gboolean             *supports_firmware_preference_management,
                                           QmiMessageDmsGetFirmwarePreferenceOutput **firmware_preference,
                                           QmiMessageDmsSwiGetCurrentFirmwareOutput **current_firmware,
@@ -0,0 +1,300 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * qmi-firmware-update -- Command line tool to update firmware in QMI devices
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+/*
+ * Firmware download throughput, against a simulated QDL target behind a
+ * pseudo terminal. The same image is downloaded sending one chunk at a time
+ * and waiting for its ack (serial), keeping several chunks in flight with
+ * the blocking API (windowed), and with the asynchronous download run in
+ * the device thread, as done by the updater (async).
+ *
+ * A small image is downloaded by default, so that the benchmark can be
+ * used as a plain test; the full one is only downloaded in perf mode
+ * (-m perf), where a tab-separated line with the benchmark name, the number
+ * of chunks, the throughput and its unit is also printed for each one.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "qfu-image.h"
+#include "qfu-qdl-device.h"
+#include "test-qdl-target.h"
+
+#define QUICK_N_CHUNKS 4
+#define PERF_N_CHUNKS  64
+
+typedef enum {
+    BENCH_MODE_SERIAL,
+    BENCH_MODE_WINDOWED,
+    BENCH_MODE_ASYNC,
+} BenchMode;
+
+typedef struct {
+    const gchar *name;
+    BenchMode    mode;
+    guint8       window_size;
+    guint        latency_us;
+    guint        chunk_processing_us;
+} BenchCase;
+
+static const BenchCase bench_cases[] = {
+    /* Host overhead only */
+    { "qdl/serial",                BENCH_MODE_SERIAL,   1, 0,    0    },
+    { "qdl/windowed",              BENCH_MODE_WINDOWED, 8, 0,    0    },
+    { "qdl/async",                 BENCH_MODE_ASYNC,    8, 0,    0    },
+    /* Target answering as a modem would, with each chunk taking a while to
+     * be written in flash */
+    { "qdl/serial/latency-1ms",    BENCH_MODE_SERIAL,   1, 1000, 2000 },
+    { "qdl/windowed/latency-1ms",  BENCH_MODE_WINDOWED, 8, 1000, 2000 },
+    { "qdl/async/latency-1ms",     BENCH_MODE_ASYNC,    8, 1000, 2000 },
+};
+
+static QfuImage *image;
+
+/*****************************************************************************/
+
+static void
+download_serial (QfuQdlDevice *device,
+                 guint16       n_chunks)
+{
+    GError  *error = NULL;
+    guint16  sequence;
+
+    for (sequence = 0; sequence < n_chunks; sequence++) {
+        guint16 ack_sequence = 0;
+
+        g_assert (qfu_qdl_device_ufwrite_send (device, image, sequence, NULL, &error));
+        g_assert_no_error (error);
+        g_assert (qfu_qdl_device_ufwrite_receive_ack (device, &ack_sequence, NULL, &error));
+        g_assert_no_error (error);
+        g_assert_cmpuint (ack_sequence, ==, sequence);
+    }
+}
+
+static void
+download_windowed (QfuQdlDevice *device,
+                   guint16       n_chunks,
+                   guint8        window_size)
+{
+    GError  *error = NULL;
+    guint16  sequence = 0;
+    guint16  n_acked = 0;
+
+    while (n_acked < n_chunks) {
+        guint16 ack_sequence = 0;
+
+        while (sequence < n_chunks && (sequence - n_acked) < window_size) {
+            g_assert (qfu_qdl_device_ufwrite_send (device, image, sequence, NULL, &error));
+            g_assert_no_error (error);
+            sequence++;
+        }
+
+        /* The target acks in order */
+        g_assert (qfu_qdl_device_ufwrite_receive_ack (device, &ack_sequence, NULL, &error));
+        g_assert_no_error (error);
+        g_assert_cmpuint (ack_sequence, ==, n_acked);
+        n_acked++;
+    }
+}
+
+typedef struct {
+    GMainLoop *loop;
+    guint16    n_acked_in_order;
+    guint      n_progress;
+} AsyncContext;
+
+static void
+ufwrite_progress (QfuQdlDevice *device,
+                  guint16       n_sent,
+                  guint16       n_acked,
+                  guint16       n_chunks,
+                  AsyncContext *ctx)
+{
+    g_assert_cmpuint (n_acked, <=, n_sent);
+    ctx->n_progress++;
+}
+
+static void
+ufwrite_ready (QfuQdlDevice *device,
+               GAsyncResult *res,
+               AsyncContext *ctx)
+{
+    GError *error = NULL;
+
+    g_assert (qfu_qdl_device_ufwrite_finish (device, res, &ctx->n_acked_in_order, &error));
+    g_assert_no_error (error);
+    g_main_loop_quit (ctx->loop);
+}
+
+static void
+download_async (QfuQdlDevice *device,
+                guint16       n_chunks,
+                guint8        window_size)
+{
+    AsyncContext ctx = { 0 };
+
+    ctx.loop = g_main_loop_new (NULL, FALSE);
+    qfu_qdl_device_ufwrite_async (device,
+                                  image,
+                                  window_size,
+                                  (QfuQdlDeviceUfwriteProgressFunc) ufwrite_progress,
+                                  &ctx,
+                                  NULL,
+                                  (GAsyncReadyCallback) ufwrite_ready,
+                                  &ctx);
+    g_main_loop_run (ctx.loop);
+    g_main_loop_unref (ctx.loop);
+
+    g_assert_cmpuint (ctx.n_acked_in_order, ==, n_chunks);
+    g_assert_cmpuint (ctx.n_progress, >, 0);
+}
+
+/*****************************************************************************/
+
+static void
+bench_download (const BenchCase *bench_case)
+{
+    TestQdlTarget *target;
+    QfuQdlDevice  *device;
+    GFile         *file;
+    GError        *error = NULL;
+    guint8         device_window_size = 0;
+    guint16        n_chunks;
+    gdouble        elapsed;
+    gdouble        throughput;
+
+    target = test_qdl_target_new (bench_case->latency_us, bench_case->chunk_processing_us, bench_case->window_size);
+    test_qdl_target_start (target);
+
+    file = g_file_new_for_path (test_qdl_target_get_name (target));
+    device = qfu_qdl_device_new (file, NULL, &error);
+    g_assert_no_error (error);
+    g_assert (device);
+    g_object_unref (file);
+
+    g_assert (qfu_qdl_device_ufopen (device, image, bench_case->window_size, 0, &device_window_size, NULL, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (device_window_size, ==, bench_case->window_size);
+    n_chunks = qfu_image_get_n_data_chunks (image, qfu_qdl_device_get_chunk_size (device));
+
+    g_test_timer_start ();
+    switch (bench_case->mode) {
+    case BENCH_MODE_SERIAL:
+        download_serial (device, n_chunks);
+        break;
+    case BENCH_MODE_WINDOWED:
+        download_windowed (device, n_chunks, bench_case->window_size);
+        break;
+    case BENCH_MODE_ASYNC:
+        download_async (device, n_chunks, bench_case->window_size);
+        break;
+    default:
+        g_assert_not_reached ();
+    }
+    elapsed = g_test_timer_elapsed ();
+
+    g_assert (qfu_qdl_device_ufclose (device, NULL, &error));
+    g_assert_no_error (error);
+    g_assert (qfu_qdl_device_reset (device, NULL, &error));
+    g_assert_no_error (error);
+    g_object_unref (device);
+
+    /* The reset has no response, so wait for the target to get it */
+    while (!test_qdl_target_get_n_resets (target))
+        g_usleep (1000);
+    test_qdl_target_stop (target);
+
+    g_assert_cmpuint (test_qdl_target_get_n_chunks (target), ==, n_chunks);
+    g_assert_cmpuint (test_qdl_target_get_n_bytes (target), ==, qfu_image_get_data_size (image));
+    g_assert_cmpuint (test_qdl_target_get_n_errors (target), ==, 0);
+    test_qdl_target_free (target);
+
+    throughput = qfu_image_get_data_size (image) / elapsed / 1e6;
+    g_test_maximized_result (throughput, "%s: %.1f MB/s", bench_case->name, throughput);
+    if (g_test_perf ())
+        g_print ("%s\t%u\t%.1f\tMB/s\n", bench_case->name, n_chunks, throughput);
+}
+
+/*****************************************************************************/
+
+static QfuImage *
+build_image (guint16   n_chunks,
+             gchar   **out_path)
+{
+    QfuImage *built;
+    GFile    *file;
+    GError   *error = NULL;
+    guint8   *contents;
+    gsize     size;
+    gsize     i;
+    gint      fd;
+
+    fd = g_file_open_tmp ("bench-qdl-XXXXXX.mbn", out_path, &error);
+    g_assert_no_error (error);
+    close (fd);
+
+    /* The last chunk is a short one */
+    size = (n_chunks - 1) * QFU_IMAGE_CHUNK_SIZE + QFU_IMAGE_CHUNK_SIZE / 2;
+    contents = g_malloc (size);
+    for (i = 0; i < size; i++)
+        contents[i] = (guint8) (i * 31 + (i >> 12));
+    g_assert (g_file_set_contents (*out_path, (const gchar *) contents, size, &error));
+    g_assert_no_error (error);
+    g_free (contents);
+
+    file = g_file_new_for_path (*out_path);
+    built = qfu_image_new (file, QFU_IMAGE_TYPE_AMSS_APPLICATION, NULL, &error);
+    g_assert_no_error (error);
+    g_object_unref (file);
+
+    g_assert_cmpuint (qfu_image_get_n_data_chunks (built, QFU_IMAGE_CHUNK_SIZE), ==, n_chunks);
+    return built;
+}
+
+int main (int argc, char **argv)
+{
+    gchar *path = NULL;
+    guint  i;
+    gint   result;
+
+    g_test_init (&argc, &argv, NULL);
+
+    image = build_image (g_test_perf () ? PERF_N_CHUNKS : QUICK_N_CHUNKS, &path);
+
+    for (i = 0; i < G_N_ELEMENTS (bench_cases); i++) {
+        gchar *test_path;
+
+        test_path = g_strdup_printf ("/qmi-firmware-update/bench/%s", bench_cases[i].name);
+        g_test_add_data_func (test_path, &bench_cases[i], (GTestDataFunc) bench_download);
+        g_free (test_path);
+    }
+
+    result = g_test_run ();
+
+    g_object_unref (image);
+    unlink (path);
+    g_free (path);
+    return result;
+}
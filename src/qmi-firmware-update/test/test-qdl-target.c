@@ -0,0 +1,530 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * qmi-firmware-update -- Command line tool to update firmware in QMI devices
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#define _GNU_SOURCE
+#include <config.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "qfu-utils.h"
+#include "qfu-image.h"
+#include "qfu-qdl-message.h"
+#include "qfu-dload-message.h"
+#include "test-qdl-target.h"
+
+#define READ_BUFFER_SIZE 65536
+#define CONTROL          0x7e
+
+/* Unframed ufwrite request header: cmd, sequence, reserved, chunk size and
+ * the crc of all the previous fields */
+#define UFWRITE_HEADER_SIZE 13
+
+/* Error codes reported in QDL error responses */
+#define QDL_ERROR_BAD_CRC         0x17
+#define QDL_ERROR_CMD_UNSUPPORTED 0x16
+#define QDL_ERROR_STATE           0x18
+
+typedef struct {
+    gint64      due;
+    GByteArray *data;
+} Response;
+
+struct _TestQdlTarget {
+    gchar   *name;
+    gint     pty_master;
+    gint     pty_slave;
+    gint     stop_pipe[2];
+    GThread *thread;
+
+    guint    latency_us;
+    guint    chunk_processing_us;
+    guint8   window_size;
+
+    /* Only used in the target thread */
+    GByteArray *buffer;
+    GByteArray *unframed;
+    GQueue     *responses;
+    gint64      busy_until;
+    gboolean    session_open;
+
+    /* Statistics */
+    GMutex   stats_mutex;
+    guint    n_chunks;
+    guint64  n_bytes;
+    guint    n_errors;
+    guint    n_resets;
+};
+
+/*****************************************************************************/
+/* Responses */
+
+static void
+response_free (Response *response)
+{
+    g_byte_array_unref (response->data);
+    g_slice_free (Response, response);
+}
+
+/* Responses are always given in order, as they're all delayed by the same
+ * latency after the previous chunks are processed */
+static void
+queue_response (TestQdlTarget *target,
+                gint64         ready_time,
+                const guint8  *rsp,
+                gsize          rsp_size)
+{
+    Response *response;
+    gsize     framed_size;
+
+    response = g_slice_new (Response);
+    response->due = ready_time + target->latency_us;
+    response->data = g_byte_array_sized_new (qfu_utils_hdlc_max_framed_size (rsp_size));
+    g_byte_array_set_size (response->data, qfu_utils_hdlc_max_framed_size (rsp_size));
+    framed_size = qfu_utils_hdlc_frame (rsp, rsp_size, response->data->data, response->data->len);
+    g_byte_array_set_size (response->data, framed_size);
+
+    /* Keep ordered even if the clock resolution is coarse */
+    if (!g_queue_is_empty (target->responses)) {
+        Response *last;
+
+        last = g_queue_peek_tail (target->responses);
+        response->due = MAX (response->due, last->due);
+    }
+    g_queue_push_tail (target->responses, response);
+}
+
+static void
+queue_error_response (TestQdlTarget *target,
+                      gint64         now,
+                      guint32        error_code)
+{
+    guint8 rsp[6] = { QFU_QDL_CMD_ERROR };
+
+    rsp[1] = error_code & 0xff;
+    rsp[2] = (error_code >> 8) & 0xff;
+    rsp[3] = (error_code >> 16) & 0xff;
+    rsp[4] = (error_code >> 24) & 0xff;
+    queue_response (target, now, rsp, sizeof (rsp));
+
+    g_mutex_lock (&target->stats_mutex);
+    target->n_errors++;
+    g_mutex_unlock (&target->stats_mutex);
+}
+
+static gboolean
+write_due_responses (TestQdlTarget *target,
+                     gint64         now)
+{
+    Response *response;
+
+    while ((response = g_queue_peek_head (target->responses)) && response->due <= now) {
+        gsize written = 0;
+
+        while (written < response->data->len) {
+            gssize wlen;
+
+            wlen = write (target->pty_master, response->data->data + written, response->data->len - written);
+            if (wlen < 0) {
+                if (errno == EINTR)
+                    continue;
+                g_warning ("couldn't write QDL response: %s", g_strerror (errno));
+                return FALSE;
+            }
+            written += wlen;
+        }
+
+        response_free (g_queue_pop_head (target->responses));
+    }
+    return TRUE;
+}
+
+/*****************************************************************************/
+/* Requests */
+
+static void
+process_framed_request (TestQdlTarget *target,
+                        gint64         now,
+                        const guint8  *req,
+                        gsize          req_size)
+{
+    switch (req[0]) {
+    case QFU_DLOAD_CMD_SDP: {
+        static const guint8 rsp[] = { QFU_DLOAD_CMD_ACK };
+
+        queue_response (target, now, rsp, sizeof (rsp));
+        return;
+    }
+    case QFU_QDL_CMD_HELLO_REQ: {
+        static const gchar magic[] = "QCOM high speed protocol hst";
+        guint8             rsp[49] = { QFU_QDL_CMD_HELLO_RSP };
+
+        /* cmd, magic, maximum and minimum version, features */
+        if (req_size < 36)
+            break;
+        memcpy (&rsp[1], magic, sizeof (magic) - 1);
+        rsp[33] = req[33];
+        rsp[34] = req[34];
+        rsp[48] = req[35];
+        queue_response (target, now, rsp, sizeof (rsp));
+        return;
+    }
+    case QFU_QDL_CMD_OPEN_UNFRAMED_REQ: {
+        guint8 rsp[8] = { QFU_QDL_CMD_OPEN_UNFRAMED_RSP };
+
+        /* Windows larger than the one of the target are accepted, acks are
+         * just delayed by the processing time then */
+        target->session_open = TRUE;
+        rsp[3] = target->window_size;
+        rsp[4] = QFU_IMAGE_CHUNK_SIZE & 0xff;
+        rsp[5] = (QFU_IMAGE_CHUNK_SIZE >> 8) & 0xff;
+        rsp[6] = (QFU_IMAGE_CHUNK_SIZE >> 16) & 0xff;
+        rsp[7] = (QFU_IMAGE_CHUNK_SIZE >> 24) & 0xff;
+        queue_response (target, now, rsp, sizeof (rsp));
+        return;
+    }
+    case QFU_QDL_CMD_CLOSE_UNFRAMED_REQ: {
+        guint8 rsp[5] = { QFU_QDL_CMD_CLOSE_UNFRAMED_RSP };
+
+        if (!target->session_open) {
+            queue_error_response (target, now, QDL_ERROR_STATE);
+            return;
+        }
+
+        /* Closing is answered once all chunks are processed */
+        target->session_open = FALSE;
+        queue_response (target, MAX (now, target->busy_until), rsp, sizeof (rsp));
+        return;
+    }
+    case QFU_QDL_CMD_RESET_REQ:
+        /* No response */
+        target->session_open = FALSE;
+        g_mutex_lock (&target->stats_mutex);
+        target->n_resets++;
+        g_mutex_unlock (&target->stats_mutex);
+        return;
+    default:
+        break;
+    }
+
+    queue_error_response (target, now, QDL_ERROR_CMD_UNSUPPORTED);
+}
+
+static void
+process_ufwrite_request (TestQdlTarget *target,
+                         gint64         now,
+                         const guint8  *req,
+                         gsize          chunk_size)
+{
+    guint8  rsp[9] = { QFU_QDL_CMD_WRITE_UNFRAMED_RSP };
+    guint16 crc;
+
+    crc = req[11] | (req[12] << 8);
+    if (crc != qfu_utils_crc16 (req, UFWRITE_HEADER_SIZE - 2)) {
+        queue_error_response (target, now, QDL_ERROR_BAD_CRC);
+        return;
+    }
+    if (!target->session_open) {
+        queue_error_response (target, now, QDL_ERROR_STATE);
+        return;
+    }
+
+    /* Chunks are processed one after the other */
+    target->busy_until = MAX (now, target->busy_until) + target->chunk_processing_us;
+
+    rsp[1] = req[1];
+    rsp[2] = req[2];
+    queue_response (target, target->busy_until, rsp, sizeof (rsp));
+
+    g_mutex_lock (&target->stats_mutex);
+    target->n_chunks++;
+    target->n_bytes += chunk_size;
+    g_mutex_unlock (&target->stats_mutex);
+}
+
+/* Processes all full requests in the buffer, returns the number of bytes
+ * used */
+static gsize
+process_requests (TestQdlTarget *target,
+                  gint64         now)
+{
+    gsize offset = 0;
+
+    while (offset < target->buffer->len) {
+        const guint8 *start;
+        gsize         available;
+
+        start = target->buffer->data + offset;
+        available = target->buffer->len - offset;
+
+        /* Unframed ufwrite: header and chunk */
+        if (start[0] == QFU_QDL_CMD_WRITE_UNFRAMED_REQ) {
+            guint32 chunk_size;
+
+            if (available < UFWRITE_HEADER_SIZE)
+                break;
+            chunk_size = start[7] | (start[8] << 8) | (start[9] << 16) | ((guint32) start[10] << 24);
+            if (available < UFWRITE_HEADER_SIZE + chunk_size)
+                break;
+            process_ufwrite_request (target, now, start, chunk_size);
+            offset += UFWRITE_HEADER_SIZE + chunk_size;
+            continue;
+        }
+
+        /* HDLC framed request */
+        if (start[0] == CONTROL) {
+            const guint8 *end;
+            gsize         frame_size;
+            gsize         unframed_size;
+            GError       *error = NULL;
+
+            end = available > 1 ? memchr (start + 1, CONTROL, available - 1) : NULL;
+            if (!end)
+                break;
+            frame_size = end - start + 1;
+            offset += frame_size;
+
+            /* Consecutive control characters */
+            if (frame_size < 5)
+                continue;
+
+            if (qfu_utils_hdlc_max_unframed_size (frame_size) > target->unframed->len)
+                g_byte_array_set_size (target->unframed, qfu_utils_hdlc_max_unframed_size (frame_size));
+            unframed_size = qfu_utils_hdlc_unframe (start, frame_size, target->unframed->data, target->unframed->len, &error);
+            if (!unframed_size) {
+                g_debug ("[qdl-target] invalid frame: %s", error->message);
+                g_error_free (error);
+                queue_error_response (target, now, QDL_ERROR_BAD_CRC);
+                continue;
+            }
+            process_framed_request (target, now, target->unframed->data, unframed_size);
+            continue;
+        }
+
+        /* Garbage */
+        g_mutex_lock (&target->stats_mutex);
+        target->n_errors++;
+        g_mutex_unlock (&target->stats_mutex);
+        offset++;
+    }
+
+    return offset;
+}
+
+/*****************************************************************************/
+
+static gpointer
+target_thread_func (TestQdlTarget *target)
+{
+    guint8 *read_buffer;
+
+    read_buffer = g_malloc (READ_BUFFER_SIZE);
+
+    for (;;) {
+        fd_set          rd;
+        struct timeval  tv;
+        struct timeval *timeout = NULL;
+        Response       *next;
+        gint64          now;
+        gint            aux;
+
+        now = g_get_monotonic_time ();
+        if (!write_due_responses (target, now))
+            break;
+
+        /* Wait until the next response is due, or until more data arrives */
+        next = g_queue_peek_head (target->responses);
+        if (next) {
+            tv.tv_sec  = (next->due - now) / G_USEC_PER_SEC;
+            tv.tv_usec = (next->due - now) % G_USEC_PER_SEC;
+            timeout = &tv;
+        }
+
+        FD_ZERO (&rd);
+        FD_SET (target->pty_master, &rd);
+        FD_SET (target->stop_pipe[0], &rd);
+        aux = select (MAX (target->pty_master, target->stop_pipe[0]) + 1, &rd, NULL, NULL, timeout);
+        if (aux < 0) {
+            if (errno == EINTR)
+                continue;
+            g_warning ("couldn't wait for QDL requests: %s", g_strerror (errno));
+            break;
+        }
+
+        if (FD_ISSET (target->stop_pipe[0], &rd))
+            break;
+
+        if (FD_ISSET (target->pty_master, &rd)) {
+            gssize rlen;
+            gsize  used;
+
+            rlen = read (target->pty_master, read_buffer, READ_BUFFER_SIZE);
+            if (rlen < 0) {
+                if (errno == EINTR || errno == EAGAIN)
+                    continue;
+                g_warning ("couldn't read QDL requests: %s", g_strerror (errno));
+                break;
+            }
+
+            g_byte_array_append (target->buffer, read_buffer, rlen);
+            used = process_requests (target, g_get_monotonic_time ());
+            if (used > 0)
+                g_byte_array_remove_range (target->buffer, 0, used);
+        }
+    }
+
+    g_free (read_buffer);
+    return NULL;
+}
+
+void
+test_qdl_target_start (TestQdlTarget *target)
+{
+    g_assert (target->thread == NULL);
+    target->thread = g_thread_new ("qdl-target", (GThreadFunc) target_thread_func, target);
+}
+
+void
+test_qdl_target_stop (TestQdlTarget *target)
+{
+    static const guint8 stop = 0;
+
+    g_assert (target->thread != NULL);
+    if (write (target->stop_pipe[1], &stop, sizeof (stop)) != sizeof (stop))
+        g_error ("Cannot stop QDL target: %s", g_strerror (errno));
+    g_thread_join (target->thread);
+    target->thread = NULL;
+}
+
+/*****************************************************************************/
+
+guint
+test_qdl_target_get_n_chunks (TestQdlTarget *target)
+{
+    guint n_chunks;
+
+    g_mutex_lock (&target->stats_mutex);
+    n_chunks = target->n_chunks;
+    g_mutex_unlock (&target->stats_mutex);
+    return n_chunks;
+}
+
+guint64
+test_qdl_target_get_n_bytes (TestQdlTarget *target)
+{
+    guint64 n_bytes;
+
+    g_mutex_lock (&target->stats_mutex);
+    n_bytes = target->n_bytes;
+    g_mutex_unlock (&target->stats_mutex);
+    return n_bytes;
+}
+
+guint
+test_qdl_target_get_n_errors (TestQdlTarget *target)
+{
+    guint n_errors;
+
+    g_mutex_lock (&target->stats_mutex);
+    n_errors = target->n_errors;
+    g_mutex_unlock (&target->stats_mutex);
+    return n_errors;
+}
+
+guint
+test_qdl_target_get_n_resets (TestQdlTarget *target)
+{
+    guint n_resets;
+
+    g_mutex_lock (&target->stats_mutex);
+    n_resets = target->n_resets;
+    g_mutex_unlock (&target->stats_mutex);
+    return n_resets;
+}
+
+/*****************************************************************************/
+
+const gchar *
+test_qdl_target_get_name (TestQdlTarget *target)
+{
+    return target->name;
+}
+
+void
+test_qdl_target_free (TestQdlTarget *target)
+{
+    g_assert (target->thread == NULL);
+
+    g_queue_free_full (target->responses, (GDestroyNotify) response_free);
+    g_byte_array_unref (target->buffer);
+    g_byte_array_unref (target->unframed);
+    g_mutex_clear (&target->stats_mutex);
+    close (target->stop_pipe[0]);
+    close (target->stop_pipe[1]);
+    close (target->pty_slave);
+    close (target->pty_master);
+    g_free (target->name);
+    g_slice_free (TestQdlTarget, target);
+}
+
+TestQdlTarget *
+test_qdl_target_new (guint  latency_us,
+                     guint  chunk_processing_us,
+                     guint8 window_size)
+{
+    TestQdlTarget  *target;
+    struct termios  options;
+    const gchar    *slave_name;
+    gint            master;
+
+    master = posix_openpt (O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt (master) < 0 || unlockpt (master) < 0 || !(slave_name = ptsname (master)))
+        g_error ("Cannot create pseudo terminal: %s", g_strerror (errno));
+
+    target = g_slice_new0 (TestQdlTarget);
+    target->name = g_strdup (slave_name);
+    target->pty_master = master;
+    target->latency_us = latency_us;
+    target->chunk_processing_us = chunk_processing_us;
+    target->window_size = window_size;
+    target->buffer = g_byte_array_sized_new (QFU_QDL_MESSAGE_MAX_SIZE (QFU_IMAGE_CHUNK_SIZE));
+    target->unframed = g_byte_array_sized_new (QFU_QDL_MESSAGE_MAX_HEADER_SIZE);
+    target->responses = g_queue_new ();
+    g_mutex_init (&target->stats_mutex);
+
+    if (pipe (target->stop_pipe) < 0)
+        g_error ("Cannot create pipe: %s", g_strerror (errno));
+
+    /* Keep the slave always open, so that the master never reports a hangup
+     * while the device is closed, and don't allow any kind of processing of
+     * the data between both ends */
+    target->pty_slave = open (slave_name, O_RDWR | O_NOCTTY);
+    if (target->pty_slave < 0 || tcgetattr (target->pty_slave, &options) < 0)
+        g_error ("Cannot open pseudo terminal '%s': %s", slave_name, g_strerror (errno));
+    cfmakeraw (&options);
+    if (tcsetattr (target->pty_slave, TCSANOW, &options) < 0)
+        g_error ("Cannot setup pseudo terminal '%s': %s", slave_name, g_strerror (errno));
+
+    return target;
+}
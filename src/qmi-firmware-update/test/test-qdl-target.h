@@ -0,0 +1,54 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * qmi-firmware-update -- Command line tool to update firmware in QMI devices
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef TEST_QDL_TARGET_H
+#define TEST_QDL_TARGET_H
+
+#include <glib.h>
+
+/*
+ * Simulated QDL download target behind a pseudo terminal, answering the
+ * DLOAD SDP, hello, ufopen, ufwrite, ufclose and reset requests in its own
+ * thread, so that a QfuQdlDevice can be opened on the slave side as if it
+ * were the serial port of a real modem in QDL mode.
+ *
+ * Every response is written once the given latency has elapsed since the
+ * request was received. Chunks are processed one after the other, each one
+ * taking the given processing time, so that the acks of the chunks in
+ * flight are delayed by the ones before them.
+ */
+
+typedef struct _TestQdlTarget TestQdlTarget;
+
+TestQdlTarget *test_qdl_target_new           (guint          latency_us,
+                                              guint          chunk_processing_us,
+                                              guint8         window_size);
+const gchar   *test_qdl_target_get_name      (TestQdlTarget *target);
+void           test_qdl_target_start         (TestQdlTarget *target);
+void           test_qdl_target_stop          (TestQdlTarget *target);
+void           test_qdl_target_free          (TestQdlTarget *target);
+
+/* Statistics, updated by the target thread */
+guint          test_qdl_target_get_n_chunks  (TestQdlTarget *target);
+guint64        test_qdl_target_get_n_bytes   (TestQdlTarget *target);
+guint          test_qdl_target_get_n_errors  (TestQdlTarget *target);
+guint          test_qdl_target_get_n_resets  (TestQdlTarget *target);
+
+#endif /* TEST_QDL_TARGET_H */
@@ -19,6 +19,8 @@
  * Copyright (C) 2016 Aleksander Morgado <aleksander@aleksander.es>
  */
 
+#include <string.h>
+
 #include "qfu-utils.h"
 
 /******************************************************************************/
@@ -90,6 +92,322 @@ test_cwe_version_parser_mc7354b_spk (void)
 
 /******************************************************************************/
 
+/* Plain bit by bit implementations, as reference */
+
+static guint16
+reference_crc16 (const guint8 *buffer,
+                 gsize         len)
+{
+    guint16 crc = 0xffff;
+    guint   i;
+
+    while (len--) {
+        crc ^= *buffer++;
+        for (i = 0; i < 8; i++)
+            crc = (crc & 1) ? ((crc >> 1) ^ 0x8408) : (crc >> 1);
+    }
+    return ~crc;
+}
+
+static guint32
+reference_crc32 (guint32       crc,
+                 const guint8 *buffer,
+                 gsize         len)
+{
+    guint i;
+
+    while (len--) {
+        crc ^= *buffer++;
+        for (i = 0; i < 8; i++)
+            crc = (crc & 1) ? ((crc >> 1) ^ 0xedb88320) : (crc >> 1);
+    }
+    return crc;
+}
+
+static gsize
+reference_hdlc_frame (const guint8 *in,
+                      gsize         inlen,
+                      guint8       *out)
+{
+    guint16 crc;
+    guint8  crc_bytes[2];
+    gsize   i, j = 0;
+
+    crc = reference_crc16 (in, inlen);
+    crc_bytes[0] = crc & 0xff;
+    crc_bytes[1] = crc >> 8;
+
+    out[j++] = 0x7e;
+    for (i = 0; i < inlen + 2; i++) {
+        guint8 byte;
+
+        byte = (i < inlen ? in[i] : crc_bytes[i - inlen]);
+        if (byte == 0x7e || byte == 0x7d) {
+            out[j++] = 0x7d;
+            out[j++] = byte ^ 0x20;
+        } else
+            out[j++] = byte;
+    }
+    out[j++] = 0x7e;
+    return j;
+}
+
+/* Random data, with plenty of bytes to escape */
+static GByteArray *
+build_hdlc_test_data (GRand *rand,
+                      gsize  len)
+{
+    GByteArray *data;
+    gsize       i;
+
+    data = g_byte_array_sized_new (len);
+    g_byte_array_set_size (data, len);
+    for (i = 0; i < len; i++) {
+        switch (g_rand_int_range (rand, 0, 16)) {
+        case 0:
+            data->data[i] = 0x7e;
+            break;
+        case 1:
+            data->data[i] = 0x7d;
+            break;
+        default:
+            data->data[i] = (guint8) g_rand_int_range (rand, 0, 256);
+            break;
+        }
+    }
+    return data;
+}
+
+static void
+test_crc16 (void)
+{
+    GRand *rand;
+    guint  len;
+
+    rand = g_rand_new_with_seed (0x7e7d);
+    for (len = 0; len < 300; len++) {
+        GByteArray *data;
+
+        data = build_hdlc_test_data (rand, len);
+        g_assert_cmpuint (qfu_utils_crc16 (data->data, data->len), ==, reference_crc16 (data->data, data->len));
+        g_byte_array_unref (data);
+    }
+    g_rand_free (rand);
+}
+
+static void
+test_crc32 (void)
+{
+    static const guint8 check[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    GRand *rand;
+    guint  len;
+
+    /* Standard CRC-32 check value, once initialized and inverted */
+    g_assert_cmphex (~qfu_utils_crc32 (0xffffffff, check, sizeof (check)), ==, 0xcbf43926);
+
+    rand = g_rand_new_with_seed (0x7e7d);
+    for (len = 0; len < 300; len++) {
+        GByteArray *data;
+        guint32     crc;
+
+        data = build_hdlc_test_data (rand, len);
+        g_assert_cmphex (qfu_utils_crc32 (0xffffffff, data->data, data->len), ==, reference_crc32 (0xffffffff, data->data, data->len));
+
+        /* Computing it in two steps gives the same result */
+        crc = qfu_utils_crc32 (0xffffffff, data->data, len / 3);
+        crc = qfu_utils_crc32 (crc, data->data + len / 3, len - len / 3);
+        g_assert_cmphex (crc, ==, reference_crc32 (0xffffffff, data->data, data->len));
+        g_byte_array_unref (data);
+    }
+    g_rand_free (rand);
+}
+
+static void
+test_hdlc (void)
+{
+    GRand  *rand;
+    guint   len;
+    guint8 *framed;
+    guint8 *reference;
+    guint8 *unframed;
+
+    framed    = g_malloc (qfu_utils_hdlc_max_framed_size (1024));
+    reference = g_malloc (qfu_utils_hdlc_max_framed_size (1024));
+    unframed  = g_malloc (qfu_utils_hdlc_max_framed_size (1024));
+
+    rand = g_rand_new_with_seed (0x7d7e);
+    for (len = 0; len < 1024; len++) {
+        GByteArray *data;
+        GError     *error = NULL;
+        gsize       framed_size;
+        gsize       unframed_size;
+
+        data = build_hdlc_test_data (rand, len);
+
+        framed_size = qfu_utils_hdlc_frame (data->data, data->len, framed, qfu_utils_hdlc_max_framed_size (len));
+        g_assert_cmpuint (framed_size, ==, reference_hdlc_frame (data->data, data->len, reference));
+        g_assert (memcmp (framed, reference, framed_size) == 0);
+
+        unframed_size = qfu_utils_hdlc_unframe (framed, framed_size, unframed, qfu_utils_hdlc_max_unframed_size (framed_size), &error);
+        g_assert_no_error (error);
+        g_assert_cmpuint (unframed_size, ==, len);
+        g_assert (memcmp (unframed, data->data, len) == 0);
+
+        /* Any change in the payload must be detected */
+        if (len > 0) {
+            framed[1] = (framed[1] == 0x00 ? 0x01 : 0x00);
+            g_assert_cmpuint (qfu_utils_hdlc_unframe (framed, framed_size, unframed, qfu_utils_hdlc_max_unframed_size (framed_size), &error), ==, 0);
+            g_assert_error (error, G_IO_ERROR, G_IO_ERROR_FAILED);
+            g_clear_error (&error);
+        }
+
+        g_byte_array_unref (data);
+    }
+    g_rand_free (rand);
+
+    g_free (framed);
+    g_free (reference);
+    g_free (unframed);
+}
+
+/* Only run in perf mode, e.g. gtester -m perf */
+static void
+test_hdlc_benchmark (void)
+{
+    GRand      *rand;
+    GByteArray *data;
+    guint8     *framed;
+    guint8     *unframed;
+    gsize       framed_size = 0;
+    gdouble     elapsed;
+    guint       i;
+
+#define BENCHMARK_SIZE       (1024 * 1024)
+#define BENCHMARK_ITERATIONS 20
+
+    if (!g_test_perf ())
+        return;
+
+    rand = g_rand_new_with_seed (0x7e7e);
+    data = build_hdlc_test_data (rand, BENCHMARK_SIZE);
+    framed = g_malloc (qfu_utils_hdlc_max_framed_size (BENCHMARK_SIZE));
+    unframed = g_malloc (qfu_utils_hdlc_max_framed_size (BENCHMARK_SIZE));
+
+    g_test_timer_start ();
+    for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+        reference_hdlc_frame (data->data, data->len, framed);
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result (elapsed / BENCHMARK_ITERATIONS, "reference frame of 1 MiB: %.6lfs", elapsed / BENCHMARK_ITERATIONS);
+
+    g_test_timer_start ();
+    for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+        framed_size = qfu_utils_hdlc_frame (data->data, data->len, framed, qfu_utils_hdlc_max_framed_size (BENCHMARK_SIZE));
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result (elapsed / BENCHMARK_ITERATIONS, "frame of 1 MiB: %.6lfs", elapsed / BENCHMARK_ITERATIONS);
+
+    g_test_timer_start ();
+    for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+        g_assert_cmpuint (qfu_utils_hdlc_unframe (framed, framed_size, unframed, qfu_utils_hdlc_max_unframed_size (framed_size), NULL), ==, BENCHMARK_SIZE);
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result (elapsed / BENCHMARK_ITERATIONS, "unframe of 1 MiB: %.6lfs", elapsed / BENCHMARK_ITERATIONS);
+
+    g_test_timer_start ();
+    for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+        reference_crc16 (data->data, data->len);
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result (elapsed / BENCHMARK_ITERATIONS, "reference crc16 of 1 MiB: %.6lfs", elapsed / BENCHMARK_ITERATIONS);
+
+    g_test_timer_start ();
+    for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+        qfu_utils_crc16 (data->data, data->len);
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result (elapsed / BENCHMARK_ITERATIONS, "crc16 of 1 MiB: %.6lfs", elapsed / BENCHMARK_ITERATIONS);
+
+#undef BENCHMARK_SIZE
+#undef BENCHMARK_ITERATIONS
+
+    g_free (framed);
+    g_free (unframed);
+    g_byte_array_unref (data);
+    g_rand_free (rand);
+}
+
+/******************************************************************************/
+
+/* Metadata of a 10240 byte image (bytes 0x00 to 0xff, 40 times) */
+
+static void
+test_compressed_size_gzip (void)
+{
+    static const guint8 trailer[] = { 0x00, 0x28, 0x00, 0x00 };
+    static const guint8 empty[]   = { 0x00, 0x00, 0x00, 0x00 };
+    GError  *error = NULL;
+    goffset  size = 0;
+
+    g_assert (qfu_utils_gzip_get_uncompressed_size (trailer, sizeof (trailer), &size, &error));
+    g_assert_no_error (error);
+    g_assert_cmpint (size, ==, 10240);
+
+    g_assert (!qfu_utils_gzip_get_uncompressed_size (empty, sizeof (empty), &size, &error));
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+    g_clear_error (&error);
+}
+
+static void
+test_compressed_size_xz (void)
+{
+    static const guint8 footer[] = {
+        0x3e, 0x30, 0x0d, 0x8b, 0x02, 0x00, 0x00, 0x00, 0x00, 0x01, 0x59, 0x5a
+    };
+    static const guint8 index[] = {
+        0x00, 0x01, 0xab, 0x02, 0x80, 0x50, 0x00, 0x00, 0x1b, 0xfe, 0xab, 0x4b
+    };
+    guint8   corrupted[sizeof (footer)];
+    GError  *error = NULL;
+    gsize    index_size = 0;
+    goffset  size = 0;
+
+    g_assert (qfu_utils_xz_get_index_size (footer, sizeof (footer), &index_size, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (index_size, ==, sizeof (index));
+
+    g_assert (qfu_utils_xz_get_uncompressed_size (index, sizeof (index), &size, &error));
+    g_assert_no_error (error);
+    g_assert_cmpint (size, ==, 10240);
+
+    /* Footer CRC mismatch */
+    memcpy (corrupted, footer, sizeof (footer));
+    corrupted[4] = 0x03;
+    g_assert (!qfu_utils_xz_get_index_size (corrupted, sizeof (corrupted), &index_size, &error));
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+    g_clear_error (&error);
+}
+
+static void
+test_compressed_size_zstd (void)
+{
+    /* Single segment, 2-byte frame content size */
+    static const guint8 header[]       = { 0x28, 0xb5, 0x2f, 0xfd, 0x60, 0x00, 0x27 };
+    /* Window descriptor, no frame content size */
+    static const guint8 header_nofcs[] = { 0x28, 0xb5, 0x2f, 0xfd, 0x00, 0x58 };
+    GError  *error = NULL;
+    goffset  size = 0;
+
+    g_assert (qfu_utils_zstd_get_uncompressed_size (header, sizeof (header), &size, &error));
+    g_assert_no_error (error);
+    g_assert_cmpint (size, ==, 10240);
+
+    g_assert (!qfu_utils_zstd_get_uncompressed_size (header_nofcs, sizeof (header_nofcs), &size, &error));
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED);
+    g_clear_error (&error);
+
+    g_assert (!qfu_utils_zstd_get_uncompressed_size (header, sizeof (header) - 1, &size, &error));
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+    g_clear_error (&error);
+}
+
+/******************************************************************************/
+
 int main (int argc, char **argv)
 {
     g_test_init (&argc, &argv, NULL);
@@ -98,6 +416,13 @@ int main (int argc, char **argv)
     g_test_add_func ("/qmi-firmware-update/cwe-version-parser/mc7354/cwe",  test_cwe_version_parser_mc7354_cwe);
     g_test_add_func ("/qmi-firmware-update/cwe-version-parser/mc7354/nvu",  test_cwe_version_parser_mc7354_nvu);
     g_test_add_func ("/qmi-firmware-update/cwe-version-parser/mc7354b/spk", test_cwe_version_parser_mc7354b_spk);
+    g_test_add_func ("/qmi-firmware-update/crc16",                          test_crc16);
+    g_test_add_func ("/qmi-firmware-update/crc32",                          test_crc32);
+    g_test_add_func ("/qmi-firmware-update/hdlc",                           test_hdlc);
+    g_test_add_func ("/qmi-firmware-update/hdlc/benchmark",                 test_hdlc_benchmark);
+    g_test_add_func ("/qmi-firmware-update/compressed-size/gzip",           test_compressed_size_gzip);
+    g_test_add_func ("/qmi-firmware-update/compressed-size/xz",             test_compressed_size_xz);
+    g_test_add_func ("/qmi-firmware-update/compressed-size/zstd",           test_compressed_size_zstd);
 
     return g_test_run ();
 }
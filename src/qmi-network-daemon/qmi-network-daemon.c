@@ -0,0 +1,845 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * qmi-network-daemon -- Keep a QMI network connection up
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <locale.h>
+#include <string.h>
+#include <unistd.h>
+#if defined QMI_USERNAME_ENABLED
+# include <pwd.h>
+#endif
+
+#include <glib.h>
+#include <glib/gprintf.h>
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+#include <glib-unix.h>
+
+#include <libqmi-glib.h>
+
+#define PROGRAM_NAME    "qmi-network-daemon"
+#define PROGRAM_VERSION PACKAGE_VERSION
+
+/* Abstract socket name prefix, the device path is appended */
+#define SOCKET_NAME_PREFIX "qmi-network-daemon:"
+
+/* Same timeout as used by qmicli */
+#define START_NETWORK_TIMEOUT 45
+
+/* Time to wait before retrying to connect, if the connection attempt failed */
+#define RECONNECT_TIMEOUT_SECS 5
+
+/* Globals */
+static GMainLoop      *loop;
+static QmiDevice      *device;
+static QmiClientWds   *client;
+static GSocketService *service;
+
+/* Connection state */
+typedef enum {
+    CONNECTION_STATE_DISCONNECTED,
+    CONNECTION_STATE_CONNECTING,
+    CONNECTION_STATE_CONNECTED,
+    CONNECTION_STATE_DISCONNECTING,
+} ConnectionState;
+
+static ConnectionState  state;
+static gboolean         connection_wanted;
+static guint32          packet_data_handle;
+static guint            reconnect_id;
+static GList           *waiting_connections;
+
+/* Main options */
+static gchar    *device_str;
+static gboolean  device_open_proxy_flag;
+static gchar    *apn_str;
+static gchar    *username_str;
+static gchar    *password_str;
+static gint      ip_type_int;
+static gboolean  start_flag;
+static gboolean  stop_flag;
+static gboolean  status_flag;
+static gboolean  verbose_flag;
+static gboolean  version_flag;
+
+static GOptionEntry main_entries[] = {
+    { "device", 'd', 0, G_OPTION_ARG_STRING, &device_str,
+      "Specify device path",
+      "[PATH]"
+    },
+    { "device-open-proxy", 'p', 0, G_OPTION_ARG_NONE, &device_open_proxy_flag,
+      "Request to use the 'qmi-proxy' proxy",
+      NULL
+    },
+    { "apn", 0, 0, G_OPTION_ARG_STRING, &apn_str,
+      "APN to connect to",
+      "[APN]"
+    },
+    { "username", 0, 0, G_OPTION_ARG_STRING, &username_str,
+      "APN user name",
+      "[USERNAME]"
+    },
+    { "password", 0, 0, G_OPTION_ARG_STRING, &password_str,
+      "APN password",
+      "[PASSWORD]"
+    },
+    { "ip-type", 0, 0, G_OPTION_ARG_INT, &ip_type_int,
+      "IP family to request",
+      "[4|6]"
+    },
+    { "start", 0, 0, G_OPTION_ARG_NONE, &start_flag,
+      "Request the daemon handling the device to start the network connection",
+      NULL
+    },
+    { "stop", 0, 0, G_OPTION_ARG_NONE, &stop_flag,
+      "Request the daemon handling the device to stop the network connection",
+      NULL
+    },
+    { "status", 0, 0, G_OPTION_ARG_NONE, &status_flag,
+      "Query the network connection status to the daemon handling the device",
+      NULL
+    },
+    { "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose_flag,
+      "Run action with verbose logs, including the debug ones",
+      NULL
+    },
+    { "version", 'V', 0, G_OPTION_ARG_NONE, &version_flag,
+      "Print version",
+      NULL
+    },
+    { NULL }
+};
+
+static void
+log_handler (const gchar *log_domain,
+             GLogLevelFlags log_level,
+             const gchar *message,
+             gpointer user_data)
+{
+    const gchar *log_level_str;
+    time_t now;
+    gchar time_str[64];
+    struct tm *local_time;
+    gboolean err;
+
+    now = time ((time_t *) NULL);
+    local_time = localtime (&now);
+    strftime (time_str, 64, "%d %b %Y, %H:%M:%S", local_time);
+    err = FALSE;
+
+    switch (log_level) {
+    case G_LOG_LEVEL_WARNING:
+        log_level_str = "-Warning **";
+        err = TRUE;
+        break;
+
+    case G_LOG_LEVEL_CRITICAL:
+    case G_LOG_FLAG_FATAL:
+    case G_LOG_LEVEL_ERROR:
+        log_level_str = "-Error **";
+        err = TRUE;
+        break;
+
+    case G_LOG_LEVEL_DEBUG:
+        log_level_str = "[Debug]";
+        break;
+
+    default:
+        log_level_str = "";
+        break;
+    }
+
+    if (!verbose_flag && !err && log_level != G_LOG_LEVEL_MESSAGE)
+        return;
+
+    g_fprintf (err ? stderr : stdout,
+               "[%s] %s %s\n",
+               time_str,
+               log_level_str,
+               message);
+}
+
+static void
+print_version_and_exit (void)
+{
+    g_print ("\n"
+             PROGRAM_NAME " " PROGRAM_VERSION "\n"
+             "Copyright (2018) Aleksander Morgado\n"
+             "License GPLv2+: GNU GPL version 2 or later <http://gnu.org/licenses/gpl-2.0.html>\n"
+             "This is free software: you are free to change and redistribute it.\n"
+             "There is NO WARRANTY, to the extent permitted by law.\n"
+             "\n");
+    exit (EXIT_SUCCESS);
+}
+
+static GSocketAddress *
+build_socket_address (void)
+{
+    GSocketAddress *address;
+    gchar          *name;
+
+    name = g_strdup_printf (SOCKET_NAME_PREFIX "%s", device_str);
+    address = g_unix_socket_address_new_with_type (name, -1, G_UNIX_SOCKET_ADDRESS_ABSTRACT);
+    g_free (name);
+    return address;
+}
+
+/*****************************************************************************/
+/* Client mode: send a single command to the running daemon */
+
+static int
+run_command (const gchar *command)
+{
+    GError            *error = NULL;
+    GSocketClient     *socket_client;
+    GSocketConnection *connection;
+    GSocketAddress    *address;
+    GDataInputStream  *input;
+    gchar             *request;
+    gchar             *line;
+    gboolean           success;
+
+    socket_client = g_socket_client_new ();
+    g_socket_client_set_family (socket_client, G_SOCKET_FAMILY_UNIX);
+    g_socket_client_set_socket_type (socket_client, G_SOCKET_TYPE_STREAM);
+    g_socket_client_set_protocol (socket_client, G_SOCKET_PROTOCOL_DEFAULT);
+
+    address = build_socket_address ();
+    connection = g_socket_client_connect (socket_client, G_SOCKET_CONNECTABLE (address), NULL, &error);
+    g_object_unref (address);
+    g_object_unref (socket_client);
+    if (!connection) {
+        g_printerr ("error: couldn't connect to the daemon handling '%s': %s\n", device_str, error->message);
+        g_error_free (error);
+        return EXIT_FAILURE;
+    }
+
+    request = g_strdup_printf ("%s\n", command);
+    success = g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (connection)),
+                                         request, strlen (request), NULL, NULL, &error);
+    g_free (request);
+    if (!success) {
+        g_printerr ("error: couldn't send command: %s\n", error->message);
+        g_error_free (error);
+        g_object_unref (connection);
+        return EXIT_FAILURE;
+    }
+
+    input = g_data_input_stream_new (g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+    line = g_data_input_stream_read_line (input, NULL, NULL, &error);
+    g_object_unref (input);
+    g_object_unref (connection);
+    if (!line) {
+        g_printerr ("error: couldn't read reply: %s\n", error ? error->message : "connection closed");
+        g_clear_error (&error);
+        return EXIT_FAILURE;
+    }
+
+    g_print ("%s\n", line);
+    success = !g_str_has_prefix (line, "error");
+    g_free (line);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*****************************************************************************/
+/* Replies to the commands */
+
+static const gchar *
+state_to_string (ConnectionState st)
+{
+    switch (st) {
+    case CONNECTION_STATE_DISCONNECTED:  return "disconnected";
+    case CONNECTION_STATE_CONNECTING:    return "connecting";
+    case CONNECTION_STATE_CONNECTED:     return "connected";
+    case CONNECTION_STATE_DISCONNECTING: return "disconnecting";
+    default:
+        g_assert_not_reached ();
+    }
+}
+
+static void
+reply_ready (GOutputStream     *output,
+             GAsyncResult      *res,
+             GSocketConnection *connection)
+{
+    GError *error = NULL;
+
+    if (!g_output_stream_write_all_finish (output, res, NULL, &error)) {
+        g_debug ("couldn't send reply: %s", error->message);
+        g_error_free (error);
+    }
+    g_io_stream_close (G_IO_STREAM (connection), NULL, NULL);
+    g_object_unref (connection);
+}
+
+/* Takes ownership of the connection */
+static void
+reply (GSocketConnection *connection,
+       const gchar       *message)
+{
+    gchar *line;
+
+    /* Keep the line valid as long as the connection */
+    line = g_strdup_printf ("%s\n", message);
+    g_object_set_data_full (G_OBJECT (connection), "reply", line, g_free);
+    g_output_stream_write_all_async (g_io_stream_get_output_stream (G_IO_STREAM (connection)),
+                                     line,
+                                     strlen (line),
+                                     G_PRIORITY_DEFAULT,
+                                     NULL,
+                                     (GAsyncReadyCallback) reply_ready,
+                                     connection);
+}
+
+static void
+reply_status (GSocketConnection *connection)
+{
+    gchar *message;
+
+    if (state == CONNECTION_STATE_CONNECTED)
+        message = g_strdup_printf ("%s handle=%u", state_to_string (state), packet_data_handle);
+    else
+        message = g_strdup (state_to_string (state));
+    reply (connection, message);
+    g_free (message);
+}
+
+/* Reply to all the start/stop commands waiting for the ongoing operation */
+static void
+reply_waiting (const gchar *error_message)
+{
+    GList *l;
+
+    for (l = waiting_connections; l; l = g_list_next (l)) {
+        if (error_message) {
+            gchar *message;
+
+            message = g_strdup_printf ("error: %s", error_message);
+            reply (G_SOCKET_CONNECTION (l->data), message);
+            g_free (message);
+        } else
+            reply_status (G_SOCKET_CONNECTION (l->data));
+    }
+    g_list_free (waiting_connections);
+    waiting_connections = NULL;
+}
+
+/*****************************************************************************/
+/* Connection handling */
+
+static void connect_network (void);
+
+static gboolean
+reconnect_cb (void)
+{
+    reconnect_id = 0;
+    connect_network ();
+    return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_reconnect (guint timeout_secs)
+{
+    if (reconnect_id)
+        return;
+
+    if (!timeout_secs)
+        reconnect_id = g_idle_add ((GSourceFunc) reconnect_cb, NULL);
+    else
+        reconnect_id = g_timeout_add_seconds (timeout_secs, (GSourceFunc) reconnect_cb, NULL);
+}
+
+static void
+start_network_ready (QmiClientWds *wds,
+                     GAsyncResult *res)
+{
+    QmiMessageWdsStartNetworkOutput *output;
+    GError                          *error = NULL;
+
+    output = qmi_client_wds_start_network_finish (wds, res, &error);
+    if (output &&
+        qmi_message_wds_start_network_output_get_result (output, &error) &&
+        qmi_message_wds_start_network_output_get_packet_data_handle (output, &packet_data_handle, &error)) {
+        g_message ("network connected (handle %u)", packet_data_handle);
+        state = CONNECTION_STATE_CONNECTED;
+        /* A stop may have been requested meanwhile */
+        if (connection_wanted)
+            reply_waiting (NULL);
+        else
+            connect_network ();
+    } else {
+        g_warning ("couldn't start network: %s", error->message);
+        state = CONNECTION_STATE_DISCONNECTED;
+        if (connection_wanted) {
+            reply_waiting (error->message);
+            /* Keep on trying while the connection is wanted */
+            schedule_reconnect (RECONNECT_TIMEOUT_SECS);
+        } else
+            reply_waiting (NULL);
+        g_error_free (error);
+    }
+
+    if (output)
+        qmi_message_wds_start_network_output_unref (output);
+}
+
+static void
+stop_network_ready (QmiClientWds *wds,
+                    GAsyncResult *res)
+{
+    QmiMessageWdsStopNetworkOutput *output;
+    GError                         *error = NULL;
+
+    output = qmi_client_wds_stop_network_finish (wds, res, &error);
+    if (!output || !qmi_message_wds_stop_network_output_get_result (output, &error)) {
+        g_warning ("couldn't stop network: %s", error->message);
+        state = CONNECTION_STATE_CONNECTED;
+        reply_waiting (connection_wanted ? NULL : error->message);
+        g_error_free (error);
+    } else {
+        g_message ("network disconnected");
+        state = CONNECTION_STATE_DISCONNECTED;
+        packet_data_handle = 0;
+        /* A start may have been requested meanwhile */
+        if (!connection_wanted)
+            reply_waiting (NULL);
+        else
+            connect_network ();
+    }
+
+    if (output)
+        qmi_message_wds_stop_network_output_unref (output);
+}
+
+/* Moves the connection towards the wanted state, if not already there or on
+ * the way */
+static void
+connect_network (void)
+{
+    if (connection_wanted && state == CONNECTION_STATE_DISCONNECTED) {
+        QmiMessageWdsStartNetworkInput *input;
+
+        if (reconnect_id) {
+            g_source_remove (reconnect_id);
+            reconnect_id = 0;
+        }
+
+        g_message ("connecting network...");
+        state = CONNECTION_STATE_CONNECTING;
+
+        input = qmi_message_wds_start_network_input_new ();
+        if (apn_str)
+            qmi_message_wds_start_network_input_set_apn (input, apn_str, NULL);
+        if (username_str)
+            qmi_message_wds_start_network_input_set_username (input, username_str, NULL);
+        if (password_str)
+            qmi_message_wds_start_network_input_set_password (input, password_str, NULL);
+        if (ip_type_int == 4)
+            qmi_message_wds_start_network_input_set_ip_family_preference (input, QMI_WDS_IP_FAMILY_IPV4, NULL);
+        else if (ip_type_int == 6)
+            qmi_message_wds_start_network_input_set_ip_family_preference (input, QMI_WDS_IP_FAMILY_IPV6, NULL);
+        qmi_client_wds_start_network (client,
+                                      input,
+                                      START_NETWORK_TIMEOUT,
+                                      NULL,
+                                      (GAsyncReadyCallback) start_network_ready,
+                                      NULL);
+        qmi_message_wds_start_network_input_unref (input);
+        return;
+    }
+
+    if (!connection_wanted && state == CONNECTION_STATE_CONNECTED) {
+        QmiMessageWdsStopNetworkInput *input;
+
+        g_message ("disconnecting network...");
+        state = CONNECTION_STATE_DISCONNECTING;
+
+        input = qmi_message_wds_stop_network_input_new ();
+        qmi_message_wds_stop_network_input_set_packet_data_handle (input, packet_data_handle, NULL);
+        qmi_client_wds_stop_network (client,
+                                     input,
+                                     10,
+                                     NULL,
+                                     (GAsyncReadyCallback) stop_network_ready,
+                                     NULL);
+        qmi_message_wds_stop_network_input_unref (input);
+    }
+}
+
+static void
+packet_service_status_received (QmiClientWds                              *wds,
+                                QmiIndicationWdsPacketServiceStatusOutput *output)
+{
+    QmiWdsConnectionStatus status;
+    gboolean               reconfiguration_required;
+
+    if (!qmi_indication_wds_packet_service_status_output_get_connection_status (output, &status, &reconfiguration_required, NULL))
+        return;
+
+    g_debug ("packet service status: %s", qmi_wds_connection_status_get_string (status));
+
+    /* Only network drops are processed here, explicit stops are handled once
+     * the WDS Stop Network reply is received */
+    if (status != QMI_WDS_CONNECTION_STATUS_DISCONNECTED || state != CONNECTION_STATE_CONNECTED)
+        return;
+
+    g_message ("network connection dropped");
+    state = CONNECTION_STATE_DISCONNECTED;
+    packet_data_handle = 0;
+
+    /* Reconnect right away */
+    if (connection_wanted)
+        schedule_reconnect (0);
+}
+
+/*****************************************************************************/
+/* Command socket */
+
+static void
+command_read_ready (GDataInputStream  *input,
+                    GAsyncResult      *res,
+                    GSocketConnection *connection)
+{
+    GError *error = NULL;
+    gchar  *command;
+
+    command = g_data_input_stream_read_line_finish (input, res, NULL, &error);
+    g_object_unref (input);
+    if (!command) {
+        g_debug ("couldn't read command: %s", error ? error->message : "connection closed");
+        g_clear_error (&error);
+        g_object_unref (connection);
+        return;
+    }
+
+    g_strstrip (command);
+    g_debug ("command received: %s", command);
+
+    if (g_str_equal (command, "status"))
+        reply_status (connection);
+    else if (g_str_equal (command, "start") || g_str_equal (command, "stop")) {
+        connection_wanted = g_str_equal (command, "start");
+        if ((connection_wanted && state == CONNECTION_STATE_CONNECTED) ||
+            (!connection_wanted && state == CONNECTION_STATE_DISCONNECTED)) {
+            if (reconnect_id) {
+                g_source_remove (reconnect_id);
+                reconnect_id = 0;
+            }
+            reply_status (connection);
+        } else {
+            waiting_connections = g_list_append (waiting_connections, connection);
+            connect_network ();
+        }
+    } else {
+        gchar *message;
+
+        message = g_strdup_printf ("error: unknown command '%s'", command);
+        reply (connection, message);
+        g_free (message);
+    }
+
+    g_free (command);
+}
+
+/* The abstract socket can't be protected with file permissions, so the
+ * peer is checked instead: only root, the user running the daemon and the
+ * configured QMI user may control the connection */
+static gboolean
+peer_allowed (GSocketConnection *connection)
+{
+    GCredentials *credentials;
+    GError       *error = NULL;
+    uid_t         uid;
+
+    credentials = g_socket_get_credentials (g_socket_connection_get_socket (connection), &error);
+    if (!credentials) {
+        g_warning ("client not allowed: error getting socket credentials: %s", error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    uid = g_credentials_get_unix_user (credentials, &error);
+    g_object_unref (credentials);
+    if (error) {
+        g_warning ("client not allowed: error getting unix user id: %s", error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    if (uid == 0 || uid == getuid ())
+        return TRUE;
+
+#if defined QMI_USERNAME_ENABLED
+    {
+        struct passwd *expected_usr;
+
+        expected_usr = getpwnam (QMI_USERNAME);
+        if (expected_usr && uid == expected_usr->pw_uid)
+            return TRUE;
+    }
+#endif
+
+    g_warning ("client not allowed: not enough privileges (uid %u)", (guint) uid);
+    return FALSE;
+}
+
+static gboolean
+incoming_cb (GSocketService    *_service,
+             GSocketConnection *connection,
+             GObject           *unused)
+{
+    GDataInputStream *input;
+
+    /* Returning without a reference closes the connection */
+    if (!peer_allowed (connection))
+        return TRUE;
+
+    input = g_data_input_stream_new (g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+    g_data_input_stream_read_line_async (input,
+                                         G_PRIORITY_DEFAULT,
+                                         NULL,
+                                         (GAsyncReadyCallback) command_read_ready,
+                                         g_object_ref (connection));
+    return TRUE;
+}
+
+static gboolean
+setup_service (GError **error)
+{
+    GSocketAddress *address;
+    GSocket        *socket;
+    gboolean        success = FALSE;
+
+    socket = g_socket_new (G_SOCKET_FAMILY_UNIX, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT, error);
+    if (!socket)
+        return FALSE;
+
+    address = build_socket_address ();
+    if (!g_socket_bind (socket, address, TRUE, error) || !g_socket_listen (socket, error))
+        goto out;
+
+    service = g_socket_service_new ();
+    g_signal_connect (service, "incoming", G_CALLBACK (incoming_cb), NULL);
+    if (!g_socket_listener_add_socket (G_SOCKET_LISTENER (service), socket, NULL, error)) {
+        g_clear_object (&service);
+        goto out;
+    }
+    g_socket_service_start (service);
+    success = TRUE;
+
+out:
+    g_object_unref (address);
+    g_object_unref (socket);
+    return success;
+}
+
+/*****************************************************************************/
+/* Device setup and teardown */
+
+static void
+release_client_ready (QmiDevice    *dev,
+                      GAsyncResult *res)
+{
+    GError *error = NULL;
+
+    if (!qmi_device_release_client_finish (dev, res, &error)) {
+        g_warning ("couldn't release WDS client: %s", error->message);
+        g_error_free (error);
+    }
+    g_main_loop_quit (loop);
+}
+
+static gboolean
+quit_cb (gpointer user_data)
+{
+    g_warning ("Caught signal, stopping the loop...");
+
+    if (service)
+        g_socket_service_stop (service);
+
+    /* Releasing the client also brings the network down */
+    if (client) {
+        qmi_device_release_client (device,
+                                   QMI_CLIENT (client),
+                                   QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID,
+                                   3,
+                                   NULL,
+                                   (GAsyncReadyCallback) release_client_ready,
+                                   NULL);
+        g_clear_object (&client);
+        return G_SOURCE_REMOVE;
+    }
+
+    g_idle_add ((GSourceFunc) g_main_loop_quit, loop);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+allocate_client_ready (QmiDevice    *dev,
+                       GAsyncResult *res)
+{
+    GError *error = NULL;
+
+    client = QMI_CLIENT_WDS (qmi_device_allocate_client_finish (dev, res, &error));
+    if (!client) {
+        g_printerr ("error: couldn't allocate WDS client: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+
+    g_signal_connect (client,
+                      "packet-service-status",
+                      G_CALLBACK (packet_service_status_received),
+                      NULL);
+
+    if (!setup_service (&error)) {
+        g_printerr ("error: couldn't setup command socket: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+
+    g_message ("ready to handle commands for '%s'", device_str);
+}
+
+static void
+device_open_ready (QmiDevice    *dev,
+                   GAsyncResult *res)
+{
+    GError *error = NULL;
+
+    if (!qmi_device_open_finish (dev, res, &error)) {
+        g_printerr ("error: couldn't open the QmiDevice: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+
+    qmi_device_allocate_client (dev,
+                                QMI_SERVICE_WDS,
+                                QMI_CID_NONE,
+                                10,
+                                NULL,
+                                (GAsyncReadyCallback) allocate_client_ready,
+                                NULL);
+}
+
+static void
+device_new_ready (GObject      *unused,
+                  GAsyncResult *res)
+{
+    QmiDeviceOpenFlags  open_flags = QMI_DEVICE_OPEN_FLAGS_AUTO;
+    GError             *error = NULL;
+
+    device = qmi_device_new_finish (res, &error);
+    if (!device) {
+        g_printerr ("error: couldn't create QmiDevice: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+
+    if (device_open_proxy_flag)
+        open_flags |= QMI_DEVICE_OPEN_FLAGS_PROXY;
+
+    qmi_device_open (device,
+                     open_flags,
+                     15,
+                     NULL,
+                     (GAsyncReadyCallback) device_open_ready,
+                     NULL);
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    GError *error = NULL;
+    GOptionContext *context;
+    GFile *file;
+
+    setlocale (LC_ALL, "");
+
+    /* Setup option context, process it and destroy it */
+    context = g_option_context_new ("- Keep a QMI network connection up");
+    g_option_context_add_main_entries (context, main_entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("error: %s\n",
+                    error->message);
+        exit (EXIT_FAILURE);
+    }
+    g_option_context_free (context);
+
+    if (version_flag)
+        print_version_and_exit ();
+
+    if (!device_str) {
+        g_printerr ("error: no device path specified\n");
+        exit (EXIT_FAILURE);
+    }
+
+    if (start_flag + stop_flag + status_flag > 1) {
+        g_printerr ("error: too many commands requested\n");
+        exit (EXIT_FAILURE);
+    }
+
+    g_log_set_handler (NULL,  G_LOG_LEVEL_MASK, log_handler, NULL);
+    g_log_set_handler ("Qmi", G_LOG_LEVEL_MASK, log_handler, NULL);
+    if (verbose_flag)
+        qmi_utils_set_traces_enabled (TRUE);
+
+    /* Client mode */
+    if (start_flag)
+        return run_command ("start");
+    if (stop_flag)
+        return run_command ("stop");
+    if (status_flag)
+        return run_command ("status");
+
+    if (ip_type_int != 0 && ip_type_int != 4 && ip_type_int != 6) {
+        g_printerr ("error: invalid IP type: %d\n", ip_type_int);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Setup signals */
+    g_unix_signal_add (SIGINT,  quit_cb, NULL);
+    g_unix_signal_add (SIGHUP,  quit_cb, NULL);
+    g_unix_signal_add (SIGTERM, quit_cb, NULL);
+
+    /* Launch the device setup; the command socket is only available once
+     * the WDS client is ready */
+    file = g_file_new_for_commandline_arg (device_str);
+    qmi_device_new (file, NULL, (GAsyncReadyCallback) device_new_ready, NULL);
+    g_object_unref (file);
+
+    /* Loop */
+    loop = g_main_loop_new (NULL, FALSE);
+    g_main_loop_run (loop);
+    g_main_loop_unref (loop);
+
+    /* Cleanup */
+    g_list_free_full (waiting_connections, g_object_unref);
+    if (reconnect_id)
+        g_source_remove (reconnect_id);
+    if (service)
+        g_object_unref (service);
+    if (device)
+        g_object_unref (device);
+
+    g_debug ("exiting '" PROGRAM_NAME "'...");
+
+    return EXIT_SUCCESS;
+}
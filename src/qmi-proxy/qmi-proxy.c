@@ -24,6 +24,9 @@
 #include <stdlib.h>
 #include <locale.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 
 #include <glib.h>
 #include <glib/gprintf.h>
@@ -37,21 +40,114 @@
 
 #define EMPTY_PROXY_LIFETIME_SECS 30
 
+/* First file descriptor passed with systemd socket activation */
+#define SD_LISTEN_FDS_START 3
+
+/* Size of the ring keeping the recorded traffic, the oldest records are
+ * dropped when full */
+#define TRACE_RING_SIZE (16 * 1024 * 1024)
+
+/* How long the running proxy waits for its requests in flight to complete
+ * before handing over */
+#define HANDOFF_DRAIN_TIMEOUT_SECS 10
+
 /* Globals */
 static GMainLoop *loop;
 static QmiProxy *proxy;
+static QmiTraceRing *trace_ring;
 static guint timeout_id;
+static gint exit_status = EXIT_SUCCESS;
 
 /* Main options */
 static gboolean verbose_flag;
 static gboolean version_flag;
 static gboolean no_exit_flag;
+static gboolean sharded_flag;
+static gboolean coalesce_requests_flag;
+static gboolean response_cache_flag;
+static gboolean indication_cache_flag;
+static gboolean epoll_flag;
+static gboolean io_uring_flag;
+static gboolean handoff_flag;
+static gchar *trace_record_str;
+static gint listen_fd_int = -1;
+static gint device_linger_int;
+static gint fair_queue_window_int;
+static gchar **keep_open_strv;
+static gchar **listen_tcp_strv;
+static gchar *auth_token_file_str;
+static gchar *tls_certificate_file_str;
+static gchar *tls_key_file_str;
 
 static GOptionEntry main_entries[] = {
     { "no-exit", 0, 0, G_OPTION_ARG_NONE, &no_exit_flag,
       "Don't exit after being idle without clients",
       NULL
     },
+    { "sharded", 0, 0, G_OPTION_ARG_NONE, &sharded_flag,
+      "Handle each device and its clients in a separate thread",
+      NULL
+    },
+    { "coalesce-requests", 0, 0, G_OPTION_ARG_NONE, &coalesce_requests_flag,
+      "Don't send idempotent requests identical to one already ongoing, even if from different clients",
+      NULL
+    },
+    { "response-cache", 0, 0, G_OPTION_ARG_NONE, &response_cache_flag,
+      "Cache the responses to requests querying rarely changing information, e.g. device IDs",
+      NULL
+    },
+    { "indication-cache", 0, 0, G_OPTION_ARG_NONE, &indication_cache_flag,
+      "Report the last known device state indications, e.g. NAS Serving System, to newly allocated clients",
+      NULL
+    },
+    { "listen-fd", 0, 0, G_OPTION_ARG_INT, &listen_fd_int,
+      "Accept clients in an already listening socket, given as an inherited file descriptor",
+      "[FD]"
+    },
+    { "listen-tcp", 0, 0, G_OPTION_ARG_STRING_ARRAY, &listen_tcp_strv,
+      "Accept remote clients at the given TCP port, only in the loopback interface unless an address is given (which requires --tls-certificate); may be given multiple times (requires --auth-token-file)",
+      "[ADDRESS:]PORT"
+    },
+    { "auth-token-file", 0, 0, G_OPTION_ARG_FILENAME, &auth_token_file_str,
+      "Read the token remote clients must authenticate with from the given file",
+      "[PATH]"
+    },
+    { "tls-certificate", 0, 0, G_OPTION_ARG_FILENAME, &tls_certificate_file_str,
+      "Accept remote clients only through TLS, with the PEM certificate in the given file",
+      "[PATH]"
+    },
+    { "tls-key", 0, 0, G_OPTION_ARG_FILENAME, &tls_key_file_str,
+      "Read the private key of the TLS certificate from the given file, if not in the certificate file",
+      "[PATH]"
+    },
+    { "device-linger", 0, 0, G_OPTION_ARG_INT, &device_linger_int,
+      "Keep devices open for the given number of seconds after the last client leaves",
+      "[SECS]"
+    },
+    { "keep-open", 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &keep_open_strv,
+      "Never close the given device once open; may be given multiple times",
+      "[PATH]"
+    },
+    { "fair-queue-window", 0, 0, G_OPTION_ARG_INT, &fair_queue_window_int,
+      "Forward at most the given number of service requests to each device at a time, with the clients taking turns",
+      "[N]"
+    },
+    { "epoll", 0, 0, G_OPTION_ARG_NONE, &epoll_flag,
+      "Multiplex the sockets of all clients with epoll, instead of watching each one separately",
+      NULL
+    },
+    { "io-uring", 0, 0, G_OPTION_ARG_NONE, &io_uring_flag,
+      "Read and write client sockets and devices through io_uring, if available (not with --sharded)",
+      NULL
+    },
+    { "handoff", 0, 0, G_OPTION_ARG_NONE, &handoff_flag,
+      "Take over the devices and clients of the proxy already running, without closing or disconnecting them",
+      NULL
+    },
+    { "trace-record", 0, 0, G_OPTION_ARG_FILENAME, &trace_record_str,
+      "Record a binary trace of the QMI traffic of all devices in the given file, written when exiting",
+      "[PATH]"
+    },
     { "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose_flag,
       "Run action with verbose logs, including the debug ones",
       NULL
@@ -165,12 +261,173 @@ proxy_n_clients_changed (QmiProxy *_proxy)
     }
 }
 
+static void
+setup_exit_on_idle (void)
+{
+    /* Don't exit the proxy when no clients are found */
+    if (no_exit_flag)
+        return;
+
+    proxy_n_clients_changed (proxy);
+    g_signal_connect (proxy,
+                      "notify::" QMI_PROXY_N_CLIENTS,
+                      G_CALLBACK (proxy_n_clients_changed),
+                      NULL);
+}
+
+/*****************************************************************************/
+
+static void
+proxy_handed_off (QmiProxy *_proxy)
+{
+    g_debug ("handed over to the new proxy, exiting...");
+    if (loop)
+        g_main_loop_quit (loop);
+}
+
+static void
+receive_handoff_ready (QmiProxy     *_proxy,
+                       GAsyncResult *res)
+{
+    GError *error = NULL;
+
+    if (!qmi_proxy_receive_handoff_finish (proxy, res, &error)) {
+        g_printerr ("error: couldn't take over the running proxy: %s\n", error->message);
+        g_error_free (error);
+        exit_status = EXIT_FAILURE;
+        g_main_loop_quit (loop);
+        return;
+    }
+
+    setup_exit_on_idle ();
+}
+
+/*****************************************************************************/
+
+/* Either the socket given explicitly, or the one passed by systemd. Returns
+ * FALSE only if @error is set, with @socket set to NULL if none inherited. */
+static gboolean
+get_inherited_socket (GSocket **socket,
+                      GError  **error)
+{
+    gint fd = listen_fd_int;
+
+    *socket = NULL;
+
+    if (fd < 0) {
+        const gchar *listen_pid;
+        const gchar *listen_fds;
+
+        listen_pid = g_getenv ("LISTEN_PID");
+        listen_fds = g_getenv ("LISTEN_FDS");
+        if (listen_pid && listen_fds &&
+            g_ascii_strtoull (listen_pid, NULL, 10) == (guint64) getpid () &&
+            g_ascii_strtoull (listen_fds, NULL, 10) >= 1)
+            fd = SD_LISTEN_FDS_START;
+
+        /* Not to be inherited by anything we may spawn */
+        g_unsetenv ("LISTEN_PID");
+        g_unsetenv ("LISTEN_FDS");
+        g_unsetenv ("LISTEN_FDNAMES");
+
+        if (fd < 0)
+            return TRUE;
+    }
+
+    if (fcntl (fd, F_SETFD, FD_CLOEXEC) < 0) {
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                     "invalid listening socket file descriptor %d: %s", fd, g_strerror (errno));
+        return FALSE;
+    }
+
+    *socket = g_socket_new_from_fd (fd, error);
+    return !!*socket;
+}
+
+/*****************************************************************************/
+
+static gboolean
+setup_tls (GError **error)
+{
+    GTlsCertificate *certificate;
+
+    if (tls_key_file_str)
+        certificate = g_tls_certificate_new_from_files (tls_certificate_file_str, tls_key_file_str, error);
+    else
+        certificate = g_tls_certificate_new_from_file (tls_certificate_file_str, error);
+    if (!certificate) {
+        g_prefix_error (error, "couldn't load TLS certificate: ");
+        return FALSE;
+    }
+
+    qmi_proxy_set_tls_certificate (proxy, certificate);
+    g_object_unref (certificate);
+    return TRUE;
+}
+
+static gboolean
+setup_tcp_listeners (GError **error)
+{
+    gchar *auth_token = NULL;
+    guint  i;
+
+    if (!auth_token_file_str) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                     "remote clients require an authentication token file");
+        return FALSE;
+    }
+
+    if (!g_file_get_contents (auth_token_file_str, &auth_token, NULL, error))
+        return FALSE;
+    g_strstrip (auth_token);
+
+    for (i = 0; listen_tcp_strv[i]; i++) {
+        gchar       *address = NULL;
+        const gchar *port_str;
+        const gchar *sep;
+        gchar       *end = NULL;
+        guint64      port;
+
+        /* IPv6 addresses are given in brackets */
+        sep = strrchr (listen_tcp_strv[i], ':');
+        if (sep) {
+            if (listen_tcp_strv[i][0] == '[' && sep > listen_tcp_strv[i] && sep[-1] == ']')
+                address = g_strndup (listen_tcp_strv[i] + 1, sep - listen_tcp_strv[i] - 2);
+            else
+                address = g_strndup (listen_tcp_strv[i], sep - listen_tcp_strv[i]);
+            port_str = sep + 1;
+        } else
+            port_str = listen_tcp_strv[i];
+
+        port = g_ascii_strtoull (port_str, &end, 10);
+        if (!port_str[0] || *end || port == 0 || port > G_MAXUINT16) {
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                         "invalid TCP listener '%s': invalid port", listen_tcp_strv[i]);
+            g_free (address);
+            g_free (auth_token);
+            return FALSE;
+        }
+
+        if (!qmi_proxy_add_tcp_listener (proxy, address, (guint16) port, auth_token, NULL, error)) {
+            g_prefix_error (error, "invalid TCP listener '%s': ", listen_tcp_strv[i]);
+            g_free (address);
+            g_free (auth_token);
+            return FALSE;
+        }
+        g_free (address);
+    }
+
+    g_free (auth_token);
+    return TRUE;
+}
+
 /*****************************************************************************/
 
 int main (int argc, char **argv)
 {
     GError *error = NULL;
     GOptionContext *context;
+    GSocket *listening_socket;
 
     setlocale (LC_ALL, "");
 
@@ -197,22 +454,80 @@ int main (int argc, char **argv)
     g_unix_signal_add (SIGHUP,  quit_cb, NULL);
     g_unix_signal_add (SIGTERM, quit_cb, NULL);
 
-    /* Setup proxy */
-    proxy = qmi_proxy_new (&error);
+    if (io_uring_flag && sharded_flag) {
+        g_printerr ("error: --io-uring cannot be used with --sharded\n");
+        exit (EXIT_FAILURE);
+    }
+
+    /* Setup proxy; when taking over, everything comes from the running one */
+    if (handoff_flag) {
+        if (sharded_flag || listen_fd_int >= 0 || listen_tcp_strv) {
+            g_printerr ("error: --handoff cannot be used with --sharded, --listen-fd or --listen-tcp\n");
+            exit (EXIT_FAILURE);
+        }
+        proxy = qmi_proxy_new_for_handoff (&error);
+    } else if (!get_inherited_socket (&listening_socket, &error)) {
+        g_printerr ("error: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    } else if (listening_socket) {
+        proxy = qmi_proxy_new_with_socket (listening_socket, sharded_flag, &error);
+        g_object_unref (listening_socket);
+    } else
+        proxy = (sharded_flag ? qmi_proxy_new_sharded (&error) : qmi_proxy_new (&error));
     if (!proxy) {
         g_printerr ("error: %s\n", error->message);
         exit (EXIT_FAILURE);
     }
 
-    /* Don't exit the proxy when no clients are found */
-    if (!no_exit_flag) {
-        proxy_n_clients_changed (proxy);
-        g_signal_connect (proxy,
-                          "notify::" QMI_PROXY_N_CLIENTS,
-                          G_CALLBACK (proxy_n_clients_changed),
-                          NULL);
+    if (coalesce_requests_flag)
+        g_object_set (proxy, QMI_PROXY_COALESCE_REQUESTS, TRUE, NULL);
+    if (response_cache_flag)
+        g_object_set (proxy, QMI_PROXY_RESPONSE_CACHE, TRUE, NULL);
+    if (indication_cache_flag)
+        g_object_set (proxy, QMI_PROXY_INDICATION_CACHE, TRUE, NULL);
+    if (epoll_flag)
+        g_object_set (proxy, QMI_PROXY_EPOLL, TRUE, NULL);
+    if (io_uring_flag)
+        g_object_set (proxy, QMI_PROXY_IO_URING, TRUE, NULL);
+    if (fair_queue_window_int > 0)
+        g_object_set (proxy, QMI_PROXY_FAIR_QUEUE_WINDOW, (guint) fair_queue_window_int, NULL);
+    if (device_linger_int > 0)
+        g_object_set (proxy, QMI_PROXY_DEVICE_LINGER, (guint) device_linger_int, NULL);
+    if (keep_open_strv)
+        g_object_set (proxy, QMI_PROXY_KEEP_OPEN, keep_open_strv, NULL);
+    if (trace_record_str) {
+        trace_ring = qmi_trace_ring_new (TRACE_RING_SIZE, 0);
+        g_object_set (proxy, QMI_PROXY_TRACE_RING, trace_ring, NULL);
+    }
+    if (tls_key_file_str && !tls_certificate_file_str) {
+        g_printerr ("error: --tls-key requires --tls-certificate\n");
+        exit (EXIT_FAILURE);
+    }
+    /* Also when taking over, for the listeners handed over */
+    if (tls_certificate_file_str && !setup_tls (&error)) {
+        g_printerr ("error: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+    if (listen_tcp_strv && !setup_tcp_listeners (&error)) {
+        g_printerr ("error: %s\n", error->message);
+        exit (EXIT_FAILURE);
     }
 
+    /* Exit once a new proxy took over */
+    g_signal_connect (proxy,
+                      "notify::" QMI_PROXY_HANDED_OFF,
+                      G_CALLBACK (proxy_handed_off),
+                      NULL);
+
+    if (handoff_flag)
+        qmi_proxy_receive_handoff (proxy,
+                                   HANDOFF_DRAIN_TIMEOUT_SECS,
+                                   NULL,
+                                   (GAsyncReadyCallback) receive_handoff_ready,
+                                   NULL);
+    else
+        setup_exit_on_idle ();
+
     /* Loop */
     loop = g_main_loop_new (NULL, FALSE);
     g_main_loop_run (loop);
@@ -221,7 +536,25 @@ int main (int argc, char **argv)
     /* Cleanup; releases socket and such */
     g_object_unref (proxy);
 
+    if (trace_ring) {
+        GBytes *bytes;
+        GError *error = NULL;
+
+        bytes = qmi_trace_ring_dump (trace_ring);
+        if (!g_file_set_contents (trace_record_str,
+                                  g_bytes_get_data (bytes, NULL),
+                                  g_bytes_get_size (bytes),
+                                  &error)) {
+            g_printerr ("error: couldn't write trace: %s\n", error->message);
+            g_error_free (error);
+        }
+        g_bytes_unref (bytes);
+        qmi_trace_ring_unref (trace_ring);
+        g_free (trace_record_str);
+    }
+    g_strfreev (keep_open_strv);
+
     g_debug ("exiting 'qmi-proxy'...");
 
-    return EXIT_SUCCESS;
+    return exit_status;
 }
@@ -0,0 +1,233 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * qmicli -- Command line interface to control QMI devices
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libqmi-glib.h>
+
+#include "qmicli.h"
+#include "qmicli-helpers.h"
+
+/* Result TLV, common to all responses */
+#define RESULT_TLV 0x02
+
+/* Context */
+typedef struct {
+    QmiDevice    *device;
+    QmiClient    *client;
+    GCancellable *cancellable;
+    guint16       message_id;
+    guint         count;
+    guint         n_sent;
+    guint         n_completed;
+    guint         n_errors;
+    guint         n_protocol_errors;
+    gint64        start_time;
+    gint64       *latencies;
+    guint         n_latencies;
+} Context;
+static Context *ctx;
+
+static void
+context_free (Context *context)
+{
+    if (!context)
+        return;
+
+    if (context->cancellable)
+        g_object_unref (context->cancellable);
+    g_object_unref (context->device);
+    g_object_unref (context->client);
+    g_free (context->latencies);
+    g_slice_free (Context, context);
+}
+
+static void
+operation_shutdown (gboolean operation_status)
+{
+    /* Cleanup context and finish async operation */
+    context_free (ctx);
+    ctx = NULL;
+    qmicli_async_operation_done (operation_status, FALSE);
+}
+
+static gint
+latency_cmp (const gint64 *a,
+             const gint64 *b)
+{
+    return (*a < *b) ? -1 : ((*a > *b) ? 1 : 0);
+}
+
+static gint64
+latency_percentile (guint percentile)
+{
+    return ctx->latencies[((ctx->n_latencies - 1) * percentile) / 100];
+}
+
+static void
+report (void)
+{
+    gint64 elapsed;
+    gint64 total = 0;
+    guint  i;
+
+    elapsed = g_get_monotonic_time () - ctx->start_time;
+
+    g_print ("[%s] Benchmark of service '%s' message 0x%04x finished:\n"
+             "\t      Requests: %u\n"
+             "\t        Failed: %u\n"
+             "\t Error results: %u\n"
+             "\t       Elapsed: %.3f s\n"
+             "\t    Throughput: %.1f requests/s\n",
+             qmi_device_get_path_display (ctx->device),
+             qmi_service_get_string (qmi_client_get_service (ctx->client)),
+             ctx->message_id,
+             ctx->count,
+             ctx->n_errors,
+             ctx->n_protocol_errors,
+             (gdouble) elapsed / G_USEC_PER_SEC,
+             elapsed > 0 ? ((gdouble) ctx->n_latencies * G_USEC_PER_SEC) / elapsed : 0.0);
+
+    if (!ctx->n_latencies)
+        return;
+
+    qsort (ctx->latencies, ctx->n_latencies, sizeof (gint64), (GCompareFunc) latency_cmp);
+    for (i = 0; i < ctx->n_latencies; i++)
+        total += ctx->latencies[i];
+
+    g_print ("\tLatency (ms):\n"
+             "\t\t min: %.3f\n"
+             "\t\t avg: %.3f\n"
+             "\t\t p50: %.3f\n"
+             "\t\t p99: %.3f\n"
+             "\t\t max: %.3f\n",
+             (gdouble) ctx->latencies[0] / 1000.0,
+             (gdouble) total / ctx->n_latencies / 1000.0,
+             (gdouble) latency_percentile (50) / 1000.0,
+             (gdouble) latency_percentile (99) / 1000.0,
+             (gdouble) ctx->latencies[ctx->n_latencies - 1] / 1000.0);
+}
+
+static void send_request (void);
+
+static void
+command_ready (QmiDevice    *device,
+               GAsyncResult *res,
+               gpointer      start_time_ptr)
+{
+    QmiMessage *response;
+    GError     *error = NULL;
+    gint64      start_time;
+
+    start_time = *((gint64 *) start_time_ptr);
+    g_slice_free (gint64, start_time_ptr);
+
+    response = qmi_device_command_full_finish (device, res, &error);
+    if (!response) {
+        g_printerr ("error: operation failed: %s\n", error->message);
+        g_error_free (error);
+        ctx->n_errors++;
+    } else {
+        gsize   init_offset;
+        gsize   offset = 0;
+        guint16 status = 0;
+
+        ctx->latencies[ctx->n_latencies++] = g_get_monotonic_time () - start_time;
+
+        /* Requests are counted as completed even if the device reports an error,
+         * as that is still a full round-trip */
+        if (((init_offset = qmi_message_tlv_read_init (response, RESULT_TLV, NULL, NULL)) == 0) ||
+            !qmi_message_tlv_read_guint16 (response, init_offset, &offset, QMI_ENDIAN_LITTLE, &status, NULL) ||
+            status != 0)
+            ctx->n_protocol_errors++;
+        qmi_message_unref (response);
+    }
+
+    ctx->n_completed++;
+    if (ctx->n_completed == ctx->count) {
+        report ();
+        operation_shutdown (ctx->n_errors == 0);
+        return;
+    }
+
+    if (ctx->n_sent < ctx->count)
+        send_request ();
+}
+
+static void
+send_request (void)
+{
+    QmiMessage *request;
+    gint64     *start_time;
+
+    request = qmi_message_new (qmi_client_get_service (ctx->client),
+                               qmi_client_get_cid (ctx->client),
+                               qmi_client_get_next_transaction_id (ctx->client),
+                               ctx->message_id);
+
+    start_time = g_slice_new (gint64);
+    *start_time = g_get_monotonic_time ();
+    ctx->n_sent++;
+
+    qmi_device_command_full (ctx->device,
+                             request,
+                             NULL,
+                             10,
+                             ctx->cancellable,
+                             (GAsyncReadyCallback)command_ready,
+                             start_time);
+    qmi_message_unref (request);
+}
+
+void
+qmicli_benchmark_run (QmiDevice    *device,
+                      QmiClient    *client,
+                      guint16       message_id,
+                      guint         count,
+                      guint         concurrency,
+                      GCancellable *cancellable)
+{
+    guint i;
+
+    g_assert (count > 0);
+    g_assert (concurrency > 0);
+
+    /* Initialize context */
+    ctx = g_slice_new0 (Context);
+    ctx->device = g_object_ref (device);
+    ctx->client = g_object_ref (client);
+    if (cancellable)
+        ctx->cancellable = g_object_ref (cancellable);
+    ctx->message_id = message_id;
+    ctx->count = count;
+    ctx->latencies = g_new (gint64, count);
+
+    g_debug ("Asynchronously running benchmark: %u requests, %u concurrent...", count, concurrency);
+    ctx->start_time = g_get_monotonic_time ();
+    for (i = 0; i < MIN (concurrency, count); i++)
+        send_request ();
+}
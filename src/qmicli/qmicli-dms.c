@@ -330,12 +330,12 @@ qmicli_dms_get_option_group (void)
     return group;
 }
 
+static guint n_actions;
+static gboolean checked;
+
 gboolean
 qmicli_dms_options_enabled (void)
 {
-    static guint n_actions = 0;
-    static gboolean checked = FALSE;
-
     if (checked)
         return !!n_actions;
 
@@ -402,6 +402,13 @@ qmicli_dms_options_enabled (void)
     return !!n_actions;
 }
 
+void
+qmicli_dms_options_reset (void)
+{
+    qmicli_reset_option_entries (entries);
+    checked = FALSE;
+}
+
 static void
 context_free (Context *context)
 {
@@ -444,6 +451,7 @@ get_ids_ready (QmiClientDms *client,
     const gchar *meid = NULL;
     QmiMessageDmsGetIdsOutput *output;
     GError *error = NULL;
+    QmicliOutput *out;
 
     output = qmi_client_dms_get_ids_finish (client, res, &error);
     if (!output) {
@@ -465,14 +473,11 @@ get_ids_ready (QmiClientDms *client,
     qmi_message_dms_get_ids_output_get_imei (output, &imei, NULL);
     qmi_message_dms_get_ids_output_get_meid (output, &meid, NULL);
 
-    g_print ("[%s] Device IDs retrieved:\n"
-             "\t ESN: '%s'\n"
-             "\tIMEI: '%s'\n"
-             "\tMEID: '%s'\n",
-             qmi_device_get_path_display (ctx->device),
-             VALIDATE_UNKNOWN (esn),
-             VALIDATE_UNKNOWN (imei),
-             VALIDATE_UNKNOWN (meid));
+    out = qmicli_output_new (qmi_device_get_path_display (ctx->device), "dms-get-ids", "[%s] Device IDs retrieved:\n");
+    qmicli_output_add_string (out, "esn",  "\t ESN: '%s'\n", VALIDATE_UNKNOWN (esn));
+    qmicli_output_add_string (out, "imei", "\tIMEI: '%s'\n", VALIDATE_UNKNOWN (imei));
+    qmicli_output_add_string (out, "meid", "\tMEID: '%s'\n", VALIDATE_UNKNOWN (meid));
+    qmicli_output_flush (out);
 
     qmi_message_dms_get_ids_output_unref (output);
     operation_shutdown (TRUE);
@@ -552,6 +557,7 @@ get_manufacturer_ready (QmiClientDms *client,
     const gchar *str = NULL;
     QmiMessageDmsGetManufacturerOutput *output;
     GError *error = NULL;
+    QmicliOutput *out;
 
     output = qmi_client_dms_get_manufacturer_finish (client, res, &error);
     if (!output) {
@@ -571,10 +577,9 @@ get_manufacturer_ready (QmiClientDms *client,
 
     qmi_message_dms_get_manufacturer_output_get_manufacturer (output, &str, NULL);
 
-    g_print ("[%s] Device manufacturer retrieved:\n"
-             "\tManufacturer: '%s'\n",
-             qmi_device_get_path_display (ctx->device),
-             VALIDATE_UNKNOWN (str));
+    out = qmicli_output_new (qmi_device_get_path_display (ctx->device), "dms-get-manufacturer", "[%s] Device manufacturer retrieved:\n");
+    qmicli_output_add_string (out, "manufacturer", "\tManufacturer: '%s'\n", VALIDATE_UNKNOWN (str));
+    qmicli_output_flush (out);
 
     qmi_message_dms_get_manufacturer_output_unref (output);
     operation_shutdown (TRUE);
@@ -587,6 +592,7 @@ get_model_ready (QmiClientDms *client,
     const gchar *str = NULL;
     QmiMessageDmsGetModelOutput *output;
     GError *error = NULL;
+    QmicliOutput *out;
 
     output = qmi_client_dms_get_model_finish (client, res, &error);
     if (!output) {
@@ -606,10 +612,9 @@ get_model_ready (QmiClientDms *client,
 
     qmi_message_dms_get_model_output_get_model (output, &str, NULL);
 
-    g_print ("[%s] Device model retrieved:\n"
-             "\tModel: '%s'\n",
-             qmi_device_get_path_display (ctx->device),
-             VALIDATE_UNKNOWN (str));
+    out = qmicli_output_new (qmi_device_get_path_display (ctx->device), "dms-get-model", "[%s] Device model retrieved:\n");
+    qmicli_output_add_string (out, "model", "\tModel: '%s'\n", VALIDATE_UNKNOWN (str));
+    qmicli_output_flush (out);
 
     qmi_message_dms_get_model_output_unref (output);
     operation_shutdown (TRUE);
@@ -622,6 +627,7 @@ get_revision_ready (QmiClientDms *client,
     const gchar *str = NULL;
     QmiMessageDmsGetRevisionOutput *output;
     GError *error = NULL;
+    QmicliOutput *out;
 
     output = qmi_client_dms_get_revision_finish (client, res, &error);
     if (!output) {
@@ -641,10 +647,9 @@ get_revision_ready (QmiClientDms *client,
 
     qmi_message_dms_get_revision_output_get_revision (output, &str, NULL);
 
-    g_print ("[%s] Device revision retrieved:\n"
-             "\tRevision: '%s'\n",
-             qmi_device_get_path_display (ctx->device),
-             VALIDATE_UNKNOWN (str));
+    out = qmicli_output_new (qmi_device_get_path_display (ctx->device), "dms-get-revision", "[%s] Device revision retrieved:\n");
+    qmicli_output_add_string (out, "revision", "\tRevision: '%s'\n", VALIDATE_UNKNOWN (str));
+    qmicli_output_flush (out);
 
     qmi_message_dms_get_revision_output_unref (output);
     operation_shutdown (TRUE);
@@ -657,6 +662,7 @@ get_msisdn_ready (QmiClientDms *client,
     const gchar *str = NULL;
     QmiMessageDmsGetMsisdnOutput *output;
     GError *error = NULL;
+    QmicliOutput *out;
 
     output = qmi_client_dms_get_msisdn_finish (client, res, &error);
     if (!output) {
@@ -676,10 +682,9 @@ get_msisdn_ready (QmiClientDms *client,
 
     qmi_message_dms_get_msisdn_output_get_msisdn (output, &str, NULL);
 
-    g_print ("[%s] Device MSISDN retrieved:\n"
-             "\tMSISDN: '%s'\n",
-             qmi_device_get_path_display (ctx->device),
-             VALIDATE_UNKNOWN (str));
+    out = qmicli_output_new (qmi_device_get_path_display (ctx->device), "dms-get-msisdn", "[%s] Device MSISDN retrieved:\n");
+    qmicli_output_add_string (out, "msisdn", "\tMSISDN: '%s'\n", VALIDATE_UNKNOWN (str));
+    qmicli_output_flush (out);
 
     qmi_message_dms_get_msisdn_output_unref (output);
     operation_shutdown (TRUE);
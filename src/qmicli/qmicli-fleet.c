@@ -0,0 +1,237 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * qmicli -- Command line interface to control QMI devices
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+/*
+ * Running the same action on multiple devices at once.
+ *
+ * The per-service actions keep their state in globals, so each device is
+ * handled by its own qmicli instance, run with the same command line but a
+ * single --device. All of them are launched at once, and their output is
+ * read here, in a single main loop, and printed line by line prefixed with
+ * the device path. Each instance applies its own --device-timeout.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/types.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+
+#include "qmicli.h"
+
+typedef struct {
+    gchar      *path;
+    GPid        pid;
+    gboolean    success;
+    GIOChannel *out;
+    GIOChannel *err;
+} Instance;
+
+/* Context */
+typedef struct {
+    GMainLoop *loop;
+    Instance  *instances;
+    guint      n_instances;
+    guint      n_pending;
+} Context;
+static Context *ctx;
+
+static void
+instance_pending_done (void)
+{
+    g_assert (ctx->n_pending > 0);
+    if (--ctx->n_pending == 0)
+        g_main_loop_quit (ctx->loop);
+}
+
+static gboolean
+instance_output_cb (GIOChannel   *channel,
+                    GIOCondition  condition,
+                    Instance     *instance)
+{
+    gchar     *line = NULL;
+    gsize      line_length = 0;
+    GIOStatus  status;
+    FILE      *stream;
+
+    stream = (channel == instance->out ? stdout : stderr);
+
+    /* Incomplete lines are only read once the pipe is closed */
+    while ((status = g_io_channel_read_line (channel, &line, &line_length, NULL, NULL)) == G_IO_STATUS_NORMAL) {
+        fprintf (stream, "[%s] %.*s%s",
+                 instance->path,
+                 (gint) line_length,
+                 line,
+                 (line_length > 0 && line[line_length - 1] == '\n') ? "" : "\n");
+        g_free (line);
+    }
+    fflush (stream);
+
+    if (status == G_IO_STATUS_AGAIN)
+        return G_SOURCE_CONTINUE;
+
+    instance_pending_done ();
+    return G_SOURCE_REMOVE;
+}
+
+static void
+instance_exited_cb (GPid      pid,
+                    gint      status,
+                    Instance *instance)
+{
+    GError *error = NULL;
+
+    instance->success = g_spawn_check_exit_status (status, &error);
+    if (!instance->success) {
+        g_debug ("[%s] instance failed: %s", instance->path, error->message);
+        g_error_free (error);
+    }
+    g_spawn_close_pid (pid);
+    instance->pid = 0;
+    instance_pending_done ();
+}
+
+static GIOChannel *
+instance_watch_output (Instance *instance,
+                       gint      fd)
+{
+    GIOChannel *channel;
+
+    channel = g_io_channel_unix_new (fd);
+    g_io_channel_set_close_on_unref (channel, TRUE);
+    g_io_channel_set_encoding (channel, NULL, NULL);
+    g_io_channel_set_flags (channel, G_IO_FLAG_NONBLOCK, NULL);
+    g_io_add_watch (channel, G_IO_IN | G_IO_HUP | G_IO_ERR, (GIOFunc) instance_output_cb, instance);
+    return channel;
+}
+
+static gboolean
+instance_spawn (Instance  *instance,
+                gchar    **argv,
+                GError   **error)
+{
+    GPtrArray *instance_argv;
+    gint       out_fd;
+    gint       err_fd;
+    gboolean   spawned;
+    guint      i;
+
+    instance_argv = g_ptr_array_new_with_free_func (g_free);
+    g_ptr_array_add (instance_argv, g_strdup (argv[0]));
+    g_ptr_array_add (instance_argv, g_strdup_printf ("--device=%s", instance->path));
+    for (i = 1; argv[i]; i++)
+        g_ptr_array_add (instance_argv, g_strdup (argv[i]));
+    g_ptr_array_add (instance_argv, NULL);
+
+    spawned = g_spawn_async_with_pipes (NULL, /* working directory */
+                                        (gchar **) instance_argv->pdata,
+                                        NULL, /* envp */
+                                        G_SPAWN_DO_NOT_REAP_CHILD | (strchr (argv[0], '/') ? 0 : G_SPAWN_SEARCH_PATH),
+                                        NULL, /* child_setup */
+                                        NULL, /* child_setup_user_data */
+                                        &instance->pid,
+                                        NULL, /* stdin */
+                                        &out_fd,
+                                        &err_fd,
+                                        error);
+    g_ptr_array_unref (instance_argv);
+    if (!spawned)
+        return FALSE;
+
+    instance->out = instance_watch_output (instance, out_fd);
+    instance->err = instance_watch_output (instance, err_fd);
+    g_child_watch_add (instance->pid, (GChildWatchFunc) instance_exited_cb, instance);
+    ctx->n_pending += 3;
+    return TRUE;
+}
+
+static gboolean
+signals_handler (gpointer signum)
+{
+    guint i;
+
+    /* SIGINT and SIGHUP from the terminal already reach the whole process
+     * group, so only SIGTERM is forwarded */
+    if (GPOINTER_TO_INT (signum) != SIGTERM)
+        return G_SOURCE_CONTINUE;
+
+    for (i = 0; i < ctx->n_instances; i++) {
+        if (ctx->instances[i].pid)
+            kill (ctx->instances[i].pid, SIGTERM);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+gboolean
+qmicli_fleet_run (gchar **devices,
+                  gchar **argv)
+{
+    gboolean success = TRUE;
+    guint    signal_ids[3];
+    guint    i;
+
+    ctx = g_slice_new0 (Context);
+    ctx->loop = g_main_loop_new (NULL, FALSE);
+    ctx->n_instances = g_strv_length (devices);
+    ctx->instances = g_new0 (Instance, ctx->n_instances);
+
+    signal_ids[0] = g_unix_signal_add (SIGINT,  (GSourceFunc) signals_handler, GINT_TO_POINTER (SIGINT));
+    signal_ids[1] = g_unix_signal_add (SIGHUP,  (GSourceFunc) signals_handler, GINT_TO_POINTER (SIGHUP));
+    signal_ids[2] = g_unix_signal_add (SIGTERM, (GSourceFunc) signals_handler, GINT_TO_POINTER (SIGTERM));
+
+    for (i = 0; i < ctx->n_instances; i++) {
+        GError *error = NULL;
+
+        ctx->instances[i].path = devices[i];
+        if (!instance_spawn (&ctx->instances[i], argv, &error)) {
+            g_printerr ("[%s] error: couldn't run qmicli: %s\n", devices[i], error->message);
+            g_error_free (error);
+        }
+    }
+
+    if (ctx->n_pending > 0)
+        g_main_loop_run (ctx->loop);
+
+    for (i = 0; i < ctx->n_instances; i++) {
+        if (!ctx->instances[i].success) {
+            if (ctx->instances[i].out)
+                g_printerr ("[%s] error: operation failed\n", ctx->instances[i].path);
+            success = FALSE;
+        }
+        if (ctx->instances[i].out)
+            g_io_channel_unref (ctx->instances[i].out);
+        if (ctx->instances[i].err)
+            g_io_channel_unref (ctx->instances[i].err);
+    }
+
+    for (i = 0; i < G_N_ELEMENTS (signal_ids); i++)
+        g_source_remove (signal_ids[i]);
+    g_free (ctx->instances);
+    g_main_loop_unref (ctx->loop);
+    g_slice_free (Context, ctx);
+    ctx = NULL;
+
+    return success;
+}
@@ -31,6 +31,7 @@ qmicli_get_raw_data_printable (const GArray *data,
                                gsize max_line_length,
                                const gchar *line_prefix)
 {
+    static const gchar hex_digits[] = "0123456789ABCDEF";
     gsize i;
     gsize j;
     gsize k;
@@ -82,7 +83,8 @@ qmicli_get_raw_data_printable (const GArray *data,
         }
 
         /* Print character in output string... */
-        snprintf (&new_str[j], 3, "%02X", g_array_index (data, guint8, i));
+        new_str[j]     = hex_digits[g_array_index (data, guint8, i) >> 4];
+        new_str[j + 1] = hex_digits[g_array_index (data, guint8, i) & 0x0F];
         j+=2;
         k+=2;
 
@@ -974,3 +976,270 @@ qmicli_parse_key_value_string (const gchar *str,
 
     return TRUE;
 }
+
+/******************************************************************************/
+/* Output */
+
+static QmicliOutputFormat output_format = QMICLI_OUTPUT_FORMAT_TEXT;
+
+gboolean
+qmicli_read_output_format_from_string (const gchar *str,
+                                       QmicliOutputFormat *out)
+{
+    if (!str || str[0] == '\0' || g_str_equal (str, "text"))
+        *out = QMICLI_OUTPUT_FORMAT_TEXT;
+    else if (g_str_equal (str, "json"))
+        *out = QMICLI_OUTPUT_FORMAT_JSON;
+    else if (g_str_equal (str, "keyvalue"))
+        *out = QMICLI_OUTPUT_FORMAT_KEYVALUE;
+    else {
+        g_printerr ("error: invalid output format given: '%s'\n", str);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void
+qmicli_set_output_format (QmicliOutputFormat format)
+{
+    output_format = format;
+}
+
+QmicliOutputFormat
+qmicli_get_output_format (void)
+{
+    return output_format;
+}
+
+struct _QmicliOutput {
+    QmicliOutputFormat  format;
+    GString            *str;
+    gboolean            first;
+};
+
+static void
+output_append_json_string (GString     *str,
+                           const gchar *value)
+{
+    const gchar *p;
+
+    g_string_append_c (str, '"');
+    for (p = value; *p; p++) {
+        switch (*p) {
+        case '"':
+            g_string_append (str, "\\\"");
+            break;
+        case '\\':
+            g_string_append (str, "\\\\");
+            break;
+        case '\n':
+            g_string_append (str, "\\n");
+            break;
+        case '\t':
+            g_string_append (str, "\\t");
+            break;
+        default:
+            if ((guchar) *p < 0x20)
+                g_string_append_printf (str, "\\u%04x", (guint) *p);
+            else
+                g_string_append_c (str, *p);
+            break;
+        }
+    }
+    g_string_append_c (str, '"');
+}
+
+/* One line per value, so only the line breaks and the escape character
+ * itself need escaping */
+static void
+output_append_keyvalue_string (GString     *str,
+                               const gchar *value)
+{
+    const gchar *p;
+
+    for (p = value; *p; p++) {
+        switch (*p) {
+        case '\\':
+            g_string_append (str, "\\\\");
+            break;
+        case '\n':
+            g_string_append (str, "\\n");
+            break;
+        case '\r':
+            g_string_append (str, "\\r");
+            break;
+        default:
+            g_string_append_c (str, *p);
+            break;
+        }
+    }
+}
+
+static void
+output_append_key (QmicliOutput *self,
+                   const gchar  *key)
+{
+    if (self->format == QMICLI_OUTPUT_FORMAT_JSON) {
+        if (!self->first)
+            g_string_append_c (self->str, ',');
+        output_append_json_string (self->str, key);
+        g_string_append_c (self->str, ':');
+    } else {
+        g_string_append (self->str, key);
+        g_string_append_c (self->str, '=');
+    }
+    self->first = FALSE;
+}
+
+QmicliOutput *
+qmicli_output_new (const gchar *device_path,
+                   const gchar *command,
+                   const gchar *text_header)
+{
+    QmicliOutput *self;
+
+    self = g_slice_new0 (QmicliOutput);
+    self->format = output_format;
+    self->str = g_string_new (NULL);
+    self->first = TRUE;
+
+    if (self->format == QMICLI_OUTPUT_FORMAT_TEXT) {
+        if (text_header)
+            g_string_append_printf (self->str, text_header, device_path);
+        return self;
+    }
+
+    if (self->format == QMICLI_OUTPUT_FORMAT_JSON)
+        g_string_append_c (self->str, '{');
+    qmicli_output_add_string (self, "device", NULL, device_path);
+    qmicli_output_add_string (self, "command", NULL, command);
+    return self;
+}
+
+void
+qmicli_output_add_string (QmicliOutput *self,
+                          const gchar  *key,
+                          const gchar  *text_format,
+                          const gchar  *value)
+{
+    if (!value)
+        value = "";
+
+    switch (self->format) {
+    case QMICLI_OUTPUT_FORMAT_TEXT:
+        if (text_format)
+            g_string_append_printf (self->str, text_format, value);
+        break;
+    case QMICLI_OUTPUT_FORMAT_JSON:
+        output_append_key (self, key);
+        output_append_json_string (self->str, value);
+        break;
+    case QMICLI_OUTPUT_FORMAT_KEYVALUE:
+        output_append_key (self, key);
+        output_append_keyvalue_string (self->str, value);
+        g_string_append_c (self->str, '\n');
+        break;
+    default:
+        g_assert_not_reached ();
+    }
+}
+
+void
+qmicli_output_add_uint (QmicliOutput *self,
+                        const gchar  *key,
+                        const gchar  *text_format,
+                        guint64       value)
+{
+    gchar buf[24];
+
+    g_snprintf (buf, sizeof (buf), "%" G_GUINT64_FORMAT, value);
+
+    switch (self->format) {
+    case QMICLI_OUTPUT_FORMAT_TEXT:
+        if (text_format)
+            g_string_append_printf (self->str, text_format, buf);
+        break;
+    case QMICLI_OUTPUT_FORMAT_JSON:
+        /* Numbers are not quoted */
+        output_append_key (self, key);
+        g_string_append (self->str, buf);
+        break;
+    case QMICLI_OUTPUT_FORMAT_KEYVALUE:
+        output_append_key (self, key);
+        g_string_append (self->str, buf);
+        g_string_append_c (self->str, '\n');
+        break;
+    default:
+        g_assert_not_reached ();
+    }
+}
+
+void
+qmicli_output_add_json (QmicliOutput *self,
+                        const gchar  *key,
+                        const gchar  *text_format,
+                        const gchar  *json)
+{
+    if (self->format != QMICLI_OUTPUT_FORMAT_JSON) {
+        qmicli_output_add_string (self, key, text_format, json);
+        return;
+    }
+
+    output_append_key (self, key);
+    g_string_append (self->str, json ? json : "null");
+}
+
+gchar *
+qmicli_output_free_to_string (QmicliOutput *self)
+{
+    gchar *str;
+
+    if (self->format == QMICLI_OUTPUT_FORMAT_JSON)
+        g_string_append (self->str, "}\n");
+
+    str = g_string_free (self->str, FALSE);
+    g_slice_free (QmicliOutput, self);
+    return str;
+}
+
+/* All the output of an action is printed at once */
+void
+qmicli_output_flush (QmicliOutput *self)
+{
+    gchar *str;
+
+    str = qmicli_output_free_to_string (self);
+    g_print ("%s", str);
+    g_free (str);
+}
+
+/******************************************************************************/
+
+void
+qmicli_reset_option_entries (const GOptionEntry *entries)
+{
+    guint i;
+
+    for (i = 0; entries[i].long_name; i++) {
+        switch (entries[i].arg) {
+        case G_OPTION_ARG_NONE:
+            *((gboolean *) entries[i].arg_data) = FALSE;
+            break;
+        case G_OPTION_ARG_STRING:
+        case G_OPTION_ARG_FILENAME:
+            g_free (*((gchar **) entries[i].arg_data));
+            *((gchar **) entries[i].arg_data) = NULL;
+            break;
+        case G_OPTION_ARG_STRING_ARRAY:
+        case G_OPTION_ARG_FILENAME_ARRAY:
+            g_strfreev (*((gchar ***) entries[i].arg_data));
+            *((gchar ***) entries[i].arg_data) = NULL;
+            break;
+        case G_OPTION_ARG_INT:
+            *((gint *) entries[i].arg_data) = 0;
+            break;
+        default:
+            g_assert_not_reached ();
+        }
+    }
+}
@@ -99,4 +99,47 @@ gboolean qmicli_parse_key_value_string (const gchar *str,
                                         QmiParseKeyValueForeachFn callback,
                                         gpointer user_data);
 
+/* Set all the option values back to their defaults, e.g. before parsing a
+ * new set of arguments */
+void qmicli_reset_option_entries (const GOptionEntry *entries);
+
+/* Output of the results of an action, either as the human-oriented text or
+ * as one of the structured formats meant to be read by scripts */
+typedef enum {
+    QMICLI_OUTPUT_FORMAT_TEXT,
+    QMICLI_OUTPUT_FORMAT_JSON,
+    QMICLI_OUTPUT_FORMAT_KEYVALUE,
+} QmicliOutputFormat;
+
+gboolean           qmicli_read_output_format_from_string (const gchar *str,
+                                                          QmicliOutputFormat *out);
+void               qmicli_set_output_format              (QmicliOutputFormat format);
+QmicliOutputFormat qmicli_get_output_format              (void);
+
+typedef struct _QmicliOutput QmicliOutput;
+
+/* The text header and each field text format get the device path or the
+ * field value as their only "%s" argument, and are only used when the output
+ * is text. In the structured formats the command and each field key are used
+ * instead, so that the text may change without affecting scripts. */
+QmicliOutput *qmicli_output_new            (const gchar *device_path,
+                                            const gchar *command,
+                                            const gchar *text_header);
+void          qmicli_output_add_string     (QmicliOutput *self,
+                                            const gchar *key,
+                                            const gchar *text_format,
+                                            const gchar *value);
+void          qmicli_output_add_uint       (QmicliOutput *self,
+                                            const gchar *key,
+                                            const gchar *text_format,
+                                            guint64 value);
+/* The value is an already built JSON value, e.g. from qmi_message_get_json(),
+ * given as it is in JSON output and as a single string otherwise */
+void          qmicli_output_add_json       (QmicliOutput *self,
+                                            const gchar *key,
+                                            const gchar *text_format,
+                                            const gchar *json);
+gchar        *qmicli_output_free_to_string (QmicliOutput *self);
+void          qmicli_output_flush          (QmicliOutput *self);
+
 #endif /* __QMICLI_H__ */
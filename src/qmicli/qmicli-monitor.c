@@ -0,0 +1,658 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * qmicli -- Command line interface to control QMI devices
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libqmi-glib.h>
+
+#include "qmicli.h"
+#include "qmicli-helpers.h"
+
+/* Context */
+typedef struct {
+    QmiDevice    *device;
+    GCancellable *cancellable;
+    GArray       *services;
+    GPtrArray    *clients;
+    guint         service_i;
+    gboolean      streaming;
+    gulong        indication_id;
+    gulong        cancelled_id;
+    gint64        start_time;
+    guint         n_indications;
+    guint         n_releasing;
+    gboolean      operation_status;
+} Context;
+static Context *ctx;
+
+static void
+context_free (Context *context)
+{
+    if (!context)
+        return;
+
+    if (context->indication_id)
+        g_signal_handler_disconnect (context->device, context->indication_id);
+    if (context->cancelled_id)
+        g_cancellable_disconnect (context->cancellable, context->cancelled_id);
+    if (context->cancellable)
+        g_object_unref (context->cancellable);
+    g_ptr_array_unref (context->clients);
+    g_array_unref (context->services);
+    g_object_unref (context->device);
+    g_slice_free (Context, context);
+}
+
+static void
+operation_shutdown (gboolean operation_status)
+{
+    /* Cleanup context and finish async operation */
+    context_free (ctx);
+    ctx = NULL;
+    qmicli_async_operation_done (operation_status, FALSE);
+}
+
+/*****************************************************************************/
+/* Indication records */
+
+static gboolean
+service_monitored (QmiService service)
+{
+    guint i;
+
+    for (i = 0; i < ctx->services->len; i++) {
+        if (g_array_index (ctx->services, QmiService, i) == service)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static void
+indication_cb (QmiDevice  *device,
+               QmiMessage *message)
+{
+    gint64 elapsed;
+
+    if (!service_monitored (qmi_message_get_service (message)))
+        return;
+
+    ctx->n_indications++;
+    elapsed = g_get_monotonic_time () - ctx->start_time;
+
+    if (qmicli_get_output_format () == QMICLI_OUTPUT_FORMAT_TEXT) {
+        GString *line;
+
+        /* One line per indication, with the same summary as in the traces */
+        line = g_string_new (NULL);
+        g_string_append_printf (line,
+                                "[%" G_GINT64_FORMAT ".%06" G_GINT64_FORMAT "] [%s] ",
+                                elapsed / G_USEC_PER_SEC,
+                                elapsed % G_USEC_PER_SEC,
+                                qmi_device_get_path_display (device));
+        qmi_message_append_summary (message, NULL, line);
+        g_print ("%s\n", line->str);
+        g_string_free (line, TRUE);
+    } else {
+        QmicliOutput *out;
+        gchar        *time_str;
+        gchar        *json;
+
+        out = qmicli_output_new (qmi_device_get_path_display (device), "indication", NULL);
+        time_str = g_strdup_printf ("%" G_GINT64_FORMAT ".%06" G_GINT64_FORMAT,
+                                    elapsed / G_USEC_PER_SEC,
+                                    elapsed % G_USEC_PER_SEC);
+        qmicli_output_add_string (out, "time", NULL, time_str);
+        g_free (time_str);
+        json = qmi_message_get_json (message, NULL);
+        qmicli_output_add_json (out, "message", NULL, json);
+        g_free (json);
+        qmicli_output_flush (out);
+    }
+}
+
+/*****************************************************************************/
+/* Shutdown */
+
+static void
+release_client_ready (QmiDevice    *device,
+                      GAsyncResult *res)
+{
+    GError *error = NULL;
+
+    if (!qmi_device_release_client_finish (device, res, &error)) {
+        g_printerr ("error: couldn't release client: %s\n", error->message);
+        g_error_free (error);
+    }
+
+    if (--ctx->n_releasing)
+        return;
+
+    g_debug ("Monitored %u indications", ctx->n_indications);
+    operation_shutdown (ctx->operation_status);
+}
+
+static void
+monitor_stop (gboolean operation_status)
+{
+    guint i;
+
+    ctx->streaming = FALSE;
+    ctx->operation_status = operation_status;
+
+    /* When monitoring through the proxy there are no clients to release, and
+     * the proxy stops forwarding indications as soon as we disconnect */
+    if (!ctx->clients->len) {
+        operation_shutdown (operation_status);
+        return;
+    }
+
+    ctx->n_releasing = ctx->clients->len;
+    for (i = 0; i < ctx->clients->len; i++)
+        qmi_device_release_client (ctx->device,
+                                   g_ptr_array_index (ctx->clients, i),
+                                   QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID,
+                                   10,
+                                   NULL,
+                                   (GAsyncReadyCallback) release_client_ready,
+                                   NULL);
+}
+
+static gboolean
+monitor_stop_idle (void)
+{
+    monitor_stop (TRUE);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+cancelled_cb (GCancellable *cancellable)
+{
+    /* Operations still running fail with the cancellation themselves */
+    if (ctx && ctx->streaming)
+        g_idle_add ((GSourceFunc) monitor_stop_idle, NULL);
+}
+
+static void
+monitor_start (void)
+{
+    g_debug ("Monitoring indications until interrupted...");
+    ctx->streaming = TRUE;
+}
+
+/*****************************************************************************/
+/* Registration for indications, when the clients are allocated */
+
+static void allocate_next_client (void);
+
+static void
+register_indications_done (QmiClient *client,
+                           GError    *error)
+{
+    if (error) {
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            g_error_free (error);
+            monitor_stop (TRUE);
+            return;
+        }
+        /* Not fatal, broadcast indications are still received */
+        g_printerr ("warning: couldn't register for '%s' indications: %s\n",
+                    qmi_service_get_string (qmi_client_get_service (client)),
+                    error->message);
+        g_error_free (error);
+    }
+
+    allocate_next_client ();
+}
+
+#if QMI_SERVICE_DMS_SUPPORTED
+
+static void
+dms_set_event_report_ready (QmiClientDms *client,
+                            GAsyncResult *res)
+{
+    QmiMessageDmsSetEventReportOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_dms_set_event_report_finish (client, res, &error);
+    if (output) {
+        qmi_message_dms_set_event_report_output_get_result (output, &error);
+        qmi_message_dms_set_event_report_output_unref (output);
+    }
+    register_indications_done (QMI_CLIENT (client), error);
+}
+
+static void
+dms_register_indications (QmiClientDms *client)
+{
+    QmiMessageDmsSetEventReportInput *input;
+
+    input = qmi_message_dms_set_event_report_input_new ();
+    qmi_message_dms_set_event_report_input_set_power_state_reporting (input, TRUE, NULL);
+    qmi_message_dms_set_event_report_input_set_pin_state_reporting (input, TRUE, NULL);
+    qmi_message_dms_set_event_report_input_set_activation_state_reporting (input, TRUE, NULL);
+    qmi_message_dms_set_event_report_input_set_operating_mode_reporting (input, TRUE, NULL);
+    qmi_message_dms_set_event_report_input_set_uim_state_reporting (input, TRUE, NULL);
+    qmi_message_dms_set_event_report_input_set_wireless_disable_state_reporting (input, TRUE, NULL);
+    qmi_client_dms_set_event_report (client,
+                                     input,
+                                     10,
+                                     ctx->cancellable,
+                                     (GAsyncReadyCallback) dms_set_event_report_ready,
+                                     NULL);
+    qmi_message_dms_set_event_report_input_unref (input);
+}
+
+#endif /* QMI_SERVICE_DMS_SUPPORTED */
+
+#if QMI_SERVICE_NAS_SUPPORTED
+
+static void
+nas_register_indications_ready (QmiClientNas *client,
+                                GAsyncResult *res)
+{
+    QmiMessageNasRegisterIndicationsOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_nas_register_indications_finish (client, res, &error);
+    if (output) {
+        qmi_message_nas_register_indications_output_get_result (output, &error);
+        qmi_message_nas_register_indications_output_unref (output);
+    }
+    register_indications_done (QMI_CLIENT (client), error);
+}
+
+static void
+nas_register_indications (QmiClientNas *client)
+{
+    QmiMessageNasRegisterIndicationsInput *input;
+
+    input = qmi_message_nas_register_indications_input_new ();
+    qmi_message_nas_register_indications_input_set_serving_system_events (input, TRUE, NULL);
+    qmi_message_nas_register_indications_input_set_system_info (input, TRUE, NULL);
+    qmi_message_nas_register_indications_input_set_signal_info (input, TRUE, NULL);
+    qmi_message_nas_register_indications_input_set_network_time (input, TRUE, NULL);
+    qmi_message_nas_register_indications_input_set_current_plmn_name (input, TRUE, NULL);
+    qmi_client_nas_register_indications (client,
+                                         input,
+                                         10,
+                                         ctx->cancellable,
+                                         (GAsyncReadyCallback) nas_register_indications_ready,
+                                         NULL);
+    qmi_message_nas_register_indications_input_unref (input);
+}
+
+#endif /* QMI_SERVICE_NAS_SUPPORTED */
+
+#if QMI_SERVICE_WDS_SUPPORTED
+
+static void
+wds_set_event_report_ready (QmiClientWds *client,
+                            GAsyncResult *res)
+{
+    QmiMessageWdsSetEventReportOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_wds_set_event_report_finish (client, res, &error);
+    if (output) {
+        qmi_message_wds_set_event_report_output_get_result (output, &error);
+        qmi_message_wds_set_event_report_output_unref (output);
+    }
+    register_indications_done (QMI_CLIENT (client), error);
+}
+
+static void
+wds_register_indications (QmiClientWds *client)
+{
+    QmiMessageWdsSetEventReportInput *input;
+
+    input = qmi_message_wds_set_event_report_input_new ();
+    qmi_message_wds_set_event_report_input_set_data_bearer_technology (input, TRUE, NULL);
+    qmi_message_wds_set_event_report_input_set_current_data_bearer_technology (input, TRUE, NULL);
+    qmi_message_wds_set_event_report_input_set_dormancy_status (input, TRUE, NULL);
+    qmi_message_wds_set_event_report_input_set_data_call_status (input, TRUE, NULL);
+    qmi_message_wds_set_event_report_input_set_data_systems (input, TRUE, NULL);
+    qmi_message_wds_set_event_report_input_set_extended_data_bearer_technology (input, TRUE, NULL);
+    qmi_client_wds_set_event_report (client,
+                                     input,
+                                     10,
+                                     ctx->cancellable,
+                                     (GAsyncReadyCallback) wds_set_event_report_ready,
+                                     NULL);
+    qmi_message_wds_set_event_report_input_unref (input);
+}
+
+#endif /* QMI_SERVICE_WDS_SUPPORTED */
+
+#if QMI_SERVICE_WMS_SUPPORTED
+
+static void
+wms_set_event_report_ready (QmiClientWms *client,
+                            GAsyncResult *res)
+{
+    QmiMessageWmsSetEventReportOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_wms_set_event_report_finish (client, res, &error);
+    if (output) {
+        qmi_message_wms_set_event_report_output_get_result (output, &error);
+        qmi_message_wms_set_event_report_output_unref (output);
+    }
+    register_indications_done (QMI_CLIENT (client), error);
+}
+
+static void
+wms_register_indications (QmiClientWms *client)
+{
+    QmiMessageWmsSetEventReportInput *input;
+
+    input = qmi_message_wms_set_event_report_input_new ();
+    qmi_message_wms_set_event_report_input_set_new_mt_message_indicator (input, TRUE, NULL);
+    qmi_client_wms_set_event_report (client,
+                                     input,
+                                     10,
+                                     ctx->cancellable,
+                                     (GAsyncReadyCallback) wms_set_event_report_ready,
+                                     NULL);
+    qmi_message_wms_set_event_report_input_unref (input);
+}
+
+#endif /* QMI_SERVICE_WMS_SUPPORTED */
+
+#if QMI_SERVICE_UIM_SUPPORTED
+
+static void
+uim_register_events_ready (QmiClientUim *client,
+                           GAsyncResult *res)
+{
+    QmiMessageUimRegisterEventsOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_uim_register_events_finish (client, res, &error);
+    if (output) {
+        qmi_message_uim_register_events_output_get_result (output, &error);
+        qmi_message_uim_register_events_output_unref (output);
+    }
+    register_indications_done (QMI_CLIENT (client), error);
+}
+
+static void
+uim_register_indications (QmiClientUim *client)
+{
+    QmiMessageUimRegisterEventsInput *input;
+
+    input = qmi_message_uim_register_events_input_new ();
+    qmi_message_uim_register_events_input_set_event_registration_mask (
+        input,
+        (QMI_UIM_EVENT_REGISTRATION_FLAG_CARD_STATUS |
+         QMI_UIM_EVENT_REGISTRATION_FLAG_SAP_CONNECTION),
+        NULL);
+    qmi_client_uim_register_events (client,
+                                    input,
+                                    10,
+                                    ctx->cancellable,
+                                    (GAsyncReadyCallback) uim_register_events_ready,
+                                    NULL);
+    qmi_message_uim_register_events_input_unref (input);
+}
+
+#endif /* QMI_SERVICE_UIM_SUPPORTED */
+
+#if QMI_SERVICE_PBM_SUPPORTED
+
+static void
+pbm_indication_register_ready (QmiClientPbm *client,
+                               GAsyncResult *res)
+{
+    QmiMessagePbmIndicationRegisterOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_pbm_indication_register_finish (client, res, &error);
+    if (output) {
+        qmi_message_pbm_indication_register_output_get_result (output, &error);
+        qmi_message_pbm_indication_register_output_unref (output);
+    }
+    register_indications_done (QMI_CLIENT (client), error);
+}
+
+static void
+pbm_register_indications (QmiClientPbm *client)
+{
+    QmiMessagePbmIndicationRegisterInput *input;
+
+    input = qmi_message_pbm_indication_register_input_new ();
+    qmi_message_pbm_indication_register_input_set_event_registration_mask (
+        input,
+        (QMI_PBM_EVENT_REGISTRATION_FLAG_RECORD_UPDATE |
+         QMI_PBM_EVENT_REGISTRATION_FLAG_PHONEBOOK_READY |
+         QMI_PBM_EVENT_REGISTRATION_FLAG_EMERGENCY_NUMBER_LIST |
+         QMI_PBM_EVENT_REGISTRATION_FLAG_HIDDEN_RECORD_STATUS),
+        NULL);
+    qmi_client_pbm_indication_register (client,
+                                        input,
+                                        10,
+                                        ctx->cancellable,
+                                        (GAsyncReadyCallback) pbm_indication_register_ready,
+                                        NULL);
+    qmi_message_pbm_indication_register_input_unref (input);
+}
+
+#endif /* QMI_SERVICE_PBM_SUPPORTED */
+
+#if QMI_SERVICE_PDC_SUPPORTED
+
+static void
+pdc_register_ready (QmiClientPdc *client,
+                    GAsyncResult *res)
+{
+    QmiMessagePdcRegisterOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_pdc_register_finish (client, res, &error);
+    if (output) {
+        qmi_message_pdc_register_output_get_result (output, &error);
+        qmi_message_pdc_register_output_unref (output);
+    }
+    register_indications_done (QMI_CLIENT (client), error);
+}
+
+static void
+pdc_register_indications (QmiClientPdc *client)
+{
+    QmiMessagePdcRegisterInput *input;
+
+    input = qmi_message_pdc_register_input_new ();
+    qmi_message_pdc_register_input_set_enable_reporting (input, TRUE, NULL);
+    qmi_client_pdc_register (client,
+                             input,
+                             10,
+                             ctx->cancellable,
+                             (GAsyncReadyCallback) pdc_register_ready,
+                             NULL);
+    qmi_message_pdc_register_input_unref (input);
+}
+
+#endif /* QMI_SERVICE_PDC_SUPPORTED */
+
+static void
+register_indications (QmiClient *client)
+{
+    switch (qmi_client_get_service (client)) {
+#if QMI_SERVICE_DMS_SUPPORTED
+    case QMI_SERVICE_DMS:
+        dms_register_indications (QMI_CLIENT_DMS (client));
+        return;
+#endif
+#if QMI_SERVICE_NAS_SUPPORTED
+    case QMI_SERVICE_NAS:
+        nas_register_indications (QMI_CLIENT_NAS (client));
+        return;
+#endif
+#if QMI_SERVICE_WDS_SUPPORTED
+    case QMI_SERVICE_WDS:
+        wds_register_indications (QMI_CLIENT_WDS (client));
+        return;
+#endif
+#if QMI_SERVICE_WMS_SUPPORTED
+    case QMI_SERVICE_WMS:
+        wms_register_indications (QMI_CLIENT_WMS (client));
+        return;
+#endif
+#if QMI_SERVICE_UIM_SUPPORTED
+    case QMI_SERVICE_UIM:
+        uim_register_indications (QMI_CLIENT_UIM (client));
+        return;
+#endif
+#if QMI_SERVICE_PBM_SUPPORTED
+    case QMI_SERVICE_PBM:
+        pbm_register_indications (QMI_CLIENT_PBM (client));
+        return;
+#endif
+#if QMI_SERVICE_PDC_SUPPORTED
+    case QMI_SERVICE_PDC:
+        pdc_register_indications (QMI_CLIENT_PDC (client));
+        return;
+#endif
+    default:
+        /* Only the broadcast indications of the service are received */
+        g_debug ("No registration for '%s' indications",
+                 qmi_service_get_string (qmi_client_get_service (client)));
+        allocate_next_client ();
+        return;
+    }
+}
+
+/*****************************************************************************/
+/* Client allocation, when not monitoring through the proxy */
+
+static void
+allocate_client_ready (QmiDevice    *device,
+                       GAsyncResult *res)
+{
+    QmiClient *client;
+    GError    *error = NULL;
+
+    client = qmi_device_allocate_client_finish (device, res, &error);
+    if (!client) {
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            g_error_free (error);
+            monitor_stop (TRUE);
+            return;
+        }
+        g_printerr ("error: couldn't create client for the '%s' service: %s\n",
+                    qmi_service_get_string (g_array_index (ctx->services, QmiService, ctx->service_i - 1)),
+                    error->message);
+        g_error_free (error);
+        /* Release the ones already allocated */
+        monitor_stop (FALSE);
+        return;
+    }
+
+    g_ptr_array_add (ctx->clients, client);
+    register_indications (client);
+}
+
+static void
+allocate_next_client (void)
+{
+    if (ctx->service_i == ctx->services->len) {
+        monitor_start ();
+        return;
+    }
+
+    qmi_device_allocate_client (ctx->device,
+                                g_array_index (ctx->services, QmiService, ctx->service_i++),
+                                QMI_CID_NONE,
+                                10,
+                                ctx->cancellable,
+                                (GAsyncReadyCallback) allocate_client_ready,
+                                NULL);
+}
+
+/*****************************************************************************/
+
+static void
+monitor_indications_ready (QmiDevice    *device,
+                           GAsyncResult *res)
+{
+    GError *error = NULL;
+
+    if (qmi_device_monitor_indications_finish (device, res, &error)) {
+        /* Indications requested by the other clients of the proxy are
+         * forwarded to us, no need to allocate our own */
+        g_debug ("Monitoring indications through the proxy");
+        monitor_start ();
+        return;
+    }
+
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_error_free (error);
+        monitor_stop (TRUE);
+        return;
+    }
+
+    if (!g_error_matches (error, QMI_CORE_ERROR, QMI_CORE_ERROR_UNSUPPORTED)) {
+        g_printerr ("error: couldn't monitor indications: %s\n", error->message);
+        g_error_free (error);
+        monitor_stop (FALSE);
+        return;
+    }
+
+    g_debug ("Cannot monitor indications through the proxy: %s", error->message);
+    g_error_free (error);
+    allocate_next_client ();
+}
+
+void
+qmicli_monitor_run (QmiDevice    *device,
+                    GArray       *services,
+                    GCancellable *cancellable)
+{
+    /* Initialize context */
+    ctx = g_slice_new0 (Context);
+    ctx->device = g_object_ref (device);
+    ctx->services = g_array_ref (services);
+    ctx->clients = g_ptr_array_new_with_free_func (g_object_unref);
+    ctx->start_time = g_get_monotonic_time ();
+    if (cancellable) {
+        ctx->cancellable = g_object_ref (cancellable);
+        ctx->cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (cancelled_cb), NULL, NULL);
+    }
+
+    ctx->indication_id = g_signal_connect (device,
+                                           QMI_DEVICE_SIGNAL_INDICATION,
+                                           G_CALLBACK (indication_cb),
+                                           NULL);
+
+    /* Prefer tapping the indications already requested through the proxy,
+     * so that the modem doesn't get any additional client */
+    qmi_device_monitor_indications (device,
+                                    services,
+                                    10,
+                                    ctx->cancellable,
+                                    (GAsyncReadyCallback) monitor_indications_ready,
+                                    NULL);
+}
@@ -32,7 +32,6 @@
 
 #include "qmicli.h"
 #include "qmicli-helpers.h"
-#include "qmicli-charsets.h"
 
 /* Context */
 typedef struct {
@@ -153,12 +152,12 @@ qmicli_nas_get_option_group (void)
     return group;
 }
 
+static guint n_actions;
+static gboolean checked;
+
 gboolean
 qmicli_nas_options_enabled (void)
 {
-    static guint n_actions = 0;
-    static gboolean checked = FALSE;
-
     if (checked)
         return !!n_actions;
 
@@ -190,6 +189,13 @@ qmicli_nas_options_enabled (void)
     return !!n_actions;
 }
 
+void
+qmicli_nas_options_reset (void)
+{
+    qmicli_reset_option_entries (entries);
+    checked = FALSE;
+}
+
 static void
 context_free (Context *context)
 {
@@ -698,6 +704,7 @@ get_home_network_ready (QmiClientNas *client,
 {
     QmiMessageNasGetHomeNetworkOutput *output;
     GError *error = NULL;
+    QmicliOutput *out;
 
     output = qmi_client_nas_get_home_network_finish (client, res, &error);
     if (!output) {
@@ -715,8 +722,9 @@ get_home_network_ready (QmiClientNas *client,
         return;
     }
 
-    g_print ("[%s] Successfully got home network:\n",
-             qmi_device_get_path_display (ctx->device));
+    out = qmicli_output_new (qmi_device_get_path_display (ctx->device),
+                             "nas-get-home-network",
+                             "[%s] Successfully got home network:\n");
 
     {
         guint16 mcc;
@@ -730,13 +738,10 @@ get_home_network_ready (QmiClientNas *client,
             &description,
             NULL);
 
-        g_print ("\tHome network:\n"
-                 "\t\tMCC: '%" G_GUINT16_FORMAT"'\n"
-                 "\t\tMNC: '%" G_GUINT16_FORMAT"'\n"
-                 "\t\tDescription: '%s'\n",
-                 mcc,
-                 mnc,
-                 description);
+        qmicli_output_add_uint   (out, "home-network.mcc",         "\tHome network:\n"
+                                                                  "\t\tMCC: '%s'\n", mcc);
+        qmicli_output_add_uint   (out, "home-network.mnc",         "\t\tMNC: '%s'\n", mnc);
+        qmicli_output_add_string (out, "home-network.description", "\t\tDescription: '%s'\n", description);
     }
 
     {
@@ -748,10 +753,8 @@ get_home_network_ready (QmiClientNas *client,
                 &sid,
                 &nid,
                 NULL)) {
-            g_print ("\t\tSID: '%" G_GUINT16_FORMAT"'\n"
-                     "\t\tNID: '%" G_GUINT16_FORMAT"'\n",
-                     sid,
-                     nid);
+            qmicli_output_add_uint (out, "home-system-id.sid", "\t\tSID: '%s'\n", sid);
+            qmicli_output_add_uint (out, "home-system-id.nid", "\t\tNID: '%s'\n", nid);
         }
     }
 
@@ -767,16 +770,16 @@ get_home_network_ready (QmiClientNas *client,
                 NULL, /* description_encoding */
                 NULL, /* description */
                 NULL)) {
-            g_print ("\t3GPP2 Home network (extended):\n"
-                     "\t\tMCC: '%" G_GUINT16_FORMAT"'\n"
-                     "\t\tMNC: '%" G_GUINT16_FORMAT"'\n",
-                     mcc,
-                     mnc);
+            qmicli_output_add_uint (out, "home-network-3gpp2.mcc", "\t3GPP2 Home network (extended):\n"
+                                                                   "\t\tMCC: '%s'\n", mcc);
+            qmicli_output_add_uint (out, "home-network-3gpp2.mnc", "\t\tMNC: '%s'\n", mnc);
 
             /* TODO: convert description to UTF-8 and display */
         }
     }
 
+    qmicli_output_flush (out);
+
     qmi_message_nas_get_home_network_output_unref (output);
     operation_shutdown (TRUE);
 }
@@ -2886,23 +2889,17 @@ garray_of_uint8_to_string (GArray *array,
 
     if (scheme == QMI_NAS_PLMN_ENCODING_SCHEME_GSM) {
         guint8 *unpacked;
-        guint32 unpacked_len = 0;
+        guint   unpacked_len;
 
         /* Unpack the GSM and decode it */
-        unpacked = qmicli_charset_gsm_unpack ((const guint8 *) array->data, (array->len * 8) / 7, &unpacked_len);
-        if (unpacked) {
-            decoded = (gchar *) qmicli_charset_gsm_unpacked_to_utf8 (unpacked, unpacked_len);
-            g_free (unpacked);
-        }
+        unpacked = g_malloc ((array->len * 8) / 7);
+        unpacked_len = qmi_charset_gsm7_unpack ((const guint8 *) array->data, array->len, (array->len * 8) / 7, unpacked);
+        decoded = g_malloc (QMI_CHARSET_GSM7_UTF8_SIZE (unpacked_len));
+        qmi_charset_gsm7_unpacked_to_utf8 (unpacked, unpacked_len, decoded, QMI_CHARSET_GSM7_UTF8_SIZE (unpacked_len));
+        g_free (unpacked);
     } else if (scheme == QMI_NAS_PLMN_ENCODING_SCHEME_UCS2LE) {
-        decoded = g_convert (
-                        array->data,
-                        array->len,
-                        "UTF-8",
-                        "UCS-2LE",
-                        NULL,
-                        NULL,
-                        NULL);
+        decoded = g_malloc (QMI_CHARSET_UCS2_UTF8_SIZE (array->len));
+        qmi_charset_ucs2_to_utf8 ((const guint8 *) array->data, array->len, QMI_ENDIAN_LITTLE, decoded, QMI_CHARSET_UCS2_UTF8_SIZE (array->len));
     }
 
     return decoded;
@@ -71,12 +71,12 @@ qmicli_pbm_get_option_group (void)
     return group;
 }
 
+static guint n_actions;
+static gboolean checked;
+
 gboolean
 qmicli_pbm_options_enabled (void)
 {
-    static guint n_actions = 0;
-    static gboolean checked = FALSE;
-
     if (checked)
         return !!n_actions;
 
@@ -92,6 +92,13 @@ qmicli_pbm_options_enabled (void)
     return !!n_actions;
 }
 
+void
+qmicli_pbm_options_reset (void)
+{
+    qmicli_reset_option_entries (entries);
+    checked = FALSE;
+}
+
 static void
 context_free (Context *context)
 {
@@ -35,25 +35,16 @@
 #include "qmicli-helpers.h"
 
 #define LIST_CONFIGS_TIMEOUT_SECS 2
-#define LOAD_CONFIG_CHUNK_SIZE 0x400
 
 /* Info about config */
 typedef struct {
     GArray *id;
     QmiPdcConfigurationType config_type;
-    guint32 token;
     guint32 version;
     gchar *description;
     guint32 total_size;
 } ConfigInfo;
 
-/* Info about loading config */
-typedef struct {
-    GMappedFile *mapped_file;
-    GArray *checksum;
-    gsize offset;
-} LoadConfigFileData;
-
 /* Context */
 typedef struct {
     QmiDevice *device;
@@ -61,18 +52,11 @@ typedef struct {
     GCancellable *cancellable;
 
     /* local data */
-    guint timeout_id;
     GArray *config_list;
     guint configs_loaded;
     GArray *active_config_id;
     GArray *pending_config_id;
     gboolean ids_loaded;
-    guint list_configs_indication_id;
-    guint get_selected_config_indication_id;
-
-    LoadConfigFileData *load_config_file_data;
-    guint load_config_indication_id;
-    guint get_config_info_indication_id;
 
     guint set_selected_config_indication_id;
     guint activate_config_indication_id;
@@ -137,12 +121,12 @@ qmicli_pdc_get_option_group (void)
     return group;
 }
 
+static guint n_actions;
+static gboolean checked;
+
 gboolean
 qmicli_pdc_options_enabled (void)
 {
-    static guint n_actions = 0;
-    static gboolean checked = FALSE;
-
     if (checked)
         return !!n_actions;
 
@@ -162,6 +146,13 @@ qmicli_pdc_options_enabled (void)
     return !!n_actions;
 }
 
+void
+qmicli_pdc_options_reset (void)
+{
+    qmicli_reset_option_entries (entries);
+    checked = FALSE;
+}
+
 static Context *
 context_new (QmiDevice *device,
              QmiClientPdc *client,
@@ -194,16 +185,6 @@ context_free (Context *context)
                 g_array_unref (current_config->id);
         }
         g_array_unref (context->config_list);
-        g_signal_handler_disconnect (context->client, context->list_configs_indication_id);
-        g_signal_handler_disconnect (context->client, context->get_config_info_indication_id);
-        g_signal_handler_disconnect (context->client, context->get_selected_config_indication_id);
-    }
-
-    if (context->load_config_file_data) {
-        g_array_unref (context->load_config_file_data->checksum);
-        g_mapped_file_unref (context->load_config_file_data->mapped_file);
-        g_slice_free (LoadConfigFileData, context->load_config_file_data);
-        g_signal_handler_disconnect (context->client, context->load_config_indication_id);
     }
 
     if (context->set_selected_config_indication_id)
@@ -277,7 +258,8 @@ print_configs (GArray *configs)
 static void
 check_list_config_completed (void)
 {
-    if (ctx->configs_loaded == ctx->config_list->len &&
+    if (ctx->config_list &&
+        ctx->configs_loaded == ctx->config_list->len &&
         ctx->ids_loaded) {
         print_configs (ctx->config_list);
         operation_shutdown (TRUE);
@@ -286,44 +268,27 @@ check_list_config_completed (void)
 
 static void
 get_config_info_ready (QmiClientPdc *client,
-                       GAsyncResult *res)
+                       GAsyncResult *res,
+                       ConfigInfo   *current_config)
 {
     GError *error = NULL;
-    QmiMessagePdcGetConfigInfoOutput *output;
+    QmiIndicationPdcGetConfigInfoOutput *output;
+    const gchar *description;
+    guint16 error_code = 0;
 
-    output = qmi_client_pdc_get_config_info_finish (client, res, &error);
+    /* The reply to the request is given in the indication */
+    output = qmi_client_pdc_get_config_info_with_indication_finish (client, res, &error);
     if (!output) {
-        g_printerr ("error: operation failed: %s\n", error->message);
-        g_error_free (error);
-        operation_shutdown (FALSE);
-        return;
-    }
-
-    if (!qmi_message_pdc_get_config_info_output_get_result (output, &error)) {
         g_printerr ("error: couldn't get config info: %s\n", error->message);
         g_error_free (error);
-        qmi_message_pdc_get_config_info_output_unref (output);
         operation_shutdown (FALSE);
         return;
     }
 
-    qmi_message_pdc_get_config_info_output_unref (output);
-}
-
-static void
-get_config_info_ready_indication (QmiClientPdc *client,
-                                  QmiIndicationPdcGetConfigInfoOutput *output)
-{
-    GError *error = NULL;
-    ConfigInfo *current_config = NULL;
-    guint32 token;
-    const gchar *description;
-    int i;
-    guint16 error_code = 0;
-
     if (!qmi_indication_pdc_get_config_info_output_get_indication_result (output, &error_code, &error)) {
         g_printerr ("error: couldn't get config info: %s\n", error->message);
         g_error_free (error);
+        qmi_indication_pdc_get_config_info_output_unref (output);
         operation_shutdown (FALSE);
         return;
     }
@@ -331,24 +296,11 @@ get_config_info_ready_indication (QmiClientPdc *client,
     if (error_code != 0) {
         g_printerr ("error: couldn't get config info: %s\n",
                     qmi_protocol_error_get_string ((QmiProtocolError) error_code));
+        qmi_indication_pdc_get_config_info_output_unref (output);
         operation_shutdown (FALSE);
         return;
     }
 
-    if (!qmi_indication_pdc_get_config_info_output_get_token (output, &token, &error)) {
-        g_printerr ("error: couldn't get config info token: %s\n", error->message);
-        g_error_free (error);
-        operation_shutdown (FALSE);
-        return;
-    }
-
-    /* Look for the current config in the list */
-    for (i = 0; i < ctx->config_list->len; i++) {
-        current_config = &g_array_index (ctx->config_list, ConfigInfo, i);
-        if (current_config->token == token)
-            break;
-    }
-
     /* Store total size, version and description of the current config */
     if (!qmi_indication_pdc_get_config_info_output_get_total_size (output,
                                                                    &current_config->total_size,
@@ -359,72 +311,47 @@ get_config_info_ready_indication (QmiClientPdc *client,
         !qmi_indication_pdc_get_config_info_output_get_description (output, &description, &error)) {
         g_printerr ("error: couldn't get config info details: %s\n", error->message);
         g_error_free (error);
+        qmi_indication_pdc_get_config_info_output_unref (output);
         operation_shutdown (FALSE);
         return;
     }
     current_config->description = g_strdup (description);
+    qmi_indication_pdc_get_config_info_output_unref (output);
 
     ctx->configs_loaded++;
 
     check_list_config_completed ();
 }
 
-static gboolean
-list_configs_timeout (void)
-{
-    /* No indication yet, cancelling */
-    if (!ctx->config_list) {
-        g_printf ("Total configurations: 0\n");
-        operation_shutdown (TRUE);
-    }
-
-    return FALSE;
-}
-
 static void
 list_configs_ready (QmiClientPdc *client,
                     GAsyncResult *res)
 {
     GError *error = NULL;
-    QmiMessagePdcListConfigsOutput *output;
+    QmiIndicationPdcListConfigsOutput *output;
+    GArray *configs = NULL;
+    int i;
+    guint16 error_code = 0;
 
-    output = qmi_client_pdc_list_configs_finish (client, res, &error);
+    output = qmi_client_pdc_list_configs_with_indication_finish (client, res, &error);
     if (!output) {
-        g_printerr ("error: operation failed: %s\n", error->message);
-        g_error_free (error);
-        operation_shutdown (FALSE);
-        return;
-    }
-
-    if (!qmi_message_pdc_list_configs_output_get_result (output, &error)) {
+        /* There will be no indication if no configs are loaded */
+        if (g_error_matches (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TIMEOUT)) {
+            g_error_free (error);
+            g_printf ("Total configurations: 0\n");
+            operation_shutdown (TRUE);
+            return;
+        }
         g_printerr ("error: couldn't list configs: %s\n", error->message);
         g_error_free (error);
-        qmi_message_pdc_list_configs_output_unref (output);
         operation_shutdown (FALSE);
         return;
     }
 
-    qmi_message_pdc_list_configs_output_unref (output);
-}
-
-static void
-list_configs_ready_indication (QmiClientPdc *client,
-                               QmiIndicationPdcListConfigsOutput *output)
-{
-    GError *error = NULL;
-    GArray *configs = NULL;
-    int i;
-    guint16 error_code = 0;
-
-    /* Remove timeout as soon as we get the indication */
-    if (ctx->timeout_id) {
-        g_source_remove (ctx->timeout_id);
-        ctx->timeout_id = 0;
-    }
-
     if (!qmi_indication_pdc_list_configs_output_get_indication_result (output, &error_code, &error)) {
         g_printerr ("error: couldn't list configs: %s\n", error->message);
         g_error_free (error);
+        qmi_indication_pdc_list_configs_output_unref (output);
         operation_shutdown (FALSE);
         return;
     }
@@ -432,6 +359,7 @@ list_configs_ready_indication (QmiClientPdc *client,
     if (error_code != 0) {
         g_printerr ("error: couldn't list config: %s\n",
                     qmi_protocol_error_get_string ((QmiProtocolError) error_code));
+        qmi_indication_pdc_list_configs_output_unref (output);
         operation_shutdown (FALSE);
         return;
     }
@@ -439,6 +367,7 @@ list_configs_ready_indication (QmiClientPdc *client,
     if (!qmi_indication_pdc_list_configs_output_get_configs (output, &configs, &error)) {
         g_printerr ("error: couldn't list configs: %s\n", error->message);
         g_error_free (error);
+        qmi_indication_pdc_list_configs_output_unref (output);
         operation_shutdown (FALSE);
         return;
     }
@@ -452,42 +381,36 @@ list_configs_ready_indication (QmiClientPdc *client,
         QmiIndicationPdcListConfigsOutputConfigsElement *element;
         QmiConfigTypeAndId type_with_id;
         QmiMessagePdcGetConfigInfoInput *input;
-        guint32 token = ctx->token++;
 
         element = &g_array_index (configs, QmiIndicationPdcListConfigsOutputConfigsElement, i);
 
         current_info = &g_array_index (ctx->config_list, ConfigInfo, i);
-        current_info->token = token;
         current_info->id = g_array_ref (element->id);
         current_info->config_type = element->config_type;
 
         input = qmi_message_pdc_get_config_info_input_new ();
 
-        /* Add type with id */
+        /* Add type with id; the token is set by the client */
         type_with_id.config_type = element->config_type;
         type_with_id.id = current_info->id;
         if (!qmi_message_pdc_get_config_info_input_set_type_with_id (input, &type_with_id, &error)) {
             g_printerr ("error: couldn't set type with id: %s\n", error->message);
             g_error_free (error);
+            qmi_message_pdc_get_config_info_input_unref (input);
+            qmi_indication_pdc_list_configs_output_unref (output);
             operation_shutdown (FALSE);
             return;
         }
 
-        /* Add token */
-        if (!qmi_message_pdc_get_config_info_input_set_token (input, token, &error)) {
-            g_printerr ("error: couldn't set token: %s\n", error->message);
-            g_error_free (error);
-            operation_shutdown (FALSE);
-            return;
-        }
-
-        qmi_client_pdc_get_config_info (ctx->client,
-                                        input,
-                                        10,
-                                        ctx->cancellable,
-                                        (GAsyncReadyCallback) get_config_info_ready, NULL);
+        qmi_client_pdc_get_config_info_with_indication (ctx->client,
+                                                        input,
+                                                        10,
+                                                        ctx->cancellable,
+                                                        (GAsyncReadyCallback) get_config_info_ready,
+                                                        current_info);
         qmi_message_pdc_get_config_info_input_unref (input);
     }
+    qmi_indication_pdc_list_configs_output_unref (output);
 
     check_list_config_completed ();
 }
@@ -496,33 +419,24 @@ static void
 get_selected_config_ready (QmiClientPdc *client,
                            GAsyncResult *res)
 {
+    GArray *pending_id = NULL;
+    GArray *active_id = NULL;
     GError *error = NULL;
-    QmiMessagePdcGetSelectedConfigOutput *output;
+    QmiIndicationPdcGetSelectedConfigOutput *output;
+    guint16 error_code = 0;
 
-    output = qmi_client_pdc_get_selected_config_finish (client, res, &error);
-    if (!qmi_message_pdc_get_selected_config_output_get_result (output, &error)) {
+    output = qmi_client_pdc_get_selected_config_with_indication_finish (client, res, &error);
+    if (!output) {
         g_printerr ("error: couldn't get selected config: %s\n", error->message);
         g_error_free (error);
-        qmi_message_pdc_get_selected_config_output_unref (output);
         operation_shutdown (FALSE);
         return;
     }
 
-    qmi_message_pdc_get_selected_config_output_unref (output);
-}
-
-static void
-get_selected_config_ready_indication (QmiClientPdc *client,
-                                      QmiIndicationPdcGetSelectedConfigOutput *output)
-{
-    GArray *pending_id = NULL;
-    GArray *active_id = NULL;
-    GError *error = NULL;
-    guint16 error_code = 0;
-
     if (!qmi_indication_pdc_get_selected_config_output_get_indication_result (output, &error_code, &error)) {
         g_printerr ("error: couldn't get selected config: %s\n", error->message);
         g_error_free (error);
+        qmi_indication_pdc_get_selected_config_output_unref (output);
         operation_shutdown (FALSE);
         return;
     }
@@ -531,6 +445,7 @@ get_selected_config_ready_indication (QmiClientPdc *client,
         error_code != QMI_PROTOCOL_ERROR_NOT_PROVISIONED) { /* No configs active */
         g_printerr ("error: couldn't get selected config: %s\n",
                     qmi_protocol_error_get_string ((QmiProtocolError) error_code));
+        qmi_indication_pdc_get_selected_config_output_unref (output);
         operation_shutdown (FALSE);
         return;
     }
@@ -541,6 +456,7 @@ get_selected_config_ready_indication (QmiClientPdc *client,
         ctx->active_config_id = g_array_ref (active_id);
     if (pending_id)
         ctx->pending_config_id = g_array_ref (pending_id);
+    qmi_indication_pdc_get_selected_config_output_unref (output);
 
     ctx->ids_loaded = TRUE;
 
@@ -606,8 +522,7 @@ list_configs_input_create (const gchar *str)
         return NULL;
 
     input = qmi_message_pdc_list_configs_input_new ();
-    if (!qmi_message_pdc_list_configs_input_set_config_type (input, config_type, &error) ||
-        !qmi_message_pdc_list_configs_input_set_token (input, ctx->token++, &error)) {
+    if (!qmi_message_pdc_list_configs_input_set_config_type (input, config_type, &error)) {
         g_printerr ("error: couldn't create input data bundle: '%s'\n", error->message);
         g_error_free (error);
         qmi_message_pdc_list_configs_input_unref (input);
@@ -667,8 +582,7 @@ get_selected_config_input_create (const gchar *str)
         return NULL;
 
     input = qmi_message_pdc_get_selected_config_input_new ();
-    if (!qmi_message_pdc_get_selected_config_input_set_config_type (input, config_type, &error) ||
-        !qmi_message_pdc_get_selected_config_input_set_token (input, ctx->token++, &error)) {
+    if (!qmi_message_pdc_get_selected_config_input_set_config_type (input, config_type, &error)) {
         g_printerr ("error: couldn't create input data bundle: '%s'\n", error->message);
         g_error_free (error);
         qmi_message_pdc_get_selected_config_input_unref (input);
@@ -951,111 +865,12 @@ set_selected_config_input_create (const gchar *str)
 /******************************************************************************/
 /* Load config */
 
-static LoadConfigFileData *
-load_config_file_from_string (const gchar *str)
-{
-    GError *error = NULL;
-    GMappedFile *mapped_file;
-    LoadConfigFileData *data;
-    guchar *file_contents;
-    GChecksum *checksum;
-    gsize file_size;
-    gsize hash_size;
-
-    if (!(mapped_file = g_mapped_file_new (str, FALSE, &error))) {
-        g_printerr ("error: couldn't map config file: '%s'\n", error->message);
-        g_error_free (error);
-        return NULL;
-    }
-
-    if (!(file_contents = (guchar *) g_mapped_file_get_contents (mapped_file))) {
-        g_printerr ("error: couldn't get file content\n");
-        g_mapped_file_unref (mapped_file);
-        return NULL;
-    }
-
-    /* Get checksum */
-    file_size = g_mapped_file_get_length (mapped_file);
-    hash_size = g_checksum_type_get_length (G_CHECKSUM_SHA1);
-    checksum = g_checksum_new (G_CHECKSUM_SHA1);
-    g_checksum_update (checksum, file_contents, file_size);
-
-    data = g_slice_new (LoadConfigFileData);
-    data->mapped_file = mapped_file;
-    data->checksum = g_array_sized_new (FALSE, FALSE, sizeof (guint8), hash_size);
-    g_array_set_size (data->checksum, hash_size);
-    data->offset = 0;
-    g_checksum_get_digest (checksum, &g_array_index (data->checksum, guint8, 0), &hash_size);
-
-    return data;
-}
-
-static QmiMessagePdcLoadConfigInput *
-load_config_input_create_chunk (LoadConfigFileData *config_file)
-{
-    QmiMessagePdcLoadConfigInput *input;
-    GError *error = NULL;
-    GArray *chunk;
-    gsize full_size;
-    gsize chunk_size;
-    guint8 *file_content;
-
-    if (!config_file)
-        return NULL;
-
-    input = qmi_message_pdc_load_config_input_new ();
-    if (!qmi_message_pdc_load_config_input_set_token (input, ctx->token++, &error)) {
-        g_printerr ("error: couldn't set token: '%s'\n", error->message);
-        g_error_free (error);
-        qmi_message_pdc_load_config_input_unref (input);
-        return NULL;
-    }
-
-    chunk = g_array_new (FALSE, FALSE, sizeof (guint8));
-    full_size = g_mapped_file_get_length (config_file->mapped_file);
-    chunk_size = (((config_file->offset + LOAD_CONFIG_CHUNK_SIZE) > full_size) ?
-                  (full_size - config_file->offset) :
-                  LOAD_CONFIG_CHUNK_SIZE);
-
-    file_content = (guint8 *) g_mapped_file_get_contents (config_file->mapped_file);
-    g_array_append_vals (chunk, &file_content[config_file->offset], chunk_size);
-    g_print ("Uploaded %" G_GSIZE_FORMAT "  of %" G_GSIZE_FORMAT "\n", config_file->offset, full_size);
-
-    if (!qmi_message_pdc_load_config_input_set_config_chunk (input,
-                                                             QMI_PDC_CONFIGURATION_TYPE_SOFTWARE,
-                                                             config_file->checksum,
-                                                             full_size,
-                                                             chunk,
-                                                             &error)) {
-        g_printerr ("error: couldn't set chunk: '%s'\n", error->message);
-        g_error_free (error);
-        g_array_unref (chunk);
-        qmi_message_pdc_load_config_input_unref (input);
-        return NULL;
-    }
-
-    config_file->offset += chunk_size;
-
-    g_array_unref (chunk);
-    return input;
-}
-
-static QmiMessagePdcLoadConfigInput *
-load_config_input_create (const gchar *str)
+static void
+load_config_progress (goffset  current_num_bytes,
+                      goffset  total_num_bytes,
+                      gpointer user_data)
 {
-    LoadConfigFileData *config_file;
-    QmiMessagePdcLoadConfigInput *input = NULL;
-
-    config_file = load_config_file_from_string (str);
-    if (!config_file)
-        return NULL;
-
-    input = load_config_input_create_chunk (config_file);
-    if (!input)
-        return NULL;
-
-    ctx->load_config_file_data = config_file;
-    return input;
+    g_print ("Loaded %" G_GOFFSET_FORMAT " of %" G_GOFFSET_FORMAT "\n", current_num_bytes, total_num_bytes);
 }
 
 static void
@@ -1063,84 +878,19 @@ load_config_ready (QmiClientPdc *client,
                    GAsyncResult *res)
 {
     GError *error = NULL;
-    QmiMessagePdcLoadConfigOutput *output;
-
-    output = qmi_client_pdc_load_config_finish (client, res, &error);
-    if (!output) {
-        g_printerr ("error: operation failed: %s\n", error->message);
-        g_error_free (error);
-        operation_shutdown (FALSE);
-        return;
-    }
-
-    if (!qmi_message_pdc_load_config_output_get_result (output, &error)) {
-        g_printerr ("error: couldn't load config: %s\n", error->message);
-        g_error_free (error);
-        qmi_message_pdc_load_config_output_unref (output);
-        operation_shutdown (FALSE);
-        return;
-    }
-
-    qmi_message_pdc_load_config_output_unref (output);
-}
-
-static void
-load_config_ready_indication (QmiClientPdc *client,
-                              QmiIndicationPdcLoadConfigOutput *output)
-{
-    GError *error = NULL;
-    QmiMessagePdcLoadConfigInput *input;
-    gboolean frame_reset;
-    guint32 remaining_size;
-    guint16 error_code = 0;
-
-    if (!qmi_indication_pdc_load_config_output_get_indication_result (output, &error_code, &error)) {
-        g_printerr ("error: couldn't load config: %s\n", error->message);
-        g_error_free (error);
-        operation_shutdown (FALSE);
-        return;
-    }
-
-    if (error_code != 0) {
-        g_printerr ("error: couldn't load config: %s\n",
-                    qmi_protocol_error_get_string ((QmiProtocolError) error_code));
-        operation_shutdown (FALSE);
-        return;
-    }
-
-    if (qmi_indication_pdc_load_config_output_get_frame_reset (output, &frame_reset, NULL) && frame_reset) {
-        g_printerr ("error: frame reset requested\n");
-        operation_shutdown (FALSE);
-        return;
-    }
+    GArray *id;
 
-    if (!qmi_indication_pdc_load_config_output_get_remaining_size (output, &remaining_size, &error)) {
+    id = qmi_client_pdc_load_config_from_file_finish (client, res, &error);
+    if (!id) {
         g_printerr ("error: couldn't load config: %s\n", error->message);
         g_error_free (error);
         operation_shutdown (FALSE);
         return;
     }
 
-    if (remaining_size == 0) {
-        g_print ("Finished loading\n");
-        operation_shutdown (TRUE);
-        return;
-    }
-
-    g_print ("Loading next chunk (%u bytes remaining)\n", remaining_size);
-    input = load_config_input_create_chunk (ctx->load_config_file_data);
-    if (!input) {
-        g_printerr ("error: couldn't create next chunk\n");
-        operation_shutdown (FALSE);
-        return;
-    }
-
-    qmi_client_pdc_load_config (ctx->client,
-                                input,
-                                10,
-                                ctx->cancellable,
-                                (GAsyncReadyCallback) load_config_ready, NULL);
-    qmi_message_pdc_load_config_input_unref (input);
+    g_print ("Finished loading\n");
+    g_array_unref (id);
+    operation_shutdown (TRUE);
 }
 
 /******************************************************************************/
@@ -1168,19 +918,6 @@ qmicli_pdc_run (QmiDevice *device,
 
         g_debug ("Listing configs asynchronously...");
 
-        /* Results are reported via indications */
-        ctx->list_configs_indication_id =
-            g_signal_connect (client,
-                              "list-configs",
-                              G_CALLBACK
-                              (list_configs_ready_indication), NULL);
-        ctx->get_selected_config_indication_id =
-            g_signal_connect (client, "get-selected-config",
-                              G_CALLBACK (get_selected_config_ready_indication), NULL);
-        ctx->get_config_info_indication_id =
-            g_signal_connect (client, "get-config-info",
-                              G_CALLBACK (get_config_info_ready_indication), NULL);
-
         input = list_configs_input_create (list_configs_str);
         if (!input) {
             operation_shutdown (FALSE);
@@ -1189,30 +926,27 @@ qmicli_pdc_run (QmiDevice *device,
 
         get_selected_config_input = get_selected_config_input_create (list_configs_str);
         if (!get_selected_config_input) {
+            qmi_message_pdc_list_configs_input_unref (input);
             operation_shutdown (FALSE);
             return;
         }
 
-        /* We need a timeout, because there will be no indications if no configs
-         * are loaded */
-        ctx->timeout_id = g_timeout_add_seconds (LIST_CONFIGS_TIMEOUT_SECS,
-                                                 (GSourceFunc) list_configs_timeout,
-                                                 NULL);
-
-        qmi_client_pdc_list_configs (ctx->client,
-                                     input,
-                                     10,
-                                     ctx->cancellable,
-                                     (GAsyncReadyCallback) list_configs_ready,
-                                     NULL);
+        /* Results are reported via indications, and if no configs are loaded
+         * there will be none, so don't wait long for it */
+        qmi_client_pdc_list_configs_with_indication (ctx->client,
+                                                     input,
+                                                     LIST_CONFIGS_TIMEOUT_SECS,
+                                                     ctx->cancellable,
+                                                     (GAsyncReadyCallback) list_configs_ready,
+                                                     NULL);
         qmi_message_pdc_list_configs_input_unref (input);
 
-        qmi_client_pdc_get_selected_config (ctx->client,
-                                            get_selected_config_input,
-                                            10,
-                                            ctx->cancellable,
-                                            (GAsyncReadyCallback) get_selected_config_ready,
-                                            NULL);
+        qmi_client_pdc_get_selected_config_with_indication (ctx->client,
+                                                            get_selected_config_input,
+                                                            10,
+                                                            ctx->cancellable,
+                                                            (GAsyncReadyCallback) get_selected_config_ready,
+                                                            NULL);
         qmi_message_pdc_get_selected_config_input_unref (get_selected_config_input);
         return;
     }
@@ -1304,29 +1038,16 @@ qmicli_pdc_run (QmiDevice *device,
     }
 
     if (load_config_str) {
-        QmiMessagePdcLoadConfigInput *input;
-
         g_debug ("Loading config asynchronously...");
-        input = load_config_input_create (load_config_str);
-        if (!input) {
-            operation_shutdown (FALSE);
-            return;
-        }
-
-        /* Results are reported via indications */
-        ctx->load_config_indication_id =
-            g_signal_connect (client,
-                              "load-config",
-                              G_CALLBACK (load_config_ready_indication),
-                              NULL);
-
-        qmi_client_pdc_load_config (ctx->client,
-                                    input,
-                                    10,
-                                    ctx->cancellable,
-                                    (GAsyncReadyCallback) load_config_ready,
-                                    NULL);
-        qmi_message_pdc_load_config_input_unref (input);
+        qmi_client_pdc_load_config_from_file (ctx->client,
+                                              load_config_str,
+                                              QMI_PDC_CONFIGURATION_TYPE_SOFTWARE,
+                                              1,
+                                              load_config_progress,
+                                              NULL,
+                                              ctx->cancellable,
+                                              (GAsyncReadyCallback) load_config_ready,
+                                              NULL);
         return;
     }
 
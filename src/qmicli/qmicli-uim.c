@@ -127,12 +127,12 @@ qmicli_uim_get_option_group (void)
     return group;
 }
 
+static guint n_actions;
+static gboolean checked;
+
 gboolean
 qmicli_uim_options_enabled (void)
 {
-    static guint n_actions = 0;
-    static gboolean checked = FALSE;
-
     if (checked)
         return !!n_actions;
 
@@ -159,6 +159,13 @@ qmicli_uim_options_enabled (void)
     return !!n_actions;
 }
 
+void
+qmicli_uim_options_reset (void)
+{
+    qmicli_reset_option_entries (entries);
+    checked = FALSE;
+}
+
 static void
 context_free (Context *context)
 {
@@ -77,12 +77,12 @@ qmicli_voice_get_option_group (void)
     return group;
 }
 
+static guint n_actions;
+static gboolean checked;
+
 gboolean
 qmicli_voice_options_enabled (void)
 {
-    static guint n_actions = 0;
-    static gboolean checked = FALSE;
-
     if (checked)
         return !!n_actions;
 
@@ -99,6 +99,13 @@ qmicli_voice_options_enabled (void)
     return !!n_actions;
 }
 
+void
+qmicli_voice_options_reset (void)
+{
+    qmicli_reset_option_entries (entries);
+    checked = FALSE;
+}
+
 static void
 context_free (Context *context)
 {
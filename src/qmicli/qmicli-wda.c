@@ -86,12 +86,12 @@ qmicli_wda_get_option_group (void)
     return group;
 }
 
+static guint n_actions;
+static gboolean checked;
+
 gboolean
 qmicli_wda_options_enabled (void)
 {
-    static guint n_actions = 0;
-    static gboolean checked = FALSE;
-
     if (checked)
         return !!n_actions;
 
@@ -109,6 +109,13 @@ qmicli_wda_options_enabled (void)
     return !!n_actions;
 }
 
+void
+qmicli_wda_options_reset (void)
+{
+    qmicli_reset_option_entries (entries);
+    checked = FALSE;
+}
+
 static void
 context_free (Context *context)
 {
@@ -143,6 +150,7 @@ get_data_format_ready (QmiClientWda *client,
 {
     QmiMessageWdaGetDataFormatOutput *output;
     GError *error = NULL;
+    QmicliOutput *out;
     gboolean qos_format;
     QmiWdaLinkLayerProtocol link_layer_protocol;
     QmiWdaDataAggregationProtocol data_aggregation_protocol;
@@ -165,53 +173,56 @@ get_data_format_ready (QmiClientWda *client,
         return;
     }
 
-    g_print ("[%s] Successfully got data format\n",
-             qmi_device_get_path_display (ctx->device));
+    out = qmicli_output_new (qmi_device_get_path_display (ctx->device),
+                             "wda-get-data-format",
+                             "[%s] Successfully got data format\n");
 
     if (qmi_message_wda_get_data_format_output_get_qos_format (
             output,
             &qos_format,
             NULL))
-        g_print ("                   QoS flow header: %s\n", qos_format ? "yes" : "no");
+        qmicli_output_add_string (out, "qos-format", "                   QoS flow header: %s\n", qos_format ? "yes" : "no");
 
     if (qmi_message_wda_get_data_format_output_get_link_layer_protocol (
             output,
             &link_layer_protocol,
             NULL))
-        g_print ("               Link layer protocol: '%s'\n",
-                 qmi_wda_link_layer_protocol_get_string (link_layer_protocol));
+        qmicli_output_add_string (out, "link-layer-protocol", "               Link layer protocol: '%s'\n",
+                                  qmi_wda_link_layer_protocol_get_string (link_layer_protocol));
 
     if (qmi_message_wda_get_data_format_output_get_uplink_data_aggregation_protocol (
             output,
             &data_aggregation_protocol,
             NULL))
-        g_print ("  Uplink data aggregation protocol: '%s'\n",
-                 qmi_wda_data_aggregation_protocol_get_string (data_aggregation_protocol));
+        qmicli_output_add_string (out, "uplink-data-aggregation-protocol", "  Uplink data aggregation protocol: '%s'\n",
+                                  qmi_wda_data_aggregation_protocol_get_string (data_aggregation_protocol));
 
     if (qmi_message_wda_get_data_format_output_get_downlink_data_aggregation_protocol (
             output,
             &data_aggregation_protocol,
             NULL))
-        g_print ("Downlink data aggregation protocol: '%s'\n",
-                 qmi_wda_data_aggregation_protocol_get_string (data_aggregation_protocol));
+        qmicli_output_add_string (out, "downlink-data-aggregation-protocol", "Downlink data aggregation protocol: '%s'\n",
+                                  qmi_wda_data_aggregation_protocol_get_string (data_aggregation_protocol));
 
     if (qmi_message_wda_get_data_format_output_get_ndp_signature (
             output,
             &ndp_signature,
             NULL))
-        g_print ("                     NDP signature: '%u'\n", ndp_signature);
+        qmicli_output_add_uint (out, "ndp-signature", "                     NDP signature: '%s'\n", ndp_signature);
 
     if (qmi_message_wda_get_data_format_output_get_uplink_data_aggregation_max_size (
             output,
             &data_aggregation_max_size,
             NULL))
-        g_print ("  Uplink data aggregation max size: '%u'\n", data_aggregation_max_size);
+        qmicli_output_add_uint (out, "uplink-data-aggregation-max-size", "  Uplink data aggregation max size: '%s'\n", data_aggregation_max_size);
 
     if (qmi_message_wda_get_data_format_output_get_downlink_data_aggregation_max_size (
             output,
             &data_aggregation_max_size,
             NULL))
-        g_print ("Downlink data aggregation max size: '%u'\n", data_aggregation_max_size);
+        qmicli_output_add_uint (out, "downlink-data-aggregation-max-size", "Downlink data aggregation max size: '%s'\n", data_aggregation_max_size);
+
+    qmicli_output_flush (out);
 
     qmi_message_wda_get_data_format_output_unref (output);
     operation_shutdown (TRUE);
@@ -223,6 +234,7 @@ set_data_format_ready (QmiClientWda *client,
 {
     QmiMessageWdaSetDataFormatOutput *output;
     GError *error = NULL;
+    QmicliOutput *out;
     gboolean qos_format;
     QmiWdaLinkLayerProtocol link_layer_protocol;
     QmiWdaDataAggregationProtocol data_aggregation_protocol;
@@ -246,53 +258,56 @@ set_data_format_ready (QmiClientWda *client,
         return;
     }
 
-    g_print ("[%s] Successfully set data format\n",
-             qmi_device_get_path_display (ctx->device));
+    out = qmicli_output_new (qmi_device_get_path_display (ctx->device),
+                             "wda-set-data-format",
+                             "[%s] Successfully set data format\n");
 
     if (qmi_message_wda_set_data_format_output_get_qos_format (
             output,
             &qos_format,
             NULL))
-        g_print ("                        QoS flow header: %s\n", qos_format ? "yes" : "no");
+        qmicli_output_add_string (out, "qos-format", "                        QoS flow header: %s\n", qos_format ? "yes" : "no");
 
     if (qmi_message_wda_set_data_format_output_get_link_layer_protocol (
             output,
             &link_layer_protocol,
             NULL))
-        g_print ("                    Link layer protocol: '%s'\n",
-                 qmi_wda_link_layer_protocol_get_string (link_layer_protocol));
+        qmicli_output_add_string (out, "link-layer-protocol", "                    Link layer protocol: '%s'\n",
+                                  qmi_wda_link_layer_protocol_get_string (link_layer_protocol));
 
     if (qmi_message_wda_set_data_format_output_get_uplink_data_aggregation_protocol (
             output,
             &data_aggregation_protocol,
             NULL))
-        g_print ("       Uplink data aggregation protocol: '%s'\n",
-                 qmi_wda_data_aggregation_protocol_get_string (data_aggregation_protocol));
+        qmicli_output_add_string (out, "uplink-data-aggregation-protocol", "       Uplink data aggregation protocol: '%s'\n",
+                                  qmi_wda_data_aggregation_protocol_get_string (data_aggregation_protocol));
 
     if (qmi_message_wda_set_data_format_output_get_downlink_data_aggregation_protocol (
             output,
             &data_aggregation_protocol,
             NULL))
-        g_print ("     Downlink data aggregation protocol: '%s'\n",
-                 qmi_wda_data_aggregation_protocol_get_string (data_aggregation_protocol));
+        qmicli_output_add_string (out, "downlink-data-aggregation-protocol", "     Downlink data aggregation protocol: '%s'\n",
+                                  qmi_wda_data_aggregation_protocol_get_string (data_aggregation_protocol));
 
     if (qmi_message_wda_set_data_format_output_get_ndp_signature (
             output,
             &ndp_signature,
             NULL))
-        g_print ("                          NDP signature: '%u'\n", ndp_signature);
+        qmicli_output_add_uint (out, "ndp-signature", "                          NDP signature: '%s'\n", ndp_signature);
 
     if (qmi_message_wda_set_data_format_output_get_downlink_data_aggregation_max_datagrams (
             output,
             &data_aggregation_max_datagrams,
             NULL))
-        g_print ("Downlink data aggregation max datagrams: '%u'\n", data_aggregation_max_datagrams);
+        qmicli_output_add_uint (out, "downlink-data-aggregation-max-datagrams", "Downlink data aggregation max datagrams: '%s'\n", data_aggregation_max_datagrams);
 
     if (qmi_message_wda_set_data_format_output_get_downlink_data_aggregation_max_size (
             output,
             &data_aggregation_max_size,
             NULL))
-        g_print ("     Downlink data aggregation max size: '%u'\n", data_aggregation_max_size);
+        qmicli_output_add_uint (out, "downlink-data-aggregation-max-size", "     Downlink data aggregation max size: '%s'\n", data_aggregation_max_size);
+
+    qmicli_output_flush (out);
 
     qmi_message_wda_set_data_format_output_unref (output);
     operation_shutdown (TRUE);
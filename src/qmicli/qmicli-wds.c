@@ -178,12 +178,12 @@ qmicli_wds_get_option_group (void)
     return group;
 }
 
+static guint n_actions;
+static gboolean checked;
+
 gboolean
 qmicli_wds_options_enabled (void)
 {
-    static guint n_actions = 0;
-    static gboolean checked = FALSE;
-
     if (checked)
         return !!n_actions;
 
@@ -221,6 +221,13 @@ qmicli_wds_options_enabled (void)
     return !!n_actions;
 }
 
+void
+qmicli_wds_options_reset (void)
+{
+    qmicli_reset_option_entries (entries);
+    checked = FALSE;
+}
+
 static void
 context_free (Context *context)
 {
@@ -273,8 +280,9 @@ stop_network_ready (QmiClientWds *client,
 #undef VALIDATE_UNKNOWN
 #define VALIDATE_UNKNOWN(str) (str ? str : "unknown")
 
-    g_print ("[%s] Network stopped\n",
-             qmi_device_get_path_display (ctx->device));
+    qmicli_output_flush (qmicli_output_new (qmi_device_get_path_display (ctx->device),
+                                            "wds-stop-network",
+                                            "[%s] Network stopped\n"));
     qmi_message_wds_stop_network_output_unref (output);
     operation_shutdown (TRUE);
 }
@@ -647,10 +655,13 @@ start_network_ready (QmiClientWds *client,
 #undef VALIDATE_UNKNOWN
 #define VALIDATE_UNKNOWN(str) (str ? str : "unknown")
 
-    g_print ("[%s] Network started\n"
-             "\tPacket data handle: '%u'\n",
-             qmi_device_get_path_display (ctx->device),
-             (guint)ctx->packet_data_handle);
+    {
+        QmicliOutput *out;
+
+        out = qmicli_output_new (qmi_device_get_path_display (ctx->device), "wds-start-network", "[%s] Network started\n");
+        qmicli_output_add_uint (out, "packet-data-handle", "\tPacket data handle: '%s'\n", ctx->packet_data_handle);
+        qmicli_output_flush (out);
+    }
 
     if (follow_network_flag) {
         g_print ("\nCtrl+C will stop the network\n");
@@ -683,8 +694,10 @@ get_current_settings_ready (QmiClientWds *client,
     struct in6_addr in6_addr_val;
     gchar buf4[INET_ADDRSTRLEN];
     gchar buf6[INET6_ADDRSTRLEN];
+    gchar buf6_prefix[INET6_ADDRSTRLEN + 4];
     guint8 prefix = 0;
     guint i;
+    QmicliOutput *out;
 
     output = qmi_client_wds_get_current_settings_finish (client, res, &error);
     if (!output) {
@@ -702,14 +715,15 @@ get_current_settings_ready (QmiClientWds *client,
         return;
     }
 
-    g_print ("[%s] Current settings retrieved:\n",
-             qmi_device_get_path_display (ctx->device));
+    out = qmicli_output_new (qmi_device_get_path_display (ctx->device),
+                             "wds-get-current-settings",
+                             "[%s] Current settings retrieved:\n");
 
     if (qmi_message_wds_get_current_settings_output_get_ip_family (output, &ip_family, NULL))
-        g_print ("           IP Family: %s\n",
-                 ((ip_family == QMI_WDS_IP_FAMILY_IPV4) ? "IPv4" :
-                  ((ip_family == QMI_WDS_IP_FAMILY_IPV6) ? "IPv6" :
-                   "unknown")));
+        qmicli_output_add_string (out, "ip-family", "           IP Family: %s\n",
+                                  ((ip_family == QMI_WDS_IP_FAMILY_IPV4) ? "IPv4" :
+                                   ((ip_family == QMI_WDS_IP_FAMILY_IPV6) ? "IPv6" :
+                                    "unknown")));
 
     /* IPv4... */
 
@@ -717,35 +731,35 @@ get_current_settings_ready (QmiClientWds *client,
         in_addr_val.s_addr = GUINT32_TO_BE (addr);
         memset (buf4, 0, sizeof (buf4));
         inet_ntop (AF_INET, &in_addr_val, buf4, sizeof (buf4));
-        g_print ("        IPv4 address: %s\n", buf4);
+        qmicli_output_add_string (out, "ipv4-address", "        IPv4 address: %s\n", buf4);
     }
 
     if (qmi_message_wds_get_current_settings_output_get_ipv4_gateway_subnet_mask (output, &addr, NULL)) {
         in_addr_val.s_addr = GUINT32_TO_BE (addr);
         memset (buf4, 0, sizeof (buf4));
         inet_ntop (AF_INET, &in_addr_val, buf4, sizeof (buf4));
-        g_print ("    IPv4 subnet mask: %s\n", buf4);
+        qmicli_output_add_string (out, "ipv4-gateway-subnet-mask", "    IPv4 subnet mask: %s\n", buf4);
     }
 
     if (qmi_message_wds_get_current_settings_output_get_ipv4_gateway_address (output, &addr, NULL)) {
         in_addr_val.s_addr = GUINT32_TO_BE (addr);
         memset (buf4, 0, sizeof (buf4));
         inet_ntop (AF_INET, &in_addr_val, buf4, sizeof (buf4));
-        g_print ("IPv4 gateway address: %s\n", buf4);
+        qmicli_output_add_string (out, "ipv4-gateway-address", "IPv4 gateway address: %s\n", buf4);
     }
 
     if (qmi_message_wds_get_current_settings_output_get_primary_ipv4_dns_address (output, &addr, NULL)) {
         in_addr_val.s_addr = GUINT32_TO_BE (addr);
         memset (buf4, 0, sizeof (buf4));
         inet_ntop (AF_INET, &in_addr_val, buf4, sizeof (buf4));
-        g_print ("    IPv4 primary DNS: %s\n", buf4);
+        qmicli_output_add_string (out, "primary-ipv4-dns-address", "    IPv4 primary DNS: %s\n", buf4);
     }
 
     if (qmi_message_wds_get_current_settings_output_get_secondary_ipv4_dns_address (output, &addr, NULL)) {
         in_addr_val.s_addr = GUINT32_TO_BE (addr);
         memset (buf4, 0, sizeof (buf4));
         inet_ntop (AF_INET, &in_addr_val, buf4, sizeof (buf4));
-        g_print ("  IPv4 secondary DNS: %s\n", buf4);
+        qmicli_output_add_string (out, "secondary-ipv4-dns-address", "  IPv4 secondary DNS: %s\n", buf4);
     }
 
     /* IPv6... */
@@ -755,7 +769,8 @@ get_current_settings_ready (QmiClientWds *client,
             in6_addr_val.s6_addr16[i] = GUINT16_TO_BE (g_array_index (array, guint16, i));
         memset (buf6, 0, sizeof (buf6));
         inet_ntop (AF_INET6, &in6_addr_val, buf6, sizeof (buf6));
-        g_print ("        IPv6 address: %s/%d\n", buf6, prefix);
+        g_snprintf (buf6_prefix, sizeof (buf6_prefix), "%s/%u", buf6, prefix);
+        qmicli_output_add_string (out, "ipv6-address", "        IPv6 address: %s\n", buf6_prefix);
     }
 
     if (qmi_message_wds_get_current_settings_output_get_ipv6_gateway_address (output, &array, &prefix, NULL)) {
@@ -763,7 +778,8 @@ get_current_settings_ready (QmiClientWds *client,
             in6_addr_val.s6_addr16[i] = GUINT16_TO_BE (g_array_index (array, guint16, i));
         memset (buf6, 0, sizeof (buf6));
         inet_ntop (AF_INET6, &in6_addr_val, buf6, sizeof (buf6));
-        g_print ("IPv6 gateway address: %s/%d\n", buf6, prefix);
+        g_snprintf (buf6_prefix, sizeof (buf6_prefix), "%s/%u", buf6, prefix);
+        qmicli_output_add_string (out, "ipv6-gateway-address", "IPv6 gateway address: %s\n", buf6_prefix);
     }
 
     if (qmi_message_wds_get_current_settings_output_get_ipv6_primary_dns_address (output, &array, NULL)) {
@@ -771,7 +787,7 @@ get_current_settings_ready (QmiClientWds *client,
             in6_addr_val.s6_addr16[i] = GUINT16_TO_BE (g_array_index (array, guint16, i));
         memset (buf6, 0, sizeof (buf6));
         inet_ntop (AF_INET6, &in6_addr_val, buf6, sizeof (buf6));
-        g_print ("    IPv6 primary DNS: %s\n", buf6);
+        qmicli_output_add_string (out, "ipv6-primary-dns-address", "    IPv6 primary DNS: %s\n", buf6);
     }
 
     if (qmi_message_wds_get_current_settings_output_get_ipv6_secondary_dns_address (output, &array, NULL)) {
@@ -779,13 +795,13 @@ get_current_settings_ready (QmiClientWds *client,
             in6_addr_val.s6_addr16[i] = GUINT16_TO_BE (g_array_index (array, guint16, i));
         memset (buf6, 0, sizeof (buf6));
         inet_ntop (AF_INET6, &in6_addr_val, buf6, sizeof (buf6));
-        g_print ("  IPv6 secondary DNS: %s\n", buf6);
+        qmicli_output_add_string (out, "ipv6-secondary-dns-address", "  IPv6 secondary DNS: %s\n", buf6);
     }
 
     /* Other... */
 
     if (qmi_message_wds_get_current_settings_output_get_mtu (output, &mtu, NULL))
-        g_print ("                 MTU: %u\n", mtu);
+        qmicli_output_add_uint (out, "mtu", "                 MTU: %s\n", mtu);
 
     if (qmi_message_wds_get_current_settings_output_get_domain_name_list (output, &array, &error)) {
         GString *s = NULL;
@@ -800,12 +816,13 @@ get_current_settings_ready (QmiClientWds *client,
             }
         }
         if (s) {
-            g_print ("             Domains: %s\n", s->str);
+            qmicli_output_add_string (out, "domain-name-list", "             Domains: %s\n", s->str);
             g_string_free (s, TRUE);
         } else
-            g_print ("             Domains: none\n");
+            qmicli_output_add_string (out, "domain-name-list", "             Domains: none\n", NULL);
     }
 
+    qmicli_output_flush (out);
     qmi_message_wds_get_current_settings_output_unref (output);
     operation_shutdown (TRUE);
 }
@@ -817,6 +834,7 @@ get_packet_service_status_ready (QmiClientWds *client,
     GError *error = NULL;
     QmiMessageWdsGetPacketServiceStatusOutput *output;
     QmiWdsConnectionStatus status;
+    QmicliOutput *out;
 
     output = qmi_client_wds_get_packet_service_status_finish (client, res, &error);
     if (!output) {
@@ -840,9 +858,9 @@ get_packet_service_status_ready (QmiClientWds *client,
         &status,
         NULL);
 
-    g_print ("[%s] Connection status: '%s'\n",
-             qmi_device_get_path_display (ctx->device),
-             qmi_wds_connection_status_get_string (status));
+    out = qmicli_output_new (qmi_device_get_path_display (ctx->device), "wds-get-packet-service-status", "[%s] ");
+    qmicli_output_add_string (out, "connection-status", "Connection status: '%s'\n", qmi_wds_connection_status_get_string (status));
+    qmicli_output_flush (out);
 
     qmi_message_wds_get_packet_service_status_output_unref (output);
     operation_shutdown (TRUE);
@@ -856,6 +874,7 @@ get_packet_statistics_ready (QmiClientWds *client,
     QmiMessageWdsGetPacketStatisticsOutput *output;
     guint32 val32;
     guint64 val64;
+    QmicliOutput *out;
 
     output = qmi_client_wds_get_packet_statistics_finish (client, res, &error);
     if (!output) {
@@ -874,42 +893,45 @@ get_packet_statistics_ready (QmiClientWds *client,
         return;
     }
 
-    g_print ("[%s] Connection statistics:\n",
-             qmi_device_get_path_display (ctx->device));
+    out = qmicli_output_new (qmi_device_get_path_display (ctx->device),
+                             "wds-get-packet-statistics",
+                             "[%s] Connection statistics:\n");
 
     if (qmi_message_wds_get_packet_statistics_output_get_tx_packets_ok (output, &val32, NULL) &&
         val32 != 0xFFFFFFFF)
-        g_print ("\tTX packets OK: %u\n", val32);
+        qmicli_output_add_uint (out, "tx-packets-ok", "\tTX packets OK: %s\n", val32);
     if (qmi_message_wds_get_packet_statistics_output_get_rx_packets_ok (output, &val32, NULL) &&
         val32 != 0xFFFFFFFF)
-        g_print ("\tRX packets OK: %u\n", val32);
+        qmicli_output_add_uint (out, "rx-packets-ok", "\tRX packets OK: %s\n", val32);
     if (qmi_message_wds_get_packet_statistics_output_get_tx_packets_error (output, &val32, NULL) &&
         val32 != 0xFFFFFFFF)
-        g_print ("\tTX packets error: %u\n", val32);
+        qmicli_output_add_uint (out, "tx-packets-error", "\tTX packets error: %s\n", val32);
     if (qmi_message_wds_get_packet_statistics_output_get_rx_packets_error (output, &val32, NULL) &&
         val32 != 0xFFFFFFFF)
-        g_print ("\tRX packets error: %u\n", val32);
+        qmicli_output_add_uint (out, "rx-packets-error", "\tRX packets error: %s\n", val32);
     if (qmi_message_wds_get_packet_statistics_output_get_tx_overflows (output, &val32, NULL) &&
         val32 != 0xFFFFFFFF)
-        g_print ("\tTX overflows: %u\n", val32);
+        qmicli_output_add_uint (out, "tx-overflows", "\tTX overflows: %s\n", val32);
     if (qmi_message_wds_get_packet_statistics_output_get_rx_overflows (output, &val32, NULL) &&
         val32 != 0xFFFFFFFF)
-        g_print ("\tRX overflows: %u\n", val32);
+        qmicli_output_add_uint (out, "rx-overflows", "\tRX overflows: %s\n", val32);
     if (qmi_message_wds_get_packet_statistics_output_get_tx_packets_dropped (output, &val32, NULL) &&
         val32 != 0xFFFFFFFF)
-        g_print ("\tTX packets dropped: %u\n", val32);
+        qmicli_output_add_uint (out, "tx-packets-dropped", "\tTX packets dropped: %s\n", val32);
     if (qmi_message_wds_get_packet_statistics_output_get_rx_packets_dropped (output, &val32, NULL) &&
         val32 != 0xFFFFFFFF)
-        g_print ("\tRX packets dropped: %u\n", val32);
+        qmicli_output_add_uint (out, "rx-packets-dropped", "\tRX packets dropped: %s\n", val32);
 
     if (qmi_message_wds_get_packet_statistics_output_get_tx_bytes_ok (output, &val64, NULL))
-        g_print ("\tTX bytes OK: %" G_GUINT64_FORMAT "\n", val64);
+        qmicli_output_add_uint (out, "tx-bytes-ok", "\tTX bytes OK: %s\n", val64);
     if (qmi_message_wds_get_packet_statistics_output_get_rx_bytes_ok (output, &val64, NULL))
-        g_print ("\tRX bytes OK: %" G_GUINT64_FORMAT "\n", val64);
+        qmicli_output_add_uint (out, "rx-bytes-ok", "\tRX bytes OK: %s\n", val64);
     if (qmi_message_wds_get_packet_statistics_output_get_last_call_tx_bytes_ok (output, &val64, NULL))
-        g_print ("\tTX bytes OK (last): %" G_GUINT64_FORMAT "\n", val64);
+        qmicli_output_add_uint (out, "last-call-tx-bytes-ok", "\tTX bytes OK (last): %s\n", val64);
     if (qmi_message_wds_get_packet_statistics_output_get_last_call_rx_bytes_ok (output, &val64, NULL))
-        g_print ("\tRX bytes OK (last): %" G_GUINT64_FORMAT "\n", val64);
+        qmicli_output_add_uint (out, "last-call-rx-bytes-ok", "\tRX bytes OK (last): %s\n", val64);
+
+    qmicli_output_flush (out);
 
     qmi_message_wds_get_packet_statistics_output_unref (output);
     operation_shutdown (TRUE);
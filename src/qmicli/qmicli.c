@@ -24,6 +24,8 @@
 #include <stdlib.h>
 #include <locale.h>
 #include <string.h>
+#include <unistd.h>
+#include <glob.h>
 
 #include <glib.h>
 #include <glib/gprintf.h>
@@ -52,12 +54,17 @@ static gboolean operation_status;
 
 /* Main options */
 static gchar *device_str;
+static gchar **device_strv;
+static gchar *device_timeout_str;
 static gboolean get_service_version_info_flag;
+static gboolean get_transactions_flag;
+static gboolean proxy_stats_flag;
 static gboolean get_wwan_iface_flag;
 static gboolean get_expected_data_format_flag;
 static gchar *set_expected_data_format_str;
 static gchar *device_set_instance_id_str;
 static gboolean device_open_version_info_flag;
+static gchar *device_open_version_info_cache_str;
 static gboolean device_open_sync_flag;
 static gchar *device_open_net_str;
 static gboolean device_open_proxy_flag;
@@ -66,15 +73,50 @@ static gboolean device_open_mbim_flag;
 static gboolean device_open_auto_flag;
 static gchar *client_cid_str;
 static gboolean client_no_release_cid_flag;
+static gchar *client_cid_pool_str;
 static gboolean verbose_flag;
 static gboolean silent_flag;
 static gboolean version_flag;
+static gchar *trace_record_str;
+static gchar *trace_decode_str;
+static gchar *trace_schema_str;
+static gchar *benchmark_str;
+static gchar *benchmark_count_str;
+static gchar *benchmark_concurrency_str;
+static gchar *batch_str;
+static gchar *monitor_str;
+static gchar *output_format_str;
+
+/* Benchmark settings, if requested */
+static guint16 benchmark_message_id;
+static guint benchmark_count = 100;
+static guint benchmark_concurrency = 1;
+
+/* Services to monitor, if requested */
+static GArray *monitor_services;
+
+/* Batch of actions, if requested */
+static GPtrArray *batch_lines;
+static guint batch_line_i;
+static gboolean batch_failed;
+static gboolean batch_skip_cid_release;
+static QmiClient *batch_clients[G_MAXUINT8 + 1];
+static guint batch_n_releasing;
+
+/* Binary trace of the traffic, if requested */
+static QmiTraceRing *trace_ring;
+
+#define TRACE_RING_SIZE (1024 * 1024)
 
 static GOptionEntry main_entries[] = {
-    { "device", 'd', 0, G_OPTION_ARG_STRING, &device_str,
-      "Specify device path",
+    { "device", 'd', 0, G_OPTION_ARG_STRING_ARRAY, &device_strv,
+      "Specify device path; if given multiple times or as a glob pattern, the action is run on all devices at once",
       "[PATH]"
     },
+    { "device-timeout", 0, 0, G_OPTION_ARG_STRING, &device_timeout_str,
+      "Cancel the operation on each device if not finished in the given time",
+      "[SECONDS]"
+    },
     { "get-wwan-iface", 'w', 0, G_OPTION_ARG_NONE, &get_wwan_iface_flag,
       "Get the WWAN iface name associated with this control port",
       NULL
@@ -91,6 +133,14 @@ static GOptionEntry main_entries[] = {
       "Get service version info",
       NULL
     },
+    { "get-transactions", 0, 0, G_OPTION_ARG_NONE, &get_transactions_flag,
+      "Get the requests waiting for a response; in all the clients of the proxy if using --device-open-proxy",
+      NULL
+    },
+    { "proxy-stats", 0, 0, G_OPTION_ARG_NONE, &proxy_stats_flag,
+      "Get the traffic statistics of qmi-proxy, per device and per client (implies --device-open-proxy)",
+      NULL
+    },
     { "device-set-instance-id", 0, 0, G_OPTION_ARG_STRING, &device_set_instance_id_str,
       "Set instance ID",
       "[Instance ID]"
@@ -99,6 +149,10 @@ static GOptionEntry main_entries[] = {
       "Run version info check when opening device",
       NULL
     },
+    { "device-open-version-info-cache", 0, 0, G_OPTION_ARG_FILENAME, &device_open_version_info_cache_str,
+      "Cache the version info checked when opening device in the given directory",
+      "[PATH]"
+    },
     { "device-open-sync", 0, 0, G_OPTION_ARG_NONE, &device_open_sync_flag,
       "Run sync operation when opening device",
       NULL
@@ -131,6 +185,10 @@ static GOptionEntry main_entries[] = {
       "Do not release the CID when exiting",
       NULL
     },
+    { "client-cid-pool", 0, 0, G_OPTION_ARG_FILENAME, &client_cid_pool_str,
+      "Keep released CIDs in the given file, and reuse them instead of allocating new ones",
+      "[PATH]"
+    },
     { "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose_flag,
       "Run action with verbose logs, including the debug ones",
       NULL
@@ -143,6 +201,42 @@ static GOptionEntry main_entries[] = {
       "Print version",
       NULL
     },
+    { "trace-record", 0, 0, G_OPTION_ARG_FILENAME, &trace_record_str,
+      "Record a binary trace of the QMI traffic in the given file",
+      "[PATH]"
+    },
+    { "trace-decode", 0, 0, G_OPTION_ARG_FILENAME, &trace_decode_str,
+      "Decode a binary trace of QMI traffic, and exit",
+      "[PATH]"
+    },
+    { "trace-schema", 0, 0, G_OPTION_ARG_FILENAME, &trace_schema_str,
+      "Translate the messages of --trace-decode with the given binary schema database",
+      "[PATH]"
+    },
+    { "benchmark", 0, 0, G_OPTION_ARG_STRING, &benchmark_str,
+      "Measure the round-trip of a request without input TLVs, e.g. \"dms,0x0025\"",
+      "[(Service),(Message ID)]"
+    },
+    { "benchmark-count", 0, 0, G_OPTION_ARG_STRING, &benchmark_count_str,
+      "Number of requests to send in the benchmark (default 100)",
+      "[N]"
+    },
+    { "benchmark-concurrency", 0, 0, G_OPTION_ARG_STRING, &benchmark_concurrency_str,
+      "Number of benchmark requests to keep in flight (default 1)",
+      "[N]"
+    },
+    { "batch", 0, 0, G_OPTION_ARG_FILENAME, &batch_str,
+      "Run the actions given in each line of the file over the same device, or of stdin if '-'",
+      "[PATH]"
+    },
+    { "monitor", 0, 0, G_OPTION_ARG_STRING, &monitor_str,
+      "Print the indications of the given services until interrupted, e.g. \"nas,wds\"",
+      "[(Service),...]"
+    },
+    { "output-format", 0, 0, G_OPTION_ARG_STRING, &output_format_str,
+      "Print the results of the supported actions, and the records of --trace-decode, in the given format (default text)",
+      "[text|json|keyvalue]"
+    },
     { NULL }
 };
 
@@ -233,6 +327,238 @@ print_version_and_exit (void)
     exit (EXIT_SUCCESS);
 }
 
+/* One JSON object or set of keys per record, with the message given by the
+ * same TLV descriptors used for its printable contents */
+static void
+trace_decode_record_structured (const QmiTraceRecord *record,
+                                gint64                elapsed)
+{
+    GByteArray   *raw;
+    QmiMessage   *message;
+    QmicliOutput *out;
+    GError       *error = NULL;
+    gchar        *time_str;
+
+    out = qmicli_output_new (record->path, "trace-decode", NULL);
+
+    time_str = g_strdup_printf ("%" G_GINT64_FORMAT ".%06" G_GINT64_FORMAT,
+                                elapsed / G_USEC_PER_SEC,
+                                elapsed % G_USEC_PER_SEC);
+    qmicli_output_add_string (out, "time", NULL, time_str);
+    g_free (time_str);
+    qmicli_output_add_string (out, "direction", NULL, record->sent ? "sent" : "received");
+    if (record->latency >= 0)
+        qmicli_output_add_uint (out, "latency", NULL, (guint64) record->latency);
+
+    raw = g_byte_array_sized_new (record->raw_length);
+    g_byte_array_append (raw, record->raw, record->raw_length);
+    message = qmi_message_new_from_raw (raw, &error);
+    if (!message) {
+        qmicli_output_add_string (out, "error", NULL, error->message);
+        g_error_free (error);
+    } else {
+        gchar *json;
+
+        json = qmi_message_get_json (message, NULL);
+        qmicli_output_add_json (out, "message", NULL, json);
+        g_free (json);
+        qmi_message_unref (message);
+    }
+    g_byte_array_unref (raw);
+
+    qmicli_output_flush (out);
+}
+
+/* Schema database given with --trace-schema, if any */
+static QmiSchema *trace_schema;
+
+static void
+trace_decode_record (const QmiTraceRecord *record,
+                     gint64               *first_timestamp)
+{
+    GByteArray *raw;
+    QmiMessage *message;
+    GError     *error = NULL;
+    gchar      *latency_str = NULL;
+
+    if (*first_timestamp < 0)
+        *first_timestamp = record->timestamp;
+
+    if (qmicli_get_output_format () != QMICLI_OUTPUT_FORMAT_TEXT) {
+        trace_decode_record_structured (record, record->timestamp - *first_timestamp);
+        return;
+    }
+
+    if (record->latency >= 0)
+        latency_str = g_strdup_printf (" (latency: %" G_GINT64_FORMAT " us)", record->latency);
+
+    g_print ("[%" G_GINT64_FORMAT ".%06" G_GINT64_FORMAT "] [%s] %s%s\n",
+             (record->timestamp - *first_timestamp) / G_USEC_PER_SEC,
+             (record->timestamp - *first_timestamp) % G_USEC_PER_SEC,
+             record->path,
+             record->sent ? "sent" : "received",
+             latency_str ? latency_str : "");
+    g_free (latency_str);
+
+    raw = g_byte_array_sized_new (record->raw_length);
+    g_byte_array_append (raw, record->raw, record->raw_length);
+    message = qmi_message_new_from_raw (raw, &error);
+    if (!message) {
+        g_print ("  invalid message: %s\n", error->message);
+        g_error_free (error);
+    } else {
+        gchar *printable;
+
+        if (trace_schema)
+            printable = qmi_schema_get_printable (trace_schema, message, NULL, "  ");
+        else
+            printable = qmi_message_get_printable_full (message, NULL, "  ");
+        g_print ("%s\n", printable);
+        g_free (printable);
+        qmi_message_unref (message);
+    }
+    g_byte_array_unref (raw);
+}
+
+static void
+trace_decode_and_exit (void)
+{
+    gchar  *contents;
+    gsize   contents_length;
+    gint64  first_timestamp = -1;
+    GError *error = NULL;
+
+    if (!g_file_get_contents (trace_decode_str, &contents, &contents_length, &error)) {
+        g_printerr ("error: couldn't read trace: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+
+    if (trace_schema_str && !(trace_schema = qmi_schema_new_from_file (trace_schema_str, &error))) {
+        g_printerr ("error: couldn't load schema: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+
+    if (!qmi_trace_foreach_record ((const guint8 *) contents,
+                                   contents_length,
+                                   (QmiTraceForeachRecordFn) trace_decode_record,
+                                   &first_timestamp,
+                                   &error)) {
+        g_printerr ("error: couldn't decode trace: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+
+    g_free (contents);
+    if (trace_schema)
+        qmi_schema_unref (trace_schema);
+    exit (EXIT_SUCCESS);
+}
+
+static void
+trace_record (QmiDevice            *self,
+              const QmiTraceRecord *record,
+              QmiTraceRing         *ring)
+{
+    qmi_trace_ring_add (ring, record);
+}
+
+static void
+trace_record_save (void)
+{
+    GBytes *bytes;
+    GError *error = NULL;
+
+    bytes = qmi_trace_ring_dump (trace_ring);
+    if (!g_file_set_contents (trace_record_str,
+                              g_bytes_get_data (bytes, NULL),
+                              g_bytes_get_size (bytes),
+                              &error)) {
+        g_printerr ("error: couldn't write trace: %s\n", error->message);
+        g_error_free (error);
+    }
+    g_bytes_unref (bytes);
+}
+
+static gboolean
+benchmark_options_parse (void)
+{
+    gchar      **split;
+    GEnumClass  *enum_class;
+    GEnumValue  *enum_value;
+    gchar       *end = NULL;
+    gulong       message_id;
+
+    split = g_strsplit (benchmark_str, ",", -1);
+    if (g_strv_length (split) != 2) {
+        g_printerr ("error: invalid benchmark request given: '%s'\n", benchmark_str);
+        exit (EXIT_FAILURE);
+    }
+
+    enum_class = G_ENUM_CLASS (g_type_class_ref (QMI_TYPE_SERVICE));
+    enum_value = g_enum_get_value_by_nick (enum_class, split[0]);
+    if (!enum_value || enum_value->value == QMI_SERVICE_CTL || enum_value->value == QMI_SERVICE_UNKNOWN) {
+        g_printerr ("error: invalid benchmark service given: '%s'\n", split[0]);
+        exit (EXIT_FAILURE);
+    }
+    service = (QmiService) enum_value->value;
+    g_type_class_unref (enum_class);
+
+    message_id = strtoul (split[1], &end, 0);
+    if (!split[1][0] || *end || message_id > G_MAXUINT16) {
+        g_printerr ("error: invalid benchmark message ID given: '%s'\n", split[1]);
+        exit (EXIT_FAILURE);
+    }
+    benchmark_message_id = (guint16) message_id;
+    g_strfreev (split);
+
+    if (benchmark_count_str &&
+        (!qmicli_read_uint_from_string (benchmark_count_str, &benchmark_count) || !benchmark_count)) {
+        g_printerr ("error: invalid benchmark count given: '%s'\n", benchmark_count_str);
+        exit (EXIT_FAILURE);
+    }
+
+    if (benchmark_concurrency_str &&
+        (!qmicli_read_uint_from_string (benchmark_concurrency_str, &benchmark_concurrency) || !benchmark_concurrency)) {
+        g_printerr ("error: invalid benchmark concurrency given: '%s'\n", benchmark_concurrency_str);
+        exit (EXIT_FAILURE);
+    }
+
+    return TRUE;
+}
+
+static gboolean
+monitor_options_parse (void)
+{
+    gchar      **split;
+    GEnumClass  *enum_class;
+    guint        i;
+
+    enum_class = G_ENUM_CLASS (g_type_class_ref (QMI_TYPE_SERVICE));
+    monitor_services = g_array_new (FALSE, FALSE, sizeof (QmiService));
+
+    split = g_strsplit (monitor_str, ",", -1);
+    for (i = 0; split[i]; i++) {
+        GEnumValue *enum_value;
+        QmiService  monitor_service;
+
+        enum_value = g_enum_get_value_by_nick (enum_class, g_strstrip (split[i]));
+        if (!enum_value || enum_value->value == QMI_SERVICE_CTL || enum_value->value == QMI_SERVICE_UNKNOWN) {
+            g_printerr ("error: invalid service to monitor given: '%s'\n", split[i]);
+            exit (EXIT_FAILURE);
+        }
+        monitor_service = (QmiService) enum_value->value;
+        g_array_append_val (monitor_services, monitor_service);
+    }
+    g_strfreev (split);
+    g_type_class_unref (enum_class);
+
+    if (!monitor_services->len) {
+        g_printerr ("error: no services to monitor given\n");
+        exit (EXIT_FAILURE);
+    }
+
+    return TRUE;
+}
+
 static gboolean
 generic_options_enabled (void)
 {
@@ -244,6 +570,8 @@ generic_options_enabled (void)
 
     n_actions = (!!device_set_instance_id_str +
                  get_service_version_info_flag +
+                 get_transactions_flag +
+                 proxy_stats_flag +
                  get_wwan_iface_flag +
                  get_expected_data_format_flag +
                  !!set_expected_data_format_str);
@@ -260,6 +588,10 @@ generic_options_enabled (void)
 /*****************************************************************************/
 /* Running asynchronously */
 
+static void batch_line_done (gboolean reported_operation_status,
+                             gboolean skip_cid_release);
+static void batch_run_next (void);
+
 static void
 close_ready (QmiDevice    *dev,
              GAsyncResult *res)
@@ -275,6 +607,17 @@ close_ready (QmiDevice    *dev,
     g_main_loop_quit (loop);
 }
 
+static void
+print_client_not_released (QmiClient *cli)
+{
+    QmicliOutput *out;
+
+    out = qmicli_output_new (qmi_device_get_path_display (device), "client-not-released", "[%s] Client ID not released:\n");
+    qmicli_output_add_string (out, "service", "\tService: '%s'\n", qmi_service_get_string (qmi_client_get_service (cli)));
+    qmicli_output_add_uint   (out, "cid",     "\t    CID: '%s'\n", qmi_client_get_cid (cli));
+    qmicli_output_flush (out);
+}
+
 static void
 release_client_ready (QmiDevice *dev,
                       GAsyncResult *res)
@@ -296,6 +639,12 @@ qmicli_async_operation_done (gboolean reported_operation_status,
 {
     QmiDeviceReleaseClientFlags flags = QMI_DEVICE_RELEASE_CLIENT_FLAGS_NONE;
 
+    /* In batch mode, the client is kept for the next lines */
+    if (batch_lines) {
+        batch_line_done (reported_operation_status, skip_cid_release);
+        return;
+    }
+
     /* Keep the result of the operation */
     operation_status = reported_operation_status;
 
@@ -313,12 +662,7 @@ qmicli_async_operation_done (gboolean reported_operation_status,
     else if (!client_no_release_cid_flag)
         flags |= QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID;
     else
-        g_print ("[%s] Client ID not released:\n"
-                 "\tService: '%s'\n"
-                 "\t    CID: '%u'\n",
-                 qmi_device_get_path_display (device),
-                 qmi_service_get_string (service),
-                 qmi_client_get_cid (client));
+        print_client_not_released (client);
 
     qmi_device_release_client (device,
                                client,
@@ -330,53 +674,89 @@ qmicli_async_operation_done (gboolean reported_operation_status,
 }
 
 static void
-allocate_client_ready (QmiDevice *dev,
-                       GAsyncResult *res)
+run_service_action (QmiDevice *dev,
+                    QmiClient *action_client)
 {
-    GError *error = NULL;
-
-    client = qmi_device_allocate_client_finish (dev, res, &error);
-    if (!client) {
-        g_printerr ("error: couldn't create client for the '%s' service: %s\n",
-                    qmi_service_get_string (service),
-                    error->message);
-        exit (EXIT_FAILURE);
+    /* Benchmark runs the same way for any service */
+    if (benchmark_str) {
+        qmicli_benchmark_run (dev,
+                              action_client,
+                              benchmark_message_id,
+                              benchmark_count,
+                              benchmark_concurrency,
+                              cancellable);
+        return;
     }
 
     /* Run the service-specific action */
     switch (service) {
+#if QMI_SERVICE_DMS_SUPPORTED
     case QMI_SERVICE_DMS:
-        qmicli_dms_run (dev, QMI_CLIENT_DMS (client), cancellable);
+        qmicli_dms_run (dev, QMI_CLIENT_DMS (action_client), cancellable);
         return;
+#endif
+#if QMI_SERVICE_NAS_SUPPORTED
     case QMI_SERVICE_NAS:
-        qmicli_nas_run (dev, QMI_CLIENT_NAS (client), cancellable);
+        qmicli_nas_run (dev, QMI_CLIENT_NAS (action_client), cancellable);
         return;
+#endif
+#if QMI_SERVICE_WDS_SUPPORTED
     case QMI_SERVICE_WDS:
-        qmicli_wds_run (dev, QMI_CLIENT_WDS (client), cancellable);
+        qmicli_wds_run (dev, QMI_CLIENT_WDS (action_client), cancellable);
         return;
+#endif
+#if QMI_SERVICE_PBM_SUPPORTED
     case QMI_SERVICE_PBM:
-        qmicli_pbm_run (dev, QMI_CLIENT_PBM (client), cancellable);
+        qmicli_pbm_run (dev, QMI_CLIENT_PBM (action_client), cancellable);
         return;
+#endif
+#if QMI_SERVICE_PDC_SUPPORTED
     case QMI_SERVICE_PDC:
-        qmicli_pdc_run (dev, QMI_CLIENT_PDC (client), cancellable);
+        qmicli_pdc_run (dev, QMI_CLIENT_PDC (action_client), cancellable);
         return;
+#endif
+#if QMI_SERVICE_UIM_SUPPORTED
     case QMI_SERVICE_UIM:
-        qmicli_uim_run (dev, QMI_CLIENT_UIM (client), cancellable);
+        qmicli_uim_run (dev, QMI_CLIENT_UIM (action_client), cancellable);
         return;
+#endif
+#if QMI_SERVICE_WMS_SUPPORTED
     case QMI_SERVICE_WMS:
-        qmicli_wms_run (dev, QMI_CLIENT_WMS (client), cancellable);
+        qmicli_wms_run (dev, QMI_CLIENT_WMS (action_client), cancellable);
         return;
+#endif
+#if QMI_SERVICE_WDA_SUPPORTED
     case QMI_SERVICE_WDA:
-        qmicli_wda_run (dev, QMI_CLIENT_WDA (client), cancellable);
+        qmicli_wda_run (dev, QMI_CLIENT_WDA (action_client), cancellable);
         return;
+#endif
+#if QMI_SERVICE_VOICE_SUPPORTED
     case QMI_SERVICE_VOICE:
-        qmicli_voice_run (dev, QMI_CLIENT_VOICE (client), cancellable);
+        qmicli_voice_run (dev, QMI_CLIENT_VOICE (action_client), cancellable);
         return;
+#endif
     default:
         g_assert_not_reached ();
     }
 }
 
+static void
+allocate_client_ready (QmiDevice *dev,
+                       GAsyncResult *res)
+{
+    GError *error = NULL;
+
+    client = qmi_device_allocate_client_finish (dev, res, &error);
+    if (!client) {
+        g_printerr ("error: couldn't create client for the '%s' service: %s\n",
+                    qmi_service_get_string (service),
+                    error->message);
+        exit (EXIT_FAILURE);
+    }
+
+    run_service_action (dev, client);
+}
+
 static void
 device_allocate_client (QmiDevice *dev)
 {
@@ -509,6 +889,149 @@ device_get_service_version_info (QmiDevice *dev)
                                          NULL);
 }
 
+static void
+get_transactions_ready (QmiDevice    *dev,
+                        GAsyncResult *res)
+{
+    GError *error = NULL;
+    GArray *transactions;
+    guint i;
+
+    transactions = qmi_device_get_transactions_finish (dev, res, &error);
+    if (!transactions) {
+        g_printerr ("error: couldn't get transactions: %s\n",
+                    error->message);
+        exit (EXIT_FAILURE);
+    }
+
+    g_print ("[%s] Transactions (%u):\n",
+             qmi_device_get_path_display (dev),
+             transactions->len);
+    for (i = 0; i < transactions->len; i++) {
+        QmiDeviceTransactionInfo *info;
+        const gchar *service_str;
+        gchar *timeout_str;
+        gchar *client_str;
+
+        info = &g_array_index (transactions, QmiDeviceTransactionInfo, i);
+        service_str = qmi_service_get_string (info->service);
+        timeout_str = (info->timeout_remaining >= 0 ?
+                       g_strdup_printf ("%" G_GINT64_FORMAT " ms", info->timeout_remaining / 1000) :
+                       g_strdup ("none"));
+        client_str = (info->proxy_client_pid ?
+                      g_strdup_printf (", client pid %u", info->proxy_client_pid) :
+                      g_strdup (""));
+        g_print ("\t%s [0x%04x] cid %u, trid %u: %s, age %" G_GUINT64_FORMAT " ms, timeout %s%s\n",
+                 service_str ? service_str : "unknown",
+                 info->message_id,
+                 info->client_id,
+                 info->transaction_id,
+                 info->in_flight ? "sent" : "queued",
+                 info->age / 1000,
+                 timeout_str,
+                 client_str);
+        g_free (timeout_str);
+        g_free (client_str);
+    }
+    g_array_unref (transactions);
+
+    /* We're done now */
+    qmicli_async_operation_done (TRUE, FALSE);
+}
+
+static void
+device_get_transactions (QmiDevice *dev)
+{
+    g_debug ("Getting transactions...");
+    qmi_device_get_transactions (dev,
+                                 10,
+                                 cancellable,
+                                 (GAsyncReadyCallback)get_transactions_ready,
+                                 NULL);
+}
+
+static void
+get_proxy_stats_ready (QmiDevice    *dev,
+                       GAsyncResult *res)
+{
+    GError *error = NULL;
+    GArray *device_stats = NULL;
+    GArray *client_stats = NULL;
+    guint i;
+
+    if (!qmi_device_get_proxy_stats_finish (dev, res, &device_stats, &client_stats, &error)) {
+        g_printerr ("error: couldn't get proxy statistics: %s\n",
+                    error->message);
+        exit (EXIT_FAILURE);
+    }
+
+    g_print ("[%s] Proxy devices (%u):\n",
+             qmi_device_get_path_display (dev),
+             device_stats->len);
+    for (i = 0; i < device_stats->len; i++) {
+        QmiProxyDeviceStats *stats;
+        guint64 n_total;
+
+        stats = &g_array_index (device_stats, QmiProxyDeviceStats, i);
+        n_total = stats->n_requests + stats->n_coalesced + stats->n_cached;
+        g_print ("\t%s: %u clients\n"
+                 "\t\trequests:   %" G_GUINT64_FORMAT " sent, %" G_GUINT64_FORMAT " responses, %" G_GUINT64_FORMAT " timeouts, %" G_GUINT64_FORMAT " aborts\n"
+                 "\t\tindications: %" G_GUINT64_FORMAT "\n"
+                 "\t\tcache:      %" G_GUINT64_FORMAT " coalesced, %" G_GUINT64_FORMAT " cached (%.1f%% hit rate)\n"
+                 "\t\tbytes:      %" G_GUINT64_FORMAT " sent, %" G_GUINT64_FORMAT " received\n"
+                 "\t\tqueues:     %u in flight, %u in output queue, %u throttled\n"
+                 "\t\tlatency:    %.3f ms mean, %.3f ms p99\n",
+                 stats->device_path, stats->n_clients,
+                 stats->n_requests, stats->n_responses, stats->n_timeouts, stats->n_aborts,
+                 stats->n_indications,
+                 stats->n_coalesced, stats->n_cached,
+                 n_total ? (100.0 * (stats->n_coalesced + stats->n_cached)) / n_total : 0.0,
+                 stats->bytes_sent, stats->bytes_received,
+                 stats->n_in_flight, stats->output_queue_length, stats->throttled_queue_length,
+                 stats->latency_mean / 1000.0, stats->latency_p99 / 1000.0);
+    }
+
+    g_print ("[%s] Proxy clients (%u):\n",
+             qmi_device_get_path_display (dev),
+             client_stats->len);
+    for (i = 0; i < client_stats->len; i++) {
+        QmiProxyClientStats *stats;
+
+        stats = &g_array_index (client_stats, QmiProxyClientStats, i);
+        g_print ("\tpid %u at %s\n"
+                 "\t\trequests:   %" G_GUINT64_FORMAT " sent, %" G_GUINT64_FORMAT " responses, %" G_GUINT64_FORMAT " timeouts, %" G_GUINT64_FORMAT " aborts\n"
+                 "\t\tindications: %" G_GUINT64_FORMAT "\n"
+                 "\t\tbytes:      %" G_GUINT64_FORMAT " received, %" G_GUINT64_FORMAT " sent\n"
+                 "\t\tqueues:     %u pending, %u queued\n"
+                 "\t\tlatency:    %.3f ms mean, %.3f ms p99, %.3f ms max\n",
+                 stats->pid, stats->device_path ? stats->device_path : "unknown",
+                 stats->n_requests, stats->n_responses, stats->n_timeouts, stats->n_aborts,
+                 stats->n_indications,
+                 stats->bytes_received, stats->bytes_sent,
+                 stats->n_pending_requests, stats->n_queued_requests,
+                 stats->n_responses ? (stats->latency_total / 1000.0) / stats->n_responses : 0.0,
+                 stats->latency_p99 / 1000.0,
+                 stats->latency_max / 1000.0);
+    }
+
+    g_array_unref (device_stats);
+    g_array_unref (client_stats);
+
+    /* We're done now */
+    qmicli_async_operation_done (TRUE, FALSE);
+}
+
+static void
+device_get_proxy_stats (QmiDevice *dev)
+{
+    g_debug ("Getting proxy statistics...");
+    qmi_device_get_proxy_stats (dev,
+                                10,
+                                cancellable,
+                                (GAsyncReadyCallback)get_proxy_stats_ready,
+                                NULL);
+}
+
 static gboolean
 device_set_expected_data_format_cb (QmiDevice *dev)
 {
@@ -521,10 +1044,14 @@ device_set_expected_data_format_cb (QmiDevice *dev)
     else if (!qmi_device_set_expected_data_format (dev, expected, &error)) {
         g_printerr ("error: cannot set expected data format: %s\n", error->message);
         g_error_free (error);
-    } else
-        g_print ("[%s] expected data format set to: %s\n",
-                 qmi_device_get_path_display (dev),
-                 qmi_device_expected_data_format_get_string (expected));
+    } else {
+        QmicliOutput *out;
+
+        out = qmicli_output_new (qmi_device_get_path_display (dev), "set-expected-data-format", "[%s] ");
+        qmicli_output_add_string (out, "expected-data-format", "expected data format set to: %s\n",
+                                  qmi_device_expected_data_format_get_string (expected));
+        qmicli_output_flush (out);
+    }
 
     /* We're done now */
     qmicli_async_operation_done (!error, FALSE);
@@ -550,8 +1077,14 @@ device_get_expected_data_format_cb (QmiDevice *dev)
     if (expected == QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN) {
         g_printerr ("error: cannot get expected data format: %s\n", error->message);
         g_error_free (error);
-    } else
-        g_print ("%s\n", qmi_device_expected_data_format_get_string (expected));
+    } else {
+        QmicliOutput *out;
+
+        out = qmicli_output_new (qmi_device_get_path_display (dev), "get-expected-data-format", NULL);
+        qmicli_output_add_string (out, "expected-data-format", "%s\n",
+                                  qmi_device_expected_data_format_get_string (expected));
+        qmicli_output_flush (out);
+    }
 
     /* We're done now */
     qmicli_async_operation_done (!error, FALSE);
@@ -575,8 +1108,13 @@ device_get_wwan_iface_cb (QmiDevice *dev)
     wwan_iface = qmi_device_get_wwan_iface (dev);
     if (!wwan_iface)
         g_printerr ("error: cannot get WWAN interface name\n");
-    else
-        g_print ("%s\n", wwan_iface);
+    else {
+        QmicliOutput *out;
+
+        out = qmicli_output_new (qmi_device_get_path_display (dev), "get-wwan-iface", NULL);
+        qmicli_output_add_string (out, "wwan-iface", "%s\n", wwan_iface);
+        qmicli_output_flush (out);
+    }
 
     /* We're done now */
     qmicli_async_operation_done (!!wwan_iface, FALSE);
@@ -611,12 +1149,20 @@ device_open_ready (QmiDevice *dev,
         device_set_instance_id (dev);
     else if (get_service_version_info_flag)
         device_get_service_version_info (dev);
+    else if (get_transactions_flag)
+        device_get_transactions (dev);
+    else if (proxy_stats_flag)
+        device_get_proxy_stats (dev);
     else if (get_wwan_iface_flag)
         device_get_wwan_iface (dev);
     else if (get_expected_data_format_flag)
         device_get_expected_data_format (dev);
     else if (set_expected_data_format_str)
         device_set_expected_data_format (dev);
+    else if (monitor_services)
+        qmicli_monitor_run (dev, monitor_services, cancellable);
+    else if (batch_lines)
+        batch_run_next ();
     else
         device_allocate_client (dev);
 }
@@ -640,12 +1186,29 @@ device_new_ready (GObject *unused,
         exit (EXIT_FAILURE);
     }
 
+    if (trace_record_str) {
+        trace_ring = qmi_trace_ring_new (TRACE_RING_SIZE, 0);
+        qmi_device_set_trace_func (device,
+                                   (QmiDeviceTraceFn) trace_record,
+                                   qmi_trace_ring_ref (trace_ring),
+                                   (GDestroyNotify) qmi_trace_ring_unref);
+    }
+
     /* Setup device open flags */
-    if (device_open_version_info_flag)
+    if (device_open_version_info_flag || device_open_version_info_cache_str)
         open_flags |= QMI_DEVICE_OPEN_FLAGS_VERSION_INFO;
+    if (device_open_version_info_cache_str)
+        g_object_set (device,
+                      QMI_DEVICE_VERSION_INFO_CACHE_DIR, device_open_version_info_cache_str,
+                      NULL);
+    if (client_cid_pool_str)
+        g_object_set (device,
+                      QMI_DEVICE_CID_POOL,      TRUE,
+                      QMI_DEVICE_CID_POOL_FILE, client_cid_pool_str,
+                      NULL);
     if (device_open_sync_flag)
         open_flags |= QMI_DEVICE_OPEN_FLAGS_SYNC;
-    if (device_open_proxy_flag)
+    if (device_open_proxy_flag || proxy_stats_flag)
         open_flags |= QMI_DEVICE_OPEN_FLAGS_PROXY;
     if (device_open_mbim_flag)
         open_flags |= QMI_DEVICE_OPEN_FLAGS_MBIM;
@@ -666,70 +1229,457 @@ device_new_ready (GObject *unused,
 
 /*****************************************************************************/
 
-static void
-parse_actions (void)
+static GOptionContext *
+option_context_new (void)
 {
-    guint actions_enabled = 0;
+    GOptionContext *context;
 
-    /* Generic options? */
-    if (generic_options_enabled ()) {
-        service = QMI_SERVICE_CTL;
-        actions_enabled++;
-    }
+    context = g_option_context_new ("- Control QMI devices");
+#if QMI_SERVICE_DMS_SUPPORTED
+    g_option_context_add_group (context,
+                                qmicli_dms_get_option_group ());
+#endif
+#if QMI_SERVICE_NAS_SUPPORTED
+    g_option_context_add_group (context,
+                                qmicli_nas_get_option_group ());
+#endif
+#if QMI_SERVICE_WDS_SUPPORTED
+    g_option_context_add_group (context,
+                                qmicli_wds_get_option_group ());
+#endif
+#if QMI_SERVICE_PBM_SUPPORTED
+    g_option_context_add_group (context,
+                                qmicli_pbm_get_option_group ());
+#endif
+#if QMI_SERVICE_PDC_SUPPORTED
+    g_option_context_add_group (context,
+                                qmicli_pdc_get_option_group ());
+#endif
+#if QMI_SERVICE_UIM_SUPPORTED
+    g_option_context_add_group (context,
+                                qmicli_uim_get_option_group ());
+#endif
+#if QMI_SERVICE_WMS_SUPPORTED
+    g_option_context_add_group (context,
+                                qmicli_wms_get_option_group ());
+#endif
+#if QMI_SERVICE_WDA_SUPPORTED
+    g_option_context_add_group (context,
+                                qmicli_wda_get_option_group ());
+#endif
+#if QMI_SERVICE_VOICE_SUPPORTED
+    g_option_context_add_group (context,
+                                qmicli_voice_get_option_group ());
+#endif
+    return context;
+}
+
+static guint
+parse_service_actions (void)
+{
+    guint actions_enabled = 0;
 
+#if QMI_SERVICE_DMS_SUPPORTED
     /* DMS options? */
     if (qmicli_dms_options_enabled ()) {
         service = QMI_SERVICE_DMS;
         actions_enabled++;
     }
+#endif
 
+#if QMI_SERVICE_NAS_SUPPORTED
     /* NAS options? */
     if (qmicli_nas_options_enabled ()) {
         service = QMI_SERVICE_NAS;
         actions_enabled++;
     }
+#endif
 
+#if QMI_SERVICE_WDS_SUPPORTED
     /* WDS options? */
     if (qmicli_wds_options_enabled ()) {
         service = QMI_SERVICE_WDS;
         actions_enabled++;
     }
+#endif
 
+#if QMI_SERVICE_PBM_SUPPORTED
     /* PBM options? */
     if (qmicli_pbm_options_enabled ()) {
         service = QMI_SERVICE_PBM;
         actions_enabled++;
     }
+#endif
 
+#if QMI_SERVICE_PDC_SUPPORTED
     /* PDC options? */
     if (qmicli_pdc_options_enabled ()) {
         service = QMI_SERVICE_PDC;
         actions_enabled++;
     }
+#endif
 
+#if QMI_SERVICE_UIM_SUPPORTED
     /* UIM options? */
     if (qmicli_uim_options_enabled ()) {
         service = QMI_SERVICE_UIM;
         actions_enabled++;
     }
+#endif
 
+#if QMI_SERVICE_WMS_SUPPORTED
     /* WMS options? */
     if (qmicli_wms_options_enabled ()) {
         service = QMI_SERVICE_WMS;
         actions_enabled++;
     }
+#endif
 
+#if QMI_SERVICE_WDA_SUPPORTED
     /* WDA options? */
     if (qmicli_wda_options_enabled ()) {
         service = QMI_SERVICE_WDA;
         actions_enabled++;
     }
+#endif
 
+#if QMI_SERVICE_VOICE_SUPPORTED
     /* VOICE options? */
     if (qmicli_voice_options_enabled ()) {
         service = QMI_SERVICE_VOICE;
         actions_enabled++;
     }
+#endif
+
+    return actions_enabled;
+}
+
+/*****************************************************************************/
+/* Batch of actions */
+
+/* Parses the given batch line into the service options, as if it was given
+ * in the command line, and sets the service to use; exits on error */
+static void
+batch_line_parse (guint i)
+{
+    GOptionContext  *context;
+    GError          *error = NULL;
+    const gchar     *line;
+    gchar          **line_argv = NULL;
+    gchar          **argv;
+    gint             line_argc = 0;
+    gint             argc;
+    guint            actions_enabled;
+
+    line = g_ptr_array_index (batch_lines, i);
+
+    /* Every line starts from scratch */
+#if QMI_SERVICE_DMS_SUPPORTED
+    qmicli_dms_options_reset ();
+#endif
+#if QMI_SERVICE_NAS_SUPPORTED
+    qmicli_nas_options_reset ();
+#endif
+#if QMI_SERVICE_WDS_SUPPORTED
+    qmicli_wds_options_reset ();
+#endif
+#if QMI_SERVICE_PBM_SUPPORTED
+    qmicli_pbm_options_reset ();
+#endif
+#if QMI_SERVICE_PDC_SUPPORTED
+    qmicli_pdc_options_reset ();
+#endif
+#if QMI_SERVICE_UIM_SUPPORTED
+    qmicli_uim_options_reset ();
+#endif
+#if QMI_SERVICE_WMS_SUPPORTED
+    qmicli_wms_options_reset ();
+#endif
+#if QMI_SERVICE_WDA_SUPPORTED
+    qmicli_wda_options_reset ();
+#endif
+#if QMI_SERVICE_VOICE_SUPPORTED
+    qmicli_voice_options_reset ();
+#endif
+
+    if (!g_shell_parse_argv (line, &line_argc, &line_argv, &error)) {
+        g_printerr ("error: couldn't parse batch line %u: %s\n",
+                    i + 1, error->message);
+        exit (EXIT_FAILURE);
+    }
+
+    /* The strings are owned by line_argv, the parser only shuffles the
+     * pointers around */
+    argc = line_argc + 1;
+    argv = g_new0 (gchar *, argc + 1);
+    argv[0] = (gchar *) PROGRAM_NAME;
+    memcpy (&argv[1], line_argv, line_argc * sizeof (gchar *));
+
+    context = option_context_new ();
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("error: batch line %u: %s\n",
+                    i + 1, error->message);
+        exit (EXIT_FAILURE);
+    }
+    g_option_context_free (context);
+
+    if (argc > 1) {
+        g_printerr ("error: batch line %u: unexpected argument '%s'\n",
+                    i + 1, argv[1]);
+        exit (EXIT_FAILURE);
+    }
+
+    g_free (argv);
+    g_strfreev (line_argv);
+
+    actions_enabled = parse_service_actions ();
+    if (actions_enabled != 1) {
+        g_printerr ("error: batch line %u: %s\n",
+                    i + 1,
+                    actions_enabled ?
+                    "cannot execute multiple actions of different services" :
+                    "no actions specified");
+        exit (EXIT_FAILURE);
+    }
+}
+
+/* Loads and validates all lines before the device is opened, so that a
+ * wrong line doesn't leave the batch half-run */
+static void
+batch_options_parse (void)
+{
+    GError  *error = NULL;
+    gchar   *contents = NULL;
+    gchar  **lines;
+    guint    i;
+
+    if (g_str_equal (batch_str, "-")) {
+        GIOChannel *channel;
+
+        channel = g_io_channel_unix_new (STDIN_FILENO);
+        if (g_io_channel_read_to_end (channel, &contents, NULL, &error) != G_IO_STATUS_NORMAL) {
+            g_printerr ("error: couldn't read batch from stdin: %s\n",
+                        error->message);
+            exit (EXIT_FAILURE);
+        }
+        g_io_channel_unref (channel);
+    } else if (!g_file_get_contents (batch_str, &contents, NULL, &error)) {
+        g_printerr ("error: couldn't read batch file: %s\n",
+                    error->message);
+        exit (EXIT_FAILURE);
+    }
+
+    /* One action per line; empty lines and comments are skipped, but the
+     * line numbers in the output refer to the actions run */
+    batch_lines = g_ptr_array_new_with_free_func (g_free);
+    lines = g_strsplit (contents, "\n", -1);
+    for (i = 0; lines[i]; i++) {
+        g_strstrip (lines[i]);
+        if (lines[i][0] == '\0' || lines[i][0] == '#')
+            continue;
+        g_ptr_array_add (batch_lines, g_strdup (lines[i]));
+    }
+    g_strfreev (lines);
+    g_free (contents);
+
+    if (batch_lines->len == 0) {
+        g_printerr ("error: no actions specified in batch\n");
+        exit (EXIT_FAILURE);
+    }
+
+    for (i = 0; i < batch_lines->len; i++)
+        batch_line_parse (i);
+}
+
+static void
+batch_release_client_ready (QmiDevice    *dev,
+                            GAsyncResult *res)
+{
+    GError *error = NULL;
+
+    if (!qmi_device_release_client_finish (dev, res, &error)) {
+        g_printerr ("error: couldn't release client: %s\n", error->message);
+        g_error_free (error);
+    } else
+        g_debug ("Client released");
+
+    /* Close only once all clients are released */
+    g_assert (batch_n_releasing > 0);
+    if (--batch_n_releasing > 0)
+        return;
+
+    qmi_device_close_async (dev, 10, NULL, (GAsyncReadyCallback) close_ready, NULL);
+}
+
+static void
+batch_finish (void)
+{
+    QmiDeviceReleaseClientFlags flags = QMI_DEVICE_RELEASE_CLIENT_FLAGS_NONE;
+    GPtrArray                  *clients;
+    guint                       i;
+
+    operation_status = !batch_failed;
+
+    if (batch_skip_cid_release)
+        g_debug ("Skipped CID release");
+    else if (!client_no_release_cid_flag)
+        flags |= QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID;
+
+    /* Take all clients first, so that the last release knows it's the last */
+    clients = g_ptr_array_new_with_free_func (g_object_unref);
+    for (i = 0; i < G_N_ELEMENTS (batch_clients); i++) {
+        if (batch_clients[i]) {
+            g_ptr_array_add (clients, batch_clients[i]);
+            batch_clients[i] = NULL;
+        }
+    }
+
+    if (clients->len == 0) {
+        g_ptr_array_unref (clients);
+        qmi_device_close_async (device, 10, NULL, (GAsyncReadyCallback) close_ready, NULL);
+        return;
+    }
+
+    batch_n_releasing = clients->len;
+    for (i = 0; i < clients->len; i++) {
+        QmiClient *batch_client;
+
+        batch_client = g_ptr_array_index (clients, i);
+        if (client_no_release_cid_flag)
+            print_client_not_released (batch_client);
+        qmi_device_release_client (device,
+                                   batch_client,
+                                   flags,
+                                   10,
+                                   NULL,
+                                   (GAsyncReadyCallback) batch_release_client_ready,
+                                   NULL);
+    }
+    g_ptr_array_unref (clients);
+}
+
+static gboolean
+batch_run_next_cb (void)
+{
+    batch_run_next ();
+    return G_SOURCE_REMOVE;
+}
+
+static void
+batch_line_done (gboolean reported_operation_status,
+                 gboolean skip_cid_release)
+{
+    if (!reported_operation_status)
+        batch_failed = TRUE;
+    if (skip_cid_release)
+        batch_skip_cid_release = TRUE;
+
+    g_print ("@@@ end %u %s\n",
+             batch_line_i + 1,
+             reported_operation_status ? "success" : "failure");
+
+    /* Once cancelled, don't run the remaining lines */
+    if (g_cancellable_is_cancelled (cancellable))
+        batch_line_i = batch_lines->len;
+    else
+        batch_line_i++;
+    g_clear_object (&cancellable);
+
+    g_idle_add ((GSourceFunc) batch_run_next_cb, NULL);
+}
+
+static void
+batch_allocate_client_ready (QmiDevice    *dev,
+                             GAsyncResult *res)
+{
+    GError    *error = NULL;
+    QmiClient *batch_client;
+
+    batch_client = qmi_device_allocate_client_finish (dev, res, &error);
+    if (!batch_client) {
+        g_printerr ("error: couldn't create client for the '%s' service: %s\n",
+                    qmi_service_get_string (service),
+                    error->message);
+        g_error_free (error);
+        batch_line_done (FALSE, FALSE);
+        return;
+    }
+
+    batch_clients[service] = batch_client;
+    run_service_action (dev, batch_client);
+}
+
+static void
+batch_run_next (void)
+{
+    if (batch_line_i == batch_lines->len) {
+        batch_finish ();
+        return;
+    }
+
+    /* Already validated, so this only loads the options again */
+    batch_line_parse (batch_line_i);
+
+    g_print ("@@@ begin %u %s\n",
+             batch_line_i + 1,
+             (const gchar *) g_ptr_array_index (batch_lines, batch_line_i));
+
+    if (!cancellable)
+        cancellable = g_cancellable_new ();
+
+    /* One client per service, reused by all the lines of the same service */
+    if (batch_clients[service]) {
+        run_service_action (device, batch_clients[service]);
+        return;
+    }
+
+    qmi_device_allocate_client (device,
+                                service,
+                                QMI_CID_NONE,
+                                10,
+                                cancellable,
+                                (GAsyncReadyCallback) batch_allocate_client_ready,
+                                NULL);
+}
+
+/*****************************************************************************/
+
+static void
+parse_actions (void)
+{
+    guint actions_enabled = 0;
+
+    /* Generic options? */
+    if (generic_options_enabled ()) {
+        service = QMI_SERVICE_CTL;
+        actions_enabled++;
+    }
+
+    /* Benchmark? */
+    if (benchmark_str && benchmark_options_parse ())
+        actions_enabled++;
+
+    /* Monitor? Clients for each service are handled by the monitor itself */
+    if (monitor_str) {
+        if (client_cid_str) {
+            g_printerr ("error: cannot reuse a CID when monitoring indications\n");
+            exit (EXIT_FAILURE);
+        }
+        if (monitor_options_parse ())
+            actions_enabled++;
+    }
+
+    /* Batch? Actions are then given only in the batch lines */
+    if (batch_str) {
+        if (actions_enabled > 0 || parse_service_actions () > 0 || client_cid_str) {
+            g_printerr ("error: cannot execute other actions or reuse a CID along with a batch\n");
+            exit (EXIT_FAILURE);
+        }
+        batch_options_parse ();
+        return;
+    }
+
+    actions_enabled += parse_service_actions ();
 
     /* Cannot mix actions from different services */
     if (actions_enabled > 1) {
@@ -746,34 +1696,107 @@ parse_actions (void)
     /* Go on! */
 }
 
+/*****************************************************************************/
+/* Multiple devices */
+
+static gchar **
+devices_expand (void)
+{
+    GPtrArray *devices;
+    guint      i;
+
+    devices = g_ptr_array_new ();
+    for (i = 0; device_strv[i]; i++) {
+        glob_t matches;
+        gsize  j;
+
+        if (!strpbrk (device_strv[i], "*?[")) {
+            g_ptr_array_add (devices, g_strdup (device_strv[i]));
+            continue;
+        }
+
+        if (glob (device_strv[i], 0, NULL, &matches) != 0) {
+            g_printerr ("error: no device matches '%s'\n", device_strv[i]);
+            exit (EXIT_FAILURE);
+        }
+        for (j = 0; j < matches.gl_pathc; j++)
+            g_ptr_array_add (devices, g_strdup (matches.gl_pathv[j]));
+        globfree (&matches);
+    }
+
+    /* The same device given twice would just fail to be shared */
+    for (i = 0; i < devices->len; i++) {
+        guint j;
+
+        for (j = i + 1; j < devices->len; ) {
+            if (g_str_equal (g_ptr_array_index (devices, i), g_ptr_array_index (devices, j))) {
+                g_free (g_ptr_array_index (devices, j));
+                g_ptr_array_remove_index (devices, j);
+            } else
+                j++;
+        }
+    }
+
+    g_ptr_array_add (devices, NULL);
+    return (gchar **) g_ptr_array_free (devices, FALSE);
+}
+
+/* The original command line without the device paths, for the instances
+ * running the action on each device */
+static gchar **
+fleet_argv_new (gchar **argv)
+{
+    GPtrArray *fleet_argv;
+    gboolean   options_end = FALSE;
+    guint      i;
+
+    fleet_argv = g_ptr_array_new ();
+    g_ptr_array_add (fleet_argv, g_strdup (argv[0]));
+    for (i = 1; argv[i]; i++) {
+        if (!options_end) {
+            if (g_str_equal (argv[i], "--")) {
+                options_end = TRUE;
+            } else if (g_str_equal (argv[i], "-d") || g_str_equal (argv[i], "--device")) {
+                if (argv[i + 1])
+                    i++;
+                continue;
+            } else if (g_str_has_prefix (argv[i], "--device=") ||
+                       (g_str_has_prefix (argv[i], "-d") && !g_str_has_prefix (argv[i], "--"))) {
+                continue;
+            }
+        }
+        g_ptr_array_add (fleet_argv, g_strdup (argv[i]));
+    }
+    g_ptr_array_add (fleet_argv, NULL);
+    return (gchar **) g_ptr_array_free (fleet_argv, FALSE);
+}
+
+static gboolean
+device_timeout_cb (void)
+{
+    if (cancellable && !g_cancellable_is_cancelled (cancellable))
+        g_printerr ("error: operation timed out\n");
+    return signals_handler ();
+}
+
+/*****************************************************************************/
+
 int main (int argc, char **argv)
 {
     GError *error = NULL;
     GFile *file;
     GOptionContext *context;
+    gchar **original_argv;
+    gchar **devices;
+    guint device_timeout = 0;
 
     setlocale (LC_ALL, "");
 
+    /* Kept for the instances run when using multiple devices */
+    original_argv = g_strdupv (argv);
+
     /* Setup option context, process it and destroy it */
-    context = g_option_context_new ("- Control QMI devices");
-    g_option_context_add_group (context,
-                                qmicli_dms_get_option_group ());
-    g_option_context_add_group (context,
-                                qmicli_nas_get_option_group ());
-    g_option_context_add_group (context,
-                                qmicli_wds_get_option_group ());
-    g_option_context_add_group (context,
-                                qmicli_pbm_get_option_group ());
-    g_option_context_add_group (context,
-                                qmicli_pdc_get_option_group ());
-    g_option_context_add_group (context,
-                                qmicli_uim_get_option_group ());
-    g_option_context_add_group (context,
-                                qmicli_wms_get_option_group ());
-    g_option_context_add_group (context,
-                                qmicli_wda_get_option_group ());
-    g_option_context_add_group (context,
-                                qmicli_voice_get_option_group ());
+    context = option_context_new ();
     g_option_context_add_main_entries (context, main_entries, NULL);
     if (!g_option_context_parse (context, &argc, &argv, &error)) {
         g_printerr ("error: %s\n",
@@ -785,6 +1808,17 @@ int main (int argc, char **argv)
     if (version_flag)
         print_version_and_exit ();
 
+    if (output_format_str) {
+        QmicliOutputFormat output_format;
+
+        if (!qmicli_read_output_format_from_string (output_format_str, &output_format))
+            exit (EXIT_FAILURE);
+        qmicli_set_output_format (output_format);
+    }
+
+    if (trace_decode_str)
+        trace_decode_and_exit ();
+
     g_log_set_handler (NULL, G_LOG_LEVEL_MASK, log_handler, NULL);
     g_log_set_handler ("Qmi", G_LOG_LEVEL_MASK, log_handler, NULL);
     if (verbose_flag)
@@ -798,11 +1832,40 @@ int main (int argc, char **argv)
 #endif
 
     /* No device path given? */
-    if (!device_str) {
+    if (!device_strv) {
         g_printerr ("error: no device path specified\n");
         exit (EXIT_FAILURE);
     }
 
+    if (device_timeout_str && !qmicli_read_uint_from_string (device_timeout_str, &device_timeout)) {
+        g_printerr ("error: invalid device timeout: '%s'\n", device_timeout_str);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Same action on multiple devices? */
+    devices = devices_expand ();
+    if (g_strv_length (devices) > 1) {
+        gchar    **fleet_argv;
+        gboolean   success;
+
+        if (trace_record_str) {
+            g_printerr ("error: cannot record a trace of multiple devices\n");
+            exit (EXIT_FAILURE);
+        }
+
+        /* Validate the actions once, before running them on all devices */
+        parse_actions ();
+
+        fleet_argv = fleet_argv_new (original_argv);
+        success = qmicli_fleet_run (devices, fleet_argv);
+        g_strfreev (fleet_argv);
+        g_strfreev (devices);
+        g_strfreev (original_argv);
+        return (success ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    g_strfreev (original_argv);
+    device_str = devices[0];
+
     /* Build new GFile from the commandline arg */
     file = g_file_new_for_commandline_arg (device_str);
 
@@ -817,6 +1880,9 @@ int main (int argc, char **argv)
     g_unix_signal_add (SIGHUP,  (GSourceFunc) signals_handler, NULL);
     g_unix_signal_add (SIGTERM, (GSourceFunc) signals_handler, NULL);
 
+    if (device_timeout)
+        g_timeout_add_seconds (device_timeout, (GSourceFunc) device_timeout_cb, NULL);
+
     /* Launch QmiDevice creation */
     qmi_device_new (file,
                     cancellable,
@@ -828,10 +1894,19 @@ int main (int argc, char **argv)
         g_object_unref (cancellable);
     if (client)
         g_object_unref (client);
+    if (batch_lines)
+        g_ptr_array_unref (batch_lines);
+    if (monitor_services)
+        g_array_unref (monitor_services);
     if (device)
         g_object_unref (device);
+    if (trace_ring) {
+        trace_record_save ();
+        qmi_trace_ring_unref (trace_ring);
+    }
     g_main_loop_unref (loop);
     g_object_unref (file);
+    g_strfreev (devices);
 
     return (operation_status ? EXIT_SUCCESS : EXIT_FAILURE);
 }
@@ -27,67 +27,111 @@
 void          qmicli_async_operation_done (gboolean reported_operation_status,
                                            gboolean skip_cid_release);
 
+#if QMI_SERVICE_DMS_SUPPORTED
 /* DMS group */
 GOptionGroup *qmicli_dms_get_option_group (void);
 gboolean      qmicli_dms_options_enabled  (void);
+void          qmicli_dms_options_reset    (void);
 void          qmicli_dms_run              (QmiDevice *device,
                                            QmiClientDms *client,
                                            GCancellable *cancellable);
+#endif
 
+#if QMI_SERVICE_WDS_SUPPORTED
 /* WDS group */
 GOptionGroup *qmicli_wds_get_option_group (void);
 gboolean      qmicli_wds_options_enabled  (void);
+void          qmicli_wds_options_reset    (void);
 void          qmicli_wds_run              (QmiDevice *device,
                                            QmiClientWds *client,
                                            GCancellable *cancellable);
+#endif
 
+#if QMI_SERVICE_NAS_SUPPORTED
 /* NAS group */
 GOptionGroup *qmicli_nas_get_option_group (void);
 gboolean      qmicli_nas_options_enabled  (void);
+void          qmicli_nas_options_reset    (void);
 void          qmicli_nas_run              (QmiDevice *device,
                                            QmiClientNas *client,
                                            GCancellable *cancellable);
+#endif
 
+#if QMI_SERVICE_PBM_SUPPORTED
 /* PBM group */
 GOptionGroup *qmicli_pbm_get_option_group (void);
 gboolean      qmicli_pbm_options_enabled  (void);
+void          qmicli_pbm_options_reset    (void);
 void          qmicli_pbm_run              (QmiDevice *device,
                                            QmiClientPbm *client,
                                            GCancellable *cancellable);
+#endif
 
+#if QMI_SERVICE_PDC_SUPPORTED
 /* PDC group */
 GOptionGroup *qmicli_pdc_get_option_group (void);
 gboolean      qmicli_pdc_options_enabled  (void);
+void          qmicli_pdc_options_reset    (void);
 void          qmicli_pdc_run              (QmiDevice *device,
                                            QmiClientPdc *client,
                                            GCancellable *cancellable);
+#endif
 
+#if QMI_SERVICE_UIM_SUPPORTED
 /* UIM group */
 GOptionGroup *qmicli_uim_get_option_group (void);
 gboolean      qmicli_uim_options_enabled  (void);
+void          qmicli_uim_options_reset    (void);
 void          qmicli_uim_run              (QmiDevice *device,
                                            QmiClientUim *client,
                                            GCancellable *cancellable);
+#endif
 
+#if QMI_SERVICE_WMS_SUPPORTED
 /* WMS group */
 GOptionGroup *qmicli_wms_get_option_group (void);
 gboolean      qmicli_wms_options_enabled  (void);
+void          qmicli_wms_options_reset    (void);
 void          qmicli_wms_run              (QmiDevice *device,
                                            QmiClientWms *client,
                                            GCancellable *cancellable);
+#endif
 
+#if QMI_SERVICE_WDA_SUPPORTED
 /* WDA group */
 GOptionGroup *qmicli_wda_get_option_group (void);
 gboolean      qmicli_wda_options_enabled  (void);
+void          qmicli_wda_options_reset    (void);
 void          qmicli_wda_run              (QmiDevice *device,
                                            QmiClientWda *client,
                                            GCancellable *cancellable);
+#endif
 
+#if QMI_SERVICE_VOICE_SUPPORTED
 /* Voice group */
 GOptionGroup *qmicli_voice_get_option_group (void);
 gboolean      qmicli_voice_options_enabled  (void);
+void          qmicli_voice_options_reset    (void);
 void          qmicli_voice_run              (QmiDevice *device,
                                              QmiClientVoice *client,
                                              GCancellable *cancellable);
+#endif
+
+/* Benchmark */
+void          qmicli_benchmark_run (QmiDevice    *device,
+                                    QmiClient    *client,
+                                    guint16       message_id,
+                                    guint         count,
+                                    guint         concurrency,
+                                    GCancellable *cancellable);
+
+/* Monitor */
+void          qmicli_monitor_run   (QmiDevice    *device,
+                                    GArray       *services,
+                                    GCancellable *cancellable);
+
+/* Multiple devices */
+gboolean      qmicli_fleet_run     (gchar **devices,
+                                    gchar **argv);
 
 #endif /* __QMICLI_H__ */
@@ -283,6 +283,80 @@ test_parse_key_value_string_mixed_quotes (void)
 
 /******************************************************************************/
 
+static gchar *
+common_build_output (QmicliOutputFormat format)
+{
+    QmicliOutput *out;
+
+    qmicli_set_output_format (format);
+    out = qmicli_output_new ("/dev/cdc-wdm0", "test-command", "[%s] Test:\n");
+    qmicli_output_add_string (out, "status", "\tStatus: '%s'\n", "connected");
+    qmicli_output_add_uint   (out, "handle", "\tHandle: '%s'\n", G_MAXUINT32);
+    qmicli_output_add_string (out, "description", "\tDescription: %s\n", "a \"b\"\\\n\x01");
+    qmicli_set_output_format (QMICLI_OUTPUT_FORMAT_TEXT);
+    return qmicli_output_free_to_string (out);
+}
+
+static void
+test_output_text (void)
+{
+    gchar *str;
+
+    str = common_build_output (QMICLI_OUTPUT_FORMAT_TEXT);
+    g_assert_cmpstr (str, ==,
+                     "[/dev/cdc-wdm0] Test:\n"
+                     "\tStatus: 'connected'\n"
+                     "\tHandle: '4294967295'\n"
+                     "\tDescription: a \"b\"\\\n\x01\n");
+    g_free (str);
+}
+
+static void
+test_output_json (void)
+{
+    gchar *str;
+
+    str = common_build_output (QMICLI_OUTPUT_FORMAT_JSON);
+    g_assert_cmpstr (str, ==,
+                     "{\"device\":\"/dev/cdc-wdm0\","
+                     "\"command\":\"test-command\","
+                     "\"status\":\"connected\","
+                     "\"handle\":4294967295,"
+                     "\"description\":\"a \\\"b\\\"\\\\\\n\\u0001\"}\n");
+    g_free (str);
+}
+
+static void
+test_output_keyvalue (void)
+{
+    gchar *str;
+
+    str = common_build_output (QMICLI_OUTPUT_FORMAT_KEYVALUE);
+    g_assert_cmpstr (str, ==,
+                     "device=/dev/cdc-wdm0\n"
+                     "command=test-command\n"
+                     "status=connected\n"
+                     "handle=4294967295\n"
+                     "description=a \"b\"\\\\\\n\x01\n");
+    g_free (str);
+}
+
+static void
+test_output_format_from_string (void)
+{
+    QmicliOutputFormat format = QMICLI_OUTPUT_FORMAT_TEXT;
+
+    g_assert (qmicli_read_output_format_from_string ("json", &format));
+    g_assert_cmpint (format, ==, QMICLI_OUTPUT_FORMAT_JSON);
+    g_assert (qmicli_read_output_format_from_string ("keyvalue", &format));
+    g_assert_cmpint (format, ==, QMICLI_OUTPUT_FORMAT_KEYVALUE);
+    g_assert (qmicli_read_output_format_from_string ("text", &format));
+    g_assert_cmpint (format, ==, QMICLI_OUTPUT_FORMAT_TEXT);
+    g_assert (!qmicli_read_output_format_from_string ("xml", &format));
+}
+
+/******************************************************************************/
+
 int main (int argc, char **argv)
 {
     g_test_init (&argc, &argv, NULL);
@@ -305,5 +379,10 @@ int main (int argc, char **argv)
     g_test_add_func ("/qmicli/helpers/key-value/double-quotes", test_parse_key_value_string_double_quotes);
     g_test_add_func ("/qmicli/helpers/key-value/mixed-quotes",  test_parse_key_value_string_mixed_quotes);
 
+    g_test_add_func ("/qmicli/helpers/output/format-from-string", test_output_format_from_string);
+    g_test_add_func ("/qmicli/helpers/output/text",               test_output_text);
+    g_test_add_func ("/qmicli/helpers/output/json",               test_output_json);
+    g_test_add_func ("/qmicli/helpers/output/keyvalue",           test_output_keyvalue);
+
     return g_test_run ();
 }